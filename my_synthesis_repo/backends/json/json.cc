@@ -0,0 +1,453 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+#include "kernel/json.h"
+#include "kernel/threading.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct JsonWriter
+{
+	Design *design;
+	const CellTypes &ct;
+	bool use_selection;
+	bool compat_int_mode;
+	bool scopeinfo_mode;
+
+	JsonWriter(Design *design, const CellTypes &ct, bool use_selection, bool compat_int_mode, bool scopeinfo_mode) :
+			design(design), ct(ct), use_selection(use_selection), compat_int_mode(compat_int_mode), scopeinfo_mode(scopeinfo_mode) { }
+
+	// per module state, each module is written by its own ModuleWriter
+	struct ModuleWriter
+	{
+		const JsonWriter &parent;
+		JsonStream &f;
+		SigMap sigmap;
+		dict<SigBit, int> sigids;
+		int sigidcounter = 2;
+
+		ModuleWriter(const JsonWriter &parent, JsonStream &f, Module *module) : parent(parent), f(f), sigmap(module) { }
+
+		void write_name(IdString name)
+		{
+			f.name(RTLIL::unescape_id(name));
+		}
+
+		void write_bits(const SigSpec &sig)
+		{
+			f.begin_array();
+			for (auto bit : sigmap(sig)) {
+				if (bit.wire == nullptr) {
+					switch (bit.data) {
+						case State::S0: f.value("0", 1); break;
+						case State::S1: f.value("1", 1); break;
+						case State::Sz: f.value("z", 1); break;
+						default: f.value("x", 1); break;
+					}
+					continue;
+				}
+				auto it = sigids.find(bit);
+				if (it == sigids.end())
+					it = sigids.emplace(bit, sigidcounter++).first;
+				f.value(it->second);
+			}
+			f.end_array();
+		}
+
+		void write_param_val(const Const &val)
+		{
+			if ((val.flags & RTLIL::ConstFlags::CONST_FLAG_STRING) != 0) {
+				std::string str = val.decode_string();
+				// strings that read back as bits get a trailing space, see read_json
+				int state = 0;
+				for (char c : str) {
+					if (state == 0) {
+						if (c == ' ')
+							state = 1;
+						else if (c != '0' && c != '1' && c != 'x' && c != 'z')
+							state = 2;
+					} else if (state == 1 && c != ' ')
+						state = 2;
+				}
+				if (state < 2)
+					str += " ";
+				f.value(str);
+			} else if (parent.compat_int_mode && GetSize(val) <= 32 && val.is_fully_def()) {
+				if ((val.flags & RTLIL::ConstFlags::CONST_FLAG_SIGNED) != 0)
+					f.value(int64_t(val.as_int()));
+				else
+					f.value(int64_t(uint32_t(val.as_int())));
+			} else {
+				f.value(val.as_string());
+			}
+		}
+
+		void write_parameters(const dict<IdString, Const> &parameters)
+		{
+			f.begin_object();
+			for (auto &param : parameters) {
+				write_name(param.first);
+				write_param_val(param.second);
+			}
+			f.end_object();
+		}
+
+		void write_wire_layout(const Wire *wire)
+		{
+			if (wire->start_offset) {
+				f.name("offset");
+				f.value(int64_t(wire->start_offset));
+			}
+			if (wire->upto) {
+				f.name("upto");
+				f.value(int64_t(1));
+			}
+			if (wire->is_signed) {
+				f.name("signed");
+				f.value(int64_t(1));
+			}
+		}
+
+		void write_module(Module *module)
+		{
+			Design *design = parent.design;
+			bool use_selection = parent.use_selection;
+
+			f.begin_object();
+			f.name("attributes");
+			write_parameters(module->attributes);
+
+			if (module->parameter_default_values.size()) {
+				f.name("parameter_default_values");
+				write_parameters(module->parameter_default_values);
+			}
+
+			f.name("ports");
+			f.begin_object();
+			for (auto n : module->ports) {
+				Wire *w = module->wire(n);
+				if (use_selection && !design->selected_member(module->name, n))
+					continue;
+				write_name(n);
+				f.begin_object();
+				f.name("direction");
+				f.value(w->port_input ? w->port_output ? "inout" : "input" : "output");
+				f.name("bits");
+				write_bits(w);
+				write_wire_layout(w);
+				f.end_object();
+			}
+			f.end_object();
+
+			f.name("cells");
+			f.begin_object();
+			for (auto c : module->cells()) {
+				if (use_selection && !design->selected_member(module->name, c->name))
+					continue;
+				if (!parent.scopeinfo_mode && c->type == ID($scopeinfo))
+					continue;
+				write_name(c->name);
+				f.begin_object();
+				f.name("hide_name");
+				f.value(int64_t(c->name[0] == '$'));
+				f.name("type");
+				f.value(RTLIL::unescape_id(c->type));
+				f.name("parameters");
+				write_parameters(c->parameters);
+				f.name("attributes");
+				write_parameters(c->attributes);
+
+				if (parent.ct.cell_known(c->type)) {
+					f.name("port_directions");
+					f.begin_object();
+					for (auto &conn : c->connections()) {
+						std::string direction = "output";
+						if (parent.ct.cell_input(c->type, conn.first))
+							direction = parent.ct.cell_output(c->type, conn.first) ? "inout" : "input";
+						write_name(conn.first);
+						f.value(direction);
+					}
+					f.end_object();
+				}
+
+				f.name("connections");
+				f.begin_object();
+				for (auto &conn : c->connections()) {
+					write_name(conn.first);
+					write_bits(conn.second);
+				}
+				f.end_object();
+				f.end_object();
+			}
+			f.end_object();
+
+			if (!module->memories.empty()) {
+				f.name("memories");
+				f.begin_object();
+				for (auto &it : module->memories) {
+					if (use_selection && !design->selected_member(module->name, it.second->name))
+						continue;
+					write_name(it.second->name);
+					f.begin_object();
+					f.name("hide_name");
+					f.value(int64_t(it.second->name[0] == '$'));
+					f.name("attributes");
+					write_parameters(it.second->attributes);
+					f.name("width");
+					f.value(int64_t(it.second->width));
+					f.name("start_offset");
+					f.value(int64_t(it.second->start_offset));
+					f.name("size");
+					f.value(int64_t(it.second->size));
+					f.end_object();
+				}
+				f.end_object();
+			}
+
+			f.name("netnames");
+			f.begin_object();
+			for (auto w : module->wires()) {
+				if (use_selection && !design->selected_member(module->name, w->name))
+					continue;
+				write_name(w->name);
+				f.begin_object();
+				f.name("hide_name");
+				f.value(int64_t(w->name[0] == '$'));
+				f.name("bits");
+				write_bits(w);
+				write_wire_layout(w);
+				f.name("attributes");
+				write_parameters(w->attributes);
+				f.end_object();
+			}
+			f.end_object();
+
+			f.end_object();
+		}
+	};
+
+	void write_design(JsonStream &f)
+	{
+		std::vector<Module*> modules;
+		for (auto module : design->modules()) {
+			if (use_selection && !design->selected_module(module->name))
+				continue;
+			if (use_selection && design->selected_module(module->name) && !design->selected_whole_module(module->name))
+				log_warning("Module %s contains unselected objects, only selected objects are written.\n", log_id(module));
+			if (!module->processes.empty())
+				log_error("Module %s contains processes, which are not supported by JSON backend (run `proc` first).\n", log_id(module));
+			modules.push_back(module);
+		}
+
+		f.begin_object();
+		f.name("creator");
+		f.value(yosys_version_str, strlen(yosys_version_str));
+		f.name("modules");
+		f.begin_object();
+
+		// modules are rendered concurrently with -j, a batch at a time so that
+		// only a few of them are held in memory, and written in design order
+		int batch_size = std::max(1, 4 * yosys_parallel_jobs);
+		for (int batch = 0; batch < GetSize(modules); batch += batch_size)
+		{
+			int count = std::min(batch_size, GetSize(modules) - batch);
+			std::vector<std::string> texts(count);
+
+			parallel_for(count, [&](int i) {
+				JsonStream text(texts[i], 2);
+				ModuleWriter writer(*this, text, modules[batch + i]);
+				writer.write_module(modules[batch + i]);
+			});
+
+			for (int i = 0; i < count; i++) {
+				f.name(RTLIL::unescape_id(modules[batch + i]->name));
+				f.raw_value(texts[i]);
+				std::string().swap(texts[i]);
+			}
+		}
+
+		f.end_object();
+		f.end_object();
+	}
+};
+
+struct JsonBackend : public Backend {
+	JsonBackend() : Backend("json", "write design to a JSON file") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    write_json [options] [filename]\n");
+		log("\n");
+		log("Write a JSON netlist of the current design.\n");
+		log("\n");
+		log("    -selected\n");
+		log("        only write selected parts of the design.\n");
+		log("\n");
+		log("    -compat-int\n");
+		log("        emit 32-bit or smaller fully-defined parameter values directly\n");
+		log("        as JSON numbers (for compatibility with old parsers)\n");
+		log("\n");
+		log("    -noscopeinfo\n");
+		log("        don't include $scopeinfo cells in the output\n");
+		log("\n");
+		log("The output is written as it is generated and never held in memory as a\n");
+		log("whole. When synthesizer runs with -j <jobs>, the modules are rendered\n");
+		log("concurrently and written in design order.\n");
+		log("\n");
+#ifdef HYBRDLINK
+		log("When synthesizer was started with -U, the netlist is written in the encrypted\n");
+		log("form that is accepted by read_json.\n");
+		log("\n");
+#endif
+		log("The general syntax of the JSON output created by this command is as follows:\n");
+		log("\n");
+		log("    {\n");
+		log("      \"creator\": \"<version string>\",\n");
+		log("      \"modules\": {\n");
+		log("        <module_name>: {\n");
+		log("          \"attributes\": { <attribute_name>: <attribute_value>, ... },\n");
+		log("          \"parameter_default_values\": { <param_name>: <param_value>, ... },\n");
+		log("          \"ports\": {\n");
+		log("            <port_name>: <port_details>,\n");
+		log("            ...\n");
+		log("          },\n");
+		log("          \"cells\": {\n");
+		log("            <cell_name>: <cell_details>,\n");
+		log("            ...\n");
+		log("          },\n");
+		log("          \"memories\": {\n");
+		log("            <memory_name>: <memory_details>,\n");
+		log("            ...\n");
+		log("          },\n");
+		log("          \"netnames\": {\n");
+		log("            <net_name>: <net_details>,\n");
+		log("            ...\n");
+		log("          }\n");
+		log("        }\n");
+		log("      }\n");
+		log("    }\n");
+		log("\n");
+		log("Where <port_details> is:\n");
+		log("\n");
+		log("    {\n");
+		log("      \"direction\": <\"input\" | \"output\" | \"inout\">,\n");
+		log("      \"bits\": <bit_vector>\n");
+		log("      \"offset\": <the lowest bit index in use, if non-0>\n");
+		log("      \"upto\": <1 if the port bit indexing is MSB-first>\n");
+		log("      \"signed\": <1 if the port is signed>\n");
+		log("    }\n");
+		log("\n");
+		log("And <cell_details> is:\n");
+		log("\n");
+		log("    {\n");
+		log("      \"hide_name\": <1 | 0>,\n");
+		log("      \"type\": <cell_type>,\n");
+		log("      \"parameters\": { <parameter_name>: <parameter_value>, ... },\n");
+		log("      \"attributes\": { <attribute_name>: <attribute_value>, ... },\n");
+		log("      \"port_directions\": { <port_name>: <\"input\" | \"output\" | \"inout\">, ... },\n");
+		log("      \"connections\": { <port_name>: <bit_vector>, ... },\n");
+		log("    }\n");
+		log("\n");
+		log("And <memory_details> is:\n");
+		log("\n");
+		log("    {\n");
+		log("      \"hide_name\": <1 | 0>,\n");
+		log("      \"attributes\": { <attribute_name>: <attribute_value>, ... },\n");
+		log("      \"width\": <memory width>\n");
+		log("      \"start_offset\": <the lowest valid memory address>\n");
+		log("      \"size\": <memory size>\n");
+		log("    }\n");
+		log("\n");
+		log("And <net_details> is:\n");
+		log("\n");
+		log("    {\n");
+		log("      \"hide_name\": <1 | 0>,\n");
+		log("      \"bits\": <bit_vector>\n");
+		log("      \"offset\": <the lowest bit index in use, if non-0>\n");
+		log("      \"upto\": <1 if the port bit indexing is MSB-first>\n");
+		log("      \"signed\": <1 if the port is signed>\n");
+		log("    }\n");
+		log("\n");
+		log("The \"hide_name\" fields are set to 1 when the name of this cell or net is\n");
+		log("automatically created and is likely not of interest for a regular user.\n");
+		log("\n");
+		log("The \"port_directions\" section is only included for cells for which the\n");
+		log("interface is known.\n");
+		log("\n");
+		log("Module and cell ports and nets can be single bit wide or vectors of multiple\n");
+		log("bits. Each individual signal bit is assigned a unique integer. The <bit_vector>\n");
+		log("values referenced above are vectors of this integers. Signal bits that are\n");
+		log("connected to a constant driver are denoted as string \"0\", \"1\", \"x\", or\n");
+		log("\"z\" instead of a number.\n");
+		log("\n");
+		log("Bit vectors (including integers) are written as string holding the binary\n");
+		log("representation of the value. Strings are written as strings, with an appended\n");
+		log("blank in cases of strings of the form /[01xz]* */.\n");
+		log("\n");
+	}
+	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		bool use_selection = false;
+		bool compat_int_mode = false;
+		bool scopeinfo_mode = true;
+
+		log_header(design, "Executing JSON backend.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-selected") {
+				use_selection = true;
+				continue;
+			}
+			if (args[argidx] == "-compat-int") {
+				compat_int_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-noscopeinfo") {
+				scopeinfo_mode = false;
+				continue;
+			}
+			break;
+		}
+		extra_args(f, filename, args, argidx);
+
+		design->sort();
+
+		log("Output filename: %s\n", filename.c_str());
+
+		uint8_t xor_key = 0;
+#ifdef HYBRDLINK
+		if (flag_fasm_encryption)
+			xor_key = 0xAA;
+#endif
+
+		CellTypes ct(design);
+		JsonWriter writer(design, ct, use_selection, compat_int_mode, scopeinfo_mode);
+		JsonStream stream(*f, xor_key);
+		writer.write_design(stream);
+	}
+} JsonBackend;
+
+PRIVATE_NAMESPACE_END
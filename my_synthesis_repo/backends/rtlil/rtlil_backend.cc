@@ -24,13 +24,49 @@
 
 #include "rtlil_backend.h"
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include <errno.h>
 
 USING_YOSYS_NAMESPACE
 using namespace RTLIL_BACKEND;
 YOSYS_NAMESPACE_BEGIN
 
-void RTLIL_BACKEND::dump_const(std::ostream &f, const RTLIL::Const &data, int width, int offset, bool autoint)
+// The dump functions format into a std::string and only the ostream
+// overloads touch the stream, once per call. This avoids a stringf() and a
+// stream insertion for every token, which dominated the runtime on large
+// netlists.
+
+static inline void put_int(std::string &f, int value)
+{
+	char buf[16], *p = buf + sizeof(buf);
+	unsigned int v = value < 0 ? 0u - (unsigned int)value : value;
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while (v != 0);
+	if (value < 0)
+		*--p = '-';
+	f.append(p, buf + sizeof(buf) - p);
+}
+
+static inline void put_id(std::string &f, RTLIL::IdString id)
+{
+	f += id.c_str();
+}
+
+static void put_attributes(std::string &f, const std::string &indent, const dict<RTLIL::IdString, RTLIL::Const> &attributes)
+{
+	for (auto &it : attributes) {
+		f += indent;
+		f += "attribute ";
+		put_id(f, it.first);
+		f += ' ';
+		dump_const(f, it.second);
+		f += '\n';
+	}
+}
+
+void RTLIL_BACKEND::dump_const(std::string &f, const RTLIL::Const &data, int width, int offset, bool autoint)
 {
 	if (width < 0)
 		width = data.bits.size() - offset;
@@ -46,282 +82,310 @@ void RTLIL_BACKEND::dump_const(std::ostream &f, const RTLIL::Const &data, int wi
 				}
 			}
 			if (val >= 0) {
-				f << stringf("%d", val);
+				put_int(f, val);
 				return;
 			}
 		}
-		f << stringf("%d'", width);
+		put_int(f, width);
+		f += '\'';
 		if (data.is_fully_undef_x_only()) {
-			f << "x";
+			f += 'x';
 		} else {
 			for (int i = offset+width-1; i >= offset; i--) {
 				log_assert(i < (int)data.bits.size());
 				switch (data.bits[i]) {
-				case State::S0: f << stringf("0"); break;
-				case State::S1: f << stringf("1"); break;
-				case RTLIL::Sx: f << stringf("x"); break;
-				case RTLIL::Sz: f << stringf("z"); break;
-				case RTLIL::Sa: f << stringf("-"); break;
-				case RTLIL::Sm: f << stringf("m"); break;
+				case State::S0: f += '0'; break;
+				case State::S1: f += '1'; break;
+				case RTLIL::Sx: f += 'x'; break;
+				case RTLIL::Sz: f += 'z'; break;
+				case RTLIL::Sa: f += '-'; break;
+				case RTLIL::Sm: f += 'm'; break;
 				}
 			}
 		}
 	} else {
-		f << stringf("\"");
+		f += '"';
 		std::string str = data.decode_string();
 		for (size_t i = 0; i < str.size(); i++) {
 			if (str[i] == '\n')
-				f << stringf("\\n");
+				f += "\\n";
 			else if (str[i] == '\t')
-				f << stringf("\\t");
-			else if (str[i] < 32)
-				f << stringf("\\%03o", (unsigned char)str[i]);
-			else if (str[i] == '"')
-				f << stringf("\\\"");
+				f += "\\t";
+			else if (str[i] < 32) {
+				unsigned char c = str[i];
+				f += '\\';
+				f += char('0' + (c >> 6));
+				f += char('0' + ((c >> 3) & 7));
+				f += char('0' + (c & 7));
+			} else if (str[i] == '"')
+				f += "\\\"";
 			else if (str[i] == '\\')
-				f << stringf("\\\\");
+				f += "\\\\";
 			else
-				f << str[i];
+				f += str[i];
 		}
-		f << stringf("\"");
+		f += '"';
 	}
 }
 
-void RTLIL_BACKEND::dump_sigchunk(std::ostream &f, const RTLIL::SigChunk &chunk, bool autoint)
+void RTLIL_BACKEND::dump_sigchunk(std::string &f, const RTLIL::SigChunk &chunk, bool autoint)
 {
 	if (chunk.wire == NULL) {
 		dump_const(f, chunk.data, chunk.width, chunk.offset, autoint);
 	} else {
+		put_id(f, chunk.wire->name);
 		if (chunk.width == chunk.wire->width && chunk.offset == 0)
-			f << stringf("%s", chunk.wire->name.c_str());
-		else if (chunk.width == 1)
-			f << stringf("%s [%d]", chunk.wire->name.c_str(), chunk.offset);
-		else
-			f << stringf("%s [%d:%d]", chunk.wire->name.c_str(), chunk.offset+chunk.width-1, chunk.offset);
+			return;
+		f += " [";
+		if (chunk.width != 1) {
+			put_int(f, chunk.offset+chunk.width-1);
+			f += ':';
+		}
+		put_int(f, chunk.offset);
+		f += ']';
 	}
 }
 
-void RTLIL_BACKEND::dump_sigspec(std::ostream &f, const RTLIL::SigSpec &sig, bool autoint)
+void RTLIL_BACKEND::dump_sigspec(std::string &f, const RTLIL::SigSpec &sig, bool autoint)
 {
 	if (sig.is_chunk()) {
 		dump_sigchunk(f, sig.as_chunk(), autoint);
 	} else {
-		f << stringf("{ ");
+		f += "{ ";
 		for (auto it = sig.chunks().rbegin(); it != sig.chunks().rend(); ++it) {
 			dump_sigchunk(f, *it, false);
-			f << stringf(" ");
+			f += ' ';
 		}
-		f << stringf("}");
+		f += '}';
 	}
 }
 
-void RTLIL_BACKEND::dump_wire(std::ostream &f, std::string indent, const RTLIL::Wire *wire)
+void RTLIL_BACKEND::dump_wire(std::string &f, const std::string &indent, const RTLIL::Wire *wire)
 {
-	for (auto &it : wire->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
+	put_attributes(f, indent, wire->attributes);
+	f += indent;
+	f += "wire ";
+	if (wire->width != 1) {
+		f += "width ";
+		put_int(f, wire->width);
+		f += ' ';
 	}
-	f << stringf("%s" "wire ", indent.c_str());
-	if (wire->width != 1)
-		f << stringf("width %d ", wire->width);
 	if (wire->upto)
-		f << stringf("upto ");
-	if (wire->start_offset != 0)
-		f << stringf("offset %d ", wire->start_offset);
-	if (wire->port_input && !wire->port_output)
-		f << stringf("input %d ", wire->port_id);
-	if (!wire->port_input && wire->port_output)
-		f << stringf("output %d ", wire->port_id);
-	if (wire->port_input && wire->port_output)
-		f << stringf("inout %d ", wire->port_id);
+		f += "upto ";
+	if (wire->start_offset != 0) {
+		f += "offset ";
+		put_int(f, wire->start_offset);
+		f += ' ';
+	}
+	if (wire->port_input || wire->port_output) {
+		f += !wire->port_output ? "input " : !wire->port_input ? "output " : "inout ";
+		put_int(f, wire->port_id);
+		f += ' ';
+	}
 	if (wire->is_signed)
-		f << stringf("signed ");
-	f << stringf("%s\n", wire->name.c_str());
+		f += "signed ";
+	put_id(f, wire->name);
+	f += '\n';
 }
 
-void RTLIL_BACKEND::dump_memory(std::ostream &f, std::string indent, const RTLIL::Memory *memory)
+void RTLIL_BACKEND::dump_memory(std::string &f, const std::string &indent, const RTLIL::Memory *memory)
 {
-	for (auto &it : memory->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
+	put_attributes(f, indent, memory->attributes);
+	f += indent;
+	f += "memory ";
+	if (memory->width != 1) {
+		f += "width ";
+		put_int(f, memory->width);
+		f += ' ';
+	}
+	if (memory->size != 0) {
+		f += "size ";
+		put_int(f, memory->size);
+		f += ' ';
 	}
-	f << stringf("%s" "memory ", indent.c_str());
-	if (memory->width != 1)
-		f << stringf("width %d ", memory->width);
-	if (memory->size != 0)
-		f << stringf("size %d ", memory->size);
-	if (memory->start_offset != 0)
-		f << stringf("offset %d ", memory->start_offset);
-	f << stringf("%s\n", memory->name.c_str());
+	if (memory->start_offset != 0) {
+		f += "offset ";
+		put_int(f, memory->start_offset);
+		f += ' ';
+	}
+	put_id(f, memory->name);
+	f += '\n';
 }
 
-void RTLIL_BACKEND::dump_cell(std::ostream &f, std::string indent, const RTLIL::Cell *cell)
+void RTLIL_BACKEND::dump_cell(std::string &f, const std::string &indent, const RTLIL::Cell *cell)
 {
-	for (auto &it : cell->attributes) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it.first.c_str());
-		dump_const(f, it.second);
-		f << stringf("\n");
-	}
-	f << stringf("%s" "cell %s %s\n", indent.c_str(), cell->type.c_str(), cell->name.c_str());
+	put_attributes(f, indent, cell->attributes);
+	f += indent;
+	f += "cell ";
+	put_id(f, cell->type);
+	f += ' ';
+	put_id(f, cell->name);
+	f += '\n';
 	for (auto &it : cell->parameters) {
-		f << stringf("%s  parameter%s%s %s ", indent.c_str(),
-				(it.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0 ? " signed" : "",
-				(it.second.flags & RTLIL::CONST_FLAG_REAL) != 0 ? " real" : "",
-				it.first.c_str());
+		f += indent;
+		f += "  parameter";
+		if ((it.second.flags & RTLIL::CONST_FLAG_SIGNED) != 0)
+			f += " signed";
+		if ((it.second.flags & RTLIL::CONST_FLAG_REAL) != 0)
+			f += " real";
+		f += ' ';
+		put_id(f, it.first);
+		f += ' ';
 		dump_const(f, it.second);
-		f << stringf("\n");
+		f += '\n';
 	}
 	for (auto &it : cell->connections()) {
-		f << stringf("%s  connect %s ", indent.c_str(), it.first.c_str());
+		f += indent;
+		f += "  connect ";
+		put_id(f, it.first);
+		f += ' ';
 		dump_sigspec(f, it.second);
-		f << stringf("\n");
+		f += '\n';
 	}
-	f << stringf("%s" "end\n", indent.c_str());
+	f += indent;
+	f += "end\n";
 }
 
-void RTLIL_BACKEND::dump_proc_case_body(std::ostream &f, std::string indent, const RTLIL::CaseRule *cs)
+void RTLIL_BACKEND::dump_proc_case_body(std::string &f, const std::string &indent, const RTLIL::CaseRule *cs)
 {
 	for (auto it = cs->actions.begin(); it != cs->actions.end(); ++it)
 	{
-		f << stringf("%s" "assign ", indent.c_str());
+		f += indent;
+		f += "assign ";
 		dump_sigspec(f, it->first);
-		f << stringf(" ");
+		f += ' ';
 		dump_sigspec(f, it->second);
-		f << stringf("\n");
+		f += '\n';
 	}
 
 	for (auto it = cs->switches.begin(); it != cs->switches.end(); ++it)
 		dump_proc_switch(f, indent, *it);
 }
 
-void RTLIL_BACKEND::dump_proc_switch(std::ostream &f, std::string indent, const RTLIL::SwitchRule *sw)
+void RTLIL_BACKEND::dump_proc_switch(std::string &f, const std::string &indent, const RTLIL::SwitchRule *sw)
 {
-	for (auto it = sw->attributes.begin(); it != sw->attributes.end(); ++it) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-		dump_const(f, it->second);
-		f << stringf("\n");
-	}
+	put_attributes(f, indent, sw->attributes);
 
-	f << stringf("%s" "switch ", indent.c_str());
+	f += indent;
+	f += "switch ";
 	dump_sigspec(f, sw->signal);
-	f << stringf("\n");
+	f += '\n';
 
 	for (auto it = sw->cases.begin(); it != sw->cases.end(); ++it)
 	{
-		for (auto ait = (*it)->attributes.begin(); ait != (*it)->attributes.end(); ++ait) {
-			f << stringf("%s  attribute %s ", indent.c_str(), ait->first.c_str());
-			dump_const(f, ait->second);
-			f << stringf("\n");
-		}
-		f << stringf("%s  case ", indent.c_str());
+		put_attributes(f, indent + "  ", (*it)->attributes);
+		f += indent;
+		f += "  case ";
 		for (size_t i = 0; i < (*it)->compare.size(); i++) {
 			if (i > 0)
-				f << stringf(" , ");
+				f += " , ";
 			dump_sigspec(f, (*it)->compare[i]);
 		}
-		f << stringf("\n");
+		f += '\n';
 
 		dump_proc_case_body(f, indent + "    ", *it);
 	}
 
-	f << stringf("%s" "end\n", indent.c_str());
+	f += indent;
+	f += "end\n";
 }
 
-void RTLIL_BACKEND::dump_proc_sync(std::ostream &f, std::string indent, const RTLIL::SyncRule *sy)
+void RTLIL_BACKEND::dump_proc_sync(std::string &f, const std::string &indent, const RTLIL::SyncRule *sy)
 {
-	f << stringf("%s" "sync ", indent.c_str());
+	f += indent;
+	f += "sync ";
 	switch (sy->type) {
-	case RTLIL::ST0: f << stringf("low ");
-	if (0) case RTLIL::ST1: f << stringf("high ");
-	if (0) case RTLIL::STp: f << stringf("posedge ");
-	if (0) case RTLIL::STn: f << stringf("negedge ");
-	if (0) case RTLIL::STe: f << stringf("edge ");
+	case RTLIL::ST0: f += "low ";
+	if (0) case RTLIL::ST1: f += "high ";
+	if (0) case RTLIL::STp: f += "posedge ";
+	if (0) case RTLIL::STn: f += "negedge ";
+	if (0) case RTLIL::STe: f += "edge ";
 		dump_sigspec(f, sy->signal);
-		f << stringf("\n");
+		f += '\n';
 		break;
-	case RTLIL::STa: f << stringf("always\n"); break;
-	case RTLIL::STg: f << stringf("global\n"); break;
-	case RTLIL::STi: f << stringf("init\n"); break;
+	case RTLIL::STa: f += "always\n"; break;
+	case RTLIL::STg: f += "global\n"; break;
+	case RTLIL::STi: f += "init\n"; break;
 	}
 
 	for (auto &it: sy->actions) {
-		f << stringf("%s  update ", indent.c_str());
+		f += indent;
+		f += "  update ";
 		dump_sigspec(f, it.first);
-		f << stringf(" ");
+		f += ' ';
 		dump_sigspec(f, it.second);
-		f << stringf("\n");
+		f += '\n';
 	}
 
 	for (auto &it: sy->mem_write_actions) {
-		for (auto it2 = it.attributes.begin(); it2 != it.attributes.end(); ++it2) {
-			f << stringf("%s  attribute %s ", indent.c_str(), it2->first.c_str());
-			dump_const(f, it2->second);
-			f << stringf("\n");
-		}
-		f << stringf("%s  memwr %s ", indent.c_str(), it.memid.c_str());
+		put_attributes(f, indent + "  ", it.attributes);
+		f += indent;
+		f += "  memwr ";
+		put_id(f, it.memid);
+		f += ' ';
 		dump_sigspec(f, it.address);
-		f << stringf(" ");
+		f += ' ';
 		dump_sigspec(f, it.data);
-		f << stringf(" ");
+		f += ' ';
 		dump_sigspec(f, it.enable);
-		f << stringf(" ");
+		f += ' ';
 		dump_const(f, it.priority_mask);
-		f << stringf("\n");
+		f += '\n';
 	}
 }
 
-void RTLIL_BACKEND::dump_proc(std::ostream &f, std::string indent, const RTLIL::Process *proc)
+void RTLIL_BACKEND::dump_proc(std::string &f, const std::string &indent, const RTLIL::Process *proc)
 {
-	for (auto it = proc->attributes.begin(); it != proc->attributes.end(); ++it) {
-		f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-		dump_const(f, it->second);
-		f << stringf("\n");
-	}
-	f << stringf("%s" "process %s\n", indent.c_str(), proc->name.c_str());
+	put_attributes(f, indent, proc->attributes);
+	f += indent;
+	f += "process ";
+	put_id(f, proc->name);
+	f += '\n';
 	dump_proc_case_body(f, indent + "  ", &proc->root_case);
 	for (auto it = proc->syncs.begin(); it != proc->syncs.end(); ++it)
 		dump_proc_sync(f, indent + "  ", *it);
-	f << stringf("%s" "end\n", indent.c_str());
+	f += indent;
+	f += "end\n";
 }
 
-void RTLIL_BACKEND::dump_conn(std::ostream &f, std::string indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
+void RTLIL_BACKEND::dump_conn(std::string &f, const std::string &indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
 {
-	f << stringf("%s" "connect ", indent.c_str());
+	f += indent;
+	f += "connect ";
 	dump_sigspec(f, left);
-	f << stringf(" ");
+	f += ' ';
 	dump_sigspec(f, right);
-	f << stringf("\n");
+	f += '\n';
 }
 
-void RTLIL_BACKEND::dump_module(std::ostream &f, std::string indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+void RTLIL_BACKEND::dump_module(std::string &f, const std::string &indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
 {
 	bool print_header = flag_m || design->selected_whole_module(module->name);
 	bool print_body = !flag_n || !design->selected_whole_module(module->name);
+	std::string body_indent = indent + "  ";
 
 	if (print_header)
 	{
-		for (auto it = module->attributes.begin(); it != module->attributes.end(); ++it) {
-			f << stringf("%s" "attribute %s ", indent.c_str(), it->first.c_str());
-			dump_const(f, it->second);
-			f << stringf("\n");
-		}
+		put_attributes(f, indent, module->attributes);
 
-		f << stringf("%s" "module %s\n", indent.c_str(), module->name.c_str());
+		f += indent;
+		f += "module ";
+		put_id(f, module->name);
+		f += '\n';
 
 		if (!module->avail_parameters.empty()) {
 			if (only_selected)
-				f << stringf("\n");
+				f += '\n';
 			for (const auto &p : module->avail_parameters) {
 				const auto &it = module->parameter_default_values.find(p);
-				if (it == module->parameter_default_values.end()) {
-					f << stringf("%s" "  parameter %s\n", indent.c_str(), p.c_str());
-				} else {
-					f << stringf("%s" "  parameter %s ", indent.c_str(), p.c_str());
+				f += body_indent;
+				f += "parameter ";
+				put_id(f, p);
+				if (it != module->parameter_default_values.end()) {
+					f += ' ';
 					dump_const(f, it->second);
-					f << stringf("\n");
 				}
+				f += '\n';
 			}
 		}
 	}
@@ -331,29 +395,29 @@ void RTLIL_BACKEND::dump_module(std::ostream &f, std::string indent, RTLIL::Modu
 		for (auto it : module->wires())
 			if (!only_selected || design->selected(module, it)) {
 				if (only_selected)
-					f << stringf("\n");
-				dump_wire(f, indent + "  ", it);
+					f += '\n';
+				dump_wire(f, body_indent, it);
 			}
 
 		for (auto it : module->memories)
 			if (!only_selected || design->selected(module, it.second)) {
 				if (only_selected)
-					f << stringf("\n");
-				dump_memory(f, indent + "  ", it.second);
+					f += '\n';
+				dump_memory(f, body_indent, it.second);
 			}
 
 		for (auto it : module->cells())
 			if (!only_selected || design->selected(module, it)) {
 				if (only_selected)
-					f << stringf("\n");
-				dump_cell(f, indent + "  ", it);
+					f += '\n';
+				dump_cell(f, body_indent, it);
 			}
 
 		for (auto it : module->processes)
 			if (!only_selected || design->selected(module, it.second)) {
 				if (only_selected)
-					f << stringf("\n");
-				dump_proc(f, indent + "  ", it.second);
+					f += '\n';
+				dump_proc(f, body_indent, it.second);
 			}
 
 		bool first_conn_line = true;
@@ -370,15 +434,17 @@ void RTLIL_BACKEND::dump_module(std::ostream &f, std::string indent, RTLIL::Modu
 			}
 			if (show_conn) {
 				if (only_selected && first_conn_line)
-					f << stringf("\n");
-				dump_conn(f, indent + "  ", it->first, it->second);
+					f += '\n';
+				dump_conn(f, body_indent, it->first, it->second);
 				first_conn_line = false;
 			}
 		}
 	}
 
-	if (print_header)
-		f << stringf("%s" "end\n", indent.c_str());
+	if (print_header) {
+		f += indent;
+		f += "end\n";
+	}
 }
 
 void RTLIL_BACKEND::dump_design(std::ostream &f, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
@@ -399,21 +465,122 @@ void RTLIL_BACKEND::dump_design(std::ostream &f, RTLIL::Design *design, bool onl
 
 	if (!only_selected || flag_m) {
 		if (only_selected)
-			f << stringf("\n");
+			f << "\n";
 		f << stringf("autoidx %d\n", autoidx);
 	}
 
-	for (auto module : design->modules()) {
-		if (!only_selected || design->selected(module)) {
+	std::vector<RTLIL::Module*> modules;
+	for (auto module : design->modules())
+		if (!only_selected || design->selected(module))
+			modules.push_back(module);
+
+	// modules are formatted concurrently with -j, a batch at a time so that
+	// only a few of them are held in memory, and written in design order
+	int batch_size = std::max(1, 4 * yosys_parallel_jobs);
+	for (int batch = 0; batch < GetSize(modules); batch += batch_size)
+	{
+		int count = std::min(batch_size, GetSize(modules) - batch);
+		std::vector<std::string> texts(count);
+
+		parallel_for(count, [&](int i) {
 			if (only_selected)
-				f << stringf("\n");
-			dump_module(f, "", module, design, only_selected, flag_m, flag_n);
-		}
+				texts[i] += '\n';
+			dump_module(texts[i], "", modules[batch + i], design, only_selected, flag_m, flag_n);
+		});
+
+		for (auto &text : texts)
+			f.write(text.data(), text.size());
 	}
 
 	log_assert(init_autoidx == autoidx);
 }
 
+// ostream front ends for the functions above
+
+void RTLIL_BACKEND::dump_const(std::ostream &f, const RTLIL::Const &data, int width, int offset, bool autoint)
+{
+	std::string buf;
+	dump_const(buf, data, width, offset, autoint);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_sigchunk(std::ostream &f, const RTLIL::SigChunk &chunk, bool autoint)
+{
+	std::string buf;
+	dump_sigchunk(buf, chunk, autoint);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_sigspec(std::ostream &f, const RTLIL::SigSpec &sig, bool autoint)
+{
+	std::string buf;
+	dump_sigspec(buf, sig, autoint);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_wire(std::ostream &f, const std::string &indent, const RTLIL::Wire *wire)
+{
+	std::string buf;
+	dump_wire(buf, indent, wire);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_memory(std::ostream &f, const std::string &indent, const RTLIL::Memory *memory)
+{
+	std::string buf;
+	dump_memory(buf, indent, memory);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_cell(std::ostream &f, const std::string &indent, const RTLIL::Cell *cell)
+{
+	std::string buf;
+	dump_cell(buf, indent, cell);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_proc_case_body(std::ostream &f, const std::string &indent, const RTLIL::CaseRule *cs)
+{
+	std::string buf;
+	dump_proc_case_body(buf, indent, cs);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_proc_switch(std::ostream &f, const std::string &indent, const RTLIL::SwitchRule *sw)
+{
+	std::string buf;
+	dump_proc_switch(buf, indent, sw);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_proc_sync(std::ostream &f, const std::string &indent, const RTLIL::SyncRule *sy)
+{
+	std::string buf;
+	dump_proc_sync(buf, indent, sy);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_proc(std::ostream &f, const std::string &indent, const RTLIL::Process *proc)
+{
+	std::string buf;
+	dump_proc(buf, indent, proc);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_conn(std::ostream &f, const std::string &indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right)
+{
+	std::string buf;
+	dump_conn(buf, indent, left, right);
+	f.write(buf.data(), buf.size());
+}
+
+void RTLIL_BACKEND::dump_module(std::ostream &f, const std::string &indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m, bool flag_n)
+{
+	std::string buf;
+	dump_module(buf, indent, module, design, only_selected, flag_m, flag_n);
+	f.write(buf.data(), buf.size());
+}
+
 YOSYS_NAMESPACE_END
 PRIVATE_NAMESPACE_BEGIN
 
@@ -432,10 +599,17 @@ struct RTLILBackend : public Backend {
 		log("    -selected\n");
 		log("        only write selected parts of the design.\n");
 		log("\n");
+		log("    -bin\n");
+		log("        write a binary RTLIL checkpoint instead of text. It holds the same\n");
+		log("        information, is much faster to read back with 'read_rtlil -bin' and\n");
+		log("        allows loading individual modules. With -selected, every module that\n");
+		log("        is at least partially selected is written as a whole.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		bool selected = false;
+		bool flag_bin = false;
 
 		log_header(design, "Executing RTLIL backend.\n");
 
@@ -446,13 +620,23 @@ struct RTLILBackend : public Backend {
 				selected = true;
 				continue;
 			}
+			if (arg == "-bin") {
+				flag_bin = true;
+				continue;
+			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, flag_bin);
 
 		design->sort();
 
 		log("Output filename: %s\n", filename.c_str());
+
+		if (flag_bin) {
+			RTLIL_BACKEND::dump_design_binary(*f, design, selected);
+			return;
+		}
+
 		// *f << stringf("# Generated by %s\n", yosys_version_str);
 		RTLIL_BACKEND::dump_design(*f, design, selected, true, false);
 	}
@@ -34,16 +34,31 @@ namespace RTLIL_BACKEND {
 	void dump_const(std::ostream &f, const RTLIL::Const &data, int width = -1, int offset = 0, bool autoint = true);
 	void dump_sigchunk(std::ostream &f, const RTLIL::SigChunk &chunk, bool autoint = true);
 	void dump_sigspec(std::ostream &f, const RTLIL::SigSpec &sig, bool autoint = true);
-	void dump_wire(std::ostream &f, std::string indent, const RTLIL::Wire *wire);
-	void dump_memory(std::ostream &f, std::string indent, const RTLIL::Memory *memory);
-	void dump_cell(std::ostream &f, std::string indent, const RTLIL::Cell *cell);
-	void dump_proc_case_body(std::ostream &f, std::string indent, const RTLIL::CaseRule *cs);
-	void dump_proc_switch(std::ostream &f, std::string indent, const RTLIL::SwitchRule *sw);
-	void dump_proc_sync(std::ostream &f, std::string indent, const RTLIL::SyncRule *sy);
-	void dump_proc(std::ostream &f, std::string indent, const RTLIL::Process *proc);
-	void dump_conn(std::ostream &f, std::string indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right);
-	void dump_module(std::ostream &f, std::string indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
+	void dump_wire(std::ostream &f, const std::string &indent, const RTLIL::Wire *wire);
+	void dump_memory(std::ostream &f, const std::string &indent, const RTLIL::Memory *memory);
+	void dump_cell(std::ostream &f, const std::string &indent, const RTLIL::Cell *cell);
+	void dump_proc_case_body(std::ostream &f, const std::string &indent, const RTLIL::CaseRule *cs);
+	void dump_proc_switch(std::ostream &f, const std::string &indent, const RTLIL::SwitchRule *sw);
+	void dump_proc_sync(std::ostream &f, const std::string &indent, const RTLIL::SyncRule *sy);
+	void dump_proc(std::ostream &f, const std::string &indent, const RTLIL::Process *proc);
+	void dump_conn(std::ostream &f, const std::string &indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right);
+	void dump_module(std::ostream &f, const std::string &indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
 	void dump_design(std::ostream &f, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
+	void dump_design_binary(std::ostream &f, RTLIL::Design *design, bool only_selected);
+
+	// the same, appending to a string instead of writing to a stream
+	void dump_const(std::string &f, const RTLIL::Const &data, int width = -1, int offset = 0, bool autoint = true);
+	void dump_sigchunk(std::string &f, const RTLIL::SigChunk &chunk, bool autoint = true);
+	void dump_sigspec(std::string &f, const RTLIL::SigSpec &sig, bool autoint = true);
+	void dump_wire(std::string &f, const std::string &indent, const RTLIL::Wire *wire);
+	void dump_memory(std::string &f, const std::string &indent, const RTLIL::Memory *memory);
+	void dump_cell(std::string &f, const std::string &indent, const RTLIL::Cell *cell);
+	void dump_proc_case_body(std::string &f, const std::string &indent, const RTLIL::CaseRule *cs);
+	void dump_proc_switch(std::string &f, const std::string &indent, const RTLIL::SwitchRule *sw);
+	void dump_proc_sync(std::string &f, const std::string &indent, const RTLIL::SyncRule *sy);
+	void dump_proc(std::string &f, const std::string &indent, const RTLIL::Process *proc);
+	void dump_conn(std::string &f, const std::string &indent, const RTLIL::SigSpec &left, const RTLIL::SigSpec &right);
+	void dump_module(std::string &f, const std::string &indent, RTLIL::Module *module, RTLIL::Design *design, bool only_selected, bool flag_m = true, bool flag_n = false);
 }
 
 YOSYS_NAMESPACE_END
@@ -0,0 +1,279 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Writer for the binary RTLIL checkpoint format, see
+ *  frontends/rtlil/rtlil_bin.h for the file layout.
+ *
+ */
+
+#include "rtlil_backend.h"
+#include "frontends/rtlil/rtlil_bin.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace RTLIL_BIN;
+
+namespace {
+
+struct BinWriter
+{
+	dict<RTLIL::IdString, int> string_index;
+	std::vector<RTLIL::IdString> strings;
+
+	// per module state
+	std::string buf;
+	dict<const RTLIL::Wire*, int> wire_index;
+
+	uint64_t id(RTLIL::IdString name)
+	{
+		auto it = string_index.find(name);
+		if (it != string_index.end())
+			return it->second;
+		int index = GetSize(strings);
+		string_index[name] = index;
+		strings.push_back(name);
+		return index;
+	}
+
+	void put_id(RTLIL::IdString name)
+	{
+		put_uint(buf, id(name));
+	}
+
+	void put_bits(const std::vector<RTLIL::State> &bits)
+	{
+		bool packed = true;
+		for (auto bit : bits)
+			if (bit != RTLIL::S0 && bit != RTLIL::S1) {
+				packed = false;
+				break;
+			}
+
+		int width = GetSize(bits);
+		put_uint(buf, (uint64_t(width) << 1) | (packed ? 1 : 0));
+
+		if (packed) {
+			for (int i = 0; i < width; i += 8) {
+				unsigned char byte = 0;
+				for (int j = 0; j < 8 && i+j < width; j++)
+					if (bits[i+j] == RTLIL::S1)
+						byte |= 1 << j;
+				buf.push_back(char(byte));
+			}
+		} else {
+			for (int i = 0; i < width; i += 2) {
+				unsigned char byte = (unsigned char)bits[i];
+				if (i+1 < width)
+					byte |= (unsigned char)bits[i+1] << 4;
+				buf.push_back(char(byte));
+			}
+		}
+	}
+
+	void put_const(const RTLIL::Const &value)
+	{
+		put_uint(buf, value.flags);
+		put_bits(value.bits);
+	}
+
+	void put_sigspec(const RTLIL::SigSpec &sig)
+	{
+		put_uint(buf, sig.chunks().size());
+		for (auto &chunk : sig.chunks()) {
+			if (chunk.wire == nullptr) {
+				put_uint(buf, 0);
+				put_bits(chunk.data);
+			} else {
+				put_uint(buf, wire_index.at(chunk.wire) + 1);
+				put_uint(buf, chunk.offset);
+				put_uint(buf, chunk.width);
+			}
+		}
+	}
+
+	void put_attrs(const dict<RTLIL::IdString, RTLIL::Const> &attrs)
+	{
+		put_uint(buf, attrs.size());
+		for (auto &it : attrs) {
+			put_id(it.first);
+			put_const(it.second);
+		}
+	}
+
+	void put_actions(const std::vector<RTLIL::SigSig> &actions)
+	{
+		put_uint(buf, actions.size());
+		for (auto &it : actions) {
+			put_sigspec(it.first);
+			put_sigspec(it.second);
+		}
+	}
+
+	void put_case(const RTLIL::CaseRule *cs)
+	{
+		put_attrs(cs->attributes);
+		put_uint(buf, cs->compare.size());
+		for (auto &sig : cs->compare)
+			put_sigspec(sig);
+		put_actions(cs->actions);
+		put_uint(buf, cs->switches.size());
+		for (auto sw : cs->switches) {
+			put_sigspec(sw->signal);
+			put_attrs(sw->attributes);
+			put_uint(buf, sw->cases.size());
+			for (auto child : sw->cases)
+				put_case(child);
+		}
+	}
+
+	void put_process(const RTLIL::Process *proc)
+	{
+		put_id(proc->name);
+		put_attrs(proc->attributes);
+		put_case(&proc->root_case);
+		put_uint(buf, proc->syncs.size());
+		for (auto sync : proc->syncs) {
+			put_uint(buf, sync->type);
+			put_sigspec(sync->signal);
+			put_actions(sync->actions);
+			put_uint(buf, sync->mem_write_actions.size());
+			for (auto &act : sync->mem_write_actions) {
+				put_attrs(act.attributes);
+				put_id(act.memid);
+				put_sigspec(act.address);
+				put_sigspec(act.data);
+				put_sigspec(act.enable);
+				put_const(act.priority_mask);
+			}
+		}
+	}
+
+	std::string encode_module(RTLIL::Module *module)
+	{
+		buf.clear();
+		wire_index.clear();
+
+		put_attrs(module->attributes);
+
+		put_uint(buf, module->avail_parameters.size());
+		for (auto &param : module->avail_parameters) {
+			put_id(param);
+			auto it = module->parameter_default_values.find(param);
+			put_uint(buf, it != module->parameter_default_values.end());
+			if (it != module->parameter_default_values.end())
+				put_const(it->second);
+		}
+
+		put_uint(buf, GetSize(module->wires()));
+		for (auto wire : module->wires()) {
+			int index = GetSize(wire_index);
+			wire_index[wire] = index;
+			put_id(wire->name);
+			put_uint(buf, wire->width);
+			put_int(buf, wire->start_offset);
+			put_int(buf, wire->port_id);
+			put_uint(buf, (wire->port_input ? WIRE_PORT_INPUT : 0) | (wire->port_output ? WIRE_PORT_OUTPUT : 0) |
+					(wire->upto ? WIRE_UPTO : 0) | (wire->is_signed ? WIRE_SIGNED : 0));
+			put_attrs(wire->attributes);
+		}
+
+		put_uint(buf, module->memories.size());
+		for (auto &it : module->memories) {
+			put_id(it.second->name);
+			put_uint(buf, it.second->width);
+			put_int(buf, it.second->start_offset);
+			put_uint(buf, it.second->size);
+			put_attrs(it.second->attributes);
+		}
+
+		put_uint(buf, GetSize(module->cells()));
+		for (auto cell : module->cells()) {
+			put_id(cell->name);
+			put_id(cell->type);
+			put_attrs(cell->attributes);
+			put_attrs(cell->parameters);
+			put_uint(buf, cell->connections().size());
+			for (auto &conn : cell->connections()) {
+				put_id(conn.first);
+				put_sigspec(conn.second);
+			}
+		}
+
+		put_uint(buf, module->processes.size());
+		for (auto &it : module->processes)
+			put_process(it.second);
+
+		put_actions(module->connections());
+
+		return std::move(buf);
+	}
+};
+
+}
+
+void RTLIL_BACKEND::dump_design_binary(std::ostream &f, RTLIL::Design *design, bool only_selected)
+{
+	BinWriter writer;
+	std::vector<std::pair<RTLIL::IdString, std::string>> sections;
+
+	for (auto module : design->modules()) {
+		if (only_selected && !design->selected(module))
+			continue;
+		writer.id(module->name);
+		sections.emplace_back(module->name, writer.encode_module(module));
+	}
+
+	std::string strtab;
+	uint64_t string_bytes = 0;
+	for (auto &str : writer.strings) {
+		put_u64(strtab, string_bytes);
+		string_bytes += str.size();
+	}
+	put_u64(strtab, string_bytes);
+	for (auto &str : writer.strings)
+		strtab.append(str.c_str(), str.size());
+
+	std::string header;
+	header.append(magic, sizeof(magic));
+	put_u32(header, version);
+	put_u32(header, 0);
+	put_u64(header, autoidx);
+	put_u64(header, writer.strings.size());
+	put_u64(header, sections.size());
+	log_assert(header.size() == header_size);
+
+	std::string modtab;
+	uint64_t offset = header.size() + strtab.size() + sections.size() * module_entry_size;
+	for (auto &it : sections) {
+		put_u64(modtab, writer.id(it.first));
+		put_u64(modtab, offset);
+		put_u64(modtab, it.second.size());
+		offset += it.second.size();
+	}
+
+	f.write(header.data(), header.size());
+	f.write(strtab.data(), strtab.size());
+	f.write(modtab.data(), modtab.size());
+	for (auto &it : sections)
+		f.write(it.second.data(), it.second.size());
+
+	log("Wrote %d modules and %d strings (%llu bytes).\n", GetSize(sections), GetSize(writer.strings), (unsigned long long)offset);
+}
+
+YOSYS_NAMESPACE_END
@@ -340,26 +340,32 @@ RTLIL::Wire* AigerReader::createWireIfNotExists(RTLIL::Module *module, unsigned
 {
 	const unsigned variable = literal >> 1;
 	const bool invert = literal & 1;
-	RTLIL::IdString wire_name(stringf("$aiger%d$%d%s", aiger_autoidx, variable, invert ? "b" : ""));
-	RTLIL::Wire *wire = module->wire(wire_name);
+	if (literal >= literal_wires.size())
+		literal_wires.resize((literal | 1) + 1);
+	RTLIL::Wire *wire = literal_wires[literal];
 	if (wire) return wire;
+	if (wire_prefix.empty())
+		wire_prefix = stringf("$aiger%d$", aiger_autoidx);
+	std::string variable_name = wire_prefix + std::to_string(variable);
+	RTLIL::IdString wire_name(invert ? variable_name + "b" : variable_name);
 	log_debug2("Creating %s\n", wire_name.c_str());
 	wire = module->addWire(wire_name);
 	wire->port_input = wire->port_output = false;
+	literal_wires[literal] = wire;
 	if (!invert) return wire;
-	RTLIL::IdString wire_inv_name(stringf("$aiger%d$%d", aiger_autoidx, variable));
-	RTLIL::Wire *wire_inv = module->wire(wire_inv_name);
+	RTLIL::Wire *wire_inv = literal_wires[literal ^ 1];
 	if (wire_inv) {
-		if (module->cell(wire_inv_name)) return wire;
+		if (module->cell(wire_inv->name)) return wire;
 	}
 	else {
-		log_debug2("Creating %s\n", wire_inv_name.c_str());
-		wire_inv = module->addWire(wire_inv_name);
+		log_debug2("Creating %s\n", variable_name.c_str());
+		wire_inv = module->addWire(variable_name);
 		wire_inv->port_input = wire_inv->port_output = false;
+		literal_wires[literal ^ 1] = wire_inv;
 	}
 
-	log_debug2("Creating %s = ~%s\n", wire_name.c_str(), wire_inv_name.c_str());
-	module->addNotGate(stringf("$not$aiger%d$%d", aiger_autoidx, variable), wire_inv, wire);
+	log_debug2("Creating %s = ~%s\n", wire_name.c_str(), wire_inv->name.c_str());
+	module->addNotGate("$not" + variable_name, wire_inv, wire);
 
 	return wire;
 }
@@ -638,12 +644,15 @@ void AigerReader::parse_aiger_ascii()
 	}
 }
 
-static unsigned parse_next_delta_literal(std::istream &f, unsigned ref)
+static unsigned parse_next_delta_literal(std::streambuf *buf, unsigned ref)
 {
 	unsigned x = 0, i = 0;
-	unsigned char ch;
-	while ((ch = f.get()) & 0x80)
+	int ch;
+	while ((ch = buf->sbumpc()) & 0x80) {
+		if (ch == EOF)
+			log_error("Unexpected EOF in AND section of binary AIGER file!\n");
 		x |= (ch & 0x7f) << (7 * i++);
+	}
 	return ref - (x | (ch << (7 * i)));
 }
 
@@ -652,6 +661,15 @@ void AigerReader::parse_aiger_binary()
 	unsigned l1, l2, l3;
 	std::string line;
 
+	// Every variable is one of the inputs, latches or ANDs, and most of them
+	// get a wire for the literal and a cell driving it
+	literal_wires.reserve(2 * (size_t(M) + 1));
+	module->wires_.reserve(2 * (size_t(M) + 1) + O);
+	module->cells_.reserve(size_t(L) + A);
+	inputs.reserve(I);
+	latches.reserve(L);
+	outputs.reserve(O);
+
 	// Parse inputs
 	int digits = decimal_digits(I);
 	for (unsigned i = 1; i <= I; ++i) {
@@ -747,11 +765,21 @@ void AigerReader::parse_aiger_binary()
 	for (unsigned i = 0; i < F; ++i, ++line_count)
 		std::getline(f, line); // Ignore up to start of next line
 
-	// Parse AND
+	// Parse AND, decoding the whole delta encoded section first
+	std::vector<unsigned> and_inputs(2 * size_t(A));
+	std::streambuf *buf = f.rdbuf();
+	l1 = (I+L+1) << 1;
+	for (unsigned i = 0; i < A; ++i, l1 += 2) {
+		l2 = parse_next_delta_literal(buf, l1);
+		l3 = parse_next_delta_literal(buf, l2);
+		and_inputs[2*i] = l2;
+		and_inputs[2*i+1] = l3;
+	}
+
 	l1 = (I+L+1) << 1;
 	for (unsigned i = 0; i < A; ++i, ++line_count, l1 += 2) {
-		l2 = parse_next_delta_literal(f, l1);
-		l3 = parse_next_delta_literal(f, l2);
+		l2 = and_inputs[2*i];
+		l3 = and_inputs[2*i+1];
 
 		log_debug2("%d %d %d is an AND\n", l1, l2, l3);
 		log_assert(!(l1 & 1));
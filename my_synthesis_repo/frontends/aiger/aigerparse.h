@@ -47,6 +47,10 @@ struct AigerReader
     std::vector<RTLIL::Cell*> boxes;
     std::vector<int> mergeability, initial_state;
 
+    // literal -> wire, filled by createWireIfNotExists()
+    std::vector<RTLIL::Wire*> literal_wires;
+    std::string wire_prefix;
+
     AigerReader(RTLIL::Design *design, std::istream &f, RTLIL::IdString module_name, RTLIL::IdString clk_name, std::string map_filename, bool wideports);
     void parse_aiger();
     void parse_xaiger();
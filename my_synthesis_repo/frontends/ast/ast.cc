@@ -29,6 +29,8 @@
 
 #include "kernel/yosys.h"
 #include "libs/sha1/sha1.h"
+#include "frontends/rtlil/rtlil_frontend.h"
+#include "backends/rtlil/rtlil_backend.h"
 #include "ast.h"
 
 YOSYS_NAMESPACE_BEGIN
@@ -38,7 +40,7 @@ using namespace AST_INTERNAL;
 
 // instantiate global variables (public API)
 namespace AST {
-	std::string current_filename;
+	YS_THREAD_LOCAL std::string current_filename;
 	void (*set_line_num)(int) = NULL;
 	int (*get_line_num)() = NULL;
 }
@@ -201,7 +203,7 @@ bool AstNode::get_bool_attribute(RTLIL::IdString id)
 // (the optional child arguments make it easier to create AST trees)
 AstNode::AstNode(AstNodeType type, AstNode *child1, AstNode *child2, AstNode *child3, AstNode *child4)
 {
-	static unsigned int hashidx_count = 123456789;
+	static YS_THREAD_LOCAL unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
 	hashidx_ = hashidx_count;
 
@@ -300,6 +302,8 @@ AstNode::~AstNode()
 void AstNode::dumpAst(FILE *f, std::string indent) const
 {
 	if (f == NULL) {
+		// the dump is written to the files directly, after any buffered log output
+		log_flush();
 		for (auto f : log_files)
 			dumpAst(f, indent);
 		return;
@@ -404,6 +408,8 @@ void AstNode::dumpVlog(FILE *f, std::string indent) const
 	std::vector<AstNode*> rem_children1, rem_children2;
 
 	if (f == NULL) {
+		// the dump is written to the files directly, after any buffered log output
+		log_flush();
 		for (auto f : log_files)
 			dumpVlog(f, indent);
 		return;
@@ -1071,6 +1077,7 @@ static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool d
 {
 	log_assert(current_scope.empty());
 	log_assert(ast->type == AST_MODULE || ast->type == AST_INTERFACE);
+	clear_const_function_cache();
 
 #ifdef HYBRDLINK
 	if (defer)
@@ -1729,6 +1736,127 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 	return modname;
 }
 
+// feed the complete content of an AST into a checksum for the derived module cache
+static void hash_ast(SHA1 &checksum, std::string &buf, const AstNode *node)
+{
+	if (node == nullptr) {
+		buf += "-\n";
+		return;
+	}
+
+	buf += stringf("%d %d:", int(node->type), GetSize(node->str));
+	buf += node->str;
+	buf += ' ';
+	for (auto bit : node->bits)
+		buf += char('0' + bit);
+	buf += stringf(" %d%d%d%d%d%d%d%d%d%d%d%d%d%d %d %d %d %u %.17g %u.%u-%u.%u %d:",
+			node->is_input, node->is_output, node->is_reg, node->is_logic, node->is_signed, node->is_string,
+			node->is_wand, node->is_wor, node->range_valid, node->range_swapped, node->was_checked,
+			node->is_unsized, node->is_custom_type, node->is_enum, node->port_id, node->range_left,
+			node->range_right, node->integer, node->realvalue, node->location.first_line, node->location.first_column,
+			node->location.last_line, node->location.last_column, GetSize(node->filename));
+	buf += node->filename;
+	buf += stringf(" %d %d\n", GetSize(node->attributes), GetSize(node->children));
+
+	if (buf.size() > 65536) {
+		checksum.update(buf);
+		buf.clear();
+	}
+
+	for (auto &it : node->attributes) {
+		buf += it.first.str() + "\n";
+		hash_ast(checksum, buf, it.second);
+	}
+	for (auto child : node->children)
+		hash_ast(checksum, buf, child);
+}
+
+// Path of the on-disk copy of a derived module in the directory named by
+// YOSYS_DERIVE_CACHE, or an empty string if that is not set. The file name
+// is a hash of the AST the module is generated from (which has the parameter
+// values applied) and the frontend options.
+static std::string derive_cache_filename(const AstModule *module, const AstNode *new_ast)
+{
+	const char *dir = getenv("YOSYS_DERIVE_CACHE");
+	if (dir == nullptr || dir[0] == 0)
+		return std::string();
+
+	SHA1 checksum;
+	std::string buf = stringf("%s\n%d%d%d%d%d%d%d%d%d%d%d\n", yosys_version_str,
+			module->nolatches, module->nomeminit, module->nomem2reg, module->mem2reg, module->noblackbox,
+			module->lib, module->nowb, module->noopt, module->icells, module->pwires, module->autowire);
+	hash_ast(checksum, buf, new_ast);
+	checksum.update(buf);
+	return stringf("%s/%s.ysb", dir, checksum.final().c_str());
+}
+
+// create an AstModule for new_ast from a derived module cache file, takes
+// ownership of new_ast on success
+static bool load_derived_module(RTLIL::Design *design, const AstModule *module, AstNode *new_ast, const std::string &cache_fn, bool quiet)
+{
+	std::ifstream f(cache_fn.c_str(), std::ifstream::binary);
+	if (!f.is_open())
+		return false;
+
+	if (!quiet)
+		log("Reading derived module `%s' from cache file `%s'.\n", new_ast->str.c_str(), cache_fn.c_str());
+
+	RTLIL::Design cached;
+	RTLIL_FRONTEND::read_design_binary(&f, cache_fn, &cached, pool<RTLIL::IdString>());
+	RTLIL::Module *cached_mod = cached.module(new_ast->str);
+	if (cached_mod == nullptr || GetSize(cached.modules()) != 1)
+		log_error("Derived module cache file `%s' does not contain module `%s'.\n", cache_fn.c_str(), new_ast->str.c_str());
+
+	AstModule *new_mod = new AstModule;
+	new_mod->name = cached_mod->name;
+	cached_mod->cloneInto(new_mod);
+
+	new_mod->ast = new_ast;
+	new_mod->nolatches = module->nolatches;
+	new_mod->nomeminit = module->nomeminit;
+	new_mod->nomem2reg = module->nomem2reg;
+	new_mod->mem2reg = module->mem2reg;
+	new_mod->noblackbox = module->noblackbox;
+	new_mod->lib = module->lib;
+	new_mod->nowb = module->nowb;
+	new_mod->noopt = module->noopt;
+	new_mod->icells = module->icells;
+	new_mod->pwires = module->pwires;
+	new_mod->autowire = module->autowire;
+	new_mod->fixup_ports();
+
+	design->add(new_mod);
+	return true;
+}
+
+// write a freshly derived module to the derived module cache
+static void store_derived_module(RTLIL::Module *module, const std::string &cache_fn)
+{
+	// the binary format holds neither bindings nor the results of lookups
+	// of other modules during simplification
+	if (!module->bindings_.empty() || simplify_design_lookups() != 0)
+		return;
+
+	RTLIL::Design cached;
+	module->cloneInto(cached.addModule(module->name));
+
+	// write to a temporary file first so that a concurrent run never reads
+	// a partially written cache file
+#ifdef _WIN32
+	int pid = GetCurrentProcessId();
+#else
+	int pid = getpid();
+#endif
+	std::string tmp_fn = stringf("%s.%d.tmp", cache_fn.c_str(), pid);
+	std::ofstream f(tmp_fn.c_str(), std::ofstream::binary);
+	if (f.fail())
+		return;
+	RTLIL_BACKEND::dump_design_binary(f, &cached, false);
+	f.close();
+	if (f.fail() || rename(tmp_fn.c_str(), cache_fn.c_str()) != 0)
+		remove(tmp_fn.c_str());
+}
+
 // create a new parametric module (when needed) and return the name of the generated module - without support for interfaces
 RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool /*mayfail*/)
 {
@@ -1739,7 +1867,14 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 
 	if (!design->has(modname) && new_ast) {
 		new_ast->str = modname;
-		process_module(design, new_ast, false, NULL, quiet);
+		std::string cache_fn = derive_cache_filename(this, new_ast);
+		if (!cache_fn.empty() && load_derived_module(design, this, new_ast, cache_fn, quiet)) {
+			new_ast = nullptr;
+		} else {
+			process_module(design, new_ast, false, NULL, quiet);
+			if (!cache_fn.empty())
+				store_derived_module(design->module(modname), cache_fn);
+		}
 		design->module(modname)->check();
 	} else if (!quiet) {
 		log("Found cached RTLIL representation for module `%s'.\n", modname.c_str());
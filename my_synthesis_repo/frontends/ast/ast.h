@@ -409,7 +409,7 @@ namespace AST
 	// this must be set by the language frontend before parsing the sources
 	// the AstNode constructor then uses current_filename and get_line_num()
 	// to initialize the filename and linenum properties of new nodes
-	extern std::string current_filename;
+	extern YS_THREAD_LOCAL std::string current_filename;
 	extern void (*set_line_num)(int);
 	extern int (*get_line_num)();
 
@@ -435,6 +435,10 @@ namespace AST
 	// used to provide simplify() access to the current design for looking up
 	// modules, ports, wires, etc.
 	void set_simplify_design_context(const RTLIL::Design *design);
+
+	// number of modules looked up in the design context since it was last set,
+	// i.e. whether the simplified AST depends on other modules of the design
+	int simplify_design_lookups();
 }
 
 namespace AST_INTERNAL
@@ -454,6 +458,13 @@ namespace AST_INTERNAL
 	struct LookaheadRewriter;
 	struct ProcessGenerator;
 
+	// compiled and memoized evaluation of constant function calls (see
+	// constfunc.cc), returns nullptr if the call has to be evaluated with
+	// AstNode::eval_const_function() instead
+	AST::AstNode *eval_const_function_cached(AST::AstNode *decl, AST::AstNode *fcall);
+	void remember_const_function_result(AST::AstNode *decl, AST::AstNode *fcall, AST::AstNode *result);
+	void clear_const_function_cache();
+
 	// Create and add a new AstModule from new_ast, then use it to replace
 	// old_module in design, renaming old_module to move it out of the way.
 	// Return the new module.
@@ -0,0 +1,949 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Compiled evaluation of constant functions.
+ *
+ *  The body of a function is translated once into a flat program of
+ *  register assignments and jumps over expression trees, and calls with
+ *  constant arguments run that program instead of cloning and simplifying
+ *  the function body for every statement and loop iteration. Results are
+ *  memoized by function and argument values.
+ *
+ *  The interpreter follows the width and sign rules applied by simplify()
+ *  when AstNode::eval_const_function() folds the same statements. Functions
+ *  using anything else (memories, local parameters, nested declarations,
+ *  function calls, real values, ...) and calls that run into an
+ *  out-of-range select are left to AstNode::eval_const_function(), which
+ *  also produces the error messages.
+ *
+ */
+
+#include "kernel/log.h"
+#include "ast.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace AST;
+using namespace AST_INTERNAL;
+
+namespace {
+
+struct CfValue
+{
+	RTLIL::Const val;
+	bool is_signed = false;
+	bool is_unsized = false;
+};
+
+struct CfVariable
+{
+	int width, offset;
+	bool range_swapped, is_signed, is_input;
+};
+
+// expression node: constants and register reads are the leaves, a register
+// read of a variable may have one (bit select) or two (part select) bounds
+struct CfExpr
+{
+	AstNodeType type;
+	CfValue value;
+	int reg = -1;
+	std::vector<int> args;
+};
+
+enum CfOpcode {
+	CF_ASSIGN,	// variable reg (with optional select bounds) = expr
+	CF_SET,		// temporary reg = self-determined expr
+	CF_JUMP,	// goto target
+	CF_JUMP_IF,	// if expr is true goto target
+	CF_JUMP_IFNOT,	// if expr is not true goto target
+	CF_REPEAT_INIT,	// counter reg = expr
+	CF_REPEAT	// if counter reg is zero goto target, else decrement it
+};
+
+struct CfInsn
+{
+	CfOpcode op;
+	int reg = -1, expr = -1, target = -1;
+	std::vector<int> sel;
+};
+
+struct CfProgram
+{
+	std::vector<CfVariable> vars;
+	std::vector<CfExpr> exprs;
+	std::vector<CfInsn> insns;
+	int num_regs = 0, num_counters = 0, result = -1;
+};
+
+struct CfCompiler
+{
+	CfProgram &prog;
+	dict<std::string, int> var_index;
+
+	CfCompiler(CfProgram &prog) : prog(prog) { }
+
+	int add_expr(CfExpr &&expr)
+	{
+		prog.exprs.push_back(std::move(expr));
+		return GetSize(prog.exprs) - 1;
+	}
+
+	int add_insn(CfOpcode op)
+	{
+		prog.insns.push_back(CfInsn());
+		prog.insns.back().op = op;
+		return GetSize(prog.insns) - 1;
+	}
+
+	int here() const
+	{
+		return GetSize(prog.insns);
+	}
+
+	bool compile_select(AstNode *node, std::vector<int> &sel)
+	{
+		if (node->children.empty())
+			return true;
+		if (node->children.size() != 1 || node->children[0]->type != AST_RANGE)
+			return false;
+		AstNode *range = node->children[0];
+		if (range->children.size() < 1 || range->children.size() > 2)
+			return false;
+		for (auto child : range->children) {
+			int idx = compile_expr(child);
+			if (idx < 0)
+				return false;
+			sel.push_back(idx);
+		}
+		return true;
+	}
+
+	int compile_expr(AstNode *node)
+	{
+		CfExpr expr;
+		expr.type = node->type;
+
+		switch (node->type)
+		{
+		case AST_CONSTANT:
+			if (!node->children.empty())
+				return -1;
+			expr.value.val = RTLIL::Const(node->bits);
+			expr.value.is_signed = node->is_signed;
+			expr.value.is_unsized = node->is_unsized;
+			return add_expr(std::move(expr));
+
+		case AST_IDENTIFIER:
+			if (var_index.count(node->str)) {
+				expr.reg = var_index.at(node->str);
+				if (!compile_select(node, expr.args))
+					return -1;
+				return add_expr(std::move(expr));
+			}
+			if (node->children.empty() && current_scope.count(node->str)) {
+				// module parameters become constants if their declared width
+				// and signedness match the value they were folded to
+				AstNode *id_ast = current_scope.at(node->str);
+				if (id_ast->type != AST_PARAMETER && id_ast->type != AST_LOCALPARAM && id_ast->type != AST_ENUM_ITEM)
+					return -1;
+				AstNode *value = id_ast->children.at(0);
+				if (value->type != AST_CONSTANT || value->is_unsized || value->is_signed != id_ast->is_signed)
+					return -1;
+				if (id_ast->children.size() > 1 && id_ast->children[1]->range_valid &&
+						id_ast->children[1]->range_left - id_ast->children[1]->range_right + 1 != GetSize(value->bits))
+					return -1;
+				expr.type = AST_CONSTANT;
+				expr.value.val = RTLIL::Const(value->bits);
+				expr.value.is_signed = value->is_signed;
+				return add_expr(std::move(expr));
+			}
+			return -1;
+
+		case AST_BIT_NOT:
+		case AST_NEG:
+		case AST_POS:
+		case AST_TO_SIGNED:
+		case AST_TO_UNSIGNED:
+		case AST_REDUCE_AND:
+		case AST_REDUCE_OR:
+		case AST_REDUCE_XOR:
+		case AST_REDUCE_XNOR:
+		case AST_REDUCE_BOOL:
+		case AST_LOGIC_NOT:
+			if (node->children.size() != 1)
+				return -1;
+			break;
+
+		case AST_BIT_AND:
+		case AST_BIT_OR:
+		case AST_BIT_XOR:
+		case AST_BIT_XNOR:
+		case AST_ADD:
+		case AST_SUB:
+		case AST_MUL:
+		case AST_DIV:
+		case AST_MOD:
+		case AST_LOGIC_AND:
+		case AST_LOGIC_OR:
+		case AST_SHIFT_LEFT:
+		case AST_SHIFT_RIGHT:
+		case AST_SHIFT_SLEFT:
+		case AST_SHIFT_SRIGHT:
+		case AST_POW:
+		case AST_LT:
+		case AST_LE:
+		case AST_EQ:
+		case AST_NE:
+		case AST_EQX:
+		case AST_NEX:
+		case AST_GE:
+		case AST_GT:
+		case AST_REPLICATE:
+			if (node->children.size() != 2)
+				return -1;
+			break;
+
+		case AST_TERNARY:
+			if (node->children.size() != 3)
+				return -1;
+			break;
+
+		case AST_CONCAT:
+			if (node->children.empty())
+				return -1;
+			break;
+
+		default:
+			return -1;
+		}
+
+		for (auto child : node->children) {
+			int idx = compile_expr(child);
+			if (idx < 0)
+				return -1;
+			expr.args.push_back(idx);
+		}
+		return add_expr(std::move(expr));
+	}
+
+	bool compile_stmt(AstNode *stmt)
+	{
+		switch (stmt->type)
+		{
+		case AST_ASSIGN_EQ: {
+			AstNode *lhs = stmt->children.at(0);
+			if (lhs->type != AST_IDENTIFIER || !var_index.count(lhs->str))
+				return false;
+			int insn = add_insn(CF_ASSIGN);
+			prog.insns[insn].reg = var_index.at(lhs->str);
+			std::vector<int> sel;
+			if (!compile_select(lhs, sel))
+				return false;
+			int rhs = compile_expr(stmt->children.at(1));
+			if (rhs < 0)
+				return false;
+			prog.insns[insn].sel = sel;
+			prog.insns[insn].expr = rhs;
+			return true;
+		}
+
+		case AST_BLOCK:
+			for (auto child : stmt->children)
+				if (!compile_stmt(child))
+					return false;
+			return true;
+
+		case AST_FOR:
+		case AST_WHILE: {
+			bool is_for = stmt->type == AST_FOR;
+			if (stmt->children.size() != (is_for ? 4 : 2))
+				return false;
+			if (is_for && !compile_stmt(stmt->children[0]))
+				return false;
+			int loop = here();
+			int cond = compile_expr(stmt->children[is_for ? 1 : 0]);
+			if (cond < 0)
+				return false;
+			int exit = add_insn(CF_JUMP_IFNOT);
+			prog.insns[exit].expr = cond;
+			if (!compile_stmt(stmt->children[is_for ? 3 : 1]))
+				return false;
+			if (is_for && !compile_stmt(stmt->children[2]))
+				return false;
+			prog.insns[add_insn(CF_JUMP)].target = loop;
+			prog.insns[exit].target = here();
+			return true;
+		}
+
+		case AST_REPEAT: {
+			if (stmt->children.size() != 2)
+				return false;
+			int count = compile_expr(stmt->children[0]);
+			if (count < 0)
+				return false;
+			int counter = prog.num_counters++;
+			int init = add_insn(CF_REPEAT_INIT);
+			prog.insns[init].reg = counter;
+			prog.insns[init].expr = count;
+			int loop = add_insn(CF_REPEAT);
+			prog.insns[loop].reg = counter;
+			if (!compile_stmt(stmt->children[1]))
+				return false;
+			prog.insns[add_insn(CF_JUMP)].target = loop;
+			prog.insns[loop].target = here();
+			return true;
+		}
+
+		case AST_CASE: {
+			int case_expr = compile_expr(stmt->children.at(0));
+			if (case_expr < 0)
+				return false;
+			int temp = prog.num_regs++;
+			int set = add_insn(CF_SET);
+			prog.insns[set].reg = temp;
+			prog.insns[set].expr = case_expr;
+
+			// compare against the items in order, the first match wins and
+			// the last default item is used if nothing matches
+			std::vector<std::pair<AstNode*, int>> items;
+			AstNode *default_body = nullptr;
+			for (size_t i = 1; i < stmt->children.size(); i++) {
+				AstNode *cond = stmt->children[i];
+				if (cond->type != AST_COND || cond->children.empty())
+					return false;
+				if (cond->children.front()->type == AST_DEFAULT) {
+					default_body = cond->children.back();
+					continue;
+				}
+				for (size_t j = 0; j+1 < cond->children.size(); j++) {
+					CfExpr case_value;
+					case_value.type = AST_IDENTIFIER;
+					case_value.reg = temp;
+					int item = compile_expr(cond->children[j]);
+					if (item < 0)
+						return false;
+					CfExpr match;
+					match.type = AST_EQ;
+					match.args.push_back(add_expr(std::move(case_value)));
+					match.args.push_back(item);
+					int insn = add_insn(CF_JUMP_IF);
+					prog.insns[insn].expr = add_expr(std::move(match));
+					items.push_back({cond->children.back(), insn});
+				}
+			}
+
+			std::vector<int> exits;
+			exits.push_back(add_insn(CF_JUMP));
+			if (default_body != nullptr) {
+				prog.insns[exits.back()].target = here();
+				if (!compile_stmt(default_body))
+					return false;
+				exits.push_back(add_insn(CF_JUMP));
+			}
+			dict<AstNode*, int> body_start;
+			for (auto &it : items) {
+				if (!body_start.count(it.first)) {
+					body_start[it.first] = here();
+					if (!compile_stmt(it.first))
+						return false;
+					exits.push_back(add_insn(CF_JUMP));
+				}
+				prog.insns[it.second].target = body_start.at(it.first);
+			}
+			for (int insn : exits)
+				if (prog.insns[insn].target < 0)
+					prog.insns[insn].target = here();
+			return true;
+		}
+
+		default:
+			return false;
+		}
+	}
+
+	bool compile(AstNode *decl)
+	{
+		bool found_stmt = false;
+		for (auto child : decl->children)
+		{
+			if (child->type == AST_WIRE)
+			{
+				if (found_stmt || var_index.count(child->str))
+					return false;
+
+				// determine the range the same way eval_const_function() does
+				AstNode *wire = child->clone();
+				wire->set_in_param_flag(true);
+				while (wire->simplify(true, 1, -1, false)) { }
+				bool supported = wire->type == AST_WIRE && wire->range_valid && GetSize(wire->dimensions) <= 1 &&
+						wire->unpacked_dimensions == 0 && !wire->attributes.count(ID::wiretype);
+				CfVariable var;
+				var.width = abs(wire->range_left - wire->range_right) + 1;
+				var.offset = wire->range_swapped ? wire->range_left : wire->range_right;
+				var.range_swapped = wire->range_swapped;
+				var.is_signed = wire->is_signed;
+				var.is_input = wire->is_input;
+				delete wire;
+				if (!supported)
+					return false;
+
+				var_index[child->str] = GetSize(prog.vars);
+				prog.vars.push_back(var);
+				continue;
+			}
+
+			if (!found_stmt) {
+				if (!var_index.count(decl->str))
+					return false;
+				prog.result = var_index.at(decl->str);
+				prog.num_regs = GetSize(prog.vars);
+				found_stmt = true;
+			}
+
+			if (!compile_stmt(child))
+				return false;
+		}
+		return found_stmt;
+	}
+};
+
+struct CfInterpreter
+{
+	const CfProgram &prog;
+	std::vector<CfValue> regs;
+	std::vector<int> counters;
+	bool failed = false;
+
+	CfInterpreter(const CfProgram &prog) : prog(prog) { }
+
+	// RTLIL equivalent of AstNode::bitsAsConst(width, is_signed)
+	static RTLIL::Const extend(const CfValue &v, int width, bool is_signed)
+	{
+		RTLIL::Const result = v.val;
+		if (width >= 0 && width < GetSize(result))
+			result.bits.resize(width);
+		if (width >= 0 && width > GetSize(result)) {
+			RTLIL::State extbit = RTLIL::State::S0;
+			if ((is_signed || v.is_unsized) && !result.bits.empty())
+				extbit = result.bits.back();
+			result.bits.resize(width, extbit);
+		}
+		return result;
+	}
+
+	// the value AstNode::integer would get for a constant from mkconst_bits()
+	static int as_integer(const CfValue &v)
+	{
+		uint32_t integer = 0;
+		for (int i = 0; i < 32; i++) {
+			if (i < GetSize(v.val))
+				integer |= uint32_t(v.val.bits[i] == RTLIL::State::S1) << i;
+			else if (v.is_signed && !v.val.bits.empty())
+				integer |= uint32_t(v.val.bits.back() == RTLIL::State::S1) << i;
+		}
+		return int(integer);
+	}
+
+	static bool as_bool(const CfValue &v)
+	{
+		for (auto bit : v.val.bits)
+			if (bit == RTLIL::State::S1)
+				return true;
+		return false;
+	}
+
+	bool get_range(const std::vector<int> &sel, int &left, int &right)
+	{
+		left = as_integer(eval_self(sel.at(0)));
+		right = sel.size() > 1 ? as_integer(eval_self(sel.at(1))) : left;
+		if (right > left)
+			std::swap(left, right);
+		return !failed;
+	}
+
+	CfValue leaf(const CfExpr &expr)
+	{
+		if (expr.type == AST_CONSTANT)
+			return expr.value;
+
+		const CfValue &reg = regs.at(expr.reg);
+		if (expr.args.empty())
+			return reg;
+
+		// see AstNode::replace_variables()
+		const CfVariable &var = prog.vars.at(expr.reg);
+		int left, right;
+		if (!get_range(expr.args, left, right))
+			return CfValue();
+		int offset = right - var.offset, width = min(left - right + 1, var.width);
+		if (var.range_swapped)
+			offset = -offset;
+		if (offset < 0 || offset + width > GetSize(reg.val)) {
+			failed = true;
+			return CfValue();
+		}
+
+		CfValue result;
+		result.val.bits.assign(reg.val.bits.begin() + offset, reg.val.bits.begin() + offset + width);
+		result.is_signed = var.is_signed;
+		return result;
+	}
+
+	// see AstNode::detectSignWidthWorker()
+	void detect(int idx, int &width_hint, bool &sign_hint)
+	{
+		const CfExpr &expr = prog.exprs[idx];
+		int sub_width_hint = -1;
+		bool sub_sign_hint = true;
+
+		switch (expr.type)
+		{
+		case AST_CONSTANT:
+		case AST_IDENTIFIER: {
+			CfValue v = leaf(expr);
+			width_hint = max(width_hint, GetSize(v.val));
+			if (!v.is_signed)
+				sign_hint = false;
+			break;
+		}
+
+		case AST_TO_SIGNED:
+			detect(expr.args[0], width_hint, sub_sign_hint);
+			break;
+
+		case AST_TO_UNSIGNED:
+			detect(expr.args[0], width_hint, sub_sign_hint);
+			sign_hint = false;
+			break;
+
+		case AST_CONCAT: {
+			int this_width = 0;
+			for (int arg : expr.args) {
+				sub_width_hint = 0;
+				sub_sign_hint = true;
+				detect(arg, sub_width_hint, sub_sign_hint);
+				this_width += sub_width_hint;
+			}
+			width_hint = max(width_hint, this_width);
+			sign_hint = false;
+			break;
+		}
+
+		case AST_REPLICATE: {
+			int count = eval_self(expr.args[0]).val.as_int();
+			detect(expr.args[1], sub_width_hint, sub_sign_hint);
+			width_hint = max(width_hint, count * sub_width_hint);
+			sign_hint = false;
+			break;
+		}
+
+		case AST_NEG:
+		case AST_BIT_NOT:
+		case AST_POS:
+		case AST_SHIFT_LEFT:
+		case AST_SHIFT_RIGHT:
+		case AST_SHIFT_SLEFT:
+		case AST_SHIFT_SRIGHT:
+		case AST_POW:
+			detect(expr.args[0], width_hint, sign_hint);
+			break;
+
+		case AST_BIT_AND:
+		case AST_BIT_OR:
+		case AST_BIT_XOR:
+		case AST_BIT_XNOR:
+		case AST_ADD:
+		case AST_SUB:
+		case AST_MUL:
+		case AST_DIV:
+		case AST_MOD:
+			detect(expr.args[0], width_hint, sign_hint);
+			detect(expr.args[1], width_hint, sign_hint);
+			break;
+
+		case AST_TERNARY:
+			detect(expr.args[1], width_hint, sign_hint);
+			detect(expr.args[2], width_hint, sign_hint);
+			break;
+
+		default:
+			// reductions, logic operators and comparisons
+			width_hint = max(width_hint, 1);
+			sign_hint = false;
+			break;
+		}
+	}
+
+	CfValue eval_self(int idx)
+	{
+		int width_hint = -1;
+		bool sign_hint = true;
+		detect(idx, width_hint, sign_hint);
+		if (width_hint >= (1 << 24)) {
+			failed = true;
+			return CfValue();
+		}
+		return eval(idx, width_hint, sign_hint);
+	}
+
+	// see the const folding in AstNode::simplify()
+	CfValue eval(int idx, int width_hint, bool sign_hint)
+	{
+		const CfExpr &expr = prog.exprs[idx];
+		RTLIL::Const (*const_func)(const RTLIL::Const&, const RTLIL::Const&, bool, bool, int);
+		RTLIL::Const dummy_arg;
+		CfValue result;
+
+		if (failed)
+			return result;
+
+		switch (expr.type)
+		{
+		case AST_CONSTANT:
+		case AST_IDENTIFIER:
+			return leaf(expr);
+
+		case AST_TO_SIGNED:
+		case AST_TO_UNSIGNED:
+			result.val = extend(eval_self(expr.args[0]), width_hint, sign_hint);
+			result.is_signed = expr.type == AST_TO_SIGNED;
+			break;
+
+		if (0) { case AST_POS: const_func = RTLIL::const_pos; }
+		if (0) { case AST_NEG: const_func = RTLIL::const_neg; }
+		if (0) { case AST_BIT_NOT: const_func = RTLIL::const_not; }
+			result.val = const_func(extend(eval(expr.args[0], width_hint, sign_hint), width_hint, sign_hint),
+					dummy_arg, sign_hint, false, width_hint);
+			result.is_signed = sign_hint;
+			break;
+
+		if (0) { case AST_BIT_AND:  const_func = RTLIL::const_and;  }
+		if (0) { case AST_BIT_OR:   const_func = RTLIL::const_or;   }
+		if (0) { case AST_BIT_XOR:  const_func = RTLIL::const_xor;  }
+		if (0) { case AST_BIT_XNOR: const_func = RTLIL::const_xnor; }
+		if (0) { case AST_ADD: const_func = RTLIL::const_add; }
+		if (0) { case AST_SUB: const_func = RTLIL::const_sub; }
+		if (0) { case AST_MUL: const_func = RTLIL::const_mul; }
+		if (0) { case AST_DIV: const_func = RTLIL::const_div; }
+		if (0) { case AST_MOD: const_func = RTLIL::const_mod; }
+		{
+			CfValue a = eval(expr.args[0], width_hint, sign_hint);
+			CfValue b = eval(expr.args[1], width_hint, sign_hint);
+			result.val = const_func(extend(a, width_hint, sign_hint), extend(b, width_hint, sign_hint),
+					sign_hint, sign_hint, width_hint);
+			result.is_signed = sign_hint;
+			break;
+		}
+
+		if (0) { case AST_REDUCE_AND:  const_func = RTLIL::const_reduce_and;  }
+		if (0) { case AST_REDUCE_OR:   const_func = RTLIL::const_reduce_or;   }
+		if (0) { case AST_REDUCE_XOR:  const_func = RTLIL::const_reduce_xor;  }
+		if (0) { case AST_REDUCE_XNOR: const_func = RTLIL::const_reduce_xnor; }
+		if (0) { case AST_REDUCE_BOOL: const_func = RTLIL::const_reduce_bool; }
+			result.val = const_func(eval_self(expr.args[0]).val, dummy_arg, false, false, -1);
+			break;
+
+		case AST_LOGIC_NOT: {
+			CfValue a = eval_self(expr.args[0]);
+			result.val = RTLIL::const_logic_not(a.val, dummy_arg, a.is_signed, false, -1);
+			break;
+		}
+
+		if (0) { case AST_LOGIC_AND: const_func = RTLIL::const_logic_and; }
+		if (0) { case AST_LOGIC_OR:  const_func = RTLIL::const_logic_or;  }
+		{
+			CfValue a = eval_self(expr.args[0]);
+			CfValue b = eval_self(expr.args[1]);
+			result.val = const_func(a.val, b.val, a.is_signed, b.is_signed, -1);
+			break;
+		}
+
+		if (0) { case AST_SHIFT_LEFT:   const_func = RTLIL::const_shl;  }
+		if (0) { case AST_SHIFT_RIGHT:  const_func = RTLIL::const_shr;  }
+		if (0) { case AST_SHIFT_SLEFT:  const_func = RTLIL::const_sshl; }
+		if (0) { case AST_SHIFT_SRIGHT: const_func = RTLIL::const_sshr; }
+		if (0) { case AST_POW:          const_func = RTLIL::const_pow; }
+		{
+			CfValue a = eval(expr.args[0], width_hint, sign_hint);
+			CfValue b = eval_self(expr.args[1]);
+			result.val = const_func(extend(a, width_hint, sign_hint), b.val, sign_hint,
+					expr.type == AST_POW ? b.is_signed : false, width_hint);
+			result.is_signed = sign_hint;
+			break;
+		}
+
+		if (0) { case AST_LT:  const_func = RTLIL::const_lt; }
+		if (0) { case AST_LE:  const_func = RTLIL::const_le; }
+		if (0) { case AST_EQ:  const_func = RTLIL::const_eq; }
+		if (0) { case AST_NE:  const_func = RTLIL::const_ne; }
+		if (0) { case AST_EQX: const_func = RTLIL::const_eqx; }
+		if (0) { case AST_NEX: const_func = RTLIL::const_nex; }
+		if (0) { case AST_GE:  const_func = RTLIL::const_ge; }
+		if (0) { case AST_GT:  const_func = RTLIL::const_gt; }
+		{
+			int cmp_width_hint = -1;
+			bool cmp_sign_hint = true;
+			detect(expr.args[0], cmp_width_hint, cmp_sign_hint);
+			detect(expr.args[1], cmp_width_hint, cmp_sign_hint);
+			CfValue a = eval(expr.args[0], cmp_width_hint, cmp_sign_hint);
+			CfValue b = eval(expr.args[1], cmp_width_hint, cmp_sign_hint);
+			int cmp_width = max(GetSize(a.val), GetSize(b.val));
+			bool cmp_signed = a.is_signed && b.is_signed;
+			result.val = const_func(extend(a, cmp_width, cmp_signed), extend(b, cmp_width, cmp_signed),
+					cmp_signed, cmp_signed, 1);
+			break;
+		}
+
+		case AST_TERNARY: {
+			CfValue cond = eval_self(expr.args[0]);
+			bool found_sure_true = false;
+			bool found_maybe_true = false;
+			for (auto bit : cond.val.bits) {
+				if (bit == RTLIL::State::S1)
+					found_sure_true = true;
+				if (bit > RTLIL::State::S1)
+					found_maybe_true = true;
+			}
+			if (found_sure_true || !found_maybe_true) {
+				CfValue choice = eval(expr.args[found_sure_true ? 1 : 2], width_hint, sign_hint);
+				result.val = extend(choice, width_hint, sign_hint);
+			} else {
+				RTLIL::Const a = extend(eval(expr.args[1], width_hint, sign_hint), width_hint, sign_hint);
+				RTLIL::Const b = extend(eval(expr.args[2], width_hint, sign_hint), width_hint, sign_hint);
+				for (int i = 0; i < GetSize(a); i++)
+					if (a.bits[i] != b.bits[i])
+						a.bits[i] = RTLIL::State::Sx;
+				result.val = a;
+			}
+			result.is_signed = sign_hint;
+			break;
+		}
+
+		case AST_CONCAT:
+			for (int arg : expr.args) {
+				CfValue v = eval_self(arg);
+				result.val.bits.insert(result.val.bits.end(), v.val.bits.begin(), v.val.bits.end());
+			}
+			break;
+
+		case AST_REPLICATE: {
+			int count = eval_self(expr.args[0]).val.as_int();
+			CfValue v = eval_self(expr.args[1]);
+			for (int i = 0; i < count; i++)
+				result.val.bits.insert(result.val.bits.end(), v.val.bits.begin(), v.val.bits.end());
+			break;
+		}
+
+		default:
+			log_abort();
+		}
+
+		return result;
+	}
+
+	bool assign(const CfInsn &insn)
+	{
+		const CfVariable &var = prog.vars.at(insn.reg);
+		CfValue &reg = regs.at(insn.reg);
+
+		// the assignment is evaluated in the context of its left hand side
+		int lhs_width = var.width, left = 0, right = 0;
+		if (!insn.sel.empty()) {
+			if (!get_range(insn.sel, left, right))
+				return false;
+			lhs_width = left - right + 1;
+		}
+		int width_hint = -1;
+		bool sign_hint = true;
+		detect(insn.expr, width_hint, sign_hint);
+		width_hint = max(width_hint, lhs_width);
+		if (width_hint >= (1 << 24))
+			return false;
+		CfValue rhs = eval(insn.expr, width_hint, sign_hint);
+		if (failed)
+			return false;
+
+		RTLIL::Const value = extend(rhs, var.width, rhs.is_signed);
+		if (insn.sel.empty()) {
+			reg.val = value;
+			return true;
+		}
+
+		int offset = right - var.offset;
+		int width = left - right + 1;
+		if (width > GetSize(value))
+			return false;
+		for (int i = 0; i < width; i++) {
+			int index = var.range_swapped ? -(i + offset) : i + offset;
+			if (index < 0 || index >= GetSize(reg.val))
+				return false;
+		}
+		for (int i = 0; i < width; i++) {
+			int index = var.range_swapped ? -(i + offset) : i + offset;
+			reg.val.bits[index] = value.bits[i];
+		}
+		return true;
+	}
+
+	bool run(AstNode *fcall, CfValue &result)
+	{
+		regs.resize(prog.num_regs);
+		counters.resize(prog.num_counters);
+
+		size_t argidx = 0;
+		for (int i = 0; i < GetSize(prog.vars); i++) {
+			const CfVariable &var = prog.vars[i];
+			CfValue &reg = regs[i];
+			reg.val = RTLIL::Const(RTLIL::State::Sx, var.width);
+			reg.is_signed = var.is_signed;
+			if (var.is_input && argidx < fcall->children.size()) {
+				AstNode *arg = fcall->children.at(argidx++);
+				if (arg->type == AST_CONSTANT)
+					reg.val = arg->bitsAsConst(var.width);
+				else
+					reg.val = arg->realAsConst(var.width);
+			}
+		}
+
+		int pc = 0;
+		while (pc < GetSize(prog.insns))
+		{
+			const CfInsn &insn = prog.insns[pc++];
+			switch (insn.op)
+			{
+			case CF_ASSIGN:
+				if (!assign(insn))
+					return false;
+				break;
+			case CF_SET:
+				regs.at(insn.reg) = eval_self(insn.expr);
+				break;
+			case CF_JUMP:
+				pc = insn.target;
+				break;
+			case CF_JUMP_IF:
+				if (as_bool(eval_self(insn.expr)))
+					pc = insn.target;
+				break;
+			case CF_JUMP_IFNOT:
+				if (!as_bool(eval_self(insn.expr)))
+					pc = insn.target;
+				break;
+			case CF_REPEAT_INIT:
+				counters.at(insn.reg) = eval_self(insn.expr).val.as_int();
+				break;
+			case CF_REPEAT:
+				if (counters.at(insn.reg) <= 0)
+					pc = insn.target;
+				else
+					counters.at(insn.reg)--;
+				break;
+			}
+			if (failed)
+				return false;
+		}
+
+		result = regs.at(prog.result);
+		return true;
+	}
+};
+
+struct CfFunction
+{
+	bool compiled = false;
+	std::unique_ptr<CfProgram> prog;
+	dict<std::string, CfValue> results;
+};
+
+dict<std::pair<AstNode*, unsigned int>, CfFunction> const_functions;
+
+// key for the memoized results of a call, the arguments must be constant
+bool const_function_args_key(AstNode *fcall, std::string &key)
+{
+	for (auto arg : fcall->children) {
+		if (arg->type == AST_CONSTANT) {
+			key += arg->is_signed ? 's' : 'u';
+			key += arg->is_unsized ? '*' : '=';
+			for (auto bit : arg->bits)
+				key += char('0' + bit);
+		} else if (arg->type == AST_REALVALUE) {
+			key += 'r';
+			key.append(reinterpret_cast<const char*>(&arg->realvalue), sizeof(arg->realvalue));
+		} else
+			return false;
+		key += ',';
+	}
+	return true;
+}
+
+}
+
+AstNode *AST_INTERNAL::eval_const_function_cached(AstNode *decl, AstNode *fcall)
+{
+	std::string key;
+	for (auto child : fcall->children)
+		while (child->simplify(true, 1, -1, false)) { }
+	if (!const_function_args_key(fcall, key))
+		return nullptr;
+
+	CfFunction &func = const_functions[{decl, decl->hashidx_}];
+	auto it = func.results.find(key);
+	if (it != func.results.end())
+		return AstNode::mkconst_bits(it->second.val.bits, it->second.is_signed);
+
+	if (!func.compiled) {
+		func.compiled = true;
+		func.prog.reset(new CfProgram);
+		std::map<std::string, AstNode*> backup_scope = current_scope;
+		CfCompiler compiler(*func.prog);
+		if (!compiler.compile(decl))
+			func.prog.reset();
+		current_scope = backup_scope;
+	}
+
+	if (func.prog == nullptr)
+		return nullptr;
+
+	CfInterpreter interp(*func.prog);
+	CfValue result;
+	if (!interp.run(fcall, result))
+		return nullptr;
+
+	func.results[key] = result;
+	return AstNode::mkconst_bits(result.val.bits, result.is_signed);
+}
+
+void AST_INTERNAL::remember_const_function_result(AstNode *decl, AstNode *fcall, AstNode *result)
+{
+	std::string key;
+	if (result->type != AST_CONSTANT || !const_function_args_key(fcall, key))
+		return;
+
+	CfValue &value = const_functions[{decl, decl->hashidx_}].results[key];
+	value.val = RTLIL::Const(result->bits);
+	value.is_signed = result->is_signed;
+}
+
+void AST_INTERNAL::clear_const_function_cache()
+{
+	const_functions.clear();
+}
+
+YOSYS_NAMESPACE_END
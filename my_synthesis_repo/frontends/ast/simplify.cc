@@ -600,18 +600,27 @@ static std::string prefix_id(const std::string &prefix, const std::string &str)
 	return prefix + str;
 }
 
-// direct access to this global should be limited to the following two functions
+// direct access to these globals should be limited to the following functions
 static const RTLIL::Design *simplify_design_context = nullptr;
+static int simplify_design_lookup_count = 0;
 
 void AST::set_simplify_design_context(const RTLIL::Design *design)
 {
 	log_assert(!simplify_design_context || !design);
 	simplify_design_context = design;
+	if (design)
+		simplify_design_lookup_count = 0;
+}
+
+int AST::simplify_design_lookups()
+{
+	return simplify_design_lookup_count;
 }
 
 // lookup the module with the given name in the current design context
 static const RTLIL::Module* lookup_module(const std::string &name)
 {
+	simplify_design_lookup_count++;
 	return simplify_design_context->module(name);
 }
 
@@ -3820,6 +3829,14 @@ skip_dynamic_range_lvalue_expansion:;
 		AstNode *decl = current_scope[str];
 		if (unevaluated_tern_branch && decl->is_recursive_function())
 			goto replace_fcall_later;
+
+		AstNode *orig_decl = decl;
+		if (decl->type == AST_FUNCTION && !decl->attributes.count(ID::via_celltype)) {
+			newNode = eval_const_function_cached(decl, this);
+			if (newNode)
+				goto apply_newNode;
+		}
+
 		decl = decl->clone();
 		decl->replace_result_wire_name_in_function(str, "$result"); // enables recursion
 		decl->expand_genblock(prefix);
@@ -3841,6 +3858,7 @@ skip_dynamic_range_lvalue_expansion:;
 				newNode = func_workspace->eval_const_function(this, in_param || require_const_eval);
 				delete func_workspace;
 				if (newNode) {
+					remember_const_function_result(orig_decl, this, newNode);
 					delete decl;
 					goto apply_newNode;
 				}
@@ -4363,6 +4381,55 @@ void AstNode::replace_result_wire_name_in_function(const std::string &from, cons
 }
 
 // replace a readmem[bh] TCALL ast node with a block of memory assignments
+// decode a $readmemh/$readmemb word the same way as const2ast() does for
+// "<width>'h<token>" and append it to bits, returns false for anything but
+// plain digits and for values that do not fit into the word, which are then
+// left to const2ast() for its diagnostics
+static bool readmem_word_bits(const std::string &token, int width, bool is_readmemh, std::vector<RTLIL::State> &bits)
+{
+	int bits_per_digit = is_readmemh ? 4 : 1;
+	size_t start = bits.size();
+
+	for (auto it = token.rbegin(); it != token.rend(); it++) {
+		int digit = 0;
+		RTLIL::State special = RTLIL::State::S0;
+		if ('0' <= *it && *it <= '9')
+			digit = *it - '0';
+		else if ('a' <= *it && *it <= 'f')
+			digit = 10 + *it - 'a';
+		else if ('A' <= *it && *it <= 'F')
+			digit = 10 + *it - 'A';
+		else if (*it == 'x' || *it == 'X')
+			special = RTLIL::State::Sx;
+		else if (*it == 'z' || *it == 'Z' || *it == '?')
+			special = RTLIL::State::Sz;
+		else if (*it == '_')
+			continue;
+		else
+			goto failed;
+		if (digit >= (1 << bits_per_digit))
+			goto failed;
+		for (int i = 0; i < bits_per_digit; i++)
+			bits.push_back(special != RTLIL::State::S0 ? special : (digit >> i) & 1 ? RTLIL::State::S1 : RTLIL::State::S0);
+	}
+
+	{
+		RTLIL::State msb = bits.size() == start ? RTLIL::State::S0 : bits.back();
+		bool msb_defined = msb == RTLIL::State::S0 || msb == RTLIL::State::S1;
+		int len = GetSize(bits) - int(start) - 1;
+		while (len >= 0 && bits[start + len] != RTLIL::State::S1)
+			len--;
+		if (len + (msb_defined ? 1 : 2) > width)
+			goto failed;
+		bits.resize(start + width, msb_defined ? RTLIL::State::S0 : msb);
+		return true;
+	}
+
+failed:
+	bits.resize(start);
+	return false;
+}
+
 AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *memory, int start_addr, int finish_addr, bool unconditional_init)
 {
 	int mem_width, mem_size, addr_bits;
@@ -4371,7 +4438,7 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 	AstNode *block = new AstNode(AST_BLOCK);
 
 	AstNode *meminit = nullptr;
-	int next_meminit_cursor=0;
+	int meminit_cursor=0;
 	vector<State> meminit_bits;
 	vector<State> en_bits;
 	int meminit_size=0;
@@ -4410,6 +4477,31 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 	int increment = start_addr <= finish_addr ? +1 : -1;
 	int cursor = start_addr;
 
+	// consecutive words go into a single $meminit chunk, which holds its
+	// words in ascending address order
+	auto finish_meminit = [&]() {
+		if (meminit == nullptr)
+			return;
+		int start = meminit_cursor;
+		if (increment < 0) {
+			start = meminit_cursor - meminit_size + 1;
+			for (int i = 0, j = meminit_size-1; i < j; i++, j--)
+				std::swap_ranges(meminit_bits.begin() + i*mem_width, meminit_bits.begin() + (i+1)*mem_width,
+						meminit_bits.begin() + j*mem_width);
+		}
+		meminit->children[0] = AstNode::mkconst_int(start, false);
+		// hand over the bits without copying them, init data can be huge
+		AstNode *data = AstNode::mkconst_bits(vector<State>(), false);
+		data->bits.swap(meminit_bits);
+		data->range_left = GetSize(data->bits) - 1;
+		for (int i = 0; i < 32 && i < GetSize(data->bits); i++)
+			data->integer |= (data->bits[i] == State::S1) << i;
+		meminit->children[1] = data;
+		meminit->children[3] = AstNode::mkconst_int(meminit_size, false);
+		meminit_bits.clear();
+		meminit_size = 0;
+	};
+
 	while (!f.eof())
 	{
 		std::string line, token;
@@ -4444,38 +4536,34 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 				continue;
 			}
 
-			AstNode *value = VERILOG_FRONTEND::const2ast(stringf("%d'%c", mem_width, is_readmemh ? 'h' : 'b') + token);
-
 			if (unconditional_init)
 			{
-				if (meminit == nullptr || cursor != next_meminit_cursor)
+				if (meminit == nullptr || cursor != meminit_cursor + increment*meminit_size)
 				{
-					if (meminit != nullptr) {
-						meminit->children[1] = AstNode::mkconst_bits(meminit_bits, false);
-						meminit->children[3] = AstNode::mkconst_int(meminit_size, false);
-					}
+					finish_meminit();
 
 					meminit = new AstNode(AST_MEMINIT);
-					meminit->children.push_back(AstNode::mkconst_int(cursor, false));
+					meminit->children.push_back(nullptr);
 					meminit->children.push_back(nullptr);
 					meminit->children.push_back(AstNode::mkconst_bits(en_bits, false));
 					meminit->children.push_back(nullptr);
 					meminit->str = memory->str;
 					meminit->id2ast = memory;
-					meminit_bits.clear();
-					meminit_size = 0;
 
 					current_ast_mod->children.push_back(meminit);
-					next_meminit_cursor = cursor;
+					meminit_cursor = cursor;
 				}
 
 				meminit_size++;
-				next_meminit_cursor++;
-				meminit_bits.insert(meminit_bits.end(), value->bits.begin(), value->bits.end());
-				delete value;
+				if (!readmem_word_bits(token, mem_width, is_readmemh, meminit_bits)) {
+					AstNode *value = VERILOG_FRONTEND::const2ast(stringf("%d'%c", mem_width, is_readmemh ? 'h' : 'b') + token);
+					meminit_bits.insert(meminit_bits.end(), value->bits.begin(), value->bits.end());
+					delete value;
+				}
 			}
 			else
 			{
+				AstNode *value = VERILOG_FRONTEND::const2ast(stringf("%d'%c", mem_width, is_readmemh ? 'h' : 'b') + token);
 				block->children.push_back(new AstNode(AST_ASSIGN_EQ, new AstNode(AST_IDENTIFIER, new AstNode(AST_RANGE, AstNode::mkconst_int(cursor, false))), value));
 				block->children.back()->children[0]->str = memory->str;
 				block->children.back()->children[0]->id2ast = memory;
@@ -4491,10 +4579,7 @@ AstNode *AstNode::readmem(bool is_readmemh, std::string mem_filename, AstNode *m
 			break;
 	}
 
-	if (meminit != nullptr) {
-		meminit->children[1] = AstNode::mkconst_bits(meminit_bits, false);
-		meminit->children[3] = AstNode::mkconst_int(meminit_size, false);
-	}
+	finish_meminit();
 
 	return block;
 }
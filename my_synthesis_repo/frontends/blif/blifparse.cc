@@ -23,9 +23,37 @@ YOSYS_NAMESPACE_BEGIN
 
 const int lut_input_plane_limit = 12;
 
-static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, std::istream &f)
+// Line source for the parser: a memory range (usually a mapped file), or a
+// stream that is read with std::getline().
+struct BlifLineSource
 {
+	std::istream *f = nullptr;
+	const char *ptr = nullptr, *end = nullptr;
 	string strbuf;
+
+	bool getline(const char *&line, size_t &len)
+	{
+		if (f != nullptr) {
+			if (!std::getline(*f, strbuf))
+				return false;
+			line = strbuf.data();
+			len = strbuf.size();
+			return true;
+		}
+
+		if (ptr == end)
+			return false;
+
+		const char *eol = (const char*)memchr(ptr, '\n', end - ptr);
+		line = ptr;
+		len = (eol != nullptr ? eol : end) - ptr;
+		ptr = eol != nullptr ? eol + 1 : end;
+		return true;
+	}
+};
+
+static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, BlifLineSource &f)
+{
 	int buffer_len = 0;
 	buffer[0] = 0;
 
@@ -45,13 +73,16 @@ static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count,
 			if (buffer_len > 0 && buffer[buffer_len-1] == '\\')
 				buffer[--buffer_len] = 0;
 			line_count++;
-			if (!std::getline(f, strbuf))
+			const char *line;
+			size_t line_len;
+			if (!f.getline(line, line_len))
 				return false;
-			while (buffer_size-buffer_len < strbuf.size()+1) {
+			while (buffer_size-buffer_len < line_len+1) {
 				buffer_size *= 2;
 				buffer = (char*)realloc(buffer, buffer_size);
 			}
-			strcpy(buffer+buffer_len, strbuf.c_str());
+			memcpy(buffer+buffer_len, line, line_len);
+			buffer[buffer_len+line_len] = 0;
 		} else
 			return true;
 	}
@@ -84,7 +115,7 @@ failed:
 	return std::pair<RTLIL::IdString, int>(RTLIL::IdString(), 0);
 }
 
-void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
+static void parse_blif_lines(RTLIL::Design *design, BlifLineSource &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
 {
 	RTLIL::Module *module = nullptr;
 	RTLIL::Const *lutptr = NULL;
@@ -94,8 +125,16 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 	std::string err_reason;
 	int blif_maxnum = 0, sopmode = -1;
 
+	// BLIF net names of the current module, looked up before escaping the
+	// name and searching the module
+	dict<std::string, Wire*> wire_cache;
+
 	auto blif_wire = [&](const std::string &wire_name) -> Wire*
 	{
+		auto cached = wire_cache.find(wire_name);
+		if (cached != wire_cache.end())
+			return cached->second;
+
 		if (wire_name[0] == '$')
 		{
 			for (int i = 0; i+1 < GetSize(wire_name); i++)
@@ -121,6 +160,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 		if (wire == nullptr)
 			wire = module->addWire(wire_id);
 
+		wire_cache[wire_name] = wire;
 		return wire;
 	};
 
@@ -172,6 +212,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 				if (name == nullptr)
 					goto error;
 				module->name = RTLIL::escape_id(name);
+				wire_cache.clear();
 				obj_attributes = &module->attributes;
 				obj_parameters = nullptr;
 				if (design->module(module->name))
@@ -250,6 +291,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 				}
 
 				module = nullptr;
+				wire_cache.clear();
 				lastcell = nullptr;
 				obj_attributes = nullptr;
 				obj_parameters = nullptr;
@@ -596,17 +638,28 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			if (input_len > lut_input_plane_limit)
 				goto error;
 
-			for (int i = 0; i < (1 << input_len); i++) {
-				for (int j = 0; j < input_len; j++) {
-					char c1 = input[j];
-					if (c1 != '-') {
-						char c2 = (i & (1 << j)) != 0 ? '1' : '0';
-						if (c1 != c2)
-							goto try_next_value;
-					}
-				}
-				lutptr->bits.at(i) = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
-			try_next_value:;
+			// only visit the table entries matched by the cube: the fixed
+			// bits are in care_value, the don't care bits are enumerated
+			int care_mask = 0, care_value = 0;
+			bool matches_any = true;
+			for (int j = 0; j < input_len; j++) {
+				if (input[j] == '0') {
+					care_mask |= 1 << j;
+				} else if (input[j] == '1') {
+					care_mask |= 1 << j;
+					care_value |= 1 << j;
+				} else if (input[j] != '-')
+					matches_any = false;
+			}
+
+			if (matches_any) {
+				RTLIL::State value = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
+				int dc_mask = ~care_mask & ((1 << input_len) - 1);
+				int i = 0;
+				do {
+					lutptr->bits.at(care_value | i) = value;
+					i = (i - dc_mask) & dc_mask;
+				} while (i != 0);
 			}
 
 			lut_default_state = !strcmp(output, "0") ? RTLIL::State::S1 : RTLIL::State::S0;
@@ -621,6 +674,21 @@ error_with_reason:
 	log_error("Syntax error in line %d: %s\n", line_count, err_reason.c_str());
 }
 
+void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
+{
+	BlifLineSource source;
+	source.f = &f;
+	parse_blif_lines(design, source, dff_name, run_clean, sop_mode, wideports);
+}
+
+void parse_blif(RTLIL::Design *design, const char *data, size_t size, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
+{
+	BlifLineSource source;
+	source.ptr = data;
+	source.end = data + size;
+	parse_blif_lines(design, source, dff_name, run_clean, sop_mode, wideports);
+}
+
 struct BlifFrontend : public Frontend {
 	BlifFrontend() : Frontend("blif", "read BLIF file") { }
 	void help() override
@@ -661,7 +729,14 @@ struct BlifFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		parse_blif(design, *f, "", true, sop_mode, wideports);
+		// plain files are parsed from a memory mapping of the file, gzip files from the decompressed buffer
+		MappedFile mapped;
+		if (dynamic_cast<std::ifstream*>(f) != nullptr && mapped.map(filename))
+			parse_blif(design, mapped.data, mapped.size, "", true, sop_mode, wideports);
+		else if (auto mem = dynamic_cast<MemoryIStream*>(f))
+			parse_blif(design, mem->text().data(), mem->text().size(), "", true, sop_mode, wideports);
+		else
+			parse_blif(design, *f, "", true, sop_mode, wideports);
 	}
 } BlifFrontend;
 
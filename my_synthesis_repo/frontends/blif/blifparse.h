@@ -27,6 +27,10 @@ YOSYS_NAMESPACE_BEGIN
 extern void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name,
 		bool run_clean = false, bool sop_mode = false, bool wideports = false);
 
+// Same as above for BLIF text in memory, e.g. a mapped file
+extern void parse_blif(RTLIL::Design *design, const char *data, size_t size, IdString dff_name,
+		bool run_clean = false, bool sop_mode = false, bool wideports = false);
+
 YOSYS_NAMESPACE_END
 
 #endif
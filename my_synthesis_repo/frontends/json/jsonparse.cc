@@ -18,9 +18,167 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 
 YOSYS_NAMESPACE_BEGIN
 
+// Character source for the JSON parser. Either a memory range (a mapped file
+// or a buffered stream) or a stream that is read in blocks, so that the input
+// never has to be held in memory as a whole.
+struct JsonReader
+{
+	const char *begin = nullptr, *ptr = nullptr, *end = nullptr;
+	std::istream *f = nullptr;
+	std::vector<char> block;
+
+	JsonReader(const char *data, size_t size) : begin(data), ptr(data), end(data + size) { }
+	JsonReader(std::istream &f) : f(&f), block(1 << 16) { }
+
+	int get()
+	{
+		if (ptr == end && !refill())
+			return EOF;
+		return (unsigned char)*ptr++;
+	}
+
+	void unget()
+	{
+		ptr--;
+	}
+
+	bool refill()
+	{
+		if (f == nullptr)
+			return false;
+		f->read(block.data(), block.size());
+		size_t n = f->gcount();
+		if (n == 0)
+			return false;
+		begin = ptr = block.data();
+		end = ptr + n;
+		return true;
+	}
+
+	// position in the memory range, only meaningful without a stream
+	size_t offset() const
+	{
+		return ptr - begin;
+	}
+
+	// returns the next character that is neither whitespace nor one of the separators
+	int next(const char *separators = "")
+	{
+		while (1) {
+			int ch = get();
+			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+				continue;
+			if (ch > 0 && strchr(separators, ch) != nullptr)
+				continue;
+			return ch;
+		}
+	}
+
+	// reads the rest of a string after the opening quote
+	void read_string(string &data_string)
+	{
+		while (1)
+		{
+			int ch = get();
+
+			if (ch == EOF)
+				log_error("Unexpected EOF in JSON string.\n");
+
+			if (ch == '"')
+				break;
+
+			if (ch == '\\') {
+				ch = get();
+
+				switch (ch) {
+					case EOF: log_error("Unexpected EOF in JSON string.\n"); break;
+					case '"':
+					case '/':
+					case '\\':           break;
+					case 'b': ch = '\b'; break;
+					case 'f': ch = '\f'; break;
+					case 'n': ch = '\n'; break;
+					case 'r': ch = '\r'; break;
+					case 't': ch = '\t'; break;
+					case 'u':
+						int val = 0;
+						for (int i = 0; i < 4; i++) {
+							ch = get();
+							val <<= 4;
+							if (ch >= '0' && '9' >= ch) {
+								val += ch - '0';
+							} else if (ch >= 'A' && 'F' >= ch) {
+								val += 10 + ch - 'A';
+							} else if (ch >= 'a' && 'f' >= ch) {
+								val += 10 + ch - 'a';
+							} else
+								log_error("Unexpected non-digit character in \\uXXXX sequence: %c.\n", ch);
+						}
+						if (val < 128)
+							ch = val;
+						else
+							log_error("Unsupported \\uXXXX sequence in JSON string: %04X.\n", val);
+						break;
+				}
+			}
+
+			data_string += ch;
+		}
+	}
+
+	// expects the start of a dict, see next_key()
+	void begin_dict(const char *what)
+	{
+		int ch = next();
+		if (ch == EOF)
+			log_error("Unexpected EOF in JSON file.\n");
+		if (ch != '{')
+			log_error("JSON %s is not a dictionary.\n", what);
+	}
+
+	// reads the next key of the current dict and leaves the reader at its
+	// value, returns false at the end of the dict
+	bool next_key(string &key)
+	{
+		int ch = next(",");
+		if (ch == EOF)
+			log_error("Unexpected EOF in JSON file.\n");
+		if (ch == '}')
+			return false;
+		if (ch != '"')
+			log_error("Unexpected non-string key in JSON dict.\n");
+
+		key.clear();
+		read_string(key);
+
+		ch = next(":");
+		if (ch == EOF)
+			log_error("Unexpected EOF in JSON file.\n");
+		unget();
+		return true;
+	}
+
+	void skip_string()
+	{
+		while (1) {
+			int ch = get();
+			if (ch == EOF)
+				log_error("Unexpected EOF in JSON string.\n");
+			if (ch == '"')
+				break;
+			if (ch == '\\')
+				get();
+		}
+	}
+
+	// skips over the next value without building it
+	void skip_value();
+};
+
 struct JsonNode
 {
 	char type; // S=String, N=Number, A=Array, D=Dict
@@ -30,7 +188,7 @@ struct JsonNode
 	dict<string, JsonNode*> data_dict;
 	vector<string> data_dict_keys;
 
-	JsonNode(std::istream &f)
+	JsonNode(JsonReader &f)
 	{
 		type = 0;
 		data_number = 0;
@@ -48,55 +206,7 @@ struct JsonNode
 			if (ch == '"')
 			{
 				type = 'S';
-
-				while (1)
-				{
-					ch = f.get();
-
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON string.\n");
-
-					if (ch == '"')
-						break;
-
-					if (ch == '\\') {
-						ch = f.get();
-
-						switch (ch) {
-							case EOF: log_error("Unexpected EOF in JSON string.\n"); break;
-							case '"':
-							case '/':
-							case '\\':           break;
-							case 'b': ch = '\b'; break;
-							case 'f': ch = '\f'; break;
-							case 'n': ch = '\n'; break;
-							case 'r': ch = '\r'; break;
-							case 't': ch = '\t'; break;
-							case 'u':
-								int val = 0;
-								for (int i = 0; i < 4; i++) {
-									ch = f.get();
-									val <<= 4;
-									if (ch >= '0' && '9' >= ch) {
-										val += ch - '0';
-									} else if (ch >= 'A' && 'F' >= ch) {
-										val += 10 + ch - 'A';
-									} else if (ch >= 'a' && 'f' >= ch) {
-										val += 10 + ch - 'a';
-									} else
-										log_error("Unexpected non-digit character in \\uXXXX sequence: %c.\n", ch);
-								}
-								if (val < 128)
-									ch = val;
-								else
-									log_error("Unsupported \\uXXXX sequence in JSON string: %04X.\n", val);
-								break;
-						}
-					}
-
-					data_string += ch;
-				}
-
+				f.read_string(data_string);
 				break;
 			}
 
@@ -287,336 +397,490 @@ void json_parse_attr_param(dict<IdString, Const> &results, JsonNode *node)
 	}
 }
 
-void json_import(Design *design, string &modname, JsonNode *node)
+
+void JsonReader::skip_value()
 {
-	log("Importing module %s from JSON tree.\n", modname.c_str());
+	int ch = next();
 
-	Module *module = new RTLIL::Module;
-	module->name = RTLIL::escape_id(modname.c_str());
+	if (ch == EOF)
+		log_error("Unexpected EOF in JSON file.\n");
 
-	if (design->module(module->name))
-		log_error("Re-definition of module %s.\n", log_id(module->name));
+	if (ch == '"') {
+		skip_string();
+		return;
+	}
 
-	design->add(module);
+	if (ch != '[' && ch != '{') {
+		unget();
+		JsonNode node(*this);
+		return;
+	}
 
-	if (node->data_dict.count("attributes"))
-		json_parse_attr_param(module->attributes, node->data_dict.at("attributes"));
+	int depth = 1;
+	while (depth > 0) {
+		ch = get();
+		if (ch == EOF)
+			log_error("Unexpected EOF in JSON file.\n");
+		if (ch == '"')
+			skip_string();
+		else if (ch == '[' || ch == '{')
+			depth++;
+		else if (ch == ']' || ch == '}')
+			depth--;
+	}
+}
 
-	dict<int, SigBit> signal_bits;
+// Bits of a port, netname or cell connection as they appear in the file:
+// signal bit numbers, or json_const_bit + State for constant bits.
+typedef std::vector<int> json_bits_t;
+static const int json_const_bit = INT_MIN;
 
-	if (node->data_dict.count("ports"))
+static std::string json_bits_context(const char *kind, IdString name, IdString conn_name)
+{
+	if (conn_name.empty())
+		return stringf("%s '%s'", kind, log_id(name));
+	return stringf("%s '%s' connection '%s'", kind, log_id(name), log_id(conn_name));
+}
+
+static void json_parse_bits(json_bits_t &bits, JsonNode *node, const char *kind, IdString name, IdString conn_name = IdString())
+{
+	bits.reserve(GetSize(node->data_array));
+
+	for (int i = 0; i < GetSize(node->data_array); i++)
 	{
-		JsonNode *ports_node = node->data_dict.at("ports");
+		JsonNode *bitval_node = node->data_array.at(i);
+
+		if (bitval_node->type == 'S') {
+			if (bitval_node->data_string == "0")
+				bits.push_back(json_const_bit + State::S0);
+			else if (bitval_node->data_string == "1")
+				bits.push_back(json_const_bit + State::S1);
+			else if (bitval_node->data_string == "x")
+				bits.push_back(json_const_bit + State::Sx);
+			else if (bitval_node->data_string == "z")
+				bits.push_back(json_const_bit + State::Sz);
+			else
+				log_error("JSON %s has invalid '%s' bit string value on bit %d.\n",
+						json_bits_context(kind, name, conn_name).c_str(), bitval_node->data_string.c_str(), i);
+		} else
+		if (bitval_node->type == 'N') {
+			bits.push_back(bitval_node->data_number);
+		} else
+			log_error("JSON %s has invalid bit value on bit %d.\n", json_bits_context(kind, name, conn_name).c_str(), i);
+	}
+}
 
-		if (ports_node->type != 'D')
-			log_error("JSON ports node is not a dictionary.\n");
+static bool json_is_const_bit(int bit)
+{
+	return bit < json_const_bit + 4;
+}
 
-		for (int port_id = 1; port_id <= GetSize(ports_node->data_dict_keys); port_id++)
-		{
-			IdString port_name = RTLIL::escape_id(ports_node->data_dict_keys[port_id-1].c_str());
-			JsonNode *port_node = ports_node->data_dict.at(ports_node->data_dict_keys[port_id-1]);
+// A port or netname entry. The entries of a module are collected while its
+// dict is scanned and turned into wires and cells once the module is
+// complete, because the bit numbers of a cell connection refer to netnames
+// that may come later in the file.
+struct JsonWireRecord
+{
+	IdString name;
+	json_bits_t bits;
+	bool port_input = false, port_output = false;
+	int upto = -1, is_signed = -1;
+	bool has_offset = false;
+	int start_offset = 0;
+	dict<IdString, Const> attributes;
+};
 
-			if (port_node->type != 'D')
-				log_error("JSON port node '%s' is not a dictionary.\n", log_id(port_name));
+struct JsonCellRecord
+{
+	IdString name, type;
+	std::vector<std::pair<IdString, json_bits_t>> connections;
+	dict<IdString, Const> attributes, parameters;
+};
 
-			if (port_node->data_dict.count("direction") == 0)
-				log_error("JSON port node '%s' has no direction attribute.\n", log_id(port_name));
+static void json_parse_port(JsonWireRecord &rec, const string &name, JsonNode *port_node)
+{
+	IdString port_name = RTLIL::escape_id(name.c_str());
+	rec.name = port_name;
 
-			if (port_node->data_dict.count("bits") == 0)
-				log_error("JSON port node '%s' has no bits attribute.\n", log_id(port_name));
+	if (port_node->type != 'D')
+		log_error("JSON port node '%s' is not a dictionary.\n", log_id(port_name));
 
-			JsonNode *port_direction_node = port_node->data_dict.at("direction");
-			JsonNode *port_bits_node = port_node->data_dict.at("bits");
+	if (port_node->data_dict.count("direction") == 0)
+		log_error("JSON port node '%s' has no direction attribute.\n", log_id(port_name));
 
-			if (port_direction_node->type != 'S')
-				log_error("JSON port node '%s' has non-string direction attribute.\n", log_id(port_name));
+	if (port_node->data_dict.count("bits") == 0)
+		log_error("JSON port node '%s' has no bits attribute.\n", log_id(port_name));
 
-			if (port_bits_node->type != 'A')
-				log_error("JSON port node '%s' has non-array bits attribute.\n", log_id(port_name));
+	JsonNode *port_direction_node = port_node->data_dict.at("direction");
+	JsonNode *port_bits_node = port_node->data_dict.at("bits");
 
-			Wire *port_wire = module->wire(port_name);
+	if (port_direction_node->type != 'S')
+		log_error("JSON port node '%s' has non-string direction attribute.\n", log_id(port_name));
 
-			if (port_wire == nullptr)
-				port_wire = module->addWire(port_name, GetSize(port_bits_node->data_array));
+	if (port_bits_node->type != 'A')
+		log_error("JSON port node '%s' has non-array bits attribute.\n", log_id(port_name));
 
-			if (port_node->data_dict.count("upto") != 0) {
-				JsonNode *val = port_node->data_dict.at("upto");
-				if (val->type == 'N')
-					port_wire->upto = val->data_number != 0;
-			}
+	if (port_node->data_dict.count("upto") != 0) {
+		JsonNode *val = port_node->data_dict.at("upto");
+		if (val->type == 'N')
+			rec.upto = val->data_number != 0;
+	}
 
-			if (port_node->data_dict.count("signed") != 0) {
-				JsonNode *val = port_node->data_dict.at("signed");
-				if (val->type == 'N')
-					port_wire->is_signed = val->data_number != 0;
-			}
+	if (port_node->data_dict.count("signed") != 0) {
+		JsonNode *val = port_node->data_dict.at("signed");
+		if (val->type == 'N')
+			rec.is_signed = val->data_number != 0;
+	}
 
-			if (port_node->data_dict.count("offset") != 0) {
-				JsonNode *val = port_node->data_dict.at("offset");
-				if (val->type == 'N')
-					port_wire->start_offset = val->data_number;
-			}
+	if (port_node->data_dict.count("offset") != 0) {
+		JsonNode *val = port_node->data_dict.at("offset");
+		if (val->type == 'N') {
+			rec.has_offset = true;
+			rec.start_offset = val->data_number;
+		}
+	}
 
-			if (port_direction_node->data_string == "input") {
-				port_wire->port_input = true;
-			} else
-			if (port_direction_node->data_string == "output") {
-				port_wire->port_output = true;
-			} else
-			if (port_direction_node->data_string == "inout") {
-				port_wire->port_input = true;
-				port_wire->port_output = true;
-			} else
-				log_error("JSON port node '%s' has invalid '%s' direction attribute.\n", log_id(port_name), port_direction_node->data_string.c_str());
+	if (port_direction_node->data_string == "input") {
+		rec.port_input = true;
+	} else
+	if (port_direction_node->data_string == "output") {
+		rec.port_output = true;
+	} else
+	if (port_direction_node->data_string == "inout") {
+		rec.port_input = true;
+		rec.port_output = true;
+	} else
+		log_error("JSON port node '%s' has invalid '%s' direction attribute.\n", log_id(port_name), port_direction_node->data_string.c_str());
 
-			port_wire->port_id = port_id;
+	json_parse_bits(rec.bits, port_bits_node, "port node", port_name);
+}
 
-			for (int i = 0; i < GetSize(port_bits_node->data_array); i++)
-			{
-				JsonNode *bitval_node = port_bits_node->data_array.at(i);
-				SigBit sigbit(port_wire, i);
-
-				if (bitval_node->type == 'S') {
-					if (bitval_node->data_string == "0")
-						module->connect(sigbit, State::S0);
-					else if (bitval_node->data_string == "1")
-						module->connect(sigbit, State::S1);
-					else if (bitval_node->data_string == "x")
-						module->connect(sigbit, State::Sx);
-					else if (bitval_node->data_string == "z")
-						module->connect(sigbit, State::Sz);
-					else
-						log_error("JSON port node '%s' has invalid '%s' bit string value on bit %d.\n",
-								log_id(port_name), bitval_node->data_string.c_str(), i);
-				} else
-				if (bitval_node->type == 'N') {
-					int bitidx = bitval_node->data_number;
-					if (signal_bits.count(bitidx)) {
-						if (port_wire->port_output) {
-							module->connect(sigbit, signal_bits.at(bitidx));
-						} else {
-							module->connect(signal_bits.at(bitidx), sigbit);
-							signal_bits[bitidx] = sigbit;
-						}
-					} else {
-						signal_bits[bitidx] = sigbit;
-					}
-				} else
-					log_error("JSON port node '%s' has invalid bit value on bit %d.\n", log_id(port_name), i);
-			}
-		}
+static void json_parse_netname(JsonWireRecord &rec, const string &name, JsonNode *net_node)
+{
+	IdString net_name = RTLIL::escape_id(name.c_str());
+	rec.name = net_name;
 
-		module->fixup_ports();
-	}
+	if (net_node->type != 'D')
+		log_error("JSON netname node '%s' is not a dictionary.\n", log_id(net_name));
 
-	if (node->data_dict.count("netnames"))
-	{
-		JsonNode *netnames_node = node->data_dict.at("netnames");
+	if (net_node->data_dict.count("bits") == 0)
+		log_error("JSON netname node '%s' has no bits attribute.\n", log_id(net_name));
 
-		if (netnames_node->type != 'D')
-			log_error("JSON netnames node is not a dictionary.\n");
+	JsonNode *bits_node = net_node->data_dict.at("bits");
 
-		for (auto &net : netnames_node->data_dict)
-		{
-			IdString net_name = RTLIL::escape_id(net.first.c_str());
-			JsonNode *net_node = net.second;
+	if (bits_node->type != 'A')
+		log_error("JSON netname node '%s' has non-array bits attribute.\n", log_id(net_name));
+
+	if (net_node->data_dict.count("upto") != 0) {
+		JsonNode *val = net_node->data_dict.at("upto");
+		if (val->type == 'N')
+			rec.upto = val->data_number != 0;
+	}
+
+	if (net_node->data_dict.count("offset") != 0) {
+		JsonNode *val = net_node->data_dict.at("offset");
+		if (val->type == 'N') {
+			rec.has_offset = true;
+			rec.start_offset = val->data_number;
+		}
+	}
 
-			if (net_node->type != 'D')
-				log_error("JSON netname node '%s' is not a dictionary.\n", log_id(net_name));
+	json_parse_bits(rec.bits, bits_node, "netname node", net_name);
 
-			if (net_node->data_dict.count("bits") == 0)
-				log_error("JSON netname node '%s' has no bits attribute.\n", log_id(net_name));
+	if (net_node->data_dict.count("attributes"))
+		json_parse_attr_param(rec.attributes, net_node->data_dict.at("attributes"));
+}
 
-			JsonNode *bits_node = net_node->data_dict.at("bits");
+static void json_parse_cell(JsonCellRecord &rec, const string &name, JsonNode *cell_node)
+{
+	IdString cell_name = RTLIL::escape_id(name.c_str());
+	rec.name = cell_name;
 
-			if (bits_node->type != 'A')
-				log_error("JSON netname node '%s' has non-array bits attribute.\n", log_id(net_name));
+	if (cell_node->type != 'D')
+		log_error("JSON cells node '%s' is not a dictionary.\n", log_id(cell_name));
 
-			Wire *wire = module->wire(net_name);
+	if (cell_node->data_dict.count("type") == 0)
+		log_error("JSON cells node '%s' has no type attribute.\n", log_id(cell_name));
 
-			if (wire == nullptr)
-				wire = module->addWire(net_name, GetSize(bits_node->data_array));
+	JsonNode *type_node = cell_node->data_dict.at("type");
 
-			if (net_node->data_dict.count("upto") != 0) {
-				JsonNode *val = net_node->data_dict.at("upto");
-				if (val->type == 'N')
-					wire->upto = val->data_number != 0;
-			}
+	if (type_node->type != 'S')
+		log_error("JSON cells node '%s' has a non-string type.\n", log_id(cell_name));
 
-			if (net_node->data_dict.count("offset") != 0) {
-				JsonNode *val = net_node->data_dict.at("offset");
-				if (val->type == 'N')
-					wire->start_offset = val->data_number;
-			}
+	rec.type = RTLIL::escape_id(type_node->data_string.c_str());
 
-			for (int i = 0; i < GetSize(bits_node->data_array); i++)
-			{
-				JsonNode *bitval_node = bits_node->data_array.at(i);
-				SigBit sigbit(wire, i);
-
-				if (bitval_node->type == 'S') {
-					if (bitval_node->data_string == "0")
-						module->connect(sigbit, State::S0);
-					else if (bitval_node->data_string == "1")
-						module->connect(sigbit, State::S1);
-					else if (bitval_node->data_string == "x")
-						module->connect(sigbit, State::Sx);
-					else if (bitval_node->data_string == "z")
-						module->connect(sigbit, State::Sz);
-					else
-						log_error("JSON netname node '%s' has invalid '%s' bit string value on bit %d.\n",
-								log_id(net_name), bitval_node->data_string.c_str(), i);
-				} else
-				if (bitval_node->type == 'N') {
-					int bitidx = bitval_node->data_number;
-					if (signal_bits.count(bitidx)) {
-						if (sigbit != signal_bits.at(bitidx))
-							module->connect(sigbit, signal_bits.at(bitidx));
-					} else {
-						signal_bits[bitidx] = sigbit;
-					}
-				} else
-					log_error("JSON netname node '%s' has invalid bit value on bit %d.\n", log_id(net_name), i);
-			}
+	if (cell_node->data_dict.count("connections") == 0)
+		log_error("JSON cells node '%s' has no connections attribute.\n", log_id(cell_name));
 
-			if (net_node->data_dict.count("attributes"))
-				json_parse_attr_param(wire->attributes, net_node->data_dict.at("attributes"));
-		}
-	}
+	JsonNode *connections_node = cell_node->data_dict.at("connections");
+
+	if (connections_node->type != 'D')
+		log_error("JSON cells node '%s' has non-dictionary connections attribute.\n", log_id(cell_name));
 
-	if (node->data_dict.count("cells"))
+	for (auto &conn_it : connections_node->data_dict)
 	{
-		JsonNode *cells_node = node->data_dict.at("cells");
+		IdString conn_name = RTLIL::escape_id(conn_it.first.c_str());
+		JsonNode *conn_node = conn_it.second;
 
-		if (cells_node->type != 'D')
-			log_error("JSON cells node is not a dictionary.\n");
+		if (conn_node->type != 'A')
+			log_error("JSON cells node '%s' connection '%s' is not an array.\n", log_id(cell_name), log_id(conn_name));
 
-		for (auto &cell_node_it : cells_node->data_dict)
-		{
-			IdString cell_name = RTLIL::escape_id(cell_node_it.first.c_str());
-			JsonNode *cell_node = cell_node_it.second;
+		rec.connections.emplace_back(conn_name, json_bits_t());
+		json_parse_bits(rec.connections.back().second, conn_node, "cells node", cell_name, conn_name);
+	}
 
-			if (cell_node->type != 'D')
-				log_error("JSON cells node '%s' is not a dictionary.\n", log_id(cell_name));
+	if (cell_node->data_dict.count("attributes"))
+		json_parse_attr_param(rec.attributes, cell_node->data_dict.at("attributes"));
 
-			if (cell_node->data_dict.count("type") == 0)
-				log_error("JSON cells node '%s' has no type attribute.\n", log_id(cell_name));
+	if (cell_node->data_dict.count("parameters"))
+		json_parse_attr_param(rec.parameters, cell_node->data_dict.at("parameters"));
+}
 
-			JsonNode *type_node = cell_node->data_dict.at("type");
+static RTLIL::Memory *json_parse_memory(const string &name, JsonNode *memory_node)
+{
+	IdString memory_name = RTLIL::escape_id(name.c_str());
+
+	RTLIL::Memory *mem = new RTLIL::Memory;
+	mem->name = memory_name;
+
+	if (memory_node->type != 'D')
+		log_error("JSON memory node '%s' is not a dictionary.\n", log_id(memory_name));
+
+	if (memory_node->data_dict.count("width") == 0)
+		log_error("JSON memory node '%s' has no width attribute.\n", log_id(memory_name));
+	JsonNode *width_node = memory_node->data_dict.at("width");
+	if (width_node->type != 'N')
+		log_error("JSON memory node '%s' has a non-number width.\n", log_id(memory_name));
+	mem->width = width_node->data_number;
+
+	if (memory_node->data_dict.count("size") == 0)
+		log_error("JSON memory node '%s' has no size attribute.\n", log_id(memory_name));
+	JsonNode *size_node = memory_node->data_dict.at("size");
+	if (size_node->type != 'N')
+		log_error("JSON memory node '%s' has a non-number size.\n", log_id(memory_name));
+	mem->size = size_node->data_number;
+
+	mem->start_offset = 0;
+	if (memory_node->data_dict.count("start_offset") != 0) {
+		JsonNode *val = memory_node->data_dict.at("start_offset");
+		if (val->type == 'N')
+			mem->start_offset = val->data_number;
+	}
 
-			if (type_node->type != 'S')
-				log_error("JSON cells node '%s' has a non-string type.\n", log_id(cell_name));
+	if (memory_node->data_dict.count("attributes"))
+		json_parse_attr_param(mem->attributes, memory_node->data_dict.at("attributes"));
 
-			IdString cell_type = RTLIL::escape_id(type_node->data_string.c_str());
+	return mem;
+}
 
-			Cell *cell = module->addCell(cell_name, cell_type);
+// Reads the dict of one module and returns the module without adding it to
+// a design. Only a single port, netname, cell or memory entry is held as a
+// JsonNode tree at any time.
+static Module *json_import_module(JsonReader &f, const string &modname)
+{
+	log("Importing module %s from JSON tree.\n", modname.c_str());
 
-			if (cell_node->data_dict.count("connections") == 0)
-				log_error("JSON cells node '%s' has no connections attribute.\n", log_id(cell_name));
+	Module *module = new RTLIL::Module;
+	module->name = RTLIL::escape_id(modname.c_str());
 
-			JsonNode *connections_node = cell_node->data_dict.at("connections");
+	std::vector<JsonWireRecord> ports, netnames;
+	std::vector<JsonCellRecord> cells;
+	std::vector<RTLIL::Memory*> memories;
 
-			if (connections_node->type != 'D')
-				log_error("JSON cells node '%s' has non-dictionary connections attribute.\n", log_id(cell_name));
+	f.begin_dict("module node");
 
-			for (auto &conn_it : connections_node->data_dict)
-			{
-				IdString conn_name = RTLIL::escape_id(conn_it.first.c_str());
-				JsonNode *conn_node = conn_it.second;
+	string key, name;
+	while (f.next_key(key))
+	{
+		if (key == "attributes") {
+			JsonNode node(f);
+			json_parse_attr_param(module->attributes, &node);
+		} else
+		if (key == "ports") {
+			f.begin_dict("ports node");
+			while (f.next_key(name)) {
+				JsonNode node(f);
+				ports.emplace_back();
+				json_parse_port(ports.back(), name, &node);
+			}
+		} else
+		if (key == "netnames") {
+			f.begin_dict("netnames node");
+			while (f.next_key(name)) {
+				JsonNode node(f);
+				netnames.emplace_back();
+				json_parse_netname(netnames.back(), name, &node);
+			}
+		} else
+		if (key == "cells") {
+			f.begin_dict("cells node");
+			while (f.next_key(name)) {
+				JsonNode node(f);
+				cells.emplace_back();
+				json_parse_cell(cells.back(), name, &node);
+			}
+		} else
+		if (key == "memories") {
+			f.begin_dict("memories node");
+			while (f.next_key(name)) {
+				JsonNode node(f);
+				memories.push_back(json_parse_memory(name, &node));
+			}
+		} else
+			f.skip_value();
+	}
 
-				if (conn_node->type != 'A')
-					log_error("JSON cells node '%s' connection '%s' is not an array.\n", log_id(cell_name), log_id(conn_name));
+	dict<int, SigBit> signal_bits;
 
-				SigSpec sig;
+	for (int port_id = 1; port_id <= GetSize(ports); port_id++)
+	{
+		JsonWireRecord &rec = ports[port_id-1];
+		Wire *port_wire = module->wire(rec.name);
 
-				for (int i = 0; i < GetSize(conn_node->data_array); i++)
-				{
-					JsonNode *bitval_node = conn_node->data_array.at(i);
-
-					if (bitval_node->type == 'S') {
-						if (bitval_node->data_string == "0")
-							sig.append(State::S0);
-						else if (bitval_node->data_string == "1")
-							sig.append(State::S1);
-						else if (bitval_node->data_string == "x")
-							sig.append(State::Sx);
-						else if (bitval_node->data_string == "z")
-							sig.append(State::Sz);
-						else
-							log_error("JSON cells node '%s' connection '%s' has invalid '%s' bit string value on bit %d.\n",
-									log_id(cell_name), log_id(conn_name), bitval_node->data_string.c_str(), i);
-					} else
-					if (bitval_node->type == 'N') {
-						int bitidx = bitval_node->data_number;
-						if (signal_bits.count(bitidx) == 0)
-							signal_bits[bitidx] = module->addWire(NEW_ID);
-						sig.append(signal_bits.at(bitidx));
-					} else
-						log_error("JSON cells node '%s' connection '%s' has invalid bit value on bit %d.\n",
-								log_id(cell_name), log_id(conn_name), i);
+		if (port_wire == nullptr)
+			port_wire = module->addWire(rec.name, GetSize(rec.bits));
 
-				}
+		if (rec.upto >= 0)
+			port_wire->upto = rec.upto;
+		if (rec.is_signed >= 0)
+			port_wire->is_signed = rec.is_signed;
+		if (rec.has_offset)
+			port_wire->start_offset = rec.start_offset;
 
-				cell->setPort(conn_name, sig);
-			}
+		port_wire->port_input |= rec.port_input;
+		port_wire->port_output |= rec.port_output;
+		port_wire->port_id = port_id;
 
-			if (cell_node->data_dict.count("attributes"))
-				json_parse_attr_param(cell->attributes, cell_node->data_dict.at("attributes"));
+		for (int i = 0; i < GetSize(rec.bits); i++)
+		{
+			int bitidx = rec.bits[i];
+			SigBit sigbit(port_wire, i);
 
-			if (cell_node->data_dict.count("parameters"))
-				json_parse_attr_param(cell->parameters, cell_node->data_dict.at("parameters"));
+			if (json_is_const_bit(bitidx)) {
+				module->connect(sigbit, State(bitidx - json_const_bit));
+			} else
+			if (signal_bits.count(bitidx)) {
+				if (port_wire->port_output) {
+					module->connect(sigbit, signal_bits.at(bitidx));
+				} else {
+					module->connect(signal_bits.at(bitidx), sigbit);
+					signal_bits[bitidx] = sigbit;
+				}
+			} else {
+				signal_bits[bitidx] = sigbit;
+			}
 		}
 	}
 
-	if (node->data_dict.count("memories"))
+	module->fixup_ports();
+
+	// netnames, cells and memories are created in the same (reverse) order
+	// as when they were read from a dict<> of the whole file
+	for (auto it = netnames.rbegin(); it != netnames.rend(); ++it)
 	{
-		JsonNode *memories_node = node->data_dict.at("memories");
+		JsonWireRecord &rec = *it;
+		Wire *wire = module->wire(rec.name);
+
+		if (wire == nullptr)
+			wire = module->addWire(rec.name, GetSize(rec.bits));
 
-		if (memories_node->type != 'D')
-			log_error("JSON memories node is not a dictionary.\n");
+		if (rec.upto >= 0)
+			wire->upto = rec.upto;
+		if (rec.has_offset)
+			wire->start_offset = rec.start_offset;
 
-		for (auto &memory_node_it : memories_node->data_dict)
+		for (int i = 0; i < GetSize(rec.bits); i++)
 		{
-			IdString memory_name = RTLIL::escape_id(memory_node_it.first.c_str());
-			JsonNode *memory_node = memory_node_it.second;
-
-			RTLIL::Memory *mem = new RTLIL::Memory;
-			mem->name = memory_name;
-
-			if (memory_node->type != 'D')
-				log_error("JSON memory node '%s' is not a dictionary.\n", log_id(memory_name));
-
-			if (memory_node->data_dict.count("width") == 0)
-				log_error("JSON memory node '%s' has no width attribute.\n", log_id(memory_name));
-			JsonNode *width_node = memory_node->data_dict.at("width");
-			if (width_node->type != 'N')
-				log_error("JSON memory node '%s' has a non-number width.\n", log_id(memory_name));
-			mem->width = width_node->data_number;
-
-			if (memory_node->data_dict.count("size") == 0)
-				log_error("JSON memory node '%s' has no size attribute.\n", log_id(memory_name));
-			JsonNode *size_node = memory_node->data_dict.at("size");
-			if (size_node->type != 'N')
-				log_error("JSON memory node '%s' has a non-number size.\n", log_id(memory_name));
-			mem->size = size_node->data_number;
-
-			mem->start_offset = 0;
-			if (memory_node->data_dict.count("start_offset") != 0) {
-				JsonNode *val = memory_node->data_dict.at("start_offset");
-				if (val->type == 'N')
-					mem->start_offset = val->data_number;
+			int bitidx = rec.bits[i];
+			SigBit sigbit(wire, i);
+
+			if (json_is_const_bit(bitidx)) {
+				module->connect(sigbit, State(bitidx - json_const_bit));
+			} else
+			if (signal_bits.count(bitidx)) {
+				if (sigbit != signal_bits.at(bitidx))
+					module->connect(sigbit, signal_bits.at(bitidx));
+			} else {
+				signal_bits[bitidx] = sigbit;
 			}
+		}
+
+		if (wire->attributes.empty())
+			wire->attributes = std::move(rec.attributes);
+		else
+			for (auto &attr : rec.attributes)
+				wire->attributes[attr.first] = attr.second;
+	}
+	netnames.clear();
+
+	for (auto it = cells.rbegin(); it != cells.rend(); ++it)
+	{
+		JsonCellRecord &rec = *it;
+		Cell *cell = module->addCell(rec.name, rec.type);
 
-			if (memory_node->data_dict.count("attributes"))
-				json_parse_attr_param(mem->attributes, memory_node->data_dict.at("attributes"));
+		for (auto &conn : rec.connections)
+		{
+			SigSpec sig;
 
-			module->memories[mem->name] = mem;
+			for (int bitidx : conn.second) {
+				if (json_is_const_bit(bitidx)) {
+					sig.append(State(bitidx - json_const_bit));
+				} else {
+					if (signal_bits.count(bitidx) == 0)
+						signal_bits[bitidx] = module->addWire(NEW_ID);
+					sig.append(signal_bits.at(bitidx));
+				}
+			}
+
+			cell->setPort(conn.first, sig);
 		}
+
+		cell->attributes = std::move(rec.attributes);
+		cell->parameters = std::move(rec.parameters);
+
+		// release the record early, a module may have millions of cells
+		rec = JsonCellRecord();
 	}
 
+	for (auto it = memories.rbegin(); it != memories.rend(); ++it)
+		module->memories[(*it)->name] = *it;
+
 	// remove duplicates from connections array
 	pool<RTLIL::SigSig> unique_connections(module->connections_.begin(), module->connections_.end());
 	module->connections_ = std::vector<RTLIL::SigSig>(unique_connections.begin(), unique_connections.end());
+
+	return module;
+}
+
+struct json_module_span_t {
+	string name;
+	size_t begin, end;
+};
+
+// Walks the root dict. Modules are imported as they are scanned, or, with
+// spans != nullptr, only located so that they can be imported in parallel.
+static void json_import_root(JsonReader &f, std::vector<Module*> &modules, std::vector<json_module_span_t> *spans)
+{
+	f.begin_dict("root node");
+
+	string key, modname;
+	while (f.next_key(key))
+	{
+		if (key != "modules") {
+			f.skip_value();
+			continue;
+		}
+
+		f.begin_dict("modules node");
+		while (f.next_key(modname)) {
+			if (spans != nullptr) {
+				size_t begin = f.offset();
+				f.skip_value();
+				spans->push_back({modname, begin, f.offset()});
+			} else
+				modules.push_back(json_import_module(f, modname));
+		}
+	}
 }
 
 struct JsonFrontend : public Frontend {
@@ -630,6 +894,11 @@ struct JsonFrontend : public Frontend {
 		log("Load modules from a JSON file into the current design See \"help write_json\"\n");
 		log("for a description of the file format.\n");
 		log("\n");
+		log("The file is read incrementally, one port, netname or cell entry at a time, so\n");
+		log("the memory used stays close to the size of the imported design. Plain files\n");
+		log("are memory mapped. When synthesizer runs with -j <jobs>, the modules are\n");
+		log("imported concurrently.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -646,20 +915,53 @@ struct JsonFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		JsonNode root(*f);
+		MappedFile mapped;
+		std::string buffer;
+		const char *data = nullptr;
+		size_t size = 0;
+
+		// plain files are mapped, other streams are only buffered for a parallel import
+		if (dynamic_cast<std::ifstream*>(f) != nullptr && mapped.map(filename)) {
+			data = mapped.data;
+			size = mapped.size;
+		} else if (auto mem = dynamic_cast<MemoryIStream*>(f)) {
+			data = mem->text().data();
+			size = mem->text().size();
+		} else if (yosys_parallel_jobs > 1) {
+			std::stringstream ss;
+			ss << f->rdbuf();
+			buffer = ss.str();
+			data = buffer.data();
+			size = buffer.size();
+		}
 
-		if (root.type != 'D')
-			log_error("JSON root node is not a dictionary.\n");
+		std::vector<Module*> modules;
 
-		if (root.data_dict.count("modules") != 0)
-		{
-			JsonNode *modules = root.data_dict.at("modules");
+		if (data != nullptr && yosys_parallel_jobs > 1) {
+			std::vector<json_module_span_t> spans;
+			JsonReader reader(data, size);
+			json_import_root(reader, modules, &spans);
 
-			if (modules->type != 'D')
-				log_error("JSON modules node is not a dictionary.\n");
+			modules.resize(GetSize(spans));
+			parallel_for(GetSize(spans), [&](int i) {
+				JsonReader module_reader(data + spans[i].begin, spans[i].end - spans[i].begin);
+				modules[i] = json_import_module(module_reader, spans[i].name);
+			});
+
+			log("Imported %d modules on up to %d threads.\n", GetSize(modules), yosys_parallel_jobs);
+		} else if (data != nullptr) {
+			JsonReader reader(data, size);
+			json_import_root(reader, modules, nullptr);
+		} else {
+			JsonReader reader(*f);
+			json_import_root(reader, modules, nullptr);
+		}
 
-			for (auto &it : modules->data_dict)
-				json_import(design, it.first, it.second);
+		// added in reverse, which keeps the module order of the old dict<> based import
+		for (auto it = modules.rbegin(); it != modules.rend(); ++it) {
+			if (design->module((*it)->name))
+				log_error("Re-definition of module %s.\n", log_id((*it)->name));
+			design->add(*it);
 		}
 	}
 } JsonFrontend;
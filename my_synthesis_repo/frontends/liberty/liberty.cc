@@ -546,13 +546,13 @@ struct LibertyFrontend : public Frontend {
 
 		log_header(design, "Executing Liberty frontend: %s\n", filename.c_str());
 
-		LibertyParser parser(*f);
+		LibertyAst *liberty_ast = LibertyCache::parse(*f);
 		int cell_count = 0;
 
 		std::map<std::string, std::tuple<int, int, bool>> global_type_map;
-		parse_type_map(global_type_map, parser.ast);
+		parse_type_map(global_type_map, liberty_ast);
 
-		for (auto cell : parser.ast->children)
+		for (auto cell : liberty_ast->children)
 		{
 			if (cell->id != "cell" || cell->args.size() != 1)
 				continue;
@@ -70,23 +70,84 @@ static std::string get_last_error_str() {
 
 using json11::Json;
 
+static bool encode_parameters(const dict<RTLIL::IdString, RTLIL::Const> &parameters, Json::object &json_parameters, std::string &error) {
+	for (auto &param : parameters) {
+		std::string type, value;
+		if (param.second.flags & RTLIL::CONST_FLAG_REAL) {
+			type = "real";
+			value = param.second.decode_string();
+		} else if (param.second.flags & RTLIL::CONST_FLAG_STRING) {
+			type = "string";
+			value = param.second.decode_string();
+		} else if ((param.second.flags & ~RTLIL::CONST_FLAG_SIGNED) == RTLIL::CONST_FLAG_NONE) {
+			type = (param.second.flags & RTLIL::CONST_FLAG_SIGNED) ? "signed" : "unsigned";
+			value = param.second.as_string();
+		} else {
+			error = stringf("Unserializable constant flags 0x%x", param.second.flags);
+			return false;
+		}
+		json_parameters[param.first.str()] = Json::object {
+			{ "type", type },
+			{ "value", value },
+		};
+	}
+	return true;
+}
+
 struct RpcServer {
 	std::string name;
 
+	// Bytes received past the end of the last response; the frontend may already be answering the next request.
+	std::string read_buffer;
+	size_t read_offset = 0;
+
 	RpcServer(const std::string &name) : name(name) { }
 	virtual ~RpcServer() { }
 
 	virtual void write(const std::string &data) = 0;
-	virtual std::string read() = 0;
+	virtual size_t read_some(char *data, size_t length) = 0;
+	virtual bool is_alive() { return true; }
+
+	std::string read_line() {
+		size_t scan_offset = read_offset;
+		while (true) {
+			size_t term_pos = read_buffer.find('\n', scan_offset);
+			if (term_pos != std::string::npos) {
+				std::string line = read_buffer.substr(read_offset, term_pos + 1 - read_offset);
+				read_offset = term_pos + 1;
+				if (read_offset == read_buffer.size()) {
+					read_buffer.clear();
+					read_offset = 0;
+				}
+				return line;
+			}
+			if (read_offset > 0) {
+				read_buffer.erase(0, read_offset);
+				read_offset = 0;
+			}
+			scan_offset = read_buffer.size();
+			char chunk[65536];
+			size_t length = read_some(chunk, sizeof(chunk));
+			if (length == 0)
+				log_cmd_error("read failed: RPC frontend closed the connection\n");
+			read_buffer.append(chunk, length);
+		}
+	}
 
-	Json call(const Json &json_request) {
+	static std::string encode_request(const Json &json_request) {
 		std::string request;
 		json_request.dump(request);
 		request += '\n';
+		return request;
+	}
+
+	void send(const std::string &request) {
 		log_debug("RPC frontend request: %s", request.c_str());
 		write(request);
+	}
 
-		std::string response = read();
+	Json receive() {
+		std::string response = read_line();
 		log_debug("RPC frontend response: %s", response.c_str());
 		std::string error;
 		Json json_response = Json::parse(response, error);
@@ -97,6 +158,11 @@ struct RpcServer {
 		return json_response;
 	}
 
+	Json call(const Json &json_request) {
+		send(encode_request(json_request));
+		return receive();
+	}
+
 	std::vector<std::string> get_module_names() {
 		Json response = call(Json::object {
 			{ "method", "modules" },
@@ -115,31 +181,15 @@ struct RpcServer {
 		return modules;
 	}
 
-	std::pair<std::string, std::string> derive_module(const std::string &module, const dict<RTLIL::IdString, RTLIL::Const> &parameters) {
-		Json::object json_parameters;
-		for (auto &param : parameters) {
-			std::string type, value;
-			if (param.second.flags & RTLIL::CONST_FLAG_REAL) {
-				type = "real";
-				value = param.second.decode_string();
-			} else if (param.second.flags & RTLIL::CONST_FLAG_STRING) {
-				type = "string";
-				value = param.second.decode_string();
-			} else if ((param.second.flags & ~RTLIL::CONST_FLAG_SIGNED) == RTLIL::CONST_FLAG_NONE) {
-				type = (param.second.flags & RTLIL::CONST_FLAG_SIGNED) ? "signed" : "unsigned";
-				value = param.second.as_string();
-			} else
-				log_cmd_error("Unserializable constant flags 0x%x\n", param.second.flags);
-			json_parameters[param.first.str()] = Json::object {
-				{ "type", type },
-				{ "value", value },
-			};
-		}
-		Json response = call(Json::object {
+	static std::string derive_request(const std::string &module, const Json::object &json_parameters) {
+		return encode_request(Json::object {
 			{ "method", "derive" },
 			{ "module", module },
 			{ "parameters", json_parameters },
 		});
+	}
+
+	static std::pair<std::string, std::string> derive_result(const Json &response) {
 		bool is_valid = true;
 		std::string frontend, source;
 		if (response["frontend"].is_string())
@@ -152,11 +202,94 @@ struct RpcServer {
 			log_cmd_error("RPC frontend returned malformed response: %s\n", response.dump().c_str());
 		return std::make_pair(frontend, source);
 	}
+
+	// Requests are pipelined: a window of requests is written before any response is read. The window is kept
+	// well below the usual pipe and socket buffer size, so that writing it can never block on a frontend that
+	// is itself blocked writing responses we have not read yet.
+	std::vector<std::pair<std::string, std::string>> derive_modules(const std::vector<std::string> &requests) {
+		const size_t window_bytes = 16384;
+		std::vector<std::pair<std::string, std::string>> results;
+		results.reserve(requests.size());
+		size_t next = 0;
+		while (next < requests.size()) {
+			size_t window_end = next, pending_bytes = 0;
+			while (window_end < requests.size() && (window_end == next || pending_bytes + requests[window_end].size() <= window_bytes))
+				pending_bytes += requests[window_end++].size();
+			for (size_t i = next; i < window_end; i++)
+				send(requests[i]);
+			for (size_t i = next; i < window_end; i++)
+				results.push_back(derive_result(receive()));
+			next = window_end;
+		}
+		return results;
+	}
 };
 
+// Derive results keyed by server name and request. They outlive the design (and `design -reset`), since the
+// protocol requires the frontend to give the same response whenever the same set of parameters is provided.
+static dict<std::string, std::pair<std::string, std::string>> rpc_derive_cache;
+
+// Connections are kept open for the lifetime of the process, and reused by `connect_rpc` with the same
+// command line or path.
+static std::map<std::string, std::shared_ptr<RpcServer>> rpc_servers;
+
 struct RpcModule : RTLIL::Module {
 	std::shared_ptr<RpcServer> server;
 
+	// On a cache miss, the parameterizations of all other cells in the design that instantiate a module of the same
+	// server are derived in the same batch, since `hierarchy' is about to ask for them one by one anyway.
+	std::pair<std::string, std::string> derive_cached(RTLIL::Design *design, const std::string &stripped_name, const dict<RTLIL::IdString, RTLIL::Const> &parameters) {
+		Json::object json_parameters;
+		std::string error;
+		if (!encode_parameters(parameters, json_parameters, error))
+			log_cmd_error("%s\n", error.c_str());
+		std::string request = RpcServer::derive_request(stripped_name.substr(1), json_parameters);
+		std::string key = server->name + '\n' + request;
+
+		auto it = rpc_derive_cache.find(key);
+		if (it != rpc_derive_cache.end()) {
+			log("Found cached response of RPC frontend for module `%s'.\n", stripped_name.c_str());
+			return it->second;
+		}
+
+		std::vector<std::string> requests, keys;
+		pool<std::string> batched;
+		requests.push_back(request);
+		keys.push_back(key);
+		batched.insert(key);
+
+		for (auto module : design->modules())
+			for (auto cell : module->cells()) {
+				if (cell->parameters.empty())
+					continue;
+				RpcModule *target = dynamic_cast<RpcModule*>(design->module("$abstract" + cell->type.str()));
+				if (target == nullptr)
+					target = dynamic_cast<RpcModule*>(design->module(cell->type));
+				if (target == nullptr || target->server != server)
+					continue;
+				std::string target_name = target->name.str();
+				if (target_name.compare(0, 9, "$abstract") == 0)
+					target_name = target_name.substr(9);
+				Json::object cell_parameters;
+				if (!encode_parameters(cell->parameters, cell_parameters, error))
+					continue;
+				std::string cell_request = RpcServer::derive_request(target_name.substr(1), cell_parameters);
+				std::string cell_key = server->name + '\n' + cell_request;
+				if (rpc_derive_cache.count(cell_key) || batched.count(cell_key))
+					continue;
+				requests.push_back(cell_request);
+				keys.push_back(cell_key);
+				batched.insert(cell_key);
+			}
+
+		if (GetSize(requests) > 1)
+			log("Sending %d derive requests to RPC frontend in one batch.\n", GetSize(requests));
+		auto results = server->derive_modules(requests);
+		for (int i = 0; i < GetSize(keys); i++)
+			rpc_derive_cache[keys[i]] = results[i];
+		return results[0];
+	}
+
 	RTLIL::IdString derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool /*mayfail*/) override {
 		std::string stripped_name = name.str();
 		if (stripped_name.compare(0, 9, "$abstract") == 0)
@@ -183,7 +316,7 @@ struct RpcModule : RTLIL::Module {
 			log("Found cached RTLIL representation for module `%s'.\n", derived_name.c_str());
 		} else {
 			std::string command, input;
-			std::tie(command, input) = server->derive_module(stripped_name.substr(1), parameters);
+			std::tie(command, input) = derive_cached(design, stripped_name, parameters);
 
 			std::istringstream input_stream(input);
 			RTLIL::Design *derived_design = new RTLIL::Design;
@@ -261,21 +394,14 @@ struct HandleRpcServer : RpcServer {
 		} while(offset < (ssize_t)data.length());
 	}
 
-	std::string read() override {
-		std::string data;
-		ssize_t offset = 0;
-		while (data.length() == 0 || data[data.length() - 1] != '\n') {
-			data.resize(data.length() + 1024);
-			DWORD data_read;
-			if (!ReadFile(hrecv, &data[offset], data.length() - offset, &data_read, /*lpOverlapped=*/NULL))
-				log_cmd_error("ReadFile failed: %s\n", get_last_error_str().c_str());
-			offset += data_read;
-			data.resize(offset);
-			size_t term_pos = data.find('\n', offset);
-			if (term_pos != data.length() - 1 && term_pos != std::string::npos)
-				log_cmd_error("read failed: more than one response\n");
+	size_t read_some(char *data, size_t length) override {
+		DWORD data_read;
+		if (!ReadFile(hrecv, data, length, &data_read, /*lpOverlapped=*/NULL)) {
+			if (GetLastError() == ERROR_BROKEN_PIPE)
+				return 0;
+			log_cmd_error("ReadFile failed: %s\n", get_last_error_str().c_str());
 		}
-		return data;
+		return data_read;
 	}
 
 	~HandleRpcServer() {
@@ -316,22 +442,16 @@ struct FdRpcServer : RpcServer {
 		} while(offset < (ssize_t)data.length());
 	}
 
-	std::string read() override {
-		std::string data;
-		ssize_t offset = 0;
-		while (data.length() == 0 || data[data.length() - 1] != '\n') {
-			data.resize(data.length() + 1024);
-			check_pid();
-			ssize_t result = ::read(fdrecv, &data[offset], data.length() - offset);
-			if (result == -1)
-				log_cmd_error("read failed: %s\n", strerror(errno));
-			offset += result;
-			data.resize(offset);
-			size_t term_pos = data.find('\n', offset);
-			if (term_pos != data.length() - 1 && term_pos != std::string::npos)
-				log_cmd_error("read failed: more than one response\n");
-		}
-		return data;
+	size_t read_some(char *data, size_t length) override {
+		check_pid();
+		ssize_t result = ::read(fdrecv, data, length);
+		if (result == -1)
+			log_cmd_error("read failed: %s\n", strerror(errno));
+		return result;
+	}
+
+	bool is_alive() override {
+		return pid == -1 || ::waitpid(pid, NULL, WNOHANG) == 0;
 	}
 
 	~FdRpcServer() {
@@ -389,6 +509,19 @@ struct RpcFrontend : public Pass {
 		log("        frontend to return anyconvenient representation of the module. the\n");
 		log("        derived module is cached,so the response should be the same whenever the\n");
 		log("        same set of parameters is provided.\n");
+		log("\n");
+		log("Requests may be pipelined: when a module is derived, the parameterizations of\n");
+		log("all other cells of the design that instantiate modules of the same frontend\n");
+		log("are requested in the same batch, before any of the responses is read. The\n");
+		log("frontend must answer requests in the order they were received. Responses are\n");
+		log("memoized for the lifetime of the process, including across 'design -reset',\n");
+		log("and the connection is kept open and reused by a later connect_rpc with the same\n");
+		log("command line or path.\n");
+	}
+	void on_shutdown() override
+	{
+		rpc_derive_cache.clear();
+		rpc_servers.clear();
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -415,16 +548,21 @@ struct RpcFrontend : public Pass {
 		if ((!command.empty()) + (!path.empty()) != 1)
 			log_cmd_error("Exactly one of -exec, -unix must be specified.\n");
 
-		std::shared_ptr<RpcServer> server;
-		if (!command.empty()) {
-			std::string command_line;
-			bool first = true;
-			for (auto &arg : command) {
-				if (!first) command_line += ' ';
-				command_line += arg;
-				first = false;
-			}
+		std::string command_line;
+		bool first = true;
+		for (auto &arg : command) {
+			if (!first) command_line += ' ';
+			command_line += arg;
+			first = false;
+		}
 
+		std::shared_ptr<RpcServer> server;
+		std::string server_name = command.empty() ? path : command_line;
+		auto server_it = rpc_servers.find(server_name);
+		if (server_it != rpc_servers.end() && server_it->second->is_alive()) {
+			log("Reusing connection to RPC frontend `%s'.\n", server_name.c_str());
+			server = server_it->second;
+		} else if (!command.empty()) {
 #ifdef _WIN32
 			std::wstring command_w = str2wstr(command[0]);
 			std::wstring command_path_w;
@@ -476,7 +614,7 @@ struct RpcFrontend : public Pass {
 			CloseHandle(proc_info.hProcess);
 			CloseHandle(proc_info.hThread);
 
-			server = std::make_shared<HandleRpcServer>(path, send_w, recv_r);
+			server = std::make_shared<HandleRpcServer>(command_line, send_w, recv_r);
 			send_w = NULL;
 			recv_r = NULL;
 
@@ -584,6 +722,7 @@ cleanup_path:
 
 		if (!server)
 			log_cmd_error("Failed to connect to RPC frontend.\n");
+		rpc_servers[server_name] = server;
 
 		for (auto &module_name : server->get_module_names()) {
 			log("Linking module `%s'.\n", module_name.c_str());
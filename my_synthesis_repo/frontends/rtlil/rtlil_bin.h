@@ -0,0 +1,126 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Binary RTLIL checkpoint format, written by 'write_rtlil -bin' and read
+ *  by 'read_rtlil -bin'.
+ *
+ *  All fixed-width integers are little endian. The file starts with a
+ *  header and two tables that can be used in place from a memory mapping:
+ *
+ *    header        magic "YSRTLBIN", u32 version, u32 reserved,
+ *                  u64 autoidx, u64 number of strings, u64 number of modules
+ *    string table  u64 offsets[number of strings + 1] into the string data,
+ *                  followed by the string data (no terminators)
+ *    module table  per module: u64 name (string index), u64 offset and
+ *                  u64 size of the module section from the start of the file
+ *    modules       one section per module
+ *
+ *  Module sections use LEB128 varints ("uint"), zigzag-encoded varints for
+ *  signed values ("int") and string indices ("id") into the string table,
+ *  which holds every IdString of the design exactly once:
+ *
+ *    const     uint flags, uint (width << 1 | packed), then the bits; packed
+ *              constants only contain 0 and 1 and store 8 bits per byte,
+ *              all others store one RTLIL::State per nibble
+ *    sigspec   uint chunk count, per chunk uint 0 and a const, or
+ *              uint (wire index + 1), uint offset and uint width
+ *    attrs     uint count, per entry id and const
+ *    module    attrs, uint parameter count, per parameter id, uint has
+ *              default and the default const, then the wires (id, uint
+ *              width, int start_offset, int port_id, uint flags, attrs),
+ *              memories (id, uint width, int start_offset, uint size,
+ *              attrs), cells (id, id type, attrs, parameters as attrs,
+ *              uint port count, per port id and sigspec), processes (id,
+ *              attrs, root case, syncs) and connections (sigspec pairs),
+ *              every list prefixed with its uint count
+ *    case      attrs, compare sigspecs, actions, switches (sigspec, attrs,
+ *              cases)
+ *    sync      uint type, sigspec, actions, memwr actions (attrs, id memid,
+ *              address, data and enable sigspecs, const priority mask)
+ *
+ *  Wires are referenced by their index in the module section, so a module
+ *  can be decoded on its own. The module table allows a reader to locate
+ *  and load a subset of the modules without touching the others.
+ */
+
+#ifndef RTLIL_BIN_H
+#define RTLIL_BIN_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_BIN {
+	static const char magic[8] = { 'Y', 'S', 'R', 'T', 'L', 'B', 'I', 'N' };
+	static const uint32_t version = 1;
+
+	static const size_t header_size = 40;
+	static const size_t module_entry_size = 24;
+
+	enum wire_flags_t {
+		WIRE_PORT_INPUT = 1,
+		WIRE_PORT_OUTPUT = 2,
+		WIRE_UPTO = 4,
+		WIRE_SIGNED = 8
+	};
+
+	inline bool has_magic(const char *data, size_t size) {
+		return size >= sizeof(magic) && memcmp(data, magic, sizeof(magic)) == 0;
+	}
+
+	inline void put_u32(std::string &buf, uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			buf.push_back(char(value >> (8*i)));
+	}
+
+	inline void put_u64(std::string &buf, uint64_t value) {
+		for (int i = 0; i < 8; i++)
+			buf.push_back(char(value >> (8*i)));
+	}
+
+	inline uint64_t get_u64(const char *data) {
+		uint64_t value = 0;
+		for (int i = 0; i < 8; i++)
+			value |= uint64_t((unsigned char)data[i]) << (8*i);
+		return value;
+	}
+
+	inline uint32_t get_u32(const char *data) {
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++)
+			value |= uint32_t((unsigned char)data[i]) << (8*i);
+		return value;
+	}
+
+	inline void put_uint(std::string &buf, uint64_t value) {
+		while (value >= 0x80) {
+			buf.push_back(char(value | 0x80));
+			value >>= 7;
+		}
+		buf.push_back(char(value));
+	}
+
+	inline void put_int(std::string &buf, int64_t value) {
+		put_uint(buf, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  Reader for the binary RTLIL checkpoint format, see rtlil_bin.h for the
+ *  file layout.
+ *
+ */
+
+#include "rtlil_frontend.h"
+#include "rtlil_bin.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace RTLIL_BIN;
+
+namespace {
+
+struct BinReader
+{
+	const char *data;
+	size_t size;
+	std::string filename;
+
+	uint64_t num_strings;
+	const char *string_offsets;
+	const char *string_data;
+	size_t string_data_size;
+
+	// IdStrings are only interned when a loaded module uses them
+	std::vector<RTLIL::IdString> ids;
+	std::vector<bool> ids_done;
+
+	// per module state
+	const char *pos, *end;
+	std::vector<RTLIL::Wire*> wires;
+
+	[[noreturn]] void error(const char *what)
+	{
+		log_error("Invalid binary RTLIL file %s: %s.\n", filename.c_str(), what);
+	}
+
+	void check_range(uint64_t offset, uint64_t length, const char *what)
+	{
+		if (offset > size || length > size - offset)
+			error(what);
+	}
+
+	void init()
+	{
+		if (size < header_size || !has_magic(data, size))
+			error("bad magic");
+		if (get_u32(data + 8) != version)
+			error(stringf("unsupported format version %u", get_u32(data + 8)).c_str());
+
+		num_strings = get_u64(data + 24);
+		if (num_strings >= size / 8)
+			error("truncated string table");
+		check_range(header_size, (num_strings + 1) * 8, "truncated string table");
+		string_offsets = data + header_size;
+		string_data = string_offsets + (num_strings + 1) * 8;
+		string_data_size = get_u64(string_offsets + num_strings * 8);
+		check_range(string_data - data, string_data_size, "truncated string table");
+
+		ids.resize(num_strings);
+		ids_done.resize(num_strings);
+	}
+
+	int64_t get_autoidx()
+	{
+		return get_u64(data + 16);
+	}
+
+	uint64_t num_modules()
+	{
+		uint64_t count = get_u64(data + 32);
+		if (count > size / module_entry_size)
+			error("truncated module table");
+		check_range(string_data - data + string_data_size, count * module_entry_size, "truncated module table");
+		return count;
+	}
+
+	const char *module_entry(uint64_t index)
+	{
+		return string_data + string_data_size + index * module_entry_size;
+	}
+
+	RTLIL::IdString lookup_id(uint64_t index)
+	{
+		if (index >= num_strings)
+			error("string index out of range");
+		if (!ids_done[index]) {
+			uint64_t begin = get_u64(string_offsets + index * 8);
+			uint64_t finish = get_u64(string_offsets + index * 8 + 8);
+			if (begin > finish || finish > string_data_size || begin == finish)
+				error("bad string table entry");
+			ids[index] = std::string(string_data + begin, finish - begin);
+			ids_done[index] = true;
+		}
+		return ids[index];
+	}
+
+	uint64_t get_uint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (pos == end)
+				error("truncated module section");
+			unsigned char byte = *pos++;
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return value;
+		}
+		error("bad varint");
+	}
+
+	int get_count()
+	{
+		uint64_t value = get_uint();
+		// every list element takes at least one byte
+		if (value > uint64_t(end - pos))
+			error("bad element count");
+		return value;
+	}
+
+	int get_size(const char *what)
+	{
+		uint64_t value = get_uint();
+		if (value > uint64_t(INT_MAX))
+			error(what);
+		return value;
+	}
+
+	int get_int()
+	{
+		uint64_t value = get_uint();
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+
+	RTLIL::IdString get_id()
+	{
+		return lookup_id(get_uint());
+	}
+
+	void get_bits(std::vector<RTLIL::State> &bits)
+	{
+		uint64_t value = get_uint();
+		uint64_t width = value >> 1;
+		bool packed = value & 1;
+		uint64_t bytes = packed ? (width + 7) / 8 : (width + 1) / 2;
+		if (bytes > uint64_t(end - pos))
+			error("truncated constant");
+
+		bits.resize(width);
+		for (uint64_t i = 0; i < width; i++) {
+			unsigned char byte = pos[packed ? i / 8 : i / 2];
+			if (packed)
+				bits[i] = (byte >> (i % 8)) & 1 ? RTLIL::S1 : RTLIL::S0;
+			else {
+				unsigned char state = (byte >> (4 * (i % 2))) & 15;
+				if (state > RTLIL::Sm)
+					error("bad constant bit");
+				bits[i] = RTLIL::State(state);
+			}
+		}
+		pos += bytes;
+	}
+
+	RTLIL::Const get_const()
+	{
+		RTLIL::Const value;
+		value.flags = get_uint();
+		get_bits(value.bits);
+		return value;
+	}
+
+	RTLIL::SigSpec get_sigspec()
+	{
+		RTLIL::SigSpec sig;
+		for (int count = get_count(); count > 0; count--) {
+			uint64_t index = get_uint();
+			if (index == 0) {
+				RTLIL::Const value;
+				get_bits(value.bits);
+				sig.append(value);
+				continue;
+			}
+			if (index > wires.size())
+				error("wire index out of range");
+			RTLIL::Wire *wire = wires[index - 1];
+			uint64_t offset = get_uint();
+			uint64_t width = get_uint();
+			if (offset > uint64_t(wire->width) || width > uint64_t(wire->width) - offset)
+				error("wire slice out of range");
+			sig.append(RTLIL::SigSpec(wire, offset, width));
+		}
+		return sig;
+	}
+
+	void get_attrs(dict<RTLIL::IdString, RTLIL::Const> &attrs)
+	{
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::IdString name = get_id();
+			attrs[name] = get_const();
+		}
+	}
+
+	void get_actions(std::vector<RTLIL::SigSig> &actions)
+	{
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::SigSpec lhs = get_sigspec();
+			RTLIL::SigSpec rhs = get_sigspec();
+			actions.push_back(RTLIL::SigSig(lhs, rhs));
+		}
+	}
+
+	void get_case(RTLIL::CaseRule *cs)
+	{
+		get_attrs(cs->attributes);
+		for (int count = get_count(); count > 0; count--)
+			cs->compare.push_back(get_sigspec());
+		get_actions(cs->actions);
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::SwitchRule *sw = new RTLIL::SwitchRule;
+			cs->switches.push_back(sw);
+			sw->signal = get_sigspec();
+			get_attrs(sw->attributes);
+			for (int n = get_count(); n > 0; n--) {
+				RTLIL::CaseRule *child = new RTLIL::CaseRule;
+				sw->cases.push_back(child);
+				get_case(child);
+			}
+		}
+	}
+
+	void get_process(RTLIL::Module *module)
+	{
+		RTLIL::IdString name = get_id();
+		if (module->processes.count(name))
+			error("duplicate process");
+		RTLIL::Process *proc = module->addProcess(name);
+		get_attrs(proc->attributes);
+		get_case(&proc->root_case);
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::SyncRule *sync = new RTLIL::SyncRule;
+			proc->syncs.push_back(sync);
+			uint64_t type = get_uint();
+			if (type > RTLIL::STi)
+				error("bad sync type");
+			sync->type = RTLIL::SyncType(type);
+			sync->signal = get_sigspec();
+			get_actions(sync->actions);
+			for (int n = get_count(); n > 0; n--) {
+				RTLIL::MemWriteAction act;
+				get_attrs(act.attributes);
+				act.memid = get_id();
+				act.address = get_sigspec();
+				act.data = get_sigspec();
+				act.enable = get_sigspec();
+				act.priority_mask = get_const();
+				sync->mem_write_actions.push_back(std::move(act));
+			}
+		}
+	}
+
+	void get_module(RTLIL::Module *module, uint64_t offset, uint64_t length)
+	{
+		check_range(offset, length, "module section out of range");
+		pos = data + offset;
+		end = pos + length;
+		wires.clear();
+
+		get_attrs(module->attributes);
+
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::IdString name = get_id();
+			module->avail_parameters(name);
+			if (get_uint())
+				module->parameter_default_values[name] = get_const();
+		}
+
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::IdString name = get_id();
+			if (module->wire(name) != nullptr)
+				error("duplicate wire");
+			RTLIL::Wire *wire = module->addWire(name, get_size("bad wire width"));
+			wire->start_offset = get_int();
+			wire->port_id = get_int();
+			uint64_t flags = get_uint();
+			wire->port_input = (flags & WIRE_PORT_INPUT) != 0;
+			wire->port_output = (flags & WIRE_PORT_OUTPUT) != 0;
+			wire->upto = (flags & WIRE_UPTO) != 0;
+			wire->is_signed = (flags & WIRE_SIGNED) != 0;
+			get_attrs(wire->attributes);
+			wires.push_back(wire);
+		}
+
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = get_id();
+			if (module->memories.count(memory->name)) {
+				delete memory;
+				error("duplicate memory");
+			}
+			module->memories[memory->name] = memory;
+			memory->width = get_size("bad memory width");
+			memory->start_offset = get_int();
+			memory->size = get_size("bad memory size");
+			get_attrs(memory->attributes);
+		}
+
+		for (int count = get_count(); count > 0; count--) {
+			RTLIL::IdString name = get_id();
+			RTLIL::IdString type = get_id();
+			if (module->cell(name) != nullptr)
+				error("duplicate cell");
+			RTLIL::Cell *cell = module->addCell(name, type);
+			get_attrs(cell->attributes);
+			get_attrs(cell->parameters);
+			for (int n = get_count(); n > 0; n--) {
+				RTLIL::IdString port = get_id();
+				cell->setPort(port, get_sigspec());
+			}
+		}
+
+		for (int count = get_count(); count > 0; count--)
+			get_process(module);
+
+		std::vector<RTLIL::SigSig> connections;
+		get_actions(connections);
+		for (auto &conn : connections)
+			module->connect(conn);
+
+		if (pos != end)
+			error("trailing data in module section");
+	}
+};
+
+}
+
+void RTLIL_FRONTEND::read_design_binary(std::istream *f, std::string filename, RTLIL::Design *design, const pool<RTLIL::IdString> &only_modules)
+{
+	MappedFile mapped;
+	std::string buffer;
+
+	// plain files are mapped, gzip files are already in memory, anything else (stdin, ...) is read into memory
+	auto mem = dynamic_cast<MemoryIStream*>(f);
+	if (mem == nullptr && (dynamic_cast<std::ifstream*>(f) == nullptr || !mapped.map(filename))) {
+		std::stringstream ss;
+		ss << f->rdbuf();
+		buffer = ss.str();
+	}
+	const std::string &text = mem != nullptr ? mem->text() : buffer;
+
+	BinReader reader;
+	reader.data = mapped.data != nullptr ? mapped.data : text.data();
+	reader.size = mapped.data != nullptr ? mapped.size : text.size();
+	reader.filename = filename;
+	reader.init();
+
+	autoidx = std::max<int64_t>(autoidx, reader.get_autoidx());
+
+	int loaded = 0, skipped = 0;
+	uint64_t num_modules = reader.num_modules();
+	pool<RTLIL::IdString> found_modules;
+
+	for (uint64_t i = 0; i < num_modules; i++)
+	{
+		const char *entry = reader.module_entry(i);
+		RTLIL::IdString name = reader.lookup_id(get_u64(entry));
+		found_modules.insert(name);
+
+		if (!only_modules.empty() && !only_modules.count(name)) {
+			skipped++;
+			continue;
+		}
+
+		RTLIL::Module *module = new RTLIL::Module;
+		module->name = name;
+		reader.get_module(module, get_u64(entry + 8), get_u64(entry + 16));
+
+		module->fixup_ports();
+		if (flag_lib)
+			module->makeblackbox();
+		if (!add_module(design, module)) {
+			skipped++;
+			continue;
+		}
+		loaded++;
+	}
+
+	for (auto name : only_modules)
+		if (!found_modules.count(name))
+			log_error("Module %s not found in binary RTLIL file %s.\n", log_id(name), filename.c_str());
+
+	log("Loaded %d modules%s, skipped %d.\n", loaded, mapped.data != nullptr ? " from memory mapped file" : "", skipped);
+}
+
+YOSYS_NAMESPACE_END
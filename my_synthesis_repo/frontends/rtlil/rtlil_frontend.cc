@@ -25,14 +25,151 @@
 #include "rtlil_frontend.h"
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "kernel/threading.h"
+
+void rtlil_frontend_yyerror(void *scanner, char const *s)
+{
+	int line = rtlil_frontend_yyget_lineno(scanner) + YOSYS_NAMESPACE_PREFIX RTLIL_FRONTEND::current_line_offset;
+	YOSYS_NAMESPACE_PREFIX log_error("Parser error in line %d: %s\n", line, s);
+}
 
 void rtlil_frontend_yyerror(char const *s)
 {
-	YOSYS_NAMESPACE_PREFIX log_error("Parser error in line %d: %s\n", rtlil_frontend_yyget_lineno(), s);
+	rtlil_frontend_yyerror(YOSYS_NAMESPACE_PREFIX RTLIL_FRONTEND::current_scanner, s);
 }
 
 YOSYS_NAMESPACE_BEGIN
 
+bool RTLIL_FRONTEND::add_module(RTLIL::Design *design, RTLIL::Module *module)
+{
+	if (design->has(module->name)) {
+		RTLIL::Module *existing_mod = design->module(module->name);
+		if (!flag_overwrite && (flag_lib || module->get_bool_attribute(ID::blackbox))) {
+			log("Ignoring blackbox re-definition of module %s.\n", log_id(module));
+			delete module;
+			return false;
+		} else if (!flag_nooverwrite && !flag_overwrite && !existing_mod->get_bool_attribute(ID::blackbox)) {
+			log_error("RTLIL error: redefinition of module %s.\n", log_id(module));
+		} else if (flag_nooverwrite) {
+			log("Ignoring re-definition of module %s.\n", log_id(module));
+			delete module;
+			return false;
+		} else {
+			log("Replacing existing%s module %s.\n", existing_mod->get_bool_attribute(ID::blackbox) ? " blackbox" : "", log_id(module));
+			design->remove(existing_mod);
+		}
+	}
+	design->add(module);
+	return true;
+}
+
+static void parse_rtlil(std::istream *f, int first_line, RTLIL::Design *design)
+{
+	void *scanner;
+	rtlil_frontend_yylex_init_extra(f, &scanner);
+
+	RTLIL_FRONTEND::current_scanner = scanner;
+	RTLIL_FRONTEND::current_line_offset = first_line - 1;
+	RTLIL_FRONTEND::current_design = design;
+	rtlil_frontend_yyparse(scanner);
+	RTLIL_FRONTEND::current_scanner = nullptr;
+	RTLIL_FRONTEND::current_design = nullptr;
+
+	rtlil_frontend_yylex_destroy(scanner);
+}
+
+struct rtlil_chunk_t {
+	size_t begin, end;
+	int line;
+};
+
+// Splits RTLIL text into the top-level `module ... end` blocks (each with the
+// attribute lines in front of it) and the remaining top-level statements.
+// Only the first word of each line is looked at, so this returns false for
+// anything unusual and the caller falls back to a single serial parse.
+static bool split_modules(const std::string &text, std::vector<rtlil_chunk_t> &modules, std::vector<rtlil_chunk_t> &others)
+{
+	size_t pos = 0, chunk_begin = 0;
+	int line = 1, chunk_line = 0, depth = 0;
+	bool pending_attributes = false;
+
+	while (pos < text.size())
+	{
+		size_t eol = text.find('\n', pos);
+		size_t next = eol == std::string::npos ? text.size() : eol + 1;
+
+		std::string word;
+		size_t word_begin = text.find_first_not_of(" \t\r", pos);
+		if (word_begin < next) {
+			size_t word_end = std::min(text.find_first_of(" \t\r\n", word_begin), next);
+			word = text.substr(word_begin, word_end - word_begin);
+		}
+
+		if (depth == 0) {
+			if (word == "module") {
+				if (!pending_attributes) {
+					chunk_begin = pos;
+					chunk_line = line;
+				}
+				pending_attributes = false;
+				depth = 1;
+			} else if (word == "attribute") {
+				if (!pending_attributes) {
+					chunk_begin = pos;
+					chunk_line = line;
+					pending_attributes = true;
+				}
+			} else if (word.empty() || word[0] == '#') {
+				/* nothing to parse */
+			} else if (pending_attributes) {
+				return false;
+			} else
+				others.push_back({pos, next, line});
+		} else {
+			if (word == "cell" || word == "process" || word == "switch")
+				depth++;
+			else if (word == "module")
+				return false;
+			else if (word == "end" && --depth == 0)
+				modules.push_back({chunk_begin, next, chunk_line});
+		}
+
+		pos = next;
+		line++;
+	}
+
+	return depth == 0 && !pending_attributes;
+}
+
+static bool parse_rtlil_parallel(const std::string &text, RTLIL::Design *design)
+{
+	std::vector<rtlil_chunk_t> module_chunks, other_chunks;
+	if (!split_modules(text, module_chunks, other_chunks))
+		return false;
+
+	for (auto &chunk : other_chunks) {
+		std::istringstream in(text.substr(chunk.begin, chunk.end - chunk.begin));
+		parse_rtlil(&in, chunk.line, design);
+	}
+
+	// every module is parsed into a private design, then added in file order
+	std::vector<RTLIL::Module*> modules(GetSize(module_chunks));
+	parallel_for(GetSize(module_chunks), [&](int i) {
+		RTLIL::Design chunk_design;
+		std::istringstream in(text.substr(module_chunks[i].begin, module_chunks[i].end - module_chunks[i].begin));
+		parse_rtlil(&in, module_chunks[i].line, &chunk_design);
+		log_assert(GetSize(chunk_design.modules_) == 1);
+		modules[i] = chunk_design.modules_.begin()->second;
+		chunk_design.modules_.clear();
+	});
+
+	for (auto module : modules)
+		RTLIL_FRONTEND::add_module(design, module);
+
+	log("Parsed %d modules on up to %d threads.\n", GetSize(modules), yosys_parallel_jobs);
+	return true;
+}
+
 struct RTLILFrontend : public Frontend {
 	RTLILFrontend() : Frontend("rtlil", "read modules from RTLIL file") { }
 	void help() override
@@ -55,12 +192,26 @@ struct RTLILFrontend : public Frontend {
 		log("    -lib\n");
 		log("        only create empty blackbox modules\n");
 		log("\n");
+		log("    -bin\n");
+		log("        read a binary RTLIL checkpoint as written by 'write_rtlil -bin'. Plain\n");
+		log("        files are memory mapped and only the modules that are loaded are\n");
+		log("        decoded.\n");
+		log("\n");
+		log("When synthesizer runs with -j <jobs>, the modules of a text RTLIL file are\n");
+		log("parsed concurrently and then added to the design in file order.\n");
+		log("\n");
+		log("    -module <name>\n");
+		log("        with -bin, only load the given module. The other modules in the file\n");
+		log("        are skipped without being decoded. Can be specified multiple times.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		RTLIL_FRONTEND::flag_nooverwrite = false;
 		RTLIL_FRONTEND::flag_overwrite = false;
 		RTLIL_FRONTEND::flag_lib = false;
+		bool flag_bin = false;
+		pool<RTLIL::IdString> only_modules;
 
 		log_header(design, "Executing RTLIL frontend.\n");
 
@@ -81,18 +232,48 @@ struct RTLILFrontend : public Frontend {
 				RTLIL_FRONTEND::flag_lib = true;
 				continue;
 			}
+			if (arg == "-bin") {
+				flag_bin = true;
+				continue;
+			}
+			if (arg == "-module" && argidx+1 < args.size()) {
+				only_modules.insert(RTLIL::escape_id(args[++argidx]));
+				continue;
+			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, flag_bin);
+
+		if (!only_modules.empty() && !flag_bin)
+			log_cmd_error("Option -module can only be used together with -bin.\n");
 
 		log("Input filename: %s\n", filename.c_str());
 
-		RTLIL_FRONTEND::lexin = f;
-		RTLIL_FRONTEND::current_design = design;
+		if (flag_bin) {
+			RTLIL_FRONTEND::read_design_binary(f, filename, design, only_modules);
+			return;
+		}
+
 		rtlil_frontend_yydebug = false;
-		rtlil_frontend_yyrestart(NULL);
-		rtlil_frontend_yyparse();
-		rtlil_frontend_yylex_destroy();
+
+		if (yosys_parallel_jobs > 1) {
+			// decompressed gzip input is already in memory
+			if (auto mem = dynamic_cast<MemoryIStream*>(f)) {
+				if (!parse_rtlil_parallel(mem->text(), design))
+					parse_rtlil(f, 1, design);
+				return;
+			}
+			std::stringstream buffer;
+			buffer << f->rdbuf();
+			std::string text = buffer.str();
+			if (parse_rtlil_parallel(text, design))
+				return;
+			std::istringstream in(text);
+			parse_rtlil(&in, 1, design);
+			return;
+		}
+
+		parse_rtlil(f, 1, design);
 	}
 } RTLILFrontend;
 
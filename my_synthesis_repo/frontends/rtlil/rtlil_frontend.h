@@ -30,22 +30,33 @@
 YOSYS_NAMESPACE_BEGIN
 
 namespace RTLIL_FRONTEND {
-	extern std::istream *lexin;
-	extern RTLIL::Design *current_design;
+	extern YS_THREAD_LOCAL void *current_scanner;
+	extern YS_THREAD_LOCAL int current_line_offset;
+	extern YS_THREAD_LOCAL RTLIL::Design *current_design;
 	extern bool flag_nooverwrite;
 	extern bool flag_overwrite;
 	extern bool flag_lib;
+
+	// adds a module read from a file to the design, following the rules for
+	// redefinitions set by the flags above; returns false and deletes the
+	// module if it was ignored
+	bool add_module(RTLIL::Design *design, RTLIL::Module *module);
+
+	// loads a binary RTLIL checkpoint (see rtlil_bin.h), mapping the file
+	// into memory when possible; if only_modules is not empty, all other
+	// modules in the file are skipped without being decoded
+	void read_design_binary(std::istream *f, std::string filename, RTLIL::Design *design, const pool<RTLIL::IdString> &only_modules);
 }
 
 YOSYS_NAMESPACE_END
 
 extern int rtlil_frontend_yydebug;
-int rtlil_frontend_yylex(void);
 void rtlil_frontend_yyerror(char const *s);
-void rtlil_frontend_yyrestart(FILE *f);
-int rtlil_frontend_yyparse(void);
-int rtlil_frontend_yylex_destroy(void);
-int rtlil_frontend_yyget_lineno(void);
+void rtlil_frontend_yyerror(void *scanner, char const *s);
+int rtlil_frontend_yyparse(void *scanner);
+int rtlil_frontend_yylex_init_extra(std::istream *in, void **scanner);
+int rtlil_frontend_yylex_destroy(void *scanner);
+int rtlil_frontend_yyget_lineno(void *scanner);
 
 #endif
 
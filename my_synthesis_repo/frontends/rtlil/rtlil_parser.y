@@ -29,18 +29,20 @@
 #include "frontends/rtlil/rtlil_frontend.h"
 YOSYS_NAMESPACE_BEGIN
 namespace RTLIL_FRONTEND {
-	std::istream *lexin;
-	RTLIL::Design *current_design;
-	RTLIL::Module *current_module;
-	RTLIL::Wire *current_wire;
-	RTLIL::Memory *current_memory;
-	RTLIL::Cell *current_cell;
-	RTLIL::Process *current_process;
-	std::vector<std::vector<RTLIL::SwitchRule*>*> switch_stack;
-	std::vector<RTLIL::CaseRule*> case_stack;
-	dict<RTLIL::IdString, RTLIL::Const> attrbuf;
+	// parser state is per thread, see read_rtlil -j
+	YS_THREAD_LOCAL void *current_scanner;
+	YS_THREAD_LOCAL int current_line_offset;
+	YS_THREAD_LOCAL RTLIL::Design *current_design;
+	YS_THREAD_LOCAL RTLIL::Module *current_module;
+	YS_THREAD_LOCAL RTLIL::Wire *current_wire;
+	YS_THREAD_LOCAL RTLIL::Memory *current_memory;
+	YS_THREAD_LOCAL RTLIL::Cell *current_cell;
+	YS_THREAD_LOCAL RTLIL::Process *current_process;
+	YS_THREAD_LOCAL std::vector<std::vector<RTLIL::SwitchRule*>*> switch_stack;
+	YS_THREAD_LOCAL std::vector<RTLIL::CaseRule*> case_stack;
+	YS_THREAD_LOCAL dict<RTLIL::IdString, RTLIL::Const> attrbuf;
 	bool flag_nooverwrite, flag_overwrite, flag_lib;
-	bool delete_current_module;
+	YS_THREAD_LOCAL bool delete_current_module;
 }
 using namespace RTLIL_FRONTEND;
 YOSYS_NAMESPACE_END
@@ -48,6 +50,9 @@ USING_YOSYS_NAMESPACE
 %}
 
 %define api.prefix {rtlil_frontend_yy}
+%define api.pure full
+%lex-param {void *scanner}
+%parse-param {void *scanner}
 
 /* The union is defined in the header, so we need to provide all the
  * includes it requires
@@ -58,6 +63,10 @@ USING_YOSYS_NAMESPACE
 #include "frontends/rtlil/rtlil_frontend.h"
 }
 
+%code provides {
+int rtlil_frontend_yylex(RTLIL_FRONTEND_YYSTYPE *yylval, void *scanner);
+}
+
 %union {
 	char *string;
 	int integer;
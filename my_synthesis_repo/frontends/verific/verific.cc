@@ -21,6 +21,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 #include "kernel/log.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -210,7 +211,7 @@ RTLIL::IdString VerificImporter::new_verific_id(Verific::DesignObj *obj)
 	std::string s = stringf("$verific$%s", obj->Name());
 	if (obj->Linefile())
 		s += stringf("$%s:%d", RTLIL::encode_filename(Verific::LineFile::GetFileName(obj->Linefile())).c_str(), Verific::LineFile::GetLineNo(obj->Linefile()));
-	s += stringf("$%d", autoidx++);
+	s += stringf("$%d", autoidx_local ? (*autoidx_local)++ : autoidx++);
 	return s;
 }
 
@@ -1606,7 +1607,7 @@ void VerificImporter::import_netlist(RTLIL::Design *design, Netlist *nl, std::ma
 						cell->parameters[ID::MEMID] = RTLIL::Const(memory->name.str());
 						cell->parameters[ID::ABITS] = 32;
 						cell->parameters[ID::WIDTH] = memory->width;
-						cell->parameters[ID::PRIORITY] = RTLIL::Const(autoidx-1);
+						cell->parameters[ID::PRIORITY] = RTLIL::Const((autoidx_local ? *autoidx_local : autoidx)-1);
 					}
 				}
 			}
@@ -2656,6 +2657,68 @@ struct VerificExtNets
 	}
 };
 
+// Imports the netlists in nl_todo and everything they instantiate, calling
+// import_one(design, nl, nl_todo) for each netlist not in nl_done yet.
+//
+// With parallel set, the netlists are imported in waves: all netlists known
+// at the start of a wave are imported concurrently, each into a private
+// design, and their modules are then added to the design in name order.
+// The netlists they instantiate form the next wave. This only reads the
+// Verific netlist database from the worker threads.
+static void verific_import_netlists(RTLIL::Design *design, std::map<std::string,Netlist*> &nl_todo, std::map<std::string,Netlist*> &nl_done,
+		bool parallel, const std::function<void(RTLIL::Design*, Netlist*, std::map<std::string,Netlist*>&)> &import_one)
+{
+	if (!parallel) {
+		while (!nl_todo.empty()) {
+			auto it = nl_todo.begin();
+			Netlist *nl = it->second;
+			if (nl_done.count(it->first) == 0) {
+				nl_done[it->first] = it->second;
+				import_one(design, nl, nl_todo);
+			}
+			nl_todo.erase(it);
+		}
+		return;
+	}
+
+	while (!nl_todo.empty())
+	{
+		std::vector<Netlist*> wave;
+		for (auto &it : nl_todo)
+			if (nl_done.count(it.first) == 0) {
+				nl_done[it.first] = it.second;
+				wave.push_back(it.second);
+			}
+		nl_todo.clear();
+
+		std::vector<RTLIL::Design*> wave_designs(GetSize(wave));
+		std::vector<std::map<std::string,Netlist*>> wave_todo(GetSize(wave));
+		parallel_for(GetSize(wave), [&](int i) {
+			wave_designs[i] = new RTLIL::Design;
+			import_one(wave_designs[i], wave[i], wave_todo[i]);
+		});
+
+		for (int i = 0; i < GetSize(wave); i++)
+		{
+			for (auto &it : wave_designs[i]->modules_) {
+				RTLIL::Module *module = it.second;
+				if (design->has(module->name)) {
+					if (!wave[i]->IsOperator() && !is_blackbox(wave[i]))
+						log_cmd_error("Re-definition of module `%s'.\n", log_id(module->name));
+					delete module;
+					continue;
+				}
+				design->add(module);
+			}
+			wave_designs[i]->modules_.clear();
+			delete wave_designs[i];
+
+			for (auto &it : wave_todo[i])
+				nl_todo.insert(it);
+		}
+	}
+}
+
 std::string verific_import(Design *design, const std::map<std::string,std::string> &parameters, std::string top)
 {
 	verific_sva_fsm_limit = 16;
@@ -2768,16 +2831,10 @@ std::string verific_import(Design *design, const std::map<std::string,std::strin
 	for (auto nl : nl_todo)
 		worker.run(nl.second);
 
-	while (!nl_todo.empty()) {
-		auto it = nl_todo.begin();
-		Netlist *nl = it->second;
-		if (nl_done.count(it->first) == 0) {
-			VerificImporter importer(false, false, false, false, false, false, false);
-			nl_done[it->first] = it->second;
-			importer.import_netlist(design, nl, nl_todo, nl->CellBaseName() == cell_name);
-		}
-		nl_todo.erase(it);
-	}
+	verific_import_netlists(design, nl_todo, nl_done, false, [&](RTLIL::Design *target, Netlist *nl, std::map<std::string,Netlist*> &todo) {
+		VerificImporter importer(false, false, false, false, false, false, false);
+		importer.import_netlist(target, nl, todo, nl->CellBaseName() == cell_name);
+	});
 
 #ifdef YOSYSHQ_VERIFIC_EXTENSIONS
 	VerificExtensions::Reset();
@@ -2989,6 +3046,11 @@ struct VerificPass : public Pass {
 		log("    Import all cell definitions from Verific loaded libraries even if they are\n");
 		log("    unused in design. Useful with \"-edif\" and \"-liberty\" option.\n");
 		log("\n");
+		log("  -parallel\n");
+		log("    Import the netlists on up to -j <jobs> threads. Netlists are imported\n");
+		log("    level by level down the hierarchy, each level concurrently, and their\n");
+		log("    modules are added to the design in a fixed order.\n");
+		log("\n");
 		log("  -chparam name value \n");
 		log("    Elaborate the specified top modules (all modules when -all given) using\n");
 		log("    this parameter value. Modules on which this parameter does not exist will\n");
@@ -3733,7 +3795,7 @@ struct VerificPass : public Pass {
 			std::map<std::string,Netlist*> nl_todo, nl_done;
 			bool mode_all = false, mode_gates = false, mode_keep = false;
 			bool mode_nosva = false, mode_names = false, mode_verific = false;
-			bool mode_autocover = false, mode_fullinit = false;
+			bool mode_autocover = false, mode_fullinit = false, mode_parallel = false;
 			bool flatten = false, extnets = false, mode_cells = false;
 			bool split_complex_ports = true;
 			string dumpfile;
@@ -3789,6 +3851,10 @@ struct VerificPass : public Pass {
 					mode_cells = true;
 					continue;
 				}
+				if (args[argidx] == "-parallel") {
+					mode_parallel = true;
+					continue;
+				}
 				if (args[argidx] == "-chparam"  && argidx+2 < GetSize(args)) {
 					const std::string &key = args[++argidx];
 					const std::string &value = args[++argidx];
@@ -4006,17 +4072,11 @@ struct VerificPass : public Pass {
 				veri_writer.WriteFile(dumpfile.c_str(), Netlist::PresentDesign());
 			}
 
-			while (!nl_todo.empty()) {
-				auto it = nl_todo.begin();
-				Netlist *nl = it->second;
-				if (nl_done.count(it->first) == 0) {
-					VerificImporter importer(mode_gates, mode_keep, mode_nosva,
-							mode_names, mode_verific, mode_autocover, mode_fullinit);
-					nl_done[it->first] = it->second;
-					importer.import_netlist(design, nl, nl_todo, top_mod_names.count(nl->CellBaseName()));
-				}
-				nl_todo.erase(it);
-			}
+			verific_import_netlists(design, nl_todo, nl_done, mode_parallel, [&](RTLIL::Design *target, Netlist *nl, std::map<std::string,Netlist*> &todo) {
+				VerificImporter importer(mode_gates, mode_keep, mode_nosva,
+						mode_names, mode_verific, mode_autocover, mode_fullinit);
+				importer.import_netlist(target, nl, todo, top_mod_names.count(nl->CellBaseName()));
+			});
 
 #ifdef YOSYSHQ_VERIFIC_EXTENSIONS
 			VerificExtensions::Reset();
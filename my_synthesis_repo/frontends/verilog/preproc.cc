@@ -36,6 +36,7 @@
 #include "verilog_frontend.h"
 #include "kernel/log.h"
 #include <assert.h>
+#include <mutex>
 #include <stack>
 #include <stdarg.h>
 #include <stdio.h>
@@ -46,9 +47,9 @@ std::vector<std::string> split_str(const std::string& str, char delimiter);
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
-static std::list<std::string> output_code;
-static std::list<std::string> input_buffer;
-static size_t input_buffer_charp;
+static YS_THREAD_LOCAL std::list<std::string> output_code;
+static YS_THREAD_LOCAL std::list<std::string> input_buffer;
+static YS_THREAD_LOCAL size_t input_buffer_charp;
 
 static void return_char(char ch)
 {
@@ -403,6 +404,16 @@ static void input_file(std::istream &f, std::string filename)
 	input_buffer.insert(it, "\n`file_pop\n");
 }
 
+static void input_file_content(const std::string &content, const std::string &filename)
+{
+	insert_input("");
+	auto it = input_buffer.begin();
+
+	input_buffer.insert(it, "`file_push \"" + filename + "\"\n");
+	input_buffer.insert(it, content);
+	input_buffer.insert(it, "\n`file_pop\n");
+}
+
 // Read tokens to get one argument (either a macro argument at a callsite or a default argument in a
 // macro definition). Writes the argument to dest. Returns true if we finished with ')' (the end of
 // the argument list); false if we finished with ','.
@@ -746,6 +757,127 @@ read_define(const std::string &filename,
 	}
 }
 
+// Process-wide cache of `include files, shared by all read_verilog calls. An
+// entry is reused as long as the file keeps its size and modification time.
+// Entries are never modified once they are in the cache, so a preprocessor
+// running on another thread ('read_verilog -parallel') can keep using an
+// entry that has been replaced in the meantime.
+struct include_cache_entry_t
+{
+	int64_t mtime = 0, size = 0;
+	std::string content;
+
+	// Set if the file holds nothing but `define directives and comments,
+	// optionally wrapped in one `ifndef include guard. Including such a file
+	// just adds these definitions (unless the guard is defined) instead of
+	// running its text through the preprocessor again.
+	bool define_only = false;
+	std::string guard;
+	define_map_t defines;
+};
+
+static std::map<std::string, std::shared_ptr<const include_cache_entry_t>> include_cache;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex include_cache_mutex;
+#endif
+
+static void scan_define_only(include_cache_entry_t &entry, const std::string &filename)
+{
+	// run the tokenizer on the file content in isolation
+	std::list<std::string> saved_input, saved_output;
+	std::swap(saved_input, input_buffer);
+	std::swap(saved_output, output_code);
+	size_t saved_charp = input_buffer_charp;
+	input_buffer_charp = 0;
+
+	define_map_t scratch;
+	entry.defines.clear();
+	entry.guard.clear();
+
+	bool ok = true, in_guard = false, guard_closed = false, seen_define = false;
+	insert_input(entry.content);
+	while (ok && !input_buffer.empty())
+	{
+		std::string tok = next_token();
+		if (tok.empty() || all_white(tok))
+			continue;
+		if (guard_closed) {
+			ok = false;
+		} else if (tok.compare(0, 2, "/*") == 0) {
+			// translate_off and friends must reach the lexer
+			if (tok.find("synopsys") != std::string::npos || tok.find("synthesis") != std::string::npos)
+				ok = false;
+		} else if (tok == "`ifndef" && !in_guard && !seen_define && entry.guard.empty()) {
+			skip_spaces();
+			entry.guard = next_token(true);
+			in_guard = !entry.guard.empty();
+			ok = in_guard;
+		} else if (tok == "`endif" && in_guard) {
+			in_guard = false;
+			guard_closed = true;
+		} else if (tok == "`define") {
+			seen_define = true;
+			read_define(filename, entry.defines, scratch);
+		} else
+			ok = false;
+	}
+
+	entry.define_only = ok && !in_guard;
+	if (!entry.define_only) {
+		entry.defines.clear();
+		entry.guard.clear();
+	}
+
+	std::swap(saved_input, input_buffer);
+	std::swap(saved_output, output_code);
+	input_buffer_charp = saved_charp;
+}
+
+// Returns the cache entry for an include file, reading it if it is new or has
+// changed since it was cached. Returns nullptr if the file cannot be read.
+static std::shared_ptr<const include_cache_entry_t> load_include(const std::string &filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) < 0 || (st.st_mode & S_IFMT) != S_IFREG)
+		return nullptr;
+
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(include_cache_mutex);
+#endif
+		auto it = include_cache.find(filename);
+		if (it != include_cache.end() && it->second->mtime == int64_t(st.st_mtime) && it->second->size == int64_t(st.st_size))
+			return it->second;
+	}
+
+	std::shared_ptr<include_cache_entry_t> entry(new include_cache_entry_t);
+	entry->mtime = st.st_mtime;
+	entry->size = st.st_size;
+	if (st.st_size > 0) {
+		MappedFile mapped;
+		if (!mapped.map(filename))
+			return nullptr;
+		entry->content.assign(mapped.data, mapped.size);
+	}
+	scan_define_only(*entry, filename);
+
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(include_cache_mutex);
+#endif
+	include_cache[filename] = entry;
+	return entry;
+}
+
+// Records an include file in yosys_input_files, which preprocessors running
+// in parallel share.
+static void add_input_file(const std::string &filename)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(include_cache_mutex);
+#endif
+	yosys_input_files.insert(filename);
+}
+
 std::string
 frontend_verilog_preproc(std::istream                 &f,
                          std::string                   filename,
@@ -877,11 +1009,9 @@ frontend_verilog_preproc(std::istream                 &f,
 #ifdef HYBRDLINK
 			rewrite_filename_to_pb(fn);
 #endif
-			std::ifstream ff;
-			ff.clear();
 			std::string fixed_fn = fn;
-			ff.open(fixed_fn.c_str());
-			
+			std::shared_ptr<const include_cache_entry_t> entry = load_include(fixed_fn);
+
 			bool filename_path_sep_found;
 			bool fn_relative;
 #ifdef _WIN32
@@ -894,43 +1024,49 @@ frontend_verilog_preproc(std::istream                 &f,
 			fn_relative = (fn[0] != '/');
 #endif
 
-			if (ff.fail() && fn.size() > 0 && fn_relative && filename_path_sep_found) {
+			if (entry == nullptr && fn.size() > 0 && fn_relative && filename_path_sep_found) {
 				// if the include file was not found, it is not given with an absolute path, and the
 				// currently read file is given with a path, then try again relative to its directory
-				ff.clear();
 #ifdef _WIN32
 				fixed_fn = filename.substr(0, filename.find_last_of("/\\")+1) + fn;
 #else
 				fixed_fn = filename.substr(0, filename.rfind('/')+1) + fn;
 #endif
-				ff.open(fixed_fn);
+				entry = load_include(fixed_fn);
 			}
-			if (ff.fail() && fn.size() > 0 && fn_relative) {
+			if (entry == nullptr && fn.size() > 0 && fn_relative) {
 				// if the include file was not found and it is not given with an absolute path, then
 				// search it in the include path
 				for (auto incdir : include_dirs) {
-					ff.clear();
 					fixed_fn = incdir + '/' + fn;
-					ff.open(fixed_fn);
-					if (!ff.fail()) break;
+					entry = load_include(fixed_fn);
+					if (entry != nullptr) break;
 				}
 			}
-			if (ff.fail()) {
+			if (entry == nullptr) {
 				output_code.push_back("`file_notfound " + fn);
 			} else {
 				// =============== 对 pb 进行解密 ===================
-				std::istringstream *iss = nullptr;
 				std::vector<std::string> temp_words = split_str(fixed_fn.c_str(),'.');
-				size_t surfix_length = temp_words[temp_words.size() -1].length();
-				
+
 				if (temp_words[temp_words.size() -1] == "pb"){
+					std::istringstream *iss = nullptr;
+					std::ifstream ff(fixed_fn.c_str());
 					Frontend::decrypt_pb_content_stringstream(ff, iss);
 					input_file(*iss, fixed_fn);
+				} else if (entry->define_only) {
+					// nothing but definitions: apply them without re-reading the text
+					if (entry->guard.empty() || !defines.find(entry->guard)) {
+						for (auto &it : entry->defines.defines) {
+							defines.add(it.first, *it.second);
+							global_defines_cache.add(it.first, *it.second);
+						}
+					}
 				} else {
-					input_file(ff, fixed_fn);
+					input_file_content(entry->content, fixed_fn);
 				}
 				// =============== 对 pb 进行解密 结束=================
-				yosys_input_files.insert(fixed_fn);
+				add_input_file(fixed_fn);
 			}
 			continue;
 		}
@@ -29,6 +29,7 @@
 #include "verilog_frontend.h"
 #include "preproc.h"
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include <stdarg.h>
 
@@ -50,7 +51,7 @@ static void error_on_dpi_function(AST::AstNode *node)
 		error_on_dpi_function(child);
 }
 
-static void add_package_types(dict<std::string, AST::AstNode *> &user_types, std::vector<AST::AstNode *> &package_list)
+static void add_package_types(dict<std::string, AST::AstNode *> &user_types, const std::vector<AST::AstNode *> &package_list)
 {
 	// prime the parser's user type lookup table with the package qualified names
 	// of typedefed names in the packages seen so far.
@@ -65,6 +66,94 @@ static void add_package_types(dict<std::string, AST::AstNode *> &user_types, std
 	}
 }
 
+static int get_scanner_line_num()
+{
+	return current_scanner ? frontend_verilog_yyget_lineno(current_scanner) : 0;
+}
+
+static void set_scanner_line_num(int line)
+{
+	if (current_scanner)
+		frontend_verilog_yyset_lineno(line, current_scanner);
+}
+
+static bool is_pb_filename(const std::string &filename)
+{
+	std::vector<std::string> words = split_str(filename, '.');
+	return !words.empty() && words.back() == "pb";
+}
+
+// Preprocesses and parses one file into a new AST_DESIGN node. This only uses
+// the parser state of the calling thread and reads the packages and globals of
+// the design, so several files can be parsed at the same time as long as each
+// has its own global_defines.
+static AST::AstNode *parse_verilog(std::istream *f, const std::string &filename, bool flag_nopp, bool flag_ppdump,
+		const define_map_t &defines_map, define_map_t &global_defines, const std::list<std::string> &include_dirs,
+		RTLIL::Design *design)
+{
+	AST::current_filename = filename;
+	current_ast = new AST::AstNode(AST::AST_DESIGN);
+
+	std::istream *lexin = f;
+	std::string code_after_preproc;
+
+	if (!flag_nopp) {
+		code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, global_defines, include_dirs);
+		if (flag_ppdump)
+			log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
+		lexin = new std::istringstream(code_after_preproc);
+	}
+
+	// make package typedefs available to parser
+	add_package_types(pkg_user_types, design->verilog_packages);
+
+	UserTypeMap global_types_map;
+	for (auto def : design->verilog_globals) {
+		if (def->type == AST::AST_TYPEDEF) {
+			global_types_map[def->str] = def;
+		}
+	}
+
+	log_assert(user_type_stack.empty());
+	// use previous global typedefs as bottom level of user type stack
+	user_type_stack.push_back(std::move(global_types_map));
+	// add a new empty type map to allow overriding existing global definitions
+	user_type_stack.push_back(UserTypeMap());
+
+	void *scanner;
+	frontend_verilog_yylex_init_extra(lexin, &scanner);
+	frontend_verilog_yyset_lineno(1, scanner);
+
+	current_scanner = scanner;
+	frontend_verilog_yyparse(scanner);
+	current_scanner = nullptr;
+
+	frontend_verilog_yylex_destroy(scanner);
+
+	if (!flag_nopp)
+		delete lexin;
+
+	// only the previous and new global type maps remain
+	log_assert(user_type_stack.size() == 2);
+	user_type_stack.clear();
+
+	AST::AstNode *ast = current_ast;
+	current_ast = NULL;
+	return ast;
+}
+
+// one file of a read_verilog command
+struct parse_job_t
+{
+	std::istream *f;
+	std::string filename;
+	define_map_t global_defines;
+	AST::AstNode *ast = nullptr;
+	bool default_nettype_wire = true;
+
+	parse_job_t(std::istream *f, const std::string &filename) : f(f), filename(filename) { }
+};
+
 struct VerilogFrontend : public Frontend {
 	VerilogFrontend() : Frontend("verilog", "read modules from Verilog file") { }
 	void help() override
@@ -204,6 +293,14 @@ struct VerilogFrontend : public Frontend {
 		log("    -overwrite\n");
 		log("        overwrite existing modules with the same name\n");
 		log("\n");
+		log("    -parallel\n");
+		log("        when several files are given, preprocess and parse them at the same\n");
+		log("        time on up to the number of threads set with 'yosys -j', then convert\n");
+		log("        their ASTs one file after another in the order of the files. Each\n");
+		log("        file only sees the `define and package declarations read by earlier\n");
+		log("        commands, not those of the other files of the same command. Files\n");
+		log("        with the .pb suffix are always read one at a time.\n");
+		log("\n");
 		log("    -defer\n");
 		log("        only read the abstract syntax tree and defer actual compilation\n");
 		log("        to a later 'hierarchy' command. Useful in cases where the default\n");
@@ -264,6 +361,7 @@ struct VerilogFrontend : public Frontend {
 		bool flag_noblackbox = false;
 		bool flag_nowb = false;
 		bool flag_nosynthesis = false;
+		bool flag_parallel = false;
 		define_map_t defines_map;
 
 		std::list<std::string> include_dirs;
@@ -429,6 +527,10 @@ struct VerilogFrontend : public Frontend {
 				flag_defer = true;
 				continue;
 			}
+			if (arg == "-parallel") {
+				flag_parallel = true;
+				continue;
+			}
 			if (arg == "-noautowire") {
 				default_nettype_wire = false;
 				continue;
@@ -482,79 +584,97 @@ struct VerilogFrontend : public Frontend {
 
 #ifdef HYBRDLINK
 		// 除用户design外，其他的文件都是原语库（pb），反之亦然，pb文件都是原语库文件，因此这里可通过if_bin_input判断
-		// 这里 flag_is_pb_file 是全局变量，在yosys.h中定义，如果想通过参数传递到 judge_design_element_is_hybrdchip 函数中，影响所有调用verilog parser的环节，不建议修改
+		// 这里 flag_is_pb_file 是全局变量，在yosys.h中定义，如果想通过参数传递到 find_design_element 函数中，影响所有调用verilog parser的环节，不建议修改
 		flag_is_pb_file = if_bin_input; 
-		log_header(design, "Executing Verilog-2005 parser: %s\n", filename.c_str());
-		if(log_verbose_level > 9){
-		log("Parsing %s%s input from `%s' to synth-mid representation 1.\n",
-				formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
-		}
-#else
-		log_header(design, "Executing Verilog-2005 frontend: %s\n", filename.c_str());
-		log("Parsing %s%s input from `%s' to AST representation.\n",
-				formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
 #endif // HYBRDLINK
 
-		AST::current_filename = filename;
-		AST::set_line_num = &frontend_verilog_yyset_lineno;
-		AST::get_line_num = &frontend_verilog_yyget_lineno;
-
-		current_ast = new AST::AstNode(AST::AST_DESIGN);
-
-		lexin = f;
-		std::string code_after_preproc;
-
-		if (!flag_nopp) {
-			code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, *design->verilog_defines, include_dirs);
-			if (flag_ppdump)
-				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
-			lexin = new std::istringstream(code_after_preproc);
+		std::vector<std::unique_ptr<parse_job_t>> jobs;
+		std::vector<std::unique_ptr<std::istream>> extra_files;
+		jobs.emplace_back(new parse_job_t(f, filename));
+
+		// collect the remaining files of the command (but no .pb files, these
+		// are read one at a time by the following calls of execute())
+		if (flag_parallel && !if_bin_input) {
+			while (!next_args.empty() && !is_pb_filename(next_args[argidx])) {
+				std::vector<std::string> file_args = next_args;
+				std::istream *ff = nullptr;
+				std::string ff_name;
+				extra_args(ff, ff_name, file_args, argidx, false);
+				extra_files.emplace_back(ff);
+				jobs.emplace_back(new parse_job_t(ff, ff_name));
+			}
 		}
 
-		// make package typedefs available to parser
-		add_package_types(pkg_user_types, design->verilog_packages);
+		AST::set_line_num = &set_scanner_line_num;
+		AST::get_line_num = &get_scanner_line_num;
 
-		UserTypeMap global_types_map;
-		for (auto def : design->verilog_globals) {
-			if (def->type == AST::AST_TYPEDEF) {
-				global_types_map[def->str] = def;
+		if (GetSize(jobs) == 1) {
+#ifdef HYBRDLINK
+			log_header(design, "Executing Verilog-2005 parser: %s\n", filename.c_str());
+			if(log_verbose_level > 9){
+			log("Parsing %s%s input from `%s' to synth-mid representation 1.\n",
+					formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
 			}
-		}
+#else
+			log_header(design, "Executing Verilog-2005 frontend: %s\n", filename.c_str());
+			log("Parsing %s%s input from `%s' to AST representation.\n",
+					formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
+#endif // HYBRDLINK
 
-		log_assert(user_type_stack.empty());
-		// use previous global typedefs as bottom level of user type stack
-		user_type_stack.push_back(std::move(global_types_map));
-		// add a new empty type map to allow overriding existing global definitions
-		user_type_stack.push_back(UserTypeMap());
-
-		frontend_verilog_yyset_lineno(1);
-		frontend_verilog_yyrestart(NULL);
-		frontend_verilog_yyparse();
-		frontend_verilog_yylex_destroy();
-
-		for (auto &child : current_ast->children) {
-			if (child->type == AST::AST_MODULE)
-				for (auto &attr : attributes)
-					if (child->attributes.count(attr) == 0)
-						child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
+			parse_job_t &job = *jobs.front();
+			job.ast = parse_verilog(job.f, job.filename, flag_nopp, flag_ppdump, defines_map,
+					*design->verilog_defines, include_dirs, design);
+			job.default_nettype_wire = default_nettype_wire;
+		} else {
+			log_header(design, "Executing Verilog-2005 frontend: %d files\n", GetSize(jobs));
+
+			// each file starts out with the same definitions and mode, and
+			// its `define directives are merged in file order below
+			bool start_nettype_wire = default_nettype_wire;
+			for (auto &job : jobs)
+				job->global_defines.merge(*design->verilog_defines);
+
+			parallel_for(GetSize(jobs), [&](int i) {
+				parse_job_t &job = *jobs[i];
+#ifdef HYBRDLINK
+				if(log_verbose_level > 9){
+				log("Parsing %s%s input from `%s' to synth-mid representation 1.\n",
+						formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", job.filename.c_str());
+				}
+#else
+				log("Parsing %s%s input from `%s' to AST representation.\n",
+						formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", job.filename.c_str());
+#endif // HYBRDLINK
+				default_nettype_wire = start_nettype_wire;
+				job.ast = parse_verilog(job.f, job.filename, flag_nopp, flag_ppdump, defines_map,
+						job.global_defines, include_dirs, design);
+				job.default_nettype_wire = default_nettype_wire;
+			});
+
+			for (auto &job : jobs)
+				design->verilog_defines->merge(job->global_defines);
 		}
 
-		if (flag_nodpi)
-			error_on_dpi_function(current_ast);
-
-		AST::process(design, current_ast, flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
-				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire);
+		for (auto &job : jobs)
+		{
+			for (auto &child : job->ast->children) {
+				if (child->type == AST::AST_MODULE)
+					for (auto &attr : attributes)
+						if (child->attributes.count(attr) == 0)
+							child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
+			}
 
+			if (flag_nodpi)
+				error_on_dpi_function(job->ast);
 
-		if (!flag_nopp)
-			delete lexin;
+			AST::current_filename = job->filename;
+			AST::process(design, job->ast, flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
+					flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, job->default_nettype_wire);
 
-		// only the previous and new global type maps remain
-		log_assert(user_type_stack.size() == 2);
-		user_type_stack.clear();
+			delete job->ast;
+			job->ast = nullptr;
+		}
 
-		delete current_ast;
-		current_ast = NULL;
 		if(log_verbose_level > 9)
 			log("Successfully finished Verilog frontend.\n");
 	}
@@ -704,7 +824,7 @@ void frontend_verilog_yyerror(char const *fmt, ...)
 	p += vsnprintf(p, buffer + sizeof(buffer) - p, fmt, ap);
 	va_end(ap);
 	p += snprintf(p, buffer + sizeof(buffer) - p, "\n");
-	YOSYS_NAMESPACE_PREFIX log_file_error(YOSYS_NAMESPACE_PREFIX AST::current_filename, frontend_verilog_yyget_lineno(),
+	YOSYS_NAMESPACE_PREFIX log_file_error(YOSYS_NAMESPACE_PREFIX AST::current_filename, frontend_verilog_yyget_lineno(YOSYS_NAMESPACE_PREFIX VERILOG_FRONTEND::current_scanner),
 					      "%s", buffer);
 	exit(1);
 }
@@ -719,7 +839,7 @@ void frontend_verilog_yyerror(char const *fmt, LogData& logdata, ...)
 	p += vsnprintf(p, buffer + sizeof(buffer) - p, fmt, ap);
 	va_end(ap);
 	p += snprintf(p, buffer + sizeof(buffer) - p, "\n");
-	YOSYS_NAMESPACE_PREFIX log_file_error(YOSYS_NAMESPACE_PREFIX AST::current_filename, frontend_verilog_yyget_lineno(),
+	YOSYS_NAMESPACE_PREFIX log_file_error(YOSYS_NAMESPACE_PREFIX AST::current_filename, frontend_verilog_yyget_lineno(YOSYS_NAMESPACE_PREFIX VERILOG_FRONTEND::current_scanner),
 					       logdata, "%s", buffer);
 	exit(1);
 }
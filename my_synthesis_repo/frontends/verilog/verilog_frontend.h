@@ -40,20 +40,20 @@ YOSYS_NAMESPACE_BEGIN
 namespace VERILOG_FRONTEND
 {
 	// this variable is set to a new AST_DESIGN node and then filled with the AST by the bison parser
-	extern struct AST::AstNode *current_ast;
+	extern YS_THREAD_LOCAL struct AST::AstNode *current_ast;
 
 	// this function converts a Verilog constant to an AST_CONSTANT node
 	AST::AstNode *const2ast(std::string code, char case_type = 0, bool warn_z = false);
 
 	// names of locally typedef'ed types in a stack
 	typedef std::map<std::string, AST::AstNode*> UserTypeMap;
-	extern std::vector<UserTypeMap> user_type_stack;
+	extern YS_THREAD_LOCAL std::vector<UserTypeMap> user_type_stack;
 
 	// names of package typedef'ed types
-	extern dict<std::string, AST::AstNode*> pkg_user_types;
+	extern YS_THREAD_LOCAL dict<std::string, AST::AstNode*> pkg_user_types;
 
 	// state of `default_nettype
-	extern bool default_nettype_wire;
+	extern YS_THREAD_LOCAL bool default_nettype_wire;
 
 	// running in SystemVerilog mode
 	extern bool sv_mode;
@@ -82,8 +82,8 @@ namespace VERILOG_FRONTEND
 	// running in -specify mode
 	extern bool specify_mode;
 
-	// lexer input stream
-	extern std::istream *lexin;
+	// the flex scanner of the file that is parsed by this thread
+	extern YS_THREAD_LOCAL void *current_scanner;
 }
 
 YOSYS_NAMESPACE_END
@@ -93,10 +93,10 @@ extern int frontend_verilog_yydebug;
 void frontend_verilog_yyerror(char const *fmt, ...);
 // 带进程通信的Verilog parser log
 void frontend_verilog_yyerror(char const *fmt, LogData& logdata, ...);
-void frontend_verilog_yyrestart(FILE *f);
-int frontend_verilog_yyparse(void);
-int frontend_verilog_yylex_destroy(void);
-int frontend_verilog_yyget_lineno(void);
-void frontend_verilog_yyset_lineno (int);
+int frontend_verilog_yyparse(void *scanner);
+int frontend_verilog_yylex_init_extra(std::istream *in, void **scanner);
+int frontend_verilog_yylex_destroy(void *scanner);
+int frontend_verilog_yyget_lineno(void *scanner);
+void frontend_verilog_yyset_lineno(int line_number, void *scanner);
 
 #endif
@@ -54,27 +54,28 @@ using namespace VERILOG_FRONTEND;
 
 YOSYS_NAMESPACE_BEGIN
 namespace VERILOG_FRONTEND {
-	int port_counter;
-	dict<std::string, int> port_stubs;
-	dict<IdString, AstNode*> *attr_list, default_attr_list;
-	std::stack<dict<IdString, AstNode*> *> attr_list_stack;
-	dict<IdString, AstNode*> *albuf;
-	std::vector<UserTypeMap> user_type_stack;
-	dict<std::string, AstNode*> pkg_user_types;
-	std::vector<AstNode*> ast_stack;
-	struct AstNode *astbuf1, *astbuf2, *astbuf3;
-	struct AstNode *current_function_or_task;
-	struct AstNode *current_ast, *current_ast_mod;
-	int current_function_or_task_port_id;
-	std::vector<char> case_type_stack;
-	bool do_not_require_port_stubs;
-	bool default_nettype_wire;
+	// parser state is per thread, see read_verilog -parallel
+	YS_THREAD_LOCAL void *current_scanner;
+	YS_THREAD_LOCAL int port_counter;
+	YS_THREAD_LOCAL dict<std::string, int> port_stubs;
+	YS_THREAD_LOCAL dict<IdString, AstNode*> *attr_list, default_attr_list;
+	YS_THREAD_LOCAL std::stack<dict<IdString, AstNode*> *> attr_list_stack;
+	YS_THREAD_LOCAL dict<IdString, AstNode*> *albuf;
+	YS_THREAD_LOCAL std::vector<UserTypeMap> user_type_stack;
+	YS_THREAD_LOCAL dict<std::string, AstNode*> pkg_user_types;
+	YS_THREAD_LOCAL std::vector<AstNode*> ast_stack;
+	YS_THREAD_LOCAL struct AstNode *astbuf1, *astbuf2, *astbuf3;
+	YS_THREAD_LOCAL struct AstNode *current_function_or_task;
+	YS_THREAD_LOCAL struct AstNode *current_ast, *current_ast_mod;
+	YS_THREAD_LOCAL int current_function_or_task_port_id;
+	YS_THREAD_LOCAL std::vector<char> case_type_stack;
+	YS_THREAD_LOCAL bool do_not_require_port_stubs;
+	YS_THREAD_LOCAL bool default_nettype_wire;
 	bool sv_mode, formal_mode, lib_mode, specify_mode;
 	bool noassert_mode, noassume_mode, norestrict_mode;
 	bool assume_asserts_mode, assert_assumes_mode;
-	bool current_wire_rand, current_wire_const;
-	bool current_modport_input, current_modport_output;
-	std::istream *lexin;
+	YS_THREAD_LOCAL bool current_wire_rand, current_wire_const;
+	YS_THREAD_LOCAL bool current_modport_input, current_modport_output;
 }
 YOSYS_NAMESPACE_END
 
@@ -90,7 +91,14 @@ YOSYS_NAMESPACE_END
     (LHS).last_line = (END).last_line; \
     (LHS).last_column = (END).last_column; } while(0)
 
-int frontend_verilog_yylex(YYSTYPE *yylval_param, YYLTYPE *yyloc_param);
+int frontend_verilog_yylex(YYSTYPE *yylval_param, YYLTYPE *yyloc_param, void *scanner);
+
+// the yyerror function called by bison itself, the rules use the printf-like
+// frontend_verilog_yyerror() from verilog_frontend.cc
+static void frontend_verilog_yyerror(YYLTYPE *, void *, char const *msg)
+{
+	frontend_verilog_yyerror("%s", msg);
+}
 
 static void append_attr(AstNode *ast, dict<IdString, AstNode*> *al)
 {
@@ -275,7 +283,7 @@ static void rewriteGenForDeclInit(AstNode *loop)
 
 	// create a unique name for the genvar
 	std::string old_str = decl->str;
-	std::string new_str = stringf("$genfordecl$%d$%s", autoidx++, old_str.c_str());
+	std::string new_str = stringf("$genfordecl$%d$%s", next_autoidx(), old_str.c_str());
 
 	// rename and move the genvar declaration to the containing description
 	decl->str = new_str;
@@ -366,42 +374,23 @@ static const AstNode *addAsgnBinopStmt(dict<IdString, AstNode*> *attr, AstNode *
 }
 
 #ifdef HYBRDLINK
-static const std::string get_design_element_name(const std::string& primitive_name)
+// 查找原语对应的设计元素名称，非hybrdchip原语时返回nullptr
+static const RTLIL::IdString *find_design_element(const std::string& primitive_name)
 {
-	std::string design_element_name = primitive_name;
-	if(!map_hybrdchip_2_xilinx.empty())
-	{
-        auto it = map_hybrdchip_2_xilinx.find(primitive_name);
-        if(it != map_hybrdchip_2_xilinx.end())
-		{
-			design_element_name = it->second;
-		}
-	}
-	return design_element_name;
-} 
-
-// 判断传入原语是否为hybrdchip原语
-static bool judge_design_element_is_hybrdchip(const std::string& primitive_name)
-{
-	std::string design_element_name = primitive_name;
-	std::cout << primitive_name << std::endl;
-	if(!map_hybrdchip_2_xilinx.empty())
-	{
-		auto it = map_hybrdchip_2_xilinx.find(primitive_name);
-		if(it != map_hybrdchip_2_xilinx.end()) {
-			// 是hybrdchip
-			return true;
-		}
-	}
-	// 非hybrdchip原语
-	return false;
-} 
+	const dict<RTLIL::IdString, RTLIL::IdString> &table = hybrdchip_primitive_map();
+	auto it = table.find(RTLIL::IdString(primitive_name));
+	if (it != table.end())
+		return &it->second;
+	return nullptr;
+}
 #endif
 
 %}
 
 %define api.prefix {frontend_verilog_yy}
 %define api.pure
+%lex-param {void *scanner}
+%parse-param {void *scanner}
 
 /* The union is defined in the header, so we need to provide all the
  * includes it requires
@@ -1273,7 +1262,7 @@ specify_item:
 
 		AstNode *cell = new AstNode(AST_CELL);
 		ast_stack.back()->children.push_back(cell);
-		cell->str = stringf("$specify$%d", autoidx++);
+		cell->str = stringf("$specify$%d", next_autoidx());
 		cell->children.push_back(new AstNode(AST_CELLTYPE));
 		cell->children.back()->str = target->dat ? "$specify3" : "$specify2";
 		SET_AST_NODE_LOC(cell, en_expr ? @1 : @2, @10);
@@ -1362,7 +1351,7 @@ specify_item:
 
 		AstNode *cell = new AstNode(AST_CELL);
 		ast_stack.back()->children.push_back(cell);
-		cell->str = stringf("$specify$%d", autoidx++);
+		cell->str = stringf("$specify$%d", next_autoidx());
 		cell->children.push_back(new AstNode(AST_CELLTYPE));
 		cell->children.back()->str = "$specrule";
 		SET_AST_NODE_LOC(cell, @1, @14);
@@ -2210,18 +2199,19 @@ cell_stmt:
 		// 2) flag_enable_compatibility_mode == false：表示关闭了兼容模式，此时仅支持hybrdchip原语；
 		// 
 		// 此时需要判断设计中的原语是否为hybrdchip而不是其他厂商的
-		// judge_design_element_is_hybrdchip(string): 这里传入一个string类型的原语名称，根据映射关系判断原语是否属于hybrdchip
+		// find_design_element(string): 这里传入一个string类型的原语名称，根据映射关系判断原语是否属于hybrdchip
 
+		const RTLIL::IdString *design_element = find_design_element(*$2);
 		if (!flag_is_pb_file && 
 			!flag_enable_compatibility_mode && 
-			!judge_design_element_is_hybrdchip(*$2)) {
+			design_element == nullptr) {
 			LogData logEntry = LogData::CreateLogStruct(
 						LevelCode::ERROR_LOG,
 						LogCategory::SYNTHESIS,
 						"verilog parser");
 			frontend_verilog_yyerror("Unsupported primitive types.",logEntry);
 		}
-        astbuf1->children[0]->str = get_design_element_name(*$2);
+        astbuf1->children[0]->str = design_element ? design_element->str() : *$2;
 #else
         astbuf1->children[0]->str = *$2;
 #endif
@@ -2818,7 +2808,7 @@ for_initialization:
 		// inject a wrapping block to declare the loop variable and
 		// contain the current loop
 		AstNode *wrapper = new AstNode(AST_BLOCK);
-		wrapper->str = "$fordecl_block$" + std::to_string(autoidx++);
+		wrapper->str = "$fordecl_block$" + std::to_string(next_autoidx());
 		wrapper->children.push_back(wire);
 		wrapper->children.push_back(loop);
 		parent->children.back() = wrapper; // replaces `loop`
@@ -2873,7 +2863,7 @@ behavioral_stmt:
 		    for (const AstNode* child : node->children)
 			if (child->type == AST_WIRE || child->type == AST_MEMORY || child->type == AST_PARAMETER
 				|| child->type == AST_LOCALPARAM || child->type == AST_TYPEDEF) {
-			    node->str = "$unnamed_block$" + std::to_string(autoidx++);
+			    node->str = "$unnamed_block$" + std::to_string(next_autoidx());
 			    break;
 			}
 		SET_AST_NODE_LOC(ast_stack.back(), @2, @8);
@@ -2890,7 +2880,7 @@ behavioral_stmt:
 		ast_stack.back()->children.push_back($7);
 	} ';' simple_behavioral_stmt ')' {
 		AstNode *block = new AstNode(AST_BLOCK);
-		block->str = "$for_loop$" + std::to_string(autoidx++);
+		block->str = "$for_loop$" + std::to_string(next_autoidx());
 		ast_stack.back()->children.push_back(block);
 		ast_stack.push_back(block);
 	} behavioral_stmt {
@@ -0,0 +1,176 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/arena.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+struct ObjectArena::Slab
+{
+	char *data;
+	int live;
+};
+
+static const size_t slot_align = alignof(std::max_align_t);
+
+static size_t align_up(size_t size)
+{
+	return (size + slot_align - 1) & ~(slot_align - 1);
+}
+
+static size_t header_size()
+{
+	struct header_t { void *arena, *slab; };
+	return align_up(sizeof(header_t));
+}
+
+ObjectArena::ObjectArena(size_t object_size) : refcount(1), live_objects(0)
+{
+	log_assert(sizeof(SlotHeader) <= header_size());
+	slot_size = header_size() + align_up(object_size);
+}
+
+ObjectArena::~ObjectArena()
+{
+	log_assert(live_objects == 0);
+	for (auto slab : slabs) {
+		free(slab->data);
+		delete slab;
+	}
+}
+
+ObjectArena *ObjectArena::create(size_t object_size)
+{
+	return new ObjectArena(object_size);
+}
+
+void ObjectArena::release()
+{
+	unref();
+}
+
+void ObjectArena::unref()
+{
+	int left = --refcount;
+	log_assert(left >= 0);
+	if (left == 0)
+		delete this;
+}
+
+void ObjectArena::add_slab()
+{
+	Slab *slab = new Slab;
+	slab->data = (char*)malloc(slot_size * slab_slots);
+	if (slab->data == nullptr) {
+		delete slab;
+		throw std::bad_alloc();
+	}
+	slab->live = 0;
+	slabs.push_back(slab);
+
+	// pushed in reverse so that slots are handed out in address order
+	for (int i = slab_slots-1; i >= 0; i--) {
+		SlotHeader *header = (SlotHeader*)(slab->data + i * slot_size);
+		header->arena = this;
+		header->slab = slab;
+		free_slots.push_back(header);
+	}
+}
+
+void *ObjectArena::allocate()
+{
+	if (free_slots.empty())
+		add_slab();
+
+	SlotHeader *header = free_slots.back();
+	free_slots.pop_back();
+
+	header->slab->live++;
+	live_objects++;
+	refcount++;
+	return (char*)header + header_size();
+}
+
+void *ObjectArena::heap_allocate(size_t object_size)
+{
+	SlotHeader *header = (SlotHeader*)malloc(header_size() + object_size);
+	if (header == nullptr)
+		throw std::bad_alloc();
+	header->arena = nullptr;
+	header->slab = nullptr;
+	return (char*)header + header_size();
+}
+
+void ObjectArena::deallocate(void *ptr)
+{
+	if (ptr == nullptr)
+		return;
+
+	SlotHeader *header = (SlotHeader*)((char*)ptr - header_size());
+	ObjectArena *arena = header->arena;
+
+	if (arena == nullptr) {
+		free(header);
+		return;
+	}
+
+	log_assert(header->slab->live > 0);
+	header->slab->live--;
+	arena->live_objects--;
+	arena->free_slots.push_back(header);
+	arena->unref();
+}
+
+size_t ObjectArena::trim()
+{
+	// slots of empty slabs leave the free list first, then the slabs go
+	std::vector<SlotHeader*> new_free_slots;
+	for (auto header : free_slots)
+		if (header->slab->live != 0)
+			new_free_slots.push_back(header);
+	if (new_free_slots.size() == free_slots.size())
+		return 0;
+	free_slots.swap(new_free_slots);
+
+	size_t released = 0;
+	std::vector<Slab*> new_slabs;
+	for (auto slab : slabs)
+		if (slab->live == 0) {
+			free(slab->data);
+			delete slab;
+			released += slab_slots * slot_size;
+		} else
+			new_slabs.push_back(slab);
+	slabs.swap(new_slabs);
+
+	return released;
+}
+
+ObjectArena::stats_t ObjectArena::stats() const
+{
+	stats_t stats;
+	stats.slabs = slabs.size();
+	stats.live_objects = live_objects;
+	stats.free_slots = free_slots.size();
+	stats.bytes = slabs.size() * slab_slots * slot_size;
+	return stats;
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,92 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "kernel/yosys_common.h"
+#include <atomic>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Slab allocator for fixed-size objects, used by RTLIL::Module to allocate
+// its cells and wires. Objects of one module are packed into slabs of
+// slab_slots objects instead of being spread over the global heap, and freed
+// slots are reused before new slabs are allocated.
+//
+// Every slot starts with a small header pointing back to its arena and slab,
+// so an object can be freed without knowing which module allocated it. The
+// arena is reference counted by its owner and by every live object: deleting a
+// module destroys its objects and then drops all slabs in one go, and a cell
+// or wire that outlives its module keeps the arena alive until it is freed.
+//
+// An arena is not thread-safe; all allocations and frees for one module must
+// happen on one thread at a time. Only the reference count is atomic, since
+// objects that outlive their module may be freed from any thread.
+struct ObjectArena
+{
+	static const int slab_slots = 256;
+
+	struct stats_t {
+		size_t slabs, live_objects, free_slots, bytes;
+	};
+
+	// returns a new arena with a reference held by the caller
+	static ObjectArena *create(size_t object_size);
+
+	// drops the owner's reference
+	void release();
+
+	void *allocate();
+
+	// frees objects from allocate() and from heap_allocate()
+	static void deallocate(void *ptr);
+
+	// allocation for objects that are not owned by any arena
+	static void *heap_allocate(size_t object_size);
+
+	// returns slabs without live objects to the heap
+	size_t trim();
+
+	stats_t stats() const;
+
+private:
+	struct Slab;
+
+	struct SlotHeader {
+		ObjectArena *arena;
+		Slab *slab;
+	};
+
+	size_t slot_size;
+	std::atomic<int> refcount;
+	std::vector<Slab*> slabs;
+	std::vector<SlotHeader*> free_slots;
+	size_t live_objects;
+
+	ObjectArena(size_t object_size);
+	~ObjectArena();
+
+	void add_slab();
+	void unref();
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -97,6 +97,188 @@ static RTLIL::Const big2const(const BigInteger &val, int result_len, int undef_b
 	return result;
 }
 
+// Fast path for narrow, fully defined operands. Returns false if `val` is wider
+// than `max_width` bits or has any bit that is not 0 or 1; otherwise stores its
+// value in `out`, sign-extended to 64 bits when `as_signed` is set.
+static bool const2u64(const RTLIL::Const &val, bool as_signed, int max_width, uint64_t &out)
+{
+	int num_bits = GetSize(val.bits);
+	if (num_bits > max_width || num_bits > 64)
+		return false;
+
+	uint64_t result = 0;
+	for (int i = 0; i < num_bits; i++)
+		if (val.bits[i] == RTLIL::State::S1)
+			result |= uint64_t(1) << i;
+		else if (val.bits[i] != RTLIL::State::S0)
+			return false;
+
+	if (as_signed && num_bits > 0 && num_bits < 64 && val.bits[num_bits-1] == RTLIL::State::S1)
+		result |= ~uint64_t(0) << num_bits;
+
+	out = result;
+	return true;
+}
+
+static RTLIL::Const u642const(uint64_t val, int result_len)
+{
+	RTLIL::Const result(RTLIL::State::S0, result_len);
+	for (int i = 0; i < result_len && i < 64; i++)
+		if ((val >> i) & 1)
+			result.bits[i] = RTLIL::State::S1;
+	return result;
+}
+
+// Like const2u64 for up to 64 bits, but returns the magnitude and sign of the
+// value instead of its two's complement, as the division operations need.
+static bool const2mag(const RTLIL::Const &val, bool as_signed, uint64_t &mag, bool &negative)
+{
+	uint64_t value;
+	if (!const2u64(val, as_signed, 64, value))
+		return false;
+	int num_bits = GetSize(val.bits);
+	negative = as_signed && num_bits > 0 && val.bits[num_bits-1] == RTLIL::State::S1;
+	mag = negative ? 0 - value : value;
+	return true;
+}
+
+// Wide fully defined operands as little-endian 64-bit limbs, extended to
+// `width` bits according to `as_signed`. Returns false if any bit is not 0
+// or 1, in which case the BigInteger path produces the all-x result.
+static bool const2limbs(const RTLIL::Const &val, bool as_signed, int width, std::vector<uint64_t> &out)
+{
+	int num_bits = GetSize(val.bits);
+	out.assign((width + 63) / 64, 0);
+	for (int i = 0; i < num_bits; i++)
+		if (val.bits[i] == RTLIL::State::S1) {
+			if (i < width)
+				out[i / 64] |= uint64_t(1) << (i % 64);
+		} else if (val.bits[i] != RTLIL::State::S0)
+			return false;
+	if (as_signed && num_bits > 0 && val.bits[num_bits-1] == RTLIL::State::S1)
+		for (int i = num_bits; i < width; i++)
+			out[i / 64] |= uint64_t(1) << (i % 64);
+	return true;
+}
+
+static RTLIL::Const limbs2const(const std::vector<uint64_t> &limbs, int result_len)
+{
+	RTLIL::Const result(RTLIL::State::S0, result_len);
+	for (int i = 0; i < result_len; i++)
+		if ((limbs[i / 64] >> (i % 64)) & 1)
+			result.bits[i] = RTLIL::State::S1;
+	return result;
+}
+
+// a * b + c + d as a 128-bit value, which can't overflow
+static inline uint64_t mul_add_u64(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t &hi)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 p = (unsigned __int128)a * b + c + d;
+	hi = p >> 64;
+	return p;
+#else
+	uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+	uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+	uint64_t p0 = a_lo * b_lo, p1 = a_lo * b_hi, p2 = a_hi * b_lo, p3 = a_hi * b_hi;
+	uint64_t mid = (p0 >> 32) + (p1 & 0xffffffff) + (p2 & 0xffffffff);
+	uint64_t lo = (p0 & 0xffffffff) | (mid << 32);
+	hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+	lo += c;
+	hi += lo < c;
+	lo += d;
+	hi += lo < d;
+	return lo;
+#endif
+}
+
+// Two's complement arithmetic on limbs, modulo 2^(64 * words)
+static void limbs_add(std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+	uint64_t carry = 0;
+	for (int i = 0; i < GetSize(a); i++) {
+		uint64_t sum = a[i] + carry;
+		carry = sum < carry;
+		a[i] = sum + b[i];
+		carry += a[i] < sum;
+	}
+}
+
+static void limbs_sub(std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+	uint64_t borrow = 0;
+	for (int i = 0; i < GetSize(a); i++) {
+		uint64_t diff = a[i] - borrow;
+		borrow = diff > a[i];
+		borrow += diff < b[i];
+		a[i] = diff - b[i];
+	}
+}
+
+static std::vector<uint64_t> limbs_mul(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+	int words = GetSize(a);
+	std::vector<uint64_t> y(words, 0);
+	for (int i = 0; i < words; i++) {
+		if (a[i] == 0)
+			continue;
+		uint64_t carry = 0;
+		for (int j = 0; i + j < words; j++)
+			y[i + j] = mul_add_u64(a[i], b[j], y[i + j], carry, carry);
+	}
+	return y;
+}
+
+// Width of the result of an arithmetic operation when `result_len` is -1
+static int arith_result_len(const RTLIL::Const &arg1, const RTLIL::Const &arg2, int result_len)
+{
+	return result_len >= 0 ? result_len : max(GetSize(arg1.bits), GetSize(arg2.bits));
+}
+
+namespace {
+// A constant split into a value plane and an undef plane, 64 bits per word.
+// Bits that are neither 0 nor 1 are set in `undef` and clear in `val`, so the
+// bitwise operations below work a whole word at a time in branch-free loops.
+struct PackedConst
+{
+	int width;
+	std::vector<uint64_t> val, undef;
+
+	PackedConst(const RTLIL::Const &c) : width(GetSize(c.bits)), val((width + 63) / 64), undef((width + 63) / 64)
+	{
+		for (int i = 0; i < width; i++) {
+			RTLIL::State s = c.bits[i];
+			if (s == RTLIL::State::S1)
+				val[i / 64] |= uint64_t(1) << (i % 64);
+			else if (s != RTLIL::State::S0)
+				undef[i / 64] |= uint64_t(1) << (i % 64);
+		}
+	}
+
+	int words() const { return GetSize(val); }
+
+	uint64_t mask(int word) const {
+		if (word != words() - 1 || width % 64 == 0)
+			return ~uint64_t(0);
+		return (uint64_t(1) << (width % 64)) - 1;
+	}
+
+	// undef bits come back as x
+	RTLIL::Const to_const() const
+	{
+		RTLIL::Const result(RTLIL::State::S0, width);
+		for (int i = 0; i < width; i++) {
+			uint64_t bit = uint64_t(1) << (i % 64);
+			if (undef[i / 64] & bit)
+				result.bits[i] = RTLIL::State::Sx;
+			else if (val[i / 64] & bit)
+				result.bits[i] = RTLIL::State::S1;
+		}
+		return result;
+	}
+};
+}
+
 static RTLIL::State logic_and(RTLIL::State a, RTLIL::State b)
 {
 	if (a == RTLIL::State::S0) return RTLIL::State::S0;
@@ -115,20 +297,6 @@ static RTLIL::State logic_or(RTLIL::State a, RTLIL::State b)
 	return RTLIL::State::S0;
 }
 
-static RTLIL::State logic_xor(RTLIL::State a, RTLIL::State b)
-{
-	if (a != RTLIL::State::S0 && a != RTLIL::State::S1) return RTLIL::State::Sx;
-	if (b != RTLIL::State::S0 && b != RTLIL::State::S1) return RTLIL::State::Sx;
-	return a != b ? RTLIL::State::S1 : RTLIL::State::S0;
-}
-
-static RTLIL::State logic_xnor(RTLIL::State a, RTLIL::State b)
-{
-	if (a != RTLIL::State::S0 && a != RTLIL::State::S1) return RTLIL::State::Sx;
-	if (b != RTLIL::State::S0 && b != RTLIL::State::S1) return RTLIL::State::Sx;
-	return a == b ? RTLIL::State::S1 : RTLIL::State::S0;
-}
-
 RTLIL::Const RTLIL::const_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
 {
 	if (result_len < 0)
@@ -137,21 +305,17 @@ RTLIL::Const RTLIL::const_not(const RTLIL::Const &arg1, const RTLIL::Const&, boo
 	RTLIL::Const arg1_ext = arg1;
 	extend_u0(arg1_ext, result_len, signed1);
 
-	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		if (i >= arg1_ext.bits.size())
-			result.bits[i] = RTLIL::State::S0;
-		else if (arg1_ext.bits[i] == RTLIL::State::S0)
-			result.bits[i] = RTLIL::State::S1;
-		else if (arg1_ext.bits[i] == RTLIL::State::S1)
-			result.bits[i] = RTLIL::State::S0;
-	}
+	PackedConst y(arg1_ext);
+	for (int i = 0; i < y.words(); i++)
+		y.val[i] = ~(y.val[i] | y.undef[i]) & y.mask(i);
 
-	return result;
+	return y.to_const();
 }
 
-static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL::State),
-		RTLIL::Const arg1, RTLIL::Const arg2, bool signed1, bool signed2, int result_len = -1)
+// Bitwise operations on the packed planes: `func(a_val, a_undef, b_val, b_undef, y_val, y_undef)`
+// is applied to each 64-bit word of the operands.
+template<typename F>
+static RTLIL::Const logic_wrapper(F func, RTLIL::Const arg1, RTLIL::Const arg2, bool signed1, bool signed2, int result_len = -1)
 {
 	if (result_len < 0)
 		result_len = max(arg1.bits.size(), arg2.bits.size());
@@ -159,44 +323,88 @@ static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL:
 	extend_u0(arg1, result_len, signed1);
 	extend_u0(arg2, result_len, signed2);
 
-	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		RTLIL::State a = i < arg1.bits.size() ? arg1.bits[i] : RTLIL::State::S0;
-		RTLIL::State b = i < arg2.bits.size() ? arg2.bits[i] : RTLIL::State::S0;
-		result.bits[i] = logic_func(a, b);
+	PackedConst a(arg1), b(arg2), y(arg1);
+	for (int i = 0; i < y.words(); i++) {
+		func(a.val[i], a.undef[i], b.val[i], b.undef[i], y.val[i], y.undef[i]);
+		y.val[i] &= y.mask(i);
+		y.undef[i] &= y.mask(i);
 	}
 
-	return result;
+	return y.to_const();
 }
 
 RTLIL::Const RTLIL::const_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_and, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper([](uint64_t av, uint64_t au, uint64_t bv, uint64_t bu, uint64_t &yv, uint64_t &yu) {
+		uint64_t zero = ~(av | au) | ~(bv | bu);
+		yv = av & bv;
+		yu = ~(zero | yv);
+	}, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_or, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper([](uint64_t av, uint64_t au, uint64_t bv, uint64_t bu, uint64_t &yv, uint64_t &yu) {
+		uint64_t zero = ~(av | au) & ~(bv | bu);
+		yv = av | bv;
+		yu = ~(zero | yv);
+	}, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_xor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_xor, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper([](uint64_t av, uint64_t au, uint64_t bv, uint64_t bu, uint64_t &yv, uint64_t &yu) {
+		yu = au | bu;
+		yv = (av ^ bv) & ~yu;
+	}, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_xnor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_xnor, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper([](uint64_t av, uint64_t au, uint64_t bv, uint64_t bu, uint64_t &yv, uint64_t &yu) {
+		yu = au | bu;
+		yv = ~(av ^ bv) & ~yu;
+	}, arg1, arg2, signed1, signed2, result_len);
+}
+
+static RTLIL::State reduce_and_packed(const PackedConst &a)
+{
+	bool undef = false;
+	for (int i = 0; i < a.words(); i++) {
+		if (~(a.val[i] | a.undef[i]) & a.mask(i))
+			return RTLIL::State::S0;
+		undef |= a.undef[i] != 0;
+	}
+	return undef ? RTLIL::State::Sx : RTLIL::State::S1;
 }
 
-static RTLIL::Const logic_reduce_wrapper(RTLIL::State initial, RTLIL::State(*logic_func)(RTLIL::State, RTLIL::State), const RTLIL::Const &arg1, int result_len)
+static RTLIL::State reduce_or_packed(const PackedConst &a)
 {
-	RTLIL::State temp = initial;
+	bool undef = false;
+	for (int i = 0; i < a.words(); i++) {
+		if (a.val[i])
+			return RTLIL::State::S1;
+		undef |= a.undef[i] != 0;
+	}
+	return undef ? RTLIL::State::Sx : RTLIL::State::S0;
+}
 
-	for (size_t i = 0; i < arg1.bits.size(); i++)
-		temp = logic_func(temp, arg1.bits[i]);
+static RTLIL::State reduce_xor_packed(const PackedConst &a)
+{
+	uint64_t parity = 0;
+	for (int i = 0; i < a.words(); i++) {
+		if (a.undef[i])
+			return RTLIL::State::Sx;
+		parity ^= a.val[i];
+	}
+	for (int shift = 32; shift > 0; shift /= 2)
+		parity ^= parity >> shift;
+	return (parity & 1) ? RTLIL::State::S1 : RTLIL::State::S0;
+}
 
-	RTLIL::Const result(temp);
+static RTLIL::Const logic_reduce_wrapper(RTLIL::State(*reduce_func)(const PackedConst&), const RTLIL::Const &arg1, int result_len)
+{
+	RTLIL::Const result(reduce_func(PackedConst(arg1)));
 	while (int(result.bits.size()) < result_len)
 		result.bits.push_back(RTLIL::State::S0);
 	return result;
@@ -204,22 +412,22 @@ static RTLIL::Const logic_reduce_wrapper(RTLIL::State initial, RTLIL::State(*log
 
 RTLIL::Const RTLIL::const_reduce_and(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S1, logic_and, arg1, result_len);
+	return logic_reduce_wrapper(reduce_and_packed, arg1, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_or(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_or, arg1, result_len);
+	return logic_reduce_wrapper(reduce_or_packed, arg1, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_xor(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_xor, arg1, result_len);
+	return logic_reduce_wrapper(reduce_xor_packed, arg1, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_xnor(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	RTLIL::Const buffer = logic_reduce_wrapper(RTLIL::State::S0, logic_xor, arg1, result_len);
+	RTLIL::Const buffer = logic_reduce_wrapper(reduce_xor_packed, arg1, result_len);
 	if (!buffer.bits.empty()) {
 		if (buffer.bits.front() == RTLIL::State::S0)
 			buffer.bits.front() = RTLIL::State::S1;
@@ -231,28 +439,23 @@ RTLIL::Const RTLIL::const_reduce_xnor(const RTLIL::Const &arg1, const RTLIL::Con
 
 RTLIL::Const RTLIL::const_reduce_bool(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_or, arg1, result_len);
+	return logic_reduce_wrapper(reduce_or_packed, arg1, result_len);
 }
 
-RTLIL::Const RTLIL::const_logic_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
+RTLIL::Const RTLIL::const_logic_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	int undef_bit_pos_a = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	RTLIL::Const result(a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S1 : RTLIL::State::S0);
+	RTLIL::State bit_a = reduce_or_packed(PackedConst(arg1));
+	RTLIL::Const result(bit_a == RTLIL::State::S1 ? RTLIL::State::S0 : bit_a == RTLIL::State::S0 ? RTLIL::State::S1 : RTLIL::State::Sx);
 
 	while (int(result.bits.size()) < result_len)
 		result.bits.push_back(RTLIL::State::S0);
 	return result;
 }
 
-RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
+RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool, int result_len)
 {
-	int undef_bit_pos_a = -1, undef_bit_pos_b = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	BigInteger b = const2big(arg2, signed2, undef_bit_pos_b);
-
-	RTLIL::State bit_a = a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
+	RTLIL::State bit_a = reduce_or_packed(PackedConst(arg1));
+	RTLIL::State bit_b = reduce_or_packed(PackedConst(arg2));
 	RTLIL::Const result(logic_and(bit_a, bit_b));
 
 	while (int(result.bits.size()) < result_len)
@@ -260,14 +463,10 @@ RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const
 	return result;
 }
 
-RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
+RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool, int result_len)
 {
-	int undef_bit_pos_a = -1, undef_bit_pos_b = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	BigInteger b = const2big(arg2, signed2, undef_bit_pos_b);
-
-	RTLIL::State bit_a = a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
+	RTLIL::State bit_a = reduce_or_packed(PackedConst(arg1));
+	RTLIL::State bit_b = reduce_or_packed(PackedConst(arg2));
 	RTLIL::Const result(logic_or(bit_a, bit_b));
 
 	while (int(result.bits.size()) < result_len)
@@ -282,13 +481,28 @@ RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const
 // bounds are filled with the leftmost bit of `arg1` (arithmetic shift).
 static RTLIL::Const const_shift_worker(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool sign_ext, bool signed2, int direction, int result_len, RTLIL::State vacant_bits = RTLIL::State::S0)
 {
-	int undef_bit_pos = -1;
-	BigInteger offset = const2big(arg2, signed2, undef_bit_pos) * direction;
-
 	if (result_len < 0)
 		result_len = arg1.bits.size();
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
+
+	uint64_t raw_offset;
+	if (const2u64(arg2, signed2, 32, raw_offset)) {
+		int64_t offset = int64_t(raw_offset) * direction;
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + offset;
+			if (pos < 0)
+				result.bits[i] = vacant_bits;
+			else if (pos >= int64_t(arg1.bits.size()))
+				result.bits[i] = sign_ext ? arg1.bits.back() : vacant_bits;
+			else
+				result.bits[i] = arg1.bits[pos];
+		}
+		return result;
+	}
+
+	int undef_bit_pos = -1;
+	BigInteger offset = const2big(arg2, signed2, undef_bit_pos) * direction;
 	if (undef_bit_pos >= 0)
 		return result;
 
@@ -343,6 +557,10 @@ RTLIL::Const RTLIL::const_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &a
 
 RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2u64(arg1, signed1, 63, a) && const2u64(arg2, signed2, 63, b))
+		return RTLIL::Const(int64_t(a) < int64_t(b) ? 1 : 0, max(result_len, 1));
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) < const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -354,6 +572,10 @@ RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_le(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2u64(arg1, signed1, 63, a) && const2u64(arg2, signed2, 63, b))
+		return RTLIL::Const(int64_t(a) <= int64_t(b) ? 1 : 0, max(result_len, 1));
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) <= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -373,13 +595,13 @@ RTLIL::Const RTLIL::const_eq(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 	extend_u0(arg1_ext, width, signed1 && signed2);
 	extend_u0(arg2_ext, width, signed1 && signed2);
 
+	PackedConst a(arg1_ext), b(arg2_ext);
 	RTLIL::State matched_status = RTLIL::State::S1;
-	for (size_t i = 0; i < arg1_ext.bits.size(); i++) {
-		if (arg1_ext.bits.at(i) == RTLIL::State::S0 && arg2_ext.bits.at(i) == RTLIL::State::S1)
+	for (int i = 0; i < a.words(); i++) {
+		uint64_t undef = a.undef[i] | b.undef[i];
+		if ((a.val[i] ^ b.val[i]) & ~undef)
 			return result;
-		if (arg1_ext.bits.at(i) == RTLIL::State::S1 && arg2_ext.bits.at(i) == RTLIL::State::S0)
-			return result;
-		if (arg1_ext.bits.at(i) > RTLIL::State::S1 || arg2_ext.bits.at(i) > RTLIL::State::S1)
+		if (undef)
 			matched_status = RTLIL::State::Sx;
 	}
 
@@ -428,6 +650,10 @@ RTLIL::Const RTLIL::const_nex(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2u64(arg1, signed1, 63, a) && const2u64(arg2, signed2, 63, b))
+		return RTLIL::Const(int64_t(a) >= int64_t(b) ? 1 : 0, max(result_len, 1));
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) >= const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -439,6 +665,10 @@ RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (const2u64(arg1, signed1, 63, a) && const2u64(arg2, signed2, 63, b))
+		return RTLIL::Const(int64_t(a) > int64_t(b) ? 1 : 0, max(result_len, 1));
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) > const2big(arg2, signed2, undef_bit_pos);
 	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
@@ -450,6 +680,18 @@ RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2,
 
 RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// arithmetic modulo 2^64 is exact for results no wider than 64 bits
+	uint64_t a, b;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2u64(arg1, signed1, 64, a) && const2u64(arg2, signed2, 64, b))
+		return u642const(a + b, y_len);
+
+	std::vector<uint64_t> a_limbs, b_limbs;
+	if (const2limbs(arg1, signed1, y_len, a_limbs) && const2limbs(arg2, signed2, y_len, b_limbs)) {
+		limbs_add(a_limbs, b_limbs);
+		return limbs2const(a_limbs, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) + const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
@@ -457,6 +699,18 @@ RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// arithmetic modulo 2^64 is exact for results no wider than 64 bits
+	uint64_t a, b;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2u64(arg1, signed1, 64, a) && const2u64(arg2, signed2, 64, b))
+		return u642const(a - b, y_len);
+
+	std::vector<uint64_t> a_limbs, b_limbs;
+	if (const2limbs(arg1, signed1, y_len, a_limbs) && const2limbs(arg2, signed2, y_len, b_limbs)) {
+		limbs_sub(a_limbs, b_limbs);
+		return limbs2const(a_limbs, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) - const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
@@ -464,6 +718,18 @@ RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// arithmetic modulo 2^64 is exact for results no wider than 64 bits
+	uint64_t a, b;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2u64(arg1, signed1, 64, a) && const2u64(arg2, signed2, 64, b))
+		return u642const(a * b, y_len);
+
+	std::vector<uint64_t> a_limbs, b_limbs;
+	if (const2limbs(arg1, signed1, y_len, a_limbs) && const2limbs(arg2, signed2, y_len, b_limbs)) {
+		a_limbs = limbs_mul(a_limbs, b_limbs);
+		return limbs2const(a_limbs, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) * const2big(arg2, signed2, undef_bit_pos);
 	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
@@ -472,6 +738,16 @@ RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 // truncating division
 RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a_mag, b_mag;
+	bool a_neg, b_neg;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2mag(arg1, signed1, a_mag, a_neg) && const2mag(arg2, signed2, b_mag, b_neg)) {
+		if (b_mag == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		uint64_t y = a_mag / b_mag;
+		return u642const(a_neg != b_neg ? 0 - y : y, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -486,6 +762,16 @@ RTLIL::Const RTLIL::const_div(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 // truncating modulo
 RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a_mag, b_mag;
+	bool a_neg, b_neg;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2mag(arg1, signed1, a_mag, a_neg) && const2mag(arg2, signed2, b_mag, b_neg)) {
+		if (b_mag == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		uint64_t y = a_mag % b_mag;
+		return u642const(a_neg ? 0 - y : y, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -499,6 +785,18 @@ RTLIL::Const RTLIL::const_mod(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_divfloor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a_mag, b_mag;
+	bool a_neg, b_neg;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2mag(arg1, signed1, a_mag, a_neg) && const2mag(arg2, signed2, b_mag, b_neg)) {
+		if (b_mag == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		uint64_t y = a_mag / b_mag;
+		if (a_neg == b_neg || a_mag == 0)
+			return u642const(y, y_len);
+		return u642const(0 - (y + (a_mag % b_mag != 0)), y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -521,6 +819,20 @@ RTLIL::Const RTLIL::const_divfloor(const RTLIL::Const &arg1, const RTLIL::Const
 
 RTLIL::Const RTLIL::const_modfloor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a_mag, b_mag;
+	bool a_neg, b_neg;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2mag(arg1, signed1, a_mag, a_neg) && const2mag(arg2, signed2, b_mag, b_neg)) {
+		if (b_mag == 0)
+			return RTLIL::Const(RTLIL::State::Sx, result_len);
+		uint64_t truncated = a_mag % b_mag;
+		if (a_neg)
+			truncated = 0 - truncated;
+		if (truncated == 0 || a_neg == b_neg)
+			return u642const(truncated, y_len);
+		return u642const(b_neg ? truncated - b_mag : truncated + b_mag, y_len);
+	}
+
 	int undef_bit_pos = -1;
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
 	BigInteger b = const2big(arg2, signed2, undef_bit_pos);
@@ -544,6 +856,30 @@ RTLIL::Const RTLIL::const_modfloor(const RTLIL::Const &arg1, const RTLIL::Const
 
 RTLIL::Const RTLIL::const_pow(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	// exponentiation modulo 2^64 is exact for results no wider than 64 bits
+	uint64_t a_mag, b_mag;
+	bool a_neg, b_neg;
+	int y_len = arith_result_len(arg1, arg2, result_len);
+	if (y_len <= 64 && const2mag(arg1, signed1, a_mag, a_neg) && const2mag(arg2, signed2, b_mag, b_neg)) {
+		if (a_mag == 0 && b_mag != 0)
+			return RTLIL::Const(b_neg ? RTLIL::State::Sx : RTLIL::State::S0, result_len);
+		uint64_t y = 1;
+		if (b_neg) {
+			if (a_mag > 1)
+				y = 0;
+			else if (a_neg && (b_mag & 1))
+				y = 0 - y;
+		} else {
+			bool flip_result_sign = a_neg && (b_mag & 1);
+			for (uint64_t base = a_mag; b_mag != 0; b_mag >>= 1, base *= base)
+				if (b_mag & 1)
+					y *= base;
+			if (flip_result_sign)
+				y = 0 - y;
+		}
+		return u642const(y, y_len);
+	}
+
 	int undef_bit_pos = -1;
 
 	BigInteger a = const2big(arg1, signed1, undef_bit_pos);
@@ -18,6 +18,7 @@
  */
 
 #include "kernel/cellaigs.h"
+#include <mutex>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -252,13 +253,11 @@ struct AigMaker
 	}
 };
 
-Aig::Aig(Cell *cell)
+// The cell type followed by the parameter values, this identifies the AIG
+// of the cell and is the key of the Aig::get() cache.
+static string aig_name(Cell *cell)
 {
-	if (cell->type[0] != '$')
-		return;
-
-	AigMaker mk(this, cell);
-	name = cell->type.str();
+	string name = cell->type.str();
 
 	string mkname_last;
 	bool mkname_a_signed = false;
@@ -290,6 +289,17 @@ Aig::Aig(Cell *cell)
 		}
 	}
 
+	return name;
+}
+
+Aig::Aig(Cell *cell)
+{
+	if (cell->type[0] != '$')
+		return;
+
+	AigMaker mk(this, cell);
+	name = aig_name(cell);
+
 	if (cell->type.in(ID($not), ID($_NOT_), ID($pos), ID($_BUF_)))
 	{
 		for (int i = 0; i < GetSize(cell->getPort(ID::Y)); i++) {
@@ -512,4 +522,25 @@ optimize:;
 	new_nodes.swap(nodes);
 }
 
+const Aig *Aig::get(Cell *cell)
+{
+	static std::mutex cache_mutex;
+	static dict<string, std::unique_ptr<Aig>> cache;
+
+	if (cell->type[0] != '$')
+		return nullptr;
+
+	string key = aig_name(cell);
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto it = cache.find(key);
+	if (it == cache.end()) {
+		std::unique_ptr<Aig> aig(new Aig(cell));
+		if (aig->name.empty())
+			aig.reset();
+		it = cache.emplace(key, std::move(aig)).first;
+	}
+	return it->second.get();
+}
+
 YOSYS_NAMESPACE_END
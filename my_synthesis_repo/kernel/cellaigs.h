@@ -43,6 +43,11 @@ struct Aig
 	vector<AigNode> nodes;
 	Aig(Cell *cell);
 
+	// Returns the AIG for the type and parameters of the cell, built once and
+	// shared by all cells with the same name. The returned AIG must not be
+	// modified. Returns nullptr for cells without an AIG model.
+	static const Aig *get(Cell *cell);
+
 	bool operator==(const Aig &other) const;
 	unsigned int hash() const;
 };
@@ -18,6 +18,7 @@
  */
 
 #include "kernel/celledges.h"
+#include <mutex>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -388,67 +389,65 @@ void ff_op(AbstractCellEdgesDatabase *db, RTLIL::Cell *cell)
 			db->add_edge(cell, ID::ARST, 0, ID::Q, k, -1);
 }
 
-PRIVATE_NAMESPACE_END
-
-bool YOSYS_NAMESPACE_PREFIX AbstractCellEdgesDatabase::add_edges_from_cell(RTLIL::Cell *cell)
+bool add_cell_edges(AbstractCellEdgesDatabase *db, RTLIL::Cell *cell)
 {
 	if (cell->type.in(ID($not), ID($pos))) {
-		bitwise_unary_op(this, cell);
+		bitwise_unary_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor))) {
-		bitwise_binary_op(this, cell);
+		bitwise_binary_op(db, cell);
 		return true;
 	}
 
 	if (cell->type == ID($neg)) {
-		arith_neg_op(this, cell);
+		arith_neg_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($add), ID($sub))) {
-		arith_binary_op(this, cell);
+		arith_binary_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool), ID($logic_not))) {
-		reduce_op(this, cell);
+		reduce_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($shl), ID($shr), ID($sshl), ID($sshr), ID($shift), ID($shiftx))) {
-		shift_op(this, cell);
+		shift_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($lt), ID($le), ID($eq), ID($ne), ID($eqx), ID($nex), ID($ge), ID($gt))) {
-		compare_op(this, cell);
+		compare_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($mux), ID($pmux))) {
-		mux_op(this, cell);
+		mux_op(db, cell);
 		return true;
 	}
 
 	if (cell->type == ID($bmux)) {
-		bmux_op(this, cell);
+		bmux_op(db, cell);
 		return true;
 	}
 
 	if (cell->type == ID($demux)) {
-		demux_op(this, cell);
+		demux_op(db, cell);
 		return true;
 	}
 
 	if (cell->type.in(ID($mem_v2), ID($memrd), ID($memrd_v2), ID($memwr), ID($memwr_v2), ID($meminit))) {
-		mem_op(this, cell);
+		mem_op(db, cell);
 		return true;
 	}
 
 	if (RTLIL::builtin_ff_cell_types().count(cell->type)) {
-		ff_op(this, cell);
+		ff_op(db, cell);
 		return true;
 	}
 
@@ -469,3 +468,157 @@ bool YOSYS_NAMESPACE_PREFIX AbstractCellEdgesDatabase::add_edges_from_cell(RTLIL
 	return false;
 }
 
+struct EdgeRecorder : AbstractCellEdgesDatabase
+{
+	std::vector<CellEdgeRun> edges;
+
+	void add_edge(RTLIL::Cell*, RTLIL::IdString from_port, int from_bit, RTLIL::IdString to_port, int to_bit, int delay) override {
+		edges.push_back({from_port, to_port, from_bit, to_bit, 1, 1, 1, delay});
+	}
+};
+
+// Merges the edges that continue the previous run with the given steps into
+// it and returns the rest. The edges must be sorted so that the edges of a
+// run are consecutive.
+std::vector<CellEdgeRun> merge_runs(const std::vector<CellEdgeRun> &edges, int from_step, int to_step, std::vector<CellEdgeRun> &runs)
+{
+	std::vector<CellEdgeRun> rest;
+	for (int i = 0; i < GetSize(edges); ) {
+		CellEdgeRun run = edges[i];
+		run.from_step = from_step;
+		run.to_step = to_step;
+		int j = i + 1;
+		while (j < GetSize(edges) && edges[j].from_port == run.from_port && edges[j].to_port == run.to_port && edges[j].delay == run.delay &&
+				edges[j].from_bit == run.from_bit + run.length*from_step && edges[j].to_bit == run.to_bit + run.length*to_step)
+			run.length++, j++;
+		if (run.length > 1)
+			runs.push_back(run);
+		else
+			rest.push_back(edges[i]);
+		i = j;
+	}
+	return rest;
+}
+
+CellEdgePattern *build_pattern(RTLIL::Cell *cell)
+{
+	EdgeRecorder recorder;
+	if (!add_cell_edges(&recorder, cell))
+		return nullptr;
+
+	auto key = [](const CellEdgeRun &e) { return std::make_tuple(e.from_port, e.to_port, e.delay); };
+	std::vector<CellEdgeRun> edges = recorder.edges;
+	std::sort(edges.begin(), edges.end(), [&](const CellEdgeRun &a, const CellEdgeRun &b) {
+		return std::make_tuple(key(a), a.from_bit, a.to_bit) < std::make_tuple(key(b), b.from_bit, b.to_bit);
+	});
+	edges.erase(std::unique(edges.begin(), edges.end(), [&](const CellEdgeRun &a, const CellEdgeRun &b) {
+		return key(a) == key(b) && a.from_bit == b.from_bit && a.to_bit == b.to_bit;
+	}), edges.end());
+
+	CellEdgePattern *pattern = new CellEdgePattern;
+
+	// bitwise runs first, then one bit driving a range, then a range driving one bit
+	std::sort(edges.begin(), edges.end(), [&](const CellEdgeRun &a, const CellEdgeRun &b) {
+		return std::make_tuple(key(a), a.from_bit - a.to_bit, a.to_bit) < std::make_tuple(key(b), b.from_bit - b.to_bit, b.to_bit);
+	});
+	edges = merge_runs(edges, 1, 1, pattern->runs);
+
+	std::sort(edges.begin(), edges.end(), [&](const CellEdgeRun &a, const CellEdgeRun &b) {
+		return std::make_tuple(key(a), a.from_bit, a.to_bit) < std::make_tuple(key(b), b.from_bit, b.to_bit);
+	});
+	edges = merge_runs(edges, 0, 1, pattern->runs);
+
+	std::sort(edges.begin(), edges.end(), [&](const CellEdgeRun &a, const CellEdgeRun &b) {
+		return std::make_tuple(key(a), a.to_bit, a.from_bit) < std::make_tuple(key(b), b.to_bit, b.from_bit);
+	});
+	edges = merge_runs(edges, 1, 0, pattern->runs);
+
+	pattern->runs.insert(pattern->runs.end(), edges.begin(), edges.end());
+	return pattern;
+}
+
+// Type, parameters and port widths, which is all the edge models look at.
+// Memory contents never change the edges and can be large, INIT is left out.
+std::string pattern_key(RTLIL::Cell *cell)
+{
+	std::string key = cell->type.str();
+
+	std::vector<std::pair<RTLIL::IdString, const RTLIL::Const*>> params;
+	for (auto &it : cell->parameters)
+		if (it.first != ID::INIT)
+			params.push_back(std::make_pair(it.first, &it.second));
+	std::sort(params.begin(), params.end(), [](const std::pair<RTLIL::IdString, const RTLIL::Const*> &a, const std::pair<RTLIL::IdString, const RTLIL::Const*> &b) {
+		return a.first < b.first;
+	});
+	for (auto &it : params)
+		key += stringf(" %s=%s", it.first.c_str(), it.second->as_string().c_str());
+
+	std::vector<std::pair<RTLIL::IdString, int>> ports;
+	for (auto &it : cell->connections())
+		ports.push_back(std::make_pair(it.first, GetSize(it.second)));
+	std::sort(ports.begin(), ports.end());
+	for (auto &it : ports)
+		key += stringf(" %s:%d", it.first.c_str(), it.second);
+
+	return key;
+}
+
+struct ModuleEdgesRecorder : AbstractCellEdgesDatabase
+{
+	ModuleEdgesGraph &graph;
+	ModuleEdgesRecorder(ModuleEdgesGraph &graph) : graph(graph) { }
+
+	void add_edge(RTLIL::Cell *cell, RTLIL::IdString from_port, int from_bit, RTLIL::IdString to_port, int to_bit, int) override {
+		SigBit from = graph.sigmap(cell->getPort(from_port)[from_bit]);
+		SigBit to = graph.sigmap(cell->getPort(to_port)[to_bit]);
+		graph.fwd[from].insert(to);
+		graph.rev[to].insert(from);
+	}
+
+	void add_edge_run(RTLIL::Cell *cell, const CellEdgeRun &run) override {
+		SigSpec from_sig = graph.sigmap(cell->getPort(run.from_port));
+		SigSpec to_sig = graph.sigmap(cell->getPort(run.to_port));
+		for (int k = 0; k < run.length; k++) {
+			SigBit from = from_sig[run.from_bit + k*run.from_step];
+			SigBit to = to_sig[run.to_bit + k*run.to_step];
+			graph.fwd[from].insert(to);
+			graph.rev[to].insert(from);
+		}
+	}
+};
+
+PRIVATE_NAMESPACE_END
+
+const CellEdgePattern *YOSYS_NAMESPACE_PREFIX CellEdgePattern::get(RTLIL::Cell *cell)
+{
+	static std::mutex cache_mutex;
+	static dict<std::string, std::unique_ptr<CellEdgePattern>> cache;
+
+	std::string key = pattern_key(cell);
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto it = cache.find(key);
+	if (it == cache.end())
+		it = cache.emplace(key, std::unique_ptr<CellEdgePattern>(build_pattern(cell))).first;
+	return it->second.get();
+}
+
+bool YOSYS_NAMESPACE_PREFIX AbstractCellEdgesDatabase::add_edges_from_cell(RTLIL::Cell *cell)
+{
+	const CellEdgePattern *pattern = CellEdgePattern::get(cell);
+	if (pattern == nullptr)
+		return false;
+
+	for (auto &run : pattern->runs)
+		add_edge_run(cell, run);
+	return true;
+}
+
+YOSYS_NAMESPACE_PREFIX ModuleEdgesGraph::ModuleEdgesGraph(RTLIL::Module *module) : sigmap(module)
+{
+	ModuleEdgesRecorder recorder(*this);
+	for (auto cell : module->cells())
+		if (!recorder.add_edges_from_cell(cell))
+			unknown_cells.insert(cell);
+}
+
@@ -25,10 +25,36 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+// A run of edges: edge k < length goes from from_port[from_bit + k*from_step]
+// to to_port[to_bit + k*to_step]. The steps are 0 or 1, so a run describes a
+// bitwise connection, one bit driving a range or a range driving one bit.
+struct CellEdgeRun
+{
+	RTLIL::IdString from_port, to_port;
+	int from_bit, to_bit, length;
+	int from_step, to_step;
+	int delay;
+};
+
+// The edges of a cell type for one set of parameters and port widths, shared
+// by all cells that have them.
+struct CellEdgePattern
+{
+	std::vector<CellEdgeRun> runs;
+
+	// Returns the cached pattern of the cell, computing it on first use, or
+	// nullptr if there is no edge model for the cell type.
+	static const CellEdgePattern *get(RTLIL::Cell *cell);
+};
+
 struct AbstractCellEdgesDatabase
 {
 	virtual ~AbstractCellEdgesDatabase() { }
 	virtual void add_edge(RTLIL::Cell *cell, RTLIL::IdString from_port, int from_bit, RTLIL::IdString to_port, int to_bit, int delay) = 0;
+	virtual void add_edge_run(RTLIL::Cell *cell, const CellEdgeRun &run) {
+		for (int k = 0; k < run.length; k++)
+			add_edge(cell, run.from_port, run.from_bit + k*run.from_step, run.to_port, run.to_bit + k*run.to_step, run.delay);
+	}
 	bool add_edges_from_cell(RTLIL::Cell *cell);
 };
 
@@ -43,6 +69,13 @@ struct FwdCellEdgesDatabase : AbstractCellEdgesDatabase
 		SigBit to_sigbit = sigmap(cell->getPort(to_port)[to_bit]);
 		db[from_sigbit].insert(to_sigbit);
 	}
+
+	void add_edge_run(RTLIL::Cell *cell, const CellEdgeRun &run) override {
+		SigSpec from_sig = sigmap(cell->getPort(run.from_port));
+		SigSpec to_sig = sigmap(cell->getPort(run.to_port));
+		for (int k = 0; k < run.length; k++)
+			db[from_sig[run.from_bit + k*run.from_step]].insert(to_sig[run.to_bit + k*run.to_step]);
+	}
 };
 
 struct RevCellEdgesDatabase : AbstractCellEdgesDatabase
@@ -56,6 +89,24 @@ struct RevCellEdgesDatabase : AbstractCellEdgesDatabase
 		SigBit to_sigbit = sigmap(cell->getPort(to_port)[to_bit]);
 		db[to_sigbit].insert(from_sigbit);
 	}
+
+	void add_edge_run(RTLIL::Cell *cell, const CellEdgeRun &run) override {
+		SigSpec from_sig = sigmap(cell->getPort(run.from_port));
+		SigSpec to_sig = sigmap(cell->getPort(run.to_port));
+		for (int k = 0; k < run.length; k++)
+			db[to_sig[run.to_bit + k*run.to_step]].insert(from_sig[run.from_bit + k*run.from_step]);
+	}
+};
+
+// The forward and reverse edges of all cells of a module, between sigmapped
+// bits. Cells without an edge model are collected in unknown_cells.
+struct ModuleEdgesGraph
+{
+	SigMap sigmap;
+	dict<SigBit, pool<SigBit>> fwd, rev;
+	pool<RTLIL::Cell*> unknown_cells;
+
+	ModuleEdgesGraph(RTLIL::Module *module);
 };
 
 YOSYS_NAMESPACE_END
@@ -420,6 +420,262 @@ struct ConstEval
 	}
 };
 
+// Evaluates a fixed cone of a ConstEval for many assignments of the same
+// input signals. The driving cells are put in topological order once and all
+// signal bits are numbered, so eval() only runs the cell list on a vector of
+// values. Values already set in the ConstEval when the cone is built are
+// constants of the cone. eval() returns false when ConstEval would fail or
+// when the cone can not reproduce its result, the caller then uses the
+// ConstEval itself for that assignment.
+struct ConstEvalCone
+{
+	struct cell_t
+	{
+		RTLIL::Cell *cell;
+		std::vector<int> a, b, c, d, s, y;
+	};
+
+	ConstEval &ce;
+	bool valid = true;
+	std::vector<RTLIL::State> init_values, values;
+	std::vector<int> input_slots, output_slots;
+	std::vector<cell_t> cells;
+	dict<RTLIL::SigBit, int> bit_slots;
+	dict<RTLIL::Cell*, int> cell_state;
+
+	ConstEvalCone(ConstEval &ce, RTLIL::SigSpec inputs, RTLIL::SigSpec outputs) : ce(ce)
+	{
+		ce.assign_map.apply(inputs);
+		for (auto bit : inputs) {
+			int slot = GetSize(init_values);
+			init_values.push_back(RTLIL::State::Sm);
+			if (bit.wire != nullptr)
+				bit_slots[bit] = slot;
+			input_slots.push_back(slot);
+		}
+
+		for (auto bit : outputs)
+			output_slots.push_back(get_slot(bit));
+	}
+
+	int const_slot(RTLIL::State state)
+	{
+		init_values.push_back(state);
+		return GetSize(init_values) - 1;
+	}
+
+	// slot of a cell input or cone output, adds the driver cells in
+	// topological order
+	int get_slot(RTLIL::SigBit bit)
+	{
+		bit = ce.assign_map(bit);
+		if (bit.wire == nullptr)
+			return const_slot(bit.data);
+
+		auto it = bit_slots.find(bit);
+		if (it != bit_slots.end())
+			return it->second;
+
+		RTLIL::SigBit value = ce.values_map(bit);
+		int slot;
+		if (value.wire == nullptr) {
+			slot = const_slot(value.data);
+			bit_slots[bit] = slot;
+			return slot;
+		}
+
+		std::set<RTLIL::Cell*> drivers;
+		if (!ce.stop_signals.check(bit))
+			ce.sig2driver.find(bit, drivers);
+		if (GetSize(drivers) > 1)
+			valid = false;
+		for (auto cell : drivers)
+			add_cell(cell);
+
+		// the driver took a slot for all its output bits
+		it = bit_slots.find(bit);
+		if (it != bit_slots.end())
+			return it->second;
+
+		// undriven, loop or stop signal
+		slot = const_slot(drivers.empty() && !ce.stop_signals.check(bit) ? ce.defaultval : RTLIL::State::Sm);
+		bit_slots[bit] = slot;
+		return slot;
+	}
+
+	void add_cell(RTLIL::Cell *cell)
+	{
+		int state = cell_state[cell];
+		if (state == 1)
+			valid = false; // combinational loop
+		if (state != 0 || !valid)
+			return;
+		cell_state[cell] = 1;
+
+		if (cell->type.in(ID($lcu), ID($fa), ID($alu), ID($macc)) || !cell->hasPort(ID::Y)) {
+			valid = false;
+			return;
+		}
+
+		cell_t c;
+		c.cell = cell;
+		bool is_mux = cell->type.in(ID($mux), ID($pmux), ID($_MUX_), ID($_NMUX_), ID($bmux), ID($demux));
+
+		auto add_port = [&](RTLIL::IdString port, std::vector<int> &slots) {
+			if (cell->hasPort(port))
+				for (auto bit : cell->getPort(port))
+					slots.push_back(get_slot(bit));
+		};
+		add_port(ID::A, c.a);
+		add_port(ID::B, c.b);
+		if (is_mux)
+			add_port(ID::S, c.s);
+		if (cell->type.in(ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_))) {
+			add_port(ID::C, c.c);
+			add_port(ID::D, c.d);
+		}
+
+		// output bits that are inputs or already have a value are not written
+		for (auto bit : cell->getPort(ID::Y)) {
+			bit = ce.assign_map(bit);
+			int slot = -1;
+			if (bit.wire != nullptr && !bit_slots.count(bit) && ce.values_map(bit).wire != nullptr) {
+				slot = const_slot(RTLIL::State::Sm);
+				bit_slots[bit] = slot;
+			}
+			c.y.push_back(slot);
+		}
+
+		cell_state[cell] = 2;
+		cells.push_back(c);
+	}
+
+	bool read(const std::vector<int> &slots, RTLIL::Const &value) const
+	{
+		value.bits.resize(slots.size());
+		for (int i = 0; i < GetSize(slots); i++) {
+			value.bits[i] = values[slots[i]];
+			if (value.bits[i] == RTLIL::State::Sm)
+				return false;
+		}
+		return true;
+	}
+
+	void write(const cell_t &c, const RTLIL::Const *value)
+	{
+		for (int i = 0; i < GetSize(c.y); i++)
+			if (c.y[i] >= 0)
+				values[c.y[i]] = value != nullptr && i < GetSize(*value) ? value->bits[i] : RTLIL::State::Sm;
+	}
+
+	bool eval_mux(const cell_t &c, RTLIL::Const &result)
+	{
+		RTLIL::Const sel, cand;
+		if (!read(c.s, sel))
+			return false;
+
+		int width = GetSize(c.y);
+		bool first = true, any_set = false;
+		bool invert = c.cell->type == ID($_NMUX_);
+
+		auto merge = [&](const std::vector<int> &slots, int offset) {
+			for (int i = 0; i < width; i++) {
+				RTLIL::State bit = values[slots[offset + i]];
+				if (bit == RTLIL::State::Sm)
+					return false;
+				if (invert)
+					bit = bit == RTLIL::State::S0 ? RTLIL::State::S1 : bit == RTLIL::State::S1 ? RTLIL::State::S0 : RTLIL::State::Sx;
+				if (first)
+					result.bits[i] = bit;
+				else if (result.bits[i] != bit)
+					result.bits[i] = RTLIL::State::Sx;
+			}
+			first = false;
+			return true;
+		};
+
+		result.bits.assign(width, RTLIL::State::Sx);
+		for (int i = 0; i < GetSize(sel); i++) {
+			if (sel[i] == RTLIL::State::S1)
+				any_set = true;
+			if ((sel[i] == RTLIL::State::S1 || sel[i] == RTLIL::State::Sx) && !merge(c.b, width*i))
+				return false;
+		}
+		if (!any_set && !merge(c.a, 0))
+			return false;
+		return true;
+	}
+
+	bool eval_cell(const cell_t &c, RTLIL::Const &result, bool &error)
+	{
+		RTLIL::IdString type = c.cell->type;
+
+		if (type.in(ID($mux), ID($pmux), ID($_MUX_), ID($_NMUX_)))
+			return eval_mux(c, result);
+
+		RTLIL::Const a, b, s;
+		if (type == ID($bmux)) {
+			if (!read(c.s, s))
+				return false;
+			if (s.is_fully_def()) {
+				int width = GetSize(c.y);
+				std::vector<int> slice(c.a.begin() + s.as_int() * width, c.a.begin() + (s.as_int() + 1) * width);
+				return read(slice, result);
+			}
+			if (!read(c.a, a))
+				return false;
+			result = const_bmux(a, s);
+			return true;
+		}
+
+		if (type == ID($demux)) {
+			if (!read(c.a, a))
+				return false;
+			if (a.is_fully_zero()) {
+				result = RTLIL::Const(0, GetSize(c.y));
+				return true;
+			}
+			if (!read(c.s, s))
+				return false;
+			result = const_demux(a, s);
+			return true;
+		}
+
+		RTLIL::Const cval, dval;
+		if (!read(c.a, a) || !read(c.b, b) || !read(c.c, cval) || !read(c.d, dval))
+			return false;
+		result = CellTypes::eval(c.cell, a, b, cval, dval, &error);
+		return !error;
+	}
+
+	bool eval(const RTLIL::Const &input_values, RTLIL::Const &output_values)
+	{
+		if (!valid)
+			return false;
+
+		values = init_values;
+		for (int i = 0; i < GetSize(input_slots); i++)
+			values[input_slots[i]] = input_values.bits.at(i);
+
+		RTLIL::Const result;
+		for (auto &c : cells) {
+			bool error = false;
+			bool ok = eval_cell(c, result, error);
+			if (error)
+				return false;
+			write(c, ok ? &result : nullptr);
+		}
+
+		output_values.bits.resize(output_slots.size());
+		for (int i = 0; i < GetSize(output_slots); i++) {
+			output_values.bits[i] = values[output_slots[i]];
+			if (output_values.bits[i] == RTLIL::State::Sm)
+				return false;
+		}
+		return true;
+	}
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
@@ -0,0 +1,85 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/counters.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+const char *kernel_counters::names[NUM_COUNTERS] = {
+	"idstring_new",
+	"idstring_free",
+	"sigspec_pack",
+	"sigspec_unpack",
+	"sigmap_build",
+	"fixup_ports",
+	"selected_modules"
+};
+
+#ifdef YOSYS_KERNEL_COUNTERS
+
+YS_THREAD_LOCAL kernel_counters::block_t *kernel_counters::local_block = nullptr;
+
+// Blocks are never freed: the worker threads live until exit, and the counts
+// of a thread must survive it for the per-pass totals.
+static std::vector<kernel_counters::block_t*> &all_blocks()
+{
+	static std::vector<kernel_counters::block_t*> blocks;
+	return blocks;
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex &blocks_mutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+#endif
+
+kernel_counters::block_t *kernel_counters::register_thread()
+{
+	block_t *block = new block_t;
+	for (auto &c : block->counts)
+		c.store(0, std::memory_order_relaxed);
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(blocks_mutex());
+#endif
+		all_blocks().push_back(block);
+	}
+	local_block = block;
+	return block;
+}
+
+#endif
+
+kernel_counters::snapshot_t kernel_counters::snapshot()
+{
+	snapshot_t totals(NUM_COUNTERS);
+#ifdef YOSYS_KERNEL_COUNTERS
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(blocks_mutex());
+#endif
+	for (auto block : all_blocks())
+		for (int i = 0; i < NUM_COUNTERS; i++)
+			totals[i] += block->counts[i].load(std::memory_order_relaxed);
+#endif
+	return totals;
+}
+
+YOSYS_NAMESPACE_END
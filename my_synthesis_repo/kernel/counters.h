@@ -0,0 +1,86 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include "kernel/yosys_common.h"
+
+#ifdef YOSYS_KERNEL_COUNTERS
+#  include <atomic>
+#endif
+
+// Opt-in event counters for hot kernel primitives, enabled by building with
+// -DYOSYS_KERNEL_COUNTERS. KERNEL_COUNT(id) bumps a counter in a block owned
+// by the calling thread, so counting needs no atomic read-modify-write and no
+// shared cache line. Pass::post_execute() attributes the totals of all
+// threads to passes (nested passes subtracted, like runtime_ns), 'stat
+// -kernel' prints them and the pass_end telemetry event carries them.
+// Without the define KERNEL_COUNT() expands to nothing.
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace kernel_counters
+{
+	enum counter_id {
+		IDSTRING_NEW,
+		IDSTRING_FREE,
+		SIGSPEC_PACK,
+		SIGSPEC_UNPACK,
+		SIGMAP_BUILD,
+		FIXUP_PORTS,
+		SELECTED_MODULES,
+		NUM_COUNTERS
+	};
+
+	// short names as used by 'stat -kernel' and the telemetry
+	extern const char *names[NUM_COUNTERS];
+
+	typedef std::vector<int64_t> snapshot_t;
+
+#ifdef YOSYS_KERNEL_COUNTERS
+	// written only by the owning thread, read by snapshot()
+	struct block_t {
+		std::atomic<int64_t> counts[NUM_COUNTERS];
+	};
+
+	extern YS_THREAD_LOCAL block_t *local_block;
+	block_t *register_thread();
+
+	static inline void count(counter_id id) {
+		block_t *block = local_block;
+		if (block == nullptr)
+			block = register_thread();
+		block->counts[id].store(block->counts[id].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+#endif
+
+	// totals over all threads, NUM_COUNTERS entries (all zero without YOSYS_KERNEL_COUNTERS)
+	snapshot_t snapshot();
+}
+
+#ifdef YOSYS_KERNEL_COUNTERS
+#  define KERNEL_COUNT(_id_) YOSYS_NAMESPACE_PREFIX kernel_counters::count(YOSYS_NAMESPACE_PREFIX kernel_counters::_id_)
+#else
+#  define KERNEL_COUNT(_id_) do { } while (0)
+#endif
+
+YOSYS_NAMESPACE_END
+
+#endif
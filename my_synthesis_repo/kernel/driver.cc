@@ -18,6 +18,8 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
+#include "kernel/tracing.h"
 #include "libs/sha1/sha1.h"
 
 #ifdef YOSYS_ENABLE_READLINE
@@ -56,10 +58,15 @@
 #ifdef HYBRDLINK
 #include "libs/json11/json11.hpp"
 #include "ArchiveTool.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#ifdef YOSYS_ENABLE_THREADS
+#include <thread>
+#endif
 
 #define MAP_JSON "+/hybrdchip/design_elements_H_V.7z"
 
-std::unordered_map<std::string, std::string> Yosys::map_hybrdchip_2_xilinx;
 #endif
 
 USING_YOSYS_NAMESPACE
@@ -73,12 +80,9 @@ const std::string get_design_elements_file_path()
 	return file_path;
 }
 
-static void parser_hybrdchip_2_xilinx_json()
+static dict<RTLIL::IdString, RTLIL::IdString> parser_hybrdchip_2_xilinx_json()
 {
-	// only once.
-	if (!map_hybrdchip_2_xilinx.empty()) {
-		return;
-	}
+	dict<RTLIL::IdString, RTLIL::IdString> table;
 	// read map.json
 	Tool::ArchiveTool tool;
 	std::vector< Tool::byte_t > buffer;
@@ -92,12 +96,192 @@ static void parser_hybrdchip_2_xilinx_json()
 	}
 	if (jsonData.is_object()) {
 		const std::map<std::string, json11::Json> &file_content = jsonData.object_items();
-		for (auto it : file_content) {
-			map_hybrdchip_2_xilinx.insert({"\\" + it.first, "\\" + it.second.string_value()});
+		for (auto &it : file_content) {
+			table.emplace("\\" + it.first, "\\" + it.second.string_value());
 		}
 	} else {
 		Yosys::log_error("Parsing json error, the file content is not of type object .\n");
 	}
+	return table;
+}
+
+// hybrdchip to xilinx原语映射关系，第一次使用时才解压解析（函数内静态变量的初始化是线程安全的）
+const dict<RTLIL::IdString, RTLIL::IdString> &Yosys::hybrdchip_primitive_map()
+{
+	static const dict<RTLIL::IdString, RTLIL::IdString> table = parser_hybrdchip_2_xilinx_json();
+	return table;
+}
+
+// 服务器模式（-Y）：进程常驻，通过 CONTROL 管道接收任务，每个任务在单独的
+// RTLIL::Design 中执行。techlib、liberty、memlib 等进程内缓存在任务之间保留。
+//   {"command": "run_job", "job_id": ..., "files": [...], "script": ..., "commands": [...], "log_file": ...}
+//   {"command": "shutdown"}
+// 任务结束时在 DATA 管道上发送 JOB_FINISHED，任务期间的所有数据包带有 job_id 字段。
+struct ServerJob {
+	std::string job_id;
+	std::vector<std::string> files;
+	std::string script;
+	std::vector<std::string> commands;
+	std::string log_file;
+};
+
+static std::mutex server_mutex;
+static std::condition_variable server_cv;
+static std::deque<ServerJob> server_jobs;
+static bool server_shutdown = false;
+
+// 在 CONTROL 管道读取线程中执行，只负责入队
+static bool server_control_handler(const nlohmann::json &command)
+{
+	std::string name = command.value("command", "");
+	std::lock_guard<std::mutex> lock(server_mutex);
+
+	if (name == "shutdown") {
+		server_shutdown = true;
+		server_cv.notify_all();
+		return true;
+	}
+	if (name != "run_job")
+		return false;
+
+	ServerJob job;
+	job.job_id = command.value("job_id", "");
+	job.script = command.value("script", "");
+	job.log_file = command.value("log_file", "");
+	for (auto key : {"files", "commands"}) {
+		auto it = command.find(key);
+		if (it == command.end() || !it->is_array())
+			continue;
+		for (auto &item : *it)
+			if (item.is_string())
+				(strcmp(key, "files") ? job.commands : job.files).push_back(item.get<std::string>());
+	}
+	server_jobs.push_back(std::move(job));
+	server_cv.notify_all();
+	return true;
+}
+
+static void server_send_job_status(const std::string &status, const std::string &error, int warnings)
+{
+	nlohmann::json data;
+	data["job_id"] = Common::g_job_id;
+	data["status"] = status;
+	data["error"] = error;
+	data["warnings"] = warnings;
+	Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(status == "failed" ?
+			StatusCode::INTERNAL_SERVER_ERROR : StatusCode::SUCCESS, data, "JOB_FINISHED"));
+}
+
+void yosys_atexit();
+
+// log_error() 会结束进程，结束前报告正在执行的任务失败，父进程据此重启服务器
+static void server_error_atexit()
+{
+	if (!Common::g_job_id.empty())
+		server_send_job_status("failed", log_last_error, log_warnings_count);
+	yosys_atexit();
+}
+
+// 服务器启动时的日志输出目标，每个任务在此基础上加上自己的日志文件
+static std::vector<FILE*> server_base_log_files;
+static std::vector<int> server_base_header_count;
+
+static void server_run_job(const ServerJob &job)
+{
+	JobContext ctx;
+	ctx.design = new RTLIL::Design;
+	ctx.log_files = server_base_log_files;
+	ctx.header_count = server_base_header_count;
+	ctx.job_id = job.job_id;
+
+	job_context_enter(&ctx);
+	// 空闲时收到的 abort 不作用于下一个任务
+	log_control_pending.fetch_and(~LOG_CONTROL_ABORT);
+
+	FILE *log_file = nullptr;
+	if (!job.log_file.empty()) {
+		log_file = fopen(job.log_file.c_str(), "wt");
+		if (log_file == nullptr)
+			log_warning("Can't open job log file `%s' for writing: %s\n", job.log_file.c_str(), strerror(errno));
+		else
+			log_files.push_back(log_file);
+	}
+
+	std::string error;
+	try {
+		for (auto &file : job.files)
+			run_frontend(file, "auto");
+		if (!job.script.empty())
+			run_frontend(job.script, "script");
+		for (auto &command : job.commands)
+			run_pass(command);
+	} catch (log_cmd_error_exception) {
+		error = log_last_error;
+		log_reset_stack();
+	}
+
+	// 任务之间不共享设计，包括 design -save/-push 保存的设计
+	for (auto &it : saved_designs)
+		delete it.second;
+	saved_designs.clear();
+	for (auto it : pushed_designs)
+		delete it;
+	pushed_designs.clear();
+	delete yosys_design;
+	yosys_design = nullptr;
+
+	if (log_file != nullptr) {
+		log_flush();
+		fclose(log_file);
+	}
+
+	server_send_job_status(error.empty() ? "done" : "failed", error, log_warnings_count);
+	job_context_leave(&ctx);
+	Common::FlushPipes();
+}
+
+static void server_worker()
+{
+	while (true) {
+		ServerJob job;
+		{
+			std::unique_lock<std::mutex> lock(server_mutex);
+			server_cv.wait(lock, [] { return server_shutdown || !server_jobs.empty(); });
+			if (server_jobs.empty())
+				break;
+			job = std::move(server_jobs.front());
+			server_jobs.pop_front();
+		}
+		server_run_job(job);
+	}
+}
+
+static void server_main()
+{
+	// 预先加载原语映射表，第一个任务不再承担解压开销
+	hybrdchip_primitive_map();
+	log_error_atexit = server_error_atexit;
+	log_cmd_error_throw = true;
+	server_base_log_files = log_files;
+	server_base_header_count = header_count;
+
+	nlohmann::json data;
+	data["pid"] = Common::g_father_process_id;
+	Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "SERVER_READY"));
+
+	// 使用 -j 时最多同时执行 <jobs> 个任务，任务等待 ABC 等外部程序时让出内核
+#ifdef YOSYS_ENABLE_THREADS
+	std::vector<std::thread> workers;
+	for (int i = 0; i < std::max(1, yosys_parallel_jobs); i++)
+		workers.emplace_back(server_worker);
+	for (auto &worker : workers)
+		worker.join();
+#else
+	server_worker();
+#endif
+
+	log_cmd_error_throw = false;
+	log_error_atexit = yosys_atexit;
 }
 #endif
 
@@ -238,6 +422,8 @@ extern "C" {
 
 void yosys_atexit()
 {
+	trace_close();
+
 #if defined(YOSYS_ENABLE_READLINE) || defined(YOSYS_ENABLE_EDITLINE)
 	if (!yosys_history_file.empty()) {
 #if defined(YOSYS_ENABLE_READLINE)
@@ -286,6 +472,7 @@ int main(int argc, char **argv)
 	std::string depsfile = "";
 	std::string topmodule = "";
 	std::string perffile = "";
+	std::string tracefile = "";
 	bool scriptfile_tcl = false;
 	bool print_banner = true;
 	bool print_stats = true;
@@ -295,6 +482,9 @@ int main(int argc, char **argv)
 	bool run_tcl_shell = false;
 	bool mode_v = false;
 	bool mode_q = false;
+#ifdef HYBRDLINK
+	bool server_mode = false;
+#endif
 
 	std::string temp_exe_path = argv[0];  // Store yosys excutable's directory for backend usage.
 	size_t last_loc = temp_exe_path.find_last_of("/\\");
@@ -320,6 +510,19 @@ int main(int argc, char **argv)
 		printf("    -U\n");
 		printf("        Enable encryption.\n");
 		printf("\n");
+		// -F 指定管道传输格式
+		printf("    -F <format>\n");
+		printf("        Select the pipe wire format: json (default), cbor or msgpack.\n");
+		printf("        Binary formats send a versioned header on every connection\n");
+		printf("        followed by length-prefixed frames.\n");
+		printf("\n");
+		// -Y 常驻服务器模式
+		printf("    -Y\n");
+		printf("        Run as a resident server (requires -K). Jobs are received as\n");
+		printf("        'run_job' commands on the CONTROL pipe and each job runs in a\n");
+		printf("        fresh design, until a 'shutdown' command is received.\n");
+		printf("        With -j <jobs>, up to <jobs> jobs are executed at the same time.\n");
+		printf("\n");
 #endif
 		printf("    -Q\n");
 		printf("        suppress printing of banner (copyright, disclaimer, version)\n");
@@ -341,11 +544,25 @@ int main(int argc, char **argv)
 		printf("    -d\n");
 		printf("        print more detailed timing stats at exit\n");
 		printf("\n");
+		printf("    -mem\n");
+		printf("        print per-command memory stats at exit (RSS growth and the change in\n");
+		printf("        IdStrings, cells, wires, SigSpec and Const bytes of the design)\n");
+		printf("\n");
+		printf("    -trace <tracefile>\n");
+		printf("        write a timeline of all commands, script labels, ABC runs, frontend\n");
+		printf("        reads and -j worker tasks in Chrome trace format (open in Perfetto)\n");
+		printf("\n");
+		printf("    -j <jobs>\n");
+		printf("        run passes that support it on up to <jobs> modules in parallel\n");
+		printf("        (0 = number of CPU cores; needs a build with YOSYS_ENABLE_THREADS).\n");
+		printf("        The default is taken from the YOSYS_THREADS environment variable.\n");
+		printf("\n");
 		printf("    -l logfile\n");
-		printf("        write log messages to the specified file\n");
+		printf("        write log messages to the specified file (written by a background\n");
+		printf("        thread in builds with YOSYS_ENABLE_THREADS)\n");
 		printf("\n");
 		printf("    -L logfile\n");
-		printf("        like -l but open log file in line buffered mode\n");
+		printf("        like -l but open log file in line buffered mode and write it directly\n");
 		printf("\n");
 		printf("    -o outfile\n");
 		printf("        write the design to the specified file on exit\n");
@@ -419,6 +636,11 @@ int main(int argc, char **argv)
 		printf("    -g\n");
 		printf("        globally enable debug log messages\n");
 		printf("\n");
+		printf("    -G <sink>=<level>[,<level>..]\n");
+		printf("        select which messages reach a log sink. <sink> is 'files' (log files\n");
+		printf("        and console) or 'pipe' (parent process), <level> is debug, info, all\n");
+		printf("        or none. messages no sink accepts are dropped before formatting.\n");
+		printf("\n");
 		printf("    -V\n");
 		printf("        print version information and exit\n");
 		printf("\n");
@@ -444,12 +666,42 @@ int main(int argc, char **argv)
 		exit(0);
 	}
 
+	// -mem and -trace are the only multi-letter options, remove them before
+	// getopt() would read them as '-m em' and '-t -r -a ...'
+	for (int i = 1; i < argc && strcmp(argv[i], "--"); i++) {
+		int num_args = 0;
+		if (!strcmp(argv[i], "-mem")) {
+			Pass::memory_accounting = true;
+			num_args = 1;
+		} else if (!strcmp(argv[i], "-trace")) {
+			if (i+1 >= argc) {
+				fprintf(stderr, "%s: option '-trace' expects an argument\n", argv[0]);
+				exit(1);
+			}
+			tracefile = argv[i+1];
+			num_args = 2;
+		}
+		if (num_args == 0)
+			continue;
+		for (int j = i; j+num_args <= argc; j++)
+			argv[j] = argv[j+num_args];
+		argc -= num_args, i--;
+	}
+
+	if (getenv("YOSYS_THREADS") != nullptr && getenv("YOSYS_THREADS")[0] != '\0') {
+		if (atoi(getenv("YOSYS_THREADS")) < 0) {
+			fprintf(stderr, "Invalid number of jobs `%s' in YOSYS_THREADS!\n", getenv("YOSYS_THREADS"));
+			exit(1);
+		}
+		set_parallel_jobs(atoi(getenv("YOSYS_THREADS")));
+	}
+
 	int opt;
 #ifdef HYBRDLINK
 	// R和U后不接参数，因此写在前半部分。K后需要接进程id，写到后面
-	while ((opt = getopt(argc, argv, "MXRUAQTVCSgm:f:Hh:b:o:p:l:L:K:qv:tds:c:W:w:e:r:D:P:E:x:B:")) != -1)
+	while ((opt = getopt(argc, argv, "MXRUYAQTVCSgm:f:Hh:b:o:p:l:L:K:F:G:qv:tdj:s:c:W:w:e:r:D:P:E:x:B:")) != -1)
 #else
-    while ((opt = getopt(argc, argv, "MXAQTVCSgm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:e:r:D:P:E:x:B:")) != -1)
+    while ((opt = getopt(argc, argv, "MXAQTVCSgm:f:Hh:b:o:p:l:L:G:qv:tdj:s:c:W:w:e:r:D:P:E:x:B:")) != -1)
 #endif
 	{
 		switch (opt)
@@ -465,6 +717,15 @@ int main(int argc, char **argv)
 		case 'U':
 			flag_fasm_encryption = true;
 			break;
+		case 'Y':
+			server_mode = true;
+			break;
+		case 'F':
+			if (!WireFormatFromString(optarg, Common::g_wire_format)) {
+				fprintf(stderr, "Unknown pipe wire format `%s'!\n", optarg);
+				exit(1);
+			}
+			break;
 #endif
 		case 'M':
 			memhasher_on();
@@ -526,6 +787,8 @@ int main(int argc, char **argv)
 			}
 			if (opt == 'L')
 				setvbuf(log_files.back(), NULL, _IOLBF, 0);
+			else
+				log_file_async(log_files.back());
 			break;
 		case 'q':
 			mode_q = true;
@@ -544,6 +807,13 @@ int main(int argc, char **argv)
 		case 'd':
 			timing_details = true;
 			break;
+		case 'j':
+			if (atoi(optarg) < 0) {
+				fprintf(stderr, "Invalid number of jobs `%s'!\n", optarg);
+				exit(1);
+			}
+			set_parallel_jobs(atoi(optarg));
+			break;
 		case 's':
 			scriptfile = optarg;
 			scriptfile_tcl = false;
@@ -555,13 +825,13 @@ int main(int argc, char **argv)
 			run_shell = false;
 			break;
 		case 'W':
-			log_warn_regexes.push_back(YS_REGEX_COMPILE(optarg));
+			log_warn_regexes.push_back(LogRegex(optarg));
 			break;
 		case 'w':
-			log_nowarn_regexes.push_back(YS_REGEX_COMPILE(optarg));
+			log_nowarn_regexes.push_back(LogRegex(optarg));
 			break;
 		case 'e':
-			log_werror_regexes.push_back(YS_REGEX_COMPILE(optarg));
+			log_werror_regexes.push_back(LogRegex(optarg));
 			break;
 		case 'r':
 			topmodule = optarg;
@@ -597,6 +867,12 @@ int main(int argc, char **argv)
 		case 'x':
 			log_experimentals_ignored.insert(optarg);
 			break;
+		case 'G':
+			if (!log_parse_sink_mask(optarg)) {
+				fprintf(stderr, "Invalid log sink mask `%s'!\n", optarg);
+				exit(1);
+			}
+			break;
 		case 'B':
 			perffile = optarg;
 			break;
@@ -671,12 +947,21 @@ int main(int argc, char **argv)
 	}
 #endif
 
-	yosys_setup();
 #ifdef HYBRDLINK
-	// 默认构建hybrdchip to xilinx原语映射关系
-	parser_hybrdchip_2_xilinx_json();
+	if (server_mode && Common::g_father_process_id == "-1") {
+		fprintf(stderr, "Server mode (-Y) requires the parent process ID (-K)!\n");
+		exit(1);
+	}
 #endif
 
+	yosys_setup();
+#ifdef HYBRDLINK
+	log_control_start(server_mode ? server_control_handler : std::function<bool(const nlohmann::json&)>());
+#else
+	log_control_start();
+#endif
+	if (!tracefile.empty())
+		trace_open(tracefile);
 #ifdef WITH_PYTHON
 	PyRun_SimpleString(("sys.path.append(\""+proc_self_dirname()+"\")").c_str());
 	PyRun_SimpleString(("sys.path.append(\""+proc_share_dirname()+"plugins\")").c_str());
@@ -695,6 +980,19 @@ int main(int argc, char **argv)
 		run_pass(vdef_cmd);
 	}
 
+#ifdef HYBRDLINK
+	if (server_mode) {
+		server_main();
+		run_shell = false;
+		passes_commands.clear();
+		frontend_files.clear();
+		scriptfile.clear();
+		topmodule.clear();
+		output_filename.clear();
+		optind = argc;
+	}
+#endif
+
 	if (scriptfile.empty() || !scriptfile_tcl) {
 		// Without a TCL script, arguments following '--' are also treated as frontend files
 		for (int i = optind; i < argc; ++i)
@@ -795,7 +1093,7 @@ int main(int argc, char **argv)
 			log("Warnings: %d experimental features used (not excluded with -x).\n", GetSize(log_experimentals));
 
 #ifdef _WIN32
-		log("End of script. Logfile hash: %s\n", hash.c_str());
+		log("End of script. Logfile hash: %s, MEM: %.2f MB peak\n", hash.c_str(), peak_rss_kb() / 1024.0);
 #else
 		std::string meminfo;
 		std::string stats_divider = ", ";
@@ -848,6 +1146,21 @@ int main(int argc, char **argv)
 				log("%5d%% %5d calls %8.3f sec %s\n", int(100*std::get<0>(*it) / total_ns),
 						std::get<1>(*it), std::get<0>(*it) / 1000000000.0, std::get<2>(*it).c_str());
 			}
+
+			log("SigSpec conversions:\n");
+			for (auto it = timedat.rbegin(); it != timedat.rend(); it++) {
+				Pass *pass = pass_register.at(std::get<2>(*it));
+				if (pass->sigspec_pack_count || pass->sigspec_unpack_count)
+					log("%12lld packs %12lld unpacks %s\n", (long long)pass->sigspec_pack_count,
+							(long long)pass->sigspec_unpack_count, std::get<2>(*it).c_str());
+			}
+
+			log("ModIndex rebuilds:\n");
+			for (auto it = timedat.rbegin(); it != timedat.rend(); it++) {
+				Pass *pass = pass_register.at(std::get<2>(*it));
+				if (pass->modindex_reload_count)
+					log("%12lld rebuilds %s\n", (long long)pass->modindex_reload_count, std::get<2>(*it).c_str());
+			}
 		}
 		else
 		{
@@ -865,6 +1178,28 @@ int main(int argc, char **argv)
 			log("%s\n", out_count ? "" : " no commands executed");
 #endif
 		}
+		if (Pass::memory_accounting)
+		{
+			std::vector<Pass*> mempasses;
+			for (auto &it : pass_register)
+				if (it.second->call_counter)
+					mempasses.push_back(it.second);
+			std::sort(mempasses.begin(), mempasses.end(), [](Pass *a, Pass *b) {
+				if (a->peak_rss_delta_kb != b->peak_rss_delta_kb)
+					return a->peak_rss_delta_kb > b->peak_rss_delta_kb;
+				return a->rss_delta_kb > b->rss_delta_kb;
+			});
+
+			log("Memory usage (current RSS %.2f MB, peak %.2f MB):\n", current_rss_kb() / 1024.0, peak_rss_kb() / 1024.0);
+			log("%10s %10s %10s %10s %10s %12s %12s  %s\n", "peak KB", "RSS KB", "IdStrings", "cells", "wires",
+					"SigSpec B", "Const B", "command");
+			for (auto pass : mempasses)
+				log("%10lld %10lld %10lld %10lld %10lld %12lld %12lld  %s\n", (long long)pass->peak_rss_delta_kb,
+						(long long)pass->rss_delta_kb, (long long)pass->census_delta.idstrings,
+						(long long)pass->census_delta.cells, (long long)pass->census_delta.wires,
+						(long long)pass->census_delta.sigspec_bytes, (long long)pass->census_delta.const_bytes,
+						pass->pass_name.c_str());
+		}
 		if(!perffile.empty())
 		{
 			FILE *f = fopen(perffile.c_str(), "wt");
@@ -881,8 +1216,22 @@ int main(int argc, char **argv)
 				if (!first)
 					fprintf(f, ",");
 				fprintf(f, "\n    \"%s\": {\n", std::get<2>(*it).c_str());
+				Pass *pass = pass_register.at(std::get<2>(*it));
 				fprintf(f, "      \"runtime_ns\": %" PRIu64 ",\n", std::get<0>(*it));
-				fprintf(f, "      \"num_calls\": %u\n", std::get<1>(*it));
+				fprintf(f, "      \"num_calls\": %u,\n", std::get<1>(*it));
+				fprintf(f, "      \"sigspec_packs\": %lld,\n", (long long)pass->sigspec_pack_count);
+				fprintf(f, "      \"sigspec_unpacks\": %lld,\n", (long long)pass->sigspec_unpack_count);
+				fprintf(f, "      \"modindex_reloads\": %lld%s\n", (long long)pass->modindex_reload_count,
+						Pass::memory_accounting ? "," : "");
+				if (Pass::memory_accounting) {
+					fprintf(f, "      \"peak_rss_delta_kb\": %lld,\n", (long long)pass->peak_rss_delta_kb);
+					fprintf(f, "      \"rss_delta_kb\": %lld,\n", (long long)pass->rss_delta_kb);
+					fprintf(f, "      \"idstrings_delta\": %lld,\n", (long long)pass->census_delta.idstrings);
+					fprintf(f, "      \"cells_delta\": %lld,\n", (long long)pass->census_delta.cells);
+					fprintf(f, "      \"wires_delta\": %lld,\n", (long long)pass->census_delta.wires);
+					fprintf(f, "      \"sigspec_bytes_delta\": %lld,\n", (long long)pass->census_delta.sigspec_bytes);
+					fprintf(f, "      \"const_bytes_delta\": %lld\n", (long long)pass->census_delta.const_bytes);
+				}
 				fprintf(f, "    }");
 				first = false;
 			}
@@ -926,6 +1275,7 @@ int main(int argc, char **argv)
 		abort();
 
 	log_flush();
+	Common::ShutdownPipes();
 #if defined(_MSC_VER)
 	_exit(0);
 #elif defined(_WIN32)
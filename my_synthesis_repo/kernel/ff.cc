@@ -21,247 +21,345 @@
 
 USING_YOSYS_NAMESPACE
 
-FfData::FfData(FfInitVals *initvals, Cell *cell_) : FfData(cell_->module, initvals, cell_->name)
+FfView::FfView(const Cell *cell) : cell(cell)
 {
-	cell = cell_;
-	sig_q = cell->getPort(ID::Q);
-	width = GetSize(sig_q);
-	attributes = cell->attributes;
-
-	if (initvals)
-		val_init = (*initvals)(sig_q);
-
-	std::string type_str = cell->type.str();
+	has_clk = false;
+	has_gclk = false;
+	has_ce = false;
+	has_aload = false;
+	has_srst = false;
+	has_arst = false;
+	has_sr = false;
+	ce_over_srst = false;
+	is_fine = false;
+	is_anyinit = false;
+	arst_from_ad = false;
+	pol_clk = false;
+	pol_aload = false;
+	pol_ce = false;
+	pol_arst = false;
+	pol_srst = false;
+	pol_clr = false;
+	pol_set = false;
+	fine_val_arst = State::Sx;
+	fine_val_srst = State::Sx;
+
+	const char *type_str = cell->type.c_str();
+	size_t type_len = strlen(type_str);
 
 	if (cell->type.in(ID($anyinit), ID($ff), ID($dff), ID($dffe), ID($dffsr), ID($dffsre), ID($adff), ID($adffe), ID($aldff), ID($aldffe), ID($sdff), ID($sdffe), ID($sdffce), ID($dlatch), ID($adlatch), ID($dlatchsr), ID($sr))) {
 		if (cell->type.in(ID($anyinit), ID($ff))) {
 			has_gclk = true;
-			sig_d = cell->getPort(ID::D);
-			if (cell->type == ID($anyinit)) {
-				is_anyinit = true;
-				log_assert(val_init.is_fully_undef());
-			}
+			port_d = ID::D;
+			is_anyinit = cell->type == ID($anyinit);
 		} else if (cell->type == ID($sr)) {
 			// No data input at all.
 		} else if (cell->type.in(ID($dlatch), ID($adlatch), ID($dlatchsr))) {
 			has_aload = true;
-			sig_aload = cell->getPort(ID::EN);
+			port_aload = ID::EN;
 			pol_aload = cell->getParam(ID::EN_POLARITY).as_bool();
-			sig_ad = cell->getPort(ID::D);
+			port_ad = ID::D;
 		} else {
 			has_clk = true;
-			sig_clk = cell->getPort(ID::CLK);
+			port_clk = ID::CLK;
 			pol_clk = cell->getParam(ID::CLK_POLARITY).as_bool();
-			sig_d = cell->getPort(ID::D);
+			port_d = ID::D;
 		}
 		if (cell->type.in(ID($dffe), ID($dffsre), ID($adffe), ID($aldffe), ID($sdffe), ID($sdffce))) {
 			has_ce = true;
-			sig_ce = cell->getPort(ID::EN);
+			port_ce = ID::EN;
 			pol_ce = cell->getParam(ID::EN_POLARITY).as_bool();
 		}
 		if (cell->type.in(ID($dffsr), ID($dffsre), ID($dlatchsr), ID($sr))) {
 			has_sr = true;
-			sig_clr = cell->getPort(ID::CLR);
-			sig_set = cell->getPort(ID::SET);
+			port_clr = ID::CLR;
+			port_set = ID::SET;
 			pol_clr = cell->getParam(ID::CLR_POLARITY).as_bool();
 			pol_set = cell->getParam(ID::SET_POLARITY).as_bool();
 		}
 		if (cell->type.in(ID($aldff), ID($aldffe))) {
 			has_aload = true;
-			sig_aload = cell->getPort(ID::ALOAD);
+			port_aload = ID::ALOAD;
 			pol_aload = cell->getParam(ID::ALOAD_POLARITY).as_bool();
-			sig_ad = cell->getPort(ID::AD);
+			port_ad = ID::AD;
 		}
 		if (cell->type.in(ID($adff), ID($adffe), ID($adlatch))) {
 			has_arst = true;
-			sig_arst = cell->getPort(ID::ARST);
+			port_arst = ID::ARST;
 			pol_arst = cell->getParam(ID::ARST_POLARITY).as_bool();
-			val_arst = cell->getParam(ID::ARST_VALUE);
 		}
 		if (cell->type.in(ID($sdff), ID($sdffe), ID($sdffce))) {
 			has_srst = true;
-			sig_srst = cell->getPort(ID::SRST);
+			port_srst = ID::SRST;
 			pol_srst = cell->getParam(ID::SRST_POLARITY).as_bool();
-			val_srst = cell->getParam(ID::SRST_VALUE);
 			ce_over_srst = cell->type == ID($sdffce);
 		}
 	} else if (cell->type == ID($_FF_)) {
 		is_fine = true;
 		has_gclk = true;
-		sig_d = cell->getPort(ID::D);
-	} else if (type_str.substr(0, 5) == "$_SR_") {
+		port_d = ID::D;
+	} else if (cell->type.begins_with("$_SR_")) {
 		is_fine = true;
 		has_sr = true;
 		pol_set = type_str[5] == 'P';
 		pol_clr = type_str[6] == 'P';
-		sig_set = cell->getPort(ID::S);
-		sig_clr = cell->getPort(ID::R);
-	} else if (type_str.substr(0, 6) == "$_DFF_" && type_str.size() == 8) {
+		port_set = ID::S;
+		port_clr = ID::R;
+	} else if (cell->type.begins_with("$_DFF_") && type_len == 8) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[6] == 'P';
-		sig_clk = cell->getPort(ID::C);
-	} else if (type_str.substr(0, 7) == "$_DFFE_" && type_str.size() == 10) {
+		port_clk = ID::C;
+	} else if (cell->type.begins_with("$_DFFE_") && type_len == 10) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[7] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_ce = true;
 		pol_ce = type_str[8] == 'P';
-		sig_ce = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 6) == "$_DFF_" && type_str.size() == 10) {
+		port_ce = ID::E;
+	} else if (cell->type.begins_with("$_DFF_") && type_len == 10) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[6] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_arst = true;
 		pol_arst = type_str[7] == 'P';
-		sig_arst = cell->getPort(ID::R);
-		val_arst = type_str[8] == '1' ? State::S1 : State::S0;
-	} else if (type_str.substr(0, 7) == "$_DFFE_" && type_str.size() == 12) {
+		port_arst = ID::R;
+		fine_val_arst = type_str[8] == '1' ? State::S1 : State::S0;
+	} else if (cell->type.begins_with("$_DFFE_") && type_len == 12) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[7] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_arst = true;
 		pol_arst = type_str[8] == 'P';
-		sig_arst = cell->getPort(ID::R);
-		val_arst = type_str[9] == '1' ? State::S1 : State::S0;
+		port_arst = ID::R;
+		fine_val_arst = type_str[9] == '1' ? State::S1 : State::S0;
 		has_ce = true;
 		pol_ce = type_str[10] == 'P';
-		sig_ce = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 8) == "$_ALDFF_" && type_str.size() == 11) {
+		port_ce = ID::E;
+	} else if (cell->type.begins_with("$_ALDFF_") && type_len == 11) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[8] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_aload = true;
 		pol_aload = type_str[9] == 'P';
-		sig_aload = cell->getPort(ID::L);
-		sig_ad = cell->getPort(ID::AD);
-	} else if (type_str.substr(0, 9) == "$_ALDFFE_" && type_str.size() == 13) {
+		port_aload = ID::L;
+		port_ad = ID::AD;
+	} else if (cell->type.begins_with("$_ALDFFE_") && type_len == 13) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[9] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_aload = true;
 		pol_aload = type_str[10] == 'P';
-		sig_aload = cell->getPort(ID::L);
-		sig_ad = cell->getPort(ID::AD);
+		port_aload = ID::L;
+		port_ad = ID::AD;
 		has_ce = true;
 		pol_ce = type_str[11] == 'P';
-		sig_ce = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 8) == "$_DFFSR_" && type_str.size() == 12) {
+		port_ce = ID::E;
+	} else if (cell->type.begins_with("$_DFFSR_") && type_len == 12) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[8] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_sr = true;
 		pol_set = type_str[9] == 'P';
 		pol_clr = type_str[10] == 'P';
-		sig_set = cell->getPort(ID::S);
-		sig_clr = cell->getPort(ID::R);
-	} else if (type_str.substr(0, 9) == "$_DFFSRE_" && type_str.size() == 14) {
+		port_set = ID::S;
+		port_clr = ID::R;
+	} else if (cell->type.begins_with("$_DFFSRE_") && type_len == 14) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[9] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_sr = true;
 		pol_set = type_str[10] == 'P';
 		pol_clr = type_str[11] == 'P';
-		sig_set = cell->getPort(ID::S);
-		sig_clr = cell->getPort(ID::R);
+		port_set = ID::S;
+		port_clr = ID::R;
 		has_ce = true;
 		pol_ce = type_str[12] == 'P';
-		sig_ce = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 7) == "$_SDFF_" && type_str.size() == 11) {
+		port_ce = ID::E;
+	} else if (cell->type.begins_with("$_SDFF_") && type_len == 11) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[7] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_srst = true;
 		pol_srst = type_str[8] == 'P';
-		sig_srst = cell->getPort(ID::R);
-		val_srst = type_str[9] == '1' ? State::S1 : State::S0;
-	} else if (type_str.substr(0, 8) == "$_SDFFE_" && type_str.size() == 13) {
+		port_srst = ID::R;
+		fine_val_srst = type_str[9] == '1' ? State::S1 : State::S0;
+	} else if (cell->type.begins_with("$_SDFFE_") && type_len == 13) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[8] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_srst = true;
 		pol_srst = type_str[9] == 'P';
-		sig_srst = cell->getPort(ID::R);
-		val_srst = type_str[10] == '1' ? State::S1 : State::S0;
+		port_srst = ID::R;
+		fine_val_srst = type_str[10] == '1' ? State::S1 : State::S0;
 		has_ce = true;
 		pol_ce = type_str[11] == 'P';
-		sig_ce = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 9) == "$_SDFFCE_" && type_str.size() == 14) {
+		port_ce = ID::E;
+	} else if (cell->type.begins_with("$_SDFFCE_") && type_len == 14) {
 		is_fine = true;
-		sig_d = cell->getPort(ID::D);
+		port_d = ID::D;
 		has_clk = true;
 		pol_clk = type_str[9] == 'P';
-		sig_clk = cell->getPort(ID::C);
+		port_clk = ID::C;
 		has_srst = true;
 		pol_srst = type_str[10] == 'P';
-		sig_srst = cell->getPort(ID::R);
-		val_srst = type_str[11] == '1' ? State::S1 : State::S0;
+		port_srst = ID::R;
+		fine_val_srst = type_str[11] == '1' ? State::S1 : State::S0;
 		has_ce = true;
 		pol_ce = type_str[12] == 'P';
-		sig_ce = cell->getPort(ID::E);
+		port_ce = ID::E;
 		ce_over_srst = true;
-	} else if (type_str.substr(0, 9) == "$_DLATCH_" && type_str.size() == 11) {
+	} else if (cell->type.begins_with("$_DLATCH_") && type_len == 11) {
 		is_fine = true;
 		has_aload = true;
-		sig_ad = cell->getPort(ID::D);
+		port_ad = ID::D;
 		has_aload = true;
 		pol_aload = type_str[9] == 'P';
-		sig_aload = cell->getPort(ID::E);
-	} else if (type_str.substr(0, 9) == "$_DLATCH_" && type_str.size() == 13) {
+		port_aload = ID::E;
+	} else if (cell->type.begins_with("$_DLATCH_") && type_len == 13) {
 		is_fine = true;
 		has_aload = true;
-		sig_ad = cell->getPort(ID::D);
+		port_ad = ID::D;
 		has_aload = true;
 		pol_aload = type_str[9] == 'P';
-		sig_aload = cell->getPort(ID::E);
+		port_aload = ID::E;
 		has_arst = true;
 		pol_arst = type_str[10] == 'P';
-		sig_arst = cell->getPort(ID::R);
-		val_arst = type_str[11] == '1' ? State::S1 : State::S0;
-	} else if (type_str.substr(0, 11) == "$_DLATCHSR_" && type_str.size() == 15) {
+		port_arst = ID::R;
+		fine_val_arst = type_str[11] == '1' ? State::S1 : State::S0;
+	} else if (cell->type.begins_with("$_DLATCHSR_") && type_len == 15) {
 		is_fine = true;
 		has_aload = true;
-		sig_ad = cell->getPort(ID::D);
+		port_ad = ID::D;
 		has_aload = true;
 		pol_aload = type_str[11] == 'P';
-		sig_aload = cell->getPort(ID::E);
+		port_aload = ID::E;
 		has_sr = true;
 		pol_set = type_str[12] == 'P';
 		pol_clr = type_str[13] == 'P';
-		sig_set = cell->getPort(ID::S);
-		sig_clr = cell->getPort(ID::R);
+		port_set = ID::S;
+		port_clr = ID::R;
 	} else {
 		log_assert(0);
 	}
-	if (has_aload && !has_clk && !has_sr && !has_arst && sig_ad.is_fully_const()) {
+	if (has_aload && !has_clk && !has_sr && !has_arst && sig_ad().is_fully_const()) {
 		// Plain D latches with const D treated specially.
 		has_aload = false;
 		has_arst = true;
-		sig_arst = sig_aload;
+		arst_from_ad = true;
+		port_arst = port_aload;
 		pol_arst = pol_aload;
-		val_arst = sig_ad.as_const();
 	}
 }
 
+const SigSpec &FfView::port(IdString name) const
+{
+	static const SigSpec empty;
+	if (name == IdString())
+		return empty;
+	return cell->getPort(name);
+}
+
+Const FfView::val_arst() const
+{
+	if (!has_arst)
+		return Const();
+	if (arst_from_ad)
+		return sig_ad().as_const();
+	if (is_fine)
+		return Const(fine_val_arst);
+	return cell->getParam(ID::ARST_VALUE);
+}
+
+Const FfView::val_srst() const
+{
+	if (!has_srst)
+		return Const();
+	if (is_fine)
+		return Const(fine_val_srst);
+	return cell->getParam(ID::SRST_VALUE);
+}
+
+State FfView::val_arst_bit(int i) const
+{
+	if (arst_from_ad)
+		return sig_ad()[i].data;
+	if (is_fine)
+		return fine_val_arst;
+	return cell->getParam(ID::ARST_VALUE)[i];
+}
+
+State FfView::val_srst_bit(int i) const
+{
+	if (is_fine)
+		return fine_val_srst;
+	return cell->getParam(ID::SRST_VALUE)[i];
+}
+
+FfData::FfData(FfInitVals *initvals, Cell *cell_) : FfData(cell_->module, initvals, cell_->name)
+{
+	cell = cell_;
+	FfView view(cell);
+	sig_q = view.sig_q();
+	width = GetSize(sig_q);
+	attributes = cell->attributes;
+
+	if (initvals)
+		val_init = (*initvals)(sig_q);
+
+	has_clk = view.has_clk;
+	has_gclk = view.has_gclk;
+	has_ce = view.has_ce;
+	has_aload = view.has_aload;
+	has_srst = view.has_srst;
+	has_arst = view.has_arst;
+	has_sr = view.has_sr;
+	ce_over_srst = view.ce_over_srst;
+	is_fine = view.is_fine;
+	is_anyinit = view.is_anyinit;
+	pol_clk = view.pol_clk;
+	pol_ce = view.pol_ce;
+	pol_aload = view.pol_aload;
+	pol_arst = view.pol_arst;
+	pol_srst = view.pol_srst;
+	pol_clr = view.pol_clr;
+	pol_set = view.pol_set;
+
+	if (is_anyinit)
+		log_assert(val_init.is_fully_undef());
+
+	sig_d = view.sig_d();
+	sig_ad = view.sig_ad();
+	sig_clk = view.sig_clk();
+	sig_ce = view.sig_ce();
+	sig_aload = view.sig_aload();
+	sig_arst = view.sig_arst();
+	sig_srst = view.sig_srst();
+	sig_clr = view.sig_clr();
+	sig_set = view.sig_set();
+	val_arst = view.val_arst();
+	val_srst = view.val_srst();
+}
+
 FfData FfData::slice(const std::vector<int> &bits) {
 	FfData res(module, initvals, NEW_ID);
 	res.sig_clk = sig_clk;
@@ -25,6 +25,65 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+// A read-only view of a FF cell.  Decodes the cell type and parameters the
+// same way as the FfData constructor, but keeps only port names, so the
+// sig_* accessors return references to the cell's own connections and
+// constructing a view does not allocate.  The flags and polarities have the
+// same meaning as in FfData.  Anything that needs to change the FF (or keep
+// it past modifications of the cell) should copy it into FfData instead.
+struct FfView {
+	const Cell *cell;
+	bool has_clk;
+	bool has_gclk;
+	bool has_ce;
+	bool has_aload;
+	bool has_srst;
+	bool has_arst;
+	bool has_sr;
+	bool ce_over_srst;
+	bool is_fine;
+	bool is_anyinit;
+	bool pol_clk;
+	bool pol_ce;
+	bool pol_aload;
+	bool pol_arst;
+	bool pol_srst;
+	bool pol_clr;
+	bool pol_set;
+
+	FfView(const Cell *cell);
+
+	const SigSpec &sig_q() const { return cell->getPort(ID::Q); }
+	const SigSpec &sig_d() const { return port(port_d); }
+	const SigSpec &sig_ad() const { return port(port_ad); }
+	const SigSpec &sig_clk() const { return port(port_clk); }
+	const SigSpec &sig_ce() const { return port(port_ce); }
+	const SigSpec &sig_aload() const { return port(port_aload); }
+	const SigSpec &sig_arst() const { return port(port_arst); }
+	const SigSpec &sig_srst() const { return port(port_srst); }
+	const SigSpec &sig_clr() const { return port(port_clr); }
+	const SigSpec &sig_set() const { return port(port_set); }
+	int width() const { return GetSize(sig_q()); }
+
+	// The reset values, empty if the corresponding reset is not present.
+	Const val_arst() const;
+	Const val_srst() const;
+	// Single bits of the reset values, without building a Const.
+	State val_arst_bit(int i) const;
+	State val_srst_bit(int i) const;
+
+private:
+	IdString port_d, port_ad, port_clk, port_ce, port_aload;
+	IdString port_arst, port_srst, port_clr, port_set;
+	// Reset values of fine cells, which are encoded in the cell type.
+	State fine_val_arst, fine_val_srst;
+	// Set for a D latch with const D, which is presented as a plain async
+	// reset to the D value.
+	bool arst_from_ad;
+
+	const SigSpec &port(IdString name) const;
+};
+
 // Describes a flip-flop or a latch.
 //
 // If has_gclk, this is a formal verification FF with implicit global clock:
@@ -90,6 +90,8 @@ struct FfInitVals
 		else if (val == State::Sx)
 			return;
 		log_assert(abit.wire);
+		if (abit.wire->module)
+			abit.wire->module->generation_++;
 		initbits[mbit] = std::make_pair(val,abit);
 		auto it2 = abit.wire->attributes.find(ID::init);
 		if (it2 != abit.wire->attributes.end()) {
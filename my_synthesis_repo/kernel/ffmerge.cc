@@ -28,11 +28,104 @@ bool FfMergeHelper::is_output_unused(RTLIL::SigSpec sig) {
 	return true;
 }
 
+// Copies the control signals and polarities of a FF bit into the merged FF.
+static void copy_ff_controls(FfData &ff, const FfData &cur_ff)
+{
+	ff.sig_clk = cur_ff.sig_clk;
+	ff.sig_ce = cur_ff.sig_ce;
+	ff.sig_aload = cur_ff.sig_aload;
+	ff.sig_srst = cur_ff.sig_srst;
+	ff.sig_arst = cur_ff.sig_arst;
+	ff.has_clk = cur_ff.has_clk;
+	ff.has_gclk = cur_ff.has_gclk;
+	ff.has_ce = cur_ff.has_ce;
+	ff.has_aload = cur_ff.has_aload;
+	ff.has_srst = cur_ff.has_srst;
+	ff.has_arst = cur_ff.has_arst;
+	ff.has_sr = cur_ff.has_sr;
+	ff.ce_over_srst = cur_ff.ce_over_srst;
+	ff.pol_clk = cur_ff.pol_clk;
+	ff.pol_ce = cur_ff.pol_ce;
+	ff.pol_aload = cur_ff.pol_aload;
+	ff.pol_arst = cur_ff.pol_arst;
+	ff.pol_srst = cur_ff.pol_srst;
+	ff.pol_clr = cur_ff.pol_clr;
+	ff.pol_set = cur_ff.pol_set;
+}
+
+// Checks that a FF cell has the same controls as the merged FF, so that its
+// bits can be appended to it.
+static bool same_ff_controls(const FfData &ff, const FfData &cur_ff)
+{
+	if (ff.has_gclk != cur_ff.has_gclk)
+		return false;
+	if (ff.has_clk != cur_ff.has_clk)
+		return false;
+	if (ff.has_ce != cur_ff.has_ce)
+		return false;
+	if (ff.has_aload != cur_ff.has_aload)
+		return false;
+	if (ff.has_srst != cur_ff.has_srst)
+		return false;
+	if (ff.has_arst != cur_ff.has_arst)
+		return false;
+	if (ff.has_sr != cur_ff.has_sr)
+		return false;
+	if (ff.has_clk) {
+		if (ff.sig_clk != cur_ff.sig_clk)
+			return false;
+		if (ff.pol_clk != cur_ff.pol_clk)
+			return false;
+	}
+	if (ff.has_ce) {
+		if (ff.sig_ce != cur_ff.sig_ce)
+			return false;
+		if (ff.pol_ce != cur_ff.pol_ce)
+			return false;
+	}
+	if (ff.has_aload) {
+		if (ff.sig_aload != cur_ff.sig_aload)
+			return false;
+		if (ff.pol_aload != cur_ff.pol_aload)
+			return false;
+	}
+	if (ff.has_srst) {
+		if (ff.sig_srst != cur_ff.sig_srst)
+			return false;
+		if (ff.pol_srst != cur_ff.pol_srst)
+			return false;
+		if (ff.has_ce && ff.ce_over_srst != cur_ff.ce_over_srst)
+			return false;
+	}
+	if (ff.has_arst) {
+		if (ff.sig_arst != cur_ff.sig_arst)
+			return false;
+		if (ff.pol_arst != cur_ff.pol_arst)
+			return false;
+	}
+	if (ff.has_sr) {
+		if (ff.pol_clr != cur_ff.pol_clr)
+			return false;
+		if (ff.pol_set != cur_ff.pol_set)
+			return false;
+	}
+	return true;
+}
+
+const FfData &FfMergeHelper::cell_ff(Cell *cell)
+{
+	auto it = ff_cache.find(cell);
+	if (it == ff_cache.end())
+		it = ff_cache.emplace(cell, FfData(initvals, cell)).first;
+	return it->second;
+}
+
 bool FfMergeHelper::find_output_ff(RTLIL::SigSpec sig, FfData &ff, pool<std::pair<Cell *, int>> &bits) {
 	ff = FfData(module, initvals, NEW_ID);
 	sigmap->apply(sig);
 
 	bool found = false;
+	pool<Cell*> checked_cells;
 
 	for (auto bit : sig)
 	{
@@ -60,7 +153,7 @@ bool FfMergeHelper::find_output_ff(RTLIL::SigSpec sig, FfData &ff, pool<std::pai
 		std::tie(cell, idx) = *sinks.begin();
 		bits.insert(std::make_pair(cell, idx));
 
-		FfData cur_ff(initvals, cell);
+		const FfData &cur_ff = cell_ff(cell);
 
 		// Reject latches and $ff.
 		if (!cur_ff.has_clk)
@@ -68,77 +161,13 @@ bool FfMergeHelper::find_output_ff(RTLIL::SigSpec sig, FfData &ff, pool<std::pai
 
 		log_assert((*sigmap)(cur_ff.sig_d[idx]) == bit);
 
+		// the controls are compared once per FF cell, not once per bit
 		if (!found) {
-			ff.sig_clk = cur_ff.sig_clk;
-			ff.sig_ce = cur_ff.sig_ce;
-			ff.sig_aload = cur_ff.sig_aload;
-			ff.sig_srst = cur_ff.sig_srst;
-			ff.sig_arst = cur_ff.sig_arst;
-			ff.has_clk = cur_ff.has_clk;
-			ff.has_ce = cur_ff.has_ce;
-			ff.has_aload = cur_ff.has_aload;
-			ff.has_srst = cur_ff.has_srst;
-			ff.has_arst = cur_ff.has_arst;
-			ff.has_sr = cur_ff.has_sr;
-			ff.ce_over_srst = cur_ff.ce_over_srst;
-			ff.pol_clk = cur_ff.pol_clk;
-			ff.pol_ce = cur_ff.pol_ce;
-			ff.pol_aload = cur_ff.pol_aload;
-			ff.pol_arst = cur_ff.pol_arst;
-			ff.pol_srst = cur_ff.pol_srst;
-			ff.pol_clr = cur_ff.pol_clr;
-			ff.pol_set = cur_ff.pol_set;
-		} else {
-			if (ff.has_clk != cur_ff.has_clk)
-				return false;
-			if (ff.has_ce != cur_ff.has_ce)
-				return false;
-			if (ff.has_aload != cur_ff.has_aload)
-				return false;
-			if (ff.has_srst != cur_ff.has_srst)
-				return false;
-			if (ff.has_arst != cur_ff.has_arst)
-				return false;
-			if (ff.has_sr != cur_ff.has_sr)
-				return false;
-			if (ff.has_clk) {
-				if (ff.sig_clk != cur_ff.sig_clk)
-					return false;
-				if (ff.pol_clk != cur_ff.pol_clk)
-					return false;
-			}
-			if (ff.has_ce) {
-				if (ff.sig_ce != cur_ff.sig_ce)
-					return false;
-				if (ff.pol_ce != cur_ff.pol_ce)
-					return false;
-			}
-			if (ff.has_aload) {
-				if (ff.sig_aload != cur_ff.sig_aload)
-					return false;
-				if (ff.pol_aload != cur_ff.pol_aload)
-					return false;
-			}
-			if (ff.has_srst) {
-				if (ff.sig_srst != cur_ff.sig_srst)
-					return false;
-				if (ff.pol_srst != cur_ff.pol_srst)
-					return false;
-				if (ff.has_ce && ff.ce_over_srst != cur_ff.ce_over_srst)
-					return false;
-			}
-			if (ff.has_arst) {
-				if (ff.sig_arst != cur_ff.sig_arst)
-					return false;
-				if (ff.pol_arst != cur_ff.pol_arst)
-					return false;
-			}
-			if (ff.has_sr) {
-				if (ff.pol_clr != cur_ff.pol_clr)
-					return false;
-				if (ff.pol_set != cur_ff.pol_set)
-					return false;
-			}
+			copy_ff_controls(ff, cur_ff);
+			ff.has_gclk = false;
+			checked_cells.insert(cell);
+		} else if (checked_cells.insert(cell).second && !same_ff_controls(ff, cur_ff)) {
+			return false;
 		}
 
 		ff.width++;
@@ -161,6 +190,7 @@ bool FfMergeHelper::find_input_ff(RTLIL::SigSpec sig, FfData &ff, pool<std::pair
 	sigmap->apply(sig);
 
 	bool found = false;
+	pool<Cell*> checked_cells;
 
 	pool<int> const_bits;
 
@@ -188,84 +218,16 @@ bool FfMergeHelper::find_input_ff(RTLIL::SigSpec sig, FfData &ff, pool<std::pair
 		std::tie(cell, idx) = dff_driver[bit];
 		bits.insert(std::make_pair(cell, idx));
 
-		FfData cur_ff(initvals, cell);
+		const FfData &cur_ff = cell_ff(cell);
 
 		log_assert((*sigmap)(cur_ff.sig_q[idx]) == bit);
 
+		// the controls are compared once per FF cell, not once per bit
 		if (!found) {
-			ff.sig_clk = cur_ff.sig_clk;
-			ff.sig_ce = cur_ff.sig_ce;
-			ff.sig_aload = cur_ff.sig_aload;
-			ff.sig_srst = cur_ff.sig_srst;
-			ff.sig_arst = cur_ff.sig_arst;
-			ff.has_clk = cur_ff.has_clk;
-			ff.has_gclk = cur_ff.has_gclk;
-			ff.has_ce = cur_ff.has_ce;
-			ff.has_aload = cur_ff.has_aload;
-			ff.has_srst = cur_ff.has_srst;
-			ff.has_arst = cur_ff.has_arst;
-			ff.has_sr = cur_ff.has_sr;
-			ff.ce_over_srst = cur_ff.ce_over_srst;
-			ff.pol_clk = cur_ff.pol_clk;
-			ff.pol_ce = cur_ff.pol_ce;
-			ff.pol_aload = cur_ff.pol_aload;
-			ff.pol_arst = cur_ff.pol_arst;
-			ff.pol_srst = cur_ff.pol_srst;
-			ff.pol_clr = cur_ff.pol_clr;
-			ff.pol_set = cur_ff.pol_set;
-		} else {
-			if (ff.has_gclk != cur_ff.has_gclk)
-				return false;
-			if (ff.has_clk != cur_ff.has_clk)
-				return false;
-			if (ff.has_ce != cur_ff.has_ce)
-				return false;
-			if (ff.has_aload != cur_ff.has_aload)
-				return false;
-			if (ff.has_srst != cur_ff.has_srst)
-				return false;
-			if (ff.has_arst != cur_ff.has_arst)
-				return false;
-			if (ff.has_sr != cur_ff.has_sr)
-				return false;
-			if (ff.has_clk) {
-				if (ff.sig_clk != cur_ff.sig_clk)
-					return false;
-				if (ff.pol_clk != cur_ff.pol_clk)
-					return false;
-			}
-			if (ff.has_ce) {
-				if (ff.sig_ce != cur_ff.sig_ce)
-					return false;
-				if (ff.pol_ce != cur_ff.pol_ce)
-					return false;
-			}
-			if (ff.has_aload) {
-				if (ff.sig_aload != cur_ff.sig_aload)
-					return false;
-				if (ff.pol_aload != cur_ff.pol_aload)
-					return false;
-			}
-			if (ff.has_srst) {
-				if (ff.sig_srst != cur_ff.sig_srst)
-					return false;
-				if (ff.pol_srst != cur_ff.pol_srst)
-					return false;
-				if (ff.has_ce && ff.ce_over_srst != cur_ff.ce_over_srst)
-					return false;
-			}
-			if (ff.has_arst) {
-				if (ff.sig_arst != cur_ff.sig_arst)
-					return false;
-				if (ff.pol_arst != cur_ff.pol_arst)
-					return false;
-			}
-			if (ff.has_sr) {
-				if (ff.pol_clr != cur_ff.pol_clr)
-					return false;
-				if (ff.pol_set != cur_ff.pol_set)
-					return false;
-			}
+			copy_ff_controls(ff, cur_ff);
+			checked_cells.insert(cell);
+		} else if (checked_cells.insert(cell).second && !same_ff_controls(ff, cur_ff)) {
+			return false;
 		}
 
 		ff.width++;
@@ -303,6 +265,7 @@ void FfMergeHelper::remove_output_ff(const pool<std::pair<Cell *, int>> &bits) {
 		dff_driver.erase((*sigmap)(q[idx]));
 		q[idx] = module->addWire(stringf("$ffmerge_disconnected$%d", autoidx++));
 		cell->setPort(ID::Q, q);
+		ff_cache.erase(cell);
 	}
 }
 
@@ -353,6 +316,7 @@ void FfMergeHelper::set(FfInitVals *initvals_, RTLIL::Module *module_)
 }
 
 void FfMergeHelper::clear() {
+	ff_cache.clear();
 	dff_driver.clear();
 	dff_sink.clear();
 	sigbit_users_count.clear();
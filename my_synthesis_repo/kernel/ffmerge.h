@@ -66,6 +66,11 @@ struct FfMergeHelper
 	dict<SigBit, pool<std::pair<Cell*, int>>> dff_sink;
 	dict<SigBit, int> sigbit_users_count;
 
+	// FfData of the FF cells looked at so far, dropped when
+	// remove_output_ff changes the cell
+	dict<Cell*, FfData> ff_cache;
+	const FfData &cell_ff(Cell *cell);
+
 	// Returns true if all bits in sig are completely unused.
 	bool is_output_unused(RTLIL::SigSpec sig);
 
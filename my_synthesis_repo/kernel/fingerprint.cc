@@ -0,0 +1,256 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/fingerprint.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// splitmix64 finalizer
+static inline uint64_t fingerprint_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+void FingerprintHasher::add(uint64_t value)
+{
+	state = fingerprint_mix(state ^ (value + 0x9e3779b97f4a7c15ull));
+}
+
+void FingerprintHasher::add(const char *data, size_t size)
+{
+	// assembled byte by byte, so that the result does not depend on endianness
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word = 0;
+		for (int k = 0; k < 8; k++)
+			word |= uint64_t((unsigned char)data[i+k]) << (8*k);
+		add(word);
+	}
+	uint64_t tail = 0;
+	for (int k = 0; i < size; i++, k++)
+		tail |= uint64_t((unsigned char)data[i]) << (8*k);
+	add(tail ^ (uint64_t(size) << 56));
+}
+
+static void add_states(FingerprintHasher &h, const std::vector<RTLIL::State> &bits)
+{
+	// 16 states of 4 bits each per word
+	h.add(bits.size());
+	uint64_t word = 0;
+	int count = 0;
+	for (auto bit : bits) {
+		word |= uint64_t(bit & 15) << (4*count);
+		if (++count == 16) {
+			h.add(word);
+			word = 0, count = 0;
+		}
+	}
+	if (count > 0)
+		h.add(word);
+}
+
+void FingerprintHasher::add(const RTLIL::Const &value)
+{
+	add(uint64_t(value.flags));
+	add_states(*this, value.bits);
+}
+
+void FingerprintHasher::add(const RTLIL::SigSpec &sig)
+{
+	add(uint64_t(sig.size()));
+	for (auto &chunk : sig.chunks()) {
+		if (chunk.wire != nullptr) {
+			add(chunk.wire->name);
+			add(uint64_t(chunk.offset) << 32 | uint32_t(chunk.width));
+		} else
+			add_states(*this, chunk.data);
+	}
+}
+
+void FingerprintHasher::add(const dict<RTLIL::IdString, RTLIL::Const> &attributes)
+{
+	uint64_t sum = 0;
+	for (auto &it : attributes) {
+		FingerprintHasher entry;
+		entry.add(it.first);
+		entry.add(it.second);
+		sum += entry.get();
+	}
+	add(attributes.size());
+	add(sum);
+}
+
+uint64_t fingerprint_wire(const RTLIL::Wire *wire, bool attributes)
+{
+	FingerprintHasher h;
+	h.add(wire->name);
+	h.add(uint64_t(wire->width) << 32 | uint32_t(wire->start_offset));
+	h.add(uint64_t(wire->port_id) << 4 | (wire->port_input ? 1 : 0) | (wire->port_output ? 2 : 0) |
+			(wire->upto ? 4 : 0) | (wire->is_signed ? 8 : 0));
+	if (attributes)
+		h.add(wire->attributes);
+	return h.get();
+}
+
+uint64_t fingerprint_cell(const RTLIL::Cell *cell, bool attributes)
+{
+	FingerprintHasher h;
+	h.add(cell->name);
+	h.add(cell->type);
+	h.add(cell->parameters);
+
+	uint64_t sum = 0;
+	for (auto &conn : cell->connections()) {
+		FingerprintHasher port;
+		port.add(conn.first);
+		port.add(conn.second);
+		sum += port.get();
+	}
+	h.add(cell->connections().size());
+	h.add(sum);
+
+	if (attributes)
+		h.add(cell->attributes);
+	return h.get();
+}
+
+uint64_t fingerprint_memory(const RTLIL::Memory *memory, bool attributes)
+{
+	FingerprintHasher h;
+	h.add(memory->name);
+	h.add(uint64_t(memory->width) << 32 | uint32_t(memory->start_offset));
+	h.add(uint64_t(memory->size));
+	if (attributes)
+		h.add(memory->attributes);
+	return h.get();
+}
+
+static void add_case(FingerprintHasher &h, const RTLIL::CaseRule *cs, bool attributes)
+{
+	h.add(cs->compare.size());
+	for (auto &sig : cs->compare)
+		h.add(sig);
+	h.add(cs->actions.size());
+	for (auto &action : cs->actions) {
+		h.add(action.first);
+		h.add(action.second);
+	}
+	h.add(cs->switches.size());
+	for (auto sw : cs->switches) {
+		h.add(sw->signal);
+		h.add(sw->cases.size());
+		for (auto sub : sw->cases)
+			add_case(h, sub, attributes);
+		if (attributes)
+			h.add(sw->attributes);
+	}
+	if (attributes)
+		h.add(cs->attributes);
+}
+
+uint64_t fingerprint_process(const RTLIL::Process *process, bool attributes)
+{
+	FingerprintHasher h;
+	h.add(process->name);
+	add_case(h, &process->root_case, attributes);
+	h.add(process->syncs.size());
+	for (auto sync : process->syncs) {
+		h.add(uint64_t(sync->type));
+		h.add(sync->signal);
+		h.add(sync->actions.size());
+		for (auto &action : sync->actions) {
+			h.add(action.first);
+			h.add(action.second);
+		}
+		h.add(sync->mem_write_actions.size());
+		for (auto &action : sync->mem_write_actions) {
+			h.add(action.memid);
+			h.add(action.address);
+			h.add(action.data);
+			h.add(action.enable);
+			h.add(action.priority_mask);
+			if (attributes)
+				h.add(action.attributes);
+		}
+	}
+	if (attributes)
+		h.add(process->attributes);
+	return h.get();
+}
+
+uint64_t fingerprint_connection(const RTLIL::SigSig &conn)
+{
+	FingerprintHasher h;
+	h.add(conn.first);
+	h.add(conn.second);
+	return h.get();
+}
+
+uint64_t module_fingerprint(const RTLIL::Module *module, bool attributes)
+{
+	FingerprintHasher h;
+	uint64_t sum;
+
+	sum = 0;
+	for (auto &it : module->wires_)
+		sum += fingerprint_wire(it.second, attributes);
+	h.add(module->wires_.size());
+	h.add(sum);
+
+	sum = 0;
+	for (auto &it : module->cells_)
+		sum += fingerprint_cell(it.second, attributes);
+	h.add(module->cells_.size());
+	h.add(sum);
+
+	sum = 0;
+	for (auto &conn : module->connections_)
+		sum += fingerprint_connection(conn);
+	h.add(module->connections_.size());
+	h.add(sum);
+
+	sum = 0;
+	for (auto &it : module->memories)
+		sum += fingerprint_memory(it.second, attributes);
+	h.add(module->memories.size());
+	h.add(sum);
+
+	sum = 0;
+	for (auto &it : module->processes)
+		sum += fingerprint_process(it.second, attributes);
+	h.add(module->processes.size());
+	h.add(sum);
+
+	h.add(module->parameter_default_values);
+	if (attributes)
+		h.add(module->attributes);
+	return h.get();
+}
+
+std::string module_fingerprint_str(const RTLIL::Module *module, bool attributes)
+{
+	return stringf("%016llx", (unsigned long long)module_fingerprint(module, attributes));
+}
+
+YOSYS_NAMESPACE_END
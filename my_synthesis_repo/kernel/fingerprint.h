@@ -0,0 +1,71 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// 64-bit content hashes of RTLIL objects, for use as cache keys (ABC
+// results, derived modules, techlib caches, ...). Unlike hash() and the
+// hashlib hashes, which use IdString indexes and object counters, these only
+// depend on names and values, so they are the same in every run and on every
+// platform for the same content.
+//
+// A module fingerprint covers its wires, cells, connections, memories,
+// processes and attributes, but not the module name, so that equal modules
+// under different names match. It does not depend on the order in which
+// objects were added: the per-object hashes below are summed, and a cache
+// can update a stored module fingerprint for a single changed object by
+// subtracting its old hash and adding the new one.
+//
+// With attributes = false, attributes of the module and all its objects are
+// left out, e.g. to ignore differing src locations.
+
+struct FingerprintHasher
+{
+	uint64_t state = 0x243f6a8885a308d3ull;
+
+	void add(uint64_t value);
+	void add(const char *data, size_t size);
+	void add(const std::string &str) { add(str.data(), str.size()); }
+	void add(RTLIL::IdString id) { add(id.c_str(), strlen(id.c_str())); }
+	void add(const RTLIL::Const &value);
+	void add(const RTLIL::SigSpec &sig);
+	void add(const dict<RTLIL::IdString, RTLIL::Const> &attributes);
+
+	uint64_t get() const { return state; }
+};
+
+uint64_t fingerprint_wire(const RTLIL::Wire *wire, bool attributes = true);
+uint64_t fingerprint_cell(const RTLIL::Cell *cell, bool attributes = true);
+uint64_t fingerprint_memory(const RTLIL::Memory *memory, bool attributes = true);
+uint64_t fingerprint_process(const RTLIL::Process *process, bool attributes = true);
+uint64_t fingerprint_connection(const RTLIL::SigSig &conn);
+
+uint64_t module_fingerprint(const RTLIL::Module *module, bool attributes = true);
+
+// module_fingerprint() as 16 hex digits
+std::string module_fingerprint_str(const RTLIL::Module *module, bool attributes = true);
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -692,55 +692,113 @@ void Fmt::emit_cxxrtl(std::ostream &os, std::string indent, std::function<void(c
 	os << indent << "return buf;\n";
 }
 
-std::string Fmt::render() const
+// Renders a fully defined integer of at most 64 bits using machine arithmetic,
+// with the same output as the generic path in render_part() below.
+static void render_integer_u64(std::string &buf, std::string &prefix, const FmtPart &part, const RTLIL::Const &arg)
 {
-	std::string str;
+	int size = arg.size();
+	uint64_t value = 0;
+	for (int i = 0; i < size; i++)
+		if (arg[i] == State::S1)
+			value |= uint64_t(1) << i;
+
+	if (part.signed_ && arg[size - 1] == State::S1) {
+		prefix = "-";
+		if (size < 64)
+			value |= ~uint64_t(0) << size;
+		value = 0 - value;
+	} else {
+		switch (part.sign) {
+			case FmtPart::MINUS:       break;
+			case FmtPart::PLUS_MINUS:  prefix = "+"; break;
+			case FmtPart::SPACE_MINUS: prefix = " "; break;
+		}
+	}
 
-	for (auto &part : parts) {
-		switch (part.type) {
-			case FmtPart::LITERAL:
-				str += part.str;
-				break;
+	if (part.base == 10) {
+		if (part.show_base)
+			prefix += "0d";
+		size_t index = 0;
+		do {
+			if (part.group && index > 0 && index % 3 == 0)
+				buf += '_';
+			buf += '0' + value % 10;
+			value /= 10;
+			index++;
+		} while (value != 0);
+	} else {
+		int shift;
+		switch (part.base) {
+			case 2:  shift = 1; break;
+			case 8:  shift = 3; break;
+			case 16: shift = 4; break;
+			default: log_abort();
+		}
+		if (part.show_base)
+			prefix += (part.base == 16) ? (part.hex_upper ? "0X" : "0x") : (part.base == 8) ? "0o" : "0b";
+		const char *digits = part.hex_upper ? "0123456789ABCDEF" : "0123456789abcdef";
+		size_t index = 0;
+		do {
+			if (part.group && index > 0 && index % 4 == 0)
+				buf += '_';
+			buf += digits[value & ((1 << shift) - 1)];
+			value >>= shift;
+			index++;
+		} while (value != 0);
+	}
+}
 
-			case FmtPart::UNICHAR: {
-				RTLIL::Const value = part.sig.as_const();
-				uint32_t codepoint = value.as_int();
-				if (codepoint >= 0x10000)
-					str += (char)(0xf0 |  (codepoint >> 18));
-				else if (codepoint >= 0x800)
-					str += (char)(0xe0 |  (codepoint >> 12));
-				else if (codepoint >= 0x80)
-					str += (char)(0xc0 |  (codepoint >>  6));
-				else
-					str += (char)codepoint;
-				if (codepoint >= 0x10000)
-					str += (char)(0x80 | ((codepoint >> 12) & 0x3f));
-				if (codepoint >= 0x800)
-					str += (char)(0x80 | ((codepoint >>  6) & 0x3f));
-				if (codepoint >= 0x80)
-					str += (char)(0x80 | ((codepoint >>  0) & 0x3f));
-				break;
-			}
+// Appends the rendering of a single part to `str`, with `arg` being the value
+// of its signal. `scratch` is only used as a reusable buffer.
+static void render_part(std::string &str, std::string &scratch, const FmtPart &part, const RTLIL::Const &arg)
+{
+	switch (part.type) {
+		case FmtPart::LITERAL:
+			str += part.str;
+			break;
+
+		case FmtPart::UNICHAR: {
+			uint32_t codepoint = arg.as_int();
+			if (codepoint >= 0x10000)
+				str += (char)(0xf0 |  (codepoint >> 18));
+			else if (codepoint >= 0x800)
+				str += (char)(0xe0 |  (codepoint >> 12));
+			else if (codepoint >= 0x80)
+				str += (char)(0xc0 |  (codepoint >>  6));
+			else
+				str += (char)codepoint;
+			if (codepoint >= 0x10000)
+				str += (char)(0x80 | ((codepoint >> 12) & 0x3f));
+			if (codepoint >= 0x800)
+				str += (char)(0x80 | ((codepoint >>  6) & 0x3f));
+			if (codepoint >= 0x80)
+				str += (char)(0x80 | ((codepoint >>  0) & 0x3f));
+			break;
+		}
 
-			case FmtPart::INTEGER:
-			case FmtPart::STRING:
-			case FmtPart::VLOG_TIME: {
-				std::string buf;
-				std::string prefix;
-				if (part.type == FmtPart::INTEGER) {
-					RTLIL::Const value = part.sig.as_const();
-					bool has_x = false, all_x = true, has_z = false, all_z = true;
-					for (State bit : value) {
-						if (bit == State::Sx)
-							has_x = true;
-						else
-							all_x = false;
-						if (bit == State::Sz)
-							has_z = true;
-						else
-							all_z = false;
-					}
+		case FmtPart::INTEGER:
+		case FmtPart::STRING:
+		case FmtPart::VLOG_TIME: {
+			std::string &buf = scratch;
+			std::string prefix;
+			buf.clear();
+			if (part.type == FmtPart::INTEGER) {
+				bool has_x = false, all_x = true, has_z = false, all_z = true;
+				for (State bit : arg.bits) {
+					if (bit == State::Sx)
+						has_x = true;
+					else
+						all_x = false;
+					if (bit == State::Sz)
+						has_z = true;
+					else
+						all_z = false;
+				}
 
+				if (!has_x && !has_z && arg.size() >= 1 && arg.size() <= 64) {
+					render_integer_u64(buf, prefix, part, arg);
+				} else {
+					RTLIL::Const value = arg;
 					if (!has_z && !has_x && part.signed_ && value[value.size() - 1]) {
 						prefix = "-";
 						value = RTLIL::const_neg(value, {}, part.signed_, {}, value.size() + 1);
@@ -831,50 +889,87 @@ std::string Fmt::render() const
 							}
 						}
 					} else log_abort();
-					if (part.justify == FmtPart::NUMERIC && part.group && part.padding == '0') {
-						int group_size = part.base == 10 ? 3 : 4;
-						while (prefix.size() + buf.size() < part.width) {
-							if (buf.size() % (group_size + 1) == group_size)
-								buf += '_';
-							buf += '0';
-						}
+				}
+				if (part.justify == FmtPart::NUMERIC && part.group && part.padding == '0') {
+					size_t group_size = part.base == 10 ? 3 : 4;
+					while (prefix.size() + buf.size() < part.width) {
+						if (buf.size() % (group_size + 1) == group_size)
+							buf += '_';
+						buf += '0';
 					}
-					std::reverse(buf.begin(), buf.end());
-				} else if (part.type == FmtPart::STRING) {
-					buf = part.sig.as_const().decode_string();
-				} else if (part.type == FmtPart::VLOG_TIME) {
-					// We only render() during initial, so time is always zero.
-					buf = "0";
 				}
+				std::reverse(buf.begin(), buf.end());
+			} else if (part.type == FmtPart::STRING) {
+				buf = arg.decode_string();
+			} else if (part.type == FmtPart::VLOG_TIME) {
+				// We only render() during initial, so time is always zero.
+				buf = "0";
+			}
 
-				log_assert(part.width == 0 || part.padding != '\0');
-				if (prefix.size() + buf.size() < part.width) {
-					size_t pad_width = part.width - prefix.size() - buf.size();
-					switch (part.justify) {
-						case FmtPart::LEFT:
-							str += prefix;
-							str += buf;
-							str += std::string(pad_width, part.padding);
-							break;
-						case FmtPart::RIGHT:
-							str += std::string(pad_width, part.padding);
-							str += prefix;
-							str += buf;
-							break;
-						case FmtPart::NUMERIC:
-							str += prefix;
-							str += std::string(pad_width, part.padding);
-							str += buf;
-							break;
-					}
-				} else {
-					str += prefix;
-					str += buf;
+			log_assert(part.width == 0 || part.padding != '\0');
+			if (prefix.size() + buf.size() < part.width) {
+				size_t pad_width = part.width - prefix.size() - buf.size();
+				switch (part.justify) {
+					case FmtPart::LEFT:
+						str += prefix;
+						str += buf;
+						str += std::string(pad_width, part.padding);
+						break;
+					case FmtPart::RIGHT:
+						str += std::string(pad_width, part.padding);
+						str += prefix;
+						str += buf;
+						break;
+					case FmtPart::NUMERIC:
+						str += prefix;
+						str += std::string(pad_width, part.padding);
+						str += buf;
+						break;
 				}
-				break;
+			} else {
+				str += prefix;
+				str += buf;
 			}
+			break;
 		}
 	}
+}
+
+std::string Fmt::render() const
+{
+	std::string str, scratch;
+
+	for (auto &part : parts)
+		render_part(str, scratch, part, part.sig.as_const());
 
 	return str;
 }
+
+FmtProgram::FmtProgram(const Fmt &fmt) : parts(fmt.parts)
+{
+	int offset = 0;
+	for (auto &part : parts) {
+		offsets.push_back(offset);
+		offset += part.sig.size();
+	}
+}
+
+const std::string &FmtProgram::render(const RTLIL::Const &args)
+{
+	output.clear();
+
+	for (int i = 0; i < GetSize(parts); i++) {
+		const FmtPart &part = parts[i];
+		if (part.type == FmtPart::LITERAL) {
+			output += part.str;
+			continue;
+		}
+		int offset = min(offsets[i], args.size());
+		int width = min(part.sig.size(), args.size() - offset);
+		value.bits.assign(args.bits.begin() + offset, args.bits.begin() + offset + width);
+		value.bits.resize(part.sig.size(), State::Sx);
+		render_part(output, scratch, part, value);
+	}
+
+	return output;
+}
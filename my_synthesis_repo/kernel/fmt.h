@@ -111,6 +111,25 @@ private:
 	void apply_verilog_automatic_sizing_and_add(FmtPart &part);
 };
 
+// A format prepared for being rendered many times with different argument
+// values, as `sim` does for $print cells. The argument offsets are computed
+// once and the output and scratch buffers are reused between renders.
+struct FmtProgram {
+	FmtProgram() {}
+	FmtProgram(const Fmt &fmt);
+
+	// Render with `args` being the concatenation of all argument signals, i.e.
+	// the value of the ARGS port of a $print cell. The returned string is only
+	// valid until the next call.
+	const std::string &render(const RTLIL::Const &args);
+
+private:
+	std::vector<FmtPart> parts;
+	std::vector<int> offsets;
+	std::string output, scratch;
+	RTLIL::Const value;
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
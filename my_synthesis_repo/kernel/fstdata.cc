@@ -245,8 +245,19 @@ void FstData::reconstructAllAtTimes(std::vector<fstHandle> &signal, uint64_t sta
 	past_time = start_time;
 	all_samples = clk_signals.empty();
 
-	fstReaderSetUnlimitedTimeRange(ctx);
-	fstReaderSetFacProcessMaskAll(ctx);
+	// Blocks that end before the window are skipped by seeking from one block
+	// header to the next, without reading their data. Every block starts with
+	// the values of all signals, so the values at the start time are known.
+	fstReaderSetLimitTimeRange(ctx, start_time, end_time);
+	if (required_signals.empty()) {
+		fstReaderSetFacProcessMaskAll(ctx);
+	} else {
+		fstReaderClrFacProcessMaskAll(ctx);
+		for (auto id : required_signals)
+			fstReaderSetFacProcessMask(ctx, id);
+		for (auto id : clk_signals)
+			fstReaderSetFacProcessMask(ctx, id);
+	}
 	fstReaderIterBlocks2(ctx, reconstruct_clb_attimes, reconstruct_clb_varlen_attimes, this, nullptr);
 	if (last_time!=end_time) {
 		past_data = last_data;
@@ -50,7 +50,12 @@ class FstData
 	std::vector<FstVar>& getVars() { return vars; };
 
 	void reconstruct_callback_attimes(uint64_t pnt_time, fstHandle pnt_facidx, const unsigned char *pnt_value, uint32_t plen);
+	// Only value change blocks that overlap the time window are read, and
+	// only the signals given to setRequiredSignals() (all if none) are decoded.
 	void reconstructAllAtTimes(std::vector<fstHandle> &signal, uint64_t start_time, uint64_t end_time, CallbackFunction cb);
+	// Signals that valueOf() is called for during reconstructAllAtTimes(),
+	// in addition to the clock signals.
+	void setRequiredSignals(const std::vector<fstHandle> &signals) { required_signals = signals; }
 
 	std::string valueOf(fstHandle signal);
 	fstHandle getHandle(std::string name);
@@ -75,6 +80,7 @@ private:
 	uint64_t end_time;
 	CallbackFunction callback;
 	std::vector<fstHandle> clk_signals;
+	std::vector<fstHandle> required_signals;
 	bool all_samples;
 	std::string tmp_file;
 };
@@ -19,11 +19,31 @@
 
 #include <stdint.h>
 
+#ifdef YOSYS_HASHLIB_STATS
+#  include <atomic>
+#endif
+
+#ifdef YOSYS_HASHLIB_SWISS
+#  include <limits>
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define HASHLIB_SSE2
+#    include <emmintrin.h>
+#  endif
+#  if defined(_MSC_VER) && !defined(__GNUC__)
+#    include <intrin.h>
+#  endif
+#endif
+
 namespace hashlib {
 
 const int hashtable_size_trigger = 2;
 const int hashtable_size_factor = 3;
 
+// dict<> with at most this many entries keeps no hashtable and is searched
+// linearly. Most attribute and parameter dicts of wires and cells are that
+// small, and the smallest hashtable would otherwise outweigh the entries.
+const int hashtable_small_size = 4;
+
 // The XOR version of DJB2
 inline unsigned int mkhash(unsigned int a, unsigned int b) {
 	return ((a << 5) + a) ^ b;
@@ -211,6 +231,245 @@ inline int hashtable_size(int min_size)
 	throw std::length_error("hash table exceeded maximum size.");
 }
 
+#ifdef YOSYS_HASHLIB_SWISS
+// Optional open-addressing backend for dict<> and pool<>, enabled by building
+// with -DYOSYS_HASHLIB_SWISS. The entries vector is kept as-is, so iteration
+// order stays the deterministic insertion order; only the hash -> entry index
+// map is replaced. Slots are probed in groups of 16, each slot having a control
+// byte that is either ctrl_empty, ctrl_deleted or the low 7 bits of the hash of
+// the entry it holds, so one SIMD compare filters a whole group of candidates.
+
+// Finalizer of MurmurHash3, applied on top of hash_ops<>::hash(). The djb2
+// style hashes are fine for prime-sized chained buckets but cluster badly in a
+// power of two sized table.
+inline unsigned int mkhash_mix(unsigned int h) {
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+class swiss_index
+{
+	static const int group_width = 16;
+	enum : unsigned char { ctrl_empty = 0x80, ctrl_deleted = 0xfe };
+
+	std::vector<unsigned char> ctrl;
+	std::vector<int> slots;
+	int used = 0;
+
+	// bit i of the result is set if group[i] == c
+	static unsigned int match_byte(const unsigned char *group, unsigned char c) {
+#ifdef HASHLIB_SSE2
+		__m128i g = _mm_loadu_si128((const __m128i*)group);
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+		unsigned int mask = 0;
+		for (int i = 0; i < group_width; i++)
+			if (group[i] == c)
+				mask |= 1u << i;
+		return mask;
+#endif
+	}
+
+	// bit i of the result is set if slot i is empty or deleted
+	static unsigned int match_free(const unsigned char *group) {
+#ifdef HASHLIB_SSE2
+		return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+		unsigned int mask = 0;
+		for (int i = 0; i < group_width; i++)
+			if (group[i] & 0x80)
+				mask |= 1u << i;
+		return mask;
+#endif
+	}
+
+	static int lowest_bit(unsigned int mask) {
+#if defined(__GNUC__)
+		return __builtin_ctz(mask);
+#elif defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		int index = 0;
+		while (!(mask & 1))
+			mask >>= 1, index++;
+		return index;
+#endif
+	}
+
+	int group_mask() const { return int(ctrl.size()) / group_width - 1; }
+	static unsigned char ctrl_hash(unsigned int hash) { return hash & 0x7f; }
+	static int first_group(unsigned int hash, int mask) { return (hash >> 7) & mask; }
+
+	// slot holding entry `index`, or -1
+	int find_slot(unsigned int hash, int index) const
+	{
+		if (ctrl.empty())
+			return -1;
+		int mask = group_mask();
+		for (int g = first_group(hash, mask), step = 1; step <= mask + 1; g = (g + step++) & mask) {
+			const unsigned char *group = &ctrl[g * group_width];
+			for (unsigned int m = match_byte(group, ctrl_hash(hash)); m; m &= m - 1) {
+				int slot = g * group_width + lowest_bit(m);
+				if (slots[slot] == index)
+					return slot;
+			}
+			if (match_byte(group, ctrl_empty))
+				break;
+		}
+		return -1;
+	}
+
+public:
+	bool empty() const { return ctrl.empty(); }
+	void clear() { ctrl.clear(); slots.clear(); used = 0; }
+
+	void swap(swiss_index &other) {
+		ctrl.swap(other.ctrl);
+		slots.swap(other.slots);
+		std::swap(used, other.used);
+	}
+
+	// drop all slots and size the table for `min_entries` at 7/8 load
+	void reset(size_t min_entries)
+	{
+		size_t groups = 1;
+		while (groups * group_width * 7 < min_entries * 8)
+			groups *= 2;
+		if (groups * group_width > size_t(std::numeric_limits<int>::max()))
+			throw std::length_error("hash table exceeded maximum size.");
+		ctrl.assign(groups * group_width, ctrl_empty);
+		slots.assign(groups * group_width, -1);
+		used = 0;
+	}
+
+	// deleted slots count as used, so this also triggers a cleanup rehash
+	bool needs_grow() const {
+		return ctrl.empty() || size_t(used + 1) * 8 > ctrl.size() * 7;
+	}
+
+	// returns the entry index for which match(index) is true, or -1
+	template<typename F>
+	int find(unsigned int hash, F match) const
+	{
+		if (ctrl.empty())
+			return -1;
+		int mask = group_mask();
+		for (int g = first_group(hash, mask), step = 1; step <= mask + 1; g = (g + step++) & mask) {
+			const unsigned char *group = &ctrl[g * group_width];
+			for (unsigned int m = match_byte(group, ctrl_hash(hash)); m; m &= m - 1) {
+				int index = slots[g * group_width + lowest_bit(m)];
+				if (match(index))
+					return index;
+			}
+			if (match_byte(group, ctrl_empty))
+				break;
+		}
+		return -1;
+	}
+
+	// caller must check needs_grow() first
+	void insert(unsigned int hash, int index)
+	{
+		int mask = group_mask();
+		for (int g = first_group(hash, mask), step = 1; ; g = (g + step++) & mask) {
+			unsigned int m = match_free(&ctrl[g * group_width]);
+			if (m) {
+				int slot = g * group_width + lowest_bit(m);
+				if (ctrl[slot] == ctrl_empty)
+					used++;
+				ctrl[slot] = ctrl_hash(hash);
+				slots[slot] = index;
+				return;
+			}
+		}
+	}
+
+	bool erase(unsigned int hash, int index)
+	{
+		int slot = find_slot(hash, index);
+		if (slot < 0)
+			return false;
+		// A group that still has an empty slot never made a probe move on,
+		// so the slot can become empty again instead of a tombstone.
+		if (match_byte(&ctrl[slot / group_width * group_width], ctrl_empty)) {
+			ctrl[slot] = ctrl_empty;
+			used--;
+		} else
+			ctrl[slot] = ctrl_deleted;
+		slots[slot] = -1;
+		return true;
+	}
+
+	// point the slot of entry `old_index` at `new_index`
+	bool relink(unsigned int hash, int old_index, int new_index)
+	{
+		int slot = find_slot(hash, old_index);
+		if (slot < 0)
+			return false;
+		slots[slot] = new_index;
+		return true;
+	}
+};
+#endif
+
+#ifdef YOSYS_HASHLIB_STATS
+// Opt-in instrumentation, enabled by building with -DYOSYS_HASHLIB_STATS.
+// Every dict<>/pool<> instantiation owns one stats_site that counts lookups,
+// key comparisons (chain entries or probe candidates visited), rehashes and the
+// largest size reached. Pass::post_execute() prints the per-pass deltas, so
+// keys that hash badly show up as a high compares-per-lookup ratio.
+struct stats_counts
+{
+	uint64_t lookups = 0, compares = 0, rehashes = 0, peak_size = 0;
+};
+
+struct stats_site
+{
+	const char *name;
+	std::atomic<uint64_t> lookups, compares, rehashes, peak_size;
+	stats_site *next;
+
+	static std::atomic<stats_site*> &list() {
+		static std::atomic<stats_site*> head(nullptr);
+		return head;
+	}
+
+	stats_site(const char *name) : name(name), lookups(0), compares(0), rehashes(0), peak_size(0) {
+		next = list().load();
+		while (!list().compare_exchange_weak(next, this)) { }
+	}
+
+	void note_size(size_t size) {
+		uint64_t peak = peak_size.load(std::memory_order_relaxed);
+		while (size > peak && !peak_size.compare_exchange_weak(peak, size, std::memory_order_relaxed)) { }
+	}
+
+	stats_counts counts() const {
+		stats_counts c;
+		c.lookups = lookups.load(std::memory_order_relaxed);
+		c.compares = compares.load(std::memory_order_relaxed);
+		c.rehashes = rehashes.load(std::memory_order_relaxed);
+		c.peak_size = peak_size.load(std::memory_order_relaxed);
+		return c;
+	}
+};
+
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    define HASHLIB_STATS_SITE_NAME __FUNCSIG__
+#  else
+#    define HASHLIB_STATS_SITE_NAME __PRETTY_FUNCTION__
+#  endif
+#  define HASHLIB_STAT(_stmt_) _stmt_
+#else
+#  define HASHLIB_STAT(_stmt_)
+#endif
+
 template<typename K, typename T, typename OPS = hash_ops<K>> class dict;
 template<typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
 template<typename K, typename OPS = hash_ops<K>> class pool;
@@ -230,7 +489,11 @@ class dict
 		bool operator<(const entry_t &other) const { return udata.first < other.udata.first; }
 	};
 
+#ifdef YOSYS_HASHLIB_SWISS
+	swiss_index hashtable;
+#else
 	std::vector<int> hashtable;
+#endif
 	std::vector<entry_t> entries;
 	OPS ops;
 
@@ -242,6 +505,123 @@ class dict
 	}
 #endif
 
+#ifdef YOSYS_HASHLIB_STATS
+	static stats_site &stats() {
+		static stats_site site(HASHLIB_STATS_SITE_NAME);
+		return site;
+	}
+#endif
+
+	// lookup and erase while there is no hashtable (see hashtable_small_size)
+	int do_lookup_small(const K &key) const
+	{
+		for (int index = 0; index < int(entries.size()); index++) {
+			HASHLIB_STAT(stats().compares++;)
+			if (ops.cmp(entries[index].udata.first, key))
+				return index;
+		}
+		return -1;
+	}
+
+	int do_erase_small(int index)
+	{
+		int back_idx = entries.size()-1;
+		if (index != back_idx)
+			entries[index] = std::move(entries[back_idx]);
+		entries.pop_back();
+		return 1;
+	}
+
+#ifdef YOSYS_HASHLIB_SWISS
+	int do_hash(const K &key) const
+	{
+		return mkhash_mix(ops.hash(key));
+	}
+
+	void do_rehash()
+	{
+		if (int(entries.size()) <= hashtable_small_size) {
+			hashtable.clear();
+			return;
+		}
+
+		HASHLIB_STAT(stats().rehashes++;)
+		hashtable.reset(std::max(entries.capacity(), entries.size() + 1));
+		for (int i = 0; i < int(entries.size()); i++)
+			hashtable.insert(do_hash(entries[i].udata.first), i);
+	}
+
+	int do_erase(int index, int hash)
+	{
+		do_assert(index < int(entries.size()));
+		if (index < 0)
+			return 0;
+
+		if (hashtable.empty())
+			return do_erase_small(index);
+
+		bool found = hashtable.erase(hash, index);
+		do_assert(found);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			found = hashtable.relink(do_hash(entries[back_idx].udata.first), back_idx, index);
+			do_assert(found);
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			hashtable.clear();
+
+		return 1;
+	}
+
+	int do_lookup(const K &key, int &hash) const
+	{
+		HASHLIB_STAT(stats().lookups++;)
+		if (hashtable.empty())
+			return do_lookup_small(key);
+		return hashtable.find(hash, [&](int index) {
+			HASHLIB_STAT(stats().compares++;)
+			return ops.cmp(entries[index].udata.first, key);
+		});
+	}
+
+	// links the entry that was just appended to `entries`
+	int do_link_back(int hash)
+	{
+		HASHLIB_STAT(stats().note_size(entries.size());)
+		if (hashtable.empty() && int(entries.size()) <= hashtable_small_size)
+			return entries.size() - 1;
+		if (hashtable.needs_grow())
+			do_rehash();
+		else
+			hashtable.insert(hash, entries.size() - 1);
+		return entries.size() - 1;
+	}
+
+	int do_insert(const K &key, int &hash)
+	{
+		entries.emplace_back(std::pair<K, T>(key, T()), -1);
+		return do_link_back(hash);
+	}
+
+	int do_insert(const std::pair<K, T> &value, int &hash)
+	{
+		entries.emplace_back(value, -1);
+		return do_link_back(hash);
+	}
+
+	int do_insert(std::pair<K, T> &&rvalue, int &hash)
+	{
+		entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), -1);
+		return do_link_back(hash);
+	}
+#else
 	int do_hash(const K &key) const
 	{
 		unsigned int hash = 0;
@@ -253,6 +633,13 @@ class dict
 	void do_rehash()
 	{
 		hashtable.clear();
+		if (int(entries.size()) <= hashtable_small_size) {
+			for (auto &entry : entries)
+				entry.next = -1;
+			return;
+		}
+
+		HASHLIB_STAT(stats().rehashes++;)
 		hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
 
 		for (int i = 0; i < int(entries.size()); i++) {
@@ -266,9 +653,12 @@ class dict
 	int do_erase(int index, int hash)
 	{
 		do_assert(index < int(entries.size()));
-		if (hashtable.empty() || index < 0)
+		if (index < 0)
 			return 0;
 
+		if (hashtable.empty())
+			return do_erase_small(index);
+
 		int k = hashtable[hash];
 		do_assert(0 <= k && k < int(entries.size()));
 
@@ -314,8 +704,9 @@ class dict
 
 	int do_lookup(const K &key, int &hash) const
 	{
+		HASHLIB_STAT(stats().lookups++;)
 		if (hashtable.empty())
-			return -1;
+			return do_lookup_small(key);
 
 		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
 			((dict*)this)->do_rehash();
@@ -323,12 +714,16 @@ class dict
 		}
 
 		int index = hashtable[hash];
+		HASHLIB_STAT(uint64_t compares = 0;)
 
 		while (index >= 0 && !ops.cmp(entries[index].udata.first, key)) {
+			HASHLIB_STAT(compares++;)
 			index = entries[index].next;
 			do_assert(-1 <= index && index < int(entries.size()));
 		}
 
+		HASHLIB_STAT(stats().compares += compares + (index >= 0);)
+
 		return index;
 	}
 
@@ -336,12 +731,15 @@ class dict
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(std::pair<K, T>(key, T()), -1);
-			do_rehash();
-			hash = do_hash(key);
+			if (int(entries.size()) > hashtable_small_size) {
+				do_rehash();
+				hash = do_hash(key);
+			}
 		} else {
 			entries.emplace_back(std::pair<K, T>(key, T()), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		HASHLIB_STAT(stats().note_size(entries.size());)
 		return entries.size() - 1;
 	}
 
@@ -349,28 +747,34 @@ class dict
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(value, -1);
-			do_rehash();
-			hash = do_hash(value.first);
+			if (int(entries.size()) > hashtable_small_size) {
+				do_rehash();
+				hash = do_hash(value.first);
+			}
 		} else {
 			entries.emplace_back(value, hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		HASHLIB_STAT(stats().note_size(entries.size());)
 		return entries.size() - 1;
 	}
 
 	int do_insert(std::pair<K, T> &&rvalue, int &hash)
 	{
 		if (hashtable.empty()) {
-			auto key = rvalue.first;
 			entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), -1);
-			do_rehash();
-			hash = do_hash(key);
+			if (int(entries.size()) > hashtable_small_size) {
+				do_rehash();
+				hash = do_hash(entries.back().udata.first);
+			}
 		} else {
 			entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		HASHLIB_STAT(stats().note_size(entries.size());)
 		return entries.size() - 1;
 	}
+#endif
 
 public:
 	class const_iterator
@@ -687,7 +1091,11 @@ protected:
 		entry_t(K &&udata, int next) : udata(std::move(udata)), next(next) { }
 	};
 
+#ifdef YOSYS_HASHLIB_SWISS
+	swiss_index hashtable;
+#else
 	std::vector<int> hashtable;
+#endif
 	std::vector<entry_t> entries;
 	OPS ops;
 
@@ -699,6 +1107,90 @@ protected:
 	}
 #endif
 
+#ifdef YOSYS_HASHLIB_STATS
+	static stats_site &stats() {
+		static stats_site site(HASHLIB_STATS_SITE_NAME);
+		return site;
+	}
+#endif
+
+#ifdef YOSYS_HASHLIB_SWISS
+	int do_hash(const K &key) const
+	{
+		return mkhash_mix(ops.hash(key));
+	}
+
+	void do_rehash()
+	{
+		if (entries.empty()) {
+			hashtable.clear();
+			return;
+		}
+
+		HASHLIB_STAT(stats().rehashes++;)
+		hashtable.reset(std::max(entries.capacity(), entries.size() + 1));
+		for (int i = 0; i < int(entries.size()); i++)
+			hashtable.insert(do_hash(entries[i].udata), i);
+	}
+
+	int do_erase(int index, int hash)
+	{
+		do_assert(index < int(entries.size()));
+		if (hashtable.empty() || index < 0)
+			return 0;
+
+		bool found = hashtable.erase(hash, index);
+		do_assert(found);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			found = hashtable.relink(do_hash(entries[back_idx].udata), back_idx, index);
+			do_assert(found);
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			hashtable.clear();
+
+		return 1;
+	}
+
+	int do_lookup(const K &key, int &hash) const
+	{
+		HASHLIB_STAT(stats().lookups++;)
+		return hashtable.find(hash, [&](int index) {
+			HASHLIB_STAT(stats().compares++;)
+			return ops.cmp(entries[index].udata, key);
+		});
+	}
+
+	// links the entry that was just appended to `entries`
+	int do_link_back(int hash)
+	{
+		HASHLIB_STAT(stats().note_size(entries.size());)
+		if (hashtable.needs_grow())
+			do_rehash();
+		else
+			hashtable.insert(hash, entries.size() - 1);
+		return entries.size() - 1;
+	}
+
+	int do_insert(const K &value, int &hash)
+	{
+		entries.emplace_back(value, -1);
+		return do_link_back(hash);
+	}
+
+	int do_insert(K &&rvalue, int &hash)
+	{
+		entries.emplace_back(std::forward<K>(rvalue), -1);
+		return do_link_back(hash);
+	}
+#else
 	int do_hash(const K &key) const
 	{
 		unsigned int hash = 0;
@@ -709,6 +1201,7 @@ protected:
 
 	void do_rehash()
 	{
+		HASHLIB_STAT(stats().rehashes++;)
 		hashtable.clear();
 		hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
 
@@ -767,6 +1260,7 @@ protected:
 
 	int do_lookup(const K &key, int &hash) const
 	{
+		HASHLIB_STAT(stats().lookups++;)
 		if (hashtable.empty())
 			return -1;
 
@@ -776,12 +1270,16 @@ protected:
 		}
 
 		int index = hashtable[hash];
+		HASHLIB_STAT(uint64_t compares = 0;)
 
 		while (index >= 0 && !ops.cmp(entries[index].udata, key)) {
+			HASHLIB_STAT(compares++;)
 			index = entries[index].next;
 			do_assert(-1 <= index && index < int(entries.size()));
 		}
 
+		HASHLIB_STAT(stats().compares += compares + (index >= 0);)
+
 		return index;
 	}
 
@@ -795,6 +1293,7 @@ protected:
 			entries.emplace_back(value, hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		HASHLIB_STAT(stats().note_size(entries.size());)
 		return entries.size() - 1;
 	}
 
@@ -808,8 +1307,10 @@ protected:
 			entries.emplace_back(std::forward<K>(rvalue), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		HASHLIB_STAT(stats().note_size(entries.size());)
 		return entries.size() - 1;
 	}
+#endif
 
 public:
 	class const_iterator
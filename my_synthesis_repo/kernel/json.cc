@@ -170,3 +170,165 @@ void PrettyJson::entry_json(const char *name, const Json &value)
     this->value(value);
 }
 
+JsonStream::JsonStream(std::ostream &os, uint8_t xor_key) : os(&os), xor_key(xor_key)
+{
+    buffer.reserve(1 << 17);
+}
+
+JsonStream::JsonStream(std::string &target, int depth) : target(&target), base_depth(depth)
+{
+}
+
+JsonStream::~JsonStream()
+{
+    flush();
+}
+
+void JsonStream::flush()
+{
+    if (os == nullptr || buffer.empty())
+        return;
+    if (xor_key)
+        for (char &c : buffer)
+            c ^= xor_key;
+    os->write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void JsonStream::newline(int depth)
+{
+    std::string &str = out();
+    str += '\n';
+    str.append(2 * (base_depth + depth), ' ');
+}
+
+void JsonStream::begin_value()
+{
+    if (after_name) {
+        after_name = false;
+        return;
+    }
+    if (state.empty())
+        return;
+    Scope &top = state.back();
+    log_assert(!top.is_object);
+    out() += top.first ? " " : ", ";
+    top.first = false;
+}
+
+void JsonStream::end_value()
+{
+    if (state.empty() && os != nullptr) {
+        buffer += '\n';
+        flush();
+    }
+    maybe_flush();
+}
+
+void JsonStream::begin_object()
+{
+    begin_value();
+    out() += '{';
+    state.push_back({true, true});
+}
+
+void JsonStream::end_object()
+{
+    log_assert(!state.empty() && state.back().is_object && !after_name);
+    state.pop_back();
+    newline(GetSize(state));
+    out() += '}';
+    end_value();
+}
+
+void JsonStream::begin_array()
+{
+    begin_value();
+    out() += '[';
+    state.push_back({false, true});
+}
+
+void JsonStream::end_array()
+{
+    log_assert(!state.empty() && !state.back().is_object);
+    state.pop_back();
+    out() += " ]";
+    end_value();
+}
+
+void JsonStream::name(const char *name, size_t len)
+{
+    log_assert(!state.empty() && state.back().is_object && !after_name);
+    Scope &top = state.back();
+    if (!top.first)
+        out() += ',';
+    top.first = false;
+    newline(GetSize(state));
+    append_escaped(out(), name, len);
+    out() += ": ";
+    after_name = true;
+}
+
+void JsonStream::value(const char *str, size_t len)
+{
+    begin_value();
+    append_escaped(out(), str, len);
+    end_value();
+}
+
+void JsonStream::value(int64_t value)
+{
+    begin_value();
+    append_int(out(), value);
+    end_value();
+}
+
+void JsonStream::raw_value(const std::string &json)
+{
+    begin_value();
+    out() += json;
+    end_value();
+}
+
+void JsonStream::append_escaped(std::string &out, const char *str, size_t len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    out += '"';
+    size_t begin = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        out.append(str + begin, i - begin);
+        begin = i + 1;
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 15];
+        }
+    }
+    out.append(str + begin, len - begin);
+    out += '"';
+}
+
+void JsonStream::append_int(std::string &out, int64_t value)
+{
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    uint64_t mag = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+    do {
+        *--p = '0' + mag % 10;
+        mag /= 10;
+    } while (mag != 0);
+    if (value < 0)
+        *--p = '-';
+    out.append(p, digits + sizeof(digits) - p);
+}
@@ -97,7 +97,58 @@ public:
     }
 };
 
+// A buffered JSON emitter for high-volume output such as netlists. Strings
+// are escaped and integers formatted straight into an output buffer that is
+// handed to the stream in large blocks, so the document never has to be held
+// in memory as a whole. Objects get one entry per line, indented by two
+// spaces per level, and arrays are written on a single line.
+class JsonStream
+{
+    struct Scope {
+        bool is_object;
+        bool first;
+    };
+
+    std::ostream *os = nullptr;
+    std::string *target = nullptr;
+    std::string buffer;
+    uint8_t xor_key = 0;
+    int base_depth = 0;
+    std::vector<Scope> state;
+    bool after_name = false;
+
+    std::string &out() { return target ? *target : buffer; }
+    void newline(int depth);
+    void begin_value();
+    void end_value();
+    void maybe_flush() { if (os && GetSize(buffer) >= (1 << 16)) flush(); }
+
+public:
+    // Writes to `os`. With a non-zero `xor_key`, every byte written is xor-ed
+    // with it, matching Frontend::decrypt_pb_content_stringstream().
+    JsonStream(std::ostream &os, uint8_t xor_key = 0);
+    // Appends to `target`, with the outermost value at nesting level `depth`.
+    // This is used to render parts of a document in parallel, which are then
+    // inserted in order with raw_value().
+    JsonStream(std::string &target, int depth = 0);
+    ~JsonStream();
 
+    void begin_object();
+    void end_object();
+    void begin_array();
+    void end_array();
+    void name(const char *name, size_t len);
+    void name(const std::string &name) { this->name(name.data(), name.size()); }
+    void value(const char *str, size_t len);
+    void value(const std::string &str) { value(str.data(), str.size()); }
+    void value(int64_t value);
+    // Inserts already rendered JSON text as the next value.
+    void raw_value(const std::string &json);
+    void flush();
+
+    static void append_escaped(std::string &out, const char *str, size_t len);
+    static void append_int(std::string &out, int64_t value);
+};
 
 YOSYS_NAMESPACE_END
 
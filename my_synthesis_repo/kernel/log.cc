@@ -35,6 +35,10 @@
 #include <stdarg.h>
 #include <vector>
 #include <list>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -42,7 +46,7 @@ std::vector<FILE*> log_files;
 std::vector<std::ostream*> log_streams;
 std::vector<std::string> log_scratchpads;
 std::map<std::string, std::set<std::string>> log_hdump;
-std::vector<std::regex> log_warn_regexes, log_nowarn_regexes, log_werror_regexes;
+std::vector<LogRegex> log_warn_regexes, log_nowarn_regexes, log_werror_regexes;
 dict<std::string, LogExpectedItem> log_expect_log, log_expect_warning, log_expect_error;
 std::set<std::string> log_warnings, log_experimentals, log_experimentals_ignored;
 int log_warnings_count = 0;
@@ -61,19 +65,173 @@ string log_last_error;
 void (*log_error_atexit)() = NULL;
 void (*log_verific_callback)(int msg_type, const char *message_id, const char* file_path, unsigned int left_line, unsigned int left_col, unsigned int right_line, unsigned int right_col, const char *msg) = NULL;
 
-int log_make_debug = 0;
+YS_THREAD_LOCAL int log_make_debug = 0;
 int log_force_debug = 0;
-int log_debug_suppressed = 0;
+YS_THREAD_LOCAL int log_debug_suppressed = 0;
+
+std::atomic<unsigned int> log_sink_mask[LOG_SINK_COUNT] = { {LOG_LEVEL_ALL}, {LOG_LEVEL_ALL} };
+std::atomic<unsigned int> log_sink_any_mask{LOG_LEVEL_ALL};
+
+std::atomic<int> log_control_pending{0};
+static std::mutex log_control_mutex;
+static std::condition_variable log_control_cv;
+static std::function<bool(const nlohmann::json&)> log_control_extra_handler;
 
 vector<int> header_count;
-vector<char*> log_id_cache;
-vector<shared_str> string_buf;
-int string_buf_index = -1;
+YS_THREAD_LOCAL vector<char*> log_id_cache;
+YS_THREAD_LOCAL vector<shared_str> string_buf;
+YS_THREAD_LOCAL int string_buf_index = -1;
+static YS_THREAD_LOCAL LogCapture *log_capture = nullptr;
+
+// static initialization runs on the main thread
+static const std::thread::id log_main_thread = std::this_thread::get_id();
 
 static struct timeval initial_tv = { 0, 0 };
 static bool next_print_log = false;
 static int log_newline_count = 0;
 
+#ifdef YOSYS_ENABLE_THREADS
+// Background writer for the files registered with log_file_async(). Output
+// is appended to a per-file buffer and written out by the thread in batches.
+struct LogAsyncWriter
+{
+	struct file_t {
+		FILE *f;
+		std::string pending;
+	};
+
+	// writers wait for the thread when this much output is buffered
+	static constexpr size_t max_pending = 64 << 20;
+	static constexpr size_t batch_size = 1 << 20;
+	static constexpr std::chrono::milliseconds batch_delay{20};
+
+	std::mutex mutex;
+	std::condition_variable work_cv, done_cv;
+	std::thread thread;
+	std::vector<file_t> files;
+	size_t pending_size = 0;
+	bool busy = false, stop = false;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			work_cv.wait(lock, [&] { return stop || pending_size > 0; });
+			if (pending_size == 0)
+				break;
+
+			// collect more output for a while before writing
+			work_cv.wait_for(lock, batch_delay, [&] { return stop || pending_size >= batch_size; });
+
+			std::vector<std::pair<FILE*, std::string>> batch;
+			for (auto &file : files)
+				if (!file.pending.empty()) {
+					batch.push_back({file.f, std::move(file.pending)});
+					file.pending.clear();
+				}
+			pending_size = 0;
+			busy = true;
+			lock.unlock();
+
+			for (auto &it : batch) {
+				fwrite(it.second.data(), 1, it.second.size(), it.first);
+				fflush(it.first);
+			}
+
+			lock.lock();
+			busy = false;
+			done_cv.notify_all();
+		}
+	}
+
+	// waits until everything written so far is in the files
+	void drain(std::unique_lock<std::mutex> &lock)
+	{
+		work_cv.notify_one();
+		done_cv.wait(lock, [&] { return pending_size == 0 && !busy; });
+	}
+};
+
+// never deleted, so that it outlives all other static objects; after
+// log_async_shutdown() the files are written directly again
+static LogAsyncWriter *log_async_writer = nullptr;
+
+static void log_async_shutdown()
+{
+	{
+		std::unique_lock<std::mutex> lock(log_async_writer->mutex);
+		log_async_writer->stop = true;
+		log_async_writer->drain(lock);
+	}
+	log_async_writer->thread.join();
+}
+
+static bool log_async_write(FILE *f, const std::string &str)
+{
+	if (log_async_writer == nullptr)
+		return false;
+
+	std::unique_lock<std::mutex> lock(log_async_writer->mutex);
+	if (log_async_writer->stop)
+		return false;
+	for (auto &file : log_async_writer->files)
+		if (file.f == f) {
+			if (log_async_writer->pending_size >= LogAsyncWriter::max_pending)
+				log_async_writer->drain(lock);
+			file.pending += str;
+			if (log_async_writer->pending_size == 0)
+				log_async_writer->work_cv.notify_one();
+			log_async_writer->pending_size += str.size();
+			return true;
+		}
+	return false;
+}
+
+void log_file_async(FILE *f)
+{
+	if (log_async_writer == nullptr) {
+		log_async_writer = new LogAsyncWriter;
+		log_async_writer->thread = std::thread([] { log_async_writer->run(); });
+		std::atexit(log_async_shutdown);
+	}
+
+	std::lock_guard<std::mutex> lock(log_async_writer->mutex);
+	log_async_writer->files.push_back({f, std::string()});
+}
+
+void log_file_sync(FILE *f)
+{
+	if (log_async_writer == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> lock(log_async_writer->mutex);
+	if (!log_async_writer->stop)
+		log_async_writer->drain(lock);
+	auto &files = log_async_writer->files;
+	for (auto it = files.begin(); it != files.end(); ++it)
+		if (it->f == f) {
+			files.erase(it);
+			break;
+		}
+}
+
+static void log_async_flush()
+{
+	if (log_async_writer == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> lock(log_async_writer->mutex);
+	if (!log_async_writer->stop)
+		log_async_writer->drain(lock);
+}
+#else
+static bool log_async_write(FILE*, const std::string&) { return false; }
+void log_file_async(FILE*) { }
+void log_file_sync(FILE*) { }
+static void log_async_flush() { }
+#endif
+
 static void log_id_cache_clear()
 {
 	for (auto p : log_id_cache)
@@ -101,6 +259,119 @@ int gettimeofday(struct timeval *tv, struct timezone *tz)
 }
 #endif
 
+void log_set_sink_mask(LogSink sink, unsigned int mask)
+{
+	log_sink_mask[sink].store(mask & LOG_LEVEL_ALL, std::memory_order_relaxed);
+
+	unsigned int any_mask = 0;
+	for (int i = 0; i < LOG_SINK_COUNT; i++)
+		any_mask |= log_sink_mask[i].load(std::memory_order_relaxed);
+	log_sink_any_mask.store(any_mask, std::memory_order_relaxed);
+}
+
+bool log_parse_sink_mask(const std::string &spec)
+{
+	size_t pos = spec.find('=');
+	if (pos == std::string::npos)
+		return false;
+
+	LogSink sink;
+	std::string sink_name = spec.substr(0, pos);
+	if (sink_name == "files")
+		sink = LOG_SINK_FILES;
+	else if (sink_name == "pipe")
+		sink = LOG_SINK_PIPE;
+	else
+		return false;
+
+	unsigned int mask = 0;
+	for (auto &level : split_tokens(spec.substr(pos+1), ",")) {
+		if (level == "debug")
+			mask |= LOG_LEVEL_DEBUG;
+		else if (level == "info")
+			mask |= LOG_LEVEL_INFO;
+		else if (level == "all")
+			mask |= LOG_LEVEL_ALL;
+		else if (level != "none")
+			return false;
+	}
+
+	log_set_sink_mask(sink, mask);
+	return true;
+}
+
+// Runs on the CONTROL pipe reader thread
+static void log_control_handler(const nlohmann::json &command)
+{
+	std::string name = command.value("command", "");
+
+	if (name == "abort")
+		log_control_pending.fetch_or(LOG_CONTROL_ABORT);
+	else if (name == "pause")
+		log_control_pending.fetch_or(LOG_CONTROL_PAUSE);
+	else if (name == "resume")
+		log_control_pending.fetch_and(~LOG_CONTROL_PAUSE);
+	else if (name == "progress")
+		log_control_pending.fetch_or(LOG_CONTROL_PROGRESS);
+	else if (name == "set_log_mask") {
+		if (!log_parse_sink_mask(command.value("mask", "")))
+			std::cerr << "Invalid log sink mask in control command: " << command.dump() << std::endl;
+		return;
+	} else {
+		if (!log_control_extra_handler || !log_control_extra_handler(command))
+			std::cerr << "Unknown control command: " << command.dump() << std::endl;
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(log_control_mutex);
+	log_control_cv.notify_all();
+}
+
+void log_control_start(std::function<bool(const nlohmann::json&)> extra_handler)
+{
+	log_control_extra_handler = extra_handler;
+	Common::StartControlReader(log_control_handler);
+}
+
+static void log_send_control_event(const char *event, const char *where, int64_t done, int64_t total)
+{
+	nlohmann::json data;
+	data["event"] = event;
+	data["pass"] = current_pass ? current_pass->pass_name : "";
+	data["where"] = where ? where : "";
+	data["done"] = done;
+	data["total"] = total;
+	Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "CONTROL_EVENT"));
+}
+
+void log_check_interrupt_worker(const char *where, int64_t done, int64_t total)
+{
+	if (log_control_pending.fetch_and(~LOG_CONTROL_PROGRESS) & LOG_CONTROL_PROGRESS)
+		log_send_control_event("progress", where, done, total);
+
+	if (log_control_pending.load() & LOG_CONTROL_PAUSE) {
+		log_send_control_event("paused", where, done, total);
+		std::unique_lock<std::mutex> lock(log_control_mutex);
+		log_control_cv.wait(lock, [] {
+			return (log_control_pending.load() & (LOG_CONTROL_PAUSE | LOG_CONTROL_ABORT)) != LOG_CONTROL_PAUSE;
+		});
+		lock.unlock();
+		log_send_control_event("resumed", where, done, total);
+	}
+
+	// log_cmd_error() can only unwind the pass on the main thread or in a
+	// parallel task, whose error is raised on the main thread after the join.
+	// Any other thread leaves the abort pending for the next check.
+	if (log_capture == nullptr && std::this_thread::get_id() != log_main_thread)
+		return;
+
+	if (log_control_pending.fetch_and(~LOG_CONTROL_ABORT) & LOG_CONTROL_ABORT) {
+		log_control_pending.fetch_and(~LOG_CONTROL_PAUSE);
+		log_send_control_event("aborted", where, done, total);
+		log_cmd_error("Interrupted by parent process%s%s.\n", where ? " in " : "", where ? where : "");
+	}
+}
+
 void logv2(const char *format, bool is_send, va_list ap)
 {
 	while (format[0] == '\n' && format[1] != 0) {
@@ -111,9 +382,22 @@ void logv2(const char *format, bool is_send, va_list ap)
 	if (log_make_debug && !ys_debug(1))
 		return;
 
+	unsigned int level = log_make_debug ? LOG_LEVEL_DEBUG : LOG_LEVEL_INFO;
+	if (!(log_sink_any_mask.load(std::memory_order_relaxed) & level))
+		return;
+
+	if (log_capture) {
+		log_capture->events.push_back({is_send ? LogCapture::EV_LOG2_SEND : LogCapture::EV_LOG2,
+				log_make_debug != 0, std::string(), vstringf(format, ap)});
+		return;
+	}
+
+	bool to_files = log_sink_mask[LOG_SINK_FILES].load(std::memory_order_relaxed) & level;
+	bool to_pipe = log_sink_mask[LOG_SINK_PIPE].load(std::memory_order_relaxed) & level;
+
 	std::string str = vstringf(format, ap);
 
-	if (is_send){
+	if (is_send && to_pipe){
 		nlohmann::json data;
 		data["level_code"] = LevelCode::ALWAYS_LOG;
 		data["message_content"] = str;
@@ -129,10 +413,10 @@ void logv2(const char *format, bool is_send, va_list ap)
 	else
 		log_newline_count = GetSize(str) - nnl_pos - 1;
 
-	if (log_hasher)
+	if (log_hasher && to_files)
 		log_hasher->update(str);
 
-	if (log_time)
+	if (log_time && to_files)
 	{
 		std::string time_str;
 
@@ -161,17 +445,21 @@ void logv2(const char *format, bool is_send, va_list ap)
 			next_print_log = true;
 
 		for (auto f : log_files)
-			fputs(time_str.c_str(), f);
+			if (!log_async_write(f, time_str))
+				fputs(time_str.c_str(), f);
 
 		for (auto f : log_streams)
 			*f << time_str;
 	}
 
-	for (auto f : log_files)
-		fputs(str.c_str(), f);
+	if (to_files) {
+		for (auto f : log_files)
+			if (!log_async_write(f, str))
+				fputs(str.c_str(), f);
 
-	for (auto f : log_streams)
-		*f << str;
+		for (auto f : log_streams)
+			*f << str;
+	}
 
 	RTLIL::Design *design = yosys_get_design();
 	if (design != nullptr)
@@ -195,11 +483,11 @@ void logv2(const char *format, bool is_send, va_list ap)
 
 			if (!linebuffer.empty() && linebuffer.back() == '\n') {
 				for (auto &re : log_warn_regexes)
-					if (std::regex_search(linebuffer, re))
+					if (re.search(linebuffer))
 						log_warning("Found log message matching -W regex:\n%s", str.c_str());
 
 				for (auto &item : log_expect_log)
-					if (std::regex_search(linebuffer, item.second.pattern))
+					if (item.second.pattern.search(linebuffer))
 						item.second.current_count++;
 
 				linebuffer.clear();
@@ -220,9 +508,23 @@ void logv(const char *format, va_list ap)
 	if (log_make_debug && !ys_debug(1))
 		return;
 
+	unsigned int level = log_make_debug ? LOG_LEVEL_DEBUG : LOG_LEVEL_INFO;
+	if (!(log_sink_any_mask.load(std::memory_order_relaxed) & level))
+		return;
+
+	if (log_capture) {
+		log_capture->events.push_back({LogCapture::EV_LOG, log_make_debug != 0, std::string(), vstringf(format, ap)});
+		return;
+	}
+
+	bool to_files = log_sink_mask[LOG_SINK_FILES].load(std::memory_order_relaxed) & level;
+	bool to_pipe = log_sink_mask[LOG_SINK_PIPE].load(std::memory_order_relaxed) & level;
+
 	std::string str = vstringf(format, ap);
-	nlohmann::json data = Common::CreateLogJson(LevelCode::ALWAYS_LOG,str,str);
-	Common::ConnectAndSendJson(PipeType::LOG, data);
+	if (to_pipe && Common::g_father_process_id != "-1") {
+		nlohmann::json data = Common::CreateLogJson(LevelCode::ALWAYS_LOG,str,str);
+		Common::ConnectAndSendJson(PipeType::LOG, data);
+	}
 
 	if (str.empty())
 		return;
@@ -233,10 +535,10 @@ void logv(const char *format, va_list ap)
 	else
 		log_newline_count = GetSize(str) - nnl_pos - 1;
 
-	if (log_hasher)
+	if (log_hasher && to_files)
 		log_hasher->update(str);
 
-	if (log_time)
+	if (log_time && to_files)
 	{
 		std::string time_str;
 
@@ -265,17 +567,21 @@ void logv(const char *format, va_list ap)
 			next_print_log = true;
 
 		for (auto f : log_files)
-			fputs(time_str.c_str(), f);
+			if (!log_async_write(f, time_str))
+				fputs(time_str.c_str(), f);
 
 		for (auto f : log_streams)
 			*f << time_str;
 	}
 
-	for (auto f : log_files)
-		fputs(str.c_str(), f);
+	if (to_files) {
+		for (auto f : log_files)
+			if (!log_async_write(f, str))
+				fputs(str.c_str(), f);
 
-	for (auto f : log_streams)
-		*f << str;
+		for (auto f : log_streams)
+			*f << str;
+	}
 
 	RTLIL::Design *design = yosys_get_design();
 	if (design != nullptr)
@@ -299,11 +605,11 @@ void logv(const char *format, va_list ap)
 
 			if (!linebuffer.empty() && linebuffer.back() == '\n') {
 				for (auto &re : log_warn_regexes)
-					if (std::regex_search(linebuffer, re))
+					if (re.search(linebuffer))
 						log_warning("Found log message matching -W regex:\n%s", str.c_str());
 
 				for (auto &item : log_expect_log)
-					if (std::regex_search(linebuffer, item.second.pattern))
+					if (item.second.pattern.search(linebuffer))
 						item.second.current_count++;
 
 				linebuffer.clear();
@@ -362,10 +668,16 @@ static void logv_warning_with_prefix(const char *prefix,
                                      const char *format, va_list ap)
 {
 	std::string message = vstringf(format, ap);
+
+	if (log_capture) {
+		log_capture->events.push_back({LogCapture::EV_WARNING, false, prefix, message});
+		return;
+	}
+
 	bool suppressed = false;
 
 	for (auto &re : log_nowarn_regexes)
-		if (std::regex_search(message, re))
+		if (re.search(message))
 			suppressed = true;
 
 	if (suppressed)
@@ -378,12 +690,12 @@ static void logv_warning_with_prefix(const char *prefix,
 		log_make_debug = 0;
 
 		for (auto &re : log_werror_regexes)
-			if (std::regex_search(message, re))
+			if (re.search(message))
 				log_error("%s",  message.c_str());
 
 		bool warning_match = false;
 		for (auto &item : log_expect_warning)
-			if (std::regex_search(message, item.second.pattern)) {
+			if (item.second.pattern.search(message)) {
 				item.second.current_count++;
 				warning_match = true;
 			}
@@ -454,6 +766,9 @@ void log_file_info(const std::string &filename, int lineno,
 static void logv_error_with_prefix(const char *prefix,
                                    const char *format, va_list ap)
 {
+	if (log_capture)
+		throw log_capture_error_exception{prefix, vstringf(format, ap), false};
+
 #ifdef EMSCRIPTEN
 	auto backup_log_files = log_files;
 #endif
@@ -476,7 +791,7 @@ static void logv_error_with_prefix(const char *prefix,
 	log_make_debug = bak_log_make_debug;
 
 	for (auto &item : log_expect_error)
-		if (std::regex_search(log_last_error, item.second.pattern))
+		if (item.second.pattern.search(log_last_error))
 			item.second.current_count++;
 
 	log_check_expected();
@@ -484,6 +799,10 @@ static void logv_error_with_prefix(const char *prefix,
 	if (log_error_atexit)
 		log_error_atexit();
 
+	// _exit() skips atexit handlers, so push queued log output and pipe packets out now
+	log_flush();
+	Common::ShutdownPipes();
+
 	YS_DEBUGTRAP_IF_DEBUGGING;
 	const char *e = getenv("YOSYS_ABORT_ON_LOG_ERROR");
 	if (e && atoi(e))
@@ -588,6 +907,9 @@ void log_cmd_error(const char *format, ...)
 	va_list ap;
 	va_start(ap, format);
 
+	if (log_capture)
+		throw log_capture_error_exception{"ERROR: ", vstringf(format, ap), true};
+
 	if (log_cmd_error_throw) {
 		log_last_error = vstringf(format, ap);
 		log("ERROR: %s", log_last_error.c_str());
@@ -598,6 +920,77 @@ void log_cmd_error(const char *format, ...)
 	logv_error(format, ap);
 }
 
+static void log_warning_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_warning_with_prefix(prefix, format, ap);
+	va_end(ap);
+}
+
+[[noreturn]]
+static void log_error_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_error_with_prefix(prefix, format, ap);
+}
+
+void log_capture_begin(LogCapture *capture)
+{
+	log_assert(log_capture == nullptr);
+	log_capture = capture;
+}
+
+void log_capture_end()
+{
+	log_assert(log_capture != nullptr);
+	log_capture->debug_suppressed += log_debug_suppressed;
+	log_debug_suppressed = 0;
+	log_capture = nullptr;
+	log_id_cache_clear();
+	string_buf.clear();
+	string_buf_index = -1;
+}
+
+bool log_capture_active()
+{
+	return log_capture != nullptr;
+}
+
+void log_capture_replay(const LogCapture &capture)
+{
+	log_assert(log_capture == nullptr);
+	int bak_log_make_debug = log_make_debug;
+
+	for (auto &ev : capture.events) {
+		log_make_debug = ev.debug;
+		switch (ev.kind) {
+		case LogCapture::EV_LOG:
+			log("%s", ev.text.c_str());
+			break;
+		case LogCapture::EV_LOG2:
+		case LogCapture::EV_LOG2_SEND:
+			log2("%s", ev.kind == LogCapture::EV_LOG2_SEND, ev.text.c_str());
+			break;
+		case LogCapture::EV_WARNING:
+			log_make_debug = bak_log_make_debug;
+			log_warning_with_prefix(ev.prefix.c_str(), "%s", ev.text.c_str());
+			break;
+		}
+	}
+
+	log_make_debug = bak_log_make_debug;
+	log_debug_suppressed += capture.debug_suppressed;
+}
+
+void log_capture_raise(const log_capture_error_exception &e)
+{
+	if (e.cmd_error)
+		log_cmd_error("%s", e.message.c_str());
+	log_error_with_prefix(e.prefix.c_str(), "%s", e.message.c_str());
+}
+
 void log_spacer()
 {
 	if (log_newline_count < 2) log("\n");
@@ -727,6 +1120,11 @@ void log_reset_stack()
 
 void log_flush()
 {
+	if (log_capture)
+		return;
+
+	log_async_flush();
+
 	for (auto f : log_files)
 		fflush(f);
 
@@ -748,16 +1146,16 @@ void log_dump_val_worker(RTLIL::State v) {
 
 const char *log_signal(const RTLIL::SigSpec &sig, bool autoint)
 {
-	std::stringstream buf;
+	std::string buf;
 	RTLIL_BACKEND::dump_sigspec(buf, sig, autoint);
 
 	if (string_buf.size() < 100) {
-		string_buf.push_back(buf.str());
+		string_buf.push_back(std::move(buf));
 		return string_buf.back().c_str();
 	} else {
 		if (++string_buf_index == 100)
 			string_buf_index = 0;
-		string_buf[string_buf_index] = buf.str();
+		string_buf[string_buf_index] = std::move(buf);
 		return string_buf[string_buf_index].c_str();
 	}
 }
@@ -795,23 +1193,108 @@ const char *log_id(const RTLIL::IdString &str)
 
 void log_module(RTLIL::Module *module, std::string indent)
 {
-	std::stringstream buf;
+	std::string buf;
 	RTLIL_BACKEND::dump_module(buf, indent, module, module->design, false);
-	log("%s", buf.str().c_str());
+	log("%s", buf.c_str());
 }
 
 void log_cell(RTLIL::Cell *cell, std::string indent)
 {
-	std::stringstream buf;
+	std::string buf;
 	RTLIL_BACKEND::dump_cell(buf, indent, cell);
-	log("%s", buf.str().c_str());
+	log("%s", buf.c_str());
 }
 
 void log_wire(RTLIL::Wire *wire, std::string indent)
 {
-	std::stringstream buf;
+	std::string buf;
 	RTLIL_BACKEND::dump_wire(buf, indent, wire);
-	log("%s", buf.str().c_str());
+	log("%s", buf.c_str());
+}
+
+// Returns the longest run of plain characters in an egrep pattern that any
+// match must contain, or an empty string if there is none or the pattern
+// uses alternation. Everything not understood here just ends the run.
+static std::string log_regex_literal(const std::string &pattern)
+{
+	std::string best, run;
+	auto end_run = [&]() {
+		if (GetSize(run) > GetSize(best))
+			best = run;
+		run.clear();
+	};
+
+	for (size_t i = 0; i < pattern.size(); i++)
+	{
+		char ch = pattern[i];
+		bool is_char = false;
+
+		if (ch == '|' || ch == '\n')
+			return std::string();
+
+		if (ch == '\\') {
+			if (i+1 < pattern.size() && !isalnum((unsigned char)pattern[i+1]))
+				ch = pattern[++i], is_char = true;
+			else
+				i++;
+		} else if (ch == '[') {
+			// skip the bracket expression, including [:class:] items
+			size_t k = i+1;
+			if (k < pattern.size() && pattern[k] == '^')
+				k++;
+			if (k < pattern.size() && pattern[k] == ']')
+				k++;
+			while (k < pattern.size() && pattern[k] != ']') {
+				if (pattern[k] == '[' && k+1 < pattern.size() && strchr(":.=", pattern[k+1])) {
+					size_t close = pattern.find(std::string(1, pattern[k+1]) + "]", k+2);
+					if (close == std::string::npos)
+						return std::string();
+					k = close + 1;
+				} else
+					k++;
+			}
+			i = k;
+		} else if (ch == '(') {
+			// alternatives inside the group do not matter, it is skipped as a whole
+			int depth = 1;
+			while (depth > 0 && ++i < pattern.size()) {
+				if (pattern[i] == '\\')
+					i++;
+				else if (pattern[i] == '(')
+					depth++;
+				else if (pattern[i] == ')')
+					depth--;
+			}
+		} else if (!strchr(".^$*+?{}()", ch)) {
+			is_char = true;
+		}
+
+		char next = i+1 < pattern.size() ? pattern[i+1] : 0;
+		if (next == '*' || next == '?' || next == '{') {
+			// the atom is optional, and so is everything after it
+			end_run();
+		} else if (is_char) {
+			run += ch;
+			if (next == '+')
+				end_run();
+		} else {
+			end_run();
+		}
+	}
+
+	end_run();
+	return best;
+}
+
+LogRegex::LogRegex(const std::string &pattern) : re(YS_REGEX_COMPILE(pattern)), literal(log_regex_literal(pattern))
+{
+}
+
+bool LogRegex::search(const std::string &str) const
+{
+	if (!literal.empty() && str.find(literal) == std::string::npos)
+		return false;
+	return std::regex_search(str, re);
 }
 
 void log_check_expected()
@@ -24,6 +24,7 @@
 #include "libs/utils/log_pipe/common.h"
 #include <time.h>
 
+#include <atomic>
 #include <regex>
 #define YS_REGEX_COMPILE(param) std::regex(param, \
 				std::regex_constants::nosubs | \
@@ -95,10 +96,24 @@ YOSYS_NAMESPACE_BEGIN
 struct log_cmd_error_exception { };
 
 extern std::vector<FILE*> log_files;
+extern std::vector<int> header_count;
 extern std::vector<std::ostream*> log_streams;
 extern std::vector<std::string> log_scratchpads;
 extern std::map<std::string, std::set<std::string>> log_hdump;
-extern std::vector<std::regex> log_warn_regexes, log_nowarn_regexes, log_werror_regexes;
+// A regex of the -W/-w/-e options and the logger pass. It also keeps the
+// longest plain string that every match of the pattern contains, and search()
+// only runs the (slow) std::regex on strings that contain this literal.
+struct LogRegex
+{
+	LogRegex() {}
+	LogRegex(const std::string &pattern);
+	bool search(const std::string &str) const;
+
+	std::regex re;
+	std::string literal;
+};
+
+extern std::vector<LogRegex> log_warn_regexes, log_nowarn_regexes, log_werror_regexes;
 extern std::set<std::string> log_warnings, log_experimentals, log_experimentals_ignored;
 extern int log_warnings_count;
 extern int log_warnings_count_noexpect;
@@ -115,9 +130,56 @@ extern int log_verbose_level;
 extern string log_last_error;
 extern void (*log_error_atexit)();
 
-extern int log_make_debug;
+extern YS_THREAD_LOCAL int log_make_debug;
 extern int log_force_debug;
-extern int log_debug_suppressed;
+extern YS_THREAD_LOCAL int log_debug_suppressed;
+
+// Per-sink verbosity masks. Each mask is a set of LOG_LEVEL_* bits; logv() and
+// logv2() test them before formatting, so a message no sink wants is dropped
+// after a single branch. Warnings and errors are not subject to the masks.
+enum LogSink {
+	LOG_SINK_FILES = 0,	// log_files, log_streams and the log hash
+	LOG_SINK_PIPE,		// LOG pipe to the parent process
+	LOG_SINK_COUNT
+};
+
+enum {
+	LOG_LEVEL_DEBUG = 1,	// log_debug() and log() while log_make_debug is set
+	LOG_LEVEL_INFO = 2,	// regular log() output
+	LOG_LEVEL_ALL = LOG_LEVEL_DEBUG | LOG_LEVEL_INFO
+};
+
+extern std::atomic<unsigned int> log_sink_mask[LOG_SINK_COUNT];
+extern std::atomic<unsigned int> log_sink_any_mask;
+
+void log_set_sink_mask(LogSink sink, unsigned int mask);
+// Parses "<sink>=<level>[,<level>..]" with sink files|pipe and level debug|info|all|none
+bool log_parse_sink_mask(const std::string &spec);
+
+// Cooperative interruption driven by the CONTROL pipe. The pipe reader sets
+// bits in log_control_pending when the parent process asks to abort, pause or
+// report progress. Long-running loops call log_check_interrupt(), which is a
+// single relaxed load while nothing is pending. An abort request is raised as
+// log_cmd_error() at the call site. It may be called from any thread: inside
+// parallel_for*() tasks the error is reported after the join like any other
+// task error, and other threads leave the abort to the next check elsewhere.
+enum {
+	LOG_CONTROL_ABORT = 1,
+	LOG_CONTROL_PAUSE = 2,
+	LOG_CONTROL_PROGRESS = 4
+};
+
+extern std::atomic<int> log_control_pending;
+
+// extra_handler is called on the pipe reader thread for commands that are not
+// handled here and returns false for unknown commands
+void log_control_start(std::function<bool(const nlohmann::json&)> extra_handler = nullptr);
+void log_check_interrupt_worker(const char *where, int64_t done, int64_t total);
+
+static inline void log_check_interrupt(const char *where = nullptr, int64_t done = -1, int64_t total = -1) {
+	if (log_control_pending.load(std::memory_order_relaxed))
+		log_check_interrupt_worker(where, done, total);
+}
 
 void logv(const char *format, va_list ap);
 void logv_header(RTLIL::Design *design, const char *format, va_list ap);
@@ -157,12 +219,41 @@ void log_error(const char *format, LogData& logdata, ...) YS_ATTRIBUTE(format(pr
 void log_file_error(const string &filename, int lineno, LogData &logdata, const char *format, ...) YS_ATTRIBUTE(format(printf, 4, 5));
 [[noreturn]] void log_cmd_error(const char *format, ...) YS_ATTRIBUTE(format(printf, 1, 2));
 
+// Per-thread log capture, used by parallel_for_modules() in kernel/threading.h.
+// While a capture is active on a thread, log(), log2() and warnings of that
+// thread are recorded instead of written, and log_capture_replay() emits them
+// later on the main thread. Errors raised while capturing unwind the worker as
+// log_capture_error_exception; log_capture_raise() reports them for real.
+struct LogCapture
+{
+	enum event_kind { EV_LOG, EV_LOG2, EV_LOG2_SEND, EV_WARNING };
+	struct event_t {
+		event_kind kind;
+		bool debug;
+		std::string prefix, text;
+	};
+	std::vector<event_t> events;
+	int debug_suppressed = 0;
+};
+
+struct log_capture_error_exception {
+	std::string prefix, message;
+	bool cmd_error;
+};
+
+void log_capture_begin(LogCapture *capture);
+void log_capture_end();
+bool log_capture_active();
+void log_capture_replay(const LogCapture &capture);
+[[noreturn]] void log_capture_raise(const log_capture_error_exception &e);
+
 #ifndef NDEBUG
 static inline bool ys_debug(int n = 0) { if (log_force_debug) return true; log_debug_suppressed += n; return false; }
 #else
 static inline bool ys_debug(int = 0) { return false; }
 #endif
-#  define log_debug(...) do { if (ys_debug(1)) log(__VA_ARGS__); } while (0)
+#  define log_debug(...) do { if (ys_debug(1) && (log_sink_any_mask.load(std::memory_order_relaxed) & LOG_LEVEL_DEBUG)) { \
+		log_make_debug++; log(__VA_ARGS__); log_make_debug--; } } while (0)
 
 static inline void log_suppressed() {
 	if (log_debug_suppressed && !log_make_debug) {
@@ -204,13 +295,19 @@ void log_backtrace(const char *prefix, int levels);
 void log_reset_stack();
 void log_flush();
 
+// Hands the writes to a file in log_files to a background thread, so that
+// slow storage does not block the passes. log_flush() waits until all output
+// is written. Call log_file_sync() before the file is closed.
+void log_file_async(FILE *f);
+void log_file_sync(FILE *f);
+
 struct LogExpectedItem
 {
-	LogExpectedItem(const std::regex &pat, int expected) :
+	LogExpectedItem(const LogRegex &pat, int expected) :
 			pattern(pat), expected_count(expected), current_count(0) {}
 	LogExpectedItem() : expected_count(0), current_count(0) {}
 
-	std::regex pattern;
+	LogRegex pattern;
 	int expected_count;
 	int current_count;
 };
@@ -309,7 +406,13 @@ struct PerformanceTimer
 
 	static int64_t query() {
 #  ifdef _WIN32
-		return 0;
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+			return 0;
+		// FILETIME counts in 100ns units
+		int64_t t = (int64_t(kernel_time.dwHighDateTime) << 32) | kernel_time.dwLowDateTime;
+		t += (int64_t(user_time.dwHighDateTime) << 32) | user_time.dwLowDateTime;
+		return t * 100;
 #  elif defined(RUSAGE_SELF)
 		struct rusage rusage;
 		int64_t t = 0;
@@ -50,6 +50,8 @@ void Mem::remove() {
 			init.cell = nullptr;
 		}
 	}
+	// erasing from module->memories is not seen by the module
+	module->generation_++;
 }
 
 void Mem::emit() {
@@ -342,6 +344,9 @@ void Mem::emit() {
 				init.cell->unsetPort(ID::EN);
 		}
 	}
+	// the parameters above are written directly, which the module does
+	// not count as a change
+	module->generation_++;
 }
 
 void Mem::clear_inits() {
@@ -831,29 +836,68 @@ namespace {
 
 }
 
-std::vector<Mem> Mem::get_all_memories(Module *module) {
-	std::vector<Mem> res;
-	MemIndex index(module);
-	for (auto it: module->memories) {
-		res.push_back(mem_from_memory(module, it.second, index));
-	}
-	for (auto cell: module->cells()) {
-		if (cell->type.in(ID($mem), ID($mem_v2)))
-			res.push_back(mem_from_cell(cell));
+namespace {
+
+	const std::vector<Mem> &cached_memories(Module *module) {
+		if (module->cached_mems_ == nullptr)
+			module->cached_mems_ = new MemCache;
+
+		MemCache *cache = module->cached_mems_;
+		if (cache->valid && cache->generation == module->generation_ && cache->memories == GetSize(module->memories)) {
+			// attributes can be changed without touching the module
+			for (auto &mem : cache->mems) {
+				mem.attributes = mem.mem ? mem.mem->attributes : mem.cell->attributes;
+				for (auto &port : mem.rd_ports)
+					if (port.cell)
+						port.attributes = port.cell->attributes;
+				for (auto &port : mem.wr_ports)
+					if (port.cell)
+						port.attributes = port.cell->attributes;
+				for (auto &init : mem.inits)
+					if (init.cell)
+						init.attributes = init.cell->attributes;
+			}
+			return cache->mems;
+		}
+
+		cache->mems.clear();
+		MemIndex index(module);
+		for (auto it: module->memories) {
+			cache->mems.push_back(mem_from_memory(module, it.second, index));
+		}
+		for (auto cell: module->cells()) {
+			if (cell->type.in(ID($mem), ID($mem_v2)))
+				cache->mems.push_back(mem_from_cell(cell));
+		}
+		cache->valid = true;
+		cache->generation = module->generation_;
+		cache->memories = GetSize(module->memories);
+		return cache->mems;
 	}
-	return res;
+
+}
+
+std::vector<Mem> Mem::get_all_memories(Module *module) {
+	return cached_memories(module);
+}
+
+bool MemPassCache::skip(Module *module) const {
+	auto it = unchanged.find(module->hashidx_);
+	return it != unchanged.end() && it->second == module->generation_ && module->design->selected_whole_module(module);
+}
+
+void MemPassCache::update(Module *module, bool changed) {
+	if (changed || !module->design->selected_whole_module(module))
+		unchanged.erase(module->hashidx_);
+	else
+		unchanged[module->hashidx_] = module->generation_;
 }
 
 std::vector<Mem> Mem::get_selected_memories(Module *module) {
 	std::vector<Mem> res;
-	MemIndex index(module);
-	for (auto it: module->memories) {
-		if (module->design->selected(module, it.second))
-			res.push_back(mem_from_memory(module, it.second, index));
-	}
-	for (auto cell: module->selected_cells()) {
-		if (cell->type.in(ID($mem), ID($mem_v2)))
-			res.push_back(mem_from_cell(cell));
+	for (auto &mem : cached_memories(module)) {
+		if (mem.mem ? module->design->selected(module, mem.mem) : module->design->selected(module, mem.cell))
+			res.push_back(mem);
 	}
 	return res;
 }
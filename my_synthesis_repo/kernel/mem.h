@@ -130,7 +130,8 @@ struct Mem : RTLIL::AttrObject {
 	Const get_init_data() const;
 
 	// Constructs and returns the helper structures for all memories
-	// in a module.
+	// in a module.  The structures are cached on the module and only
+	// rebuilt after the module changed.
 	static std::vector<Mem> get_all_memories(Module *module);
 
 	// Constructs and returns the helper structures for all selected
@@ -224,6 +225,31 @@ struct Mem : RTLIL::AttrObject {
 	Mem(Module *module, IdString memid, int width, int start_offset, int size) : module(module), memid(memid), packed(false), mem(nullptr), cell(nullptr), width(width), start_offset(start_offset), size(size) {}
 };
 
+// The helper structures of all memories in a module, as of one module
+// generation, behind Mem::get_all_memories(). Every edit through the Module
+// and Cell API (as well as Mem::emit(), Mem::remove() and notify_blackout())
+// bumps the generation, so the cache does not follow monitor callbacks and is
+// not registered in module->monitors. Owned by the module.
+struct MemCache
+{
+	bool valid = false;
+	unsigned int generation = 0;
+	int memories = 0;
+	std::vector<Mem> mems;
+};
+
+// Remembers, by module generation, the modules in which a memory pass found
+// nothing to do on its last run, so that the repeated opt_mem* runs within
+// `opt -full` and `memory` skip them until they change.  Only fully selected
+// modules are recorded.
+struct MemPassCache
+{
+	dict<unsigned int, unsigned int> unchanged;
+
+	bool skip(Module *module) const;
+	void update(Module *module, bool changed);
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
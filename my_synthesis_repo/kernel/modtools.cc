@@ -0,0 +1,73 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/modtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+ModIndex::counter_t ModIndex::reload_counter(0);
+
+ModIndex &ModIndex::get(RTLIL::Module *module)
+{
+	if (module->cached_modindex_ == nullptr)
+		module->cached_modindex_ = new ModIndex(module);
+
+	ModIndex *index = static_cast<ModIndex*>(module->cached_modindex_);
+
+	// the auto-reload warning is about reloads within one user of the index
+	index->auto_reload_counter = 0;
+	return *index;
+}
+
+CellGraph::CellGraph(RTLIL::Module *module, const std::vector<RTLIL::Cell*> &cells,
+		const std::function<bool(RTLIL::Cell*, RTLIL::IdString)> &use_port) : cells(cells)
+{
+	for (int i = 0; i < GetSize(cells); i++)
+		node_of[cells[i]] = i;
+
+	ModIndex &index = ModIndex::get(module);
+	std::vector<std::pair<int, int>> edges;
+
+	for (int i = 0; i < GetSize(cells); i++)
+	{
+		RTLIL::Cell *cell = cells[i];
+		size_t cell_edges = edges.size();
+
+		for (auto &conn : cell->connections()) {
+			if (!cell->output(conn.first) || (use_port && !use_port(cell, conn.first)))
+				continue;
+			for (auto bit : conn.second)
+				for (auto &port : index.query_ports(bit)) {
+					auto it = node_of.find(port.cell);
+					if (it == node_of.end() || !port.cell->input(port.port))
+						continue;
+					if (use_port && !use_port(port.cell, port.port))
+						continue;
+					edges.emplace_back(i, it->second);
+				}
+		}
+
+		std::sort(edges.begin() + cell_edges, edges.end());
+		edges.erase(std::unique(edges.begin() + cell_edges, edges.end()), edges.end());
+	}
+
+	graph = CsrGraph(GetSize(cells), edges);
+}
+
+YOSYS_NAMESPACE_END
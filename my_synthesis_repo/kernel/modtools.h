@@ -23,6 +23,7 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
+#include "kernel/utils.h"
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -78,6 +79,14 @@ struct ModIndex : public RTLIL::Monitor
 	int auto_reload_counter;
 	bool auto_reload_module;
 
+#ifdef YOSYS_ENABLE_THREADS
+	typedef std::atomic<int64_t> counter_t;
+#else
+	typedef int64_t counter_t;
+#endif
+	// running total of reload_module() calls, attributed to passes in Pass::post_execute()
+	static counter_t reload_counter;
+
 	void port_add(RTLIL::Cell *cell, RTLIL::IdString port, const RTLIL::SigSpec &sig)
 	{
 		for (int i = 0; i < GetSize(sig); i++) {
@@ -103,6 +112,8 @@ struct ModIndex : public RTLIL::Monitor
 
 	void reload_module(bool reset_sigmap = true)
 	{
+		reload_counter++;
+
 		if (reset_sigmap) {
 			sigmap.clear();
 			sigmap.set(module);
@@ -238,6 +249,14 @@ struct ModIndex : public RTLIL::Monitor
 		module->monitors.erase(this);
 	}
 
+	// Returns the index cached on the module, creating it on first use. It is
+	// kept up to date by the monitor callbacks across passes and only rebuilt
+	// after bulk edits (new_connections(), fixup_ports(), wire removal, cell
+	// renames, rewrite_sigspecs()). Edits that bypass the Module and Cell API,
+	// such as changing wire->port_input without calling fixup_ports(), must be
+	// followed by module->notify_blackout(). The module owns the index.
+	static ModIndex &get(RTLIL::Module *module);
+
 	SigBitInfo *query(RTLIL::SigBit bit)
 	{
 		if (auto_reload_module)
@@ -297,6 +316,20 @@ struct ModIndex : public RTLIL::Monitor
 	}
 };
 
+// Cell dependency graph of a module, built from the module's cached ModIndex:
+// node i is cells[i], with an edge from each cell to every cell in the list
+// that reads a bit it drives. Ports for which use_port returns false are
+// ignored on both ends, e.g. to cut the graph at FF outputs.
+struct CellGraph
+{
+	std::vector<RTLIL::Cell*> cells;
+	dict<RTLIL::Cell*, int> node_of;
+	CsrGraph graph;
+
+	CellGraph(RTLIL::Module *module, const std::vector<RTLIL::Cell*> &cells,
+			const std::function<bool(RTLIL::Cell*, RTLIL::IdString)> &use_port = nullptr);
+};
+
 struct ModWalker
 {
 	struct PortBit
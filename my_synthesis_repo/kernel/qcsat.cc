@@ -18,6 +18,7 @@
  */
 
 #include "kernel/qcsat.h"
+#include "kernel/utils.h"
 
 USING_YOSYS_NAMESPACE
 
@@ -100,3 +101,313 @@ int QuickConeSat::cell_complexity(RTLIL::Cell *cell)
 	// Unknown cell.
 	return 5;
 }
+
+void QuickConeSim::run()
+{
+	values.clear();
+	unknown_bits.clear();
+	valid_patterns = 0;
+
+	auto imported = [&](RTLIL::Cell *cell) {
+		return QuickConeSat::cell_complexity(cell) <= qcsat.max_cell_complexity;
+	};
+
+	TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
+	cells.analyze_loops = false;
+
+	for (auto cell : modwalker.module->cells())
+	{
+		if (!imported(cell))
+			continue;
+		cells.node(cell);
+
+		// A second driver or a constant adds constraints to the inputs of
+		// the cell that random patterns do not honour.
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first) && modwalker.sigmap(conn.second).has_const())
+				return;
+
+		if (modwalker.cell_outputs.count(cell))
+			for (auto bit : modwalker.cell_outputs.at(cell)) {
+				int drivers = 0;
+				for (auto &pbit : modwalker.signal_drivers.at(bit))
+					if (imported(pbit.cell))
+						drivers++;
+				if (drivers > 1)
+					return;
+			}
+
+		if (modwalker.cell_inputs.count(cell))
+			for (auto bit : modwalker.cell_inputs.at(cell)) {
+				auto it = modwalker.signal_drivers.find(bit);
+				if (it == modwalker.signal_drivers.end())
+					continue;
+				for (auto &pbit : it->second)
+					if (imported(pbit.cell))
+						cells.edge(pbit.cell, cell);
+			}
+	}
+
+	if (!cells.sort())
+		return;
+
+	for (auto cell : cells.sorted)
+		simulate_cell(cell);
+
+	uint64_t invalid = 0;
+	for (auto wire : modwalker.module->wires())
+	{
+		if (!wire->get_bool_attribute(ID::onehot))
+			continue;
+		uint64_t seen = 0;
+		for (auto bit : SigSpec(wire)) {
+			uint64_t word;
+			if (!get(bit, word))
+				return;
+			invalid |= seen & word;
+			seen |= word;
+		}
+	}
+
+	valid_patterns = ~invalid;
+}
+
+bool QuickConeSim::get(RTLIL::SigBit bit, uint64_t &patterns)
+{
+	bit = modwalker.sigmap(bit);
+
+	// SatGen without an undef model imports x and z bits as zero.
+	if (!bit.wire) {
+		patterns = bit == State::S1 ? ~uint64_t(0) : 0;
+		return true;
+	}
+
+	if (unknown_bits.count(bit))
+		return false;
+
+	// Bits without a simulated driver are inputs of the model.
+	auto it = values.find(bit);
+	if (it == values.end())
+		it = values.emplace(bit, next_random()).first;
+	patterns = it->second;
+	return true;
+}
+
+bool QuickConeSim::can_simulate(RTLIL::Cell *cell)
+{
+	return cell->type.in(ID($pos), ID($_BUF_), ID($not), ID($_NOT_), ID($neg),
+			ID($and), ID($or), ID($xor), ID($xnor), ID($add), ID($sub),
+			ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_),
+			ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_),
+			ID($mux), ID($_MUX_), ID($_NMUX_), ID($pmux),
+			ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool),
+			ID($logic_not), ID($logic_and), ID($logic_or),
+			ID($eq), ID($ne), ID($eqx), ID($nex), ID($lt), ID($le), ID($gt), ID($ge));
+}
+
+uint64_t QuickConeSim::next_random()
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+	return rng_state;
+}
+
+static bool import_sig(const RTLIL::SigSpec &sig, const std::function<bool(RTLIL::SigBit, uint64_t&)> &get, std::vector<uint64_t> &words)
+{
+	words.clear();
+	for (auto bit : sig) {
+		uint64_t word;
+		if (!get(bit, word))
+			return false;
+		words.push_back(word);
+	}
+	return true;
+}
+
+static void extend_words(std::vector<uint64_t> &words, int width, bool is_signed)
+{
+	while (GetSize(words) < width)
+		words.push_back(is_signed && !words.empty() ? words.back() : 0);
+}
+
+static uint64_t reduce_or_words(const std::vector<uint64_t> &words)
+{
+	uint64_t result = 0;
+	for (auto word : words)
+		result |= word;
+	return result;
+}
+
+// Returns a < b for each pattern, both vectors must have the same width.
+static uint64_t lt_words(std::vector<uint64_t> a, std::vector<uint64_t> b, bool is_signed)
+{
+	if (is_signed && !a.empty()) {
+		a.back() = ~a.back();
+		b.back() = ~b.back();
+	}
+	uint64_t result = 0;
+	for (int i = 0; i < GetSize(a); i++)
+		result = (~a[i] & b[i]) | (~(a[i] ^ b[i]) & result);
+	return result;
+}
+
+static std::vector<uint64_t> add_words(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b, bool subtract)
+{
+	std::vector<uint64_t> result(a.size());
+	uint64_t carry = subtract ? ~uint64_t(0) : 0;
+	for (int i = 0; i < GetSize(a); i++) {
+		uint64_t bb = subtract ? ~b[i] : b[i];
+		result[i] = a[i] ^ bb ^ carry;
+		carry = (a[i] & bb) | (carry & (a[i] ^ bb));
+	}
+	return result;
+}
+
+void QuickConeSim::simulate_cell(RTLIL::Cell *cell)
+{
+	std::vector<uint64_t> y;
+
+	if (!eval_cell(cell, [&](RTLIL::SigBit bit, uint64_t &word) { return get(bit, word); }, y)) {
+		if (modwalker.cell_outputs.count(cell))
+			for (auto bit : modwalker.cell_outputs.at(cell))
+				unknown_bits.insert(bit);
+		return;
+	}
+
+	SigSpec sig_y = cell->getPort(ID::Y);
+	for (int i = 0; i < GetSize(sig_y); i++) {
+		SigBit bit = modwalker.sigmap(sig_y[i]);
+		values[bit] = y[i];
+	}
+}
+
+bool QuickConeSim::eval_cell(RTLIL::Cell *cell, const std::function<bool(RTLIL::SigBit, uint64_t&)> &get, std::vector<uint64_t> &y)
+{
+	std::vector<uint64_t> a, b, c, d, s;
+
+	if (!can_simulate(cell))
+		return false;
+	for (auto &conn : cell->connections())
+		if (conn.first != ID::Y && !import_sig(conn.second, get, conn.first == ID::A ? a : conn.first == ID::B ? b :
+				conn.first == ID::C ? c : conn.first == ID::D ? d : s))
+			return false;
+
+	y.clear();
+	SigSpec sig_y = cell->getPort(ID::Y);
+	int width = GetSize(sig_y);
+
+	auto param_bool = [&](IdString param) {
+		return cell->hasParam(param) && cell->getParam(param).as_bool();
+	};
+
+	if (cell->type.in(ID($pos), ID($_BUF_), ID($not), ID($_NOT_), ID($neg)))
+	{
+		extend_words(a, width, param_bool(ID::A_SIGNED));
+		y = a;
+		if (cell->type.in(ID($not), ID($_NOT_)))
+			for (auto &word : y)
+				word = ~word;
+		if (cell->type == ID($neg))
+			y = add_words(std::vector<uint64_t>(a.size()), a, true);
+	}
+	else if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($add), ID($sub),
+			ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_)))
+	{
+		bool is_signed = param_bool(ID::A_SIGNED) && param_bool(ID::B_SIGNED);
+		int ext_width = std::max(width, std::max(GetSize(a), GetSize(b)));
+		extend_words(a, ext_width, is_signed);
+		extend_words(b, ext_width, is_signed);
+		if (cell->type.in(ID($add), ID($sub))) {
+			y = add_words(a, b, cell->type == ID($sub));
+		} else {
+			y.resize(ext_width);
+			for (int i = 0; i < ext_width; i++) {
+				if (cell->type.in(ID($and), ID($_AND_)))
+					y[i] = a[i] & b[i];
+				else if (cell->type == ID($_NAND_))
+					y[i] = ~(a[i] & b[i]);
+				else if (cell->type.in(ID($or), ID($_OR_)))
+					y[i] = a[i] | b[i];
+				else if (cell->type == ID($_NOR_))
+					y[i] = ~(a[i] | b[i]);
+				else if (cell->type.in(ID($xor), ID($_XOR_)))
+					y[i] = a[i] ^ b[i];
+				else if (cell->type.in(ID($xnor), ID($_XNOR_)))
+					y[i] = ~(a[i] ^ b[i]);
+				else if (cell->type == ID($_ANDNOT_))
+					y[i] = a[i] & ~b[i];
+				else
+					y[i] = a[i] | ~b[i];
+			}
+		}
+	}
+	else if (cell->type.in(ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_)))
+	{
+		bool aoi_mode = cell->type.in(ID($_AOI3_), ID($_AOI4_));
+		if (d.empty())
+			d.push_back(aoi_mode ? ~uint64_t(0) : 0);
+		if (aoi_mode)
+			y.push_back(~((a[0] & b[0]) | (c[0] & d[0])));
+		else
+			y.push_back(~((a[0] | b[0]) & (c[0] | d[0])));
+	}
+	else if (cell->type.in(ID($mux), ID($_MUX_), ID($_NMUX_), ID($pmux)))
+	{
+		y = a;
+		for (int i = 0; i < GetSize(s); i++)
+			for (int j = 0; j < GetSize(y); j++)
+				y[j] = (s[i] & b[i*GetSize(a) + j]) | (~s[i] & y[j]);
+		if (cell->type == ID($_NMUX_))
+			for (auto &word : y)
+				word = ~word;
+	}
+	else
+	{
+		uint64_t result;
+		if (cell->type == ID($reduce_and)) {
+			result = ~uint64_t(0);
+			for (auto word : a)
+				result &= word;
+		} else if (cell->type.in(ID($reduce_xor), ID($reduce_xnor))) {
+			result = 0;
+			for (auto word : a)
+				result ^= word;
+			if (cell->type == ID($reduce_xnor))
+				result = ~result;
+		} else if (cell->type.in(ID($reduce_or), ID($reduce_bool))) {
+			result = reduce_or_words(a);
+		} else if (cell->type == ID($logic_not)) {
+			result = ~reduce_or_words(a);
+		} else if (cell->type == ID($logic_and)) {
+			result = reduce_or_words(a) & reduce_or_words(b);
+		} else if (cell->type == ID($logic_or)) {
+			result = reduce_or_words(a) | reduce_or_words(b);
+		} else {
+			bool is_signed = param_bool(ID::A_SIGNED) && param_bool(ID::B_SIGNED);
+			int ext_width = std::max(GetSize(a), GetSize(b));
+			extend_words(a, ext_width, is_signed);
+			extend_words(b, ext_width, is_signed);
+			if (cell->type.in(ID($eq), ID($eqx), ID($ne), ID($nex))) {
+				result = 0;
+				for (int i = 0; i < ext_width; i++)
+					result |= a[i] ^ b[i];
+				if (cell->type.in(ID($eq), ID($eqx)))
+					result = ~result;
+			} else if (cell->type == ID($lt)) {
+				result = lt_words(a, b, is_signed);
+			} else if (cell->type == ID($le)) {
+				result = ~lt_words(b, a, is_signed);
+			} else if (cell->type == ID($gt)) {
+				result = lt_words(b, a, is_signed);
+			} else {
+				result = ~lt_words(a, b, is_signed);
+			}
+		}
+		y.push_back(result);
+	}
+
+	extend_words(y, width, false);
+	y.resize(width);
+	return true;
+}
@@ -71,6 +71,50 @@ struct QuickConeSat {
 	static int cell_complexity(RTLIL::Cell *cell);
 };
 
+// A companion to QuickConeSat that evaluates the same model of the module on
+// 64 pseudo-random input patterns at once, one pattern per bit of a uint64_t.
+// Every valid pattern is also a solution of the constraints QuickConeSat
+// would import (with any of its cell limits, which only drop constraints), so
+// a satisfiability query that one of the patterns already answers does not
+// need to be passed to the solver.  Queries that none of the
+// patterns answer still have to go to QuickConeSat.
+struct QuickConeSim {
+	QuickConeSat &qcsat;
+	ModWalker &modwalker;
+
+	// The patterns that satisfy all onehot constraints, or 0 if the model
+	// cannot be simulated at all (loops, multiple or constant drivers).
+	uint64_t valid_patterns = 0;
+
+	// Internal state.
+	dict<RTLIL::SigBit, uint64_t> values;
+	pool<RTLIL::SigBit> unknown_bits;
+	uint64_t rng_state;
+
+	QuickConeSim(QuickConeSat &qcsat, uint64_t seed = 1) : qcsat(qcsat), modwalker(qcsat.modwalker), rng_state(seed) {}
+
+	// Simulates all cells of the module that QuickConeSat would import.
+	void run();
+
+	// Sets patterns to the simulated values of a bit.  Returns false when
+	// the bit depends on a cell that QuickConeSat imports but that cannot be
+	// simulated here.
+	bool get(RTLIL::SigBit bit, uint64_t &patterns);
+
+	// Returns true if the cell can be evaluated by this class.
+	static bool can_simulate(RTLIL::Cell *cell);
+
+	// Evaluates a cell on 64 patterns at once, independent of any module
+	// model.  get() returns the patterns of an input bit, or false if they
+	// are not known.  Returns false if the cell cannot be simulated or an
+	// input is not known, otherwise y has one word per bit of the Y port.
+	static bool eval_cell(RTLIL::Cell *cell, const std::function<bool(RTLIL::SigBit, uint64_t&)> &get, std::vector<uint64_t> &y);
+
+private:
+	uint64_t next_random();
+	void simulate_cell(RTLIL::Cell *cell);
+};
+
 YOSYS_NAMESPACE_END
 
 #endif
@@ -19,33 +19,128 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/modtools.h"
+#include "kernel/tracing.h"
+#include "backends/rtlil/rtlil_backend.h"
+#include "frontends/rtlil/rtlil_frontend.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <chrono>
+
+#if defined(_WIN32)
+#  include <psapi.h>
+#elif defined(__linux__)
+#  include <unistd.h>
+#endif
 
 // #include <unistd.h>
 #ifdef YOSYS_ENABLE_ZLIB
 #include <zlib.h>
 
+USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 #define GZ_BUFFER_SIZE 8192
-void decompress_gzip(const std::string &filename, std::stringstream &out)
+#define GZ_INFLATE_BLOCK (4 << 20)
+
+/*
+Decompresses a whole gzip file into memory. Regular files are mapped and
+inflated in large blocks straight into the result, which is sized from the
+length in the gzip trailer. Files with several gzip members (concatenated
+or written by pigz/bgzip) are read member after member. Anything that cannot
+be mapped, like a named pipe, goes through gzread() instead.
+*/
+std::string decompress_gzip(const std::string &filename)
 {
-	char buffer[GZ_BUFFER_SIZE];
-	int bytes_read;
-	gzFile gzf = gzopen(filename.c_str(), "rb");
-	while(!gzeof(gzf)) {
-		bytes_read = gzread(gzf, reinterpret_cast<void *>(buffer), GZ_BUFFER_SIZE);
-		out.write(buffer, bytes_read);
+	std::string out;
+	size_t written = 0;
+
+	MappedFile mapped;
+	if (!mapped.map(filename))
+	{
+		gzFile gzf = gzopen(filename.c_str(), "rb");
+		if (gzf == nullptr)
+			log_cmd_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+		gzbuffer(gzf, GZ_INFLATE_BLOCK);
+		while (1) {
+			out.resize(written + GZ_INFLATE_BLOCK);
+			int bytes_read = gzread(gzf, &out[written], GZ_INFLATE_BLOCK);
+			if (bytes_read < 0) {
+				int errnum;
+				std::string msg = gzerror(gzf, &errnum);
+				gzclose(gzf);
+				log_cmd_error("Error while decompressing gzip file `%s': %s\n", filename.c_str(), msg.c_str());
+			}
+			written += bytes_read;
+			if (bytes_read < GZ_INFLATE_BLOCK)
+				break;
+		}
+		gzclose(gzf);
+		out.resize(written);
+		return out;
+	}
+
+	const unsigned char *in = (const unsigned char*)mapped.data;
+	size_t in_size = mapped.size, in_pos = 0;
+
+	// ISIZE of the last member is the whole length (mod 2^32) for the usual single-member file
+	size_t size_hint = 0;
+	if (in_size >= 18)
+		for (int i = 0; i < 4; i++)
+			size_hint |= size_t(in[in_size - 4 + i]) << (8*i);
+	out.resize(std::max(size_hint, std::min(in_size * 4, size_t(GZ_INFLATE_BLOCK))) + 1);
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit2(&zs, 15 + 16) != Z_OK)
+		log_cmd_error("Can't initialize zlib for gzip file `%s'.\n", filename.c_str());
+
+	while (1)
+	{
+		if (written == out.size())
+			out.resize(out.size() * 2);
+		if (zs.avail_in == 0 && in_pos < in_size) {
+			zs.next_in = (Bytef*)(in + in_pos);
+			zs.avail_in = uInt(std::min(in_size - in_pos, size_t(1) << 30));
+			in_pos += zs.avail_in;
+		}
+
+		zs.next_out = (Bytef*)&out[written];
+		zs.avail_out = uInt(std::min(out.size() - written, size_t(1) << 30));
+		uInt avail_out = zs.avail_out;
+		int ret = inflate(&zs, Z_NO_FLUSH);
+		written += avail_out - zs.avail_out;
+
+		if (ret == Z_STREAM_END) {
+			// another member follows, unless only padding is left
+			if (zs.avail_in == 0 && in_pos < in_size) {
+				zs.next_in = (Bytef*)(in + in_pos);
+				zs.avail_in = uInt(std::min(in_size - in_pos, size_t(1) << 30));
+				in_pos += zs.avail_in;
+			}
+			if (zs.avail_in < 2 || zs.next_in[0] != 0x1f || zs.next_in[1] != 0x8b)
+				break;
+			inflateReset(&zs);
+			continue;
+		}
+
+		if (ret == Z_BUF_ERROR && zs.avail_in == 0 && in_pos == in_size)
+			log_cmd_error("Gzip file `%s' is truncated.\n", filename.c_str());
+		if (ret != Z_OK && ret != Z_BUF_ERROR)
+			log_cmd_error("Error while decompressing gzip file `%s': %s\n", filename.c_str(), zs.msg ? zs.msg : "corrupt data");
 	}
-	gzclose(gzf);
+
+	inflateEnd(&zs);
+	out.resize(written);
+	return out;
 }
 
 /*
-An output stream that uses a stringbuf to buffer data internally,
-using zlib to write gzip-compressed data every time the stream is flushed.
+An output stream that compresses its data with zlib as it is written, through
+a fixed-size buffer, so that the uncompressed output never has to be held in
+memory as a whole.
 */
 class gzip_ostream : public std::ostream  {
 public:
@@ -58,9 +153,12 @@ public:
 		return outbuf.open(filename);
 	}
 private:
-	class gzip_streambuf : public std::stringbuf {
+	class gzip_streambuf : public std::streambuf {
 	public:
-		gzip_streambuf() { };
+		gzip_streambuf()
+		{
+			setp(buffer, buffer + sizeof(buffer));
+		}
 		bool open(const std::string &filename)
 		{
 			gzf = gzopen(filename.c_str(), "wb");
@@ -68,17 +166,41 @@ private:
 		}
 		virtual int sync() override
 		{
-			gzwrite(gzf, reinterpret_cast<const void *>(str().c_str()), unsigned(str().size()));
-			str("");
+			int size = int(pptr() - pbase());
+			if (size > 0 && gzwrite(gzf, pbase(), unsigned(size)) != size)
+				return -1;
+			setp(buffer, buffer + sizeof(buffer));
 			return 0;
 		}
+		virtual int_type overflow(int_type c) override
+		{
+			if (sync() != 0)
+				return traits_type::eof();
+			if (!traits_type::eq_int_type(c, traits_type::eof())) {
+				*pptr() = traits_type::to_char_type(c);
+				pbump(1);
+			}
+			return traits_type::not_eof(c);
+		}
+		virtual std::streamsize xsputn(const char *s, std::streamsize n) override
+		{
+			// large blocks, like whole modules from write_rtlil, bypass the buffer
+			if (n < epptr() - pptr())
+				return std::streambuf::xsputn(s, n);
+			if (sync() != 0 || gzwrite(gzf, s, unsigned(n)) != n)
+				return 0;
+			return n;
+		}
 		virtual ~gzip_streambuf()
 		{
+			if (gzf == nullptr)
+				return;
 			sync();
 			gzclose(gzf);
 		}
 	private:
 		gzFile gzf = nullptr;
+		char buffer[GZ_BUFFER_SIZE * 8];
 	} outbuf;
 };
 PRIVATE_NAMESPACE_END
@@ -138,20 +260,38 @@ void Pass::run_register()
 
 void Pass::init_register()
 {
-	vector<Pass*> added_passes;
 	while (first_queued_pass) {
-		added_passes.push_back(first_queued_pass);
 		first_queued_pass->run_register();
 		first_queued_pass = first_queued_pass->next_queued_pass;
 	}
-	for (auto added_pass : added_passes)
-		added_pass->on_register();
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex on_register_mutex;
+#endif
+
+void Pass::ensure_registered()
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(on_register_mutex);
+#endif
+	if (registered)
+		return;
+	registered = true;
+	on_register();
+}
+
+void Pass::ensure_all_registered()
+{
+	for (auto &it : pass_register)
+		it.second->ensure_registered();
 }
 
 void Pass::done_register()
 {
 	for (auto &it : pass_register)
-		it.second->on_shutdown();
+		if (it.second->registered)
+			it.second->on_shutdown();
 
 	frontend_register.clear();
 	pass_register.clear();
@@ -171,14 +311,273 @@ Pass::~Pass()
 {
 }
 
+static int pass_depth = 0;
+
+static int64_t wall_time_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t peak_rss_kb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return int64_t(pmc.PeakWorkingSetSize / 1024);
+	return 0;
+#elif defined(__linux__) || defined(__FreeBSD__)
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return int64_t(ru.ru_maxrss);
+#else
+	return 0;
+#endif
+}
+
+int64_t current_rss_kb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return int64_t(pmc.WorkingSetSize / 1024);
+	return 0;
+#elif defined(__linux__)
+	long pages_total = 0, pages_resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f == nullptr)
+		return 0;
+	if (fscanf(f, "%ld %ld", &pages_total, &pages_resident) != 2)
+		pages_resident = 0;
+	fclose(f);
+	return int64_t(pages_resident) * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+	return 0;
+#endif
+}
+
+bool Pass::memory_accounting = false;
+
+static bool memory_tracked()
+{
+	return Pass::memory_accounting || Common::g_father_process_id != "-1";
+}
+
+// Counts the objects of the current design. Walks modules_ directly so that
+// modules shared with saved designs are not copied just to be counted.
+static Pass::mem_census_t memory_census()
+{
+	Pass::mem_census_t census;
+	census.idstrings = RTLIL::IdString::live_count();
+
+	RTLIL::Design *design = yosys_get_design();
+	if (design == nullptr)
+		return census;
+
+	auto count_attrs = [&](const dict<RTLIL::IdString, RTLIL::Const> &attrs) {
+		for (auto &it : attrs)
+			census.const_bytes += it.second.memory_usage();
+	};
+
+	for (auto &mod_it : design->modules_) {
+		// not via modules(), which would unshare every module just to count it
+		const RTLIL::Module *module = mod_it.second->shared_contents();
+		census.modules++;
+		count_attrs(mod_it.second->attributes);
+		count_attrs(module->parameter_default_values);
+		for (auto &it : module->wires_) {
+			census.wires++;
+			count_attrs(it.second->attributes);
+		}
+		for (auto &it : module->cells_) {
+			census.cells++;
+			count_attrs(it.second->attributes);
+			count_attrs(it.second->parameters);
+			for (auto &conn : it.second->connections())
+				census.sigspec_bytes += conn.second.memory_usage();
+		}
+		for (auto &conn : module->connections()) {
+			census.sigspec_bytes += conn.first.memory_usage();
+			census.sigspec_bytes += conn.second.memory_usage();
+		}
+	}
+	return census;
+}
+
+static Pass::mem_census_t census_diff(const Pass::mem_census_t &a, const Pass::mem_census_t &b)
+{
+	Pass::mem_census_t diff;
+	diff.modules = a.modules - b.modules;
+	diff.idstrings = a.idstrings - b.idstrings;
+	diff.cells = a.cells - b.cells;
+	diff.wires = a.wires - b.wires;
+	diff.sigspec_bytes = a.sigspec_bytes - b.sigspec_bytes;
+	diff.const_bytes = a.const_bytes - b.const_bytes;
+	return diff;
+}
+
+static void census_add(Pass::mem_census_t &sum, const Pass::mem_census_t &delta, int sign)
+{
+	sum.modules += sign * delta.modules;
+	sum.idstrings += sign * delta.idstrings;
+	sum.cells += sign * delta.cells;
+	sum.wires += sign * delta.wires;
+	sum.sigspec_bytes += sign * delta.sigspec_bytes;
+	sum.const_bytes += sign * delta.const_bytes;
+}
+
+// Streams a pass_begin/pass_end event over the DATA pipe so the parent
+// process can follow the pass nesting while the script is running.
+static void send_pass_telemetry(const char *event, Pass *pass, const Pass::pre_post_exec_state_t &state,
+		int64_t cpu_ns, int64_t wall_ns, int64_t peak_kb, int64_t rss_kb, const Pass::mem_census_t &census)
+{
+	nlohmann::json data;
+	data["event"] = event;
+	data["pass"] = pass->pass_name;
+	data["depth"] = state.depth;
+	data["cpu_ns"] = cpu_ns;
+	data["wall_ns"] = wall_ns;
+	data["peak_rss_kb"] = peak_kb;
+	data["peak_rss_delta_kb"] = peak_kb - state.begin_peak_rss_kb;
+	data["rss_kb"] = rss_kb;
+	data["rss_delta_kb"] = rss_kb - state.begin_rss_kb;
+	data["sigspec_packs"] = RTLIL::SigSpec::pack_counter - state.begin_pack_count;
+	data["sigspec_unpacks"] = RTLIL::SigSpec::unpack_counter - state.begin_unpack_count;
+	data["modindex_reloads"] = ModIndex::reload_counter - state.begin_modindex_reloads;
+
+	data["sat_solves"] = ezSAT::solverTotals.solves - state.begin_sat_solves;
+	data["sat_conflicts"] = ezSAT::solverTotals.conflicts - state.begin_sat_conflicts;
+	data["sat_decisions"] = ezSAT::solverTotals.decisions - state.begin_sat_decisions;
+	data["sat_propagations"] = ezSAT::solverTotals.propagations - state.begin_sat_propagations;
+	data["sat_gc_ns"] = ezSAT::solverTotals.gc_ns - state.begin_sat_gc_ns;
+	data["sat_arena_bytes"] = ezSAT::solverTotals.arena_bytes.load();
+
+	data["modules"] = census.modules;
+	data["idstrings"] = census.idstrings;
+	data["cells"] = census.cells;
+	data["wires"] = census.wires;
+	data["sigspec_bytes"] = census.sigspec_bytes;
+	data["const_bytes"] = census.const_bytes;
+
+#ifdef YOSYS_KERNEL_COUNTERS
+	kernel_counters::snapshot_t counts = kernel_counters::snapshot();
+	for (int i = 0; i < kernel_counters::NUM_COUNTERS; i++)
+		data["kernel"][kernel_counters::names[i]] = counts[i] - state.begin_kernel_counts[i];
+#endif
+
+	Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "PASS_TELEMETRY"));
+}
+
+#ifdef YOSYS_HASHLIB_STATS
+static std::map<const hashlib::stats_site*, hashlib::stats_counts> hashlib_stats_snapshot()
+{
+	std::map<const hashlib::stats_site*, hashlib::stats_counts> snapshot;
+	for (auto site = hashlib::stats_site::list().load(); site != nullptr; site = site->next)
+		snapshot[site] = site->counts();
+	return snapshot;
+}
+
+// Reduces the signature of dict<>::stats() / pool<>::stats() to the
+// container kind and its template arguments.
+static std::string hashlib_site_name(const char *signature)
+{
+	std::string str = signature;
+	std::string kind = str.find("hashlib::pool<") != std::string::npos ? "pool" : "dict";
+
+	size_t pos = str.find("[with ");
+	if (pos != std::string::npos)
+		return kind + " [" + str.substr(pos + 6, str.size() - pos - 7) + "]";
+
+	pos = str.find("hashlib::" + kind + "<");
+	size_t end = str.rfind("::stats");
+	if (pos != std::string::npos && end != std::string::npos && end > pos)
+		return str.substr(pos + 9, end - pos - 9);
+	return str;
+}
+
+// Prints the containers with the most key compares during this pass,
+// including nested passes.
+static void report_hashlib_stats(Pass *pass, const std::map<const hashlib::stats_site*, hashlib::stats_counts> &begin)
+{
+	std::vector<std::pair<const hashlib::stats_site*, hashlib::stats_counts>> rows;
+	for (auto site = hashlib::stats_site::list().load(); site != nullptr; site = site->next) {
+		hashlib::stats_counts delta = site->counts();
+		auto it = begin.find(site);
+		if (it != begin.end()) {
+			delta.lookups -= it->second.lookups;
+			delta.compares -= it->second.compares;
+			delta.rehashes -= it->second.rehashes;
+		}
+		if (delta.lookups != 0 || delta.rehashes != 0)
+			rows.push_back(std::make_pair(site, delta));
+	}
+
+	if (rows.empty())
+		return;
+
+	std::sort(rows.begin(), rows.end(), [](const std::pair<const hashlib::stats_site*, hashlib::stats_counts> &a,
+			const std::pair<const hashlib::stats_site*, hashlib::stats_counts> &b) {
+		return a.second.compares > b.second.compares;
+	});
+
+	int num_rows = std::min(GetSize(rows), 10);
+	log("\nHashlib statistics for `%s' (top %d of %d containers by key compares):\n", pass->pass_name.c_str(), num_rows, GetSize(rows));
+	log("  %12s %12s %8s %9s %10s  %s\n", "lookups", "compares", "cmp/lkp", "rehashes", "peak size", "container");
+	for (int i = 0; i < num_rows; i++) {
+		const hashlib::stats_counts &c = rows[i].second;
+		log("  %12llu %12llu %8.2f %9llu %10llu  %s\n", (unsigned long long)c.lookups, (unsigned long long)c.compares,
+				c.lookups ? double(c.compares) / c.lookups : 0.0, (unsigned long long)c.rehashes,
+				(unsigned long long)c.peak_size, hashlib_site_name(rows[i].first->name).c_str());
+	}
+}
+#endif
+
 Pass::pre_post_exec_state_t Pass::pre_execute()
 {
+	log_check_interrupt(pass_name.c_str());
+	ensure_registered();
+
 	pre_post_exec_state_t state;
 	call_counter++;
 	state.begin_ns = PerformanceTimer::query();
+	state.begin_pack_count = RTLIL::SigSpec::pack_counter;
+	state.begin_unpack_count = RTLIL::SigSpec::unpack_counter;
+	state.begin_modindex_reloads = ModIndex::reload_counter;
+	state.begin_sat_solves = ezSAT::solverTotals.solves;
+	state.begin_sat_conflicts = ezSAT::solverTotals.conflicts;
+	state.begin_sat_decisions = ezSAT::solverTotals.decisions;
+	state.begin_sat_propagations = ezSAT::solverTotals.propagations;
+	state.begin_sat_gc_ns = ezSAT::solverTotals.gc_ns;
 	state.parent_pass = current_pass;
+	state.depth = pass_depth++;
 	current_pass = this;
 	clear_flags();
+
+#ifdef YOSYS_HASHLIB_STATS
+	state.begin_hashlib_stats = hashlib_stats_snapshot();
+#endif
+#ifdef YOSYS_KERNEL_COUNTERS
+	state.begin_kernel_counts = kernel_counters::snapshot();
+#endif
+
+	if (memory_tracked()) {
+		state.begin_peak_rss_kb = peak_rss_kb();
+		state.begin_rss_kb = current_rss_kb();
+		state.begin_census = memory_census();
+	} else {
+		state.begin_peak_rss_kb = 0;
+		state.begin_rss_kb = 0;
+	}
+
+	if (trace_enabled())
+		trace_begin(dynamic_cast<Frontend*>(this) ? "frontend" : dynamic_cast<Backend*>(this) ? "backend" : "pass", pass_name);
+
+	if (Common::g_father_process_id != "-1") {
+		state.begin_wall_ns = wall_time_ns();
+		send_pass_telemetry("pass_begin", this, state, 0, 0, state.begin_peak_rss_kb, state.begin_rss_kb, state.begin_census);
+	} else {
+		state.begin_wall_ns = 0;
+	}
 	return state;
 }
 
@@ -189,9 +588,55 @@ void Pass::post_execute(Pass::pre_post_exec_state_t state)
 
 	int64_t time_ns = PerformanceTimer::query() - state.begin_ns;
 	runtime_ns += time_ns;
+	int64_t packs = RTLIL::SigSpec::pack_counter - state.begin_pack_count;
+	int64_t unpacks = RTLIL::SigSpec::unpack_counter - state.begin_unpack_count;
+	sigspec_pack_count += packs;
+	sigspec_unpack_count += unpacks;
+	int64_t reloads = ModIndex::reload_counter - state.begin_modindex_reloads;
+	modindex_reload_count += reloads;
+
+	int64_t end_peak_kb = 0, end_rss_kb = 0;
+	mem_census_t end_census, census;
+	if (memory_tracked()) {
+		end_peak_kb = peak_rss_kb();
+		end_rss_kb = current_rss_kb();
+		end_census = memory_census();
+		census = census_diff(end_census, state.begin_census);
+		peak_rss_delta_kb = std::max(peak_rss_delta_kb, end_peak_kb - state.begin_peak_rss_kb);
+		rss_delta_kb += end_rss_kb - state.begin_rss_kb;
+		census_add(census_delta, census, +1);
+	}
+
 	current_pass = state.parent_pass;
-	if (current_pass)
+	if (current_pass) {
 		current_pass->runtime_ns -= time_ns;
+		current_pass->sigspec_pack_count -= packs;
+		current_pass->sigspec_unpack_count -= unpacks;
+		current_pass->modindex_reload_count -= reloads;
+		current_pass->rss_delta_kb -= end_rss_kb - state.begin_rss_kb;
+		census_add(current_pass->census_delta, census, -1);
+	}
+
+#ifdef YOSYS_KERNEL_COUNTERS
+	kernel_counters::snapshot_t end_kernel_counts = kernel_counters::snapshot();
+	for (int i = 0; i < kernel_counters::NUM_COUNTERS; i++) {
+		int64_t delta = end_kernel_counts[i] - state.begin_kernel_counts[i];
+		kernel_counts[i] += delta;
+		if (current_pass)
+			current_pass->kernel_counts[i] -= delta;
+	}
+#endif
+	pass_depth = state.depth;
+
+#ifdef YOSYS_HASHLIB_STATS
+	report_hashlib_stats(this, state.begin_hashlib_stats);
+#endif
+
+	if (trace_enabled())
+		trace_end();
+
+	if (Common::g_father_process_id != "-1")
+		send_pass_telemetry("pass_end", this, state, time_ns, wall_time_ns() - state.begin_wall_ns, end_peak_kb, end_rss_kb, end_census);
 }
 
 void Pass::help()
@@ -337,6 +782,12 @@ void Pass::call(RTLIL::Design *design, std::vector<std::string> args)
 
 	size_t orig_sel_stack_pos = design->selection_stack.size();
 	auto state = pass_register[args[0]]->pre_execute();
+	if (trace_enabled()) {
+		std::string command;
+		for (size_t i = 0; i < args.size(); i++)
+			command += (i ? " " : "") + args[i];
+		trace_annotate("command", command);
+	}
 	pass_register[args[0]]->execute(args, design);
 	pass_register[args[0]]->post_execute(state);
 	while (design->selection_stack.size() > orig_sel_stack_pos)
@@ -403,6 +854,7 @@ bool ScriptPass::check_label(std::string label, std::string info)
 			log("    %s:    %s\n", label.c_str(), info.c_str());
 		return true;
 	} else {
+		end_label_profile();
 		if (!active_run_from.empty() && active_run_from == active_run_to) {
 			block_active = (label == active_run_from);
 		} else {
@@ -411,6 +863,23 @@ bool ScriptPass::check_label(std::string label, std::string info)
 			if (label == active_run_to)
 				block_active = false;
 		}
+		if (trace_label_open) {
+			trace_end();
+			trace_label_open = false;
+		}
+		if (block_active && trace_enabled()) {
+			trace_begin("label", pass_name + ": " + label);
+			trace_label_open = true;
+		}
+		if (block_active && !checkpoint_dir.empty()) {
+			if (checkpoint_resume && label == active_run_from) {
+				read_checkpoint(label);
+				checkpoint_resume = false;
+			} else
+				write_checkpoint(label);
+		}
+		if (block_active)
+			begin_label_profile(label);
 		return block_active;
 	}
 }
@@ -459,7 +928,195 @@ void ScriptPass::run_script(RTLIL::Design *design, std::string run_from, std::st
 	block_active = run_from.empty();
 	active_run_from = run_from;
 	active_run_to = run_to;
+	label_profiles.clear();
+
+	// the checkpoint options only apply to this run, and the techmap cache
+	// set up for it is dropped again, also when a pass of the script fails
+	struct RunScope {
+		ScriptPass *pass;
+		bool own_techmap_cache = false;
+		~RunScope() {
+			if (own_techmap_cache) {
+#ifdef _WIN32
+				_putenv_s("YOSYS_TECHMAP_CACHE", "");
+#else
+				unsetenv("YOSYS_TECHMAP_CACHE");
+#endif
+			}
+			pass->checkpoint_dir.clear();
+			pass->checkpoint_resume = false;
+			pass->profile_labels = false;
+		}
+	} run_scope{this};
+
+	if (checkpoint_resume && (checkpoint_dir.empty() || run_from.empty()))
+		log_cmd_error("Option -resume requires -checkpoint <dir> and -run <from_label>.\n");
+
+	// map libraries loaded by techmap are kept next to the snapshots, unless
+	// the user already has a cache directory of their own
+	if (!checkpoint_dir.empty()) {
+		if (!create_directory(checkpoint_dir))
+			log_cmd_error("Can't create checkpoint directory `%s'.\n", checkpoint_dir.c_str());
+		const char *cache_dir = getenv("YOSYS_TECHMAP_CACHE");
+		if (cache_dir == nullptr || cache_dir[0] == 0) {
+			std::string techmap_dir = checkpoint_dir + "/techmap";
+			if (create_directory(techmap_dir)) {
+#ifdef _WIN32
+				_putenv_s("YOSYS_TECHMAP_CACHE", techmap_dir.c_str());
+#else
+				setenv("YOSYS_TECHMAP_CACHE", techmap_dir.c_str(), 1);
+#endif
+				run_scope.own_techmap_cache = true;
+			}
+		}
+	}
+
 	script();
+	end_label_profile();
+	if (trace_label_open) {
+		trace_end();
+		trace_label_open = false;
+	}
+	report_label_profiles();
+
+	if (checkpoint_resume)
+		log_cmd_error("Label `%s' not found, nothing was resumed.\n", run_from.c_str());
+}
+
+// A checkpoint holds the design as it is at the start of a label: a binary
+// RTLIL snapshot in <dir>/<label>.ilb and the scratchpad in <dir>/<label>.sp,
+// the latter as "<key size> <value size>" lines followed by the raw strings.
+void ScriptPass::write_checkpoint(std::string label)
+{
+	std::string filename = checkpoint_dir + "/" + label + ".ilb";
+	log("Writing checkpoint for label `%s' to `%s'.\n", label.c_str(), filename.c_str());
+
+	// written under a temporary name first, so that an interrupted run
+	// never leaves a truncated snapshot behind for -resume
+	std::string tmp_filename = filename + ".tmp";
+	std::ofstream f(tmp_filename.c_str(), std::ofstream::binary);
+	if (f.fail())
+		log_cmd_error("Can't open checkpoint file `%s' for writing: %s\n", tmp_filename.c_str(), strerror(errno));
+	RTLIL_BACKEND::dump_design_binary(f, active_design, false);
+	f.close();
+	if (f.fail() || rename(tmp_filename.c_str(), filename.c_str()) != 0)
+		log_cmd_error("Can't write checkpoint file `%s'.\n", filename.c_str());
+
+	std::string sp_filename = checkpoint_dir + "/" + label + ".sp";
+	std::ofstream sp(sp_filename.c_str(), std::ofstream::binary);
+	if (sp.fail())
+		log_cmd_error("Can't open checkpoint file `%s' for writing: %s\n", sp_filename.c_str(), strerror(errno));
+	for (auto &it : active_design->scratchpad)
+		sp << it.first.size() << " " << it.second.size() << "\n" << it.first << it.second;
+	sp.close();
+	if (sp.fail())
+		log_cmd_error("Can't write checkpoint file `%s'.\n", sp_filename.c_str());
+}
+
+void ScriptPass::read_checkpoint(std::string label)
+{
+	std::string filename = checkpoint_dir + "/" + label + ".ilb";
+	std::ifstream f(filename.c_str(), std::ifstream::binary);
+	if (f.fail())
+		log_cmd_error("Can't open checkpoint file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+	log("Resuming at label `%s' from checkpoint `%s'.\n", label.c_str(), filename.c_str());
+
+	// not via modules(), which would unshare what is about to be dropped
+	std::vector<RTLIL::Module*> old_modules;
+	for (auto &it : active_design->modules_)
+		old_modules.push_back(it.second);
+	for (auto mod : old_modules)
+		active_design->remove(mod);
+	active_design->selection_stack.clear();
+	active_design->selection_vars.clear();
+	active_design->selected_active_module.clear();
+	active_design->selection_stack.push_back(RTLIL::Selection());
+
+	RTLIL_FRONTEND::read_design_binary(&f, filename, active_design, pool<RTLIL::IdString>());
+
+	std::string sp_filename = checkpoint_dir + "/" + label + ".sp";
+	std::ifstream sp(sp_filename.c_str(), std::ifstream::binary);
+	if (sp.fail())
+		log_cmd_error("Can't open checkpoint file `%s' for reading: %s\n", sp_filename.c_str(), strerror(errno));
+	active_design->scratchpad.clear();
+	size_t key_size, value_size;
+	while (sp >> key_size >> value_size) {
+		sp.get();
+		std::string key(key_size, 0), value(value_size, 0);
+		sp.read(&key[0], key_size);
+		sp.read(&value[0], value_size);
+		if (sp.fail())
+			log_cmd_error("Checkpoint file `%s' is truncated.\n", sp_filename.c_str());
+		active_design->scratchpad[key] = value;
+	}
+	active_design->check();
+}
+
+static int64_t design_cell_count(RTLIL::Design *design)
+{
+	int64_t count = 0;
+	for (auto &it : design->modules_)
+		count += GetSize(it.second->shared_contents()->cells_);
+	return count;
+}
+
+void ScriptPass::begin_label_profile(std::string label)
+{
+	label_profile_t profile;
+	profile.label = label;
+	profile.begin_cpu_ns = PerformanceTimer::query();
+	profile.begin_wall_ns = wall_time_ns();
+	profile.begin_peak_rss_kb = peak_rss_kb();
+	profile.begin_cells = design_cell_count(active_design);
+	profile.cpu_ns = -1;
+	label_profiles.push_back(profile);
+}
+
+// Closes the profile of the label that is still open, if any, and sends it
+// as a LABEL_PROFILE record over the DATA pipe.
+void ScriptPass::end_label_profile()
+{
+	if (label_profiles.empty() || label_profiles.back().cpu_ns >= 0)
+		return;
+
+	label_profile_t &profile = label_profiles.back();
+	profile.cpu_ns = PerformanceTimer::query() - profile.begin_cpu_ns;
+	profile.wall_ns = wall_time_ns() - profile.begin_wall_ns;
+	profile.peak_rss_kb = peak_rss_kb();
+	profile.cells = design_cell_count(active_design);
+
+	if (Common::g_father_process_id != "-1") {
+		nlohmann::json data;
+		data["pass"] = pass_name;
+		data["label"] = profile.label;
+		data["cpu_ns"] = profile.cpu_ns;
+		data["wall_ns"] = profile.wall_ns;
+		data["peak_rss_kb"] = profile.peak_rss_kb;
+		data["peak_rss_delta_kb"] = profile.peak_rss_kb - profile.begin_peak_rss_kb;
+		data["cells"] = profile.cells;
+		data["cells_delta"] = profile.cells - profile.begin_cells;
+		Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "LABEL_PROFILE"));
+	}
+}
+
+void ScriptPass::report_label_profiles()
+{
+	if (!profile_labels || label_profiles.empty())
+		return;
+
+	int64_t total_wall_ns = 0;
+	for (auto &profile : label_profiles)
+		total_wall_ns += profile.wall_ns;
+
+	log("\nResources used per label of %s:\n", pass_name.c_str());
+	log("%-20s %10s %5s %10s %10s %10s %10s %10s\n", "label", "wall sec", "%", "CPU sec",
+			"peak MB", "+peak MB", "cells", "+cells");
+	for (auto &profile : label_profiles)
+		log("%-20s %10.3f %4d%% %10.3f %10.2f %10.2f %10lld %+10lld\n", profile.label.c_str(),
+				profile.wall_ns / 1e9, total_wall_ns ? int(100 * profile.wall_ns / total_wall_ns) : 0,
+				profile.cpu_ns / 1e9, profile.peak_rss_kb / 1024.0,
+				(profile.peak_rss_kb - profile.begin_peak_rss_kb) / 1024.0,
+				(long long)profile.cells, (long long)(profile.cells - profile.begin_cells));
 }
 
 void ScriptPass::help_script()
@@ -566,6 +1223,7 @@ void Frontend::extra_args(std::istream *&f, std::string &filename, std::vector<s
 			std::ifstream *ff = new std::ifstream;
 			ff->open(filename.c_str(), bin_input ? std::ifstream::binary : std::ifstream::in);
 			yosys_input_files.insert(filename);
+			trace_annotate("file", filename);
 			if (ff->fail()) {
 				delete ff;
 				ff = nullptr;
@@ -649,9 +1307,7 @@ void Frontend::extra_args(std::istream *&f, std::string &filename, std::vector<s
 						log_cmd_error("gzip file `%s' uses unsupported compression type %02x\n",
 							filename.c_str(), unsigned(magic[2]));
 					delete ff;
-					std::stringstream *df = new std::stringstream();
-					decompress_gzip(filename, *df);
-					f = df;
+					f = new MemoryIStream(decompress_gzip(filename));
 	#else
 					log_cmd_error("File `%s' is a gzip file, but Yosys is compiled without zlib.\n", filename.c_str());
 	#endif
@@ -1068,6 +1724,7 @@ struct HelpPass : public Pass {
 					for (size_t i = 0; i < it.first.size() + it.second->short_help.size() + 6; i++)
 						log("=");
 					log("\n");
+					it.second->ensure_registered();
 					it.second->help();
 					if (it.second->experimental_flag) {
 						log("\n");
@@ -1093,6 +1750,7 @@ struct HelpPass : public Pass {
 				for (auto &it : pass_register) {
 					std::ostringstream buf;
 					log_streams.push_back(&buf);
+					it.second->ensure_registered();
 					it.second->help();
 					if (it.second->experimental_flag) {
 						log("\n");
@@ -1104,6 +1762,7 @@ struct HelpPass : public Pass {
 				}
 			}
 			else if (pass_register.count(args[1])) {
+				pass_register.at(args[1])->ensure_registered();
 				pass_register.at(args[1])->help();
 				if (pass_register.at(args[1])->experimental_flag) {
 					log("\n");
@@ -1174,6 +1833,13 @@ struct MinisatSatSolver : public SatSolver {
 	}
 } MinisatSatSolver;
 
+struct MinisatPortfolioSatSolver : public SatSolver {
+	MinisatPortfolioSatSolver() : SatSolver("minisat-portfolio") { }
+	ezSAT *create() override {
+		return new ezMiniSATPortfolio();
+	}
+} MinisatPortfolioSatSolver;
+
 struct LicensePass : public Pass {
 	LicensePass() : Pass("license", "print license terms") { }
 	void help() override
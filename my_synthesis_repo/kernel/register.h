@@ -39,8 +39,34 @@ struct Pass
 
 	int call_counter;
 	int64_t runtime_ns;
+	int64_t sigspec_pack_count = 0;
+	int64_t sigspec_unpack_count = 0;
+	int64_t modindex_reload_count = 0;
 	bool experimental_flag = false;
 
+	// object census of the current design, see memory_accounting
+	struct mem_census_t {
+		int64_t modules = 0;
+		int64_t idstrings = 0;
+		int64_t cells = 0;
+		int64_t wires = 0;
+		int64_t sigspec_bytes = 0;
+		int64_t const_bytes = 0;
+	};
+
+	// collected when memory_accounting is set (driver option -mem); peak_rss_delta_kb
+	// is the largest peak RSS growth of one call including nested passes, the other
+	// values are summed over all calls with nested passes subtracted like runtime_ns
+	static bool memory_accounting;
+	int64_t peak_rss_delta_kb = 0;
+	int64_t rss_delta_kb = 0;
+	mem_census_t census_delta;
+
+#ifdef YOSYS_KERNEL_COUNTERS
+	// kernel_counters events of this pass, nested passes subtracted
+	kernel_counters::snapshot_t kernel_counts = kernel_counters::snapshot_t(kernel_counters::NUM_COUNTERS);
+#endif
+
 	void experimental() {
 		experimental_flag = true;
 	}
@@ -48,6 +74,21 @@ struct Pass
 	struct pre_post_exec_state_t {
 		Pass *parent_pass;
 		int64_t begin_ns;
+		int64_t begin_wall_ns;
+		int64_t begin_peak_rss_kb;
+		int64_t begin_rss_kb;
+		mem_census_t begin_census;
+		int64_t begin_pack_count;
+		int64_t begin_unpack_count;
+		int64_t begin_modindex_reloads;
+		int64_t begin_sat_solves, begin_sat_conflicts, begin_sat_decisions, begin_sat_propagations, begin_sat_gc_ns;
+		int depth;
+#ifdef YOSYS_HASHLIB_STATS
+		std::map<const hashlib::stats_site*, hashlib::stats_counts> begin_hashlib_stats;
+#endif
+#ifdef YOSYS_KERNEL_COUNTERS
+		kernel_counters::snapshot_t begin_kernel_counts;
+#endif
 	};
 
 	pre_post_exec_state_t pre_execute();
@@ -71,9 +112,19 @@ struct Pass
 	static void init_register();
 	static void done_register();
 
+	// on_register() is not called at startup but on the first use of the
+	// pass (an execution or its help message), so that passes can set up
+	// defaults such as RTLIL::constpad entries without slowing down every
+	// invocation of the synthesizer
 	virtual void on_register();
 	virtual void on_shutdown();
 	virtual bool replace_existing_pass() const { return false; }
+
+	bool registered = false;
+	void ensure_registered();
+	// runs the on_register() hooks of all passes, for code that reads state
+	// set up by them without knowing which pass owns it
+	static void ensure_all_registered();
 };
 
 struct ScriptPass : Pass
@@ -81,6 +132,23 @@ struct ScriptPass : Pass
 	bool block_active, help_mode;
 	RTLIL::Design *active_design;
 	std::string active_run_from, active_run_to;
+	bool trace_label_open = false;
+
+	// set by passes with -checkpoint <dir> and -resume before run_script()
+	std::string checkpoint_dir;
+	bool checkpoint_resume = false;
+
+	// resources used by each label of the last run_script(), the table is
+	// printed at the end of the script when profile_labels is set
+	struct label_profile_t {
+		std::string label;
+		int64_t begin_cpu_ns, cpu_ns;
+		int64_t begin_wall_ns, wall_ns;
+		int64_t begin_peak_rss_kb, peak_rss_kb;
+		int64_t begin_cells, cells;
+	};
+	std::vector<label_profile_t> label_profiles;
+	bool profile_labels = false;
 
 	ScriptPass(std::string name, std::string short_help = "** document me **") : Pass(name, short_help) { }
 
@@ -91,6 +159,11 @@ struct ScriptPass : Pass
 	void run_nocheck(std::string command, std::string info = std::string());
 	void run_script(RTLIL::Design *design, std::string run_from = std::string(), std::string run_to = std::string());
 	void help_script();
+	void write_checkpoint(std::string label);
+	void read_checkpoint(std::string label);
+	void begin_label_profile(std::string label);
+	void end_label_profile();
+	void report_label_profiles();
 };
 
 struct Frontend : Pass
@@ -140,6 +213,11 @@ extern void handle_extra_select_args(Pass *pass, const std::vector<std::string>
 extern RTLIL::Selection eval_select_args(const vector<string> &args, RTLIL::Design *design);
 extern void eval_select_op(vector<RTLIL::Selection> &work, const string &op, RTLIL::Design *design);
 
+// process memory in KiB, 0 where the platform does not report it
+extern int64_t peak_rss_kb();
+extern int64_t current_rss_kb();
+
+extern Pass *current_pass;
 extern std::map<std::string, Pass*> pass_register;
 extern std::map<std::string, Frontend*> frontend_register;
 extern std::map<std::string, Backend*> backend_register;
@@ -18,6 +18,8 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/arena.h"
+#include "kernel/mem.h"
 #include "kernel/macc.h"
 #include "kernel/celltypes.h"
 #include "kernel/binding.h"
@@ -32,12 +34,21 @@ YOSYS_NAMESPACE_BEGIN
 
 bool RTLIL::IdString::destruct_guard_ok = false;
 RTLIL::IdString::destruct_guard_t RTLIL::IdString::destruct_guard;
+#ifdef YOSYS_ENABLE_THREADS
+RTLIL::IdString::storage_pages_t<char*> RTLIL::IdString::global_id_storage_;
+RTLIL::IdString::storage_pages_t<std::atomic<int>> RTLIL::IdString::global_refcount_storage_;
+RTLIL::IdString::storage_pages_t<unsigned char> RTLIL::IdString::global_id_shard_;
+RTLIL::IdString::index_shard_t RTLIL::IdString::global_id_shards_[RTLIL::IdString::index_shard_count];
+std::vector<int> RTLIL::IdString::global_free_idx_list_;
+std::mutex RTLIL::IdString::global_id_alloc_mutex_;
+#else
 std::vector<char*> RTLIL::IdString::global_id_storage_;
 dict<char*, int, hash_cstr_ops> RTLIL::IdString::global_id_index_;
 #ifndef YOSYS_NO_IDS_REFCNT
 std::vector<int> RTLIL::IdString::global_refcount_storage_;
 std::vector<int> RTLIL::IdString::global_free_idx_list_;
 #endif
+#endif
 #ifdef YOSYS_USE_STICKY_IDS
 int RTLIL::IdString::last_created_idx_[8];
 int RTLIL::IdString::last_created_idx_ptr_;
@@ -49,6 +60,39 @@ int RTLIL::IdString::last_created_idx_ptr_;
 
 dict<std::string, std::string> RTLIL::constpad;
 
+RTLIL::SigSpec::counter_t RTLIL::SigSpec::pack_counter(0);
+RTLIL::SigSpec::counter_t RTLIL::SigSpec::unpack_counter(0);
+
+// Object hash indices are drawn from per-type xorshift sequences. Workers of
+// parallel_for_modules() and friends draw from their task's own sequence
+// (hashidx_local) instead, so that the hash indices, and with them the
+// iteration order of pools and dicts of objects, do not depend on how the
+// threads are scheduled.
+#ifdef YOSYS_ENABLE_THREADS
+typedef std::atomic<unsigned int> hashidx_counter_t;
+
+static unsigned int next_hashidx(hashidx_counter_t &counter)
+{
+	if (hashidx_local != nullptr)
+		return *hashidx_local = mkhash_xorshift(*hashidx_local);
+	unsigned int old_value = counter.load(std::memory_order_relaxed), new_value;
+	do
+		new_value = mkhash_xorshift(old_value);
+	while (!counter.compare_exchange_weak(old_value, new_value, std::memory_order_relaxed));
+	return new_value;
+}
+#else
+typedef unsigned int hashidx_counter_t;
+
+static unsigned int next_hashidx(hashidx_counter_t &counter)
+{
+	if (hashidx_local != nullptr)
+		return *hashidx_local = mkhash_xorshift(*hashidx_local);
+	counter = mkhash_xorshift(counter);
+	return counter;
+}
+#endif
+
 const pool<IdString> &RTLIL::builtin_ff_cell_types() {
 	static const pool<IdString> res = {
 		ID($sr),
@@ -554,10 +598,8 @@ bool RTLIL::Selection::selected_member(const RTLIL::IdString &mod_name, const RT
 		return true;
 	if (selected_modules.count(mod_name) > 0)
 		return true;
-	if (selected_members.count(mod_name) > 0)
-		if (selected_members.at(mod_name).count(memb_name) > 0)
-			return true;
-	return false;
+	auto it = selected_members.find(mod_name);
+	return it != selected_members.end() && it->second.count(memb_name) > 0;
 }
 
 void RTLIL::Selection::optimize(RTLIL::Design *design)
@@ -620,9 +662,8 @@ void RTLIL::Selection::optimize(RTLIL::Design *design)
 RTLIL::Design::Design()
   : verilog_defines (new define_map_t)
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 
 	refcount_modules_ = 0;
 	selection_stack.push_back(RTLIL::Selection());
@@ -635,7 +676,10 @@ RTLIL::Design::Design()
 RTLIL::Design::~Design()
 {
 	for (auto &pr : modules_)
-		delete pr.second;
+		if (!pr.second->sharers_.empty())
+			release_shared(pr.second);
+		else
+			delete pr.second;
 	for (auto n : bindings_)
 		delete n;
 	for (auto n : verilog_packages)
@@ -657,17 +701,25 @@ std::map<unsigned int, RTLIL::Design*> *RTLIL::Design::get_all_designs(void)
 
 RTLIL::ObjRange<RTLIL::Module*> RTLIL::Design::modules()
 {
+	unshare_modules();
 	return RTLIL::ObjRange<RTLIL::Module*>(&modules_, &refcount_modules_);
 }
 
 RTLIL::Module *RTLIL::Design::module(const RTLIL::IdString& name)
 {
-	return modules_.count(name) ? modules_.at(name) : NULL;
+	auto it = modules_.find(name);
+	return it != modules_.end() ? unshare_module(it->second) : NULL;
 }
 
 const RTLIL::Module *RTLIL::Design::module(const RTLIL::IdString& name) const
 {
-	return modules_.count(name) ? modules_.at(name) : NULL;
+	auto it = modules_.find(name);
+	if (it == modules_.end())
+		return NULL;
+	// copies from add_clone() have no contents until they are handed out
+	if (it->second->clone_source_ != nullptr)
+		unshare_module(it->second);
+	return it->second;
 }
 
 RTLIL::Module *RTLIL::Design::top_module()
@@ -701,6 +753,132 @@ void RTLIL::Design::add(RTLIL::Module *module)
 	}
 }
 
+// removes a holder from the sharers_ of a module
+static void drop_sharer(RTLIL::Module *module, RTLIL::Design *design, RTLIL::IdString name)
+{
+	auto &sharers = module->sharers_;
+	for (auto it = sharers.begin(); it != sharers.end(); ++it)
+		if (it->first == design && it->second == name) {
+			sharers.erase(it);
+			return;
+		}
+	log_abort();
+}
+
+// a shared module that left all designs is deleted with its last holder
+static void delete_if_orphaned(RTLIL::Module *module)
+{
+	if (module->design == nullptr && module->sharers_.empty())
+		delete module;
+}
+
+// replaces what a holder of a shared module holds with a private copy
+static void copy_for_sharer(const RTLIL::Module *module, RTLIL::Design *design, RTLIL::IdString name)
+{
+	RTLIL::Module *&held = design->modules_.at(name);
+
+	// the virtual clone() keeps frontend specific module types intact
+	RTLIL::Module *copy = module->clone();
+	copy->name = name;
+	copy->design = design;
+
+	if (held != module) {
+		// an empty copy from add_clone() keeps its own attributes
+		log_assert(held->clone_source_ == module);
+		copy->attributes = held->attributes;
+		held->clone_source_ = nullptr;
+		delete held;
+	}
+	held = copy;
+}
+
+void RTLIL::Design::add_shared(RTLIL::Module *module)
+{
+	// a copy that has no contents yet is shared through its original
+	if (module->clone_source_ != nullptr) {
+		add_clone(module, module->name);
+		return;
+	}
+
+	// design monitors expect to see every module of the design being added
+	if (!monitors.empty()) {
+		add(module->clone());
+		return;
+	}
+
+	log_assert(modules_.count(module->name) == 0);
+	log_assert(refcount_modules_ == 0);
+	modules_[module->name] = module;
+	module->sharers_.push_back({this, module->name});
+}
+
+RTLIL::Module *RTLIL::Design::add_clone(RTLIL::Module *module, RTLIL::IdString name)
+{
+	RTLIL::Module *source = module->clone_source_ != nullptr ? module->clone_source_ : module;
+	RTLIL::Module *copy;
+
+	// design monitors expect to see every module of the design being added
+	if (!monitors.empty()) {
+		copy = source->clone();
+	} else {
+		copy = new RTLIL::Module;
+		copy->clone_source_ = source;
+		source->sharers_.push_back({this, name});
+	}
+
+	copy->name = name;
+	copy->attributes = module->attributes;
+	add(copy);
+	return copy;
+}
+
+void RTLIL::Design::release_shared(RTLIL::Module *module)
+{
+	// the first remaining holder to unshare the module becomes its owner
+	if (module->design == this)
+		module->design = nullptr;
+	else
+		drop_sharer(module, this, module->name);
+	delete_if_orphaned(module);
+}
+
+void RTLIL::Design::unshare_modules()
+{
+	log_assert(refcount_modules_ == 0);
+	for (auto &it : modules_)
+		unshare_module(it.second);
+}
+
+RTLIL::Module *RTLIL::Design::unshare_module(RTLIL::Module *&module) const
+{
+	RTLIL::Design *self = const_cast<RTLIL::Design*>(this);
+
+	if (module->clone_source_ != nullptr) {
+		RTLIL::Module *source = module->clone_source_;
+		RTLIL::IdString name = module->name;
+		drop_sharer(source, self, name);
+		copy_for_sharer(source, self, name);
+		delete_if_orphaned(source);
+	} else if (!module->sharers_.empty()) {
+		if (module->design == nullptr)
+			module->design = self;
+		if (module->design == self) {
+			// the owner keeps the module, so pointers to it stay valid
+			auto sharers = std::move(module->sharers_);
+			module->sharers_.clear();
+			for (auto &it : sharers)
+				if (it.first != self || it.second != module->name)
+					copy_for_sharer(module, it.first, it.second);
+		} else {
+			drop_sharer(module, self, module->name);
+			copy_for_sharer(module, self, module->name);
+		}
+	}
+
+	module->design = self;
+	return module;
+}
+
 void RTLIL::Design::add(RTLIL::Binding *binding)
 {
 	log_assert(binding != nullptr);
@@ -807,11 +985,20 @@ void RTLIL::Design::remove(RTLIL::Module *module)
 	log_assert(modules_.at(module->name) == module);
 	log_assert(refcount_modules_ == 0);
 	modules_.erase(module->name);
-	delete module;
+	if (!module->sharers_.empty())
+		release_shared(module);
+	else
+		delete module;
 }
 
 void RTLIL::Design::rename(RTLIL::Module *module, RTLIL::IdString new_name)
 {
+	// the other holders of a shared module keep the old name
+	RTLIL::Module *&held = modules_.at(module->name);
+	log_assert(held == module);
+	unshare_module(held);
+	log_assert(held == module);
+
 	modules_.erase(module->name);
 	module->name = new_name;
 	add(module);
@@ -822,14 +1009,14 @@ void RTLIL::Design::sort()
 	scratchpad.sort();
 	modules_.sort(sort_by_id_str());
 	for (auto &it : modules_)
-		it.second->sort();
+		unshare_module(it.second)->sort();
 }
 
 void RTLIL::Design::check()
 {
 #ifndef NDEBUG
 	for (auto &it : modules_) {
-		log_assert(this == it.second->design);
+		log_assert(this == it.second->design || !it.second->sharers_.empty());
 		log_assert(it.first == it.second->name);
 		log_assert(!it.first.empty());
 		it.second->check();
@@ -840,7 +1027,7 @@ void RTLIL::Design::check()
 void RTLIL::Design::optimize()
 {
 	for (auto &it : modules_)
-		it.second->optimize();
+		unshare_module(it.second)->optimize();
 	for (auto &it : selection_stack)
 		it.optimize(this);
 	for (auto &it : selection_vars)
@@ -874,6 +1061,22 @@ bool RTLIL::Design::selected_member(const RTLIL::IdString& mod_name, const RTLIL
 	return selection_stack.back().selected_member(mod_name, memb_name);
 }
 
+const pool<RTLIL::IdString> *RTLIL::Design::selected_members_of(const RTLIL::IdString& mod_name) const
+{
+	static const pool<RTLIL::IdString> empty_pool;
+
+	if (!selected_active_module.empty() && mod_name != selected_active_module)
+		return &empty_pool;
+	if (selection_stack.size() == 0)
+		return nullptr;
+
+	const RTLIL::Selection &sel = selection_stack.back();
+	if (sel.full_selection || sel.selected_modules.count(mod_name) > 0)
+		return nullptr;
+	auto it = sel.selected_members.find(mod_name);
+	return it != sel.selected_members.end() ? &it->second : &empty_pool;
+}
+
 bool RTLIL::Design::selected_module(RTLIL::Module *mod) const
 {
 	return selected_module(mod->name);
@@ -886,33 +1089,36 @@ bool RTLIL::Design::selected_whole_module(RTLIL::Module *mod) const
 
 std::vector<RTLIL::Module*> RTLIL::Design::selected_modules() const
 {
+	KERNEL_COUNT(SELECTED_MODULES);
 	std::vector<RTLIL::Module*> result;
 	result.reserve(modules_.size());
 	for (auto &it : modules_)
 		if (selected_module(it.first) && !it.second->get_blackbox_attribute())
-			result.push_back(it.second);
+			result.push_back(unshare_module(it.second));
 	return result;
 }
 
 std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules() const
 {
+	KERNEL_COUNT(SELECTED_MODULES);
 	std::vector<RTLIL::Module*> result;
 	result.reserve(modules_.size());
 	for (auto &it : modules_)
 		if (selected_whole_module(it.first) && !it.second->get_blackbox_attribute())
-			result.push_back(it.second);
+			result.push_back(unshare_module(it.second));
 	return result;
 }
 
 std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules_warn(bool include_wb) const
 {
+	KERNEL_COUNT(SELECTED_MODULES);
 	std::vector<RTLIL::Module*> result;
 	result.reserve(modules_.size());
 	for (auto &it : modules_)
 		if (it.second->get_blackbox_attribute(include_wb))
 			continue;
 		else if (selected_whole_module(it.first))
-			result.push_back(it.second);
+			result.push_back(unshare_module(it.second));
 		else if (selected_module(it.first))
 			log_warning("Ignoring partially selected module %s.\n", log_id(it.first));
 	return result;
@@ -920,13 +1126,20 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules_warn(bool incl
 
 RTLIL::Module::Module()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 
 	design = nullptr;
 	refcount_wires_ = 0;
 	refcount_cells_ = 0;
+	clone_source_ = nullptr;
+	cell_arena_ = ObjectArena::create(sizeof(RTLIL::Cell));
+	wire_arena_ = ObjectArena::create(sizeof(RTLIL::Wire));
+	cached_modindex_ = nullptr;
+	cached_sigmap_ = nullptr;
+	cached_mems_ = nullptr;
+	cached_timing_ = nullptr;
+	generation_ = 0;
 
 #ifdef WITH_PYTHON
 	RTLIL::Module::get_all_modules()->insert(std::pair<unsigned int, RTLIL::Module*>(hashidx_, this));
@@ -935,6 +1148,14 @@ RTLIL::Module::Module()
 
 RTLIL::Module::~Module()
 {
+	if (clone_source_ != nullptr) {
+		drop_sharer(clone_source_, design, name);
+		delete_if_orphaned(clone_source_);
+	}
+	delete cached_modindex_;
+	delete cached_sigmap_;
+	delete cached_mems_;
+	delete cached_timing_;
 	for (auto &pr : wires_)
 		delete pr.second;
 	for (auto &pr : memories)
@@ -945,11 +1166,18 @@ RTLIL::Module::~Module()
 		delete pr.second;
 	for (auto binding : bindings_)
 		delete binding;
+	cell_arena_->release();
+	wire_arena_->release();
 #ifdef WITH_PYTHON
 	RTLIL::Module::get_all_modules()->erase(hashidx_);
 #endif
 }
 
+size_t RTLIL::Module::trim_storage()
+{
+	return cell_arena_->trim() + wire_arena_->trim();
+}
+
 #ifdef WITH_PYTHON
 static std::map<unsigned int, RTLIL::Module*> all_modules;
 std::map<unsigned int, RTLIL::Module*> *RTLIL::Module::get_all_modules(void)
@@ -2120,9 +2348,12 @@ bool RTLIL::Module::has_processes_warn() const
 std::vector<RTLIL::Wire*> RTLIL::Module::selected_wires() const
 {
 	std::vector<RTLIL::Wire*> result;
-	result.reserve(wires_.size());
+	const pool<RTLIL::IdString> *members = design->selected_members_of(name);
+	if (members != nullptr && members->empty())
+		return result;
+	result.reserve(members ? std::min(wires_.size(), members->size()) : wires_.size());
 	for (auto &it : wires_)
-		if (design->selected(this, it.second))
+		if (members == nullptr || members->count(it.first))
 			result.push_back(it.second);
 	return result;
 }
@@ -2130,9 +2361,12 @@ std::vector<RTLIL::Wire*> RTLIL::Module::selected_wires() const
 std::vector<RTLIL::Cell*> RTLIL::Module::selected_cells() const
 {
 	std::vector<RTLIL::Cell*> result;
-	result.reserve(cells_.size());
+	const pool<RTLIL::IdString> *members = design->selected_members_of(name);
+	if (members != nullptr && members->empty())
+		return result;
+	result.reserve(members ? std::min(cells_.size(), members->size()) : cells_.size());
 	for (auto &it : cells_)
-		if (design->selected(this, it.second))
+		if (members == nullptr || members->count(it.first))
 			result.push_back(it.second);
 	return result;
 }
@@ -2144,6 +2378,7 @@ void RTLIL::Module::add(RTLIL::Wire *wire)
 	log_assert(refcount_wires_ == 0);
 	wires_[wire->name] = wire;
 	wire->module = this;
+	generation_++;
 }
 
 void RTLIL::Module::add(RTLIL::Cell *cell)
@@ -2153,6 +2388,7 @@ void RTLIL::Module::add(RTLIL::Cell *cell)
 	log_assert(refcount_cells_ == 0);
 	cells_[cell->name] = cell;
 	cell->module = this;
+	generation_++;
 }
 
 void RTLIL::Module::add(RTLIL::Process *process)
@@ -2182,7 +2418,7 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 			sig.pack();
 			for (auto &c : sig.chunks_)
 				if (c.wire != NULL && wires_p->count(c.wire)) {
-					c.wire = module->addWire(stringf("$delete_wire$%d", autoidx++), c.width);
+					c.wire = module->addWire(stringf("$delete_wire$%d", autoidx_local ? (*autoidx_local)++ : autoidx++), c.width);
 					c.offset = 0;
 				}
 		}
@@ -2205,6 +2441,7 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 		wires_.erase(it->name);
 		delete it;
 	}
+	generation_++;
 }
 
 void RTLIL::Module::remove(RTLIL::Cell *cell)
@@ -2216,6 +2453,7 @@ void RTLIL::Module::remove(RTLIL::Cell *cell)
 	log_assert(refcount_cells_ == 0);
 	cells_.erase(cell->name);
 	delete cell;
+	generation_++;
 }
 
 void RTLIL::Module::remove(RTLIL::Process *process)
@@ -2241,6 +2479,9 @@ void RTLIL::Module::rename(RTLIL::Cell *cell, RTLIL::IdString new_name)
 	cells_.erase(cell->name);
 	cell->name = new_name;
 	add(cell);
+
+	// ModIndex::PortInfo hashes by cell name
+	notify_blackout();
 }
 
 void RTLIL::Module::rename(RTLIL::IdString old_name, RTLIL::IdString new_name)
@@ -2267,6 +2508,7 @@ void RTLIL::Module::swap_names(RTLIL::Wire *w1, RTLIL::Wire *w2)
 
 	wires_[w1->name] = w1;
 	wires_[w2->name] = w2;
+	generation_++;
 }
 
 void RTLIL::Module::swap_names(RTLIL::Cell *c1, RTLIL::Cell *c2)
@@ -2282,6 +2524,7 @@ void RTLIL::Module::swap_names(RTLIL::Cell *c1, RTLIL::Cell *c2)
 
 	cells_[c1->name] = c1;
 	cells_[c2->name] = c2;
+	generation_++;
 }
 
 RTLIL::IdString RTLIL::Module::uniquify(RTLIL::IdString name)
@@ -2320,6 +2563,8 @@ static bool fixup_ports_compare(const RTLIL::Wire *a, const RTLIL::Wire *b)
 
 void RTLIL::Module::connect(const RTLIL::SigSig &conn)
 {
+	generation_++;
+
 	for (auto mon : monitors)
 		mon->notify_connect(this, conn);
 
@@ -2356,6 +2601,8 @@ void RTLIL::Module::connect(const RTLIL::SigSpec &lhs, const RTLIL::SigSpec &rhs
 
 void RTLIL::Module::new_connections(const std::vector<RTLIL::SigSig> &new_conn)
 {
+	generation_++;
+
 	for (auto mon : monitors)
 		mon->notify_connect(this, new_conn);
 
@@ -2378,8 +2625,22 @@ const std::vector<RTLIL::SigSig> &RTLIL::Module::connections() const
 	return connections_;
 }
 
+void RTLIL::Module::notify_blackout()
+{
+	generation_++;
+
+	for (auto mon : monitors)
+		mon->notify_blackout(this);
+
+	if (design)
+		for (auto mon : design->monitors)
+			mon->notify_blackout(this);
+}
+
 void RTLIL::Module::fixup_ports()
 {
+	KERNEL_COUNT(FIXUP_PORTS);
+
 	std::vector<RTLIL::Wire*> all_ports;
 
 	for (auto &w : wires_)
@@ -2395,11 +2656,14 @@ void RTLIL::Module::fixup_ports()
 		ports.push_back(all_ports[i]->name);
 		all_ports[i]->port_id = i+1;
 	}
+
+	// port directions may have changed
+	notify_blackout();
 }
 
 RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, int width)
 {
-	RTLIL::Wire *wire = new RTLIL::Wire;
+	RTLIL::Wire *wire = new (this) RTLIL::Wire;
 	wire->name = name;
 	wire->width = width;
 	add(wire);
@@ -2422,9 +2686,16 @@ RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, const RTLIL::Wire *oth
 
 RTLIL::Cell *RTLIL::Module::addCell(RTLIL::IdString name, RTLIL::IdString type)
 {
-	RTLIL::Cell *cell = new RTLIL::Cell;
+	RTLIL::Cell *cell = new (this) RTLIL::Cell;
 	cell->name = name;
 	cell->type = type;
+
+	// size the port dict for the ports of known cell types up front; with at
+	// most hashtable_small_size ports it then never allocates a hashtable
+	auto ct = yosys_celltypes.cell_types.find(type);
+	if (ct != yosys_celltypes.cell_types.end())
+		cell->connections_.reserve(ct->second.inputs.size() + ct->second.outputs.size());
+
 	add(cell);
 	return cell;
 }
@@ -2438,6 +2709,47 @@ RTLIL::Cell *RTLIL::Module::addCell(RTLIL::IdString name, const RTLIL::Cell *oth
 	return cell;
 }
 
+std::vector<RTLIL::Cell*> RTLIL::Module::addCells(const std::string &name_prefix, RTLIL::IdString type, int count,
+		const std::vector<std::pair<RTLIL::IdString, RTLIL::SigSpec>> &ports,
+		const dict<RTLIL::IdString, RTLIL::Const> &attributes)
+{
+	std::vector<std::vector<RTLIL::SigBit>> port_bits(ports.size());
+	for (size_t k = 0; k < ports.size(); k++)
+		if (GetSize(ports[k].second) == count)
+			port_bits[k] = ports[k].second.to_sigbit_vector();
+
+	std::vector<RTLIL::Cell*> cells;
+	cells.reserve(count);
+	reserve_cells(count);
+
+	for (int i = 0; i < count; i++) {
+		RTLIL::Cell *cell = new (this) RTLIL::Cell;
+		cell->name = name_prefix + std::to_string(next_autoidx());
+		cell->type = type;
+		cell->attributes = attributes;
+		cell->connections_.reserve(ports.size());
+		add(cell);
+		for (size_t k = 0; k < ports.size(); k++)
+			if (port_bits[k].empty())
+				cell->setPort(ports[k].first, ports[k].second);
+			else
+				cell->setPort(ports[k].first, port_bits[k][i]);
+		cells.push_back(cell);
+	}
+
+	return cells;
+}
+
+void RTLIL::Module::reserve_cells(int count)
+{
+	cells_.reserve(cells_.size() + count);
+}
+
+void RTLIL::Module::reserve_wires(int count)
+{
+	wires_.reserve(wires_.size() + count);
+}
+
 RTLIL::Memory *RTLIL::Module::addMemory(RTLIL::IdString name, const RTLIL::Memory *other)
 {
 	RTLIL::Memory *mem = new RTLIL::Memory;
@@ -2447,6 +2759,7 @@ RTLIL::Memory *RTLIL::Module::addMemory(RTLIL::IdString name, const RTLIL::Memor
 	mem->size = other->size;
 	mem->attributes = other->attributes;
 	memories[mem->name] = mem;
+	generation_++;
 	return mem;
 }
 
@@ -3408,9 +3721,8 @@ RTLIL::SigSpec RTLIL::Module::FutureFF(RTLIL::IdString name, const RTLIL::SigSpe
 
 RTLIL::Wire::Wire()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 
 	module = nullptr;
 	width = 1;
@@ -3433,6 +3745,23 @@ RTLIL::Wire::~Wire()
 #endif
 }
 
+void *RTLIL::Wire::operator new(size_t size, RTLIL::Module *module)
+{
+	if (module == nullptr || size != sizeof(RTLIL::Wire))
+		return ObjectArena::heap_allocate(size);
+	return module->wire_arena_->allocate();
+}
+
+void RTLIL::Wire::operator delete(void *ptr, RTLIL::Module*)
+{
+	ObjectArena::deallocate(ptr);
+}
+
+void RTLIL::Wire::operator delete(void *ptr)
+{
+	ObjectArena::deallocate(ptr);
+}
+
 #ifdef WITH_PYTHON
 static std::map<unsigned int, RTLIL::Wire*> all_wires;
 std::map<unsigned int, RTLIL::Wire*> *RTLIL::Wire::get_all_wires(void)
@@ -3443,9 +3772,8 @@ std::map<unsigned int, RTLIL::Wire*> *RTLIL::Wire::get_all_wires(void)
 
 RTLIL::Memory::Memory()
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 
 	width = 1;
 	start_offset = 0;
@@ -3457,16 +3785,14 @@ RTLIL::Memory::Memory()
 
 RTLIL::Process::Process() : module(nullptr)
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 }
 
 RTLIL::Cell::Cell() : module(nullptr)
 {
-	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	static hashidx_counter_t hashidx_count(123456789);
+	hashidx_ = next_hashidx(hashidx_count);
 
 	// log("#memtrace# %p\n", this);
 	memhasher();
@@ -3483,6 +3809,23 @@ RTLIL::Cell::~Cell()
 #endif
 }
 
+void *RTLIL::Cell::operator new(size_t size, RTLIL::Module *module)
+{
+	if (module == nullptr || size != sizeof(RTLIL::Cell))
+		return ObjectArena::heap_allocate(size);
+	return module->cell_arena_->allocate();
+}
+
+void RTLIL::Cell::operator delete(void *ptr, RTLIL::Module*)
+{
+	ObjectArena::deallocate(ptr);
+}
+
+void RTLIL::Cell::operator delete(void *ptr)
+{
+	ObjectArena::deallocate(ptr);
+}
+
 #ifdef WITH_PYTHON
 static std::map<unsigned int, RTLIL::Cell*> all_cells;
 std::map<unsigned int, RTLIL::Cell*> *RTLIL::Cell::get_all_cells(void)
@@ -3503,6 +3846,8 @@ void RTLIL::Cell::unsetPort(const RTLIL::IdString& portname)
 
 	if (conn_it != connections_.end())
 	{
+		module->generation_++;
+
 		for (auto mon : module->monitors)
 			mon->notify_connect(this, conn_it->first, conn_it->second, signal);
 
@@ -3526,6 +3871,8 @@ void RTLIL::Cell::setPort(const RTLIL::IdString& portname, RTLIL::SigSpec signal
 	if (!r.second && conn_it->second == signal)
 		return;
 
+	module->generation_++;
+
 	for (auto mon : module->monitors)
 		mon->notify_connect(this, conn_it->first, conn_it->second, signal);
 
@@ -3592,11 +3939,15 @@ bool RTLIL::Cell::hasParam(const RTLIL::IdString& paramname) const
 void RTLIL::Cell::unsetParam(const RTLIL::IdString& paramname)
 {
 	parameters.erase(paramname);
+	if (module)
+		module->generation_++;
 }
 
 void RTLIL::Cell::setParam(const RTLIL::IdString& paramname, RTLIL::Const value)
 {
 	parameters[paramname] = std::move(value);
+	if (module)
+		module->generation_++;
 }
 
 const RTLIL::Const &RTLIL::Cell::getParam(const RTLIL::IdString& paramname) const
@@ -3976,6 +4327,9 @@ void RTLIL::SigSpec::pack() const
 
 	cover("kernel.rtlil.sigspec.convert.pack");
 	log_assert(that->chunks_.empty());
+	pack_counter++;
+	that->pack_stamp_++;
+	KERNEL_COUNT(SIGSPEC_PACK);
 
 	std::vector<RTLIL::SigBit> old_bits;
 	old_bits.swap(that->bits_);
@@ -4012,6 +4366,8 @@ void RTLIL::SigSpec::unpack() const
 
 	cover("kernel.rtlil.sigspec.convert.unpack");
 	log_assert(that->bits_.empty());
+	unpack_counter++;
+	KERNEL_COUNT(SIGSPEC_UNPACK);
 
 	that->bits_.reserve(that->width_);
 	for (auto &c : that->chunks_)
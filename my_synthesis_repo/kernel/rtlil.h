@@ -25,6 +25,8 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+struct ObjectArena;
+
 namespace RTLIL
 {
 	enum State : unsigned char {
@@ -92,12 +94,69 @@ namespace RTLIL
 			~destruct_guard_t() { destruct_guard_ok = false; }
 		} destruct_guard;
 
+	#ifdef YOSYS_ENABLE_THREADS
+		// With YOSYS_ENABLE_THREADS the id table may be used from several threads.
+		// Storage lives in fixed pages that never move, so c_str() needs no lock.
+		// The name index is split into shards with one mutex each, refcounts are
+		// atomic, and index allocation is serialized by global_id_alloc_mutex_.
+		template<typename T> struct storage_pages_t
+		{
+			static constexpr int page_bits = 12;
+			static constexpr int page_size = 1 << page_bits;
+			static constexpr int max_pages = 0x40000000 >> page_bits;
+
+			std::atomic<T*> pages_[max_pages];
+			std::atomic<int> size_;
+
+			~storage_pages_t() {
+				for (int i = 0; i < max_pages && pages_[i].load() != nullptr; i++)
+					delete[] pages_[i].load();
+			}
+
+			T &operator[](int idx) { return pages_[idx >> page_bits].load(std::memory_order_acquire)[idx & (page_size-1)]; }
+			T &at(int idx) { log_assert(idx >= 0 && idx < size()); return (*this)[idx]; }
+			T &back() { return (*this)[size()-1]; }
+			int size() const { return size_.load(std::memory_order_acquire); }
+			bool empty() const { return size() == 0; }
+
+			// only called with global_id_alloc_mutex_ held
+			template<typename V> void push_back(V value) {
+				int idx = size_.load(std::memory_order_relaxed);
+				if ((idx & (page_size-1)) == 0)
+					pages_[idx >> page_bits].store(new T[page_size](), std::memory_order_release);
+				(*this)[idx] = value;
+				size_.store(idx+1, std::memory_order_release);
+			}
+		};
+
+		struct index_shard_t {
+			std::mutex mutex;
+			dict<char*, int, hash_cstr_ops> index;
+		};
+
+		static constexpr int index_shard_count = 16;
+
+		static storage_pages_t<char*> global_id_storage_;
+		static storage_pages_t<std::atomic<int>> global_refcount_storage_;
+		static storage_pages_t<unsigned char> global_id_shard_;
+		static index_shard_t global_id_shards_[index_shard_count];
+		static std::vector<int> global_free_idx_list_;
+		static std::mutex global_id_alloc_mutex_;
+
+		// per-thread direct-mapped cache for by-name lookups
+		struct lookup_cache_entry_t {
+			unsigned int hash;
+			int idx;
+		};
+		static constexpr int lookup_cache_size = 256;
+	#else
 		static std::vector<char*> global_id_storage_;
 		static dict<char*, int, hash_cstr_ops> global_id_index_;
 	#ifndef YOSYS_NO_IDS_REFCNT
 		static std::vector<int> global_refcount_storage_;
 		static std::vector<int> global_free_idx_list_;
 	#endif
+	#endif
 
 	#ifdef YOSYS_USE_STICKY_IDS
 		static int last_created_idx_ptr_;
@@ -117,6 +176,19 @@ namespace RTLIL
 		#endif
 		}
 
+		// number of names currently in the table
+		static inline int live_count()
+		{
+		#ifdef YOSYS_ENABLE_THREADS
+			std::lock_guard<std::mutex> lock(global_id_alloc_mutex_);
+			return global_id_storage_.size() - GetSize(global_free_idx_list_);
+		#elif !defined(YOSYS_NO_IDS_REFCNT)
+			return GetSize(global_id_storage_) - GetSize(global_free_idx_list_);
+		#else
+			return GetSize(global_id_storage_);
+		#endif
+		}
+
 		static inline void checkpoint()
 		{
 		#ifdef YOSYS_USE_STICKY_IDS
@@ -146,6 +218,99 @@ namespace RTLIL
 			return idx;
 		}
 
+	#ifdef YOSYS_ENABLE_THREADS
+		// Takes a reference on idx unless its refcount already dropped to zero,
+		// in which case the id may be in the middle of being freed.
+		static inline bool try_get_reference(int idx)
+		{
+			std::atomic<int> &refcount = global_refcount_storage_[idx];
+			int current = refcount.load(std::memory_order_relaxed);
+			while (current > 0)
+				if (refcount.compare_exchange_weak(current, current+1, std::memory_order_acq_rel))
+					return true;
+			return false;
+		}
+
+		static int get_reference(const char *p)
+		{
+			log_assert(destruct_guard_ok);
+
+			if (!p[0])
+				return 0;
+
+			unsigned int hash = hash_cstr_ops::hash(p);
+			static thread_local lookup_cache_entry_t lookup_cache[lookup_cache_size];
+			lookup_cache_entry_t &cached = lookup_cache[hash % lookup_cache_size];
+
+			// The cached index is only a hint: after taking a reference we check
+			// that the slot still holds this name, since ids are recycled.
+			if (cached.idx > 0 && cached.hash == hash && cached.idx < global_id_storage_.size() && try_get_reference(cached.idx)) {
+				if (hash_cstr_ops::cmp(global_id_storage_[cached.idx], p))
+					return cached.idx;
+				put_reference(cached.idx);
+			}
+
+			index_shard_t &shard = global_id_shards_[hash % index_shard_count];
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				auto it = shard.index.find((char*)p);
+				if (it != shard.index.end()) {
+					global_refcount_storage_[it->second]++;
+					cached.hash = hash;
+					cached.idx = it->second;
+					return it->second;
+				}
+			}
+
+			log_assert(p[0] == '$' || p[0] == '\\');
+			log_assert(p[1] != 0);
+			for (const char *c = p; *c; c++)
+				if ((unsigned)*c <= (unsigned)' ')
+					log_error("Found control character or space (0x%02x) in string '%s' which is not allowed in RTLIL identifiers\n", *c, p);
+
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			// another thread may have created the same id since we dropped the lock
+			auto it = shard.index.find((char*)p);
+			if (it != shard.index.end()) {
+				global_refcount_storage_[it->second]++;
+				return it->second;
+			}
+
+			int idx;
+			{
+				std::lock_guard<std::mutex> alloc_lock(global_id_alloc_mutex_);
+				if (global_free_idx_list_.empty()) {
+					if (global_id_storage_.empty()) {
+						global_refcount_storage_.push_back(0);
+						global_id_shard_.push_back(0);
+						global_id_storage_.push_back((char*)"");
+					}
+					log_assert(global_id_storage_.size() < 0x40000000);
+					global_free_idx_list_.push_back(global_id_storage_.size());
+					global_id_storage_.push_back(nullptr);
+					global_id_shard_.push_back(0);
+					global_refcount_storage_.push_back(0);
+				}
+				idx = global_free_idx_list_.back();
+				global_free_idx_list_.pop_back();
+			}
+
+			global_id_storage_[idx] = strdup(p);
+			global_id_shard_[idx] = hash % index_shard_count;
+			shard.index[global_id_storage_[idx]] = idx;
+			global_refcount_storage_[idx].store(1, std::memory_order_release);
+
+			KERNEL_COUNT(IDSTRING_NEW);
+
+			if (yosys_xtrace) {
+				log("#X# New IdString '%s' with index %d.\n", p, idx);
+				log_backtrace("-X- ", yosys_xtrace-1);
+			}
+
+			return idx;
+		}
+	#else
 		static int get_reference(const char *p)
 		{
 			log_assert(destruct_guard_ok);
@@ -199,6 +364,8 @@ namespace RTLIL
 			global_id_index_[global_id_storage_.back()] = idx;
 		#endif
 
+			KERNEL_COUNT(IDSTRING_NEW);
+
 			if (yosys_xtrace) {
 				log("#X# New IdString '%s' with index %d.\n", p, idx);
 				log_backtrace("-X- ", yosys_xtrace-1);
@@ -220,8 +387,48 @@ namespace RTLIL
 
 			return idx;
 		}
+	#endif
 
-	#ifndef YOSYS_NO_IDS_REFCNT
+	#if defined(YOSYS_ENABLE_THREADS)
+		static inline void put_reference(int idx)
+		{
+			if (!destruct_guard_ok || !idx)
+				return;
+
+			if (global_refcount_storage_[idx].fetch_sub(1, std::memory_order_acq_rel) > 1)
+				return;
+
+			free_reference(idx);
+		}
+		static void free_reference(int idx)
+		{
+			index_shard_t &shard = global_id_shards_[global_id_shard_[idx]];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			// A by-name lookup may have revived the id before we got the lock, or
+			// another thread may be freeing it already. Claim it by moving the
+			// refcount from 0 to -1; such ids are not handed out again until the
+			// index is reallocated.
+			int expected = 0;
+			if (!global_refcount_storage_[idx].compare_exchange_strong(expected, -1, std::memory_order_acq_rel))
+				return;
+
+			char *p = global_id_storage_[idx];
+			KERNEL_COUNT(IDSTRING_FREE);
+
+			if (yosys_xtrace) {
+				log("#X# Removed IdString '%s' with index %d.\n", p, idx);
+				log_backtrace("-X- ", yosys_xtrace-1);
+			}
+
+			shard.index.erase(p);
+			global_id_storage_[idx] = nullptr;
+			free(p);
+
+			std::lock_guard<std::mutex> alloc_lock(global_id_alloc_mutex_);
+			global_free_idx_list_.push_back(idx);
+		}
+	#elif !defined(YOSYS_NO_IDS_REFCNT)
 		static inline void put_reference(int idx)
 		{
 			// put_reference() may be called from destructors after the destructor of
@@ -245,6 +452,8 @@ namespace RTLIL
 		}
 		static inline void free_reference(int idx)
 		{
+			KERNEL_COUNT(IDSTRING_FREE);
+
 			if (yosys_xtrace) {
 				log("#X# Removed IdString '%s' with index %d.\n", global_id_storage_.at(idx), idx);
 				log_backtrace("-X- ", yosys_xtrace-1);
@@ -682,6 +891,8 @@ struct RTLIL::Const
 
 	inline int size() const { return bits.size(); }
 	inline bool empty() const { return bits.empty(); }
+	// heap bytes owned by this constant, for the memory census in Pass::post_execute()
+	inline size_t memory_usage() const { return bits.capacity() * sizeof(RTLIL::State); }
 	inline RTLIL::State &operator[](int index) { return bits.at(index); }
 	inline const RTLIL::State &operator[](int index) const { return bits.at(index); }
 	inline decltype(bits)::iterator begin() { return bits.begin(); }
@@ -821,20 +1032,30 @@ struct RTLIL::SigSpecIterator
 	inline void operator++() { index++; }
 };
 
+// Iterating a const SigSpec does not unpack it: while the SigSpec is packed the
+// iterator walks its chunks, and the returned reference is to a copy of the
+// current bit held by the iterator, valid until it is dereferenced again.
 struct RTLIL::SigSpecConstIterator
 {
 	typedef std::input_iterator_tag iterator_category;
 	typedef RTLIL::SigBit value_type;
 	typedef ptrdiff_t difference_type;
-	typedef RTLIL::SigBit* pointer;
-	typedef RTLIL::SigBit& reference;
+	typedef const RTLIL::SigBit* pointer;
+	typedef const RTLIL::SigBit& reference;
 
 	const RTLIL::SigSpec *sig_p;
 	int index;
 
+	// position of index within the chunk list, only meaningful while packed
+	// and while the SigSpec still has the chunk list with pack_stamp_ == stamp
+	mutable int chunk_idx = 0;
+	mutable int chunk_base = 0;
+	mutable unsigned int stamp = 0;
+	mutable RTLIL::SigBit bit;
+
 	inline const RTLIL::SigBit &operator*() const;
 	inline bool operator!=(const RTLIL::SigSpecConstIterator &other) const { return index != other.index; }
-	inline bool operator==(const RTLIL::SigSpecIterator &other) const { return index == other.index; }
+	inline bool operator==(const RTLIL::SigSpecConstIterator &other) const { return index == other.index; }
 	inline void operator++() { index++; }
 };
 
@@ -842,6 +1063,8 @@ struct RTLIL::SigSpec
 {
 private:
 	int width_;
+	// bumped whenever pack() builds a new chunk list, see SigSpecConstIterator
+	mutable unsigned int pack_stamp_ = 0;
 	unsigned long hash_;
 	std::vector<RTLIL::SigChunk> chunks_; // LSB at index 0
 	std::vector<RTLIL::SigBit> bits_; // LSB at index 0
@@ -854,6 +1077,20 @@ private:
 		return bits_.empty();
 	}
 
+	friend struct RTLIL::SigSpecConstIterator;
+
+public:
+	// running totals of pack()/unpack() conversions, attributed to passes in Pass::post_execute()
+#ifdef YOSYS_ENABLE_THREADS
+	typedef std::atomic<int64_t> counter_t;
+#else
+	typedef int64_t counter_t;
+#endif
+	static counter_t pack_counter;
+	static counter_t unpack_counter;
+
+private:
+
 	inline void inline_unpack() const {
 		if (!chunks_.empty())
 			unpack();
@@ -894,6 +1131,15 @@ public:
 	inline int size() const { return width_; }
 	inline bool empty() const { return width_ == 0; }
 
+	// heap bytes owned by this SigSpec in its current (packed or unpacked) form,
+	// for the memory census in Pass::post_execute(); does not convert it
+	size_t memory_usage() const {
+		size_t bytes = chunks_.capacity() * sizeof(RTLIL::SigChunk) + bits_.capacity() * sizeof(RTLIL::SigBit);
+		for (auto &chunk : chunks_)
+			bytes += chunk.data.capacity() * sizeof(RTLIL::State);
+		return bytes;
+	}
+
 	inline RTLIL::SigBit &operator[](int index) { inline_unpack(); return bits_.at(index); }
 	inline const RTLIL::SigBit &operator[](int index) const { inline_unpack(); return bits_.at(index); }
 
@@ -1056,6 +1302,9 @@ struct RTLIL::Monitor
 // Forward declaration; defined in preproc.h.
 struct define_map_t;
 
+// Forward declaration; defined in mem.h.
+struct MemCache;
+
 struct RTLIL::Design
 {
 	unsigned int hashidx_;
@@ -1065,7 +1314,8 @@ struct RTLIL::Design
 	dict<std::string, std::string> scratchpad;
 
 	int refcount_modules_;
-	dict<RTLIL::IdString, RTLIL::Module*> modules_;
+	// mutable for unshare_module() in the const selected_*modules() accessors
+	mutable dict<RTLIL::IdString, RTLIL::Module*> modules_;
 	std::vector<RTLIL::Binding*> bindings_;
 
 	std::vector<AST::AstNode*> verilog_packages, verilog_globals;
@@ -1090,6 +1340,33 @@ struct RTLIL::Design
 	void add(RTLIL::Module *module);
 	void add(RTLIL::Binding *binding);
 
+	// Copy-on-write module sharing, used by the design command for -save,
+	// -load, -push and -pop. add_shared() puts a module of another design
+	// into this one without copying it. Shared modules are never modified:
+	// before an accessor hands out a shared module as non-const (module(),
+	// modules(), top_module(), selected_*modules()), the module is unshared.
+	// The design that owns it (Module::design, or the first design to ask
+	// once the owner dropped it) keeps the module object, so pointers the
+	// owner handed out stay valid, and the other holders get a private copy.
+	// Any other design gets a private copy the first time it hands its entry
+	// out, and hands out that copy from then on. A module that the owner
+	// drops before anyone asks for it (e.g. design -push/-pop) is thus never
+	// copied. unshare_modules() does that for all modules at once. remove()
+	// and the destructor release shared modules instead of deleting them.
+	//
+	// add_clone() adds a copy of a module under a new name the same way: the
+	// returned module is empty and only holds its name and attributes, which
+	// the caller may still change, and the contents are copied from the
+	// original when an accessor first hands it out, or when the original is
+	// unshared (or never, if the copy is removed before). The empty module
+	// is replaced at that point, so the pointer add_clone() returns must not
+	// be kept. Both accessors of module() do that for copies.
+	void add_shared(RTLIL::Module *module);
+	RTLIL::Module *add_clone(RTLIL::Module *module, RTLIL::IdString name);
+	void unshare_modules();
+	RTLIL::Module *unshare_module(RTLIL::Module *&module) const;
+	void release_shared(RTLIL::Module *module);
+
 	RTLIL::Module *addModule(RTLIL::IdString name);
 	void remove(RTLIL::Module *module);
 	void rename(RTLIL::Module *module, RTLIL::IdString new_name);
@@ -1115,6 +1392,12 @@ struct RTLIL::Design
 	bool selected_module(RTLIL::Module *mod) const;
 	bool selected_whole_module(RTLIL::Module *mod) const;
 
+	// Resolves the active selection for one module, so that loops over its
+	// members need a single set lookup per member: returns nullptr if the
+	// whole module is selected, otherwise the selected member names (an
+	// empty pool if none are).
+	const pool<RTLIL::IdString> *selected_members_of(const RTLIL::IdString &mod_name) const;
+
 	RTLIL::Selection &selection() {
 		return selection_stack.back();
 	}
@@ -1175,6 +1458,45 @@ public:
 	int refcount_wires_;
 	int refcount_cells_;
 
+	// the other holders of this module besides its owner (design), see
+	// Design::add_shared(): each is a design and the name under which it
+	// holds either this module or a copy from Design::add_clone() that has
+	// no contents yet. The module is read-only while this is non-empty.
+	std::vector<std::pair<RTLIL::Design*, RTLIL::IdString>> sharers_;
+
+	// for a copy made by Design::add_clone() that was not handed out yet, the
+	// module it copies; the copy is listed in the sharers_ of that module
+	RTLIL::Module *clone_source_;
+
+	// the module that holds the contents (i.e. everything but the name and
+	// attributes) of this one, for code that looks at design->modules_
+	// directly instead of through the accessors that fill in such copies
+	const RTLIL::Module *shared_contents() const {
+		return clone_source_ != nullptr ? clone_source_ : this;
+	}
+
+	// storage for the cells and wires of this module, see kernel/arena.h
+	ObjectArena *cell_arena_;
+	ObjectArena *wire_arena_;
+
+	// indexes handed out by ModIndex::get() and SigMap::get(), owned by
+	// the module and registered in monitors while they exist
+	RTLIL::Monitor *cached_modindex_;
+	RTLIL::Monitor *cached_sigmap_;
+
+	// memory helper structures behind Mem::get_all_memories(), owned by
+	// the module and checked against generation_ (see kernel/mem.cc)
+	MemCache *cached_mems_;
+
+	// timing graph kept by the sta pass between calls, owned by the module
+	// and registered in its monitors while it exists (see passes/cmds/sta.cc)
+	RTLIL::Monitor *cached_timing_;
+
+	// bumped by every change made through the module's methods (cells, wires,
+	// ports, parameters and connections), so that passes can tell whether a
+	// module was modified since they last looked at it
+	unsigned int generation_;
+
 	dict<RTLIL::IdString, RTLIL::Wire*> wires_;
 	dict<RTLIL::IdString, RTLIL::Cell*> cells_;
 
@@ -1200,11 +1522,19 @@ public:
 	virtual void optimize();
 	virtual void makeblackbox();
 
+	// returns cell/wire arena slabs without live objects to the heap, and
+	// the number of bytes released
+	size_t trim_storage();
+
 	void connect(const RTLIL::SigSig &conn);
 	void connect(const RTLIL::SigSpec &lhs, const RTLIL::SigSpec &rhs);
 	void new_connections(const std::vector<RTLIL::SigSig> &new_conn);
 	const std::vector<RTLIL::SigSig> &connections() const;
 
+	// tells the monitors that the module changed in a way they cannot
+	// follow incrementally, so that cached indexes rebuild on next use
+	void notify_blackout();
+
 	std::vector<RTLIL::IdString> ports;
 	void fixup_ports();
 
@@ -1270,6 +1600,17 @@ public:
 	RTLIL::Cell *addCell(RTLIL::IdString name, RTLIL::IdString type);
 	RTLIL::Cell *addCell(RTLIL::IdString name, const RTLIL::Cell *other);
 
+	// Adds count cells of one type in one go, e.g. the single-bit gates a
+	// coarse cell is split into. The cells are named name_prefix followed by
+	// next_autoidx() (see NEW_ID_PREFIX) and get a copy of attributes. A port
+	// signal of width count is split so that cell i gets bit i, any other
+	// signal is connected to all cells as a whole.
+	std::vector<RTLIL::Cell*> addCells(const std::string &name_prefix, RTLIL::IdString type, int count,
+			const std::vector<std::pair<RTLIL::IdString, RTLIL::SigSpec>> &ports,
+			const dict<RTLIL::IdString, RTLIL::Const> &attributes = dict<RTLIL::IdString, RTLIL::Const>());
+	void reserve_cells(int count);
+	void reserve_wires(int count);
+
 	RTLIL::Memory *addMemory(RTLIL::IdString name, const RTLIL::Memory *other);
 
 	RTLIL::Process *addProcess(RTLIL::IdString name);
@@ -1511,6 +1852,11 @@ protected:
 	Wire();
 	~Wire();
 
+	// wires live in the arena of the module that created them
+	static void *operator new(size_t size, RTLIL::Module *module);
+	static void operator delete(void *ptr, RTLIL::Module *module);
+	static void operator delete(void *ptr);
+
 public:
 	// do not simply copy wires
 	Wire(RTLIL::Wire &other) = delete;
@@ -1556,6 +1902,11 @@ protected:
 	Cell();
 	~Cell();
 
+	// cells live in the arena of the module that created them
+	static void *operator new(size_t size, RTLIL::Module *module);
+	static void operator delete(void *ptr, RTLIL::Module *module);
+	static void operator delete(void *ptr);
+
 public:
 	// do not simply copy cells
 	Cell(RTLIL::Cell &other) = delete;
@@ -1713,7 +2064,19 @@ inline RTLIL::SigBit &RTLIL::SigSpecIterator::operator*() const {
 }
 
 inline const RTLIL::SigBit &RTLIL::SigSpecConstIterator::operator*() const {
-	return (*sig_p)[index];
+	if (!sig_p->packed())
+		return sig_p->bits_[index];
+	const std::vector<RTLIL::SigChunk> &chunks = sig_p->chunks_;
+	// a repacked SigSpec may have a different chunk list, so the position is
+	// then found again from the bit index, as it is when stepping backwards
+	if (stamp != sig_p->pack_stamp_ || index < chunk_base) {
+		stamp = sig_p->pack_stamp_;
+		chunk_idx = 0, chunk_base = 0;
+	}
+	while (index >= chunk_base + chunks[chunk_idx].width)
+		chunk_base += chunks[chunk_idx++].width;
+	bit = RTLIL::SigBit(chunks[chunk_idx], index - chunk_base);
+	return bit;
 }
 
 inline RTLIL::SigBit::SigBit(const RTLIL::SigSpec &sig) {
@@ -1732,6 +2095,7 @@ void RTLIL::Module::rewrite_sigspecs(T &functor)
 		functor(it.first);
 		functor(it.second);
 	}
+	notify_blackout();
 }
 
 template<typename T>
@@ -1744,18 +2108,23 @@ void RTLIL::Module::rewrite_sigspecs2(T &functor)
 	for (auto &it : connections_) {
 		functor(it.first, it.second);
 	}
+	notify_blackout();
 }
 
 template<typename T>
 void RTLIL::Cell::rewrite_sigspecs(T &functor) {
 	for (auto &it : connections_)
 		functor(it.second);
+	if (module)
+		module->notify_blackout();
 }
 
 template<typename T>
 void RTLIL::Cell::rewrite_sigspecs2(T &functor) {
 	for (auto &it : connections_)
 		functor(it.second);
+	if (module)
+		module->notify_blackout();
 }
 
 template<typename T>
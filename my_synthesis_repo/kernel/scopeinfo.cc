@@ -21,6 +21,81 @@
 
 YOSYS_NAMESPACE_BEGIN
 
+IdString compact_hier_name(int scope, IdString leaf)
+{
+	log_assert(leaf.isPublic());
+	return stringf("\\@%d.%s", scope, leaf.c_str() + 1);
+}
+
+bool parse_compact_hier_name(IdString name, int &scope, IdString &leaf)
+{
+	const char *p = name.c_str();
+	if (p[0] != '\\' || p[1] != '@' || !isdigit((unsigned char)p[2]))
+		return false;
+	char *end;
+	long value = strtol(p + 2, &end, 10);
+	if (*end != '.' || end[1] == 0)
+		return false;
+	scope = value;
+	leaf = stringf("\\%s", end + 1);
+	return true;
+}
+
+ModuleScopeIndex::ModuleScopeIndex(RTLIL::Module *module) : module(module)
+{
+	for (auto cell : module->cells())
+		if (cell->type == ID($scopeinfo) && cell->has_attribute(ID(scope_id)))
+			scopes[cell->attributes.at(ID(scope_id)).as_int()] = cell;
+}
+
+std::vector<IdString> ModuleScopeIndex::path(IdString name) const
+{
+	std::vector<IdString> result;
+	if (!name.isPublic())
+		return result;
+
+	Cell *scope_cell = nullptr;
+	IdString current = name;
+	int scope;
+	IdString leaf;
+	while (parse_compact_hier_name(current, scope, leaf)) {
+		auto found = scopes.find(scope);
+		if (found == scopes.end() || GetSize(result) > GetSize(scopes))
+			return {};
+		result.push_back(leaf);
+		scope_cell = found->second;
+		current = scope_cell->name;
+	}
+
+	if (scope_cell != nullptr && scope_cell->has_attribute(ID::hdlname)) {
+		std::vector<IdString> outer = parse_hdlname(scope_cell);
+		result.insert(result.end(), outer.rbegin(), outer.rend());
+	} else {
+		if (!current.isPublic())
+			return {};
+		result.push_back(current);
+	}
+
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+IdString ModuleScopeIndex::join_path(const std::vector<IdString> &path)
+{
+	std::string result;
+	for (auto &item : path) {
+		result += result.empty() ? "\\" : ".";
+		result += RTLIL::unescape_id(item);
+	}
+	return result;
+}
+
+IdString ModuleScopeIndex::full_name(IdString name) const
+{
+	std::vector<IdString> result = path(name);
+	return result.empty() ? name : join_path(result);
+}
+
 template <typename I, typename Filter> void ModuleHdlnameIndex::index_items(I begin, I end, Filter filter)
 {
 	for (; begin != end; ++begin) {
@@ -28,7 +103,7 @@ template <typename I, typename Filter> void ModuleHdlnameIndex::index_items(I be
 
 		if (!filter(item))
 			continue;
-		std::vector<IdString> path = parse_hdlname(item);
+		std::vector<IdString> path = item_path(item);
 		if (!path.empty())
 			lookup.emplace(item, tree.insert(path, item));
 	}
@@ -359,6 +359,33 @@ std::pair<std::vector<IdString>, IdString> parse_scopename(const O* object)
 	return {path, trailing};
 }
 
+// With `flatten -scopeids`, objects with a public name inside a flattened
+// instance are named `\@<scope>.<leaf>` instead of spelling out the whole
+// instance path. The scope is the `scope_id` attribute of the $scopeinfo cell
+// of that instance, whose own name can again be a compact name. Each name
+// thus only stores its leaf, and the full path is reconstructed on demand.
+IdString compact_hier_name(int scope, IdString leaf);
+bool parse_compact_hier_name(IdString name, int &scope, IdString &leaf);
+
+struct ModuleScopeIndex {
+	RTLIL::Module *module;
+	dict<int, RTLIL::Cell*> scopes;
+
+	ModuleScopeIndex(RTLIL::Module *module);
+
+	// Return the hierarchical path of a public name in the same form as
+	// parse_hdlname, resolving compact names through the $scopeinfo cells.
+	// Returns an empty path if a scope can't be found.
+	std::vector<IdString> path(IdString name) const;
+
+	// Return the flattened name `\a.b.c` for a hierarchical path.
+	static IdString join_path(const std::vector<IdString> &path);
+
+	// Return the flattened name for a compact name, or the name itself if it
+	// can't be resolved.
+	IdString full_name(IdString name) const;
+};
+
 struct ModuleHdlnameIndex {
 	typedef IdTree<ModuleItem>::Cursor Cursor;
 
@@ -369,9 +396,39 @@ struct ModuleHdlnameIndex {
 	ModuleHdlnameIndex(RTLIL::Module *module) : module(module) {}
 
 private:
+	std::unique_ptr<ModuleScopeIndex> compact_scopes;
+
 	template<typename I, typename Filter>
 	void index_items(I begin, I end, Filter filter);
 
+	const ModuleScopeIndex &scope_index() {
+		if (!compact_scopes)
+			compact_scopes.reset(new ModuleScopeIndex(module));
+		return *compact_scopes;
+	}
+
+	template<typename O>
+	std::vector<IdString> item_path(const O* object) {
+		std::vector<IdString> path = parse_hdlname(object);
+		if (GetSize(path) == 1 && path[0].begins_with("\\@"))
+			path = scope_index().path(path[0]);
+		return path;
+	}
+
+	template<typename O>
+	std::pair<std::vector<IdString>, IdString> item_scopename(const O* object) {
+		auto pair = parse_scopename(object);
+		if (pair.first.empty() && pair.second.begins_with("\\@")) {
+			std::vector<IdString> path = scope_index().path(pair.second);
+			if (!path.empty()) {
+				pair.second = path.back();
+				path.pop_back();
+				pair.first = std::move(path);
+			}
+		}
+		return pair;
+	}
+
 public:
 	// Index all wires and cells of the module
 	void index();
@@ -390,7 +447,7 @@ public:
 	// Return the cursor for the containing scope of some RTLIL object (Wire/Cell/...)
 	template<typename O>
 	std::pair<Cursor, IdString> containing_scope(O *object) {
-		auto pair = parse_scopename(object);
+		auto pair = item_scopename(object);
 		return {tree.cursor(pair.first), pair.second};
 	}
 
@@ -406,7 +463,7 @@ public:
 	// attributes.
 	template<typename O>
 	std::vector<std::string> sources(O *object) {
-		auto pair = parse_scopename(object);
+		auto pair = item_scopename(object);
 		std::vector<std::string> result = scope_sources(tree.cursor(pair.first));
 		result.push_back(object->get_src_attribute());
 		return result;
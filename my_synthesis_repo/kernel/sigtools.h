@@ -251,6 +251,8 @@ struct SigMap
 
 	void set(RTLIL::Module *module)
 	{
+		KERNEL_COUNT(SIGMAP_BUILD);
+
 		int bitcount = 0;
 		for (auto &it : module->connections())
 			bitcount += it.first.size();
@@ -302,6 +304,16 @@ struct SigMap
 
 	inline void add(Wire *wire) { return add(RTLIL::SigSpec(wire)); }
 
+	// Returns the SigMap of the module's connections that is cached on the
+	// module. It follows Module::connect() incrementally and is rebuilt on the
+	// next get() after new_connections() or another bulk edit, so re-fetch it
+	// after such edits instead of holding on to the reference. It must not be
+	// modified; passes that add to their SigMap take a copy:
+	//
+	//     const SigMap &sigmap = SigMap::get(module);    // read-only
+	//     SigMap assign_map = SigMap::get(module);       // private copy
+	static const SigMap &get(RTLIL::Module *module);
+
 	void apply(RTLIL::SigBit &bit) const
 	{
 		bit = database.find(bit);
@@ -342,6 +354,61 @@ struct SigMap
 	}
 };
 
+// The monitor behind SigMap::get(), owned by the module
+struct CachedSigMap : public RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	bool stale;
+
+	CachedSigMap(RTLIL::Module *module) : module(module), stale(true)
+	{
+		module->monitors.insert(this);
+	}
+
+	~CachedSigMap()
+	{
+		module->monitors.erase(this);
+	}
+
+	void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig &sigsig) override
+	{
+		log_assert(module == mod);
+
+		// Module::connect() drops constant lhs bits and calls the
+		// monitors again with the rest
+		if (stale || sigsig.first.has_const())
+			return;
+
+		sigmap.add(sigsig.first, sigsig.second);
+	}
+
+	void notify_connect(RTLIL::Module *mod, const std::vector<RTLIL::SigSig>&) override
+	{
+		log_assert(module == mod);
+		stale = true;
+	}
+
+	void notify_blackout(RTLIL::Module *mod) override
+	{
+		log_assert(module == mod);
+		stale = true;
+	}
+};
+
+inline const SigMap &SigMap::get(RTLIL::Module *module)
+{
+	if (module->cached_sigmap_ == nullptr)
+		module->cached_sigmap_ = new CachedSigMap(module);
+
+	CachedSigMap *cache = static_cast<CachedSigMap*>(module->cached_sigmap_);
+	if (cache->stale) {
+		cache->sigmap.set(module);
+		cache->stale = false;
+	}
+	return cache->sigmap;
+}
+
 YOSYS_NAMESPACE_END
 
 #endif /* SIGTOOLS_H */
@@ -0,0 +1,312 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/threading.h"
+#include "kernel/tracing.h"
+
+#ifdef YOSYS_ENABLE_THREADS
+#  include <thread>
+#  include <condition_variable>
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+int yosys_parallel_jobs = 1;
+
+void set_parallel_jobs(int jobs)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	if (jobs == 0)
+		jobs = std::thread::hardware_concurrency();
+#endif
+	yosys_parallel_jobs = std::max(jobs, 1);
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+
+// Fixed set of worker threads. run() hands out task indices from a shared
+// counter to the workers and to the calling thread and returns once all tasks
+// are finished. The pool is created on first use and grows when -j is raised.
+struct ThreadPool
+{
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable work_cv, done_cv;
+
+	const std::function<void(int)> *job = nullptr;
+	int job_tasks = 0;
+	std::atomic<int> next_task{0};
+	int busy = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		work_cv.notify_all();
+		for (auto &t : threads)
+			t.join();
+	}
+
+	void grow(int num_threads)
+	{
+		while (GetSize(threads) < num_threads)
+			threads.emplace_back([this]() { worker_main(); });
+	}
+
+	void drain(const std::function<void(int)> &task, int num_tasks)
+	{
+		for (int i = next_task++; i < num_tasks; i = next_task++)
+			task(i);
+	}
+
+	void worker_main()
+	{
+		uint64_t seen_generation = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (1)
+		{
+			work_cv.wait(lock, [&]() { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+			if (job == nullptr)
+				continue;
+
+			const std::function<void(int)> *task = job;
+			int num_tasks = job_tasks;
+			busy++;
+			lock.unlock();
+			drain(*task, num_tasks);
+			lock.lock();
+			if (--busy == 0)
+				done_cv.notify_all();
+		}
+	}
+
+	void run(int num_tasks, const std::function<void(int)> &task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &task;
+			job_tasks = num_tasks;
+			next_task = 0;
+			generation++;
+		}
+		work_cv.notify_all();
+
+		drain(task, num_tasks);
+
+		// workers that wake up after this see job == nullptr and go back to sleep
+		std::unique_lock<std::mutex> lock(mutex);
+		done_cv.wait(lock, [&]() { return busy == 0; });
+		job = nullptr;
+	}
+};
+
+static ThreadPool &thread_pool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+#endif
+
+static bool has_monitors(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules)
+{
+	if (!design->monitors.empty())
+		return true;
+	// indexes cached on a module only follow that module, on the worker's thread
+	for (auto module : modules)
+		for (auto mon : module->monitors)
+			if (mon != module->cached_modindex_ && mon != module->cached_sigmap_ && mon != module->cached_timing_)
+				return true;
+	return false;
+}
+
+static int parallel_jobs(int count, int jobs = 0)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	// tasks started from inside a task run on that task's thread, the pool
+	// threads are already busy with the outer tasks
+	if (autoidx_local != nullptr)
+		return 1;
+	return std::min(jobs > 0 ? jobs : yosys_parallel_jobs, count);
+#else
+	(void)count;
+	(void)jobs;
+	return 1;
+#endif
+}
+
+// with -j1 the tasks run as a plain loop, so that NEW_ID keeps counting up
+// through all of them and the names match those of a serial pass
+static bool plain_loop(int jobs)
+{
+	return autoidx_local == nullptr && (jobs > 0 ? jobs : yosys_parallel_jobs) <= 1;
+}
+
+// start of the hash index sequence of task i (xorshift never leaves zero)
+static unsigned int task_hashidx_seed(int base_autoidx, int i)
+{
+	unsigned int seed = mkhash(base_autoidx, i);
+	return seed ? seed : 123456789;
+}
+
+static void run_tasks(int count, int jobs, const std::function<void(int)> &worker, const std::vector<int> *schedule = nullptr)
+{
+	int base_autoidx = autoidx;
+	int max_autoidx = base_autoidx;
+
+	if (jobs <= 1)
+	{
+		// nested tasks count from the counter of the task that started them
+		int *outer_autoidx = autoidx_local;
+		unsigned int *outer_hashidx = hashidx_local;
+		int &counter = outer_autoidx ? *outer_autoidx : autoidx;
+		base_autoidx = max_autoidx = counter;
+
+		// same numbering as the parallel case, so that -j does not change the netlist
+		for (int i = 0; i < count; i++) {
+			int task_autoidx = base_autoidx;
+			unsigned int task_hashidx = task_hashidx_seed(base_autoidx, i);
+			autoidx_local = &task_autoidx;
+			hashidx_local = &task_hashidx;
+			try {
+				worker(i);
+			} catch (...) {
+				autoidx_local = outer_autoidx;
+				hashidx_local = outer_hashidx;
+				counter = std::max(max_autoidx, task_autoidx);
+				throw;
+			}
+			autoidx_local = outer_autoidx;
+			hashidx_local = outer_hashidx;
+			max_autoidx = std::max(max_autoidx, task_autoidx);
+		}
+		counter = max_autoidx;
+		return;
+	}
+
+#ifdef YOSYS_ENABLE_THREADS
+	std::vector<LogCapture> captures(count);
+	std::vector<std::exception_ptr> errors(count);
+	std::vector<int> task_autoidx(count, base_autoidx);
+	std::vector<unsigned int> task_hashidx(count);
+	for (int i = 0; i < count; i++)
+		task_hashidx[i] = task_hashidx_seed(base_autoidx, i);
+
+	std::function<void(int)> task = [&](int k) {
+		int i = schedule ? (*schedule)[k] : k;
+		autoidx_local = &task_autoidx[i];
+		hashidx_local = &task_hashidx[i];
+		log_capture_begin(&captures[i]);
+		try {
+			worker(i);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+		log_capture_end();
+		autoidx_local = nullptr;
+		hashidx_local = nullptr;
+	};
+
+	ThreadPool &pool = thread_pool();
+	pool.grow(jobs - 1);
+	pool.run(count, task);
+
+	for (int i = 0; i < count; i++)
+		max_autoidx = std::max(max_autoidx, task_autoidx[i]);
+	autoidx = max_autoidx;
+
+	for (int i = 0; i < count; i++) {
+		log_capture_replay(captures[i]);
+		if (errors[i] == nullptr)
+			continue;
+		try {
+			std::rethrow_exception(errors[i]);
+		} catch (const log_capture_error_exception &e) {
+			log_capture_raise(e);
+		}
+	}
+#endif
+}
+
+void parallel_for_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules,
+		const std::function<void(RTLIL::Module*)> &worker, int jobs)
+{
+	if (plain_loop(jobs)) {
+		for (auto module : modules) {
+			TraceScope trace_scope("module", trace_enabled() ? RTLIL::unescape_id(module->name) : std::string());
+			worker(module);
+		}
+		return;
+	}
+
+	jobs = parallel_jobs(GetSize(modules), jobs);
+	if (jobs > 1 && has_monitors(design, modules))
+		jobs = 1;
+
+	// workers must not clone shared modules behind each other's back
+	if (jobs > 1)
+		design->unshare_modules();
+
+	run_tasks(GetSize(modules), jobs, [&](int i) {
+		TraceScope trace_scope("module", trace_enabled() ? RTLIL::unescape_id(modules[i]->name) : std::string());
+		worker(modules[i]);
+	});
+}
+
+void parallel_for(int count, const std::function<void(int)> &worker, int jobs)
+{
+	if (plain_loop(jobs)) {
+		for (int i = 0; i < count; i++) {
+			TraceScope trace_scope("task", trace_enabled() ? stringf("task %d", i) : std::string());
+			worker(i);
+		}
+		return;
+	}
+
+	run_tasks(count, parallel_jobs(count, jobs), [&](int i) {
+		TraceScope trace_scope("task", trace_enabled() ? stringf("task %d", i) : std::string());
+		worker(i);
+	});
+}
+
+void parallel_for_scheduled(const std::vector<int> &schedule, const std::function<void(int)> &worker, int jobs)
+{
+	int count = GetSize(schedule);
+	if (plain_loop(jobs)) {
+		for (int i = 0; i < count; i++) {
+			TraceScope trace_scope("task", trace_enabled() ? stringf("task %d", i) : std::string());
+			worker(i);
+		}
+		return;
+	}
+
+	run_tasks(count, parallel_jobs(count, jobs), [&](int i) {
+		TraceScope trace_scope("task", trace_enabled() ? stringf("task %d", i) : std::string());
+		worker(i);
+	}, &schedule);
+}
+
+YOSYS_NAMESPACE_END
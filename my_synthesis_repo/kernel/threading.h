@@ -0,0 +1,76 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef THREADING_H
+#define THREADING_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Number of worker threads for module-parallel passes, set with the -j
+// command line option or the YOSYS_THREADS environment variable. 1 (the
+// default) runs everything on the main thread. All parallel_for*() calls
+// share one pool of that many threads; a task that calls parallel_for*()
+// itself runs the inner tasks in order on its own thread.
+extern int yosys_parallel_jobs;
+
+// 0 selects the number of CPU cores
+void set_parallel_jobs(int jobs);
+
+// Calls worker(module) for every module in the list, on up to
+// yosys_parallel_jobs threads. A pass may use this instead of a plain loop
+// over design->selected_modules() when its worker only reads and writes the
+// one module it is given (reading the design's selection is fine).
+//
+// With -j1 this is a plain loop over the modules. Otherwise the result does
+// not depend on the number of threads:
+//  - log output and warnings of each module are buffered and replayed in the
+//    order of the module list after all workers are done
+//  - NEW_ID and NEW_ID_SUFFIX count from the same start value in each module,
+//    and autoidx is moved past the largest value used afterwards (with -j1
+//    they count on from one module to the next, as in a serial pass)
+//  - the hash indices of the cells, wires etc. that a worker creates come
+//    from a sequence of its own, so pools and dicts of them iterate in the
+//    same order however the threads are scheduled
+//  - if workers fail, the error of the first failing module in list order is
+//    reported, after the log output of the modules before it
+//
+// Workers must not call log_header(), log_push()/log_pop() or use autoidx
+// directly. The modules run serially when Yosys is built without
+// YOSYS_ENABLE_THREADS, when -j is 1, or when the design has monitors.
+// A jobs value larger than 0 replaces yosys_parallel_jobs as the thread limit.
+void parallel_for_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules,
+		const std::function<void(RTLIL::Module*)> &worker, int jobs = 0);
+
+// Calls worker(i) for i = 0 .. count-1 with the same guarantees as
+// parallel_for_modules(), for tasks that do not touch any design, e.g.
+// frontends that build modules in a private RTLIL::Design per task. A jobs
+// value larger than 0 replaces yosys_parallel_jobs as the thread limit.
+void parallel_for(int count, const std::function<void(int)> &worker, int jobs = 0);
+
+// Like parallel_for() over schedule.size() tasks, but the tasks are handed
+// to the threads in the order of schedule, a permutation of the task
+// indices, e.g. longest task first. Log output is still replayed in task
+// index order, so the schedule only affects the run time.
+void parallel_for_scheduled(const std::vector<int> &schedule, const std::function<void(int)> &worker, int jobs = 0);
+
+YOSYS_NAMESPACE_END
+
+#endif
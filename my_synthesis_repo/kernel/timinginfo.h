@@ -22,6 +22,8 @@
 #define TIMINGINFO_H
 
 #include "kernel/yosys.h"
+#include <memory>
+#include <mutex>
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -47,14 +49,85 @@ struct TimingInfo
 		unsigned int hash() const { return mkhash_add(first.hash(), second.hash()); }
 	};
 
+	// A combinational path of a $specify2 cell between two bit ranges: with
+	// full set every src bit drives every dst bit, otherwise src bit i drives
+	// dst bit i and both ranges have src_width bits.
+	struct CombPath
+	{
+		NameBit src, dst;
+		int src_width, dst_width;
+		bool full;
+		int delay;
+
+		bool has_src(const NameBit &s, const NameBit &d) const {
+			if (s.name != src.name)
+				return false;
+			if (full)
+				return s.offset >= src.offset && s.offset < src.offset + src_width;
+			return s.offset - src.offset == d.offset - dst.offset;
+		}
+	};
+
 	struct ModuleTiming
 	{
-		dict<BitBit, int> comb;
+		std::vector<CombPath> comb_paths;
+		dict<NameBit, std::vector<int>> comb_by_dst;
 		dict<NameBit, std::pair<int,NameBit>> arrival, required;
-		bool has_inputs;
+		bool has_inputs = false;
+
+		bool comb_empty() const { return comb_paths.empty(); }
+
+		// delay from src to dst, or -1 if there is no combinational path
+		int comb_delay(const NameBit &src, const NameBit &dst) const {
+			auto it = comb_by_dst.find(dst);
+			if (it != comb_by_dst.end())
+				for (int i : it->second)
+					if (comb_paths[i].has_src(src, dst))
+						return comb_paths[i].delay;
+			return -1;
+		}
+
+		// all combinational paths, expanded to single bits
+		dict<BitBit, int> comb_bits() const {
+			dict<BitBit, int> bits;
+			for (auto &p : comb_paths)
+				for (int i = 0; i < p.src_width; i++)
+					for (int j = p.full ? 0 : i; j < (p.full ? p.dst_width : i+1); j++)
+						bits[BitBit(NameBit(p.src.name, p.src.offset + i), NameBit(p.dst.name, p.dst.offset + j))] = p.delay;
+			return bits;
+		}
+
+		void add_comb_path(RTLIL::Module *module, const CombPath &path) {
+			int index = GetSize(comb_paths);
+			for (int j = 0; j < path.dst_width; j++) {
+				NameBit d(path.dst.name, path.dst.offset + j);
+				auto &paths = comb_by_dst[d];
+				for (int i : paths) {
+					// first SRC bit of the new path that the other path already has for d
+					const CombPath &other = comb_paths[i];
+					int s = -1;
+					if (!path.full)
+						s = other.has_src(NameBit(path.src.name, path.src.offset + j), d) ? path.src.offset + j : -1;
+					else if (other.src.name != path.src.name)
+						s = -1;
+					else if (other.full)
+						s = std::max(path.src.offset, other.src.offset) < std::min(path.src.offset + path.src_width, other.src.offset + other.src_width) ?
+								std::max(path.src.offset, other.src.offset) : -1;
+					else {
+						int o = other.src.offset + d.offset - other.dst.offset;
+						s = o >= path.src.offset && o < path.src.offset + path.src_width ? o : -1;
+					}
+					if (s >= 0)
+						log_error("Module '%s' contains multiple specify cells for SRC '%s' and DST '%s'.\n", log_id(module),
+								log_signal(SigBit(module->wire(path.src.name), s)), log_signal(SigBit(module->wire(d.name), d.offset)));
+				}
+				paths.push_back(index);
+			}
+			comb_paths.push_back(path);
+		}
 	};
 
-	dict<RTLIL::IdString, ModuleTiming> data;
+	dict<RTLIL::IdString, std::shared_ptr<const ModuleTiming>> data;
 
 	TimingInfo()
 	{
@@ -78,7 +151,31 @@ struct TimingInfo
 	{
 		auto r = data.insert(module->name);
 		log_assert(r.second);
-		auto &t = r.first->second;
+		r.first->second = cached_module(module);
+		return *r.first->second;
+	}
+
+	// The parsed timing of a module, shared by all TimingInfo objects until
+	// the module changes.
+	static std::shared_ptr<const ModuleTiming> cached_module(RTLIL::Module *module)
+	{
+		static std::mutex cache_mutex;
+		static dict<unsigned int, std::pair<unsigned int, std::shared_ptr<const ModuleTiming>>> cache;
+
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = cache.find(module->hashidx_);
+		if (it != cache.end() && it->second.first == module->generation_)
+			return it->second.second;
+
+		std::shared_ptr<const ModuleTiming> t = parse_module(module);
+		cache[module->hashidx_] = std::make_pair(module->generation_, t);
+		return t;
+	}
+
+	static std::shared_ptr<const ModuleTiming> parse_module(RTLIL::Module *module)
+	{
+		std::shared_ptr<ModuleTiming> ptr = std::make_shared<ModuleTiming>();
+		auto &t = *ptr;
 
 		for (auto cell : module->cells()) {
 			if (cell->type == ID($specify2)) {
@@ -99,23 +196,20 @@ struct TimingInfo
 				if (max < 0)
 					log_error("Module '%s' contains specify cell '%s' with T_{RISE,FALL}_MAX < 0.\n", log_id(module), log_id(cell));
 				if (cell->getParam(ID::FULL).as_bool()) {
-					for (const auto &s : src)
-						for (const auto &d : dst) {
-							auto r = t.comb.insert(BitBit(s,d));
-							if (!r.second)
-								log_error("Module '%s' contains multiple specify cells for SRC '%s' and DST '%s'.\n", log_id(module), log_signal(s), log_signal(d));
-							r.first->second = max;
-						}
+					for (const auto &sc : src.chunks())
+						for (const auto &dc : dst.chunks())
+							t.add_comb_path(module, {NameBit(sc.wire->name, sc.offset), NameBit(dc.wire->name, dc.offset), sc.width, dc.width, true, max});
 				}
 				else {
 					log_assert(GetSize(src) == GetSize(dst));
-					for (auto i = 0; i < GetSize(src); i++) {
-						const auto &s = src[i];
-						const auto &d = dst[i];
-						auto r = t.comb.insert(BitBit(s,d));
-						if (!r.second)
-							log_error("Module '%s' contains multiple specify cells for SRC '%s' and DST '%s'.\n", log_id(module), log_signal(s), log_signal(d));
-						r.first->second = max;
+					// runs of bits that are consecutive in both SRC and DST
+					for (auto i = 0; i < GetSize(src); ) {
+						int n = 1;
+						while (i+n < GetSize(src) && src[i+n].wire == src[i].wire && src[i+n].offset == src[i].offset + n &&
+								dst[i+n].wire == dst[i].wire && dst[i+n].offset == dst[i].offset + n)
+							n++;
+						t.add_comb_path(module, {NameBit(src[i]), NameBit(dst[i]), n, n, false, max});
+						i += n;
 					}
 				}
 			}
@@ -178,13 +272,13 @@ struct TimingInfo
 			}
 		}
 
-		return t;
+		return ptr;
 	}
 
 	decltype(data)::const_iterator find(RTLIL::IdString module_name) const { return data.find(module_name); }
 	decltype(data)::const_iterator end() const { return data.end(); }
 	int count(RTLIL::IdString module_name) const { return data.count(module_name); }
-	const ModuleTiming& at(RTLIL::IdString module_name) const { return data.at(module_name); }
+	const ModuleTiming& at(RTLIL::IdString module_name) const { return *data.at(module_name); }
 };
 
 YOSYS_NAMESPACE_END
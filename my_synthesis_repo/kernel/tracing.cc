@@ -0,0 +1,144 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/tracing.h"
+
+#include <chrono>
+
+YOSYS_NAMESPACE_BEGIN
+
+FILE *yosys_trace_file = nullptr;
+
+static std::chrono::steady_clock::time_point trace_start;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex trace_mutex;
+static std::atomic<int> trace_next_tid{1};
+#else
+static int trace_next_tid = 1;
+#endif
+
+// per thread: trace tid (0 = not yet assigned) and the arguments of the open events
+static YS_THREAD_LOCAL int trace_tid = 0;
+static YS_THREAD_LOCAL std::vector<std::string> trace_open_args;
+
+static void json_escape(std::string &out, const std::string &str)
+{
+	out += '"';
+	for (unsigned char ch : str) {
+		if (ch == '"' || ch == '\\') {
+			out += '\\';
+			out += ch;
+		} else if (ch < 0x20) {
+			out += stringf("\\u%04x", ch);
+		} else
+			out += ch;
+	}
+	out += '"';
+}
+
+static double trace_timestamp_us()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - trace_start).count();
+}
+
+static void trace_write(const std::string &event)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(trace_mutex);
+#endif
+	if (yosys_trace_file != nullptr)
+		fprintf(yosys_trace_file, "%s,\n", event.c_str());
+}
+
+// assigns the thread its tid on first use and names it in the viewer
+static int current_tid()
+{
+	if (trace_tid == 0) {
+		trace_tid = trace_next_tid++;
+		std::string event = stringf("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", trace_tid);
+		json_escape(event, trace_tid == 1 ? "main" : stringf("worker %d", trace_tid - 1));
+		event += "}}";
+		trace_write(event);
+	}
+	return trace_tid;
+}
+
+void trace_open(const std::string &filename)
+{
+	trace_close();
+	yosys_trace_file = fopen(filename.c_str(), "wt");
+	if (yosys_trace_file == nullptr)
+		log_error("Can't open trace file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+	trace_start = std::chrono::steady_clock::now();
+	fprintf(yosys_trace_file, "[\n");
+	trace_write("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"yosys\"}}");
+}
+
+void trace_close()
+{
+	if (yosys_trace_file == nullptr)
+		return;
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(trace_mutex);
+#endif
+	// a final event without the trailing comma closes the array
+	fprintf(yosys_trace_file, "{\"ph\":\"i\",\"name\":\"end of trace\",\"s\":\"g\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}\n]\n",
+			trace_tid ? trace_tid : 1, trace_timestamp_us());
+	fclose(yosys_trace_file);
+	yosys_trace_file = nullptr;
+}
+
+void trace_begin(const char *category, const std::string &name)
+{
+	if (yosys_trace_file == nullptr)
+		return;
+	trace_open_args.emplace_back();
+
+	std::string event = "{\"ph\":\"B\",\"name\":";
+	json_escape(event, name);
+	event += stringf(",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}", category, current_tid(), trace_timestamp_us());
+	trace_write(event);
+}
+
+void trace_end()
+{
+	if (yosys_trace_file == nullptr || trace_open_args.empty())
+		return;
+
+	std::string event = stringf("{\"ph\":\"E\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", current_tid(), trace_timestamp_us());
+	if (!trace_open_args.back().empty())
+		event += ",\"args\":{" + trace_open_args.back() + "}";
+	event += "}";
+	trace_open_args.pop_back();
+	trace_write(event);
+}
+
+void trace_annotate(const std::string &key, const std::string &value)
+{
+	if (yosys_trace_file == nullptr || trace_open_args.empty())
+		return;
+	std::string &args = trace_open_args.back();
+	if (!args.empty())
+		args += ',';
+	json_escape(args, key);
+	args += ':';
+	json_escape(args, value);
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,64 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Execution timeline written with the -trace command line option, in the
+// Chrome trace event format (a JSON array of begin/end events) that
+// Perfetto and chrome://tracing load directly. Events nest per thread and
+// carry the thread they ran on: passes and ScriptPass labels on the main
+// thread, per-module tasks on the -j worker threads. The array is left open
+// between writes so a trace cut short by a crash still loads.
+extern FILE *yosys_trace_file;
+
+static inline bool trace_enabled() { return yosys_trace_file != nullptr; }
+
+void trace_open(const std::string &filename);
+void trace_close();
+
+// the category groups events in the viewer, e.g. "pass", "label", "abc"
+void trace_begin(const char *category, const std::string &name);
+void trace_end();
+
+// attaches an argument to the innermost open event of the calling thread
+void trace_annotate(const std::string &key, const std::string &value);
+
+struct TraceScope
+{
+	bool active;
+
+	TraceScope(const char *category, const std::string &name) : active(trace_enabled()) {
+		if (active)
+			trace_begin(category, name);
+	}
+
+	~TraceScope() {
+		if (active)
+			trace_end();
+	}
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
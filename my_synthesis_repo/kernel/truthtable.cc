@@ -0,0 +1,237 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/truthtable.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+static const uint64_t var_masks[6] = {
+	0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+	0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull,
+};
+
+static int num_words(int num_vars)
+{
+	return num_vars > 6 ? 1 << (num_vars - 6) : 1;
+}
+
+TruthTable::TruthTable(int num_vars, bool value) : num_vars(num_vars)
+{
+	log_assert(num_vars >= 0 && num_vars <= max_vars);
+	words.resize(num_words(num_vars), value ? ~uint64_t(0) : 0);
+}
+
+TruthTable TruthTable::var(int num_vars, int idx)
+{
+	log_assert(idx >= 0 && idx < num_vars);
+	TruthTable result(num_vars);
+	if (idx < 6) {
+		for (auto &word : result.words)
+			word = var_masks[idx];
+	} else {
+		int stride = 1 << (idx - 6);
+		for (int i = 0; i < GetSize(result.words); i++)
+			if (i & stride)
+				result.words[i] = ~uint64_t(0);
+	}
+	return result;
+}
+
+bool TruthTable::from_const(const RTLIL::Const &mask, int num_vars, TruthTable &result)
+{
+	if (num_vars > max_vars || GetSize(mask) != 1 << num_vars)
+		return false;
+	result = TruthTable(num_vars);
+	for (int i = 0; i < GetSize(mask); i++) {
+		if (mask[i] != State::S0 && mask[i] != State::S1)
+			return false;
+		if (mask[i] == State::S1)
+			result.words[i >> 6] |= uint64_t(1) << (i & 63);
+	}
+	if (num_vars < 6)
+		for (int i = 1 << num_vars; i < 64; i <<= 1)
+			result.words[0] |= result.words[0] << i;
+	return true;
+}
+
+RTLIL::Const TruthTable::to_const() const
+{
+	RTLIL::Const result(State::S0, 1 << num_vars);
+	for (int i = 0; i < GetSize(result); i++)
+		if (get(i))
+			result.bits[i] = State::S1;
+	return result;
+}
+
+void TruthTable::set(int index, bool value)
+{
+	// keep tables of less than six variables repeated
+	for (int i = index; i < (num_vars < 6 ? 64 : index + 1); i += 1 << num_vars) {
+		uint64_t bit = uint64_t(1) << (i & 63);
+		if (value)
+			words[i >> 6] |= bit;
+		else
+			words[i >> 6] &= ~bit;
+	}
+}
+
+bool TruthTable::is_const(bool value) const
+{
+	uint64_t expected = value ? ~uint64_t(0) : 0;
+	for (auto word : words)
+		if (word != expected)
+			return false;
+	return true;
+}
+
+unsigned int TruthTable::hash() const
+{
+	unsigned int h = mkhash_init;
+	h = mkhash(h, num_vars);
+	for (auto word : words)
+		h = mkhash(h, hash_ops<uint64_t>::hash(word));
+	return h;
+}
+
+TruthTable TruthTable::operator~() const
+{
+	TruthTable result = *this;
+	for (auto &word : result.words)
+		word = ~word;
+	return result;
+}
+
+TruthTable TruthTable::operator&(const TruthTable &other) const
+{
+	log_assert(num_vars == other.num_vars);
+	TruthTable result = *this;
+	for (int i = 0; i < GetSize(words); i++)
+		result.words[i] &= other.words[i];
+	return result;
+}
+
+TruthTable TruthTable::operator|(const TruthTable &other) const
+{
+	log_assert(num_vars == other.num_vars);
+	TruthTable result = *this;
+	for (int i = 0; i < GetSize(words); i++)
+		result.words[i] |= other.words[i];
+	return result;
+}
+
+TruthTable TruthTable::operator^(const TruthTable &other) const
+{
+	log_assert(num_vars == other.num_vars);
+	TruthTable result = *this;
+	for (int i = 0; i < GetSize(words); i++)
+		result.words[i] ^= other.words[i];
+	return result;
+}
+
+TruthTable TruthTable::mux(const TruthTable &s, const TruthTable &a, const TruthTable &b)
+{
+	log_assert(s.num_vars == a.num_vars && s.num_vars == b.num_vars);
+	TruthTable result = a;
+	for (int i = 0; i < GetSize(result.words); i++)
+		result.words[i] = (s.words[i] & b.words[i]) | (~s.words[i] & a.words[i]);
+	return result;
+}
+
+TruthTable TruthTable::cofactor(int idx, bool value) const
+{
+	log_assert(idx >= 0 && idx < num_vars);
+	TruthTable result = *this;
+	if (idx < 6) {
+		int shift = 1 << idx;
+		for (auto &word : result.words) {
+			if (value) {
+				uint64_t hi = word & var_masks[idx];
+				word = hi | (hi >> shift);
+			} else {
+				uint64_t lo = word & ~var_masks[idx];
+				word = lo | (lo << shift);
+			}
+		}
+	} else {
+		int stride = 1 << (idx - 6);
+		for (int i = 0; i < GetSize(result.words); i++)
+			if (!(i & stride)) {
+				uint64_t word = value ? words[i + stride] : words[i];
+				result.words[i] = word;
+				result.words[i + stride] = word;
+			}
+	}
+	return result;
+}
+
+std::vector<int> TruthTable::support() const
+{
+	std::vector<int> result;
+	for (int i = 0; i < num_vars; i++)
+		if (depends_on(i))
+			result.push_back(i);
+	return result;
+}
+
+TruthTable TruthTable::permute(const std::vector<int> &perm, int new_num_vars) const
+{
+	log_assert(GetSize(perm) == num_vars);
+	std::vector<TruthTable> inputs;
+	for (int p : perm) {
+		if (p >= 0)
+			inputs.push_back(var(new_num_vars, p));
+		else
+			inputs.push_back(TruthTable(new_num_vars, p == -2));
+	}
+	return lut(*this, inputs);
+}
+
+TruthTable TruthTable::lut(const TruthTable &mask, const std::vector<TruthTable> &inputs)
+{
+	log_assert(GetSize(inputs) == mask.num_vars);
+	int result_vars = inputs.empty() ? 0 : inputs.front().num_vars;
+
+	if (inputs.empty())
+		return TruthTable(0, mask.get(0));
+
+	// Shannon expansion, one input at a time: after step i, entry j is the
+	// function selected by the remaining inputs having the value j.
+	std::vector<TruthTable> level;
+	for (int j = 0; j < 1 << (mask.num_vars - 1); j++) {
+		bool lo = mask.get(2*j), hi = mask.get(2*j + 1);
+		if (lo == hi)
+			level.push_back(TruthTable(result_vars, lo));
+		else if (hi)
+			level.push_back(inputs[0]);
+		else
+			level.push_back(~inputs[0]);
+	}
+
+	for (int i = 1; i < GetSize(inputs); i++) {
+		std::vector<TruthTable> next;
+		for (int j = 0; j < GetSize(level); j += 2)
+			next.push_back(level[j] == level[j+1] ? level[j] : mux(inputs[i], level[j], level[j+1]));
+		level.swap(next);
+	}
+
+	log_assert(GetSize(level) == 1);
+	return level.front();
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,85 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TRUTHTABLE_H
+#define TRUTHTABLE_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// The truth table of a boolean function of up to max_vars variables, stored
+// in 64-bit words. Bit i of the table is the value of the function for the
+// input assignment i, with variable 0 as the least significant bit of i.
+// Tables of less than six variables are repeated to fill one word, so that
+// every operation works on whole words; the loops over the words are simple
+// enough for the compiler to vectorize.
+struct TruthTable
+{
+	static const int max_vars = 16;
+
+	int num_vars;
+	std::vector<uint64_t> words;
+
+	TruthTable(int num_vars = 0, bool value = false);
+
+	// The projection function of variable idx.
+	static TruthTable var(int num_vars, int idx);
+
+	// Converts from and to a LUT mask. Fails for masks that do not have
+	// exactly 2^num_vars bits or that contain x or z bits.
+	static bool from_const(const RTLIL::Const &mask, int num_vars, TruthTable &result);
+	RTLIL::Const to_const() const;
+
+	bool get(int index) const { return (words[index >> 6] >> (index & 63)) & 1; }
+	void set(int index, bool value);
+
+	bool is_const(bool value) const;
+	bool operator==(const TruthTable &other) const { return num_vars == other.num_vars && words == other.words; }
+	bool operator!=(const TruthTable &other) const { return !(*this == other); }
+	unsigned int hash() const;
+
+	TruthTable operator~() const;
+	TruthTable operator&(const TruthTable &other) const;
+	TruthTable operator|(const TruthTable &other) const;
+	TruthTable operator^(const TruthTable &other) const;
+
+	// Returns s ? b : a.
+	static TruthTable mux(const TruthTable &s, const TruthTable &a, const TruthTable &b);
+
+	// The function with variable idx fixed to value (it still has num_vars
+	// variables, but no longer depends on idx).
+	TruthTable cofactor(int idx, bool value) const;
+	bool depends_on(int idx) const { return cofactor(idx, false) != cofactor(idx, true); }
+	std::vector<int> support() const;
+
+	// Returns the function g of new_num_vars variables with g(x) = f(y),
+	// where bit i of y is bit perm[i] of x, or constant 0 (perm[i] == -1) or
+	// constant 1 (perm[i] == -2).
+	TruthTable permute(const std::vector<int> &perm, int new_num_vars) const;
+
+	// Returns the function computed by a LUT with the given mask, when its
+	// inputs are driven by the given functions (which must all have the
+	// same number of variables).
+	static TruthTable lut(const TruthTable &mask, const std::vector<TruthTable> &inputs);
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
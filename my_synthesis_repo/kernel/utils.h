@@ -21,6 +21,7 @@
 // do not depend on any other components of yosys (except stuff like log_*).
 
 #include "kernel/yosys.h"
+#include <queue>
 
 #ifndef UTILS_H
 #define UTILS_H
@@ -215,44 +216,263 @@ template <typename T, typename C = std::less<T>, typename OPS = hash_ops<T>> cla
 	std::vector<T> nodes;
 	const IndirectCmp indirect_cmp;
 
+	// depth first search with an explicit stack, so that long chains do not
+	// overflow the call stack; visits the nodes in the same order as the
+	// recursive formulation
 	void sort_worker(const int root_index, std::vector<bool> &marked_cells, std::vector<bool> &active_cells, std::vector<int> &active_stack)
 	{
-		if (active_cells[root_index]) {
-			found_loops = true;
-			if (analyze_loops) {
-				std::vector<T> loop;
-				for (int i = GetSize(active_stack) - 1; i >= 0; i--) {
-					const int index = active_stack[i];
-					loop.push_back(nodes[index]);
-					if (index == root_index)
-						break;
+		typedef typename std::set<int, IndirectCmp>::const_iterator edge_iter;
+		std::vector<std::pair<int, edge_iter>> call_stack;
+
+		auto enter = [&](int index) {
+			if (active_cells[index]) {
+				found_loops = true;
+				if (analyze_loops) {
+					std::vector<T> loop;
+					for (int i = GetSize(active_stack) - 1; i >= 0; i--) {
+						const int stack_index = active_stack[i];
+						loop.push_back(nodes[stack_index]);
+						if (stack_index == index)
+							break;
+					}
+					loops.insert(loop);
 				}
-				loops.insert(loop);
+				return;
 			}
-			return;
-		}
 
-		if (marked_cells[root_index])
-			return;
+			if (marked_cells[index])
+				return;
 
-		if (!edges[root_index].empty()) {
-			if (analyze_loops)
-				active_stack.push_back(root_index);
-			active_cells[root_index] = true;
+			if (edges[index].empty()) {
+				marked_cells[index] = true;
+				sorted.push_back(nodes[index]);
+				return;
+			}
 
-			for (int left_n : edges[root_index])
-				sort_worker(left_n, marked_cells, active_cells, active_stack);
+			if (analyze_loops)
+				active_stack.push_back(index);
+			active_cells[index] = true;
+			call_stack.emplace_back(index, edges[index].begin());
+		};
+
+		enter(root_index);
+
+		while (!call_stack.empty()) {
+			int index = call_stack.back().first;
+			edge_iter &it = call_stack.back().second;
+			if (it != edges[index].end()) {
+				int left_n = *it++;
+				enter(left_n);
+				continue;
+			}
 
+			call_stack.pop_back();
 			if (analyze_loops)
 				active_stack.pop_back();
-			active_cells[root_index] = false;
+			active_cells[index] = false;
+			marked_cells[index] = true;
+			sorted.push_back(nodes[index]);
 		}
+	}
+};
+
+
+// ------------------------------------------------
+// Compact graphs: SCCs, topological order, longest paths
+// ------------------------------------------------
 
-		marked_cells[root_index] = true;
-		sorted.push_back(nodes[root_index]);
+// A directed graph over the nodes 0 .. num_nodes()-1 in compressed sparse
+// row form: the successors of node i are targets[first[i]] ..
+// targets[first[i+1]-1], in the order the edges were added.
+struct CsrGraph
+{
+	std::vector<int> first, targets;
+
+	CsrGraph() : first(1, 0) { }
+
+	CsrGraph(int num_nodes, const std::vector<std::pair<int, int>> &edges) : first(num_nodes + 1, 0), targets(GetSize(edges))
+	{
+		for (auto &e : edges)
+			first[e.first + 1]++;
+		for (int i = 0; i < num_nodes; i++)
+			first[i + 1] += first[i];
+		std::vector<int> pos(first.begin(), first.end() - 1);
+		for (auto &e : edges)
+			targets[pos[e.first]++] = e.second;
 	}
+
+	int num_nodes() const { return GetSize(first) - 1; }
 };
 
+// Tarjan's algorithm with an explicit stack. Appends the components to sccs
+// in the order they are completed, which is a reverse topological order of
+// the condensed graph; the nodes of each component are listed in the order
+// they are popped from the Tarjan stack. Single nodes are only reported with
+// include_trivial, whether or not they have a self loop.
+//
+// With max_depth >= 0 an edge back to a node on the stack only closes a
+// loop if that node was entered less than max_depth levels up in the depth
+// first search (limited to loops of up to max_depth nodes along the search
+// path, as used by "scc -max_depth").
+inline void find_sccs(const CsrGraph &graph, std::vector<std::vector<int>> &sccs, bool include_trivial = false, int max_depth = -1)
+{
+	int num_nodes = graph.num_nodes();
+	std::vector<int> index(num_nodes, -1), lowlink(num_nodes), depth(num_nodes);
+	std::vector<bool> on_stack(num_nodes, false);
+	std::vector<int> stack;
+	std::vector<std::pair<int, int>> call_stack;
+	int counter = 0;
+
+	auto enter = [&](int node, int node_depth) {
+		index[node] = lowlink[node] = counter++;
+		depth[node] = node_depth;
+		stack.push_back(node);
+		on_stack[node] = true;
+		call_stack.emplace_back(node, graph.first[node]);
+	};
+
+	for (int root = 0; root < num_nodes; root++)
+	{
+		if (index[root] >= 0)
+			continue;
+
+		enter(root, 0);
+
+		while (!call_stack.empty())
+		{
+			int node = call_stack.back().first;
+			int &pos = call_stack.back().second;
+
+			if (pos < graph.first[node + 1]) {
+				int next = graph.targets[pos++];
+				if (index[next] < 0)
+					enter(next, depth[node] + 1);
+				else if (on_stack[next] && (max_depth < 0 || depth[next] + max_depth > depth[node]))
+					lowlink[node] = std::min(lowlink[node], lowlink[next]);
+				continue;
+			}
+
+			call_stack.pop_back();
+			if (!call_stack.empty()) {
+				int parent = call_stack.back().first;
+				lowlink[parent] = std::min(lowlink[parent], lowlink[node]);
+			}
+
+			if (lowlink[node] != index[node])
+				continue;
+
+			if (stack.back() == node && !include_trivial) {
+				stack.pop_back();
+				on_stack[node] = false;
+				continue;
+			}
+
+			sccs.emplace_back();
+			while (on_stack[node]) {
+				int n = stack.back();
+				stack.pop_back();
+				on_stack[n] = false;
+				sccs.back().push_back(n);
+			}
+		}
+	}
+}
+
+// Kahn's algorithm, picking the smallest ready node first, so the order only
+// depends on the node numbering. When nodes on loops keep the remaining
+// nodes from getting ready, the smallest of them is emitted anyway and its
+// loop is cut there. Returns false if that was necessary.
+inline bool topological_order(const CsrGraph &graph, std::vector<int> &order)
+{
+	int num_nodes = graph.num_nodes();
+	std::vector<int> indegree(num_nodes, 0);
+	std::vector<bool> done(num_nodes, false);
+	for (int target : graph.targets)
+		indegree[target]++;
+
+	std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+	for (int i = 0; i < num_nodes; i++)
+		if (indegree[i] == 0)
+			ready.push(i);
+
+	order.clear();
+	order.reserve(num_nodes);
+	bool acyclic = true;
+	int next_unsorted = 0;
+
+	while (GetSize(order) < num_nodes)
+	{
+		int node;
+		if (!ready.empty()) {
+			node = ready.top();
+			ready.pop();
+			if (done[node])
+				continue;
+		} else {
+			while (done[next_unsorted])
+				next_unsorted++;
+			node = next_unsorted;
+			acyclic = false;
+		}
+
+		done[node] = true;
+		order.push_back(node);
+		for (int e = graph.first[node]; e < graph.first[node + 1]; e++) {
+			int target = graph.targets[e];
+			if (!done[target] && --indegree[target] == 0)
+				ready.push(target);
+		}
+	}
+
+	return acyclic;
+}
+
+// Length of the longest path ending in each node, in edges, following the
+// given topological order (edges going backwards in it are ignored, which
+// cuts the loops). If pred is given, it receives the previous node on that
+// path, or -1 for nodes without predecessor.
+inline void longest_paths(const CsrGraph &graph, const std::vector<int> &order, std::vector<int> &length, std::vector<int> *pred = nullptr)
+{
+	int num_nodes = graph.num_nodes();
+	std::vector<int> position(num_nodes);
+	for (int i = 0; i < GetSize(order); i++)
+		position[order[i]] = i;
+
+	length.assign(num_nodes, 0);
+	if (pred)
+		pred->assign(num_nodes, -1);
+
+	for (int node : order)
+		for (int e = graph.first[node]; e < graph.first[node + 1]; e++) {
+			int target = graph.targets[e];
+			if (position[target] <= position[node] || length[target] > length[node])
+				continue;
+			length[target] = length[node] + 1;
+			if (pred)
+				(*pred)[target] = node;
+		}
+}
+
+// Marks all nodes reachable from the roots, including the roots.
+inline void fanout_cone(const CsrGraph &graph, const std::vector<int> &roots, std::vector<bool> &in_cone)
+{
+	in_cone.assign(graph.num_nodes(), false);
+	std::vector<int> queue;
+	for (int root : roots)
+		if (!in_cone[root]) {
+			in_cone[root] = true;
+			queue.push_back(root);
+		}
+	for (int k = 0; k < GetSize(queue); k++) {
+		int node = queue[k];
+		for (int e = graph.first[node]; e < graph.first[node + 1]; e++)
+			if (!in_cone[graph.targets[e]]) {
+				in_cone[graph.targets[e]] = true;
+				queue.push_back(graph.targets[e]);
+			}
+	}
+}
+
 YOSYS_NAMESPACE_END
 
 #endif
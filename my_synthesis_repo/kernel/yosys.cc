@@ -51,6 +51,16 @@
 #  endif
 #endif
 
+#if !defined(_WIN32) && !defined(__wasm)
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  if !defined(YOSYS_DISABLE_SPAWN)
+#    include <spawn.h>
+extern char **environ;
+#  endif
+#endif
+
 #if !defined(_WIN32) && defined(YOSYS_ENABLE_GLOB)
 #  include <glob.h>
 #endif
@@ -83,6 +93,8 @@ YOSYS_NAMESPACE_BEGIN
 	bool flag_is_pb_file=false;
 #endif
 int autoidx = 1;
+YS_THREAD_LOCAL int *autoidx_local = nullptr;
+YS_THREAD_LOCAL unsigned int *hashidx_local = nullptr;
 int yosys_xtrace = 0;
 RTLIL::Design *yosys_design = NULL;
 CellTypes yosys_celltypes;
@@ -296,21 +308,194 @@ bool patmatch(const char *pattern, const char *string)
 }
 
 #if !defined(YOSYS_DISABLE_SPAWN)
+#if !defined(_WIN32) && !defined(__wasm)
+// Starts argv[0] with posix_spawnp(), which avoids copying the page tables of
+// a large process like fork() does, and reads its stdout (and stderr with
+// merge_stderr) line by line. With channel_data the child also gets the
+// write end of a pipe as file descriptor 3, see run_command_channel().
+static int spawn_command(const std::vector<std::string> &argv, bool merge_stderr,
+		std::function<void(const std::string&)> process_line, std::string *channel_data)
+{
+	int out_pipe[2], chan_pipe[2] = {-1, -1};
+	if (pipe(out_pipe) < 0)
+		return -1;
+	if (channel_data != nullptr && pipe(chan_pipe) < 0) {
+		close(out_pipe[0]);
+		close(out_pipe[1]);
+		return -1;
+	}
+
+	// children of other threads must not keep the write ends open
+	for (int fd : {out_pipe[0], out_pipe[1], chan_pipe[0], chan_pipe[1]})
+		if (fd >= 0)
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	// the dup2() actions clear FD_CLOEXEC on the new descriptors
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+	if (merge_stderr)
+		posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 2);
+	if (channel_data != nullptr)
+		posix_spawn_file_actions_adddup2(&actions, chan_pipe[1], 3);
+
+	std::vector<char*> args;
+	for (auto &arg : argv)
+		args.push_back(const_cast<char*>(arg.c_str()));
+	args.push_back(nullptr);
+
+	fflush(stdout);
+	fflush(stderr);
+
+	pid_t pid;
+	int err = posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	close(out_pipe[1]);
+	if (chan_pipe[1] >= 0)
+		close(chan_pipe[1]);
+	if (err != 0) {
+		close(out_pipe[0]);
+		if (chan_pipe[0] >= 0)
+			close(chan_pipe[0]);
+		return -1;
+	}
+
+	std::string line;
+	char buffer[4096];
+#ifdef HYBRDLINK
+	bool skip_line = true;  // To skip the first line of ABC log
+#endif
+
+	struct pollfd fds[2];
+	fds[0].fd = out_pipe[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = chan_pipe[0];
+	fds[1].events = POLLIN;
+	int open_fds = chan_pipe[0] >= 0 ? 2 : 1;
+
+	while (open_fds > 0)
+	{
+		int ready;
+		{
+			JobContextYield yield;
+			ready = poll(fds, 2, -1);
+		}
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (int i = 0; i < 2; i++) {
+			if (fds[i].fd < 0 || fds[i].revents == 0)
+				continue;
+			ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				open_fds--;
+				continue;
+			}
+			if (i == 1) {
+				channel_data->append(buffer, n);
+				continue;
+			}
+			for (ssize_t k = 0; k < n; k++) {
+				line += buffer[k];
+				if (buffer[k] != '\n')
+					continue;
+#ifdef HYBRDLINK
+				if (skip_line)
+					skip_line = false;
+				else
+#endif
+					process_line(line);
+				line.clear();
+			}
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+		if (fds[i].fd >= 0)
+			close(fds[i].fd);
+
+	if (!line.empty())
+		process_line(line);
+
+	int status;
+	JobContextYield yield;
+	while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
+
+#ifdef _WIN32
+static std::wstring utf8_to_wide(const std::string &str)
+{
+	int len = MultiByteToWideChar(CP_UTF8, 0, str.data(), GetSize(str), nullptr, 0);
+	std::wstring result(len, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, str.data(), GetSize(str), &result[0], len);
+	return result;
+}
+
+// quotes one argument so that CommandLineToArgvW() (and the C runtime) parse
+// it back unchanged
+static void append_quoted_arg(std::wstring &cmdline, const std::wstring &arg)
+{
+	if (!cmdline.empty())
+		cmdline += L' ';
+	if (!arg.empty() && arg.find_first_of(L" \t\n\v\"") == std::wstring::npos) {
+		cmdline += arg;
+		return;
+	}
+	cmdline += L'"';
+	for (size_t i = 0; ; i++) {
+		size_t backslashes = 0;
+		while (i < arg.size() && arg[i] == L'\\')
+			i++, backslashes++;
+		if (i == arg.size()) {
+			cmdline.append(2 * backslashes, L'\\');
+			break;
+		}
+		if (arg[i] == L'"')
+			cmdline.append(2 * backslashes + 1, L'\\');
+		else
+			cmdline.append(backslashes, L'\\');
+		cmdline += arg[i];
+	}
+	cmdline += L'"';
+}
+#endif
+
 int run_command(const std::string &command, std::function<void(const std::string&)> process_line)
 {
-	if (!process_line)
+	if (!process_line) {
+		JobContextYield yield;
 		return system(command.c_str());
+	}
 
+#if !defined(_WIN32) && !defined(__wasm)
+	return spawn_command({"/bin/sh", "-c", command}, false, process_line, nullptr);
+#else
 	FILE *f = popen(command.c_str(), "r");
 	if (f == nullptr)
 		return -1;
 
 	std::string line;
 	char logbuf[128];
+	auto read_chunk = [&]() {
+		JobContextYield yield;
+		return fgets(logbuf, 128, f) != NULL;
+	};
 
 #ifdef HYBRDLINK
 	int counter = 0;  // To skip the first line of ABC log if counter == 0
-	while (fgets(logbuf, 128, f) != NULL) {
+	while (read_chunk()) {
 		if (counter == 0)
 		{
 			counter++;
@@ -321,7 +506,7 @@ int run_command(const std::string &command, std::function<void(const std::string
 			process_line(line), line.clear();
 	}
 #else
-	while (fgets(logbuf, 128, f) != NULL) {
+	while (read_chunk()) {
 		line += logbuf;
 		if (!line.empty() && line.back() == '\n')
 			process_line(line), line.clear();
@@ -332,7 +517,11 @@ int run_command(const std::string &command, std::function<void(const std::string
 	if (!line.empty())
 		process_line(line);
 
-	int ret = pclose(f);
+	int ret;
+	{
+		JobContextYield yield;
+		ret = pclose(f);
+	}
 	if (ret < 0)
 		return -1;
 #ifdef _WIN32
@@ -340,7 +529,145 @@ int run_command(const std::string &command, std::function<void(const std::string
 #else
 	return WEXITSTATUS(ret);
 #endif
+#endif
 }
+
+int run_command_argv(const std::vector<std::string> &argv, std::function<void(const std::string&)> process_line)
+{
+	log_assert(!argv.empty());
+
+#if defined(_WIN32)
+	std::wstring cmdline;
+	for (auto &arg : argv)
+		append_quoted_arg(cmdline, utf8_to_wide(arg));
+
+	SECURITY_ATTRIBUTES sa = {};
+	sa.nLength = sizeof(sa);
+	sa.bInheritHandle = TRUE;
+
+	HANDLE read_handle = nullptr, write_handle = nullptr;
+	if (process_line) {
+		if (!CreatePipe(&read_handle, &write_handle, &sa, 0))
+			return -1;
+		SetHandleInformation(read_handle, HANDLE_FLAG_INHERIT, 0);
+	}
+
+	// only the pipe is inherited, so that children started by other threads
+	// at the same time do not keep its write end open
+	SIZE_T attr_size = 0;
+	InitializeProcThreadAttributeList(nullptr, 1, 0, &attr_size);
+	std::vector<char> attr_buffer(attr_size);
+	auto attr_list = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attr_buffer.data());
+	InitializeProcThreadAttributeList(attr_list, 1, 0, &attr_size);
+
+	STARTUPINFOEXW si = {};
+	si.StartupInfo.cb = sizeof(si);
+	if (process_line) {
+		UpdateProcThreadAttribute(attr_list, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &write_handle, sizeof(HANDLE), nullptr, nullptr);
+		si.lpAttributeList = attr_list;
+		si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+		si.StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		si.StartupInfo.hStdOutput = write_handle;
+		si.StartupInfo.hStdError = write_handle;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	PROCESS_INFORMATION pi = {};
+	BOOL ok = CreateProcessW(nullptr, &cmdline[0], nullptr, nullptr, process_line ? TRUE : FALSE,
+			process_line ? EXTENDED_STARTUPINFO_PRESENT : 0, nullptr, nullptr, &si.StartupInfo, &pi);
+	DeleteProcThreadAttributeList(attr_list);
+	if (write_handle != nullptr)
+		CloseHandle(write_handle);
+	if (!ok) {
+		if (read_handle != nullptr)
+			CloseHandle(read_handle);
+		return -1;
+	}
+	CloseHandle(pi.hThread);
+
+	if (process_line) {
+		std::string line;
+		char buffer[4096];
+		DWORD n;
+#ifdef HYBRDLINK
+		bool skip_line = true;  // To skip the first line of ABC log
+#endif
+		while (true) {
+			{
+				JobContextYield yield;
+				if (!ReadFile(read_handle, buffer, sizeof(buffer), &n, nullptr) || n == 0)
+					break;
+			}
+			for (DWORD k = 0; k < n; k++) {
+				line += buffer[k];
+				if (buffer[k] != '\n')
+					continue;
+#ifdef HYBRDLINK
+				if (skip_line)
+					skip_line = false;
+				else
+#endif
+					process_line(line);
+				line.clear();
+			}
+		}
+		CloseHandle(read_handle);
+		if (!line.empty())
+			process_line(line);
+	}
+
+	DWORD exit_code = 0;
+	{
+		JobContextYield yield;
+		WaitForSingleObject(pi.hProcess, INFINITE);
+	}
+	if (!GetExitCodeProcess(pi.hProcess, &exit_code))
+		exit_code = DWORD(-1);
+	CloseHandle(pi.hProcess);
+	return int(exit_code);
+#elif !defined(__wasm)
+	if (!process_line) {
+		// without a reader the output goes straight to our stdout
+		std::vector<char*> args;
+		for (auto &arg : argv)
+			args.push_back(const_cast<char*>(arg.c_str()));
+		args.push_back(nullptr);
+		fflush(stdout);
+		fflush(stderr);
+		pid_t pid;
+		if (posix_spawnp(&pid, args[0], nullptr, nullptr, args.data(), environ) != 0)
+			return -1;
+		int status;
+		JobContextYield yield;
+		while (waitpid(pid, &status, 0) < 0)
+			if (errno != EINTR)
+				return -1;
+		return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	}
+	return spawn_command(argv, true, process_line, nullptr);
+#else
+	std::string command;
+	for (auto &arg : argv) {
+		if (!command.empty())
+			command += ' ';
+		command += '\'';
+		for (char c : arg)
+			command += c == '\'' ? std::string("'\\''") : std::string(1, c);
+		command += '\'';
+	}
+	return run_command(command + " 2>&1", process_line);
+#endif
+}
+
+#if !defined(_WIN32) && !defined(__wasm)
+int run_command_channel(const std::vector<std::string> &argv, std::function<void(const std::string&)> process_line, std::string &channel_data)
+{
+	log_assert(!argv.empty());
+	return spawn_command(argv, true, process_line, &channel_data);
+}
+#endif
 #endif
 
 std::string get_base_tmpdir()
@@ -482,10 +809,104 @@ bool is_absolute_path(std::string filename)
 #endif
 }
 
+bool MappedFile::map(const std::string &filename)
+{
+	log_assert(data == nullptr);
+#if defined(_WIN32)
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = handle;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(handle, &file_size) || file_size.QuadPart == 0)
+		return false;
+	mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+		return false;
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+		return false;
+	size = file_size.QuadPart;
+	return true;
+#elif defined(__wasm)
+	// no mmap() in WASI, read the file into memory instead
+	FILE *f = fopen(filename.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	struct stat st;
+	if (fstat(fileno(f), &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		fclose(f);
+		return false;
+	}
+	char *buffer = (char*)malloc(st.st_size);
+	size_t rc = fread(buffer, 1, st.st_size, f);
+	fclose(f);
+	if (rc != size_t(st.st_size)) {
+		free(buffer);
+		return false;
+	}
+	data = buffer;
+	size = st.st_size;
+	return true;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+	void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED)
+		return false;
+	data = (const char*)ptr;
+	size = st.st_size;
+	return true;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+	if (data != nullptr)
+		UnmapViewOfFile(data);
+	if (mapping != nullptr)
+		CloseHandle(mapping);
+	if (file != nullptr)
+		CloseHandle(file);
+#elif defined(__wasm)
+	free((void*)data);
+#else
+	if (data != nullptr)
+		munmap((void*)data, size);
+#endif
+}
+
 void remove_directory(std::string dirname)
 {
 #ifdef _WIN32
-	run_command(stringf("rmdir /s /q \"%s\"", dirname.c_str()));
+	// deleting in place instead of starting "rmdir /s /q" through cmd.exe
+	WIN32_FIND_DATAA data;
+	HANDLE handle = FindFirstFileA((dirname + "\\*").c_str(), &data);
+	if (handle != INVALID_HANDLE_VALUE) {
+		do {
+			std::string name = data.cFileName;
+			if (name == "." || name == "..")
+				continue;
+			std::string buffer = dirname + "\\" + name;
+			if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				remove_directory(buffer);
+			} else {
+				if (data.dwFileAttributes & FILE_ATTRIBUTE_READONLY)
+					SetFileAttributesA(buffer.c_str(), FILE_ATTRIBUTE_NORMAL);
+				DeleteFileA(buffer.c_str());
+			}
+		} while (FindNextFileA(handle, &data));
+		FindClose(handle);
+	}
+	RemoveDirectoryA(dirname.c_str());
 #else
 	struct stat stbuf;
 	struct dirent **namelist;
@@ -609,8 +1030,10 @@ void yosys_shutdown()
 	yosys_design = NULL;
 
 	for (auto f : log_files)
-		if (f != stderr)
+		if (f != stderr) {
+			log_file_sync(f);
 			fclose(f);
+		}
 	log_errfile = NULL;
 	log_files.clear();
 
@@ -642,7 +1065,12 @@ void yosys_shutdown()
 #endif
 }
 
-RTLIL::IdString new_id(std::string file, int line, std::string func)
+int next_autoidx()
+{
+	return autoidx_local ? (*autoidx_local)++ : autoidx++;
+}
+
+std::string new_id_prefix(std::string file, int line, std::string func)
 {
 #ifdef _WIN32
 	size_t pos = file.find_last_of("/\\");
@@ -656,7 +1084,12 @@ RTLIL::IdString new_id(std::string file, int line, std::string func)
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
-	return stringf("$auto$%s:%d:%s$%d", file.c_str(), line, func.c_str(), autoidx++);
+	return stringf("$auto$%s:%d:%s$", file.c_str(), line, func.c_str());
+}
+
+RTLIL::IdString new_id(std::string file, int line, std::string func)
+{
+	return new_id_prefix(file, line, func) + std::to_string(next_autoidx());
 }
 
 RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std::string suffix)
@@ -673,7 +1106,7 @@ RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std:
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
-	return stringf("$auto$%s:%d:%s$%s$%d", file.c_str(), line, func.c_str(), suffix.c_str(), autoidx++);
+	return stringf("$auto$%s:%d:%s$%s$%d", file.c_str(), line, func.c_str(), suffix.c_str(), next_autoidx());
 }
 
 RTLIL::Design *yosys_get_design()
@@ -681,6 +1114,69 @@ RTLIL::Design *yosys_get_design()
 	return yosys_design;
 }
 
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex job_kernel_mutex;
+#endif
+static YS_THREAD_LOCAL JobContext *job_current = nullptr;
+static YS_THREAD_LOCAL int job_yield_depth = 0;
+
+// exchanges the job state with the globals, so that entering and leaving
+// restores whatever the globals held before
+static void job_context_swap(JobContext *ctx)
+{
+	std::swap(yosys_design, ctx->design);
+	std::swap(saved_designs, ctx->saved_designs);
+	std::swap(pushed_designs, ctx->pushed_designs);
+	std::swap(log_files, ctx->log_files);
+	std::swap(log_streams, ctx->log_streams);
+	std::swap(header_count, ctx->header_count);
+	std::swap(current_pass, ctx->current_pass);
+	std::swap(log_warnings_count, ctx->log_warnings_count);
+	std::swap(Common::g_job_id, ctx->job_id);
+}
+
+void job_context_enter(JobContext *ctx)
+{
+	log_assert(job_current == nullptr);
+#ifdef YOSYS_ENABLE_THREADS
+	job_kernel_mutex.lock();
+#endif
+	job_context_swap(ctx);
+	job_current = ctx;
+}
+
+void job_context_leave(JobContext *ctx)
+{
+	log_assert(job_current == ctx);
+	job_current = nullptr;
+	job_context_swap(ctx);
+#ifdef YOSYS_ENABLE_THREADS
+	job_kernel_mutex.unlock();
+#endif
+}
+
+JobContextYield::JobContextYield() : ctx(job_yield_depth > 0 ? job_current : nullptr)
+{
+	if (ctx != nullptr)
+		job_context_leave(ctx);
+}
+
+JobContextYield::~JobContextYield()
+{
+	if (ctx != nullptr)
+		job_context_enter(ctx);
+}
+
+JobYieldScope::JobYieldScope()
+{
+	job_yield_depth++;
+}
+
+JobYieldScope::~JobYieldScope()
+{
+	job_yield_depth--;
+}
+
 const char *create_prompt(RTLIL::Design *design, int recursion_counter)
 {
 	static char buffer[100];
@@ -41,6 +41,7 @@
 
 #include "kernel/yosys_common.h"
 
+#include "kernel/counters.h"
 #include "kernel/log.h"
 #include "kernel/rtlil.h"
 #include "kernel/register.h"
@@ -86,6 +87,50 @@ extern const char *yosys_version_str;
 extern std::map<std::string, RTLIL::Design*> saved_designs;
 extern std::vector<RTLIL::Design*> pushed_designs;
 
+// Execution state of one job of the resident server (driver option -Y).
+// Jobs run on their own threads, but only the job holding the kernel lock
+// executes kernel code, with its state swapped into the globals while it
+// does. The lock is given up while a job waits for an external program in
+// run_command() and friends inside a JobYieldScope, so that the ABC runs of
+// some jobs overlap with the passes of others. Scratchpad and selection stack
+// live in the design.
+struct Pass;
+struct JobContext
+{
+	RTLIL::Design *design = nullptr;
+	std::map<std::string, RTLIL::Design*> saved_designs;
+	std::vector<RTLIL::Design*> pushed_designs;
+	std::vector<FILE*> log_files;
+	std::vector<std::ostream*> log_streams;
+	std::vector<int> header_count;
+	Pass *current_pass = nullptr;
+	int log_warnings_count = 0;
+	std::string job_id;
+};
+
+// blocks until the kernel lock is free and makes ctx current on this thread
+void job_context_enter(JobContext *ctx);
+void job_context_leave(JobContext *ctx);
+
+// gives up the kernel lock for its lifetime when the calling thread runs a
+// job inside a JobYieldScope, and does nothing otherwise
+struct JobContextYield
+{
+	JobContext *ctx;
+	JobContextYield();
+	~JobContextYield();
+};
+
+// allows the run_command() calls in its lifetime to give up the kernel lock.
+// Other jobs then run in between, so the caller must not keep state in
+// globals or statics across those calls, or must set it aside and restore
+// it afterwards.
+struct JobYieldScope
+{
+	JobYieldScope();
+	~JobYieldScope();
+};
+
 // from passes/cmds/pluginc.cc
 extern std::map<std::string, void*> loaded_plugins;
 #ifdef WITH_PYTHON
@@ -97,7 +142,8 @@ void load_plugin(std::string filename, std::vector<std::string> aliases);
 extern std::string yosys_share_dirname;
 extern std::string yosys_abc_executable;
 #ifdef HYBRDLINK
-extern std::unordered_map<std::string, std::string> map_hybrdchip_2_xilinx;
+// hybrdchip 原语名称到 xilinx 设计元素名称的映射（均为 escaped id），第一次调用时加载
+const dict<RTLIL::IdString, RTLIL::IdString> &hybrdchip_primitive_map();
 extern bool flag_enable_compatibility_mode; // -R 是否开启了兼容模式，默认false，传入时为true
 extern bool flag_fasm_encryption; // -U。是否加密生成的json格式网表
 extern bool flag_is_pb_file; // 标记是否为pb文件，加载pb文件时，不判断内容是否为hybrdchip
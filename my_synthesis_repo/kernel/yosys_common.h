@@ -35,6 +35,25 @@
 #include <cmath>
 #include <cstddef>
 
+#ifdef YOSYS_ENABLE_THREADS
+#  include <atomic>
+#  include <mutex>
+#endif
+
+#ifdef YOSYS_HASHLIB_STATS
+#  include <atomic>
+#endif
+
+#ifdef YOSYS_HASHLIB_SWISS
+#  include <limits>
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#  endif
+#  if defined(_MSC_VER) && !defined(__GNUC__)
+#    include <intrin.h>
+#  endif
+#endif
+
 #include <sstream>
 #include <fstream>
 #include <istream>
@@ -107,6 +126,13 @@
 #  define YS_MAYBE_UNUSED
 #endif
 
+// Globals that are per-thread in YOSYS_ENABLE_THREADS builds (see kernel/threading.h)
+#ifdef YOSYS_ENABLE_THREADS
+#  define YS_THREAD_LOCAL thread_local
+#else
+#  define YS_THREAD_LOCAL
+#endif
+
 #if __cplusplus >= 201703L
 #  define YS_FALLTHROUGH [[fallthrough]];
 #elif defined(__clang__)
@@ -299,6 +325,16 @@ std::vector<std::string> split_tokens(const std::string &text, const char *sep =
 bool patmatch(const char *pattern, const char *string);
 #if !defined(YOSYS_DISABLE_SPAWN)
 int run_command(const std::string &command, std::function<void(const std::string&)> process_line = std::function<void(const std::string&)>());
+// like run_command(), but starts argv[0] (searched in PATH) directly with the
+// remaining elements as its arguments, without going through a shell. stderr
+// is passed to process_line together with stdout.
+int run_command_argv(const std::vector<std::string> &argv, std::function<void(const std::string&)> process_line = std::function<void(const std::string&)>());
+#if !defined(_WIN32) && !defined(__wasm)
+// like run_command_argv(), but the program also gets the write end of a pipe
+// as file descriptor 3 (/dev/fd/3), and all data written to it is appended to
+// channel_data. lets a tool hand back a result file without a disk round trip.
+int run_command_channel(const std::vector<std::string> &argv, std::function<void(const std::string&)> process_line, std::string &channel_data);
+#endif
 #endif
 std::string get_base_tmpdir();
 std::string make_temp_file(std::string template_str = get_base_tmpdir() + "/yosys_XXXXXX");
@@ -310,19 +346,87 @@ void remove_directory(std::string dirname);
 bool create_directory(const std::string& dirname);
 std::string escape_filename_spaces(const std::string& filename);
 
+// Read-only view of a whole file, memory mapped where the platform allows it.
+// map() fails for files that cannot be opened, are no regular files or are empty.
+struct MappedFile
+{
+	const char *data = nullptr;
+	size_t size = 0;
+
+	MappedFile() { }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile &operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool map(const std::string &filename);
+
+private:
+#ifdef _WIN32
+	void *file = nullptr, *mapping = nullptr;
+#endif
+};
+
+// Input stream over a buffer it owns, used for decompressed input files.
+// Frontends that parse from memory take text() instead of reading the
+// stream, the same way they use a MappedFile for plain files.
+struct MemoryIStream : public std::istream
+{
+	MemoryIStream(std::string &&text) : std::istream(nullptr), text_(std::move(text)), buf(text_) {
+		rdbuf(&buf);
+	}
+
+	const std::string &text() const { return text_; }
+
+private:
+	struct membuf : public std::streambuf
+	{
+		membuf(std::string &text) {
+			char *begin = &text[0];
+			setg(begin, begin, begin + text.size());
+		}
+
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+			char *target = (dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr()) + off;
+			if (!(which & std::ios_base::in) || target < eback() || target > egptr())
+				return pos_type(off_type(-1));
+			setg(eback(), target, egptr());
+			return pos_type(target - eback());
+		}
+
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+			return seekoff(off_type(pos), std::ios_base::beg, which);
+		}
+	};
+
+	std::string text_;
+	membuf buf;
+};
+
 template<typename T> int GetSize(const T &obj) { return obj.size(); }
 inline int GetSize(RTLIL::Wire *wire);
 
 extern int autoidx;
+// when set, NEW_ID and NEW_ID_SUFFIX on this thread count here instead of autoidx
+extern YS_THREAD_LOCAL int *autoidx_local;
+// when set, the hash indices of new RTLIL objects on this thread are drawn from here
+extern YS_THREAD_LOCAL unsigned int *hashidx_local;
 extern int yosys_xtrace;
 
 RTLIL::IdString new_id(std::string file, int line, std::string func);
 RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std::string suffix);
+std::string new_id_prefix(std::string file, int line, std::string func);
+
+// returns the next value of autoidx (or *autoidx_local) and increments it
+int next_autoidx();
 
 #define NEW_ID \
 	YOSYS_NAMESPACE_PREFIX new_id(__FILE__, __LINE__, __FUNCTION__)
 #define NEW_ID_SUFFIX(suffix) \
 	YOSYS_NAMESPACE_PREFIX new_id_suffix(__FILE__, __LINE__, __FUNCTION__, suffix)
+// NEW_ID without the trailing number, for creating many names at once:
+// NEW_ID_PREFIX + std::to_string(next_autoidx()) is the same as NEW_ID
+#define NEW_ID_PREFIX \
+	YOSYS_NAMESPACE_PREFIX new_id_prefix(__FILE__, __LINE__, __FUNCTION__)
 
 // Create a statically allocated IdString object, using for example ID::A or ID($add).
 //
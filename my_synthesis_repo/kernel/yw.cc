@@ -103,27 +103,164 @@ static std::vector<IdString> get_path(const json11::Json &json)
 	return result;
 }
 
+// A minimal pull scanner over the witness file. It only finds the extent of
+// JSON values, which are then parsed individually with json11.
+struct ReadWitness::Scanner
+{
+	std::string filename;
+	std::ifstream f;
+	std::streambuf *buf = nullptr;
+	int64_t pos = 0;
+
+	Scanner(const std::string &filename) : filename(filename), f(filename.c_str(), std::ios::binary) {
+		if (!f.fail())
+			buf = f.rdbuf();
+	}
+
+	[[noreturn]] void error(const char *what) {
+		log_error("Failed to parse `%s`: %s at offset %lld\n", filename.c_str(), what, (long long)pos);
+	}
+
+	int peek() { return buf->sgetc(); }
+
+	int next() {
+		int c = buf->sbumpc();
+		if (c != EOF)
+			pos++;
+		return c;
+	}
+
+	void seek(int64_t offset) {
+		buf->pubseekpos(offset, std::ios::in);
+		pos = offset;
+	}
+
+	void skip_ws() {
+		while (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r')
+			next();
+	}
+
+	bool consume(char c) {
+		skip_ws();
+		if (peek() != c)
+			return false;
+		next();
+		return true;
+	}
+
+	void expect(char c) {
+		if (!consume(c))
+			error(stringf("Expected '%c'", c).c_str());
+	}
+
+	// Scans a string, appending its raw text (including quotes) to out unless out is null
+	void scan_string(std::string *out) {
+		if (next() != '"')
+			error("Expected string");
+		if (out)
+			out->push_back('"');
+		while (true) {
+			int c = next();
+			if (c == EOF)
+				error("Unterminated string");
+			if (out)
+				out->push_back(c);
+			if (c == '"')
+				return;
+			if (c == '\\') {
+				c = next();
+				if (c == EOF)
+					error("Unterminated string");
+				if (out)
+					out->push_back(c);
+			}
+		}
+	}
+
+	// Scans a complete value, appending its raw text to out unless out is null
+	void scan_value(std::string *out) {
+		skip_ws();
+		int depth = 0;
+		while (true) {
+			int c = peek();
+			if (c == EOF)
+				error("Unexpected end of file");
+			if (depth == 0 && (c == ',' || c == '}' || c == ']'))
+				return;
+			if (c == '"') {
+				scan_string(out);
+			} else {
+				next();
+				if (out)
+					out->push_back(c);
+				if (c == '{' || c == '[')
+					depth++;
+				else if (c == '}' || c == ']')
+					depth--;
+				else
+					continue;
+			}
+			if (depth == 0)
+				return;
+		}
+	}
+
+	json11::Json parse_value() {
+		std::string text, err;
+		scan_value(&text);
+		json11::Json json = json11::Json::parse(text, err);
+		if (!err.empty())
+			log_error("Failed to parse `%s`: %s\n", filename.c_str(), err.c_str());
+		return json;
+	}
+};
+
 ReadWitness::ReadWitness(const std::string &filename) :
 	filename(filename)
 {
-	std::ifstream f(filename.c_str());
-	if (f.fail() || GetSize(filename) == 0)
+	scanner.reset(new Scanner(filename));
+	if (scanner->buf == nullptr || GetSize(filename) == 0)
 		log_error("Cannot open file `%s`\n", filename.c_str());
-	std::stringstream buf;
-	buf << f.rdbuf();
-	std::string err;
-	json11::Json json = json11::Json::parse(buf.str(), err);
-	if (!err.empty())
-		log_error("Failed to parse `%s`: %s\n", filename.c_str(), err.c_str());
 
-	std::string format = json["format"].string_value();
+	json11::Json json_format, json_clocks, json_signals;
+
+	scanner->expect('{');
+	if (!scanner->consume('}')) {
+		do {
+			scanner->skip_ws();
+			std::string key = scanner->parse_value().string_value();
+			scanner->expect(':');
+			if (key == "steps") {
+				scanner->expect('[');
+				if (!scanner->consume(']')) {
+					do {
+						scanner->skip_ws();
+						step_offsets.push_back(scanner->pos);
+						scanner->scan_value(nullptr);
+					} while (scanner->consume(','));
+					scanner->expect(']');
+				}
+			} else if (key == "format") {
+				json_format = scanner->parse_value();
+			} else if (key == "clocks") {
+				json_clocks = scanner->parse_value();
+			} else if (key == "signals") {
+				json_signals = scanner->parse_value();
+			} else {
+				scanner->scan_value(nullptr);
+			}
+		} while (scanner->consume(','));
+		scanner->expect('}');
+	}
+
+	std::string format = json_format.string_value();
 
 	if (format.empty())
 		log_error("Failed to parse `%s`: Unknown format\n", filename.c_str());
 	if (format != "Yosys Witness Trace")
 		log_error("Failed to parse `%s`: Unsupported format `%s`\n", filename.c_str(), format.c_str());
 
-	for (auto &clock_json : json["clocks"].array_items()) {
+	for (auto &clock_json : json_clocks.array_items()) {
 		Clock clock;
 		clock.path = get_path(clock_json["path"]);
 		if (clock.path.empty())
@@ -144,7 +281,7 @@ ReadWitness::ReadWitness(const std::string &filename) :
 	}
 
 	int bits_offset = 0;
-	for (auto &signal_json : json["signals"].array_items()) {
+	for (auto &signal_json : json_signals.array_items()) {
 		Signal signal;
 		signal.bits_offset = bits_offset;
 		signal.path = get_path(signal_json["path"]);
@@ -164,44 +301,49 @@ ReadWitness::ReadWitness(const std::string &filename) :
 		signal.init_only = signal_json["init_only"].bool_value();
 		signals.push_back(signal);
 	}
+}
 
-	for (auto &step_json : json["steps"].array_items()) {
-		Step step;
-		if (!step_json["bits"].is_string())
-			log_error("Failed to parse `%s`: Expected string as bits value for step %d\n", filename.c_str(), GetSize(steps));
-		step.bits = step_json["bits"].string_value();
-		for (char c : step.bits) {
-			if (c != '0' && c != '1' && c != 'x' && c != '?')
-				log_error("Failed to parse `%s`: Invalid bit '%c' value for step %d\n", filename.c_str(), c, GetSize(steps));
-		}
-		steps.push_back(step);
-	}
+ReadWitness::~ReadWitness()
+{
 }
 
-RTLIL::Const ReadWitness::get_bits(int t, int bits_offset, int width) const
+void ReadWitness::load_step(int t) const
 {
-	log_assert(t >= 0 && t < GetSize(steps));
+	log_assert(t >= 0 && t < GetSize(step_offsets));
 
-	const std::string &bits = steps[t].bits;
+	if (t == loaded_step)
+		return;
 
-	RTLIL::Const result(State::Sa, width);
-	result.bits.reserve(width);
-
-	int read_begin = GetSize(bits) - 1 - bits_offset;
-	int read_end = max(-1, read_begin - width);
-
-	for (int i = read_begin, j = 0; i > read_end; i--, j++) {
-		RTLIL::State bit = State::Sa;
-		switch (bits[i]) {
-			case '0': bit = State::S0; break;
-			case '1': bit = State::S1; break;
-			case 'x': bit = State::Sx; break;
-			case '?': bit = State::Sa; break;
+	scanner->seek(step_offsets[t]);
+	json11::Json step_json = scanner->parse_value();
+	if (!step_json["bits"].is_string())
+		log_error("Failed to parse `%s`: Expected string as bits value for step %d\n", filename.c_str(), t);
+
+	// Decoded directly into LSB first order, which is the order of the bits in a Const
+	const std::string &bits = step_json["bits"].string_value();
+	loaded_bits.resize(bits.size());
+	for (int i = 0, j = GetSize(bits) - 1; j >= 0; i++, j--) {
+		switch (bits[j]) {
+			case '0': loaded_bits[i] = State::S0; break;
+			case '1': loaded_bits[i] = State::S1; break;
+			case 'x': loaded_bits[i] = State::Sx; break;
+			case '?': loaded_bits[i] = State::Sa; break;
 			default:
-				log_abort();
+				log_error("Failed to parse `%s`: Invalid bit '%c' value for step %d\n", filename.c_str(), bits[j], t);
 		}
-		result.bits[j] = bit;
 	}
+	loaded_step = t;
+}
+
+RTLIL::Const ReadWitness::get_bits(int t, int bits_offset, int width) const
+{
+	load_step(t);
+
+	RTLIL::Const result(State::Sa, width);
+
+	int available = min(width, GetSize(loaded_bits) - bits_offset);
+	if (available > 0)
+		std::copy(loaded_bits.begin() + bits_offset, loaded_bits.begin() + bits_offset + available, result.bits.begin());
 
 	return result;
 }
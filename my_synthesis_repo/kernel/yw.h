@@ -82,18 +82,30 @@ struct ReadWitness
 		int bits_offset;
 	};
 
-	struct Step {
-		std::string bits;
-	};
-
 	std::string filename;
 	std::vector<Clock> clocks;
 	std::vector<Signal> signals;
-	std::vector<Step> steps;
 
+	// The header is parsed up front, but steps are only indexed by their
+	// file offset and read one at a time when their bits are requested, so
+	// memory use does not grow with the length of the trace.
 	ReadWitness(const std::string &filename);
+	~ReadWitness();
+
+	int num_steps() const { return GetSize(step_offsets); }
 
 	RTLIL::Const get_bits(int t, int bits_offset, int width) const;
+
+private:
+	struct Scanner;
+
+	std::unique_ptr<Scanner> scanner;
+	std::vector<int64_t> step_offsets;
+	// The most recently read step, LSB first
+	mutable int loaded_step = -1;
+	mutable std::vector<RTLIL::State> loaded_bits;
+
+	void load_step(int t) const;
 };
 
 template<typename D, typename T>
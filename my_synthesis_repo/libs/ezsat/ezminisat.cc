@@ -30,6 +30,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <cinttypes>
+#include <algorithm>
 
 #if !defined(_WIN32) && !defined(__wasm)
 #  include <csignal>
@@ -40,6 +41,27 @@
 #include "../minisat/Solver.h"
 #include "../minisat/SimpSolver.h"
 
+#ifdef YOSYS_ENABLE_THREADS
+#  include <thread>
+#  include <mutex>
+#  include <condition_variable>
+#  include <chrono>
+#endif
+
+// cumulative counters of a MiniSat instance, see ezSAT::addSolverStats()
+static ezSAT::SolverStats minisat_counters(const Minisat::Solver *solver)
+{
+	ezSAT::SolverStats counters;
+	counters.solves = solver->solves;
+	counters.conflicts = solver->conflicts;
+	counters.decisions = solver->decisions;
+	counters.propagations = solver->propagations;
+	counters.gc_runs = solver->gc_runs;
+	counters.gc_seconds = solver->gc_time;
+	counters.arena_bytes = solver->arenaBytes();
+	return counters;
+}
+
 ezMiniSAT::ezMiniSAT() : minisatSolver(NULL)
 {
 	minisatSolver = NULL;
@@ -61,6 +83,7 @@ void ezMiniSAT::clear()
 		delete minisatSolver;
 		minisatSolver = NULL;
 	}
+	releaseSolverStats();
 	foundContradiction = false;
 	minisatVars.clear();
 #if EZMINISAT_SIMPSOLVER && EZMINISAT_INCREMENTAL
@@ -110,6 +133,7 @@ contradiction:
 		delete minisatSolver;
 		minisatSolver = NULL;
 		minisatVars.clear();
+		releaseSolverStats();
 		foundContradiction = true;
 		return false;
 	}
@@ -132,10 +156,10 @@ contradiction:
 	}
 
 #if EZMINISAT_INCREMENTAL
-	std::vector<std::vector<int>> cnf;
+	ezSATCnf cnf;
 	consumeCnf(cnf);
 #else
-	const std::vector<std::vector<int>> &cnf = this->cnf();
+	const ezSATCnf &cnf = this->cnf();
 #endif
 
 	while (int(minisatVars.size()) < numCnfVariables())
@@ -147,7 +171,7 @@ contradiction:
 	cnfFrozenVars.clear();
 #endif
 
-	for (auto &clause : cnf) {
+	for (auto clause : cnf) {
 		Minisat::vec<Minisat::Lit> ps;
 		for (auto idx : clause) {
 			if (idx > 0)
@@ -201,8 +225,13 @@ contradiction:
 	}
 #endif
 
+	ezSAT::SolverStats counters_before = minisat_counters(minisatSolver);
 	bool foundSolution = minisatSolver->solve(assumps);
 
+	if (mode_compact_arena())
+		minisatSolver->compactArena();
+	addSolverStats(counters_before, minisat_counters(minisatSolver));
+
 #if defined(HAS_ALARM)
 	if (solverTimeout > 0) {
 		if (alarmHandlerTimeout == 0)
@@ -218,6 +247,7 @@ contradiction:
 		delete minisatSolver;
 		minisatSolver = NULL;
 		minisatVars.clear();
+		releaseSolverStats();
 #endif
 		return false;
 	}
@@ -242,7 +272,207 @@ contradiction:
 	delete minisatSolver;
 	minisatSolver = NULL;
 	minisatVars.clear();
+	releaseSolverStats();
 #endif
 	return true;
 }
 
+ezMiniSATPortfolio::ezMiniSATPortfolio(int numSolvers) : numSolvers(numSolvers < 1 ? 1 : numSolvers)
+{
+	foundContradiction = false;
+}
+
+ezMiniSATPortfolio::~ezMiniSATPortfolio()
+{
+	deleteSolvers();
+}
+
+void ezMiniSATPortfolio::createSolvers()
+{
+	for (int i = 0; i < numSolvers; i++)
+	{
+		Minisat::Solver *s = new Minisat::Solver;
+		s->verbosity = EZMINISAT_VERBOSITY;
+
+		// the first instance keeps the default configuration
+		if (i > 0) {
+			s->random_seed = 91648253 + 7919.0 * i;
+			s->rnd_init_act = true;
+			s->random_var_freq = 0.005 * (i % 4);
+			s->phase_saving = (i % 3 == 1) ? 1 : 2;
+			s->luby_restart = i % 2 == 0;
+			s->ccmin_mode = i % 4 == 3 ? 1 : 2;
+			s->restart_first = 100 >> (i % 3);
+		}
+
+		minisatSolvers.push_back(s);
+	}
+}
+
+void ezMiniSATPortfolio::deleteSolvers()
+{
+	for (auto s : minisatSolvers)
+		delete s;
+	minisatSolvers.clear();
+	minisatVars.clear();
+	releaseSolverStats();
+}
+
+ezSAT::SolverStats ezMiniSATPortfolio::counters() const
+{
+	ezSAT::SolverStats sum;
+	for (auto s : minisatSolvers) {
+		ezSAT::SolverStats c = minisat_counters(s);
+		sum.solves = std::max(sum.solves, c.solves);
+		sum.conflicts += c.conflicts;
+		sum.decisions += c.decisions;
+		sum.propagations += c.propagations;
+		sum.gc_runs += c.gc_runs;
+		sum.gc_seconds += c.gc_seconds;
+		sum.arena_bytes += c.arena_bytes;
+	}
+	return sum;
+}
+
+void ezMiniSATPortfolio::clear()
+{
+	deleteSolvers();
+	foundContradiction = false;
+	ezSAT::clear();
+}
+
+bool ezMiniSATPortfolio::solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions)
+{
+	preSolverCallback();
+
+	solverTimoutStatus = false;
+
+	if (foundContradiction) {
+		consumeCnf();
+		return false;
+	}
+
+	std::vector<int> extraClauses, modelIdx;
+
+	for (auto id : assumptions)
+		extraClauses.push_back(bind(id));
+	for (auto id : modelExpressions)
+		modelIdx.push_back(bind(id));
+
+	if (minisatSolvers.empty())
+		createSolvers();
+
+	ezSATCnf cnf;
+	consumeCnf(cnf);
+
+	// all instances allocate their variables in the same order
+	while (int(minisatVars.size()) < numCnfVariables()) {
+		int var = 0;
+		for (auto s : minisatSolvers)
+			var = s->newVar();
+		minisatVars.push_back(var);
+	}
+
+	for (auto clause : cnf) {
+		Minisat::vec<Minisat::Lit> ps;
+		for (auto idx : clause) {
+			if (idx > 0)
+				ps.push(Minisat::mkLit(minisatVars.at(idx-1)));
+			else
+				ps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
+		}
+		for (auto s : minisatSolvers)
+			if (!s->addClause(ps)) {
+				deleteSolvers();
+				foundContradiction = true;
+				return false;
+			}
+	}
+
+	Minisat::vec<Minisat::Lit> assumps;
+
+	for (auto idx : extraClauses) {
+		if (idx > 0)
+			assumps.push(Minisat::mkLit(minisatVars.at(idx-1)));
+		else
+			assumps.push(Minisat::mkLit(minisatVars.at(-idx-1), true));
+	}
+
+	int winner = -1;
+	Minisat::lbool result = Minisat::l_Undef;
+	ezSAT::SolverStats counters_before = counters();
+
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+	std::condition_variable done_cv;
+	int finished = 0;
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < int(minisatSolvers.size()); i++)
+		threads.emplace_back([&, i]() {
+			Minisat::lbool r = minisatSolvers[i]->solveLimited(assumps);
+			std::lock_guard<std::mutex> lock(mutex);
+			finished++;
+			if (winner < 0 && r != Minisat::l_Undef) {
+				winner = i;
+				result = r;
+				for (int j = 0; j < int(minisatSolvers.size()); j++)
+					if (j != i)
+						minisatSolvers[j]->interrupt();
+			}
+			done_cv.notify_all();
+		});
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto done = [&]() { return winner >= 0 || finished == int(minisatSolvers.size()); };
+		if (solverTimeout > 0) {
+			if (!done_cv.wait_for(lock, std::chrono::seconds(solverTimeout), done)) {
+				for (auto s : minisatSolvers)
+					s->interrupt();
+				solverTimoutStatus = true;
+			}
+		} else {
+			done_cv.wait(lock, done);
+		}
+	}
+
+	for (auto &t : threads)
+		t.join();
+	for (auto s : minisatSolvers)
+		s->clearInterrupt();
+
+	// an instance may have finished right after the timeout
+	if (winner >= 0)
+		solverTimoutStatus = false;
+#else
+	result = minisatSolvers[0]->solveLimited(assumps);
+	winner = 0;
+#endif
+
+	if (mode_compact_arena())
+		for (auto s : minisatSolvers)
+			s->compactArena();
+	addSolverStats(counters_before, counters());
+
+	if (winner < 0 || result != Minisat::l_True)
+		return false;
+
+	modelValues.clear();
+	modelValues.resize(modelIdx.size());
+
+	for (size_t i = 0; i < modelIdx.size(); i++)
+	{
+		int idx = modelIdx[i];
+		bool refvalue = true;
+
+		if (idx < 0)
+			idx = -idx, refvalue = false;
+
+		using namespace Minisat;
+		lbool value = minisatSolvers[winner]->modelValue(minisatVars.at(idx-1));
+		modelValues[i] = (value == Minisat::lbool(refvalue));
+	}
+
+	return true;
+}
@@ -68,4 +68,27 @@ public:
 	virtual bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions);
 };
 
+// Runs several differently configured MiniSat instances on the same CNF,
+// each in its own thread, and takes the answer of the first one that
+// finishes. The others are interrupted and keep their learned clauses for
+// the next call. Without YOSYS_ENABLE_THREADS only the first instance runs.
+class ezMiniSATPortfolio : public ezSAT
+{
+private:
+	int numSolvers;
+	std::vector<Minisat::Solver*> minisatSolvers;
+	std::vector<int> minisatVars;
+	bool foundContradiction;
+
+	void createSolvers();
+	void deleteSolvers();
+	ezSAT::SolverStats counters() const;
+
+public:
+	ezMiniSATPortfolio(int numSolvers = 4);
+	virtual ~ezMiniSATPortfolio();
+	virtual void clear();
+	virtual bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions);
+};
+
 #endif
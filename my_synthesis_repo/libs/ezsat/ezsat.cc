@@ -46,6 +46,8 @@ ezSAT::ezSAT()
 
 	flag_keep_cnf = false;
 	flag_non_incremental = false;
+	flag_eager_cnf = false;
+	flag_compact_arena = false;
 
 	non_incremental_solve_used_up = false;
 
@@ -63,8 +65,11 @@ ezSAT::ezSAT()
 	assert(literal("CONST_FALSE") == CONST_FALSE);
 }
 
+ezSAT::SolverTotals ezSAT::solverTotals;
+
 ezSAT::~ezSAT()
 {
+	releaseSolverStats();
 }
 
 void ezSAT::addhash(unsigned int h)
@@ -202,6 +207,15 @@ int ezSAT::expression(OpId op, const std::vector<int> &args)
 		abort();
 	}
 
+	if (flag_eager_cnf && op != OpNot) {
+		int id = eager_expression(op, myArgs);
+		if (xorRemovedOddTrues)
+			id = NOT(id);
+		addhash(__LINE__);
+		addhash(id);
+		return id;
+	}
+
 	std::pair<OpId, std::vector<int>> myExpr(op, myArgs);
 	int id = 0;
 
@@ -387,6 +401,7 @@ int ezSAT::eval(int id, const std::vector<int> &values) const
 
 void ezSAT::clear()
 {
+	assert(!flag_eager_cnf);
 	cnfConsumed = false;
 	cnfVariableCount = 0;
 	cnfClausesCount = 0;
@@ -422,7 +437,7 @@ void ezSAT::assume(int id)
 
 			if (op == OpNot) {
 				int idx = bind(args[0]);
-				cnfClauses.push_back(std::vector<int>(1, -idx));
+				cnfClauses.add(-idx);
 				cnfClausesCount++;
 				return;
 			}
@@ -430,13 +445,13 @@ void ezSAT::assume(int id)
 				std::vector<int> clause;
 				for (int arg : args)
 					clause.push_back(bind(arg));
-				cnfClauses.push_back(clause);
+				cnfClauses.add(clause);
 				cnfClausesCount++;
 				return;
 			}
 			if (op == OpAnd) {
 				for (int arg : args) {
-					cnfClauses.push_back(std::vector<int>(1, bind(arg)));
+					cnfClauses.add(bind(arg));
 					cnfClausesCount++;
 				}
 				return;
@@ -445,7 +460,7 @@ void ezSAT::assume(int id)
 	}
 
 	int idx = bind(id);
-	cnfClauses.push_back(std::vector<int>(1, idx));
+	cnfClauses.add(idx);
 	cnfClausesCount++;
 }
 
@@ -455,7 +470,7 @@ void ezSAT::add_clause(const std::vector<int> &args)
 	for (auto arg : args)
 		addhash(arg);
 
-	cnfClauses.push_back(args);
+	cnfClauses.add(args);
 	cnfClausesCount++;
 }
 
@@ -640,30 +655,97 @@ int ezSAT::bind(int id, bool auto_freeze)
 	return cnfExpressionVariables[-id-1];
 }
 
+int ezSAT::bind_cnf_xor(int a, int b)
+{
+	int idx = ++cnfVariableCount;
+	add_clause(-a, -b, -idx);
+	add_clause(+a, +b, -idx);
+	add_clause(-a, +b, +idx);
+	add_clause(+a, -b, +idx);
+	return idx;
+}
+
+int ezSAT::bind_cnf_ite(int s, int t, int e)
+{
+	int idx = ++cnfVariableCount;
+	add_clause(-s, -t, +idx);
+	add_clause(-s, +t, -idx);
+	add_clause(+s, -e, +idx);
+	add_clause(+s, +e, -idx);
+	// redundant, but they help propagation when s is unassigned
+	add_clause(-t, -e, +idx);
+	add_clause(+t, +e, -idx);
+	return idx;
+}
+
+// creates the literal for a simplified, non-constant expression in eager_cnf mode
+int ezSAT::eager_expression(OpId op, const std::vector<int> &args)
+{
+	bool cached = args.size() <= 3;
+	std::tuple<int, int, int, int> key(op, args.size() > 0 ? args[0] : 0,
+			args.size() > 1 ? args[1] : 0, args.size() > 2 ? args[2] : 0);
+
+	if (cached) {
+		auto it = eagerCache.find(key);
+		if (it != eagerCache.end())
+			return it->second;
+	}
+
+	int idx = 0;
+
+	if (op == OpIFF) {
+		std::vector<int> invArgs;
+		for (auto arg : args)
+			invArgs.push_back(NOT(arg));
+		idx = bind(OR(expression(OpAnd, args), expression(OpAnd, invArgs)), false);
+	} else if (op == OpXor) {
+		idx = bind(args[0], false);
+		for (int i = 1; i < int(args.size()); i++)
+			idx = bind_cnf_xor(idx, bind(args[i], false));
+	} else if (op == OpITE) {
+		idx = bind_cnf_ite(bind(args[0], false), bind(args[1], false), bind(args[2], false));
+	} else {
+		std::vector<int> cnfArgs;
+		for (auto arg : args)
+			cnfArgs.push_back(bind(arg, false));
+		idx = op == OpAnd ? bind_cnf_and(cnfArgs) : bind_cnf_or(cnfArgs);
+	}
+
+	// represent the gate by a fresh literal that is already bound to idx
+	int id = literal();
+	cnfLiteralVariables.resize(literals.size());
+	cnfLiteralVariables[id-1] = idx;
+	freeze(id);
+
+	if (cached)
+		eagerCache[key] = id;
+	return id;
+}
+
 void ezSAT::consumeCnf()
 {
 	if (mode_keep_cnf())
-		cnfClausesBackup.insert(cnfClausesBackup.end(), cnfClauses.begin(), cnfClauses.end());
+		cnfClausesBackup.append(cnfClauses);
 	else
 		cnfConsumed = true;
 	cnfClauses.clear();
 }
 
-void ezSAT::consumeCnf(std::vector<std::vector<int>> &cnf)
+void ezSAT::consumeCnf(ezSATCnf &cnf)
 {
 	if (mode_keep_cnf())
-		cnfClausesBackup.insert(cnfClausesBackup.end(), cnfClauses.begin(), cnfClauses.end());
+		cnfClausesBackup.append(cnfClauses);
 	else
 		cnfConsumed = true;
 	cnf.swap(cnfClauses);
 	cnfClauses.clear();
 }
 
-void ezSAT::getFullCnf(std::vector<std::vector<int>> &full_cnf) const
+void ezSAT::getFullCnf(ezSATCnf &full_cnf) const
 {
 	assert(full_cnf.empty());
-	full_cnf.insert(full_cnf.end(), cnfClausesBackup.begin(), cnfClausesBackup.end());
-	full_cnf.insert(full_cnf.end(), cnfClauses.begin(), cnfClauses.end());
+	full_cnf.append(cnfClausesBackup);
+	full_cnf.append(cnfClauses);
 }
 
 void ezSAT::preSolverCallback()
@@ -673,6 +755,34 @@ void ezSAT::preSolverCallback()
 		non_incremental_solve_used_up = true;
 }
 
+void ezSAT::addSolverStats(const SolverStats &before, const SolverStats &after)
+{
+	solverStats.solves += after.solves - before.solves;
+	solverStats.conflicts += after.conflicts - before.conflicts;
+	solverStats.decisions += after.decisions - before.decisions;
+	solverStats.propagations += after.propagations - before.propagations;
+	solverStats.gc_runs += after.gc_runs - before.gc_runs;
+	solverStats.gc_seconds += after.gc_seconds - before.gc_seconds;
+
+	solverTotals.solves += after.solves - before.solves;
+	solverTotals.conflicts += after.conflicts - before.conflicts;
+	solverTotals.decisions += after.decisions - before.decisions;
+	solverTotals.propagations += after.propagations - before.propagations;
+	solverTotals.gc_runs += after.gc_runs - before.gc_runs;
+	solverTotals.gc_ns += int64_t((after.gc_seconds - before.gc_seconds) * 1e9);
+	solverTotals.arena_bytes += after.arena_bytes - solverStats.arena_bytes;
+
+	solverStats.arena_bytes = after.arena_bytes;
+	if (solverStats.arena_peak_bytes < after.arena_bytes)
+		solverStats.arena_peak_bytes = after.arena_bytes;
+}
+
+void ezSAT::releaseSolverStats()
+{
+	solverTotals.arena_bytes -= solverStats.arena_bytes;
+	solverStats.arena_bytes = 0;
+}
+
 bool ezSAT::solver(const std::vector<int>&, std::vector<bool>&, const std::vector<int>&)
 {
 	preSolverCallback();
@@ -1256,24 +1366,25 @@ void ezSAT::printDIMACS(FILE *f, bool verbose) const
 		fprintf(f, "c\n");
 	}
 
-	std::vector<std::vector<int>> all_clauses;
-	getFullCnf(all_clauses);
-	assert(cnfClausesCount == int(all_clauses.size()));
+	// both buffers are printed in place, without a copy of the whole CNF
+	assert(cnfClausesCount == int(cnfClausesBackup.size() + cnfClauses.size()));
 
 	fprintf(f, "p cnf %d %d\n", cnfVariableCount, cnfClausesCount);
 	int maxClauseLen = 0;
-	for (auto &clause : all_clauses)
-		maxClauseLen = std::max(int(clause.size()), maxClauseLen);
+	for (auto buffer : {&cnfClausesBackup, &cnfClauses})
+		for (auto clause : *buffer)
+			maxClauseLen = std::max(int(clause.size()), maxClauseLen);
 	if (!verbose)
 		maxClauseLen = std::min(maxClauseLen, 3);
-	for (auto &clause : all_clauses) {
-		for (auto idx : clause)
-			fprintf(f, " %*d", digits, idx);
-		if (maxClauseLen >= int(clause.size()))
-			fprintf(f, " %*d\n", (digits + 1)*int(maxClauseLen - clause.size()) + digits, 0);
-		else
-			fprintf(f, " %*d\n", digits, 0);
-	}
+	for (auto buffer : {&cnfClausesBackup, &cnfClauses})
+		for (auto clause : *buffer) {
+			for (auto idx : clause)
+				fprintf(f, " %*d", digits, idx);
+			if (maxClauseLen >= int(clause.size()))
+				fprintf(f, " %*d\n", (digits + 1)*int(maxClauseLen - clause.size()) + digits, 0);
+			else
+				fprintf(f, " %*d\n", digits, 0);
+		}
 }
 
 static std::string expression2str(const std::pair<ezSAT::OpId, std::vector<int>> &data)
@@ -1326,8 +1437,8 @@ void ezSAT::printInternalState(FILE *f) const
 			fprintf(f, "    expression %d -> %d (%s)\n", -i-1, cnfExpressionVariables[i], to_string(-i-1).c_str());
 
 	fprintf(f, "cnfClauses:\n");
-	for (auto &i1 : cnfClauses) {
-		for (auto &i2 : i1)
+	for (auto i1 : cnfClauses) {
+		for (auto i2 : i1)
 			fprintf(f, " %4d", i2);
 		fprintf(f, "\n");
 	}
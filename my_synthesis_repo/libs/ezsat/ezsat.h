@@ -26,6 +26,62 @@
 #include <string>
 #include <stdio.h>
 #include <stdint.h>
+#include <tuple>
+#include <atomic>
+
+// A list of CNF clauses in one flat array of literals, each clause followed
+// by a 0. Iterating yields one clause_t (a range of literals) per clause.
+class ezSATCnf
+{
+	std::vector<int> lits;
+	int count = 0;
+
+public:
+	struct clause_t {
+		const int *first, *last;
+		const int *begin() const { return first; }
+		const int *end() const { return last; }
+		size_t size() const { return last - first; }
+	};
+
+	struct iterator {
+		const int *ptr;
+		clause_t operator*() const {
+			const int *last = ptr;
+			while (*last != 0)
+				last++;
+			return clause_t{ptr, last};
+		}
+		iterator &operator++() {
+			while (*ptr != 0)
+				ptr++;
+			ptr++;
+			return *this;
+		}
+		bool operator!=(const iterator &other) const { return ptr != other.ptr; }
+	};
+
+	iterator begin() const { return iterator{lits.data()}; }
+	iterator end() const { return iterator{lits.data() + lits.size()}; }
+
+	void add(const int *clause, size_t n) {
+		lits.insert(lits.end(), clause, clause + n);
+		lits.push_back(0);
+		count++;
+	}
+	void add(const std::vector<int> &clause) { add(clause.data(), clause.size()); }
+	void add(int lit) { add(&lit, 1); }
+	void append(const ezSATCnf &other) {
+		lits.insert(lits.end(), other.lits.begin(), other.lits.end());
+		count += other.count;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t num_literals() const { return lits.size() - count; }
+	void clear() { lits.clear(); count = 0; }
+	void swap(ezSATCnf &other) { lits.swap(other.lits); std::swap(count, other.count); }
+};
 
 class ezSAT
 {
@@ -48,9 +104,25 @@ public:
 	static const int CONST_TRUE;
 	static const int CONST_FALSE;
 
+	// work done by the solver backend, summed over all calls to solve()
+	struct SolverStats {
+		int64_t solves = 0, conflicts = 0, decisions = 0, propagations = 0, gc_runs = 0;
+		double gc_seconds = 0;
+		int64_t arena_bytes = 0, arena_peak_bytes = 0;
+	};
+
+	// the same for all ezSAT instances of the process, arena_bytes is the
+	// memory currently held by all solvers
+	struct SolverTotals {
+		std::atomic<int64_t> solves{0}, conflicts{0}, decisions{0}, propagations{0}, gc_runs{0}, gc_ns{0}, arena_bytes{0};
+	};
+	static SolverTotals solverTotals;
+
 private:
 	bool flag_keep_cnf;
 	bool flag_non_incremental;
+	bool flag_eager_cnf;
+	bool flag_compact_arena;
 
 	bool non_incremental_solve_used_up;
 
@@ -60,10 +132,14 @@ private:
 	std::map<std::pair<OpId, std::vector<int>>, int> expressionsCache;
 	std::vector<std::pair<OpId, std::vector<int>>> expressions;
 
+	// in eager_cnf mode gates with up to three arguments are hashed here
+	// as (op, a, b, c), mapping to the literal that represents them
+	std::map<std::tuple<int, int, int, int>, int> eagerCache;
+
 	bool cnfConsumed;
 	int cnfVariableCount, cnfClausesCount;
 	std::vector<int> cnfLiteralVariables, cnfExpressionVariables;
-	std::vector<std::vector<int>> cnfClauses, cnfClausesBackup;
+	ezSATCnf cnfClauses, cnfClausesBackup;
 
 	void add_clause(const std::vector<int> &args);
 	void add_clause(const std::vector<int> &args, bool argsPolarity, int a = 0, int b = 0, int c = 0);
@@ -72,13 +148,23 @@ private:
 	int bind_cnf_not(const std::vector<int> &args);
 	int bind_cnf_and(const std::vector<int> &args);
 	int bind_cnf_or(const std::vector<int> &args);
+	int bind_cnf_xor(int a, int b);
+	int bind_cnf_ite(int s, int t, int e);
+
+	int eager_expression(OpId op, const std::vector<int> &args);
 
 protected:
 	void preSolverCallback();
 
+	// called by the solver backends after each solve with the cumulative
+	// counters of their solver before and after the call
+	void addSolverStats(const SolverStats &before, const SolverStats &after);
+	void releaseSolverStats();
+
 public:
 	int solverTimeout;
 	bool solverTimoutStatus;
+	SolverStats solverStats;
 
 	ezSAT();
 	virtual ~ezSAT();
@@ -89,8 +175,22 @@ public:
 	void keep_cnf() { flag_keep_cnf = true; }
 	void non_incremental() { flag_non_incremental = true; }
 
+	// In eager_cnf mode expressions are Tseitin encoded as soon as they are
+	// created and represented by a frozen literal, instead of being stored
+	// in the expression table and encoded on bind(). This keeps the memory
+	// use of very large problems close to that of the CNF itself, at the
+	// price of the variable elimination of the SimpSolver. Enable it before
+	// creating the first expression; clear() is not supported in this mode.
+	void eager_cnf() { flag_eager_cnf = true; }
+
+	// Give the unused clause memory of the solver back after every solve,
+	// instead of keeping the arena at its peak size for the next call.
+	void compact_arena() { flag_compact_arena = true; }
+
 	bool mode_keep_cnf() const { return flag_keep_cnf; }
 	bool mode_non_incremental() const { return flag_non_incremental; }
+	bool mode_eager_cnf() const { return flag_eager_cnf; }
+	bool mode_compact_arena() const { return flag_compact_arena; }
 
 	// manage expressions
 
@@ -169,13 +269,13 @@ public:
 
 	int numCnfVariables() const { return cnfVariableCount; }
 	int numCnfClauses() const { return cnfClausesCount; }
-	const std::vector<std::vector<int>> &cnf() const { return cnfClauses; }
+	const ezSATCnf &cnf() const { return cnfClauses; }
 
 	void consumeCnf();
-	void consumeCnf(std::vector<std::vector<int>> &cnf);
+	void consumeCnf(ezSATCnf &cnf);
 
 	// use this function to get the full CNF in keep_cnf mode
-	void getFullCnf(std::vector<std::vector<int>> &full_cnf) const;
+	void getFullCnf(ezSATCnf &full_cnf) const;
 
 	std::string cnfLiteralInfo(int idx) const;
 
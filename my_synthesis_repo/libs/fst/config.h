@@ -25,6 +25,12 @@
 #undef HAVE_ALLOCA_H
 #endif
 
+/* The parallel writer thread of fstWriterSetParallelMode(), only in builds
+   that link with thread support. */
+#if defined(HAVE_LIBPTHREAD) && defined(YOSYS_ENABLE_THREADS)
+#define FST_WRITER_PARALLEL 1
+#endif
+
 # ifndef __STDC_FORMAT_MACROS
 #  define __STDC_FORMAT_MACROS 1
 # endif
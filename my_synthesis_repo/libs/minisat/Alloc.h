@@ -55,6 +55,7 @@ class RegionAllocator
 
     uint32_t size      () const      { return sz; }
     uint32_t wasted    () const      { return wasted_; }
+    uint32_t reserved  () const      { return cap; }
 
     Ref      alloc     (int size); 
     void     free      (int size)    { wasted_ += size; }
@@ -116,6 +116,8 @@ public:
     virtual void garbageCollect();
     void    checkGarbage(double gf);
     void    checkGarbage();
+    void    compactArena();       // Release unused clause memory, e.g. between incremental solves.
+    uint64_t arenaBytes() const;  // The number of bytes reserved for the clause arena.
 
     // Extra results: (read-only member variable)
     //
@@ -150,6 +152,8 @@ public:
     //
     uint64_t solves, starts, decisions, rnd_decisions, propagations, conflicts;
     uint64_t dec_vars, num_clauses, num_learnts, clauses_literals, learnts_literals, max_literals, tot_literals;
+    uint64_t gc_runs;
+    double   gc_time;
 
 protected:
 
@@ -328,6 +332,10 @@ inline void Solver::claBumpActivity (Clause& c) {
             cla_inc *= 1e-20; } }
 
 inline void Solver::checkGarbage(void){ return checkGarbage(garbage_frac); }
+inline void Solver::compactArena(void){
+    if (ca.wasted() > 0 || ca.reserved() / 2 > ca.size())
+        garbageCollect(); }
+inline uint64_t Solver::arenaBytes(void) const { return (uint64_t)ca.reserved() * ClauseAllocator::Unit_Size; }
 inline void Solver::checkGarbage(double gf){
     if (ca.wasted() > ca.size() * gf)
         garbageCollect(); }
@@ -262,6 +262,7 @@ class ClauseAllocator
 
     uint32_t size      () const      { return ra.size(); }
     uint32_t wasted    () const      { return ra.wasted(); }
+    uint32_t reserved  () const      { return ra.reserved(); }
 
     // Deref, Load Effective Address (LEA), Inverse of LEA (AEL):
     Clause&       operator[](CRef r)         { return (Clause&)ra[r]; }
@@ -21,6 +21,7 @@
 #include "subcircuit.h"
 
 #include <algorithm>
+#include <mutex>
 #include <assert.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -319,6 +320,7 @@ class SubCircuit::SolverWorker
 		std::string graphId;
 		Graph graph;
 		adjMatrix_t adjMatrix;
+		std::map<std::string, std::vector<int>> nodesByTypeId;
 		std::vector<bool> usedNodes;
 	};
 
@@ -681,6 +683,7 @@ class SubCircuit::SolverWorker
 		std::map<DiEdge, int> edgeTypesMap;
 		std::vector<DiEdge> edgeTypes;
 		std::map<std::pair<int, int>, bool> compareCache;
+		std::mutex compareCacheMutex;
 
 		void add(const Graph &graph, adjMatrix_t &adjMatrix, const std::string &graphId, Solver *userSolver)
 		{
@@ -708,10 +711,18 @@ class SubCircuit::SolverWorker
 		bool compare(int needleEdge, int haystackEdge, const std::map<std::string, std::set<std::set<std::string>>> &swapPorts,
 				const std::map<std::string, std::set<std::map<std::string, std::string>>> &swapPermutations)
 		{
+			// solve() may run concurrently for different haystacks
 			std::pair<int, int> key(needleEdge, haystackEdge);
-			if (!compareCache.count(key))
-				compareCache[key] = edgeTypes.at(needleEdge).compare(edgeTypes.at(haystackEdge), swapPorts, swapPermutations);
-			return compareCache[key];
+			{
+				std::lock_guard<std::mutex> lock(compareCacheMutex);
+				auto it = compareCache.find(key);
+				if (it != compareCache.end())
+					return it->second;
+			}
+			bool result = edgeTypes.at(needleEdge).compare(edgeTypes.at(haystackEdge), swapPorts, swapPermutations);
+			std::lock_guard<std::mutex> lock(compareCacheMutex);
+			compareCache[key] = result;
+			return result;
 		}
 
 		bool compare(int needleEdge, int haystackEdge, const std::map<std::string, std::string> &mapFromPorts, const std::map<std::string, std::set<std::set<std::string>>> &swapPorts,
@@ -871,37 +882,40 @@ class SubCircuit::SolverWorker
 		return false;
 	}
 
-	void generateEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
+	void addEnumerationCandidates(std::set<int> &row, const GraphData &needle, int needleNodeIdx, const GraphData &haystack, const std::string &typeId,
+			const std::map<std::string, std::set<std::string>> &initialMappings) const
 	{
-		std::map<std::string, std::set<int>> haystackNodesByTypeId;
-		for (int i = 0; i < int(haystack.graph.nodes.size()); i++)
-			haystackNodesByTypeId[haystack.graph.nodes[i].typeId].insert(i);
+		auto it = haystack.nodesByTypeId.find(typeId);
+		if (it == haystack.nodesByTypeId.end())
+			return;
 
+		const Graph::Node &nn = needle.graph.nodes[needleNodeIdx];
+		for (int j : it->second) {
+			const Graph::Node &hn = haystack.graph.nodes[j];
+			if (initialMappings.count(nn.nodeId) > 0 && initialMappings.at(nn.nodeId).count(hn.nodeId) == 0)
+				continue;
+			// the neighbours of the needle node map to distinct neighbours of the haystack node
+			if (haystack.adjMatrix[j].size() < needle.adjMatrix[needleNodeIdx].size())
+				continue;
+			if (!matchNodes(needle, needleNodeIdx, haystack, j))
+				continue;
+			row.insert(j);
+		}
+	}
+
+	void generateEnumerationMatrix(std::vector<std::set<int>> &enumerationMatrix, const GraphData &needle, const GraphData &haystack, const std::map<std::string, std::set<std::string>> &initialMappings) const
+	{
 		enumerationMatrix.clear();
 		enumerationMatrix.resize(needle.graph.nodes.size());
 		for (int i = 0; i < int(needle.graph.nodes.size()); i++)
 		{
 			const Graph::Node &nn = needle.graph.nodes[i];
 
-			for (int j : haystackNodesByTypeId[nn.typeId]) {
-				const Graph::Node &hn = haystack.graph.nodes[j];
-				if (initialMappings.count(nn.nodeId) > 0 && initialMappings.at(nn.nodeId).count(hn.nodeId) == 0)
-					continue;
-				if (!matchNodes(needle, i, haystack, j))
-					continue;
-				enumerationMatrix[i].insert(j);
-			}
+			addEnumerationCandidates(enumerationMatrix[i], needle, i, haystack, nn.typeId, initialMappings);
 
 			if (compatibleTypes.count(nn.typeId) > 0)
 				for (const std::string &compatibleTypeId : compatibleTypes.at(nn.typeId))
-					for (int j : haystackNodesByTypeId[compatibleTypeId]) {
-						const Graph::Node &hn = haystack.graph.nodes[j];
-						if (initialMappings.count(nn.nodeId) > 0 && initialMappings.at(nn.nodeId).count(hn.nodeId) == 0)
-							continue;
-						if (!matchNodes(needle, i, haystack, j))
-							continue;
-						enumerationMatrix[i].insert(j);
-					}
+					addEnumerationCandidates(enumerationMatrix[i], needle, i, haystack, compatibleTypeId, initialMappings);
 		}
 	}
 
@@ -1511,6 +1525,8 @@ protected:
 		gd.graphId = graphId;
 		gd.graph = graph;
 		diCache.add(gd.graph, gd.adjMatrix, graphId, userSolver);
+		for (int i = 0; i < int(gd.graph.nodes.size()); i++)
+			gd.nodesByTypeId[gd.graph.nodes[i].typeId].push_back(i);
 	}
 
 	void addCompatibleTypes(std::string needleTypeId, std::string haystackTypeId)
@@ -1541,8 +1557,8 @@ protected:
 		assert(graphData.count(needleGraphId) > 0);
 		assert(graphData.count(haystackGraphId) > 0);
 
-		const GraphData &needle = graphData[needleGraphId];
-		GraphData &haystack = graphData[haystackGraphId];
+		const GraphData &needle = graphData.find(needleGraphId)->second;
+		GraphData &haystack = graphData.find(haystackGraphId)->second;
 
 		std::vector<std::set<int>> enumerationMatrix;
 		generateEnumerationMatrix(enumerationMatrix, needle, haystack, initialMappings);
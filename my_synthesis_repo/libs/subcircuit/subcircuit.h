@@ -141,6 +141,8 @@ namespace SubCircuit
 		void addSwappablePorts(std::string needleTypeId, std::set<std::string> ports);
 		void addSwappablePortsPermutation(std::string needleTypeId, std::map<std::string, std::string> portMapping);
 
+		// solve() may be called from several threads at once, as long as
+		// no two of the calls use the same haystack graph
 		void solve(std::vector<Result> &results, std::string needleGraphId, std::string haystackGraphId, bool allowOverlap = true, int maxSolutions = -1);
 		void solve(std::vector<Result> &results, std::string needleGraphId, std::string haystackGraphId,
 				const std::map<std::string, std::set<std::string>> &initialMapping, bool allowOverlap = true, int maxSolutions = -1);
@@ -3,6 +3,14 @@
  * Copyright (C) 2023 Gwenhael Goavec-Merou <gwenhael.goavec-merou@trabucayre.com>
  */
 #include "common.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 std::string StatusCodeToString(StatusCode code) {
 	switch (code) {
 		case StatusCode::SUCCESS:
@@ -50,6 +58,28 @@ std::string PipeTypeToString(PipeType pipeType) {
 	}
 }
 
+std::string WireFormatToString(WireFormat format) {
+	switch (format) {
+		case WireFormat::JSON:
+			return "json";
+		case WireFormat::CBOR:
+			return "cbor";
+		case WireFormat::MSGPACK:
+			return "msgpack";
+		default:
+			throw std::invalid_argument("Invalid WireFormat value");
+	}
+}
+
+bool WireFormatFromString(const std::string& name, WireFormat& format) {
+	for (auto candidate : {WireFormat::JSON, WireFormat::CBOR, WireFormat::MSGPACK})
+		if (name == WireFormatToString(candidate)) {
+			format = candidate;
+			return true;
+		}
+	return false;
+}
+
 std::string LogCategoryToString(LogCategory category) {
     switch (category) {
         case LogCategory::PROJECT:
@@ -93,6 +123,8 @@ namespace Common {
     std::string g_data_pipe_name    = R"(\\.\pipe\DataPipe_)";    // 数据管道名称
     std::string g_control_pipe_name = R"(\\.\pipe\ControlPipe_)"; // 控制管道名称
 	std::string g_log_cache = "";
+	WireFormat g_wire_format = WireFormat::JSON;
+	std::string g_job_id = "";
 	std::map<std::string, int> indices; // 存储每个类别的消息编号
 	// 动态生成消息唯一标号
     int GetNextIndex(const std::string& messagelabel) {
@@ -105,73 +137,394 @@ namespace Common {
      * @param jsonData: 要发送的 JSON 数据包
      */
 	void CreateLogHeader(std::string& log_info) {
+		// 标题在下一条发往管道的日志之前发送；若日志被屏蔽一直没有发出，
+		// 只保留最近的标题，避免缓存无限增长
+		const size_t kMaxLogCache = 4096;
+		if (g_log_cache.size() + log_info.size() > kMaxLogCache)
+			g_log_cache.clear();
 		g_log_cache += log_info;
 	}
 
+    // ---------- 后台发送线程 ----------
+    // 每个 PipeType 只建立一次连接并长期持有；调用方只负责入队，
+    // 序列化和写管道都在发送线程中完成。同一批次内的数据包一次
+    // WriteFile 写出：
+    //   JSON 格式：每个数据包一行（dump() 的输出不含裸换行）；
+    //   CBOR/MSGPACK 格式：连接建立后先写 8 字节帧头
+    //     "YSPF" + 版本号(1 字节) + 格式(1 字节) + 2 字节保留，
+    //   之后每个数据包为 4 字节小端长度 + 负载。
+    namespace {
+        struct PipeMessage {
+            PipeType pipe_type = PipeType::LOG;
+            nlohmann::json json_data;
+        };
+
+        // 定长环形缓冲区：写满后覆盖最旧的数据包并计数，
+        // 因此父进程长时间不读管道时内存占用也保持不变。
+        // 发送线程通过 swap() 整体接管缓冲区内容，不复制数据包。
+        class PipeRing {
+        public:
+            explicit PipeRing(size_t capacity) : slots_(capacity) { }
+
+            // 返回 false 表示缓冲区已满，最旧的数据包被覆盖
+            bool push(PipeMessage&& msg) {
+                slots_[(head_ + count_) % slots_.size()] = std::move(msg);
+                if (count_ == slots_.size()) {
+                    head_ = (head_ + 1) % slots_.size();
+                    return false;
+                }
+                count_++;
+                return true;
+            }
+
+            PipeMessage& operator[](size_t idx) { return slots_[(head_ + idx) % slots_.size()]; }
+            size_t size() const { return count_; }
+            bool empty() const { return count_ == 0; }
+
+            void clear() {
+                for (size_t i = 0; i < count_; i++)
+                    (*this)[i].json_data = nullptr;
+                head_ = 0;
+                count_ = 0;
+            }
+
+            void swap(PipeRing& other) {
+                slots_.swap(other.slots_);
+                std::swap(head_, other.head_);
+                std::swap(count_, other.count_);
+            }
+
+        private:
+            std::vector<PipeMessage> slots_;
+            size_t head_ = 0;
+            size_t count_ = 0;
+        };
+
+        const size_t kQueueCapacity = 16384;                     // 发送队列容量（包数）
+        const size_t kBatchMaxMessages = 256;                    // 单批次最大包数
+        const auto kBatchWindow = std::chrono::milliseconds(5); // 攒批等待时间
+
+        std::mutex g_queue_mutex;
+        std::condition_variable g_queue_cv;   // 通知发送线程有新数据
+        std::condition_variable g_drained_cv; // 通知 FlushPipes 队列已清空
+        PipeRing g_queue(kQueueCapacity);
+        size_t g_in_flight = 0;               // 已出队但尚未写完的包数
+        size_t g_dropped = 0;                 // 因队列溢出被丢弃的包数
+        std::string g_dropped_job_id;         // 最近一次溢出时在入队线程记下的 job_id，发送线程不读取 g_job_id
+        bool g_flush_requested = false;
+        bool g_stop_requested = false;
+        std::thread g_sender_thread;
+
+        // CONTROL 读取线程
+        std::thread g_control_thread;
+        std::atomic<bool> g_control_stop{false};
+        std::function<void(const nlohmann::json&)> g_control_handler;
+        const auto kControlPollInterval = std::chrono::milliseconds(20);
+
+#if defined(_WIN32) || defined(__MINGW32__)
+        // g_pipe_handles 由发送线程和 CONTROL 读取线程共享，访问时需持有 g_pipe_mutex
+        std::mutex g_pipe_mutex;
+        HANDLE g_pipe_handles[3] = { INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE, INVALID_HANDLE_VALUE };
+        bool g_pipe_failed[3] = { false, false, false }; // 避免连接失败时重复刷屏
+#endif
+
+        std::string PipeNameOf(PipeType pipeType) {
+            if (pipeType == PipeType::DATA)
+                return g_data_pipe_name + g_father_process_id;
+            if (pipeType == PipeType::CONTROL)
+                return g_control_pipe_name + g_father_process_id;
+            return g_log_pipe_name + g_father_process_id;
+        }
+
+#if defined(_WIN32) || defined(__MINGW32__)
+        void ReleasePipe(PipeType pipeType) {
+            int idx = static_cast<int>(pipeType) - 1;
+            if (g_pipe_handles[idx] != INVALID_HANDLE_VALUE)
+                CloseHandle(g_pipe_handles[idx]);
+            g_pipe_handles[idx] = INVALID_HANDLE_VALUE;
+        }
+
+        bool WritePipe(HANDLE hPipe, const std::string& buffer) {
+            DWORD bytesWritten = 0;
+            return WriteFile(hPipe, buffer.c_str(), static_cast<DWORD>(buffer.length()), &bytesWritten, NULL) &&
+                    bytesWritten == static_cast<DWORD>(buffer.length());
+        }
+
+        // 二进制格式下，每个新连接先发送帧头，供父进程识别格式和版本
+        bool WriteWireHeader(HANDLE hPipe) {
+            if (g_wire_format == WireFormat::JSON)
+                return true;
+            std::string header = "YSPF";
+            header += static_cast<char>(kWireFormatVersion);
+            header += static_cast<char>(g_wire_format);
+            header += std::string(2, '\0');
+            return WritePipe(hPipe, header);
+        }
+
+        // 获取（必要时建立）到指定管道的长连接
+        HANDLE AcquirePipe(PipeType pipeType) {
+            int idx = static_cast<int>(pipeType) - 1;
+            if (g_pipe_handles[idx] != INVALID_HANDLE_VALUE)
+                return g_pipe_handles[idx];
+
+            std::string pipeName = PipeNameOf(pipeType);
+            // 将 std::string 转换为 std::wstring（Windows 使用宽字符）
+            std::wstring wpipeName = std::wstring(pipeName.begin(), pipeName.end());
+            HANDLE hPipe = CreateFileW(
+                wpipeName.c_str(),              // 命名管道名称
+                GENERIC_WRITE | GENERIC_READ,   // 读写权限
+                0,                              // 其他进程是否可以访问(0:不共享管道)
+                NULL,                           // 默认安全属性
+                OPEN_EXISTING,                  // 打开现有管道
+                FILE_ATTRIBUTE_NORMAL,          // 同步模式
+                NULL                            // 无模板
+            );
+            // 处理异常
+            if (hPipe == INVALID_HANDLE_VALUE) {
+                if (!g_pipe_failed[idx]) {
+                    DWORD errorCode = GetLastError();
+                    if (errorCode == ERROR_FILE_NOT_FOUND) { // 管道不存在
+                        std::cerr << "Pipe not found: " << pipeName << std::endl;
+                    } else if (errorCode == ERROR_ACCESS_DENIED) { // 访问被拒绝
+                        std::cerr << "Access denied to pipe: " << pipeName << std::endl;
+                    } else {
+                        std::cerr << "Failed to connect to pipe: " << pipeName << " Error: " << errorCode << std::endl;
+                    }
+                }
+                g_pipe_failed[idx] = true;
+                return INVALID_HANDLE_VALUE;
+            }
+            g_pipe_failed[idx] = false;
+            if (!WriteWireHeader(hPipe)) {
+                CloseHandle(hPipe);
+                return INVALID_HANDLE_VALUE;
+            }
+            g_pipe_handles[idx] = hPipe;
+            return hPipe;
+        }
+#endif
+
+        // 把一批数据包写入对应管道；写失败时重连一次，仍失败则丢弃该批次
+        void SendBatch(PipeType pipeType, const std::string& buffer) {
+            if (buffer.empty())
+                return;
+#if defined(_WIN32) || defined(__MINGW32__)
+            std::lock_guard<std::mutex> pipe_lock(g_pipe_mutex);
+            for (int attempt = 0; attempt < 2; attempt++) {
+                HANDLE hPipe = AcquirePipe(pipeType);
+                if (hPipe == INVALID_HANDLE_VALUE)
+                    return;
+                if (WritePipe(hPipe, buffer))
+                    return;
+                // 父进程可能已断开，关闭旧句柄后重连
+                DWORD errorCode = GetLastError();
+                ReleasePipe(pipeType);
+                if (attempt == 1)
+                    std::cerr << "Failed to write to pipe: " << PipeNameOf(pipeType) << " Error: " << std::to_string(errorCode) << std::endl;
+            }
+#else
+            (void)pipeType;
+#endif
+        }
+
+        // 按当前传输格式把一个数据包追加到发送缓冲区
+        void EncodeMessage(const nlohmann::json& jsonData, std::string& buffer) {
+            if (g_wire_format == WireFormat::JSON) {
+                buffer += jsonData.dump();
+                buffer += '\n';
+                return;
+            }
+            std::vector<uint8_t> payload = g_wire_format == WireFormat::CBOR ?
+                    nlohmann::json::to_cbor(jsonData) : nlohmann::json::to_msgpack(jsonData);
+            uint32_t length = static_cast<uint32_t>(payload.size());
+            for (int i = 0; i < 4; i++)
+                buffer += static_cast<char>((length >> (8 * i)) & 0xff);
+            buffer.append(payload.begin(), payload.end());
+        }
+
+        void SenderMain() {
+            PipeRing batch(kQueueCapacity);
+            std::unique_lock<std::mutex> lock(g_queue_mutex);
+            while (true) {
+                g_queue_cv.wait(lock, [] { return !g_queue.empty() || g_stop_requested; });
+                if (g_queue.empty() && g_stop_requested)
+                    break;
+
+                // 攒批：等待更多数据包，直到达到数量上限、超时或被要求刷新
+                if (!g_flush_requested && !g_stop_requested && g_queue.size() < kBatchMaxMessages)
+                    g_queue_cv.wait_for(lock, kBatchWindow, [] {
+                        return g_flush_requested || g_stop_requested || g_queue.size() >= kBatchMaxMessages;
+                    });
+
+                batch.swap(g_queue);
+                g_in_flight = batch.size();
+                size_t dropped = g_dropped;
+                std::string dropped_job_id = std::move(g_dropped_job_id);
+                g_dropped = 0;
+                g_dropped_job_id.clear();
+                lock.unlock();
+
+                // 相同管道的连续数据包合并为一次写操作
+                std::string buffer;
+                PipeType current = PipeType::LOG;
+                if (dropped > 0) {
+                    EncodeMessage(CreateLogJson(LevelCode::WARNING_LOG,
+                            std::to_string(dropped) + " pipe messages were dropped because the pipe send queue overflowed.\n",
+                            "PIPE_OVERFLOW", dropped_job_id), buffer);
+                }
+                for (size_t i = 0; i < batch.size(); i++) {
+                    PipeMessage &msg = batch[i];
+                    if (msg.pipe_type != current) {
+                        SendBatch(current, buffer);
+                        buffer.clear();
+                        current = msg.pipe_type;
+                    }
+                    EncodeMessage(msg.json_data, buffer);
+                }
+                SendBatch(current, buffer);
+                batch.clear();
+
+                lock.lock();
+                g_in_flight = 0;
+                if (g_queue.empty()) {
+                    g_flush_requested = false;
+                    g_drained_cv.notify_all();
+                }
+            }
+
+#if defined(_WIN32) || defined(__MINGW32__)
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> pipe_lock(g_pipe_mutex);
+                ReleasePipe(PipeType::LOG);
+                ReleasePipe(PipeType::DATA);
+                ReleasePipe(PipeType::CONTROL);
+            }
+            lock.lock();
+#endif
+            g_drained_cv.notify_all();
+        }
+
+        // 轮询 CONTROL 管道：父进程每条命令为一行 JSON（与传输格式无关）。
+        // 只在 PeekNamedPipe 报告有数据时才 ReadFile，因此不会阻塞发送线程的写操作。
+        void ControlReaderMain() {
+            std::string pending;
+            while (!g_control_stop.load()) {
+                std::string chunk;
+#if defined(_WIN32) || defined(__MINGW32__)
+                {
+                    std::lock_guard<std::mutex> pipe_lock(g_pipe_mutex);
+                    HANDLE hPipe = AcquirePipe(PipeType::CONTROL);
+                    DWORD available = 0;
+                    if (hPipe != INVALID_HANDLE_VALUE) {
+                        if (!PeekNamedPipe(hPipe, NULL, 0, NULL, &available, NULL)) {
+                            ReleasePipe(PipeType::CONTROL);
+                            available = 0;
+                        }
+                    }
+                    if (available > 0) {
+                        chunk.resize(available);
+                        DWORD bytesRead = 0;
+                        if (ReadFile(hPipe, &chunk[0], available, &bytesRead, NULL))
+                            chunk.resize(bytesRead);
+                        else
+                            chunk.clear();
+                    }
+                }
+#endif
+                if (chunk.empty()) {
+                    std::this_thread::sleep_for(kControlPollInterval);
+                    continue;
+                }
+
+                pending += chunk;
+                size_t pos;
+                while ((pos = pending.find('\n')) != std::string::npos) {
+                    std::string line = pending.substr(0, pos);
+                    pending.erase(0, pos + 1);
+                    if (line.find_first_not_of(" \t\r") == std::string::npos)
+                        continue;
+                    nlohmann::json command = nlohmann::json::parse(line, nullptr, false);
+                    if (command.is_discarded() || !command.is_object()) {
+                        std::cerr << "Ignoring malformed control command: " << line << std::endl;
+                        continue;
+                    }
+                    g_control_handler(command);
+                }
+            }
+        }
+    }
+
     /**
-     * 通过命名管道发送 JSON 数据包
-     * @param pipeName: 命名管道名称
+     * 将 JSON 数据包放入发送队列，由后台线程异步写入命名管道
+     * @param pipeType: 管道类型
      * @param jsonData: 要发送的 JSON 数据包
      */
     void ConnectAndSendJson(PipeType pipeType, nlohmann::json jsonData) {
-        if(Common::g_father_process_id != "-1"){
-            std::string pipeName = Common::g_log_pipe_name;
-            if (pipeType == PipeType::LOG){
-				pipeName = Common::g_log_pipe_name + Common::g_father_process_id;
-				// 将 JSON 对象序列化为字符串
-				jsonData["message_content"] = g_log_cache + jsonData["message_content"].get<std::string>();
-			}
-            else if (pipeType == PipeType::DATA){
-                pipeName = Common::g_data_pipe_name + Common::g_father_process_id;
-			}
-            else if (pipeType == PipeType::CONTROL)
-                pipeName = Common::g_control_pipe_name + Common::g_father_process_id;
-
-			#if defined(_WIN32) || defined(__MINGW32__)
-				// 将 std::string 转换为 std::wstring（Windows 使用宽字符）
-				std::wstring wpipeName = std::wstring(pipeName.begin(), pipeName.end());
-				// 尝试连接到指定名称的命名管道
-				HANDLE hPipe = CreateFileW(
-					wpipeName.c_str(),              // 命名管道名称
-					GENERIC_WRITE | GENERIC_READ,   // 读写权限
-					0,                              // 其他进程是否可以访问(0:不共享管道)
-					NULL,                           // 默认安全属性
-					OPEN_EXISTING,                  // 打开现有管道
-					FILE_ATTRIBUTE_NORMAL,          // 同步模式
-					NULL                            // 无模板
-				);
-				// 处理异常
-				if (hPipe == INVALID_HANDLE_VALUE) {
-					DWORD errorCode = GetLastError();
-					if (errorCode == ERROR_FILE_NOT_FOUND) { // 管道不存在
-						std::cerr << "Pipe not found: " << pipeName << std::endl;
-					} else if (errorCode == ERROR_ACCESS_DENIED) { // 访问被拒绝
-						std::cerr << "Access denied to pipe: " << pipeName << std::endl;
-					} else {
-						std::cerr << "Failed to connect to pipe: " << pipeName << " Error: " << errorCode << std::endl;
-					}
-					return;
-				}
-
-				g_log_cache = "";
-				std::string jsonString = jsonData.dump();
-
-				// 发送 JSON 数据到命名管道
-				DWORD bytesWritten = 0;
-				if (WriteFile(hPipe, jsonString.c_str(), static_cast<DWORD>(jsonString.length()), &bytesWritten, NULL)) {
-					std::cout << "JSON message sent to pipe: "<< pipeName << " (" << std::to_string(bytesWritten) << " bytes written)" << std::endl;
-				} else {
-					DWORD errorCode = GetLastError();
-					std::cerr << "Failed to write to pipe: "<< pipeName << " Error: " << std::to_string(errorCode) << std::endl;
-				}
-				// // 关闭管道句柄
-				CloseHandle(hPipe);
-			#endif
-		}
+        if (Common::g_father_process_id == "-1")
+            return;
+
+        if (pipeType == PipeType::LOG) {
+            jsonData["message_content"] = g_log_cache + jsonData["message_content"].get<std::string>();
+            g_log_cache = "";
+        }
+
+        std::lock_guard<std::mutex> lock(g_queue_mutex);
+        if (g_stop_requested)
+            return;
+        if (!g_sender_thread.joinable()) {
+            g_sender_thread = std::thread(SenderMain);
+            std::atexit(ShutdownPipes);
+        }
+        if (!g_queue.push(PipeMessage{pipeType, std::move(jsonData)})) {
+            g_dropped++;
+            g_dropped_job_id = g_job_id;
+        }
+        if (g_queue.size() == 1 || g_queue.size() >= kBatchMaxMessages)
+            g_queue_cv.notify_one();
+    }
+
+    void FlushPipes() {
+        std::unique_lock<std::mutex> lock(g_queue_mutex);
+        if (!g_sender_thread.joinable())
+            return;
+        g_flush_requested = true;
+        g_queue_cv.notify_one();
+        g_drained_cv.wait(lock, [] { return g_queue.empty() && g_in_flight == 0; });
+    }
+
+    void StartControlReader(std::function<void(const nlohmann::json&)> handler) {
+        if (Common::g_father_process_id == "-1" || g_control_thread.joinable())
+            return;
+#if defined(_WIN32) || defined(__MINGW32__)
+        g_control_handler = handler;
+        g_control_thread = std::thread(ControlReaderMain);
+#else
+        (void)handler;
+#endif
+    }
+
+    void ShutdownPipes() {
+        if (g_control_thread.joinable()) {
+            g_control_stop.store(true);
+            g_control_thread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_queue_mutex);
+            if (!g_sender_thread.joinable())
+                return;
+            g_stop_requested = true;
+            g_queue_cv.notify_one();
+        }
+        g_sender_thread.join();
     }
 
 
     nlohmann::json CreateLogJson(LevelCode level_code,const std::string message_content,const std::string task_info) {
+        return CreateLogJson(level_code, message_content, task_info, g_job_id);
+    }
+
+    nlohmann::json CreateLogJson(LevelCode level_code,const std::string message_content,const std::string task_info,const std::string& job_id) {
         nlohmann::json packet;
         packet["pipe_type"] = PipeTypeToString(PipeType::LOG);            // 日志
         packet["level_code"] = static_cast<int>(level_code);  // 级别
@@ -180,6 +533,8 @@ namespace Common {
         packet["sub_phase"] = "SYNTHESIS";
         packet["category"] = "";
         packet["task_info"] = task_info;
+        if (!job_id.empty())
+            packet["job_id"] = job_id;
         return packet;
     }
 
@@ -192,6 +547,8 @@ namespace Common {
 		packet["phase"] = "SYNTHESIS";
         packet["sub_phase"] = "SYNTHESIS";
 		packet["task_info"] = task_info;
+        if (!g_job_id.empty())
+            packet["job_id"] = g_job_id;
         return packet;
     }
 
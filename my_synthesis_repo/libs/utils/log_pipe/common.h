@@ -10,6 +10,7 @@
 #include "libs/nlohmann/json.hpp" // 引入 nlohmann/json
 #include "libs/utils/log_pipe/common.h"
 #include <iostream>
+#include <functional>
 
 #if defined(_WIN32) || defined(__MINGW32__)
 #include <windows.h>
@@ -43,6 +44,15 @@ enum class PipeType {
     CONTROL = 3
 };
 
+// 管道传输格式
+enum class WireFormat {
+    JSON = 0,   // 文本 JSON，每个数据包一行（默认，兼容旧版父进程）
+    CBOR = 1,   // 长度前缀帧 + CBOR 负载
+    MSGPACK = 2 // 长度前缀帧 + MessagePack 负载
+};
+
+// 二进制传输格式的版本号，写在每个连接的帧头中
+const int kWireFormatVersion = 1;
 
 // 状态码的枚举类
 enum class StatusCode {
@@ -58,6 +68,9 @@ std::string LevelCodeToString(LevelCode code);
 std::string LogCategoryToString(LogCategory category);
 std::string PipeTypeToString(PipeType type);
 std::string StatusCodeToString(StatusCode code);
+std::string WireFormatToString(WireFormat format);
+// 解析传输格式名称（json/cbor/msgpack），无法识别时返回 false
+bool WireFormatFromString(const std::string& name, WireFormat& format);
 
 // 定义 LogData 结构体,用来存储进程通信字段
 struct LogData {
@@ -90,8 +103,26 @@ namespace Common {
     extern std::string g_data_pipe_name;    // 数据管道名称
     extern std::string g_control_pipe_name; // 控制管道名称
     extern std::string g_log_cache; // 日志缓存
+    extern WireFormat g_wire_format; // 管道传输格式，需在发送第一个数据包之前设置
+    extern std::string g_job_id; // 服务器模式（-Y）下正在执行的任务 id，非空时写入每个数据包的 job_id 字段
 	void CreateLogHeader(std::string& log_info);
     void ConnectAndSendJson(PipeType pipeType, nlohmann::json jsonData);
+
+    /*!
+    * \brief 阻塞等待后台发送线程把队列中已有的数据包全部写入管道
+    */
+    void FlushPipes();
+
+    /*!
+    * \brief 刷新队列、关闭所有管道连接并结束后台发送线程（进程退出前调用）
+    */
+    void ShutdownPipes();
+
+    /*!
+    * \brief 启动 CONTROL 管道读取线程（需已设置父进程 id）
+    * \param[in] handler: 每收到一条命令调用一次，在读取线程中执行
+    */
+    void StartControlReader(std::function<void(const nlohmann::json&)> handler);
 	// 动态生成消息唯一标号
     int GetNextIndex(const std::string& messagelabel);
 	extern std::map<std::string, int> indices;
@@ -104,6 +135,11 @@ namespace Common {
     */
 	nlohmann::json CreateLogJson(LevelCode level_code,const std::string message_content,const std::string task_info);
 
+    /*!
+    * \brief 同上，但 job_id 字段取自参数而不是 g_job_id（供发送线程使用）
+    */
+	nlohmann::json CreateLogJson(LevelCode level_code,const std::string message_content,const std::string task_info,const std::string& job_id);
+
     /*!
     * \brief 构造数据类型的 JSON 数据包
     * \param[in] data: 要传输的数据内容
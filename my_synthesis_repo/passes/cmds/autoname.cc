@@ -18,74 +18,133 @@
  */
 
 #include "kernel/yosys.h"
+#include <queue>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-int autoname_worker(Module *module, const dict<Wire*, int>& wire_score)
+// Proposes names for private cells from the public wires they are connected
+// to, and for private wires from the public cells they are connected to.  A
+// lower score is better: the number of cell ports on the wire (or 0 for an
+// output port), then the length of the name.  The proposals are renamed
+// best first, and every renamed object can then give names to its private
+// neighbours, so the whole module is handled in one pass.
+struct AutonameWorker
 {
-	dict<Cell*, pair<int, string>> proposed_cell_names;
-	dict<Wire*, pair<int, string>> proposed_wire_names;
-	int best_score = -1;
-
-	for (auto cell : module->selected_cells()) {
-		if (cell->name[0] == '$') {
-			for (auto &conn : cell->connections()) {
-				string suffix;
-				for (auto bit : conn.second)
-					if (bit.wire != nullptr && bit.wire->name[0] != '$') {
-						if (suffix.empty())
-							suffix = stringf("_%s_%s", log_id(cell->type), log_id(conn.first));
-						string new_name(bit.wire->name.str() + suffix);
-						int score = wire_score.at(bit.wire);
-						if (cell->output(conn.first)) score = 0;
-						score = 10000*score + new_name.size();
-						if (!proposed_cell_names.count(cell) || score < proposed_cell_names.at(cell).first) {
-							if (best_score < 0 || score < best_score)
-								best_score = score;
-							proposed_cell_names[cell] = make_pair(score, new_name);
-						}
-					}
-			}
-		} else {
-			for (auto &conn : cell->connections()) {
-				string suffix;
-				for (auto bit : conn.second)
-					if (bit.wire != nullptr && bit.wire->name[0] == '$' && !bit.wire->port_id) {
-						if (suffix.empty())
-							suffix = stringf("_%s", log_id(conn.first));
-						string new_name(cell->name.str() + suffix);
-						int score = wire_score.at(bit.wire);
-						if (cell->output(conn.first)) score = 0;
-						score = 10000*score + new_name.size();
-						if (!proposed_wire_names.count(bit.wire) || score < proposed_wire_names.at(bit.wire).first) {
-							if (best_score < 0 || score < best_score)
-								best_score = score;
-							proposed_wire_names[bit.wire] = make_pair(score, new_name);
-						}
-					}
-			}
+	// (score, name, object), object is a cell index or ~wire index
+	typedef std::tuple<int, string, int> proposal_t;
+
+	Module *module;
+	std::vector<Cell*> cells;
+	std::vector<Wire*> wires;
+	dict<Wire*, int> wire_index, wire_score;
+	dict<Wire*, std::vector<std::pair<int, IdString>>> wire_cells;
+	dict<int, std::pair<int, string>> best;
+	std::priority_queue<proposal_t, std::vector<proposal_t>, std::greater<proposal_t>> queue;
+
+	AutonameWorker(Module *module) : module(module)
+	{
+		cells = module->selected_cells();
+		for (auto wire : module->wires()) {
+			wire_index[wire] = GetSize(wires);
+			wires.push_back(wire);
 		}
+
+		for (int i = 0; i < GetSize(cells); i++)
+		for (auto &conn : cells[i]->connections())
+		for (auto bit : conn.second)
+			if (bit.wire != nullptr) {
+				wire_score[bit.wire]++;
+				auto &list = wire_cells[bit.wire];
+				if (list.empty() || list.back() != std::make_pair(i, conn.first))
+					list.push_back({i, conn.first});
+			}
+	}
+
+	void propose(int object, int score, string name)
+	{
+		auto it = best.find(object);
+		if (it != best.end() && !(std::make_pair(score, name) < it->second))
+			return;
+		best[object] = {score, name};
+		queue.push(proposal_t(score, std::move(name), object));
 	}
 
-	for (auto &it : proposed_cell_names) {
-		if (best_score*2 < it.second.first)
-			continue;
-		IdString n = module->uniquify(IdString(it.second.second));
-		log_debug("Rename cell %s in %s to %s.\n", log_id(it.first), log_id(module), log_id(n));
-		module->rename(it.first, n);
+	// a name for a private cell from a public wire on one of its ports
+	void propose_cell(int index, Wire *wire, IdString port)
+	{
+		Cell *cell = cells[index];
+		string new_name = stringf("%s_%s_%s", wire->name.c_str(), log_id(cell->type), log_id(port));
+		int score = cell->output(port) ? 0 : wire_score.at(wire);
+		propose(index, 10000*score + GetSize(new_name), std::move(new_name));
 	}
 
-	for (auto &it : proposed_wire_names) {
-		if (best_score*2 < it.second.first)
-			continue;
-		IdString n = module->uniquify(IdString(it.second.second));
-		log_debug("Rename wire %s in %s to %s.\n", log_id(it.first), log_id(module), log_id(n));
-		module->rename(it.first, n);
+	// names for the private wires on the ports of a public cell
+	void propose_wires(int index)
+	{
+		Cell *cell = cells[index];
+		for (auto &conn : cell->connections()) {
+			string new_name;
+			for (auto bit : conn.second)
+				if (bit.wire != nullptr && bit.wire->name[0] == '$' && !bit.wire->port_id) {
+					if (new_name.empty())
+						new_name = cell->name.str() + stringf("_%s", log_id(conn.first));
+					int score = cell->output(conn.first) ? 0 : wire_score.at(bit.wire);
+					propose(~wire_index.at(bit.wire), 10000*score + GetSize(new_name), new_name);
+				}
+		}
 	}
 
-	return proposed_cell_names.size() + proposed_wire_names.size();
-}
+	int run()
+	{
+		for (int i = 0; i < GetSize(cells); i++) {
+			Cell *cell = cells[i];
+			if (cell->name[0] != '$') {
+				propose_wires(i);
+				continue;
+			}
+			for (auto &conn : cell->connections())
+				for (auto bit : conn.second)
+					if (bit.wire != nullptr && bit.wire->name[0] != '$')
+						propose_cell(i, bit.wire, conn.first);
+		}
+
+		int count = 0;
+		while (!queue.empty())
+		{
+			proposal_t proposal = queue.top();
+			queue.pop();
+
+			int object = std::get<2>(proposal);
+			// skip proposals that were replaced by a better one, or whose object is renamed
+			auto it = best.find(object);
+			if (it == best.end() || it->second.first != std::get<0>(proposal) || it->second.second != std::get<1>(proposal))
+				continue;
+			best.erase(it);
+
+			if (object >= 0) {
+				Cell *cell = cells[object];
+				IdString n = module->uniquify(IdString(std::get<1>(proposal)));
+				log_debug("Rename cell %s in %s to %s.\n", log_id(cell), log_id(module), log_id(n));
+				module->rename(cell, n);
+				propose_wires(object);
+			} else {
+				Wire *wire = wires[~object];
+				IdString n = module->uniquify(IdString(std::get<1>(proposal)));
+				log_debug("Rename wire %s in %s to %s.\n", log_id(wire), log_id(module), log_id(n));
+				module->rename(wire, n);
+				auto it = wire_cells.find(wire);
+				if (it != wire_cells.end())
+					for (auto &cell_port : it->second)
+						if (cells[cell_port.first]->name[0] == '$')
+							propose_cell(cell_port.first, wire, cell_port.second);
+			}
+			count++;
+		}
+
+		return count;
+	}
+};
 
 struct AutonamePass : public Pass {
 	AutonamePass() : Pass("autoname", "automatically assign names to objects") { }
@@ -115,22 +174,10 @@ struct AutonamePass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
-			dict<Wire*, int> wire_score;
-			for (auto cell : module->selected_cells())
-			for (auto &conn : cell->connections())
-			for (auto bit : conn.second)
-				if (bit.wire != nullptr)
-					wire_score[bit.wire]++;
-
-			int count = 0, iter = 0;
-			while (1) {
-				iter++;
-				int n = autoname_worker(module, wire_score);
-				if (!n) break;
-				count += n;
-			}
+			AutonameWorker worker(module);
+			int count = worker.run();
 			if (count > 0)
-				log("Renamed %d objects in module %s (%d iterations).\n", count, log_id(module), iter);
+				log("Renamed %d objects in module %s.\n", count, log_id(module));
 		}
 	}
 } AutonamePass;
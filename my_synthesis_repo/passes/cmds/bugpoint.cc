@@ -18,7 +18,10 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "backends/rtlil/rtlil_backend.h"
+#include <climits>
+#include <stdarg.h>
 
 USING_YOSYS_NAMESPACE
 using namespace RTLIL_BACKEND;
@@ -92,21 +95,74 @@ struct BugpointPass : public Pass {
 		log("    -runner \"<prefix>\"\n");
 		log("        child process wrapping command, e.g., \"timeout 30\", or valgrind.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        test up to <num> candidates concurrently, each in its own child process.\n");
+		log("        the candidates are written to bugpoint-case.il, bugpoint-case-1.il and so\n");
+		log("        on. of the crashing candidates, the first one in removal order is kept,\n");
+		log("        so the result does not depend on <num>. The default is the value of the\n");
+		log("        synthesizer's -j option. scripts that write to fixed file names need\n");
+		log("        -j 1.\n");
+		log("\n");
+		log("    -single\n");
+		log("        only remove one part of the design at a time. without this option, the\n");
+		log("        parts are first removed in large chunks which are halved whenever no\n");
+		log("        chunk can be removed (delta debugging), until single parts remain.\n");
+		log("\n");
+		log("    -bin\n");
+		log("        pass the candidates to the child processes as binary RTLIL checkpoints\n");
+		log("        (see 'write_rtlil -bin'), which are faster to write and to read than\n");
+		log("        RTLIL text. the binary given with -yosys must support 'read_rtlil -bin'.\n");
+		log("\n");
 	}
 
-	bool run_yosys(RTLIL::Design *design, string runner, string yosys_cmd, string yosys_arg)
+	bool quiet_steps = false;
+	int candidate_count = 0;
+
+	void log_step(RTLIL::Design *design, const char *format, ...) YS_ATTRIBUTE(format(printf, 3, 4))
+	{
+		if (quiet_steps)
+			return;
+		va_list ap;
+		va_start(ap, format);
+		std::string str = vstringf(format, ap);
+		va_end(ap);
+		log_header(design, "%s", str.c_str());
+	}
+
+	static string case_name(int slot)
+	{
+		return slot ? stringf("bugpoint-case-%d", slot) : string("bugpoint-case");
+	}
+
+	// writes the testcase for a child process, needs to run on the main thread
+	string write_case(RTLIL::Design *design, int slot, bool binary)
 	{
 		design->sort();
 
-		std::ofstream f("bugpoint-case.il");
+		string name = case_name(slot);
+		if (binary) {
+			std::ofstream f(name + ".ilb", std::ios::binary);
+			RTLIL_BACKEND::dump_design_binary(f, design, /*only_selected=*/false);
+			return stringf("-f \"rtlil -bin\" %s.ilb", name.c_str());
+		}
+
+		std::ofstream f(name + ".il");
 		RTLIL_BACKEND::dump_design(f, design, /*only_selected=*/false, /*flag_m=*/true, /*flag_n=*/false);
-		f.close();
+		return name + ".il";
+	}
 
-		string yosys_cmdline = stringf("%s %s -qq -L bugpoint-case.log %s bugpoint-case.il", runner.c_str(), yosys_cmd.c_str(), yosys_arg.c_str());
+	static bool run_case(int slot, const string &case_arg, string runner, string yosys_cmd, string yosys_arg)
+	{
+		string yosys_cmdline = stringf("%s %s -qq -L %s.log %s %s", runner.c_str(), yosys_cmd.c_str(), case_name(slot).c_str(), yosys_arg.c_str(), case_arg.c_str());
 		return run_command(yosys_cmdline) == 0;
 	}
 
-	bool check_logfile(string grep)
+	bool run_yosys(RTLIL::Design *design, string runner, string yosys_cmd, string yosys_arg, bool binary)
+	{
+		return run_case(0, write_case(design, 0, binary), runner, yosys_cmd, yosys_arg);
+	}
+
+	bool check_logfile(string grep, int slot = 0)
 	{
 		if (grep.empty())
 			return true;
@@ -114,7 +170,7 @@ struct BugpointPass : public Pass {
 		if (grep.size() > 2 && grep.front() == '"' && grep.back() == '"')
 			grep = grep.substr(1, grep.size() - 2);
 
-		std::ifstream f("bugpoint-case.log");
+		std::ifstream f(case_name(slot) + ".log");
 		while (!f.eof())
 		{
 			string line;
@@ -161,7 +217,7 @@ struct BugpointPass : public Pass {
 
 				if (index++ == seed)
 				{
-					log_header(design, "Trying to remove module %s.\n", log_id(module));
+					log_step(design, "Trying to remove module %s.\n", log_id(module));
 					removed_module = module;
 					break;
 				}
@@ -191,7 +247,7 @@ struct BugpointPass : public Pass {
 
 					if (index++ == seed)
 					{
-						log_header(design, "Trying to remove module port %s.\n", log_id(wire));
+						log_step(design, "Trying to remove module port %s.\n", log_id(wire));
 						wire->port_input = wire->port_output = false;
 						mod->fixup_ports();
 						return design_copy;
@@ -214,7 +270,7 @@ struct BugpointPass : public Pass {
 
 					if (index++ == seed)
 					{
-						log_header(design, "Trying to remove cell %s.%s.\n", log_id(mod), log_id(cell));
+						log_step(design, "Trying to remove cell %s.%s.\n", log_id(mod), log_id(cell));
 						removed_cell = cell;
 						break;
 					}
@@ -245,7 +301,7 @@ struct BugpointPass : public Pass {
 
 						if (index++ == seed)
 						{
-							log_header(design, "Trying to remove cell port %s.%s.%s.\n", log_id(mod), log_id(cell), log_id(it.first));
+							log_step(design, "Trying to remove cell port %s.%s.%s.\n", log_id(mod), log_id(cell), log_id(it.first));
 							RTLIL::SigSpec port_x(State::Sx, port.size());
 							cell->unsetPort(it.first);
 							cell->setPort(it.first, port_x);
@@ -254,7 +310,7 @@ struct BugpointPass : public Pass {
 
 						if (!stage2 && (cell->input(it.first) || cell->output(it.first)) && index++ == seed)
 						{
-							log_header(design, "Trying to expose cell port %s.%s.%s as module port.\n", log_id(mod), log_id(cell), log_id(it.first));
+							log_step(design, "Trying to expose cell port %s.%s.%s as module port.\n", log_id(mod), log_id(cell), log_id(it.first));
 							RTLIL::Wire *wire = mod->addWire(NEW_ID, port.size());
 							wire->set_bool_attribute(ID($bugpoint));
 							wire->port_input = cell->input(it.first);
@@ -283,7 +339,7 @@ struct BugpointPass : public Pass {
 
 					if (index++ == seed)
 					{
-						log_header(design, "Trying to remove process %s.%s.\n", log_id(mod), log_id(process.first));
+						log_step(design, "Trying to remove process %s.%s.\n", log_id(mod), log_id(process.first));
 						removed_process = process.second;
 						break;
 					}
@@ -312,7 +368,7 @@ struct BugpointPass : public Pass {
 						{
 							if (index++ == seed)
 							{
-								log_header(design, "Trying to remove assign %s %s in %s.%s.\n", log_signal(it->first), log_signal(it->second), log_id(mod), log_id(pr.first));
+								log_step(design, "Trying to remove assign %s %s in %s.%s.\n", log_signal(it->first), log_signal(it->second), log_id(mod), log_id(pr.first));
 								cs->actions.erase(it);
 								return design_copy;
 							}
@@ -338,7 +394,7 @@ struct BugpointPass : public Pass {
 						{
 							if (index++ == seed)
 							{
-								log_header(design, "Trying to remove sync %s update %s %s in %s.%s.\n", log_signal(sy->signal), log_signal(it->first), log_signal(it->second), log_id(mod), log_id(pr.first));
+								log_step(design, "Trying to remove sync %s update %s %s in %s.%s.\n", log_signal(sy->signal), log_signal(it->first), log_signal(it->second), log_id(mod), log_id(pr.first));
 								sy->actions.erase(it);
 								return design_copy;
 							}
@@ -348,7 +404,7 @@ struct BugpointPass : public Pass {
 						{
 							if (index++ == seed)
 							{
-								log_header(design, "Trying to remove sync %s memwr %s %s %s %s in %s.%s.\n", log_signal(sy->signal), log_id(it->memid), log_signal(it->address), log_signal(it->data), log_signal(it->enable), log_id(mod), log_id(pr.first));
+								log_step(design, "Trying to remove sync %s memwr %s %s %s %s in %s.%s.\n", log_signal(sy->signal), log_id(it->memid), log_signal(it->address), log_signal(it->data), log_signal(it->enable), log_id(mod), log_id(pr.first));
 								sy->mem_write_actions.erase(it);
 								// Remove the bit for removed action from other actions' priority masks.
 								for (auto it2 = sy->mem_write_actions.begin(); it2 != sy->mem_write_actions.end(); ++it2) {
@@ -382,7 +438,7 @@ struct BugpointPass : public Pass {
 
 					if (index++ == seed)
 					{
-						log_header(design, "Trying to remove wire %s.%s.\n", log_id(mod), log_id(wire));
+						log_step(design, "Trying to remove wire %s.%s.\n", log_id(mod), log_id(wire));
 						removed_wire = wire;
 						break;
 					}
@@ -393,14 +449,35 @@ struct BugpointPass : public Pass {
 				}
 			}
 		}
+		candidate_count = index;
 		delete design_copy;
 		return nullptr;
 	}
 
+	// removes up to chunk consecutive parts, starting at the given seed
+	RTLIL::Design *simplify_chunk(RTLIL::Design *design, int seed, int chunk, bool stage2, bool modules, bool ports, bool cells, bool connections, bool processes, bool assigns, bool updates, bool wires)
+	{
+		RTLIL::Design *result = nullptr;
+		quiet_steps = chunk > 1;
+		for (int i = 0; i < chunk; i++) {
+			RTLIL::Design *next = simplify_something(result ? result : design, seed, stage2, modules, ports, cells, connections, processes, assigns, updates, wires);
+			if (next == nullptr)
+				break;
+			delete result;
+			result = next;
+		}
+		quiet_steps = false;
+
+		if (result != nullptr && chunk > 1)
+			log_header(design, "Trying to remove %d parts starting at index %d.\n", chunk, seed);
+		return result;
+	}
+
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		string yosys_cmd = "yosys", yosys_arg, grep, runner;
-		bool fast = false, clean = false;
+		bool fast = false, clean = false, single = false, binary = false;
+		int jobs = yosys_parallel_jobs;
 		bool modules = false, ports = false, cells = false, connections = false, processes = false, assigns = false, updates = false, wires = false, has_part = false;
 
 		log_header(design, "Executing BUGPOINT pass (minimize testcases).\n");
@@ -477,6 +554,20 @@ struct BugpointPass : public Pass {
 				has_part = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx + 1 < args.size()) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid number of jobs: %d\n", jobs);
+				continue;
+			}
+			if (args[argidx] == "-single") {
+				single = true;
+				continue;
+			}
+			if (args[argidx] == "-bin") {
+				binary = true;
+				continue;
+			}
 			if (args[argidx] == "-runner" && argidx + 1 < args.size()) {
 				runner = args[++argidx];
 				if (runner.size() && runner.at(0) == '"') {
@@ -508,50 +599,80 @@ struct BugpointPass : public Pass {
 			log_cmd_error("This command only operates on fully selected designs!\n");
 
 		RTLIL::Design *crashing_design = clean_design(design, clean);
-		if (run_yosys(crashing_design, runner, yosys_cmd, yosys_arg))
+		if (run_yosys(crashing_design, runner, yosys_cmd, yosys_arg, binary))
 			log_cmd_error("The provided script file or command and Yosys binary do not crash on this design!\n");
 		if (!check_logfile(grep))
 			log_cmd_error("The provided grep string is not found in the log file!\n");
 
-		int seed = 0;
+		int seed = 0, chunk = 1;
 		bool found_something = false, stage2 = false;
+
+		if (!single) {
+			int unused_seed = INT_MAX;
+			simplify_something(crashing_design, unused_seed, stage2, modules, ports, cells, connections, processes, assigns, updates, wires);
+			chunk = std::max(candidate_count / 2, 1);
+		}
+
 		while (true)
 		{
-			if (RTLIL::Design *simplified = simplify_something(crashing_design, seed, stage2, modules, ports, cells, connections, processes, assigns, updates, wires))
-			{
-				simplified = clean_design(simplified, fast, /*do_delete=*/true);
+			std::vector<RTLIL::Design*> candidates;
+			while (GetSize(candidates) < jobs) {
+				RTLIL::Design *simplified = simplify_chunk(crashing_design, seed + GetSize(candidates) * chunk, chunk, stage2, modules, ports, cells, connections, processes, assigns, updates, wires);
+				if (simplified == nullptr)
+					break;
+				candidates.push_back(clean_design(simplified, fast, /*do_delete=*/true));
+			}
 
-				bool crashes;
-				if (clean)
-				{
-					RTLIL::Design *testcase = clean_design(simplified);
-					crashes = !run_yosys(testcase, runner, yosys_cmd, yosys_arg);
-					delete testcase;
-				}
-				else
-				{
-					crashes = !run_yosys(simplified, runner, yosys_cmd, yosys_arg);
+			if (!candidates.empty())
+			{
+				std::vector<string> case_args;
+				for (int i = 0; i < GetSize(candidates); i++) {
+					if (clean) {
+						RTLIL::Design *testcase = clean_design(candidates[i]);
+						case_args.push_back(write_case(testcase, i, binary));
+						delete testcase;
+					} else
+						case_args.push_back(write_case(candidates[i], i, binary));
 				}
 
-				if (crashes && check_logfile(grep))
+				std::vector<char> crashes(GetSize(candidates));
+				parallel_for(GetSize(candidates), [&](int i) {
+					crashes[i] = !run_case(i, case_args[i], runner, yosys_cmd, yosys_arg);
+				}, jobs);
+
+				int crashing = -1;
+				for (int i = 0; i < GetSize(candidates) && crashing < 0; i++)
+					if (crashes[i] && check_logfile(grep, i))
+						crashing = i;
+
+				if (crashing >= 0)
 				{
 					log("Testcase crashes.\n");
 					if (crashing_design != design)
 						delete crashing_design;
-					crashing_design = simplified;
+					crashing_design = candidates[crashing];
+					candidates[crashing] = nullptr;
+					seed += crashing * chunk;
 					found_something = true;
 				}
 				else
 				{
 					log("Testcase does not crash.\n");
-					delete simplified;
-					seed++;
+					seed += GetSize(candidates) * chunk;
 				}
+
+				for (auto candidate : candidates)
+					delete candidate;
 			}
 			else
 			{
 				seed = 0;
-				if (found_something)
+				if (chunk > 1)
+				{
+					chunk /= 2;
+					log("Reducing chunk size to %d.\n", chunk);
+				}
+				else if (found_something)
 					found_something = false;
 				else
 				{
@@ -22,6 +22,8 @@
 #include "kernel/celledges.h"
 #include "kernel/celltypes.h"
 #include "kernel/utils.h"
+#include "kernel/threading.h"
+#include <atomic>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -59,10 +61,13 @@ struct CheckPass : public Pass {
 		log("    -assert\n");
 		log("        produce a runtime error if any problems are found in the current design\n");
 		log("\n");
+		log("When synthesizer runs with -j <jobs>, the modules are checked concurrently. The\n");
+		log("warnings are reported in module order.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
-		int counter = 0;
+		std::atomic<int> counter(0);
 		bool noinit = false;
 		bool initdrv = false;
 		bool mapped = false;
@@ -97,17 +102,20 @@ struct CheckPass : public Pass {
 
 		log_header(design, "Executing CHECK pass (checking for obvious problems).\n");
 
-		for (auto module : design->selected_whole_modules_warn())
+		// warnings are buffered per module and replayed in module order
+		std::vector<RTLIL::Module*> modules = design->selected_whole_modules_warn();
+		parallel_for_modules(design, modules, [&](RTLIL::Module *module)
 		{
 			if(log_verbose_level > 9)
 				log("Checking module %s...\n", log_id(module));
 
-			SigMap sigmap(module);
+			const SigMap &sigmap = SigMap::get(module);
 			dict<SigBit, vector<string>> wire_drivers;
 			dict<SigBit, Cell *> driver_cells;
 			dict<SigBit, int> wire_drivers_count;
 			pool<SigBit> used_wires;
-			TopoSort<std::pair<RTLIL::IdString, int>> topo;
+			idict<std::pair<RTLIL::IdString, int>> nodes;
+			std::vector<std::pair<int, int>> edges;
 			for (auto &proc_it : module->processes)
 			{
 				std::vector<RTLIL::CaseRule*> all_cases = {&proc_it.second->root_case};
@@ -153,11 +161,16 @@ struct CheckPass : public Pass {
 			}
 
 			struct CircuitEdgesDatabase : AbstractCellEdgesDatabase {
-				TopoSort<std::pair<RTLIL::IdString, int>> &topo;
-				SigMap sigmap;
+				idict<std::pair<RTLIL::IdString, int>> &nodes;
+				std::vector<std::pair<int, int>> &edges;
+				const SigMap &sigmap;
+
+				CircuitEdgesDatabase(idict<std::pair<RTLIL::IdString, int>> &nodes, std::vector<std::pair<int, int>> &edges, const SigMap &sigmap)
+					: nodes(nodes), edges(edges), sigmap(sigmap) {}
 
-				CircuitEdgesDatabase(TopoSort<std::pair<RTLIL::IdString, int>> &topo, SigMap &sigmap)
-					: topo(topo), sigmap(sigmap) {}
+				void edge(std::pair<RTLIL::IdString, int> from, std::pair<RTLIL::IdString, int> to) {
+					edges.push_back({nodes(from), nodes(to)});
+				}
 
 				void add_edge(RTLIL::Cell *cell, RTLIL::IdString from_port, int from_bit,
 							  RTLIL::IdString to_port, int to_bit, int) override {
@@ -169,7 +182,7 @@ struct CheckPass : public Pass {
 					SigBit to = sigmap(to_portsig[to_bit]);
 
 					if (from.wire && to.wire)
-						topo.edge(std::make_pair(from.wire->name, from.offset), std::make_pair(to.wire->name, to.offset));
+						edge(std::make_pair(from.wire->name, from.offset), std::make_pair(to.wire->name, to.offset));
 				}
 
 				bool add_edges_from_cell(Cell *cell) {
@@ -181,20 +194,20 @@ struct CheckPass : public Pass {
 						if (cell->input(conn.first))
 						for (auto bit : sigmap(conn.second))
 						if (bit.wire)
-							topo.edge(std::make_pair(bit.wire->name, bit.offset),
+							edge(std::make_pair(bit.wire->name, bit.offset),
 									  std::make_pair(cell->name, -1));
 
 						if (cell->output(conn.first))
 						for (auto bit : sigmap(conn.second))
 						if (bit.wire)
-							topo.edge(std::make_pair(cell->name, -1),
+							edge(std::make_pair(cell->name, -1),
 									  std::make_pair(bit.wire->name, bit.offset));
 					}
 					return true;
 				}
 			};
 
-			CircuitEdgesDatabase edges_db(topo, sigmap);
+			CircuitEdgesDatabase edges_db(nodes, edges, sigmap);
 
 			for (auto cell : module->cells())
 			{
@@ -281,8 +294,54 @@ struct CheckPass : public Pass {
 					counter++;
 				}
 
-			topo.sort();
-			for (auto &loop : topo.loops) {
+			// report one loop through every strongly connected component
+			CsrGraph graph(GetSize(nodes), edges);
+			std::vector<std::vector<int>> sccs;
+			find_sccs(graph, sccs, /*include_trivial=*/true);
+
+			std::vector<int> component(GetSize(nodes), -1);
+			for (int i = 0; i < GetSize(sccs); i++)
+				for (int n : sccs[i])
+					component[n] = i;
+
+			std::vector<std::vector<std::pair<RTLIL::IdString, int>>> loops;
+			std::vector<int> parent(GetSize(nodes), -1);
+			for (int i = GetSize(sccs) - 1; i >= 0; i--) {
+				int start = *std::min_element(sccs[i].begin(), sccs[i].end());
+
+				// breadth first search for the shortest path from start back to start
+				std::vector<int> queue = {start}, visited;
+				int last = -1;
+				for (int k = 0; k < GetSize(queue) && last < 0; k++) {
+					int n = queue[k];
+					for (int e = graph.first[n]; e < graph.first[n+1]; e++) {
+						int m = graph.targets[e];
+						if (m == start) {
+							last = n;
+							break;
+						}
+						if (component[m] != i || parent[m] >= 0)
+							continue;
+						parent[m] = n;
+						visited.push_back(m);
+						queue.push_back(m);
+					}
+				}
+
+				if (last >= 0) {
+					std::vector<std::pair<RTLIL::IdString, int>> loop;
+					for (int n = last; n != start; n = parent[n])
+						loop.push_back(nodes[n]);
+					loop.push_back(nodes[start]);
+					std::reverse(loop.begin(), loop.end());
+					loops.push_back(std::move(loop));
+				}
+
+				for (int n : visited)
+					parent[n] = -1;
+			}
+
+			for (auto &loop : loops) {
 				string message = stringf("found logic loop in module %s:\n", log_id(module));
 
 				// `loop` only contains wire bits, or an occassional special helper node for cells for
@@ -303,12 +362,12 @@ struct CheckPass : public Pass {
 
 					struct MatchingEdgePrinter : AbstractCellEdgesDatabase {
 						std::string &message;
-						SigMap &sigmap;
+						const SigMap &sigmap;
 						SigBit from, to;
 						int nhits;
 						const int HITS_LIMIT = 3;
 
-						MatchingEdgePrinter(std::string &message, SigMap &sigmap, SigBit from, SigBit to)
+						MatchingEdgePrinter(std::string &message, const SigMap &sigmap, SigBit from, SigBit to)
 							: message(message), sigmap(sigmap), from(from), to(to), nhits(0) {}
 
 						void add_edge(RTLIL::Cell *cell, RTLIL::IdString from_port, int from_bit,
@@ -373,12 +432,12 @@ struct CheckPass : public Pass {
 					counter++;
 				}
 			}
-		}
+		});
 
-		log("Found and reported %d problems.\n", counter);
+		log("Found and reported %d problems.\n", counter.load());
 
 		if (assert_mode && counter > 0)
-			log_error("Found %d problems in 'check -assert'.\n", counter);
+			log_error("Found %d problems in 'check -assert'.\n", counter.load());
 	}
 } CheckPass;
 
@@ -39,6 +39,8 @@ static void unset_drivers(RTLIL::Design *design, RTLIL::Module *module, SigMap &
 
 	for (auto &conn : module->connections_)
 		sigmap(conn.first).replace(sig, dummy_wire, &conn.first);
+
+	module->notify_blackout();
 }
 
 struct ConnectPass : public Pass {
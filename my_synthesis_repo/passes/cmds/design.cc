@@ -49,6 +49,10 @@ struct DesignPass : public Pass {
 		log("\n");
 		log("Save the current design under the given name.\n");
 		log("\n");
+		log("Saved and pushed designs share their modules with the current design. A module\n");
+		log("is only copied when one of the designs accesses it for modification, so saving\n");
+		log("or loading a design is cheap even for large designs.\n");
+		log("\n");
 		log("\n");
 		log("    design -stash <name>\n");
 		log("\n");
@@ -343,8 +347,9 @@ struct DesignPass : public Pass {
 		{
 			RTLIL::Design *design_copy = new RTLIL::Design;
 
-			for (auto mod : design->modules())
-				design_copy->add(mod->clone());
+			// modules are shared copy-on-write, see RTLIL::Design::add_shared()
+			for (auto &it : design->modules_)
+				design_copy->add_shared(it.second);
 
 			design_copy->selection_stack = design->selection_stack;
 			design_copy->selection_vars = design->selection_vars;
@@ -361,7 +366,11 @@ struct DesignPass : public Pass {
 
 		if (reset_mode || !load_name.empty() || push_mode || pop_mode)
 		{
-			for (auto mod : design->modules().to_vector())
+			// not via modules(), which would unshare what is about to be dropped
+			std::vector<RTLIL::Module*> old_modules;
+			for (auto &it : design->modules_)
+				old_modules.push_back(it.second);
+			for (auto mod : old_modules)
 				design->remove(mod);
 
 			design->selection_stack.clear();
@@ -388,8 +397,8 @@ struct DesignPass : public Pass {
 		{
 			RTLIL::Design *saved_design = pop_mode ? pushed_designs.back() : saved_designs.at(load_name);
 
-			for (auto mod : saved_design->modules())
-				design->add(mod->clone());
+			for (auto &it : saved_design->modules_)
+				design->add_shared(it.second);
 
 			design->selection_stack = saved_design->selection_stack;
 			design->selection_vars = saved_design->selection_vars;
@@ -527,28 +527,24 @@ struct DftTagWorker {
 			if (cell->type.in(ID($_ANDNOT_), ID($_ORNOT_)))
 				inv_b ^= true;
 
-			if (inv_a)
-				sig_a = autoNot(NEW_ID, sig_a);
-			if (inv_b)
-				sig_b = autoNot(NEW_ID, sig_b);
-
-			auto group_sig_a = tag_group_signal(tag, sig_a);
-			auto group_sig_b = tag_group_signal(tag, sig_b);
-
+			// Tags are looked up on the original inputs, the inverted signals
+			// are new wires that the propagation never saw
 			auto tag_sig_a = tag_signal(tag, sig_a);
 			auto tag_sig_b = tag_signal(tag, sig_b);
 
+			// Mask input tags by whether the other side allows propagating
+			// (doesn't fix output or same tag group), only building that
+			// condition for sides that actually carry the tag
+			SigSpec tag_sig = Const(0, GetSize(sig_y));
+			if (!tag_sig_a.is_fully_zero()) {
+				auto prop_b = autoOr(NEW_ID, inv_b ? autoNot(NEW_ID, sig_b) : sig_b, tag_group_signal(tag, sig_b));
+				tag_sig = autoAnd(NEW_ID, tag_sig_a, prop_b);
+			}
+			if (!tag_sig_b.is_fully_zero()) {
+				auto prop_a = autoOr(NEW_ID, inv_a ? autoNot(NEW_ID, sig_a) : sig_a, tag_group_signal(tag, sig_a));
+				tag_sig = autoOr(NEW_ID, tag_sig, autoAnd(NEW_ID, tag_sig_b, prop_a));
+			}
 
-			// Does this input allow propagating (doesn't fix output or same tag group)
-			sig_a = autoOr(NEW_ID, sig_a, group_sig_a);
-			sig_b = autoOr(NEW_ID, sig_b, group_sig_b);
-
-			// Mask input tags by whether the other side allows propagation
-			tag_sig_a = autoAnd(NEW_ID, tag_sig_a, sig_b);
-			tag_sig_b = autoAnd(NEW_ID, tag_sig_b, sig_a);
-
-
-			auto tag_sig = autoOr(NEW_ID, tag_sig_a, tag_sig_b);
 			emit_tag_signal(tag, sig_y, tag_sig);
 			return;
 		}
@@ -580,24 +576,24 @@ struct DftTagWorker {
 			if (cell->type == ID($mux))
 				sig_s = SigSpec(sig_s[0], GetSize(sig_y));
 
-			auto group_sig_a = tag_group_signal(tag, sig_a);
-			auto group_sig_b = tag_group_signal(tag, sig_b);
-			auto group_sig_s = tag_group_signal(tag, sig_s);
-
-			auto prop_s = autoOr(NEW_ID,
-					autoXor(NEW_ID, sig_a, sig_b),
-					autoOr(NEW_ID, group_sig_a, group_sig_b));
-
-			auto prop_a = autoOr(NEW_ID, autoNot(NEW_ID, sig_s), group_sig_s);
-			auto prop_b = autoOr(NEW_ID, sig_s, group_sig_s);
-
 			auto tag_sig_a = tag_signal(tag, sig_a);
 			auto tag_sig_b = tag_signal(tag, sig_b);
 			auto tag_sig_s = tag_signal(tag, sig_s);
 
-			tag_sig_a = autoAnd(NEW_ID, tag_sig_a, prop_a);
-			tag_sig_b = autoAnd(NEW_ID, tag_sig_b, prop_b);
-			tag_sig_s = autoAnd(NEW_ID, tag_sig_s, prop_s);
+			if (!tag_sig_s.is_fully_zero()) {
+				auto prop_s = autoOr(NEW_ID,
+						autoXor(NEW_ID, sig_a, sig_b),
+						autoOr(NEW_ID, tag_group_signal(tag, sig_a), tag_group_signal(tag, sig_b)));
+				tag_sig_s = autoAnd(NEW_ID, tag_sig_s, prop_s);
+			}
+
+			if (!tag_sig_a.is_fully_zero() || !tag_sig_b.is_fully_zero()) {
+				auto group_sig_s = tag_group_signal(tag, sig_s);
+				if (!tag_sig_a.is_fully_zero())
+					tag_sig_a = autoAnd(NEW_ID, tag_sig_a, autoOr(NEW_ID, autoNot(NEW_ID, sig_s), group_sig_s));
+				if (!tag_sig_b.is_fully_zero())
+					tag_sig_b = autoAnd(NEW_ID, tag_sig_b, autoOr(NEW_ID, sig_s, group_sig_s));
+			}
 
 			auto tag_sig = autoOr(NEW_ID, tag_sig_s,
 					autoOr(NEW_ID, tag_sig_a, tag_sig_b));
@@ -613,12 +609,17 @@ struct DftTagWorker {
 			sig_a.extend_u0(width, cell->getParam(ID::A_SIGNED).as_bool());
 			sig_b.extend_u0(width, cell->getParam(ID::B_SIGNED).as_bool());
 
-			auto group_sig_a = tag_group_signal(tag, sig_a);
-			auto group_sig_b = tag_group_signal(tag, sig_b);
-
 			auto tag_sig_a = tag_signal(tag, sig_a);
 			auto tag_sig_b = tag_signal(tag, sig_b);
 
+			if (tag_sig_a.is_fully_zero() && tag_sig_b.is_fully_zero()) {
+				emit_tag_signal(tag, sig_y, Const(0, GetSize(sig_y)));
+				return;
+			}
+
+			auto group_sig_a = tag_group_signal(tag, sig_a);
+			auto group_sig_b = tag_group_signal(tag, sig_b);
+
 			auto group_sig = autoOr(NEW_ID, group_sig_a, group_sig_b);
 			// The output can only be affected by the tagged inputs if all group-untagged bits are equal
 
@@ -645,12 +646,17 @@ struct DftTagWorker {
 			if (cell->type.in(ID($gt), ID($le)))
 				std::swap(sig_a, sig_b);
 
-			auto group_sig_a = tag_group_signal(tag, sig_a);
-			auto group_sig_b = tag_group_signal(tag, sig_b);
-
 			auto tag_sig_a = tag_signal(tag, sig_a);
 			auto tag_sig_b = tag_signal(tag, sig_b);
 
+			if (tag_sig_a.is_fully_zero() && tag_sig_b.is_fully_zero()) {
+				emit_tag_signal(tag, sig_y, Const(0, GetSize(sig_y)));
+				return;
+			}
+
+			auto group_sig_a = tag_group_signal(tag, sig_a);
+			auto group_sig_b = tag_group_signal(tag, sig_b);
+
 			auto group_sig = autoOr(NEW_ID, group_sig_a, group_sig_b);
 			// The output can only be affected by the tagged inputs if the greatest possible sig_a is
 			// greater or equal to the least possible sig_b
@@ -669,8 +675,13 @@ struct DftTagWorker {
 			auto &sig_y = cell->getPort(ID::Y);
 			auto sig_a = cell->getPort(ID::A);
 
-			auto group_sig_a = tag_group_signal(tag, sig_a);
 			auto tag_sig_a = tag_signal(tag, sig_a);
+			if (tag_sig_a.is_fully_zero()) {
+				emit_tag_signal(tag, sig_y, Const(0, GetSize(sig_y)));
+				return;
+			}
+
+			auto group_sig_a = tag_group_signal(tag, sig_a);
 
 			if (cell->type.in(ID($reduce_or), ID($reduce_bool), ID($logic_not)))
 				sig_a = autoNot(NEW_ID, sig_a);
@@ -695,11 +706,17 @@ struct DftTagWorker {
 				int width = ff.width;
 
 				auto sig_q = ff.sig_q;
-				auto sig_d = ff.sig_d;
+				auto tag_sig_d = tag_signal(tag, ff.sig_d);
+
+				// No shadow FF is needed when the tag never reaches D
+				if (tag_sig_d.is_fully_zero()) {
+					emit_tag_signal(tag, sig_q, Const(0, width));
+					return;
+				}
 
 				ff.name = NEW_ID;
 				ff.cell = nullptr;
-				ff.sig_d = tag_signal(tag, ff.sig_d);
+				ff.sig_d = tag_sig_d;
 				ff.sig_q = module->addWire(NEW_ID, width);
 				ff.is_anyinit = false;
 				ff.val_init = Const(0, width);
@@ -1002,6 +1019,7 @@ struct DftTagPass : public Pass {
 
 			log_debug("Propagate tagged signals.\n");
 			worker.propagate_tags();
+			log_debug("Found %d tagged signal bits with %d distinct tag sets.\n", GetSize(worker.tagged_signals), GetSize(worker.tag_sets));
 
 			log_debug("Emit tag signals and logic.\n");
 			worker.emit_tags();
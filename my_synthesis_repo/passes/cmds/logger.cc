@@ -102,7 +102,7 @@ struct LoggerPass : public Pass {
 				if (pattern.front() == '\"' && pattern.back() == '\"') pattern = pattern.substr(1, pattern.size() - 2);		
 				try {
 					log("Added regex '%s' for warnings to warn list.\n", pattern.c_str());
-					log_warn_regexes.push_back(YS_REGEX_COMPILE(pattern));
+					log_warn_regexes.push_back(LogRegex(pattern));
 				}
 				catch (const std::regex_error& e) {
 					log_cmd_error("Error in regex expression '%s' !\n", pattern.c_str());
@@ -114,7 +114,7 @@ struct LoggerPass : public Pass {
 				if (pattern.front() == '\"' && pattern.back() == '\"') pattern = pattern.substr(1, pattern.size() - 2);	
 				try {
 					log("Added regex '%s' for warnings to nowarn list.\n", pattern.c_str());
-					log_nowarn_regexes.push_back(YS_REGEX_COMPILE(pattern));
+					log_nowarn_regexes.push_back(LogRegex(pattern));
 				}
 				catch (const std::regex_error& e) {
 					log_cmd_error("Error in regex expression '%s' !\n", pattern.c_str());
@@ -126,7 +126,7 @@ struct LoggerPass : public Pass {
 				if (pattern.front() == '\"' && pattern.back() == '\"') pattern = pattern.substr(1, pattern.size() - 2);	
 				try {
 					log("Added regex '%s' for warnings to werror list.\n", pattern.c_str());
-					log_werror_regexes.push_back(YS_REGEX_COMPILE(pattern));
+					log_werror_regexes.push_back(LogRegex(pattern));
 				}
 				catch (const std::regex_error& e) {
 					log_cmd_error("Error in regex expression '%s' !\n", pattern.c_str());
@@ -165,11 +165,11 @@ struct LoggerPass : public Pass {
 				log("Added regex '%s' for warnings to expected %s list.\n", pattern.c_str(), type.c_str());
 				try {
 					if (type == "error")
-						log_expect_error[pattern] = LogExpectedItem(YS_REGEX_COMPILE(pattern), count);
+						log_expect_error[pattern] = LogExpectedItem(LogRegex(pattern), count);
 					else if (type == "warning")
-						log_expect_warning[pattern] = LogExpectedItem(YS_REGEX_COMPILE(pattern), count);
+						log_expect_warning[pattern] = LogExpectedItem(LogRegex(pattern), count);
 					else if (type == "log")
-						log_expect_log[pattern] = LogExpectedItem(YS_REGEX_COMPILE(pattern), count);
+						log_expect_log[pattern] = LogExpectedItem(LogRegex(pattern), count);
 					else log_abort();
 				}
 				catch (const std::regex_error& e) {
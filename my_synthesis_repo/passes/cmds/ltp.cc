@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
 #include "kernel/sigtools.h"
+#include "kernel/utils.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -30,14 +31,12 @@ struct LtpWorker
 	RTLIL::Module *module;
 	SigMap sigmap;
 
-	dict<SigBit, tuple<int, SigBit, Cell*>> bits;
-	dict<SigBit, dict<SigBit, Cell*>> bit2bits;
+	// nodes of the bit graph, edges are labeled with the cell they pass through
+	idict<SigBit> bits;
+	std::vector<std::pair<int, int>> edges;
+	std::vector<Cell*> edge_cells;
 	dict<SigBit, tuple<SigBit, Cell*>> bit2ff;
 
-	int maxlvl;
-	SigBit maxbit;
-	pool<SigBit> busy;
-
 	LtpWorker(RTLIL::Module *module, bool noff) : design(module->design), module(module), sigmap(module)
 	{
 		CellTypes ff_celltypes;
@@ -49,7 +48,7 @@ struct LtpWorker
 
 		for (auto wire : module->selected_wires())
 			for (auto bit : sigmap(wire))
-				bits[bit] = tuple<int, SigBit, Cell*>(-1, State::Sx, nullptr);
+				bits(bit);
 
 		for (auto cell : module->selected_cells())
 		{
@@ -73,67 +72,63 @@ struct LtpWorker
 			}
 
 			for (auto s : src_bits)
-				for (auto d : dst_bits)
-					bit2bits[s][d] = cell;
+				for (auto d : dst_bits) {
+					if (!bits.count(s) || !bits.count(d))
+						continue;
+					edges.emplace_back(bits.at(s), bits.at(d));
+					edge_cells.push_back(cell);
+				}
 		}
-
-		maxlvl = -1;
-		maxbit = State::Sx;
 	}
 
-	void runner(SigBit bit, int level, SigBit from, Cell *via)
+	void run()
 	{
-		auto &bitinfo = bits.at(bit);
-
-		if (get<0>(bitinfo) >= level)
-			return;
-
-		if (busy.count(bit) > 0) {
-			log_warning("Detected loop at %s in %s\n", log_signal(bit), log_id(module));
-			return;
+		CsrGraph graph(GetSize(bits), edges);
+
+		std::vector<std::vector<int>> sccs;
+		find_sccs(graph, sccs, /*include_trivial=*/true);
+		for (auto &scc : sccs) {
+			int node = *std::min_element(scc.begin(), scc.end());
+			bool self_loop = std::find(graph.targets.begin() + graph.first[node], graph.targets.begin() + graph.first[node + 1], node) !=
+					graph.targets.begin() + graph.first[node + 1];
+			if (GetSize(scc) > 1 || self_loop)
+				log_warning("Detected loop at %s in %s\n", log_signal(bits[node]), log_id(module));
 		}
 
-		busy.insert(bit);
-		get<0>(bitinfo) = level;
-		get<1>(bitinfo) = from;
-		get<2>(bitinfo) = via;
+		std::vector<int> order, length, pred;
+		topological_order(graph, order);
+		longest_paths(graph, order, length, &pred);
 
-		if (level > maxlvl) {
-			maxlvl = level;
-			maxbit = bit;
-		}
+		int maxlvl = -1, maxnode = -1;
+		for (int node : order)
+			if (length[node] > maxlvl)
+				maxlvl = length[node], maxnode = node;
 
-		if (bit2bits.count(bit)) {
-			for (auto &it : bit2bits.at(bit))
-				runner(it.first, level+1, bit, it.second);
-		}
+		log("\n");
+		log("Longest topological path in %s (length=%d):\n", log_id(module), maxlvl);
 
-		busy.erase(bit);
-	}
+		if (maxnode < 0)
+			return;
 
-	void printpath(SigBit bit)
-	{
-		auto &bitinfo = bits.at(bit);
-		if (get<2>(bitinfo)) {
-			printpath(get<1>(bitinfo));
-			log("%5d: %s (via %s)\n", get<0>(bitinfo), log_signal(bit), log_id(get<2>(bitinfo)));
-		} else {
-			log("%5d: %s\n", get<0>(bitinfo), log_signal(bit));
+		std::vector<int> path;
+		for (int node = maxnode; node >= 0; node = pred[node])
+			path.push_back(node);
+		std::reverse(path.begin(), path.end());
+
+		dict<std::pair<int, int>, Cell*> path_cells;
+		for (int i = 1; i < GetSize(path); i++)
+			path_cells[std::make_pair(path[i-1], path[i])] = nullptr;
+		for (int i = 0; i < GetSize(edges); i++) {
+			auto it = path_cells.find(edges[i]);
+			if (it != path_cells.end() && it->second == nullptr)
+				it->second = edge_cells[i];
 		}
-	}
-
-	void run()
-	{
-		for (auto &it : bits)
-			if (get<0>(it.second) < 0)
-				runner(it.first, 0, State::Sx, nullptr);
-
-		log("\n");
-		log("Longest topological path in %s (length=%d):\n", log_id(module), maxlvl);
 
-		if (maxlvl >= 0)
-			printpath(maxbit);
+		log("%5d: %s\n", 0, log_signal(bits[path[0]]));
+		for (int i = 1; i < GetSize(path); i++)
+			log("%5d: %s (via %s)\n", i, log_signal(bits[path[i]]), log_id(path_cells.at(std::make_pair(path[i-1], path[i]))));
 
+		SigBit maxbit = bits[maxnode];
 		if (bit2ff.count(maxbit))
 			log("%5s: %s (via %s)\n", "ff", log_signal(get<0>(bit2ff.at(maxbit))), log_id(get<1>(bit2ff.at(maxbit))));
 	}
@@ -19,8 +19,8 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
-#undef LOG_MATRICES
 #undef PYPLOT_EDGES
 
 USING_YOSYS_NAMESPACE
@@ -203,6 +203,39 @@ struct QwpWorker
 		}
 	}
 
+	// AA in compressed sparse row form, without the diagonal
+	struct SparseMatrix
+	{
+		int N;
+		vector<double> diag;
+		vector<int> row_start, cols;
+		vector<double> vals;
+
+		// y := M * x, split into row ranges on multiple threads for big systems
+		void multiply(const vector<double> &x, vector<double> &y) const
+		{
+			auto rows = [&](int begin, int end) {
+				for (int i = begin; i < end; i++) {
+					double sum = diag[i] * x[i];
+					for (int k = row_start[i]; k < row_start[i+1]; k++)
+						sum += vals[k] * x[cols[k]];
+					y[i] = sum;
+				}
+			};
+
+			const int chunk_size = 16384;
+			if (yosys_parallel_jobs <= 1 || N < 4 * chunk_size) {
+				rows(0, N);
+				return;
+			}
+
+			int chunks = (N + chunk_size - 1) / chunk_size;
+			parallel_for(chunks, [&](int c) {
+				rows(c * chunk_size, std::min(N, (c+1) * chunk_size));
+			});
+		}
+	};
+
 	void solve(bool alt_mode = false)
 	{
 		// A := constraint_matrix
@@ -211,14 +244,17 @@ struct QwpWorker
 		// AA = A' * A
 		// Ay = A' * y
 		//
-		// M := [AA Ay]
+		// AA is the weighted graph laplacian plus a positive diagonal, so it
+		// is sparse and symmetric positive definite.
 
 		if (config.verbose)
 			log("> System size: %d^2\n", GetSize(nodes));
 
-		// Row major order
-		int N = GetSize(nodes), N1 = N+1;
-		vector<double> M(N * N1);
+		int N = GetSize(nodes);
+		SparseMatrix M;
+		M.N = N;
+		M.diag.assign(N, 0.0);
+		vector<double> rhs_vec(N, 0.0);
 
 		if (config.verbose)
 			log("> Edge constraints: %d\n", GetSize(edges));
@@ -227,17 +263,34 @@ struct QwpWorker
 		//   A[i,:] := [ 0 0 .... 0 weight 0 ... 0 -weight 0 ... 0 0], y[i] := 0
 		//
 		// i.e. nonzero columns in A[i,:] at the two node indices.
+		M.row_start.assign(N+1, 0);
+		vector<pair<pair<int, int>, double>> weighted_edges;
+		weighted_edges.reserve(GetSize(edges));
 		for (auto &edge : edges)
 		{
 			int idx1 = edge.first.first;
 			int idx2 = edge.first.second;
 			double weight = edge.second * (1.0 + xorshift32() * 1e-3);
 
-			M[idx1 + idx1*N1] += weight * weight;
-			M[idx2 + idx2*N1] += weight * weight;
+			M.diag[idx1] += weight * weight;
+			M.diag[idx2] += weight * weight;
 
-			M[idx1 + idx2*N1] += -weight * weight;
-			M[idx2 + idx1*N1] += -weight * weight;
+			weighted_edges.push_back(make_pair(edge.first, -weight * weight));
+			M.row_start[idx1+1]++;
+			M.row_start[idx2+1]++;
+		}
+
+		for (int i = 0; i < N; i++)
+			M.row_start[i+1] += M.row_start[i];
+		M.cols.resize(M.row_start[N]);
+		M.vals.resize(M.row_start[N]);
+		{
+			vector<int> fill(M.row_start.begin(), M.row_start.end() - 1);
+			for (auto &it : weighted_edges) {
+				int idx1 = it.first.first, idx2 = it.first.second;
+				M.cols[fill[idx1]] = idx2, M.vals[fill[idx1]++] = it.second;
+				M.cols[fill[idx2]] = idx1, M.vals[fill[idx2]++] = it.second;
+			}
 		}
 
 		if (config.verbose)
@@ -251,6 +304,7 @@ struct QwpWorker
 		// "tied" nodes have a large weight, pinning them in position. Untied
 		// nodes have a small weight, giving then a tiny preference to stay at
 		// the current position, making sure that AA never is singular.
+		vector<double> x(N);
 		for (int idx = 0; idx < GetSize(nodes); idx++)
 		{
 			auto &node = nodes[idx];
@@ -261,98 +315,71 @@ struct QwpWorker
 				weight = 1e3;
 			weight *= (1.0 + xorshift32() * 1e-3);
 
-			M[idx + idx*N1] += weight * weight;
-			M[N + idx*N1] += rhs * weight * weight;
-		}
+			M.diag[idx] += weight * weight;
+			rhs_vec[idx] += rhs * weight * weight;
 
-#ifdef LOG_MATRICES
-		log("\n");
-		for (int i = 0; i < N; i++) {
-			for (int j = 0; j < N+1; j++)
-				log(" %10.2e", M[(N+1)*i + j]);
-			log("\n");
+			// the positions handed down from the parent partition are a good
+			// starting point for the iteration
+			x[idx] = rhs;
 		}
-#endif
 
 		if (config.verbose)
 			log("> Solving\n");
 
-		// Solve "AA*x = Ay"
-		// (least squares fit for "A*x = y")
-		//
-		// Using gaussian elimination to get M := [Id x]
+		// Solve "AA*x = Ay" (least squares fit for "A*x = y") with the
+		// conjugate gradient method, preconditioned with the diagonal of AA
+		// (the tied nodes make the diagonal span many orders of magnitude)
 
-		vector<int> pivot_cache;
-		vector<int> queue;
+		vector<double> r(N), z(N), p(N), q(N);
+		M.multiply(x, q);
 
-		for (int i = 0; i < N; i++)
-			queue.push_back(i);
+		double rhs_norm = 0, rz = 0;
+		for (int i = 0; i < N; i++) {
+			r[i] = rhs_vec[i] - q[i];
+			z[i] = r[i] / M.diag[i];
+			p[i] = z[i];
+			rz += r[i] * z[i];
+			rhs_norm += rhs_vec[i] * rhs_vec[i];
+		}
+
+		double tolerance = 1e-20 * std::max(rhs_norm, 1e-300);
+		int max_iter = std::min(N, 10000) + 100;
+		int iter = 0;
+		double r_norm = 0;
 
-		// gaussian elimination
 		for (int i = 0; i < N; i++)
+			r_norm += r[i] * r[i];
+
+		while (iter < max_iter && r_norm > tolerance)
 		{
-			if (config.verbose && N > 15 && ((i+1) % (N/15)) == 0)
-				log("> Solved %d%%: %d/%d\n", (100*(i+1))/N, i+1, N);
-
-			// find best row
-			int best_row = queue.front();
-			int best_row_queue_idx = 0;
-			double best_row_absval = 0;
-
-			for (int k = 0; k < GetSize(queue); k++) {
-				int row = queue[k];
-				double absval = fabs(M[i + row*N1]);
-				if (absval > best_row_absval) {
-					best_row = row;
-					best_row_queue_idx = k;
-					best_row_absval = absval;
-				}
+			M.multiply(p, q);
+
+			double pq = 0;
+			for (int i = 0; i < N; i++)
+				pq += p[i] * q[i];
+			if (pq <= 0 || !std::isfinite(pq))
+				break;
+
+			double alpha = rz / pq;
+			double rz_new = 0;
+			r_norm = 0;
+			for (int i = 0; i < N; i++) {
+				x[i] += alpha * p[i];
+				r[i] -= alpha * q[i];
+				z[i] = r[i] / M.diag[i];
+				rz_new += r[i] * z[i];
+				r_norm += r[i] * r[i];
 			}
 
-			int row = best_row;
-			pivot_cache.push_back(row);
-
-			queue[best_row_queue_idx] = queue.back();
-			queue.pop_back();
-
-			// normalize row
-			for (int k = i+1; k < N1; k++)
-				M[k + row*N1] /= M[i + row*N1];
-			M[i + row*N1] = 1.0;
-
-			// elimination
-			for (int other_row : queue) {
-				double d = M[i + other_row*N1];
-				for (int k = i+1; k < N1; k++)
-					M[k + other_row*N1] -= d*M[k + row*N1];
-				M[i + other_row*N1] = 0.0;
-			}
+			double beta = rz_new / rz;
+			rz = rz_new;
+			for (int i = 0; i < N; i++)
+				p[i] = z[i] + beta * p[i];
+			iter++;
 		}
 
 		if (config.verbose)
-			log("> Solved\n");
-
-		log_assert(queue.empty());
-		log_assert(GetSize(pivot_cache) == N);
-
-		// back substitution
-		for (int i = N-1; i >= 0; i--)
-		for (int j = i+1; j < N; j++)
-		{
-			int row = pivot_cache[i];
-			int other_row = pivot_cache[j];
-			M[N + row*N1] -= M[j + row*N1] * M[N + other_row*N1];
-			M[j + row*N1] = 0.0;
-		}
-
-#ifdef LOG_MATRICES
-		log("\n");
-		for (int i = 0; i < N; i++) {
-			for (int j = 0; j < N+1; j++)
-				log(" %10.2e", M[(N+1)*i + j]);
-			log("\n");
-		}
-#endif
+			log("> Solved after %d CG iterations (residual %.2e)\n", iter, sqrt(r_norm));
 
 		if (config.verbose)
 			log("> Update nodes\n");
@@ -360,7 +387,7 @@ struct QwpWorker
 		// update node positions
 		for (int i = 0; i < N; i++)
 		{
-			double v = M[(N+1)*i + N];
+			double v = x[i];
 			double c = alt_mode ? alt_midpos : midpos;
 			double r = alt_mode ? alt_radius : radius;
 
@@ -804,8 +831,11 @@ struct QwpPass : public Pass {
 		log("    -v\n");
 		log("        Verbose solver output for profiling or debugging\n");
 		log("\n");
-		log("Note: This implementation of a quadratic wirelength placer uses exact\n");
-		log("dense matrix operations. It is only a toy-placer for small circuits.\n");
+		log("Note: This quadratic wirelength placer solves the sparse least squares\n");
+		log("systems with a preconditioned conjugate gradient method, starting from the\n");
+		log("positions of the enclosing partition. With -j <jobs> the matrix products of\n");
+		log("large systems run in parallel. It is still a toy-placer without any notion\n");
+		log("of cell sizes or legalization.\n");
 		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
@@ -21,6 +21,7 @@
 #include "kernel/rtlil.h"
 #include "kernel/log.h"
 #include "kernel/hashlib.h"
+#include "kernel/scopeinfo.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -242,6 +243,13 @@ struct RenamePass : public Pass {
 		log("with public names. This ignores all selected ports.\n");
 		log("\n");
 		log("\n");
+		log("    rename -hiernames [selection]\n");
+		log("\n");
+		log("Replace the compact names created by 'flatten -scopeids' on all selected wires\n");
+		log("and cells with the full hierarchical names that 'flatten' creates by default,\n");
+		log("and add the corresponding 'hdlname' attributes.\n");
+		log("\n");
+		log("\n");
 		log("    rename -top new_name\n");
 		log("\n");
 		log("Rename top module.\n");
@@ -263,6 +271,7 @@ struct RenamePass : public Pass {
 		bool flag_enumerate = false;
 		bool flag_witness = false;
 		bool flag_hide = false;
+		bool flag_hiernames = false;
 		bool flag_top = false;
 		bool flag_output = false;
 		bool flag_scramble_name = false;
@@ -303,6 +312,11 @@ struct RenamePass : public Pass {
 				got_mode = true;
 				continue;
 			}
+			if (arg == "-hiernames" && !got_mode) {
+				flag_hiernames = true;
+				got_mode = true;
+				continue;
+			}
 			if (arg == "-top" && !got_mode) {
 				flag_top = true;
 				got_mode = true;
@@ -442,6 +456,50 @@ struct RenamePass : public Pass {
 			}
 		}
 		else
+		if (flag_hiernames)
+		{
+			extra_args(args, argidx, design);
+
+			for (auto module : design->selected_modules())
+			{
+				// All paths are resolved before renaming, as the scopes are found by name
+				ModuleScopeIndex scopes(module);
+				dict<RTLIL::Wire *, std::vector<IdString>> new_wire_paths;
+				dict<RTLIL::Cell *, std::vector<IdString>> new_cell_paths;
+
+				for (auto wire : module->selected_wires())
+					if (wire->name.begins_with("\\@")) {
+						std::vector<IdString> path = scopes.path(wire->name);
+						if (!path.empty())
+							new_wire_paths[wire] = path;
+					}
+
+				for (auto cell : module->selected_cells())
+					if (cell->name.begins_with("\\@")) {
+						std::vector<IdString> path = scopes.path(cell->name);
+						if (!path.empty())
+							new_cell_paths[cell] = path;
+					}
+
+				auto hdlname = [](const std::vector<IdString> &path) {
+					std::vector<std::string> result;
+					for (auto &item : path)
+						result.push_back(RTLIL::unescape_id(item));
+					return result;
+				};
+
+				for (auto &it : new_wire_paths) {
+					module->rename(it.first, module->uniquify(ModuleScopeIndex::join_path(it.second)));
+					it.first->set_hdlname_attribute(hdlname(it.second));
+				}
+
+				for (auto &it : new_cell_paths) {
+					module->rename(it.first, module->uniquify(ModuleScopeIndex::join_path(it.second)));
+					it.first->set_hdlname_attribute(hdlname(it.second));
+				}
+			}
+		}
+		else
 		if (flag_top)
 		{
 			if (argidx+1 != args.size())
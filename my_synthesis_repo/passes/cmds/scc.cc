@@ -25,6 +25,7 @@
 #include "kernel/celltypes.h"
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
+#include "kernel/utils.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -38,67 +39,12 @@ struct SccWorker
 	SigMap sigmap;
 	CellTypes ct, specifyCells;
 
-	pool<RTLIL::Cell*> workQueue;
-	dict<RTLIL::Cell*, pool<RTLIL::Cell*>> cellToNextCell;
+	std::vector<RTLIL::Cell*> cells;
 	dict<RTLIL::Cell*, RTLIL::SigSpec> cellToPrevSig, cellToNextSig;
 
-	dict<RTLIL::Cell*, std::pair<int, int>> cellLabels;
-	dict<RTLIL::Cell*, int> cellDepth;
-	pool<RTLIL::Cell*> cellsOnStack;
-	std::vector<RTLIL::Cell*> cellStack;
-	int labelCounter;
-
 	dict<RTLIL::Cell*, int> cell2scc;
 	std::vector<pool<RTLIL::Cell*>> sccList;
 
-	void run(RTLIL::Cell *cell, int depth, int maxDepth)
-	{
-		log_assert(workQueue.count(cell) > 0);
-
-		workQueue.erase(cell);
-		cellLabels[cell] = std::pair<int, int>(labelCounter, labelCounter);
-		labelCounter++;
-
-		cellsOnStack.insert(cell);
-		cellStack.push_back(cell);
-
-		if (maxDepth >= 0)
-			cellDepth[cell] = depth;
-
-		for (auto nextCell : cellToNextCell[cell])
-			if (cellLabels.count(nextCell) == 0) {
-				run(nextCell, depth+1, maxDepth);
-				cellLabels[cell].second = min(cellLabels[cell].second, cellLabels[nextCell].second);
-			} else
-			if (cellsOnStack.count(nextCell) > 0 && (maxDepth < 0 || cellDepth[nextCell] + maxDepth > depth)) {
-					cellLabels[cell].second = min(cellLabels[cell].second, cellLabels[nextCell].second);
-			}
-
-		if (cellLabels[cell].first == cellLabels[cell].second)
-		{
-			if (cellStack.back() == cell)
-			{
-				cellStack.pop_back();
-				cellsOnStack.erase(cell);
-			}
-			else
-			{
-				log("Found an SCC:");
-				pool<RTLIL::Cell*> scc;
-				while (cellsOnStack.count(cell) > 0) {
-					RTLIL::Cell *c = cellStack.back();
-					cellStack.pop_back();
-					cellsOnStack.erase(c);
-					log(" %s", RTLIL::id2cstr(c->name));
-					cell2scc[c] = sccList.size();
-					scc.insert(c);
-				}
-				sccList.push_back(scc);
-				log("\n");
-			}
-		}
-	}
-
 	SccWorker(RTLIL::Design *design, RTLIL::Module *module, bool nofeedbackMode, bool allCellTypes, bool specifyMode, int maxDepth) :
 			design(design), module(module), sigmap(module)
 	{
@@ -143,7 +89,7 @@ struct SccWorker
 			if (!allCellTypes && !ct.cell_known(cell->type) && !specifyCells.cell_known(cell->type))
 				continue;
 
-			workQueue.insert(cell);
+			cells.push_back(cell);
 
 			RTLIL::SigSpec inputSignals, outputSignals;
 
@@ -196,11 +142,23 @@ struct SccWorker
 			sigToNextCells.insert(inputSignals, cell);
 		}
 
-		for (auto cell : workQueue)
+		// the cell graph in compact form, searched with find_sccs() from
+		// kernel/utils.h, which does not recurse
+		dict<RTLIL::Cell*, int> cellIndex;
+		for (int i = 0; i < GetSize(cells); i++)
+			cellIndex[cells[i]] = i;
+
+		std::vector<std::pair<int, int>> edges;
+		for (int i = 0; i < GetSize(cells); i++)
 		{
-			sigToNextCells.find(cellToNextSig[cell], cellToNextCell[cell]);
+			RTLIL::Cell *cell = cells[i];
+			pool<RTLIL::Cell*> nextCells;
+			sigToNextCells.find(cellToNextSig[cell], nextCells);
 
-			if (!nofeedbackMode && cellToNextCell[cell].count(cell)) {
+			for (auto nextCell : nextCells)
+				edges.emplace_back(i, cellIndex.at(nextCell));
+
+			if (!nofeedbackMode && nextCells.count(cell)) {
 				log("Found an SCC:");
 				pool<RTLIL::Cell*> scc;
 				log(" %s", RTLIL::id2cstr(cell->name));
@@ -211,16 +169,22 @@ struct SccWorker
 			}
 		}
 
-		labelCounter = 0;
-		cellLabels.clear();
+		CsrGraph graph(GetSize(cells), edges);
+		std::vector<std::vector<int>> components;
+		find_sccs(graph, components, false, maxDepth);
 
-		while (!workQueue.empty())
+		for (auto &component : components)
 		{
-			RTLIL::Cell *cell = *workQueue.begin();
-			log_assert(cellStack.size() == 0);
-			cellDepth.clear();
-
-			run(cell, 0, maxDepth);
+			log("Found an SCC:");
+			pool<RTLIL::Cell*> scc;
+			for (int i : component) {
+				RTLIL::Cell *c = cells[i];
+				log(" %s", RTLIL::id2cstr(c->name));
+				cell2scc[c] = sccList.size();
+				scc.insert(c);
+			}
+			sccList.push_back(scc);
+			log("\n");
 		}
 
 		log("Found %d SCCs in module %s.\n", int(sccList.size()), RTLIL::id2cstr(module->name));
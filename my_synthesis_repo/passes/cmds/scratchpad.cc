@@ -66,6 +66,9 @@ struct ScratchpadPass : public Pass {
 
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
+		// constpad entries are set up when their pass is first used
+		Pass::ensure_all_registered();
+
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
 		{
@@ -54,92 +54,145 @@ static bool match_ids(RTLIL::IdString id, const std::string &pattern)
 	return false;
 }
 
-static bool match_attr_val(const RTLIL::Const &value, const std::string &pattern, char match_op)
+// A name pattern, compiled once per selection argument. Patterns without any
+// wildcard or escape characters can only match the escaped name, so they are
+// answered with a single lookup instead of a scan over all objects.
+struct id_pattern_t
 {
-	if (match_op == 0)
-		return true;
+	std::string pattern;
+	RTLIL::IdString literal_id;
 
-	if ((value.flags & RTLIL::CONST_FLAG_STRING) == 0)
+	id_pattern_t(const std::string &pattern) : pattern(pattern)
 	{
-		RTLIL::SigSpec sig_value;
+		if (!pattern.empty() && pattern[0] != '$' && pattern.find_first_of("*?[\\") == std::string::npos)
+			literal_id = "\\" + pattern;
+	}
 
-		if (!RTLIL::SigSpec::parse(sig_value, nullptr, pattern))
-			return false;
+	bool literal() const
+	{
+		return !literal_id.empty();
+	}
 
-		RTLIL::Const pattern_value = sig_value.as_const();
-
-		if (match_op == '=')
-			return value == pattern_value;
-		if (match_op == '!')
-			return value != pattern_value;
-		if (match_op == '<')
-			return value.as_int() < pattern_value.as_int();
-		if (match_op == '>')
-			return value.as_int() > pattern_value.as_int();
-		if (match_op == '[')
-			return value.as_int() <= pattern_value.as_int();
-		if (match_op == ']')
-			return value.as_int() >= pattern_value.as_int();
+	bool match(RTLIL::IdString id) const
+	{
+		if (literal())
+			return id == literal_id;
+		return match_ids(id, pattern);
 	}
-	else
+};
+
+// An attribute or parameter match expression (name, name=value, name<value,
+// ...), compiled once. Constant values are parsed up front instead of once
+// per compared object.
+struct attr_pattern_t
+{
+	std::string name_pat, value_pat;
+	char match_op = 0;
+	bool name_wildcard = false;
+	RTLIL::IdString name_id, escaped_name_id;
+	bool value_valid = false;
+	RTLIL::Const value_const;
+
+	attr_pattern_t(const std::string &match_expr)
 	{
-		std::string value_str = value.decode_string();
+		size_t pos = match_expr.find_first_of("<!=>");
 
-		if (match_op == '=')
-			if (patmatch(pattern.c_str(), value.decode_string().c_str()))
-				return true;
+		if (pos == std::string::npos) {
+			name_pat = match_expr;
+		} else if (match_expr.compare(pos, 2, "!=") == 0) {
+			name_pat = match_expr.substr(0, pos), value_pat = match_expr.substr(pos+2), match_op = '!';
+		} else if (match_expr.compare(pos, 2, "<=") == 0) {
+			name_pat = match_expr.substr(0, pos), value_pat = match_expr.substr(pos+2), match_op = '[';
+		} else if (match_expr.compare(pos, 2, ">=") == 0) {
+			name_pat = match_expr.substr(0, pos), value_pat = match_expr.substr(pos+2), match_op = ']';
+		} else {
+			name_pat = match_expr.substr(0, pos), value_pat = match_expr.substr(pos+1), match_op = match_expr[pos];
+		}
+
+		name_wildcard = name_pat.find_first_of("*?[") != std::string::npos;
+		if (!name_wildcard) {
+			if (name_pat.size() > 0 && (name_pat[0] == '\\' || name_pat[0] == '$'))
+				name_id = name_pat;
+			escaped_name_id = "\\" + name_pat;
+		}
 
-		if (match_op == '=')
-			return value_str == pattern;
-		if (match_op == '!')
-			return value_str != pattern;
-		if (match_op == '<')
-			return value_str < pattern;
-		if (match_op == '>')
-			return value_str > pattern;
-		if (match_op == '[')
-			return value_str <= pattern;
-		if (match_op == ']')
-			return value_str >= pattern;
+		if (match_op != 0) {
+			RTLIL::SigSpec sig_value;
+			if (RTLIL::SigSpec::parse(sig_value, nullptr, value_pat)) {
+				value_valid = true;
+				value_const = sig_value.as_const();
+			}
+		}
 	}
 
-	log_abort();
-}
+	bool match_value(const RTLIL::Const &value) const
+	{
+		if (match_op == 0)
+			return true;
 
-static bool match_attr(const dict<RTLIL::IdString, RTLIL::Const> &attributes, const std::string &name_pat, const std::string &value_pat, char match_op)
-{
-	if (name_pat.find('*') != std::string::npos || name_pat.find('?') != std::string::npos || name_pat.find('[') != std::string::npos) {
-		for (auto &it : attributes) {
-			if (patmatch(name_pat.c_str(), it.first.c_str()) && match_attr_val(it.second, value_pat, match_op))
-				return true;
-			if (it.first.size() > 0 && it.first[0] == '\\' && patmatch(name_pat.c_str(), it.first.substr(1).c_str()) && match_attr_val(it.second, value_pat, match_op))
-				return true;
+		if ((value.flags & RTLIL::CONST_FLAG_STRING) == 0)
+		{
+			if (!value_valid)
+				return false;
+
+			if (match_op == '=')
+				return value == value_const;
+			if (match_op == '!')
+				return value != value_const;
+			if (match_op == '<')
+				return value.as_int() < value_const.as_int();
+			if (match_op == '>')
+				return value.as_int() > value_const.as_int();
+			if (match_op == '[')
+				return value.as_int() <= value_const.as_int();
+			if (match_op == ']')
+				return value.as_int() >= value_const.as_int();
+		}
+		else
+		{
+			std::string value_str = value.decode_string();
+
+			if (match_op == '=')
+				return patmatch(value_pat.c_str(), value_str.c_str()) || value_str == value_pat;
+			if (match_op == '!')
+				return value_str != value_pat;
+			if (match_op == '<')
+				return value_str < value_pat;
+			if (match_op == '>')
+				return value_str > value_pat;
+			if (match_op == '[')
+				return value_str <= value_pat;
+			if (match_op == ']')
+				return value_str >= value_pat;
 		}
-	} else {
-		if (name_pat.size() > 0 && (name_pat[0] == '\\' || name_pat[0] == '$') && attributes.count(name_pat) && match_attr_val(attributes.at(name_pat), value_pat, match_op))
-			return true;
-		if (attributes.count("\\" + name_pat) && match_attr_val(attributes.at("\\" + name_pat), value_pat, match_op))
-			return true;
-	}
-	return false;
-}
 
-static bool match_attr(const dict<RTLIL::IdString, RTLIL::Const> &attributes, const std::string &match_expr)
-{
-	size_t pos = match_expr.find_first_of("<!=>");
-
-	if (pos != std::string::npos) {
-		if (match_expr.compare(pos, 2, "!=") == 0)
-			return match_attr(attributes, match_expr.substr(0, pos), match_expr.substr(pos+2), '!');
-		if (match_expr.compare(pos, 2, "<=") == 0)
-			return match_attr(attributes, match_expr.substr(0, pos), match_expr.substr(pos+2), '[');
-		if (match_expr.compare(pos, 2, ">=") == 0)
-			return match_attr(attributes, match_expr.substr(0, pos), match_expr.substr(pos+2), ']');
-		return match_attr(attributes, match_expr.substr(0, pos), match_expr.substr(pos+1), match_expr[pos]);
+		log_abort();
 	}
 
-	return match_attr(attributes, match_expr, std::string(), 0);
-}
+	bool match(const dict<RTLIL::IdString, RTLIL::Const> &attributes) const
+	{
+		if (attributes.empty())
+			return false;
+
+		if (name_wildcard) {
+			for (auto &it : attributes) {
+				if (patmatch(name_pat.c_str(), it.first.c_str()) && match_value(it.second))
+					return true;
+				if (it.first.size() > 0 && it.first[0] == '\\' && patmatch(name_pat.c_str(), it.first.c_str() + 1) && match_value(it.second))
+					return true;
+			}
+			return false;
+		}
+
+		if (!name_id.empty()) {
+			auto it = attributes.find(name_id);
+			if (it != attributes.end() && match_value(it->second))
+				return true;
+		}
+		auto it = attributes.find(escaped_name_id);
+		return it != attributes.end() && match_value(it->second);
+	}
+};
 
 static void select_op_neg(RTLIL::Design *design, RTLIL::Selection &lhs)
 {
@@ -431,22 +484,33 @@ static int parse_comma_list(std::set<RTLIL::IdString> &tokens, const std::string
 	}
 }
 
-static int select_op_expand(RTLIL::Design *design, RTLIL::Selection &lhs, std::vector<expand_rule_t> &rules, std::set<RTLIL::IdString> &limits, int max_objects, char mode, CellTypes &ct, bool eval_only)
+// Connectivity of one module as seen by a single expand operator: which wires
+// are joined by connections and which cell ports (after applying the rules)
+// each wire reaches. It is built once and reused for every expansion level,
+// and each level only walks the objects that were added by the previous one.
+struct expand_graph_t
 {
-	int sel_objects = 0;
-	bool is_input, is_output;
-	for (auto mod : design->modules())
-	{
-		if (lhs.selected_whole_module(mod->name) || !lhs.selected_module(mod->name))
-			continue;
+	struct port_t {
+		RTLIL::Cell *cell;
+		bool is_input, is_output;
+		std::vector<RTLIL::Wire*> wires;
+	};
 
-		std::set<RTLIL::Wire*> selected_wires;
-		auto selected_members = lhs.selected_members[mod->name];
+	std::vector<port_t> ports;
+	dict<RTLIL::Wire*, std::vector<RTLIL::Wire*>> wire_wires;
+	dict<RTLIL::Wire*, std::vector<int>> wire_ports;
+	dict<RTLIL::IdString, std::vector<int>> cell_ports;
+	pool<RTLIL::IdString> frontier;
 
-		for (auto wire : mod->wires())
-			if (lhs.selected_member(mod->name, wire->name) && limits.count(wire->name) == 0)
-				selected_wires.insert(wire);
+	void add_edge(RTLIL::Wire *from, RTLIL::Wire *to)
+	{
+		auto &edges = wire_wires[from];
+		if (edges.empty() || edges.back() != to)
+			edges.push_back(to);
+	}
 
+	expand_graph_t(RTLIL::Module *mod, std::vector<expand_rule_t> &rules, char mode, CellTypes &ct, bool eval_only)
+	{
 		for (auto &conn : mod->connections())
 		{
 			std::vector<RTLIL::SigBit> conn_lhs = conn.first.to_sigbit_vector();
@@ -455,10 +519,10 @@ static int select_op_expand(RTLIL::Design *design, RTLIL::Selection &lhs, std::v
 			for (size_t i = 0; i < conn_lhs.size(); i++) {
 				if (conn_lhs[i].wire == nullptr || conn_rhs[i].wire == nullptr)
 					continue;
-				if (mode != 'i' && selected_wires.count(conn_rhs[i].wire) && selected_members.count(conn_lhs[i].wire->name) == 0)
-					lhs.selected_members[mod->name].insert(conn_lhs[i].wire->name), sel_objects++, max_objects--;
-				if (mode != 'o' && selected_wires.count(conn_lhs[i].wire) && selected_members.count(conn_rhs[i].wire->name) == 0)
-					lhs.selected_members[mod->name].insert(conn_rhs[i].wire->name), sel_objects++, max_objects--;
+				if (mode != 'i')
+					add_edge(conn_rhs[i].wire, conn_lhs[i].wire);
+				if (mode != 'o')
+					add_edge(conn_lhs[i].wire, conn_rhs[i].wire);
 			}
 		}
 
@@ -482,20 +546,71 @@ static int select_op_expand(RTLIL::Design *design, RTLIL::Selection &lhs, std::v
 			if (last_mode == '+')
 				goto exclude_match;
 		include_match:
-			is_input = mode == 'x' || ct.cell_input(cell->type, conn.first);
-			is_output = mode == 'x' || ct.cell_output(cell->type, conn.first);
-			for (auto &chunk : conn.second.chunks())
-				if (chunk.wire != nullptr) {
-					if (max_objects != 0 && selected_wires.count(chunk.wire) > 0 && selected_members.count(cell->name) == 0)
-						if (mode == 'x' || (mode == 'i' && is_output) || (mode == 'o' && is_input))
-							lhs.selected_members[mod->name].insert(cell->name), sel_objects++, max_objects--;
-					if (max_objects != 0 && selected_members.count(cell->name) > 0 && limits.count(cell->name) == 0 && selected_members.count(chunk.wire->name) == 0)
-						if (mode == 'x' || (mode == 'i' && is_input) || (mode == 'o' && is_output))
-							lhs.selected_members[mod->name].insert(chunk.wire->name), sel_objects++, max_objects--;
-				}
+			{
+				port_t port;
+				port.cell = cell;
+				port.is_input = mode == 'x' || ct.cell_input(cell->type, conn.first);
+				port.is_output = mode == 'x' || ct.cell_output(cell->type, conn.first);
+				for (auto &chunk : conn.second.chunks())
+					if (chunk.wire != nullptr && (port.wires.empty() || port.wires.back() != chunk.wire))
+						port.wires.push_back(chunk.wire);
+				if (port.wires.empty())
+					goto exclude_match;
+				int idx = GetSize(ports);
+				for (auto wire : port.wires)
+					wire_ports[wire].push_back(idx);
+				cell_ports[cell->name].push_back(idx);
+				ports.push_back(std::move(port));
+			}
 		exclude_match:;
 		}
 	}
+};
+
+static int select_op_expand(RTLIL::Module *mod, expand_graph_t &graph, RTLIL::Selection &lhs, std::set<RTLIL::IdString> &limits, int &max_objects, char mode)
+{
+	int sel_objects = 0;
+	auto &selected_members = lhs.selected_members[mod->name];
+	pool<RTLIL::IdString> frontier;
+	std::swap(frontier, graph.frontier);
+
+	auto add_member = [&](RTLIL::IdString name) {
+		if (max_objects == 0 || selected_members.count(name))
+			return;
+		selected_members.insert(name);
+		graph.frontier.insert(name);
+		sel_objects++, max_objects--;
+	};
+
+	for (auto name : frontier)
+	{
+		if (limits.count(name))
+			continue;
+
+		RTLIL::Wire *wire = mod->wire(name);
+		if (wire != nullptr) {
+			auto it = graph.wire_wires.find(wire);
+			if (it != graph.wire_wires.end())
+				for (auto other : it->second)
+					add_member(other->name);
+			auto pit = graph.wire_ports.find(wire);
+			if (pit != graph.wire_ports.end())
+				for (int idx : pit->second) {
+					auto &port = graph.ports[idx];
+					if (mode == 'x' || (mode == 'i' && port.is_output) || (mode == 'o' && port.is_input))
+						add_member(port.cell->name);
+				}
+		}
+
+		auto cit = graph.cell_ports.find(name);
+		if (cit != graph.cell_ports.end())
+			for (int idx : cit->second) {
+				auto &port = graph.ports[idx];
+				if (mode == 'x' || (mode == 'i' && port.is_input) || (mode == 'o' && port.is_output))
+					for (auto w : port.wires)
+						add_member(w->name);
+			}
+	}
 
 	return sel_objects;
 }
@@ -593,11 +708,23 @@ static void select_op_expand(RTLIL::Design *design, const std::string &arg, char
 	}
 #endif
 
+	RTLIL::Selection &lhs = work_stack.back();
+	dict<RTLIL::Module*, std::unique_ptr<expand_graph_t>> graphs;
+
+	for (auto mod : design->modules()) {
+		if (lhs.selected_whole_module(mod->name) || !lhs.selected_module(mod->name))
+			continue;
+		auto &graph = graphs[mod];
+		graph.reset(new expand_graph_t(mod, rules, mode, ct, eval_only));
+		graph->frontier = lhs.selected_members[mod->name];
+	}
+
 	while (levels-- > 0 && rem_objects != 0) {
-		int num_objects = select_op_expand(design, work_stack.back(), rules, limits, rem_objects, mode, ct, eval_only);
+		int num_objects = 0;
+		for (auto &it : graphs)
+			num_objects += select_op_expand(it.first, *it.second, lhs, limits, rem_objects, mode);
 		if (num_objects == 0)
 			break;
-		rem_objects -= num_objects;
 	}
 
 	if (rem_objects == 0)
@@ -805,22 +932,43 @@ static void select_stmt(RTLIL::Design *design, std::string arg, bool disable_emp
 	}
 
 	sel.full_selection = false;
-	for (auto mod : design->modules())
+
+	// patterns are compiled once here and not per visited object
+	bool mod_attr = arg_mod.compare(0, 2, "A:") == 0;
+	id_pattern_t mod_pat(arg_mod.compare(0, 2, "N:") == 0 || mod_attr ? arg_mod.substr(2) : arg_mod);
+	attr_pattern_t mod_attr_pat(mod_attr ? arg_mod.substr(2) : std::string());
+
+	std::string memb_prefix, memb_expr = arg_memb;
+	if (isprefixed(arg_memb) && std::string("wioxsmctparn").find(arg_memb[0]) != std::string::npos) {
+		memb_prefix = arg_memb.substr(0, 2);
+		memb_expr = arg_memb.substr(2);
+		if (memb_prefix == "n:")
+			memb_prefix.clear();
+	}
+	id_pattern_t memb_pat(memb_expr);
+	attr_pattern_t memb_attr_pat(memb_prefix == "a:" || memb_prefix == "r:" ? memb_expr : std::string());
+
+	std::vector<RTLIL::Module*> candidate_mods;
+	if (!mod_attr && mod_pat.literal()) {
+		RTLIL::Module *mod = design->module(mod_pat.literal_id);
+		if (mod != nullptr)
+			candidate_mods.push_back(mod);
+	} else {
+		candidate_mods = design->modules().to_vector();
+	}
+
+	for (auto mod : candidate_mods)
 	{
 		if (!select_blackboxes && mod->get_blackbox_attribute())
 			continue;
 
-		if (arg_mod.compare(0, 2, "A:") == 0) {
-			if (!match_attr(mod->attributes, arg_mod.substr(2)))
-				continue;
-		} else
-		if (arg_mod.compare(0, 2, "N:") == 0) {
-			if (!match_ids(mod->name, arg_mod.substr(2)))
+		if (mod_attr) {
+			if (!mod_attr_pat.match(mod->attributes))
 				continue;
 		} else
-		if (!match_ids(mod->name, arg_mod))
+		if (!mod_pat.match(mod->name))
 			continue;
-		else
+		else if (arg_mod.compare(0, 2, "N:") != 0)
 			arg_mod_found[arg_mod] = true;
 
 		if (arg_memb == "") {
@@ -828,106 +976,124 @@ static void select_stmt(RTLIL::Design *design, std::string arg, bool disable_emp
 			continue;
 		}
 
-		if (arg_memb.compare(0, 2, "w:") == 0) {
-			for (auto wire : mod->wires())
-				if (match_ids(wire->name, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(wire->name);
-		} else
-		if (arg_memb.compare(0, 2, "i:") == 0) {
-			for (auto wire : mod->wires())
-				if (wire->port_input && match_ids(wire->name, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(wire->name);
-		} else
-		if (arg_memb.compare(0, 2, "o:") == 0) {
-			for (auto wire : mod->wires())
-				if (wire->port_output && match_ids(wire->name, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(wire->name);
-		} else
-		if (arg_memb.compare(0, 2, "x:") == 0) {
-			for (auto wire : mod->wires())
-				if ((wire->port_input || wire->port_output) && match_ids(wire->name, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(wire->name);
+		auto &members = sel.selected_members[mod->name];
+
+		if (memb_prefix == "w:" || memb_prefix == "i:" || memb_prefix == "o:" || memb_prefix == "x:") {
+			auto wire_matches = [&](RTLIL::Wire *wire) {
+				if (memb_prefix == "i:")
+					return wire->port_input;
+				if (memb_prefix == "o:")
+					return wire->port_output;
+				if (memb_prefix == "x:")
+					return wire->port_input || wire->port_output;
+				return true;
+			};
+			if (memb_pat.literal()) {
+				RTLIL::Wire *wire = mod->wire(memb_pat.literal_id);
+				if (wire != nullptr && wire_matches(wire))
+					members.insert(wire->name);
+			} else {
+				for (auto wire : mod->wires())
+					if (wire_matches(wire) && memb_pat.match(wire->name))
+						members.insert(wire->name);
+			}
 		} else
-		if (arg_memb.compare(0, 2, "s:") == 0) {
-			size_t delim = arg_memb.substr(2).find(':');
+		if (memb_prefix == "s:") {
+			size_t delim = memb_expr.find(':');
 			if (delim == std::string::npos) {
-				int width = atoi(arg_memb.substr(2).c_str());
+				int width = atoi(memb_expr.c_str());
 				for (auto wire : mod->wires())
 					if (wire->width == width)
-						sel.selected_members[mod->name].insert(wire->name);
+						members.insert(wire->name);
 			} else {
-				std::string min_str = arg_memb.substr(2, delim);
-				std::string max_str = arg_memb.substr(2+delim+1);
+				std::string min_str = memb_expr.substr(0, delim);
+				std::string max_str = memb_expr.substr(delim+1);
 				int min_width = min_str.empty() ? 0 : atoi(min_str.c_str());
 				int max_width = max_str.empty() ? -1 : atoi(max_str.c_str());
 				for (auto wire : mod->wires())
 					if (min_width <= wire->width && (wire->width <= max_width || max_width == -1))
-						sel.selected_members[mod->name].insert(wire->name);
+						members.insert(wire->name);
 			}
 		} else
-		if (arg_memb.compare(0, 2, "m:") == 0) {
-			for (auto &it : mod->memories)
-				if (match_ids(it.first, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(it.first);
+		if (memb_prefix == "m:") {
+			if (memb_pat.literal()) {
+				if (mod->memories.count(memb_pat.literal_id))
+					members.insert(memb_pat.literal_id);
+			} else {
+				for (auto &it : mod->memories)
+					if (memb_pat.match(it.first))
+						members.insert(it.first);
+			}
 		} else
-		if (arg_memb.compare(0, 2, "c:") == 0) {
-			for (auto cell : mod->cells())
-				if (match_ids(cell->name, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(cell->name);
+		if (memb_prefix == "c:") {
+			if (memb_pat.literal()) {
+				if (mod->cell(memb_pat.literal_id) != nullptr)
+					members.insert(memb_pat.literal_id);
+			} else {
+				for (auto cell : mod->cells())
+					if (memb_pat.match(cell->name))
+						members.insert(cell->name);
+			}
 		} else
-		if (arg_memb.compare(0, 2, "t:") == 0) {
+		if (memb_prefix == "t:") {
 			for (auto cell : mod->cells())
-				if (match_ids(cell->type, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(cell->name);
+				if (memb_pat.match(cell->type))
+					members.insert(cell->name);
 		} else
-		if (arg_memb.compare(0, 2, "p:") == 0) {
-			for (auto &it : mod->processes)
-				if (match_ids(it.first, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(it.first);
+		if (memb_prefix == "p:") {
+			if (memb_pat.literal()) {
+				if (mod->processes.count(memb_pat.literal_id))
+					members.insert(memb_pat.literal_id);
+			} else {
+				for (auto &it : mod->processes)
+					if (memb_pat.match(it.first))
+						members.insert(it.first);
+			}
 		} else
-		if (arg_memb.compare(0, 2, "a:") == 0) {
+		if (memb_prefix == "a:") {
 			for (auto wire : mod->wires())
-				if (match_attr(wire->attributes, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(wire->name);
+				if (memb_attr_pat.match(wire->attributes))
+					members.insert(wire->name);
 			for (auto &it : mod->memories)
-				if (match_attr(it.second->attributes, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(it.first);
+				if (memb_attr_pat.match(it.second->attributes))
+					members.insert(it.first);
 			for (auto cell : mod->cells())
-				if (match_attr(cell->attributes, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(cell->name);
+				if (memb_attr_pat.match(cell->attributes))
+					members.insert(cell->name);
 			for (auto &it : mod->processes)
-				if (match_attr(it.second->attributes, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(it.first);
+				if (memb_attr_pat.match(it.second->attributes))
+					members.insert(it.first);
 		} else
-		if (arg_memb.compare(0, 2, "r:") == 0) {
+		if (memb_prefix == "r:") {
 			for (auto cell : mod->cells())
-				if (match_attr(cell->parameters, arg_memb.substr(2)))
-					sel.selected_members[mod->name].insert(cell->name);
+				if (memb_attr_pat.match(cell->parameters))
+					members.insert(cell->name);
 		} else {
-			std::string orig_arg_memb = arg_memb;
-			if (arg_memb.compare(0, 2, "n:") == 0)
-				arg_memb = arg_memb.substr(2);
-			for (auto wire : mod->wires())
-				if (match_ids(wire->name, arg_memb)) {
-					sel.selected_members[mod->name].insert(wire->name);
-					arg_memb_found[orig_arg_memb] = true;
-				}
-			for (auto &it : mod->memories)
-				if (match_ids(it.first, arg_memb)) {
-					sel.selected_members[mod->name].insert(it.first);
-					arg_memb_found[orig_arg_memb] = true;
-				}
-			for (auto cell : mod->cells())
-				if (match_ids(cell->name, arg_memb)) {
-					sel.selected_members[mod->name].insert(cell->name);
-					arg_memb_found[orig_arg_memb] = true;
-				}
-			for (auto &it : mod->processes)
-				if (match_ids(it.first, arg_memb)) {
-					sel.selected_members[mod->name].insert(it.first);
-					arg_memb_found[orig_arg_memb] = true;
-				}
+			size_t old_size = members.size();
+			if (memb_pat.literal()) {
+				RTLIL::IdString id = memb_pat.literal_id;
+				if (mod->wire(id) != nullptr || mod->memories.count(id) || mod->cell(id) != nullptr || mod->processes.count(id))
+					members.insert(id);
+			} else {
+				for (auto wire : mod->wires())
+					if (memb_pat.match(wire->name))
+						members.insert(wire->name);
+				for (auto &it : mod->memories)
+					if (memb_pat.match(it.first))
+						members.insert(it.first);
+				for (auto cell : mod->cells())
+					if (memb_pat.match(cell->name))
+						members.insert(cell->name);
+				for (auto &it : mod->processes)
+					if (memb_pat.match(it.first))
+						members.insert(it.first);
+			}
+			if (members.size() != old_size)
+				arg_memb_found[arg_memb] = true;
 		}
+
+		if (members.empty())
+			sel.selected_members.erase(mod->name);
 	}
 
 	select_filter_active_mod(design, work_stack.back());
@@ -99,14 +99,19 @@ struct SetattrPass : public Pass {
 		for (auto module : design->modules())
 		{
 			if (flag_mod) {
-				if (design->selected_whole_module(module->name))
+				if (design->selected_whole_module(module->name)) {
 					do_setunset(module->attributes, setunset_list);
+					module->generation_++;
+				}
 				continue;
 			}
 
 			if (!design->selected(module))
 				continue;
 
+			// attributes such as keep change what later passes may do with the module
+			module->generation_++;
+
 			for (auto wire : module->wires())
 				if (design->selected(module, wire))
 					do_setunset(wire->attributes, setunset_list);
@@ -208,6 +213,7 @@ struct SetparamPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			module->generation_++;
 			for (auto cell : module->selected_cells()) {
 				if (!new_cell_type.empty())
 					cell->type = new_cell_type;
@@ -540,6 +540,9 @@ struct SetundefPass : public Pass {
 					}
 				}
 			}
+
+			// cell ports and connections were rewritten in place
+			module->notify_blackout();
 		}
 	}
 } SetundefPass;
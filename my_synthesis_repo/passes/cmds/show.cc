@@ -19,6 +19,7 @@
 
 #include "kernel/register.h"
 #include "kernel/celltypes.h"
+#include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include <string.h>
 
@@ -66,6 +67,7 @@ struct ShowWorker
 	bool abbreviateIds;
 	bool notitle;
 	bool href;
+	int max_nodes;
 	int page_counter;
 
 	const std::vector<std::pair<std::string, RTLIL::Selection>> &color_selections;
@@ -616,13 +618,108 @@ struct ShowWorker
 		fprintf(f, "}\n");
 	}
 
+	int count_nodes()
+	{
+		int count = GetSize(module->selected_cells());
+		for (auto &it : module->processes)
+			if (design->selected_member(module->name, it.first))
+				count++;
+		for (auto wire : module->selected_wires())
+			if (wire->name.isPublic())
+				count++;
+		return count;
+	}
+
+	// Level-of-detail view for modules larger than the node budget: one node per
+	// 'vg' group (see 'viz -set-vg-attr') or, for cells without it, per cell type.
+	void handle_module_collapsed()
+	{
+		dot_escape_store.clear();
+		dot_id2num_store.clear();
+
+		SigMap sigmap(module);
+		std::map<std::string, int> cluster_ids;
+		std::vector<int> cluster_sizes;
+		dict<SigBit, pool<int>> drivers, readers;
+		pool<std::pair<int, int>> edges;
+
+		for (auto cell : module->selected_cells())
+		{
+			std::string key = cell->has_attribute(ID(vg)) ? stringf("vg=%d", cell->attributes.at(ID(vg)).as_int()) : cell->type.str();
+			auto it = cluster_ids.find(key);
+			if (it == cluster_ids.end()) {
+				it = cluster_ids.emplace(key, GetSize(cluster_sizes)).first;
+				cluster_sizes.push_back(0);
+			}
+			cluster_sizes[it->second]++;
+
+			for (auto &conn : cell->connections())
+				for (auto bit : sigmap(conn.second)) {
+					if (bit.wire == nullptr)
+						continue;
+					if (ct.cell_output(cell->type, conn.first))
+						drivers[bit].insert(it->second);
+					else
+						readers[bit].insert(it->second);
+				}
+		}
+
+		fprintf(f, "digraph \"%s\" {\n", escape(module->name.str()));
+		if (!notitle)
+			fprintf(f, "label=\"%s\";\n", escape(module->name.str()));
+		fprintf(f, "rankdir=\"LR\";\n");
+		fprintf(f, "remincross=true;\n");
+
+		for (auto &it : cluster_ids)
+			fprintf(f, "g%d [ shape=box3d, label=\"%s\\n%d cells\" ];\n", it.second, escape(it.first), cluster_sizes[it.second]);
+
+		for (auto wire : module->selected_wires())
+		{
+			if (!wire->port_input && !wire->port_output)
+				continue;
+			fprintf(f, "n%d [ shape=octagon, label=\"%s\" ];\n", id2num(wire->name), findLabel(wire->name.str()));
+			auto &peers = wire->port_input ? readers : drivers;
+			pool<int> targets;
+			for (auto bit : sigmap(wire)) {
+				auto it = peers.find(bit);
+				if (it != peers.end())
+					targets.insert(it->second.begin(), it->second.end());
+			}
+			for (int idx : targets) {
+				if (wire->port_input)
+					fprintf(f, "n%d:e -> g%d:w;\n", id2num(wire->name), idx);
+				else
+					fprintf(f, "g%d:e -> n%d:w;\n", idx, id2num(wire->name));
+			}
+		}
+
+		for (auto &it : drivers) {
+			auto reader = readers.find(it.first);
+			if (reader == readers.end())
+				continue;
+			for (int from : it.second)
+				for (int to : reader->second)
+					if (from != to)
+						edges.insert({from, to});
+		}
+		edges.sort();
+		for (auto &edge : edges)
+			fprintf(f, "g%d:e -> g%d:w;\n", edge.first, edge.second);
+
+		fprintf(f, "}\n");
+
+		if (GetSize(cluster_ids) > max_nodes)
+			log_warning("Collapsed view of module %s still has %d nodes, more than the budget of %d.\n",
+					log_id(module), GetSize(cluster_ids), max_nodes);
+	}
+
 	ShowWorker(FILE *f, RTLIL::Design *design, std::vector<RTLIL::Design*> &libs, uint32_t colorSeed, bool genWidthLabels,
-			bool genSignedLabels, bool stretchIO, bool enumerateIds, bool abbreviateIds, bool notitle, bool href,
+			bool genSignedLabels, bool stretchIO, bool enumerateIds, bool abbreviateIds, bool notitle, bool href, int max_nodes,
 			const std::vector<std::pair<std::string, RTLIL::Selection>> &color_selections,
 			const std::vector<std::pair<std::string, RTLIL::Selection>> &label_selections, RTLIL::IdString colorattr) :
 			f(f), design(design), currentColor(colorSeed), genWidthLabels(genWidthLabels),
 			genSignedLabels(genSignedLabels), stretchIO(stretchIO), enumerateIds(enumerateIds), abbreviateIds(abbreviateIds),
-			notitle(notitle), href(href), color_selections(color_selections), label_selections(label_selections), colorattr(colorattr)
+			notitle(notitle), href(href), max_nodes(max_nodes), color_selections(color_selections), label_selections(label_selections), colorattr(colorattr)
 	{
 		ct.setup_internals();
 		ct.setup_internals_mem();
@@ -651,7 +748,12 @@ struct ShowWorker
 					log("Dumping module %s to page %d.\n", log_id(module->name), ++page_counter);
 			} else
 				log("Dumping selected parts of module %s to page %d.\n", log_id(module->name), ++page_counter);
-			handle_module();
+			int node_count = max_nodes > 0 ? count_nodes() : 0;
+			if (node_count > max_nodes) {
+				log("  Module has %d nodes, exceeding the budget of %d: showing cells collapsed by group.\n", node_count, max_nodes);
+				handle_module_collapsed();
+			} else
+				handle_module();
 		}
 	}
 };
@@ -739,6 +841,16 @@ struct ShowPass : public Pass {
 		log("        adds href attribute to all items representing cells and wires, using\n");
 		log("        src attribute of origin\n");
 		log("\n");
+		log("    -max_nodes <n>\n");
+		log("        node budget per module. modules with more selected cells, processes\n");
+		log("        and public wires are shown collapsed: one node for each 'vg' group\n");
+		log("        (as set by 'viz -set-vg-attr') and for each type of the remaining\n");
+		log("        cells, plus the module ports.\n");
+		log("\n");
+		log("    -async\n");
+		log("        run 'dot' and the viewer as one background job, so that the script\n");
+		log("        continues while the graph is rendered (POSIX systems only).\n");
+		log("\n");
 		log("When no <format> is specified, 'dot' is used. When no <format> and <viewer> is\n");
 		log("specified, 'xdot' is used to display the schematic (POSIX systems only).\n");
 		log("\n");
@@ -777,6 +889,8 @@ struct ShowPass : public Pass {
 		bool flag_abbreviate = true;
 		bool flag_notitle = false;
 		bool flag_href = false;
+		bool flag_async = false;
+		int max_nodes = 0;
 		bool custom_prefix = false;
 		std::string background = "&";
 		RTLIL::IdString colorattr;
@@ -868,6 +982,14 @@ struct ShowPass : public Pass {
 				flag_href = true;
 				continue;
 			}
+			if (arg == "-max_nodes" && argidx+1 < args.size()) {
+				max_nodes = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (arg == "-async") {
+				flag_async = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -912,7 +1034,7 @@ struct ShowPass : public Pass {
 				delete lib;
 			log_cmd_error("Can't open dot file `%s' for writing.\n", dot_file.c_str());
 		}
-		ShowWorker worker(f, design, libs, colorSeed, flag_width, flag_signed, flag_stretch, flag_enum, flag_abbreviate, flag_notitle, flag_href, color_selections, label_selections, colorattr);
+		ShowWorker worker(f, design, libs, colorSeed, flag_width, flag_signed, flag_stretch, flag_enum, flag_abbreviate, flag_notitle, flag_href, max_nodes, color_selections, label_selections, colorattr);
 		fclose(f);
 
 		for (auto lib : libs)
@@ -930,6 +1052,16 @@ struct ShowPass : public Pass {
 			#endif
 			std::string cmd = stringf(DOT_CMD, format.c_str(), dot_file.c_str(), out_file.c_str(), out_file.c_str(), out_file.c_str());
 			#undef DOT_CMD
+			#ifndef _WIN32
+			if (flag_async) {
+				// the viewer has to wait for the rendered file, so it joins the background job
+				if (!viewer_exe.empty() && viewer_exe != "none") {
+					cmd = stringf("{ %s && %s '%s'; } &", cmd.c_str(), viewer_exe.c_str(), out_file.c_str());
+					viewer_exe = "none";
+				} else
+					cmd = stringf("{ %s; } &", cmd.c_str());
+			}
+			#endif
 			log("Exec: %s\n", cmd.c_str());
 			#if !defined(YOSYS_DISABLE_SPAWN)
 				if (run_command(cmd) != 0)
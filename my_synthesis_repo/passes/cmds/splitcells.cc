@@ -29,6 +29,7 @@ struct SplitcellsWorker
 	SigMap sigmap;
 	dict<SigBit, tuple<IdString,IdString,int>> bit_drivers_db;
 	dict<SigBit, pool<tuple<IdString,IdString,int>>> bit_users_db;
+	std::vector<Cell*> new_slices;
 
 	SplitcellsWorker(Module *module) : module(module), sigmap(module)
 	{
@@ -66,6 +67,28 @@ struct SplitcellsWorker
 		}
 	}
 
+	const pool<tuple<IdString,IdString,int>> &users(SigBit bit) const
+	{
+		static const pool<tuple<IdString,IdString,int>> empty;
+		auto it = bit_users_db.find(bit);
+		return it == bit_users_db.end() ? empty : it->second;
+	}
+
+	// Only cells whose output users changed in the last round can be split
+	// further: the drivers of the inputs of the slices created in it.
+	void add_drivers(const std::vector<Cell*> &slices, pool<IdString> &drivers)
+	{
+		for (auto slice : slices)
+		for (auto &conn : slice->connections()) {
+			if (!slice->input(conn.first)) continue;
+			for (auto bit : sigmap(conn.second)) {
+				auto it = bit_drivers_db.find(bit);
+				if (it != bit_drivers_db.end())
+					drivers.insert(std::get<0>(it->second));
+			}
+		}
+	}
+
 	int split(Cell *cell, const std::string &format)
 	{
 		if (cell->type.in("$and", "$mux", "$not", "$or", "$pmux", "$xnor", "$xor"))
@@ -82,14 +105,15 @@ struct SplitcellsWorker
 				width = std::min(width, GetSize(cell->getPort(ID::B)));
 
 			for (int i = 1; i < width; i++) {
-				auto &last_users = bit_users_db[outsig[slices.back()]];
-				auto &this_users = bit_users_db[outsig[i]];
-				if (last_users != this_users) slices.push_back(i);
+				auto &last_users = users(outsig[slices.back()]);
+				auto &this_users = users(outsig[i]);
+				if (&last_users != &this_users && last_users != this_users) slices.push_back(i);
 			}
 			if (GetSize(slices) <= 1) return 0;
 			slices.push_back(GetSize(outsig));
 
 			log("Splitting %s cell %s/%s into %d slices:\n", log_id(cell->type), log_id(module), log_id(cell), GetSize(slices)-1);
+			module->reserve_cells(GetSize(slices)-1);
 			for (int i = 1; i < GetSize(slices); i++)
 			{
 				int slice_msb = slices[i]-1;
@@ -100,6 +124,7 @@ struct SplitcellsWorker
 						stringf("%c%d%c%d%c", format[0], slice_msb, format[2], slice_lsb, format[1])));
 
 				Cell *slice = module->addCell(slice_name, cell);
+				new_slices.push_back(slice);
 
 				auto slice_signal = [&](SigSpec old_sig) -> SigSpec {
 					SigSpec new_sig;
@@ -148,15 +173,16 @@ struct SplitcellsWorker
 			slices.push_back(0);
 
 			for (int i = 1; i < width; i++) {
-				auto &last_users = bit_users_db[outsig[slices.back()]];
-				auto &this_users = bit_users_db[outsig[i]];
-				if (last_users != this_users) slices.push_back(i);
+				auto &last_users = users(outsig[slices.back()]);
+				auto &this_users = users(outsig[i]);
+				if (&last_users != &this_users && last_users != this_users) slices.push_back(i);
 			}
 
 			if (GetSize(slices) <= 1) return 0;
 			slices.push_back(GetSize(outsig));
 
 			log("Splitting %s cell %s/%s into %d slices:\n", log_id(cell->type), log_id(module), log_id(cell), GetSize(slices)-1);
+			module->reserve_cells(GetSize(slices)-1);
 			for (int i = 1; i < GetSize(slices); i++)
 			{
 				int slice_msb = slices[i]-1;
@@ -167,6 +193,7 @@ struct SplitcellsWorker
 						stringf("%c%d%c%d%c", format[0], slice_msb, format[2], slice_lsb, format[1])));
 
 				Cell *slice = module->addCell(slice_name, cell);
+				new_slices.push_back(slice);
 
 				for (IdString portname : splitports) {
 					if (slice->hasPort(portname)) {
@@ -244,10 +271,15 @@ struct SplitcellsPass : public Pass {
 			int count_split_pre = 0;
 			int count_split_post = 0;
 
-			while (1) {
+			std::vector<Cell*> last_slices;
+			for (int round = 0;; round++) {
 				SplitcellsWorker worker(module);
+				pool<IdString> candidates;
+				worker.add_drivers(last_slices, candidates);
 				bool did_something = false;
 				for (auto cell : module->selected_cells()) {
+					if (round > 0 && !candidates.count(cell->name))
+						continue;
 					int n = worker.split(cell, format);
 					did_something |= (n != 0);
 					count_split_pre += (n != 0);
@@ -255,6 +287,7 @@ struct SplitcellsPass : public Pass {
 				}
 				if (!did_something)
 					break;
+				last_slices.swap(worker.new_slices);
 			}
 
 			if (count_split_pre)
@@ -27,7 +27,7 @@ PRIVATE_NAMESPACE_BEGIN
 
 struct SplitnetsWorker
 {
-	std::map<RTLIL::Wire*, std::vector<RTLIL::SigBit>> splitmap;
+	dict<RTLIL::Wire*, std::vector<RTLIL::SigBit>> splitmap;
 
 	void append_wire(RTLIL::Module *module, RTLIL::Wire *wire, int offset, int width, std::string format)
 	{
@@ -81,15 +81,34 @@ struct SplitnetsWorker
 			new_wire->attributes.emplace(ID::init, new_init);
 		}
 
-		std::vector<RTLIL::SigBit> sigvec = RTLIL::SigSpec(new_wire).to_sigbit_vector();
-		splitmap[wire].insert(splitmap[wire].end(), sigvec.begin(), sigvec.end());
+		auto &bits = splitmap[wire];
+		for (int i = 0; i < width; i++)
+			bits.push_back(RTLIL::SigBit(new_wire, i));
 	}
 
 	void operator()(RTLIL::SigSpec &sig)
 	{
-		for (auto &bit : sig)
-			if (splitmap.count(bit.wire) > 0)
-				bit = splitmap.at(bit.wire).at(bit.offset);
+		// most signals do not touch a split wire, they are left packed
+		bool found = false;
+		for (auto &chunk : sig.chunks())
+			if (chunk.wire != nullptr && splitmap.count(chunk.wire)) {
+				found = true;
+				break;
+			}
+		if (!found)
+			return;
+
+		RTLIL::SigSpec new_sig;
+		for (auto &chunk : sig.chunks()) {
+			auto it = chunk.wire != nullptr ? splitmap.find(chunk.wire) : splitmap.end();
+			if (it == splitmap.end()) {
+				new_sig.append(chunk);
+				continue;
+			}
+			for (int i = 0; i < chunk.width; i++)
+				new_sig.append(it->second.at(chunk.offset + i));
+		}
+		sig = new_sig;
 	}
 };
 
@@ -195,6 +214,11 @@ struct SplitnetsPass : public Pass {
 					}
 				}
 
+				int new_wires = 0;
+				for (auto &it : split_wires_at)
+					new_wires += GetSize(it.second) + 1;
+				module->reserve_wires(new_wires);
+
 				for (auto &it : split_wires_at) {
 					int cursor = 0;
 					for (int next_cursor : it.second) {
@@ -206,10 +230,14 @@ struct SplitnetsPass : public Pass {
 			}
 			else
 			{
+				int new_wires = 0;
 				for (auto wire : module->wires()) {
-					if (wire->width > 1 && (wire->port_id == 0 || flag_ports) && design->selected(module, wire))
-						worker.splitmap[wire] = std::vector<RTLIL::SigBit>();
+					if (wire->width > 1 && (wire->port_id == 0 || flag_ports) && design->selected(module, wire)) {
+						worker.splitmap[wire].reserve(wire->width);
+						new_wires += wire->width;
+					}
 				}
+				module->reserve_wires(new_wires);
 
 				for (auto &it : worker.splitmap)
 					for (int i = 0; i < it.first->width; i++)
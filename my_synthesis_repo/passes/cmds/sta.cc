@@ -21,230 +21,539 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/timinginfo.h"
-#include <deque>
+#include "kernel/threading.h"
+#include <climits>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-struct StaWorker
+// The timing arcs of a module, kept on the module (Module::cached_timing_)
+// between calls of the pass. The arcs are extracted per cell; edits made
+// through the module's methods are recorded by the monitor callbacks, so a
+// later update only redoes the extraction (and the box derive) for cells
+// that changed. The arcs are then packed into a levelized graph with int
+// node ids, which is what arrival and required times are propagated on.
+struct TimingGraph : RTLIL::Monitor
 {
 	Design *design;
 	Module *module;
-	SigMap sigmap;
-
-	struct t_data {
-		Cell* driver;
-		IdString dst_port, src_port;
-		vector<tuple<SigBit,int,IdString>> fanouts;
-		SigBit backtrack;
-		t_data() : driver(nullptr) {}
+	TimingInfo timing;
+
+	struct arc_t {
+		SigBit src, dst;
+		int delay;
+		IdString src_port;
+	};
+
+	struct cell_entry_t {
+		Cell *cell;
+		IdString type;
+		unsigned int params_hash;
+		vector<arc_t> arcs;
+		vector<std::pair<SigBit, IdString>> outputs;
+		vector<std::tuple<SigBit, IdString, int>> setups;
+		// every wire referenced above, by name, so that wires deleted behind
+		// the monitor's back can be detected without touching the pointers
+		vector<std::pair<IdString, Wire*>> wires;
+	};
+
+	bool valid;
+	dict<IdString, cell_entry_t> cells;
+	pool<IdString> dirty_cells;
+	dict<IdString, unsigned int> box_hashes;
+	vector<std::tuple<IdString, Wire*, bool, bool>> port_wires;
+	pool<IdString> unrecognised_cells;
+
+	struct node_t {
+		SigBit bit;
+		Cell *driver, *sink;
+		IdString dst_port, sink_port;
+		int setup;
+		bool is_input, is_endpoint;
+		node_t() : driver(nullptr), sink(nullptr), setup(0), is_input(false), is_endpoint(false) { }
 	};
-	dict<SigBit, t_data> data;
-	std::deque<SigBit> queue;
-	struct t_endpoint {
-		Cell *sink;
-		IdString port;
-		int required;
-		t_endpoint() : sink(nullptr), required(0) {}
+
+	struct edge_t {
+		int src, dst, delay;
+		IdString src_port;
 	};
-	dict<SigBit, t_endpoint> endpoints;
 
-	int maxarrival;
-	SigBit maxbit;
+	vector<node_t> nodes;
+	vector<edge_t> edges;
+	vector<int> fanin_start, fanin_edges, fanout_start, fanout_edges;
+	vector<vector<int>> levels;
+	int loop_nodes;
 
-	pool<SigBit> driven;
+	vector<int> arrival, required, backtrack;
 
-	StaWorker(RTLIL::Module *module) : design(module->design), module(module), sigmap(module), maxarrival(0)
+	TimingGraph(Module *module) : design(module->design), module(module), valid(false), loop_nodes(0)
 	{
-		TimingInfo timing;
+		module->monitors.insert(this);
+	}
 
-		pool<IdString> unrecognised_cells;
+	~TimingGraph()
+	{
+		module->monitors.erase(this);
+	}
 
-		for (auto cell : module->cells())
-		{
-			Module *inst_module = design->module(cell->type);
-			if (!inst_module) {
-				if (unrecognised_cells.insert(cell->type).second)
-					log_warning("Cell type '%s' not recognised! Ignoring.\n", log_id(cell->type));
-				continue;
-			}
+	static TimingGraph &get(Module *module)
+	{
+		if (module->cached_timing_ == nullptr)
+			module->cached_timing_ = new TimingGraph(module);
+		return *static_cast<TimingGraph*>(module->cached_timing_);
+	}
 
-			if (!inst_module->get_blackbox_attribute()) {
-				log_warning("Cell type '%s' is not a black- nor white-box! Ignoring.\n", log_id(cell->type));
-				continue;
-			}
+	void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString&, const RTLIL::SigSpec&, const RTLIL::SigSpec&) override
+	{
+		dirty_cells.insert(cell->name);
+	}
 
-			IdString derived_type = inst_module->derive(design, cell->parameters);
-			inst_module = design->module(derived_type);
-			log_assert(inst_module);
+	void notify_connect(RTLIL::Module*, const RTLIL::SigSig&) override
+	{
+		valid = false;
+	}
 
-			if (!timing.count(derived_type)) {
-				auto &t = timing.setup_module(inst_module);
-				if (t.has_inputs && t.comb.empty() && t.arrival.empty() && t.required.empty())
-					log_warning("Module '%s' has no timing arcs!\n", log_id(cell->type));
-			}
+	void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) override
+	{
+		valid = false;
+	}
 
-			auto &t = timing.at(derived_type);
-			if (t.comb.empty() && t.arrival.empty() && t.required.empty())
-				continue;
+	void notify_blackout(RTLIL::Module*) override
+	{
+		valid = false;
+	}
+
+	void build_entry(cell_entry_t &entry, Cell *cell, const SigMap &sigmap)
+	{
+		entry = cell_entry_t();
+		entry.cell = cell;
+		entry.type = cell->type;
+		entry.params_hash = cell->parameters.hash();
+
+		Module *inst_module = design->module(cell->type);
+		if (!inst_module) {
+			if (unrecognised_cells.insert(cell->type).second)
+				log_warning("Cell type '%s' not recognised! Ignoring.\n", log_id(cell->type));
+			return;
+		}
+
+		if (!inst_module->get_blackbox_attribute()) {
+			log_warning("Cell type '%s' is not a black- nor white-box! Ignoring.\n", log_id(cell->type));
+			return;
+		}
+
+		IdString derived_type = inst_module->derive(design, cell->parameters);
+		inst_module = design->module(derived_type);
+		log_assert(inst_module);
+
+		if (!timing.count(derived_type)) {
+			auto &t = timing.setup_module(inst_module);
+			if (t.has_inputs && t.comb_empty() && t.arrival.empty() && t.required.empty())
+				log_warning("Module '%s' has no timing arcs!\n", log_id(cell->type));
+			box_hashes[derived_type] = inst_module->hashidx_;
+		}
+
+		auto &t = timing.at(derived_type);
+		if (t.comb_empty() && t.arrival.empty() && t.required.empty())
+			return;
 
-			pool<std::pair<SigBit,TimingInfo::NameBit>> src_bits, dst_bits;
+		pool<std::pair<SigBit,TimingInfo::NameBit>> src_bits, dst_bits;
+		pool<Wire*> wires;
+
+		for (auto &conn : cell->connections()) {
+			auto rhs = sigmap(conn.second);
+			for (auto i = 0; i < GetSize(rhs); i++) {
+				const auto &bit = rhs[i];
+				if (!bit.wire)
+					continue;
+				wires.insert(bit.wire);
+				TimingInfo::NameBit namebit(conn.first,i);
+				if (cell->input(conn.first)) {
+					src_bits.insert(std::make_pair(bit,namebit));
+
+					auto it = t.required.find(namebit);
+					if (it != t.required.end())
+						entry.setups.emplace_back(bit, conn.first, it->second.first);
+				}
+				if (cell->output(conn.first)) {
+					dst_bits.insert(std::make_pair(bit,namebit));
+					entry.outputs.emplace_back(bit, conn.first);
 
-			for (auto &conn : cell->connections()) {
-				auto rhs = sigmap(conn.second);
-				for (auto i = 0; i < GetSize(rhs); i++) {
-					const auto &bit = rhs[i];
-					if (!bit.wire)
+					auto it = t.arrival.find(namebit);
+					if (it == t.arrival.end())
 						continue;
-					TimingInfo::NameBit namebit(conn.first,i);
-					if (cell->input(conn.first)) {
-						src_bits.insert(std::make_pair(bit,namebit));
-
-						auto it = t.required.find(namebit);
-						if (it == t.required.end())
-							continue;
-						auto r = endpoints.insert(bit);
-						if (r.second || r.first->second.required < it->second.first) {
-							r.first->second.sink = cell;
-							r.first->second.port = conn.first;
-							r.first->second.required = it->second.first;
-						}
-					}
-					if (cell->output(conn.first)) {
-						dst_bits.insert(std::make_pair(bit,namebit));
-						auto &d = data[bit];
-						d.driver = cell;
-						d.dst_port = conn.first;
-						driven.insert(bit);
-
-						auto it = t.arrival.find(namebit);
-						if (it == t.arrival.end())
-							continue;
-						const auto &s = it->second.second;
-						if (cell->hasPort(s.name)) {
-							auto s_bit = sigmap(cell->getPort(s.name)[s.offset]);
-							if (s_bit.wire)
-								data[s_bit].fanouts.emplace_back(bit,it->second.first,s.name);
-						}
+					const auto &s = it->second.second;
+					if (cell->hasPort(s.name)) {
+						auto s_bit = sigmap(cell->getPort(s.name)[s.offset]);
+						if (s_bit.wire)
+							entry.arcs.push_back({s_bit, bit, it->second.first, s.name});
 					}
 				}
 			}
+		}
 
-			for (const auto &s : src_bits)
-				for (const auto &d : dst_bits) {
-					auto it = t.comb.find(TimingInfo::BitBit(s.second,d.second));
-					if (it == t.comb.end())
-						continue;
-					data[s.first].fanouts.emplace_back(d.first,it->second,s.second.name);
+		for (const auto &s : src_bits)
+			for (const auto &d : dst_bits) {
+				int delay = t.comb_delay(s.second, d.second);
+				if (delay < 0)
+					continue;
+				entry.arcs.push_back({s.first, d.first, delay, s.second.name});
+			}
+
+		for (auto wire : wires)
+			entry.wires.emplace_back(wire->name, wire);
+	}
+
+	bool entry_alive(const cell_entry_t &entry)
+	{
+		for (auto &it : entry.wires)
+			if (module->wire(it.first) != it.second)
+				return false;
+		return true;
+	}
+
+	bool ports_unchanged()
+	{
+		if (GetSize(port_wires) != GetSize(module->ports))
+			return false;
+		for (int i = 0; i < GetSize(port_wires); i++) {
+			Wire *wire = module->wire(std::get<0>(port_wires[i]));
+			if (wire != std::get<1>(port_wires[i]) || wire->port_input != std::get<2>(port_wires[i]) || wire->port_output != std::get<3>(port_wires[i]))
+				return false;
+		}
+		return true;
+	}
+
+	// brings the per-cell arcs up to date, returns the number of cells whose
+	// arcs were extracted again
+	int update_cells()
+	{
+		if (valid) {
+			for (auto &it : box_hashes) {
+				Module *box = design->module(it.first);
+				if (box == nullptr || box->hashidx_ != it.second)
+					valid = false;
+			}
+			if (!ports_unchanged())
+				valid = false;
+		}
+
+		if (valid)
+			for (auto &it : cells)
+				if (module->cell(it.first) == it.second.cell && !entry_alive(it.second))
+					valid = false;
+
+		if (!valid) {
+			cells.clear();
+			box_hashes.clear();
+			timing = TimingInfo();
+			unrecognised_cells.clear();
+			valid = true;
+		}
+
+		const SigMap &sigmap = SigMap::get(module);
+		int rebuilt = 0;
+
+		pool<IdString> stale;
+		for (auto &it : cells) {
+			Cell *cell = module->cell(it.first);
+			if (cell != it.second.cell || dirty_cells.count(it.first) || cell->type != it.second.type || cell->parameters.hash() != it.second.params_hash)
+				stale.insert(it.first);
+		}
+		for (auto name : stale)
+			cells.erase(name);
+		dirty_cells.clear();
+
+		for (auto cell : module->cells()) {
+			auto it = cells.find(cell->name);
+			if (it != cells.end())
+				continue;
+			build_entry(cells[cell->name], cell, sigmap);
+			rebuilt++;
+		}
+
+		port_wires.clear();
+		for (auto port_name : module->ports) {
+			Wire *wire = module->wire(port_name);
+			port_wires.emplace_back(port_name, wire, wire->port_input, wire->port_output);
+		}
+
+		return rebuilt;
+	}
+
+	void build_graph()
+	{
+		const SigMap &sigmap = SigMap::get(module);
+		dict<SigBit, int> node_of;
+		nodes.clear();
+		edges.clear();
+
+		auto node = [&](const SigBit &bit) {
+			auto r = node_of.insert(std::make_pair(bit, GetSize(nodes)));
+			if (r.second) {
+				nodes.emplace_back();
+				nodes.back().bit = bit;
+			}
+			return r.first->second;
+		};
+
+		for (auto &it : cells) {
+			auto &entry = it.second;
+			for (auto &s : entry.setups) {
+				auto &n = nodes[node(std::get<0>(s))];
+				if (!n.is_endpoint || n.setup < std::get<2>(s)) {
+					n.sink = entry.cell;
+					n.sink_port = std::get<1>(s);
+					n.setup = std::get<2>(s);
 				}
+				n.is_endpoint = true;
+			}
+			for (auto &o : entry.outputs) {
+				auto &n = nodes[node(o.first)];
+				n.driver = entry.cell;
+				n.dst_port = o.second;
+			}
+			for (auto &arc : entry.arcs)
+				edges.push_back({node(arc.src), node(arc.dst), arc.delay, arc.src_port});
 		}
 
 		for (auto port_name : module->ports) {
 			auto wire = module->wire(port_name);
-			if (wire->port_input) {
-				for (const auto &b : sigmap(wire)) {
-					queue.emplace_back(b);
-					driven.insert(b);
+			for (const auto &b : sigmap(wire)) {
+				if (!b.wire)
+					continue;
+				if (wire->port_input)
+					nodes[node(b)].is_input = true;
+				if (wire->port_output)
+					nodes[node(b)].is_endpoint = true;
+			}
+		}
+
+		int num_nodes = GetSize(nodes);
+		fanin_start.assign(num_nodes + 1, 0);
+		fanout_start.assign(num_nodes + 1, 0);
+		for (auto &e : edges)
+			fanin_start[e.dst + 1]++, fanout_start[e.src + 1]++;
+		for (int i = 0; i < num_nodes; i++)
+			fanin_start[i + 1] += fanin_start[i], fanout_start[i + 1] += fanout_start[i];
+		fanin_edges.resize(GetSize(edges));
+		fanout_edges.resize(GetSize(edges));
+		{
+			vector<int> fanin_pos(fanin_start.begin(), fanin_start.end() - 1);
+			vector<int> fanout_pos(fanout_start.begin(), fanout_start.end() - 1);
+			for (int i = 0; i < GetSize(edges); i++) {
+				fanin_edges[fanin_pos[edges[i].dst]++] = i;
+				fanout_edges[fanout_pos[edges[i].src]++] = i;
+			}
+		}
+
+		// levelize, nodes on combinational loops never get a level
+		levels.clear();
+		vector<int> pending(num_nodes), current;
+		for (int i = 0; i < num_nodes; i++) {
+			pending[i] = fanin_start[i + 1] - fanin_start[i];
+			if (pending[i] == 0)
+				current.push_back(i);
+		}
+		int levelized = 0;
+		while (!current.empty()) {
+			vector<int> next;
+			for (int i : current)
+				for (int k = fanout_start[i]; k < fanout_start[i + 1]; k++)
+					if (--pending[edges[fanout_edges[k]].dst] == 0)
+						next.push_back(edges[fanout_edges[k]].dst);
+			levelized += GetSize(current);
+			levels.push_back(std::move(current));
+			current = std::move(next);
+		}
+		loop_nodes = num_nodes - levelized;
+	}
+
+	// calls worker(node) for all nodes of one level, the nodes of a level do
+	// not depend on each other
+	static void for_level(const vector<int> &level, const std::function<void(int)> &worker)
+	{
+		const int chunk_size = 4096;
+		if (yosys_parallel_jobs <= 1 || GetSize(level) < 2 * chunk_size) {
+			for (int i : level)
+				worker(i);
+			return;
+		}
+		int chunks = (GetSize(level) + chunk_size - 1) / chunk_size;
+		parallel_for(chunks, [&](int c) {
+			int end = std::min(GetSize(level), (c + 1) * chunk_size);
+			for (int k = c * chunk_size; k < end; k++)
+				worker(level[k]);
+		});
+	}
+
+	void propagate_arrival()
+	{
+		arrival.assign(GetSize(nodes), INT_MIN);
+		backtrack.assign(GetSize(nodes), -1);
+
+		for (auto &level : levels)
+			for_level(level, [&](int i) {
+				int best = nodes[i].is_input ? 0 : INT_MIN;
+				for (int k = fanin_start[i]; k < fanin_start[i + 1]; k++) {
+					auto &e = edges[fanin_edges[k]];
+					if (arrival[e.src] == INT_MIN || arrival[e.src] + e.delay <= best)
+						continue;
+					best = arrival[e.src] + e.delay;
+					backtrack[i] = fanin_edges[k];
 				}
-				// All primary inputs to arrive at time zero
-				wire->set_intvec_attribute(ID::sta_arrival, std::vector<int>(GetSize(wire), 0));
+				arrival[i] = best;
+			});
+	}
+
+	void propagate_required(int period)
+	{
+		required.assign(GetSize(nodes), INT_MAX);
+
+		for (int l = GetSize(levels) - 1; l >= 0; l--)
+			for_level(levels[l], [&](int i) {
+				int best = nodes[i].is_endpoint ? period - nodes[i].setup : INT_MAX;
+				for (int k = fanout_start[i]; k < fanout_start[i + 1]; k++) {
+					auto &e = edges[fanout_edges[k]];
+					if (required[e.dst] != INT_MAX)
+						best = std::min(best, required[e.dst] - e.delay);
+				}
+				required[i] = best;
+			});
+	}
+
+	int path_end(int i) const
+	{
+		return arrival[i] + (nodes[i].is_endpoint ? nodes[i].setup : 0);
+	}
+};
+
+struct StaWorker
+{
+	Module *module;
+	TimingGraph &graph;
+	int num_paths, period;
+	bool has_period;
+
+	int maxarrival, wns;
+	long long tns;
+
+	StaWorker(RTLIL::Module *module, int num_paths, bool has_period, int period) : module(module), graph(TimingGraph::get(module)),
+			num_paths(num_paths), period(period), has_period(has_period), maxarrival(0), wns(0), tns(0)
+	{
+		bool was_valid = graph.valid && !graph.cells.empty();
+		int rebuilt = graph.update_cells();
+		if (was_valid)
+			log("Updated timing arcs of %d out of %d cells in '%s'.\n", rebuilt, GetSize(graph.cells), log_id(module));
+		graph.build_graph();
+		if (graph.loop_nodes > 0)
+			log_warning("Found %d timing nodes on combinational loops in '%s', ignoring them.\n", graph.loop_nodes, log_id(module));
+	}
+
+	void log_path(int end)
+	{
+		auto &n = graph.nodes[end];
+		int value = graph.path_end(end);
+
+		if (n.sink)
+			log("  %6d %s (%s.%s)\n", value, log_id(n.sink), log_id(n.sink->type), log_id(n.sink_port));
+		else {
+			log("  %6d (%s)\n", value, n.bit.wire->port_output ? "<primary output>" : "<unknown>");
+			if (!n.bit.wire->port_output)
+				log_warning("Critical-path does not terminate in a recognised endpoint.\n");
+		}
+
+		for (int i = end; i >= 0; ) {
+			auto &node = graph.nodes[i];
+			int e = graph.backtrack[i];
+			if (e >= 0) {
+				log("           %s\n", log_signal(node.bit));
+				log("  %6d %s (%s.%s->%s)\n", graph.arrival[i], log_id(node.driver), log_id(node.driver->type), log_id(graph.edges[e].src_port), log_id(node.dst_port));
+				i = graph.edges[e].src;
+			} else {
+				if (node.is_input)
+					log("  %6d   %s (%s)\n", graph.arrival[i], log_signal(node.bit), "<primary input>");
+				else
+					log_abort();
+				break;
 			}
-			if (wire->port_output)
-				for (const auto &b : sigmap(wire))
-					if (b.wire)
-						endpoints.insert(b);
 		}
 	}
 
 	void run()
 	{
-		while (!queue.empty()) {
-			auto b = queue.front();
-			queue.pop_front();
-			auto it = data.find(b);
-			if (it == data.end())
+		graph.propagate_arrival();
+
+		// path ends: endpoints and nodes without fanout that were reached
+		// through at least one arc, worst first
+		vector<int> ends;
+		for (int i = 0; i < GetSize(graph.nodes); i++)
+			if (graph.backtrack[i] >= 0 && (graph.nodes[i].is_endpoint || graph.fanout_start[i] == graph.fanout_start[i + 1]))
+				ends.push_back(i);
+		std::stable_sort(ends.begin(), ends.end(), [&](int a, int b) { return graph.path_end(a) > graph.path_end(b); });
+
+		// all primary inputs to arrive at time zero
+		for (auto port_name : module->ports) {
+			auto wire = module->wire(port_name);
+			if (wire->port_input)
+				wire->set_intvec_attribute(ID::sta_arrival, std::vector<int>(GetSize(wire), 0));
+		}
+		dict<Wire*, vector<int>> wire_arrivals;
+		for (int i = 0; i < GetSize(graph.nodes); i++) {
+			if (graph.arrival[i] == INT_MIN)
 				continue;
-			const auto& src_arrivals = b.wire->get_intvec_attribute(ID::sta_arrival);
-			log_assert(GetSize(src_arrivals) == GetSize(b.wire));
-			auto src_arrival = src_arrivals[b.offset];
-			for (const auto &d : it->second.fanouts) {
-				const auto &dst_bit = std::get<0>(d);
-				auto dst_arrivals = dst_bit.wire->get_intvec_attribute(ID::sta_arrival);
-				if (dst_arrivals.empty())
-					dst_arrivals = std::vector<int>(GetSize(dst_bit.wire), -1);
-				else
-					log_assert(GetSize(dst_arrivals) == GetSize(dst_bit.wire));
-				auto &dst_arrival = dst_arrivals[dst_bit.offset];
-				auto new_arrival = src_arrival + std::get<1>(d);
-				if (dst_arrival < new_arrival) {
-					auto dst_wire = dst_bit.wire;
-					dst_arrival = std::max(dst_arrival, new_arrival);
-					dst_wire->set_intvec_attribute(ID::sta_arrival, dst_arrivals);
-					queue.emplace_back(dst_bit);
-
-					data[dst_bit].backtrack = b;
-					data[dst_bit].src_port = std::get<2>(d);
-
-					auto it = endpoints.find(dst_bit);
-					if (it != endpoints.end())
-						new_arrival += it->second.required;
-					if (new_arrival > maxarrival && driven.count(b)) {
-						maxarrival = new_arrival;
-						maxbit = dst_bit;
-					}
-				}
-			}
+			auto &bit = graph.nodes[i].bit;
+			auto &arrivals = wire_arrivals[bit.wire];
+			if (arrivals.empty())
+				arrivals.resize(GetSize(bit.wire), -1);
+			arrivals[bit.offset] = graph.arrival[i];
 		}
+		for (auto &it : wire_arrivals)
+			it.first->set_intvec_attribute(ID::sta_arrival, it.second);
 
-		auto b = maxbit;
-		if (b == SigBit()) {
+		if (ends.empty()) {
 			log("No timing paths found.\n");
 			return;
 		}
 
+		maxarrival = graph.path_end(ends.front());
 		log("Latest arrival time in '%s' is %d:\n", log_id(module), maxarrival);
-		auto it = endpoints.find(maxbit);
-		if (it != endpoints.end() && it->second.sink)
-			log("  %6d %s (%s.%s)\n", maxarrival, log_id(it->second.sink), log_id(it->second.sink->type), log_id(it->second.port));
-		else {
-			log("  %6d (%s)\n", maxarrival, b.wire->port_output ? "<primary output>" : "<unknown>");
-			if (!b.wire->port_output)
-				log_warning("Critical-path does not terminate in a recognised endpoint.\n");
-		}
-		auto jt = data.find(b);
-		while (jt != data.end()) {
-			int arrival = b.wire->get_intvec_attribute(ID::sta_arrival)[b.offset];
-			if (jt->second.driver) {
-				log("           %s\n", log_signal(b));
-				log("  %6d %s (%s.%s->%s)\n", arrival, log_id(jt->second.driver), log_id(jt->second.driver->type), log_id(jt->second.src_port), log_id(jt->second.dst_port));
-			}
-			else if (b.wire->port_input)
-				log("  %6d   %s (%s)\n", arrival, log_signal(b), "<primary input>");
-			else
-				log_abort();
-			b = jt->second.backtrack;
-			jt = data.find(b);
+		log_path(ends.front());
+
+		for (int k = 1; k < std::min(num_paths, GetSize(ends)); k++) {
+			log("\n");
+			log("Path %d of %d in '%s' arrives at %d:\n", k+1, num_paths, log_id(module), graph.path_end(ends[k]));
+			log_path(ends[k]);
 		}
 
+		graph.propagate_required(has_period ? period : maxarrival);
+
 		std::map<int, unsigned> arrival_histogram;
-		for (const auto &i : endpoints) {
-			const auto &b = i.first;
-			if (!driven.count(b))
+		int failing = 0;
+		wns = INT_MAX;
+		for (int i = 0; i < GetSize(graph.nodes); i++) {
+			auto &n = graph.nodes[i];
+			if (!n.is_endpoint || (!n.is_input && n.driver == nullptr))
 				continue;
 
-			if (!b.wire->attributes.count(ID::sta_arrival)) {
-				log_warning("Endpoint %s.%s has no (* sta_arrival *) value.\n", log_id(module), log_signal(b));
+			if (graph.arrival[i] == INT_MIN || graph.arrival[i] < 0) {
+				log_warning("Endpoint %s.%s has no (* sta_arrival *) value.\n", log_id(module), log_signal(n.bit));
 				continue;
 			}
+			arrival_histogram[graph.path_end(i)]++;
 
-			auto arrival = b.wire->get_intvec_attribute(ID::sta_arrival)[b.offset];
-			if (arrival < 0) {
-				log_warning("Endpoint %s.%s has no (* sta_arrival *) value.\n", log_id(module), log_signal(b));
-				continue;
-			}
-			arrival += i.second.required;
-			arrival_histogram[arrival]++;
+			int slack = graph.required[i] - graph.arrival[i];
+			wns = std::min(wns, slack);
+			if (slack < 0)
+				tns += slack, failing++;
 		}
+
+		if (has_period && wns != INT_MAX) {
+			log("\n");
+			log("Worst slack in '%s' for a period of %d is %d", log_id(module), period, wns);
+			log(", total negative slack %lld on %d endpoint(s).\n", tns, failing);
+		}
+
 		// Adapted from https://github.com/YosysHQ/nextpnr/blob/affb12cc27ebf409eade062c4c59bb98569d8147/common/timing.cc#L946-L969
 		if (arrival_histogram.size() > 0) {
 			unsigned num_bins = 20;
@@ -284,30 +593,68 @@ struct StaPass : public Pass {
 		log("This command performs static timing analysis on the design. (Only considers\n");
 		log("paths within a single module, so the design must be flattened.)\n");
 		log("\n");
+		log("    -n <num>\n");
+		log("        report the <num> most critical paths of each module instead of only\n");
+		log("        the most critical one.\n");
+		log("\n");
+		log("    -period <time>\n");
+		log("        compute slack against this required time for all endpoints and report\n");
+		log("        worst and total negative slack. without this option the latest arrival\n");
+		log("        time is used as required time.\n");
+		log("\n");
+		log("Arrival times are stored in the sta_arrival attribute of the wires. The largest\n");
+		log("arrival time over the selected modules is stored in the scratchpad variable\n");
+		log("sta.max_arrival, with -period the worst and total negative slack also in\n");
+		log("sta.wns and sta.tns.\n");
+		log("\n");
+		log("The timing arcs extracted from the cells are kept with the module and only\n");
+		log("updated for cells that changed in the meantime, so running sta repeatedly\n");
+		log("during a script is cheap. Large levels of the timing graph are propagated\n");
+		log("in parallel when synthesizer runs with -j <jobs>.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		log_header(design, "Executing STA pass (static timing analysis).\n");
 
-		/*
+		int num_paths = 1, period = 0;
+		bool has_period = false;
+
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
-			if (args[argidx] == "-TODO") {
+			if (args[argidx] == "-n" && argidx+1 < args.size()) {
+				num_paths = std::max(1, atoi(args[++argidx].c_str()));
+				continue;
+			}
+			if (args[argidx] == "-period" && argidx+1 < args.size()) {
+				period = atoi(args[++argidx].c_str());
+				has_period = true;
 				continue;
 			}
 			break;
 		}
-		*/
+		extra_args(args, argidx, design);
 
-		extra_args(args, 1, design);
+		int maxarrival = 0, wns = INT_MAX;
+		long long tns = 0;
 
 		for (Module *module : design->selected_modules())
 		{
 			if (module->has_processes_warn())
 				continue;
 
-			StaWorker worker(module);
+			StaWorker worker(module, num_paths, has_period, period);
 			worker.run();
+
+			maxarrival = std::max(maxarrival, worker.maxarrival);
+			wns = std::min(wns, worker.wns);
+			tns += worker.tns;
+		}
+
+		design->scratchpad_set_int("sta.max_arrival", maxarrival);
+		if (has_period && wns != INT_MAX) {
+			design->scratchpad_set_int("sta.wns", wns);
+			design->scratchpad_set_int("sta.tns", tns);
 		}
 	}
 } StaPass;
@@ -23,7 +23,10 @@
 #include "kernel/celltypes.h"
 #include "passes/techmap/libparse.h"
 #include "kernel/cost.h"
+#include "kernel/fingerprint.h"
+#include "kernel/threading.h"
 #include "libs/json11/json11.hpp"
+#include "libs/sha1/sha1.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -295,11 +298,13 @@ void log_data(RTLIL::IdString mod_name, bool top_mod)
 		}
 	}
 
-	void log_data_json(const char *mod_name, bool first_module)
+	void log_data_json(const char *mod_name, bool first_module, const std::string &hash = std::string())
 	{
 		if (!first_module)
 			log(",\n");
 		log("      %s: {\n", json11::Json(mod_name).dump().c_str());
+		if (!hash.empty())
+			log("         \"hash\":              \"%s\",\n", hash.c_str());
 		log("         \"num_wires\":         %u,\n", num_wires);
 		log("         \"num_wire_bits\":     %u,\n", num_wire_bits);
 		log("         \"num_pub_wires\":     %u,\n", num_pub_wires);
@@ -360,26 +365,91 @@ statdata_t hierarchy_worker(std::map<RTLIL::IdString, statdata_t> &mod_stat, RTL
 	return mod_data;
 }
 
-void read_liberty_cellarea(dict<IdString, cell_area_t> &cell_area, string liberty_file)
+// area tables of the liberty files read so far, by SHA1 of the file content
+static dict<std::string, dict<IdString, cell_area_t>> liberty_area_cache;
+
+// returns the SHA1 of the file, which identifies the area table
+std::string read_liberty_cellarea(dict<IdString, cell_area_t> &cell_area, string liberty_file)
 {
 	std::ifstream f;
 	f.open(liberty_file.c_str());
 	yosys_input_files.insert(liberty_file);
 	if (f.fail())
 		log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-	LibertyParser libparser(f);
+	std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
 	f.close();
 
-	for (auto cell : libparser.ast->children)
+	std::string key = sha1(content);
+	auto it = liberty_area_cache.find(key);
+	if (it == liberty_area_cache.end())
 	{
-		if (cell->id != "cell" || cell->args.size() != 1)
-			continue;
+		dict<IdString, cell_area_t> areas;
+		std::istringstream in(content);
+		LibertyAst *liberty_ast = LibertyCache::parse(in);
+
+		for (auto cell : liberty_ast->children)
+		{
+			if (cell->id != "cell" || cell->args.size() != 1)
+				continue;
 
-		LibertyAst *ar = cell->find("area");
-		bool is_flip_flop = cell->find("ff") != nullptr;
-		if (ar != nullptr && !ar->value.empty())
-			cell_area["\\" + cell->args[0]] = {/*area=*/atof(ar->value.c_str()), is_flip_flop};
+			LibertyAst *ar = cell->find("area");
+			bool is_flip_flop = cell->find("ff") != nullptr;
+			if (ar != nullptr && !ar->value.empty())
+				areas["\\" + cell->args[0]] = {/*area=*/atof(ar->value.c_str()), is_flip_flop};
+		}
+
+		it = liberty_area_cache.emplace(key, std::move(areas)).first;
 	}
+	else
+		log("Using cached cell areas of liberty file `%s'.\n", liberty_file.c_str());
+
+	for (auto &area : it->second)
+		cell_area[area.first] = area.second;
+	return key;
+}
+
+// Everything statdata_t counts for a whole module, folded into one hash.
+// Cell types and wire flags can be changed in place without bumping the
+// module generation, so the generation alone is not enough to reuse a result.
+unsigned int stat_fingerprint(RTLIL::Module *mod)
+{
+	unsigned int h = mkhash_init;
+	for (auto wire : mod->wires()) {
+		h = mkhash(h, wire->name.index_);
+		h = mkhash(h, wire->width);
+		h = mkhash(h, (wire->port_input ? 1 : 0) | (wire->port_output ? 2 : 0));
+	}
+	for (auto &it : mod->memories)
+		h = mkhash(h, mkhash(it.second->width, it.second->size));
+	for (auto cell : mod->cells())
+		h = mkhash(h, cell->type.index_);
+	h = mkhash(h, GetSize(mod->processes));
+	return h;
+}
+
+struct stat_cache_entry_t
+{
+	unsigned int generation, fingerprint;
+	std::string options;
+	statdata_t data;
+};
+
+// per-module results of previous runs, by RTLIL::Module::hashidx_
+static dict<unsigned int, stat_cache_entry_t> stat_cache;
+
+nlohmann::json stat_data_json(const statdata_t &data)
+{
+	nlohmann::json obj;
+#define X(_name) obj[#_name] = data._name;
+	STAT_INT_MEMBERS
+#undef X
+	obj["area"] = data.area;
+	obj["sequential_area"] = data.sequential_area;
+	obj["num_cells_by_type"] = nlohmann::json::object();
+	for (auto &it : data.num_cells_by_type)
+		if (it.second)
+			obj["num_cells_by_type"][log_id(it.first)] = it.second;
+	return obj;
 }
 
 struct StatPass : public Pass {
@@ -413,14 +483,59 @@ struct StatPass : public Pass {
 		log("        output the statistics in a machine-readable JSON format.\n");
 		log("        this is output to the console; use \"tee\" to output to a file.\n");
 		log("\n");
+		log("    -hash\n");
+		log("        also print a content hash of each module. the hash only depends on\n");
+		log("        the module contents (not its name or the order of its objects) and\n");
+		log("        is the same in every run, so it can be used as a cache key. see\n");
+		log("        kernel/fingerprint.h for the API.\n");
+		log("\n");
+		log("    -kernel\n");
+		log("        instead of design statistics, print how often each command so far hit\n");
+		log("        the counted kernel primitives (IdString creation and removal, SigSpec\n");
+		log("        pack/unpack, SigMap builds, fixup_ports, selected_modules). needs a\n");
+		log("        build with YOSYS_KERNEL_COUNTERS.\n");
+		log("\n");
+		log("The statistics of fully selected modules are kept between calls and reused\n");
+		log("for modules that did not change, the others are computed in parallel when\n");
+		log("synthesizer runs with -j <jobs>. Cell areas are cached per liberty file\n");
+		log("content. The results are also sent as STAT data to the DATA pipe.\n");
+		log("\n");
+	}
+	void print_kernel_counters(RTLIL::Design *design)
+	{
+		log_header(design, "Printing kernel counters.\n");
+#ifdef YOSYS_KERNEL_COUNTERS
+		using namespace kernel_counters;
+		snapshot_t totals = snapshot();
+
+		log("\n");
+		for (int i = 0; i < NUM_COUNTERS; i++)
+			log("   %-20s %12lld\n", names[i], (long long)totals[i]);
+
+		log("\n  %-24s", "command");
+		for (int i = 0; i < NUM_COUNTERS; i++)
+			log(" %16s", names[i]);
+		log("\n");
+		for (auto &it : pass_register) {
+			Pass *pass = it.second;
+			if (pass->call_counter == 0 || std::all_of(pass->kernel_counts.begin(), pass->kernel_counts.end(), [](int64_t c) { return c == 0; }))
+				continue;
+			log("  %-24s", it.first.c_str());
+			for (int i = 0; i < NUM_COUNTERS; i++)
+				log(" %16lld", (long long)pass->kernel_counts[i]);
+			log("\n");
+		}
+#else
+		log("\nKernel counters are not available, this version of yosys is not built with YOSYS_KERNEL_COUNTERS.\n");
+#endif
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
-		bool width_mode = false, json_mode = false;
+		bool width_mode = false, json_mode = false, kernel_mode = false, hash_mode = false;
 		RTLIL::Module *top_mod = nullptr;
 		std::map<RTLIL::IdString, statdata_t> mod_stat;
 		dict<IdString, cell_area_t> cell_area;
-		string techname;
+		string techname, liberty_keys;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
@@ -432,7 +547,7 @@ struct StatPass : public Pass {
 			if (args[argidx] == "-liberty" && argidx+1 < args.size()) {
 				string liberty_file = args[++argidx];
 				rewrite_filename(liberty_file);
-				read_liberty_cellarea(cell_area, liberty_file);
+				liberty_keys += read_liberty_cellarea(cell_area, liberty_file) + ",";
 				continue;
 			}
 			if (args[argidx] == "-tech" && argidx+1 < args.size()) {
@@ -449,10 +564,23 @@ struct StatPass : public Pass {
 				json_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-kernel") {
+				kernel_mode = true;
+				continue;
+			}
+			if (args[argidx] == "-hash") {
+				hash_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (kernel_mode) {
+			print_kernel_counters(design);
+			return;
+		}
+
 		if(!json_mode)
 			log_header(design, "Printing statistics.\n");
 
@@ -468,23 +596,83 @@ struct StatPass : public Pass {
 			log("   \"modules\": {\n");
 		}
 
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		std::vector<statdata_t> results(GetSize(modules));
+		std::vector<unsigned int> fingerprints(GetSize(modules));
+		std::string options = stringf("%d|%s|%s", width_mode, techname.c_str(), liberty_keys.c_str());
+		dict<RTLIL::Module*, int> module_index;
+		int reused = 0;
+
+		std::vector<RTLIL::Module*> todo;
+		for (int i = 0; i < GetSize(modules); i++) {
+			RTLIL::Module *mod = modules[i];
+			module_index[mod] = i;
+			if (!design->selected_whole_module(mod->name)) {
+				todo.push_back(mod);
+				continue;
+			}
+			auto it = stat_cache.find(mod->hashidx_);
+			if (it != stat_cache.end() && it->second.generation == mod->generation_ && it->second.options == options) {
+				fingerprints[i] = stat_fingerprint(mod);
+				if (fingerprints[i] == it->second.fingerprint) {
+					results[i] = it->second.data;
+					reused++;
+					continue;
+				}
+			}
+			todo.push_back(mod);
+		}
+
+		parallel_for_modules(design, todo, [&](RTLIL::Module *mod) {
+			int i = module_index.at(mod);
+			results[i] = statdata_t(design, mod, width_mode, cell_area, techname);
+			if (design->selected_whole_module(mod->name))
+				fingerprints[i] = stat_fingerprint(mod);
+		});
+
+		dict<unsigned int, stat_cache_entry_t> new_stat_cache;
+		for (int i = 0; i < GetSize(modules); i++) {
+			RTLIL::Module *mod = modules[i];
+			if (design->selected_whole_module(mod->name))
+				new_stat_cache[mod->hashidx_] = {mod->generation_, fingerprints[i], options, results[i]};
+		}
+		stat_cache.swap(new_stat_cache);
+
+		if (reused > 0 && !json_mode)
+			log("Reusing statistics of %d unchanged modules.\n", reused);
+
+		std::vector<std::string> hashes(GetSize(modules));
+		if (hash_mode)
+			parallel_for(GetSize(modules), [&](int i) {
+				hashes[i] = module_fingerprint_str(modules[i]);
+			});
+
+		nlohmann::json pipe_data;
+		pipe_data["modules"] = nlohmann::json::object();
+
 		bool first_module = true;
-		for (auto mod : design->selected_modules())
+		for (int i = 0; i < GetSize(modules); i++)
 		{
+			RTLIL::Module *mod = modules[i];
 			if (!top_mod && design->full_selection())
 				if (mod->get_bool_attribute(ID::top))
 					top_mod = mod;
 
-			statdata_t data(design, mod, width_mode, cell_area, techname);
+			statdata_t &data = results[i];
 			mod_stat[mod->name] = data;
+			pipe_data["modules"][log_id(mod->name)] = stat_data_json(data);
+			if (hash_mode)
+				pipe_data["modules"][log_id(mod->name)]["hash"] = hashes[i];
 
 			if (json_mode) {
-				data.log_data_json(mod->name.c_str(), first_module);
+				data.log_data_json(mod->name.c_str(), first_module, hashes[i]);
 				first_module = false;
 			} else {
 				log("\n");
 				log("=== %s%s ===\n", log_id(mod->name), design->selected_whole_module(mod->name) ? "" : " (partially selected)");
 				log("\n");
+				if (hash_mode)
+					log("   Content hash:         %s\n\n", hashes[i].c_str());
 				data.log_data(mod->name, false);
 			}
 		}
@@ -505,6 +693,9 @@ struct StatPass : public Pass {
 
 			statdata_t data = hierarchy_worker(mod_stat, top_mod->name, 0, /*quiet=*/json_mode);
 
+			pipe_data["top"] = log_id(top_mod->name);
+			pipe_data["design"] = stat_data_json(data);
+
 			if (json_mode)
 				data.log_data_json("design", true);
 			else if (GetSize(mod_stat) > 1) {
@@ -530,6 +721,8 @@ struct StatPass : public Pass {
 			log("}\n");
 		}
 
+		Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, pipe_data, "STAT"));
+
 		log("\n");
 	}
 } StatPass;
@@ -19,7 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
-#include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 #include "kernel/utils.h"
 
 USING_YOSYS_NAMESPACE
@@ -42,6 +42,9 @@ struct TorderPass : public Pass {
 		log("        by default Q outputs of internal FF cells and memory read port outputs\n");
 		log("        are not used in topological sorting. this option deactivates that.\n");
 		log("\n");
+		log("The cells of each loop are listed first, then all cells in topological order,\n");
+		log("with the loops cut at their first cell in name order.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -70,52 +73,53 @@ struct TorderPass : public Pass {
 		{
 			log("module %s\n", log_id(module));
 
-			SigMap sigmap(module);
-			dict<SigBit, pool<IdString>> bit_drivers, bit_users;
-			TopoSort<IdString, RTLIL::sort_by_id_str> toposort;
+			auto use_port = [&](Cell *cell, IdString port) {
+				if (stop_db.count(cell->type) && stop_db.at(cell->type).count(port))
+					return false;
+				if (!noautostop && yosys_celltypes.cell_known(cell->type)) {
+					if (port.in(ID::Q, ID::CTRL_OUT, ID::RD_DATA))
+						return false;
+					if (cell->type.in(ID($memrd), ID($memrd_v2)) && port == ID::DATA)
+						return false;
+				}
+				return true;
+			};
 
+			// cells are numbered in name order, which makes the order of the output
+			std::vector<Cell*> cells;
 			for (auto cell : module->selected_cells())
-			for (auto conn : cell->connections())
-			{
-				if (stop_db.count(cell->type) && stop_db.at(cell->type).count(conn.first))
-					continue;
-
-				if (!noautostop && yosys_celltypes.cell_known(cell->type)) {
-					if (conn.first.in(ID::Q, ID::CTRL_OUT, ID::RD_DATA))
-						continue;
-					if (cell->type.in(ID($memrd), ID($memrd_v2)) && conn.first == ID::DATA)
+				for (auto &conn : cell->connections())
+					if (use_port(cell, conn.first)) {
+						cells.push_back(cell);
+						break;
+					}
+			std::sort(cells.begin(), cells.end(), [](Cell *a, Cell *b) { return RTLIL::sort_by_id_str()(a->name, b->name); });
+
+			CellGraph cell_graph(module, cells, use_port);
+			const CsrGraph &graph = cell_graph.graph;
+
+			std::vector<std::vector<int>> sccs;
+			find_sccs(graph, sccs, /*include_trivial=*/true);
+			std::reverse(sccs.begin(), sccs.end());
+
+			for (auto &scc : sccs) {
+				if (GetSize(scc) == 1) {
+					int node = scc.front();
+					if (std::find(graph.targets.begin() + graph.first[node], graph.targets.begin() + graph.first[node + 1], node) ==
+							graph.targets.begin() + graph.first[node + 1])
 						continue;
 				}
-
-				if (cell->input(conn.first))
-					for (auto bit : sigmap(conn.second))
-						bit_users[bit].insert(cell->name);
-
-				if (cell->output(conn.first))
-					for (auto bit : sigmap(conn.second))
-						bit_drivers[bit].insert(cell->name);
-
-				toposort.node(cell->name);
-			}
-
-			for (auto &it : bit_users)
-				if (bit_drivers.count(it.first))
-					for (auto driver_cell : bit_drivers.at(it.first))
-					for (auto user_cell : it.second)
-						toposort.edge(driver_cell, user_cell);
-
-			toposort.analyze_loops = true;
-			toposort.sort();
-
-			for (auto &it : toposort.loops) {
+				std::sort(scc.begin(), scc.end());
 				log("  loop");
-				for (auto cell : it)
-					log(" %s", log_id(cell));
+				for (int node : scc)
+					log(" %s", log_id(cells[node]));
 				log("\n");
 			}
 
-			for (auto cell : toposort.sorted)
-					log("  cell %s\n", log_id(cell));
+			std::vector<int> order;
+			topological_order(graph, order);
+			for (int node : order)
+				log("  cell %s\n", log_id(cells[node]));
 		}
 	}
 } TorderPass;
@@ -48,6 +48,7 @@ struct VizConfig {
 	};
 
 	int effort = 9;
+	int max_nodes = 0;
 	int similar_thresh = 30;
 	int small_group_thresh = 10;
 	int large_group_count = 10;
@@ -686,15 +687,19 @@ struct VizWorker
 
 	VizWorker(Module *module, const VizConfig &cfg) : config(cfg), module(module), graph(module, config)
 	{
-		for (int effort = 0; effort <= config.effort; effort++) {
+		int max_effort = config.effort;
+		for (int effort = 0; effort <= max_effort; effort++) {
 			bool first = true;
 			while (1) {
 				if (!graph.phase(false, effort) && !first) break;
 				if (!graph.phase(true, effort)) break;
 				first = false;
 			}
+			// level of detail: keep merging with more aggressive strategies until the graph fits the budget
+			if (effort == max_effort && effort < 9 && config.max_nodes > 0 && GetSize(graph.nodes) > config.max_nodes)
+				max_effort++;
 			log("  %s: %d nodes (%d term and %d non-term), %d edges, and %d tags\n",
-					effort == config.effort ? "Final" : "Status", GetSize(graph.nodes),
+					effort == max_effort ? "Final" : "Status", GetSize(graph.nodes),
 					GetSize(graph.term_nodes), GetSize(graph.nonterm_nodes),
 					graph.edge_count, graph.tag_count);
 		}
@@ -798,21 +803,63 @@ struct VizWorker
 			}
 		}
 
-		pool<std::string> edges;
+		pool<std::pair<int, int>> edges;
 		for (auto g : graph.nodes) {
 			auto p = bypass_nodes.at(g, g);
 			for (auto n : g->downstream()) {
 				auto q = bypass_nodes.at(n, n);
 				if (p == q) continue;
-				edges.insert(stringf("n%d -> n%d", p->index, q->index));
+				edges.insert({p->index, q->index});
 			}
 		}
 		edges.sort();
-		for (auto e : edges)
-			fprintf(f, "\t%s;\n", e.c_str());
+		for (auto &e : edges)
+			fprintf(f, "\tn%d -> n%d;\n", e.first, e.second);
 
 		fprintf(f, "}\n");
 	}
+
+	static std::string json_string(const std::string &str)
+	{
+		std::string res = "\"";
+		for (char c : str) {
+			if (c == '"' || c == '\\')
+				res += '\\';
+			if ((unsigned char)c < 0x20)
+				res += stringf("\\u%04x", c);
+			else
+				res += c;
+		}
+		return res + "\"";
+	}
+
+	void write_json(FILE *f, bool first)
+	{
+		fprintf(f, "%s\n    {\n      \"name\": %s,\n      \"nodes\": [", first ? "" : ",", json_string(log_id(module)).c_str());
+
+		bool first_node = true;
+		for (auto g : graph.nodes) {
+			g->names().sort();
+			fprintf(f, "%s\n        { \"id\": %d, \"terminal\": %s, \"special\": %s, \"names\": [", first_node ? "" : ",",
+					g->index, g->terminal ? "true" : "false", g->special ? "true" : "false");
+			bool first_name = true;
+			for (auto name : g->names()) {
+				fprintf(f, "%s%s", first_name ? " " : ", ", json_string(log_id(name)).c_str());
+				first_name = false;
+			}
+			fprintf(f, " ] }");
+			first_node = false;
+		}
+
+		fprintf(f, "\n      ],\n      \"edges\": [");
+		bool first_edge = true;
+		for (auto g : graph.nodes)
+			for (auto n : g->downstream()) {
+				fprintf(f, "%s\n        [ %d, %d ]", first_edge ? "" : ",", g->index, n->index);
+				first_edge = false;
+			}
+		fprintf(f, "\n      ]\n    }");
+	}
 };
 
 struct VizPass : public Pass {
@@ -835,6 +882,8 @@ struct VizPass : public Pass {
 		log("        Generate a graphics file in the specified format. Use 'dot' to just\n");
 		log("        generate a .dot file, or other <format> strings such as 'svg' or 'ps'\n");
 		log("        to generate files in other formats (this calls the 'dot' command).\n");
+		log("        Use 'json' to write the merged graph of all selected modules to a\n");
+		log("        .json file instead.\n");
 		log("\n");
 		log("    -prefix <prefix>\n");
 		log("        generate <prefix>.* instead of ~/.yosys_viz.*\n");
@@ -846,6 +895,17 @@ struct VizPass : public Pass {
 		log("        don't run viewer in the background, IE wait for the viewer tool to\n");
 		log("        exit before returning\n");
 		log("\n");
+		log("    -async\n");
+		log("        run 'dot' and the viewer as one background job, so that the script\n");
+		log("        continues while the graph is rendered (POSIX systems only).\n");
+		log("\n");
+		log("    -max_nodes <n>\n");
+		log("        node budget per module. when the graph is larger after merging with the\n");
+		log("        selected effort level, the effort level is raised until the graph fits\n");
+		log("        or the highest level is reached. graphs still exceeding the budget\n");
+		log("        are handled as described below. (default: no budget, and a limit of\n");
+		log("        200 nodes for formats other than 'dot' and 'json')\n");
+		log("\n");
 		log("    -set-vg-attr\n");
 		log("        set their group index as 'vg' attribute on cells and wires\n");
 		log("\n");
@@ -879,6 +939,9 @@ struct VizPass : public Pass {
 		log("When no <format> is specified, 'dot' is used. When no <format> and <viewer> is\n");
 		log("specified, 'xdot' is used to display the schematic (POSIX systems only).\n");
 		log("\n");
+		log("Graphs larger than the node budget are left out of the output when no <format>\n");
+		log("is specified, and switch the format to 'dot' otherwise.\n");
+		log("\n");
 		log("The generated output files are '~/.yosys_viz.dot' and '~/.yosys_viz.<format>',\n");
 		log("unless another prefix is specified using -prefix <prefix>.\n");
 		log("\n");
@@ -902,6 +965,7 @@ struct VizPass : public Pass {
 		std::string viewer_exe;
 		bool flag_pause = false;
 		bool flag_attr = false;
+		bool flag_async = false;
 		bool custom_prefix = false;
 		std::string background = "&";
 
@@ -936,6 +1000,14 @@ struct VizPass : public Pass {
 				background= "";
 				continue;
 			}
+			if (arg == "-async") {
+				flag_async = true;
+				continue;
+			}
+			if (arg == "-max_nodes" && argidx+1 < args.size()) {
+				config.max_nodes = atoi(args[++argidx].c_str());
+				continue;
+			}
 			if ((arg == "-g" || arg == "-u" || arg == "-x" || arg == "-s" ||
 					arg == "-G" || arg == "-U" || arg == "-X" || arg == "-S") && argidx+1 < args.size()) {
 				int numargs = 1;
@@ -971,12 +1043,13 @@ struct VizPass : public Pass {
 				continue;
 			modlist.push_back(module);
 		}
-		if (format != "ps" && format != "dot" && GetSize(modlist) > 1)
+		if (format != "ps" && format != "dot" && format != "json" && GetSize(modlist) > 1)
 			log_cmd_error("For formats different than 'ps' or 'dot' only one module must be selected.\n");
 		if (modlist.empty())
 			log_cmd_error("Nothing there to show.\n");
 
-		std::string dot_file = stringf("%s.dot", prefix.c_str());
+		bool json_format = format == "json";
+		std::string dot_file = stringf("%s.%s", prefix.c_str(), json_format ? "json" : "dot");
 		std::string out_file = stringf("%s.%s", prefix.c_str(), format.empty() ? "svg" : format.c_str());
 
 		if (custom_prefix)
@@ -989,31 +1062,44 @@ struct VizPass : public Pass {
 			f = fopen(dot_file.c_str(), "w");
 			if (f == nullptr)
 				log_cmd_error("Can't open dot file `%s' for writing.\n", dot_file.c_str());
+			if (json_format)
+				fprintf(f, "{\n  \"modules\": [");
 		};
+		int budget = config.max_nodes > 0 ? config.max_nodes : 200;
+		bool first_module = true;
 		for (auto module : modlist) {
 			VizWorker worker(module, config);
 
 			if (flag_attr)
 				worker.update_attrs();
 
-			if (format != "dot" && GetSize(worker.graph.nodes) > 200) {
-				if (format.empty()) {
-					log_warning("Suppressing module in output as graph size exceeds 200 nodes.\n");
+			if (GetSize(worker.graph.nodes) > budget) {
+				if (format == "dot" || json_format) {
+					if (config.max_nodes > 0)
+						log_warning("Graph size of %d nodes exceeds the budget of %d nodes.\n", GetSize(worker.graph.nodes), budget);
+				} else if (format.empty()) {
+					log_warning("Suppressing module in output as graph size exceeds %d nodes.\n", budget);
 					continue;
 				} else {
-					log_warning("Changing format to 'dot' as graph size exceeds 200 nodes.\n");
+					log_warning("Changing format to 'dot' as graph size exceeds %d nodes.\n", budget);
 					format = "dot";
 				}
 			}
 
 			// delay opening of output file until we have something to write, to avoid race with xdot
 			open_dot_file();
-			worker.write_dot(f);
+			if (json_format)
+				worker.write_json(f, first_module);
+			else
+				worker.write_dot(f);
+			first_module = false;
 		}
 		open_dot_file();
+		if (json_format)
+			fprintf(f, "\n  ]\n}\n");
 		fclose(f);
 
-		if (format != "dot" && !format.empty()) {
+		if (format != "dot" && !json_format && !format.empty()) {
 			#ifdef _WIN32
 				// system()/cmd.exe does not understand single quotes on Windows.
 				#define DOT_CMD "dot -T%s \"%s\" > \"%s.new\" && move \"%s.new\" \"%s\""
@@ -1022,6 +1108,16 @@ struct VizPass : public Pass {
 			#endif
 			std::string cmd = stringf(DOT_CMD, format.c_str(), dot_file.c_str(), out_file.c_str(), out_file.c_str(), out_file.c_str());
 			#undef DOT_CMD
+			#ifndef _WIN32
+			if (flag_async) {
+				// the viewer has to wait for the rendered file, so it joins the background job
+				if (!viewer_exe.empty()) {
+					cmd = stringf("{ %s && %s '%s'; } &", cmd.c_str(), viewer_exe.c_str(), out_file.c_str());
+					viewer_exe.clear();
+				} else
+					cmd = stringf("{ %s; } &", cmd.c_str());
+			}
+			#endif
 			log("Exec: %s\n", cmd.c_str());
 			#if !defined(YOSYS_DISABLE_SPAWN)
 				if (run_command(cmd) != 0)
@@ -40,6 +40,7 @@ struct XpropOptions
 	bool required = false;
 	bool formal = false;
 	bool debug_asserts = false;
+	bool analyze = false;
 };
 
 struct XpropWorker
@@ -1098,6 +1099,460 @@ struct XpropWorker
 	}
 };
 
+// Analysis-only x propagation: computes which signals may carry x values as a
+// dataflow fixpoint over a packed 2-bit lattice, without adding encoding logic.
+struct XpropAnalysis
+{
+	// lattice values, ordered 0, 1 < DEF < X
+	enum : uint8_t { V0 = 0, V1 = 1, DEF = 2, VX = 3 };
+
+	static uint8_t join(uint8_t a, uint8_t b) { return a == b ? a : std::max<uint8_t>(std::max(a, b), DEF); }
+	static uint8_t inv(uint8_t a) { return a <= V1 ? a ^ 1 : a; }
+	static uint8_t and2(uint8_t a, uint8_t b) { return a == V0 || b == V0 ? V0 : a == VX || b == VX ? VX : a == V1 && b == V1 ? V1 : DEF; }
+	static uint8_t or2(uint8_t a, uint8_t b) { return inv(and2(inv(a), inv(b))); }
+	static uint8_t xor2(uint8_t a, uint8_t b) { return a == VX || b == VX ? VX : a <= V1 && b <= V1 ? a ^ b : DEF; }
+	static uint8_t mux2(uint8_t a, uint8_t b, uint8_t s) { return s == V0 ? a : s == V1 ? b : s == VX ? uint8_t(VX) : join(a, b); }
+
+	Module *module;
+	XpropOptions options;
+	SigMap sigmap;
+	FfInitVals initvals;
+
+	dict<SigBit, int> bit_index;
+	std::vector<uint64_t> values;
+	std::vector<uint64_t> assigned;
+	dict<int, std::vector<Cell*>> consumers;
+
+	pool<Cell *> pending_cells;
+	std::deque<Cell *> pending_cell_queue;
+	pool<Cell *> unhandled_cells;
+
+	int index(SigBit bit)
+	{
+		auto it = bit_index.find(bit);
+		if (it != bit_index.end())
+			return it->second;
+		int idx = GetSize(bit_index);
+		bit_index.emplace(bit, idx);
+		if (idx % 32 == 0)
+			values.push_back(0);
+		if (idx % 64 == 0)
+			assigned.push_back(0);
+		return idx;
+	}
+
+	bool is_assigned(int idx) const { return (assigned[idx / 64] >> (idx % 64)) & 1; }
+	uint8_t value(int idx) const { return (values[idx / 32] >> (2 * (idx % 32))) & 3; }
+
+	// returns false for bits that have no value yet
+	bool get(SigBit bit, uint8_t &v)
+	{
+		bit = sigmap(bit);
+		if (bit.wire == nullptr) {
+			v = bit.data == State::S0 ? V0 : bit.data == State::S1 ? V1 : bit.data == State::Sx || bit.data == State::Sz ? VX : DEF;
+			return true;
+		}
+		int idx = index(bit);
+		if (!is_assigned(idx))
+			return false;
+		v = value(idx);
+		return true;
+	}
+
+	void update(SigBit bit, uint8_t v)
+	{
+		bit = sigmap(bit);
+		if (bit.wire == nullptr)
+			return;
+		int idx = index(bit);
+		if (is_assigned(idx)) {
+			v = join(value(idx), v);
+			if (v == value(idx))
+				return;
+		}
+		assigned[idx / 64] |= uint64_t(1) << (idx % 64);
+		values[idx / 32] = (values[idx / 32] & ~(uint64_t(3) << (2 * (idx % 32)))) | (uint64_t(v) << (2 * (idx % 32)));
+
+		auto it = consumers.find(idx);
+		if (it == consumers.end())
+			return;
+		for (auto cell : it->second)
+			if (pending_cells.insert(cell).second)
+				pending_cell_queue.push_back(cell);
+	}
+
+	void update(const SigSpec &sig, uint8_t v)
+	{
+		for (auto bit : sig)
+			update(bit, v);
+	}
+
+	void update_outputs(Cell *cell, uint8_t v)
+	{
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first))
+				update(conn.second, v);
+	}
+
+	// joined value of all input bits of the cell, false if any of them has no value yet
+	bool inputs_joined(Cell *cell, uint8_t &v)
+	{
+		bool first = true;
+		for (auto &conn : cell->connections()) {
+			if (!cell->input(conn.first))
+				continue;
+			for (auto bit : conn.second) {
+				uint8_t b;
+				if (!get(bit, b))
+					return false;
+				v = first ? b : join(v, b);
+				first = false;
+			}
+		}
+		if (first)
+			v = DEF;
+		return true;
+	}
+
+	bool get_sig(const SigSpec &sig, std::vector<uint8_t> &vals)
+	{
+		vals.resize(GetSize(sig));
+		for (int i = 0; i < GetSize(sig); i++)
+			if (!get(sig[i], vals[i]))
+				return false;
+		return true;
+	}
+
+	static bool any_x(const std::vector<uint8_t> &vals)
+	{
+		for (auto v : vals)
+			if (v == VX)
+				return true;
+		return false;
+	}
+
+	// index of the selected word for an all-constant select signal, -1 otherwise
+	static int const_select(const std::vector<uint8_t> &vals)
+	{
+		int sel = 0;
+		for (int i = 0; i < GetSize(vals); i++) {
+			if (vals[i] > V1 || i >= 30)
+				return -1;
+			sel |= vals[i] << i;
+		}
+		return sel;
+	}
+
+	XpropAnalysis(Module *module, XpropOptions options) : module(module), options(options), sigmap(module)
+	{
+		initvals.set(&sigmap, module);
+
+		for (auto wire : module->wires())
+			for (auto bit : sigmap(wire))
+				if (bit.wire != nullptr)
+					index(bit);
+
+		pool<SigBit> driven;
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections()) {
+				if (cell->output(conn.first)) {
+					for (auto bit : sigmap(conn.second))
+						driven.insert(bit);
+				}
+				if (cell->input(conn.first)) {
+					for (auto bit : sigmap(conn.second)) {
+						if (bit.wire == nullptr)
+							continue;
+						auto &list = consumers[index(bit)];
+						if (list.empty() || list.back() != cell)
+							list.push_back(cell);
+					}
+				}
+			}
+
+		// undriven signals and inputs are the x sources, flip-flops start at their initial value
+		for (auto wire : module->wires())
+			for (auto bit : sigmap(wire))
+				if (bit.wire != nullptr && !driven.count(bit))
+					update(bit, wire->port_input && options.assume_def_inputs ? DEF : VX);
+
+		for (auto cell : module->cells()) {
+			if (RTLIL::builtin_ff_cell_types().count(cell->type) || cell->type == ID($anyinit)) {
+				FfData ff(&initvals, cell);
+				for (int i = 0; i < ff.width; i++) {
+					uint8_t v;
+					get(ff.val_init[i], v);
+					update(ff.sig_q[i], cell->type == ID($anyinit) && v == VX ? uint8_t(DEF) : v);
+				}
+			}
+			pending_cells.insert(cell);
+			pending_cell_queue.push_back(cell);
+		}
+	}
+
+	void run()
+	{
+		while (!pending_cell_queue.empty()) {
+			Cell *cell = pending_cell_queue.front();
+			pending_cell_queue.pop_front();
+			pending_cells.erase(cell);
+			eval(cell);
+		}
+
+		// bits on combinational loops never got a value
+		bool loops = false;
+		for (auto &it : bit_index)
+			if (!is_assigned(it.second)) {
+				update(it.first, VX);
+				loops = true;
+			}
+		if (loops)
+			run();
+	}
+
+	void eval_ff(Cell *cell)
+	{
+		FfData ff(&initvals, cell);
+		std::vector<uint8_t> vals;
+
+		SigSpec ctrl;
+		if (ff.has_ce) ctrl.append(ff.sig_ce);
+		if (ff.has_srst) ctrl.append(ff.sig_srst);
+		if (ff.has_arst) ctrl.append(ff.sig_arst);
+		if (ff.has_aload) ctrl.append(ff.sig_aload);
+		if (ff.has_sr) ctrl.append(ff.sig_set), ctrl.append(ff.sig_clr);
+		for (auto bit : ctrl) {
+			uint8_t v;
+			if (get(bit, v) && v == VX) {
+				update(ff.sig_q, VX);
+				return;
+			}
+		}
+
+		for (int i = 0; i < ff.width; i++) {
+			uint8_t v;
+			if ((ff.has_clk || ff.has_gclk) && get(ff.sig_d[i], v))
+				update(ff.sig_q[i], v);
+			if (ff.has_aload && get(ff.sig_ad[i], v))
+				update(ff.sig_q[i], v);
+			if (ff.has_srst && get(ff.val_srst[i], v))
+				update(ff.sig_q[i], v);
+			if (ff.has_arst && get(ff.val_arst[i], v))
+				update(ff.sig_q[i], v);
+			if (ff.has_sr)
+				update(ff.sig_q[i], DEF);
+		}
+	}
+
+	void eval(Cell *cell)
+	{
+		if (RTLIL::builtin_ff_cell_types().count(cell->type) || cell->type == ID($anyinit)) {
+			eval_ff(cell);
+			return;
+		}
+
+		if (cell->type.in(ID($bweqx), ID($eqx), ID($nex), ID($initstate), ID($anyseq), ID($anyconst), ID($allseq), ID($allconst),
+				ID($assert), ID($assume), ID($cover), ID($live), ID($fair))) {
+			update_outputs(cell, DEF);
+			return;
+		}
+
+		std::vector<uint8_t> a, b, s;
+
+		if (cell->type.in(ID($not), ID($pos), ID($_NOT_), ID($_BUF_))) {
+			auto &sig_y = cell->getPort(ID::Y);
+			auto sig_a = cell->getPort(ID::A);
+			if (cell->hasParam(ID::A_SIGNED))
+				sig_a.extend_u0(GetSize(sig_y), cell->getParam(ID::A_SIGNED).as_bool());
+			if (!get_sig(sig_a, a))
+				return;
+			bool invert = cell->type.in(ID($not), ID($_NOT_));
+			for (int i = 0; i < GetSize(sig_y); i++)
+				update(sig_y[i], invert ? inv(a[i]) : a[i]);
+			return;
+		}
+
+		if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_),
+				ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_))) {
+			auto &sig_y = cell->getPort(ID::Y);
+			auto sig_a = cell->getPort(ID::A);
+			auto sig_b = cell->getPort(ID::B);
+			if (cell->hasParam(ID::A_SIGNED)) {
+				sig_a.extend_u0(GetSize(sig_y), cell->getParam(ID::A_SIGNED).as_bool());
+				sig_b.extend_u0(GetSize(sig_y), cell->getParam(ID::B_SIGNED).as_bool());
+			}
+			if (!get_sig(sig_a, a) || !get_sig(sig_b, b))
+				return;
+			for (int i = 0; i < GetSize(sig_y); i++) {
+				uint8_t y;
+				if (cell->type.in(ID($and), ID($_AND_), ID($_NAND_)))
+					y = and2(a[i], b[i]);
+				else if (cell->type == ID($_ANDNOT_))
+					y = and2(a[i], inv(b[i]));
+				else if (cell->type.in(ID($or), ID($_OR_), ID($_NOR_)))
+					y = or2(a[i], b[i]);
+				else if (cell->type == ID($_ORNOT_))
+					y = or2(a[i], inv(b[i]));
+				else
+					y = xor2(a[i], b[i]);
+				if (cell->type.in(ID($xnor), ID($_NAND_), ID($_NOR_), ID($_XNOR_)))
+					y = inv(y);
+				update(sig_y[i], y);
+			}
+			return;
+		}
+
+		if (cell->type.in(ID($mux), ID($_MUX_), ID($_NMUX_), ID($bwmux))) {
+			auto &sig_y = cell->getPort(ID::Y);
+			if (!get_sig(cell->getPort(ID::A), a) || !get_sig(cell->getPort(ID::B), b) || !get_sig(cell->getPort(ID::S), s))
+				return;
+			bool bitwise = cell->type == ID($bwmux);
+			for (int i = 0; i < GetSize(sig_y); i++) {
+				uint8_t y = mux2(a[i], b[i], s[bitwise ? i : 0]);
+				update(sig_y[i], cell->type == ID($_NMUX_) ? inv(y) : y);
+			}
+			return;
+		}
+
+		if (cell->type.in(ID($pmux), ID($bmux))) {
+			auto &sig_y = cell->getPort(ID::Y);
+			int width = GetSize(sig_y);
+			if (!get_sig(cell->getPort(ID::A), a) || !get_sig(cell->getPort(ID::S), s))
+				return;
+			if (cell->type == ID($pmux) && !get_sig(cell->getPort(ID::B), b))
+				return;
+			if (any_x(s)) {
+				update(sig_y, VX);
+				return;
+			}
+			std::vector<uint8_t> &data = cell->type == ID($pmux) ? b : a;
+			int sel = -1;
+			if (cell->type == ID($bmux)) {
+				sel = const_select(s);
+			} else {
+				// $pmux with more than one active select bit is undefined, so only
+				// a known one-hot or all-zero select is propagated precisely
+				std::vector<uint8_t> y(a);
+				int active = 0;
+				for (int j = 0; j < GetSize(s); j++) {
+					if (s[j] == V0)
+						continue;
+					if (s[j] != V1 || active++) {
+						update(sig_y, VX);
+						return;
+					}
+					std::copy(b.begin() + j*width, b.begin() + (j+1)*width, y.begin());
+				}
+				for (int i = 0; i < width; i++)
+					update(sig_y[i], y[i]);
+				return;
+			}
+			for (int i = 0; i < width; i++) {
+				uint8_t y = VX;
+				if (sel >= 0)
+					y = data[sel*width + i];
+				else
+					for (int j = i; j < GetSize(data); j += width)
+						y = j == i ? data[j] : join(y, data[j]);
+				update(sig_y[i], y);
+			}
+			return;
+		}
+
+		if (cell->type == ID($demux)) {
+			auto &sig_y = cell->getPort(ID::Y);
+			if (!get_sig(cell->getPort(ID::A), a) || !get_sig(cell->getPort(ID::S), s))
+				return;
+			if (any_x(s)) {
+				update(sig_y, VX);
+				return;
+			}
+			int width = GetSize(a), sel = const_select(s);
+			for (int j = 0; j*width < GetSize(sig_y); j++)
+				for (int i = 0; i < width; i++)
+					update(sig_y[j*width + i], sel < 0 ? join(a[i], V0) : sel == j ? a[i] : uint8_t(V0));
+			return;
+		}
+
+		if (cell->type == ID($shiftx)) {
+			auto &sig_y = cell->getPort(ID::Y);
+			auto &sig_a = cell->getPort(ID::A);
+			auto &sig_b = cell->getPort(ID::B);
+			if (!get_sig(sig_a, a) || !get_sig(sig_b, b))
+				return;
+			if (any_x(a) || any_x(b) || cell->getParam(ID::B_SIGNED).as_bool() || GetSize(sig_b) >= 30) {
+				update(sig_y, VX);
+				return;
+			}
+			int max_shift = (1 << GetSize(sig_b)) - 1;
+			for (int i = 0; i < GetSize(sig_y); i++)
+				update(sig_y[i], i + max_shift >= GetSize(sig_a) ? VX : DEF);
+			return;
+		}
+
+		if (cell->type.in(ID($div), ID($mod), ID($divfloor), ID($modfloor))) {
+			update_outputs(cell, VX);
+			return;
+		}
+
+		if (cell->type.in(
+			ID($le), ID($lt), ID($ge), ID($gt),
+			ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor),
+			ID($reduce_bool), ID($logic_not), ID($logic_or), ID($logic_and),
+			ID($eq), ID($ne)
+		)) {
+			auto &sig_y = cell->getPort(ID::Y);
+			uint8_t v;
+			if (!inputs_joined(cell, v))
+				return;
+			update(sig_y[0], v == VX ? VX : DEF);
+			update(sig_y.extract(1, GetSize(sig_y) - 1), V0);
+			return;
+		}
+
+		uint8_t v;
+		if (!inputs_joined(cell, v))
+			return;
+
+		if (cell->type.in(ID($add), ID($sub), ID($mul), ID($neg), ID($shl), ID($shr), ID($sshl), ID($sshr), ID($shift))) {
+			update_outputs(cell, v == VX ? VX : DEF);
+			return;
+		}
+
+		if (unhandled_cells.insert(cell).second)
+			log_warning("Unhandled cell %s (%s) during x-propagation analysis\n", log_id(cell), log_id(cell->type));
+		update_outputs(cell, VX);
+	}
+
+	int report()
+	{
+		int maybe_x_count = 0, const_count = 0, total_count = 0;
+
+		for (auto wire : module->selected_wires()) {
+			if (!wire->name.isPublic())
+				continue;
+			int wire_x_count = 0;
+			for (auto bit : SigSpec(wire)) {
+				uint8_t v = VX;
+				get(bit, v);
+				total_count++;
+				if (v == VX)
+					wire_x_count++;
+				else if (v != DEF)
+					const_count++;
+			}
+			maybe_x_count += wire_x_count;
+			if (wire_x_count > 0 && wire->port_output)
+				log("  Output port %s: %d of %d bits may be x.\n", log_id(wire), wire_x_count, GetSize(wire));
+			else if (wire_x_count > 0)
+				log_debug("  Wire %s: %d of %d bits may be x.\n", log_id(wire), wire_x_count, GetSize(wire));
+		}
+
+		log("  %d of %d public signal bits may carry x values, %d are constant.\n", maybe_x_count, total_count, const_count);
+		return maybe_x_count;
+	}
+};
+
 struct XpropPass : public Pass {
 	XpropPass() : Pass("xprop", "formal x propagation") {}
 	void help() override
@@ -1151,6 +1606,15 @@ struct XpropPass : public Pass {
 		log("        Add assertions checking that the encoding used by this pass never\n");
 		log("        produces x values within the encoded signals.\n");
 		log("\n");
+		log("    -analyze\n");
+		log("        Do not transform the design. Instead compute which signals may carry\n");
+		log("        x values, tracking bits known to be constant 0 or 1 so that masked x\n");
+		log("        values (e.g. an AND gate with a constant 0 input) do not propagate.\n");
+		log("        Output ports that may be x are reported, and the total number of\n");
+		log("        public signal bits that may be x is stored in the scratchpad\n");
+		log("        variable 'xprop.maybe_x_bits'. Only -assume-def-inputs can be\n");
+		log("        combined with this option.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -1198,6 +1662,10 @@ struct XpropPass : public Pass {
 				options.required = true;
 				continue;
 			}
+			if (args[argidx] == "-analyze") {
+				options.analyze = true;
+				continue;
+			}
 			if (args[argidx] == "-debug-asserts") { // TODO documented
 				options.debug_asserts = true;
 				options.assert_encoding = true;
@@ -1211,6 +1679,18 @@ struct XpropPass : public Pass {
 
 		extra_args(args, argidx, design);
 
+		if (options.analyze) {
+			int maybe_x_count = 0;
+			for (auto module : design->selected_modules()) {
+				log("Analyzing x propagation in module %s.\n", log_id(module));
+				XpropAnalysis analysis(module, options);
+				analysis.run();
+				maybe_x_count += analysis.report();
+			}
+			design->scratchpad_set_int("xprop.maybe_x_bits", maybe_x_count);
+			return;
+		}
+
 		log_push();
 		Pass::call(design, "bmuxmap");
 		Pass::call(design, "demuxmap");
@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -196,12 +197,19 @@ struct EquivInductPass : public Pass {
 		log("you confidence that the circuits start out synced for at least <N> cycles\n");
 		log("after reset.\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        prove the $equiv cells of up to <num> modules at the same time, each\n");
+		log("        with its own SAT solver. the log output is written in the same order\n");
+		log("        as without this option. the default is the -j value synthesizer runs\n");
+		log("        with.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, Design *design) override
 	{
 		int success_counter = 0;
 		bool model_undef = false;
 		int max_seq = 4;
+		int jobs = yosys_parallel_jobs;
 
 		log_header(design, "Executing EQUIV_INDUCT pass.\n");
 
@@ -215,11 +223,22 @@ struct EquivInductPass : public Pass {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid -j argument: %s\n", args[argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
-		for (auto module : design->selected_modules())
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		dict<RTLIL::Module*, int> module_success;
+		for (auto module : modules)
+			module_success[module] = 0;
+
+		parallel_for_modules(design, modules, [&](RTLIL::Module *module)
 		{
 			pool<Cell*> unproven_equiv_cells;
 
@@ -231,13 +250,16 @@ struct EquivInductPass : public Pass {
 
 			if (unproven_equiv_cells.empty()) {
 				log("No selected unproven $equiv cells found in %s.\n", log_id(module));
-				continue;
+				return;
 			}
 
 			EquivInductWorker worker(module, unproven_equiv_cells, model_undef, max_seq);
 			worker.run();
-			success_counter += worker.success_counter;
-		}
+			module_success.at(module) = worker.success_counter;
+		}, jobs);
+
+		for (auto &it : module_success)
+			success_counter += it.second;
 
 		log("Proved %d previously unproven $equiv cells.\n", success_counter);
 	}
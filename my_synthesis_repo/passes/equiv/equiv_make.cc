@@ -99,38 +99,35 @@ struct EquivMakeWorker
 		}
 	}
 
-	void copy_to_equiv()
+	// Collects the names to match and appends the suffix to all wires and
+	// cells of the module.
+	void rename_objects(Module *mod, const std::string &suffix)
 	{
-		Module *gold_clone = gold_mod->clone();
-		Module *gate_clone = gate_mod->clone();
-
-		for (auto it : gold_clone->wires().to_vector()) {
+		wire_names.reserve(GetSize(wire_names) + GetSize(mod->wires_));
+		for (auto it : mod->wires().to_vector()) {
 			if ((it->name.isPublic() || inames) && blacklist_names.count(it->name) == 0)
 				wire_names.insert(it->name);
-			gold_clone->rename(it, it->name.str() + "_gold");
+			mod->rename(it, it->name.str() + suffix);
 		}
 
-		for (auto it : gold_clone->cells().to_vector()) {
+		cell_names.reserve(GetSize(cell_names) + GetSize(mod->cells_));
+		for (auto it : mod->cells().to_vector()) {
 			if ((it->name.isPublic() || inames) && blacklist_names.count(it->name) == 0)
 				cell_names.insert(it->name);
-			gold_clone->rename(it, it->name.str() + "_gold");
-		}
-
-		for (auto it : gate_clone->wires().to_vector()) {
-			if ((it->name.isPublic() || inames) && blacklist_names.count(it->name) == 0)
-				wire_names.insert(it->name);
-			gate_clone->rename(it, it->name.str() + "_gate");
+			mod->rename(it, it->name.str() + suffix);
 		}
+	}
 
-		for (auto it : gate_clone->cells().to_vector()) {
-			if ((it->name.isPublic() || inames) && blacklist_names.count(it->name) == 0)
-				cell_names.insert(it->name);
-			gate_clone->rename(it, it->name.str() + "_gate");
-		}
+	void copy_to_equiv()
+	{
+		// the gold side is renamed in place, only the gate side needs a
+		// separate copy to avoid name clashes
+		gold_mod->cloneInto(equiv_mod);
+		rename_objects(equiv_mod, "_gold");
 
-		gold_clone->cloneInto(equiv_mod);
+		Module *gate_clone = gate_mod->clone();
+		rename_objects(gate_clone, "_gate");
 		gate_clone->cloneInto(equiv_mod);
-		delete gold_clone;
 		delete gate_clone;
 	}
 
@@ -140,6 +137,15 @@ struct EquivMakeWorker
 		equiv_mod->addAssert(NEW_ID_SUFFIX("assert"), eq_wire, State::S1);
 	}
 
+	// one single-bit $equiv cell for each bit of the signals
+	void add_equiv_cells(const SigSpec &gold_sig, const SigSpec &gate_sig, const SigSpec &equiv_sig)
+	{
+		if (GetSize(gold_sig) == 0)
+			return;
+		equiv_mod->addCells(NEW_ID_PREFIX, ID($equiv), GetSize(gold_sig),
+				{{ID::A, gold_sig}, {ID::B, gate_sig}, {ID::Y, equiv_sig}});
+	}
+
 	void find_same_wires()
 	{
 		SigMap assign_map(equiv_mod);
@@ -253,8 +259,7 @@ struct EquivMakeWorker
 				}
 				else
 				{
-					for (int i = 0; i < wire->width; i++)
-						equiv_mod->addEquiv(NEW_ID, SigSpec(gold_wire, i), SigSpec(gate_wire, i), SigSpec(wire, i));
+					add_equiv_cells(gold_wire, gate_wire, wire);
 				}
 
 				rd_signal_map.add(assign_map(gold_wire), wire);
@@ -291,12 +296,13 @@ struct EquivMakeWorker
 							log("  Skipping signal bit %s [%d]: undriven on gate side.\n", id2cstr(gate_wire->name), i);
 							continue;
 						}
-						equiv_mod->addEquiv(NEW_ID, SigSpec(gold_wire, i), SigSpec(gate_wire, i), SigSpec(wire, i));
 						rdmap_gold.append(SigBit(gold_wire, i));
 						rdmap_gate.append(SigBit(gate_wire, i));
 						rdmap_equiv.append(SigBit(wire, i));
 					}
 
+					add_equiv_cells(rdmap_gold, rdmap_gate, rdmap_equiv);
+
 					rd_signal_map.add(rdmap_gold, rdmap_equiv);
 					rd_signal_map.add(rdmap_gate, rdmap_equiv);
 				}
@@ -363,12 +369,20 @@ struct EquivMakeWorker
 				}
 				else
 				{
+					SigSpec diff_gold, diff_gate;
+					std::vector<int> diff_idx;
 					for (int i = 0; i < GetSize(gold_sig); i++)
 						if (gold_sig[i] != gate_sig[i]) {
-							Wire *w = equiv_mod->addWire(NEW_ID);
-							equiv_mod->addEquiv(NEW_ID, gold_sig[i], gate_sig[i], w);
-							gold_sig[i] = w;
+							diff_gold.append(gold_sig[i]);
+							diff_gate.append(gate_sig[i]);
+							diff_idx.push_back(i);
 						}
+					if (!diff_idx.empty()) {
+						Wire *w = equiv_mod->addWire(NEW_ID, GetSize(diff_idx));
+						add_equiv_cells(diff_gold, diff_gate, w);
+						for (int i = 0; i < GetSize(diff_idx); i++)
+							gold_sig[diff_idx[i]] = SigBit(w, i);
+					}
 				}
 
 				gold_cell->setPort(gold_conn.first, gold_sig);
@@ -18,10 +18,30 @@
  */
 
 #include "kernel/register.h"
+#include "backends/rtlil/rtlil_backend.h"
+
+#if defined(YOSYS_ENABLE_THREADS) && !defined(YOSYS_DISABLE_SPAWN)
+#  define EQUIV_OPT_ASYNC
+#  include <thread>
+#  include <atomic>
+#endif
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+#ifdef EQUIV_OPT_ASYNC
+// An equivalence check started with -async. The thread only waits for the
+// child process, which proves the snapshot in tmpdir/snapshot.il.
+struct EquivOptAsyncCheck
+{
+	std::string command, tmpdir;
+	bool assert;
+	std::thread thread;
+	std::atomic<bool> done{false};
+	int retcode = 0;
+};
+#endif
+
 struct EquivOptPass:public ScriptPass
 {
 	EquivOptPass() : ScriptPass("equiv_opt", "prove equivalence for optimized circuit") { }
@@ -63,13 +83,119 @@ struct EquivOptPass:public ScriptPass
 		log("    -nocheck\n");
 		log("        disable running check before and after the command under test.\n");
 		log("\n");
+		log("    -async\n");
+		log("        do not wait for the equivalence check. the gold and gate modules are\n");
+		log("        written to a temporary snapshot, and the labels techmap and prove run\n");
+		log("        on it in a separate synthesizer process while the script continues.\n");
+		log("        the result is reported by the next equiv_opt call after the check has\n");
+		log("        finished, by 'equiv_opt -wait', or on exit, and is also sent as an\n");
+		log("        EQUIV_OPT packet on the DATA pipe. with -assert, a failed check is an\n");
+		log("        error at that time.\n");
+		log("\n");
+		log("    equiv_opt -wait\n");
+		log("\n");
+		log("Wait for all equivalence checks started with -async and report their results.\n");
+		log("\n");
 		log("The following commands are executed by this verification command:\n");
 		help_script();
 		log("\n");
 	}
 
 	std::string command, techmap_opts, make_opts;
-	bool assert, undef, multiclock, async2sync, nocheck;
+	bool assert, undef, multiclock, async2sync, nocheck, async;
+
+#ifdef EQUIV_OPT_ASYNC
+	std::vector<std::unique_ptr<EquivOptAsyncCheck>> async_checks;
+
+	// Reports the finished checks, or all of them with wait = true. A failed
+	// -assert check is an error, except at shutdown, where it is only warned
+	// about since the pass that started it is long done.
+	void collect_async_checks(bool wait, bool shutdown = false)
+	{
+		std::vector<std::unique_ptr<EquivOptAsyncCheck>> pending, failed;
+		for (auto &check : async_checks)
+		{
+			if (!wait && !check->done.load()) {
+				pending.push_back(std::move(check));
+				continue;
+			}
+			check->thread.join();
+
+			bool passed = check->retcode == 0;
+			log("Background equivalence check for `%s' %s.\n", check->command.c_str(), passed ? "passed" : "FAILED");
+			if (passed)
+				remove_directory(check->tmpdir);
+			else
+				log("  Snapshot and log kept in %s.\n", check->tmpdir.c_str());
+
+			nlohmann::json data;
+			data["command"] = check->command;
+			data["equivalent"] = passed;
+			if (!passed)
+				data["directory"] = check->tmpdir;
+			Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "EQUIV_OPT"));
+
+			if (!passed && check->assert)
+				failed.push_back(std::move(check));
+		}
+		async_checks.swap(pending);
+
+		if (shutdown) {
+			for (auto &check : failed)
+				log_warning("Background equivalence check for `%s' failed, see %s/check.log.\n",
+						check->command.c_str(), check->tmpdir.c_str());
+		} else if (!failed.empty())
+			log_error("Background equivalence check for `%s' failed, see %s/check.log.\n",
+					failed.front()->command.c_str(), failed.front()->tmpdir.c_str());
+	}
+
+	void start_async_check(RTLIL::Design *design)
+	{
+		auto check = std::unique_ptr<EquivOptAsyncCheck>(new EquivOptAsyncCheck);
+		check->command = command;
+		check->assert = assert;
+		check->tmpdir = make_temp_dir(get_base_tmpdir() + "/yosys-equiv-opt-XXXXXX");
+
+		{
+			std::ofstream f(check->tmpdir + "/snapshot.il");
+			RTLIL_BACKEND::dump_design(f, design, /*only_selected=*/false, /*flag_m=*/true, /*flag_n=*/false);
+		}
+
+		// the script of the techmap and prove labels, always failing on a difference
+		std::ofstream f(check->tmpdir + "/check.ys");
+		f << "read_rtlil " << check->tmpdir << "/snapshot.il\n";
+		if (!techmap_opts.empty())
+			f << "techmap -wb -D EQUIV -autoproc" << techmap_opts << "\n";
+		if (multiclock)
+			f << "clk2fflogic\n";
+		if (async2sync)
+			f << "async2sync\n";
+		f << "equiv_make" << make_opts << " gold gate equiv\n";
+		f << (undef ? "equiv_induct -undef equiv\n" : "equiv_induct equiv\n");
+		f << "equiv_status -assert equiv\n";
+		f.close();
+
+		std::vector<std::string> argv = {proc_self_dirname() + proc_program_prefix() + YOSYS_EXE_NAME,
+				"-q", "-l", check->tmpdir + "/check.log", "-s", check->tmpdir + "/check.ys"};
+		log("Started background equivalence check in %s.\n", check->tmpdir.c_str());
+
+		EquivOptAsyncCheck *c = check.get();
+		c->thread = std::thread([c, argv]() {
+			// the output is in check.log, discard what the child prints
+			c->retcode = run_command_argv(argv, [](const std::string&) {});
+			c->done.store(true);
+		});
+		async_checks.push_back(std::move(check));
+	}
+
+	void on_shutdown() override
+	{
+		if (!async_checks.empty()) {
+			log("Waiting for %d background equivalence checks.\n", GetSize(async_checks));
+			collect_async_checks(true, true);
+		}
+	}
+#endif
 
 	void clear_flags() override
 	{
@@ -81,6 +207,7 @@ struct EquivOptPass:public ScriptPass
 		multiclock = false;
 		async2sync = false;
 		nocheck = false;
+		async = false;
 	}
 
 	void execute(std::vector < std::string > args, RTLIL::Design * design) override
@@ -88,6 +215,18 @@ struct EquivOptPass:public ScriptPass
 		string run_from, run_to;
 		clear_flags();
 
+#ifdef EQUIV_OPT_ASYNC
+		if (args.size() == 2 && args[1] == "-wait") {
+			log_header(design, "Executing EQUIV_OPT pass (waiting for background checks).\n");
+			collect_async_checks(true);
+			return;
+		}
+		collect_async_checks(false);
+#else
+		if (args.size() == 2 && args[1] == "-wait")
+			return;
+#endif
+
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
 			if (args[argidx] == "-run" && argidx + 1 < args.size()) {
@@ -126,6 +265,10 @@ struct EquivOptPass:public ScriptPass
 				async2sync = true;
 				continue;
 			}
+			if (args[argidx] == "-async") {
+				async = true;
+				continue;
+			}
 			break;
 		}
 
@@ -148,6 +291,13 @@ struct EquivOptPass:public ScriptPass
 		if (async2sync && multiclock)
 			log_cmd_error("The '-async2sync' and '-multiclock' options are mutually exclusive!\n");
 
+#ifndef EQUIV_OPT_ASYNC
+		if (async) {
+			log_warning("equiv_opt -async needs a build with threads and process spawning, checking synchronously.\n");
+			async = false;
+		}
+#endif
+
 		log_header(design, "Executing EQUIV_OPT pass.\n");
 		log_push();
 
@@ -177,7 +327,16 @@ struct EquivOptPass:public ScriptPass
 			run("design -copy-from postopt -as gate A:top");
 		}
 
-		if ((!techmap_opts.empty() || help_mode) && check_label("techmap", "(only with -map)")) {
+		if ((async || help_mode) && check_label("async", "(only with -async)")) {
+			if (help_mode)
+				run("[write snapshot, run techmap and prove on it in the background]");
+#ifdef EQUIV_OPT_ASYNC
+			else
+				start_async_check(active_design);
+#endif
+		}
+
+		if ((!techmap_opts.empty() || help_mode) && !async && check_label("techmap", "(only with -map)")) {
 			string opts;
 			if (help_mode)
 				opts = " -map <filename> ...";
@@ -186,7 +345,7 @@ struct EquivOptPass:public ScriptPass
 			run("techmap -wb -D EQUIV -autoproc" + opts);
 		}
 
-		if (check_label("prove")) {
+		if (!async && check_label("prove")) {
 			if (multiclock || help_mode)
 				run("clk2fflogic", "(only with -multiclock)");
 			if (async2sync || help_mode)
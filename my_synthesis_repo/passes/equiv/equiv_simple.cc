@@ -19,6 +19,8 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/threading.h"
+#include <mutex>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -26,7 +28,6 @@ PRIVATE_NAMESPACE_BEGIN
 struct EquivSimpleWorker
 {
 	Module *module;
-	const vector<Cell*> &equiv_cells;
 	Cell *equiv_cell;
 
 	SigMap &sigmap;
@@ -38,11 +39,20 @@ struct EquivSimpleWorker
 	bool short_cones;
 	bool verbose;
 
+	// The cells imported so far, for all $equiv cells proved with this worker.
+	// Imported cells only add constraints that define their outputs, so they
+	// are shared by all proofs, only the miter and the input constraints of
+	// a $equiv cell are guarded by its context literal.
 	pool<pair<Cell*, int>> imported_cells_cache;
 
-	EquivSimpleWorker(const vector<Cell*> &equiv_cells, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, int max_seq, bool short_cones, bool verbose, bool model_undef) :
-			module(equiv_cells.front()->module), equiv_cells(equiv_cells), equiv_cell(nullptr),
-			sigmap(sigmap), bit2driver(bit2driver), satgen(ez.get(), &sigmap), max_seq(max_seq), short_cones(short_cones), verbose(verbose)
+	// with deferred_updates set, proven cells are only collected in
+	// proven_cells and left for the caller to update
+	bool deferred_updates = false;
+	vector<Cell*> proven_cells;
+
+	EquivSimpleWorker(Module *module, SigMap &sigmap, dict<SigBit, Cell*> &bit2driver, int max_seq, bool short_cones, bool verbose, bool model_undef) :
+			module(module), equiv_cell(nullptr), sigmap(sigmap), bit2driver(bit2driver),
+			satgen(ez.get(), &sigmap), max_seq(max_seq), short_cones(short_cones), verbose(verbose)
 	{
 		satgen.model_undef = model_undef;
 	}
@@ -195,7 +205,7 @@ struct EquivSimpleWorker
 
 			if (satgen.model_undef) {
 				for (auto bit : input_bits)
-					ez->assume(ez->NOT(satgen.importUndefSigBit(bit, step+1)));
+					ez->assume(ez->NOT(satgen.importUndefSigBit(bit, step+1)), ez_context);
 			}
 
 			if (verbose)
@@ -203,7 +213,9 @@ struct EquivSimpleWorker
 
 			if (!ez->solve(ez_context)) {
 				log(verbose ? "    Proved equivalence! Marking $equiv cell as proven.\n" : " success!\n");
-				equiv_cell->setPort(ID::B, equiv_cell->getPort(ID::A));
+				if (!deferred_updates)
+					equiv_cell->setPort(ID::B, equiv_cell->getPort(ID::A));
+				proven_cells.push_back(equiv_cell);
 				ez->assume(ez->NOT(ez_context));
 				return true;
 			}
@@ -255,7 +267,7 @@ struct EquivSimpleWorker
 		return false;
 	}
 
-	int run()
+	int run(const vector<Cell*> &equiv_cells)
 	{
 		if (GetSize(equiv_cells) > 1) {
 			SigSpec sig;
@@ -275,6 +287,40 @@ struct EquivSimpleWorker
 
 };
 
+// number of cells in the combinational input cones of a group of $equiv cells,
+// used to start the largest proofs first
+static int estimate_cone_size(const vector<Cell*> &equiv_cells, SigMap &sigmap, const dict<SigBit, Cell*> &bit2driver)
+{
+	pool<Cell*> cone;
+	vector<SigBit> queue;
+
+	for (auto cell : equiv_cells)
+		for (auto bit : sigmap(cell->getPort(ID::A)).to_sigbit_vector())
+			queue.push_back(bit);
+	for (auto cell : equiv_cells)
+		for (auto bit : sigmap(cell->getPort(ID::B)).to_sigbit_vector())
+			queue.push_back(bit);
+
+	while (!queue.empty())
+	{
+		SigBit bit = queue.back();
+		queue.pop_back();
+
+		auto it = bit2driver.find(bit);
+		if (it == bit2driver.end() || !cone.insert(it->second).second)
+			continue;
+		if (RTLIL::builtin_ff_cell_types().count(it->second->type))
+			continue;
+
+		for (auto &conn : it->second->connections())
+			if (yosys_celltypes.cell_input(it->second->type, conn.first))
+				for (auto in_bit : sigmap(conn.second))
+					queue.push_back(in_bit);
+	}
+
+	return GetSize(cone);
+}
+
 struct EquivSimplePass : public Pass {
 	EquivSimplePass() : Pass("equiv_simple", "try proving simple $equiv instances") { }
 	void help() override
@@ -301,12 +347,25 @@ struct EquivSimplePass : public Pass {
 		log("    -seq <N>\n");
 		log("        the max. number of time steps to be considered (default = 1)\n");
 		log("\n");
+		log("    -incremental\n");
+		log("        use one SAT solver per module for all $equiv cells, instead of one per\n");
+		log("        group. Every cell is then imported only once, and each $equiv cell is\n");
+		log("        proved with its own miter enabled through an assumption.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        prove up to <num> groups of $equiv cells at the same time, each with its\n");
+		log("        own SAT solver, starting with the groups with the largest input cones.\n");
+		log("        the proven cells are updated and the log output is written in the same\n");
+		log("        order as without this option. the default is the -j value synthesizer\n");
+		log("        runs with. -incremental always proves the groups one at a time.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, Design *design) override
 	{
-		bool verbose = false, short_cones = false, model_undef = false, nogroup = false;
+		bool verbose = false, short_cones = false, model_undef = false, nogroup = false, incremental = false;
 		int success_counter = 0;
 		int max_seq = 1;
+		int jobs = yosys_parallel_jobs;
 
 		log_header(design, "Executing EQUIV_SIMPLE pass.\n");
 
@@ -328,10 +387,20 @@ struct EquivSimplePass : public Pass {
 				nogroup = true;
 				continue;
 			}
+			if (args[argidx] == "-incremental") {
+				incremental = true;
+				continue;
+			}
 			if (args[argidx] == "-seq" && argidx+1 < args.size()) {
 				max_seq = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid -j argument: %s\n", args[argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -374,6 +443,7 @@ struct EquivSimplePass : public Pass {
 							bit2driver[bit] = cell;
 			}
 
+			vector<vector<Cell*>> groups;
 			unproven_equiv_cells.sort();
 			for (auto it : unproven_equiv_cells)
 			{
@@ -382,9 +452,65 @@ struct EquivSimplePass : public Pass {
 				vector<Cell*> cells;
 				for (auto it2 : it.second)
 					cells.push_back(it2.second);
+				groups.push_back(cells);
+			}
 
-				EquivSimpleWorker worker(cells, sigmap, bit2driver, max_seq, short_cones, verbose, model_undef);
-				success_counter += worker.run();
+			if (incremental)
+			{
+				EquivSimpleWorker worker(module, sigmap, bit2driver, max_seq, short_cones, verbose, model_undef);
+				for (auto &cells : groups)
+					success_counter += worker.run(cells);
+			}
+			else if (jobs > 1 && GetSize(groups) > 1)
+			{
+				vector<int> cone_sizes, schedule;
+				for (int i = 0; i < GetSize(groups); i++) {
+					cone_sizes.push_back(estimate_cone_size(groups[i], sigmap, bit2driver));
+					schedule.push_back(i);
+				}
+				std::stable_sort(schedule.begin(), schedule.end(), [&](int a, int b) { return cone_sizes[a] > cone_sizes[b]; });
+
+				// SigMap lookups compress paths, so every thread works on its own copy
+				std::mutex sigmaps_mutex;
+				vector<std::unique_ptr<SigMap>> sigmaps;
+				vector<SigMap*> free_sigmaps;
+
+				vector<int> group_success(GetSize(groups));
+				vector<vector<Cell*>> group_proven(GetSize(groups));
+
+				parallel_for_scheduled(schedule, [&](int i) {
+					SigMap *task_sigmap;
+					{
+						std::lock_guard<std::mutex> lock(sigmaps_mutex);
+						if (free_sigmaps.empty()) {
+							sigmaps.emplace_back(new SigMap(sigmap));
+							free_sigmaps.push_back(sigmaps.back().get());
+						}
+						task_sigmap = free_sigmaps.back();
+						free_sigmaps.pop_back();
+					}
+
+					EquivSimpleWorker worker(module, *task_sigmap, bit2driver, max_seq, short_cones, verbose, model_undef);
+					worker.deferred_updates = true;
+					group_success[i] = worker.run(groups[i]);
+					group_proven[i].swap(worker.proven_cells);
+
+					std::lock_guard<std::mutex> lock(sigmaps_mutex);
+					free_sigmaps.push_back(task_sigmap);
+				}, jobs);
+
+				for (int i = 0; i < GetSize(groups); i++) {
+					for (auto cell : group_proven[i])
+						cell->setPort(ID::B, cell->getPort(ID::A));
+					success_counter += group_success[i];
+				}
+			}
+			else
+			{
+				for (auto &cells : groups) {
+					EquivSimpleWorker worker(module, sigmap, bit2driver, max_seq, short_cones, verbose, model_undef);
+					success_counter += worker.run(cells);
+				}
 			}
 		}
 
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -31,6 +32,7 @@ struct EquivStructWorker
 	bool mode_fwd;
 	bool mode_icells;
 	int merge_count;
+	int jobs;
 
 	const pool<IdString> &fwonly_cells;
 
@@ -55,9 +57,168 @@ struct EquivStructWorker
 		}
 	};
 
+	// the forward key (all input bits) and the backward keys (one per output
+	// bit) a cell was last hashed with
+	struct cell_keys_t
+	{
+		merge_key_t fwd_key;
+		vector<merge_key_t> bwd_keys;
+	};
+
 	dict<merge_key_t, pool<IdString>> merge_cache;
 	pool<merge_key_t> fwd_merge_cache, bwd_merge_cache;
 
+	// Cells are only rehashed when one of the signals in their keys changes.
+	// bit_readers and bit_drivers map the signals of the current keys back to
+	// the cells, dirty_cells collects the cells to rehash in the next iteration.
+	dict<IdString, cell_keys_t> cell_keys;
+	dict<SigBit, pool<IdString>> bit_readers, bit_drivers;
+	pool<IdString> equiv_cells, dirty_cells;
+
+	static cell_keys_t compute_keys(Cell *cell, SigMap &sigmap, SigMap &equiv_bits)
+	{
+		cell_keys_t keys;
+		merge_key_t key;
+		vector<tuple<IdString, int, SigBit>> fwd_connections;
+
+		key.type = cell->type;
+
+		for (auto &it : cell->parameters)
+			key.parameters.push_back(it);
+		std::sort(key.parameters.begin(), key.parameters.end());
+
+		for (auto &it : cell->connections())
+			key.port_sizes.push_back(make_pair(it.first, GetSize(it.second)));
+		std::sort(key.port_sizes.begin(), key.port_sizes.end());
+
+		for (auto &conn : cell->connections())
+		{
+			if (cell->input(conn.first)) {
+				SigSpec sig = sigmap(conn.second);
+				for (int i = 0; i < GetSize(sig); i++)
+					fwd_connections.push_back(make_tuple(conn.first, i, sig[i]));
+			}
+
+			if (cell->output(conn.first)) {
+				SigSpec sig = equiv_bits(conn.second);
+				for (int i = 0; i < GetSize(sig); i++) {
+					key.connections.clear();
+					key.connections.push_back(make_tuple(conn.first, i, sig[i]));
+					keys.bwd_keys.push_back(key);
+				}
+			}
+		}
+
+		std::sort(fwd_connections.begin(), fwd_connections.end());
+		key.connections.swap(fwd_connections);
+		keys.fwd_key = key;
+		return keys;
+	}
+
+	void hash_cell(IdString cell_name, cell_keys_t &&keys)
+	{
+		for (auto &key : keys.bwd_keys) {
+			auto &group = merge_cache[key];
+			group.insert(cell_name);
+			if (GetSize(group) > 1)
+				bwd_merge_cache.insert(key);
+			bit_drivers[std::get<2>(key.connections.front())].insert(cell_name);
+		}
+
+		auto &group = merge_cache[keys.fwd_key];
+		group.insert(cell_name);
+		if (GetSize(group) > 1)
+			fwd_merge_cache.insert(keys.fwd_key);
+		for (auto &conn : keys.fwd_key.connections)
+			bit_readers[std::get<2>(conn)].insert(cell_name);
+
+		cell_keys[cell_name] = std::move(keys);
+	}
+
+	void unhash_cell(IdString cell_name)
+	{
+		auto it = cell_keys.find(cell_name);
+		if (it == cell_keys.end())
+			return;
+
+		auto remove_from = [&](dict<SigBit, pool<IdString>> &index, SigBit bit) {
+			auto idx_it = index.find(bit);
+			if (idx_it == index.end())
+				return;
+			idx_it->second.erase(cell_name);
+			if (idx_it->second.empty())
+				index.erase(idx_it);
+		};
+
+		auto remove_key = [&](const merge_key_t &key) {
+			auto group_it = merge_cache.find(key);
+			if (group_it == merge_cache.end())
+				return;
+			group_it->second.erase(cell_name);
+			if (group_it->second.empty())
+				merge_cache.erase(group_it);
+		};
+
+		for (auto &key : it->second.bwd_keys) {
+			remove_key(key);
+			remove_from(bit_drivers, std::get<2>(key.connections.front()));
+		}
+
+		remove_key(it->second.fwd_key);
+		for (auto &conn : it->second.fwd_key.connections)
+			remove_from(bit_readers, std::get<2>(conn));
+
+		cell_keys.erase(it);
+	}
+
+	// must be called before the signal of the bit is joined with another one
+	void invalidate_bit(SigBit bit)
+	{
+		auto it = bit_readers.find(sigmap(bit));
+		if (it != bit_readers.end())
+			for (auto cell_name : it->second)
+				dirty_cells.insert(cell_name);
+
+		it = bit_drivers.find(equiv_bits(bit));
+		if (it != bit_drivers.end())
+			for (auto cell_name : it->second)
+				dirty_cells.insert(cell_name);
+	}
+
+	void connect(const SigSpec &lhs, const SigSpec &rhs)
+	{
+		for (auto bit : lhs)
+			invalidate_bit(bit);
+		for (auto bit : rhs)
+			invalidate_bit(bit);
+
+		module->connect(lhs, rhs);
+		sigmap.add(lhs, rhs);
+		equiv_bits.add(lhs, rhs);
+	}
+
+	void add_equiv(SigBit bit_a, SigBit bit_b, SigBit bit_y)
+	{
+		Cell *cell = module->addEquiv(NEW_ID, bit_a, bit_b, bit_y);
+
+		if (!module->design->selected(module, cell))
+			return;
+
+		invalidate_bit(bit_a);
+		invalidate_bit(bit_b);
+		equiv_bits.add(sigmap(bit_b), sigmap(bit_a));
+		equiv_cells.insert(cell->name);
+		dirty_cells.insert(cell->name);
+	}
+
+	void remove_cell(Cell *cell)
+	{
+		unhash_cell(cell->name);
+		equiv_cells.erase(cell->name);
+		dirty_cells.erase(cell->name);
+		module->remove(cell);
+	}
+
 	void merge_cell_pair(Cell *cell_a, Cell *cell_b)
 	{
 		SigMap merged_map;
@@ -88,7 +249,7 @@ struct EquivStructWorker
 			SigBit bit_y = module->addWire(NEW_ID);
 			log("        New $equiv for input %s: A: %s, B: %s, Y: %s\n",
 					input_names[i].c_str(), log_signal(bit_a), log_signal(bit_b), log_signal(bit_y));
-			module->addEquiv(NEW_ID, bit_a, bit_b, bit_y);
+			add_equiv(bit_a, bit_b, bit_y);
 			merged_map.add(bit_a, bit_y);
 			merged_map.add(bit_b, bit_y);
 		}
@@ -103,114 +264,110 @@ struct EquivStructWorker
 
 		for (auto &pn : inport_names)
 			cell_a->setPort(pn, merged_map(sigmap(cell_a->getPort(pn))));
+		dirty_cells.insert(cell_a->name);
 
 		for (auto &pn : outport_names) {
 			SigSpec sig_a = cell_a->getPort(pn);
 			SigSpec sig_b = cell_b->getPort(pn);
-			module->connect(sig_b, sig_a);
+			connect(sig_b, sig_a);
 		}
 
 		auto merged_attr = cell_b->get_strpool_attribute(ID::equiv_merged);
 		merged_attr.insert(log_id(cell_b));
 		cell_a->add_strpool_attribute(ID::equiv_merged, merged_attr);
-		module->remove(cell_b);
+		remove_cell(cell_b);
 	}
 
-	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, const pool<IdString> &fwonly_cells, int iter_num) :
-			module(module), sigmap(module), equiv_bits(module),
-			mode_fwd(mode_fwd), mode_icells(mode_icells), merge_count(0), fwonly_cells(fwonly_cells)
+	void rehash_dirty_cells()
 	{
-		log("  Starting iteration %d.\n", iter_num);
-
-		pool<SigBit> equiv_inputs;
-		pool<IdString> cells;
-
-		for (auto cell : module->selected_cells())
-			if (cell->type == ID($equiv)) {
-				SigBit sig_a = sigmap(cell->getPort(ID::A).as_bit());
-				SigBit sig_b = sigmap(cell->getPort(ID::B).as_bit());
-				equiv_bits.add(sig_b, sig_a);
-				equiv_inputs.insert(sig_a);
-				equiv_inputs.insert(sig_b);
-				cells.insert(cell->name);
-			} else {
-				if (mode_icells || module->design->module(cell->type))
-					cells.insert(cell->name);
-			}
-
-		for (auto cell : module->selected_cells())
-			if (cell->type == ID($equiv)) {
-				SigBit sig_a = sigmap(cell->getPort(ID::A).as_bit());
-				SigBit sig_b = sigmap(cell->getPort(ID::B).as_bit());
-				SigBit sig_y = sigmap(cell->getPort(ID::Y).as_bit());
-				if (sig_a == sig_b && equiv_inputs.count(sig_y)) {
-					log("    Purging redundant $equiv cell %s.\n", log_id(cell));
-					module->connect(sig_y, sig_a);
-					module->remove(cell);
-					merge_count++;
-				}
-			}
+		vector<Cell*> cells;
+		for (auto cell_name : dirty_cells) {
+			unhash_cell(cell_name);
+			Cell *cell = module->cell(cell_name);
+			if (cell != nullptr)
+				cells.push_back(cell);
+		}
+		dirty_cells.clear();
+
+		vector<cell_keys_t> keys(GetSize(cells));
+
+		// SigMap lookups compress paths, so each chunk works on its own copies
+		int chunks = std::min(jobs, GetSize(cells) / 1024);
+		if (chunks > 1) {
+			parallel_for(chunks, [&](int chunk) {
+				SigMap chunk_sigmap = sigmap, chunk_equiv_bits = equiv_bits;
+				for (int i = chunk; i < GetSize(cells); i += chunks)
+					keys[i] = compute_keys(cells[i], chunk_sigmap, chunk_equiv_bits);
+			}, jobs);
+		} else {
+			for (int i = 0; i < GetSize(cells); i++)
+				keys[i] = compute_keys(cells[i], sigmap, equiv_bits);
+		}
 
-		if (merge_count > 0)
-			return;
+		for (int i = 0; i < GetSize(cells); i++)
+			hash_cell(cells[i]->name, std::move(keys[i]));
+	}
 
-		for (auto cell_name : cells)
-		{
-			merge_key_t key;
-			vector<tuple<IdString, int, SigBit>> fwd_connections;
+	bool purge_equiv_cells()
+	{
+		pool<SigBit> equiv_inputs;
+		vector<Cell*> purge_cells;
 
+		for (auto cell_name : equiv_cells) {
 			Cell *cell = module->cell(cell_name);
-			key.type = cell->type;
+			equiv_inputs.insert(sigmap(cell->getPort(ID::A).as_bit()));
+			equiv_inputs.insert(sigmap(cell->getPort(ID::B).as_bit()));
+		}
 
-			for (auto &it : cell->parameters)
-				key.parameters.push_back(it);
-			std::sort(key.parameters.begin(), key.parameters.end());
+		for (auto cell_name : equiv_cells) {
+			Cell *cell = module->cell(cell_name);
+			SigBit sig_a = sigmap(cell->getPort(ID::A).as_bit());
+			SigBit sig_b = sigmap(cell->getPort(ID::B).as_bit());
+			SigBit sig_y = sigmap(cell->getPort(ID::Y).as_bit());
+			if (sig_a == sig_b && equiv_inputs.count(sig_y))
+				purge_cells.push_back(cell);
+		}
 
-			for (auto &it : cell->connections())
-				key.port_sizes.push_back(make_pair(it.first, GetSize(it.second)));
-			std::sort(key.port_sizes.begin(), key.port_sizes.end());
+		for (auto cell : purge_cells) {
+			log("    Purging redundant $equiv cell %s.\n", log_id(cell));
+			SigBit sig_a = sigmap(cell->getPort(ID::A).as_bit());
+			SigBit sig_y = sigmap(cell->getPort(ID::Y).as_bit());
+			connect(sig_y, sig_a);
+			remove_cell(cell);
+			merge_count++;
+		}
 
-			for (auto &conn : cell->connections())
-			{
-				if (cell->input(conn.first)) {
-					SigSpec sig = sigmap(conn.second);
-					for (int i = 0; i < GetSize(sig); i++)
-						fwd_connections.push_back(make_tuple(conn.first, i, sig[i]));
-				}
+		return !purge_cells.empty();
+	}
 
-				if (cell->output(conn.first)) {
-					SigSpec sig = equiv_bits(conn.second);
-					for (int i = 0; i < GetSize(sig); i++) {
-						key.connections.clear();
-						key.connections.push_back(make_tuple(conn.first, i, sig[i]));
+	bool run_iteration(int iter_num)
+	{
+		log("  Starting iteration %d.\n", iter_num);
 
-						if (merge_cache.count(key))
-							bwd_merge_cache.insert(key);
-						merge_cache[key].insert(cell_name);
-					}
-				}
-			}
+		int start_merge_count = merge_count;
 
-			std::sort(fwd_connections.begin(), fwd_connections.end());
-			key.connections.swap(fwd_connections);
+		if (purge_equiv_cells())
+			return true;
 
-			if (merge_cache.count(key))
-				fwd_merge_cache.insert(key);
-			merge_cache[key].insert(cell_name);
-		}
+		rehash_dirty_cells();
 
 		for (int phase = 0; phase < 2; phase++)
 		{
-			auto &queue = phase ? bwd_merge_cache : fwd_merge_cache;
+			pool<merge_key_t> queue, requeue;
+			queue.swap(phase ? bwd_merge_cache : fwd_merge_cache);
 
 			for (auto &key : queue)
 			{
+				auto group_it = merge_cache.find(key);
+				if (group_it == merge_cache.end())
+					continue;
+
 				const char *strategy = nullptr;
 				vector<Cell*> gold_cells, gate_cells, other_cells;
 				vector<pair<Cell*, Cell*>> cell_pairs;
 				IdString cells_type;
 
-				for (auto cell_name : merge_cache[key]) {
+				for (auto cell_name : group_it->second) {
 					Cell *c = module->cell(cell_name);
 					if (c != nullptr) {
 						string n = cell_name.str();
@@ -271,13 +428,50 @@ struct EquivStructWorker
 					log("      Merging cells %s and %s.\n", log_id(it.first),  log_id(it.second));
 					merge_cell_pair(it.first, it.second);
 				}
+
+				// the cells left over in the group are looked at again in the next iteration
+				requeue.insert(key);
 			}
 
-			if (merge_count > 0)
-				return;
+			auto &merge_queue = phase ? bwd_merge_cache : fwd_merge_cache;
+			for (auto &key : requeue)
+				merge_queue.insert(key);
+
+			if (merge_count > start_merge_count)
+				return true;
 		}
 
 		log("    Nothing to merge.\n");
+		return false;
+	}
+
+	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, const pool<IdString> &fwonly_cells, int jobs) :
+			module(module), sigmap(module), equiv_bits(module),
+			mode_fwd(mode_fwd), mode_icells(mode_icells), merge_count(0), jobs(jobs), fwonly_cells(fwonly_cells)
+	{
+		for (auto cell : module->selected_cells())
+			if (cell->type == ID($equiv)) {
+				SigBit sig_a = sigmap(cell->getPort(ID::A).as_bit());
+				SigBit sig_b = sigmap(cell->getPort(ID::B).as_bit());
+				equiv_bits.add(sig_b, sig_a);
+				equiv_cells.insert(cell->name);
+				dirty_cells.insert(cell->name);
+			} else {
+				if (mode_icells || module->design->module(cell->type))
+					dirty_cells.insert(cell->name);
+			}
+	}
+
+	void run(int max_iter)
+	{
+		for (int iter = 0;; iter++) {
+			if (iter == max_iter) {
+				log("  Reached iteration limit of %d.\n", iter);
+				break;
+			}
+			if (!run_iteration(iter+1))
+				break;
+		}
 	}
 };
 
@@ -313,6 +507,11 @@ struct EquivStructPass : public Pass {
 		log("    -maxiter <N>\n");
 		log("        maximum number of iterations to run before aborting\n");
 		log("\n");
+		log("    -j <num>\n");
+		log("        compute the structural hashes of up to <num> chunks of cells at the same\n");
+		log("        time. after the first iteration only the cells next to merged cells are\n");
+		log("        hashed again. the default is the -j value synthesizer runs with.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, Design *design) override
 	{
@@ -320,6 +519,7 @@ struct EquivStructPass : public Pass {
 		bool mode_icells = false;
 		bool mode_fwd = false;
 		int max_iter = -1;
+		int jobs = yosys_parallel_jobs;
 
 		log_header(design, "Executing EQUIV_STRUCT pass.\n");
 
@@ -341,25 +541,22 @@ struct EquivStructPass : public Pass {
 				max_iter = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid -j argument: %s\n", args[argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
 		for (auto module : design->selected_modules()) {
-			int module_merge_count = 0;
 			log("Running equiv_struct on module %s:\n", log_id(module));
-			for (int iter = 0;; iter++) {
-				if (iter == max_iter) {
-					log("  Reached iteration limit of %d.\n", iter);
-					break;
-				}
-				EquivStructWorker worker(module, mode_fwd, mode_icells, fwonly_cells, iter+1);
-				if (worker.merge_count == 0)
-					break;
-				module_merge_count += worker.merge_count;
-			}
-			if (module_merge_count)
-				log("  Performed a total of %d merges in module %s.\n", module_merge_count, log_id(module));
+			EquivStructWorker worker(module, mode_fwd, mode_icells, fwonly_cells, jobs);
+			worker.run(max_iter);
+			if (worker.merge_count)
+				log("  Performed a total of %d merges in module %s.\n", worker.merge_count, log_id(module));
 		}
 	}
 } EquivStructPass;
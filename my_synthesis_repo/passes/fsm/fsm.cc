@@ -65,6 +65,7 @@ struct FsmPass : public Pass {
 		log("    -encoding type\n");
 		log("    -fm_set_fsm_file file\n");
 		log("    -encfile file\n");
+		log("    -search\n");
 		log("        passed through to fsm_recode pass\n");
 		log("\n");
 		log("This pass uses a subset of FF types to detect FSMs. Run 'opt -nosdff -nodffe'\n");
@@ -88,6 +89,7 @@ struct FsmPass : public Pass {
 		std::string fm_set_fsm_file_opt;
 		std::string encfile_opt;
 		std::string encoding_opt;
+		std::string search_opt;
 
 		log_header(design, "Executing FSM pass (extract and optimize FSM).\n");
 		log_push();
@@ -107,6 +109,10 @@ struct FsmPass : public Pass {
 				encoding_opt = " -encoding " + args[++argidx];
 				continue;
 			}
+			if (arg == "-search") {
+				search_opt = " -search";
+				continue;
+			}
 			if (arg == "-nodetect") {
 				flag_nodetect = true;
 				continue;
@@ -150,7 +156,7 @@ struct FsmPass : public Pass {
 		}
 
 		if (!flag_norecode)
-			Pass::call(design, "fsm_recode" + fm_set_fsm_file_opt + encfile_opt + encoding_opt);
+			Pass::call(design, "fsm_recode" + fm_set_fsm_file_opt + encfile_opt + encoding_opt + search_opt);
 		Pass::call(design, "fsm_info");
 
 		if (flag_export)
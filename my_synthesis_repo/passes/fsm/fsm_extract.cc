@@ -27,6 +27,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/consteval.h"
 #include "kernel/celltypes.h"
+#include "kernel/satgen.h"
 #include "fsmdata.h"
 
 USING_YOSYS_NAMESPACE
@@ -37,6 +38,7 @@ static SigMap assign_map;
 typedef std::pair<RTLIL::IdString, RTLIL::IdString> sig2driver_entry_t;
 static SigSet<sig2driver_entry_t> sig2driver, sig2trigger;
 static std::map<RTLIL::SigBit, std::set<RTLIL::SigBit>> exclusive_ctrls;
+static int sat_inputs;
 
 static bool find_states(RTLIL::SigSpec sig, const RTLIL::SigSpec &dff_out, RTLIL::SigSpec &ctrl, std::map<RTLIL::Const, int> &states, RTLIL::Const *reset_state = NULL)
 {
@@ -141,6 +143,46 @@ static RTLIL::Const sig2const(ConstEval &ce, RTLIL::SigSpec sig, RTLIL::State no
 	return sig.as_const();
 }
 
+static void add_transition(FsmData &fsm_data, std::map<RTLIL::Const, int> &states, int state_in, const RTLIL::SigSpec &ctrl_in,
+		FsmData::transition_t &tr, const RTLIL::Const &next_state, bool shortened)
+{
+	std::map<RTLIL::SigBit, int> ctrl_in_bit_indices;
+	for (int i = 0; i < GetSize(ctrl_in); i++)
+		ctrl_in_bit_indices[ctrl_in[i]] = i;
+
+	for (auto &it : ctrl_in_bit_indices)
+		if (tr.ctrl_in.bits.at(it.second) == State::S1 && exclusive_ctrls.count(it.first) != 0)
+			for (auto &dc_bit : exclusive_ctrls.at(it.first))
+				if (ctrl_in_bit_indices.count(dc_bit))
+					tr.ctrl_in.bits.at(ctrl_in_bit_indices.at(dc_bit)) = RTLIL::State::Sa;
+
+	RTLIL::Const log_state_in = RTLIL::Const(RTLIL::State::Sx, fsm_data.state_bits);
+	if (state_in >= 0)
+		log_state_in = fsm_data.state_table.at(state_in);
+
+	if (states.count(next_state) == 0) {
+		log("  transition: %10s %s -> INVALID_STATE(%s) %s  <ignored invalid transition!>%s\n",
+				log_signal(log_state_in), log_signal(tr.ctrl_in),
+				log_signal(next_state), log_signal(tr.ctrl_out),
+				shortened ? " SHORTENED" : "");
+		return;
+	}
+
+	tr.state_in = state_in;
+	tr.state_out = states.at(next_state);
+
+	if (next_state.is_fully_def()) {
+		fsm_data.transition_table.push_back(tr);
+		log("  transition: %10s %s -> %10s %s\n",
+				log_signal(log_state_in), log_signal(tr.ctrl_in),
+				log_signal(fsm_data.state_table[tr.state_out]), log_signal(tr.ctrl_out));
+	} else {
+		log("  transition: %10s %s -> %10s %s  <ignored undef transition!>\n",
+				log_signal(log_state_in), log_signal(tr.ctrl_in),
+				log_signal(fsm_data.state_table[tr.state_out]), log_signal(tr.ctrl_out));
+	}
+}
+
 static void find_transitions(ConstEval &ce, ConstEval &ce_nostop, FsmData &fsm_data, std::map<RTLIL::Const, int> &states, int state_in, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec ctrl_out, RTLIL::SigSpec dff_in, RTLIL::SigSpec dont_care)
 {
 	bool undef_bit_in_next_state_mode = false;
@@ -162,42 +204,7 @@ undef_bit_in_next_state:
 		FsmData::transition_t tr;
 		tr.ctrl_in = sig2const(ce, ctrl_in, RTLIL::State::Sa, dont_care);
 		tr.ctrl_out = sig2const(ce, ctrl_out, RTLIL::State::Sx);
-
-		std::map<RTLIL::SigBit, int> ctrl_in_bit_indices;
-		for (int i = 0; i < GetSize(ctrl_in); i++)
-			ctrl_in_bit_indices[ctrl_in[i]] = i;
-
-		for (auto &it : ctrl_in_bit_indices)
-			if (tr.ctrl_in.bits.at(it.second) == State::S1 && exclusive_ctrls.count(it.first) != 0)
-				for (auto &dc_bit : exclusive_ctrls.at(it.first))
-					if (ctrl_in_bit_indices.count(dc_bit))
-						tr.ctrl_in.bits.at(ctrl_in_bit_indices.at(dc_bit)) = RTLIL::State::Sa;
-
-		RTLIL::Const log_state_in = RTLIL::Const(RTLIL::State::Sx, fsm_data.state_bits);
-		if (state_in >= 0)
-			log_state_in = fsm_data.state_table.at(state_in);
-
-		if (states.count(ce.values_map(ce.assign_map(dff_in)).as_const()) == 0) {
-			log("  transition: %10s %s -> INVALID_STATE(%s) %s  <ignored invalid transition!>%s\n",
-					log_signal(log_state_in), log_signal(tr.ctrl_in),
-					log_signal(ce.values_map(ce.assign_map(dff_in))), log_signal(tr.ctrl_out),
-					undef_bit_in_next_state_mode ? " SHORTENED" : "");
-			return;
-		}
-
-		tr.state_in = state_in;
-		tr.state_out = states.at(ce.values_map(ce.assign_map(dff_in)).as_const());
-
-		if (dff_in.is_fully_def()) {
-			fsm_data.transition_table.push_back(tr);
-			log("  transition: %10s %s -> %10s %s\n",
-					log_signal(log_state_in), log_signal(tr.ctrl_in),
-					log_signal(fsm_data.state_table[tr.state_out]), log_signal(tr.ctrl_out));
-		} else {
-			log("  transition: %10s %s -> %10s %s  <ignored undef transition!>\n",
-					log_signal(log_state_in), log_signal(tr.ctrl_in),
-					log_signal(fsm_data.state_table[tr.state_out]), log_signal(tr.ctrl_out));
-		}
+		add_transition(fsm_data, states, state_in, ctrl_in, tr, ce.values_map(ce.assign_map(dff_in)).as_const(), undef_bit_in_next_state_mode);
 		return;
 	}
 
@@ -253,6 +260,169 @@ undef_bit_in_next_state:
 	}
 }
 
+// Enumerate the transitions as cubes over the control inputs with a SAT solver: find
+// one input assignment per solver call, widen it by every input that can be removed
+// without changing the outputs and block the resulting cube. This scales with the
+// number of cubes instead of the number of control input combinations.
+static bool find_transitions_sat(ConstEval &ce_nostop, FsmData &fsm_data, std::map<RTLIL::Const, int> &states,
+		RTLIL::SigSpec dff_out, RTLIL::SigSpec ctrl_in, RTLIL::SigSpec ctrl_out, RTLIL::SigSpec dff_in)
+{
+	ezSatPtr ez;
+	SatGen satgen(ez.get(), &assign_map);
+	satgen.model_undef = true;
+
+	pool<RTLIL::SigBit> stop_bits;
+	for (auto bit : assign_map(ctrl_in))
+		stop_bits.insert(bit);
+	for (auto bit : assign_map(dff_out))
+		stop_bits.insert(bit);
+
+	pool<RTLIL::Cell*> cone_cells;
+	pool<RTLIL::SigBit> visited;
+	std::vector<RTLIL::SigBit> queue;
+	for (auto bit : assign_map(ctrl_out))
+		queue.push_back(bit);
+	for (auto bit : assign_map(dff_in))
+		queue.push_back(bit);
+
+	while (!queue.empty())
+	{
+		RTLIL::SigBit bit = queue.back();
+		queue.pop_back();
+		if (bit.wire == nullptr || stop_bits.count(bit) || !visited.insert(bit).second)
+			continue;
+
+		std::set<sig2driver_entry_t> cellport_list;
+		sig2driver.find(bit, cellport_list);
+		if (GetSize(cellport_list) != 1) {
+			log("  signal %s has %d drivers, using recursive transition enumeration.\n", log_signal(bit), GetSize(cellport_list));
+			return false;
+		}
+
+		RTLIL::Cell *cell = module->cells_.at(cellport_list.begin()->first);
+		if (!cone_cells.insert(cell).second)
+			continue;
+		if (RTLIL::builtin_ff_cell_types().count(cell->type) || !satgen.importCell(cell)) {
+			log("  no SAT model for cell %s (%s), using recursive transition enumeration.\n", log_id(cell), log_id(cell->type));
+			return false;
+		}
+		for (auto &conn : cell->connections())
+			if (cell->input(conn.first))
+				for (auto in_bit : assign_map(conn.second))
+					queue.push_back(in_bit);
+	}
+
+	log("  enumerating transitions with SAT solver (%d cells, %d ctrl inputs).\n", GetSize(cone_cells), GetSize(ctrl_in));
+
+	std::vector<int> state_vec = satgen.importSigSpec(dff_out);
+	std::vector<int> state_undef = satgen.importUndefSigSpec(dff_out);
+	std::vector<int> in_vec = satgen.importSigSpec(ctrl_in);
+	std::vector<int> in_undef = satgen.importUndefSigSpec(ctrl_in);
+	std::vector<int> out_vec = satgen.importSigSpec(ctrl_out);
+	std::vector<int> out_undef = satgen.importUndefSigSpec(ctrl_out);
+	std::vector<int> next_vec = satgen.importSigSpec(dff_in);
+	std::vector<int> next_undef = satgen.importUndefSigSpec(dff_in);
+
+	for (int i = 0; i < GetSize(ctrl_in); i++) {
+		ez->assume(ez->NOT(in_undef[i]));
+		if (exclusive_ctrls.count(ctrl_in[i]))
+			for (int j = i+1; j < GetSize(ctrl_in); j++)
+				if (exclusive_ctrls.at(ctrl_in[i]).count(ctrl_in[j]))
+					ez->assume(ez->NOT(ez->AND(in_vec[i], in_vec[j])));
+	}
+
+	std::vector<int> model_expressions = in_vec;
+	for (auto vec : {&out_vec, &out_undef, &next_vec, &next_undef})
+		model_expressions.insert(model_expressions.end(), vec->begin(), vec->end());
+
+	std::vector<int> result_vec = out_vec, result_undef = out_undef;
+	result_vec.insert(result_vec.end(), next_vec.begin(), next_vec.end());
+	result_undef.insert(result_undef.end(), next_undef.begin(), next_undef.end());
+
+	for (int state_idx = 0; state_idx < GetSize(fsm_data.state_table); state_idx++)
+	{
+		const RTLIL::Const &state = fsm_data.state_table[state_idx];
+		int state_active = ez->literal();
+
+		std::vector<int> assumptions = {state_active};
+		for (int i = 0; i < GetSize(state); i++) {
+			assumptions.push_back(state[i] == State::Sx ? state_undef[i] : ez->NOT(state_undef[i]));
+			if (state[i] == State::S0 || state[i] == State::S1)
+				assumptions.push_back(state[i] == State::S1 ? state_vec[i] : ez->NOT(state_vec[i]));
+		}
+
+		// control inputs that are set by the state alone are don't-care in the transition table
+		std::vector<int> free_inputs;
+		ce_nostop.push();
+		ce_nostop.set(dff_out, state);
+		for (int i = 0; i < GetSize(ctrl_in); i++) {
+			RTLIL::SigSpec constval = ctrl_in[i];
+			if (ce_nostop.eval(constval) && constval.is_fully_def())
+				assumptions.push_back(constval == State::S1 ? in_vec[i] : ez->NOT(in_vec[i]));
+			else
+				free_inputs.push_back(i);
+		}
+		ce_nostop.pop();
+
+		std::vector<bool> model;
+		while (ez->solve(model_expressions, model, assumptions))
+		{
+			int n_in = GetSize(ctrl_in), n_out = GetSize(ctrl_out), n_next = GetSize(dff_in);
+			auto model_const = [&](int offset, int width, State undef_state) {
+				RTLIL::Const value(State::S0, width);
+				for (int i = 0; i < width; i++)
+					value.bits[i] = model[offset + width + i] ? undef_state : model[offset + i] ? State::S1 : State::S0;
+				return value;
+			};
+
+			FsmData::transition_t tr;
+			tr.ctrl_out = model_const(n_in, n_out, State::Sx);
+			RTLIL::Const next_state = model_const(n_in + 2*n_out, n_next, State::Sx);
+
+			std::vector<int> changed_results;
+			for (int i = 0; i < n_out + n_next; i++) {
+				int k = i < n_out ? n_in + i : n_in + n_out + i;
+				bool undef = model[k + (i < n_out ? n_out : n_next)];
+				if (undef)
+					changed_results.push_back(ez->NOT(result_undef[i]));
+				else
+					changed_results.push_back(ez->OR(result_undef[i], model[k] ? ez->NOT(result_vec[i]) : result_vec[i]));
+			}
+			int results_changed = ez->expression(ezSAT::OpOr, changed_results);
+
+			std::vector<bool> model_check;
+			std::vector<int> cube;
+			for (int i : free_inputs)
+				cube.push_back(model[i] ? in_vec[i] : ez->NOT(in_vec[i]));
+
+			for (int i = 0; i < GetSize(cube); i++) {
+				std::vector<int> check = assumptions;
+				check.push_back(results_changed);
+				for (int j = 0; j < GetSize(cube); j++)
+					if (j != i && cube[j] != 0)
+						check.push_back(cube[j]);
+				if (!ez->solve(std::vector<int>(), model_check, check))
+					cube[i] = 0;
+			}
+
+			tr.ctrl_in = RTLIL::Const(State::Sa, n_in);
+			std::vector<int> cube_lits;
+			for (int i = 0; i < GetSize(cube); i++)
+				if (cube[i] != 0) {
+					tr.ctrl_in.bits[free_inputs[i]] = model[free_inputs[i]] ? State::S1 : State::S0;
+					cube_lits.push_back(cube[i]);
+				}
+
+			add_transition(fsm_data, states, state_idx, ctrl_in, tr, next_state, false);
+			ez->assume(ez->NOT(ez->expression(ezSAT::OpAnd, cube_lits)), state_active);
+		}
+
+		ez->assume(ez->NOT(state_active));
+	}
+
+	return true;
+}
+
 static void extract_fsm(RTLIL::Wire *wire)
 {
 	log("Extracting FSM `%s' from module `%s'.\n", wire->name.c_str(), module->name.c_str());
@@ -358,6 +528,8 @@ static void extract_fsm(RTLIL::Wire *wire)
 
 	ConstEval ce(module), ce_nostop(module);
 	ce.stop(ctrl_in);
+	if (sat_inputs >= 0 && GetSize(ctrl_in) > sat_inputs && find_transitions_sat(ce_nostop, fsm_data, states, dff_out, ctrl_in, ctrl_out, dff_in))
+		goto transitions_done;
 	for (int state_idx = 0; state_idx < int(fsm_data.state_table.size()); state_idx++) {
 		ce.push(), ce_nostop.push();
 		ce.set(dff_out, fsm_data.state_table[state_idx]);
@@ -365,6 +537,7 @@ static void extract_fsm(RTLIL::Wire *wire)
 		find_transitions(ce, ce_nostop, fsm_data, states, state_idx, ctrl_in, ctrl_out, dff_in, RTLIL::SigSpec());
 		ce.pop(), ce_nostop.pop();
 	}
+transitions_done:
 
 	// create fsm cell
 
@@ -397,6 +570,7 @@ static void extract_fsm(RTLIL::Wire *wire)
 		RTLIL::Wire *unconn_wire = module->addWire(stringf("$fsm_unconnect$%d", autoidx++), unconn_sig.size());
 		port_sig.replace(unconn_sig, RTLIL::SigSpec(unconn_wire), &cell->connections_[cellport.second]);
 	}
+	module->notify_blackout();
 }
 
 struct FsmExtractPass : public Pass {
@@ -405,7 +579,7 @@ struct FsmExtractPass : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    fsm_extract [selection]\n");
+		log("    fsm_extract [options] [selection]\n");
 		log("\n");
 		log("This pass operates on all signals marked as FSM state signals using the\n");
 		log("'fsm_encoding' attribute. It consumes the logic that creates the state signal\n");
@@ -416,11 +590,36 @@ struct FsmExtractPass : public Pass {
 		log("original encoding. The 'fsm_opt' pass can be used in combination with the\n");
 		log("'opt_clean' pass to eliminate this signal.\n");
 		log("\n");
+		log("    -sat_inputs <num>\n");
+		log("        the transitions of FSMs with more than <num> control inputs are\n");
+		log("        enumerated as input cubes with a SAT solver instead of recursively\n");
+		log("        splitting on each control input. the default is 12.\n");
+		log("\n");
+		log("    -nosat\n");
+		log("        always use the recursive transition enumeration.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		log_header(design, "Executing FSM_EXTRACT pass (extracting FSM from design).\n");
-		extra_args(args, 1, design);
+
+		sat_inputs = 12;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-sat_inputs" && argidx+1 < args.size()) {
+				sat_inputs = atoi(args[++argidx].c_str());
+				if (sat_inputs < 0)
+					log_cmd_error("Invalid -sat_inputs argument: %s\n", args[argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-nosat") {
+				sat_inputs = -1;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
 
 		CellTypes ct(design);
 
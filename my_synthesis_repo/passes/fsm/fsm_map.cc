@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/consteval.h"
 #include "kernel/celltypes.h"
+#include "kernel/threading.h"
 #include "fsmdata.h"
 #include <string.h>
 
@@ -42,10 +43,27 @@ static bool pattern_is_subset(const RTLIL::Const &super_pattern, const RTLIL::Co
 	return true;
 }
 
-static void implement_pattern_cache(RTLIL::Module *module, std::map<RTLIL::Const, std::set<int>> &pattern_cache, std::set<int> &fullstate_cache, int num_states, RTLIL::Wire *state_onehot, RTLIL::SigSpec &ctrl_in, RTLIL::SigSpec output)
+// the ctrl_in patterns and in-states for which one next state or output bit is set
+struct PatternCache
 {
+	std::map<RTLIL::Const, std::set<int>> patterns;
+	std::set<int> fullstates;
+
+	// upper bound for the cells and wires created by implement_pattern_cache()
+	int estimated_size() const {
+		return 2 * GetSize(patterns) + 2;
+	}
+};
+
+static void implement_pattern_cache(RTLIL::Module *module, const PatternCache &cache, int num_states, RTLIL::Wire *state_onehot, RTLIL::SigSpec &ctrl_in, RTLIL::SigSpec output)
+{
+	const std::map<RTLIL::Const, std::set<int>> &pattern_cache = cache.patterns;
+	const std::set<int> &fullstate_cache = cache.fullstates;
 	RTLIL::SigSpec cases_vector;
 
+	// the two-input terms of all patterns are implemented by one wide $and cell
+	RTLIL::SigSpec and_sig_a, and_sig_b;
+
 	for (int in_state : fullstate_cache)
 		cases_vector.append(RTLIL::SigSpec(state_onehot, in_state));
 
@@ -114,21 +132,9 @@ static void implement_pattern_cache(RTLIL::Module *module, std::map<RTLIL::Const
 		switch (and_sig.size())
 		{
 		case 2:
-			{
-				RTLIL::Wire *and_wire = module->addWire(NEW_ID);
-				cases_vector.append(RTLIL::SigSpec(and_wire));
-
-				RTLIL::Cell *and_cell = module->addCell(NEW_ID, ID($and));
-				and_cell->setPort(ID::A, and_sig.extract(0, 1));
-				and_cell->setPort(ID::B, and_sig.extract(1, 1));
-				and_cell->setPort(ID::Y, RTLIL::SigSpec(and_wire));
-				and_cell->parameters[ID::A_SIGNED] = RTLIL::Const(false);
-				and_cell->parameters[ID::B_SIGNED] = RTLIL::Const(false);
-				and_cell->parameters[ID::A_WIDTH] = RTLIL::Const(1);
-				and_cell->parameters[ID::B_WIDTH] = RTLIL::Const(1);
-				and_cell->parameters[ID::Y_WIDTH] = RTLIL::Const(1);
-				break;
-			}
+			and_sig_a.append(and_sig[0]);
+			and_sig_b.append(and_sig[1]);
+			break;
 		case 1:
 			cases_vector.append(and_sig);
 			break;
@@ -140,6 +146,21 @@ static void implement_pattern_cache(RTLIL::Module *module, std::map<RTLIL::Const
 		}
 	}
 
+	if (and_sig_a.size() > 0) {
+		RTLIL::Wire *and_wire = module->addWire(NEW_ID, and_sig_a.size());
+		cases_vector.append(RTLIL::SigSpec(and_wire));
+
+		RTLIL::Cell *and_cell = module->addCell(NEW_ID, ID($and));
+		and_cell->setPort(ID::A, and_sig_a);
+		and_cell->setPort(ID::B, and_sig_b);
+		and_cell->setPort(ID::Y, RTLIL::SigSpec(and_wire));
+		and_cell->parameters[ID::A_SIGNED] = RTLIL::Const(false);
+		and_cell->parameters[ID::B_SIGNED] = RTLIL::Const(false);
+		and_cell->parameters[ID::A_WIDTH] = RTLIL::Const(and_sig_a.size());
+		and_cell->parameters[ID::B_WIDTH] = RTLIL::Const(and_sig_b.size());
+		and_cell->parameters[ID::Y_WIDTH] = RTLIL::Const(and_sig_a.size());
+	}
+
 	if (cases_vector.size() > 1) {
 		RTLIL::Cell *or_cell = module->addCell(NEW_ID, ID($reduce_or));
 		or_cell->setPort(ID::A, cases_vector);
@@ -163,6 +184,62 @@ static void map_fsm(RTLIL::Cell *fsm_cell, RTLIL::Module *module)
 
 	RTLIL::SigSpec ctrl_in = fsm_cell->getPort(ID::CTRL_IN);
 	RTLIL::SigSpec ctrl_out = fsm_cell->getPort(ID::CTRL_OUT);
+	int num_states = GetSize(fsm_data.state_table);
+
+	// collect the patterns for all next states and outputs first, in a single
+	// pass over the transition table for the next states, so that the storage
+	// for the generated cells and wires can be reserved up front
+
+	std::vector<PatternCache> next_state_caches;
+	if (num_states > 1)
+	{
+		next_state_caches.resize(num_states);
+
+		// the only next state of each state, -1 if it has no transitions and
+		// -2 if there are several
+		std::vector<int> next_state_of(num_states, -1);
+
+		for (auto &tr : fsm_data.transition_table) {
+			next_state_caches[tr.state_out].patterns[tr.ctrl_in].insert(tr.state_in);
+			int &next_state = next_state_of[tr.state_in];
+			if (next_state == -1)
+				next_state = tr.state_out;
+			else if (next_state != tr.state_out)
+				next_state = -2;
+		}
+
+		for (int j = 0; j < num_states; j++) {
+			if (next_state_of[j] == -1)
+				for (auto &cache : next_state_caches)
+					cache.fullstates.insert(j);
+			else if (next_state_of[j] >= 0)
+				next_state_caches[next_state_of[j]].fullstates.insert(j);
+		}
+	}
+
+	std::vector<PatternCache> ctrl_out_caches(fsm_data.num_outputs);
+	for (int i = 0; i < fsm_data.num_outputs; i++)
+	{
+		PatternCache &cache = ctrl_out_caches[i];
+
+		for (int j = 0; j < num_states; j++)
+			cache.fullstates.insert(j);
+
+		for (auto &tr : fsm_data.transition_table) {
+			if (tr.ctrl_out.bits[i] == RTLIL::State::S1)
+				cache.patterns[tr.ctrl_in].insert(tr.state_in);
+			else
+				cache.fullstates.erase(tr.state_in);
+		}
+	}
+
+	int estimated_size = num_states + 4;
+	for (auto &cache : next_state_caches)
+		estimated_size += cache.estimated_size();
+	for (auto &cache : ctrl_out_caches)
+		estimated_size += cache.estimated_size();
+	module->reserve_cells(estimated_size);
+	module->reserve_wires(estimated_size);
 
 	// create state register
 
@@ -237,23 +314,8 @@ static void map_fsm(RTLIL::Cell *fsm_cell, RTLIL::Module *module)
 	{
 		RTLIL::Wire *next_state_onehot = module->addWire(NEW_ID, fsm_data.state_table.size());
 
-		for (size_t i = 0; i < fsm_data.state_table.size(); i++)
-		{
-			std::map<RTLIL::Const, std::set<int>> pattern_cache;
-			std::set<int> fullstate_cache;
-
-			for (size_t j = 0; j < fsm_data.state_table.size(); j++)
-				fullstate_cache.insert(j);
-
-			for (auto &tr : fsm_data.transition_table) {
-				if (tr.state_out == int(i))
-					pattern_cache[tr.ctrl_in].insert(tr.state_in);
-				else
-					fullstate_cache.erase(tr.state_in);
-			}
-
-			implement_pattern_cache(module, pattern_cache, fullstate_cache, fsm_data.state_table.size(), state_onehot, ctrl_in, RTLIL::SigSpec(next_state_onehot, i));
-		}
+		for (int i = 0; i < num_states; i++)
+			implement_pattern_cache(module, next_state_caches[i], num_states, state_onehot, ctrl_in, RTLIL::SigSpec(next_state_onehot, i));
 
 		if (encoding_is_onehot)
 		{
@@ -298,22 +360,7 @@ static void map_fsm(RTLIL::Cell *fsm_cell, RTLIL::Module *module)
 	// Generate ctrl_out signal
 
 	for (int i = 0; i < fsm_data.num_outputs; i++)
-	{
-		std::map<RTLIL::Const, std::set<int>> pattern_cache;
-		std::set<int> fullstate_cache;
-
-		for (size_t j = 0; j < fsm_data.state_table.size(); j++)
-			fullstate_cache.insert(j);
-
-		for (auto &tr : fsm_data.transition_table) {
-			if (tr.ctrl_out.bits[i] == RTLIL::State::S1)
-				pattern_cache[tr.ctrl_in].insert(tr.state_in);
-			else
-				fullstate_cache.erase(tr.state_in);
-		}
-
-		implement_pattern_cache(module, pattern_cache, fullstate_cache, fsm_data.state_table.size(), state_onehot, ctrl_in, ctrl_out.extract(i, 1));
-	}
+		implement_pattern_cache(module, ctrl_out_caches[i], num_states, state_onehot, ctrl_in, ctrl_out.extract(i, 1));
 
 	// Remove FSM cell
 
@@ -328,7 +375,8 @@ struct FsmMapPass : public Pass {
 		log("\n");
 		log("    fsm_map [selection]\n");
 		log("\n");
-		log("This pass translates FSM cells to flip-flops and logic.\n");
+		log("This pass translates FSM cells to flip-flops and logic. When synthesizer runs\n");
+		log("with -j <jobs>, the FSMs of different modules are mapped concurrently.\n");
 		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
@@ -336,14 +384,23 @@ struct FsmMapPass : public Pass {
 		log_header(design, "Executing FSM_MAP pass (mapping FSMs to basic logic).\n");
 		extra_args(args, 1, design);
 
-		for (auto mod : design->selected_modules()) {
+		std::vector<RTLIL::Module*> modules;
+		for (auto mod : design->selected_modules())
+			for (auto cell : mod->selected_cells())
+				if (cell->type == ID($fsm)) {
+					modules.push_back(mod);
+					break;
+				}
+
+		// map_fsm() only touches the module of the FSM cell
+		parallel_for_modules(design, modules, [&](RTLIL::Module *mod) {
 			std::vector<RTLIL::Cell*> fsm_cells;
 			for (auto cell : mod->selected_cells())
 				if (cell->type == ID($fsm))
 					fsm_cells.push_back(cell);
 			for (auto cell : fsm_cells)
-					map_fsm(cell, mod);
-		}
+				map_fsm(cell, mod);
+		});
 	}
 } FsmMapPass;
 
@@ -305,6 +305,7 @@ struct FsmOpt
 
 		opt_alias_inputs();
 		opt_feedback_inputs();
+		module->notify_blackout();
 		opt_find_dont_care();
 
 		opt_const_and_unused_inputs();
@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/consteval.h"
 #include "kernel/celltypes.h"
+#include "kernel/threading.h"
 #include "fsmdata.h"
 #include <math.h>
 #include <string.h>
@@ -51,7 +52,175 @@ static void fm_set_fsm_print(RTLIL::Cell *cell, RTLIL::Module *module, FsmData &
 			prefix, RTLIL::unescape_id(module->name).c_str());
 }
 
-static void fsm_recode(RTLIL::Cell *cell, RTLIL::Module *module, FILE *fm_set_fsm_file, FILE *encfile, std::string default_encoding)
+struct FsmEncoding
+{
+	std::string encoding;
+	std::vector<RTLIL::Const> codes;
+	int cost;
+};
+
+// searched encodings by FSM signature, so that identical FSMs are only searched once
+static dict<std::string, FsmEncoding> encoding_cache;
+
+static std::string fsm_signature(const FsmData &fsm_data)
+{
+	std::string sig = stringf("%d %d %d %d", GetSize(fsm_data.state_table), fsm_data.reset_state, fsm_data.num_inputs, fsm_data.num_outputs);
+	for (auto &tr : fsm_data.transition_table)
+		sig += stringf(" %d:%s:%d:%s", tr.state_in, tr.ctrl_in.as_string().c_str(), tr.state_out, tr.ctrl_out.as_string().c_str());
+	return sig;
+}
+
+// Estimated gate cost of the next-state and output logic for the given state codes: every
+// logic bit is a sum of products over the state and control input bits, with adjacent
+// products merged, and counts with its AND and OR inputs. Each state bit adds a flip-flop.
+static int fsm_encoding_cost(const FsmData &fsm_data, const std::vector<RTLIL::Const> &codes, bool one_hot)
+{
+	int state_bits = GetSize(codes.front());
+	int cube_width = state_bits + fsm_data.num_inputs;
+
+	std::vector<std::string> state_cubes;
+	for (auto &code : codes) {
+		std::string cube(state_bits, '-');
+		for (int i = 0; i < state_bits; i++)
+			if (!one_hot || code[i] == State::S1)
+				cube[i] = code[i] == State::S1 ? '1' : '0';
+		state_cubes.push_back(cube);
+	}
+
+	std::vector<pool<std::string>> on_sets(state_bits + fsm_data.num_outputs);
+	for (auto &tr : fsm_data.transition_table) {
+		std::string cube = state_cubes[tr.state_in];
+		for (int i = 0; i < fsm_data.num_inputs; i++)
+			cube += tr.ctrl_in[i] == State::S1 ? '1' : tr.ctrl_in[i] == State::S0 ? '0' : '-';
+		for (int i = 0; i < state_bits; i++)
+			if (codes[tr.state_out][i] == State::S1)
+				on_sets[i].insert(cube);
+		for (int i = 0; i < fsm_data.num_outputs; i++)
+			if (tr.ctrl_out[i] == State::S1)
+				on_sets[state_bits + i].insert(cube);
+	}
+
+	int cost = 4 * state_bits;
+	for (auto &cubes : on_sets)
+	{
+		while (1) {
+			dict<std::string, std::vector<int>> merge_groups;
+			std::vector<std::string> cube_list(cubes.begin(), cubes.end());
+			for (int i = 0; i < GetSize(cube_list); i++)
+				for (int k = 0; k < cube_width; k++)
+					if (cube_list[i][k] != '-') {
+						std::string key = cube_list[i];
+						key[k] = '-';
+						merge_groups[stringf("%d:", k) + key].push_back(i);
+					}
+
+			pool<std::string> merged;
+			std::vector<bool> used(GetSize(cube_list));
+			for (auto &it : merge_groups) {
+				if (GetSize(it.second) < 2)
+					continue;
+				std::string key = it.first.substr(it.first.find(':') + 1);
+				merged.insert(key);
+				for (int i : it.second)
+					used[i] = true;
+			}
+			if (merged.empty())
+				break;
+			for (int i = 0; i < GetSize(cube_list); i++)
+				if (!used[i])
+					merged.insert(cube_list[i]);
+			cubes.swap(merged);
+		}
+
+		for (auto &cube : cubes)
+			for (char c : cube)
+				if (c != '-')
+					cost++;
+		if (GetSize(cubes) > 1)
+			cost += GetSize(cubes);
+	}
+
+	return cost;
+}
+
+// Compare the one-hot encoding and a binary encoding improved by swapping and moving
+// state codes, and return the one with the lower estimated cost. The reset state keeps
+// the all-zero code (or the first one-hot bit).
+static FsmEncoding fsm_encoding_search(const FsmData &fsm_data)
+{
+	int num_states = GetSize(fsm_data.state_table);
+	std::vector<int> state_order;
+	int state_idx_counter = fsm_data.reset_state >= 0 ? 1 : 0;
+	for (int i = 0; i < num_states; i++)
+		state_order.push_back(fsm_data.reset_state == i ? 0 : state_idx_counter++);
+
+	FsmEncoding one_hot;
+	one_hot.encoding = "one-hot";
+	for (int i = 0; i < num_states; i++) {
+		RTLIL::Const code(RTLIL::State::Sa, num_states);
+		code.bits[state_order[i]] = RTLIL::State::S1;
+		one_hot.codes.push_back(code);
+	}
+	one_hot.cost = fsm_encoding_cost(fsm_data, one_hot.codes, true);
+
+	FsmEncoding binary;
+	binary.encoding = "binary";
+	int state_bits = ceil_log2(num_states);
+	std::vector<int> assignment = state_order;
+	auto make_codes = [&](const std::vector<int> &values) {
+		std::vector<RTLIL::Const> codes;
+		for (int v : values)
+			codes.push_back(RTLIL::Const(v, state_bits));
+		return codes;
+	};
+	binary.codes = make_codes(assignment);
+	binary.cost = fsm_encoding_cost(fsm_data, binary.codes, false);
+
+	int evaluations = 0;
+	for (bool improved = true; improved && evaluations < 5000;)
+	{
+		improved = false;
+		pool<int> used_values(assignment.begin(), assignment.end());
+		for (int i = 0; i < num_states && evaluations < 5000; i++) {
+			if (i == fsm_data.reset_state)
+				continue;
+			// swaps with the later states and moves to unused codes
+			for (int j = i+1; j < num_states + (1 << state_bits) && evaluations < 5000; j++) {
+				std::vector<int> candidate = assignment;
+				if (j < num_states) {
+					if (j == fsm_data.reset_state)
+						continue;
+					std::swap(candidate[i], candidate[j]);
+				} else {
+					int value = j - num_states;
+					if (used_values.count(value) || (fsm_data.reset_state >= 0 && value == 0))
+						continue;
+					candidate[i] = value;
+				}
+				std::vector<RTLIL::Const> codes = make_codes(candidate);
+				int cost = fsm_encoding_cost(fsm_data, codes, false);
+				evaluations++;
+				if (cost < binary.cost) {
+					assignment = candidate;
+					binary.codes = codes;
+					binary.cost = cost;
+					used_values = pool<int>(assignment.begin(), assignment.end());
+					improved = true;
+				}
+			}
+		}
+	}
+
+	return one_hot.cost <= binary.cost ? one_hot : binary;
+}
+
+static bool fsm_auto_encoded(RTLIL::Cell *cell)
+{
+	std::string encoding = cell->attributes.count(ID::fsm_encoding) ? cell->attributes.at(ID::fsm_encoding).decode_string() : "auto";
+	return encoding != "none" && encoding != "user" && encoding != "one-hot" && encoding != "binary";
+}
+
+static void fsm_recode(RTLIL::Cell *cell, RTLIL::Module *module, FILE *fm_set_fsm_file, FILE *encfile, std::string default_encoding, const FsmEncoding *searched)
 {
 	std::string encoding = cell->attributes.count(ID::fsm_encoding) ? cell->attributes.at(ID::fsm_encoding).decode_string() : "auto";
 
@@ -76,17 +245,22 @@ static void fsm_recode(RTLIL::Cell *cell, RTLIL::Module *module, FILE *fm_set_fs
 	if (encoding == "auto") {
 		if (!default_encoding.empty())
 			encoding = default_encoding;
+		else if (searched != nullptr)
+			encoding = searched->encoding;
 		else
 			encoding = GetSize(fsm_data.state_table) < 32 ? "one-hot" : "binary";
 		log("  mapping auto encoding to `%s` for this FSM.\n", encoding.c_str());
 	}
 
+	if (searched != nullptr)
+		log("  searched encoding has an estimated cost of %d.\n", searched->cost);
+
 	if (encoding == "one-hot") {
 		fsm_data.state_bits = fsm_data.state_table.size();
 	} else
 	if (encoding == "binary") {
 		int new_num_state_bits = ceil_log2(fsm_data.state_table.size());
-		if (fsm_data.state_bits == new_num_state_bits) {
+		if (fsm_data.state_bits == new_num_state_bits && searched == nullptr) {
 			log("  existing encoding is already a packed binary encoding.\n");
 			return;
 		}
@@ -103,6 +277,9 @@ static void fsm_recode(RTLIL::Cell *cell, RTLIL::Module *module, FILE *fm_set_fs
 		int state_idx = fsm_data.reset_state == i ? 0 : state_idx_counter++;
 		RTLIL::Const new_code;
 
+		if (searched != nullptr) {
+			new_code = searched->codes.at(i);
+		} else
 		if (encoding == "one-hot") {
 			new_code = RTLIL::Const(RTLIL::State::Sa, fsm_data.state_bits);
 			new_code.bits[state_idx] = RTLIL::State::S1;
@@ -139,6 +316,14 @@ struct FsmRecodePass : public Pass {
 		log("        specify the encoding scheme used for FSMs without the\n");
 		log("        'fsm_encoding' attribute or with the attribute set to `auto'.\n");
 		log("\n");
+		log("    -search\n");
+		log("        choose the encoding of FSMs with `auto' encoding by estimated gate\n");
+		log("        cost of their next-state and output logic, comparing one-hot encoding\n");
+		log("        with binary encodings found by exchanging state codes. FSMs are\n");
+		log("        searched concurrently when synthesizer runs with -j <jobs>, and the\n");
+		log("        result is reused for FSMs with the same transition table. -encoding\n");
+		log("        takes precedence over this option.\n");
+		log("\n");
 		log("    -fm_set_fsm_file <file>\n");
 		log("        generate a file containing the mapping from old to new FSM encoding\n");
 		log("        in form of Synopsys Formality set_fsm_* commands.\n");
@@ -156,6 +341,7 @@ struct FsmRecodePass : public Pass {
 		FILE *fm_set_fsm_file = NULL;
 		FILE *encfile = NULL;
 		std::string default_encoding;
+		bool search = false;
 
 		log_header(design, "Executing FSM_RECODE pass (re-assigning FSM state encoding).\n");
 		size_t argidx;
@@ -177,14 +363,50 @@ struct FsmRecodePass : public Pass {
 				default_encoding = args[++argidx];
 				continue;
 			}
+			if (arg == "-search") {
+				search = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		std::vector<std::pair<RTLIL::Cell*, RTLIL::Module*>> fsm_cells;
 		for (auto mod : design->selected_modules())
 			for (auto cell : mod->selected_cells())
 				if (cell->type == ID($fsm))
-					fsm_recode(cell, mod, fm_set_fsm_file, encfile, default_encoding);
+					fsm_cells.push_back({cell, mod});
+
+		std::vector<std::string> signatures(GetSize(fsm_cells));
+		if (search && default_encoding.empty())
+		{
+			std::vector<std::string> pending;
+			std::vector<FsmData> pending_data;
+			for (int i = 0; i < GetSize(fsm_cells); i++) {
+				if (!fsm_auto_encoded(fsm_cells[i].first))
+					continue;
+				FsmData fsm_data;
+				fsm_data.copy_from_cell(fsm_cells[i].first);
+				if (GetSize(fsm_data.state_table) < 2)
+					continue;
+				signatures[i] = fsm_signature(fsm_data);
+				if (encoding_cache.count(signatures[i]) || std::find(pending.begin(), pending.end(), signatures[i]) != pending.end())
+					continue;
+				pending.push_back(signatures[i]);
+				pending_data.push_back(fsm_data);
+			}
+
+			std::vector<FsmEncoding> results(GetSize(pending));
+			parallel_for(GetSize(pending), [&](int i) {
+				results[i] = fsm_encoding_search(pending_data[i]);
+			});
+			for (int i = 0; i < GetSize(pending); i++)
+				encoding_cache[pending[i]] = results[i];
+		}
+
+		for (int i = 0; i < GetSize(fsm_cells); i++)
+			fsm_recode(fsm_cells[i].first, fsm_cells[i].second, fm_set_fsm_file, encfile, default_encoding,
+					signatures[i].empty() ? nullptr : &encoding_cache.at(signatures[i]));
 
 		if (fm_set_fsm_file != NULL)
 			fclose(fm_set_fsm_file);
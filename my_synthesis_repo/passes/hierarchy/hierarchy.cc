@@ -19,6 +19,7 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "frontends/verific/verific.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -315,6 +316,7 @@ struct IFExpander
 		for(unsigned int i=0;i<connections_to_remove.size();i++) {
 			cell.connections_.erase(connections_to_remove[i]);
 		}
+		cell.module->notify_blackout();
 	}
 };
 
@@ -439,8 +441,93 @@ void check_cell_connections(const RTLIL::Module &module, RTLIL::Cell &cell, RTLI
 	}
 }
 
+// Key of a derive request in the derive cache shared by prederive_modules()
+// and expand_module()
+std::string derive_key(RTLIL::IdString type, const dict<RTLIL::IdString, RTLIL::Const> &parameters)
+{
+	std::string key = type.str();
+	for (auto &param : parameters)
+		key += stringf("\n%s=%d:%s", param.first.c_str(), int(param.second.flags), param.second.as_string().c_str());
+	return key;
+}
+
+// Returns true if expand_module() would derive the cell without any interface
+// handling and check_cell_connections() would not reject its parameters.
+bool plain_derive_request(const RTLIL::Cell *cell, const RTLIL::Module *mod)
+{
+	if (mod->get_blackbox_attribute() || mod->get_bool_attribute(ID::is_interface))
+		return false;
+
+	for (auto &conn : cell->connections()) {
+		const RTLIL::Wire *wire = mod->wire(conn.first);
+		if (wire && wire->get_bool_attribute(ID::is_interface))
+			return false;
+	}
+
+	int id;
+	for (auto &param : cell->parameters) {
+		if (read_id_num(param.first, &id)) {
+			if (id <= 0 || id > GetSize(mod->avail_parameters))
+				return false;
+			continue;
+		}
+		if (mod->avail_parameters.count(param.first) == 0 && param.first[0] != '$' && strchr(param.first.c_str(), '.') == NULL)
+			return false;
+	}
+	return true;
+}
+
+// Derives the parameterized modules that expand_module() is about to ask for
+// in the given modules, each distinct (module, parameters) pair once, and
+// records the results in derive_cache. The cells are collected concurrently,
+// the modules are derived one after another since the derive() implementations
+// of the frontends are not reentrant. Cells connected to interface ports are
+// left to expand_module().
+void prederive_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules, dict<std::string, RTLIL::IdString> &derive_cache)
+{
+	typedef std::pair<RTLIL::IdString, dict<RTLIL::IdString, RTLIL::Const>> request_t;
+	std::vector<std::vector<request_t>> requests(GetSize(modules));
+	dict<RTLIL::Module*, int> module_index;
+	for (int i = 0; i < GetSize(modules); i++)
+		module_index[modules[i]] = i;
+
+	const RTLIL::Design *const_design = design;
+	parallel_for_modules(design, modules, [&](RTLIL::Module *module) {
+		auto &module_requests = requests[module_index.at(module)];
+		pool<std::string> seen;
+		for (auto cell : module->cells()) {
+			if (cell->parameters.empty() || cell->type.begins_with("$array:"))
+				continue;
+			const RTLIL::Module *mod = const_design->module(cell->type);
+			if (mod == nullptr || !plain_derive_request(cell, mod))
+				continue;
+			if (seen.insert(derive_key(cell->type, cell->parameters)).second)
+				module_requests.push_back(request_t(cell->type, cell->parameters));
+		}
+	});
+
+	const dict<RTLIL::IdString, RTLIL::Module*> no_interfaces;
+	const dict<RTLIL::IdString, RTLIL::IdString> no_modports;
+	int count = 0;
+	for (auto &module_requests : requests)
+		for (auto &request : module_requests) {
+			std::string key = derive_key(request.first, request.second);
+			auto it = derive_cache.find(key);
+			if (it != derive_cache.end() && design->module(it->second) != nullptr)
+				continue;
+			RTLIL::Module *mod = design->module(request.first);
+			if (mod == nullptr)
+				continue;
+			derive_cache[key] = mod->derive(design, request.second, no_interfaces, no_modports);
+			count++;
+		}
+
+	if (count > 0)
+		log("Derived %d distinct parameterizations of modules.\n", count);
+}
+
 bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check, bool flag_simcheck, bool flag_smtcheck,
-		   std::vector<std::string> &libdirs)
+		   std::vector<std::string> &libdirs, dict<std::string, RTLIL::IdString> &derive_cache)
 {
 	bool did_something = false;
 	std::map<RTLIL::Cell*, std::pair<int, int>> array_cells;
@@ -527,10 +614,26 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 			continue;
 		}
 
-		cell->type = mod->derive(design,
-					 cell->parameters,
-					 if_expander.interfaces_to_add_to_submodule,
-					 if_expander.modports_used_in_submodule);
+		{
+			// requests without interfaces were usually derived by prederive_modules() already
+			std::string key;
+			RTLIL::IdString derived_type;
+			if (if_expander.interfaces_to_add_to_submodule.empty() && if_expander.modports_used_in_submodule.empty()) {
+				key = derive_key(cell->type, cell->parameters);
+				auto it = derive_cache.find(key);
+				if (it != derive_cache.end() && design->module(it->second) != nullptr)
+					derived_type = it->second;
+			}
+			if (derived_type.empty()) {
+				derived_type = mod->derive(design,
+							   cell->parameters,
+							   if_expander.interfaces_to_add_to_submodule,
+							   if_expander.modports_used_in_submodule);
+				if (!key.empty())
+					derive_cache[key] = derived_type;
+			}
+			cell->type = derived_type;
+		}
 		cell->parameters.clear();
 		did_something = true;
 
@@ -596,6 +699,10 @@ bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check
 		}
 	}
 
+	// the array cell ports above were narrowed in place
+	if (!array_cells.empty())
+		module->notify_blackout();
+
 	return did_something;
 }
 
@@ -800,6 +907,13 @@ struct HierarchyPass : public Pass {
 		log("       This option can be specified multiple times to override multiple\n");
 		log("       parameters. String values must be passed in double quotes (\").\n");
 		log("\n");
+		log("When the environment variable YOSYS_DERIVE_CACHE names a directory, modules\n");
+		log("derived from Verilog ASTs are also stored there in the binary RTLIL format,\n");
+		log("keyed by a hash of the AST with the parameter values applied and of the\n");
+		log("frontend options. Later runs load the derived modules from there instead of\n");
+		log("elaborating them again. Modules whose elaboration depends on other modules\n");
+		log("of the design (e.g. for port widths of submodules) are not cached.\n");
+		log("\n");
 		log("In -generate mode this pass generates blackbox modules for the given cell\n");
 		log("types (wildcards supported). For this the design is searched for cells that\n");
 		log("match the given types and then the given port declarations are used to\n");
@@ -1066,6 +1180,7 @@ struct HierarchyPass : public Pass {
 					mod->attributes.erase(ID::initial_top);
 		}
 
+		dict<std::string, RTLIL::IdString> derive_cache;
 		bool did_something = true;
 		while (did_something)
 		{
@@ -1080,8 +1195,10 @@ struct HierarchyPass : public Pass {
 					used_modules.insert(mod);
 			}
 
+			prederive_modules(design, std::vector<RTLIL::Module*>(used_modules.begin(), used_modules.end()), derive_cache);
+
 			for (auto module : used_modules) {
-				if (expand_module(design, module, flag_check, flag_simcheck, flag_smtcheck, libdirs))
+				if (expand_module(design, module, flag_check, flag_simcheck, flag_smtcheck, libdirs, derive_cache))
 					did_something = true;
 			}
 
@@ -1204,6 +1321,7 @@ struct HierarchyPass : public Pass {
 						new_connections[conn.first] = conn.second;
 				}
 				cell->connections_ = new_connections;
+				module->notify_blackout();
 			}
 		}
 
@@ -40,6 +40,10 @@ struct UniquifyPass : public Pass {
 		log("This commands only operates on modules that by themself have the 'unique'\n");
 		log("attribute set (the 'top' module is unique implicitly).\n");
 		log("\n");
+		log("The new modules share the contents of the original module until a later\n");
+		log("command accesses them, so copies that are never looked at again cost almost\n");
+		log("no memory.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -59,38 +63,74 @@ struct UniquifyPass : public Pass {
 		bool did_something = true;
 		int count = 0;
 
+		// The copies are made with add_clone(), so a module only gets its own
+		// cells and wires once a later pass asks for it. Modules are looked up
+		// in design->modules_ directly here, since the accessors would copy
+		// them just to check whether they have anything to uniquify.
+		auto peek_module = [&](RTLIL::IdString name) -> RTLIL::Module* {
+			auto it = design->modules_.find(name);
+			return it != design->modules_.end() ? it->second : nullptr;
+		};
+
+		auto needs_copy = [&](RTLIL::Module *module, RTLIL::Cell *cell) {
+			Module *tmod = peek_module(cell->type);
+			IdString newname = module->name.str() + "." + log_id(cell->name);
+
+			if (tmod == nullptr)
+				return false;
+
+			if (tmod->get_blackbox_attribute())
+				return false;
+
+			if (tmod->get_bool_attribute(ID::unique) && newname == tmod->name)
+				return false;
+
+			return true;
+		};
+
 		while (did_something)
 		{
 			did_something = false;
 
-			for (auto module : design->selected_modules())
+			std::vector<RTLIL::IdString> module_names;
+			for (auto &it : design->modules_)
+				module_names.push_back(it.first);
+
+			for (auto name : module_names)
 			{
+				RTLIL::Module *module = peek_module(name);
+				if (!design->selected_module(name) || module->get_blackbox_attribute())
+					continue;
+
 				if (!module->get_bool_attribute(ID::unique) && !module->get_bool_attribute(ID::top))
 					continue;
 
-				for (auto cell : module->selected_cells())
-				{
-					Module *tmod = design->module(cell->type);
-					IdString newname = module->name.str() + "." + log_id(cell->name);
+				bool found = false;
+				for (auto &it : module->shared_contents()->cells_)
+					if (design->selected_member(name, it.first) && needs_copy(module, it.second)) {
+						found = true;
+						break;
+					}
+				if (!found)
+					continue;
 
-					if (tmod == nullptr)
-						continue;
+				module = design->module(name);
 
-					if (tmod->get_blackbox_attribute())
+				for (auto cell : module->selected_cells())
+				{
+					if (!needs_copy(module, cell))
 						continue;
 
-					if (tmod->get_bool_attribute(ID::unique) && newname == tmod->name)
-						continue;
+					Module *tmod = peek_module(cell->type);
+					IdString newname = module->name.str() + "." + log_id(cell->name);
 
 					log("Creating module %s from %s.\n", log_id(newname), log_id(tmod));
 
-					auto smod = tmod->clone();
-					smod->name = newname;
+					auto smod = design->add_clone(tmod, newname);
 					cell->type = newname;
 					smod->set_bool_attribute(ID::unique);
 					if (smod->attributes.count(ID::hdlname) == 0)
 						smod->attributes[ID::hdlname] = string(log_id(tmod->name));
-					design->add(smod);
 
 					did_something = true;
 					count++;
@@ -18,6 +18,7 @@
  */
 
 #include "memlib.h"
+#include "libs/sha1/sha1.h"
 
 #include <ctype.h>
 
@@ -1147,13 +1148,360 @@ struct Parser {
 	}
 };
 
+// The rams and the names of the defines checked by each library file, keyed by
+// the SHA1 of the file content and the -D set. They are kept for the lifetime of
+// the process, so that repeated memory_libmap calls (as in synth_xilinx) parse
+// every file once, and stored in the YOSYS_MEMLIB_CACHE directory as a binary
+// file for later runs. This also saves decoding the bundled .pb libraries.
+struct LibraryCacheEntry {
+	std::vector<Ram> rams;
+	pool<std::string> checked_defines;
+};
+
+static dict<std::string, LibraryCacheEntry> library_cache;
+
+static const char memlib_cache_magic[] = "YSMEMLIB 1\n";
+
+// the files are parsed every time while they are serialized to .pb
+#if SERIALIZE_STATIC_FILES
+static const bool library_cache_enabled = false;
+#else
+static const bool library_cache_enabled = true;
+#endif
+
+struct CacheWriter {
+	std::string buf;
+
+	void write_int(int val) {
+		buf.append(reinterpret_cast<const char*>(&val), sizeof(val));
+	}
+
+	void write_double(double val) {
+		buf.append(reinterpret_cast<const char*>(&val), sizeof(val));
+	}
+
+	void write_string(const std::string &str) {
+		write_int(GetSize(str));
+		buf += str;
+	}
+
+	void write_const(const Const &val) {
+		write_int(val.flags);
+		write_int(GetSize(val.bits));
+		for (auto bit : val.bits)
+			buf += char(bit);
+	}
+
+	void write_options(const dict<std::string, Const> &options) {
+		write_int(GetSize(options));
+		for (auto &it : options) {
+			write_string(it.first);
+			write_const(it.second);
+		}
+	}
+
+	void write_ints(const std::vector<int> &vals) {
+		write_int(GetSize(vals));
+		for (int val : vals)
+			write_int(val);
+	}
+
+	void write_strings(const std::vector<std::string> &strs) {
+		write_int(GetSize(strs));
+		for (auto &str : strs)
+			write_string(str);
+	}
+
+	void write_variant(const PortVariant &var) {
+		write_options(var.options);
+		write_ints({int(var.kind), var.clk_shared, int(var.clk_pol), var.clk_en, var.width_tied,
+				var.min_wr_wide_log2, var.max_wr_wide_log2, var.min_rd_wide_log2, var.max_rd_wide_log2,
+				var.rd_en, int(var.rdwr), int(var.rdinitval), int(var.rdarstval), int(var.rdsrstval),
+				int(var.rdsrstmode), var.rdsrst_block_wr, var.wrbe_separate});
+		write_ints(var.wrprio);
+		write_int(GetSize(var.wrtrans));
+		for (auto &trans : var.wrtrans)
+			write_ints({int(trans.target_kind), trans.target_group, int(trans.kind)});
+	}
+
+	void write_ram(const Ram &ram) {
+		write_string(ram.id.str());
+		write_int(int(ram.kind));
+		write_options(ram.options);
+		write_int(GetSize(ram.port_groups));
+		for (auto &pg : ram.port_groups) {
+			write_ints({pg.optional, pg.optional_rw});
+			write_strings(pg.names);
+			write_int(GetSize(pg.variants));
+			for (auto &var : pg.variants)
+				write_variant(var);
+		}
+		write_ints({ram.prune_rom, ram.abits, int(ram.width_mode), ram.resource_count, ram.byte, int(ram.init)});
+		write_ints(ram.dbits);
+		write_string(ram.resource_name);
+		write_double(ram.cost);
+		write_double(ram.widthscale);
+		write_strings(ram.style);
+		write_int(GetSize(ram.shared_clocks));
+		for (auto &clk : ram.shared_clocks) {
+			write_string(clk.name);
+			write_int(clk.anyedge);
+		}
+	}
+};
+
+struct CacheReader {
+	const std::string &buf;
+	size_t pos = 0;
+	bool fail = false;
+
+	CacheReader(const std::string &buf, size_t pos) : buf(buf), pos(pos) {}
+
+	template<typename T> T read_raw() {
+		T val = T();
+		if (pos + sizeof(T) > buf.size()) {
+			fail = true;
+			return val;
+		}
+		memcpy(&val, buf.data() + pos, sizeof(T));
+		pos += sizeof(T);
+		return val;
+	}
+
+	int read_int() { return read_raw<int>(); }
+	double read_double() { return read_raw<double>(); }
+
+	int read_size() {
+		int size = read_int();
+		if (size < 0 || size_t(size) > buf.size() - pos)
+			fail = true;
+		return fail ? 0 : size;
+	}
+
+	std::string read_string() {
+		int size = read_size();
+		std::string str = buf.substr(pos, size);
+		pos += size;
+		return str;
+	}
+
+	Const read_const() {
+		Const val;
+		val.flags = read_int();
+		int size = read_size();
+		for (int i = 0; i < size; i++)
+			val.bits.push_back(State(buf[pos++]));
+		return val;
+	}
+
+	dict<std::string, Const> read_options() {
+		dict<std::string, Const> options;
+		int size = read_size();
+		for (int i = 0; i < size; i++) {
+			std::string name = read_string();
+			options[name] = read_const();
+		}
+		return options;
+	}
+
+	std::vector<int> read_ints() {
+		std::vector<int> vals;
+		int size = read_size();
+		for (int i = 0; i < size && !fail; i++)
+			vals.push_back(read_int());
+		return vals;
+	}
+
+	std::vector<std::string> read_strings() {
+		std::vector<std::string> strs;
+		int size = read_size();
+		for (int i = 0; i < size && !fail; i++)
+			strs.push_back(read_string());
+		return strs;
+	}
+
+	std::vector<int> read_fields(int count) {
+		std::vector<int> vals = read_ints();
+		if (GetSize(vals) != count) {
+			fail = true;
+			vals.resize(count);
+		}
+		return vals;
+	}
+
+	PortVariant read_variant() {
+		PortVariant var;
+		var.options = read_options();
+		std::vector<int> f = read_fields(17);
+		var.kind = PortKind(f[0]);
+		var.clk_shared = f[1];
+		var.clk_pol = ClkPolKind(f[2]);
+		var.clk_en = f[3];
+		var.width_tied = f[4];
+		var.min_wr_wide_log2 = f[5];
+		var.max_wr_wide_log2 = f[6];
+		var.min_rd_wide_log2 = f[7];
+		var.max_rd_wide_log2 = f[8];
+		var.rd_en = f[9];
+		var.rdwr = RdWrKind(f[10]);
+		var.rdinitval = ResetValKind(f[11]);
+		var.rdarstval = ResetValKind(f[12]);
+		var.rdsrstval = ResetValKind(f[13]);
+		var.rdsrstmode = SrstKind(f[14]);
+		var.rdsrst_block_wr = f[15];
+		var.wrbe_separate = f[16];
+		var.wrprio = read_ints();
+		int num_trans = read_size();
+		for (int i = 0; i < num_trans && !fail; i++) {
+			std::vector<int> t = read_fields(3);
+			var.wrtrans.push_back({WrTransTargetKind(t[0]), t[1], WrTransKind(t[2])});
+		}
+		return var;
+	}
+
+	Ram read_ram() {
+		Ram ram;
+		std::string id = read_string();
+		if (id.empty() || (id[0] != '$' && id[0] != '\\')) {
+			fail = true;
+			return ram;
+		}
+		ram.id = IdString(id);
+		ram.kind = RamKind(read_int());
+		ram.options = read_options();
+		int num_groups = read_size();
+		for (int i = 0; i < num_groups && !fail; i++) {
+			PortGroup pg;
+			std::vector<int> f = read_fields(2);
+			pg.optional = f[0];
+			pg.optional_rw = f[1];
+			pg.names = read_strings();
+			int num_variants = read_size();
+			for (int j = 0; j < num_variants && !fail; j++)
+				pg.variants.push_back(read_variant());
+			ram.port_groups.push_back(pg);
+		}
+		std::vector<int> f = read_fields(6);
+		ram.prune_rom = f[0];
+		ram.abits = f[1];
+		ram.width_mode = WidthMode(f[2]);
+		ram.resource_count = f[3];
+		ram.byte = f[4];
+		ram.init = MemoryInitKind(f[5]);
+		ram.dbits = read_ints();
+		ram.resource_name = read_string();
+		ram.cost = read_double();
+		ram.widthscale = read_double();
+		ram.style = read_strings();
+		int num_clocks = read_size();
+		for (int i = 0; i < num_clocks && !fail; i++) {
+			RamClock clk;
+			clk.name = read_string();
+			clk.anyedge = read_int();
+			ram.shared_clocks.push_back(clk);
+		}
+		return ram;
+	}
+};
+
+static bool read_library_cache(const std::string &filename, LibraryCacheEntry &entry)
+{
+	std::ifstream f(filename.c_str(), std::ifstream::binary);
+	if (f.fail())
+		return false;
+	std::string buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	if (buf.compare(0, strlen(memlib_cache_magic), memlib_cache_magic) != 0)
+		return false;
+
+	CacheReader reader(buf, strlen(memlib_cache_magic));
+	LibraryCacheEntry new_entry;
+	int num_rams = reader.read_size();
+	for (int i = 0; i < num_rams && !reader.fail; i++)
+		new_entry.rams.push_back(reader.read_ram());
+	for (auto &name : reader.read_strings())
+		new_entry.checked_defines.insert(name);
+
+	if (reader.fail || reader.pos != buf.size()) {
+		log_warning("Ignoring corrupt memory library cache file `%s'.\n", filename.c_str());
+		return false;
+	}
+
+	entry = std::move(new_entry);
+	return true;
+}
+
+static void write_library_cache(const std::string &filename, const LibraryCacheEntry &entry)
+{
+	CacheWriter writer;
+	writer.buf = memlib_cache_magic;
+	writer.write_int(GetSize(entry.rams));
+	for (auto &ram : entry.rams)
+		writer.write_ram(ram);
+	writer.write_strings(std::vector<std::string>(entry.checked_defines.begin(), entry.checked_defines.end()));
+
+	// same write-then-rename scheme as the DFF mapping cache
+#ifdef _WIN32
+	int pid = GetCurrentProcessId();
+#else
+	int pid = getpid();
+#endif
+	std::string tmp_fn = stringf("%s.%d.tmp", filename.c_str(), pid);
+	std::ofstream f(tmp_fn.c_str(), std::ofstream::binary);
+	if (f.fail())
+		return;
+	f << writer.buf;
+	f.close();
+	if (f.fail() || rename(tmp_fn.c_str(), filename.c_str()) != 0)
+		remove(tmp_fn.c_str());
+}
+
 PRIVATE_NAMESPACE_END
 
 Library MemLibrary::parse_library(const std::vector<std::string> &filenames, const pool<std::string> &defines) {
 	Library res;
 	pool<std::string> defines_unused = defines;
+
+	std::vector<std::string> sorted_defines(defines.begin(), defines.end());
+	std::sort(sorted_defines.begin(), sorted_defines.end());
+	const char *cache_dir = getenv("YOSYS_MEMLIB_CACHE");
+
 	for (auto &file: filenames) {
-		Parser(file, res, defines, defines_unused);
+		std::string path = file;
+		rewrite_filename(path);
+		std::ifstream f(path.c_str(), std::ifstream::binary);
+		if (f.fail())
+			log_error("failed to open %s\n", path.c_str());
+		std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+		f.close();
+
+		std::string cache_key = sha1(content);
+		for (auto &def : sorted_defines)
+			cache_key += "\n" + def;
+
+		auto cached = library_cache_enabled ? library_cache.find(cache_key) : library_cache.end();
+		if (cached == library_cache.end()) {
+			std::string cache_fn;
+			if (library_cache_enabled && cache_dir != nullptr && cache_dir[0] != 0)
+				cache_fn = stringf("%s/%s.yml", cache_dir, sha1(cache_key).c_str());
+			LibraryCacheEntry entry;
+			if (cache_fn.empty() || !read_library_cache(cache_fn, entry)) {
+				Library file_lib;
+				pool<std::string> file_unused = defines;
+				Parser(file, file_lib, defines, file_unused);
+				entry.rams = std::move(file_lib.rams);
+				for (auto &def : defines)
+					if (!file_unused.count(def))
+						entry.checked_defines.insert(def);
+				if (!cache_fn.empty())
+					write_library_cache(cache_fn, entry);
+			}
+			library_cache[cache_key] = std::move(entry);
+			cached = library_cache.find(cache_key);
+		}
+
+		res.rams.insert(res.rams.end(), cached->second.rams.begin(), cached->second.rams.end());
+		for (auto &def : cached->second.checked_defines)
+			defines_unused.erase(def);
 	}
 	for (auto def: defines_unused) {
 		log_warning("define %s not used in the library.\n", def.c_str());
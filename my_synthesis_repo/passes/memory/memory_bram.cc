@@ -135,9 +135,30 @@ struct rules_t
 		vector<vector<std::tuple<bool,IdString,Const>>> attributes;
 	};
 
+	// One entry for every variant of every match rule, in the order they are
+	// tried.  A match without a bram description gets a single entry with
+	// bram set to nullptr, so that the error is raised only when reached.
+	struct entry_t {
+		int match_idx, variant_idx;
+		const bram_t *bram;
+		bool or_next_if_better;
+		int avail_rd_ports, avail_wr_ports;
+	};
+
+	// The outcome of the checks in check_rule() for one entry, which only
+	// depend on the properties of the memory and the attributes referenced
+	// by match rules.
+	struct result_t {
+		bool checked = false;
+		bool accepted = false;
+		dict<string, int> properties;
+	};
+
 	bool attr_icase;
 	dict<IdString, vector<bram_t>> brams;
 	vector<match_t> matches;
+	vector<entry_t> table;
+	pool<IdString> match_attributes;
 
 	std::string map_case(std::string value) const
 	{
@@ -395,9 +416,66 @@ struct rules_t
 		}
 
 		infile.close();
+		compile();
+	}
+
+	void compile()
+	{
+		table.clear();
+		match_attributes.clear();
+
+		for (int i = 0; i < GetSize(matches); i++)
+		{
+			auto &match = matches.at(i);
+			for (auto &sums : match.attributes)
+				for (auto &term : sums)
+					match_attributes.insert(std::get<1>(term));
+
+			if (!brams.count(match.name)) {
+				table.push_back(entry_t{i, 0, nullptr, false, 0, 0});
+				continue;
+			}
+
+			for (int vi = 0; vi < GetSize(brams.at(match.name)); vi++)
+			{
+				auto &bram = brams.at(match.name).at(vi);
+				entry_t entry;
+				entry.match_idx = i;
+				entry.variant_idx = vi;
+				entry.bram = &bram;
+				entry.or_next_if_better = match.or_next_if_better || vi+1 < GetSize(brams.at(match.name));
+				entry.avail_rd_ports = 0;
+				entry.avail_wr_ports = 0;
+				for (int j = 0; j < bram.groups; j++) {
+					if (GetSize(bram.wrmode) < j || bram.wrmode.at(j) == 0)
+						entry.avail_rd_ports += GetSize(bram.ports) < j ? bram.ports.at(j) : 0;
+					if (GetSize(bram.wrmode) < j || bram.wrmode.at(j) != 0)
+						entry.avail_wr_ports += GetSize(bram.ports) < j ? bram.ports.at(j) : 0;
+				}
+				table.push_back(entry);
+			}
+		}
+	}
+
+	// Returns a key for all memory properties that check_rule() looks at.
+	string shape_key(const Mem &mem) const
+	{
+		string key = stringf("%d %d %d %d %d", mem.size, mem.width, GetSize(mem.wr_ports), GetSize(mem.rd_ports), !mem.inits.empty());
+		for (auto name : match_attributes) {
+			auto it = mem.attributes.find(name);
+			if (it == mem.attributes.end())
+				key += " -";
+			else
+				key += " =" + map_case(it->second).as_string();
+		}
+		return key;
 	}
 };
 
+// Results of check_rule() for every entry of the rules table, by
+// rules_t::shape_key().
+typedef dict<string, vector<rules_t::result_t>> shape_cache_t;
+
 bool replace_memory(Mem &mem, const rules_t &rules, FfInitVals *initvals, const rules_t::bram_t &bram, const rules_t::match_t &match, dict<string, int> &match_properties, int mode)
 {
 	Module *module = mem.module;
@@ -1002,7 +1080,115 @@ grow_read_ports:;
 	return true;
 }
 
-void handle_memory(Mem &mem, const rules_t &rules, FfInitVals *initvals)
+// Computes the properties of a memory for one entry of the rules table
+// and checks them against the limits and attribute requirements of its
+// match rule.
+static bool check_rule(const Mem &mem, const rules_t &rules, const rules_t::entry_t &entry, bool cell_init, dict<string, int> &props)
+{
+	int i = entry.match_idx;
+	auto &match = rules.matches.at(i);
+	auto &bram = *entry.bram;
+
+	int dups = entry.avail_rd_ports ? (props["rports"] + entry.avail_rd_ports - 1) / entry.avail_rd_ports : 1;
+	props["dups"] = dups;
+
+	log("    Estimated number of duplicates for more read ports: dups=%d\n", props["dups"]);
+
+	int aover = props["words"] % (1 << bram.abits);
+	int awaste = aover ? (1 << bram.abits) - aover : 0;
+	props["awaste"] = awaste;
+
+	int dover = props["dbits"] % bram.dbits;
+	int dwaste = dover ? bram.dbits - dover : 0;
+	props["dwaste"] = dwaste;
+
+	int bwaste = awaste * bram.dbits + dwaste * (1 << bram.abits) - awaste * dwaste;
+	props["bwaste"] = bwaste;
+
+	int waste = props["dups"] * bwaste;
+	props["waste"] = waste;
+
+	int cells = ((props["dbits"] + bram.dbits - 1) / bram.dbits) * ((props["words"] + (1 << bram.abits) - 1) / (1 << bram.abits));
+	int efficiency = (100 * props["bits"]) / (dups * cells * bram.dbits * (1 << bram.abits));
+	props["efficiency"] = efficiency;
+
+	log("    Metrics for %s: awaste=%d dwaste=%d bwaste=%d waste=%d efficiency=%d\n",
+			log_id(match.name), awaste, dwaste, bwaste, waste, efficiency);
+
+	if (cell_init && bram.init == 0) {
+		log("    Rule #%d for bram type %s (variant %d) rejected: cannot be initialized.\n",
+				i+1, log_id(bram.name), bram.variant);
+		return false;
+	}
+
+	for (auto it : match.min_limits) {
+		if (it.first == "waste" || it.first == "dups" || it.first == "acells" || it.first == "dcells" || it.first == "cells")
+			continue;
+		if (!props.count(it.first))
+			log_error("Unknown property '%s' in match rule for bram type %s.\n",
+					it.first.c_str(), log_id(match.name));
+		if (props[it.first] >= it.second)
+			continue;
+		log("    Rule #%d for bram type %s (variant %d) rejected: requirement 'min %s %d' not met.\n",
+				i+1, log_id(bram.name), bram.variant, it.first.c_str(), it.second);
+		return false;
+	}
+
+	for (auto it : match.max_limits) {
+		if (it.first == "acells" || it.first == "dcells" || it.first == "cells")
+			continue;
+		if (!props.count(it.first))
+			log_error("Unknown property '%s' in match rule for bram type %s.\n",
+					it.first.c_str(), log_id(match.name));
+		if (props[it.first] <= it.second)
+			continue;
+		log("    Rule #%d for bram type %s (variant %d) rejected: requirement 'max %s %d' not met.\n",
+				i+1, log_id(bram.name), bram.variant, it.first.c_str(), it.second);
+		return false;
+	}
+
+	for (const auto &sums : match.attributes) {
+		bool found = false;
+		for (const auto &term : sums) {
+			bool exists = std::get<0>(term);
+			IdString key = std::get<1>(term);
+			const Const &value = std::get<2>(term);
+			auto it = mem.attributes.find(key);
+			if (it == mem.attributes.end()) {
+				if (exists)
+					continue;
+				found = true;
+				break;
+			}
+			else if (!exists)
+				continue;
+			if (rules.map_case(it->second) != value)
+				continue;
+			found = true;
+			break;
+		}
+		if (!found) {
+			std::stringstream ss;
+			bool exists = std::get<0>(sums.front());
+			if (!exists)
+				ss << "!";
+			IdString key = std::get<1>(sums.front());
+			ss << log_id(key);
+			const Const &value = rules.map_case(std::get<2>(sums.front()));
+			if (exists && value != Const(1))
+				ss << "=\"" << value.decode_string() << "\"";
+
+			log("    Rule for bram type %s (variant %d) rejected: requirement 'attribute %s ...' not met.\n",
+					log_id(bram.name), bram.variant, ss.str().c_str());
+			return false;
+		}
+	}
+
+	log("    Rule #%d for bram type %s (variant %d) accepted.\n", i+1, log_id(bram.name), bram.variant);
+	return true;
+}
+
+void handle_memory(Mem &mem, const rules_t &rules, shape_cache_t &shape_cache, FfInitVals *initvals)
 {
 	log("Processing %s.%s:\n", log_id(mem.module), log_id(mem.memid));
 	mem.narrow();
@@ -1026,174 +1212,84 @@ void handle_memory(Mem &mem, const rules_t &rules, FfInitVals *initvals)
 	pool<pair<IdString, int>> failed_brams;
 	dict<pair<int, int>, tuple<int, int, int>> best_rule_cache;
 
-	for (int i = 0; i < GetSize(rules.matches); i++)
+	auto &results = shape_cache[rules.shape_key(mem)];
+	if (!results.empty())
+		log("  Reusing rule checks of an earlier memory with the same properties.\n");
+	results.resize(GetSize(rules.table));
+
+	for (int k = 0; k < GetSize(rules.table); k++)
 	{
+		auto &entry = rules.table.at(k);
+		int i = entry.match_idx, vi = entry.variant_idx;
 		auto &match = rules.matches.at(i);
 
-		if (!rules.brams.count(rules.matches[i].name))
-			log_error("No bram description for resource %s found!\n", log_id(rules.matches[i].name));
+		if (entry.bram == nullptr)
+			log_error("No bram description for resource %s found!\n", log_id(match.name));
 
-		for (int vi = 0; vi < GetSize(rules.brams.at(match.name)); vi++)
-		{
-			auto &bram = rules.brams.at(match.name).at(vi);
-			bool or_next_if_better = match.or_next_if_better || vi+1 < GetSize(rules.brams.at(match.name));
-
-			int avail_rd_ports = 0;
-			int avail_wr_ports = 0;
-			for (int j = 0; j < bram.groups; j++) {
-				if (GetSize(bram.wrmode) < j || bram.wrmode.at(j) == 0)
-					avail_rd_ports += GetSize(bram.ports) < j ? bram.ports.at(j) : 0;
-				if (GetSize(bram.wrmode) < j || bram.wrmode.at(j) != 0)
-					avail_wr_ports += GetSize(bram.ports) < j ? bram.ports.at(j) : 0;
-			}
+		auto &bram = *entry.bram;
+		bool or_next_if_better = entry.or_next_if_better;
+		auto &result = results.at(k);
 
+		if (!result.checked) {
 			log("  Checking rule #%d for bram type %s (variant %d):\n", i+1, log_id(bram.name), bram.variant);
-			log("    Bram geometry: abits=%d dbits=%d wports=%d rports=%d\n", bram.abits, bram.dbits, avail_wr_ports, avail_rd_ports);
-
-			int dups = avail_rd_ports ? (match_properties["rports"] + avail_rd_ports - 1) / avail_rd_ports : 1;
-			match_properties["dups"] = dups;
-
-			log("    Estimated number of duplicates for more read ports: dups=%d\n", match_properties["dups"]);
-
-			int aover = match_properties["words"] % (1 << bram.abits);
-			int awaste = aover ? (1 << bram.abits) - aover : 0;
-			match_properties["awaste"] = awaste;
-
-			int dover = match_properties["dbits"] % bram.dbits;
-			int dwaste = dover ? bram.dbits - dover : 0;
-			match_properties["dwaste"] = dwaste;
-
-			int bwaste = awaste * bram.dbits + dwaste * (1 << bram.abits) - awaste * dwaste;
-			match_properties["bwaste"] = bwaste;
-
-			int waste = match_properties["dups"] * bwaste;
-			match_properties["waste"] = waste;
+			log("    Bram geometry: abits=%d dbits=%d wports=%d rports=%d\n", bram.abits, bram.dbits, entry.avail_wr_ports, entry.avail_rd_ports);
+			result.properties = match_properties;
+			result.accepted = check_rule(mem, rules, entry, cell_init, result.properties);
+			result.checked = true;
+		}
 
-			int cells = ((match_properties["dbits"] + bram.dbits - 1) / bram.dbits) * ((match_properties["words"] + (1 << bram.abits) - 1) / (1 << bram.abits));
-			int efficiency = (100 * match_properties["bits"]) / (dups * cells * bram.dbits * (1 << bram.abits));
-			match_properties["efficiency"] = efficiency;
+		for (auto &it : result.properties)
+			match_properties[it.first] = it.second;
 
-			if (failed_brams.count(pair<IdString, int>(bram.name, bram.variant)))
-				goto next_match_rule;
+		if (failed_brams.count(pair<IdString, int>(bram.name, bram.variant)))
+			goto next_match_rule;
 
-			log("    Metrics for %s: awaste=%d dwaste=%d bwaste=%d waste=%d efficiency=%d\n",
-					log_id(match.name), awaste, dwaste, bwaste, waste, efficiency);
+		if (!result.accepted)
+			goto next_match_rule;
 
-			if (cell_init && bram.init == 0) {
-				log("    Rule #%d for bram type %s (variant %d) rejected: cannot be initialized.\n",
-						i+1, log_id(bram.name), bram.variant);
-				goto next_match_rule;
-			}
-
-			for (auto it : match.min_limits) {
-				if (it.first == "waste" || it.first == "dups" || it.first == "acells" || it.first == "dcells" || it.first == "cells")
-					continue;
-				if (!match_properties.count(it.first))
-					log_error("Unknown property '%s' in match rule for bram type %s.\n",
-							it.first.c_str(), log_id(match.name));
-				if (match_properties[it.first] >= it.second)
-					continue;
-				log("    Rule #%d for bram type %s (variant %d) rejected: requirement 'min %s %d' not met.\n",
-						i+1, log_id(bram.name), bram.variant, it.first.c_str(), it.second);
-				goto next_match_rule;
-			}
+		if (or_next_if_better || !best_rule_cache.empty())
+		{
+			if (or_next_if_better && i+1 == GetSize(rules.matches) && vi+1 == GetSize(rules.brams.at(match.name)))
+				log_error("Found 'or_next_if_better' in last match rule.\n");
 
-			for (auto it : match.max_limits) {
-				if (it.first == "acells" || it.first == "dcells" || it.first == "cells")
-					continue;
-				if (!match_properties.count(it.first))
-					log_error("Unknown property '%s' in match rule for bram type %s.\n",
-							it.first.c_str(), log_id(match.name));
-				if (match_properties[it.first] <= it.second)
-					continue;
-				log("    Rule #%d for bram type %s (variant %d) rejected: requirement 'max %s %d' not met.\n",
-						i+1, log_id(bram.name), bram.variant, it.first.c_str(), it.second);
+			if (!replace_memory(mem, rules, initvals, bram, match, match_properties, 1)) {
+				log("    Mapping to bram type %s failed.\n", log_id(match.name));
+				failed_brams.insert(pair<IdString, int>(bram.name, bram.variant));
 				goto next_match_rule;
 			}
 
-			for (const auto &sums : match.attributes) {
-				bool found = false;
-				for (const auto &term : sums) {
-					bool exists = std::get<0>(term);
-					IdString key = std::get<1>(term);
-					const Const &value = std::get<2>(term);
-					auto it = mem.attributes.find(key);
-					if (it == mem.attributes.end()) {
-						if (exists)
-							continue;
-						found = true;
-						break;
-					}
-					else if (!exists)
-						continue;
-					if (rules.map_case(it->second) != value)
-						continue;
-					found = true;
-					break;
-				}
-				if (!found) {
-					std::stringstream ss;
-					bool exists = std::get<0>(sums.front());
-					if (!exists)
-						ss << "!";
-					IdString key = std::get<1>(sums.front());
-					ss << log_id(key);
-					const Const &value = rules.map_case(std::get<2>(sums.front()));
-					if (exists && value != Const(1))
-						ss << "=\"" << value.decode_string() << "\"";
-
-					log("    Rule for bram type %s (variant %d) rejected: requirement 'attribute %s ...' not met.\n",
-							log_id(bram.name), bram.variant, ss.str().c_str());
-					goto next_match_rule;
-				}
-			}
-
-			log("    Rule #%d for bram type %s (variant %d) accepted.\n", i+1, log_id(bram.name), bram.variant);
-
-			if (or_next_if_better || !best_rule_cache.empty())
-			{
-				if (or_next_if_better && i+1 == GetSize(rules.matches) && vi+1 == GetSize(rules.brams.at(match.name)))
-					log_error("Found 'or_next_if_better' in last match rule.\n");
-
-				if (!replace_memory(mem, rules, initvals, bram, match, match_properties, 1)) {
-					log("    Mapping to bram type %s failed.\n", log_id(match.name));
-					failed_brams.insert(pair<IdString, int>(bram.name, bram.variant));
-					goto next_match_rule;
-				}
-
-				log("      Storing for later selection.\n");
-				best_rule_cache[pair<int, int>(i, vi)] = tuple<int, int, int>(match_properties["efficiency"], -match_properties["cells"], -match_properties["acells"]);
+			log("      Storing for later selection.\n");
+			best_rule_cache[pair<int, int>(i, vi)] = tuple<int, int, int>(match_properties["efficiency"], -match_properties["cells"], -match_properties["acells"]);
 
 		next_match_rule:
-				if (or_next_if_better || best_rule_cache.empty())
-					continue;
-
-				log("  Selecting best of %d rules:\n", GetSize(best_rule_cache));
-				pair<int, int> best_rule = best_rule_cache.begin()->first;
-
-				for (auto &it : best_rule_cache) {
-					if (it.second > best_rule_cache[best_rule])
-						best_rule = it.first;
-					log("    Efficiency for rule %d.%d: efficiency=%d, cells=%d, acells=%d\n", it.first.first+1, it.first.second+1,
-							std::get<0>(it.second), -std::get<1>(it.second), -std::get<2>(it.second));
-				}
+			if (or_next_if_better || best_rule_cache.empty())
+				continue;
 
-				log("    Selected rule %d.%d with efficiency %d.\n", best_rule.first+1, best_rule.second+1, std::get<0>(best_rule_cache[best_rule]));
-				best_rule_cache.clear();
+			log("  Selecting best of %d rules:\n", GetSize(best_rule_cache));
+			pair<int, int> best_rule = best_rule_cache.begin()->first;
 
-				auto &best_bram = rules.brams.at(rules.matches.at(best_rule.first).name).at(best_rule.second);
-				if (!replace_memory(mem, rules, initvals, best_bram, rules.matches.at(best_rule.first), match_properties, 2))
-					log_error("Mapping to bram type %s (variant %d) after pre-selection failed.\n", log_id(best_bram.name), best_bram.variant);
-				return;
+			for (auto &it : best_rule_cache) {
+				if (it.second > best_rule_cache[best_rule])
+					best_rule = it.first;
+				log("    Efficiency for rule %d.%d: efficiency=%d, cells=%d, acells=%d\n", it.first.first+1, it.first.second+1,
+						std::get<0>(it.second), -std::get<1>(it.second), -std::get<2>(it.second));
 			}
 
-			if (!replace_memory(mem, rules, initvals, bram, match, match_properties, 0)) {
-				log("    Mapping to bram type %s failed.\n", log_id(match.name));
-				failed_brams.insert(pair<IdString, int>(bram.name, bram.variant));
-				goto next_match_rule;
-			}
+			log("    Selected rule %d.%d with efficiency %d.\n", best_rule.first+1, best_rule.second+1, std::get<0>(best_rule_cache[best_rule]));
+			best_rule_cache.clear();
+
+			auto &best_bram = rules.brams.at(rules.matches.at(best_rule.first).name).at(best_rule.second);
+			if (!replace_memory(mem, rules, initvals, best_bram, rules.matches.at(best_rule.first), match_properties, 2))
+				log_error("Mapping to bram type %s (variant %d) after pre-selection failed.\n", log_id(best_bram.name), best_bram.variant);
 			return;
 		}
+
+		if (!replace_memory(mem, rules, initvals, bram, match, match_properties, 0)) {
+			log("    Mapping to bram type %s failed.\n", log_id(match.name));
+			failed_brams.insert(pair<IdString, int>(bram.name, bram.variant));
+			goto next_match_rule;
+		}
+		return;
 	}
 
 	log("  No acceptable bram resources found.\n");
@@ -1320,11 +1416,12 @@ struct MemoryBramPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		shape_cache_t shape_cache;
 		for (auto mod : design->selected_modules()) {
 			SigMap sigmap(mod);
 			FfInitVals initvals(&sigmap, mod);
 			for (auto &mem : Mem::get_selected_memories(mod))
-				handle_memory(mem, rules, &initvals);
+				handle_memory(mem, rules, shape_cache, &initvals);
 		}
 	}
 } MemoryBramPass;
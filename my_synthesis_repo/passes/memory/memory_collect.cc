@@ -42,6 +42,10 @@ struct MemoryCollectPass : public Pass {
 			if (module->has_processes_warn())
 				continue;
 
+			// only RTLIL::Memory based memories need packing, $mem_v2 cells already are
+			if (module->memories.empty())
+				continue;
+
 			for (auto &mem : Mem::get_selected_memories(module)) {
 				if (!mem.packed) {
 					mem.packed = true;
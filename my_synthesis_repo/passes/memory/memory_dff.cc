@@ -604,10 +604,11 @@ struct MemoryDffWorker
 		log("merged address FF to cell.\n");
 	}
 
-	void run()
+	void run(std::vector<Mem> &memories)
 	{
-		std::vector<Mem> memories = Mem::get_selected_memories(module);
 		for (auto &mem : memories) {
+			if (!has_async_rd_port(mem))
+				continue;
 			QuickConeSat qcsat(modwalker);
 			for (int i = 0; i < GetSize(mem.rd_ports); i++) {
 				if (!mem.rd_ports[i].clk_enable)
@@ -621,6 +622,14 @@ struct MemoryDffWorker
 			}
 		}
 	}
+
+	static bool has_async_rd_port(const Mem &mem)
+	{
+		for (auto &port : mem.rd_ports)
+			if (!port.clk_enable)
+				return true;
+		return false;
+	}
 };
 
 struct MemoryDffPass : public Pass {
@@ -657,8 +666,16 @@ struct MemoryDffPass : public Pass {
 		extra_args(args, argidx, design);
 
 		for (auto mod : design->selected_modules()) {
+			// the worker's module indexes are only built for modules with something to merge
+			std::vector<Mem> memories = Mem::get_selected_memories(mod);
+			bool found = false;
+			for (auto &mem : memories)
+				found |= MemoryDffWorker::has_async_rd_port(mem);
+			if (!found)
+				continue;
+
 			MemoryDffWorker worker(mod, flag_no_rw_check);
-			worker.run();
+			worker.run(memories);
 		}
 	}
 } MemoryDffPass;
@@ -25,6 +25,9 @@
 #include "kernel/sigtools.h"
 #include "kernel/mem.h"
 #include "kernel/qcsat.h"
+#include "kernel/threading.h"
+#include <limits>
+#include <mutex>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -129,8 +132,29 @@ struct MemConfig {
 
 typedef std::vector<MemConfig> MemConfigs;
 
+// The geometry chosen by handle_geom() for one config.  It only depends on the
+// shape of the memory and the config, so it is shared between memories of the
+// same shape.
+struct MemGeometry {
+	int base_width_log2;
+	int unit_width_log2;
+	std::vector<int> swizzle;
+	int hard_wide_mask;
+	int emu_wide_mask;
+	int repl_d;
+	int score_mux;
+	int score_demux;
+	double cost;
+};
+
+struct MemGeometryCache {
+	std::mutex mutex;
+	dict<std::string, MemGeometry> geometries;
+};
+
 struct MapWorker {
 	Module *module;
+	MemGeometryCache *geom_cache = nullptr;
 	ModWalker modwalker;
 	SigMap sigmap;
 	SigMap sigmap_xmux;
@@ -309,6 +333,9 @@ struct MemMapping {
 	void handle_rd_rst();
 	void score_emu_ports();
 	void handle_geom();
+	void handle_geom_cfg(MemConfig &cfg, const std::vector<int> &wren_size);
+	double cost_lower_bound(const MemConfig &cfg);
+	std::string geom_key(const MemConfig &cfg);
 	void prune_post_geom();
 	void emit_port(const MemConfig &cfg, std::vector<Cell*> &cells, const PortVariant &pdef, const char *name, int wpidx, int rpidx, const std::vector<int> &hw_addr_swizzle);
 	void emit(const MemConfig &cfg);
@@ -1185,6 +1212,42 @@ void MemMapping::score_emu_ports() {
 	}
 }
 
+// A cost no geometry of this config can go below: every memory bit needs a bit in
+// one of the replicated blocks, and the remaining cost terms are not negative.
+double MemMapping::cost_lower_bound(const MemConfig &cfg) {
+	if (cfg.def->widthscale < 0 || cfg.def->cost < cfg.def->widthscale)
+		return -std::numeric_limits<double>::infinity();
+	int64_t capacity = 0;
+	for (int i = 0; i < GetSize(cfg.def->dbits) && i <= cfg.def->abits; i++)
+		capacity = std::max(capacity, int64_t(cfg.def->dbits[i]) << (cfg.def->abits - i));
+	if (capacity == 0)
+		return -std::numeric_limits<double>::infinity();
+	int64_t repl = (int64_t(mem.width) * mem.size + capacity - 1) / capacity;
+	return (cfg.def->cost - cfg.def->widthscale) * repl * cfg.repl_port + cfg.score_emu * FACTOR_EMU;
+}
+
+// Everything handle_geom_cfg() looks at: the memory dimensions, the port widths,
+// which write enable bits are equal, and the chosen port and ram definitions.
+std::string MemMapping::geom_key(const MemConfig &cfg) {
+	std::string key = stringf("%p %d %d %d %d %d", cfg.def, mem.width, mem.size, mem.start_offset, cfg.score_emu, cfg.repl_port);
+	for (int i = 0; i < GetSize(mem.wr_ports); i++) {
+		auto &port = mem.wr_ports[i];
+		auto &pcfg = cfg.wr_ports[i];
+		key += stringf(" w%d:%p:%d:%d:", port.wide_log2, pcfg.def, pcfg.force_uniform, pcfg.rd_port);
+		dict<SigBit, int> en_bits;
+		for (auto bit : port.en) {
+			if (!en_bits.count(bit)) {
+				int idx = GetSize(en_bits);
+				en_bits[bit] = idx;
+			}
+			key += stringf("%d,", en_bits.at(bit));
+		}
+	}
+	for (int i = 0; i < GetSize(mem.rd_ports); i++)
+		key += stringf(" r%d:%d:%p", mem.rd_ports[i].wide_log2, GetSize(mem.rd_ports[i].data), cfg.rd_ports[i].def);
+	return key;
+}
+
 void MemMapping::handle_geom() {
 	std::vector<int> wren_size;
 	for (auto &port: mem.wr_ports) {
@@ -1192,281 +1255,325 @@ void MemMapping::handle_geom() {
 		en.sort_and_unify();
 		wren_size.push_back(GetSize(en));
 	}
+	// Configs that cannot get cheaper than an earlier config (or than the soft logic
+	// mapping) can never be picked, so their geometry is not searched.
+	double cutoff = logic_ok ? logic_cost : std::numeric_limits<double>::infinity();
+	MemConfigs new_cfgs;
 	for (auto &cfg: cfgs) {
-		// First, create a set of "byte boundaries": the bit positions in source memory word
-		// that have write enable different from the previous bit in any write port.
-		// Bit 0 is considered to be a byte boundary as well.
-		// Likewise, create a set of "word boundaries" that are like above, but only for write ports
-		// with the "force uniform" flag set.
-		std::vector<bool> byte_boundary(mem.width, false);
-		std::vector<bool> word_boundary(mem.width, false);
-		byte_boundary[0] = true;
-		for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
-			auto &port = mem.wr_ports[pidx];
-			auto &pcfg = cfg.wr_ports[pidx];
-			if (pcfg.force_uniform)
-				word_boundary[0] = true;
-			for (int sub = 0; sub < (1 << port.wide_log2); sub++) {
-				for (int i = 1; i < mem.width; i++) {
-					int pos = sub * mem.width + i;
-					if (port.en[pos] != port.en[pos-1]) {
-						byte_boundary[i] = true;
-						if (pcfg.force_uniform)
-							word_boundary[i] = true;
-					}
-				}
+		double lower_bound = cost_lower_bound(cfg);
+		if (lower_bound > cutoff) {
+			log_reject(*cfg.def, stringf("cost is at least %f, more than the best cost %f so far", lower_bound, cutoff));
+			continue;
+		}
+		std::string key;
+		bool found = false;
+		if (worker.geom_cache) {
+			key = geom_key(cfg);
+			std::lock_guard<std::mutex> lock(worker.geom_cache->mutex);
+			auto it = worker.geom_cache->geometries.find(key);
+			if (it != worker.geom_cache->geometries.end()) {
+				const MemGeometry &geom = it->second;
+				cfg.base_width_log2 = geom.base_width_log2;
+				cfg.unit_width_log2 = geom.unit_width_log2;
+				cfg.swizzle = geom.swizzle;
+				cfg.hard_wide_mask = geom.hard_wide_mask;
+				cfg.emu_wide_mask = geom.emu_wide_mask;
+				cfg.repl_d = geom.repl_d;
+				cfg.score_mux = geom.score_mux;
+				cfg.score_demux = geom.score_demux;
+				cfg.cost = geom.cost;
+				found = true;
 			}
 		}
-		bool got_config = false;
-		int best_cost = 0;
-		int byte_width_log2 = 0;
-		for (int i = 0; i < GetSize(cfg.def->dbits); i++)
-			if (cfg.def->byte >= cfg.def->dbits[i])
-				byte_width_log2 = i;
-		if (cfg.def->byte == 0)
-			byte_width_log2 = GetSize(cfg.def->dbits) - 1;
-		pool<int> no_wide_bits;
-		// Determine which of the source address bits involved in wide ports
-		// are "uniform".  Bits are considered uniform if, when a port is widened through
-		// them, the write enables are the same for both values of the bit.
-		int max_wr_wide_log2 = 0;
-		for (auto &port: mem.wr_ports)
-			if (port.wide_log2 > max_wr_wide_log2)
-				max_wr_wide_log2 = port.wide_log2;
-		int max_wide_log2 = max_wr_wide_log2;
-		for (auto &port: mem.rd_ports)
-			if (port.wide_log2 > max_wide_log2)
-				max_wide_log2 = port.wide_log2;
-		int wide_nu_start = max_wide_log2;
-		int wide_nu_end = max_wr_wide_log2;
-		for (int i = 0; i < GetSize(mem.wr_ports); i++) {
-			auto &port = mem.wr_ports[i];
-			auto &pcfg = cfg.wr_ports[i];
-			for (int j = 0; j < port.wide_log2; j++) {
-				bool uniform = true;
-				// If write enables don't match, mark bit as non-uniform.
-				for (int k = 0; k < (1 << port.wide_log2); k += 2 << j)
-					if (port.en.extract(k * mem.width, mem.width << j) != port.en.extract((k + (1 << j)) * mem.width, mem.width << j))
-						uniform = false;
-				if (!uniform) {
-					if (pcfg.force_uniform) {
-						for (int k = j; k < port.wide_log2; k++)
-							no_wide_bits.insert(k);
-					}
-					if (j < wide_nu_start)
-						wide_nu_start = j;
-					break;
-				}
+		if (!found) {
+			handle_geom_cfg(cfg, wren_size);
+			if (worker.geom_cache) {
+				MemGeometry geom = {cfg.base_width_log2, cfg.unit_width_log2, cfg.swizzle, cfg.hard_wide_mask,
+						cfg.emu_wide_mask, cfg.repl_d, cfg.score_mux, cfg.score_demux, cfg.cost};
+				std::lock_guard<std::mutex> lock(worker.geom_cache->mutex);
+				worker.geom_cache->geometries.insert({key, geom});
 			}
-			if (pcfg.def->width_tied && pcfg.rd_port != -1) {
-				// If:
-				//
-				// - the write port is merged with a read port
-				// - the read port is wider than the write port
-				// - read and write widths are tied
-				//
-				// then we will have to artificially widen the write
-				// port to the width of the read port, and emulate
-				// a narrower write path by use of write enables,
-				// which will definitely be non-uniform over the added
-				// bits.
-				auto &rport = mem.rd_ports[pcfg.rd_port];
-				if (rport.wide_log2 > port.wide_log2) {
-					if (port.wide_log2 < wide_nu_start)
-						wide_nu_start = port.wide_log2;
-					if (rport.wide_log2 > wide_nu_end)
-						wide_nu_end = rport.wide_log2;
-					if (pcfg.force_uniform) {
-						for (int k = port.wide_log2; k < rport.wide_log2; k++)
-							no_wide_bits.insert(k);
-					}
+		}
+		cutoff = std::min(cutoff, cfg.cost);
+		new_cfgs.push_back(cfg);
+	}
+	cfgs.swap(new_cfgs);
+}
+
+void MemMapping::handle_geom_cfg(MemConfig &cfg, const std::vector<int> &wren_size) {
+	// First, create a set of "byte boundaries": the bit positions in source memory word
+	// that have write enable different from the previous bit in any write port.
+	// Bit 0 is considered to be a byte boundary as well.
+	// Likewise, create a set of "word boundaries" that are like above, but only for write ports
+	// with the "force uniform" flag set.
+	std::vector<bool> byte_boundary(mem.width, false);
+	std::vector<bool> word_boundary(mem.width, false);
+	byte_boundary[0] = true;
+	for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
+		auto &port = mem.wr_ports[pidx];
+		auto &pcfg = cfg.wr_ports[pidx];
+		if (pcfg.force_uniform)
+			word_boundary[0] = true;
+		for (int sub = 0; sub < (1 << port.wide_log2); sub++) {
+			for (int i = 1; i < mem.width; i++) {
+				int pos = sub * mem.width + i;
+				if (port.en[pos] != port.en[pos-1]) {
+					byte_boundary[i] = true;
+					if (pcfg.force_uniform)
+						word_boundary[i] = true;
 				}
 			}
 		}
-		// Iterate over base widths.
-		for (int base_width_log2 = 0; base_width_log2 < GetSize(cfg.def->dbits); base_width_log2++) {
-			// Now, see how many data bits we actually have available.
-			// This is usually dbits[base_width_log2], but could be smaller if we
-			// ran afoul of a max width limitation.  Configurations where this
-			// happens are not useful, unless we need it to satisfy a *minimum*
-			// width limitation.
-			int unit_width_log2 = base_width_log2;
-			for (auto &pcfg: cfg.wr_ports)
-				if (unit_width_log2 > pcfg.def->max_wr_wide_log2)
-					unit_width_log2 = pcfg.def->max_wr_wide_log2;
-			for (auto &pcfg: cfg.rd_ports)
-				if (unit_width_log2 > pcfg.def->max_rd_wide_log2)
-					unit_width_log2 = pcfg.def->max_rd_wide_log2;
-			if (unit_width_log2 != base_width_log2 && got_config)
+	}
+	bool got_config = false;
+	int best_cost = 0;
+	int byte_width_log2 = 0;
+	for (int i = 0; i < GetSize(cfg.def->dbits); i++)
+		if (cfg.def->byte >= cfg.def->dbits[i])
+			byte_width_log2 = i;
+	if (cfg.def->byte == 0)
+		byte_width_log2 = GetSize(cfg.def->dbits) - 1;
+	pool<int> no_wide_bits;
+	// Determine which of the source address bits involved in wide ports
+	// are "uniform".  Bits are considered uniform if, when a port is widened through
+	// them, the write enables are the same for both values of the bit.
+	int max_wr_wide_log2 = 0;
+	for (auto &port: mem.wr_ports)
+		if (port.wide_log2 > max_wr_wide_log2)
+			max_wr_wide_log2 = port.wide_log2;
+	int max_wide_log2 = max_wr_wide_log2;
+	for (auto &port: mem.rd_ports)
+		if (port.wide_log2 > max_wide_log2)
+			max_wide_log2 = port.wide_log2;
+	int wide_nu_start = max_wide_log2;
+	int wide_nu_end = max_wr_wide_log2;
+	for (int i = 0; i < GetSize(mem.wr_ports); i++) {
+		auto &port = mem.wr_ports[i];
+		auto &pcfg = cfg.wr_ports[i];
+		for (int j = 0; j < port.wide_log2; j++) {
+			bool uniform = true;
+			// If write enables don't match, mark bit as non-uniform.
+			for (int k = 0; k < (1 << port.wide_log2); k += 2 << j)
+				if (port.en.extract(k * mem.width, mem.width << j) != port.en.extract((k + (1 << j)) * mem.width, mem.width << j))
+					uniform = false;
+			if (!uniform) {
+				if (pcfg.force_uniform) {
+					for (int k = j; k < port.wide_log2; k++)
+						no_wide_bits.insert(k);
+				}
+				if (j < wide_nu_start)
+					wide_nu_start = j;
 				break;
-			int unit_width = cfg.def->dbits[unit_width_log2];
-			// Also determine effective byte width (the granularity of write enables).
-			int effective_byte = cfg.def->byte;
-			if (effective_byte == 0 || effective_byte > unit_width)
-				effective_byte = unit_width;
-			if (mem.wr_ports.empty())
-				effective_byte = 1;
-			log_assert(unit_width % effective_byte == 0);
-			// Create the swizzle pattern.
-			std::vector<int> swizzle;
-			for (int i = 0; i < mem.width; i++) {
-				if (word_boundary[i])
-					while (GetSize(swizzle) % unit_width)
-						swizzle.push_back(-1);
-				else if (byte_boundary[i])
-					while (GetSize(swizzle) % effective_byte)
-						swizzle.push_back(-1);
-				swizzle.push_back(i);
 			}
-			if (word_boundary[0])
+		}
+		if (pcfg.def->width_tied && pcfg.rd_port != -1) {
+			// If:
+			//
+			// - the write port is merged with a read port
+			// - the read port is wider than the write port
+			// - read and write widths are tied
+			//
+			// then we will have to artificially widen the write
+			// port to the width of the read port, and emulate
+			// a narrower write path by use of write enables,
+			// which will definitely be non-uniform over the added
+			// bits.
+			auto &rport = mem.rd_ports[pcfg.rd_port];
+			if (rport.wide_log2 > port.wide_log2) {
+				if (port.wide_log2 < wide_nu_start)
+					wide_nu_start = port.wide_log2;
+				if (rport.wide_log2 > wide_nu_end)
+					wide_nu_end = rport.wide_log2;
+				if (pcfg.force_uniform) {
+					for (int k = port.wide_log2; k < rport.wide_log2; k++)
+						no_wide_bits.insert(k);
+				}
+			}
+		}
+	}
+	// Iterate over base widths.
+	for (int base_width_log2 = 0; base_width_log2 < GetSize(cfg.def->dbits); base_width_log2++) {
+		// Now, see how many data bits we actually have available.
+		// This is usually dbits[base_width_log2], but could be smaller if we
+		// ran afoul of a max width limitation.  Configurations where this
+		// happens are not useful, unless we need it to satisfy a *minimum*
+		// width limitation.
+		int unit_width_log2 = base_width_log2;
+		for (auto &pcfg: cfg.wr_ports)
+			if (unit_width_log2 > pcfg.def->max_wr_wide_log2)
+				unit_width_log2 = pcfg.def->max_wr_wide_log2;
+		for (auto &pcfg: cfg.rd_ports)
+			if (unit_width_log2 > pcfg.def->max_rd_wide_log2)
+				unit_width_log2 = pcfg.def->max_rd_wide_log2;
+		if (unit_width_log2 != base_width_log2 && got_config)
+			break;
+		int unit_width = cfg.def->dbits[unit_width_log2];
+		// Also determine effective byte width (the granularity of write enables).
+		int effective_byte = cfg.def->byte;
+		if (effective_byte == 0 || effective_byte > unit_width)
+			effective_byte = unit_width;
+		if (mem.wr_ports.empty())
+			effective_byte = 1;
+		log_assert(unit_width % effective_byte == 0);
+		// Create the swizzle pattern.
+		std::vector<int> swizzle;
+		for (int i = 0; i < mem.width; i++) {
+			if (word_boundary[i])
 				while (GetSize(swizzle) % unit_width)
 					swizzle.push_back(-1);
-			else
+			else if (byte_boundary[i])
 				while (GetSize(swizzle) % effective_byte)
 					swizzle.push_back(-1);
-			// Now evaluate the configuration, then keep adding more hard wide bits
-			// and evaluating.
-			int hard_wide_mask = 0;
-			int hard_wide_num = 0;
-			bool byte_failed = false;
-			while (1) {
-				// Check if all min width constraints are satisfied.
-				// Only check these constraints for write ports with width below
-				// byte width — for other ports, we can emulate narrow width with
-				// a larger one.
-				bool min_width_ok = true;
-				int min_width_bit = wide_nu_start;
-				for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
-					auto &port = mem.wr_ports[pidx];
-					int w = base_width_log2;
+			swizzle.push_back(i);
+		}
+		if (word_boundary[0])
+			while (GetSize(swizzle) % unit_width)
+				swizzle.push_back(-1);
+		else
+			while (GetSize(swizzle) % effective_byte)
+				swizzle.push_back(-1);
+		// Now evaluate the configuration, then keep adding more hard wide bits
+		// and evaluating.
+		int hard_wide_mask = 0;
+		int hard_wide_num = 0;
+		bool byte_failed = false;
+		while (1) {
+			// Check if all min width constraints are satisfied.
+			// Only check these constraints for write ports with width below
+			// byte width — for other ports, we can emulate narrow width with
+			// a larger one.
+			bool min_width_ok = true;
+			int min_width_bit = wide_nu_start;
+			for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
+				auto &port = mem.wr_ports[pidx];
+				int w = base_width_log2;
+				for (int i = 0; i < port.wide_log2; i++)
+					if (hard_wide_mask & 1 << i)
+						w++;
+				if (w < cfg.wr_ports[pidx].def->min_wr_wide_log2 && w < byte_width_log2) {
+					min_width_ok = false;
+					if (min_width_bit > port.wide_log2)
+						min_width_bit = port.wide_log2;
+				}
+			}
+			if (min_width_ok) {
+				int emu_wide_bits = max_wide_log2 - hard_wide_num;
+				int mult_wide = 1 << emu_wide_bits;
+				int addrs = 1 << (cfg.def->abits - base_width_log2 + emu_wide_bits);
+				int min_addr = mem.start_offset / addrs;
+				int max_addr = (mem.start_offset + mem.size - 1) / addrs;
+				int mult_a = max_addr - min_addr + 1;
+				int bits = mult_a * mult_wide * GetSize(swizzle);
+				int repl = (bits + unit_width - 1) / unit_width;
+				int score_demux = 0;
+				for (int i = 0; i < GetSize(mem.wr_ports); i++) {
+					auto &port = mem.wr_ports[i];
+					int w = emu_wide_bits;
 					for (int i = 0; i < port.wide_log2; i++)
-						if (hard_wide_mask & 1 << i)
-							w++;
-					if (w < cfg.wr_ports[pidx].def->min_wr_wide_log2 && w < byte_width_log2) {
-						min_width_ok = false;
-						if (min_width_bit > port.wide_log2)
-							min_width_bit = port.wide_log2;
-					}
+						if (!(hard_wide_mask & 1 << i))
+							w--;
+					if (w || mult_a != 1)
+						score_demux += (mult_a << w) * wren_size[i];
 				}
-				if (min_width_ok) {
-					int emu_wide_bits = max_wide_log2 - hard_wide_num;
-					int mult_wide = 1 << emu_wide_bits;
-					int addrs = 1 << (cfg.def->abits - base_width_log2 + emu_wide_bits);
-					int min_addr = mem.start_offset / addrs;
-					int max_addr = (mem.start_offset + mem.size - 1) / addrs;
-					int mult_a = max_addr - min_addr + 1;
-					int bits = mult_a * mult_wide * GetSize(swizzle);
-					int repl = (bits + unit_width - 1) / unit_width;
-					int score_demux = 0;
-					for (int i = 0; i < GetSize(mem.wr_ports); i++) {
-						auto &port = mem.wr_ports[i];
-						int w = emu_wide_bits;
-						for (int i = 0; i < port.wide_log2; i++)
-							if (!(hard_wide_mask & 1 << i))
-								w--;
-						if (w || mult_a != 1)
-							score_demux += (mult_a << w) * wren_size[i];
-					}
-					int score_mux = 0;
-					for (auto &port: mem.rd_ports) {
-						int w = emu_wide_bits;
-						for (int i = 0; i < port.wide_log2; i++)
-							if (!(hard_wide_mask & 1 << i))
-								w--;
-						score_mux += ((mult_a << w) - 1) * GetSize(port.data);
-					}
-					double cost = (cfg.def->cost - cfg.def->widthscale) * repl * cfg.repl_port;
-					cost += cfg.def->widthscale * mult_a * mult_wide * mem.width / unit_width * cfg.repl_port;
-					cost += score_mux * FACTOR_MUX;
-					cost += score_demux * FACTOR_DEMUX;
-					cost += cfg.score_emu * FACTOR_EMU;
-					if (!got_config || cost < best_cost) {
-						cfg.base_width_log2 = base_width_log2;
-						cfg.unit_width_log2 = unit_width_log2;
-						cfg.swizzle = swizzle;
-						cfg.hard_wide_mask = hard_wide_mask;
-						cfg.emu_wide_mask = ((1 << max_wide_log2) - 1) & ~hard_wide_mask;
-						cfg.repl_d = repl;
-						cfg.score_demux = score_demux;
-						cfg.score_mux = score_mux;
-						cfg.cost = cost;
-						best_cost = cost;
-						got_config = true;
-					}
+				int score_mux = 0;
+				for (auto &port: mem.rd_ports) {
+					int w = emu_wide_bits;
+					for (int i = 0; i < port.wide_log2; i++)
+						if (!(hard_wide_mask & 1 << i))
+							w--;
+					score_mux += ((mult_a << w) - 1) * GetSize(port.data);
 				}
-				if (cfg.def->width_mode != WidthMode::PerPort)
-					break;
-				// Now, pick the next bit to add to the hard wide mask.
-next_hw:
-				int scan_from;
-				int scan_to;
-				bool retry = false;
-				if (!min_width_ok) {
-					// If we still haven't met the minimum width limits,
-					// add the highest one that will be useful for working
-					// towards all unmet limits.
-					scan_from = min_width_bit;
-					scan_to = 0;
-					// If the relevant write port is not wide, it's impossible.
-				} else if (byte_failed) {
-					// If we already failed with uniformly-written bits only,
-					// go with uniform bits that are only involved in reads.
-					scan_from = max_wide_log2;
-					scan_to = wide_nu_end;
-				} else if (base_width_log2 + hard_wide_num < byte_width_log2) {
-					// If we still need uniform bits, prefer the low ones.
-					scan_from = wide_nu_start;
-					scan_to = 0;
-					retry = true;
-				} else {
-					scan_from = max_wide_log2;
-					scan_to = 0;
+				double cost = (cfg.def->cost - cfg.def->widthscale) * repl * cfg.repl_port;
+				cost += cfg.def->widthscale * mult_a * mult_wide * mem.width / unit_width * cfg.repl_port;
+				cost += score_mux * FACTOR_MUX;
+				cost += score_demux * FACTOR_DEMUX;
+				cost += cfg.score_emu * FACTOR_EMU;
+				if (!got_config || cost < best_cost) {
+					cfg.base_width_log2 = base_width_log2;
+					cfg.unit_width_log2 = unit_width_log2;
+					cfg.swizzle = swizzle;
+					cfg.hard_wide_mask = hard_wide_mask;
+					cfg.emu_wide_mask = ((1 << max_wide_log2) - 1) & ~hard_wide_mask;
+					cfg.repl_d = repl;
+					cfg.score_demux = score_demux;
+					cfg.score_mux = score_mux;
+					cfg.cost = cost;
+					best_cost = cost;
+					got_config = true;
 				}
-				int bit = scan_from - 1;
-				while (1) {
-					if (bit < scan_to) {
+			}
+			if (cfg.def->width_mode != WidthMode::PerPort)
+				break;
+			// Now, pick the next bit to add to the hard wide mask.
+next_hw:
+			int scan_from;
+			int scan_to;
+			bool retry = false;
+			if (!min_width_ok) {
+				// If we still haven't met the minimum width limits,
+				// add the highest one that will be useful for working
+				// towards all unmet limits.
+				scan_from = min_width_bit;
+				scan_to = 0;
+				// If the relevant write port is not wide, it's impossible.
+			} else if (byte_failed) {
+				// If we already failed with uniformly-written bits only,
+				// go with uniform bits that are only involved in reads.
+				scan_from = max_wide_log2;
+				scan_to = wide_nu_end;
+			} else if (base_width_log2 + hard_wide_num < byte_width_log2) {
+				// If we still need uniform bits, prefer the low ones.
+				scan_from = wide_nu_start;
+				scan_to = 0;
+				retry = true;
+			} else {
+				scan_from = max_wide_log2;
+				scan_to = 0;
+			}
+			int bit = scan_from - 1;
+			while (1) {
+				if (bit < scan_to) {
 hw_bit_failed:
-						if (retry) {
-							byte_failed = true;
-							goto next_hw;
-						} else {
-							goto bw_done;
-						}
+					if (retry) {
+						byte_failed = true;
+						goto next_hw;
+					} else {
+						goto bw_done;
 					}
-					if (!(hard_wide_mask & 1 << bit) && !no_wide_bits.count(bit))
-						break;
-					bit--;
 				}
-				int new_hw_mask = hard_wide_mask | 1 << bit;
-				// Check if all max width constraints are satisfied.
-				for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
-					auto &port = mem.wr_ports[pidx];
-					int w = base_width_log2;
-					for (int i = 0; i < port.wide_log2; i++)
-						if (new_hw_mask & 1 << i)
-							w++;
-					if (w > cfg.wr_ports[pidx].def->max_wr_wide_log2) {
-						goto hw_bit_failed;
-					}
+				if (!(hard_wide_mask & 1 << bit) && !no_wide_bits.count(bit))
+					break;
+				bit--;
+			}
+			int new_hw_mask = hard_wide_mask | 1 << bit;
+			// Check if all max width constraints are satisfied.
+			for (int pidx = 0; pidx < GetSize(mem.wr_ports); pidx++) {
+				auto &port = mem.wr_ports[pidx];
+				int w = base_width_log2;
+				for (int i = 0; i < port.wide_log2; i++)
+					if (new_hw_mask & 1 << i)
+						w++;
+				if (w > cfg.wr_ports[pidx].def->max_wr_wide_log2) {
+					goto hw_bit_failed;
 				}
-				for (int pidx = 0; pidx < GetSize(mem.rd_ports); pidx++) {
-					auto &port = mem.rd_ports[pidx];
-					int w = base_width_log2;
-					for (int i = 0; i < port.wide_log2; i++)
-						if (new_hw_mask & 1 << i)
-							w++;
-					if (w > cfg.rd_ports[pidx].def->max_rd_wide_log2) {
-						goto hw_bit_failed;
-					}
+			}
+			for (int pidx = 0; pidx < GetSize(mem.rd_ports); pidx++) {
+				auto &port = mem.rd_ports[pidx];
+				int w = base_width_log2;
+				for (int i = 0; i < port.wide_log2; i++)
+					if (new_hw_mask & 1 << i)
+						w++;
+				if (w > cfg.rd_ports[pidx].def->max_rd_wide_log2) {
+					goto hw_bit_failed;
 				}
-				// Bit ok, commit.
-				hard_wide_mask = new_hw_mask;
-				hard_wide_num++;
 			}
-bw_done:;
+			// Bit ok, commit.
+			hard_wide_mask = new_hw_mask;
+			hard_wide_num++;
 		}
-		log_assert(got_config);
+bw_done:;
 	}
+	log_assert(got_config);
 }
 
 void MemMapping::prune_post_geom() {
@@ -2163,6 +2270,9 @@ struct MemoryLibMapPass : public Pass {
 		log("    Selects a library file containing RAM cell definitions. This option\n");
 		log("    can be passed more than once to select multiple libraries.\n");
 		log("    See passes/memory/memlib.md for description of the library format.\n");
+		log("    Parsed library files are reused by later calls with the same file\n");
+		log("    content and -D conditions. If the YOSYS_MEMLIB_CACHE environment\n");
+		log("    variable names a directory, they are also stored there for later runs.\n");
 		log("\n");
 		log("  -D <condition>\n");
 		log("    Enables a condition that can be checked within the library file\n");
@@ -2179,6 +2289,11 @@ struct MemoryLibMapPass : public Pass {
 		log("    Disables automatic mapping of given kind of RAMs.  Manual mapping\n");
 		log("    (using ram_style or other attributes) is still supported.\n");
 		log("\n");
+		log("Configurations that cannot be cheaper than one already found are skipped\n");
+		log("before their geometry is searched, and the geometry search results are shared\n");
+		log("between memories of the same shape. When synthesizer runs with -j <jobs>,\n");
+		log("modules are mapped concurrently.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -2227,15 +2342,20 @@ struct MemoryLibMapPass : public Pass {
 		extra_args(args, argidx, design);
 
 		Library lib = parse_library(lib_files, defines);
+		MemGeometryCache geom_cache;
 
-		for (auto module : design->selected_modules()) {
-			if (module->has_processes_warn())
-				continue;
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_modules())
+			if (!module->has_processes_warn())
+				modules.push_back(module);
 
+		parallel_for_modules(design, modules, [&](RTLIL::Module *module) {
 			MapWorker worker(module);
+			worker.geom_cache = &geom_cache;
 			auto mems = Mem::get_selected_memories(module);
 			for (auto &mem : mems)
 			{
+				log_check_interrupt("memory_libmap");
 				MemMapping map(worker, mem, lib, opts);
 				int idx = -1;
 				int best = map.logic_cost;
@@ -2260,7 +2380,7 @@ struct MemoryLibMapPass : public Pass {
 					map.emit(map.cfgs[idx]);
 				}
 			}
-		}
+		});
 	}
 } MemoryLibMapPass;
 
@@ -33,6 +33,7 @@ struct MemoryMapWorker
 	bool rom_only = false;
 	bool keepdc = false;
 	bool formal = false;
+	bool wordlevel = false;
 	dict<RTLIL::IdString, std::vector<RTLIL::Const>> attributes;
 
 	RTLIL::Design *design;
@@ -103,6 +104,140 @@ struct MemoryMapWorker
 		return bit.wire;
 	}
 
+	// Word-level variant of the mapping in handle_memory(): all words that
+	// need storage share one wide $dff, every read port is a single $bmux
+	// and every write port is a $demux for the word enables followed by a
+	// $bwmux, so the number of cells does not depend on the memory size.
+	void handle_memory_wordlevel(Mem &mem, const SigSpec &init_data, const std::set<int> &static_ports,
+			const std::map<int, RTLIL::SigSpec> &static_cells_map, bool static_only, const SigSpec &refclock, bool refclock_pol)
+	{
+		int abits = ceil_log2(mem.size);
+
+		// words that need a flip-flop, in address order
+		std::vector<int> ff_words;
+		ff_words.reserve(mem.size);
+		int count_static = 0;
+		for (int i = 0; i < mem.size; i++) {
+			if (static_cells_map.count(i) > 0) {
+				count_static++;
+				continue;
+			}
+			if (static_only && (!keepdc || init_data.extract(i*mem.width, mem.width).is_fully_def()))
+				continue;
+			ff_words.push_back(i);
+		}
+
+		RTLIL::Wire *w_in = nullptr, *w_out = nullptr;
+		if (!ff_words.empty()) {
+			int ff_width = GetSize(ff_words) * mem.width;
+			RTLIL::Cell *c = module->addCell(genid(mem.memid), ID($dff));
+			if (static_only) {
+				// non-static part is a ROM, we only reach this with keepdc
+				c->parameters[ID::CLK_POLARITY] = RTLIL::Const(RTLIL::State::S1);
+				c->setPort(ID::CLK, RTLIL::SigSpec(RTLIL::State::S0));
+			} else {
+				c->parameters[ID::CLK_POLARITY] = RTLIL::Const(refclock_pol);
+				c->setPort(ID::CLK, refclock);
+			}
+			c->parameters[ID::WIDTH] = ff_width;
+
+			w_in = module->addWire(genid(mem.memid, "", -1, "$d"), ff_width);
+			w_out = module->addWire(genid(mem.memid, "", -1, "$q"), ff_width);
+			c->setPort(ID::D, w_in);
+			c->setPort(ID::Q, w_out);
+
+			SigSpec w_init;
+			for (int i : ff_words)
+				w_init.append(init_data.extract(i*mem.width, mem.width));
+			if (!w_init.is_fully_undef())
+				w_out->attributes[ID::init] = w_init.as_const();
+
+			if (static_only)
+				module->connect(RTLIL::SigSig(w_in, w_out));
+		}
+
+		log("  created 1 $dff cell of width %d for %d words and %d static cells of width %d.\n",
+				GetSize(ff_words) * mem.width, GetSize(ff_words), count_static, mem.width);
+
+		// the contents of all 2^abits words, as seen by the read ports
+		SigSpec words;
+		for (int i = 0, ff_idx = 0; i < (1 << abits); i++) {
+			if (i >= mem.size)
+				words.append(RTLIL::Const(State::Sx, mem.width));
+			else if (static_cells_map.count(i) > 0)
+				words.append(static_cells_map.at(i));
+			else if (ff_idx < GetSize(ff_words) && ff_words[ff_idx] == i)
+				words.append(SigSpec(w_out, (ff_idx++) * mem.width, mem.width));
+			else
+				words.append(init_data.extract(i*mem.width, mem.width));
+		}
+
+		int count_dff = 0, count_mux = 0, count_wrmux = 0;
+
+		for (int i = 0; i < GetSize(mem.rd_ports); i++)
+		{
+			auto &port = mem.rd_ports[i];
+			if (mem.extract_rdff(i, &initvals))
+				count_dff++;
+			RTLIL::SigSpec rd_addr = port.addr;
+			rd_addr.extend_u0(abits, false);
+			rd_addr = rd_addr.extract_end(port.wide_log2);
+
+			if (rd_addr.empty()) {
+				module->connect(port.data, words);
+			} else {
+				module->addBmux(genid(mem.memid, "$rdmux", i), words, rd_addr, port.data);
+				count_mux++;
+			}
+		}
+
+		log("  read interface: %d $dff and %d $bmux cells.\n", count_dff, count_mux);
+
+		if (!static_only)
+		{
+			SigSpec sig = words;
+			words = SigSpec();
+
+			for (int j = 0; j < GetSize(mem.wr_ports); j++)
+			{
+				if (static_ports.count(j) > 0)
+					continue;
+
+				auto &port = mem.wr_ports[j];
+				RTLIL::SigSpec wr_addr = port.addr.extract_end(port.wide_log2);
+				RTLIL::SigSpec wr_en = port.en;
+				int sel_width = abits - port.wide_log2;
+
+				// address bits above the memory size must be zero for the write to happen
+				if (GetSize(wr_addr) > sel_width) {
+					RTLIL::SigSpec wr_addr_hi = wr_addr.extract_end(sel_width);
+					wr_addr = wr_addr.extract(0, sel_width);
+					if (!wr_addr_hi.is_fully_zero()) {
+						RTLIL::SigBit in_range = module->LogicNot(NEW_ID, wr_addr_hi);
+						wr_en = module->And(NEW_ID, wr_en, SigSpec(in_range, GetSize(wr_en)));
+					}
+				} else {
+					wr_addr.extend_u0(sel_width);
+				}
+
+				RTLIL::SigSpec word_en = wr_addr.empty() ? wr_en : module->Demux(genid(mem.memid, "$wren", -1, "", j), wr_en, wr_addr);
+				RTLIL::SigSpec word_data = port.data.repeat(1 << sel_width);
+				sig = module->Bwmux(genid(mem.memid, "$wrmux", -1, "", j), sig, word_data, word_en);
+				count_wrmux++;
+			}
+
+			SigSpec sig_in;
+			for (int i : ff_words)
+				sig_in.append(sig.extract(i*mem.width, mem.width));
+			if (w_in != nullptr)
+				module->connect(RTLIL::SigSig(w_in, sig_in));
+		}
+
+		log("  write interface: %d $demux/$bwmux blocks.\n", count_wrmux);
+
+		mem.remove();
+	}
+
 	void handle_memory(Mem &mem)
 	{
 		std::set<int> static_ports;
@@ -194,6 +329,11 @@ struct MemoryMapWorker
 
 		log("Mapping memory %s in module %s:\n", mem.memid.c_str(), module->name.c_str());
 
+		if (wordlevel && !formal && !async_wr && mem.start_offset == 0) {
+			handle_memory_wordlevel(mem, init_data, static_ports, static_cells_map, static_only, refclock, refclock_pol);
+			return;
+		}
+
 		int abits = ceil_log2(mem.size);
 		std::vector<RTLIL::SigSpec> data_reg_in(1 << abits);
 		std::vector<RTLIL::SigSpec> data_reg_out(1 << abits);
@@ -202,6 +342,9 @@ struct MemoryMapWorker
 
 		int count_static = 0;
 
+		module->reserve_cells(mem.size);
+		module->reserve_wires(2 * mem.size);
+
 		for (int i = 0; i < mem.size; i++)
 		{
 			int addr = i + mem.start_offset;
@@ -429,6 +572,13 @@ struct MemoryMapPass : public Pass {
 		log("        attributes. It also has limited support for async write ports\n");
 		log("        as generated by clk2fflogic.\n");
 		log("\n");
+		log("    -wordlevel\n");
+		log("        map each memory to a single wide $dff, one $bmux per read port and\n");
+		log("        one $demux and $bwmux per write port instead of one $dff per word\n");
+		log("        with address decoders and mux trees. This keeps the number of cells\n");
+		log("        independent of the memory size. Not used with -formal, for async\n");
+		log("        write ports or for memories with a non-zero start offset.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -436,6 +586,7 @@ struct MemoryMapPass : public Pass {
 		bool rom_only = false;
 		bool keepdc = false;
 		bool formal = false;
+		bool wordlevel = false;
 		dict<RTLIL::IdString, std::vector<RTLIL::Const>> attributes;
 
 		log_header(design, "Executing MEMORY_MAP pass (converting memories to logic and flip-flops).\n");
@@ -482,6 +633,11 @@ struct MemoryMapPass : public Pass {
 				keepdc = true;
 				continue;
 			}
+			if (args[argidx] == "-wordlevel")
+			{
+				wordlevel = true;
+				continue;
+			}
 			if (args[argidx] == "-formal")
 			{
 				formal = true;
@@ -502,6 +658,7 @@ struct MemoryMapPass : public Pass {
 			worker.rom_only = rom_only;
 			worker.keepdc = keepdc;
 			worker.formal = formal;
+			worker.wordlevel = wordlevel;
 			worker.run();
 		}
 	}
@@ -293,6 +293,55 @@ struct MemoryShareWorker
 	// Consolidate write ports using sat-based resource sharing
 	// --------------------------------------------------------
 
+	// Returns true if bit a is the output of an inverter driven by bit b.
+	bool is_inverted(RTLIL::SigBit a, RTLIL::SigBit b)
+	{
+		auto it = modwalker.signal_drivers.find(a);
+		if (it == modwalker.signal_drivers.end())
+			return false;
+		for (auto &pbit : it->second) {
+			RTLIL::Cell *cell = pbit.cell;
+			RTLIL::SigSpec sig_a = modwalker.sigmap(cell->getPort(ID::A));
+			if (cell->type.in(ID($_NOT_), ID($not))) {
+				if (GetSize(sig_a) == GetSize(cell->getPort(ID::Y)) && sig_a[pbit.offset] == b)
+					return true;
+			} else if (cell->type == ID($logic_not)) {
+				if (pbit.offset == 0 && GetSize(sig_a) == 1 && sig_a[0] == b)
+					return true;
+			}
+		}
+		return false;
+	}
+
+	// Cheap structural check for enables that can never be active at the
+	// same time: a port that is never enabled, or two ports whose enables
+	// are a single signal and its inversion.
+	bool enables_exclusive(const Mem &mem, int idx1, int idx2)
+	{
+		std::vector<RTLIL::SigBit> en1 = modwalker.sigmap(mem.wr_ports[idx1].en);
+		std::vector<RTLIL::SigBit> en2 = modwalker.sigmap(mem.wr_ports[idx2].en);
+
+		auto never_active = [](const std::vector<RTLIL::SigBit> &bits) {
+			for (auto bit : bits)
+				if (bit != RTLIL::State::S0)
+					return false;
+			return true;
+		};
+		if (never_active(en1) || never_active(en2))
+			return true;
+
+		auto uniform = [](const std::vector<RTLIL::SigBit> &bits) {
+			for (auto bit : bits)
+				if (bit != bits.front())
+					return false;
+			return true;
+		};
+		if (!uniform(en1) || !uniform(en2) || !en1.front().wire || !en2.front().wire)
+			return false;
+
+		return is_inverted(en1.front(), en2.front()) || is_inverted(en2.front(), en1.front());
+	}
+
 	void consolidate_wr_using_sat(Mem &mem)
 	{
 		if (GetSize(mem.wr_ports) <= 1)
@@ -361,6 +410,41 @@ struct MemoryShareWorker
 			groups.push_back(group);
 		}
 
+		// All groups share one solver and one set of random patterns.  Pairs
+		// that are settled structurally or by simulation never reach SAT.
+
+		QuickConeSat qcsat(modwalker);
+		QuickConeSim qcsim(qcsat);
+		qcsim.run();
+
+		// create SAT representation of common input cone of all considered EN signals
+
+		dict<int, int> port_to_sat_variable;
+		dict<int, uint64_t> port_to_patterns;
+
+		for (auto &group : groups)
+			for (auto idx : group) {
+				port_to_sat_variable[idx] = qcsat.ez->expression(qcsat.ez->OpOr, qcsat.importSig(mem.wr_ports[idx].en));
+				uint64_t patterns = 0;
+				bool simulated = true;
+				for (auto bit : mem.wr_ports[idx].en) {
+					uint64_t bit_patterns;
+					if (!qcsim.get(bit, bit_patterns)) {
+						simulated = false;
+						break;
+					}
+					patterns |= bit_patterns;
+				}
+				if (simulated)
+					port_to_patterns[idx] = patterns;
+			}
+
+		qcsat.prepare();
+
+		log("  Common input cone for all EN signals: %d cells.\n", GetSize(qcsat.imported_cells));
+
+		log("  Size of unconstrained SAT problem: %d variables, %d clauses\n", qcsat.ez->numCnfVariables(), qcsat.ez->numCnfClauses());
+
 		bool changed = false;
 		for (auto &group : groups) {
 			auto &some_port = mem.wr_ports[group[0]];
@@ -376,23 +460,6 @@ struct MemoryShareWorker
 				log("  Checking group clocked with %sedge %s, width %d: ports %s.\n", some_port.clk_polarity ? "pos" : "neg", log_signal(some_port.clk), mem.width << some_port.wide_log2, ports.c_str());
 			}
 
-			// Okay, time to actually run the SAT solver.
-
-			QuickConeSat qcsat(modwalker);
-
-			// create SAT representation of common input cone of all considered EN signals
-
-			dict<int, int> port_to_sat_variable;
-
-			for (auto idx : group)
-				port_to_sat_variable[idx] = qcsat.ez->expression(qcsat.ez->OpOr, qcsat.importSig(mem.wr_ports[idx].en));
-
-			qcsat.prepare();
-
-			log("  Common input cone for all EN signals: %d cells.\n", GetSize(qcsat.imported_cells));
-
-			log("  Size of unconstrained SAT problem: %d variables, %d clauses\n", qcsat.ez->numCnfVariables(), qcsat.ez->numCnfClauses());
-
 			// now try merging the ports.
 
 			for (int ii = 0; ii < GetSize(group); ii++) {
@@ -406,7 +473,13 @@ struct MemoryShareWorker
 					if (port2.removed)
 						continue;
 
-					if (qcsat.ez->solve(port_to_sat_variable.at(idx1), port_to_sat_variable.at(idx2))) {
+					if (enables_exclusive(mem, idx1, idx2)) {
+						log("  Enables of port %d and port %d are exclusive by construction.\n", idx1, idx2);
+					} else if (port_to_patterns.count(idx1) && port_to_patterns.count(idx2) &&
+							(port_to_patterns.at(idx1) & port_to_patterns.at(idx2) & qcsim.valid_patterns) != 0) {
+						log("  According to simulation sharing of port %d with port %d is not possible.\n", idx1, idx2);
+						continue;
+					} else if (qcsat.ez->solve(port_to_sat_variable.at(idx1), port_to_sat_variable.at(idx2))) {
 						log("  According to SAT solver sharing of port %d with port %d is not possible.\n", idx1, idx2);
 						continue;
 					}
@@ -414,6 +487,10 @@ struct MemoryShareWorker
 					log("  Merging port %d into port %d.\n", idx2, idx1);
 					mem.prepare_wr_merge(idx1, idx2, &initvals);
 					port_to_sat_variable.at(idx1) = qcsat.ez->OR(port_to_sat_variable.at(idx1), port_to_sat_variable.at(idx2));
+					if (port_to_patterns.count(idx1) && port_to_patterns.count(idx2))
+						port_to_patterns.at(idx1) |= port_to_patterns.at(idx2);
+					else
+						port_to_patterns.erase(idx1);
 
 					RTLIL::SigSpec last_addr = port1.addr;
 					RTLIL::SigSpec last_data = port1.data;
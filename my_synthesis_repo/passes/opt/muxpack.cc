@@ -64,26 +64,29 @@ struct ExclusiveDatabase
 		}
 
 		for (auto cell : reduce_or) {
-			nonconst_sig = SigSpec();
+			// most bits share one compared signal, so only the first one is
+			// copied and the rest are compared against it in place
+			const SigSpec *common_sig = nullptr;
 			std::vector<Const> values;
 			SigSpec a_port = sigmap(cell->getPort(ID::A));
 			for (auto bit : a_port) {
 				auto it = sig_cmp_prev.find(bit);
 				if (it == sig_cmp_prev.end()) {
-					nonconst_sig = SigSpec();
+					common_sig = nullptr;
 					break;
 				}
-				if (nonconst_sig.empty())
-					nonconst_sig = it->second.first;
-				else if (nonconst_sig != it->second.first) {
-					nonconst_sig = SigSpec();
+				if (common_sig == nullptr)
+					common_sig = &it->second.first;
+				else if (*common_sig != it->second.first) {
+					common_sig = nullptr;
 					break;
 				}
 				for (auto value : it->second.second)
 					values.push_back(value);
 			}
-			if (nonconst_sig.empty())
+			if (common_sig == nullptr)
 				continue;
+			nonconst_sig = *common_sig;
 			y_port = sigmap(cell->getPort(ID::Y));
 			sig_cmp_prev[y_port] = std::make_pair(nonconst_sig,std::move(values));
 		}
@@ -91,7 +94,7 @@ struct ExclusiveDatabase
 
 	bool query(const SigSpec &sig) const
 	{
-		SigSpec nonconst_sig;
+		const SigSpec *nonconst_sig = nullptr;
 		pool<Const> const_values;
 
 		for (auto bit : sig.bits()) {
@@ -99,9 +102,9 @@ struct ExclusiveDatabase
 			if (it == sig_cmp_prev.end())
 				return false;
 
-			if (nonconst_sig.empty())
-				nonconst_sig = it->second.first;
-			else if (nonconst_sig != it->second.first)
+			if (nonconst_sig == nullptr)
+				nonconst_sig = &it->second.first;
+			else if (nonconst_sig != &it->second.first && *nonconst_sig != it->second.first)
 				return false;
 
 			for (auto value : it->second.second)
@@ -356,6 +359,15 @@ struct MuxpackPass : public Pass {
 		int pmux_count = 0;
 
 		for (auto module : design->selected_modules()) {
+			bool has_mux = false;
+			for (auto cell : module->cells())
+				if (cell->type.in(ID($mux), ID($pmux))) {
+					has_mux = true;
+					break;
+				}
+			if (!has_mux)
+				continue;
+
 			MuxpackWorker worker(module);
 			mux_count += worker.mux_count;
 			pmux_count += worker.pmux_count;
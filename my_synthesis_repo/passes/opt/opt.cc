@@ -25,6 +25,65 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// Runs opt_* sub-passes only on the selected modules that were modified since
+// the same sub-pass (with the same arguments) last ran on them, using the
+// generation counter of the modules. The sub-passes also edit cell types,
+// parameters and attributes in place, which does not bump the counter, so
+// each of them bumps it for every module it changed.
+struct OptScheduler
+{
+	RTLIL::Design *design;
+	dict<std::string, dict<RTLIL::IdString, std::pair<RTLIL::Module*, unsigned int>>> last_run;
+	int module_runs = 0, module_skips = 0;
+
+	OptScheduler(RTLIL::Design *design) : design(design) { }
+
+	void call(const std::string &command)
+	{
+		auto &seen = last_run[command];
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		std::vector<RTLIL::Module*> todo;
+
+		for (auto module : modules) {
+			auto it = seen.find(module->name);
+			if (it != seen.end() && it->second.first == module && it->second.second == module->generation_) {
+				module_skips++;
+				continue;
+			}
+			todo.push_back(module);
+		}
+
+		// changes made by the sub-pass itself count, so it runs again on the modules it modified
+		for (auto module : todo)
+			seen[module->name] = std::make_pair(module, module->generation_);
+		module_runs += GetSize(todo);
+
+		if (todo.empty())
+			return;
+		if (GetSize(todo) == GetSize(modules)) {
+			Pass::call(design, command);
+			return;
+		}
+
+		RTLIL::Selection selection(false);
+		for (auto module : todo) {
+			if (design->selected_whole_module(module))
+				selection.selected_modules.insert(module->name);
+			else
+				selection.selected_members[module->name] = design->selection().selected_members.at(module->name);
+		}
+		Pass::call_on_selection(design, selection, command);
+	}
+
+	void log_summary(int iteration)
+	{
+		log("Iteration %d ran %d sub-pass/module combinations and skipped %d on unchanged modules.\n",
+				iteration, module_runs, module_skips);
+		module_runs = 0;
+		module_skips = 0;
+	}
+};
+
 struct OptPass : public Pass {
 	OptPass() : Pass("opt", "perform simple optimizations") { }
 	void help() override
@@ -62,6 +121,9 @@ struct OptPass : public Pass {
 		log("Note: Options in square brackets (such as [-keepdc]) are passed through to\n");
 		log("the opt_* commands when given to 'opt'.\n");
 		log("\n");
+		log("Each opt_* command only runs on the selected modules that were modified since\n");
+		log("it last ran on them. The number of skipped runs is logged for each iteration.\n");
+		log("\n");
 		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
@@ -145,41 +207,47 @@ struct OptPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		OptScheduler scheduler(design);
+		int iteration = 1;
+
 		if (fast_mode)
 		{
 			while (1) {
-				Pass::call(design, "opt_expr" + opt_expr_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				scheduler.call("opt_expr" + opt_expr_args);
+				scheduler.call("opt_merge" + opt_merge_args);
 				design->scratchpad_unset("opt.did_something");
 				if (!noff_mode)
-					Pass::call(design, "opt_dff" + opt_dff_args);
+					scheduler.call("opt_dff" + opt_dff_args);
 				if (design->scratchpad_get_bool("opt.did_something") == false)
 					break;
-				Pass::call(design, "opt_clean" + opt_clean_args);
+				scheduler.call("opt_clean" + opt_clean_args);
+				scheduler.log_summary(iteration++);
 				log_header(design, "Rerunning OPT passes. (Removed registers in this run.)\n");
 			}
-			Pass::call(design, "opt_clean" + opt_clean_args);
+			scheduler.call("opt_clean" + opt_clean_args);
 		}
 		else
 		{
-			Pass::call(design, "opt_expr" + opt_expr_args);
-			Pass::call(design, "opt_merge -nomux" + opt_merge_args);
+			scheduler.call("opt_expr" + opt_expr_args);
+			scheduler.call("opt_merge -nomux" + opt_merge_args);
 			while (1) {
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_muxtree");
-				Pass::call(design, "opt_reduce" + opt_reduce_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				scheduler.call("opt_muxtree");
+				scheduler.call("opt_reduce" + opt_reduce_args);
+				scheduler.call("opt_merge" + opt_merge_args);
 				if (opt_share)
-					Pass::call(design, "opt_share");
+					scheduler.call("opt_share");
 				if (!noff_mode)
-					Pass::call(design, "opt_dff" + opt_dff_args);
-				Pass::call(design, "opt_clean" + opt_clean_args);
-				Pass::call(design, "opt_expr" + opt_expr_args);
+					scheduler.call("opt_dff" + opt_dff_args);
+				scheduler.call("opt_clean" + opt_clean_args);
+				scheduler.call("opt_expr" + opt_expr_args);
 				if (design->scratchpad_get_bool("opt.did_something") == false)
 					break;
+				scheduler.log_summary(iteration++);
 				log_header(design, "Rerunning OPT passes. (Maybe there is more to do..)\n");
 			}
 		}
+		scheduler.log_summary(iteration);
 
 		design->optimize();
 		design->sort();
@@ -22,6 +22,7 @@
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
 #include "kernel/ffinit.h"
+#include "kernel/threading.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
@@ -31,17 +32,53 @@ PRIVATE_NAMESPACE_BEGIN
 
 using RTLIL::id2cstr;
 
+// Whether a cell or module must be kept, cached across calls. An entry is reused
+// while the module's generation counter is unchanged and the cell types it
+// instantiates still resolve to the same modules with the same result.
 struct keep_cache_t
 {
-	Design *design;
-	dict<Module*, bool> cache;
+	struct dep_t {
+		IdString type;
+		unsigned int hashidx;
+		bool keep;
+	};
+
+	struct entry_t {
+		unsigned int generation;
+		bool keep;
+		std::vector<dep_t> deps;
+	};
+
+	Design *design = nullptr;
 	bool purge_mode = false;
 
+	// keyed by Module::hashidx_, one cache for each purge mode
+	dict<unsigned int, entry_t> cache[2];
+	pool<unsigned int> checked, active;
+
+	// set while modules are cleaned on worker threads: all entries are
+	// checked by then and query() only reads them
+	bool frozen = false;
+
 	void reset(Design *design = nullptr, bool purge_mode = false)
 	{
 		this->design = design;
 		this->purge_mode = purge_mode;
-		cache.clear();
+		checked.clear();
+		active.clear();
+		frozen = false;
+	}
+
+	bool deps_unchanged(const entry_t &entry)
+	{
+		for (auto &dep : entry.deps) {
+			Module *module = design->module(dep.type);
+			if ((module ? module->hashidx_ : 0) != dep.hashidx)
+				return false;
+			if (module && query(module) != dep.keep)
+				return false;
+		}
+		return true;
 	}
 
 	bool query(Module *module)
@@ -51,29 +88,67 @@ struct keep_cache_t
 		if (module == nullptr)
 			return false;
 
-		if (cache.count(module))
-			return cache.at(module);
+		if (module->get_bool_attribute(ID::keep))
+			return true;
+
+		auto &c = cache[purge_mode];
+		unsigned int hashidx = module->hashidx_;
+		auto it = c.find(hashidx);
+
+		if (frozen) {
+			log_assert(it != c.end());
+			return it->second.keep;
+		}
+
+		if (it != c.end()) {
+			if (checked.count(hashidx) || active.count(hashidx))
+				return it->second.keep;
+			active.insert(hashidx);
+			bool valid = it->second.generation == module->generation_ && deps_unchanged(it->second);
+			active.erase(hashidx);
+			if (valid) {
+				checked.insert(hashidx);
+				return c.at(hashidx).keep;
+			}
+		}
 
-		cache[module] = true;
-		if (!module->get_bool_attribute(ID::keep)) {
-		    bool found_keep = false;
-		    for (auto cell : module->cells())
-			if (query(cell, true /* ignore_specify */)) {
-			    found_keep = true;
-			    break;
+		// a module that instantiates itself is kept while it is being looked at
+		c[hashidx] = entry_t{module->generation_, true, {}};
+		checked.insert(hashidx);
+
+		bool found_keep = false;
+		std::vector<dep_t> deps;
+		pool<IdString> types;
+		for (auto cell : module->cells()) {
+			if (query_cell(cell, true /* ignore_specify */)) {
+				found_keep = true;
+				break;
 			}
-		    for (auto wire : module->wires())
-			if (wire->get_bool_attribute(ID::keep)) {
-			    found_keep = true;
-			    break;
+			if (!types.insert(cell->type).second)
+				continue;
+			Module *submodule = design->module(cell->type);
+			bool submodule_keep = query(submodule);
+			deps.push_back(dep_t{cell->type, submodule ? submodule->hashidx_ : 0, submodule_keep});
+			if (submodule_keep) {
+				found_keep = true;
+				break;
 			}
-		    cache[module] = found_keep;
 		}
+		if (!found_keep)
+			for (auto wire : module->wires())
+				if (wire->get_bool_attribute(ID::keep)) {
+					found_keep = true;
+					break;
+				}
 
-		return cache[module];
+		entry_t &entry = c.at(hashidx);
+		entry.keep = found_keep;
+		entry.deps = std::move(deps);
+		return found_keep;
 	}
 
-	bool query(Cell *cell, bool ignore_specify = false)
+	// the part of query() that only looks at the cell itself
+	bool query_cell(Cell *cell, bool ignore_specify)
 	{
 		if (cell->type.in(ID($assert), ID($assume), ID($live), ID($fair), ID($cover)))
 			return true;
@@ -93,6 +168,14 @@ struct keep_cache_t
 		if (!purge_mode && cell->type == ID($scopeinfo))
 			return true;
 
+		return false;
+	}
+
+	bool query(Cell *cell, bool ignore_specify = false)
+	{
+		if (query_cell(cell, ignore_specify))
+			return true;
+
 		if (cell->module && cell->module->design)
 			return query(cell->module->design->module(cell->type));
 
@@ -100,13 +183,24 @@ struct keep_cache_t
 	}
 };
 
+// The state of a module after it was last cleaned. Cleaning is skipped while
+// the module and the modules it instantiates have the same generation, since
+// a second run would not find anything to remove.
+struct clean_state_t {
+	unsigned int generation;
+	bool purge_mode;
+	std::vector<std::tuple<IdString, unsigned int, unsigned int>> deps;
+};
+
 keep_cache_t keep_cache;
+dict<unsigned int, clean_state_t> clean_cache;
 CellTypes ct_reg, ct_all;
-int count_rm_cells, count_rm_wires;
+std::atomic<int> count_rm_cells, count_rm_wires;
+std::atomic<bool> clean_did_something;
 
 void rmunused_module_cells(Module *module, bool verbose)
 {
-	SigMap sigmap(module);
+	const SigMap &sigmap = SigMap::get(module);
 	dict<IdString, pool<Cell*>> mem2cells;
 	pool<IdString> mem_unused;
 	pool<Cell*> queue, unused;
@@ -205,7 +299,7 @@ void rmunused_module_cells(Module *module, bool verbose)
 	for (auto cell : unused) {
 		if (verbose)
 			log_debug("  removing unused `%s' cell `%s'.\n", cell->type.c_str(), cell->name.c_str());
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		clean_did_something = true;
 		if (RTLIL::builtin_ff_cell_types().count(cell->type))
 			ffinit.remove_init(cell->getPort(ID::Q));
 		module->remove(cell);
@@ -350,6 +444,7 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 
 	// we are removing all connections
 	module->connections_.clear();
+	module->notify_blackout();
 
 	// used signals sigmapped
 	SigPool used_signals;
@@ -508,7 +603,7 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		log_debug("  removed %d unused temporary wires.\n", del_temp_wires_count);
 
 	if (!del_wires_queue.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		clean_did_something = true;
 
 	return !del_wires_queue.empty();
 }
@@ -519,7 +614,7 @@ bool rmunused_module_init(RTLIL::Module *module, bool verbose)
 	CellTypes fftypes;
 	fftypes.setup_internals_mem();
 
-	SigMap sigmap(module);
+	SigMap sigmap = SigMap::get(module);
 	dict<SigBit, State> qbits;
 
 	for (auto cell : module->cells())
@@ -588,8 +683,11 @@ bool rmunused_module_init(RTLIL::Module *module, bool verbose)
 	next_wire:;
 	}
 
-	if (did_something)
-		module->design->scratchpad_set_bool("opt.did_something", true);
+	// attribute edits do not go through the module's methods
+	if (did_something) {
+		module->generation_++;
+		clean_did_something = true;
+	}
 
 	return did_something;
 }
@@ -617,13 +715,82 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool
 		module->remove(cell);
 	}
 	if (!delcells.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		clean_did_something = true;
 
 	rmunused_module_cells(module, verbose);
 	while (rmunused_module_signals(module, purge_mode, verbose)) { }
 
 	if (rminit && rmunused_module_init(module, verbose))
 		while (rmunused_module_signals(module, purge_mode, verbose)) { }
+
+	size_t released = module->trim_storage();
+	if (verbose && released > 0)
+		log_debug("  released %zu bytes of unused cell and wire storage.\n", released);
+}
+
+bool clean_state_unchanged(const clean_state_t &state, RTLIL::Design *design, RTLIL::Module *module, bool purge_mode)
+{
+	if (state.generation != module->generation_ || (purge_mode && !state.purge_mode))
+		return false;
+	for (auto &dep : state.deps) {
+		Module *submodule = design->module(std::get<0>(dep));
+		if ((submodule ? submodule->hashidx_ : 0) != std::get<1>(dep))
+			return false;
+		if (submodule && submodule->generation_ != std::get<2>(dep))
+			return false;
+	}
+	return true;
+}
+
+void rmunused_design(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules, bool purge_mode, bool verbose)
+{
+	keep_cache.reset(design, purge_mode);
+	for (auto module : design->modules())
+		keep_cache.query(module);
+
+	std::vector<RTLIL::Module*> todo;
+	dict<RTLIL::Module*, int> todo_index;
+	for (auto module : modules) {
+		auto it = clean_cache.find(module->hashidx_);
+		if (it != clean_cache.end() && clean_state_unchanged(it->second, design, module, purge_mode))
+			continue;
+		todo_index[module] = GetSize(todo);
+		todo.push_back(module);
+	}
+
+	std::vector<pool<IdString>> todo_types(todo.size());
+	keep_cache.frozen = true;
+	parallel_for_modules(design, todo, [&](RTLIL::Module *module) {
+		rmunused_module(module, purge_mode, verbose, true);
+		auto &types = todo_types[todo_index.at(module)];
+		for (auto cell : module->cells())
+			types.insert(cell->type);
+	});
+	keep_cache.frozen = false;
+
+	for (int i = 0; i < GetSize(todo); i++) {
+		clean_state_t &state = clean_cache[todo[i]->hashidx_];
+		state.generation = todo[i]->generation_;
+		state.purge_mode = purge_mode;
+		state.deps.clear();
+		for (auto type : todo_types[i]) {
+			Module *submodule = design->module(type);
+			state.deps.emplace_back(type, submodule ? submodule->hashidx_ : 0, submodule ? submodule->generation_ : 0);
+		}
+	}
+
+	// forget modules that are gone
+	pool<unsigned int> live_modules;
+	for (auto module : design->modules())
+		live_modules.insert(module->hashidx_);
+	for (auto &c : keep_cache.cache)
+		for (auto it = c.begin(); it != c.end();)
+			it = live_modules.count(it->first) ? std::next(it) : c.erase(it);
+	for (auto it = clean_cache.begin(); it != clean_cache.end();)
+		it = live_modules.count(it->first) ? std::next(it) : clean_cache.erase(it);
+
+	if (clean_did_something)
+		design->scratchpad_set_bool("opt.did_something", true);
 }
 
 struct OptCleanPass : public Pass {
@@ -640,6 +807,8 @@ struct OptCleanPass : public Pass {
 		log("after the passes that do the actual work.\n");
 		log("\n");
 		log("This pass only operates on completely selected modules without processes.\n");
+		log("Modules that were not modified since they were last cleaned are skipped, and\n");
+		log("the other modules are cleaned in parallel when Yosys is started with -j.\n");
 		log("\n");
 		log("    -purge\n");
 		log("        also remove internal nets if they have a public name\n");
@@ -672,15 +841,16 @@ struct OptCleanPass : public Pass {
 
 		count_rm_cells = 0;
 		count_rm_wires = 0;
+		clean_did_something = false;
 
-		for (auto module : design->selected_whole_modules_warn()) {
-			if (module->has_processes_warn())
-				continue;
-			rmunused_module(module, purge_mode, true, true);
-		}
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules_warn())
+			if (!module->has_processes_warn())
+				modules.push_back(module);
+		rmunused_design(design, modules, purge_mode, true);
 
 		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells.load(), count_rm_wires.load());
 
 		design->optimize();
 		design->sort();
@@ -734,16 +904,17 @@ struct CleanPass : public Pass {
 
 		count_rm_cells = 0;
 		count_rm_wires = 0;
+		clean_did_something = false;
 
-		for (auto module : design->selected_whole_modules()) {
-			if (module->has_processes())
-				continue;
-			rmunused_module(module, purge_mode, ys_debug(), true);
-		}
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules())
+			if (!module->has_processes())
+				modules.push_back(module);
+		rmunused_design(design, modules, purge_mode, ys_debug());
 
 		log_suppressed();
 		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells.load(), count_rm_wires.load());
 
 		design->optimize();
 		design->sort();
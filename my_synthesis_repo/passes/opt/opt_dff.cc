@@ -739,6 +739,30 @@ struct OptDffWorker
 		ModWalker modwalker(module->design, module);
 		QuickConeSat qcsat(modwalker);
 
+		// Random patterns rule out most bits that do change before the
+		// (much more expensive) SAT query is built.
+		QuickConeSim qcsim(qcsat);
+		if (opt.sat)
+			qcsim.run();
+
+		auto can_change = [&](SigBit q, SigBit d, State val) {
+			uint64_t q_patterns, d_patterns;
+			if (qcsim.get(q, q_patterns) && qcsim.get(d, d_patterns)) {
+				uint64_t init_patterns = val == State::S1 ? ~uint64_t(0) : 0;
+				if (~(q_patterns ^ init_patterns) & (d_patterns ^ init_patterns) & qcsim.valid_patterns)
+					return true;
+			}
+
+			int init_sat_pi = qcsat.importSigBit(val);
+			int q_sat_pi = qcsat.importSigBit(q);
+			int d_sat_pi = qcsat.importSigBit(d);
+
+			qcsat.prepare();
+
+			// Try to find out whether the register bit can change under some circumstances
+			return qcsat.ez->solve(qcsat.ez->IFF(q_sat_pi, init_sat_pi), qcsat.ez->NOT(qcsat.ez->IFF(d_sat_pi, init_sat_pi)));
+		};
+
 		// Run as a separate sub-pass, so that we don't mutate (non-FF) cells under ModWalker.
 		bool did_something = false;
 		for (auto cell : module->selected_cells()) {
@@ -776,17 +800,8 @@ struct OptDffWorker
 						if (val != State::S0 && val != State::S1)
 							continue;
 
-						int init_sat_pi = qcsat.importSigBit(val);
-						int q_sat_pi = qcsat.importSigBit(ff.sig_q[i]);
-						int d_sat_pi = qcsat.importSigBit(ff.sig_d[i]);
-
-						qcsat.prepare();
-
-						// Try to find out whether the register bit can change under some circumstances
-						bool counter_example_found = qcsat.ez->solve(qcsat.ez->IFF(q_sat_pi, init_sat_pi), qcsat.ez->NOT(qcsat.ez->IFF(d_sat_pi, init_sat_pi)));
-
 						// If the register bit cannot change, we can replace it with a constant
-						if (counter_example_found)
+						if (can_change(ff.sig_q[i], ff.sig_d[i], val))
 							continue;
 					}
 				}
@@ -804,17 +819,8 @@ struct OptDffWorker
 						if (val != State::S0 && val != State::S1)
 							continue;
 
-						int init_sat_pi = qcsat.importSigBit(val);
-						int q_sat_pi = qcsat.importSigBit(ff.sig_q[i]);
-						int d_sat_pi = qcsat.importSigBit(ff.sig_ad[i]);
-
-						qcsat.prepare();
-
-						// Try to find out whether the register bit can change under some circumstances
-						bool counter_example_found = qcsat.ez->solve(qcsat.ez->IFF(q_sat_pi, init_sat_pi), qcsat.ez->NOT(qcsat.ez->IFF(d_sat_pi, init_sat_pi)));
-
 						// If the register bit cannot change, we can replace it with a constant
-						if (counter_example_found)
+						if (can_change(ff.sig_q[i], ff.sig_ad[i], val))
 							continue;
 					}
 				}
@@ -872,6 +878,8 @@ struct OptDffPass : public Pass {
 		log("    -sat\n");
 		log("        additionally invoke SAT solver to detect and remove flip-flops (with\n");
 		log("        non-constant inputs) that can also be replaced with a constant driver\n");
+		log("        (candidates are first simulated on 64 random input patterns, and only\n");
+		log("        the ones that no pattern rules out are passed to the solver)\n");
 		log("\n");
 		log("    -keepdc\n");
 		log("        some optimizations change the behavior of the circuit with respect to\n");
@@ -920,10 +928,14 @@ struct OptDffPass : public Pass {
 		bool did_something = false;
 		for (auto mod : design->selected_modules()) {
 			OptDffWorker worker(opt, mod);
-			if (worker.run())
-				did_something = true;
+			bool changed = worker.run();
 			if (worker.run_constbits())
+				changed = true;
+			// FF types and parameters are edited in place, see opt_expr
+			if (changed) {
+				mod->generation_++;
 				did_something = true;
+			}
 		}
 
 		if (did_something)
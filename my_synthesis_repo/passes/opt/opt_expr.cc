@@ -393,39 +393,196 @@ int get_highest_hot_index(RTLIL::SigSpec signal)
 	return -1;
 }
 
-void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc, bool noclkinv)
+bool is_inverter_type(RTLIL::IdString type)
+{
+	return type.in(ID($_NOT_), ID($not), ID($logic_not), ID($mux), ID($_MUX_));
+}
+
+// Records which cells replace_const_cells() has to visit again: cells that were
+// added or rewritten, and cells reading a signal whose driver changed or whose
+// representative in the module's SigMap changed. Like CachedSigMap, it follows
+// Module::connect() with a SigMap of its own.
+struct OptExprWorklist : public RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	dict<RTLIL::SigBit, pool<RTLIL::IdString>> readers;
+	pool<RTLIL::IdString> inverters;
+	pool<RTLIL::IdString> changed;
+	bool blackout;
+
+	OptExprWorklist(RTLIL::Module *module) : module(module)
+	{
+		module->monitors.insert(this);
+		reset();
+	}
+
+	~OptExprWorklist()
+	{
+		module->monitors.erase(this);
+	}
+
+	void reset()
+	{
+		sigmap.set(module);
+		readers.clear();
+		inverters.clear();
+		changed.clear();
+		for (auto cell : module->cells()) {
+			if (cell->type[0] != '$')
+				continue;
+			if (is_inverter_type(cell->type))
+				inverters.insert(cell->name);
+			for (auto &conn : cell->connections())
+				add_reader(cell, conn.second);
+		}
+		blackout = false;
+	}
+
+	void add_reader(RTLIL::Cell *cell, const RTLIL::SigSpec &sig)
+	{
+		for (auto bit : sigmap(sig))
+			if (bit.wire != nullptr)
+				readers[bit].insert(cell->name);
+	}
+
+	void readers_changed(const RTLIL::SigSpec &sig)
+	{
+		for (auto bit : sigmap(sig)) {
+			auto it = readers.find(bit);
+			if (it != readers.end())
+				changed.insert(it->second.begin(), it->second.end());
+		}
+	}
+
+	// Also called for rewrites that only change the type or parameters of a cell
+	void cell_changed(RTLIL::IdString name)
+	{
+		changed.insert(name);
+		RTLIL::Cell *cell = module->cell(name);
+		if (cell == nullptr)
+			return;
+		if (is_inverter_type(cell->type))
+			inverters.insert(name);
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first))
+				readers_changed(conn.second);
+	}
+
+	void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString &port, const RTLIL::SigSpec &old_sig, const RTLIL::SigSpec &sig) override
+	{
+		if (cell->type[0] == '$') {
+			changed.insert(cell->name);
+			if (is_inverter_type(cell->type))
+				inverters.insert(cell->name);
+			add_reader(cell, sig);
+		}
+		if (cell->output(port) || !cell->known()) {
+			readers_changed(old_sig);
+			readers_changed(sig);
+		}
+	}
+
+	void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig &sigsig) override
+	{
+		log_assert(module == mod);
+
+		// Module::connect() drops constant lhs bits and calls the
+		// monitors again with the rest
+		if (blackout || sigsig.first.has_const())
+			return;
+
+		RTLIL::SigSpec old_sig = sigmap(sigsig.first);
+		old_sig.append(sigmap(sigsig.second));
+		sigmap.add(sigsig.first, sigsig.second);
+
+		for (auto bit : old_sig) {
+			RTLIL::SigBit new_bit = sigmap(bit);
+			if (bit.wire == nullptr || new_bit == bit)
+				continue;
+			auto it = readers.find(bit);
+			if (it == readers.end())
+				continue;
+			pool<RTLIL::IdString> bit_readers;
+			std::swap(bit_readers, it->second);
+			readers.erase(it);
+			changed.insert(bit_readers.begin(), bit_readers.end());
+			if (new_bit.wire != nullptr)
+				readers[new_bit].insert(bit_readers.begin(), bit_readers.end());
+		}
+	}
+
+	void notify_connect(RTLIL::Module *mod, const std::vector<RTLIL::SigSig>&) override
+	{
+		log_assert(module == mod);
+		blackout = true;
+	}
+
+	void notify_blackout(RTLIL::Module *mod) override
+	{
+		log_assert(module == mod);
+		blackout = true;
+	}
+};
+
+// With a worklist, only the cells named in visit are considered for rewriting
+// (visit == nullptr visits all cells), and the changes are left in the worklist.
+void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc, bool noclkinv,
+		OptExprWorklist *worklist = nullptr, const pool<RTLIL::IdString> *visit = nullptr)
 {
 	CellTypes ct_combinational;
 	ct_combinational.setup_internals();
 	ct_combinational.setup_stdcells();
 
-	SigMap assign_map(module);
+	SigMap assign_map = SigMap::get(module);
 	dict<RTLIL::SigSpec, RTLIL::SigSpec> invert_map;
 
 	TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
 	dict<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
 	dict<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
 
-	for (auto cell : module->cells())
-		if (design->selected(module, cell) && cell->type[0] == '$') {
-			if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
-					GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
-			if (cell->type.in(ID($mux), ID($_MUX_)) &&
-					cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::S));
-			if (ct_combinational.cell_known(cell->type))
-				for (auto &conn : cell->connections()) {
-					RTLIL::SigSpec sig = assign_map(conn.second);
-					sig.remove_const();
-					if (ct_combinational.cell_input(cell->type, conn.first))
-						cell_to_inbit[cell].insert(sig.begin(), sig.end());
-					if (ct_combinational.cell_output(cell->type, conn.first))
-						for (auto &bit : sig)
-							outbit_to_cell[bit].insert(cell);
-				}
-                        cells.node(cell);
+	std::vector<RTLIL::Cell*> candidates, inverter_candidates;
+	if (visit == nullptr) {
+		for (auto cell : module->cells())
+			if (design->selected(module, cell) && cell->type[0] == '$')
+				candidates.push_back(cell);
+		inverter_candidates = candidates;
+	} else {
+		log_assert(worklist != nullptr);
+		for (auto name : *visit) {
+			RTLIL::Cell *cell = module->cell(name);
+			if (cell != nullptr && design->selected(module, cell) && cell->type[0] == '$')
+				candidates.push_back(cell);
+		}
+		for (auto name : worklist->inverters) {
+			RTLIL::Cell *cell = module->cell(name);
+			if (cell != nullptr && design->selected(module, cell))
+				inverter_candidates.push_back(cell);
 		}
+	}
+
+	for (auto cell : inverter_candidates) {
+		if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
+				GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
+		if (cell->type.in(ID($mux), ID($_MUX_)) &&
+				cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::S));
+	}
+
+	for (auto cell : candidates) {
+		if (ct_combinational.cell_known(cell->type))
+			for (auto &conn : cell->connections()) {
+				RTLIL::SigSpec sig = assign_map(conn.second);
+				sig.remove_const();
+				if (ct_combinational.cell_input(cell->type, conn.first))
+					cell_to_inbit[cell].insert(sig.begin(), sig.end());
+				if (ct_combinational.cell_output(cell->type, conn.first))
+					for (auto &bit : sig)
+						outbit_to_cell[bit].insert(cell);
+			}
+		cells.node(cell);
+	}
 
         // Build the graph for the topological sort.
 	for (auto &it_right : cell_to_inbit) {
@@ -442,6 +599,10 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 	for (auto cell : cells.sorted)
 	{
+		RTLIL::IdString cell_name = cell->name;
+		bool did_something_before = did_something;
+		did_something = false;
+
 #define ACTION_DO(_p_, _s_) do { cover("opt.opt_expr.action_" S__LINE__); replace_cell(assign_map, module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
 #define ACTION_DO_Y(_v_) ACTION_DO(ID::Y, RTLIL::SigSpec(RTLIL::State::S ## _v_))
 
@@ -2189,7 +2350,10 @@ skip_alu_split:
 			}
 		}
 
-	next_cell:;
+	next_cell:
+		if (did_something && worklist != nullptr)
+			worklist->cell_changed(cell_name);
+		did_something = did_something || did_something_before;
 #undef ACTION_DO
 #undef ACTION_DO_Y
 #undef FOLD_1ARG_CELL
@@ -2198,7 +2362,7 @@ skip_alu_split:
 }
 
 void replace_const_connections(RTLIL::Module *module) {
-	SigMap assign_map(module);
+	const SigMap &assign_map = SigMap::get(module);
 	for (auto cell : module->selected_cells())
 	{
 		std::vector<std::pair<RTLIL::IdString, SigSpec>> changes;
@@ -2303,31 +2467,62 @@ struct OptExprPass : public Pass {
 		for (auto module : design->selected_modules())
 		{
 			log("Optimizing module %s.\n", log_id(module));
+			bool changed = false;
 
 			if (undriven) {
 				did_something = false;
 				replace_undriven(module, ct);
 				if (did_something)
 					design->scratchpad_set_bool("opt.did_something", true);
-			}
+				changed |= did_something;
+			}
+
+			// The first run of each replace_const_cells() variant visits all
+			// cells, later runs only the cells changed or affected since that
+			// variant last ran.
+			OptExprWorklist worklist(module);
+			pool<IdString> visit[2];
+			bool visit_all[2] = { true, true };
+			auto run_replace_const_cells = [&](bool consume_x) {
+				pool<IdString> cells;
+				std::swap(cells, visit[consume_x]);
+				bool all = visit_all[consume_x];
+				visit_all[consume_x] = false;
+				replace_const_cells(design, module, consume_x, mux_undef, mux_bool, do_fine, keepdc, noclkinv, &worklist, all ? nullptr : &cells);
+				if (worklist.blackout) {
+					worklist.reset();
+					visit_all[0] = visit_all[1] = true;
+				}
+				for (auto &v : visit)
+					v.insert(worklist.changed.begin(), worklist.changed.end());
+				worklist.changed.clear();
+			};
 
 			do {
 				do {
 					did_something = false;
-					replace_const_cells(design, module, false /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
+					run_replace_const_cells(false /* consume_x */);
 					if (did_something)
 						design->scratchpad_set_bool("opt.did_something", true);
+					changed |= did_something;
 				} while (did_something);
 				if (!keepdc)
-					replace_const_cells(design, module, true /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
+					run_replace_const_cells(true /* consume_x */);
 				if (did_something)
 					design->scratchpad_set_bool("opt.did_something", true);
+				changed |= did_something;
 			} while (did_something);
 
 			did_something = false;
 			replace_const_connections(module);
 			if (did_something)
 				design->scratchpad_set_bool("opt.did_something", true);
+			changed |= did_something;
+
+			// cell types, parameters and init attributes are edited in place,
+			// which does not count as a change of the module by itself
+			if (changed)
+				module->generation_++;
 
 			log_suppressed();
 		}
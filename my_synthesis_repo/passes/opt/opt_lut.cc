@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
+#include "kernel/truthtable.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -48,27 +49,34 @@ struct OptLutWorker
 
 	int eliminated_count = 0, combined_count = 0;
 
-	bool evaluate_lut(RTLIL::Cell *lut, dict<SigBit, bool> inputs)
+	// Returns the function of a LUT over num_vars variables, given the functions
+	// of some of its input signals. All other inputs count as constants.
+	TruthTable evaluate_lut(RTLIL::Cell *lut, const dict<SigBit, TruthTable> &inputs, int num_vars)
 	{
 		SigSpec lut_input = sigmap(lut->getPort(ID::A));
 		int lut_width = lut->getParam(ID::WIDTH).as_int();
 		Const lut_table = lut->getParam(ID::LUT);
-		int lut_index = 0;
 
+		TruthTable mask(lut_width);
+		for (int i = 0; i < 1 << lut_width; i++)
+			mask.set(i, lut_table.extract(i).as_bool());
+
+		std::vector<TruthTable> input_tables;
 		for (int i = 0; i < lut_width; i++)
 		{
 			SigBit input = sigmap(lut_input[i]);
 			if (inputs.count(input))
-			{
-				lut_index |= inputs[input] << i;
-			}
+				input_tables.push_back(inputs.at(input));
 			else
-			{
-				lut_index |= SigSpec(lut_input[i]).as_bool() << i;
-			}
+				input_tables.push_back(TruthTable(num_vars, SigSpec(lut_input[i]).as_bool()));
 		}
 
-		return lut_table.extract(lut_index).as_bool();
+		return TruthTable::lut(mask, input_tables);
+	}
+
+	static bool lut_too_wide(RTLIL::Cell *lut)
+	{
+		return lut->getParam(ID::WIDTH).as_int() > TruthTable::max_vars;
 	}
 
 	void show_stats_by_arity()
@@ -218,6 +226,8 @@ struct OptLutWorker
 			}
 
 			auto lut = worklist.pop();
+			if (lut_too_wide(lut))
+				continue;
 			SigSpec lut_input = sigmap(lut->getPort(ID::A));
 			pool<int> &lut_dlogic_inputs = luts_dlogic_inputs[lut];
 
@@ -228,28 +238,16 @@ struct OptLutWorker
 					lut_inputs.push_back(sigmap(bit));
 			}
 
-			bool const0_match = true;
-			bool const1_match = true;
-			vector<bool> input_matches;
+			dict<SigBit, TruthTable> eval_inputs;
 			for (size_t i = 0; i < lut_inputs.size(); i++)
-				input_matches.push_back(true);
+				eval_inputs[lut_inputs[i]] = TruthTable::var(GetSize(lut_inputs), i);
+			TruthTable value = evaluate_lut(lut, eval_inputs, GetSize(lut_inputs));
 
-			for (int eval = 0; eval < 1 << lut_inputs.size(); eval++)
-			{
-				dict<SigBit, bool> eval_inputs;
-				for (size_t i = 0; i < lut_inputs.size(); i++)
-					eval_inputs[lut_inputs[i]] = (eval >> i) & 1;
-				bool value = evaluate_lut(lut, eval_inputs);
-				if (value != 0)
-					const0_match = false;
-				if (value != 1)
-					const1_match = false;
-				for (size_t i = 0; i < lut_inputs.size(); i++)
-				{
-					if (value != eval_inputs[lut_inputs[i]])
-						input_matches[i] = false;
-				}
-			}
+			bool const0_match = value.is_const(false);
+			bool const1_match = value.is_const(true);
+			vector<bool> input_matches;
+			for (size_t i = 0; i < lut_inputs.size(); i++)
+				input_matches.push_back(value == eval_inputs.at(lut_inputs[i]));
 
 			int input_match = -1;
 			for (size_t i = 0; i < lut_inputs.size(); i++)
@@ -455,6 +453,11 @@ struct OptLutWorker
 					}
 
 					int lutM_width = lutM->getParam(ID::WIDTH).as_int();
+					if (lut_too_wide(lutA) || lut_too_wide(lutB))
+					{
+						log_debug("  Not combining LUTs (too wide to evaluate).\n");
+						continue;
+					}
 					SigSpec lutM_input = sigmap(lutM->getPort(ID::A));
 					std::vector<SigBit> lutM_new_inputs;
 					for (int i = 0; i < lutM_width; i++)
@@ -484,17 +487,11 @@ struct OptLutWorker
 					}
 					log_assert(lutR_unique.size() == 0);
 
-					RTLIL::Const lutM_new_table(State::Sx, 1 << lutM_width);
-					for (int eval = 0; eval < 1 << lutM_width; eval++)
-					{
-						dict<SigBit, bool> eval_inputs;
-						for (size_t i = 0; i < lutM_new_inputs.size(); i++)
-						{
-							eval_inputs[lutM_new_inputs[i]] = (eval >> i) & 1;
-						}
-						eval_inputs[lutA_output] = evaluate_lut(lutA, eval_inputs);
-						lutM_new_table[eval] = (RTLIL::State) evaluate_lut(lutB, eval_inputs);
-					}
+					dict<SigBit, TruthTable> eval_inputs;
+					for (size_t i = 0; i < lutM_new_inputs.size(); i++)
+						eval_inputs[lutM_new_inputs[i]] = TruthTable::var(lutM_width, i);
+					eval_inputs[lutA_output] = evaluate_lut(lutA, eval_inputs, lutM_width);
+					RTLIL::Const lutM_new_table = evaluate_lut(lutB, eval_inputs, lutM_width).to_const();
 
 					log_debug("  Cell A truth table: %s.\n", lutA->getParam(ID::LUT).as_string().c_str());
 					log_debug("  Cell B truth table: %s.\n", lutB->getParam(ID::LUT).as_string().c_str());
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/truthtable.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -146,6 +147,10 @@ struct OptLutInsPass : public Pass {
 						continue;
 					}
 				}
+				// Fully defined masks are handled as truth tables, anything
+				// else falls back to comparing the mask bits one by one.
+				TruthTable tt;
+				bool have_tt = GetSize(inputs) <= TruthTable::max_vars && TruthTable::from_const(lut, GetSize(inputs), tt);
 				std::vector<int> swizzle;
 				std::vector<SigBit> new_inputs;
 				bool doit = false;
@@ -165,7 +170,9 @@ struct OptLutInsPass : public Pass {
 							doit = true;
 					} else {
 						bool redundant = true;
-						for (int j = 0; j < GetSize(lut); j++) {
+						if (have_tt)
+							redundant = !tt.depends_on(i);
+						else for (int j = 0; j < GetSize(lut); j++) {
 							if (lut[j] != lut[j ^ 1 << i])
 								redundant = false;
 						}
@@ -200,7 +207,9 @@ struct OptLutInsPass : public Pass {
 					}
 				}
 				Const new_lut(0, 1 << GetSize(new_inputs));
-				for (int i = 0; i < GetSize(new_lut); i++) {
+				if (have_tt)
+					new_lut = tt.permute(swizzle, GetSize(new_inputs)).to_const();
+				else for (int i = 0; i < GetSize(new_lut); i++) {
 					int lidx = 0;
 					for (int j = 0; j < GetSize(inputs); j++) {
 						int val;
@@ -34,6 +34,7 @@ struct OptMemPass : public Pass {
 		log("    opt_mem [options] [selection]\n");
 		log("\n");
 		log("This pass performs various optimizations on memories in the design.\n");
+		log("Modules in which it found nothing to do are skipped until they change.\n");
 		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
@@ -50,14 +51,25 @@ struct OptMemPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		static MemPassCache cache;
+
 		int total_count = 0;
 		for (auto module : design->selected_modules()) {
 			if (module->has_processes_warn())
 				continue;
+			if (cache.skip(module))
+				continue;
+
+			std::vector<Mem> memories = Mem::get_selected_memories(module);
+			int module_count = total_count;
+			if (memories.empty()) {
+				cache.update(module, false);
+				continue;
+			}
 
 			SigMap sigmap(module);
 			FfInitVals initvals(&sigmap, module);
-			for (auto &mem : Mem::get_selected_memories(module)) {
+			for (auto &mem : memories) {
 				std::vector<bool> always_0(mem.width, true);
 				std::vector<bool> always_1(mem.width, true);
 				bool changed = false;
@@ -214,6 +226,7 @@ struct OptMemPass : public Pass {
 					mem.emit();
 				}
 			}
+			cache.update(module, total_count != module_count);
 		}
 
 		if (total_count)
@@ -135,7 +135,7 @@ struct OptMemFeedbackWorker
 		return conditions_logic_cache[key] = terms;
 	}
 
-	void translate_rd_feedback_to_en(Mem &mem)
+	bool translate_rd_feedback_to_en(Mem &mem)
 	{
 		// Look for async read ports that may be suitable for feedback paths.
 		dict<RTLIL::SigSpec, std::vector<pool<RTLIL::SigBit>>> async_rd_bits;
@@ -154,7 +154,7 @@ struct OptMemFeedbackWorker
 		}
 
 		if (async_rd_bits.empty())
-			return;
+			return false;
 
 		// Look for actual feedback paths.
 		std::vector<FeedbackPath> paths;
@@ -187,7 +187,7 @@ struct OptMemFeedbackWorker
 		}
 
 		if (paths.empty())
-			return;
+			return false;
 
 		// Now determine which read ports are actually used only for
 		// feedback paths, and can be removed.
@@ -218,7 +218,7 @@ struct OptMemFeedbackWorker
 		}
 
 		if (feedback_ok.empty())
-			return;
+			return false;
 
 		// Prepare a feedback condition list grouped by port bits.
 
@@ -228,7 +228,7 @@ struct OptMemFeedbackWorker
 				portbit_conds[std::make_pair(path.wrport_idx, path.data_bit_idx)].insert(path.condition);
 
 		if (portbit_conds.empty())
-			return;
+			return false;
 
 		// Okay, let's do it.
 
@@ -265,6 +265,7 @@ struct OptMemFeedbackWorker
 			module->connect(bit, State::Sx);
 
 		design->scratchpad_set_bool("opt.did_something", true);
+		return true;
 	}
 
 	// -------------
@@ -273,14 +274,27 @@ struct OptMemFeedbackWorker
 
 	OptMemFeedbackWorker(RTLIL::Design *design) : design(design) {}
 
-	void operator()(RTLIL::Module* module)
+	// returns true if the module was changed
+	bool operator()(RTLIL::Module* module)
 	{
 		std::vector<Mem> memories = Mem::get_selected_memories(module);
 
+		// the mux and fanout index below is only needed for memories
+		// with both asynchronous read ports and write ports
+		bool candidates = false;
+		for (auto &mem : memories)
+			if (!mem.wr_ports.empty())
+				for (auto &port : mem.rd_ports)
+					if (!port.clk_enable)
+						candidates = true;
+		if (!candidates)
+			return false;
+
 		this->module = module;
 		sigmap.set(module);
 		initvals.set(&sigmap, module);
 		sig_to_mux.clear();
+		sig_users_count.clear();
 		conditions_logic_cache.clear();
 
 		sigmap_xmux = sigmap;
@@ -317,8 +331,10 @@ struct OptMemFeedbackWorker
 						sig_users_count[bit]++;
 		}
 
+		bool changed = false;
 		for (auto &mem : memories)
-			translate_rd_feedback_to_en(mem);
+			changed |= translate_rd_feedback_to_en(mem);
+		return changed;
 	}
 };
 
@@ -339,10 +355,12 @@ struct OptMemFeedbackPass : public Pass {
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override {
 		log_header(design, "Executing OPT_MEM_FEEDBACK pass (finding memory read-to-write feedback paths).\n");
 		extra_args(args, 1, design);
+		static MemPassCache cache;
 		OptMemFeedbackWorker worker(design);
 
 		for (auto module : design->selected_modules())
-			worker(module);
+			if (!cache.skip(module))
+				cache.update(module, worker(module));
 	}
 } OptMemFeedbackPass;
 
@@ -44,14 +44,32 @@ struct OptMemPriorityPass : public Pass {
 		log_header(design, "Executing OPT_MEM_PRIORITY pass (removing unnecessary memory write priority relations).\n");
 		extra_args(args, 1, design);
 
+		static MemPassCache cache;
 		ModWalker modwalker(design);
 
 		int total_count = 0;
 		for (auto module : design->selected_modules()) {
+			if (cache.skip(module))
+				continue;
+
+			// the module index and the solver are only built for modules
+			// with write port priorities, and shared by all their memories
+			std::vector<Mem> memories = Mem::get_selected_memories(module);
+			bool has_priority = false;
+			for (auto &mem : memories)
+				for (auto &wport : mem.wr_ports)
+					if (std::find(wport.priority_mask.begin(), wport.priority_mask.end(), true) != wport.priority_mask.end())
+						has_priority = true;
+			if (!has_priority) {
+				cache.update(module, false);
+				continue;
+			}
+
+			int module_count = total_count;
 			modwalker.setup(module);
-			for (auto &mem : Mem::get_selected_memories(module)) {
+			QuickConeSat qcsat(modwalker);
+			for (auto &mem : memories) {
 				bool mem_changed = false;
-				QuickConeSat qcsat(modwalker);
 				for (int i = 0; i < GetSize(mem.wr_ports); i++) {
 					auto &wport1 = mem.wr_ports[i];
 					for (int j = 0; j < GetSize(mem.wr_ports); j++) {
@@ -97,6 +115,7 @@ struct OptMemPriorityPass : public Pass {
 				if (mem_changed)
 					mem.emit();
 			}
+			cache.update(module, total_count != module_count);
 		}
 
 		if (total_count)
@@ -49,8 +49,13 @@ struct OptMemWidenPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		static MemPassCache cache;
+
 		int total_count = 0;
 		for (auto module : design->selected_modules()) {
+			if (cache.skip(module))
+				continue;
+			int module_count = total_count;
 			for (auto &mem : Mem::get_selected_memories(module)) {
 				// If the memory has no read ports, opt_clean will remove it
 				// instead.
@@ -96,6 +101,7 @@ struct OptMemWidenPass : public Pass {
 				}
 				mem.emit();
 			}
+			cache.update(module, total_count != module_count);
 		}
 
 		if (total_count)
@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -65,7 +66,7 @@ struct OptMergeWorker
 		}
 	}
 
-	std::string int_to_hash_string(unsigned int v)
+	static std::string int_to_hash_string(unsigned int v)
 	{
 		if (v == 0)
 			return "0";
@@ -77,59 +78,50 @@ struct OptMergeWorker
 		return str;
 	}
 
-        uint64_t hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
+	// The connections that take part in the hash, with assign_map applied to
+	// the inputs and the init value in place of the 'Q' output of state
+	// elements. This is the only part of the hash that reads assign_map and
+	// initvals, so hash_connections() below may run on several threads.
+	dict<RTLIL::IdString, RTLIL::SigSpec> hashed_connections(const RTLIL::Cell *cell)
+	{
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn;
+		for (auto &it : cell->connections()) {
+			if (cell->output(it.first)) {
+				if (it.first == ID::Q && RTLIL::builtin_ff_cell_types().count(cell->type)) {
+					// For the 'Q' output of state elements,
+					//   use its (* init *) attribute value
+					conn[it.first] = initvals(it.second);
+				}
+			}
+			else
+				conn[it.first] = assign_map(it.second);
+		}
+		return conn;
+	}
+
+	static uint64_t hash_connections(const RTLIL::Cell *cell, dict<RTLIL::IdString, RTLIL::SigSpec> &conn)
 	{
 		vector<string> hash_conn_strings;
 		std::string hash_string = cell->type.str() + "\n";
 
-		const dict<RTLIL::IdString, RTLIL::SigSpec> *conn = &cell->connections();
-		dict<RTLIL::IdString, RTLIL::SigSpec> alt_conn;
-
 		if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($add), ID($mul),
 				ID($logic_and), ID($logic_or), ID($_AND_), ID($_OR_), ID($_XOR_))) {
-			alt_conn = *conn;
-			if (assign_map(alt_conn.at(ID::A)) < assign_map(alt_conn.at(ID::B))) {
-				alt_conn[ID::A] = conn->at(ID::B);
-				alt_conn[ID::B] = conn->at(ID::A);
-			}
-			conn = &alt_conn;
+			if (conn.at(ID::A) < conn.at(ID::B))
+				std::swap(conn.at(ID::A), conn.at(ID::B));
 		} else
 		if (cell->type.in(ID($reduce_xor), ID($reduce_xnor))) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			alt_conn.at(ID::A).sort();
-			conn = &alt_conn;
+			conn.at(ID::A).sort();
 		} else
 		if (cell->type.in(ID($reduce_and), ID($reduce_or), ID($reduce_bool))) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			alt_conn.at(ID::A).sort_and_unify();
-			conn = &alt_conn;
+			conn.at(ID::A).sort_and_unify();
 		} else
 		if (cell->type == ID($pmux)) {
-			alt_conn = *conn;
-			assign_map.apply(alt_conn.at(ID::A));
-			assign_map.apply(alt_conn.at(ID::B));
-			assign_map.apply(alt_conn.at(ID::S));
-			sort_pmux_conn(alt_conn);
-			conn = &alt_conn;
+			sort_pmux_conn(conn);
 		}
 
-		for (auto &it : *conn) {
-			RTLIL::SigSpec sig;
-			if (cell->output(it.first)) {
-				if (it.first == ID::Q && RTLIL::builtin_ff_cell_types().count(cell->type)) {
-					// For the 'Q' output of state elements,
-					//   use its (* init *) attribute value
-					sig = initvals(it.second);
-				}
-				else
-					continue;
-			}
-			else
-				sig = assign_map(it.second);
+		for (auto &it : conn) {
 			string s = "C " + it.first.str() + "=";
-			for (auto &chunk : sig.chunks()) {
+			for (auto &chunk : it.second.chunks()) {
 				if (chunk.wire)
 					s += "{" + chunk.wire->name.str() + " " +
 							int_to_hash_string(chunk.offset) + " " +
@@ -151,6 +143,74 @@ struct OptMergeWorker
 		return std::hash<std::string>{}(hash_string);
 	}
 
+	// Hashes stay valid until an input of the cell (or the init value of its
+	// 'Q' output) changes its representative in assign_map. cell_users lists
+	// the cells that were hashed by each representative bit, so that a merge
+	// only invalidates the users of the bits it redirected.
+	dict<RTLIL::Cell*, uint64_t> cell_hashes;
+	dict<RTLIL::SigBit, std::vector<RTLIL::Cell*>> cell_users;
+
+	void add_cell_hash(RTLIL::Cell *cell, const dict<RTLIL::IdString, RTLIL::SigSpec> &conn, uint64_t hash)
+	{
+		cell_hashes[cell] = hash;
+		for (auto &it : cell->connections()) {
+			bool is_output = cell->output(it.first);
+			if (is_output && (it.first != ID::Q || !RTLIL::builtin_ff_cell_types().count(cell->type)))
+				continue;
+			for (auto bit : is_output ? assign_map(it.second) : conn.at(it.first))
+				if (bit.wire != nullptr)
+					cell_users[bit].push_back(cell);
+		}
+	}
+
+	uint64_t cached_cell_hash(RTLIL::Cell *cell)
+	{
+		auto it = cell_hashes.find(cell);
+		if (it != cell_hashes.end())
+			return it->second;
+		dict<RTLIL::IdString, RTLIL::SigSpec> conn = hashed_connections(cell);
+		uint64_t hash = hash_connections(cell, conn);
+		add_cell_hash(cell, conn, hash);
+		return hash;
+	}
+
+	void hash_cells_parallel(const std::vector<RTLIL::Cell*> &cells)
+	{
+		const int chunk_size = 1024;
+		int num_chunks = (GetSize(cells) + chunk_size - 1) / chunk_size;
+
+		std::vector<dict<RTLIL::IdString, RTLIL::SigSpec>> conns;
+		conns.reserve(cells.size());
+		for (auto cell : cells)
+			conns.push_back(hashed_connections(cell));
+
+		std::vector<uint64_t> hashes(cells.size());
+		parallel_for(num_chunks, [&](int chunk) {
+			int end = std::min(GetSize(cells), (chunk + 1) * chunk_size);
+			for (int i = chunk * chunk_size; i < end; i++)
+				hashes[i] = hash_connections(cells[i], conns[i]);
+		});
+
+		for (int i = 0; i < GetSize(cells); i++)
+			add_cell_hash(cells[i], conns[i], hashes[i]);
+	}
+
+	// Called after assign_map.add(), with the representatives of the merged
+	// bits from before the merge
+	void invalidate_cell_hashes(const RTLIL::SigSpec &old_sig)
+	{
+		for (auto bit : old_sig) {
+			if (bit.wire == nullptr || assign_map(bit) == bit)
+				continue;
+			auto it = cell_users.find(bit);
+			if (it == cell_users.end())
+				continue;
+			for (auto cell : it->second)
+				cell_hashes.erase(cell);
+			cell_users.erase(it);
+		}
+	}
+
 	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
 	{
 		log_assert(cell1 != cell2);
@@ -225,7 +285,7 @@ struct OptMergeWorker
 		return !initvals(cell->getPort(ID::Q)).is_fully_def();
 	}
 
-	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all, bool mode_keepdc) :
+	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all, bool mode_keepdc, bool parallel_hash = false) :
 		design(design), module(module), assign_map(module), mode_share_all(mode_share_all)
 	{
 		total_count = 0;
@@ -252,6 +312,7 @@ struct OptMergeWorker
 		initvals.set(&assign_map, module);
 
 		bool did_something = true;
+		bool first_pass = true;
 		while (did_something)
 		{
 			std::vector<RTLIL::Cell*> cells;
@@ -265,17 +326,19 @@ struct OptMergeWorker
 					cells.push_back(it.second);
 			}
 
+			cells.erase(std::remove_if(cells.begin(), cells.end(), [&](RTLIL::Cell *cell) {
+				return (!mode_share_all && !ct.cell_known(cell->type)) || !cell->known() || cell->type == ID($scopeinfo);
+			}), cells.end());
+
+			if (first_pass && parallel_hash)
+				hash_cells_parallel(cells);
+			first_pass = false;
+
 			did_something = false;
-                        dict<uint64_t, RTLIL::Cell*> sharemap;
+			dict<uint64_t, RTLIL::Cell*> sharemap;
 			for (auto cell : cells)
 			{
-				if ((!mode_share_all && !ct.cell_known(cell->type)) || !cell->known())
-					continue;
-
-				if (cell->type == ID($scopeinfo))
-					continue;
-
-				uint64_t hash = hash_cell_parameters_and_connections(cell);
+				uint64_t hash = cached_cell_hash(cell);
 				auto r = sharemap.insert(std::make_pair(hash, cell));
 				if (!r.second) {
 					if (compare_cell_parameters_and_connections(cell, r.first->second)) {
@@ -294,14 +357,18 @@ struct OptMergeWorker
 								log_debug("    Redirecting output %s: %s = %s\n", it.first.c_str(),
 										log_signal(it.second), log_signal(other_sig));
 								Const init = initvals(other_sig);
+								RTLIL::SigSpec old_sig = assign_map(it.second);
+								old_sig.append(assign_map(other_sig));
 								initvals.remove_init(it.second);
 								initvals.remove_init(other_sig);
 								module->connect(RTLIL::SigSig(it.second, other_sig));
 								assign_map.add(it.second, other_sig);
 								initvals.set_init(other_sig, init);
+								invalidate_cell_hashes(old_sig);
 							}
 						}
 						log_debug("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
+						cell_hashes.erase(cell);
 						module->remove(cell);
 						total_count++;
 					}
@@ -322,7 +389,9 @@ struct OptMergePass : public Pass {
 		log("    opt_merge [options] [selection]\n");
 		log("\n");
 		log("This pass identifies cells with identical type and input signals. Such cells\n");
-		log("are then merged to one cell.\n");
+		log("are then merged to one cell. Modules are processed in parallel when Yosys is\n");
+		log("started with -j. When only one module is selected, its cells are hashed in\n");
+		log("parallel instead.\n");
 		log("\n");
 		log("    -nomux\n");
 		log("        Do not merge MUX cells.\n");
@@ -361,15 +430,27 @@ struct OptMergePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules()) {
-			OptMergeWorker worker(design, module, mode_nomux, mode_share_all, mode_keepdc);
+		std::atomic<int> total_count{0};
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		if (GetSize(modules) == 1 && yosys_parallel_jobs > 1) {
+			// a single (e.g. flattened) module hashes its cells on all threads instead
+			OptMergeWorker worker(design, modules.front(), mode_nomux, mode_share_all, mode_keepdc, true);
 			total_count += worker.total_count;
+			// merged attributes are edited in place, see opt_expr
+			if (worker.total_count)
+				modules.front()->generation_++;
+		} else {
+			parallel_for_modules(design, modules, [&](RTLIL::Module *module) {
+				OptMergeWorker worker(design, module, mode_nomux, mode_share_all, mode_keepdc);
+				total_count += worker.total_count;
+				if (worker.total_count)
+					module->generation_++;
+			});
 		}
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Removed a total of %d cells.\n", total_count);
+		log("Removed a total of %d cells.\n", total_count.load());
 	}
 } OptMergePass;
 
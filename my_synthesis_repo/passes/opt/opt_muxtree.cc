@@ -30,6 +30,10 @@ PRIVATE_NAMESPACE_BEGIN
 
 using RTLIL::id2cstr;
 
+// Signatures of the mux trees that a previous run on a module (keyed by
+// Module::hashidx_) evaluated without finding anything to optimize.
+dict<unsigned int, pool<unsigned int>> clean_trees_cache;
+
 struct OptMuxtreeWorker
 {
 	RTLIL::Design *design;
@@ -59,6 +63,7 @@ struct OptMuxtreeWorker
 	struct muxinfo_t {
 		RTLIL::Cell *cell;
 		vector<portinfo_t> ports;
+		bool replaced_known = false;
 	};
 
 	vector<muxinfo_t> mux2info;
@@ -181,8 +186,28 @@ struct OptMuxtreeWorker
 			if (GetSize(it.second) > 1)
 				root_muxes.at(it.first) = true;
 
+		// The evaluation never leaves a group of muxes connected by their data
+		// inputs, so groups that are unchanged since a run that found nothing
+		// in them are skipped (with all their ports considered live).
+		vector<int> mux_group;
+		dict<int, unsigned int> group_signatures;
+		find_mux_groups(mux_group, group_signatures);
+
+		pool<unsigned int> &clean_trees = clean_trees_cache[module->hashidx_];
+		vector<bool> skip_mux(GetSize(mux2info));
+		int skipped_count = 0;
+		for (int mux_idx = 0; mux_idx < GetSize(mux2info); mux_idx++)
+			if (clean_trees.count(group_signatures.at(mux_group[mux_idx]))) {
+				skip_mux[mux_idx] = true;
+				for (auto &pi : mux2info[mux_idx].ports)
+					pi.enabled = true;
+				skipped_count++;
+			}
+		if (skipped_count)
+			log_debug("  Skipping %d muxes in unchanged mux trees.\n", skipped_count);
+
 		for (int mux_idx = 0; mux_idx < GetSize(root_muxes); mux_idx++)
-			if (root_muxes.at(mux_idx)) {
+			if (root_muxes.at(mux_idx) && !skip_mux[mux_idx]) {
 				log_debug("    Root of a mux tree: %s%s\n", log_id(mux2info[mux_idx].cell), root_enable_muxes.at(mux_idx) ? " (pure)" : "");
 				root_mux_rerun.erase(mux_idx);
 				eval_root_mux(mux_idx);
@@ -207,6 +232,21 @@ struct OptMuxtreeWorker
 			log("  Analyzing evaluation results.\n");
 		log_assert(glob_abort_cnt > 0);
 
+		pool<int> dirty_groups;
+		for (int mux_idx = 0; mux_idx < GetSize(mux2info); mux_idx++) {
+			bool dirty = mux2info[mux_idx].replaced_known;
+			for (auto &pi : mux2info[mux_idx].ports)
+				if (!pi.enabled)
+					dirty = true;
+			if (dirty)
+				dirty_groups.insert(mux_group[mux_idx]);
+		}
+
+		clean_trees.clear();
+		for (auto &it : group_signatures)
+			if (!dirty_groups.count(it.first))
+				clean_trees.insert(it.second);
+
 		for (auto &mi : mux2info)
 		{
 			vector<int> live_ports;
@@ -270,6 +310,37 @@ struct OptMuxtreeWorker
 		}
 	}
 
+	void find_mux_groups(vector<int> &mux_group, dict<int, unsigned int> &group_signatures)
+	{
+		mux_group.resize(GetSize(mux2info));
+		for (int i = 0; i < GetSize(mux2info); i++)
+			mux_group[i] = i;
+
+		auto find_group = [&](int i) {
+			while (mux_group[i] != i)
+				i = mux_group[i] = mux_group[mux_group[i]];
+			return i;
+		};
+
+		for (int i = 0; i < GetSize(mux2info); i++)
+		for (auto &pi : mux2info[i].ports)
+		for (int j : pi.input_muxes)
+			mux_group[find_group(i)] = find_group(j);
+
+		for (int i = 0; i < GetSize(mux2info); i++)
+		{
+			int group = mux_group[i] = find_group(i);
+			unsigned int &h = group_signatures[group];
+			RTLIL::Cell *cell = mux2info[i].cell;
+
+			h = mkhash(h, cell->hashidx_);
+			h = mkhash(h, (root_muxes.at(i) ? 2 : 0) + (root_enable_muxes.at(i) ? 1 : 0));
+			for (auto port : {ID::A, ID::B, ID::S, ID::Y})
+				for (auto bit : assign_map(cell->getPort(port)))
+					h = mkhash(h, hash_ops<SigBit>::hash(bit));
+		}
+	}
+
 	vector<int> sig2bits(RTLIL::SigSpec sig, bool skip_non_wires = true)
 	{
 		vector<int> results;
@@ -402,6 +473,7 @@ struct OptMuxtreeWorker
 			log("      Replacing known input bits on port %s of cell %s: %s -> %s\n", log_id(portname),
 					log_id(muxinfo.cell), log_signal(muxinfo.cell->getPort(portname)), log_signal(sig));
 			muxinfo.cell->setPort(portname, sig);
+			muxinfo.replaced_known = true;
 		}
 	}
 
@@ -486,6 +558,9 @@ struct OptMuxtreePass : public Pass {
 		log("\n");
 		log("This pass only operates on completely selected modules without processes.\n");
 		log("\n");
+		log("Mux trees that are unchanged since an earlier run of this pass found nothing\n");
+		log("to remove in them are not analyzed again.\n");
+		log("\n");
 	}
 	void execute(vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -498,9 +573,18 @@ struct OptMuxtreePass : public Pass {
 				continue;
 			OptMuxtreeWorker worker(design, module);
 			total_count += worker.removed_count;
+			// cell types and parameters are edited in place, see opt_expr
+			if (worker.removed_count)
+				module->generation_++;
 		}
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
+
+		pool<unsigned int> live_modules;
+		for (auto module : design->modules())
+			live_modules.insert(module->hashidx_);
+		for (auto it = clean_trees_cache.begin(); it != clean_trees_cache.end();)
+			it = live_modules.count(it->first) ? std::next(it) : clean_trees_cache.erase(it);
 		log("Removed %d multiplexer ports.\n", total_count);
 	}
 } OptMuxtreePass;
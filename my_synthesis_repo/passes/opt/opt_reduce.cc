@@ -37,6 +37,13 @@ struct OptReduceWorker
 	int total_count;
 	bool did_something;
 
+	// Normalized input sets of $reduce_and/$reduce_or cells and of the
+	// OR-ed $pmux select groups, hash-consed for the whole module so that
+	// identical reductions are found across cells.
+	idict<RTLIL::SigSpec> input_sets;
+	dict<RTLIL::Cell*, int> cell_input_set;
+	dict<std::pair<RTLIL::IdString, int>, RTLIL::SigBit> reduce_outputs;
+
 	void opt_reduce(pool<RTLIL::Cell*> &cells, SigSet<RTLIL::Cell*> &drivers, RTLIL::Cell *cell)
 	{
 		if (cells.count(cell) == 0)
@@ -75,8 +82,15 @@ struct OptReduceWorker
 				if (child_cell->type == cell->type) {
 					opt_reduce(cells, drivers, child_cell);
 					if (child_cell->getPort(ID::Y)[0] == bit) {
-						pool<RTLIL::SigBit> child_sig_a_bits = assign_map(child_cell->getPort(ID::A)).to_sigbit_pool();
-						new_sig_a_bits.insert(child_sig_a_bits.begin(), child_sig_a_bits.end());
+						auto it = cell_input_set.find(child_cell);
+						if (it != cell_input_set.end()) {
+							for (auto child_bit : input_sets[it->second])
+								new_sig_a_bits.insert(child_bit);
+						} else {
+							// child is still being normalized (combinational loop)
+							pool<RTLIL::SigBit> child_sig_a_bits = assign_map(child_cell->getPort(ID::A)).to_sigbit_pool();
+							new_sig_a_bits.insert(child_sig_a_bits.begin(), child_sig_a_bits.end());
+						}
 					} else
 						new_sig_a_bits.insert(RTLIL::State::S0);
 					imported_children = true;
@@ -97,9 +111,39 @@ struct OptReduceWorker
 
 		cell->setPort(ID::A, new_sig_a);
 		cell->parameters[ID::A_WIDTH] = RTLIL::Const(new_sig_a.size());
+		cell_input_set[cell] = input_sets(new_sig_a);
 		return;
 	}
 
+	void merge_reduce_duplicates(const std::vector<RTLIL::Cell*> &cells)
+	{
+		for (auto cell : cells)
+		{
+			RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+			if (GetSize(sig_y) == 0)
+				continue;
+
+			auto key = std::make_pair(cell->type, cell_input_set.at(cell));
+			auto it = reduce_outputs.find(key);
+			if (it == reduce_outputs.end()) {
+				reduce_outputs[key] = assign_map(sig_y[0]);
+				continue;
+			}
+			if (cell->has_keep_attr())
+				continue;
+
+			RTLIL::SigSpec new_sig_y = it->second;
+			new_sig_y.append(RTLIL::Const(State::S0, GetSize(sig_y) - 1));
+			log("    Merging %s cell %s with identical input vector: %s = %s\n", cell->type.c_str(), cell->name.c_str(),
+					log_signal(sig_y), log_signal(new_sig_y));
+			module->connect(sig_y, new_sig_y);
+			assign_map.add(sig_y, new_sig_y);
+			module->remove(cell);
+			did_something = true;
+			total_count++;
+		}
+	}
+
 	void opt_pmux(RTLIL::Cell *cell)
 	{
 		RTLIL::SigSpec sig_a = assign_map(cell->getPort(ID::A));
@@ -107,38 +151,54 @@ struct OptReduceWorker
 		RTLIL::SigSpec sig_s = assign_map(cell->getPort(ID::S));
 
 		RTLIL::SigSpec new_sig_b, new_sig_s;
-		pool<RTLIL::SigSpec> handled_sig;
 
-		handled_sig.insert(sig_a);
+		// group the select bits by data input in a single pass, in order of first occurrence
+		dict<RTLIL::SigSpec, int> group_index;
+		std::vector<RTLIL::SigSpec> group_b, group_s;
+
 		for (int i = 0; i < sig_s.size(); i++)
 		{
 			RTLIL::SigSpec this_b = sig_b.extract(i*sig_a.size(), sig_a.size());
-			if (handled_sig.count(this_b) > 0)
+			if (this_b == sig_a)
 				continue;
 
-			RTLIL::SigSpec this_s = sig_s.extract(i, 1);
-			for (int j = i+1; j < sig_s.size(); j++) {
-				RTLIL::SigSpec that_b = sig_b.extract(j*sig_a.size(), sig_a.size());
-				if (this_b == that_b)
-					this_s.append(sig_s.extract(j, 1));
-			}
+			auto it = group_index.find(this_b);
+			if (it == group_index.end()) {
+				group_index[this_b] = GetSize(group_b);
+				group_b.push_back(this_b);
+				group_s.push_back(sig_s[i]);
+			} else
+				group_s[it->second].append(sig_s[i]);
+		}
+
+		for (int i = 0; i < GetSize(group_b); i++)
+		{
+			RTLIL::SigSpec this_s = group_s[i];
+			this_s.sort_and_unify();
 
 			if (this_s.size() > 1)
 			{
-				RTLIL::Cell *reduce_or_cell = module->addCell(NEW_ID, ID($reduce_or));
-				reduce_or_cell->setPort(ID::A, this_s);
-				reduce_or_cell->parameters[ID::A_SIGNED] = RTLIL::Const(0);
-				reduce_or_cell->parameters[ID::A_WIDTH] = RTLIL::Const(this_s.size());
-				reduce_or_cell->parameters[ID::Y_WIDTH] = RTLIL::Const(1);
-
-				RTLIL::Wire *reduce_or_wire = module->addWire(NEW_ID);
-				this_s = RTLIL::SigSpec(reduce_or_wire);
-				reduce_or_cell->setPort(ID::Y, this_s);
+				// select groups shared with other cells reuse the same $reduce_or
+				auto key = std::make_pair(ID($reduce_or), input_sets(this_s));
+				auto it = reduce_outputs.find(key);
+				if (it != reduce_outputs.end()) {
+					this_s = it->second;
+				} else {
+					RTLIL::Cell *reduce_or_cell = module->addCell(NEW_ID, ID($reduce_or));
+					reduce_or_cell->setPort(ID::A, this_s);
+					reduce_or_cell->parameters[ID::A_SIGNED] = RTLIL::Const(0);
+					reduce_or_cell->parameters[ID::A_WIDTH] = RTLIL::Const(this_s.size());
+					reduce_or_cell->parameters[ID::Y_WIDTH] = RTLIL::Const(1);
+
+					RTLIL::Wire *reduce_or_wire = module->addWire(NEW_ID);
+					this_s = RTLIL::SigSpec(reduce_or_wire);
+					reduce_or_cell->setPort(ID::Y, this_s);
+					reduce_outputs[key] = this_s;
+				}
 			}
 
-			new_sig_b.append(this_b);
+			new_sig_b.append(group_b[i]);
 			new_sig_s.append(this_s);
-			handled_sig.insert(this_b);
 		}
 
 		if (new_sig_s.size() == 0)
@@ -550,6 +610,8 @@ struct OptReduceWorker
 		while (did_something)
 		{
 			did_something = false;
+			cell_input_set.clear();
+			reduce_outputs.clear();
 
 			// merge trees of reduce_* cells to one single cell and unify input vectors
 			// (only handle reduce_and and reduce_or for various reasons)
@@ -559,6 +621,7 @@ struct OptReduceWorker
 			{
 				SigSet<RTLIL::Cell*> drivers;
 				pool<RTLIL::Cell*> cells;
+				std::vector<RTLIL::Cell*> cell_list;
 
 				for (auto &cell_it : module->cells_) {
 					RTLIL::Cell *cell = cell_it.second;
@@ -566,12 +629,15 @@ struct OptReduceWorker
 						continue;
 					drivers.insert(assign_map(cell->getPort(ID::Y)), cell);
 					cells.insert(cell);
+					cell_list.push_back(cell);
 				}
 
 				while (cells.size() > 0) {
 					RTLIL::Cell *cell = *cells.begin();
 					opt_reduce(cells, drivers, cell);
 				}
+
+				merge_reduce_duplicates(cell_list);
 			}
 
 			// merge identical inputs on $mux and $pmux cells
@@ -622,6 +688,10 @@ struct OptReducePass : public Pass {
 		log("2. it identifies duplicated inputs to MUXes and replaces them with a single\n");
 		log("input with the original control signals OR'ed together.\n");
 		log("\n");
+		log("The normalized input vectors are shared across the module: AND/OR gates with\n");
+		log("identical inputs are merged, and MUXes OR-ing the same control signals share\n");
+		log("a single OR gate.\n");
+		log("\n");
 		log("    -fine\n");
 		log("      perform fine-grain optimizations\n");
 		log("\n");
@@ -656,6 +726,8 @@ struct OptReducePass : public Pass {
 				total_count += worker.total_count;
 				if (worker.total_count == 0)
 					break;
+				// cell types and parameters are edited in place, see opt_expr
+				module->generation_++;
 			}
 
 		if (total_count)
@@ -552,6 +552,8 @@ struct OptSharePass : public Pass {
 					merged_ops.push_back(merged_op_t{mux, merged_ports, shared_operand});
 
 					design->scratchpad_set_bool("opt.did_something", true);
+					// parameters of the shared operator are edited in place, see opt_expr
+					module->generation_++;
 				}
 
 			}
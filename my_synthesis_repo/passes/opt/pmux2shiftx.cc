@@ -275,6 +275,13 @@ struct Pmux2ShiftxPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			std::vector<Cell*> pmux_cells;
+			for (auto cell : module->selected_cells())
+				if (cell->type == ID($pmux))
+					pmux_cells.push_back(cell);
+			if (pmux_cells.empty())
+				continue;
+
 			SigMap sigmap(module);
 			OnehotDatabase onehot_db(module, sigmap);
 			onehot_db.verbose = verbose_onehot;
@@ -353,11 +360,8 @@ struct Pmux2ShiftxPass : public Pass {
 		next_cell:;
 			}
 
-			for (auto cell : module->selected_cells())
+			for (auto cell : pmux_cells)
 			{
-				if (cell->type != ID($pmux))
-					continue;
-
 				string src = cell->get_src_attribute();
 				int width = cell->getParam(ID::WIDTH).as_int();
 				int width_bits = ceil_log2(width);
@@ -371,6 +375,14 @@ struct Pmux2ShiftxPass : public Pass {
 				SigSpec A = cell->getPort(ID::A);
 				SigSpec B = cell->getPort(ID::B);
 				SigSpec S = sigmap(cell->getPort(ID::S));
+
+				// the case data is sliced and rewritten per choice below, as
+				// bit vectors so that wide $pmux cells stay linear
+				std::vector<SigBit> A_bits = A.to_sigbit_vector();
+				std::vector<SigBit> B_bits = B.to_sigbit_vector();
+				auto B_case = [&](int index) {
+					return SigSpec(std::vector<SigBit>(B_bits.begin() + index*width, B_bits.begin() + (index+1)*width));
+				};
 				for (int i = 0; i < GetSize(S); i++)
 				{
 					if (!eqdb.count(S[i]))
@@ -391,19 +403,20 @@ struct Pmux2ShiftxPass : public Pass {
 					log("  data width: %d (next power-of-2 = %d, log2 = %d)\n", width, extwidth, width_bits);
 				}
 
-				SigSpec updated_S = cell->getPort(ID::S);
-				SigSpec updated_B = cell->getPort(ID::B);
+				std::vector<SigBit> updated_S = cell->getPort(ID::S).to_sigbit_vector();
+				std::vector<SigBit> updated_B = B_bits;
 
 				while (!seldb.empty())
 				{
 					// pick the largest entry in seldb
-					SigSpec sig = seldb.begin()->first;
-					for (auto &it : seldb) {
-						if (GetSize(sig) < GetSize(it.first))
-							sig = it.first;
-						else if (GetSize(seldb.at(sig)) < GetSize(it.second))
-							sig = it.first;
+					auto best = seldb.begin();
+					for (auto it = seldb.begin(); it != seldb.end(); ++it) {
+						if (GetSize(best->first) < GetSize(it->first))
+							best = it;
+						else if (GetSize(best->second) < GetSize(it->second))
+							best = it;
 					}
+					SigSpec sig = best->first;
 
 					// find the relevant choices
 					bool is_onehot = GetSize(sig) > 2;
@@ -448,7 +461,7 @@ struct Pmux2ShiftxPass : public Pass {
 						log("    table of choices:\n");
 						for (auto &it : choices)
 							log("    %3d: %s: %s\n", it.second, log_signal(it.first),
-									log_signal(B.extract(it.second*width, width)));
+									log_signal(B_case(it.second)));
 					};
 
 					if (verbose)
@@ -624,7 +637,7 @@ struct Pmux2ShiftxPass : public Pass {
 						max_choice = std::max(max_choice, new_c.as_int());
 
 						log("    %3d: %s -> %s -> %s: %s\n", it.second, log_signal(old_c), log_signal(new_c_before_xor),
-								log_signal(new_c), log_signal(B.extract(it.second*width, width)));
+								log_signal(new_c), log_signal(B_case(it.second)));
 					}
 
 					int range_density = 100*GetSize(choices) / (max_choice-min_choice+1);
@@ -692,25 +705,26 @@ struct Pmux2ShiftxPass : public Pass {
 					}
 
 					// create data signal
-					SigSpec data(State::Sx, (max_choice+1)*extwidth);
+					std::vector<SigBit> data((max_choice+1)*extwidth, State::Sx);
 					if (full_pmux) {
 						for (int i = 0; i <= max_choice; i++)
-							data.replace(i*extwidth, A);
+							std::copy(A_bits.begin(), A_bits.end(), data.begin() + i*extwidth);
 					}
 					for (auto &it : perm_choices) {
 						int position = it.first.as_int()*extwidth;
 						int data_index = it.second;
-						data.replace(position, B.extract(data_index*width, width));
+						std::copy(B_bits.begin() + data_index*width, B_bits.begin() + (data_index+1)*width, data.begin() + position);
 						updated_S[data_index] = State::S0;
-						updated_B.replace(data_index*width, SigSpec(State::Sx, width));
+						std::fill(updated_B.begin() + data_index*width, updated_B.begin() + (data_index+1)*width, SigBit(State::Sx));
 					}
 
 					// create shiftx cell
 					SigSpec shifted_cmp = {cmp, SigSpec(State::S0, width_bits)};
 					SigSpec outsig = module->addWire(NEW_ID, width);
 					Cell *c = module->addShiftx(NEW_ID, data, shifted_cmp, outsig, false, src);
-					updated_S.append(en);
-					updated_B.append(outsig);
+					updated_S.push_back(en);
+					for (auto bit : outsig)
+						updated_B.push_back(bit);
 					log("    created $shiftx cell %s.\n", log_id(c));
 
 					// remove this sig and continue with the next block
@@ -718,8 +732,8 @@ struct Pmux2ShiftxPass : public Pass {
 				}
 
 				// update $pmux cell
-				cell->setPort(ID::S, updated_S);
-				cell->setPort(ID::B, updated_B);
+				cell->setPort(ID::S, SigSpec(updated_S));
+				cell->setPort(ID::B, SigSpec(updated_B));
 				cell->setParam(ID::S_WIDTH, GetSize(updated_S));
 			}
 		}
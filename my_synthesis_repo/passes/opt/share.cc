@@ -30,6 +30,74 @@ PRIVATE_NAMESPACE_BEGIN
 typedef RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell> cell_ptr_cmp;
 typedef std::pair<RTLIL::SigSpec, RTLIL::Const> ssc_pair_t;
 
+// The cells that are still considered for sharing, bucketed by a key that
+// two cells must have in common to be shareable.  Cells are visited in the
+// same order as a pool<> with the same history of insertions and removals
+// (inserts append, removing a cell moves the last cell into its slot), so
+// that the bucketing does not change which pairs end up being merged.
+struct ShareableCells
+{
+	std::vector<RTLIL::Cell*> entries;
+	dict<RTLIL::Cell*, int> index;
+	dict<RTLIL::Cell*, std::string> keys;
+	dict<std::string, pool<RTLIL::Cell*>> buckets;
+
+	bool empty() const { return entries.empty(); }
+	int size() const { return GetSize(entries); }
+	RTLIL::Cell *front() const { return entries.back(); }
+
+	void insert(RTLIL::Cell *cell, const std::string &key)
+	{
+		if (index.count(cell))
+			return;
+		index[cell] = GetSize(entries);
+		entries.push_back(cell);
+		keys[cell] = key;
+		buckets[key].insert(cell);
+	}
+
+	void erase(RTLIL::Cell *cell)
+	{
+		auto it = index.find(cell);
+		if (it == index.end())
+			return;
+		int idx = it->second;
+		index.erase(it);
+		if (idx != GetSize(entries)-1) {
+			entries[idx] = entries.back();
+			index[entries[idx]] = idx;
+		}
+		entries.pop_back();
+		auto &bucket = buckets.at(keys.at(cell));
+		bucket.erase(cell);
+		if (bucket.empty())
+			buckets.erase(keys.at(cell));
+		keys.erase(cell);
+	}
+
+	void clear()
+	{
+		entries.clear();
+		index.clear();
+		keys.clear();
+		buckets.clear();
+	}
+
+	// Returns the cells with the given key in visiting order.
+	std::vector<RTLIL::Cell*> bucket(const std::string &key) const
+	{
+		std::vector<RTLIL::Cell*> result;
+		auto it = buckets.find(key);
+		if (it == buckets.end())
+			return result;
+		result.insert(result.end(), it->second.begin(), it->second.end());
+		std::sort(result.begin(), result.end(), [&](RTLIL::Cell *a, RTLIL::Cell *b) {
+			return index.at(a) > index.at(b);
+		});
+		return result;
+	}
+};
+
 struct ShareWorkerConfig
 {
 	int limit;
@@ -344,7 +412,7 @@ struct ShareWorker
 	// Find shareable cells and compatible groups of cells
 	// ---------------------------------------------------
 
-	pool<RTLIL::Cell*> shareable_cells;
+	ShareableCells shareable_cells;
 
 	void find_shareable_cells()
 	{
@@ -362,7 +430,7 @@ struct ShareWorker
 				continue;
 
 			if (config.opt_force) {
-				shareable_cells.insert(cell);
+				shareable_cells.insert(cell, share_key(cell));
 				continue;
 			}
 
@@ -370,30 +438,47 @@ struct ShareWorker
 				if (cell->parameters.at(ID::CLK_ENABLE).as_bool())
 					continue;
 				if (config.opt_aggressive || !modwalker.sigmap(cell->getPort(ID::ADDR)).is_fully_const())
-					shareable_cells.insert(cell);
+					shareable_cells.insert(cell, share_key(cell));
 				continue;
 			}
 
 			if (cell->type.in(ID($mul), ID($div), ID($mod), ID($divfloor), ID($modfloor))) {
 				if (config.opt_aggressive || cell->parameters.at(ID::Y_WIDTH).as_int() >= 4)
-					shareable_cells.insert(cell);
+					shareable_cells.insert(cell, share_key(cell));
 				continue;
 			}
 
 			if (cell->type.in(ID($shl), ID($shr), ID($sshl), ID($sshr))) {
 				if (config.opt_aggressive || cell->parameters.at(ID::Y_WIDTH).as_int() >= 8)
-					shareable_cells.insert(cell);
+					shareable_cells.insert(cell, share_key(cell));
 				continue;
 			}
 
 			if (generic_ops.count(cell->type)) {
 				if (config.opt_aggressive)
-					shareable_cells.insert(cell);
+					shareable_cells.insert(cell, share_key(cell));
 				continue;
 			}
 		}
 	}
 
+	// Cells can only be shareable if their keys match, see is_shareable_pair().
+	std::string share_key(RTLIL::Cell *cell)
+	{
+		std::string key = cell->type.str();
+
+		if (cell->type.in(ID($memrd), ID($memrd_v2)))
+			return key + "\n" + cell->parameters.at(ID::MEMID).decode_string() + "\n" + cell->parameters.at(ID::WIDTH).as_string();
+
+		if (generic_ops.count(cell->type) || cell->type == ID($alu))
+			return key;
+
+		std::map<RTLIL::IdString, RTLIL::Const, RTLIL::sort_by_id_str> params(cell->parameters.begin(), cell->parameters.end());
+		for (auto &it : params)
+			key += "\n" + it.first.str() + "=" + it.second.as_string();
+		return key;
+	}
+
 	bool is_shareable_pair(RTLIL::Cell *c1, RTLIL::Cell *c2)
 	{
 		if (c1->type != c2->type)
@@ -495,7 +580,7 @@ struct ShareWorker
 	void find_shareable_partners(std::vector<RTLIL::Cell*> &results, RTLIL::Cell *cell)
 	{
 		results.clear();
-		for (auto c : shareable_cells)
+		for (auto c : shareable_cells.bucket(share_key(cell)))
 			if (c != cell && is_shareable_pair(c, cell))
 				results.push_back(c);
 	}
@@ -972,6 +1057,23 @@ struct ShareWorker
 		}
 	}
 
+	// Sets active to the random patterns of QuickConeSim that activate a cell.
+	bool simulate_activation(QuickConeSim &qcsim, const pool<ssc_pair_t> &activation_patterns, uint64_t &active)
+	{
+		active = 0;
+		for (auto &p : activation_patterns) {
+			uint64_t match = ~uint64_t(0);
+			for (int i = 0; i < GetSize(p.first); i++) {
+				uint64_t word;
+				if (!qcsim.get(p.first[i], word))
+					return false;
+				match &= p.second.bits[i] == State::S1 ? word : ~word;
+			}
+			active |= match;
+		}
+		return true;
+	}
+
 	RTLIL::SigSpec make_cell_activation_logic(const pool<ssc_pair_t> &activation_patterns, pool<RTLIL::Cell*> &supercell_aux)
 	{
 		RTLIL::Wire *all_cases_wire = module->addWire(NEW_ID, 0);
@@ -1171,9 +1273,13 @@ struct ShareWorker
 		log("Found %d cells in module %s that may be considered for resource sharing.\n",
 				GetSize(shareable_cells), log_id(module));
 
+		QuickConeSat module_qcsat(modwalker);
+		QuickConeSim qcsim(module_qcsat);
+		qcsim.run();
+
 		while (!shareable_cells.empty() && config.limit != 0)
 		{
-			RTLIL::Cell *cell = *shareable_cells.begin();
+			RTLIL::Cell *cell = shareable_cells.front();
 			shareable_cells.erase(cell);
 
 			log("  Analyzing resource sharing options for %s (%s):\n", log_id(cell), log_id(cell->type));
@@ -1249,11 +1355,29 @@ struct ShareWorker
 				optimize_activation_patterns(filtered_cell_activation_patterns);
 				optimize_activation_patterns(filtered_other_cell_activation_patterns);
 
-				QuickConeSat qcsat(modwalker);
+				for (auto &p : filtered_cell_activation_patterns)
+					log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
+
+				for (auto &p : filtered_other_cell_activation_patterns)
+					log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
+
+				uint64_t cell_sim_active, other_cell_sim_active;
+				if (simulate_activation(qcsim, filtered_cell_activation_patterns, cell_sim_active) &&
+						simulate_activation(qcsim, filtered_other_cell_activation_patterns, other_cell_sim_active) &&
+						(cell_sim_active & other_cell_sim_active & qcsim.valid_patterns) != 0) {
+					log("      According to simulation both cells can be active at the same time, so this pair of cells can not be shared.\n");
+					continue;
+				}
+
+				// Without -fast all pairs are checked with one incremental solver, so that
+				// the input cones of the control signals are only imported once.
+				std::unique_ptr<QuickConeSat> pair_qcsat;
 				if (config.opt_fast) {
-					qcsat.max_cell_outs = 3;
-					qcsat.max_cell_count = 100;
+					pair_qcsat.reset(new QuickConeSat(modwalker));
+					pair_qcsat->max_cell_outs = 3;
+					pair_qcsat->max_cell_count = 100;
 				}
+				QuickConeSat &qcsat = config.opt_fast ? *pair_qcsat : module_qcsat;
 
 				pool<RTLIL::Cell*> sat_cells;
 				std::set<RTLIL::SigBit> bits_queue;
@@ -1262,13 +1386,11 @@ struct ShareWorker
 				RTLIL::SigSpec all_ctrl_signals;
 
 				for (auto &p : filtered_cell_activation_patterns) {
-					log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
 					cell_active.push_back(qcsat.ez->vec_eq(qcsat.importSig(p.first), qcsat.importSig(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
 
 				for (auto &p : filtered_other_cell_activation_patterns) {
-					log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
 					other_cell_active.push_back(qcsat.ez->vec_eq(qcsat.importSig(p.first), qcsat.importSig(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
@@ -1290,18 +1412,21 @@ struct ShareWorker
 					continue;
 				}
 
-				qcsat.ez->non_incremental();
+				int both_active = qcsat.ez->AND(sub1, sub2);
+				if (config.opt_fast) {
+					qcsat.ez->non_incremental();
+					qcsat.ez->assume(both_active);
+					both_active = 0;
+				}
 
 				all_ctrl_signals.sort_and_unify();
 				std::vector<int> sat_model = qcsat.importSig(all_ctrl_signals);
 				std::vector<bool> sat_model_values;
 
-				qcsat.ez->assume(qcsat.ez->AND(sub1, sub2));
-
 				log("      Size of SAT problem: %d cells, %d variables, %d clauses\n",
 						GetSize(sat_cells), qcsat.ez->numCnfVariables(), qcsat.ez->numCnfClauses());
 
-				if (qcsat.ez->solve(sat_model, sat_model_values)) {
+				if (qcsat.ez->solve(sat_model, sat_model_values, both_active)) {
 					log("      According to the SAT solver this pair of cells can not be shared.\n");
 					log("      Model from SAT solver: %s = %d'", log_signal(all_ctrl_signals), GetSize(sat_model_values));
 					for (int i = GetSize(sat_model_values)-1; i >= 0; i--)
@@ -1359,7 +1484,7 @@ struct ShareWorker
 					log("      New topology contains loops! Rolling back..\n");
 					cells_to_remove.erase(cell);
 					cells_to_remove.erase(other_cell);
-					shareable_cells.insert(other_cell);
+					shareable_cells.insert(other_cell, share_key(other_cell));
 					for (auto cc : supercell_aux)
 						remove_cell(cc);
 					continue;
@@ -1370,7 +1495,7 @@ struct ShareWorker
 				supercell_activation_patterns.insert(filtered_other_cell_activation_patterns.begin(), filtered_other_cell_activation_patterns.end());
 				optimize_activation_patterns(supercell_activation_patterns);
 				activation_patterns_cache[supercell] = supercell_activation_patterns;
-				shareable_cells.insert(supercell);
+				shareable_cells.insert(supercell, share_key(supercell));
 
 				for (auto bit : topo_sigmap(all_ctrl_signals))
 					for (auto c : topo_bit_drivers[bit])
@@ -1417,6 +1542,11 @@ struct SharePass : public Pass {
 		log("This pass merges shareable resources into a single resource. A SAT solver\n");
 		log("is used to determine if two resources are share-able.\n");
 		log("\n");
+		log("Only cells of the same type (and the same parameters or memory, where the\n");
+		log("widths do not matter) are paired up. Pairs that a random simulation of the\n");
+		log("control logic shows to be active at the same time are rejected without a SAT\n");
+		log("query, and the remaining queries share one incremental solver per module.\n");
+		log("\n");
 		log("  -force\n");
 		log("    Per default the selection of cells that is considered for sharing is\n");
 		log("    narrowed using a list of cell types. With this option all selected\n");
@@ -1434,7 +1564,7 @@ struct SharePass : public Pass {
 		log("  -fast\n");
 		log("    Only consider the simple part of the control logic in SAT solving, resulting\n");
 		log("    in much easier SAT problems at the cost of maybe missing some opportunities\n");
-		log("    for resource sharing.\n");
+		log("    for resource sharing. Each pair is checked with its own solver.\n");
 		log("\n");
 		log("  -limit N\n");
 		log("    Only perform the first N merges, then stop. This is useful for debugging.\n");
@@ -51,7 +51,7 @@ struct WreduceWorker
 {
 	WreduceConfig *config;
 	Module *module;
-	ModIndex mi;
+	ModIndex &mi;
 
 	std::set<Cell*, IdString::compare_ptr_by_name<Cell>> work_queue_cells;
 	std::set<SigBit> work_queue_bits;
@@ -59,7 +59,132 @@ struct WreduceWorker
 	FfInitVals initvals;
 
 	WreduceWorker(WreduceConfig *config, Module *module) :
-			config(config), module(module), mi(module) { }
+			config(config), module(module), mi(ModIndex::get(module)) { }
+
+	// Bits whose value can be observed: module outputs, kept wires, inputs
+	// of cells that are not narrowed here, and (bit by bit) everything these
+	// depend on through the cells that are.  This is computed once for the
+	// whole module before any cell is changed.  Narrowing never makes more
+	// bits observable, so a bit outside of this set can be dropped from the
+	// output of its driver even if other (equally unobservable) cells still
+	// read it.
+	pool<SigBit> demanded_bits;
+	std::vector<SigBit> demand_queue;
+	pool<Cell*> demanded_cells;
+	dict<Cell*, int> demanded_prefix;
+
+	bool is_demanded(SigBit bit)
+	{
+		return demanded_bits.count(mi.sigmap(bit)) != 0;
+	}
+
+	void demand(SigBit bit)
+	{
+		bit = mi.sigmap(bit);
+		if (bit.wire && demanded_bits.insert(bit).second)
+			demand_queue.push_back(bit);
+	}
+
+	void demand_inputs(Cell *cell, IdString except = IdString())
+	{
+		for (auto &conn : cell->connections())
+			if (conn.first != except && !cell->output(conn.first))
+				for (auto bit : conn.second)
+					demand(bit);
+	}
+
+	void demand_cell_bit(Cell *cell, IdString port, int offset)
+	{
+		if (cell->type.in(ID($dff), ID($dffe), ID($adff), ID($adffe), ID($sdff), ID($sdffe), ID($sdffce), ID($dlatch), ID($adlatch))) {
+			if (port != ID::Q)
+				return;
+			demand(cell->getPort(ID::D)[offset]);
+			if (demanded_cells.insert(cell).second)
+				demand_inputs(cell, ID::D);
+			return;
+		}
+
+		if (cell->type.in(ID($mux), ID($pmux))) {
+			SigSpec sig_a = cell->getPort(ID::A);
+			SigSpec sig_b = cell->getPort(ID::B);
+			demand(sig_a[offset]);
+			for (int k = 0; k*GetSize(sig_a) < GetSize(sig_b); k++)
+				demand(sig_b[k*GetSize(sig_a) + offset]);
+			if (demanded_cells.insert(cell).second)
+				for (auto bit : cell->getPort(ID::S))
+					demand(bit);
+			return;
+		}
+
+		if (cell->type.in(ID($not), ID($pos), ID($and), ID($or), ID($xor), ID($xnor))) {
+			for (auto in_port : {ID::A, ID::B}) {
+				if (!cell->hasPort(in_port))
+					continue;
+				SigSpec sig = cell->getPort(in_port);
+				if (offset < GetSize(sig))
+					demand(sig[offset]);
+				else if (GetSize(sig) > 0 && cell->getParam(in_port == ID::A ? ID::A_SIGNED : ID::B_SIGNED).as_bool())
+					demand(sig[GetSize(sig)-1]);
+			}
+			return;
+		}
+
+		if (cell->type.in(ID($neg), ID($add), ID($sub), ID($mul))) {
+			// Bit i of the result only depends on bits 0..i of the inputs.
+			int &prefix = demanded_prefix[cell];
+			for (auto in_port : {ID::A, ID::B}) {
+				if (!cell->hasPort(in_port))
+					continue;
+				SigSpec sig = cell->getPort(in_port);
+				for (int i = prefix; i <= offset && i < GetSize(sig); i++)
+					demand(sig[i]);
+			}
+			prefix = std::max(prefix, offset+1);
+			return;
+		}
+
+		if (demanded_cells.insert(cell).second)
+			demand_inputs(cell);
+	}
+
+	void find_demanded_bits()
+	{
+		for (auto w : module->wires())
+			if (w->port_output)
+				for (auto bit : SigSpec(w))
+					demand(bit);
+
+		for (auto bit : keep_bits)
+			demand(bit);
+
+		for (auto c : module->cells())
+			if (!module->selected(c) || !c->type.in(config->supported_cell_types))
+				demand_inputs(c);
+
+		while (!demand_queue.empty())
+		{
+			SigBit bit = demand_queue.back();
+			demand_queue.pop_back();
+
+			for (auto &port : mi.query_ports(bit))
+				if (port.cell->output(port.port) && module->selected(port.cell) && port.cell->type.in(config->supported_cell_types))
+					demand_cell_bit(port.cell, port.port, port.offset);
+		}
+	}
+
+	// Connects signals while keeping demanded_bits up to date for the merged bits.
+	void connect(SigSpec lhs, SigSpec rhs)
+	{
+		std::vector<bool> demanded;
+		for (int i = 0; i < GetSize(lhs); i++)
+			demanded.push_back(is_demanded(lhs[i]) || is_demanded(rhs[i]));
+		module->connect(lhs, rhs);
+		for (int i = 0; i < GetSize(lhs); i++) {
+			SigBit bit = mi.sigmap(lhs[i]);
+			if (demanded[i] && bit.wire)
+				demanded_bits.insert(bit);
+		}
+	}
 
 	void run_cell_mux(Cell *cell)
 	{
@@ -76,8 +201,7 @@ struct WreduceWorker
 
 		for (int i = GetSize(sig_y)-1; i >= 0; i--)
 		{
-			auto info = mi.query(sig_y[i]);
-			if (!info->is_output && GetSize(info->ports) <= 1 && !keep_bits.count(mi.sigmap(sig_y[i]))) {
+			if (!is_demanded(sig_y[i])) {
 				bits_removed.push_back(State::Sx);
 				continue;
 			}
@@ -104,7 +228,7 @@ struct WreduceWorker
 
 		if (GetSize(bits_removed) == GetSize(sig_y)) {
 			log("Removed cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
-			module->connect(sig_y, sig_removed);
+			connect(sig_y, sig_removed);
 			module->remove(cell);
 			return;
 		}
@@ -136,7 +260,7 @@ struct WreduceWorker
 		cell->setPort(ID::Y, new_sig_y);
 		cell->fixup_parameters();
 
-		module->connect(sig_y.extract(n_kept, n_removed), sig_removed);
+		connect(sig_y.extract(n_kept, n_removed), sig_removed);
 	}
 
 	void run_cell_dff(Cell *cell)
@@ -168,7 +292,7 @@ struct WreduceWorker
 		{
 			if (zero_ext && sig_d[i] == State::S0 && (initval[i] == State::S0 || (!config->keepdc && initval[i] == State::Sx)) &&
 					(!has_reset || i >= GetSize(rst_value) || rst_value[i] == State::S0 || (!config->keepdc && rst_value[i] == State::Sx))) {
-				module->connect(sig_q[i], State::S0);
+				connect(sig_q[i], State::S0);
 				initvals.remove_init(sig_q[i]);
 				sig_d.remove(i);
 				sig_q.remove(i);
@@ -177,7 +301,7 @@ struct WreduceWorker
 
 			if (sign_ext && i > 0 && sig_d[i] == sig_d[i-1] && initval[i] == initval[i-1] && (!config->keepdc || initval[i] != State::Sx) &&
 					(!has_reset || i >= GetSize(rst_value) || (rst_value[i] == rst_value[i-1] && (!config->keepdc || rst_value[i] != State::Sx)))) {
-				module->connect(sig_q[i], sig_q[i-1]);
+				connect(sig_q[i], sig_q[i-1]);
 				initvals.remove_init(sig_q[i]);
 				sig_d.remove(i);
 				sig_q.remove(i);
@@ -187,7 +311,7 @@ struct WreduceWorker
 			auto info = mi.query(sig_q[i]);
 			if (info == nullptr)
 				return;
-			if (!info->is_output && GetSize(info->ports) == 1 && !keep_bits.count(mi.sigmap(sig_q[i]))) {
+			if (!is_demanded(sig_q[i])) {
 				initvals.remove_init(sig_q[i]);
 				sig_d.remove(i);
 				sig_q.remove(i);
@@ -335,12 +459,7 @@ struct WreduceWorker
 		} else {
 			while (GetSize(sig) > 0)
 			{
-				auto bit = sig[GetSize(sig)-1];
-				if (keep_bits.count(bit))
-					break;
-
-				auto info = mi.query(bit);
-				if (info->is_output || GetSize(info->ports) > 1)
+				if (is_demanded(sig[GetSize(sig)-1]))
 					break;
 
 				sig.remove(GetSize(sig)-1);
@@ -373,7 +492,11 @@ struct WreduceWorker
 				sig.remove(max_y_size, GetSize(extra_bits));
 
 				SigBit padbit = is_signed ? sig[GetSize(sig)-1] : State::S0;
-				module->connect(extra_bits, SigSpec(padbit, GetSize(extra_bits)));
+				connect(extra_bits, SigSpec(padbit, GetSize(extra_bits)));
+
+				// The readers of these bits now see a sign or zero extension.
+				for (auto bit : extra_bits)
+					work_queue_bits.insert(bit);
 			}
 		}
 
@@ -416,6 +539,8 @@ struct WreduceWorker
 					keep_bits.insert(bit);
 		}
 
+		find_demanded_bits();
+
 		for (auto c : module->selected_cells())
 			work_queue_cells.insert(c);
 
@@ -480,6 +605,10 @@ struct WreducePass : public Pass {
 		log("        assign y = a + b + c + 1;\n");
 		log("    endmodule\n");
 		log("\n");
+		log("Output bits are removed when a module-wide analysis shows that their value\n");
+		log("cannot be observed, even if other (equally unobservable) cells still read\n");
+		log("them, so chains of such cells are narrowed in a single run.\n");
+		log("\n");
 		log("Options:\n");
 		log("\n");
 		log("    -memx\n");
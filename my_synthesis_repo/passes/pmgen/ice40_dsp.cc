@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -260,6 +261,7 @@ void create_ice40_dsp(ice40_dsp_pm &pm)
 			cell->setParam(ID(TOPOUTPUT_SELECT), Const(1, 2));
 
 		st.ffO->connections_.at(ID::Q).replace(O, pm.module->addWire(NEW_ID, GetSize(O)));
+		pm.module->notify_blackout();
 		cell->setParam(ID(BOTOUTPUT_SELECT), Const(1, 2));
 	}
 	else {
@@ -312,7 +314,7 @@ struct Ice40DspPass : public Pass {
 		extra_args(args, argidx, design);
 
 		for (auto module : design->selected_modules())
-			ice40_dsp_pm(module, module->selected_cells()).run_ice40_dsp(create_ice40_dsp);
+			ice40_dsp_pm(module, module->selected_cells(), ModIndex::get(module)).run_ice40_dsp(create_ice40_dsp);
 	}
 } Ice40DspPass;
 
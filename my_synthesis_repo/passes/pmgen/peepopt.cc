@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -27,6 +28,73 @@ bool did_something;
 
 #include "passes/pmgen/peepopt_pm.h"
 
+// Collects the signals touched by the rewrites of one round, so that the next
+// round only matches the cells around them. Bulk edits fall back to a round
+// over all selected cells.
+struct PeepoptChanges : public RTLIL::Monitor
+{
+	pool<SigBit> bits;
+	bool blackout = false;
+
+	void add(const SigSpec &sig)
+	{
+		for (auto bit : sig)
+			if (bit.wire != nullptr)
+				bits.insert(bit);
+	}
+
+	void notify_connect(RTLIL::Cell*, const RTLIL::IdString&, const RTLIL::SigSpec &old_sig, const RTLIL::SigSpec &sig) override
+	{
+		add(old_sig);
+		add(sig);
+	}
+
+	void notify_connect(RTLIL::Module*, const RTLIL::SigSig &sigsig) override
+	{
+		add(sigsig.first);
+		add(sigsig.second);
+	}
+
+	void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) override
+	{
+		blackout = true;
+	}
+
+	void notify_blackout(RTLIL::Module*) override
+	{
+		blackout = true;
+	}
+};
+
+// Selected cells within two connections of the changed signals, in module order.
+static std::vector<Cell*> changed_neighborhood(Module *module, const PeepoptChanges &changes)
+{
+	ModIndex &index = ModIndex::get(module);
+
+	pool<Cell*> near;
+	for (auto bit : changes.bits)
+		for (auto &port : index.query_ports(bit))
+			near.insert(port.cell);
+
+	pool<Cell*> around = near;
+	for (auto cell : near)
+		for (auto &conn : cell->connections())
+			for (auto bit : conn.second)
+				if (bit.wire != nullptr)
+					for (auto &port : index.query_ports(bit))
+						around.insert(port.cell);
+
+	std::vector<Cell*> cells;
+	for (auto cell : module->selected_cells())
+		if (around.count(cell))
+			cells.push_back(cell);
+	return cells;
+}
+
+// generation_ of the fully selected modules at the end of the last run,
+// by hashidx_, so that unchanged modules are skipped by the next call
+static dict<unsigned int, unsigned int> done_generation;
+
 struct PeepoptPass : public Pass {
 	PeepoptPass() : Pass("peepopt", "collection of peephole optimizers") { }
 	void help() override
@@ -51,6 +119,10 @@ struct PeepoptPass : public Pass {
 		log("   * shiftadd - Replace A>>(B+D) with (A'>>D)>>(B) where D is constant and\n");
 		log("                A' is derived from A by padding or cutting inaccessible bits.\n");
 		log("\n");
+		log("After the first round over a module, the rules are only matched again on the\n");
+		log("cells near the ones changed by the previous round. Fully selected modules that\n");
+		log("were not modified since the last run of this pass are skipped.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -63,24 +135,51 @@ struct PeepoptPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		int skipped = 0;
 		for (auto module : design->selected_modules())
 		{
+			bool whole_module = design->selected_whole_module(module->name);
+			auto it = done_generation.find(module->hashidx_);
+			if (whole_module && it != done_generation.end() && it->second == module->generation_) {
+				skipped++;
+				continue;
+			}
+
+			std::vector<Cell*> cells = module->selected_cells();
 			did_something = true;
 
-			while (did_something)
+			while (did_something && !cells.empty())
 			{
 				did_something = false;
 
-				peepopt_pm pm(module);
+				PeepoptChanges changes;
+				module->monitors.insert(&changes);
+				{
+					peepopt_pm pm(module, ModIndex::get(module));
 
-				pm.setup(module->selected_cells());
+					pm.setup(cells);
 
-				pm.run_shiftadd();
-				pm.run_shiftmul_right();
-				pm.run_shiftmul_left();
-				pm.run_muldiv();
+					pm.run_shiftadd();
+					pm.run_shiftmul_right();
+					pm.run_shiftmul_left();
+					pm.run_muldiv();
+				}
+				module->monitors.erase(&changes);
+
+				if (!did_something)
+					break;
+				if (changes.blackout)
+					cells = module->selected_cells();
+				else
+					cells = changed_neighborhood(module, changes);
 			}
+
+			if (whole_module)
+				done_generation[module->hashidx_] = module->generation_;
 		}
+
+		if (skipped > 0)
+			log("Skipped %d modules that are unchanged since the last run.\n", skipped);
 	}
 } PeepoptPass;
 
@@ -354,6 +354,7 @@ with open(outfile, "w") as f:
     if genhdr:
         print("#include \"kernel/yosys.h\"", file=f)
         print("#include \"kernel/sigtools.h\"", file=f)
+        print("#include \"kernel/modtools.h\"", file=f)
         print("", file=f)
         print("YOSYS_NAMESPACE_BEGIN", file=f)
         print("", file=f)
@@ -361,6 +362,7 @@ with open(outfile, "w") as f:
     print("struct {}_pm {{".format(prefix), file=f)
     print("  Module *module;", file=f)
     print("  SigMap sigmap;", file=f)
+    print("  ModIndex *shared_index;", file=f)
     print("  std::function<void()> on_accept;", file=f)
     print("  bool setup_done;", file=f)
     print("  bool generate_mode;", file=f)
@@ -474,21 +476,53 @@ with open(outfile, "w") as f:
 
     print("  int nusers(const SigSpec &sig) {", file=f)
     print("    pool<Cell*> users;", file=f)
-    print("    for (auto bit : sigmap(sig))", file=f)
+    print("    for (auto bit : sigmap(sig)) {", file=f)
     print("      for (auto user : sigusers[bit])", file=f)
     print("        users.insert(user);", file=f)
+    print("      if (shared_index == nullptr || bit.wire == nullptr) continue;", file=f)
+    print("      const ModIndex::SigBitInfo *info = shared_index->query(bit);", file=f)
+    print("      if (info == nullptr) continue;", file=f)
+    print("      if (info->is_input || info->is_output)", file=f)
+    print("        users.insert(nullptr);", file=f)
+    print("      for (auto &port : info->ports)", file=f)
+    print("        users.insert(port.cell);", file=f)
+    print("    }", file=f)
     print("    return GetSize(users);", file=f)
     print("  }", file=f)
     print("", file=f)
 
     print("  {}_pm(Module *module, const vector<Cell*> &cells) :".format(prefix), file=f)
-    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("      module(module), sigmap(module), shared_index(nullptr), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
     print("    setup(cells);", file=f)
     print("  }", file=f)
     print("", file=f)
 
     print("  {}_pm(Module *module) :".format(prefix), file=f)
-    print("      module(module), sigmap(module), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("      module(module), sigmap(module), shared_index(nullptr), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  // Matchers created with a ModIndex, usually ModIndex::get(module), take", file=f)
+    print("  // their SigMap from it and count users with it instead of indexing every", file=f)
+    print("  // connection of the module themselves.", file=f)
+    print("  {}_pm(Module *module, const vector<Cell*> &cells, ModIndex &index) :".format(prefix), file=f)
+    print("      module(module), shared_index(&index), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("    attach_index(index);", file=f)
+    print("    setup(cells);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  {}_pm(Module *module, ModIndex &index) :".format(prefix), file=f)
+    print("      module(module), shared_index(&index), setup_done(false), generate_mode(false), rngseed(12345678) {", file=f)
+    print("    attach_index(index);", file=f)
+    print("  }", file=f)
+    print("", file=f)
+
+    print("  void attach_index(ModIndex &index) {", file=f)
+    print("    log_assert(index.module == module);", file=f)
+    print("    if (index.auto_reload_module)", file=f)
+    print("      index.reload_module();", file=f)
+    print("    sigmap = index.sigmap;", file=f)
     print("  }", file=f)
     print("", file=f)
 
@@ -502,11 +536,13 @@ with open(outfile, "w") as f:
     current_pattern = None
     print("    log_assert(!setup_done);", file=f)
     print("    setup_done = true;", file=f)
-    print("    for (auto port : module->ports)", file=f)
-    print("      add_siguser(module->wire(port), nullptr);", file=f)
-    print("    for (auto cell : module->cells())", file=f)
-    print("      for (auto &conn : cell->connections())", file=f)
-    print("        add_siguser(conn.second, cell);", file=f)
+    print("    if (shared_index == nullptr) {", file=f)
+    print("      for (auto port : module->ports)", file=f)
+    print("        add_siguser(module->wire(port), nullptr);", file=f)
+    print("      for (auto cell : module->cells())", file=f)
+    print("        for (auto &conn : cell->connections())", file=f)
+    print("          add_siguser(conn.second, cell);", file=f)
+    print("    }", file=f)
     print("    for (auto cell : cells) {", file=f)
 
     for index in range(len(blocks)):
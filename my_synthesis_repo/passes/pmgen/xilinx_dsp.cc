@@ -20,6 +20,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 #include <deque>
 
 USING_YOSYS_NAMESPACE
@@ -309,6 +310,7 @@ void xilinx_dsp_pack(xilinx_dsp_pm &pm)
 		log("  postadder %s (%s)\n", log_id(st.postAdd), log_id(st.postAdd->type));
 
 		SigSpec &opmode = cell->connections_.at(ID(OPMODE));
+		pm.module->notify_blackout();
 		if (st.postAddMux) {
 			log_assert(st.ffP);
 			opmode[4] = st.postAddMux->getPort(ID::S);
@@ -438,12 +440,14 @@ void xilinx_dsp_pack(xilinx_dsp_pm &pm)
 			SigSpec M; // unused
 			f(M, st.ffM, ID(CEM), ID(RSTM));
 			st.ffM->connections_.at(ID::Q).replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			pm.module->notify_blackout();
 			cell->setParam(ID(MREG), State::S1);
 		}
 		if (st.ffP) {
 			SigSpec P; // unused
 			f(P, st.ffP, ID(CEP), ID(RSTP));
 			st.ffP->connections_.at(ID::Q).replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			pm.module->notify_blackout();
 			cell->setParam(ID(PREG), State::S1);
 		}
 
@@ -503,6 +507,7 @@ void xilinx_dsp48a_pack(xilinx_dsp48a_pm &pm)
 
 	Cell *cell = st.dsp;
 	SigSpec &opmode = cell->connections_.at(ID(OPMODE));
+	pm.module->notify_blackout();
 
 	if (st.preAdd) {
 		log("  preadder %s (%s)\n", log_id(st.preAdd), log_id(st.preAdd->type));
@@ -621,12 +626,14 @@ void xilinx_dsp48a_pack(xilinx_dsp48a_pm &pm)
 			SigSpec M; // unused
 			f(M, st.ffM, ID(CEM), ID(RSTM));
 			st.ffM->connections_.at(ID::Q).replace(st.sigM, pm.module->addWire(NEW_ID, GetSize(st.sigM)));
+			pm.module->notify_blackout();
 			cell->setParam(ID(MREG), State::S1);
 		}
 		if (st.ffP) {
 			SigSpec P; // unused
 			f(P, st.ffP, ID(CEP), ID(RSTP));
 			st.ffP->connections_.at(ID::Q).replace(st.sigP, pm.module->addWire(NEW_ID, GetSize(st.sigP)));
+			pm.module->notify_blackout();
 			cell->setParam(ID(PREG), State::S1);
 		}
 
@@ -725,6 +732,68 @@ void xilinx_dsp_packC(xilinx_dsp_CREG_pm &pm)
 	pm.blacklist(cell);
 }
 
+// Returns the cells the cascade matcher can use, in their original order: the
+// DSPs that are linked to another DSP by a 'P' -> 'C' connection (directly or
+// shifted by 17 bits) and the FFs whose outputs drive the 'A' or 'B' inputs of
+// those DSPs. All chains are found with one lookup of 'P[0]' and 'P[17]' per
+// DSP, so the matcher does not index the rest of the module.
+static std::vector<Cell*> cascade_candidates(Module *module, const std::vector<Cell*> &cells)
+{
+	const SigMap &sigmap = SigMap::get(module);
+
+	dict<SigBit, std::vector<Cell*>> dsp_by_c0;
+	std::vector<Cell*> dsps;
+	for (auto cell : cells) {
+		if (!cell->type.in(ID(DSP48A), ID(DSP48A1), ID(DSP48E1)))
+			continue;
+		dsps.push_back(cell);
+		SigSpec C = cell->connections_.at(ID(C), SigSpec());
+		if (!C.empty())
+			dsp_by_c0[sigmap(C[0])].push_back(cell);
+	}
+
+	pool<Cell*> linked;
+	for (auto dsp : dsps) {
+		SigSpec P = sigmap(dsp->connections_.at(ID(P), SigSpec()));
+		for (int offset : {0, 17}) {
+			if (GetSize(P) <= offset)
+				continue;
+			auto it = dsp_by_c0.find(P[offset]);
+			if (it == dsp_by_c0.end())
+				continue;
+			linked.insert(dsp);
+			for (auto next : it->second)
+				linked.insert(next);
+		}
+	}
+
+	std::vector<Cell*> candidates;
+	if (linked.empty())
+		return candidates;
+
+	pool<SigBit> ab_bits;
+	for (auto dsp : linked)
+		for (auto port : {ID::A, ID::B})
+			for (auto bit : sigmap(dsp->connections_.at(port, SigSpec())))
+				if (bit.wire)
+					ab_bits.insert(bit);
+
+	for (auto cell : cells) {
+		if (linked.count(cell)) {
+			candidates.push_back(cell);
+			continue;
+		}
+		if (!cell->type.in(ID($dff), ID($dffe), ID($sdff), ID($sdffe)))
+			continue;
+		for (auto bit : sigmap(cell->getPort(ID::Q)))
+			if (ab_bits.count(bit)) {
+				candidates.push_back(cell);
+				break;
+			}
+	}
+	return candidates;
+}
+
 struct XilinxDspPass : public Pass {
 	XilinxDspPass() : Pass("xilinx_dsp", "Xilinx: pack resources into DSPs") { }
 	void help() override
@@ -799,6 +868,10 @@ struct XilinxDspPass : public Pass {
 			if (design->scratchpad_get_bool("xilinx_dsp.multonly"))
 				continue;
 
+			// all matchers below share the module's index, which follows
+			// the changes made by the earlier ones
+			ModIndex &index = ModIndex::get(module);
+
 			// Experimental feature: pack $add/$sub cells with
 			//   (* use_dsp48="simd" *) into DSP48E1's using its
 			//   SIMD feature
@@ -808,10 +881,10 @@ struct XilinxDspPass : public Pass {
 			// Match for all features ([ABDMP][12]?REG, pre-adder,
 			// post-adder, pattern detector, etc.) except for CREG
 			if (family == "xc7") {
-				xilinx_dsp_pm pm(module, module->selected_cells());
+				xilinx_dsp_pm pm(module, module->selected_cells(), index);
 				pm.run_xilinx_dsp_pack(xilinx_dsp_pack);
 			} else if (family == "xc6s" || family == "xc3sda") {
-				xilinx_dsp48a_pm pm(module, module->selected_cells());
+				xilinx_dsp48a_pm pm(module, module->selected_cells(), index);
 				pm.run_xilinx_dsp48a_pack(xilinx_dsp48a_pack);
 			}
 			// Separating out CREG packing is necessary since there
@@ -823,14 +896,15 @@ struct XilinxDspPass : public Pass {
 			//   PREG of an upstream DSP that had not been visited
 			//   yet
 			{
-				xilinx_dsp_CREG_pm pm(module, module->selected_cells());
+				xilinx_dsp_CREG_pm pm(module, module->selected_cells(), index);
 				pm.run_xilinx_dsp_packC(xilinx_dsp_packC);
 			}
 			// Lastly, identify and utilise PCOUT -> PCIN,
 			//   ACOUT -> ACIN, and BCOUT-> BCIN dedicated cascade
 			//   chains
-			{
-				xilinx_dsp_cascade_pm pm(module, module->selected_cells());
+			std::vector<Cell*> candidates = cascade_candidates(module, module->selected_cells());
+			if (!candidates.empty()) {
+				xilinx_dsp_cascade_pm pm(module, candidates, index);
 				pm.run_xilinx_dsp_cascade();
 			}
 		}
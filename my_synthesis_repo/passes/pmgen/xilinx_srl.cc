@@ -20,20 +20,138 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 #include "passes/pmgen/xilinx_srl_pm.h"
 
-void run_fixed(xilinx_srl_pm &pm)
+// Fixed-length chains are found without the pattern matcher: each FF is
+// linked once to the FF that drives its D input, and every maximal chain is
+// then walked from its last FF towards its first without recursion, using the
+// same conditions as the "fixed" pattern in xilinx_srl.pmg.
+struct FixedChainFinder
 {
-	auto &st = pm.st_fixed;
-	auto &ud = pm.ud_fixed;
-	log("Found fixed chain of length %d (%s):\n", GetSize(ud.longest_chain), log_id(st.first->type));
+	Module *module;
+	const SigMap &sigmap;
+	ModIndex &index;
+	dict<SigBit, Cell*> q_driver;
+
+	FixedChainFinder(Module *module) : module(module), sigmap(SigMap::get(module)), index(ModIndex::get(module)) { }
+
+	static bool is_ff(Cell *cell)
+	{
+		return cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_), ID(FDRE), ID(FDRE_1));
+	}
+
+	SigSpec port(Cell *cell, IdString portname, const SigSpec &defval = SigSpec())
+	{
+		return sigmap(cell->connections_.at(portname, defval));
+	}
+
+	// number of cells, and module ports, connected to the bit
+	int nusers(SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return 0;
+		const ModIndex::SigBitInfo *info = index.query(bit);
+		if (info == nullptr)
+			return 0;
+		pool<Cell*> users;
+		if (info->is_input || info->is_output)
+			users.insert(nullptr);
+		for (auto &p : info->ports)
+			users.insert(p.cell);
+		return GetSize(users);
+	}
+
+	bool can_be_last(Cell *cell)
+	{
+		if (!is_ff(cell) || cell->has_keep_attr())
+			return false;
+		if (cell->type == ID(FDRE) && (cell->getParam(ID(IS_R_INVERTED)).as_bool() || cell->getParam(ID(IS_D_INVERTED)).as_bool()))
+			return false;
+		if (cell->type.in(ID(FDRE), ID(FDRE_1)) && !port(cell, ID::R, State::S0).is_fully_zero())
+			return false;
+		return true;
+	}
+
+	// The FF in front of prev in a chain that ends with last, or nullptr.
+	Cell *prev_in_chain(Cell *prev, Cell *last)
+	{
+		SigSpec D = port(prev, ID::D);
+		if (GetSize(D) != 1)
+			return nullptr;
+		auto it = q_driver.find(D[0]);
+		if (it == q_driver.end())
+			return nullptr;
+		Cell *next = it->second;
+
+		if (next->type != prev->type || next->has_keep_attr())
+			return nullptr;
+		SigSpec next_D = port(next, ID::D);
+		if (next_D.empty() || !next_D[0].wire || next_D[0].wire->get_bool_attribute(ID::keep))
+			return nullptr;
+		if (nusers(port(next, ID::Q)[0]) != 2)
+			return nullptr;
+		if (port(next, ID::C) != port(last, ID::C))
+			return nullptr;
+		IdString en_port = last->type.in(ID(FDRE), ID(FDRE_1)) ? ID(CE) : last->type.begins_with("$_DFFE_") ? ID::E : IdString();
+		if (en_port != IdString() && port(next, en_port) != port(last, en_port))
+			return nullptr;
+		if (last->type == ID(FDRE))
+			for (auto param : {ID(IS_C_INVERTED), ID(IS_D_INVERTED), ID(IS_R_INVERTED)})
+				if (next->getParam(param).as_bool() != last->getParam(param).as_bool())
+					return nullptr;
+		if (last->type.in(ID(FDRE), ID(FDRE_1)) && !port(next, ID::R, State::S0).is_fully_zero())
+			return nullptr;
+		return next;
+	}
+
+	// Returns the chains of at least minlen FFs, each from its last FF to its
+	// first, in the order of their last FFs in cells.
+	std::vector<std::vector<Cell*>> find(const std::vector<Cell*> &cells, int minlen)
+	{
+		std::vector<Cell*> ffs;
+		for (auto cell : cells)
+			if (is_ff(cell)) {
+				ffs.push_back(cell);
+				SigSpec Q = port(cell, ID::Q);
+				if (GetSize(Q) == 1 && Q[0].wire)
+					q_driver[Q[0]] = cell;
+			}
+
+		pool<Cell*> has_successor;
+		for (auto cell : ffs)
+			if (can_be_last(cell)) {
+				Cell *prev = prev_in_chain(cell, cell);
+				if (prev != nullptr)
+					has_successor.insert(prev);
+			}
+
+		std::vector<std::vector<Cell*>> chains;
+		for (auto cell : ffs) {
+			if (!can_be_last(cell) || has_successor.count(cell))
+				continue;
+			std::vector<Cell*> chain = {cell};
+			// a chain can only run into a loop through its last FF, as every
+			// other FF of the chain has a single user
+			for (Cell *prev = prev_in_chain(cell, cell); prev != nullptr && prev != cell; prev = prev_in_chain(prev, cell))
+				chain.push_back(prev);
+			if (GetSize(chain) >= minlen)
+				chains.push_back(std::move(chain));
+		}
+		return chains;
+	}
+};
+
+void run_fixed(Module *module, const std::vector<Cell*> &longest_chain, pool<Cell*> &remove_cells)
+{
+	log("Found fixed chain of length %d (%s):\n", GetSize(longest_chain), log_id(longest_chain.front()->type));
 
 	SigSpec initval;
-	for (auto cell : ud.longest_chain) {
+	for (auto cell : longest_chain) {
 		log_debug("    %s\n", log_id(cell));
 		if (cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_))) {
 			SigBit Q = cell->getPort(ID::Q);
@@ -55,16 +173,16 @@ void run_fixed(xilinx_srl_pm &pm)
 		}
 		else
 			log_abort();
-		pm.autoremove(cell);
+		remove_cells.insert(cell);
 	}
 
-	auto first_cell = ud.longest_chain.back();
-	auto last_cell = ud.longest_chain.front();
-	Cell *c = pm.module->addCell(NEW_ID, ID($__XILINX_SHREG_));
-	pm.module->swap_names(c, first_cell);
+	auto first_cell = longest_chain.back();
+	auto last_cell = longest_chain.front();
+	Cell *c = module->addCell(NEW_ID, ID($__XILINX_SHREG_));
+	module->swap_names(c, first_cell);
 
 	if (first_cell->type.in(ID($_DFF_N_), ID($_DFF_P_), ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_), ID(FDRE), ID(FDRE_1))) {
-		c->setParam(ID::DEPTH, GetSize(ud.longest_chain));
+		c->setParam(ID::DEPTH, GetSize(longest_chain));
 		c->setParam(ID::INIT, initval.as_const());
 		if (first_cell->type.in(ID($_DFF_P_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
 			c->setParam(ID(CLKPOL), 1);
@@ -88,7 +206,7 @@ void run_fixed(xilinx_srl_pm &pm)
 		c->setPort(ID::C, first_cell->getPort(ID::C));
 		c->setPort(ID::D, first_cell->getPort(ID::D));
 		c->setPort(ID::Q, last_cell->getPort(ID::Q));
-		c->setPort(ID::L, GetSize(ud.longest_chain)-1);
+		c->setPort(ID::L, GetSize(longest_chain)-1);
 		if (first_cell->type.in(ID($_DFF_N_), ID($_DFF_P_)))
 			c->setPort(ID::E, State::S1);
 		else if (first_cell->type.in(ID($_DFFE_NN_), ID($_DFFE_NP_), ID($_DFFE_PN_), ID($_DFFE_PP_)))
@@ -204,7 +322,9 @@ struct XilinxSrlPass : public Pass {
 		log("        min length of shift register (default = 3)\n");
 		log("\n");
 		log("    -fixed\n");
-		log("        infer fixed-length shift registers.\n");
+		log("        infer fixed-length shift registers. all chains are found with a\n");
+		log("        single walk over the FFs, so the run time is linear in their number\n");
+		log("        also for very deep delay lines.\n");
 		log("\n");
 		log("    -variable\n");
 		log("        infer variable-length shift registers (i.e. fixed-length shifts where\n");
@@ -247,14 +367,20 @@ struct XilinxSrlPass : public Pass {
 			log_cmd_error("'-fixed' and/or '-variable' must be specified.\n");
 
 		for (auto module : design->selected_modules()) {
-			auto pm = xilinx_srl_pm(module, module->selected_cells());
-			pm.ud_fixed.minlen = minlen;
-			pm.ud_variable.minlen = minlen;
+			if (fixed) {
+				pool<Cell*> remove_cells;
+				FixedChainFinder finder(module);
+				for (auto &chain : finder.find(module->selected_cells(), minlen))
+					run_fixed(module, chain, remove_cells);
+				for (auto cell : remove_cells)
+					module->remove(cell);
+			}
 
-			if (fixed)
-				pm.run_fixed(run_fixed);
-			if (variable)
+			if (variable) {
+				auto pm = xilinx_srl_pm(module, module->selected_cells(), ModIndex::get(module));
+				pm.ud_variable.minlen = minlen;
 				pm.run_variable(run_variable);
+			}
 		}
 	}
 } XilinxSrlPass;
@@ -109,37 +109,51 @@ struct SigSnippets
 struct SnippetSwCache
 {
 	dict<RTLIL::SwitchRule*, pool<RTLIL::SigBit>, hash_ptr_ops> full_case_bits_cache;
-	dict<RTLIL::SwitchRule*, pool<int>, hash_ptr_ops> cache;
+	// for each switch and snippet the ascending indices of the cases that assign the snippet
+	dict<RTLIL::SwitchRule*, dict<int, std::vector<int>>, hash_ptr_ops> cache;
+	dict<RTLIL::SwitchRule*, std::vector<int>, hash_ptr_ops> pgroups_cache;
+	dict<RTLIL::CaseRule*, RTLIL::SigSpec, hash_ptr_ops> cmp_cache;
 	const SigSnippets *snippets;
 	int current_snippet;
 
 	bool check(RTLIL::SwitchRule *sw)
 	{
-		return cache[sw].count(current_snippet) != 0;
+		auto it = cache.find(sw);
+		return it != cache.end() && it->second.count(current_snippet) != 0;
 	}
 
-	void insert(const RTLIL::CaseRule *cs, vector<RTLIL::SwitchRule*> &sw_stack)
+	const std::vector<int> &cases(RTLIL::SwitchRule *sw)
+	{
+		return cache.at(sw).at(current_snippet);
+	}
+
+	void insert(const RTLIL::CaseRule *cs, vector<std::pair<RTLIL::SwitchRule*, int>> &sw_stack)
 	{
 		for (auto &action : cs->actions)
 		for (auto bit : action.first) {
 			int sn = snippets->bit2snippet.at(bit, -1);
 			if (sn < 0)
 				continue;
-			for (auto sw : sw_stack)
-				cache[sw].insert(sn);
+			for (auto &it : sw_stack) {
+				std::vector<int> &case_list = cache[it.first][sn];
+				if (case_list.empty() || case_list.back() != it.second)
+					case_list.push_back(it.second);
+			}
 		}
 
 		for (auto sw : cs->switches) {
-			sw_stack.push_back(sw);
-			for (auto cs2 : sw->cases)
+			sw_stack.push_back({sw, 0});
+			for (auto cs2 : sw->cases) {
 				insert(cs2, sw_stack);
+				sw_stack.back().second++;
+			}
 			sw_stack.pop_back();
 		}
 	}
 
 	void insert(const RTLIL::CaseRule *cs)
 	{
-		vector<RTLIL::SwitchRule*> sw_stack;
+		vector<std::pair<RTLIL::SwitchRule*, int>> sw_stack;
 		insert(cs, sw_stack);
 	}
 };
@@ -218,7 +232,18 @@ RTLIL::SigSpec gen_cmp(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 	return RTLIL::SigSpec(ctrl_wire);
 }
 
-RTLIL::SigSpec gen_mux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::SigSpec else_signal, RTLIL::Cell *&last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+// the compare logic only depends on the case, so it is shared by the mux trees of all snippets
+RTLIL::SigSpec get_cmp(RTLIL::Module *mod, SnippetSwCache &swcache, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+{
+	auto it = swcache.cmp_cache.find(cs);
+	if (it != swcache.cmp_cache.end())
+		return it->second;
+	RTLIL::SigSpec ctrl_sig = gen_cmp(mod, sw->signal, cs->compare, sw, cs, ifxmode);
+	swcache.cmp_cache[cs] = ctrl_sig;
+	return ctrl_sig;
+}
+
+RTLIL::SigSpec gen_mux(RTLIL::Module *mod, SnippetSwCache &swcache, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::SigSpec else_signal, RTLIL::Cell *&last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
 {
 	log_assert(when_signal.size() == else_signal.size());
 
@@ -230,7 +255,7 @@ RTLIL::SigSpec gen_mux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 		return when_signal;
 
 	// compare results
-	RTLIL::SigSpec ctrl_sig = gen_cmp(mod, signal, compare, sw, cs, ifxmode);
+	RTLIL::SigSpec ctrl_sig = get_cmp(mod, swcache, sw, cs, ifxmode);
 	if (ctrl_sig.size() == 0)
 		return when_signal;
 	log_assert(ctrl_sig.size() == 1);
@@ -252,7 +277,9 @@ RTLIL::SigSpec gen_mux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const s
 	return RTLIL::SigSpec(result_wire);
 }
 
-void append_pmux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::vector<RTLIL::SigSpec> &compare, RTLIL::SigSpec when_signal, RTLIL::Cell *last_mux_cell, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
+// the new S and B bits are collected in pmux_s and pmux_b and added to the cell by flush_pmux(),
+// so that a wide case statement does not copy the growing ports for every case
+void append_pmux(RTLIL::Module *mod, SnippetSwCache &swcache, RTLIL::SigSpec when_signal, RTLIL::Cell *last_mux_cell, RTLIL::SigSpec &pmux_s, RTLIL::SigSpec &pmux_b, RTLIL::SwitchRule *sw, RTLIL::CaseRule *cs, bool ifxmode)
 {
 	log_assert(last_mux_cell != NULL);
 	log_assert(when_signal.size() == last_mux_cell->getPort(ID::A).size());
@@ -260,19 +287,31 @@ void append_pmux(RTLIL::Module *mod, const RTLIL::SigSpec &signal, const std::ve
 	if (when_signal == last_mux_cell->getPort(ID::A))
 		return;
 
-	RTLIL::SigSpec ctrl_sig = gen_cmp(mod, signal, compare, sw, cs, ifxmode);
+	RTLIL::SigSpec ctrl_sig = get_cmp(mod, swcache, sw, cs, ifxmode);
 	log_assert(ctrl_sig.size() == 1);
+
+	pmux_s.append(ctrl_sig);
+	pmux_b.append(when_signal);
+}
+
+void flush_pmux(RTLIL::Cell *last_mux_cell, RTLIL::SigSpec &pmux_s, RTLIL::SigSpec &pmux_b)
+{
+	if (last_mux_cell == NULL || pmux_s.empty())
+		return;
+
 	last_mux_cell->type = ID($pmux);
 
 	RTLIL::SigSpec new_s = last_mux_cell->getPort(ID::S);
-	new_s.append(ctrl_sig);
+	new_s.append(pmux_s);
 	last_mux_cell->setPort(ID::S, new_s);
 
 	RTLIL::SigSpec new_b = last_mux_cell->getPort(ID::B);
-	new_b.append(when_signal);
+	new_b.append(pmux_b);
 	last_mux_cell->setPort(ID::B, new_b);
 
-	last_mux_cell->parameters[ID::S_WIDTH] = last_mux_cell->getPort(ID::S).size();
+	last_mux_cell->parameters[ID::S_WIDTH] = new_s.size();
+	pmux_s = RTLIL::SigSpec();
+	pmux_b = RTLIL::SigSpec();
 }
 
 const pool<SigBit> &get_full_case_bits(SnippetSwCache &swcache, RTLIL::SwitchRule *sw)
@@ -318,6 +357,70 @@ const pool<SigBit> &get_full_case_bits(SnippetSwCache &swcache, RTLIL::SwitchRul
 	return swcache.full_case_bits_cache.at(sw);
 }
 
+const std::vector<int> &get_pgroups(SnippetSwCache &swcache, dict<RTLIL::SwitchRule*, bool, hash_ptr_ops> &swpara, RTLIL::SwitchRule *sw, bool ifxmode)
+{
+	auto it = swcache.pgroups_cache.find(sw);
+	if (it != swcache.pgroups_cache.end())
+		return it->second;
+
+	// detect groups of parallel cases
+	std::vector<int> pgroups(sw->cases.size());
+	bool is_simple_parallel_case = true;
+
+	if (!sw->get_bool_attribute(ID::parallel_case)) {
+		if (!swpara.count(sw)) {
+			pool<Const> case_values;
+			for (size_t i = 0; i < sw->cases.size(); i++) {
+				RTLIL::CaseRule *cs2 = sw->cases[i];
+				for (auto pat : cs2->compare) {
+					if (!pat.is_fully_def())
+						goto not_simple_parallel_case;
+					Const cpat = pat.as_const();
+					if (case_values.count(cpat))
+						goto not_simple_parallel_case;
+					case_values.insert(cpat);
+				}
+			}
+			if (0)
+		not_simple_parallel_case:
+				is_simple_parallel_case = false;
+			swpara[sw] = is_simple_parallel_case;
+		} else {
+			is_simple_parallel_case = swpara.at(sw);
+		}
+	}
+
+	if (!is_simple_parallel_case) {
+		BitPatternPool pool(sw->signal.size());
+		bool extra_group_for_next_case = false;
+		for (size_t i = 0; i < sw->cases.size(); i++) {
+			RTLIL::CaseRule *cs2 = sw->cases[i];
+			if (i != 0) {
+				pgroups[i] = pgroups[i-1];
+				if (extra_group_for_next_case) {
+					pgroups[i] = pgroups[i-1]+1;
+					extra_group_for_next_case = false;
+				}
+				for (auto pat : cs2->compare)
+					if (!pat.is_fully_const() || !pool.has_all(pat))
+						pgroups[i] = pgroups[i-1]+1;
+				if (cs2->compare.empty())
+					pgroups[i] = pgroups[i-1]+1;
+				if (pgroups[i] != pgroups[i-1])
+					pool = BitPatternPool(sw->signal.size());
+			}
+			for (auto pat : cs2->compare)
+				if (!pat.is_fully_const())
+					extra_group_for_next_case = true;
+				else if (!ifxmode)
+					pool.take(pat);
+		}
+	}
+
+	pgroups.swap(swcache.pgroups_cache[sw]);
+	return swcache.pgroups_cache.at(sw);
+}
+
 RTLIL::SigSpec signal_to_mux_tree(RTLIL::Module *mod, SnippetSwCache &swcache, dict<RTLIL::SwitchRule*, bool, hash_ptr_ops> &swpara,
 		RTLIL::CaseRule *cs, const RTLIL::SigSpec &sig, const RTLIL::SigSpec &defval, bool ifxmode)
 {
@@ -333,59 +436,7 @@ RTLIL::SigSpec signal_to_mux_tree(RTLIL::Module *mod, SnippetSwCache &swcache, d
 		if (!swcache.check(sw))
 			continue;
 
-		// detect groups of parallel cases
-		std::vector<int> pgroups(sw->cases.size());
-		bool is_simple_parallel_case = true;
-
-		if (!sw->get_bool_attribute(ID::parallel_case)) {
-			if (!swpara.count(sw)) {
-				pool<Const> case_values;
-				for (size_t i = 0; i < sw->cases.size(); i++) {
-					RTLIL::CaseRule *cs2 = sw->cases[i];
-					for (auto pat : cs2->compare) {
-						if (!pat.is_fully_def())
-							goto not_simple_parallel_case;
-						Const cpat = pat.as_const();
-						if (case_values.count(cpat))
-							goto not_simple_parallel_case;
-						case_values.insert(cpat);
-					}
-				}
-				if (0)
-			not_simple_parallel_case:
-					is_simple_parallel_case = false;
-				swpara[sw] = is_simple_parallel_case;
-			} else {
-				is_simple_parallel_case = swpara.at(sw);
-			}
-		}
-
-		if (!is_simple_parallel_case) {
-			BitPatternPool pool(sw->signal.size());
-			bool extra_group_for_next_case = false;
-			for (size_t i = 0; i < sw->cases.size(); i++) {
-				RTLIL::CaseRule *cs2 = sw->cases[i];
-				if (i != 0) {
-					pgroups[i] = pgroups[i-1];
-					if (extra_group_for_next_case) {
-						pgroups[i] = pgroups[i-1]+1;
-						extra_group_for_next_case = false;
-					}
-					for (auto pat : cs2->compare)
-						if (!pat.is_fully_const() || !pool.has_all(pat))
-							pgroups[i] = pgroups[i-1]+1;
-					if (cs2->compare.empty())
-						pgroups[i] = pgroups[i-1]+1;
-					if (pgroups[i] != pgroups[i-1])
-						pool = BitPatternPool(sw->signal.size());
-				}
-				for (auto pat : cs2->compare)
-					if (!pat.is_fully_const())
-						extra_group_for_next_case = true;
-					else if (!ifxmode)
-						pool.take(pat);
-			}
-		}
+		const std::vector<int> &pgroups = get_pgroups(swcache, swpara, sw, ifxmode);
 
 		// mask default bits that are irrelevant because the output is driven by a full case
 		const pool<SigBit> &full_case_bits = get_full_case_bits(swcache, sw);
@@ -396,15 +447,34 @@ RTLIL::SigSpec signal_to_mux_tree(RTLIL::Module *mod, SnippetSwCache &swcache, d
 		// evaluate in reverse order to give the first entry the top priority
 		RTLIL::SigSpec initial_val = result;
 		RTLIL::Cell *last_mux_cell = NULL;
-		for (size_t i = 0; i < sw->cases.size(); i++) {
-			int case_idx = sw->cases.size() - i - 1;
+		RTLIL::SigSpec pmux_s, pmux_b;
+		const std::vector<int> &assigning_cases = swcache.cases(sw);
+		int next_assigning = GetSize(assigning_cases) - 1;
+		for (int case_idx = GetSize(sw->cases) - 1; case_idx >= 0; case_idx--) {
 			RTLIL::CaseRule *cs2 = sw->cases[case_idx];
-			RTLIL::SigSpec value = signal_to_mux_tree(mod, swcache, swpara, cs2, sig, initial_val, ifxmode);
+			RTLIL::SigSpec value = initial_val;
+			if (next_assigning >= 0 && assigning_cases[next_assigning] == case_idx) {
+				value = signal_to_mux_tree(mod, swcache, swpara, cs2, sig, initial_val, ifxmode);
+				next_assigning--;
+			} else {
+				// cases that do not assign the snippet keep initial_val, skip all up to the
+				// next assigning case when none of them can change the result
+				int run_begin = next_assigning >= 0 ? assigning_cases[next_assigning] + 1 : 0;
+				bool default_is_initial = last_mux_cell && last_mux_cell->getPort(ID::A) == initial_val;
+				if ((default_is_initial && pgroups[run_begin] == pgroups[case_idx+1]) ||
+						(result == initial_val && (!last_mux_cell || default_is_initial))) {
+					case_idx = run_begin;
+					continue;
+				}
+			}
 			if (last_mux_cell && pgroups[case_idx] == pgroups[case_idx+1])
-				append_pmux(mod, sw->signal, cs2->compare, value, last_mux_cell, sw, cs2, ifxmode);
-			else
-				result = gen_mux(mod, sw->signal, cs2->compare, value, result, last_mux_cell, sw, cs2, ifxmode);
+				append_pmux(mod, swcache, value, last_mux_cell, pmux_s, pmux_b, sw, cs2, ifxmode);
+			else {
+				flush_pmux(last_mux_cell, pmux_s, pmux_b);
+				result = gen_mux(mod, swcache, cs2->compare, value, result, last_mux_cell, sw, cs2, ifxmode);
+			}
 		}
+		flush_pmux(last_mux_cell, pmux_s, pmux_b);
 	}
 
 	return result;
@@ -424,6 +494,10 @@ void proc_mux(RTLIL::Module *mod, RTLIL::Process *proc, bool ifxmode)
 
 	dict<RTLIL::SwitchRule*, bool, hash_ptr_ops> swpara;
 
+	// computed up front, signal_to_mux_tree() keeps references into pgroups_cache
+	for (auto &it : swcache.cache)
+		get_pgroups(swcache, swpara, it.first, ifxmode);
+
 	int cnt = 0;
 	for (int idx : sigsnip.snippets)
 	{
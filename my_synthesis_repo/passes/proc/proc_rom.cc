@@ -36,7 +36,9 @@ struct RomWorker
 
 	RomWorker(RTLIL::Module *mod) : module(mod), sigmap(mod) {}
 
-	void do_switch(RTLIL::SwitchRule *sw)
+	// Returns a new switch that holds the ROM read when only some of the assigned bits could
+	// be moved into the ROM. The caller adds it to the parent case next to sw.
+	RTLIL::SwitchRule *do_switch(RTLIL::SwitchRule *sw)
 	{
 		for (auto cs : sw->cases) {
 			do_case(cs);
@@ -44,31 +46,38 @@ struct RomWorker
 
 		if (sw->cases.empty()) {
 			log_debug("rejecting switch: no cases\n");
-			return;
+			return nullptr;
 		}
 
 		// A switch can be converted into ROM when:
 		//
 		// 1. No case contains a nested switch
-		// 2. All cases have the same set of assigned signals
-		// 3. All right-hand values in cases are constants
-		// 4. All compare values used in cases are fully-defined constants
+		// 2. Some signal bits are assigned in all cases
+		// 3. Those bits are assigned constants in all cases
+		// 4. All compare values used in cases are constants (don't-care bits are expanded)
 		// 5. The cases must cover all possible values (possibly by using default case)
+		//
+		// Bits that are not assigned in all cases or that are assigned non-constant values
+		// stay in the switch.
 
 		SigSpec lhs;
 		dict<SigBit, int> lhs_lookup;
-		for (auto &it: sw->cases[0]->actions) {
-			for (auto bit: it.first) {
-				if (!lhs_lookup.count(bit)) {
-					lhs_lookup[bit] = GetSize(lhs);
-					lhs.append(bit);
+		for (auto cs : sw->cases) {
+			for (auto &it: cs->actions) {
+				for (auto bit: it.first) {
+					if (!lhs_lookup.count(bit)) {
+						lhs_lookup[bit] = GetSize(lhs);
+						lhs.append(bit);
+					}
 				}
 			}
+			if (cs->compare.empty())
+				break;
 		}
 
 		if (lhs.empty()) {
 			log_debug("rejecting switch: lhs empty\n");
-			return;
+			return nullptr;
 		}
 
 		int swsigbits = 0;
@@ -76,141 +85,199 @@ struct RomWorker
 			if (sw->signal[i] != State::S0)
 				swsigbits = i + 1;
 
-		dict<int, Const> vals;
-		Const default_val;
-		bool got_default = false;
+		// the case values, and the case index for every address in the order of priority
+		std::vector<Const> case_vals;
+		dict<int, int> vals;
+		int default_idx = -1;
 		int maxaddr = 0;
+		std::vector<bool> rom_bit(GetSize(lhs), true);
 		for (auto cs : sw->cases) {
 			if (!cs->switches.empty()) {
 				log_debug("rejecting switch: has nested switches\n");
-				return;
+				return nullptr;
 			}
 			Const val = Const(State::Sm, GetSize(lhs));
 			for (auto &it: cs->actions) {
-				if (!it.second.is_fully_const()) {
-					log_debug("rejecting switch: rhs not const\n");
-					return;
-				}
 				for (int i = 0; i < GetSize(it.first); i++) {
-					auto it2 = lhs_lookup.find(it.first[i]);
-					if (it2 == lhs_lookup.end()) {
-						log_debug("rejecting switch: lhs not uniform\n");
-						return;
-					}
-					val[it2->second] = it.second[i].data;
-				}
-			}
-			for (auto bit: val.bits) {
-				if (bit == State::Sm) {
-					log_debug("rejecting switch: lhs not uniform\n");
-					return;
+					int idx = lhs_lookup.at(it.first[i]);
+					if (it.second[i].wire != nullptr)
+						rom_bit[idx] = false;
+					else
+						val.bits[idx] = it.second[i].data;
 				}
 			}
+			for (int i = 0; i < GetSize(lhs); i++)
+				if (val.bits[i] == State::Sm)
+					rom_bit[i] = false;
+
+			int case_idx = GetSize(case_vals);
+			case_vals.push_back(std::move(val));
 
 			for (auto &addr: cs->compare) {
-				if (!addr.is_fully_def()) {
-					log_debug("rejecting switch: case value has undef bits\n");
-					return;
+				int fixed = 0;
+				std::vector<int> free_bits;
+				bool matches = true;
+				for (int i = 0; i < GetSize(addr); i++) {
+					State bit = addr[i].wire ? State::Sx : addr[i].data;
+					if (bit == State::Sa) {
+						if (i < swsigbits)
+							free_bits.push_back(i);
+						continue;
+					}
+					if (bit != State::S0 && bit != State::S1) {
+						log_debug("rejecting switch: case value has undef bits\n");
+						return nullptr;
+					}
+					if (bit == State::S1) {
+						if (i >= swsigbits) {
+							matches = false;
+							break;
+						}
+						if (i >= 30) {
+							log_debug("rejecting switch: address too large\n");
+							return nullptr;
+						}
+						fixed |= 1 << i;
+					}
 				}
-				Const c = addr.as_const();
-				while (GetSize(c) && c.bits.back() == State::S0)
-					c.bits.pop_back();
-				if (GetSize(c) > swsigbits)
+				if (!matches)
 					continue;
-				if (GetSize(c) > 30) {
-					log_debug("rejecting switch: address too large\n");
-					return;
+				if (!free_bits.empty() && (free_bits.back() >= 30 || GetSize(vals) + (1 << GetSize(free_bits)) > (1 << 24))) {
+					log_debug("rejecting switch: too many don't-care bits\n");
+					return nullptr;
+				}
+				for (int k = 0; k < (1 << GetSize(free_bits)); k++) {
+					int a = fixed;
+					for (int j = 0; j < GetSize(free_bits); j++)
+						if (k & (1 << j))
+							a |= 1 << free_bits[j];
+					if (vals.count(a))
+						continue;
+					vals[a] = case_idx;
+					if (a > maxaddr)
+						maxaddr = a;
 				}
-				int a = c.as_int();
-				if (vals.count(a))
-					continue;
-				vals[a] = val;
-				if (a > maxaddr)
-					maxaddr = a;
 			}
 			if (cs->compare.empty()) {
-				default_val = val;
-				got_default = true;
+				default_idx = case_idx;
 				break;
 			}
 		}
 		int abits = ceil_log2(maxaddr + 1);
-		if (!got_default && (swsigbits > 30 || GetSize(vals) != (1 << swsigbits))) {
+		if (default_idx < 0 && (swsigbits > 30 || GetSize(vals) != (1 << swsigbits))) {
 			log_debug("rejecting switch: not all values are covered\n");
-			return;
+			return nullptr;
+		}
+
+		SigSpec rom_lhs;
+		std::vector<int> rom_idx;
+		for (int i = 0; i < GetSize(lhs); i++)
+			if (rom_bit[i]) {
+				rom_lhs.append(lhs[i]);
+				rom_idx.push_back(i);
+			}
+		if (rom_lhs.empty()) {
+			log_debug("rejecting switch: no bits with constant values in all cases\n");
+			return nullptr;
 		}
 
 		// TODO: better density heuristic?
 		if (GetSize(vals) < 8) {
 			log_debug("rejecting switch: not enough values\n");
-			return;
+			return nullptr;
 		}
 		if ((1 << abits) / GetSize(vals) > 4) {
 			log_debug("rejecting switch: not enough density\n");
-			return;
+			return nullptr;
 		}
 
 		// Ok, let's do it.
-		SigSpec rdata = module->addWire(NEW_ID, GetSize(lhs));
-		Mem mem(module, NEW_ID, GetSize(lhs), 0, 1 << abits);
+		int width = GetSize(rom_lhs);
+		std::vector<Const> rom_vals;
+		for (auto &val : case_vals) {
+			Const rom_val(State::Sx, width);
+			for (int i = 0; i < width; i++)
+				rom_val.bits[i] = val.bits[rom_idx[i]];
+			rom_vals.push_back(std::move(rom_val));
+		}
+		Const default_val = default_idx >= 0 ? rom_vals[default_idx] : Const(State::Sx, width);
+
+		SigSpec rdata = module->addWire(NEW_ID, width);
+		Mem mem(module, NEW_ID, width, 0, 1 << abits);
 		mem.attributes = sw->attributes;
 
-		Const init_data;
+		// filled in place, without building the entries one by one
+		Const init_data(State::Sx, mem.size * width);
 		for (int i = 0; i < mem.size; i++) {
 			auto it = vals.find(i);
-			if (it == vals.end()) {
-				log_assert(got_default);
-				for (auto bit: default_val.bits)
-					init_data.bits.push_back(bit);
-			} else {
-				for (auto bit: it->second.bits)
-					init_data.bits.push_back(bit);
-			}
+			if (it == vals.end())
+				log_assert(default_idx >= 0);
+			const Const &val = it == vals.end() ? default_val : rom_vals[it->second];
+			std::copy(val.bits.begin(), val.bits.end(), init_data.bits.begin() + i * width);
 		}
 
 		MemInit init;
 		init.addr = 0;
-		init.data = init_data;
-		init.en = Const(State::S1, GetSize(lhs));
+		init.data = std::move(init_data);
+		init.en = Const(State::S1, width);
 		mem.inits.push_back(std::move(init));
 
 		MemRd rd;
 		rd.addr = sw->signal.extract(0, abits);
 		rd.data = rdata;
-		rd.init_value = Const(State::Sx, GetSize(lhs));
-		rd.arst_value = Const(State::Sx, GetSize(lhs));
-		rd.srst_value = Const(State::Sx, GetSize(lhs));
+		rd.init_value = Const(State::Sx, width);
+		rd.arst_value = Const(State::Sx, width);
+		rd.srst_value = Const(State::Sx, width);
 		mem.rd_ports.push_back(std::move(rd));
 
 		mem.emit();
-		for (auto cs: sw->cases)
-			delete cs;
-		sw->cases.clear();
-		sw->signal = sw->signal.extract(0, swsigbits);
-		if (abits == GetSize(sw->signal)) {
-			sw->signal = SigSpec();
+
+		RTLIL::SwitchRule *rom_sw = sw;
+		if (width == GetSize(lhs)) {
+			for (auto cs: sw->cases)
+				delete cs;
+			sw->cases.clear();
+		} else {
+			pool<SigBit> rom_bits(rom_lhs.begin(), rom_lhs.end());
+			for (auto cs : sw->cases)
+				for (auto &it : cs->actions)
+					it.first.remove2(rom_bits, &it.second);
+			rom_sw = new RTLIL::SwitchRule;
+			rom_sw->signal = sw->signal;
+			rom_sw->attributes = sw->attributes;
+		}
+
+		rom_sw->signal = rom_sw->signal.extract(0, swsigbits);
+		if (abits == GetSize(rom_sw->signal)) {
+			rom_sw->signal = SigSpec();
 			RTLIL::CaseRule *cs = new RTLIL::CaseRule;
-			cs->actions.push_back(SigSig(lhs, rdata));
-			sw->cases.push_back(cs);
+			cs->actions.push_back(SigSig(rom_lhs, rdata));
+			rom_sw->cases.push_back(cs);
 		} else {
-			sw->signal = sw->signal.extract_end(abits);
+			rom_sw->signal = rom_sw->signal.extract_end(abits);
 			RTLIL::CaseRule *cs = new RTLIL::CaseRule;
-			cs->compare.push_back(Const(State::S0, GetSize(sw->signal)));
-			cs->actions.push_back(SigSig(lhs, rdata));
-			sw->cases.push_back(cs);
+			cs->compare.push_back(Const(State::S0, GetSize(rom_sw->signal)));
+			cs->actions.push_back(SigSig(rom_lhs, rdata));
+			rom_sw->cases.push_back(cs);
 			RTLIL::CaseRule *cs2 = new RTLIL::CaseRule;
-			cs2->actions.push_back(SigSig(lhs, default_val));
-			sw->cases.push_back(cs2);
+			cs2->actions.push_back(SigSig(rom_lhs, default_val));
+			rom_sw->cases.push_back(cs2);
 		}
 
 		count += 1;
+		return rom_sw != sw ? rom_sw : nullptr;
 	}
 
 	void do_case(RTLIL::CaseRule *cs)
 	{
+		std::vector<RTLIL::SwitchRule*> new_switches;
 		for (auto sw: cs->switches) {
-			do_switch(sw);
+			new_switches.push_back(sw);
+			RTLIL::SwitchRule *rom_sw = do_switch(sw);
+			if (rom_sw != nullptr)
+				new_switches.push_back(rom_sw);
 		}
+		cs->switches.swap(new_switches);
 	}
 
 	void do_process(RTLIL::Process *pr)
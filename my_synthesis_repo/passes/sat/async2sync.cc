@@ -66,12 +66,33 @@ struct Async2syncPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			// Find the cells to convert first. FfView decodes FFs without allocating, so the
+			// synchronous FFs that are left alone are not copied into FfData, and modules
+			// without any work are not indexed at all.
+			vector<Cell*> work_cells;
+			for (auto cell : module->selected_cells()) {
+				if (cell->type.in(ID($print), ID($check))) {
+					work_cells.push_back(cell);
+					continue;
+				}
+				if (!RTLIL::builtin_ff_cell_types().count(cell->type))
+					continue;
+				FfView view(cell);
+				if (view.has_gclk)
+					continue;
+				if (view.has_clk && !view.sig_clk().is_fully_const() && !view.has_sr && !view.has_aload && !view.has_arst)
+					continue;
+				work_cells.push_back(cell);
+			}
+			if (work_cells.empty())
+				continue;
+
 			SigMap sigmap(module);
 			FfInitVals initvals(&sigmap, module);
 
 			SigBit initstate;
 
-			for (auto cell : vector<Cell*>(module->selected_cells()))
+			for (auto cell : work_cells)
 			{
 				if (cell->type.in(ID($print), ID($check)))
 				{
@@ -123,15 +144,8 @@ struct Async2syncPass : public Pass {
 					continue;
 				}
 
-				if (!RTLIL::builtin_ff_cell_types().count(cell->type))
-					continue;
-
 				FfData ff(&initvals, cell);
 
-				// Skip for $_FF_ and $ff cells.
-				if (ff.has_gclk)
-					continue;
-
 				if (ff.has_clk && ff.sig_clk.is_fully_const())
 					ff.has_ce = ff.has_clk = ff.has_srst = false;
 
@@ -139,9 +139,44 @@ struct Clk2fflogicPass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			// Find the cells to convert first, with FfView so that FFs on the global clock are
+			// skipped without decoding them, and modules without any work are not indexed at all.
+			vector<Cell*> work_cells;
+			bool has_mem = !module->memories.empty();
+			for (auto cell : module->selected_cells()) {
+				if (cell->type.in(ID($print), ID($check)))
+					work_cells.push_back(cell);
+				else if (RTLIL::builtin_ff_cell_types().count(cell->type)) {
+					if (!FfView(cell).has_gclk)
+						work_cells.push_back(cell);
+				} else if (cell->is_mem_cell())
+					has_mem = true;
+			}
+			if (work_cells.empty() && !has_mem)
+				continue;
+
 			SigMap sigmap(module);
 			FfInitVals initvals(&sigmap, module);
 
+			// FFs in the same clock domain (or with the same async control) share one edge
+			// detector (or one sampled control signal) instead of getting their own.
+			dict<std::tuple<SigSpec, bool, bool>, SigSpec> edge_cache;
+			dict<std::tuple<SigSpec, bool, bool>, SampledSig> control_cache;
+			auto shared_control_edge = [&](SigSpec sig, bool polarity, bool is_fine) {
+				auto key = std::make_tuple(sigmap(sig), polarity, is_fine);
+				auto it = edge_cache.find(key);
+				if (it == edge_cache.end())
+					it = edge_cache.emplace(key, sample_control_edge(module, sig, polarity, is_fine)).first;
+				return it->second;
+			};
+			auto shared_control = [&](SigSpec sig, bool polarity, bool is_fine) {
+				auto key = std::make_tuple(sigmap(sig), polarity, is_fine);
+				auto it = control_cache.find(key);
+				if (it == control_cache.end())
+					it = control_cache.emplace(key, sample_control(module, sig, polarity, is_fine)).first;
+				return it->second;
+			};
+
 			for (auto &mem : Mem::get_selected_memories(module))
 			{
 				for (int i = 0; i < GetSize(mem.rd_ports); i++) {
@@ -201,7 +236,7 @@ struct Clk2fflogicPass : public Pass {
 
 			SigBit initstate;
 
-			for (auto cell : vector<Cell*>(module->selected_cells()))
+			for (auto cell : work_cells)
 			{
 				if (cell->type.in(ID($print), ID($check)))
 				{
@@ -229,7 +264,7 @@ struct Clk2fflogicPass : public Pass {
 						SigSpec sig_trg_sampled;
 
 						for (auto const &bit : sig_trg)
-							sig_trg_sampled.append(sample_control_edge(module, bit, trg_polarity[GetSize(sig_trg_sampled)] == State::S1, false));
+							sig_trg_sampled.append(shared_control_edge(bit, trg_polarity[GetSize(sig_trg_sampled)] == State::S1, false));
 						SigSpec sig_args_sampled = sample_data(module, sig_args, Const(State::S0, GetSize(sig_args)), false, false).sampled;
 						SigBit sig_en_sampled = sample_data(module, sig_en, State::S0, false, false).sampled;
 
@@ -254,16 +289,8 @@ struct Clk2fflogicPass : public Pass {
 					continue;
 				}
 
-				if (!RTLIL::builtin_ff_cell_types().count(cell->type))
-					continue;
-
 				FfData ff(&initvals, cell);
 
-				if (ff.has_gclk) {
-					// Already a $ff or $_FF_ cell.
-					continue;
-				}
-
 				if (ff.has_clk) {
 					log("Replacing %s.%s (%s): CLK=%s, D=%s, Q=%s\n",
 							log_id(module), log_id(cell), log_id(cell->type),
@@ -289,7 +316,7 @@ struct Clk2fflogicPass : public Pass {
 				if (ff.has_clk) {
 					// The init value for the sampled d is never used, so we can set it to fixed zero, reducing uninit'd FFs
 					auto sampled_d = sample_data(module, ff.sig_d, RTLIL::Const(State::S0, ff.width), ff.is_fine);
-					auto clk_edge = sample_control_edge(module, ff.sig_clk, ff.pol_clk, ff.is_fine);
+					auto clk_edge = shared_control_edge(ff.sig_clk, ff.pol_clk, ff.is_fine);
 					next_q = mux(module, next_q, sampled_d.sampled, clk_edge, ff.is_fine);
 				}
 
@@ -299,16 +326,16 @@ struct Clk2fflogicPass : public Pass {
 				// generating a lot of extra logic.
 				bool has_nonconst_aload = ff.has_aload && ff.sig_aload != (ff.pol_aload ? State::S0 : State::S1);
 				if (has_nonconst_aload) {
-					sampled_aload = sample_control(module, ff.sig_aload, ff.pol_aload, ff.is_fine);
+					sampled_aload = shared_control(ff.sig_aload, ff.pol_aload, ff.is_fine);
 					// The init value for the sampled ad is never used, so we can set it to fixed zero, reducing uninit'd FFs
 					sampled_ad = sample_data(module, ff.sig_ad, RTLIL::Const(State::S0, ff.width), ff.is_fine);
 				}
 				if (ff.has_sr) {
-					sampled_set = sample_control(module, ff.sig_set, ff.pol_set, ff.is_fine);
-					sampled_clr = sample_control(module, ff.sig_clr, ff.pol_clr, ff.is_fine);
+					sampled_set = shared_control(ff.sig_set, ff.pol_set, ff.is_fine);
+					sampled_clr = shared_control(ff.sig_clr, ff.pol_clr, ff.is_fine);
 				}
 				if (ff.has_arst)
-					sampled_arst = sample_control(module, ff.sig_arst, ff.pol_arst, ff.is_fine);
+					sampled_arst = shared_control(ff.sig_arst, ff.pol_arst, ff.is_fine);
 
 				// First perform updates using _only_ sampled values, then again using _only_ current values. Unlike the previous
 				// implementation, this approach correctly handles all the cases of multiple signals changing simultaneously.
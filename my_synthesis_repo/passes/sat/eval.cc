@@ -522,6 +522,11 @@ struct EvalPass : public Pass {
 			tab.push_back(tab_line);
 			tab_line.clear();
 
+			// the cone is evaluated for all table rows, ConstEval is only
+			// used for rows that the cone can not evaluate on its own
+			ConstEvalCone cone(ce, tabsigs, signal);
+			RTLIL::Const cone_value;
+
 			RTLIL::Const tabvals(0, tabsigs.size());
 			do
 			{
@@ -530,7 +535,10 @@ struct EvalPass : public Pass {
 				value = signal;
 
 				RTLIL::SigSpec this_undef;
-				while (!ce.eval(value, this_undef)) {
+				bool cone_done = cone.eval(tabvals, cone_value);
+				if (cone_done)
+					value = cone_value;
+				while (!cone_done && !ce.eval(value, this_undef)) {
 					if (!set_undef) {
 						log("Failed to evaluate signal %s at %s = %s: Missing value for %s.\n", log_signal(signal),
 								log_signal(tabsigs), log_signal(tabvals), log_signal(this_undef));
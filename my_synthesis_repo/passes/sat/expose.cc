@@ -76,13 +76,12 @@ bool compare_cells(RTLIL::Cell *cell1, RTLIL::Cell *cell2)
 	return true;
 }
 
-void find_dff_wires(std::set<RTLIL::IdString> &dff_wires, RTLIL::Module *module)
+void find_dff_wires(std::set<RTLIL::IdString> &dff_wires, RTLIL::Module *module, const SigMap &sigmap)
 {
 	CellTypes ct;
 	ct.setup_internals_mem();
 	ct.setup_stdcells_mem();
 
-	SigMap sigmap(module);
 	SigPool dffsignals;
 
 	for (auto cell : module->cells()) {
@@ -366,7 +365,7 @@ struct ExposePass : public Pass {
 			{
 				std::set<RTLIL::IdString> dff_wires;
 				if (flag_dff)
-					find_dff_wires(dff_wires, module);
+					find_dff_wires(dff_wires, module, SigMap(module));
 
 				if (first_module == NULL)
 				{
@@ -441,11 +440,12 @@ struct ExposePass : public Pass {
 
 		for (auto module : design->selected_modules())
 		{
+			// one SigMap per module, also used to find the FF outputs
+			SigMap sigmap(module);
+
 			std::set<RTLIL::IdString> dff_wires;
 			if (flag_dff && !flag_shared)
-				find_dff_wires(dff_wires, module);
-
-			SigMap sigmap(module);
+				find_dff_wires(dff_wires, module, sigmap);
 
 			SigMap out_to_in_map;
 
@@ -502,6 +502,7 @@ struct ExposePass : public Pass {
 
 				for (auto &conn : module->connections_)
 					conn.first = out_to_in_map(conn.first);
+				module->notify_blackout();
 			}
 
 			if (flag_cut)
@@ -523,6 +524,7 @@ struct ExposePass : public Pass {
 
 				for (auto &conn : module->connections_)
 					conn.second = out_to_in_map(sigmap(conn.second));
+				module->notify_blackout();
 			}
 
 			std::set<RTLIL::SigBit> set_q_bits;
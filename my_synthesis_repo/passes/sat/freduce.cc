@@ -33,7 +33,7 @@ USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 bool inv_mode;
-int verbose_level, reduce_counter, reduce_stop_at;
+int verbose_level, reduce_counter, reduce_stop_at, sim_words;
 typedef std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>>> drivers_t;
 std::string dump_prefix;
 
@@ -241,6 +241,9 @@ struct PerformReduction
 	std::vector<int> out_depth;
 	int cone_size;
 
+	// input assignments of the models that shattered a bucket, used to refine outstanding buckets
+	std::vector<dict<RTLIL::SigBit, bool>> *counter_examples = nullptr;
+
 	int register_cone_worker(std::set<RTLIL::Cell*> &celldone, std::map<RTLIL::SigBit, int> &sigdepth, RTLIL::SigBit out)
 	{
 		if (out.wire == NULL)
@@ -375,7 +378,7 @@ struct PerformReduction
 		std::vector<bool> model;
 
 		modelVars.insert(modelVars.end(), sat_def.begin(), sat_def.end());
-		if (verbose_level >= 2)
+		if (verbose_level >= 2 || counter_examples != nullptr)
 			modelVars.insert(modelVars.end(), sat_pi.begin(), sat_pi.end());
 
 		if (ez->solve(modelVars, model, ez->expression(ezSAT::OpOr, sat_set_list), ez->expression(ezSAT::OpOr, sat_clr_list)))
@@ -402,6 +405,13 @@ struct PerformReduction
 				iter_count++;
 			}
 
+			if (counter_examples != nullptr) {
+				dict<RTLIL::SigBit, bool> cex;
+				for (size_t i = 0; i < pi_bits.size(); i++)
+					cex[pi_bits[i]] = model[2*sat_out.size() + i];
+				counter_examples->push_back(cex);
+			}
+
 			if (verbose_level >= 1) {
 				int count_set = 0, count_clr = 0, count_undef = 0;
 				for (int idx : bucket)
@@ -560,6 +570,259 @@ struct PerformReduction
 	}
 };
 
+struct SimulateCones
+{
+	SigMap &sigmap;
+	drivers_t &drivers;
+	CellTypes ct;
+
+	uint64_t rng_state;
+	const std::vector<dict<RTLIL::SigBit, bool>> *patterns;
+	dict<RTLIL::SigBit, uint64_t> values;
+	pool<RTLIL::SigBit> unknown_bits;
+	pool<RTLIL::SigBit> recursion_guard;
+
+	SimulateCones(SigMap &sigmap, drivers_t &drivers) : sigmap(sigmap), drivers(drivers), rng_state(88172645463325252ULL), patterns(nullptr)
+	{
+		ct.setup_internals();
+		ct.setup_stdcells();
+	}
+
+	uint64_t rng()
+	{
+		rng_state ^= rng_state << 13;
+		rng_state ^= rng_state >> 7;
+		rng_state ^= rng_state << 17;
+		return rng_state;
+	}
+
+	// Start a new round of 64 parallel simulations. Lane i uses the input values
+	// from round_patterns[i] where given and random values everywhere else.
+	void new_round(const std::vector<dict<RTLIL::SigBit, bool>> *round_patterns = nullptr)
+	{
+		log_assert(round_patterns == nullptr || GetSize(*round_patterns) <= 64);
+		values.clear();
+		patterns = round_patterns;
+	}
+
+	void mark_unknown(RTLIL::Cell *cell)
+	{
+		for (auto &port : cell->connections())
+			if (ct.cell_output(cell->type, port.first))
+				for (auto bit : sigmap(port.second))
+					unknown_bits.insert(bit);
+	}
+
+	void eval_cell(RTLIL::Cell *cell)
+	{
+		if (!cell->type.begins_with("$_") || cell->type == ID($_TBUF_))
+		{
+			for (auto &port : cell->connections())
+				if (!port.first.in(ID::A, ID::B, ID::S, ID::Y)) {
+					mark_unknown(cell);
+					return;
+				}
+			if (!cell->hasPort(ID::Y)) {
+				mark_unknown(cell);
+				return;
+			}
+
+			// word-level cells are evaluated one lane at a time
+			dict<RTLIL::IdString, std::vector<uint64_t>> inputs;
+			for (auto &port : cell->connections()) {
+				if (port.first == ID::Y)
+					continue;
+				for (auto bit : sigmap(port.second)) {
+					uint64_t value = 0;
+					if (!eval(bit, value)) {
+						mark_unknown(cell);
+						return;
+					}
+					inputs[port.first].push_back(value);
+				}
+			}
+
+			auto lane_const = [&](RTLIL::IdString port, int lane) {
+				RTLIL::Const value;
+				if (inputs.count(port))
+					for (auto word : inputs.at(port))
+						value.bits.push_back((word >> lane) & 1 ? State::S1 : State::S0);
+				return value;
+			};
+
+			RTLIL::SigSpec sig_y = sigmap(cell->getPort(ID::Y));
+			std::vector<uint64_t> result(GetSize(sig_y));
+
+			for (int lane = 0; lane < 64; lane++)
+			{
+				bool err = false;
+				RTLIL::Const a = lane_const(ID::A, lane), b = lane_const(ID::B, lane), s = lane_const(ID::S, lane);
+				RTLIL::Const y;
+				if (cell->type.in(ID($bmux), ID($demux)))
+					y = CellTypes::eval(cell, a, s, &err);
+				else if (cell->hasPort(ID::S))
+					y = CellTypes::eval(cell, a, b, s, &err);
+				else
+					y = CellTypes::eval(cell, a, b, &err);
+
+				if (err || GetSize(y) != GetSize(sig_y)) {
+					mark_unknown(cell);
+					return;
+				}
+				for (int i = 0; i < GetSize(sig_y); i++) {
+					if (y.bits[i] == State::S1)
+						result[i] |= uint64_t(1) << lane;
+					else if (y.bits[i] != State::S0) {
+						mark_unknown(cell);
+						return;
+					}
+				}
+			}
+
+			for (int i = 0; i < GetSize(sig_y); i++)
+				if (sig_y[i].wire != NULL)
+					values[sig_y[i]] = result[i];
+			return;
+		}
+
+		bool ok = true;
+		auto input = [&](RTLIL::IdString port) {
+			uint64_t value = 0;
+			if (!eval(sigmap(cell->getPort(port)).as_bit(), value))
+				ok = false;
+			return value;
+		};
+
+		uint64_t y = 0;
+
+		if (cell->type.in(ID($_MUX4_), ID($_MUX8_), ID($_MUX16_)))
+		{
+			int sel_count = cell->type == ID($_MUX4_) ? 2 : cell->type == ID($_MUX8_) ? 3 : 4;
+			std::vector<uint64_t> data;
+			for (int i = 0; i < (1 << sel_count); i++)
+				data.push_back(input(RTLIL::IdString(stringf("\\%c", 'A' + i))));
+			for (int i = 0; i < sel_count; i++) {
+				uint64_t sel = input(RTLIL::IdString(stringf("\\%c", 'S' + i)));
+				for (int j = 0; j < GetSize(data) / 2; j++)
+					data[j] = (data[2*j] & ~sel) | (data[2*j+1] & sel);
+				data.resize(GetSize(data) / 2);
+			}
+			y = data.front();
+		}
+		else if (cell->type.in(ID($_MUX_), ID($_NMUX_)))
+		{
+			uint64_t a = input(ID::A), b = input(ID::B), sel = input(ID::S);
+			y = (a & ~sel) | (b & sel);
+			if (cell->type == ID($_NMUX_))
+				y = ~y;
+		}
+		else if (cell->type.in(ID($_AOI3_), ID($_OAI3_), ID($_AOI4_), ID($_OAI4_)))
+		{
+			uint64_t a = input(ID::A), b = input(ID::B), c = input(ID::C);
+			uint64_t d = cell->hasPort(ID::D) ? input(ID::D) : 0;
+			if (cell->type == ID($_AOI3_))
+				y = ~((a & b) | c);
+			else if (cell->type == ID($_OAI3_))
+				y = ~((a | b) & c);
+			else if (cell->type == ID($_AOI4_))
+				y = ~((a & b) | (c & d));
+			else
+				y = ~((a | b) & (c | d));
+		}
+		else if (cell->type.in(ID($_BUF_), ID($_NOT_)))
+		{
+			y = input(ID::A);
+			if (cell->type == ID($_NOT_))
+				y = ~y;
+		}
+		else if (cell->type.in(ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_), ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_)))
+		{
+			uint64_t a = input(ID::A), b = input(ID::B);
+			if (cell->type.in(ID($_AND_), ID($_NAND_)))
+				y = a & b;
+			else if (cell->type.in(ID($_OR_), ID($_NOR_)))
+				y = a | b;
+			else if (cell->type.in(ID($_XOR_), ID($_XNOR_)))
+				y = a ^ b;
+			else if (cell->type == ID($_ANDNOT_))
+				y = a & ~b;
+			else
+				y = a | ~b;
+			if (cell->type.in(ID($_NAND_), ID($_NOR_), ID($_XNOR_)))
+				y = ~y;
+		}
+		else
+			ok = false;
+
+		if (!ok) {
+			mark_unknown(cell);
+			return;
+		}
+
+		RTLIL::SigBit bit_y = sigmap(cell->getPort(ID::Y)).as_bit();
+		if (bit_y.wire != NULL)
+			values[bit_y] = y;
+	}
+
+	// Returns false for signals that depend on undef constants or on cells
+	// that can not be simulated. Those are never split by simulation.
+	bool eval(RTLIL::SigBit bit, uint64_t &value)
+	{
+		if (bit.wire == NULL) {
+			if (bit.data != State::S0 && bit.data != State::S1)
+				return false;
+			value = bit.data == State::S1 ? ~uint64_t(0) : 0;
+			return true;
+		}
+
+		if (unknown_bits.count(bit))
+			return false;
+
+		auto it = values.find(bit);
+		if (it != values.end()) {
+			value = it->second;
+			return true;
+		}
+
+		if (drivers.count(bit) == 0) {
+			value = rng();
+			if (patterns != nullptr)
+				for (int i = 0; i < GetSize(*patterns); i++) {
+					auto p = patterns->at(i).find(bit);
+					if (p == patterns->at(i).end())
+						continue;
+					if (p->second)
+						value |= uint64_t(1) << i;
+					else
+						value &= ~(uint64_t(1) << i);
+				}
+			values[bit] = value;
+			return true;
+		}
+
+		// logic loops are reported by PerformReduction
+		if (recursion_guard.count(bit)) {
+			unknown_bits.insert(bit);
+			return false;
+		}
+
+		recursion_guard.insert(bit);
+		eval_cell(drivers.at(bit).first);
+		recursion_guard.erase(bit);
+
+		it = values.find(bit);
+		if (unknown_bits.count(bit) || it == values.end()) {
+			unknown_bits.insert(bit);
+			return false;
+		}
+
+		value = it->second;
+		return true;
+	}
+};
+
+typedef std::pair<int, std::vector<RTLIL::SigBit>> freduce_job_t;
+
 struct FreduceWorker
 {
 	RTLIL::Design *design;
@@ -598,6 +861,41 @@ struct FreduceWorker
 		return find_bit_in_cone(celldone, needle, haystack);
 	}
 
+	void simulate(SimulateCones &sim, const std::vector<RTLIL::SigBit> &bits, dict<RTLIL::SigBit, bool> &sim_inverted,
+			dict<RTLIL::SigBit, std::vector<uint64_t>> &signatures)
+	{
+		for (auto bit : bits) {
+			uint64_t value = 0;
+			if (!sim.eval(bit, value)) {
+				signatures.erase(bit);
+				continue;
+			}
+			// in -inv mode the signatures are normalized to lane 0 of the first round
+			if (inv_mode && !sim_inverted.count(bit))
+				sim_inverted[bit] = (value & 1) != 0;
+			if (sim_inverted.count(bit) && sim_inverted.at(bit))
+				value = ~value;
+			signatures[bit].push_back(value);
+		}
+	}
+
+	void split_job(const freduce_job_t &job, const dict<RTLIL::SigBit, std::vector<uint64_t>> &signatures, std::vector<freduce_job_t> &jobs)
+	{
+		for (auto bit : job.second)
+			if (signatures.count(bit) == 0) {
+				jobs.push_back(job);
+				return;
+			}
+
+		std::map<std::vector<uint64_t>, std::vector<RTLIL::SigBit>> classes;
+		for (auto bit : job.second)
+			classes[signatures.at(bit)].push_back(bit);
+
+		for (auto &it : classes)
+			if (GetSize(it.second) > 1)
+				jobs.push_back(freduce_job_t(job.first, it.second));
+	}
+
 	void dump()
 	{
 		std::string filename = stringf("%s_%s_%05d.il", dump_prefix.c_str(), RTLIL::id2cstr(module->name), reduce_counter);
@@ -657,6 +955,7 @@ struct FreduceWorker
 
 			FindReducedInputs infinder(sigmap, drivers);
 			for (auto &bit : batch) {
+				log_check_interrupt("freduce input cones", bits_full_count, bits_full_total);
 				std::vector<RTLIL::SigBit> inputs;
 				infinder.analyze(inputs, bit, 100 * bits_full_count / bits_full_total);
 				buckets[inputs].push_back(bit);
@@ -666,24 +965,88 @@ struct FreduceWorker
 		}
 		log("  Sorted %d signal bits into %d buckets.\n", bits_count, int(buckets.size()));
 
-		int bucket_count = 0;
-		std::vector<std::vector<equiv_bit_t>> equiv;
-		for (auto &bucket : buckets)
+		// Bit-parallel random simulation splits the buckets into candidate classes
+		// first, so that SAT only needs to confirm the survivors.
+		std::vector<freduce_job_t> jobs;
+		SimulateCones sim(sigmap, drivers);
+		dict<RTLIL::SigBit, bool> sim_inverted;
+		std::vector<dict<RTLIL::SigBit, bool>> counter_examples;
+
+		if (sim_words > 0)
 		{
-			bucket_count++;
+			std::vector<RTLIL::SigBit> sim_bits;
+			for (auto &bucket : buckets)
+				if (bucket.second.size() > 1 && bucket.first.size() > 0)
+					sim_bits.insert(sim_bits.end(), bucket.second.begin(), bucket.second.end());
+
+			dict<RTLIL::SigBit, std::vector<uint64_t>> signatures;
+			for (int i = 0; i < sim_words; i++) {
+				sim.new_round();
+				simulate(sim, sim_bits, sim_inverted, signatures);
+			}
 
-			if (bucket.second.size() == 1)
-				continue;
+			int candidate_count = 0;
+			for (auto &bucket : buckets)
+				if (bucket.second.size() > 1 && bucket.first.size() > 0)
+					split_job(freduce_job_t(bucket.first.size(), bucket.second), signatures, jobs);
+			for (auto &job : jobs)
+				candidate_count += GetSize(job.second);
+			log("  Simulated %d patterns: %d of %d signal bits remain in %d candidate classes.\n",
+					64*sim_words, candidate_count, GetSize(sim_bits), GetSize(jobs));
+		}
+
+		for (auto &bucket : buckets)
+			if (bucket.second.size() > 1 && (bucket.first.size() == 0 || sim_words == 0))
+				jobs.push_back(freduce_job_t(bucket.first.size(), bucket.second));
 
-			if (bucket.first.size() == 0) {
-				log("  Finding const values for bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				for (size_t idx = 0; idx < bucket.second.size(); idx++)
+		int job_count = 0;
+		std::vector<std::vector<equiv_bit_t>> equiv;
+		for (size_t job_idx = 0; job_idx < jobs.size(); job_idx++)
+		{
+			const freduce_job_t job = jobs[job_idx];
+			job_count++;
+			log_check_interrupt("freduce buckets", job_count, job_count + GetSize(jobs) - int(job_idx) - 1);
+
+			if (job.first == 0) {
+				log("  Finding const values for bucket %s%c\n", log_signal(job.second), verbose_level ? ':' : '.');
+				PerformReduction worker(sigmap, drivers, inv_pairs, jobs[job_idx].second, job.first);
+				for (size_t idx = 0; idx < job.second.size(); idx++)
 					worker.analyze_const(equiv, idx);
-			} else {
-				log("  Trying to shatter bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
-				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1));
+				continue;
+			}
+
+			log("  Trying to shatter bucket %s%c\n", log_signal(job.second), verbose_level ? ':' : '.');
+			PerformReduction worker(sigmap, drivers, inv_pairs, jobs[job_idx].second, job.first);
+			if (sim_words > 0)
+				worker.counter_examples = &counter_examples;
+			worker.analyze(equiv, 100 * job_count / (job_count + GetSize(jobs) - int(job_idx)));
+
+			// refine the outstanding candidate classes with the SAT counter-examples
+			if (GetSize(counter_examples) >= 64)
+			{
+				std::vector<RTLIL::SigBit> sim_bits;
+				for (size_t i = job_idx+1; i < jobs.size(); i++)
+					if (jobs[i].first > 0)
+						sim_bits.insert(sim_bits.end(), jobs[i].second.begin(), jobs[i].second.end());
+
+				std::vector<dict<RTLIL::SigBit, bool>> patterns(counter_examples.begin(), counter_examples.begin() + 64);
+				counter_examples.erase(counter_examples.begin(), counter_examples.begin() + 64);
+
+				dict<RTLIL::SigBit, std::vector<uint64_t>> signatures;
+				sim.new_round(&patterns);
+				simulate(sim, sim_bits, sim_inverted, signatures);
+
+				std::vector<freduce_job_t> refined_jobs(jobs.begin(), jobs.begin() + job_idx + 1);
+				for (size_t i = job_idx+1; i < jobs.size(); i++)
+					if (jobs[i].first > 0)
+						split_job(jobs[i], signatures, refined_jobs);
+					else
+						refined_jobs.push_back(jobs[i]);
+
+				if (verbose_level >= 1)
+					log("  Refined %d outstanding candidate classes into %d using 64 counter-examples.\n",
+							GetSize(jobs) - int(job_idx) - 1, GetSize(refined_jobs) - int(job_idx) - 1);
+				jobs.swap(refined_jobs);
 			}
 		}
 
@@ -725,6 +1088,8 @@ struct FreduceWorker
 				for (auto &port : drv->connections_)
 					if (ct.cell_output(drv->type, port.first))
 						sigmap(port.second).replace(grp[i].bit, dummy_wire, &port.second);
+				// the driver's output ports were rewired in place
+				module->notify_blackout();
 
 				if (grp[i].inverted)
 				{
@@ -781,6 +1146,13 @@ struct FreducePass : public Pass {
 		log("        stop after <n> reduction operations. this is mostly used for\n");
 		log("        debugging the freduce command itself.\n");
 		log("\n");
+		log("    -sim <words>\n");
+		log("        number of 64 bit words of random input patterns that are simulated\n");
+		log("        before SAT is used. signals that are distinguished by simulation are\n");
+		log("        never passed to the SAT solver, and the counter-examples found by\n");
+		log("        SAT are simulated to refine the remaining candidates. default is 4\n");
+		log("        (256 patterns), 0 disables the simulation.\n");
+		log("\n");
 		log("    -dump <prefix>\n");
 		log("        dump the design to <prefix>_<module>_<num>.il after each reduction\n");
 		log("        operation. this is mostly used for debugging the freduce command.\n");
@@ -798,6 +1170,7 @@ struct FreducePass : public Pass {
 		reduce_stop_at = 0;
 		verbose_level = 0;
 		inv_mode = false;
+		sim_words = 4;
 		dump_prefix = std::string();
 
 		log_header(design, "Executing FREDUCE pass (perform functional reduction).\n");
@@ -820,6 +1193,12 @@ struct FreducePass : public Pass {
 				reduce_stop_at = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-sim" && argidx+1 < args.size()) {
+				sim_words = atoi(args[++argidx].c_str());
+				if (sim_words < 0)
+					log_cmd_error("Invalid value for -sim: %d\n", sim_words);
+				continue;
+			}
 			if (args[argidx] == "-dump" && argidx+1 < args.size()) {
 				dump_prefix = args[++argidx];
 				continue;
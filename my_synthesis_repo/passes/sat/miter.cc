@@ -24,6 +24,21 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// One 1-bit $eqx cell per bit, setting sig_y[i] if sig_a[i] is x. All cells are
+// created in one go, so that wide ports don't pay for a name and a lookup per bit.
+static void add_bit_eqx_cells(RTLIL::Module *module, const RTLIL::SigSpec &sig_a, const RTLIL::SigSpec &sig_y)
+{
+	std::vector<RTLIL::Cell*> cells = module->addCells(NEW_ID_PREFIX, ID($eqx), GetSize(sig_a),
+			{{ID::A, sig_a}, {ID::B, RTLIL::SigSpec(RTLIL::State::Sx)}, {ID::Y, sig_y}});
+	for (auto cell : cells) {
+		cell->parameters[ID::A_WIDTH] = 1;
+		cell->parameters[ID::B_WIDTH] = 1;
+		cell->parameters[ID::Y_WIDTH] = 1;
+		cell->parameters[ID::A_SIGNED] = 0;
+		cell->parameters[ID::B_SIGNED] = 0;
+	}
+}
+
 void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL::Design *design)
 {
 	bool flag_ignore_gold_x = false;
@@ -148,8 +163,7 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 			gold_cell->setPort(gold_wire->name, w);
 			if (flag_ignore_gold_x) {
 				RTLIL::SigSpec w_x = miter_module->addWire(NEW_ID, GetSize(w));
-				for (int i = 0; i < GetSize(w); i++)
-					miter_module->addEqx(NEW_ID, w[i], State::Sx, w_x[i]);
+				add_bit_eqx_cells(miter_module, w, w_x);
 				RTLIL::SigSpec w_any = miter_module->And(NEW_ID, miter_module->Anyseq(NEW_ID, GetSize(w)), w_x);
 				RTLIL::SigSpec w_masked = miter_module->And(NEW_ID, w, miter_module->Not(NEW_ID, w_x));
 				w = miter_module->And(NEW_ID, w_any, w_masked);
@@ -183,17 +197,7 @@ void create_miter_equiv(struct Pass *that, std::vector<std::string> args, RTLIL:
 			if (flag_ignore_gold_x)
 			{
 				RTLIL::SigSpec gold_x = miter_module->addWire(NEW_ID, w_gold->width);
-				for (int i = 0; i < w_gold->width; i++) {
-					RTLIL::Cell *eqx_cell = miter_module->addCell(NEW_ID, ID($eqx));
-					eqx_cell->parameters[ID::A_WIDTH] = 1;
-					eqx_cell->parameters[ID::B_WIDTH] = 1;
-					eqx_cell->parameters[ID::Y_WIDTH] = 1;
-					eqx_cell->parameters[ID::A_SIGNED] = 0;
-					eqx_cell->parameters[ID::B_SIGNED] = 0;
-					eqx_cell->setPort(ID::A, RTLIL::SigSpec(w_gold, i));
-					eqx_cell->setPort(ID::B, RTLIL::State::Sx);
-					eqx_cell->setPort(ID::Y, gold_x.extract(i, 1));
-				}
+				add_bit_eqx_cells(miter_module, w_gold, gold_x);
 
 				RTLIL::SigSpec gold_masked = miter_module->addWire(NEW_ID, w_gold->width);
 				RTLIL::SigSpec gate_masked = miter_module->addWire(NEW_ID, w_gate->width);
@@ -19,6 +19,9 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+#include "kernel/satgen.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -726,6 +729,408 @@ void mutate_cnot(Design *design, const mutate_opts_t &opts, bool one)
 	cell->setPort(opts.port, s);
 }
 
+bool mutate_parse_cmd(const string &line, mutate_t &entry)
+{
+	std::vector<string> tokens = split_tokens(line);
+
+	if (tokens.empty() || tokens[0] != "mutate")
+		return false;
+
+	for (size_t i = 1; i < tokens.size(); i++)
+	{
+		bool has_arg = i+1 < tokens.size();
+		if (tokens[i] == "-ctrl" && i+3 < tokens.size()) {
+			i += 3;
+			continue;
+		}
+		if (tokens[i] == "-mode" && has_arg) {
+			entry.mode = tokens[++i];
+			continue;
+		}
+		if (tokens[i] == "-module" && has_arg) {
+			entry.module = RTLIL::escape_id(tokens[++i]);
+			continue;
+		}
+		if (tokens[i] == "-cell" && has_arg) {
+			entry.cell = RTLIL::escape_id(tokens[++i]);
+			continue;
+		}
+		if (tokens[i] == "-port" && has_arg) {
+			entry.port = RTLIL::escape_id(tokens[++i]);
+			continue;
+		}
+		if (tokens[i] == "-portbit" && has_arg) {
+			entry.portbit = atoi(tokens[++i].c_str());
+			continue;
+		}
+		if (tokens[i] == "-ctrlbit" && has_arg) {
+			entry.ctrlbit = atoi(tokens[++i].c_str());
+			continue;
+		}
+		if (tokens[i] == "-wire" && has_arg) {
+			entry.wire = RTLIL::escape_id(tokens[++i]);
+			continue;
+		}
+		if (tokens[i] == "-wirebit" && has_arg) {
+			entry.wirebit = atoi(tokens[++i].c_str());
+			continue;
+		}
+		if (tokens[i] == "-src" && has_arg) {
+			entry.src.insert(tokens[++i]);
+			continue;
+		}
+		log_cmd_error("Unexpected argument '%s' in mutation: %s\n", tokens[i].c_str(), line.c_str());
+	}
+
+	return entry.mode != "none";
+}
+
+struct mutate_batch_result_t {
+	bool skipped = false;
+	std::vector<bool> coverage;
+};
+
+// Checks mutations against the unmodified module. The combinational cells of
+// the module are encoded once, each mutation then only adds a copy of the cells
+// in the fanout cone of the mutated bit. Everything else (module inputs and the
+// outputs of FFs, memories and submodules) is a free variable, and a mutation
+// is detected at an observation point if the point can have a different value
+// in the mutated module for the same free variables.
+struct MutateBatchWorker
+{
+	Module *module;
+	SigMap sigmap;
+	CellTypes ct;
+	ezSatPtr ez;
+	SatGen satgen, mutgen;
+
+	pool<Cell*> comb_cells;
+	dict<SigBit, Cell*> bit_driver;
+	dict<SigBit, pool<Cell*>> bit_users;
+
+	// one column of the coverage matrix: an output port of the module, or an
+	// input port of a cell that is not part of the combinational model
+	struct observe_t {
+		string name;
+		Cell *cell;
+		IdString port;
+		SigSpec sig;
+	};
+	std::vector<observe_t> observe;
+
+	int mutant_count = 0;
+	dict<SigBit, int> mutant_bits;
+	pool<Cell*> affected, recursion_guard;
+	Cell *override_cell = nullptr;
+	IdString override_port;
+	int override_bit = -1, override_lit = 0;
+
+	MutateBatchWorker(Module *module) : module(module), sigmap(module), satgen(ez.get(), &sigmap), mutgen(ez.get(), &sigmap)
+	{
+		ct.setup_internals();
+		ct.setup_stdcells();
+
+		for (auto port : module->ports) {
+			Wire *wire = module->wire(port);
+			if (wire->port_output)
+				observe.push_back(observe_t{log_id(wire), nullptr, IdString(), sigmap(wire)});
+		}
+
+		for (auto cell : module->cells())
+		{
+			if (ct.cell_known(cell->type) && satgen.importCell(cell)) {
+				comb_cells.insert(cell);
+				for (auto &conn : cell->connections())
+					for (auto bit : sigmap(conn.second)) {
+						if (bit.wire == nullptr)
+							continue;
+						if (ct.cell_output(cell->type, conn.first))
+							bit_driver[bit] = cell;
+						else
+							bit_users[bit].insert(cell);
+					}
+				continue;
+			}
+
+			for (auto &conn : cell->connections())
+				if (!cell->output(conn.first))
+					observe.push_back(observe_t{stringf("%s.%s", log_id(cell), log_id(conn.first)), cell, conn.first, sigmap(conn.second)});
+		}
+	}
+
+	bool is_output(Cell *cell, IdString port)
+	{
+		if (comb_cells.count(cell))
+			return ct.cell_output(cell->type, port);
+		return cell->output(port);
+	}
+
+	int base_lit(SigBit bit)
+	{
+		return satgen.importSigBit(bit);
+	}
+
+	int mutant_lit(SigBit bit)
+	{
+		auto it = mutant_bits.find(bit);
+		if (it != mutant_bits.end())
+			return it->second;
+
+		if (bit_driver.count(bit) && affected.count(bit_driver.at(bit)))
+			encode_cell(bit_driver.at(bit));
+
+		it = mutant_bits.find(bit);
+		return it != mutant_bits.end() ? it->second : base_lit(bit);
+	}
+
+	void encode_cell(Cell *cell)
+	{
+		// a logic loop through the cone falls back to the unmutated values
+		if (recursion_guard.count(cell))
+			return;
+		recursion_guard.insert(cell);
+
+		for (auto &conn : cell->connections()) {
+			if (ct.cell_output(cell->type, conn.first))
+				continue;
+			SigSpec sig = sigmap(conn.second);
+			for (int i = 0; i < GetSize(sig); i++) {
+				if (sig[i].wire == nullptr)
+					continue;
+				bool overridden = cell == override_cell && conn.first == override_port && i == override_bit;
+				ez->assume(ez->IFF(mutgen.importSigBit(sig[i]), overridden ? override_lit : mutant_lit(sig[i])));
+			}
+		}
+
+		if (!mutgen.importCell(cell))
+			log_abort();
+
+		for (auto &conn : cell->connections())
+			if (ct.cell_output(cell->type, conn.first))
+				for (auto bit : sigmap(conn.second))
+					if (bit.wire != nullptr && !mutant_bits.count(bit))
+						mutant_bits[bit] = mutgen.importSigBit(bit);
+
+		recursion_guard.erase(cell);
+	}
+
+	void add_cone(std::vector<SigBit> worklist)
+	{
+		while (!worklist.empty()) {
+			SigBit bit = worklist.back();
+			worklist.pop_back();
+			if (bit_users.count(bit) == 0)
+				continue;
+			for (auto user : bit_users.at(bit)) {
+				if (affected.count(user))
+					continue;
+				affected.insert(user);
+				for (auto &conn : user->connections())
+					if (ct.cell_output(user->type, conn.first))
+						for (auto b : sigmap(conn.second))
+							if (b.wire != nullptr)
+								worklist.push_back(b);
+			}
+		}
+	}
+
+	void evaluate(const mutate_t &entry, mutate_batch_result_t &result)
+	{
+		Cell *cell = module->cell(entry.cell);
+		SigSpec sig = sigmap(cell->getPort(entry.port));
+		SigBit bit = sig[entry.portbit];
+
+		mutgen.setContext(&sigmap, stringf("mutant%d:", mutant_count++));
+		mutant_bits.clear();
+		affected.clear();
+		override_cell = nullptr;
+
+		result.coverage = std::vector<bool>(GetSize(observe), false);
+
+		int orig_lit = base_lit(bit);
+		int ctrl_lit = entry.ctrlbit >= 0 ? base_lit(sig[entry.ctrlbit]) : 0;
+		int changed_lit;
+
+		if (entry.mode == "inv")
+			changed_lit = ez->NOT(orig_lit);
+		else if (entry.mode == "const0")
+			changed_lit = ez->CONST_FALSE;
+		else if (entry.mode == "const1")
+			changed_lit = ez->CONST_TRUE;
+		else if (entry.mode == "cnot0")
+			changed_lit = ez->IFF(orig_lit, ctrl_lit);
+		else
+			changed_lit = ez->XOR(orig_lit, ctrl_lit);
+
+		if (is_output(cell, entry.port))
+		{
+			if (bit.wire == nullptr) {
+				result.skipped = true;
+				return;
+			}
+			mutant_bits[bit] = changed_lit;
+			add_cone({bit});
+		}
+		else
+		{
+			override_cell = cell;
+			override_port = entry.port;
+			override_bit = entry.portbit;
+			override_lit = changed_lit;
+
+			if (comb_cells.count(cell))
+			{
+				// the mutated port bit can not be told apart from other uses of the same net
+				int uses = 0;
+				for (auto &conn : cell->connections())
+					if (!ct.cell_output(cell->type, conn.first))
+						for (auto b : sigmap(conn.second))
+							if (b == bit)
+								uses++;
+				if (uses > 1) {
+					result.skipped = true;
+					return;
+				}
+
+				std::vector<SigBit> outputs;
+				for (auto &conn : cell->connections())
+					if (ct.cell_output(cell->type, conn.first))
+						for (auto b : sigmap(conn.second))
+							if (b.wire != nullptr)
+								outputs.push_back(b);
+				affected.insert(cell);
+				add_cone(outputs);
+			}
+		}
+
+		for (int k = 0; k < GetSize(observe); k++)
+		{
+			const observe_t &ob = observe[k];
+			std::vector<int> diffs;
+
+			for (int i = 0; i < GetSize(ob.sig); i++) {
+				int lit = ob.cell != nullptr && ob.cell == override_cell && ob.port == override_port && i == override_bit ?
+						override_lit : mutant_lit(ob.sig[i]);
+				int base = base_lit(ob.sig[i]);
+				if (lit != base)
+					diffs.push_back(ez->XOR(base, lit));
+			}
+
+			if (!diffs.empty() && ez->solve(ez->expression(ezSAT::OpOr, diffs)))
+				result.coverage[k] = true;
+		}
+	}
+};
+
+void mutate_batch(Design *design, const string &listfile, const string &filename, int jobs)
+{
+	std::ifstream fin(listfile);
+	if (!fin.is_open())
+		log_cmd_error("Could not open file \"%s\" for reading.\n", listfile.c_str());
+
+	std::vector<mutate_t> database;
+	std::vector<string> commands;
+	string line;
+
+	while (std::getline(fin, line))
+	{
+		mutate_t entry;
+		if (!mutate_parse_cmd(line, entry))
+			continue;
+
+		Module *module = design->module(entry.module);
+		if (module == nullptr)
+			log_cmd_error("Module %s not found in mutation: %s\n", log_id(entry.module), line.c_str());
+
+		Cell *cell = module->cell(entry.cell);
+		if (cell == nullptr)
+			log_cmd_error("Cell %s not found in mutation: %s\n", log_id(entry.cell), line.c_str());
+
+		if (!cell->hasPort(entry.port) || entry.portbit < 0 || entry.portbit >= GetSize(cell->getPort(entry.port)))
+			log_cmd_error("Invalid port or port bit in mutation: %s\n", line.c_str());
+
+		if (pool<string>{"inv", "const0", "const1", "cnot0", "cnot1"}.count(entry.mode) == 0)
+			log_cmd_error("Invalid mode in mutation: %s\n", line.c_str());
+
+		if (entry.mode.substr(0, 4) == "cnot" && (entry.ctrlbit < 0 || entry.ctrlbit >= GetSize(cell->getPort(entry.port))))
+			log_cmd_error("Invalid ctrl bit in mutation: %s\n", line.c_str());
+
+		database.push_back(entry);
+		commands.push_back(line);
+	}
+
+	log("Checking %d mutations from %s.\n", GetSize(database), listfile.c_str());
+
+	// every chunk builds its own encoding of each module once and then checks
+	// every n-th mutation against it
+	int n = std::min(GetSize(database), std::max(jobs, 1));
+	std::vector<mutate_batch_result_t> results(GetSize(database));
+	std::vector<dict<IdString, std::vector<string>>> chunk_columns(n);
+
+	parallel_for(n, [&](int chunk) {
+		dict<IdString, std::unique_ptr<MutateBatchWorker>> workers;
+		for (int i = chunk; i < GetSize(database); i += n) {
+			auto &worker = workers[database[i].module];
+			if (worker == nullptr) {
+				worker.reset(new MutateBatchWorker(design->module(database[i].module)));
+				for (auto &ob : worker->observe)
+					chunk_columns[chunk][database[i].module].push_back(ob.name);
+			}
+			worker->evaluate(database[i], results[i]);
+		}
+	}, jobs);
+
+	nlohmann::json data;
+	data["modules"] = nlohmann::json::object();
+	for (auto &columns : chunk_columns)
+		for (auto &it : columns)
+			data["modules"][log_id(it.first)]["observation_points"] = it.second;
+
+	int detected = 0, undetected = 0, skipped = 0;
+	data["mutants"] = nlohmann::json::array();
+	for (int i = 0; i < GetSize(database); i++)
+	{
+		const mutate_t &entry = database[i];
+		const mutate_batch_result_t &result = results[i];
+		bool is_detected = std::find(result.coverage.begin(), result.coverage.end(), true) != result.coverage.end();
+
+		nlohmann::json row;
+		row["command"] = commands[i];
+		row["mode"] = entry.mode;
+		row["module"] = log_id(entry.module);
+		row["cell"] = log_id(entry.cell);
+		row["port"] = log_id(entry.port);
+		row["portbit"] = entry.portbit;
+		if (entry.ctrlbit >= 0)
+			row["ctrlbit"] = entry.ctrlbit;
+		row["status"] = result.skipped ? "skipped" : is_detected ? "detected" : "undetected";
+		row["coverage"] = nlohmann::json::array();
+		for (bool covered : result.coverage)
+			row["coverage"].push_back(covered ? 1 : 0);
+		data["mutants"].push_back(row);
+
+		if (result.skipped)
+			skipped++;
+		else if (is_detected)
+			detected++;
+		else
+			undetected++;
+	}
+
+	log("Checked %d mutations on up to %d threads: %d detected, %d undetected, %d skipped.\n",
+			GetSize(database), n, detected, undetected, skipped);
+
+	Common::ConnectAndSendJson(PipeType::DATA, Common::CreateDataJson(StatusCode::SUCCESS, data, "MUTATE_COVERAGE"));
+
+	if (!filename.empty()) {
+		std::ofstream fout;
+		fout.open(filename, std::ios::out | std::ios::trunc);
+		if (!fout.is_open())
+			log_error("Could not open file \"%s\" with write access.\n", filename.c_str());
+		fout << data.dump(2) << std::endl;
+	}
+}
+
 struct MutatePass : public Pass {
 	MutatePass() : Pass("mutate", "generate or apply design mutations") { }
 	void help() override
@@ -791,13 +1196,33 @@ struct MutatePass : public Pass {
 		log("    -src string\n");
 		log("        Ignored. (They are generated by -list for documentation purposes.)\n");
 		log("\n");
+		log("\n");
+		log("    mutate -batch filename [options]\n");
+		log("\n");
+		log("Check the mutations listed in the given file, as written by 'mutate -list N\n");
+		log("-o filename', against the unmodified design without applying them. The\n");
+		log("combinational logic of each module is encoded for SAT once, and each mutation\n");
+		log("only adds its fanout cone. A mutation is detected at an observation point, an\n");
+		log("output port of the module or an input of a FF, memory or submodule cell, if\n");
+		log("the point can have a different value than in the unmodified module. The\n");
+		log("resulting coverage matrix is sent as JSON over the DATA pipe.\n");
+		log("\n");
+		log("    -o filename\n");
+		log("        Also write the JSON coverage matrix to this file\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        Check the mutations on up to <num> threads. The default is the value\n");
+		log("        of the synthesizer's -j option.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		mutate_opts_t opts;
 		string filename;
 		string srcsfile;
+		string batchfile;
 		int N = -1;
+		int jobs = yosys_parallel_jobs;
 
 		log_header(design, "Executing MUTATE pass.\n");
 
@@ -808,6 +1233,16 @@ struct MutatePass : public Pass {
 				N = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-batch" && argidx+1 < args.size()) {
+				batchfile = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid number of jobs: %d\n", jobs);
+				continue;
+			}
 			if (args[argidx] == "-o" && argidx+1 < args.size()) {
 				filename = args[++argidx];
 				continue;
@@ -927,6 +1362,11 @@ struct MutatePass : public Pass {
 			return;
 		}
 
+		if (!batchfile.empty()) {
+			mutate_batch(design, batchfile, filename, jobs);
+			return;
+		}
+
 		if (opts.mode == "none") {
 			if (!opts.ctrl_name.empty()) {
 				Module *topmod = opts.module.empty() ? design->top_module() : design->module(opts.module);
@@ -157,6 +157,21 @@ void specialize(RTLIL::Module *module, const QbfSolutionType &sol, bool quiet =
 	}
 }
 
+//Like specialize(), but only sets the hole values in a ConstEval instead of changing the module.
+void set_solution(ConstEval &ce, RTLIL::Module *module, const QbfSolutionType &sol) {
+	auto hole_loc_idx_to_sigbit = sol.get_hole_loc_idx_sigbit_map(module);
+	for (auto &it : sol.hole_to_value) {
+		const std::string &hole_value = it.second;
+		for (unsigned int i = 0; i < hole_value.size(); ++i) {
+			int bit_idx = GetSize(hole_value) - 1 - i;
+			auto sigbit_it = hole_loc_idx_to_sigbit.find(std::make_pair(it.first, i));
+			log_assert(sigbit_it != hole_loc_idx_to_sigbit.end());
+			log_assert(hole_value[bit_idx] == '0' || hole_value[bit_idx] == '1');
+			ce.set(sigbit_it->second, hole_value[bit_idx] == '1'? RTLIL::State::S1 : RTLIL::State::S0);
+		}
+	}
+}
+
 void allconstify_inputs(RTLIL::Module *module, const pool<std::string> &input_wires) {
 	for (auto &n : input_wires) {
 		RTLIL::Wire *input = module->wire(n);
@@ -254,7 +269,6 @@ QbfSolutionType qbf_solve(RTLIL::Module *mod, const QbfSolveOptions &opt) {
 	const std::string tempdir_name = make_temp_dir(get_base_tmpdir() + "/yosys-qbfsat-XXXXXX");
 	RTLIL::Module *module = mod;
 	RTLIL::Design *design = module->design;
-	std::string module_name = module->name.str();
 	RTLIL::IdString wire_to_optimize_name = "";
 	bool maximize = false;
 	log_assert(module->design != nullptr);
@@ -305,31 +319,37 @@ QbfSolutionType qbf_solve(RTLIL::Module *mod, const QbfSolveOptions &opt) {
 		log("%s wire \"%s\".\n", (maximize? "Maximizing" : "Minimizing"), wire_to_optimize_name.c_str());
 
 		//If maximizing, grow until we get a failure.  Then bisect success and failure.
+		//The problem is shared by all iterations, only the thresholding logic is added and removed
+		//again, so the design is not copied for every iteration.
 		while (failure == 0 || difference(success, failure) > 1) {
-			Pass::call(design, "design -push-copy");
 			log_header(design, "Preparing QBF-SAT problem.\n");
 
+			RTLIL::Wire *threshold_wire = nullptr;
+			RTLIL::Cell *threshold_cmp = nullptr, *threshold_assume = nullptr;
 			if (cur_thresh != 0) {
 				//Add thresholding logic (but not on the initial run when we don't have a sense of where to start):
-				RTLIL::SigSpec comparator = maximize? module->Ge(NEW_ID, module->wire(wire_to_optimize_name), RTLIL::Const(cur_thresh), false)
-				                                    : module->Le(NEW_ID, module->wire(wire_to_optimize_name), RTLIL::Const(cur_thresh), false);
+				threshold_wire = module->addWire(NEW_ID);
+				threshold_cmp = maximize? module->addGe(NEW_ID, module->wire(wire_to_optimize_name), RTLIL::Const(cur_thresh), threshold_wire, false)
+				                        : module->addLe(NEW_ID, module->wire(wire_to_optimize_name), RTLIL::Const(cur_thresh), threshold_wire, false);
 
-				module->addAssume(wire_to_optimize_name.str() + "__threshold", comparator, RTLIL::Const(1, 1));
+				threshold_assume = module->addAssume(wire_to_optimize_name.str() + "__threshold", threshold_wire, RTLIL::Const(1, 1));
 				log("Trying to solve with %s %s %d.\n", wire_to_optimize_name.c_str(), (maximize? ">=" : "<="), cur_thresh);
 			}
 
 			ret = call_qbf_solver(module, opt, tempdir_name, false, iter_num);
-			Pass::call(design, "design -pop");
-			module = design->module(module_name);
 
-			if (!ret.unknown && ret.sat) {
-				Pass::call(design, "design -push-copy");
-				specialize(module, ret, true);
+			if (threshold_wire != nullptr) {
+				module->remove(threshold_assume);
+				module->remove(threshold_cmp);
+				module->remove({threshold_wire});
+			}
 
+			if (!ret.unknown && ret.sat) {
 				RTLIL::SigSpec wire, value, undef;
 				RTLIL::SigSpec::parse_sel(wire, design, module, wire_to_optimize_name.str());
 
 				ConstEval ce(module);
+				set_solution(ce, module, ret);
 				value = wire;
 				if (!ce.eval(value, undef))
 					log_cmd_error("Failed to evaluate signal %s: Missing value for %s.\n", log_signal(wire), log_signal(undef));
@@ -337,8 +357,6 @@ QbfSolutionType qbf_solve(RTLIL::Module *mod, const QbfSolveOptions &opt) {
 				success = value.as_const().as_int();
 				best_soln = ret;
 				log("Problem is satisfiable with %s = %d.\n", wire_to_optimize_name.c_str(), success);
-				Pass::call(design, "design -pop");
-				module = design->module(module_name);
 
 				//sometimes this happens if we get an 'unknown' or timeout
 				if (!maximize && success < failure)
@@ -23,6 +23,7 @@
 #include "kernel/celltypes.h"
 #include "kernel/utils.h"
 #include "kernel/satgen.h"
+#include "kernel/qcsat.h"
 
 #include <algorithm>
 #include <queue>
@@ -177,6 +178,88 @@ struct RecoverModuleWorker {
         }
     }
 
+    // Same as calling sim_cycle() for all sim_length cycles, but simulates all patterns at once,
+    // with one bit per cycle in each word of anchors. Anchors cut the module like ConstEval::set()
+    // does. Returns false without changing bit2cls if the module has loops or cells that ConstEval
+    // can evaluate but QuickConeSim::eval_cell() can't; sim_cycle() has to be used then.
+    bool sim_words(const dict<IdBit, equiv_cls_t> &anchors)
+    {
+        dict<SigBit, equiv_cls_t> values;
+        pool<SigBit> fixed_bits;
+        for (auto &anchor : anchors) {
+            SigBit bit = (*sigmap)(id2bit(anchor.first));
+            if (!bit.wire)
+                continue;
+            values[bit] = anchor.second;
+            fixed_bits.insert(bit);
+        }
+
+        std::vector<Cell*> sim_cells;
+        dict<SigBit, Cell*> bit2sim_driver;
+        for (auto cell : flat->cells()) {
+            if (!QuickConeSim::can_simulate(cell)) {
+                if (yosys_celltypes.cell_evaluable(cell->type))
+                    return false;
+                continue;
+            }
+            sim_cells.push_back(cell);
+            for (auto bit : (*sigmap)(cell->getPort(ID::Y)))
+                if (bit.wire)
+                    bit2sim_driver[bit] = cell;
+        }
+
+        TopoSort<Cell*, RTLIL::IdString::compare_ptr_by_name<Cell>> toposort;
+        toposort.analyze_loops = false;
+        for (auto cell : sim_cells) {
+            toposort.node(cell);
+            for (auto &conn : cell->connections()) {
+                if (conn.first == ID::Y)
+                    continue;
+                for (auto bit : (*sigmap)(conn.second)) {
+                    if (!bit.wire || fixed_bits.count(bit))
+                        continue;
+                    auto it = bit2sim_driver.find(bit);
+                    if (it != bit2sim_driver.end())
+                        toposort.edge(it->second, cell);
+                }
+            }
+        }
+        if (!toposort.sort())
+            return false;
+
+        auto get = [&](SigBit bit, uint64_t &word) {
+            bit = (*sigmap)(bit);
+            if (!bit.wire) {
+                word = bit == State::S1 ? ~equiv_cls_t(0) : 0;
+                return true;
+            }
+            auto it = values.find(bit);
+            if (it == values.end())
+                return false;
+            word = it->second;
+            return true;
+        };
+
+        std::vector<uint64_t> y;
+        for (auto cell : toposort.sorted) {
+            if (!QuickConeSim::eval_cell(cell, get, y))
+                continue;
+            SigSpec sig_y = (*sigmap)(cell->getPort(ID::Y));
+            for (int i = 0; i < GetSize(sig_y); i++)
+                if (sig_y[i].wire && !fixed_bits.count(sig_y[i]))
+                    values[sig_y[i]] = y[i];
+        }
+
+        for (auto idbit : flat2orig) {
+            if (anchors.count(idbit.first))
+                continue;
+            auto it = values.find((*sigmap)(id2bit(idbit.first)));
+            if (it != values.end() && it->second != 0)
+                bit2cls[idbit.first] = it->second;
+        }
+        return true;
+    }
+
     // Update the equivalence class groupings
     void group_classes(dict<equiv_cls_t, std::pair<pool<IdBit>, pool<InvBit>>> &cls2bits, bool is_gate)
     {
@@ -581,16 +664,32 @@ struct RecoverNamesWorker {
                 gate_anchors[gate_bit] = gold_bit.first;
             }
         }
-        // Run a random-value combinational simulation to find candidate equivalence classes
-        dict<IdBit, RTLIL::State> gold_anchor_vals, gate_anchor_vals;
+        // Run a random-value combinational simulation to find candidate equivalence classes,
+        // with all cycles at once where possible, and one cycle at a time with ConstEval otherwise
+        dict<IdBit, equiv_cls_t> gold_anchor_words, gate_anchor_words;
         rng_init();
-        for (int t = 0; t < sim_length; t++) {
-            for (auto anchor : gold_anchors) {
-                gold_anchor_vals[anchor.first] = next_randbit();
-                gate_anchor_vals[anchor.second] = gold_anchor_vals[anchor.first];
+        for (auto anchor : gold_anchors)
+            gold_anchor_words[anchor.first] = 0;
+        for (int t = 0; t < sim_length; t++)
+            for (auto anchor : gold_anchors)
+                if (next_randbit() == State::S1)
+                    gold_anchor_words[anchor.first] |= equiv_cls_t(1) << t;
+        for (auto anchor : gold_anchors)
+            gate_anchor_words[anchor.second] = gold_anchor_words.at(anchor.first);
+
+        if (!gold_worker.sim_words(gold_anchor_words) || !gate_worker.sim_words(gate_anchor_words)) {
+            gold_worker.bit2cls.clear();
+            gate_worker.bit2cls.clear();
+            dict<IdBit, RTLIL::State> gold_anchor_vals, gate_anchor_vals;
+            rng_init();
+            for (int t = 0; t < sim_length; t++) {
+                for (auto anchor : gold_anchors) {
+                    gold_anchor_vals[anchor.first] = next_randbit();
+                    gate_anchor_vals[anchor.second] = gold_anchor_vals[anchor.first];
+                }
+                gold_worker.sim_cycle(t, gold_anchor_vals);
+                gate_worker.sim_cycle(t, gate_anchor_vals);
             }
-            gold_worker.sim_cycle(t, gold_anchor_vals);
-            gate_worker.sim_cycle(t, gate_anchor_vals);
         }
         log_debug("%d candidate equiv classes in gold; %d in gate\n", GetSize(gold_worker.bit2cls), GetSize(gate_worker.bit2cls));
         // Group bits by equivalence classes together
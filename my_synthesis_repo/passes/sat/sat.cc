@@ -63,10 +63,11 @@ struct SatHelper
 	SigPool show_signal_pool;
 	SigSet<RTLIL::Cell*> show_drivers;
 	int max_timestep, timeout;
-	bool gotTimeout;
+	bool gotTimeout, show_stats;
 
-	SatHelper(RTLIL::Design *design, RTLIL::Module *module, bool enable_undef, bool set_def_formal) :
-		design(design), module(module), sigmap(module), ct(design), satgen(ez.get(), &sigmap)
+	SatHelper(RTLIL::Design *design, RTLIL::Module *module, bool enable_undef, bool set_def_formal, int portfolio = 0) :
+		design(design), module(module), sigmap(module), ct(design),
+		ez(portfolio > 0 ? new ezMiniSATPortfolio(portfolio) : yosys_satsolver->create()), satgen(ez.get(), &sigmap)
 	{
 		this->enable_undef = enable_undef;
 		satgen.model_undef = enable_undef;
@@ -78,6 +79,7 @@ struct SatHelper
 		max_timestep = -1;
 		timeout = 0;
 		gotTimeout = false;
+		show_stats = false;
 	}
 
 	void check_undef_enabled(const RTLIL::SigSpec &sig)
@@ -441,23 +443,41 @@ struct SatHelper
 			ez->assume(ez->NOT(satgen.signals_eq(state_signals, state_signals, i, timestep_to)));
 	}
 
+	void print_solver_stats(const ezSAT::SolverStats &before)
+	{
+		const ezSAT::SolverStats &after = ez->solverStats;
+		log("SAT solver statistics: %lld conflicts, %lld decisions, %lld propagations, %lld GC runs (%.3f s).\n",
+				(long long)(after.conflicts - before.conflicts), (long long)(after.decisions - before.decisions),
+				(long long)(after.propagations - before.propagations), (long long)(after.gc_runs - before.gc_runs),
+				after.gc_seconds - before.gc_seconds);
+		log("SAT solver totals: %lld solves, %lld conflicts, %lld propagations, clause arena %lld bytes (peak %lld bytes).\n",
+				(long long)after.solves, (long long)after.conflicts, (long long)after.propagations,
+				(long long)after.arena_bytes, (long long)after.arena_peak_bytes);
+	}
+
 	bool solve(const std::vector<int> &assumptions)
 	{
 		log_assert(gotTimeout == false);
+		ezSAT::SolverStats before = ez->solverStats;
 		ez->setSolverTimeout(timeout);
 		bool success = ez->solve(modelExpressions, modelValues, assumptions);
 		if (ez->getSolverTimoutStatus())
 			gotTimeout = true;
+		if (show_stats)
+			print_solver_stats(before);
 		return success;
 	}
 
 	bool solve(int a = 0, int b = 0, int c = 0, int d = 0, int e = 0, int f = 0)
 	{
 		log_assert(gotTimeout == false);
+		ezSAT::SolverStats before = ez->solverStats;
 		ez->setSolverTimeout(timeout);
 		bool success = ez->solve(modelExpressions, modelValues, a, b, c, d, e, f);
 		if (ez->getSolverTimoutStatus())
 			gotTimeout = true;
+		if (show_stats)
+			print_solver_stats(before);
 		return success;
 	}
 
@@ -481,6 +501,11 @@ struct SatHelper
 	std::vector<bool> modelValues;
 	std::set<ModelBlockInfo> modelInfo;
 
+	// the model is extended in place while time steps are added, see generate_model()
+	RTLIL::SigSpec modelSignals, modelInitSignals;
+	std::vector<int> modelValueExpressions, modelUndefExpressions;
+	int modelTimestep = -1;
+
 	void maximize_undefs()
 	{
 		log_assert(enable_undef);
@@ -507,8 +532,6 @@ struct SatHelper
 	void generate_model()
 	{
 		RTLIL::SigSpec modelSig;
-		modelExpressions.clear();
-		modelInfo.clear();
 
 		// Add "show" signals or alternatively the leaves on the input cone on all set and prove signals
 
@@ -554,7 +577,21 @@ struct SatHelper
 		modelSig.sort_and_unify();
 		// log("Model signals: %s\n", log_signal(modelSig));
 
-		std::vector<int> modelUndefExpressions;
+		// When only new time steps were added since the last call, only those are
+		// imported. The blocks are found through their offsets, so their order in
+		// modelExpressions does not matter.
+		RTLIL::SigSpec initSig = satgen.initial_state.export_all();
+		int first_timestep = -1;
+
+		if (max_timestep > 0 && modelTimestep > 0 && modelTimestep <= max_timestep && modelSig == modelSignals && initSig == modelInitSignals) {
+			first_timestep = modelTimestep + 1;
+		} else {
+			modelInfo.clear();
+			modelValueExpressions.clear();
+			modelUndefExpressions.clear();
+			modelSignals = modelSig;
+			modelInitSignals = initSig;
+		}
 
 		for (auto &c : modelSig.chunks())
 			if (c.wire != NULL)
@@ -564,17 +601,17 @@ struct SatHelper
 				info.width = chunksig.size();
 				info.description = log_signal(chunksig);
 
-				for (int timestep = -1; timestep <= max_timestep; timestep++)
+				for (int timestep = first_timestep; timestep <= max_timestep; timestep++)
 				{
 					if ((timestep == -1 && max_timestep > 0) || timestep == 0)
 						continue;
 
 					info.timestep = timestep;
-					info.offset = modelExpressions.size();
+					info.offset = modelValueExpressions.size();
 					modelInfo.insert(info);
 
 					std::vector<int> vec = satgen.importSigSpec(chunksig, timestep);
-					modelExpressions.insert(modelExpressions.end(), vec.begin(), vec.end());
+					modelValueExpressions.insert(modelValueExpressions.end(), vec.begin(), vec.end());
 
 					if (enable_undef) {
 						std::vector<int> undef_vec = satgen.importUndefSigSpec(chunksig, timestep);
@@ -585,28 +622,31 @@ struct SatHelper
 
 		// Add initial state signals as collected by satgen
 		//
-		modelSig = satgen.initial_state.export_all();
-		for (auto &c : modelSig.chunks())
-			if (c.wire != NULL)
-			{
-				ModelBlockInfo info;
-				RTLIL::SigSpec chunksig = c;
+		if (first_timestep == -1)
+			for (auto &c : initSig.chunks())
+				if (c.wire != NULL)
+				{
+					ModelBlockInfo info;
+					RTLIL::SigSpec chunksig = c;
 
-				info.timestep = 0;
-				info.offset = modelExpressions.size();
-				info.width = chunksig.size();
-				info.description = log_signal(chunksig);
-				modelInfo.insert(info);
+					info.timestep = 0;
+					info.offset = modelValueExpressions.size();
+					info.width = chunksig.size();
+					info.description = log_signal(chunksig);
+					modelInfo.insert(info);
 
-				std::vector<int> vec = satgen.importSigSpec(chunksig, 1);
-				modelExpressions.insert(modelExpressions.end(), vec.begin(), vec.end());
+					std::vector<int> vec = satgen.importSigSpec(chunksig, 1);
+					modelValueExpressions.insert(modelValueExpressions.end(), vec.begin(), vec.end());
 
-				if (enable_undef) {
-					std::vector<int> undef_vec = satgen.importUndefSigSpec(chunksig, 1);
-					modelUndefExpressions.insert(modelUndefExpressions.end(), undef_vec.begin(), undef_vec.end());
+					if (enable_undef) {
+						std::vector<int> undef_vec = satgen.importUndefSigSpec(chunksig, 1);
+						modelUndefExpressions.insert(modelUndefExpressions.end(), undef_vec.begin(), undef_vec.end());
+					}
 				}
-			}
 
+		modelTimestep = max_timestep;
+
+		modelExpressions = modelValueExpressions;
 		modelExpressions.insert(modelExpressions.end(), modelUndefExpressions.begin(), modelUndefExpressions.end());
 	}
 
@@ -960,6 +1000,21 @@ struct SatPass : public Pass {
 		log("    -ignore_unknown_cells\n");
 		log("        ignore all cells that can not be matched to a SAT model\n");
 		log("\n");
+		log("    -eager_cnf\n");
+		log("        write the clauses of every gate as soon as the circuit is imported,\n");
+		log("        instead of first building an expression graph of the whole problem.\n");
+		log("        This uses much less memory on very large miters, but disables the\n");
+		log("        variable elimination of the SAT solver.\n");
+		log("\n");
+		log("    -portfolio <N>\n");
+		log("        solve with <N> differently configured MiniSat instances running in\n");
+		log("        parallel, and use the answer of the first one that finishes.\n");
+		log("\n");
+		log("    -simp\n");
+		log("        let the SAT solver eliminate all variables it can before solving. This\n");
+		log("        is only possible when the problem is solved once, so it can not be\n");
+		log("        used with -all, -max, -max_undef or -tempinduct.\n");
+		log("\n");
 		log("The following options can be used to set up a sequential problem:\n");
 		log("\n");
 		log("    -seq <N>\n");
@@ -969,6 +1024,13 @@ struct SatPass : public Pass {
 		log("        note: for large <N> it can be significantly faster to use\n");
 		log("        -tempinduct-baseonly -maxsteps <N> instead of -seq <N>.\n");
 		log("\n");
+		log("    -seq-incremental\n");
+		log("        add the time steps of a -seq proof one at a time to the same solver\n");
+		log("        and check the proof for each new step under an assumption literal,\n");
+		log("        so the solver keeps its learned clauses from step to step. the proof\n");
+		log("        stops at the first failing step, and only the constraints of the steps\n");
+		log("        up to that one are used for the counter-example.\n");
+		log("\n");
 		log("    -set-at <N> <signal> <value>\n");
 		log("    -unset-at <N> <signal>\n");
 		log("        set or unset the specified signal to the specified value in the\n");
@@ -1059,6 +1121,15 @@ struct SatPass : public Pass {
 		log("    -timeout <N>\n");
 		log("        Maximum number of seconds a single SAT instance may take.\n");
 		log("\n");
+		log("    -stat\n");
+		log("        Print the work done by the SAT solver (conflicts, decisions, propagations,\n");
+		log("        garbage collection time and clause arena size) after each solver call.\n");
+		log("\n");
+		log("    -compact_arena\n");
+		log("        Compact the clause arena of the SAT solver after each solver call. This\n");
+		log("        keeps the memory of long incremental runs (e.g. -tempinduct) bounded at\n");
+		log("        the cost of some extra garbage collection time.\n");
+		log("\n");
 		log("    -verify\n");
 		log("        Return an error and stop the synthesis script if the proof fails.\n");
 		log("\n");
@@ -1080,11 +1151,14 @@ struct SatPass : public Pass {
 		std::vector<std::string> shows, sets_def, sets_any_undef, sets_all_undef;
 		int loopcount = 0, seq_len = 0, maxsteps = 0, initsteps = 0, timeout = 0, prove_skip = 0;
 		bool verify = false, fail_on_timeout = false, enable_undef = false, set_def_inputs = false, set_def_formal = false;
+		bool show_stats = false, compact_arena = false;
 		bool ignore_div_by_zero = false, set_init_undef = false, set_init_zero = false, max_undef = false;
 		bool tempinduct = false, prove_asserts = false, show_inputs = false, show_outputs = false;
 		bool show_regs = false, show_public = false, show_all = false;
 		bool ignore_unknown_cells = false, falsify = false, tempinduct_def = false, set_init_def = false;
 		bool tempinduct_baseonly = false, tempinduct_inductonly = false, set_assumes = false;
+		bool eager_cnf = false, simp = false, seq_incremental = false;
+		int portfolio = 0;
 		int tempinduct_skip = 0, stepsize = 1;
 		std::string vcd_file_name, json_file_name, cnf_file_name;
 
@@ -1118,6 +1192,14 @@ struct SatPass : public Pass {
 				timeout = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-stat") {
+				show_stats = true;
+				continue;
+			}
+			if (args[argidx] == "-compact_arena") {
+				compact_arena = true;
+				continue;
+			}
 			if (args[argidx] == "-max" && argidx+1 < args.size()) {
 				loopcount = atoi(args[++argidx].c_str());
 				continue;
@@ -1231,6 +1313,10 @@ struct SatPass : public Pass {
 				seq_len = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-seq-incremental") {
+				seq_incremental = true;
+				continue;
+			}
 			if (args[argidx] == "-set-at" && argidx+3 < args.size()) {
 				int timestep = atoi(args[++argidx].c_str());
 				std::string lhs = args[++argidx];
@@ -1309,6 +1395,20 @@ struct SatPass : public Pass {
 				show_all = true;
 				continue;
 			}
+			if (args[argidx] == "-portfolio" && argidx+1 < args.size()) {
+				portfolio = atoi(args[++argidx].c_str());
+				if (portfolio < 1)
+					log_cmd_error("Invalid -portfolio argument: %s\n", args[argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-simp") {
+				simp = true;
+				continue;
+			}
+			if (args[argidx] == "-eager_cnf") {
+				eager_cnf = true;
+				continue;
+			}
 			if (args[argidx] == "-ignore_unknown_cells") {
 				ignore_unknown_cells = true;
 				continue;
@@ -1344,6 +1444,12 @@ struct SatPass : public Pass {
 		if (prove_skip && tempinduct)
 			log_cmd_error("Options -prove-skip and -tempinduct don't work with each other. Use -seq instead of -prove-skip.\n");
 
+		if (seq_incremental && (tempinduct || seq_len == 0 || (!prove.size() && !prove_x.size() && !prove_asserts)))
+			log_cmd_error("Option -seq-incremental requires -seq <N> and something to prove, and can not be used with -tempinduct.\n");
+
+		if (seq_incremental && (loopcount != 0 || max_undef || simp || !cnf_file_name.empty()))
+			log_cmd_error("Option -seq-incremental can not be combined with -all, -max, -max_undef, -simp or -dump_cnf.\n");
+
 		if (prove_skip >= seq_len && prove_skip > 0)
 			log_cmd_error("The value of -prove-skip must be smaller than the one of -seq.\n");
 
@@ -1396,8 +1502,16 @@ struct SatPass : public Pass {
 			if (loopcount > 0 || max_undef)
 				log_cmd_error("The options -max, -all, and -max_undef are not supported for temporal induction proofs!\n");
 
-			SatHelper basecase(design, module, enable_undef, set_def_formal);
-			SatHelper inductstep(design, module, enable_undef, set_def_formal);
+			if (simp)
+				log_cmd_error("The option -simp is not supported for temporal induction proofs!\n");
+
+			SatHelper basecase(design, module, enable_undef, set_def_formal, portfolio);
+			SatHelper inductstep(design, module, enable_undef, set_def_formal, portfolio);
+
+			if (eager_cnf) {
+				basecase.ez->eager_cnf();
+				inductstep.ez->eager_cnf();
+			}
 
 			basecase.sets = sets;
 			basecase.set_assumes = set_assumes;
@@ -1408,6 +1522,9 @@ struct SatPass : public Pass {
 			basecase.unsets_at = unsets_at;
 			basecase.shows = shows;
 			basecase.timeout = timeout;
+			basecase.show_stats = show_stats;
+			if (compact_arena)
+				basecase.ez->compact_arena();
 			basecase.sets_def = sets_def;
 			basecase.sets_any_undef = sets_any_undef;
 			basecase.sets_all_undef = sets_all_undef;
@@ -1421,9 +1538,11 @@ struct SatPass : public Pass {
 			basecase.satgen.ignore_div_by_zero = ignore_div_by_zero;
 			basecase.ignore_unknown_cells = ignore_unknown_cells;
 
-			for (int timestep = 1; timestep <= seq_len; timestep++)
+			for (int timestep = 1; timestep <= seq_len; timestep++) {
+				log_check_interrupt("sat -seq", timestep, seq_len);
 				if (!tempinduct_inductonly)
 					basecase.setup(timestep, timestep == 1);
+			}
 
 			inductstep.sets = sets;
 			inductstep.set_assumes = set_assumes;
@@ -1432,6 +1551,9 @@ struct SatPass : public Pass {
 			inductstep.prove_asserts = prove_asserts;
 			inductstep.shows = shows;
 			inductstep.timeout = timeout;
+			inductstep.show_stats = show_stats;
+			if (compact_arena)
+				inductstep.ez->compact_arena();
 			inductstep.sets_def = sets_def;
 			inductstep.sets_any_undef = sets_any_undef;
 			inductstep.sets_all_undef = sets_all_undef;
@@ -1450,6 +1572,7 @@ struct SatPass : public Pass {
 
 			for (int inductlen = 1; inductlen <= maxsteps || maxsteps == 0; inductlen++)
 			{
+				log_check_interrupt("sat -tempinduct", inductlen, maxsteps);
 				log("\n** Trying induction with length %d **\n", inductlen);
 
 				// phase 1: proving base case
@@ -1586,7 +1709,17 @@ struct SatPass : public Pass {
 			if (maxsteps > 0)
 				log_cmd_error("The options -maxsteps is only supported for temporal induction proofs!\n");
 
-			SatHelper sathelper(design, module, enable_undef, set_def_formal);
+			if (simp && (loopcount != 0 || max_undef))
+				log_cmd_error("The option -simp can not be combined with -max, -all, or -max_undef!\n");
+			if (simp && portfolio > 0)
+				log_cmd_error("The options -simp and -portfolio can not be combined!\n");
+
+			SatHelper sathelper(design, module, enable_undef, set_def_formal, portfolio);
+
+			if (eager_cnf)
+				sathelper.ez->eager_cnf();
+			if (simp)
+				sathelper.ez->non_incremental();
 
 			sathelper.sets = sets;
 			sathelper.set_assumes = set_assumes;
@@ -1597,6 +1730,9 @@ struct SatPass : public Pass {
 			sathelper.unsets_at = unsets_at;
 			sathelper.shows = shows;
 			sathelper.timeout = timeout;
+			sathelper.show_stats = show_stats;
+			if (compact_arena)
+				sathelper.ez->compact_arena();
 			sathelper.sets_def = sets_def;
 			sathelper.sets_any_undef = sets_any_undef;
 			sathelper.sets_all_undef = sets_all_undef;
@@ -1610,6 +1746,59 @@ struct SatPass : public Pass {
 			sathelper.satgen.ignore_div_by_zero = ignore_div_by_zero;
 			sathelper.ignore_unknown_cells = ignore_unknown_cells;
 
+			if (seq_incremental)
+			{
+				bool found_model = false;
+
+				for (int timestep = 1; timestep <= seq_len; timestep++)
+				{
+					log_check_interrupt("sat -seq", timestep, seq_len);
+					sathelper.setup(timestep, timestep == 1);
+					if (timestep <= prove_skip)
+						continue;
+
+					int property = sathelper.setup_proof(timestep);
+					sathelper.generate_model();
+
+					log("\n[time step %d] Solving problem with %d variables and %d clauses..\n",
+							timestep, sathelper.ez->numCnfVariables(), sathelper.ez->numCnfClauses());
+					log_flush();
+
+					if (sathelper.solve(sathelper.ez->NOT(property))) {
+						found_model = true;
+						break;
+					}
+
+					if (sathelper.gotTimeout)
+						goto timeout;
+
+					log("Proof for time step %d succeeded.\n", timestep);
+					sathelper.ez->assume(property);
+				}
+
+				if (found_model) {
+					log("SAT proof finished - model found: FAIL!\n");
+					print_proof_failed();
+					sathelper.print_model();
+					if(!vcd_file_name.empty())
+						sathelper.dump_model_to_vcd(vcd_file_name);
+					if(!json_file_name.empty())
+						sathelper.dump_model_to_json(json_file_name);
+					if (verify) {
+						log("\n");
+						log_error("Called with -verify and proof did fail!\n");
+					}
+				} else {
+					log("SAT proof finished - no model found: SUCCESS!\n");
+					print_qed();
+					if (falsify) {
+						log("\n");
+						log_error("Called with -falsify and proof did succeed!\n");
+					}
+				}
+				return;
+			}
+
 			if (seq_len == 0) {
 				sathelper.setup();
 				if (sathelper.prove.size() || sathelper.prove_x.size() || sathelper.prove_asserts)
@@ -26,9 +26,14 @@
 #include "kernel/yw.h"
 #include "kernel/json.h"
 #include "kernel/fmt.h"
+#include "kernel/threading.h"
 
 #include <ctime>
 
+#ifdef YOSYS_ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
@@ -73,7 +78,13 @@ struct OutputWriter
 {
 	OutputWriter(SimWorker *w) { worker = w;};
 	virtual ~OutputWriter() {};
-	virtual void write(std::map<int, bool> &use_signal) = 0;
+	// called once, before the first step
+	virtual void write_header(const std::map<int, bool> &use_signal) = 0;
+	virtual void write_step(int time, const std::map<int, Const> &data) = 0;
+	// called after each batch of steps
+	virtual void flush() {};
+	// called after the last step
+	virtual void finish() {};
 	SimWorker *worker;
 };
 
@@ -99,6 +110,325 @@ struct DisplayOutput {
 	{ }
 };
 
+// The port combinations of evaluable cells that the simulator supports
+enum class EvalPattern {
+	none,
+	ab,   // (A -> Y) and (A,B -> Y) cells
+	abc,  // (A,B,C -> Y) cells
+	as,   // (A,S -> Y) cells
+	abs,  // (A,B,S -> Y) cells
+};
+
+static EvalPattern eval_pattern(Cell *cell)
+{
+	bool has_a = cell->hasPort(ID::A);
+	bool has_b = cell->hasPort(ID::B);
+	bool has_c = cell->hasPort(ID::C);
+	bool has_d = cell->hasPort(ID::D);
+	bool has_s = cell->hasPort(ID::S);
+	bool has_y = cell->hasPort(ID::Y);
+
+	if (has_a && !has_c && !has_d && !has_s && has_y)
+		return EvalPattern::ab;
+	if (has_a && has_b && has_c && !has_d && !has_s && has_y)
+		return EvalPattern::abc;
+	if (has_a && !has_b && !has_c && !has_d && has_s && has_y)
+		return EvalPattern::as;
+	if (has_a && has_b && !has_c && !has_d && has_s && has_y)
+		return EvalPattern::abs;
+	return EvalPattern::none;
+}
+
+// sig_c is the C or the S port, depending on the pattern
+static void eval_pattern_ports(Cell *cell, EvalPattern pattern, SigSpec &sig_a, SigSpec &sig_b, SigSpec &sig_c)
+{
+	sig_a = cell->getPort(ID::A);
+	sig_b = pattern != EvalPattern::as && cell->hasPort(ID::B) ? cell->getPort(ID::B) : SigSpec();
+	sig_c = pattern == EvalPattern::abc ? cell->getPort(ID::C) : pattern != EvalPattern::ab ? cell->getPort(ID::S) : SigSpec();
+}
+
+static Const eval_pattern_cell(Cell *cell, EvalPattern pattern, const Const &value_a, const Const &value_b, const Const &value_c)
+{
+	switch (pattern) {
+	case EvalPattern::ab:
+		return CellTypes::eval(cell, value_a, value_b);
+	case EvalPattern::abc:
+		return CellTypes::eval(cell, value_a, value_b, value_c);
+	case EvalPattern::as:
+		return CellTypes::eval(cell, value_a, value_c);
+	case EvalPattern::abs:
+		return CellTypes::eval(cell, value_a, value_b, value_c);
+	default:
+		log_abort();
+	}
+}
+
+// Net layout of a module, shared by all instances of the module. With
+// compile set, the combinational cells are also levelized into a flat
+// instruction list that SimInstance runs instead of interpreting the cells
+// one dirty net at a time. Instruction operands are net indices, or -1-state
+// for constant bits.
+struct SimProgram
+{
+	struct instr_t
+	{
+		Cell *cell;
+		EvalPattern pattern;
+		int level;
+		std::vector<int> ops_a, ops_b, ops_c, ops_y;
+
+		// for single bit gates: the output for each combination of the
+		// (S0, S1, Sx, Sz) input states, two index bits per input
+		const State *lut = nullptr;
+		std::vector<int> lut_inputs;
+	};
+
+	SigMap sigmap;
+	dict<SigBit, int> net_ids;
+	std::vector<SigBit> net_bits;
+
+	bool compiled = false;
+	int num_levels = 0;
+	std::vector<instr_t> instrs;
+	pool<Cell*> compiled_cells;
+	std::vector<std::vector<int>> net_fanout;
+	std::vector<int> const_fanout;
+	std::vector<bool> net_external;
+	std::map<std::pair<IdString, int>, std::vector<State>> gate_luts;
+
+	SimProgram(Module *module, bool compile) : sigmap(module)
+	{
+		for (auto wire : module->wires())
+			for (auto bit : sigmap(wire))
+				if (net_ids.count(bit) == 0) {
+					net_ids[bit] = GetSize(net_bits);
+					net_bits.push_back(bit);
+				}
+
+		if (compile)
+			compile_cells(module);
+	}
+
+	int operand(SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return -1 - int(bit.data);
+		return net_ids.at(bit);
+	}
+
+	std::vector<int> operands(const SigSpec &sig)
+	{
+		std::vector<int> ops;
+		for (auto bit : sigmap(sig))
+			ops.push_back(operand(bit));
+		return ops;
+	}
+
+	static bool is_compilable(Cell *cell)
+	{
+		if (cell->module->design->module(cell->type) != nullptr)
+			return false;
+		if (RTLIL::builtin_ff_cell_types().count(cell->type) || cell->type == ID($anyinit))
+			return false;
+		if (cell->is_mem_cell() || cell->type.in(ID($assert), ID($cover), ID($assume), ID($print)))
+			return false;
+		if (!yosys_celltypes.cell_evaluable(cell->type))
+			return false;
+		return eval_pattern(cell) != EvalPattern::none;
+	}
+
+	const State *gate_lut(Cell *cell, const instr_t &instr)
+	{
+		if (!cell->type.in(ID($_BUF_), ID($_NOT_), ID($_AND_), ID($_NAND_), ID($_OR_), ID($_NOR_),
+				ID($_XOR_), ID($_XNOR_), ID($_ANDNOT_), ID($_ORNOT_), ID($_MUX_), ID($_NMUX_),
+				ID($_AOI3_), ID($_OAI3_)))
+			return nullptr;
+
+		if (GetSize(instr.ops_a) > 1 || GetSize(instr.ops_b) > 1 || GetSize(instr.ops_c) > 1 || GetSize(instr.ops_y) != 1)
+			return nullptr;
+
+		int num_inputs = GetSize(instr.ops_a) + GetSize(instr.ops_b) + GetSize(instr.ops_c);
+		auto key = std::make_pair(cell->type, num_inputs);
+
+		auto it = gate_luts.find(key);
+		if (it != gate_luts.end())
+			return it->second.data();
+
+		std::vector<State> lut(1 << (2*num_inputs));
+
+		for (int index = 0; index < GetSize(lut); index++) {
+			Const value_a, value_b, value_c;
+			int input = 0;
+			auto input_state = [&](const std::vector<int> &ops, Const &value) {
+				if (!ops.empty())
+					value = Const(State((index >> (2*input++)) & 3));
+			};
+			input_state(instr.ops_a, value_a);
+			input_state(instr.ops_b, value_b);
+			input_state(instr.ops_c, value_c);
+			Const value_y = eval_pattern_cell(cell, instr.pattern, value_a, value_b, value_c);
+			if (GetSize(value_y) != 1)
+				return nullptr;
+			lut[index] = value_y[0];
+		}
+
+		return gate_luts.emplace(key, std::move(lut)).first->second.data();
+	}
+
+	void compile_cells(Module *module)
+	{
+		dict<SigBit, int> driver_count;
+
+		for (auto wire : module->wires())
+			if (wire->port_input)
+				for (auto bit : sigmap(wire))
+					driver_count[bit]++;
+
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections())
+				if (cell->output(conn.first))
+					for (auto bit : sigmap(conn.second))
+						driver_count[bit]++;
+
+		// Cells that drive a net together with something else give results
+		// that depend on the evaluation order. They stay with the interpreter,
+		// as do cells with constant outputs.
+		std::vector<instr_t> candidates;
+		std::vector<pool<SigBit>> candidate_inputs;
+
+		for (auto cell : module->cells())
+		{
+			if (!is_compilable(cell))
+				continue;
+
+			bool single_driver = true;
+			for (auto bit : sigmap(cell->getPort(ID::Y)))
+				if (bit.wire == nullptr || driver_count.at(bit) != 1)
+					single_driver = false;
+			if (!single_driver)
+				continue;
+
+			instr_t instr;
+			instr.cell = cell;
+			instr.pattern = eval_pattern(cell);
+			instr.level = 0;
+
+			SigSpec sig_a, sig_b, sig_c;
+			eval_pattern_ports(cell, instr.pattern, sig_a, sig_b, sig_c);
+			instr.ops_a = operands(sig_a);
+			instr.ops_b = operands(sig_b);
+			instr.ops_c = operands(sig_c);
+			instr.ops_y = operands(cell->getPort(ID::Y));
+
+			// like the interpreter, evaluate the cell when any of its inputs
+			// changes, not only those used by the evaluation
+			pool<SigBit> inputs;
+			for (auto &conn : cell->connections())
+				if (cell->input(conn.first))
+					for (auto bit : sigmap(conn.second))
+						inputs.insert(bit);
+
+			candidates.push_back(std::move(instr));
+			candidate_inputs.push_back(std::move(inputs));
+		}
+
+		dict<SigBit, int> bit_driver;
+		for (int i = 0; i < GetSize(candidates); i++)
+			for (int op : candidates[i].ops_y)
+				bit_driver[net_bits[op]] = i;
+
+		std::vector<int> indegree(GetSize(candidates));
+		std::vector<std::vector<int>> users(GetSize(candidates));
+		for (int i = 0; i < GetSize(candidates); i++) {
+			pool<int> drivers;
+			for (auto bit : candidate_inputs[i]) {
+				auto it = bit_driver.find(bit);
+				if (it != bit_driver.end())
+					drivers.insert(it->second);
+			}
+			for (int driver : drivers)
+				users[driver].push_back(i);
+			indegree[i] = GetSize(drivers);
+		}
+
+		// Levelize. Combinational loops and the cells after them never get
+		// an indegree of zero and are left to the interpreter.
+		std::vector<int> order;
+		for (int i = 0; i < GetSize(candidates); i++)
+			if (indegree[i] == 0)
+				order.push_back(i);
+
+		for (int k = 0; k < GetSize(order); k++) {
+			auto &instr = candidates[order[k]];
+			num_levels = std::max(num_levels, instr.level + 1);
+			for (int user : users[order[k]]) {
+				candidates[user].level = std::max(candidates[user].level, instr.level + 1);
+				if (--indegree[user] == 0)
+					order.push_back(user);
+			}
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return candidates[a].level < candidates[b].level;
+		});
+
+		net_fanout.resize(GetSize(net_bits));
+		net_external.resize(GetSize(net_bits));
+
+		for (int i : order) {
+			instr_t &instr = candidates[i];
+			instr.lut = gate_lut(instr.cell, instr);
+			if (instr.lut != nullptr) {
+				instr.lut_inputs = instr.ops_a;
+				instr.lut_inputs.insert(instr.lut_inputs.end(), instr.ops_b.begin(), instr.ops_b.end());
+				instr.lut_inputs.insert(instr.lut_inputs.end(), instr.ops_c.begin(), instr.ops_c.end());
+			}
+
+			bool has_const_input = false;
+			for (auto bit : candidate_inputs[i]) {
+				auto it = net_ids.find(bit);
+				if (it != net_ids.end())
+					net_fanout[it->second].push_back(GetSize(instrs));
+				if (bit.wire == nullptr)
+					has_const_input = true;
+			}
+			if (has_const_input)
+				const_fanout.push_back(GetSize(instrs));
+
+			compiled_cells.insert(instr.cell);
+			instrs.push_back(std::move(instr));
+		}
+
+		// nets that are also read by interpreted cells or output ports
+		for (auto cell : module->cells())
+			if (compiled_cells.count(cell) == 0)
+				for (auto &conn : cell->connections())
+					if (cell->input(conn.first))
+						for (auto bit : sigmap(conn.second)) {
+							auto it = net_ids.find(bit);
+							if (it != net_ids.end())
+								net_external[it->second] = true;
+						}
+
+		for (auto wire : module->wires())
+			if (wire->port_output)
+				for (auto bit : sigmap(wire))
+					net_external[net_ids.at(bit)] = true;
+
+		compiled = !instrs.empty();
+	}
+};
+
+// Changes to state outside of the instances that a worker thread evaluates,
+// applied in hierarchy order after all threads of a phase are done
+struct SimDeferred
+{
+	std::vector<std::tuple<SimInstance*, IdString, int>> memory_addrs;
+	std::vector<std::tuple<SimInstance*, SigSpec, Const>> parent_writes;
+	std::vector<TriggeredAssertion> triggered_assertions;
+	std::vector<DisplayOutput> display_output;
+};
+
 struct SimShared
 {
 	bool debug = false;
@@ -114,7 +444,15 @@ struct SimShared
 	SimulationMode sim_mode = SimulationMode::sim;
 	bool cycles_set = false;
 	std::vector<std::unique_ptr<OutputWriter>> outputfiles;
+	// recorded steps that have not been passed to the output writers yet
 	std::vector<std::pair<int,std::map<int,Const>>> output_data;
+	int output_buffer = 1024;
+	bool output_started = false;
+	fstWriterPackType fst_pack_type = FST_WR_PT_FASTLZ;
+	// bytes of value changes per FST block, 0 ends a block with every batch of steps
+	int64_t fst_block_size = 0;
+	bool fst_parallel = false;
+	bool fst_repack = false;
 	bool ignore_x = false;
 	bool date = false;
 	bool multiclock = false;
@@ -122,8 +460,23 @@ struct SimShared
 	int step = 0;
 	std::vector<TriggeredAssertion> triggered_assertions;
 	std::vector<DisplayOutput> display_output;
+	dict<Cell*, FmtProgram> print_programs;
 	bool serious_asserts = false;
 	bool initstate = true;
+	bool compiled = false;
+	std::map<Module*, std::unique_ptr<SimProgram>> programs;
+	int jobs = 1;
+	// all instances in pre-order, set up when the phases run on several threads
+	std::vector<SimInstance*> instances;
+	bool parallel_phases = false;
+
+	SimProgram *get_program(Module *module)
+	{
+		auto &program = programs[module];
+		if (program == nullptr)
+			program.reset(new SimProgram(module, compiled && !debug));
+		return program.get();
+	}
 };
 
 void zinit(State &v)
@@ -150,18 +503,28 @@ struct SimInstance
 	dict<Cell*, SimInstance*> children;
 
 	SigMap sigmap;
-	dict<SigBit, State> state_nets;
+	SimProgram *program;
+	std::vector<State> state_nets;
 	dict<SigBit, pool<Cell*>> upd_cells;
 	dict<SigBit, pool<Wire*>> upd_outports;
 
 	dict<SigBit, SigBit> in_parent_drivers;
 	dict<SigBit, SigBit> clk2fflogic_drivers;
 
-	pool<SigBit> dirty_bits;
+	pool<SigBit> dirty_bits, dirty_program_bits;
 	pool<Cell*> dirty_cells;
 	pool<IdString> dirty_memories;
 	pool<SimInstance*, hash_ptr_ops> dirty_children;
 
+	// set while the instance is evaluated on a worker thread
+	SimDeferred *deferred = nullptr;
+	int preorder_index = 0, subtree_size = 1;
+
+	// scheduled instructions of the compiled program, by level
+	std::vector<bool> instr_pending;
+	std::vector<std::vector<int>> level_queue;
+	int pending_instrs = 0;
+
 	struct ff_state_t
 	{
 		Const past_d;
@@ -191,7 +554,7 @@ struct SimInstance
 		Const past_args;
 
 		Cell *cell;
-		Fmt fmt;
+		FmtProgram program;
 
 		std::tuple<bool, SigSpec, Const, int, Cell*> _sort_label() const
 		{
@@ -222,6 +585,7 @@ struct SimInstance
 	dict<Wire*, pair<int, Const>> signal_database;
 	dict<IdString, std::map<int, pair<int, Const>>> trace_mem_database;
 	dict<std::pair<IdString, int>, Const> trace_mem_init_database;
+	pool<IdString> untraced_memories;
 	dict<Wire*, fstHandle> fst_handles;
 	dict<Wire*, fstHandle> fst_inputs;
 	dict<IdString, dict<int,fstHandle>> fst_memories;
@@ -244,13 +608,16 @@ struct SimInstance
 			parent->children[instance] = this;
 		}
 
+		program = shared->get_program(module);
+		state_nets.assign(GetSize(program->net_bits), State::Sx);
+		instr_pending.assign(GetSize(program->instrs), false);
+		level_queue.resize(program->num_levels);
+
 		for (auto wire : module->wires())
 		{
 			SigSpec sig = sigmap(wire);
 
 			for (int i = 0; i < GetSize(sig); i++) {
-				if (state_nets.count(sig[i]) == 0)
-					state_nets[sig[i]] = State::Sx;
 				if (wire->port_output) {
 					upd_outports[sig[i]].insert(wire);
 					dirty_bits.insert(sig[i]);
@@ -268,7 +635,7 @@ struct SimInstance
 				Const initval = wire->attributes.at(ID::init);
 				for (int i = 0; i < GetSize(sig) && i < GetSize(initval); i++)
 					if (initval[i] == State::S0 || initval[i] == State::S1) {
-						state_nets[sig[i]] = initval[i];
+						state_nets[program->net_ids.at(sig[i])] = initval[i];
 						dirty_bits.insert(sig[i]);
 					}
 			}
@@ -305,7 +672,8 @@ struct SimInstance
 			for (auto &port : cell->connections()) {
 				if (cell->input(port.first))
 					for (auto bit : sigmap(port.second)) {
-						upd_cells[bit].insert(cell);
+						if (program->compiled_cells.count(cell) == 0)
+							upd_cells[bit].insert(cell);
 						// Make sure cell inputs connected to constants are updated in the first cycle
 						if (bit.wire == nullptr)
 							dirty_bits.insert(bit);
@@ -347,7 +715,15 @@ struct SimInstance
 				print_database.emplace_back();
 				auto &print = print_database.back();
 				print.cell = cell;
-				print.fmt.parse_rtlil(cell);
+				// parsed once per cell, but every instance has its own buffers as
+				// instances can be evaluated on different threads
+				auto it = shared->print_programs.find(cell);
+				if (it == shared->print_programs.end()) {
+					Fmt fmt;
+					fmt.parse_rtlil(cell);
+					it = shared->print_programs.emplace(cell, FmtProgram(fmt)).first;
+				}
+				print.program = it->second;
 				print.past_trg = Const(State::Sx, cell->getPort(ID::TRG).size());
 				print.past_args = Const(State::Sx, cell->getPort(ID::ARGS).size());
 				print.past_en = State::Sx;
@@ -420,13 +796,17 @@ struct SimInstance
 	{
 		Const value;
 
-		for (auto bit : sigmap(sig))
-			if (bit.wire == nullptr)
+		for (auto bit : sigmap(sig)) {
+			if (bit.wire == nullptr) {
 				value.bits.push_back(bit.data);
-			else if (state_nets.count(bit))
-				value.bits.push_back(state_nets.at(bit));
+				continue;
+			}
+			auto it = program->net_ids.find(bit);
+			if (it != program->net_ids.end())
+				value.bits.push_back(state_nets[it->second]);
 			else
 				value.bits.push_back(State::Sz);
+		}
 
 		if (shared->debug)
 			log("[%s] get %s: %s\n", hiername().c_str(), log_signal(sig), log_signal(value));
@@ -440,12 +820,14 @@ struct SimInstance
 		sig = sigmap(sig);
 		log_assert(GetSize(sig) <= GetSize(value));
 
-		for (int i = 0; i < GetSize(sig); i++)
-			if (value[i] != State::Sa && state_nets.at(sig[i]) != value[i]) {
-				state_nets.at(sig[i]) = value[i];
+		for (int i = 0; i < GetSize(sig); i++) {
+			State &net = state_nets[program->net_ids.at(sig[i])];
+			if (value[i] != State::Sa && net != value[i]) {
+				net = value[i];
 				dirty_bits.insert(sig[i]);
 				did_something = true;
 			}
+		}
 
 		if (shared->debug)
 			log("[%s] set %s: %s\n", hiername().c_str(), log_signal(sig), log_signal(value));
@@ -532,51 +914,22 @@ struct SimInstance
 
 		if (yosys_celltypes.cell_evaluable(cell->type))
 		{
-			RTLIL::SigSpec sig_a, sig_b, sig_c, sig_d, sig_s, sig_y;
-			bool has_a, has_b, has_c, has_d, has_s, has_y;
-
-			has_a = cell->hasPort(ID::A);
-			has_b = cell->hasPort(ID::B);
-			has_c = cell->hasPort(ID::C);
-			has_d = cell->hasPort(ID::D);
-			has_s = cell->hasPort(ID::S);
-			has_y = cell->hasPort(ID::Y);
-
-			if (has_a) sig_a = cell->getPort(ID::A);
-			if (has_b) sig_b = cell->getPort(ID::B);
-			if (has_c) sig_c = cell->getPort(ID::C);
-			if (has_d) sig_d = cell->getPort(ID::D);
-			if (has_s) sig_s = cell->getPort(ID::S);
-			if (has_y) sig_y = cell->getPort(ID::Y);
-
 			if (shared->debug)
 				log("[%s] eval %s (%s)\n", hiername().c_str(), log_id(cell), log_id(cell->type));
 
-			// Simple (A -> Y) and (A,B -> Y) cells
-			if (has_a && !has_c && !has_d && !has_s && has_y) {
-				set_state(sig_y, CellTypes::eval(cell, get_state(sig_a), get_state(sig_b)));
-				return;
-			}
-
-			// (A,B,C -> Y) cells
-			if (has_a && has_b && has_c && !has_d && !has_s && has_y) {
-				set_state(sig_y, CellTypes::eval(cell, get_state(sig_a), get_state(sig_b), get_state(sig_c)));
-				return;
-			}
-
-			// (A,S -> Y) cells
-			if (has_a && !has_b && !has_c && !has_d && has_s && has_y) {
-				set_state(sig_y, CellTypes::eval(cell, get_state(sig_a), get_state(sig_s)));
-				return;
-			}
+			EvalPattern pattern = eval_pattern(cell);
 
-			// (A,B,S -> Y) cells
-			if (has_a && has_b && !has_c && !has_d && has_s && has_y) {
-				set_state(sig_y, CellTypes::eval(cell, get_state(sig_a), get_state(sig_b), get_state(sig_s)));
+			if (pattern == EvalPattern::none) {
+				log_warning("Unsupported evaluable cell type: %s (%s.%s)\n", log_id(cell->type), log_id(module), log_id(cell));
 				return;
 			}
 
-			log_warning("Unsupported evaluable cell type: %s (%s.%s)\n", log_id(cell->type), log_id(module), log_id(cell));
+			RTLIL::SigSpec sig_a, sig_b, sig_c;
+			eval_pattern_ports(cell, pattern, sig_a, sig_b, sig_c);
+			Const value_a = get_state(sig_a);
+			Const value_b = get_state(sig_b);
+			Const value_c = get_state(sig_c);
+			set_state(cell->getPort(ID::Y), eval_pattern_cell(cell, pattern, value_a, value_b, value_c));
 			return;
 		}
 
@@ -614,6 +967,93 @@ struct SimInstance
 		}
 	}
 
+	State read_operand(int op) const
+	{
+		return op >= 0 ? state_nets[op] : State(-1 - op);
+	}
+
+	Const read_operands(const std::vector<int> &ops) const
+	{
+		Const value;
+		value.bits.reserve(ops.size());
+		for (int op : ops)
+			value.bits.push_back(read_operand(op));
+		return value;
+	}
+
+	void schedule_instr(int idx)
+	{
+		if (instr_pending[idx])
+			return;
+		instr_pending[idx] = true;
+		level_queue[program->instrs[idx].level].push_back(idx);
+		pending_instrs++;
+	}
+
+	void schedule_fanout(SigBit bit)
+	{
+		auto it = program->net_ids.find(bit);
+		if (it != program->net_ids.end()) {
+			for (int idx : program->net_fanout[it->second])
+				schedule_instr(idx);
+		} else if (bit.wire == nullptr) {
+			for (int idx : program->const_fanout)
+				schedule_instr(idx);
+		}
+	}
+
+	void write_net(int net, State value)
+	{
+		if (value == State::Sa || state_nets[net] == value)
+			return;
+
+		state_nets[net] = value;
+		for (int idx : program->net_fanout[net])
+			schedule_instr(idx);
+		if (program->net_external[net])
+			dirty_program_bits.insert(program->net_bits[net]);
+	}
+
+	void run_instr(int idx)
+	{
+		const SimProgram::instr_t &instr = program->instrs[idx];
+		instr_pending[idx] = false;
+
+		if (instr.lut != nullptr) {
+			int index = 0;
+			bool known = true;
+			for (int i = 0; i < GetSize(instr.lut_inputs); i++) {
+				State state = read_operand(instr.lut_inputs[i]);
+				if (state > State::Sz)
+					known = false;
+				index |= int(state) << (2*i);
+			}
+			if (known) {
+				write_net(instr.ops_y[0], instr.lut[index]);
+				return;
+			}
+		}
+
+		Const value = eval_pattern_cell(instr.cell, instr.pattern, read_operands(instr.ops_a),
+				read_operands(instr.ops_b), read_operands(instr.ops_c));
+		log_assert(GetSize(instr.ops_y) <= GetSize(value));
+		for (int i = 0; i < GetSize(instr.ops_y); i++)
+			write_net(instr.ops_y[i], value[i]);
+	}
+
+	// runs the scheduled instructions, every instruction only schedules
+	// instructions on later levels
+	void run_program()
+	{
+		for (int level = 0; pending_instrs > 0 && level < GetSize(level_queue); level++) {
+			auto &queue = level_queue[level];
+			for (int i = 0; i < GetSize(queue); i++)
+				run_instr(queue[i]);
+			pending_instrs -= GetSize(queue);
+			queue.clear();
+		}
+	}
+
 	void update_ph1()
 	{
 		pool<Cell*> queue_cells;
@@ -621,23 +1061,35 @@ struct SimInstance
 
 		queue_cells.swap(dirty_cells);
 
+		auto queue_bit = [&](SigBit bit) {
+			if (upd_cells.count(bit))
+				for (auto cell : upd_cells.at(bit))
+					queue_cells.insert(cell);
+
+			if (upd_outports.count(bit) && parent != nullptr)
+				for (auto wire : upd_outports.at(bit))
+					queue_outports.insert(wire);
+		};
+
 		while (1)
 		{
-			for (auto bit : dirty_bits)
-			{
-				if (upd_cells.count(bit))
-					for (auto cell : upd_cells.at(bit))
-						queue_cells.insert(cell);
-
-				if (upd_outports.count(bit) && parent != nullptr)
-					for (auto wire : upd_outports.at(bit))
-						queue_outports.insert(wire);
+			for (auto bit : dirty_bits) {
+				queue_bit(bit);
+				if (program->compiled)
+					schedule_fanout(bit);
 			}
 
+			// changed by the compiled program, which already scheduled its own readers
+			for (auto bit : dirty_program_bits)
+				queue_bit(bit);
+
 			dirty_bits.clear();
+			dirty_program_bits.clear();
 
-			if (!queue_cells.empty())
+			if (!queue_cells.empty() || pending_instrs > 0)
 			{
+				run_program();
+
 				for (auto cell : queue_cells)
 					update_cell(cell);
 
@@ -652,13 +1104,19 @@ struct SimInstance
 			for (auto wire : queue_outports)
 				if (instance->hasPort(wire->name)) {
 					Const value = get_state(wire);
-					parent->set_state(instance->getPort(wire->name), value);
+					if (deferred != nullptr && parent->deferred != deferred)
+						deferred->parent_writes.emplace_back(parent, instance->getPort(wire->name), value);
+					else
+						parent->set_state(instance->getPort(wire->name), value);
 				}
 
 			queue_outports.clear();
 
-			for (auto child : dirty_children)
-				child->update_ph1();
+			if (shared->parallel_phases && deferred == nullptr && GetSize(dirty_children) > 1)
+				update_children_ph1();
+			else
+				for (auto child : dirty_children)
+					child->update_ph1();
 
 			dirty_children.clear();
 
@@ -667,7 +1125,68 @@ struct SimInstance
 		}
 	}
 
+	// Runs the dirty child subtrees on separate threads. A child only reads
+	// its own state, so only its writes to this instance and to the shared
+	// output state are held back and applied in the serial order afterwards.
+	void update_children_ph1()
+	{
+		std::vector<SimInstance*> tasks;
+		for (auto child : dirty_children)
+			tasks.push_back(child);
+
+		std::vector<SimDeferred> buffers(GetSize(tasks));
+		parallel_for(GetSize(tasks), [&](int i) {
+			tasks[i]->set_subtree_deferred(&buffers[i]);
+			tasks[i]->update_ph1();
+			tasks[i]->set_subtree_deferred(nullptr);
+		}, shared->jobs);
+
+		for (auto &buffer : buffers)
+			apply_deferred(buffer);
+	}
+
+	void set_subtree_deferred(SimDeferred *buffer)
+	{
+		for (int i = 0; i < subtree_size; i++)
+			shared->instances[preorder_index + i]->deferred = buffer;
+	}
+
+	static void apply_deferred(SimDeferred &buffer)
+	{
+		for (auto &it : buffer.parent_writes)
+			std::get<0>(it)->set_state(std::get<1>(it), std::get<2>(it));
+		for (auto &it : buffer.memory_addrs)
+			std::get<0>(it)->register_memory_addr(std::get<1>(it), std::get<2>(it));
+		for (auto &it : buffer.triggered_assertions)
+			it.instance->shared->triggered_assertions.push_back(it);
+		for (auto &it : buffer.display_output)
+			it.instance->shared->display_output.push_back(it);
+	}
+
+	void collect_instances(std::vector<SimInstance*> &list)
+	{
+		preorder_index = GetSize(list);
+		list.push_back(this);
+		for (auto it : children)
+			it.second->collect_instances(list);
+		subtree_size = GetSize(list) - preorder_index;
+	}
+
 	bool update_ph2(bool gclk, bool stable_past_update = false)
+	{
+		bool did_something = update_ph2_local(gclk, stable_past_update);
+
+		for (auto it : children)
+			if (it.second->update_ph2(gclk, stable_past_update)) {
+				dirty_children.insert(it.second);
+				did_something = true;
+			}
+
+		return did_something;
+	}
+
+	// update_ph2() without the children
+	bool update_ph2_local(bool gclk, bool stable_past_update)
 	{
 		bool did_something = false;
 
@@ -780,12 +1299,6 @@ struct SimInstance
 			}
 		}
 
-		for (auto it : children)
-			if (it.second->update_ph2(gclk, stable_past_update)) {
-				dirty_children.insert(it.second);
-				did_something = true;
-			}
-
 		return did_something;
 	}
 
@@ -814,6 +1327,15 @@ struct SimInstance
 	}
 
 	void update_ph3(bool gclk_trigger)
+	{
+		update_ph3_local(gclk_trigger);
+
+		for (auto it : children)
+			it.second->update_ph3(gclk_trigger);
+	}
+
+	// update_ph3() without the children
+	void update_ph3_local(bool gclk_trigger)
 	{
 		for (auto &it : ff_database)
 		{
@@ -886,15 +1408,12 @@ struct SimInstance
 				}
 
 				if (triggered) {
-					int pos = 0;
-					for (auto &part : print.fmt.parts) {
-						part.sig = (sampled ? print.past_args : args).extract(pos, part.sig.size());
-						pos += part.sig.size();
-					}
-
-					std::string rendered = print.fmt.render();
+					const std::string &rendered = print.program.render(sampled ? print.past_args : args);
 					log("%s", rendered.c_str());
-					shared->display_output.emplace_back(shared->step, this, cell, rendered);
+					if (deferred != nullptr)
+						deferred->display_output.emplace_back(shared->step, this, cell, rendered);
+					else
+						shared->display_output.emplace_back(shared->step, this, cell, rendered);
 				}
 			}
 
@@ -916,7 +1435,10 @@ struct SimInstance
 				State en = get_state(cell->getPort(ID::EN))[0];
 
 				if (en == State::S1 && (cell->type == ID($cover) ? a == State::S1 : a != State::S1)) {
-					shared->triggered_assertions.emplace_back(shared->step, this, cell);
+					if (deferred != nullptr)
+						deferred->triggered_assertions.emplace_back(shared->step, this, cell);
+					else
+						shared->triggered_assertions.emplace_back(shared->step, this, cell);
 				}
 
 				if (cell->type == ID($cover) && en == State::S1 && a == State::S1)
@@ -934,9 +1456,6 @@ struct SimInstance
 				}
 			}
 		}
-
-		for (auto it : children)
-			it.second->update_ph3(gclk_trigger);
 	}
 
 	void set_initstate_outputs(State state)
@@ -1021,8 +1540,7 @@ struct SimInstance
 		for (auto cell : module->cells())
 		{
 			if (RTLIL::builtin_ff_cell_types().count(cell->type)) {
-				FfData ff_data(nullptr, cell);
-				SigSpec q = sigmap(ff_data.sig_q);
+				SigSpec q = sigmap(cell->getPort(ID::Q));
 				if (q.is_wire() && signal_database.count(q.as_wire()) != 0) {
 					registers[q.as_wire()] = true;
 				}
@@ -1088,6 +1606,11 @@ struct SimInstance
 
 	void register_memory_addr(IdString memid, int addr)
 	{
+		if (deferred != nullptr) {
+			// allocates output ids, which must happen in the serial order
+			deferred->memory_addrs.emplace_back(this, memid, addr);
+			return;
+		}
 		auto &mdb = mem_database.at(memid);
 		auto &mem = *mdb.mem;
 		int index = addr - mem.start_offset;
@@ -1096,6 +1619,13 @@ struct SimInstance
 		auto it = trace_mem_database.find(memid);
 		if (it != trace_mem_database.end() && it->second.count(index))
 			return;
+		if (shared->output_started) {
+			// the output headers are written, no more signals can be added
+			if (!shared->outputfiles.empty() && untraced_memories.insert(memid).second)
+				log_warning("Memory %s.%s has addresses that are first accessed after the output headers were written, these are not traced. Use a larger -buffer value.\n",
+						hiername().c_str(), log_id(memid));
+			return;
+		}
 		int output_id = shared->next_output_id++;
 		Const data;
 		if (!shared->output_data.empty()) {
@@ -1174,6 +1704,21 @@ struct SimInstance
 		return did_something;
 	}
 
+	void collectFstHandles(std::vector<fstHandle> &handles)
+	{
+		for (auto &item : fst_handles)
+			if (item.second != 0)
+				handles.push_back(item.second);
+		for (auto &item : fst_inputs)
+			handles.push_back(item.second);
+		for (auto &mem : fst_memories)
+			for (auto &data : mem.second)
+				handles.push_back(data.second);
+
+		for (auto child : children)
+			child.second->collectFstHandles(handles);
+	}
+
 	void addAdditionalInputs()
 	{
 		for (auto cell : module->cells())
@@ -1308,26 +1853,51 @@ struct SimWorker : SimShared
 		std::map<int,Const> data;
 		top->register_output_step_values(&data);
 		output_data.emplace_back(t, data);
+
+		// -x needs all steps to find the signals that stay undefined
+		if (!ignore_x && output_buffer > 0 && GetSize(output_data) >= output_buffer)
+			flush_output_steps();
 	}
 
-	void write_output_files()
+	// The headers are written with the first batch of steps. Signals first
+	// recorded in that batch (e.g. memory words) are still part of it.
+	void flush_output_steps()
 	{
-		std::map<int, bool> use_signal;
-		bool first = ignore_x;
-		for(auto& d : output_data)
+		if (!output_started)
 		{
-			if (first) {
-				for (auto &data : d.second)
-					use_signal[data.first] = !data.second.is_fully_undef();
-				first = false;
-			} else {
-				for (auto &data : d.second)
-					use_signal[data.first] = true;
+			std::map<int, bool> use_signal;
+			bool first = ignore_x;
+			for(auto& d : output_data)
+			{
+				if (first) {
+					for (auto &data : d.second)
+						use_signal[data.first] = !data.second.is_fully_undef();
+					first = false;
+				} else {
+					for (auto &data : d.second)
+						use_signal[data.first] = true;
+				}
+				if (!ignore_x) break;
 			}
-			if (!ignore_x) break;
+			for(auto& writer : outputfiles)
+				writer->write_header(use_signal);
+			output_started = true;
 		}
+
+		for (auto &d : output_data)
+			for(auto& writer : outputfiles)
+				writer->write_step(d.first, d.second);
+		for(auto& writer : outputfiles)
+			writer->flush();
+
+		output_data.clear();
+	}
+
+	void write_output_files()
+	{
+		flush_output_steps();
 		for(auto& writer : outputfiles)
-			writer->write(use_signal);
+			writer->finish();
 		
 		if (writeback) {
 			pool<Module*> wbmods;
@@ -1335,11 +1905,78 @@ struct SimWorker : SimShared
 		}
 	}
 
+	// With -j, phase 2 and 3 evaluate contiguous ranges of the pre-order
+	// instance list on separate threads, and phase 1 evaluates independent
+	// child subtrees concurrently. The log output and the recorded results
+	// are the same as with one thread. Not used with -d.
+	void setup_parallel_phases()
+	{
+		if (jobs <= 1 || debug || !instances.empty())
+			return;
+		top->collect_instances(instances);
+		parallel_phases = GetSize(instances) > 1;
+	}
+
+	void run_instance_ranges(const std::function<void(SimInstance*)> &worker)
+	{
+		int count = GetSize(instances);
+		int ranges = std::min(count, 4 * jobs);
+		std::vector<SimDeferred> buffers(ranges);
+
+		parallel_for(ranges, [&](int r) {
+			int begin = int(int64_t(count) * r / ranges), end = int(int64_t(count) * (r+1) / ranges);
+			for (int i = begin; i < end; i++) {
+				instances[i]->deferred = &buffers[r];
+				worker(instances[i]);
+				instances[i]->deferred = nullptr;
+			}
+		}, jobs);
+
+		for (auto &buffer : buffers)
+			SimInstance::apply_deferred(buffer);
+	}
+
+	bool update_ph2(bool gclk, bool stable_past_update = false)
+	{
+		if (!parallel_phases)
+			return top->update_ph2(gclk, stable_past_update);
+
+		std::vector<char> changed(GetSize(instances));
+		run_instance_ranges([&](SimInstance *instance) {
+			changed[instance->preorder_index] = instance->update_ph2_local(gclk, stable_past_update);
+		});
+
+		// children follow their parent in pre-order, so a reverse walk
+		// sees every subtree before its root
+		for (int i = GetSize(instances)-1; i > 0; i--)
+			if (changed[i])
+				changed[instances[i]->parent->preorder_index] = true;
+		for (int i = 1; i < GetSize(instances); i++)
+			if (changed[i])
+				instances[i]->parent->dirty_children.insert(instances[i]);
+
+		return changed[0];
+	}
+
+	void update_ph3(bool gclk_trigger)
+	{
+		if (!parallel_phases) {
+			top->update_ph3(gclk_trigger);
+			return;
+		}
+
+		run_instance_ranges([&](SimInstance *instance) {
+			instance->update_ph3_local(gclk_trigger);
+		});
+	}
+
 	void update(bool gclk)
 	{
 		if (gclk)
 			step += 1;
 
+		setup_parallel_phases();
+
 		while (1)
 		{
 			if (debug)
@@ -1350,18 +1987,19 @@ struct SimWorker : SimShared
 			if (debug)
 				log("\n-- ph2 --\n");
 
-			if (!top->update_ph2(gclk))
+			if (!update_ph2(gclk))
 				break;
 		}
 
 		if (debug)
 			log("\n-- ph3 --\n");
 
-		top->update_ph3(gclk);
+		update_ph3(gclk);
 	}
 
 	void initialize_stable_past()
 	{
+		setup_parallel_phases();
 
 		while (1)
 		{
@@ -1373,13 +2011,13 @@ struct SimWorker : SimShared
 			if (debug)
 				log("\n-- ph2 (initialize) --\n");
 
-			if (!top->update_ph2(false, true))
+			if (!update_ph2(false, true))
 				break;
 		}
 
 		if (debug)
 			log("\n-- ph3 (initialize) --\n");
-		top->update_ph3(true);
+		update_ph3(true);
 	}
 
 	void set_inports(pool<IdString> ports, State value)
@@ -1546,6 +2184,11 @@ struct SimWorker : SimShared
 		log("\n");
 		bool all_samples = fst_clock.empty();
 
+		// signals of the file that are not part of the design are not decoded
+		std::vector<fstHandle> fst_signals;
+		top->collectFstHandles(fst_signals);
+		fst->setRequiredSignals(fst_signals);
+
 		try {
 			fst->reconstructAllAtTimes(fst_clock, startCount, stopCount, [&](uint64_t time) {
 				if (verbose)
@@ -1950,7 +2593,7 @@ struct SimWorker : SimShared
 
 					State expected = clock_input.second ? State::S0 : State::S1;
 
-					for (int t = 0; t < GetSize(yw.steps); t++) {
+					for (int t = 0; t < yw.num_steps(); t++) {
 						if (yw.get_bits(t, clock_bits_offset, 1) != expected)
 						{
 #ifdef HYBRDLINK
@@ -1970,7 +2613,7 @@ struct SimWorker : SimShared
 
 	void set_yw_state(const ReadWitness &yw, const YwHierarchy &hierarchy, int t)
 	{
-		log_assert(t >= 0 && t < GetSize(yw.steps));
+		log_assert(t >= 0 && t < yw.num_steps());
 
 		for (auto &signal : yw.signals) {
 			if (signal.init_only && t >= 1)
@@ -2035,7 +2678,7 @@ struct SimWorker : SimShared
 
 		YwHierarchy hierarchy = prepare_yw_hierarchy(yw);
 
-		if (yw.steps.empty()) {
+		if (yw.num_steps() == 0) {
 #ifdef HYBRDLINK
 			log_warning("Synthesizer witness file `%s` contains no time steps\n", yw.filename.c_str());
 #else
@@ -2058,11 +2701,11 @@ struct SimWorker : SimShared
 			top->set_initstate_outputs(State::S0);
 		}
 
-		for (int cycle = 1; cycle < GetSize(yw.steps) + append; cycle++)
+		for (int cycle = 1; cycle < yw.num_steps() + append; cycle++)
 		{
 			if (verbose)
 				log("Simulating cycle %d.\n", cycle);
-			if (cycle < GetSize(yw.steps))
+			if (cycle < yw.num_steps())
 				set_yw_state(yw, hierarchy, cycle);
 			set_yw_clocks(yw, hierarchy, true);
 			update(true);
@@ -2077,7 +2720,7 @@ struct SimWorker : SimShared
 			}
 		}
 
-		register_output_step(10 * (GetSize(yw.steps) + append));
+		register_output_step(10 * (yw.num_steps() + append));
 		write_output_files();
 	}
 
@@ -2349,74 +2992,184 @@ struct SimWorker : SimShared
 	}
 };
 
+// Collects the VCD text in a buffer that is written out in large blocks,
+// gzip compressed when the file name ends in ".gz". Every signal gets a short
+// printable identifier code, and vector values are written without the
+// leading bits that a VCD reader extends them with anyway.
 struct VCDWriter : public OutputWriter
 {
 	VCDWriter(SimWorker *worker, std::string filename) : OutputWriter(worker) {
-		vcdfile.open(filename.c_str());
-	}
-
-	void write(std::map<int, bool> &use_signal) override
-	{
-		if (!vcdfile.is_open()) return;
+		if (filename.size() > 3 && filename.compare(filename.size()-3, std::string::npos, ".gz") == 0) {
+#ifdef YOSYS_ENABLE_ZLIB
+			gzfile = gzopen(filename.c_str(), "wb");
+			if (gzfile == nullptr)
+				log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+#else
 #ifdef HYBRDLINK
-		// vcdfile << stringf("$version %s $end\n", worker->date ? yosys_version_str : "Synthesizer");
-		vcdfile << stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Synthesizer");
+			log_cmd_error("Synthesizer is compiled without zlib support, unable to write gzip output.\n");
 #else
-		// vcdfile << stringf("$version %s $end\n", worker->date ? yosys_version_str : "Yosys");
-		vcdfile << stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Yosys");
+			log_cmd_error("Yosys is compiled without zlib support, unable to write gzip output.\n");
 #endif // HYBRDLINK
-
-		if (worker->date) {
-			std::time_t t = std::time(nullptr);
-			char mbstr[255];
-			if (std::strftime(mbstr, sizeof(mbstr), "%c", std::localtime(&t))) {
-				vcdfile << stringf("$date ") << mbstr << stringf(" $end\n");
-			}
+#endif // YOSYS_ENABLE_ZLIB
+		} else {
+			file = fopen(filename.c_str(), "wb");
+			if (file == nullptr)
+				log_cmd_error("Can't open output file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+		}
+	}
+
+	virtual ~VCDWriter()
+	{
+		write_buffer();
+		if (file != nullptr)
+			fclose(file);
+#ifdef YOSYS_ENABLE_ZLIB
+		if (gzfile != nullptr)
+			gzclose(gzfile);
+#endif
+	}
+
+	bool is_open() const
+	{
+#ifdef YOSYS_ENABLE_ZLIB
+		if (gzfile != nullptr)
+			return true;
+#endif
+		return file != nullptr;
+	}
+
+	void write_buffer()
+	{
+		if (buffer.empty())
+			return;
+		if (file != nullptr && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+			log_error("Writing VCD output failed: %s\n", strerror(errno));
+#ifdef YOSYS_ENABLE_ZLIB
+		if (gzfile != nullptr && gzwrite(gzfile, buffer.data(), unsigned(buffer.size())) != int(buffer.size()))
+			log_error("Writing gzip compressed VCD output failed.\n");
+#endif
+		buffer.clear();
+	}
+
+	// identifier codes are base 94 numbers written with the printable
+	// characters from '!' to '~', the most frequent signals are not known
+	// up front, so they are simply handed out in declaration order
+	static std::string id_code(int index)
+	{
+		std::string code;
+		do {
+			code += char('!' + index % 94);
+			index /= 94;
+		} while (index > 0);
+		return code;
+	}
+
+	void write_header(const std::map<int, bool> &signals) override
+	{
+		use_signal = signals;
+		if (!is_open()) return;
+#ifdef HYBRDLINK
+		// buffer += stringf("$version %s $end\n", worker->date ? yosys_version_str : "Synthesizer");
+		buffer += stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Synthesizer");
+#else
+		// buffer += stringf("$version %s $end\n", worker->date ? yosys_version_str : "Yosys");
+		buffer += stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Yosys");
+#endif // HYBRDLINK
+
+		if (worker->date) {
+			std::time_t t = std::time(nullptr);
+			char mbstr[255];
+			if (std::strftime(mbstr, sizeof(mbstr), "%c", std::localtime(&t))) {
+				buffer += stringf("$date %s $end\n", mbstr);
+			}
 		}
 
 		if (!worker->timescale.empty())
-			vcdfile << stringf("$timescale %s $end\n", worker->timescale.c_str());
+			buffer += stringf("$timescale %s $end\n", worker->timescale.c_str());
 
+		int num_codes = 0;
 		worker->top->write_output_header(
-			[this](IdString name) { vcdfile << stringf("$scope module %s $end\n", log_id(name)); },
-			[this]() { vcdfile << stringf("$upscope $end\n");},
-			[this,use_signal](const char *name, int size, Wire *, int id, bool is_reg) {
+			[this](IdString name) { buffer += stringf("$scope module %s $end\n", log_id(name)); },
+			[this]() { buffer += stringf("$upscope $end\n");},
+			[this, &num_codes](const char *name, int size, Wire *, int id, bool is_reg) {
 				if (use_signal.at(id)) {
+					if (id >= GetSize(codes)) {
+						codes.resize(id + 1);
+						widths.resize(id + 1);
+					}
+					codes[id] = id_code(num_codes++);
+					widths[id] = size;
 					// Works around gtkwave trying to parse everything past the last [ in a signal
 					// name. While the emitted range doesn't necessarily match the wire's range,
 					// this is consistent with the range gtkwave makes up if it doesn't find a
 					// range
 					std::string range = strchr(name, '[') ? stringf("[%d:0]", size - 1) : std::string();
-					vcdfile << stringf("$var %s %d n%d %s%s%s $end\n", is_reg ? "reg" : "wire", size, id, name[0] == '$' ? "\\" : "", name, range.c_str());
+					buffer += stringf("$var %s %d %s %s%s%s $end\n", is_reg ? "reg" : "wire", size, codes[id].c_str(), name[0] == '$' ? "\\" : "", name, range.c_str());
 
 				}
 			}
 		);
 
-		vcdfile << stringf("$enddefinitions $end\n");
+		buffer += stringf("$enddefinitions $end\n");
+	}
+
+	static char state_char(State state)
+	{
+		switch (state) {
+			case State::S0: return '0';
+			case State::S1: return '1';
+			case State::Sx: return 'x';
+			default: return 'z';
+		}
+	}
 
-		for(auto& d : worker->output_data)
+	void write_step(int time, const std::map<int, Const> &data) override
+	{
+		if (!is_open()) return;
+		buffer += '#';
+		buffer += std::to_string(time);
+		buffer += '\n';
+		for (auto &it : data)
 		{
-			vcdfile << stringf("#%d\n", d.first);
-			for (auto &data : d.second)
-			{
-				if (!use_signal.at(data.first)) continue;
-				Const value = data.second;
-				vcdfile << "b";
-				for (int i = GetSize(value)-1; i >= 0; i--) {
-					switch (value[i]) {
-						case State::S0: vcdfile << "0"; break;
-						case State::S1: vcdfile << "1"; break;
-						case State::Sx: vcdfile << "x"; break;
-						default: vcdfile << "z";
-					}
-				}
-				vcdfile << stringf(" n%d\n", data.first);
+			if (!use_signal.at(it.first)) continue;
+			const Const &value = it.second;
+			int width = GetSize(value);
+			if (widths[it.first] == 1 && width == 1) {
+				buffer += state_char(value[0]);
+			} else {
+				// a reader extends a leading 0 or 1 with 0s, x with xs and z with zs
+				int msb = width - 1;
+				while (msb > 0 && value[msb] == value[msb-1] && value[msb] != State::S1)
+					msb--;
+				if (msb > 0 && value[msb] == State::S0 && value[msb-1] == State::S1)
+					msb--;
+				buffer += 'b';
+				for (int i = msb; i >= 0; i--)
+					buffer += state_char(value[i]);
+				buffer += ' ';
 			}
+			buffer += codes[it.first];
+			buffer += '\n';
 		}
+		if (buffer.size() >= (1 << 20))
+			write_buffer();
 	}
 
-	std::ofstream vcdfile;
+	void flush() override
+	{
+		write_buffer();
+		if (file != nullptr)
+			fflush(file);
+	}
+
+	FILE *file = nullptr;
+#ifdef YOSYS_ENABLE_ZLIB
+	gzFile gzfile = nullptr;
+#endif
+	std::string buffer;
+	std::vector<std::string> codes;
+	std::vector<int> widths;
+	std::map<int, bool> use_signal;
 };
 
 struct FSTWriter : public OutputWriter
@@ -2430,8 +3183,9 @@ struct FSTWriter : public OutputWriter
 		fstWriterClose(fstfile);
 	}
 
-	void write(std::map<int, bool> &use_signal) override
+	void write_header(const std::map<int, bool> &signals) override
 	{
+		use_signal = signals;
 		if (!fstfile) return;
 		std::time_t t = std::time(nullptr);
 #ifdef HYBRDLINK
@@ -2448,43 +3202,62 @@ struct FSTWriter : public OutputWriter
 		if (!worker->timescale.empty())
 			fstWriterSetTimescaleFromString(fstfile, worker->timescale.c_str());
 
-		fstWriterSetPackType(fstfile, FST_WR_PT_FASTLZ);
-		fstWriterSetRepackOnClose(fstfile, 1);
-	   
+		fstWriterSetPackType(fstfile, worker->fst_pack_type);
+		// recompressing the whole file on close only pays off when it was
+		// written in one go, not when it was streamed in batches
+		bool streamed = worker->output_buffer > 0 && !worker->ignore_x;
+		fstWriterSetRepackOnClose(fstfile, worker->fst_repack || !streamed);
+		if (worker->fst_parallel)
+			fstWriterSetParallelMode(fstfile, 1);
+
 	   	worker->top->write_output_header(
 			[this](IdString name) { fstWriterSetScope(fstfile, FST_ST_VCD_MODULE, stringf("%s",log_id(name)).c_str(), nullptr); },
 			[this]() { fstWriterSetUpscope(fstfile); },
-			[this,use_signal](const char *name, int size, Wire *, int id, bool is_reg) {
+			[this](const char *name, int size, Wire *, int id, bool is_reg) {
 				if (!use_signal.at(id)) return;
 				fstHandle fst_id = fstWriterCreateVar(fstfile, is_reg ? FST_VT_VCD_REG : FST_VT_VCD_WIRE, FST_VD_IMPLICIT, size,
 												name, 0);
 				mapping.emplace(id, fst_id);
 			}
 		);
+	}
 
-		for(auto& d : worker->output_data)
+	void write_step(int time, const std::map<int, Const> &data) override
+	{
+		if (!fstfile) return;
+		if (worker->fst_block_size > 0 && block_bytes >= worker->fst_block_size) {
+			fstWriterFlushContext(fstfile);
+			block_bytes = 0;
+		}
+		fstWriterEmitTimeChange(fstfile, time);
+		for (auto &it : data)
 		{
-			fstWriterEmitTimeChange(fstfile, d.first);
-			for (auto &data : d.second)
-			{
-				if (!use_signal.at(data.first)) continue;
-				Const value = data.second;
-				std::stringstream ss;
-				for (int i = GetSize(value)-1; i >= 0; i--) {
-					switch (value[i]) {
-						case State::S0: ss << "0"; break;
-						case State::S1: ss << "1"; break;
-						case State::Sx: ss << "x"; break;
-						default: ss << "z";
-					}
+			if (!use_signal.at(it.first)) continue;
+			const Const &value = it.second;
+			std::stringstream ss;
+			for (int i = GetSize(value)-1; i >= 0; i--) {
+				switch (value[i]) {
+					case State::S0: ss << "0"; break;
+					case State::S1: ss << "1"; break;
+					case State::Sx: ss << "x"; break;
+					default: ss << "z";
 				}
-				fstWriterEmitValueChange(fstfile, mapping[data.first], ss.str().c_str());
 			}
+			fstWriterEmitValueChange(fstfile, mapping[it.first], ss.str().c_str());
+			block_bytes += GetSize(value);
 		}
 	}
 
+	void flush() override
+	{
+		if (fstfile && worker->fst_block_size == 0)
+			fstWriterFlushContext(fstfile);
+	}
+
 	struct fstContext *fstfile = nullptr;
+	int64_t block_bytes = 0;
 	std::map<int,fstHandle> mapping;
+	std::map<int, bool> use_signal;
 };
 
 struct AIWWriter : public OutputWriter
@@ -2498,7 +3271,7 @@ struct AIWWriter : public OutputWriter
 		aiwfile << '.' << '\n';
 	}
 
-	void write(std::map<int, bool> &) override
+	void write_header(const std::map<int, bool> &) override
 	{
 		if (!aiwfile.is_open()) return;
 		if (worker->map_filename.empty())
@@ -2507,7 +3280,6 @@ struct AIWWriter : public OutputWriter
 		std::ifstream mf(worker->map_filename);
 		std::string type, symbol;
 		int variable, index;
-		int max_input = 0;
 		if (mf.fail())
 			log_cmd_error("Not able to read AIGER witness map file.\n");
 		while (mf >> type >> variable >> index >> symbol) {
@@ -2541,73 +3313,913 @@ struct AIWWriter : public OutputWriter
 			[]() {},
 			[this](const char */*name*/, int /*size*/, Wire *wire, int id, bool) { if (wire != nullptr) mapping[wire] = id; }
 		);
+	}
 
-		std::map<int, Yosys::RTLIL::Const> current;
-		bool first = true;
-		for (auto iter = worker->output_data.begin(); iter != std::prev(worker->output_data.end()); ++iter)
+	// the last step is not part of the witness, so each step is written
+	// when the next one arrives
+	void write_step(int, const std::map<int, Const> &data) override
+	{
+		if (!aiwfile.is_open()) return;
+		if (has_pending)
+			write_pending_step();
+		pending = data;
+		has_pending = true;
+	}
+
+	void flush() override
+	{
+		if (aiwfile.is_open())
+			aiwfile.flush();
+	}
+
+	void write_pending_step()
+	{
+		for (auto &data : pending)
 		{
-			auto& d = *iter;
-			for (auto &data : d.second)
+			current[data.first] = data.second;
+		}
+		if (first) {
+			for (int i = 0;; i++)
 			{
-				current[data.first] = data.second;
-			}
-			if (first) {
-				for (int i = 0;; i++)
-				{
-					if (aiw_latches.count(i)) {
-						aiwfile << '0';
-						continue;
-					}
-					aiwfile << '\n';
-					break;
+				if (aiw_latches.count(i)) {
+					aiwfile << '0';
+					continue;
 				}
-				first = false;
+				aiwfile << '\n';
+				break;
 			}
+			first = false;
+		}
 
-			bool skip = false;
-			for (auto it : clocks)
-			{
-				auto val = it.second ? State::S1 : State::S0;
-				SigBit bit = aiw_inputs.at(it.first);
+		bool skip = false;
+		for (auto it : clocks)
+		{
+			auto val = it.second ? State::S1 : State::S0;
+			SigBit bit = aiw_inputs.at(it.first);
+			auto v = current[mapping[bit.wire]].bits.at(bit.offset);
+			if (v == val)
+				skip = true;
+		}
+		if (skip)
+			return;
+		for (int i = 0; i <= max_input; i++)
+		{
+			if (aiw_inputs.count(i)) {
+				SigBit bit = aiw_inputs.at(i);
 				auto v = current[mapping[bit.wire]].bits.at(bit.offset);
-				if (v == val)
-					skip = true;
+				if (v == State::S1)
+					aiwfile << '1';
+				else
+					aiwfile << '0';
+				continue;
 			}
-			if (skip)
+			if (aiw_inits.count(i)) {
+				SigBit bit = aiw_inits.at(i);
+				auto v = current[mapping[bit.wire]].bits.at(bit.offset);
+				if (v == State::S1)
+					aiwfile << '1';
+				else
+					aiwfile << '0';
 				continue;
-			for (int i = 0; i <= max_input; i++)
-			{
-				if (aiw_inputs.count(i)) {
-					SigBit bit = aiw_inputs.at(i);
-					auto v = current[mapping[bit.wire]].bits.at(bit.offset);
-					if (v == State::S1)
-						aiwfile << '1';
-					else
-						aiwfile << '0';
-					continue;
-				}
-				if (aiw_inits.count(i)) {
-					SigBit bit = aiw_inits.at(i);
-					auto v = current[mapping[bit.wire]].bits.at(bit.offset);
-					if (v == State::S1)
-						aiwfile << '1';
-					else
-						aiwfile << '0';
-					continue;
-				}
-				aiwfile << '0';
 			}
-			aiwfile << '\n';
-		} 
+			aiwfile << '0';
+		}
+		aiwfile << '\n';
 	}
 
 	std::ofstream aiwfile;
+	std::map<int, Yosys::RTLIL::Const> current, pending;
+	bool first = true, has_pending = false;
+	int max_input = 0;
 	dict<int, std::pair<SigBit, bool>> aiw_latches;
 	dict<int, SigBit> aiw_inputs, aiw_inits;
 	dict<int, bool> clocks;
 	std::map<Wire*,int> mapping;
 };
 
+// Runs the top module with many independent random stimuli at once. Every
+// net bit holds one value and one undef bit per lane, packed into 64 bit
+// words, so single bit gates are evaluated for 64 lanes with a few bitwise
+// operations. The design must be flat and must not contain memories.
+struct LaneSimWorker
+{
+	SimWorker *worker;
+	Module *module;
+	int lanes, words;
+	uint64_t seed;
+	SigMap sigmap;
+
+	dict<SigBit, int> net_ids;
+	std::vector<SigBit> net_bits;
+	std::vector<uint64_t> net_val, net_undef;
+
+	// A gate is given by the input cubes for which it is 1 and for which it
+	// is 0, each cube literal is 0, 1, 2 (undef) or 3 (any value).
+	struct gate_t
+	{
+		int num_inputs;
+		std::vector<std::array<int, 3>> ones, zeros;
+	};
+
+	struct instr_t
+	{
+		Cell *cell;
+		EvalPattern pattern;
+		const gate_t *gate = nullptr;
+		std::vector<int> ops_a, ops_b, ops_c, ops_y, gate_inputs;
+	};
+
+	struct ff_t
+	{
+		FfData data;
+		std::vector<int> ops_d, ops_q;
+		int op_clk, op_ce, op_srst, op_arst;
+		std::vector<uint64_t> past_d_val, past_d_undef;
+		std::vector<uint64_t> past_clk_val, past_clk_undef, past_ce_val, past_ce_undef, past_srst_val, past_srst_undef;
+	};
+
+	std::map<std::pair<IdString, int>, gate_t> gates;
+	std::vector<instr_t> instrs;
+	std::vector<ff_t> ffs;
+	std::vector<Cell*> formal_cells;
+	std::vector<int> initstate_nets, stimulus_nets;
+	std::vector<uint64_t> rng_state;
+
+	struct lane_event_t
+	{
+		int step;
+		Cell *cell;
+	};
+
+	int step = 0;
+	std::vector<std::vector<lane_event_t>> lane_events;
+
+	std::ofstream vcdfile;
+	std::vector<Wire*> vcd_wires;
+	std::vector<Const> vcd_values;
+
+	LaneSimWorker(SimWorker *worker, Module *module, int lanes, uint64_t seed) :
+			worker(worker), module(module), lanes(lanes), words((lanes + 63) / 64), seed(seed), sigmap(module)
+	{
+		for (auto wire : module->wires())
+			for (auto bit : sigmap(wire))
+				if (net_ids.count(bit) == 0) {
+					net_ids[bit] = GetSize(net_bits);
+					net_bits.push_back(bit);
+				}
+
+		net_val.assign(GetSize(net_bits) * words, 0);
+		net_undef.assign(GetSize(net_bits) * words, ~uint64_t(0));
+		lane_events.resize(lanes);
+
+		for (auto wire : module->wires())
+		{
+			if (!wire->attributes.count(ID::init))
+				continue;
+			SigSpec sig = sigmap(wire);
+			Const initval = wire->attributes.at(ID::init);
+			for (int i = 0; i < GetSize(sig) && i < GetSize(initval); i++)
+				if (sig[i].wire != nullptr && (initval[i] == State::S0 || initval[i] == State::S1))
+					for (int w = 0; w < words; w++)
+						write(net_ids.at(sig[i]), w, initval[i] == State::S1 ? ~uint64_t(0) : 0, 0);
+		}
+
+		setup_cells();
+
+		pool<IdString> driven_ports;
+		for (auto &names : {worker->clock, worker->clockn, worker->reset, worker->resetn})
+			for (auto name : names)
+				driven_ports.insert(name);
+
+		for (auto port : module->ports) {
+			Wire *wire = module->wire(port);
+			if (!wire->port_input || driven_ports.count(wire->name))
+				continue;
+			for (auto bit : sigmap(wire))
+				if (bit.wire != nullptr)
+					stimulus_nets.push_back(net_ids.at(bit));
+		}
+
+		// one generator per word, so that a lane gets the same stimulus
+		// for a given seed no matter how many lanes are simulated
+		for (int w = 0; w < words; w++) {
+			uint64_t state = seed + 0x9e3779b97f4a7c15ULL * (w + 1);
+			state = (state ^ (state >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			state = (state ^ (state >> 27)) * 0x94d049bb133111ebULL;
+			rng_state.push_back((state ^ (state >> 31)) | 1);
+		}
+	}
+
+	int operand(SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return -1 - int(bit.data);
+		return net_ids.at(bit);
+	}
+
+	std::vector<int> operands(const SigSpec &sig)
+	{
+		std::vector<int> ops;
+		for (auto bit : sigmap(sig))
+			ops.push_back(operand(bit));
+		return ops;
+	}
+
+	void read(int op, int w, uint64_t &val, uint64_t &undef) const
+	{
+		if (op >= 0) {
+			val = net_val[op * words + w];
+			undef = net_undef[op * words + w];
+			return;
+		}
+		State state = State(-1 - op);
+		val = state == State::S1 ? ~uint64_t(0) : 0;
+		undef = state == State::S0 || state == State::S1 ? 0 : ~uint64_t(0);
+	}
+
+	bool write(int net, int w, uint64_t val, uint64_t undef)
+	{
+		val &= ~undef;
+		uint64_t &net_v = net_val[net * words + w];
+		uint64_t &net_u = net_undef[net * words + w];
+		if (net_v == val && net_u == undef)
+			return false;
+		net_v = val;
+		net_u = undef;
+		return true;
+	}
+
+	State lane_state(int op, int lane) const
+	{
+		uint64_t val, undef;
+		read(op, lane / 64, val, undef);
+		uint64_t mask = uint64_t(1) << (lane % 64);
+		return (undef & mask) ? State::Sx : (val & mask) ? State::S1 : State::S0;
+	}
+
+	Const lane_value(const std::vector<int> &ops, int lane) const
+	{
+		Const value;
+		for (int op : ops)
+			value.bits.push_back(lane_state(op, lane));
+		return value;
+	}
+
+	void set_lane_state(int net, int lane, State state)
+	{
+		uint64_t mask = uint64_t(1) << (lane % 64);
+		uint64_t &net_v = net_val[net * words + lane / 64];
+		uint64_t &net_u = net_undef[net * words + lane / 64];
+		net_v &= ~mask;
+		net_u &= ~mask;
+		if (state == State::S1)
+			net_v |= mask;
+		else if (state != State::S0)
+			net_u |= mask;
+	}
+
+	uint64_t lane_mask(int w) const
+	{
+		int count = std::min(64, lanes - 64*w);
+		return count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1;
+	}
+
+	// lanes in which the operand is known to be the given value
+	uint64_t known(int op, int w, bool value) const
+	{
+		uint64_t val, undef;
+		read(op, w, val, undef);
+		return ~undef & (value ? val : ~val);
+	}
+
+	const gate_t *get_gate(Cell *cell, const instr_t &instr)
+	{
+		if (!cell->type.begins_with("$_"))
+			return nullptr;
+
+		int num_inputs = GetSize(instr.ops_a) + GetSize(instr.ops_b) + GetSize(instr.ops_c);
+		if (GetSize(instr.ops_a) > 1 || GetSize(instr.ops_b) > 1 || GetSize(instr.ops_c) > 1 || GetSize(instr.ops_y) != 1)
+			return nullptr;
+
+		auto key = std::make_pair(cell->type, num_inputs);
+		auto it = gates.find(key);
+		if (it != gates.end())
+			return &it->second;
+
+		int num_points = 1;
+		for (int i = 0; i < num_inputs; i++)
+			num_points *= 3;
+
+		std::vector<State> table(num_points);
+		for (int index = 0; index < num_points; index++) {
+			Const value_a, value_b, value_c;
+			int digits = index;
+			auto input_state = [&](const std::vector<int> &ops, Const &value) {
+				if (!ops.empty()) {
+					static const State states[3] = {State::S0, State::S1, State::Sx};
+					value = Const(states[digits % 3]);
+					digits /= 3;
+				}
+			};
+			input_state(instr.ops_a, value_a);
+			input_state(instr.ops_b, value_b);
+			input_state(instr.ops_c, value_c);
+			Const value_y = eval_pattern_cell(cell, instr.pattern, value_a, value_b, value_c);
+			if (GetSize(value_y) != 1)
+				return nullptr;
+			table[index] = value_y[0];
+		}
+
+		auto point_index = [&](const std::array<int, 3> &point) {
+			int index = 0;
+			for (int i = num_inputs-1; i >= 0; i--)
+				index = index * 3 + point[i];
+			return index;
+		};
+
+		// all points of a cube give the wanted value
+		std::function<bool(std::array<int, 3>, int, State)> cube_matches = [&](std::array<int, 3> cube, int pos, State value) {
+			if (pos == num_inputs)
+				return table[point_index(cube)] == value;
+			if (cube[pos] != 3)
+				return cube_matches(cube, pos+1, value);
+			for (int lit = 0; lit < 3; lit++) {
+				cube[pos] = lit;
+				if (!cube_matches(cube, pos+1, value))
+					return false;
+			}
+			return true;
+		};
+
+		auto cube_covers = [&](const std::array<int, 3> &cube, const std::array<int, 3> &point) {
+			for (int i = 0; i < num_inputs; i++)
+				if (cube[i] != 3 && cube[i] != point[i])
+					return false;
+			return true;
+		};
+
+		gate_t gate;
+		gate.num_inputs = num_inputs;
+
+		for (State value : {State::S1, State::S0})
+		{
+			auto &cubes = value == State::S1 ? gate.ones : gate.zeros;
+			for (int index = 0; index < num_points; index++) {
+				if (table[index] != value)
+					continue;
+				std::array<int, 3> point = {0, 0, 0};
+				for (int i = 0, digits = index; i < num_inputs; i++, digits /= 3)
+					point[i] = digits % 3;
+				bool covered = false;
+				for (auto &cube : cubes)
+					covered = covered || cube_covers(cube, point);
+				if (covered)
+					continue;
+				std::array<int, 3> cube = point;
+				for (int i = 0; i < num_inputs; i++) {
+					std::array<int, 3> wider = cube;
+					wider[i] = 3;
+					if (cube_matches(wider, 0, value))
+						cube = wider;
+				}
+				cubes.push_back(cube);
+			}
+		}
+
+		return &(gates[key] = gate);
+	}
+
+	void setup_cells()
+	{
+		dict<SigBit, int> driver_count;
+		std::vector<instr_t> candidates;
+
+		for (auto cell : module->cells())
+		{
+			for (auto &conn : cell->connections())
+				if (cell->output(conn.first))
+					for (auto bit : sigmap(conn.second))
+						if (++driver_count[bit] > 1)
+							log_error("Net %s has more than one driver, this is not supported with -lanes.\n", log_signal(bit));
+
+			if (module->design->module(cell->type) != nullptr)
+				log_error("Cell %s.%s is an instance of module %s, run 'flatten' before using -lanes.\n",
+						log_id(module), log_id(cell), log_id(cell->type));
+
+			if (cell->is_mem_cell())
+				log_error("Memory cell %s.%s is not supported with -lanes, run 'memory_map' first.\n", log_id(module), log_id(cell));
+
+			if (cell->type.in(ID($assert), ID($cover), ID($assume))) {
+				formal_cells.push_back(cell);
+				continue;
+			}
+
+			if (cell->type == ID($initstate)) {
+				for (auto bit : sigmap(cell->getPort(ID::Y)))
+					initstate_nets.push_back(net_ids.at(bit));
+				continue;
+			}
+
+			if (cell->type == ID($print)) {
+				log_warning("Ignoring $print cell %s.%s, $print is not supported with -lanes.\n", log_id(module), log_id(cell));
+				continue;
+			}
+
+			if (RTLIL::builtin_ff_cell_types().count(cell->type))
+			{
+				ff_t ff;
+				ff.data = FfData(nullptr, cell);
+				if (ff.data.has_aload || ff.data.has_sr)
+					log_error("Flip-flop %s.%s (%s) has an async load or set/reset input, this is not supported with -lanes.\n",
+							log_id(module), log_id(cell), log_id(cell->type));
+				ff.ops_d = operands(ff.data.sig_d);
+				ff.ops_q = operands(ff.data.sig_q);
+				ff.op_clk = ff.data.has_clk ? operand(sigmap(ff.data.sig_clk)) : 0;
+				ff.op_ce = ff.data.has_ce ? operand(sigmap(ff.data.sig_ce)) : 0;
+				ff.op_srst = ff.data.has_srst ? operand(sigmap(ff.data.sig_srst)) : 0;
+				ff.op_arst = ff.data.has_arst ? operand(sigmap(ff.data.sig_arst)) : 0;
+				for (int op : ff.ops_q)
+					if (op < 0)
+						log_error("Flip-flop %s.%s drives a constant.\n", log_id(module), log_id(cell));
+				ff.past_d_val.assign(GetSize(ff.ops_d) * words, 0);
+				ff.past_d_undef.assign(GetSize(ff.ops_d) * words, ~uint64_t(0));
+				for (auto past : {&ff.past_clk_val, &ff.past_ce_val, &ff.past_srst_val})
+					past->assign(words, 0);
+				for (auto past : {&ff.past_clk_undef, &ff.past_ce_undef, &ff.past_srst_undef})
+					past->assign(words, ~uint64_t(0));
+				ffs.push_back(std::move(ff));
+				continue;
+			}
+
+			EvalPattern pattern = yosys_celltypes.cell_evaluable(cell->type) ? eval_pattern(cell) : EvalPattern::none;
+			if (pattern == EvalPattern::none)
+				log_error("Cell %s.%s of type %s is not supported with -lanes.\n", log_id(module), log_id(cell), log_id(cell->type));
+
+			instr_t instr;
+			instr.cell = cell;
+			instr.pattern = pattern;
+			SigSpec sig_a, sig_b, sig_c;
+			eval_pattern_ports(cell, pattern, sig_a, sig_b, sig_c);
+			instr.ops_a = operands(sig_a);
+			instr.ops_b = operands(sig_b);
+			instr.ops_c = operands(sig_c);
+			instr.ops_y = operands(cell->getPort(ID::Y));
+			for (int op : instr.ops_y)
+				if (op < 0)
+					log_error("Cell %s.%s drives a constant.\n", log_id(module), log_id(cell));
+			candidates.push_back(std::move(instr));
+		}
+
+		if (worker->zinit)
+			for (auto &ff : ffs) {
+				for (auto &word : ff.past_d_undef)
+					word = 0;
+				for (int op : ff.ops_q)
+					for (int w = 0; w < words; w++)
+						write(op, w, net_val[op * words + w], 0);
+			}
+
+		// levelize the combinational cells
+		dict<int, int> net_driver;
+		for (int i = 0; i < GetSize(candidates); i++)
+			for (int op : candidates[i].ops_y)
+				net_driver[op] = i;
+
+		std::vector<int> indegree(GetSize(candidates));
+		std::vector<std::vector<int>> users(GetSize(candidates));
+		for (int i = 0; i < GetSize(candidates); i++) {
+			pool<int> drivers;
+			for (auto ops : {&candidates[i].ops_a, &candidates[i].ops_b, &candidates[i].ops_c})
+				for (int op : *ops) {
+					auto it = net_driver.find(op);
+					if (it != net_driver.end())
+						drivers.insert(it->second);
+				}
+			for (int driver : drivers)
+				users[driver].push_back(i);
+			indegree[i] = GetSize(drivers);
+		}
+
+		std::vector<int> order;
+		for (int i = 0; i < GetSize(candidates); i++)
+			if (indegree[i] == 0)
+				order.push_back(i);
+		for (int k = 0; k < GetSize(order); k++)
+			for (int user : users[order[k]])
+				if (--indegree[user] == 0)
+					order.push_back(user);
+
+		if (GetSize(order) != GetSize(candidates))
+			for (int i = 0; i < GetSize(candidates); i++)
+				if (indegree[i] != 0)
+					log_error("Cell %s.%s is part of or driven by a combinational loop, this is not supported with -lanes.\n",
+							log_id(module), log_id(candidates[i].cell));
+
+		for (int i : order) {
+			instr_t &instr = candidates[i];
+			instr.gate = get_gate(instr.cell, instr);
+			if (instr.gate != nullptr) {
+				instr.gate_inputs = instr.ops_a;
+				instr.gate_inputs.insert(instr.gate_inputs.end(), instr.ops_b.begin(), instr.ops_b.end());
+				instr.gate_inputs.insert(instr.gate_inputs.end(), instr.ops_c.begin(), instr.ops_c.end());
+			}
+			instrs.push_back(std::move(instr));
+		}
+	}
+
+	void eval_instr(const instr_t &instr)
+	{
+		if (instr.gate != nullptr)
+		{
+			const gate_t &gate = *instr.gate;
+			for (int w = 0; w < words; w++) {
+				uint64_t lit_masks[3][4];
+				for (int i = 0; i < gate.num_inputs; i++) {
+					uint64_t val, undef;
+					read(instr.gate_inputs[i], w, val, undef);
+					lit_masks[i][0] = ~val & ~undef;
+					lit_masks[i][1] = val & ~undef;
+					lit_masks[i][2] = undef;
+					lit_masks[i][3] = ~uint64_t(0);
+				}
+				auto eval_cubes = [&](const std::vector<std::array<int, 3>> &cubes) {
+					uint64_t result = 0;
+					for (auto &cube : cubes) {
+						uint64_t term = ~uint64_t(0);
+						for (int i = 0; i < gate.num_inputs; i++)
+							term &= lit_masks[i][cube[i]];
+						result |= term;
+					}
+					return result;
+				};
+				uint64_t ones = eval_cubes(gate.ones);
+				uint64_t zeros = eval_cubes(gate.zeros);
+				write(instr.ops_y[0], w, ones, ~(ones | zeros));
+			}
+			return;
+		}
+
+		for (int lane = 0; lane < lanes; lane++) {
+			Const value = eval_pattern_cell(instr.cell, instr.pattern, lane_value(instr.ops_a, lane),
+					lane_value(instr.ops_b, lane), lane_value(instr.ops_c, lane));
+			log_assert(GetSize(instr.ops_y) <= GetSize(value));
+			for (int i = 0; i < GetSize(instr.ops_y); i++)
+				set_lane_state(instr.ops_y[i], lane, value[i]);
+		}
+	}
+
+	bool update_ffs(bool gclk)
+	{
+		bool did_something = false;
+
+		for (auto &ff : ffs)
+		{
+			FfData &ff_data = ff.data;
+			for (int w = 0; w < words; w++)
+			{
+				uint64_t edge = 0, ce = ~uint64_t(0), srst = 0, arst = 0;
+
+				if (ff_data.has_clk) {
+					uint64_t past_v = ff.past_clk_val[w], past_u = ff.past_clk_undef[w];
+					if (ff_data.pol_clk)
+						edge = (~past_v & ~past_u) & ~known(ff.op_clk, w, false);
+					else
+						edge = (past_v & ~past_u) & ~known(ff.op_clk, w, true);
+				}
+				if (ff_data.has_ce) {
+					uint64_t past_v = ff.past_ce_val[w], past_u = ff.past_ce_undef[w];
+					ce = ~past_u & (ff_data.pol_ce ? past_v : ~past_v);
+				}
+				if (ff_data.has_srst) {
+					uint64_t past_v = ff.past_srst_val[w], past_u = ff.past_srst_undef[w];
+					srst = edge & ~past_u & (ff_data.pol_srst ? past_v : ~past_v);
+					if (ff_data.ce_over_srst)
+						srst &= ce;
+				}
+				if (ff_data.has_arst)
+					arst = known(ff.op_arst, w, ff_data.pol_arst);
+
+				uint64_t load = edge & ce;
+				if (ff_data.has_gclk && gclk)
+					load = ~uint64_t(0);
+
+				for (int i = 0; i < GetSize(ff.ops_q); i++) {
+					uint64_t val, undef;
+					read(ff.ops_q[i], w, val, undef);
+					uint64_t d_val = ff.past_d_val[i * words + w], d_undef = ff.past_d_undef[i * words + w];
+					val = (val & ~load) | (d_val & load);
+					undef = (undef & ~load) | (d_undef & load);
+					auto force = [&](uint64_t mask, State state) {
+						val = (val & ~mask) | (state == State::S1 ? mask : 0);
+						undef = (undef & ~mask) | (state == State::S0 || state == State::S1 ? 0 : mask);
+					};
+					if (ff_data.has_srst)
+						force(srst, ff_data.val_srst[i]);
+					if (ff_data.has_arst)
+						force(arst, ff_data.val_arst[i]);
+					if (ff_data.has_gclk && gclk) {
+						val = d_val;
+						undef = d_undef;
+					}
+					if (write(ff.ops_q[i], w, val, undef))
+						did_something = true;
+				}
+			}
+		}
+
+		return did_something;
+	}
+
+	void capture_past()
+	{
+		for (auto &ff : ffs)
+			for (int w = 0; w < words; w++) {
+				if (ff.data.has_clk || ff.data.has_gclk)
+					for (int i = 0; i < GetSize(ff.ops_d); i++)
+						read(ff.ops_d[i], w, ff.past_d_val[i * words + w], ff.past_d_undef[i * words + w]);
+				if (ff.data.has_clk)
+					read(ff.op_clk, w, ff.past_clk_val[w], ff.past_clk_undef[w]);
+				if (ff.data.has_ce)
+					read(ff.op_ce, w, ff.past_ce_val[w], ff.past_ce_undef[w]);
+				if (ff.data.has_srst)
+					read(ff.op_srst, w, ff.past_srst_val[w], ff.past_srst_undef[w]);
+			}
+	}
+
+	void check_formal()
+	{
+		for (auto cell : formal_cells)
+		{
+			string label = log_id(cell);
+			if (cell->attributes.count(ID::src))
+				label = cell->attributes.at(ID::src).decode_string();
+
+			int op_a = operand(sigmap(cell->getPort(ID::A).as_bit()));
+			int op_en = operand(sigmap(cell->getPort(ID::EN).as_bit()));
+
+			std::vector<int> triggered;
+			for (int w = 0; w < words; w++) {
+				uint64_t a = known(op_a, w, true);
+				uint64_t mask = known(op_en, w, true) & (cell->type == ID($cover) ? a : ~a) & lane_mask(w);
+				for (int bit = 0; bit < 64; bit++)
+					if (mask & (uint64_t(1) << bit))
+						triggered.push_back(64*w + bit);
+			}
+
+			if (triggered.empty())
+				continue;
+
+			std::string lane_list;
+			for (int lane : triggered) {
+				lane_events[lane].push_back({step, cell});
+				lane_list += stringf("%s%d", lane_list.empty() ? "" : " ", lane);
+			}
+
+			if (cell->type == ID($cover))
+				log("Cover %s.%s (%s) reached in lanes %s.\n", log_id(module), log_id(cell), label.c_str(), lane_list.c_str());
+
+			if (cell->type == ID($assume))
+				log("Assumption %s.%s (%s) failed in lanes %s.\n", log_id(module), log_id(cell), label.c_str(), lane_list.c_str());
+
+			if (cell->type == ID($assert)) {
+				if (worker->serious_asserts)
+					log_error("Assertion %s.%s (%s) failed in lanes %s.\n", log_id(module), log_id(cell), label.c_str(), lane_list.c_str());
+				else
+					log_warning("Assertion %s.%s (%s) failed in lanes %s.\n", log_id(module), log_id(cell), label.c_str(), lane_list.c_str());
+			}
+		}
+	}
+
+	void update(bool gclk)
+	{
+		if (gclk)
+			step += 1;
+
+		while (1)
+		{
+			for (auto &instr : instrs)
+				eval_instr(instr);
+
+			if (!update_ffs(gclk))
+				break;
+		}
+
+		capture_past();
+
+		if (gclk)
+			check_formal();
+	}
+
+	void set_ports(const pool<IdString> &ports, State value)
+	{
+		for (auto portname : ports)
+		{
+			Wire *wire = module->wire(portname);
+
+			if (wire == nullptr)
+				log_error("Can't find port %s on module %s.\n", log_id(portname), log_id(module));
+
+			for (auto bit : sigmap(wire))
+				if (bit.wire != nullptr)
+					for (int w = 0; w < words; w++)
+						write(net_ids.at(bit), w, value == State::S1 ? ~uint64_t(0) : 0,
+								value == State::S0 || value == State::S1 ? 0 : ~uint64_t(0));
+		}
+	}
+
+	void set_initstate(State value)
+	{
+		for (int net : initstate_nets)
+			for (int w = 0; w < words; w++)
+				write(net, w, value == State::S1 ? ~uint64_t(0) : 0, 0);
+	}
+
+	void randomize_inputs()
+	{
+		for (int net : stimulus_nets)
+			for (int w = 0; w < words; w++) {
+				uint64_t &state = rng_state[w];
+				state ^= state << 13;
+				state ^= state >> 7;
+				state ^= state << 17;
+				write(net, w, state, 0);
+			}
+	}
+
+	void write_vcd_header(const std::string &filename)
+	{
+		vcdfile.open(filename.c_str());
+		if (!vcdfile.is_open())
+			log_error("Can't open file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+
+#ifdef HYBRDLINK
+		vcdfile << stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Synthesizer");
+#else
+		vcdfile << stringf("$version %s $end\n", worker->date ? "zs yosys 0.0.1" : "Yosys");
+#endif // HYBRDLINK
+
+		if (worker->date) {
+			std::time_t t = std::time(nullptr);
+			char mbstr[255];
+			if (std::strftime(mbstr, sizeof(mbstr), "%c", std::localtime(&t))) {
+				vcdfile << stringf("$date ") << mbstr << stringf(" $end\n");
+			}
+		}
+
+		if (!worker->timescale.empty())
+			vcdfile << stringf("$timescale %s $end\n", worker->timescale.c_str());
+
+		for (auto wire : module->wires())
+			if (!(worker->hide_internal && wire->name[0] == '$'))
+				vcd_wires.push_back(wire);
+		vcd_values.resize(lanes * GetSize(vcd_wires));
+
+		vcdfile << stringf("$scope module %s $end\n", log_id(module));
+		for (int lane = 0; lane < lanes; lane++) {
+			vcdfile << stringf("$scope module lane%d $end\n", lane);
+			for (int i = 0; i < GetSize(vcd_wires); i++) {
+				const char *name = log_id(vcd_wires[i]);
+				std::string range = strchr(name, '[') ? stringf("[%d:0]", GetSize(vcd_wires[i]) - 1) : std::string();
+				vcdfile << stringf("$var wire %d n%d %s%s%s $end\n", GetSize(vcd_wires[i]), lane * GetSize(vcd_wires) + i + 1,
+						name[0] == '$' ? "\\" : "", name, range.c_str());
+			}
+			vcdfile << stringf("$upscope $end\n");
+		}
+		vcdfile << stringf("$upscope $end\n");
+		vcdfile << stringf("$enddefinitions $end\n");
+	}
+
+	void write_vcd_step(int t)
+	{
+		if (!vcdfile.is_open())
+			return;
+
+		vcdfile << stringf("#%d\n", t);
+		for (int lane = 0; lane < lanes; lane++)
+			for (int i = 0; i < GetSize(vcd_wires); i++) {
+				std::vector<int> ops;
+				for (auto bit : sigmap(vcd_wires[i]))
+					ops.push_back(operand(bit));
+				Const value = lane_value(ops, lane);
+				Const &last = vcd_values[lane * GetSize(vcd_wires) + i];
+				if (value == last)
+					continue;
+				last = value;
+				vcdfile << "b";
+				for (int k = GetSize(value)-1; k >= 0; k--)
+					vcdfile << (value[k] == State::S0 ? "0" : value[k] == State::S1 ? "1" : "x");
+				vcdfile << stringf(" n%d\n", lane * GetSize(vcd_wires) + i + 1);
+			}
+	}
+
+	void run(int numcycles, const std::string &vcd_filename)
+	{
+		log("Simulating %d lanes with seed %llu.\n", lanes, (unsigned long long)seed);
+
+		if (!vcd_filename.empty())
+			write_vcd_header(vcd_filename);
+
+		if (worker->verbose)
+			log("Simulating cycle 0.\n");
+
+		set_ports(worker->reset, State::S1);
+		set_ports(worker->resetn, State::S0);
+
+		set_ports(worker->clock, State::Sx);
+		set_ports(worker->clockn, State::Sx);
+
+		set_initstate(worker->initstate ? State::S1 : State::S0);
+		randomize_inputs();
+
+		update(false);
+		write_vcd_step(0);
+
+		for (int cycle = 0; cycle < numcycles; cycle++)
+		{
+			if (worker->verbose)
+				log("Simulating cycle %d.\n", (cycle*2)+1);
+			set_ports(worker->clock, State::S0);
+			set_ports(worker->clockn, State::S1);
+			randomize_inputs();
+
+			update(true);
+			write_vcd_step(10*cycle + 5);
+
+			if (cycle == 0)
+				set_initstate(State::S0);
+
+			if (worker->verbose)
+				log("Simulating cycle %d.\n", (cycle*2)+2);
+
+			set_ports(worker->clock, State::S1);
+			set_ports(worker->clockn, State::S0);
+
+			if (cycle+1 == worker->rstlen) {
+				set_ports(worker->reset, State::S0);
+				set_ports(worker->resetn, State::S1);
+			}
+
+			update(true);
+			write_vcd_step(10*cycle + 10);
+		}
+
+		write_vcd_step(10*numcycles + 2);
+
+		int failing_lanes = 0;
+		for (auto &events : lane_events) {
+			for (auto &event : events)
+				if (event.cell->type == ID($assert)) {
+					failing_lanes++;
+					break;
+				}
+		}
+		log("Assertions failed in %d of %d lanes.\n", failing_lanes, lanes);
+	}
+
+	void write_summary(const std::string &filename)
+	{
+		if (filename.empty())
+			return;
+
+		PrettyJson json;
+		if (!json.write_to_file(filename))
+			log_error("Can't open file `%s' for writing: %s\n", filename.c_str(), strerror(errno));
+
+		json.begin_object();
+#ifdef HYBRDLINK
+		json.entry("version", "Synthesizer sim summary");
+#else
+		json.entry("version", "Yosys sim summary");
+#endif // HYBRDLINK
+		json.entry("steps", step);
+		json.entry("top", log_id(module->name));
+		json.entry("seed", stringf("%llu", (unsigned long long)seed));
+		json.name("lanes");
+		json.begin_array();
+		for (int lane = 0; lane < lanes; lane++) {
+			json.begin_object();
+			json.entry("lane", lane);
+			json.name("assertions");
+			json.begin_array();
+			for (auto &event : lane_events[lane]) {
+				json.begin_object();
+				json.entry("step", event.step);
+				json.entry("type", log_id(event.cell->type));
+				json.entry("path", witness_path(event.cell));
+				auto src = event.cell->get_string_attribute(ID::src);
+				if (!src.empty()) {
+					json.entry("src", src);
+				}
+				json.end_object();
+			}
+			json.end_array();
+			json.end_object();
+		}
+		json.end_array();
+		json.end_object();
+	}
+};
+
 struct SimPass : public Pass {
 	SimPass() : Pass("sim", "simulate the circuit") { }
 	void help() override
@@ -2619,11 +4231,28 @@ struct SimPass : public Pass {
 		log("This command simulates the circuit using the given top-level module.\n");
 		log("\n");
 		log("    -vcd <filename>\n");
-		log("        write the simulation results to the given VCD file\n");
+		log("        write the simulation results to the given VCD file, gzip compressed\n");
+		log("        if the file name ends in .gz\n");
 		log("\n");
 		log("    -fst <filename>\n");
 		log("        write the simulation results to the given FST file\n");
 		log("\n");
+		log("    -fst-pack <zlib|fastlz|lz4>\n");
+		log("        compression of the FST value change blocks (default: fastlz)\n");
+		log("\n");
+		log("    -fst-blocksize <bytes>\n");
+		log("        start a new FST value change block after about this many bytes of\n");
+		log("        value changes. by default a block is written with every batch of\n");
+		log("        steps (see -buffer)\n");
+		log("\n");
+		log("    -fst-parallel\n");
+		log("        compress and write the FST blocks on a separate thread\n");
+		log("\n");
+		log("    -fst-repack\n");
+		log("        recompress the whole FST file when it is closed. this is the default\n");
+		log("        when all steps are written at the end (-buffer 0 or -x), the file is\n");
+		log("        not repacked when it is written in batches.\n");
+		log("\n");
 		log("    -aiw <filename>\n");
 		log("        write the simulation results to an AIGER witness file\n");
 		log("        (requires a *.aim file via -map)\n");
@@ -2633,7 +4262,14 @@ struct SimPass : public Pass {
 		log("        (preserves hierarchy in a flattened design)\n");
 		log("\n");
 		log("    -x\n");
-		log("        ignore constant x outputs in simulation file.\n");
+		log("        ignore constant x outputs in simulation file. this needs all recorded\n");
+		log("        steps, so the output files are only written at the end.\n");
+		log("\n");
+		log("    -buffer <integer>\n");
+		log("        number of recorded steps kept in memory before they are written to the\n");
+		log("        VCD/FST/AIW files. the headers are written with the first batch, memory\n");
+		log("        words first accessed after that are not traced. 0 writes everything at\n");
+		log("        the end of the simulation (default: 1024)\n");
 		log("\n");
 		log("    -date\n");
 		log("        include date and full version info in output.\n");
@@ -2659,6 +4295,30 @@ struct SimPass : public Pass {
 		log("    -zinit\n");
 		log("        zero-initialize all uninitialized regs and memories\n");
 		log("\n");
+		log("    -compiled\n");
+		log("        levelize the combinational cells of each module once and run them as a\n");
+		log("        flat instruction list instead of interpreting them cell by cell. the\n");
+		log("        results are the same. combinational loops and cells that share an\n");
+		log("        output net with other drivers are still interpreted. ignored with -d.\n");
+		log("\n");
+		log("    -lanes <integer>\n");
+		log("        simulate the given number of independent random stimuli at once. each\n");
+		log("        signal bit holds one value per lane, packed 64 lanes to a machine word.\n");
+		log("        all top-level inputs except clocks and resets get random values at the\n");
+		log("        start and at every falling clock edge. requires a flat design without\n");
+		log("        memories or combinational loops, -vcd writes one scope per lane and\n");
+		log("        -summary lists the triggered assertions per lane. can not be used\n");
+		log("        together with -r, -fst, -aiw or -w.\n");
+		log("\n");
+		log("    -seed <integer>\n");
+		log("        seed for the random stimuli of -lanes. a lane gets the same stimulus for\n");
+		log("        a given seed, independent of the number of lanes (default: 1)\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        evaluate independent instances of the hierarchy on up to <num> threads.\n");
+		log("        the results do not depend on the number of threads. ignored with -d.\n");
+		log("        the default is the -j value synthesizer runs with.\n");
+		log("\n");
 		log("    -timescale <string>\n");
 		log("        include the specified timescale declaration in the vcd\n");
 		log("\n");
@@ -2735,6 +4395,11 @@ struct SimPass : public Pass {
 		SimWorker worker;
 		int numcycles = 20;
 		int append = 0;
+		int lanes = 0;
+		uint64_t seed = 1;
+		worker.jobs = yosys_parallel_jobs;
+		std::string lanes_vcd_filename;
+		bool lanes_other_outputs = false;
 		bool start_set = false, stop_set = false, at_set = false;
 
 		log_header(design, "Executing SIM pass (simulate the circuit).\n");
@@ -2745,18 +4410,21 @@ struct SimPass : public Pass {
 				std::string vcd_filename = args[++argidx];
 				rewrite_filename(vcd_filename);
 				worker.outputfiles.emplace_back(std::unique_ptr<VCDWriter>(new VCDWriter(&worker, vcd_filename.c_str())));
+				lanes_vcd_filename = vcd_filename;
 				continue;
 			}
 			if (args[argidx] == "-fst" && argidx+1 < args.size()) {
 				std::string fst_filename = args[++argidx];
 				rewrite_filename(fst_filename);
 				worker.outputfiles.emplace_back(std::unique_ptr<FSTWriter>(new FSTWriter(&worker, fst_filename.c_str())));
+				lanes_other_outputs = true;
 				continue;
 			}
 			if (args[argidx] == "-aiw" && argidx+1 < args.size()) {
 				std::string aiw_filename = args[++argidx];
 				rewrite_filename(aiw_filename);
 				worker.outputfiles.emplace_back(std::unique_ptr<AIWWriter>(new AIWWriter(&worker, aiw_filename.c_str())));
+				lanes_other_outputs = true;
 				continue;
 			}
 			if (args[argidx] == "-hdlname") {
@@ -2816,6 +4484,26 @@ struct SimPass : public Pass {
 				worker.zinit = true;
 				continue;
 			}
+			if (args[argidx] == "-compiled") {
+				worker.compiled = true;
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				worker.jobs = atoi(args[++argidx].c_str());
+				if (worker.jobs < 1)
+					log_cmd_error("Invalid -j argument: %s\n", args[argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-lanes" && argidx+1 < args.size()) {
+				lanes = atoi(args[++argidx].c_str());
+				if (lanes < 1)
+					log_cmd_error("Invalid -lanes argument: %s\n", args[argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-seed" && argidx+1 < args.size()) {
+				seed = strtoull(args[++argidx].c_str(), nullptr, 0);
+				continue;
+			}
 			if (args[argidx] == "-r" && argidx+1 < args.size()) {
 				std::string sim_filename = args[++argidx];
 				rewrite_filename(sim_filename);
@@ -2882,6 +4570,43 @@ struct SimPass : public Pass {
 				worker.ignore_x = true;
 				continue;
 			}
+			if (args[argidx] == "-fst-pack" && argidx+1 < args.size()) {
+				std::string pack = args[++argidx];
+				if (pack == "zlib")
+					worker.fst_pack_type = FST_WR_PT_ZLIB;
+				else if (pack == "fastlz")
+					worker.fst_pack_type = FST_WR_PT_FASTLZ;
+				else if (pack == "lz4")
+					worker.fst_pack_type = FST_WR_PT_LZ4;
+				else
+					log_cmd_error("Invalid -fst-pack argument: %s\n", pack.c_str());
+				continue;
+			}
+			if (args[argidx] == "-fst-blocksize" && argidx+1 < args.size()) {
+				worker.fst_block_size = atoll(args[++argidx].c_str());
+				if (worker.fst_block_size < 1)
+					log_cmd_error("Invalid -fst-blocksize argument: %s\n", args[argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-fst-parallel") {
+				// same condition as FST_WRITER_PARALLEL in libs/fst/config.h
+#if defined(YOSYS_ENABLE_THREADS) && !defined(_MSC_VER)
+				worker.fst_parallel = true;
+#else
+				log_cmd_error("Option -fst-parallel requires a build with thread support.\n");
+#endif
+				continue;
+			}
+			if (args[argidx] == "-fst-repack") {
+				worker.fst_repack = true;
+				continue;
+			}
+			if (args[argidx] == "-buffer" && argidx+1 < args.size()) {
+				worker.output_buffer = atoi(args[++argidx].c_str());
+				if (worker.output_buffer < 0)
+					log_cmd_error("Invalid -buffer argument: %s\n", args[argidx].c_str());
+				continue;
+			}
 			if (args[argidx] == "-date") {
 				worker.date = true;
 				continue;
@@ -2912,6 +4637,17 @@ struct SimPass : public Pass {
 			top_mod = mods.front();
 		}
 
+		if (lanes > 0) {
+			if (!worker.sim_filename.empty() || lanes_other_outputs || worker.writeback)
+				log_cmd_error("Option -lanes can not be used together with -r, -fst, -aiw or -w.\n");
+			// the lane engine writes its own VCD file
+			worker.outputfiles.clear();
+			LaneSimWorker lane_worker(&worker, top_mod, lanes, seed);
+			lane_worker.run(numcycles, lanes_vcd_filename);
+			lane_worker.write_summary(worker.summary_filename);
+			return;
+		}
+
 		if (worker.sim_filename.empty())
 			worker.run(top_mod, numcycles);
 		else {
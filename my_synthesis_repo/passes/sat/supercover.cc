@@ -19,10 +19,77 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/qcsat.h"
+#include "kernel/json.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+struct CoverCheckResult
+{
+	int cnt_bits = 0, cnt_sim = 0, cnt_sat = 0;
+	// bits with a hi (true) or lo (false) level that can never be reached
+	std::vector<std::pair<SigBit, bool>> unreachable;
+};
+
+void check_covers(RTLIL::Module *module, CoverCheckResult &result)
+{
+	ModWalker modwalker(module->design, module);
+	QuickConeSat qcsat(modwalker);
+	qcsat.max_cell_complexity = 4;
+
+	pool<SigBit> handled_bits;
+	std::vector<SigBit> bits;
+	for (auto wire : module->selected_wires())
+		for (auto bit : modwalker.sigmap(SigSpec(wire)))
+			if (bit.wire != nullptr && handled_bits.insert(bit).second)
+				bits.push_back(bit);
+
+	// seen hi and lo level of each bit, discharged by simulation first
+	std::vector<bool> seen_hi(GetSize(bits)), seen_lo(GetSize(bits));
+	int cnt_open = GetSize(bits);
+	for (int round = 0; round < 4 && cnt_open > 0; round++)
+	{
+		QuickConeSim qcsim(qcsat, round + 1);
+		qcsim.run();
+		if (qcsim.valid_patterns == 0)
+			break;
+
+		cnt_open = 0;
+		for (int i = 0; i < GetSize(bits); i++) {
+			uint64_t patterns;
+			if (qcsim.get(bits[i], patterns)) {
+				if (patterns & qcsim.valid_patterns)
+					seen_hi[i] = true;
+				if (~patterns & qcsim.valid_patterns)
+					seen_lo[i] = true;
+			}
+			if (!seen_hi[i] || !seen_lo[i])
+				cnt_open++;
+		}
+	}
+
+	// the remaining levels share one incremental solver for the module
+	for (int i = 0; i < GetSize(bits); i++)
+	{
+		result.cnt_bits++;
+		if (seen_hi[i] && seen_lo[i]) {
+			result.cnt_sim++;
+			continue;
+		}
+
+		int lit = qcsat.importSigBit(bits[i]);
+		qcsat.prepare();
+		if (!seen_hi[i] && !qcsat.ez->solve(lit))
+			result.unreachable.push_back({bits[i], true});
+		else if (!seen_lo[i] && !qcsat.ez->solve(qcsat.ez->NOT(lit)))
+			result.unreachable.push_back({bits[i], false});
+		else
+			result.cnt_sat++;
+	}
+}
+
 struct SupercoverPass : public Pass {
 	SupercoverPass() : Pass("supercover", "add hi/lo cover cells for each wire bit") { }
 	void help() override
@@ -37,21 +104,84 @@ struct SupercoverPass : public Pass {
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
-		// bool flag_noinit = false;
+		bool flag_check = false;
+		std::string json_filename;
 
 		log_header(design, "Executing SUPERCOVER pass.\n");
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++)
 		{
-			// if (args[argidx] == "-noinit") {
-			// 	flag_noinit = true;
-			// 	continue;
-			// }
+			if (args[argidx] == "-check") {
+				flag_check = true;
+				continue;
+			}
+			if (args[argidx] == "-json" && argidx+1 < args.size()) {
+				json_filename = args[++argidx];
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (!json_filename.empty() && !flag_check)
+			log_cmd_error("Option -json requires -check.\n");
+
+		if (flag_check)
+		{
+			std::vector<RTLIL::Module*> modules = design->selected_modules();
+			std::vector<CoverCheckResult> results(GetSize(modules));
+			dict<RTLIL::Module*, int> module_index;
+			for (int i = 0; i < GetSize(modules); i++)
+				module_index[modules[i]] = i;
+
+			parallel_for_modules(design, modules, [&](RTLIL::Module *module) {
+				check_covers(module, results[module_index.at(module)]);
+			});
+
+			PrettyJson json;
+			if (!json_filename.empty()) {
+				if (!json.write_to_file(json_filename))
+					log_error("Can't open file `%s' for writing: %s\n", json_filename.c_str(), strerror(errno));
+				json.begin_object();
+				json.name("modules");
+				json.begin_object();
+			}
+
+			for (int i = 0; i < GetSize(modules); i++)
+			{
+				auto &result = results[i];
+				log("Checked covers of %d bits in module %s: %d by simulation, %d by SAT, %d unreachable.\n",
+						result.cnt_bits, log_id(modules[i]), result.cnt_sim, result.cnt_sat, GetSize(result.unreachable));
+				for (auto &it : result.unreachable)
+					log("  %s cover for %s cannot be reached.\n", it.second ? "hi" : "lo", log_signal(it.first));
+
+				if (!json.active())
+					continue;
+				json.name(log_id(modules[i]));
+				json.begin_object();
+				json.entry("bits", result.cnt_bits);
+				json.entry("simulated", result.cnt_sim);
+				json.entry("solved", result.cnt_sat);
+				json.name("unreachable");
+				json.begin_array();
+				for (auto &it : result.unreachable) {
+					json.begin_object();
+					json.entry("signal", log_signal(it.first));
+					json.entry("level", it.second ? "hi" : "lo");
+					json.end_object();
+				}
+				json.end_array();
+				json.end_object();
+			}
+
+			if (json.active()) {
+				json.end_object();
+				json.end_object();
+			}
+			return;
+		}
+
 		for (auto module : design->selected_modules())
 		{
 			SigMap sigmap(module);
@@ -78,7 +208,7 @@ struct SupercoverPass : public Pass {
 
 					handled_bits.insert(bit);
 					if (!counted_wire) {
-						counted_wire = false;
+						counted_wire = true;
 						cnt_wire++;
 					}
 					cnt_bits++;
@@ -48,6 +48,8 @@
 #include "kernel/ff.h"
 #include "kernel/cost.h"
 #include "kernel/log.h"
+#include "kernel/tracing.h"
+#include "kernel/threading.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -63,11 +65,12 @@
 #endif
 
 #include "frontends/blif/blifparse.h"
+#include "passes/techmap/abc_link.h"
+#include "passes/techmap/abc_cache.h"
 
-#ifdef YOSYS_LINK_ABC
-namespace abc {
-	int Abc_RealMain(int argc, char *argv[]);
-}
+// ABC hands output.blif back through a pipe instead of the temp dir
+#if !defined(YOSYS_LINK_ABC) && !defined(_WIN32) && !defined(__wasm)
+#  define ABC_OUTPUT_CHANNEL
 #endif
 
 USING_YOSYS_NAMESPACE
@@ -129,6 +132,130 @@ dict<int, std::string> pi_map, po_map;
 
 int undef_bits_lost;
 
+// all of the file-scope state above. In server mode other jobs may run abc
+// while this one waits for ABC, so it is set aside for the duration of the
+// ABC run and restored afterwards.
+struct abc_pass_state_t
+{
+	bool map_mux4 = false, map_mux8 = false, map_mux16 = false;
+	bool markgroups = false;
+	int map_autoidx = 0;
+	SigMap assign_map;
+	RTLIL::Module *module = nullptr;
+	std::vector<gate_t> signal_list;
+	dict<RTLIL::SigBit, int> signal_map;
+	dict<SigBit, std::pair<State,SigBit>> initbits;
+	pool<std::string> enabled_gates;
+	bool cmos_cost = false;
+	bool had_init = false;
+	bool clk_polarity = false, en_polarity = false, arst_polarity = false, srst_polarity = false;
+	RTLIL::SigSpec clk_sig, en_sig, arst_sig, srst_sig;
+	dict<int, std::string> pi_map, po_map;
+	int undef_bits_lost = 0;
+
+	// exchanges the contents with the globals; initvals keeps pointing to
+	// the global assign_map
+	void swap()
+	{
+		std::swap(this->map_mux4, ::map_mux4);
+		std::swap(this->map_mux8, ::map_mux8);
+		std::swap(this->map_mux16, ::map_mux16);
+		std::swap(this->markgroups, ::markgroups);
+		std::swap(this->map_autoidx, ::map_autoidx);
+		this->assign_map.swap(::assign_map);
+		std::swap(this->module, ::module);
+		this->signal_list.swap(::signal_list);
+		this->signal_map.swap(::signal_map);
+		this->initbits.swap(::initvals.initbits);
+		this->enabled_gates.swap(::enabled_gates);
+		std::swap(this->cmos_cost, ::cmos_cost);
+		std::swap(this->had_init, ::had_init);
+		std::swap(this->clk_polarity, ::clk_polarity);
+		std::swap(this->en_polarity, ::en_polarity);
+		std::swap(this->arst_polarity, ::arst_polarity);
+		std::swap(this->srst_polarity, ::srst_polarity);
+		std::swap(this->clk_sig, ::clk_sig);
+		std::swap(this->en_sig, ::en_sig);
+		std::swap(this->arst_sig, ::arst_sig);
+		std::swap(this->srst_sig, ::srst_sig);
+		this->pi_map.swap(::pi_map);
+		this->po_map.swap(::po_map);
+		std::swap(this->undef_bits_lost, ::undef_bits_lost);
+	}
+};
+
+// lets other server jobs run while ABC runs, with the state of this pass
+// set aside in the meantime
+struct abc_yield_scope_t
+{
+	abc_pass_state_t saved;
+	JobYieldScope yield;
+
+	abc_yield_scope_t() { saved.swap(); }
+	~abc_yield_scope_t() { saved.swap(); }
+};
+
+// the state of one ABC invocation between extraction, the ABC run and the
+// re-integration of its results, so that several of them can be in flight
+struct abc_job_t
+{
+	RTLIL::Module *module;
+	int map_autoidx;
+	std::string tempdir_name;
+	std::vector<gate_t> signal_list;
+	dict<int, std::string> pi_map, po_map;
+	bool clk_polarity, en_polarity, arst_polarity, srst_polarity;
+	RTLIL::SigSpec clk_sig, en_sig, arst_sig, srst_sig;
+	bool had_init;
+	int count_output;
+	std::string abc_script, abc_command;
+	std::vector<std::string> abc_argv;
+	bool output_channel;
+	std::string output_data;
+	AbcResultCache cache;
+};
+
+void save_abc_job(abc_job_t &job)
+{
+	job.module = module;
+	job.map_autoidx = map_autoidx;
+	job.signal_list = std::move(signal_list);
+	job.pi_map = std::move(pi_map);
+	job.po_map = std::move(po_map);
+	job.clk_polarity = clk_polarity;
+	job.en_polarity = en_polarity;
+	job.arst_polarity = arst_polarity;
+	job.srst_polarity = srst_polarity;
+	job.clk_sig = clk_sig;
+	job.en_sig = en_sig;
+	job.arst_sig = arst_sig;
+	job.srst_sig = srst_sig;
+	job.had_init = had_init;
+
+	signal_list.clear();
+	signal_map.clear();
+	pi_map.clear();
+	po_map.clear();
+}
+
+void load_abc_job(abc_job_t &job)
+{
+	module = job.module;
+	map_autoidx = job.map_autoidx;
+	signal_list = std::move(job.signal_list);
+	pi_map = std::move(job.pi_map);
+	po_map = std::move(job.po_map);
+	clk_polarity = job.clk_polarity;
+	en_polarity = job.en_polarity;
+	arst_polarity = job.arst_polarity;
+	srst_polarity = job.srst_polarity;
+	clk_sig = job.clk_sig;
+	en_sig = job.en_sig;
+	arst_sig = job.arst_sig;
+	srst_sig = job.srst_sig;
+	had_init = job.had_init;
+}
+
 int map_signal(RTLIL::SigBit bit, gate_type_t gate_type = G(NONE), int in1 = -1, int in2 = -1, int in3 = -1, int in4 = -1)
 {
 	assign_map.apply(bit);
@@ -177,7 +304,7 @@ void mark_port(RTLIL::SigSpec sig)
 void extract_cell(RTLIL::Cell *cell, bool keepff)
 {
 	if (RTLIL::builtin_ff_cell_types().count(cell->type)) {
-		FfData ff(&initvals, cell);
+		FfView ff(cell);
 		gate_type_t type = G(FF);
 		if (!ff.has_clk)
 			return;
@@ -191,34 +318,35 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 			return;
 		if (clk_polarity != ff.pol_clk)
 			return;
-		if (clk_sig != assign_map(ff.sig_clk))
+		if (clk_sig != assign_map(ff.sig_clk()))
 			return;
 		if (ff.has_ce) {
 			if (en_polarity != ff.pol_ce)
 				return;
-			if (en_sig != assign_map(ff.sig_ce))
+			if (en_sig != assign_map(ff.sig_ce()))
 				return;
 		} else {
 			if (GetSize(en_sig) != 0)
 				return;
 		}
-		if (ff.val_init == State::S1) {
+		State val_init = initvals(ff.sig_q()[0]);
+		if (val_init == State::S1) {
 			type = G(FF1);
 			had_init = true;
-		} else if (ff.val_init == State::S0) {
+		} else if (val_init == State::S0) {
 			type = G(FF0);
 			had_init = true;
 		}
 		if (ff.has_arst) {
 			if (arst_polarity != ff.pol_arst)
 				return;
-			if (arst_sig != assign_map(ff.sig_arst))
+			if (arst_sig != assign_map(ff.sig_arst()))
 				return;
-			if (ff.val_arst == State::S1) {
+			if (ff.val_arst_bit(0) == State::S1) {
 				if (type == G(FF0))
 					return;
 				type = G(FF1);
-			} else if (ff.val_arst == State::S0) {
+			} else if (ff.val_arst_bit(0) == State::S0) {
 				if (type == G(FF1))
 					return;
 				type = G(FF0);
@@ -230,13 +358,13 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 		if (ff.has_srst) {
 			if (srst_polarity != ff.pol_srst)
 				return;
-			if (srst_sig != assign_map(ff.sig_srst))
+			if (srst_sig != assign_map(ff.sig_srst()))
 				return;
-			if (ff.val_srst == State::S1) {
+			if (ff.val_srst_bit(0) == State::S1) {
 				if (type == G(FF0))
 					return;
 				type = G(FF1);
-			} else if (ff.val_srst == State::S0) {
+			} else if (ff.val_srst_bit(0) == State::S0) {
 				if (type == G(FF1))
 					return;
 				type = G(FF0);
@@ -247,13 +375,13 @@ void extract_cell(RTLIL::Cell *cell, bool keepff)
 		}
 
 		if (keepff)
-			for (auto &c : ff.sig_q.chunks())
+			for (auto &c : ff.sig_q().chunks())
 				if (c.wire != nullptr)
 					c.wire->attributes[ID::keep] = 1;
 
-		map_signal(ff.sig_q, type, map_signal(ff.sig_d));
+		map_signal(ff.sig_q(), type, map_signal(ff.sig_d()));
 
-		ff.remove();
+		FfData(&initvals, cell).remove();
 		return;
 	}
 
@@ -660,8 +788,10 @@ struct abc_output_filter
 	std::string linebuf;
 	std::string tempdir_name;
 	bool show_tempdir;
+	const dict<int, std::string> *pi_map, *po_map;
 
-	abc_output_filter(std::string tempdir_name, bool show_tempdir) : tempdir_name(tempdir_name), show_tempdir(show_tempdir)
+	abc_output_filter(const abc_job_t &job, bool show_tempdir) : tempdir_name(job.tempdir_name), show_tempdir(show_tempdir),
+			pi_map(&job.pi_map), po_map(&job.po_map)
 	{
 		got_cr = false;
 		escape_seq_state = 0;
@@ -709,8 +839,8 @@ struct abc_output_filter
 		if (sscanf(line.c_str(), "Start-point = pi%d.  End-point = po%d.", &pi, &po) == 2) {
 #ifndef HYBRDLINK
 			log("ABC: Start-point = pi%d (%s).  End-point = po%d (%s).\n",
-					pi, pi_map.count(pi) ? pi_map.at(pi).c_str() : "???",
-					po, po_map.count(po) ? po_map.at(po).c_str() : "???");
+					pi, pi_map->count(pi) ? pi_map->at(pi).c_str() : "???",
+					po, po_map->count(po) ? po_map->at(po).c_str() : "???");
 #endif // HYBRDLINK
 			return;
 		}
@@ -720,11 +850,15 @@ struct abc_output_filter
 	}
 };
 
+// extracts the cells into the temp dir of the job and writes the ABC script;
+// extracted_sig holds the connections of cells already taken out of the
+// module by jobs that are not re-integrated yet
 void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::string script_file, std::string exe_file,
 		std::vector<std::string> &liberty_files, std::vector<std::string> &genlib_files, std::string constr_file,
 		bool cleanup, vector<int> lut_costs, bool dff_mode, std::string clk_str, bool keepff, std::string delay_target,
 		std::string sop_inputs, std::string sop_products, std::string lutin_shared, bool fast_mode,
-		const std::vector<RTLIL::Cell*> &cells, bool show_tempdir, bool sop_mode, bool abc_dress, std::vector<std::string> &dont_use_cells)
+		const std::vector<RTLIL::Cell*> &cells, bool show_tempdir, bool sop_mode, bool abc_dress, std::vector<std::string> &dont_use_cells,
+		std::string cache_dir, const RTLIL::SigSpec &extracted_sig, abc_job_t &job)
 {
 	module = current_module;
 	map_autoidx = autoidx++;
@@ -885,7 +1019,16 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 		abc_script = abc_script.substr(0, pos) + lutin_shared + abc_script.substr(pos+3);
 	if (abc_dress)
 		abc_script += stringf("; dress \"%s/input.blif\"", tempdir_name.c_str());
-	abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
+#ifdef ABC_OUTPUT_CHANNEL
+	// with -nocleanup the file stays around for debugging
+	job.output_channel = cleanup;
+#else
+	job.output_channel = false;
+#endif
+	if (job.output_channel)
+		abc_script += "; write_blif /dev/fd/3";
+	else
+		abc_script += stringf("; write_blif %s/output.blif", tempdir_name.c_str());
 	abc_script = add_echos_to_abc_cmd(abc_script);
 
 	for (size_t i = 0; i+1 < abc_script.size(); i++)
@@ -898,6 +1041,7 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 		log_error("Opening %s for writing failed: %s\n", buffer.c_str(), strerror(errno));
 	fprintf(f, "%s\n", abc_script.c_str());
 	fclose(f);
+	job.abc_script = abc_script;
 
 	if (dff_mode || !clk_str.empty())
 	{
@@ -933,6 +1077,8 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 	for (auto &port_it : cell->connections())
 		mark_port(port_it.second);
 
+	mark_port(extracted_sig);
+
 	if (clk_sig.size() != 0)
 		mark_port(clk_sig);
 
@@ -1067,15 +1213,12 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 
 	log("Extracted %d gates and %d wires to a netlist network with %d inputs and %d outputs.\n",
 			count_gates, GetSize(signal_list), count_input, count_output);
-	log_push();
+
+	job.tempdir_name = tempdir_name;
+	job.count_output = count_output;
+
 	if (count_output > 0)
 	{
-#ifdef HYBRDLINK
-		log_header(design, "Executing synth-optimizer.\n");
-#else
-		log_header(design, "Executing ABC.\n");
-#endif //HYBRDLINK
-
 		auto &cell_cost = cmos_cost ? CellCosts::cmos_gate_cost() : CellCosts::default_gate_cost();
 
 		buffer = stringf("%s/stdcells.genlib", tempdir_name.c_str());
@@ -1133,81 +1276,128 @@ void abc_module(RTLIL::Design *design, RTLIL::Module *current_module, std::strin
 		}
 
 #ifdef HYBRDLINK
-		buffer = stringf("\"%s\" -s -f %s/synth-optimizer.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
-		if(log_verbose_level > 9)
-			log("Running synth-optimizer command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+		std::string script_name = tempdir_name + "/synth-optimizer.script";
 #else
-		buffer = stringf("\"%s\" -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
-		log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
+		std::string script_name = tempdir_name + "/abc.script";
 #endif
+		// started without a shell, abc_command is only used for messages
+		job.abc_argv = {exe_file, "-s", "-f", script_name};
+		job.abc_command = stringf("\"%s\" -s -f %s", exe_file.c_str(), script_name.c_str());
+
+		if (!cache_dir.empty()) {
+			std::vector<std::string> cache_files = {tempdir_name + "/input.blif"};
+			cache_files.push_back(tempdir_name + (lut_costs.empty() ? "/stdcells.genlib" : "/lutdefs.txt"));
+			cache_files.insert(cache_files.end(), liberty_files.begin(), liberty_files.end());
+			cache_files.insert(cache_files.end(), genlib_files.begin(), genlib_files.end());
+			if (!constr_file.empty())
+				cache_files.push_back(constr_file);
+			if (!script_file.empty() && script_file[0] != '+')
+				cache_files.push_back(script_file);
+			job.cache.dir = cache_dir;
+			job.cache.make_key(tempdir_name, abc_script, cache_files, exe_file);
+		}
+	}
 
-#ifndef YOSYS_LINK_ABC
-		abc_output_filter filt(tempdir_name, show_tempdir);
-		int ret = run_command(buffer, std::bind(&abc_output_filter::next_line, filt, std::placeholders::_1));
-#else
-		string temp_stdouterr_name = stringf("%s/stdouterr.txt", tempdir_name.c_str());
-		FILE *temp_stdouterr_w = fopen(temp_stdouterr_name.c_str(), "w");
-		if (temp_stdouterr_w == NULL)
+	save_abc_job(job);
+}
+
+// runs ABC for an extracted job; only touches the job itself, so that
+// several jobs can run at the same time
+void abc_run_job(abc_job_t &job, bool show_tempdir)
+{
+	const std::string &tempdir_name = job.tempdir_name;
+	const std::string &buffer = job.abc_command;
+
+	abc_output_filter filt(job, show_tempdir);
+	std::vector<std::string> log_lines;
+	std::function<void(const std::string&)> process_line = [&](const std::string &line) {
+		if (!job.cache.dir.empty())
+			log_lines.push_back(line);
+		filt.next_line(line);
+	};
+
+	if (!job.cache.dir.empty()) {
+		std::string result;
+		if (job.cache.load(tempdir_name, log_lines, result)) {
 #ifdef HYBRDLINK
-			log_error("synth-optimizer: cannot open a temporary file for output redirection");
+			if(log_verbose_level > 9)
+				log("Using cached synth-optimizer result %s.\n", job.cache.key.c_str());
 #else
-			log_error("ABC: cannot open a temporary file for output redirection");
-#endif // HYBRDLINK
-		fflush(stdout);
-		fflush(stderr);
-		FILE *old_stdout = fopen(temp_stdouterr_name.c_str(), "r"); // need any fd for renumbering
-		FILE *old_stderr = fopen(temp_stdouterr_name.c_str(), "r"); // need any fd for renumbering
-#if defined(__wasm)
-#define fd_renumber(from, to) (void)__wasi_fd_renumber(from, to)
+			log("Using cached ABC result %s.\n", job.cache.key.c_str());
+#endif
+			for (auto &line : log_lines)
+				filt.next_line(line);
+			job.output_data = std::move(result);
+			job.output_channel = true;
+			return;
+		}
+	}
+
+#ifdef HYBRDLINK
+	if(log_verbose_level > 9)
+		log("Running synth-optimizer command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 #else
-#define fd_renumber(from, to) dup2(from, to)
+	log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 #endif
-		fd_renumber(fileno(stdout), fileno(old_stdout));
-		fd_renumber(fileno(stderr), fileno(old_stderr));
-		fd_renumber(fileno(temp_stdouterr_w), fileno(stdout));
-		fd_renumber(fileno(temp_stdouterr_w), fileno(stderr));
-		fclose(temp_stdouterr_w);
-		// These needs to be mutable, supposedly due to getopt
-		char *abc_argv[5];
-		string tmp_script_name = stringf("%s/abc.script", tempdir_name.c_str());
-		abc_argv[0] = strdup(exe_file.c_str());
-		abc_argv[1] = strdup("-s");
-		abc_argv[2] = strdup("-f");
-		abc_argv[3] = strdup(tmp_script_name.c_str());
-		abc_argv[4] = 0;
-		int ret = abc::Abc_RealMain(4, abc_argv);
-		free(abc_argv[0]);
-		free(abc_argv[1]);
-		free(abc_argv[2]);
-		free(abc_argv[3]);
-		fflush(stdout);
-		fflush(stderr);
-		fd_renumber(fileno(old_stdout), fileno(stdout));
-		fd_renumber(fileno(old_stderr), fileno(stderr));
-		fclose(old_stdout);
-		fclose(old_stderr);
-		std::ifstream temp_stdouterr_r(temp_stdouterr_name);
-		abc_output_filter filt(tempdir_name, show_tempdir);
-		for (std::string line; std::getline(temp_stdouterr_r, line); )
-			filt.next_line(line + "\n");
-		temp_stdouterr_r.close();
+
+	if (trace_enabled()) {
+		trace_begin("abc", "yosys-abc");
+		trace_annotate("command", buffer);
+	}
+#if defined(ABC_OUTPUT_CHANNEL)
+	int ret = job.output_channel ? run_command_channel(job.abc_argv, process_line, job.output_data) : run_command_argv(job.abc_argv, process_line);
+#elif !defined(YOSYS_LINK_ABC)
+	int ret = run_command_argv(job.abc_argv, process_line);
+#else
+	int ret = abc_link_run_script(job.abc_script, process_line);
 #endif
-		if (ret != 0)
+	if (trace_enabled())
+		trace_end();
+	if (ret != 0)
 #ifdef HYBRDLINK
-			log_error("synth-optimizer: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+		log_error("synth-optimizer: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
 #else
-			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
+		log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
 #endif // HYBRDLINK
 
-		buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
+	if (!job.cache.dir.empty()) {
+		if (job.output_channel) {
+			job.cache.store(tempdir_name, log_lines, job.output_data);
+		} else {
+			std::ifstream ifs(stringf("%s/output.blif", tempdir_name.c_str()), std::ios::binary);
+			std::stringstream result;
+			result << ifs.rdbuf();
+			if (!ifs.fail())
+				job.cache.store(tempdir_name, log_lines, result.str());
+		}
+	}
+}
+
+// reads back the results of a job that has run; expects the log_push() of
+// the job to be still open
+void abc_reintegrate(RTLIL::Design *design, abc_job_t &job, std::vector<std::string> &liberty_files,
+		std::vector<std::string> &genlib_files, bool cleanup, bool sop_mode)
+{
+	load_abc_job(job);
+	const std::string &tempdir_name = job.tempdir_name;
+
+	if (job.count_output > 0)
+	{
 		std::ifstream ifs;
-		ifs.open(buffer);
-		if (ifs.fail())
-			log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
+		std::istringstream iss;
+		if (job.output_channel) {
+			iss.str(std::move(job.output_data));
+			job.output_data.clear();
+		} else {
+			std::string buffer = stringf("%s/%s", tempdir_name.c_str(), "output.blif");
+			ifs.open(buffer);
+			if (ifs.fail())
+				log_error("Can't open ABC output file `%s'.\n", buffer.c_str());
+		}
 
 		bool builtin_lib = liberty_files.empty() && genlib_files.empty();
 		RTLIL::Design *mapped_design = new RTLIL::Design;
-		parse_blif(mapped_design, ifs, builtin_lib ? ID(DFF) : ID(_dff_), false, sop_mode);
+		parse_blif(mapped_design, job.output_channel ? static_cast<std::istream&>(iss) : ifs, builtin_lib ? ID(DFF) : ID(_dff_), false, sop_mode);
 
 		ifs.close();
 
@@ -1689,6 +1879,19 @@ struct AbcPass : public Pass {
 		log("        preserve naming by an equivalence check between the original and\n");
 		log("        post-ABC netlists (experimental).\n");
 		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the results of ABC runs in <dir>, addressed by a hash of the\n");
+		log("        extracted netlist, the ABC script, the cell or LUT library and the ABC\n");
+		log("        binary. a run with a hash that is already in <dir> is replayed from\n");
+		log("        there without starting ABC. the directory can be shared.\n");
+		log("\n");
+		log("    -j <num>\n");
+		log("        run up to <num> ABC processes at the same time, one for each module\n");
+		log("        and, with -dff, each clock domain. every process gets its own temp\n");
+		log("        dir and the results are re-integrated in the same order as without\n");
+		log("        this option. the default is the -j value synthesizer runs with. builds\n");
+		log("        that link ABC into the executable always run one process at a time.\n");
+		log("\n");
 		log("When no target cell library is specified the Yosys standard cell library is\n");
 		log("loaded into ABC before the ABC script is executed.\n");
 		log("\n");
@@ -1726,6 +1929,8 @@ struct AbcPass : public Pass {
 		bool fast_mode = false, dff_mode = false, keepff = false, cleanup = true;
 		bool show_tempdir = false, sop_mode = false;
 		bool abc_dress = false;
+		int abc_jobs = yosys_parallel_jobs;
+		std::string cache_dir;
 		vector<int> lut_costs;
 		markgroups = false;
 
@@ -1773,6 +1978,7 @@ struct AbcPass : public Pass {
 		keepff = design->scratchpad_get_bool("abc.keepff", keepff);
 		show_tempdir = design->scratchpad_get_bool("abc.showtmp", show_tempdir);
 		markgroups = design->scratchpad_get_bool("abc.markgroups", markgroups);
+		cache_dir = design->scratchpad_get_string("abc.cache", cache_dir);
 
 		if (design->scratchpad_get_bool("abc.debug")) {
 			cleanup = false;
@@ -1897,10 +2103,26 @@ struct AbcPass : public Pass {
 				markgroups = true;
 				continue;
 			}
+			if (arg == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				continue;
+			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				abc_jobs = atoi(args[++argidx].c_str());
+				if (abc_jobs < 1)
+					log_cmd_error("Invalid -j argument: %s\n", args[argidx].c_str());
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+#ifdef YOSYS_LINK_ABC
+		// the linked ABC keeps a single global state and redirects the stdout/stderr
+		// of the whole process while it runs
+		abc_jobs = 1;
+#endif
+
 		if (genlib_files.empty() && liberty_files.empty() && !default_liberty_file.empty())
 			liberty_files.push_back(default_liberty_file);
 
@@ -2102,8 +2324,28 @@ struct AbcPass : public Pass {
 			// enabled_gates.insert("NMUX");
 		}
 
+		// with -j the jobs are only extracted here, then run together and
+		// re-integrated in order afterwards
+		bool parallel_abc = abc_jobs > 1;
+		std::vector<abc_job_t> pending_jobs;
+
+		auto finish_job = [&](abc_job_t &job) {
+			log_push();
+			if (job.count_output > 0) {
+#ifdef HYBRDLINK
+				log_header(design, "Executing synth-optimizer.\n");
+#else
+				log_header(design, "Executing ABC.\n");
+#endif //HYBRDLINK
+				abc_yield_scope_t yield_scope;
+				abc_run_job(job, show_tempdir);
+			}
+			abc_reintegrate(design, job, liberty_files, genlib_files, cleanup, sop_mode);
+		};
+
 		for (auto mod : design->selected_modules())
 		{
+			log_check_interrupt("abc");
 			if (mod->processes.size() > 0) {
 				log("Skipping module %s as it contains processes.\n", log_id(mod));
 				continue;
@@ -2113,8 +2355,14 @@ struct AbcPass : public Pass {
 			initvals.set(&assign_map, mod);
 
 			if (!dff_mode || !clk_str.empty()) {
+				abc_job_t job;
 				abc_module(design, mod, script_file, exe_file, liberty_files, genlib_files, constr_file, cleanup, lut_costs, dff_mode, clk_str, keepff,
-						delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, mod->selected_cells(), show_tempdir, sop_mode, abc_dress, dont_use_cells);
+						delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, mod->selected_cells(), show_tempdir, sop_mode, abc_dress, dont_use_cells,
+						cache_dir, RTLIL::SigSpec(), job);
+				if (parallel_abc)
+					pending_jobs.push_back(std::move(job));
+				else
+					finish_job(job);
 				continue;
 			}
 
@@ -2158,7 +2406,7 @@ struct AbcPass : public Pass {
 				if (!RTLIL::builtin_ff_cell_types().count(cell->type))
 					continue;
 
-				FfData ff(&initvals, cell);
+				FfView ff(cell);
 				if (!ff.has_clk)
 					continue;
 				if (ff.has_gclk)
@@ -2171,13 +2419,13 @@ struct AbcPass : public Pass {
 					continue;
 				key = clkdomain_t(
 					ff.pol_clk,
-					ff.sig_clk,
+					ff.sig_clk(),
 					ff.has_ce ? ff.pol_ce : true,
-					ff.has_ce ? assign_map(ff.sig_ce) : RTLIL::SigSpec(),
+					ff.has_ce ? assign_map(ff.sig_ce()) : RTLIL::SigSpec(),
 					ff.has_arst ? ff.pol_arst : true,
-					ff.has_arst ? assign_map(ff.sig_arst) : RTLIL::SigSpec(),
+					ff.has_arst ? assign_map(ff.sig_arst()) : RTLIL::SigSpec(),
 					ff.has_srst ? ff.pol_srst : true,
-					ff.has_srst ? assign_map(ff.sig_srst) : RTLIL::SigSpec()
+					ff.has_srst ? assign_map(ff.sig_srst()) : RTLIL::SigSpec()
 				);
 
 				unassigned_cells.erase(cell);
@@ -2266,7 +2514,12 @@ struct AbcPass : public Pass {
 						std::get<4>(it.first) ? "" : "!", log_signal(std::get<5>(it.first)),
 						std::get<6>(it.first) ? "" : "!", log_signal(std::get<7>(it.first)));
 
+			// the cells of domains that are extracted but not re-integrated yet
+			RTLIL::SigSpec extracted_sig;
+
+			int domain_count = 0;
 			for (auto &it : assigned_cells) {
+				log_check_interrupt("abc clock domains", domain_count++, GetSize(assigned_cells));
 				clk_polarity = std::get<0>(it.first);
 				clk_sig = assign_map(std::get<1>(it.first));
 				en_polarity = std::get<2>(it.first);
@@ -2275,9 +2528,48 @@ struct AbcPass : public Pass {
 				arst_sig = assign_map(std::get<5>(it.first));
 				srst_polarity = std::get<6>(it.first);
 				srst_sig = assign_map(std::get<7>(it.first));
+				RTLIL::SigSpec domain_sig;
+				if (parallel_abc)
+					for (auto cell : it.second)
+						for (auto &conn : cell->connections())
+							domain_sig.append(conn.second);
+				abc_job_t job;
 				abc_module(design, mod, script_file, exe_file, liberty_files, genlib_files, constr_file, cleanup, lut_costs, !clk_sig.empty(), "$",
-						keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, it.second, show_tempdir, sop_mode, abc_dress, dont_use_cells);
-				assign_map.set(mod);
+						keepff, delay_target, sop_inputs, sop_products, lutin_shared, fast_mode, it.second, show_tempdir, sop_mode, abc_dress, dont_use_cells,
+						cache_dir, extracted_sig, job);
+				if (parallel_abc) {
+					pending_jobs.push_back(std::move(job));
+					extracted_sig.append(domain_sig);
+				} else {
+					finish_job(job);
+					assign_map.set(mod);
+				}
+			}
+		}
+
+		if (!pending_jobs.empty())
+		{
+#ifdef HYBRDLINK
+			log_header(design, "Executing synth-optimizer.\n");
+#else
+			log_header(design, "Executing ABC.\n");
+#endif //HYBRDLINK
+			log("Running %d jobs on up to %d threads.\n", GetSize(pending_jobs), std::min(abc_jobs, GetSize(pending_jobs)));
+
+			parallel_for(GetSize(pending_jobs), [&](int i) {
+				if (pending_jobs[i].count_output > 0)
+					abc_run_job(pending_jobs[i], show_tempdir);
+			}, abc_jobs);
+
+			RTLIL::Module *current_module = nullptr;
+			for (auto &job : pending_jobs) {
+				if (job.module != current_module) {
+					current_module = job.module;
+					assign_map.set(current_module);
+					initvals.set(&assign_map, current_module);
+				}
+				log_push();
+				abc_reintegrate(design, job, liberty_files, genlib_files, cleanup, sop_mode);
 			}
 		}
 
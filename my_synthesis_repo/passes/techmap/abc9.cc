@@ -171,6 +171,10 @@ struct Abc9Pass : public ScriptPass
 		log("    -box <file>\n");
 		log("        pass this file with box library to ABC.\n");
 		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the mapped results in <dir> and replay them for identical ABC\n");
+		log("        runs. see 'help abc9_exe' for details.\n");
+		log("\n");
 		log("Note that this is a logic optimization pass within Yosys that is calling ABC\n");
 		log("internally. This is not going to \"run ABC on your design\". It will instead run\n");
 		log("ABC on logic snippets extracted from your design. You will not get any useful\n");
@@ -220,7 +224,7 @@ struct Abc9Pass : public ScriptPass
 			std::string arg = args[argidx];
 			if ((arg == "-exe" || arg == "-script" || arg == "-D" ||
 						/*arg == "-S" ||*/ arg == "-lut" || arg == "-luts" ||
-						/*arg == "-box" ||*/ arg == "-W") &&
+						/*arg == "-box" ||*/ arg == "-W" || arg == "-cache") &&
 					argidx+1 < args.size()) {
 				if (arg == "-lut" || arg == "-luts")
 					lut_mode = true;
@@ -406,18 +410,38 @@ struct Abc9Pass : public ScriptPass
 		if (check_label("exe")) {
 			run("aigmap");
 			if (help_mode) {
+				run("abc9_ops -write_lut <abc-temp-dir>/input.lut", "(skip if '-lut' or '-luts')");
+				run("abc9_ops -write_box <abc-temp-dir>/input.box", "(skip if '-box')");
+				run("foreach module in selection");
+				run("    write_xaiger -map <module-temp-dir>/input.sym [-dff] <module-temp-dir>/input.xaig");
+				run("abc9_exe [options] -lut [<abc-temp-dir>/input.lut] -box [<abc-temp-dir>/input.box] -cwd <module-temp-dir> ...");
 				run("foreach module in selection");
-				run("    abc9_ops -write_lut <abc-temp-dir>/input.lut", "(skip if '-lut' or '-luts')");
-				run("    abc9_ops -write_box <abc-temp-dir>/input.box", "(skip if '-box')");
-				run("    write_xaiger -map <abc-temp-dir>/input.sym [-dff] <abc-temp-dir>/input.xaig");
-				run("    abc9_exe [options] -cwd <abc-temp-dir> -lut [<abc-temp-dir>/input.lut] -box [<abc-temp-dir>/input.box]");
-				run("    read_aiger -xaiger -wideports -module_name <module-name>$abc9 -map <abc-temp-dir>/input.sym <abc-temp-dir>/output.aig");
+				run("    read_aiger -xaiger -wideports -module_name <module-name>$abc9 -map <module-temp-dir>/input.sym <module-temp-dir>/output.aig");
 				run("    abc9_ops -reintegrate [-dff]");
 			}
 			else {
 				auto selected_modules = active_design->selected_modules();
 				active_design->selection_stack.emplace_back(false);
 
+				auto make_tempdir = [&]() {
+					std::string tempdir_name;
+					if (cleanup)
+						tempdir_name = get_base_tmpdir() + "/";
+					else
+						tempdir_name = "_tmp_";
+#ifdef HYBRDLINK
+					tempdir_name += proc_program_prefix() + "synth-optimizer-XXXXXX";  // Changed folder name for encryption
+#else
+					tempdir_name += proc_program_prefix() + "yosys-abc-XXXXXX";
+#endif // HYBRDLINK
+					return make_temp_dir(tempdir_name);
+				};
+
+				// the LUT and box libraries are the same for all modules, they are
+				// written once and shared by all ABC runs
+				std::string shared_tempdir_name;
+				std::vector<std::pair<RTLIL::Module*, std::string>> extracted;
+
 				for (auto mod : selected_modules) {
 					if (mod->processes.size() > 0) {
 						log("Skipping module %s as it contains processes.\n", log_id(mod));
@@ -430,24 +454,15 @@ struct Abc9Pass : public ScriptPass
 					if (!active_design->selected_whole_module(mod))
 						log_error("Can't handle partially selected module %s!\n", log_id(mod));
 
-					std::string tempdir_name;
-					if (cleanup) 
-						tempdir_name = get_base_tmpdir() + "/";
-					else
-						tempdir_name = "_tmp_";
-					
-#ifdef HYBRDLINK
-					tempdir_name += proc_program_prefix() + "synth-optimizer-XXXXXX";  // Changed folder name for encryption
-#else
-					tempdir_name += proc_program_prefix() + "yosys-abc-XXXXXX";
-#endif // HYBRDLINK
-					
-					tempdir_name = make_temp_dir(tempdir_name);
+					if (shared_tempdir_name.empty()) {
+						shared_tempdir_name = make_tempdir();
+						if (!lut_mode)
+							run_nocheck(stringf("abc9_ops -write_lut %s/input.lut", shared_tempdir_name.c_str()));
+						if (box_file.empty())
+							run_nocheck(stringf("abc9_ops -write_box %s/input.box", shared_tempdir_name.c_str()));
+					}
 
-					if (!lut_mode)
-						run_nocheck(stringf("abc9_ops -write_lut %s/input.lut", tempdir_name.c_str()));
-					if (box_file.empty())
-						run_nocheck(stringf("abc9_ops -write_box %s/input.box", tempdir_name.c_str()));
+					std::string tempdir_name = make_tempdir();
 					run_nocheck(stringf("write_xaiger -map %s/input.sym %s %s/input.xaig", tempdir_name.c_str(), dff_mode ? "-dff" : "", tempdir_name.c_str()));  // write to .sym and .xaig fiels
 
 					int num_outputs = active_design->scratchpad_get_int("write_xaiger.num_outputs");
@@ -458,21 +473,44 @@ struct Abc9Pass : public ScriptPass
 							log_id(mod),
 							active_design->scratchpad_get_int("write_xaiger.num_inputs"),
 							num_outputs);
-					if (num_outputs) {
-						std::string abc9_exe_cmd;
-						abc9_exe_cmd += stringf("%s -cwd %s", exe_cmd.str().c_str(), tempdir_name.c_str());
-						if (!lut_mode)
-							abc9_exe_cmd += stringf(" -lut %s/input.lut", tempdir_name.c_str());
-						if (box_file.empty())
-							abc9_exe_cmd += stringf(" -box %s/input.box", tempdir_name.c_str());
-						else
-							abc9_exe_cmd += stringf(" -box %s", box_file.c_str());
-						run_nocheck(abc9_exe_cmd);
-						run_nocheck(stringf("read_aiger -xaiger -wideports -module_name %s$abc9 -map %s/input.sym %s/output.aig", log_id(mod), tempdir_name.c_str(), tempdir_name.c_str()));
-						run_nocheck(stringf("abc9_ops -reintegrate %s", dff_mode ? "-dff" : ""));
+					if (num_outputs)
+						extracted.emplace_back(mod, tempdir_name);
+					else {
+						log("Don't call ABC as there is nothing to map.\n");
+						if (cleanup) {
+							log("Removing temp directory.\n");
+							remove_directory(tempdir_name);
+						}
+						mod->check();
 					}
+
+					active_design->selection().selected_modules.clear();
+					log_pop();
+				}
+
+				// one abc9_exe call for all modules, which runs them on up to -j threads
+				if (!extracted.empty()) {
+					std::string abc9_exe_cmd = exe_cmd.str();
+					if (!lut_mode)
+						abc9_exe_cmd += stringf(" -lut %s/input.lut", shared_tempdir_name.c_str());
+					if (box_file.empty())
+						abc9_exe_cmd += stringf(" -box %s/input.box", shared_tempdir_name.c_str());
 					else
-						log("Don't call ABC as there is nothing to map.\n");
+						abc9_exe_cmd += stringf(" -box %s", box_file.c_str());
+					for (auto &it : extracted)
+						abc9_exe_cmd += stringf(" -cwd %s", it.second.c_str());
+					run_nocheck(abc9_exe_cmd);
+				}
+
+				for (auto &it : extracted) {
+					RTLIL::Module *mod = it.first;
+					const std::string &tempdir_name = it.second;
+
+					log_push();
+					active_design->selection().select(mod);
+
+					run_nocheck(stringf("read_aiger -xaiger -wideports -module_name %s$abc9 -map %s/input.sym %s/output.aig", log_id(mod), tempdir_name.c_str(), tempdir_name.c_str()));
+					run_nocheck(stringf("abc9_ops -reintegrate %s", dff_mode ? "-dff" : ""));
 
 					if (cleanup) {
 						log("Removing temp directory.\n");
@@ -483,6 +521,9 @@ struct Abc9Pass : public ScriptPass
 					log_pop();
 				}
 
+				if (cleanup && !shared_tempdir_name.empty())
+					remove_directory(shared_tempdir_name);
+
 				active_design->selection_stack.pop_back();
 			}
 		}
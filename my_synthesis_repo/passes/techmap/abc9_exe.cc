@@ -24,17 +24,16 @@
 
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "kernel/tracing.h"
+#include "kernel/threading.h"
 
 #ifndef _WIN32
 #  include <unistd.h>
 #  include <dirent.h>
 #endif
 
-#ifdef YOSYS_LINK_ABC
-namespace abc {
-	int Abc_RealMain(int argc, char *argv[]);
-}
-#endif
+#include "passes/techmap/abc_link.h"
+#include "passes/techmap/abc_cache.h"
 
 std::string fold_abc9_cmd(std::string str)
 {
@@ -180,7 +179,7 @@ struct abc9_output_filter
 void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe_file,
 		vector<int> lut_costs, bool dff_mode, std::string delay_target, std::string /*lutin_shared*/, bool fast_mode,
 		bool show_tempdir, std::string box_file, std::string lut_file,
-		std::string wire_delay, std::string tempdir_name
+		std::string wire_delay, std::string tempdir_name, std::string cache_dir
 )
 {
 	std::string abc9_script;
@@ -272,12 +271,6 @@ void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe
 
 	std::string buffer;
 
-#ifdef HYBRDLINK
-	log_header(design, "Executing synth-optimizer2.\n");
-#else
-	log_header(design, "Executing ABC9.\n");
-#endif
-
 	if (!lut_costs.empty()) {
 		buffer = stringf("%s/lutdefs.txt", tempdir_name.c_str());
 		f = fopen(buffer.c_str(), "wt");
@@ -288,69 +281,63 @@ void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe
 		fclose(f);
 	}
 
+	abc9_output_filter filt(tempdir_name, show_tempdir);
+	std::vector<std::string> log_lines;
+	AbcResultCache cache;
+	std::string output_file = stringf("%s/output.aig", tempdir_name.c_str());
+
+	if (!cache_dir.empty()) {
+		std::vector<std::string> cache_files = {tempdir_name + "/input.xaig", box_file};
+		cache_files.push_back(lut_costs.empty() ? lut_file : tempdir_name + "/lutdefs.txt");
+		if (!script_file.empty() && script_file[0] != '+')
+			cache_files.push_back(script_file);
+		cache.dir = cache_dir;
+		cache.make_key(tempdir_name, abc9_script, cache_files, exe_file);
+
+		std::string result;
+		if (cache.load(tempdir_name, log_lines, result)) {
+#ifndef HYBRDLINK
+			log("Using cached ABC result %s.\n", cache.key.c_str());
+#endif
+			for (auto &line : log_lines)
+				filt.next_line(line);
+			std::ofstream ofs(output_file, std::ios::binary);
+			ofs << result;
+			ofs.close();
+			if (ofs.fail())
+				log_error("Writing %s failed.\n", output_file.c_str());
+			return;
+		}
+	}
+
+	std::function<void(const std::string&)> process_line = [&](const std::string &line) {
+		if (!cache.dir.empty())
+			log_lines.push_back(line);
+		filt.next_line(line);
+	};
+
+	// started without a shell, buffer is only used for messages
 #ifdef HYBRDLINK
-	buffer = stringf("\"%s\" -s -f %s/synth-optimizer.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
+	std::vector<std::string> abc9_argv = {exe_file, "-s", "-f", tempdir_name + "/synth-optimizer.script"};
+	buffer = stringf("\"%s\" -s -f %s/synth-optimizer.script", exe_file.c_str(), tempdir_name.c_str());
 	// log("Running synth-optimizer command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 #else
-	buffer = stringf("\"%s\" -s -f %s/abc.script 2>&1", exe_file.c_str(), tempdir_name.c_str());
+	std::vector<std::string> abc9_argv = {exe_file, "-s", "-f", tempdir_name + "/abc.script"};
+	buffer = stringf("\"%s\" -s -f %s/abc.script", exe_file.c_str(), tempdir_name.c_str());
 	log("Running ABC command: %s\n", replace_tempdir(buffer, tempdir_name, show_tempdir).c_str());
 #endif
 
+	if (trace_enabled()) {
+		trace_begin("abc", "yosys-abc");
+		trace_annotate("command", buffer);
+	}
 #ifndef YOSYS_LINK_ABC
-	abc9_output_filter filt(tempdir_name, show_tempdir);
-	int ret = run_command(buffer, std::bind(&abc9_output_filter::next_line, filt, std::placeholders::_1));	// write to temp file other than .box and .lut
-#else
-	string temp_stdouterr_name = stringf("%s/stdouterr.txt", tempdir_name.c_str());
-	FILE *temp_stdouterr_w = fopen(temp_stdouterr_name.c_str(), "w");
-	if (temp_stdouterr_w == NULL)
-#ifdef HYBRDLINK
-		log_error("synth-optimizer: cannot open a temporary file for output redirection");
-#else
-		log_error("ABC: cannot open a temporary file for output redirection");
-#endif // HYBRDLINK
-	fflush(stdout);
-	fflush(stderr);
-	FILE *old_stdout = fopen(temp_stdouterr_name.c_str(), "r"); // need any fd for renumbering
-	FILE *old_stderr = fopen(temp_stdouterr_name.c_str(), "r"); // need any fd for renumbering
-#if defined(__wasm)
-#define fd_renumber(from, to) (void)__wasi_fd_renumber(from, to)
+	int ret = run_command_argv(abc9_argv, process_line);	// write to temp file other than .box and .lut
 #else
-#define fd_renumber(from, to) dup2(from, to)
-#endif
-	fd_renumber(fileno(stdout), fileno(old_stdout));
-	fd_renumber(fileno(stderr), fileno(old_stderr));
-	fd_renumber(fileno(temp_stdouterr_w), fileno(stdout));
-	fd_renumber(fileno(temp_stdouterr_w), fileno(stderr));
-	fclose(temp_stdouterr_w);
-	// These needs to be mutable, supposedly due to getopt
-	char *abc9_argv[5];
-#ifdef HYBRDLINK
-	string tmp_script_name = stringf("%s/synth-optimizer.script", tempdir_name.c_str());
-#else
-	string tmp_script_name = stringf("%s/abc.script", tempdir_name.c_str());
-#endif
-	abc9_argv[0] = strdup(exe_file.c_str());
-	abc9_argv[1] = strdup("-s");
-	abc9_argv[2] = strdup("-f");
-	abc9_argv[3] = strdup(tmp_script_name.c_str());
-	abc9_argv[4] = 0;
-	int ret = abc::Abc_RealMain(4, abc9_argv);
-	free(abc9_argv[0]);
-	free(abc9_argv[1]);
-	free(abc9_argv[2]);
-	free(abc9_argv[3]);
-	fflush(stdout);
-	fflush(stderr);
-	fd_renumber(fileno(old_stdout), fileno(stdout));
-	fd_renumber(fileno(old_stderr), fileno(stderr));
-	fclose(old_stdout);
-	fclose(old_stderr);
-	std::ifstream temp_stdouterr_r(temp_stdouterr_name);
-	abc9_output_filter filt(tempdir_name, show_tempdir);
-	for (std::string line; std::getline(temp_stdouterr_r, line); )
-		filt.next_line(line + "\n");
-	temp_stdouterr_r.close();
+	int ret = abc_link_run_script(abc9_script, process_line);
 #endif
+	if (trace_enabled())
+		trace_end();
 	if (ret != 0) {
 #ifdef HYBRDLINK
 		if (check_file_exists(stringf("%s/output.aig", tempdir_name.c_str())))
@@ -363,13 +350,28 @@ void abc9_module(RTLIL::Design *design, std::string script_file, std::string exe
 		else
 			log_error("ABC: execution of command \"%s\" failed: return code %d.\n", buffer.c_str(), ret);
 #endif //HYBRDLINK
+	} else if (!cache.dir.empty()) {
+		std::ifstream ifs(output_file, std::ios::binary);
+		std::stringstream result;
+		result << ifs.rdbuf();
+		if (!ifs.fail())
+			cache.store(tempdir_name, log_lines, result.str());
 	}
 }
 
 struct Abc9ExePass : public Pass {
 	Abc9ExePass() : Pass("abc9_exe", "use ABC9 for technology mapping") { }
+	// the default scripts are constpad entries set up by the abc9 pass
+	static void abc9_constpad_setup()
+	{
+		auto it = pass_register.find("abc9");
+		if (it != pass_register.end())
+			it->second->ensure_registered();
+	}
+
 	void help() override
 	{
+		abc9_constpad_setup();
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
 		log("    abc9_exe [options]\n");
@@ -435,11 +437,21 @@ struct Abc9ExePass : public Pass {
 		log("    -box <file>\n");
 		log("        pass this file with box library to ABC.\n");
 		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the results of ABC runs in <dir>, addressed by a hash of the\n");
+		log("        input netlist, the ABC script, the box and LUT library and the ABC\n");
+		log("        binary. a run with a hash that is already in <dir> is replayed from\n");
+		log("        there without starting ABC. the directory can be shared.\n");
+		log("\n");
 		log("    -cwd <dir>\n");
 		log("        use this as the current working directory, inside which the 'input.xaig'\n");
 		log("        file is expected. temporary files will be created in this directory, and\n");
 		log("        the mapped result will be written to 'output.aig'.\n");
 		log("\n");
+		log("        this option can be given more than once. ABC then runs once for each\n");
+		log("        directory, with the same options. When synthesizer runs with -j <jobs>,\n");
+		log("        up to <jobs> of these runs happen at the same time.\n");
+		log("\n");
 		log("Note that this is a logic optimization pass within Yosys that is calling ABC\n");
 		log("internally. This is not going to \"run ABC on your design\". It will instead run\n");
 		log("ABC on logic snippets extracted from your design. You will not get any useful\n");
@@ -452,6 +464,7 @@ struct Abc9ExePass : public Pass {
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
+		abc9_constpad_setup();
 #ifdef HYBRDLINK
 		log_header(design, "Executing synth-optimizer2_EXE pass (technology mapping using synth-optimizer2).\n");
 #else
@@ -460,7 +473,8 @@ struct Abc9ExePass : public Pass {
 		std::string exe_file = yosys_abc_executable;
 		std::string script_file, clk_str, box_file, lut_file;
 		std::string delay_target, lutin_shared = "-S 1", wire_delay;
-		std::string tempdir_name;
+		std::vector<std::string> tempdir_names;
+		std::string cache_dir;
 		bool fast_mode = false, dff_mode = false;
 		bool show_tempdir = false;
 		vector<int> lut_costs;
@@ -482,6 +496,7 @@ struct Abc9ExePass : public Pass {
 		dff_mode = design->scratchpad_get_bool("abc9.dff", dff_mode);
 		show_tempdir = design->scratchpad_get_bool("abc9.showtmp", show_tempdir);
 		box_file = design->scratchpad_get_string("abc9.box", box_file);
+		cache_dir = design->scratchpad_get_string("abc9.cache", cache_dir);
 		if (design->scratchpad.count("abc9.W")) {
 			wire_delay = "-W " + design->scratchpad_get_string("abc9.W");
 		}
@@ -543,7 +558,11 @@ struct Abc9ExePass : public Pass {
 				continue;
 			}
 			if (arg == "-cwd" && argidx+1 < args.size()) {
-				tempdir_name = args[++argidx];
+				tempdir_names.push_back(args[++argidx]);
+				continue;
+			}
+			if (arg == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
 				continue;
 			}
 			break;
@@ -603,13 +622,28 @@ struct Abc9ExePass : public Pass {
 		if (!box_file.empty() && !is_absolute_path(box_file) && box_file[0] != '+')
 			box_file = std::string(pwd) + "/" + box_file;
 
-		if (tempdir_name.empty())
+		if (tempdir_names.empty())
 			log_cmd_error("abc9_exe '-cwd' option is mandatory.\n");
 
+#ifdef HYBRDLINK
+		log_header(design, "Executing synth-optimizer2.\n");
+#else
+		log_header(design, "Executing ABC9.\n");
+#endif
+
+#ifdef YOSYS_LINK_ABC
+		// the linked ABC keeps a single global state
+		int abc_jobs = 1;
+#else
+		int abc_jobs = 0;
+#endif
 
-		abc9_module(design, script_file, exe_file, lut_costs, dff_mode,
-				delay_target, lutin_shared, fast_mode, show_tempdir,
-				box_file, lut_file, wire_delay, tempdir_name);  // create abc9 module
+		// the runs only touch their own directory, the log is replayed in -cwd order
+		parallel_for(GetSize(tempdir_names), [&](int i) {
+			abc9_module(design, script_file, exe_file, lut_costs, dff_mode,
+					delay_target, lutin_shared, fast_mode, show_tempdir,
+					box_file, lut_file, wire_delay, tempdir_names[i], cache_dir);  // create abc9 module
+		}, abc_jobs);
 	}
 } Abc9ExePass;
 
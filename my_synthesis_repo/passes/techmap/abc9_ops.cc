@@ -23,6 +23,7 @@
 #include "kernel/utils.h"
 #include "kernel/celltypes.h"
 #include "kernel/timinginfo.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -602,6 +603,9 @@ void break_scc(RTLIL::Module *module)
 
 	if (!I.empty())
 	{
+		// the cell outputs above were rewired in place
+		module->notify_blackout();
+
 		auto cell = module->addCell(NEW_ID, ID($__ABC9_SCC_BREAKER));
 		log_assert(GetSize(I) == GetSize(O));
 		cell->setParam(ID::WIDTH, GetSize(I));
@@ -899,7 +903,7 @@ void prep_lut(RTLIL::Design *design, int maxlut)
 
 		TimingInfo::NameBit o;
 		std::vector<int> delays;
-		for (const auto &i : t.comb) {
+		for (const auto &i : t.comb_bits()) {
 			auto &d = i.first.second;
 			if (o == TimingInfo::NameBit())
 				o = d;
@@ -1111,7 +1115,7 @@ void prep_box(RTLIL::Design *design)
 			ss << std::endl;
 
 			auto &t = timing.setup_module(module);
-			if (t.comb.empty())
+			if (t.comb_empty())
 				log_error("Module '%s' with (* abc9_box *) has no timing (and thus no connectivity) information.\n", log_id(module));
 
 			for (const auto &o : outputs) {
@@ -1121,11 +1125,11 @@ void prep_box(RTLIL::Design *design)
 						first = false;
 					else
 						ss << " ";
-					auto jt = t.comb.find(TimingInfo::BitBit(i,o));
-					if (jt == t.comb.end())
+					int delay = t.comb_delay(TimingInfo::NameBit(i), TimingInfo::NameBit(o));
+					if (delay < 0)
 						ss << "-";
 					else
-						ss << jt->second;
+						ss << delay;
 				}
 				ss << " # ";
 				if (GetSize(o.wire) == 1)
@@ -1812,6 +1816,7 @@ struct Abc9OpsPass : public Pass {
 		if (prep_box_mode)
 			prep_box(design);
 
+		std::vector<RTLIL::Module*> modules;
 		for (auto mod : design->selected_modules()) {
 			if (mod->processes.size() > 0) {
 				log("Skipping module %s as it contains processes.\n", log_id(mod));
@@ -1821,14 +1826,21 @@ struct Abc9OpsPass : public Pass {
 			if (!design->selected_whole_module(mod))
 				log_error("Can't handle partially selected module %s!\n", log_id(mod));
 
+			modules.push_back(mod);
+		}
+
+		// break_scc() only edits its own module, the other steps share state
+		// across modules (the holes design, the reintegration counter)
+		if (break_scc_mode)
+			parallel_for_modules(design, modules, [](RTLIL::Module *mod) { break_scc(mod); });
+
+		for (auto mod : modules) {
 			if (!write_lut_dst.empty())
 				write_lut(mod, write_lut_dst);
 				// write_RTLIL_to_pb(mod, write_lut_dst, "abc9_ops.lut_library");	// To encrypt input.lut
 			if (!write_box_dst.empty())
 				write_box(mod, write_box_dst);
 				// write_RTLIL_to_pb(mod, write_box_dst, "abc9_ops.box_library");  // To encrypt input.box
-			if (break_scc_mode)
-				break_scc(mod);
 			if (prep_xaiger_mode)
 				prep_xaiger(mod, dff_mode);
 			if (reintegrate_mode)
@@ -0,0 +1,120 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "passes/techmap/abc_cache.h"
+#include "libs/sha1/sha1.h"
+#include <sys/stat.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+YOSYS_NAMESPACE_BEGIN
+
+// stands in for the temp dir name in cached log lines
+static const char *tempdir_token = "<abc-cache-temp-dir>";
+
+static std::string replace_all(std::string text, const std::string &from, const std::string &to)
+{
+	if (from.empty())
+		return text;
+	for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+		text.replace(pos, from.size(), to);
+	return text;
+}
+
+void AbcResultCache::make_key(const std::string &tempdir_name, const std::string &script,
+		const std::vector<std::string> &files, const std::string &exe_file)
+{
+	SHA1 hasher;
+	hasher.update("abc-cache-1\n");
+	hasher.update(replace_all(script, tempdir_name, tempdir_token));
+	hasher.update("\n");
+
+	for (auto &filename : files) {
+		hasher.update(replace_all(filename, tempdir_name, tempdir_token));
+		hasher.update(check_file_exists(filename) ? " " + SHA1::from_file(filename) + "\n" : " -\n");
+	}
+
+#ifdef YOSYS_LINK_ABC
+	(void)exe_file;
+	hasher.update(stringf("linked %s\n", yosys_version_str));
+#else
+	// size and modification time stand in for the version of the binary
+	struct stat st;
+	if (stat(exe_file.c_str(), &st) == 0)
+		hasher.update(stringf("%s %lld %lld\n", exe_file.c_str(), (long long)st.st_size, (long long)st.st_mtime));
+	else
+		hasher.update(exe_file + "\n");
+#endif
+
+	key = hasher.final();
+}
+
+bool AbcResultCache::load(const std::string &tempdir_name, std::vector<std::string> &log_lines, std::string &result) const
+{
+	std::ifstream f(stringf("%s/%s.abc", dir.c_str(), key.c_str()), std::ios::binary);
+	if (f.fail())
+		return false;
+
+	std::stringstream buffer;
+	buffer << f.rdbuf();
+	std::string data = buffer.str();
+
+	// "<log size>\n<log text><result>"
+	size_t eol = data.find('\n');
+	if (eol == std::string::npos)
+		return false;
+	size_t log_size = strtoull(data.c_str(), nullptr, 10);
+	if (eol + 1 + log_size > data.size())
+		return false;
+
+	std::string log_text = replace_all(data.substr(eol + 1, log_size), tempdir_token, tempdir_name);
+	log_lines.clear();
+	for (size_t pos = 0; pos < log_text.size();) {
+		size_t end = log_text.find('\n', pos);
+		end = end == std::string::npos ? log_text.size() : end + 1;
+		log_lines.push_back(log_text.substr(pos, end - pos));
+		pos = end;
+	}
+	result = data.substr(eol + 1 + log_size);
+	return true;
+}
+
+void AbcResultCache::store(const std::string &tempdir_name, const std::vector<std::string> &log_lines, const std::string &result) const
+{
+	if (!check_directory_exists(dir) && !create_directory(dir)) {
+		log_warning("Can't create ABC cache directory `%s'.\n", dir.c_str());
+		return;
+	}
+
+	std::string log_text;
+	for (auto &line : log_lines)
+		log_text += replace_all(line, tempdir_name, tempdir_token);
+
+	std::string filename = stringf("%s/%s.abc", dir.c_str(), key.c_str());
+	std::string temp_filename = make_temp_file(stringf("%s/%s_XXXXXX", dir.c_str(), key.c_str()));
+	std::ofstream f(temp_filename, std::ios::binary);
+	f << GetSize(log_text) << "\n" << log_text << result;
+	f.close();
+
+	if (f.fail() || rename(temp_filename.c_str(), filename.c_str()) != 0)
+		remove(temp_filename.c_str());
+}
+
+YOSYS_NAMESPACE_END
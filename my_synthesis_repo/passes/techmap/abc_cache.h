@@ -0,0 +1,51 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ABC_CACHE_H
+#define ABC_CACHE_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// On-disk cache for the results of ABC runs, used by abc and abc9_exe.
+// Entries are addressed by a hash of everything a run depends on: the
+// contents of its input and library files, the ABC script with the temp
+// dir name factored out, and the identity of the ABC binary. Entries are
+// written to a temporary name and renamed into place, so several processes
+// can share one cache directory.
+struct AbcResultCache
+{
+	// cache directory, caching is disabled when empty
+	std::string dir;
+	std::string key;
+
+	// files that do not exist only contribute their name
+	void make_key(const std::string &tempdir_name, const std::string &script,
+			const std::vector<std::string> &files, const std::string &exe_file);
+
+	// the cached ABC output lines and result file, with the temp dir name of
+	// the run that stored them replaced by tempdir_name
+	bool load(const std::string &tempdir_name, std::vector<std::string> &log_lines, std::string &result) const;
+	void store(const std::string &tempdir_name, const std::vector<std::string> &log_lines, const std::string &result) const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
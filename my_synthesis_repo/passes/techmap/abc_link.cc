@@ -0,0 +1,99 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "passes/techmap/abc_link.h"
+#include <stdio.h>
+
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+#ifdef YOSYS_LINK_ABC
+
+namespace abc {
+	typedef struct Abc_Frame_t_ Abc_Frame_t;
+	Abc_Frame_t *Abc_FrameGetGlobalFrame();
+	int Cmd_CommandExecute(Abc_Frame_t *pAbc, const char *sCommand);
+}
+
+#if defined(__wasm)
+#define fd_renumber(from, to) (void)__wasi_fd_renumber(from, to)
+#else
+#define fd_renumber(from, to) dup2(from, to)
+#endif
+
+YOSYS_NAMESPACE_BEGIN
+
+int abc_link_run_script(const std::string &script, const std::function<void(const std::string&)> &process_line)
+{
+	// getting the frame the first time also initializes ABC, without reading abc.rc
+	abc::Abc_Frame_t *frame = abc::Abc_FrameGetGlobalFrame();
+
+	// ABC prints to stdout and stderr, send both to an anonymous file for the duration
+	FILE *capture = tmpfile();
+	if (capture == nullptr)
+		log_error("ABC: cannot open a temporary file for output redirection\n");
+	fflush(stdout);
+	fflush(stderr);
+	FILE *old_stdout = tmpfile(); // need any fd for renumbering
+	FILE *old_stderr = tmpfile(); // need any fd for renumbering
+	fd_renumber(fileno(stdout), fileno(old_stdout));
+	fd_renumber(fileno(stderr), fileno(old_stderr));
+	fd_renumber(fileno(capture), fileno(stdout));
+	fd_renumber(fileno(capture), fileno(stderr));
+
+	int ret = 0;
+	for (size_t pos = 0; pos < script.size() && ret == 0;) {
+		size_t end = script.find('\n', pos);
+		if (end == std::string::npos)
+			end = script.size();
+		std::string command = script.substr(pos, end - pos);
+		pos = end + 1;
+		if (command.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		if (abc::Cmd_CommandExecute(frame, command.c_str()) != 0)
+			ret = 1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+	fd_renumber(fileno(old_stdout), fileno(stdout));
+	fd_renumber(fileno(old_stderr), fileno(stderr));
+	fclose(old_stdout);
+	fclose(old_stderr);
+
+	rewind(capture);
+	std::string line;
+	for (int ch = fgetc(capture); ch != EOF; ch = fgetc(capture)) {
+		line += ch;
+		if (ch == '\n') {
+			process_line(line);
+			line.clear();
+		}
+	}
+	if (!line.empty())
+		process_line(line + "\n");
+	fclose(capture);
+
+	return ret;
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef ABC_LINK_H
+#define ABC_LINK_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+#ifdef YOSYS_LINK_ABC
+
+// Runs an ABC script (one or more ';'-separated commands per line) in the
+// ABC instance linked into the synthesizer. The instance is started on first
+// use and kept for later calls, so there is no process start and no script
+// file. Every line ABC prints is passed to process_line, newline included.
+// Returns 0 on success, or 1 after the first command that failed.
+//
+// Not thread-safe: ABC keeps its state in a single global frame.
+int abc_link_run_script(const std::string &script, const std::function<void(const std::string&)> &process_line);
+
+#endif
+
+YOSYS_NAMESPACE_END
+
+#endif
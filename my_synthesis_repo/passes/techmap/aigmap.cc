@@ -73,17 +73,20 @@ struct AigmapPass : public Pass {
 			int orig_num_cells = GetSize(module->cells());
 
 			pool<IdString> new_sel;
+			vector<pair<Cell*, const Aig*>> work;
+			int new_gates = 0;
+
 			for (auto cell : module->selected_cells())
 			{
-				Aig aig(cell);
+				const Aig *aig = Aig::get(cell);
 
 				if (cell->type.in(ID($_AND_), ID($_NOT_)))
-					aig.name.clear();
+					aig = nullptr;
 
 				if (nand_mode && cell->type == ID($_NAND_))
-					aig.name.clear();
+					aig = nullptr;
 
-				if (aig.name.empty()) {
+				if (aig == nullptr) {
 					not_replaced_count++;
 					stat_not_replaced[cell->type]++;
 					if (select_mode)
@@ -91,16 +94,43 @@ struct AigmapPass : public Pass {
 					continue;
 				}
 
+				for (auto &node : aig->nodes)
+					if (node.portbit >= 0 || node.left_parent >= 0 || node.right_parent >= 0)
+						new_gates += (node.portbit < 0) + node.inverter;
+
+				work.push_back(make_pair(cell, aig));
+			}
+
+			// upper bound of the number of new gates, each with its own output wire
+			module->reserve_cells(new_gates);
+			module->reserve_wires(new_gates);
+
+			// all new gates and wires share one prefix, only the number differs
+			std::string name_prefix = NEW_ID_PREFIX;
+			auto new_name = [&]() { return RTLIL::IdString(name_prefix + std::to_string(next_autoidx())); };
+
+			for (auto &it : work)
+			{
+				Cell *cell = it.first;
+				const Aig *aig = it.second;
+
+				// the port signals as bit vectors, so that each node is a plain index
+				dict<IdString, vector<SigBit>> port_bits;
+				for (auto &conn : cell->connections())
+					port_bits[conn.first] = conn.second.to_sigbit_vector();
+
 				vector<SigBit> sigs;
+				sigs.reserve(GetSize(aig->nodes));
+				vector<SigBit> conn_lhs, conn_rhs;
 				dict<pair<int, int>, SigBit> and_cache;
 
-				for (int node_idx = 0; node_idx < GetSize(aig.nodes); node_idx++)
+				for (int node_idx = 0; node_idx < GetSize(aig->nodes); node_idx++)
 				{
 					SigBit bit;
-					auto &node = aig.nodes[node_idx];
+					auto &node = aig->nodes[node_idx];
 
 					if (node.portbit >= 0) {
-						bit = cell->getPort(node.portname)[node.portbit];
+						bit = port_bits.at(node.portname).at(node.portbit);
 					} else if (node.left_parent < 0 && node.right_parent < 0) {
 						bit = node.inverter ? State::S1 : State::S0;
 						goto skip_inverter;
@@ -108,8 +138,8 @@ struct AigmapPass : public Pass {
 						SigBit A = sigs.at(node.left_parent);
 						SigBit B = sigs.at(node.right_parent);
 						if (nand_mode && node.inverter) {
-							bit = module->addWire(NEW_ID);
-							auto gate = module->addNandGate(NEW_ID, A, B, bit);
+							bit = module->addWire(new_name());
+							auto gate = module->addNandGate(new_name(), A, B, bit);
 							if (select_mode)
 								new_sel.insert(gate->name);
 
@@ -119,8 +149,8 @@ struct AigmapPass : public Pass {
 							if (and_cache.count(key))
 								bit = and_cache.at(key);
 							else {
-								bit = module->addWire(NEW_ID);
-								auto gate = module->addAndGate(NEW_ID, A, B, bit);
+								bit = module->addWire(new_name());
+								auto gate = module->addAndGate(new_name(), A, B, bit);
 								if (select_mode)
 									new_sel.insert(gate->name);
 							}
@@ -128,8 +158,8 @@ struct AigmapPass : public Pass {
 					}
 
 					if (node.inverter) {
-						SigBit new_bit = module->addWire(NEW_ID);
-						auto gate = module->addNotGate(NEW_ID, bit, new_bit);
+						SigBit new_bit = module->addWire(new_name());
+						auto gate = module->addNotGate(new_name(), bit, new_bit);
 						bit = new_bit;
 						if (select_mode)
 							new_sel.insert(gate->name);
@@ -137,12 +167,18 @@ struct AigmapPass : public Pass {
 					}
 
 				skip_inverter:
-					for (auto &op : node.outports)
-						module->connect(cell->getPort(op.first)[op.second], bit);
+					for (auto &op : node.outports) {
+						conn_lhs.push_back(port_bits.at(op.first).at(op.second));
+						conn_rhs.push_back(bit);
+					}
 
 					sigs.push_back(bit);
 				}
 
+				// one connection per cell instead of one per output bit
+				if (!conn_lhs.empty())
+					module->connect(conn_lhs, conn_rhs);
+
 				replaced_cells.push_back(cell);
 				stat_replaced[cell->type]++;
 			}
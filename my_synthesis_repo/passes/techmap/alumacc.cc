@@ -239,10 +239,14 @@ struct AlumaccWorker
 				{
 					auto &port = n->macc.ports[i];
 
-					if (GetSize(port.in_b) > 0 || sig_macc.count(port.in_a) == 0)
+					if (GetSize(port.in_b) > 0)
 						continue;
 
-					auto other_n = sig_macc.at(port.in_a);
+					auto other_it = sig_macc.find(port.in_a);
+					if (other_it == sig_macc.end())
+						continue;
+
+					auto other_n = other_it->second;
 
 					if (other_n->users > 1)
 						continue;
@@ -252,14 +256,15 @@ struct AlumaccWorker
 
 					log("  merging $macc model for %s into %s.\n", log_id(other_n->cell), log_id(n->cell));
 
+					// other_n has no other users and is deleted below, so its ports are moved
 					bool do_subtract = port.do_subtract;
 					for (int j = 0; j < GetSize(other_n->macc.ports); j++) {
 						if (do_subtract)
 							other_n->macc.ports[j].do_subtract = !other_n->macc.ports[j].do_subtract;
 						if (j == 0)
-							n->macc.ports[i--] = other_n->macc.ports[j];
+							n->macc.ports[i--] = std::move(other_n->macc.ports[j]);
 						else
-							n->macc.ports.push_back(other_n->macc.ports[j]);
+							n->macc.ports.push_back(std::move(other_n->macc.ports[j]));
 					}
 
 					delete_nodes.insert(other_n);
@@ -576,6 +581,17 @@ struct AlumaccPass : public Pass {
 
 		for (auto mod : design->selected_modules())
 			if (!mod->has_processes_warn()) {
+				// don't build the SigMap and bit user counts for modules without arithmetic
+				bool has_arith = false;
+				for (auto cell : mod->selected_cells())
+					if (cell->type.in(ID($pos), ID($neg), ID($add), ID($sub), ID($mul),
+							ID($lt), ID($le), ID($ge), ID($gt), ID($eq), ID($eqx), ID($ne), ID($nex))) {
+						has_arith = true;
+						break;
+					}
+				if (!has_arith)
+					continue;
+
 				AlumaccWorker worker(mod);
 				worker.run();
 			}
@@ -57,18 +57,29 @@ synth -top my_design -booth
 
 #include "kernel/sigtools.h"
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
 struct BoothPassWorker {
 
+	// outputs of the radix-4 encoders for one multiplier operand
+	struct BoothEncoders {
+		SigSpec one_int, two_int, s_int, sb_int;
+		int count = 0;
+	};
+
 	RTLIL::Module *module;
 	SigMap sigmap;
 	int booth_counter;
 	bool lowpower = false;
 	bool mapped_cpa = false;
 
+	// multipliers of one module often share an operand, or both of them
+	dict<std::pair<SigSpec, bool>, BoothEncoders> encoders;
+	dict<std::tuple<SigSpec, SigSpec, bool>, SigSpec> products;
+
 	BoothPassWorker(RTLIL::Module *module) : module(module), sigmap(module) { booth_counter = 0; }
 
 	// Booth unsigned decoder lsb
@@ -206,10 +217,24 @@ struct BoothPassWorker {
 
 	void run()
 	{
-		for (auto cell : module->selected_cells()) {
-			if (cell->type != ID($mul))
-				continue;
+		std::vector<RTLIL::Cell*> mul_cells;
+		int estimated_size = 0;
+		for (auto cell : module->selected_cells())
+			if (cell->type == ID($mul)) {
+				int width = std::max(GetSize(cell->getPort(ID::A)), GetSize(cell->getPort(ID::B))) + 1;
+				estimated_size += 3 * width * width;
+				mul_cells.push_back(cell);
+			}
+
+		if (mul_cells.empty())
+			return;
+
+		// about a gate and a wire per decoder bit, plus two full adders per
+		// partial product bit in the Wallace tree
+		module->reserve_cells(estimated_size);
+		module->reserve_wires(estimated_size);
 
+		for (auto cell : mul_cells) {
 			SigSpec A = cell->getPort(ID::A);
 			SigSpec B = cell->getPort(ID::B);
 			SigSpec Y = cell->getPort(ID::Y);
@@ -262,6 +287,18 @@ struct BoothPassWorker {
 			A.extend_u0(x_sz_revised, is_signed);
 			B.extend_u0(y_sz_revised, is_signed);
 
+			auto product_key = std::make_tuple(sigmap(A), sigmap(B), is_signed);
+			auto product_it = products.find(product_key);
+			if (product_it != products.end()) {
+				log("  reusing the product of an identical multiplier\n");
+				SigSpec Y_driver = product_it->second;
+				Y_driver.extend_u0(Y.size(), is_signed);
+				module->connect(Y, Y_driver);
+				module->remove(cell);
+				booth_counter++;
+				continue;
+			}
+
 			// Make sure output domain is big enough to take
 			// all combinations.
 			// Later logic synthesis will kill unused
@@ -277,6 +314,7 @@ struct BoothPassWorker {
 				Y = expanded_Y;
 			}
 			log_assert(GetSize(Y) == required_op_size);
+			products[product_key] = Y;
 
 			if (!lowpower)
 				CreateBoothMult(module,
@@ -342,10 +380,14 @@ struct BoothPassWorker {
 	{ // result
 		int z_sz = Z.size();
 
-		SigSpec one_int, two_int, s_int, sb_int;
-		int encoder_count = 0;
+		// the encoders only depend on the multiplier, so they are shared by
+		// all multipliers of the module with the same one
+		BoothEncoders &enc = encoders[std::make_pair(sigmap(Y), is_signed)];
+		if (enc.count == 0)
+			BuildBoothMultEncoders(Y, enc.one_int, enc.two_int, enc.s_int, enc.sb_int, module, enc.count, is_signed);
 
-		BuildBoothMultEncoders(Y, one_int, two_int, s_int, sb_int, module, encoder_count, is_signed);
+		SigSpec one_int = enc.one_int, two_int = enc.two_int, s_int = enc.s_int, sb_int = enc.sb_int;
+		int encoder_count = enc.count;
 
 		// Build the decoder rows
 		// format of each Partial product to be passed to CSA
@@ -857,18 +899,21 @@ struct BoothPassWorker {
 	{
 		int y_sz = GetSize(Y);
 
+		// the encoder outputs are appended as they are, without a wire of their own
+		auto build_encoder = [&](const std::string &enc_name, SigBit y0, SigBit y1, SigBit y2) {
+			SigBit one_o, two_o, s_o, sb_o;
+			BuildBur4e(enc_name, y0, y1, y2, one_o, two_o, s_o, sb_o);
+			one_int.append(one_o);
+			two_int.append(two_o);
+			s_int.append(s_o);
+			sb_int.append(sb_o);
+		};
+
 		for (int y_ix = 0; y_ix < (!is_signed ? y_sz : y_sz - 1);) {
 			std::string enc_name = stringf("bur_enc_%d", encoder_ix);
 
-			two_int.append(module->addWire(NEW_ID_SUFFIX(stringf("two_int_%d", encoder_ix)), 1));
-			one_int.append(module->addWire(NEW_ID_SUFFIX(stringf("one_int_%d", encoder_ix)), 1));
-			s_int.append(module->addWire(NEW_ID_SUFFIX(stringf("s_int_%d", encoder_ix)), 1));
-			sb_int.append(module->addWire(NEW_ID_SUFFIX(stringf("sb_int_%d", encoder_ix)), 1));
-
 			if (y_ix == 0) {
-				BuildBur4e(enc_name, State::S0, Y[y_ix],
-					   Y[y_ix + 1], one_int[encoder_ix], two_int[encoder_ix], s_int[encoder_ix],
-					   sb_int[encoder_ix]);
+				build_encoder(enc_name, State::S0, Y[y_ix], Y[y_ix + 1]);
 
 				y_ix = y_ix + 1;
 				encoder_ix++;
@@ -901,6 +946,12 @@ struct BoothPassWorker {
 				if (y_ix > y_sz - 1) {
 					need_padded_cell = false;
 					y2 = is_signed ? Y.msb() : State::S0;
+
+					// no encoder here, its outputs are left undriven
+					two_int.append(module->addWire(NEW_ID_SUFFIX(stringf("two_int_%d", encoder_ix)), 1));
+					one_int.append(module->addWire(NEW_ID_SUFFIX(stringf("one_int_%d", encoder_ix)), 1));
+					s_int.append(module->addWire(NEW_ID_SUFFIX(stringf("s_int_%d", encoder_ix)), 1));
+					sb_int.append(module->addWire(NEW_ID_SUFFIX(stringf("sb_int_%d", encoder_ix)), 1));
 				} else {
 					if (y_ix == y_sz - 1)
 						need_padded_cell = !is_signed;
@@ -908,8 +959,7 @@ struct BoothPassWorker {
 						need_padded_cell = false;
 					y2 = Y[y_ix];
 
-					BuildBur4e(enc_name, y0, y1, y2, one_int[encoder_ix], two_int[encoder_ix], s_int[encoder_ix],
-						   sb_int[encoder_ix]);
+					build_encoder(enc_name, y0, y1, y2);
 				}
 
 				encoder_ix++;
@@ -918,21 +968,7 @@ struct BoothPassWorker {
 					// make extra encoder cell
 					// y_ix at y0, rest 0
 
-					std::string enc_name = stringf("br_enc_pad_%d", encoder_ix);
-
-					two_int.append(module->addWire(NEW_ID_SUFFIX(stringf("two_int_%d", encoder_ix)), 1));
-					one_int.append(module->addWire(NEW_ID_SUFFIX(stringf("one_int_%d", encoder_ix)), 1));
-					s_int.append(module->addWire(NEW_ID_SUFFIX(stringf("s_int_%d", encoder_ix)), 1));
-					sb_int.append(module->addWire(NEW_ID_SUFFIX(stringf("sb_int_%d", encoder_ix)), 1));
-
-					SigBit one_o_int, two_o_int, s_o_int, sb_o_int;
-					BuildBur4e(enc_name, Y[y_ix], State::S0,
-						   State::S0, one_o_int, two_o_int, s_o_int, sb_o_int);
-
-					module->connect(one_int[encoder_ix], one_o_int);
-					module->connect(two_int[encoder_ix], two_o_int);
-					module->connect(s_int[encoder_ix], s_o_int);
-					module->connect(sb_int[encoder_ix], sb_o_int);
+					build_encoder(stringf("br_enc_pad_%d", encoder_ix), Y[y_ix], State::S0, State::S0);
 					y_ix++;
 					encoder_ix++;
 				}
@@ -1172,9 +1208,11 @@ struct BoothPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total = 0;
+		std::atomic<int> total{0};
 
-		for (auto mod : design->selected_modules()) {
+		// the workers only touch their own module
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		parallel_for_modules(design, modules, [&](RTLIL::Module *mod) {
 			if (!mod->has_processes_warn()) {
 				BoothPassWorker worker(mod);
 				worker.mapped_cpa = mapped_cpa;
@@ -1182,9 +1220,9 @@ struct BoothPass : public Pass {
 				worker.run();
 				total += worker.booth_counter;
 			}
-		}
+		});
 
-		log("Mapped %d multipliers.\n", total);
+		log("Mapped %d multipliers.\n", total.load());
 	}
 } MultPass;
 
@@ -57,8 +57,8 @@ uint64_t permute_lut(uint64_t lut, const std::vector<int> &varmap)
 		for (int l = 0; l < k; l++)
 		if (j & 1 << l)
 			m |= 1 << varmap[l];
-		if (lut & 1 << m)
-			ret |= 1 << j;
+		if (lut & (uint64_t) 1 << m)
+			ret |= (uint64_t) 1 << j;
 	}
 	return ret;
 }
@@ -87,6 +87,70 @@ uint64_t p_class(int k, uint64_t lut)
 	return repr;
 }
 
+// Invert input var of a k-LUT, by swapping the halves of the truth table
+// where var is 0 and where it is 1
+uint64_t negate_lut_input(uint64_t lut, int var)
+{
+	static const uint64_t var_zero[6] = {
+		0x5555555555555555ull, 0x3333333333333333ull, 0x0f0f0f0f0f0f0f0full,
+		0x00ff00ff00ff00ffull, 0x0000ffff0000ffffull, 0x00000000ffffffffull,
+	};
+	int shift = 1 << var;
+	return ((lut & var_zero[var]) << shift) | ((lut >> shift) & var_zero[var]);
+}
+
+// The transform relating a k-LUT f to its canonical form c:
+//   c(z) = output_neg ^ f(x)  with  x[varmap[l]] = z[l] ^ (input_neg >> l & 1)
+struct NpnTransform
+{
+	std::vector<int> varmap;
+	int input_neg = 0;
+	bool output_neg = false;
+};
+
+// Find the NPN representative of a k-LUT, the minimum truth table reachable
+// by permuting the inputs, inverting inputs and inverting the output. With
+// allow_neg unset only the permutations are tried, which gives the p_class().
+// The transform that produced the representative is returned in transform.
+uint64_t npn_canonical(int k, uint64_t lut, bool allow_neg, NpnTransform &transform)
+{
+	uint64_t mask = k == 6 ? ~(uint64_t) 0 : ((uint64_t) 1 << (1 << k)) - 1;
+
+	std::vector<int> map;
+	for (int j = 0; j < k; j++)
+		map.push_back(j);
+
+	uint64_t repr = ~(uint64_t) 0;
+	bool found = false;
+	while (true) {
+		uint64_t perm = permute_lut(lut, map);
+		int neg = 0;
+		// visit all input inversions in Gray code order, one negate_lut_input() each
+		for (int step = 0; step < (allow_neg ? 1 << k : 1); step++) {
+			if (step) {
+				int var = 0;
+				while (!(step >> var & 1))
+					var++;
+				perm = negate_lut_input(perm, var);
+				neg ^= 1 << var;
+			}
+			for (int out = 0; out < (allow_neg ? 2 : 1); out++) {
+				uint64_t cand = out ? ~perm & mask : perm;
+				if (!found || cand < repr) {
+					repr = cand;
+					transform.varmap = map;
+					transform.input_neg = neg;
+					transform.output_neg = out;
+					found = true;
+				}
+			}
+		}
+		if (!std::next_permutation(map.begin(), map.end()))
+			break;
+	}
+	return repr;
+}
+
 // Represent module m as N single-output k-LUTs
 // where k is the number of module inputs,
 //   and N is the number of module outputs.
@@ -130,7 +194,7 @@ bool derive_module_luts(Module *m, std::vector<uint64_t> &luts)
 			log_assert(ceval.eval(bit));
 
 			if (bit[0] == State::S1)
-				luts[j] |= 1 << i;
+				luts[j] |= (uint64_t) 1 << i;
 		}
 	}
 
@@ -155,6 +219,14 @@ struct CellmatchPass : Pass {
 		log("equivalent as long as their truth tables are identical upto a permutation of\n");
 		log("inputs and outputs. The supported number of inputs is limited to 6.\n");
 		log("\n");
+		log("Single-output modules are looked up in an index of the canonical forms of the\n");
+		log("library's truth tables, so that each of them is matched with a single probe.\n");
+		log("\n");
+		log("    -npn\n");
+		log("        also match single-output modules whose truth tables are identical upto\n");
+		log("        inverting inputs or the output, the generated techmap rules then\n");
+		log("        contain the required $_NOT_ cells.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *d) override
 	{
@@ -162,11 +234,14 @@ struct CellmatchPass : Pass {
 
 		size_t argidx;
 		bool lut_attrs = false;
+		bool npn_mode = false;
 		Design *lib = NULL;
 		for (argidx = 1; argidx < args.size(); argidx++) {
 			if (args[argidx] == "-lut_attrs") {
 				// an undocumented debugging option
 				lut_attrs = true;
+			} else if (args[argidx] == "-npn") {
+				npn_mode = true;
 			} else if (args[argidx] == "-lib" && argidx + 1 < args.size()) {
 				if (!saved_designs.count(args[++argidx]))
 					log_cmd_error("No design '%s' found!\n", args[argidx].c_str());
@@ -187,6 +262,10 @@ struct CellmatchPass : Pass {
 
 		dict<pool<uint64_t>, std::vector<Target>> targets;
 
+		// single-output targets by (number of inputs, canonical truth table)
+		std::vector<Target> npn_targets;
+		dict<std::pair<int, uint64_t>, std::vector<std::pair<int, NpnTransform>>> npn_index;
+
 		if (lib)
 		for (auto m : lib->modules()) {
 			pool<uint64_t> p_classes;
@@ -202,7 +281,14 @@ struct CellmatchPass : Pass {
 			log_debug("Registered %s\n", log_id(m));
 
 			// save as a viable target
-			targets[p_classes].push_back(Target{m, luts});
+			if (GetSize(luts) == 1) {
+				NpnTransform transform;
+				uint64_t canon = npn_canonical(ninputs, luts[0], npn_mode, transform);
+				npn_index[std::make_pair(ninputs, canon)].push_back(std::make_pair(GetSize(npn_targets), transform));
+				npn_targets.push_back(Target{m, luts});
+			} else {
+				targets[p_classes].push_back(Target{m, luts});
+			}
 		}
 
 		auto r = saved_designs.emplace("$cellmatch", nullptr);
@@ -210,6 +296,49 @@ struct CellmatchPass : Pass {
 			r.first->second = new Design;
 		Design *map_design = r.first->second;
 
+		// Add target to map_design ("$cellmatch") as a techmap rule to match m
+		// and replace it with target, inverting the ports in input_neg/output_neg
+		auto add_rule = [&](Module *m, Module *target, const std::vector<int> &input_map,
+				const std::vector<int> &output_map, int input_neg, bool output_neg) {
+			SigSpec inputs = module_inputs(m);
+			SigSpec outputs = module_outputs(m);
+			SigSpec target_inputs = module_inputs(target);
+			SigSpec target_outputs = module_outputs(target);
+
+			Module *map = map_design->addModule(stringf("\\_60_%s_%s", log_id(m), log_id(target)));
+			Cell *cell = map->addCell(ID::_TECHMAP_REPLACE_, target->name);
+
+			map->attributes[ID(techmap_celltype)] = m->name.str();
+
+			for (int i = 0; i < outputs.size(); i++) {
+				log_assert(outputs[i].is_wire());
+				Wire *w = map->addWire(outputs[i].wire->name, 1);
+				w->port_id = outputs[i].wire->port_id;
+				w->port_output = true;
+				log_assert(target_outputs[output_map[i]].is_wire());
+				SigSpec sig = w;
+				if (output_neg) {
+					sig = map->addWire(NEW_ID);
+					map->addNotGate(NEW_ID, sig, w);
+				}
+				cell->setPort(target_outputs[output_map[i]].wire->name, sig);
+			}
+
+			for (int i = 0; i < inputs.size(); i++) {
+				log_assert(inputs[i].is_wire());
+				Wire *w = map->addWire(inputs[i].wire->name, 1);
+				w->port_id = inputs[i].wire->port_id;
+				w->port_input = true;
+				log_assert(target_inputs[input_map[i]].is_wire());
+				SigSpec sig = w;
+				if (input_neg >> i & 1)
+					sig = map->NotGate(NEW_ID, w);
+				cell->setPort(target_inputs[input_map[i]].wire->name, sig);
+			}
+
+			map->fixup_ports();
+		};
+
 		for (auto m : d->selected_whole_modules_warn()) {
 			std::vector<uint64_t> luts;
 			if (!derive_module_luts(m, luts))
@@ -227,6 +356,46 @@ struct CellmatchPass : Pass {
 				}
 			}
 
+			if (GetSize(outputs) == 1) {
+				NpnTransform transform;
+				uint64_t canon = npn_canonical(inputs.size(), luts[0], npn_mode, transform);
+				auto it = npn_index.find(std::make_pair(inputs.size(), canon));
+				if (it == npn_index.end())
+					continue;
+
+				for (auto &entry : it->second) {
+					const Target &target = npn_targets[entry.first];
+					const NpnTransform &target_transform = entry.second;
+
+					// both tables reach the same canonical form, so m's input
+					// transform.varmap[l] corresponds to the target's input
+					// target_transform.varmap[l], through the combined inversions
+					std::vector<int> input_map(inputs.size());
+					int input_neg = 0;
+					for (int l = 0; l < inputs.size(); l++) {
+						input_map[transform.varmap[l]] = target_transform.varmap[l];
+						if ((transform.input_neg ^ target_transform.input_neg) >> l & 1)
+							input_neg |= 1 << transform.varmap[l];
+					}
+					bool output_neg = transform.output_neg != target_transform.output_neg;
+
+					for (int x = 0; x < 1 << inputs.size(); x++) {
+						int y = 0;
+						for (int i = 0; i < inputs.size(); i++)
+							if ((x ^ input_neg) >> i & 1)
+								y |= 1 << input_map[i];
+						log_assert(((luts[0] >> x) & 1) == (((target.luts[0] >> y) & 1) ^ output_neg));
+					}
+
+					if (input_neg || output_neg)
+						log("Module %s matches %s with inverted ports\n", log_id(m), log_id(target.module));
+					else
+						log("Module %s matches %s\n", log_id(m), log_id(target.module));
+					add_rule(m, target.module, input_map, std::vector<int>{0}, input_neg, output_neg);
+				}
+				continue;
+			}
+
 			// fingerprint
 			pool<uint64_t> p_classes;
 			for (auto lut : luts)
@@ -268,32 +437,7 @@ struct CellmatchPass : Pass {
 
 						if (match) {
 							log("Module %s matches %s\n", log_id(m), log_id(target.module));
-							// Add target.module to map_design ("$cellmatch")
-							// as a techmap rule to match m and replace it with target.module
-							Module *map = map_design->addModule(stringf("\\_60_%s_%s", log_id(m), log_id(target.module)));
-							Cell *cell = map->addCell(ID::_TECHMAP_REPLACE_, target.module->name);
-
-							map->attributes[ID(techmap_celltype)] = m->name.str();
-
-							for (int i = 0; i < outputs.size(); i++) {
-								log_assert(outputs[i].is_wire());
-								Wire *w = map->addWire(outputs[i].wire->name, 1);
-								w->port_id = outputs[i].wire->port_id;
-								w->port_output = true;
-								log_assert(target_outputs[output_map[i]].is_wire());
-								cell->setPort(target_outputs[output_map[i]].wire->name, w);
-							}
-
-							for (int i = 0; i < inputs.size(); i++) {
-								log_assert(inputs[i].is_wire());
-								Wire *w = map->addWire(inputs[i].wire->name, 1);
-								w->port_id = inputs[i].wire->port_id;
-								w->port_input = true;
-								log_assert(target_inputs[input_map[i]].is_wire());
-								cell->setPort(target_inputs[input_map[i]].wire->name, w);
-							}
-
-							map->fixup_ports();
+							add_rule(m, target.module, input_map, output_map, 0, false);
 							found_match = true;
 						}
 
@@ -945,10 +945,7 @@ struct DffLegalizePass : public Pass {
 		pol = !pol;
 	}
 
-	void legalize_finish(FfData &ff) {
-		int ff_type = get_ff_type(ff);
-		int initmask = get_initmask(ff);
-		log_assert(supported_cells[ff_type] & initmask);
+	int get_ff_neg(const FfData &ff) {
 		int ff_neg = 0;
 		if (ff.has_sr) {
 			if (!ff.pol_clr)
@@ -976,6 +973,27 @@ struct DffLegalizePass : public Pass {
 			if (!ff.pol_ce)
 				ff_neg |= NEG_CE;
 		}
+		return ff_neg;
+	}
+
+	// Whether legalize_ff would emit the FF without any change: it already
+	// has a supported type, polarity and init value, and neither -mince nor
+	// -minsrst applies to it.  Such FFs are left in place.
+	bool is_legal(FfData &ff) {
+		if (ff.has_gclk || !ff.is_fine)
+			return true;
+		if (mince && ff.has_ce && ff.sig_ce[0].wire && ce_used[ff.sig_ce[0]] < mince)
+			return false;
+		if (minsrst && ff.has_srst && ff.sig_srst[0].wire && srst_used[ff.sig_srst[0]] < minsrst)
+			return false;
+		return supported_cells_neg[get_ff_type(ff)][get_ff_neg(ff)] & get_initmask(ff);
+	}
+
+	void legalize_finish(FfData &ff) {
+		int ff_type = get_ff_type(ff);
+		int initmask = get_initmask(ff);
+		log_assert(supported_cells[ff_type] & initmask);
+		int ff_neg = get_ff_neg(ff);
 		if (!(supported_cells_neg[ff_type][ff_neg] & initmask)) {
 			// Cell is supported, but not with those polarities.
 			// Will need to add some inverters.
@@ -1211,6 +1229,8 @@ unrecognized:
 				if (!RTLIL::builtin_ff_cell_types().count(cell->type))
 					continue;
 				FfData ff(&initvals, cell);
+				if (is_legal(ff))
+					continue;
 				legalize_ff(ff);
 			}
 		}
@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "libparse.h"
+#include "libs/sha1/sha1.h"
 #include <string.h>
 #include <errno.h>
 
@@ -32,6 +33,82 @@ struct cell_mapping {
 };
 static std::map<RTLIL::IdString, cell_mapping> cell_mappings;
 
+// The cell_mappings derived from a library, keyed by the SHA1 of the liberty
+// file content and the -dont_use patterns. They are kept for the lifetime of
+// the process and, like the parsed library, stored in the YOSYS_LIBERTY_CACHE
+// directory as a small text file of "<type> <cell> <nports>" lines, each
+// followed by <nports> "<pin> <code>" lines.
+static dict<std::string, std::map<RTLIL::IdString, cell_mapping>> cell_mapping_cache;
+
+static const char dfflibmap_cache_magic[] = "YSDFFMAP 1";
+
+static bool read_mapping_cache(const std::string &filename)
+{
+	std::ifstream f(filename.c_str());
+	if (f.fail())
+		return false;
+
+	std::string line;
+	if (!std::getline(f, line) || line != dfflibmap_cache_magic)
+		return false;
+
+	std::map<RTLIL::IdString, cell_mapping> mappings;
+	std::string cell_type, cell_name;
+	int num_ports;
+	while (f >> cell_type >> cell_name >> num_ports) {
+		cell_mapping &cm = mappings[RTLIL::IdString(cell_type)];
+		cm.cell_name = cell_name;
+		for (int i = 0; i < num_ports; i++) {
+			std::string port;
+			int code;
+			if (!(f >> port >> code) || code < 0 || code > 127) {
+				log_warning("Ignoring corrupt DFF mapping cache file `%s'.\n", filename.c_str());
+				return false;
+			}
+			cm.ports[port] = code;
+		}
+	}
+
+	if (!f.eof()) {
+		log_warning("Ignoring corrupt DFF mapping cache file `%s'.\n", filename.c_str());
+		return false;
+	}
+
+	cell_mappings.swap(mappings);
+	return true;
+}
+
+static void write_mapping_cache(const std::string &filename)
+{
+	std::string buf = stringf("%s\n", dfflibmap_cache_magic);
+	for (auto &it : cell_mappings) {
+		buf += stringf("%s %s %d\n", it.first.c_str(), it.second.cell_name.c_str(), GetSize(it.second.ports));
+		for (auto &port : it.second.ports) {
+			// names with white space would not read back, such libraries are simply not cached
+			if (port.first.empty() || port.first.find_first_of(" \t\r\n") != std::string::npos)
+				return;
+			buf += stringf("%s %d\n", port.first.c_str(), int(port.second));
+		}
+		if (it.second.cell_name.str().find_first_of(" \t\r\n") != std::string::npos)
+			return;
+	}
+
+	// same write-then-rename scheme as the Liberty AST cache
+#ifdef _WIN32
+	int pid = GetCurrentProcessId();
+#else
+	int pid = getpid();
+#endif
+	std::string tmp_fn = stringf("%s.%d.tmp", filename.c_str(), pid);
+	std::ofstream f(tmp_fn.c_str());
+	if (f.fail())
+		return;
+	f << buf;
+	f.close();
+	if (f.fail() || rename(tmp_fn.c_str(), filename.c_str()) != 0)
+		remove(tmp_fn.c_str());
+}
+
 static void logmap(IdString dff)
 {
 	if (cell_mappings.count(dff) == 0) {
@@ -464,6 +541,11 @@ struct DfflibmapPass : public Pass {
 		log("This argument can be called multiple times with different cell names. This\n");
 		log("argument also supports simple glob patterns in the cell name.\n");
 		log("\n");
+		log("The cell mappings found for a library are reused by later calls with the\n");
+		log("same liberty file content and -dont_use options. If the YOSYS_LIBERTY_CACHE\n");
+		log("environment variable names a directory, they are also stored there for\n");
+		log("later runs.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -523,29 +605,53 @@ struct DfflibmapPass : public Pass {
 		f.open(liberty_file.c_str());
 		if (f.fail())
 			log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-		LibertyParser libparser(f);
+		std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
 		f.close();
 
-		find_cell(libparser.ast, ID($_DFF_N_), false, false, false, false, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_P_), true, false, false, false, dont_use_cells);
-
-		find_cell(libparser.ast, ID($_DFF_NN0_), false, true, false, false, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_NN1_), false, true, false, true, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_NP0_), false, true, true, false, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_NP1_), false, true, true, true, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_PN0_), true, true, false, false, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_PN1_), true, true, false, true, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_PP0_), true, true, true, false, dont_use_cells);
-		find_cell(libparser.ast, ID($_DFF_PP1_), true, true, true, true, dont_use_cells);
-
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNN_), false, false, false, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NNP_), false, false, true, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPN_), false, true, false, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_NPP_), false, true, true, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNN_), true, false, false, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PNP_), true, false, true, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPN_), true, true, false, dont_use_cells);
-		find_cell_sr(libparser.ast, ID($_DFFSR_PPP_), true, true, true, dont_use_cells);
+		std::string cache_key = sha1(content);
+		for (auto &pattern : dont_use_cells)
+			cache_key += "\n" + pattern;
+
+		std::string cache_fn;
+		const char *cache_dir = getenv("YOSYS_LIBERTY_CACHE");
+		if (cache_dir != nullptr && cache_dir[0] != 0)
+			cache_fn = stringf("%s/%s.ydm", cache_dir, sha1(cache_key).c_str());
+
+		auto cached = cell_mapping_cache.find(cache_key);
+		if (cached != cell_mapping_cache.end()) {
+			log("  using cached cell mappings for this library.\n");
+			cell_mappings = cached->second;
+		} else if (!cache_fn.empty() && read_mapping_cache(cache_fn)) {
+			log("  using cell mappings from cache file `%s'.\n", cache_fn.c_str());
+		} else {
+			std::istringstream in(content);
+			LibertyAst *liberty_ast = LibertyCache::parse(in);
+
+			find_cell(liberty_ast, ID($_DFF_N_), false, false, false, false, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_P_), true, false, false, false, dont_use_cells);
+
+			find_cell(liberty_ast, ID($_DFF_NN0_), false, true, false, false, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_NN1_), false, true, false, true, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_NP0_), false, true, true, false, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_NP1_), false, true, true, true, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_PN0_), true, true, false, false, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_PN1_), true, true, false, true, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_PP0_), true, true, true, false, dont_use_cells);
+			find_cell(liberty_ast, ID($_DFF_PP1_), true, true, true, true, dont_use_cells);
+
+			find_cell_sr(liberty_ast, ID($_DFFSR_NNN_), false, false, false, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_NNP_), false, false, true, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_NPN_), false, true, false, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_NPP_), false, true, true, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_PNN_), true, false, false, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_PNP_), true, false, true, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_PPN_), true, true, false, dont_use_cells);
+			find_cell_sr(liberty_ast, ID($_DFFSR_PPP_), true, true, true, dont_use_cells);
+
+			if (!cache_fn.empty())
+				write_mapping_cache(cache_fn);
+		}
+		cell_mapping_cache[cache_key] = cell_mappings;
 
 		log("  final dff cell mappings:\n");
 		logmap_all();
@@ -20,11 +20,13 @@
 #include "kernel/register.h"
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
+#include "kernel/threading.h"
 #include "libs/subcircuit/subcircuit.h"
 #include <algorithm>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -344,6 +346,30 @@ bool compareSortNeedleList(RTLIL::Module *left, RTLIL::Module *right)
 	return left->name < right->name;
 }
 
+// The map design and needle graphs of the last set of -map files, reused by
+// the next extract call with the same files and -constports setting.
+struct needle_cache_t {
+	std::string key;
+	RTLIL::Design *map = nullptr;
+	std::vector<std::pair<RTLIL::Module*, SubCircuit::Graph>> graphs;
+} needle_cache;
+
+// Returns an empty key if the map files cannot be cached (in-memory designs).
+std::string needle_cache_key(const std::vector<std::string> &map_filenames, bool constports)
+{
+	std::string key = constports ? "constports" : "";
+	for (auto filename : map_filenames) {
+		if (filename.compare(0, 1, "%") == 0)
+			return std::string();
+		rewrite_filename(filename);
+		struct stat st;
+		if (stat(filename.c_str(), &st) != 0)
+			return std::string();
+		key += stringf("\n%s %lld %lld", filename.c_str(), (long long)st.st_size, (long long)st.st_mtime);
+	}
+	return key;
+}
+
 struct ExtractPass : public Pass {
 	ExtractPass() : Pass("extract", "find subcircuits and replace them with cells") { }
 	void help() override
@@ -427,6 +453,11 @@ struct ExtractPass : public Pass {
 		log("    -mine_max_fanout <num>\n");
 		log("        don't consider internal signals with more than <num> connections\n");
 		log("\n");
+		log("The map design and needle graphs of the last set of map files are kept for\n");
+		log("the next call that uses the same files, and reloaded when one of them changes.\n");
+		log("When synthesizer runs with -j <jobs>, the haystack modules are searched\n");
+		log("concurrently.\n");
+		log("\n");
 		log("The modules in the map file may have the attribute 'extract_order' set to an\n");
 		log("integer value. Then this value is used to determine the order in which the pass\n");
 		log("tries to map the modules to the design (ascending, default value is 0).\n");
@@ -582,8 +613,14 @@ struct ExtractPass : public Pass {
 			log_cmd_error("Missing option -map <verilog_or_rtlil_file> or -mine <output_rtlil_file>.\n");
 
 		RTLIL::Design *map = nullptr;
+		std::string cache_key = mine_mode ? std::string() : needle_cache_key(map_filenames, constports);
+		bool cached = !cache_key.empty() && cache_key == needle_cache.key;
 
-		if (!mine_mode)
+		if (cached)
+		{
+			map = needle_cache.map;
+		}
+		else if (!mine_mode)
 		{
 			map = new RTLIL::Design;
 			for (auto &filename : map_filenames)
@@ -623,7 +660,19 @@ struct ExtractPass : public Pass {
 
 		log_header(design, "Creating graphs for SubCircuit library.\n");
 
-		if (!mine_mode)
+		if (cached)
+		{
+			log("Reusing needle graphs of the previous call.\n");
+			for (auto &it : needle_cache.graphs) {
+				std::string graph_name = "needle_" + RTLIL::unescape_id(it.first->name);
+				solver.addGraph(graph_name, it.second);
+				needle_map[graph_name] = it.first;
+				needle_list.push_back(it.first);
+			}
+		}
+		else if (!mine_mode)
+		{
+			std::vector<std::pair<RTLIL::Module*, SubCircuit::Graph>> needle_graphs;
 			for (auto module : map->modules()) {
 				SubCircuit::Graph mod_graph;
 				std::string graph_name = "needle_" + RTLIL::unescape_id(module->name);
@@ -632,19 +681,37 @@ struct ExtractPass : public Pass {
 					solver.addGraph(graph_name, mod_graph);
 					needle_map[graph_name] = module;
 					needle_list.push_back(module);
+					if (!cache_key.empty())
+						needle_graphs.emplace_back(module, std::move(mod_graph));
 				}
 			}
 
-		for (auto module : design->modules()) {
-			SubCircuit::Graph mod_graph;
-			std::string graph_name = "haystack_" + RTLIL::unescape_id(module->name);
-			log("Creating haystack graph %s.\n", graph_name.c_str());
-			if (module2graph(mod_graph, module, constports, design, mine_mode ? mine_max_fanout : -1, mine_mode ? &mine_split : nullptr)) {
-				solver.addGraph(graph_name, mod_graph);
-				haystack_map[graph_name] = module;
+			if (!cache_key.empty()) {
+				delete needle_cache.map;
+				needle_cache.key = cache_key;
+				needle_cache.map = map;
+				needle_cache.graphs.swap(needle_graphs);
 			}
 		}
 
+		std::vector<RTLIL::Module*> haystack_modules = design->modules().to_vector();
+		std::vector<SubCircuit::Graph> haystack_graphs(GetSize(haystack_modules));
+		std::vector<char> haystack_valid(GetSize(haystack_modules));
+		parallel_for(GetSize(haystack_modules), [&](int i) {
+			RTLIL::Module *module = haystack_modules[i];
+			log("Creating haystack graph %s.\n", ("haystack_" + RTLIL::unescape_id(module->name)).c_str());
+			haystack_valid[i] = module2graph(haystack_graphs[i], module, constports, design, mine_mode ? mine_max_fanout : -1, mine_mode ? &mine_split : nullptr);
+		});
+
+		for (int i = 0; i < GetSize(haystack_modules); i++) {
+			if (!haystack_valid[i])
+				continue;
+			std::string graph_name = "haystack_" + RTLIL::unescape_id(haystack_modules[i]->name);
+			solver.addGraph(graph_name, haystack_graphs[i]);
+			haystack_map[graph_name] = haystack_modules[i];
+		}
+		haystack_graphs.clear();
+
 		if (!mine_mode)
 		{
 			std::vector<SubCircuit::Solver::Result> results;
@@ -652,11 +719,26 @@ struct ExtractPass : public Pass {
 
 			std::sort(needle_list.begin(), needle_list.end(), compareSortNeedleList);
 
-			for (auto needle : needle_list)
-			for (auto &haystack_it : haystack_map) {
-				log("Solving for %s in %s.\n", ("needle_" + RTLIL::unescape_id(needle->name)).c_str(), haystack_it.first.c_str());
-				solver.solve(results, "needle_" + RTLIL::unescape_id(needle->name), haystack_it.first, false);
-			}
+			// Matches must not overlap, so the needles are tried one after the other in each
+			// haystack, but haystacks do not depend on each other.
+			std::vector<std::string> haystack_names;
+			for (auto &haystack_it : haystack_map)
+				haystack_names.push_back(haystack_it.first);
+
+			std::vector<std::vector<std::vector<SubCircuit::Solver::Result>>> haystack_results(GetSize(haystack_names));
+			parallel_for(GetSize(haystack_names), [&](int i) {
+				haystack_results[i].resize(GetSize(needle_list));
+				for (int j = 0; j < GetSize(needle_list); j++) {
+					std::string needle_name = "needle_" + RTLIL::unescape_id(needle_list[j]->name);
+					log("Solving for %s in %s.\n", needle_name.c_str(), haystack_names[i].c_str());
+					solver.solve(haystack_results[i][j], needle_name, haystack_names[i], false);
+				}
+			});
+
+			for (int j = 0; j < GetSize(needle_list); j++)
+			for (int i = 0; i < GetSize(haystack_names); i++)
+				for (auto &result : haystack_results[i][j])
+					results.push_back(std::move(result));
 			log("Found %d matches.\n", GetSize(results));
 
 			if (results.size() > 0)
@@ -749,7 +831,8 @@ struct ExtractPass : public Pass {
 			f.close();
 		}
 
-		delete map;
+		if (map != needle_cache.map)
+			delete map;
 		log_pop();
 	}
 } ExtractPass;
@@ -610,6 +610,12 @@ void counter_worker(
 		return;
 	}
 
+	//Removed cells stay in the index until the end of the module, so a counter sharing
+	//one of them with an already extracted one can still match. Take each cell only once.
+	if(cells_to_remove.count(extract.count_mux) || cells_to_remove.count(extract.count_reg) ||
+			cells_to_remove.count(extract.overflow_cell))
+		return;
+
 	//Get new cell name
 	string countname = string("$COUNTx$") + log_id(extract.rwire->name.str());
 
@@ -881,8 +887,17 @@ struct ExtractCounterPass : public Pass {
 			pool<Cell*> cells_to_remove;
 			pool<pair<Cell*, string>> cells_to_rename;
 
-			ModIndex index(module);
+			//Every counter is centered on an ALU, don't index modules without one
+			vector<Cell*> alu_cells;
 			for (auto cell : module->selected_cells())
+				if (cell->type == ID($alu))
+					alu_cells.push_back(cell);
+			if (alu_cells.empty())
+				continue;
+
+			//One index for the whole module, it follows the changes made by counter_worker()
+			ModIndex index(module);
+			for (auto cell : alu_cells)
 				counter_worker(index, cell, total_counters, cells_to_remove, cells_to_rename, settings);
 
 			for(auto cell : cells_to_remove)
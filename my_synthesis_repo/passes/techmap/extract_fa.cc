@@ -19,7 +19,6 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
-#include "kernel/consteval.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -51,8 +50,7 @@ struct ExtractFaWorker
 {
 	const ExtractFaConfig &config;
 	Module *module;
-	ConstEval ce;
-	SigMap &sigmap;
+	SigMap sigmap;
 
 	dict<SigBit, Cell*> driver;
 	pool<SigBit> handled_bits;
@@ -80,8 +78,24 @@ struct ExtractFaWorker
 	dict<int, func2_and_info_t> func2_and_info;
 	dict<int, func3_maj_info_t> func3_maj_info;
 
+	// A cut of a node is a set of at most three sorted leaves the node is a
+	// function of. func is the truth table of that function, where bit i is
+	// the value for leaves[v] = (i >> v) & 1. Cuts with fewer leaves repeat
+	// their truth table in the unused upper bits.
+	struct cut_t {
+		SigBit leaves[3];
+		int size;
+		int depth;
+		int func;
+	};
+
+	// upper bound on the cuts per node, against blowup in reconvergent logic
+	static constexpr int max_cuts = 64;
+
+	dict<SigBit, vector<cut_t>> cuts;
+
 	ExtractFaWorker(const ExtractFaConfig &config, Module *module) :
-			config(config), module(module), ce(module), sigmap(ce.assign_map)
+			config(config), module(module), sigmap(module)
 	{
 		for (auto cell : module->selected_cells())
 		{
@@ -153,128 +167,189 @@ struct ExtractFaWorker
 		}
 	}
 
-	void check_partition(SigBit root, pool<SigBit> &leaves)
+	static cut_t trivial_cut(SigBit bit)
 	{
-		if (config.enable_ha && GetSize(leaves) == 2)
-		{
-			leaves.sort();
-
-			SigBit A = SigSpec(leaves)[0];
-			SigBit B = SigSpec(leaves)[1];
-
-			int func = 0;
-			for (int i = 0; i < 4; i++)
-			{
-				bool a_value = (i & 1) != 0;
-				bool b_value = (i & 2) != 0;
-
-				ce.push();
-				ce.set(A, a_value ? State::S1 : State::S0);
-				ce.set(B, b_value ? State::S1 : State::S0);
+		cut_t cut;
+		cut.leaves[0] = bit;
+		cut.size = 1;
+		cut.depth = 0;
+		cut.func = 0xaa;
+		return cut;
+	}
 
-				SigSpec sig = root;
+	// Truth table of a cut over the leaves of a larger cut.
+	static int expand_func(const cut_t &cut, const SigBit *leaves, int size)
+	{
+		int pos[3] = {0, 0, 0};
+		for (int v = 0; v < cut.size; v++)
+			for (int w = 0; w < size; w++)
+				if (leaves[w] == cut.leaves[v])
+					pos[v] = w;
+
+		int func = 0;
+		for (int i = 0; i < 8; i++) {
+			int j = 0;
+			for (int v = 0; v < cut.size; v++)
+				j |= ((i >> pos[v]) & 1) << v;
+			func |= ((cut.func >> j) & 1) << i;
+		}
+		return func;
+	}
 
-				if (!ce.eval(sig)) {
-					ce.pop();
-					return;
-				}
+	static int eval_gate(IdString type, int a, int b, int c, int d, int s)
+	{
+		if (type == ID($_BUF_)) return a;
+		if (type == ID($_NOT_)) return ~a & 0xff;
+		if (type == ID($_AND_)) return a & b;
+		if (type == ID($_NAND_)) return ~(a & b) & 0xff;
+		if (type == ID($_OR_)) return a | b;
+		if (type == ID($_NOR_)) return ~(a | b) & 0xff;
+		if (type == ID($_XOR_)) return a ^ b;
+		if (type == ID($_XNOR_)) return ~(a ^ b) & 0xff;
+		if (type == ID($_ANDNOT_)) return a & ~b & 0xff;
+		if (type == ID($_ORNOT_)) return (a | ~b) & 0xff;
+		if (type == ID($_MUX_)) return (a & ~s) | (b & s);
+		if (type == ID($_NMUX_)) return ~((a & ~s) | (b & s)) & 0xff;
+		if (type == ID($_AOI3_)) return ~((a & b) | c) & 0xff;
+		if (type == ID($_OAI3_)) return ~((a | b) & c) & 0xff;
+		if (type == ID($_AOI4_)) return ~((a & b) | (c & d)) & 0xff;
+		if (type == ID($_OAI4_)) return ~((a | b) & (c | d)) & 0xff;
+		log_abort();
+	}
 
-				if (sig == State::S1)
-					func |= 1 << i;
+	// Combines one cut of each gate input into cuts of the gate output.
+	void merge_cuts(Cell *cell, const vector<const vector<cut_t>*> &input_cuts, const vector<int> &const_funcs,
+			vector<const cut_t*> &chosen, vector<cut_t> &result, dict<tuple<SigBit, SigBit, SigBit>, int> &index)
+	{
+		if (GetSize(result) >= max_cuts)
+			return;
 
-				ce.pop();
+		int k = GetSize(chosen);
+		if (k < GetSize(input_cuts)) {
+			if (input_cuts[k] == nullptr) {
+				chosen.push_back(nullptr);
+				merge_cuts(cell, input_cuts, const_funcs, chosen, result, index);
+				chosen.pop_back();
+				return;
 			}
-
-			// log("%04d %s %s -> %s\n", bindec(func), log_signal(A), log_signal(B), log_signal(root));
-
-			if (func == xor2_func || func == xnor2_func)
-				xorxnor2.insert(tuple<SigBit, SigBit>(A, B));
-
-			count_func2++;
-			func2[tuple<SigBit, SigBit>(A, B)][func].insert(root);
+			for (auto &cut : *input_cuts[k]) {
+				chosen.push_back(&cut);
+				merge_cuts(cell, input_cuts, const_funcs, chosen, result, index);
+				chosen.pop_back();
+			}
+			return;
 		}
 
-		if (config.enable_fa && GetSize(leaves) == 3)
-		{
-			leaves.sort();
-
-			SigBit A = SigSpec(leaves)[0];
-			SigBit B = SigSpec(leaves)[1];
-			SigBit C = SigSpec(leaves)[2];
-
-			int func = 0;
-			for (int i = 0; i < 8; i++)
-			{
-				bool a_value = (i & 1) != 0;
-				bool b_value = (i & 2) != 0;
-				bool c_value = (i & 4) != 0;
-
-				ce.push();
-				ce.set(A, a_value ? State::S1 : State::S0);
-				ce.set(B, b_value ? State::S1 : State::S0);
-				ce.set(C, c_value ? State::S1 : State::S0);
-
-				SigSpec sig = root;
-
-				if (!ce.eval(sig)) {
-					ce.pop();
+		cut_t cut;
+		cut.size = 0;
+		cut.depth = 0;
+		for (auto input : chosen) {
+			if (input == nullptr)
+				continue;
+			cut.depth = max(cut.depth, input->depth + 1);
+			for (int v = 0; v < input->size; v++) {
+				int w = 0;
+				while (w < cut.size && cut.leaves[w] < input->leaves[v])
+					w++;
+				if (w < cut.size && cut.leaves[w] == input->leaves[v])
+					continue;
+				if (cut.size == min(3, config.maxbreadth))
 					return;
-				}
-
-				if (sig == State::S1)
-					func |= 1 << i;
-
-				ce.pop();
+				for (int u = cut.size; u > w; u--)
+					cut.leaves[u] = cut.leaves[u-1];
+				cut.leaves[w] = input->leaves[v];
+				cut.size++;
 			}
+		}
+		if (cut.size == 0 || cut.depth > config.maxdepth)
+			return;
 
-			// log("%08d %s %s %s -> %s\n", bindec(func), log_signal(A), log_signal(B), log_signal(C), log_signal(root));
-
-			if (func == xor3_func || func == xnor3_func)
-				xorxnor3.insert(tuple<SigBit, SigBit, SigBit>(A, B, C));
-
-			count_func3++;
-			func3[tuple<SigBit, SigBit, SigBit>(A, B, C)][func].insert(root);
+		int funcs[5];
+		for (int i = 0; i < GetSize(chosen); i++)
+			funcs[i] = chosen[i] ? expand_func(*chosen[i], cut.leaves, cut.size) : const_funcs[i];
+		cut.func = eval_gate(cell->type, funcs[0], funcs[1], funcs[2], funcs[3], funcs[4]);
+
+		tuple<SigBit, SigBit, SigBit> key(cut.leaves[0], cut.size > 1 ? cut.leaves[1] : SigBit(), cut.size > 2 ? cut.leaves[2] : SigBit());
+		auto it = index.find(key);
+		if (it == index.end()) {
+			index[key] = GetSize(result);
+			result.push_back(cut);
+		} else if (result[it->second].depth > cut.depth) {
+			result[it->second].depth = cut.depth;
 		}
 	}
 
-	void find_partitions(SigBit root, pool<SigBit> &leaves, pool<pool<SigBit>> &cache, int maxdepth, int maxbreadth)
+	// Enumerates the cuts of root and of its transitive fan-in bottom-up,
+	// each node only once.
+	void compute_cuts(SigBit root)
 	{
-		if (cache.count(leaves))
+		if (cuts.count(root))
 			return;
 
-		// log("%*s[%d] %s:", 20-maxdepth, "", maxdepth, log_signal(root));
-		// for (auto bit : leaves)
-		// 	log(" %s", log_signal(bit));
-		// log("\n");
-
-		cache.insert(leaves);
-		check_partition(root, leaves);
-
-		if (maxdepth == 0)
-			return;
-
-		for (SigBit bit : leaves)
+		vector<pair<SigBit, bool>> stack = {{root, false}};
+		pool<SigBit> active;
+		while (!stack.empty())
 		{
-			if (driver.count(bit) == 0)
+			SigBit bit = stack.back().first;
+			bool expanded = stack.back().second;
+			stack.pop_back();
+			if (cuts.count(bit))
 				continue;
 
-			Cell *cell = driver.at(bit);
-			pool<SigBit> new_leaves = leaves;
-
-			new_leaves.erase(bit);
-			for (auto port : {ID::A, ID::B, ID::C, ID::D}) {
-				if (!cell->hasPort(port))
-					continue;
-				auto bit = sigmap(SigBit(cell->getPort(port)));
-				if (!bit.wire)
-					continue;
-				new_leaves.insert(bit);
+			if (driver.count(bit) == 0) {
+				cuts[bit] = {trivial_cut(bit)};
+				continue;
 			}
 
-			if (GetSize(new_leaves) > maxbreadth)
+			Cell *cell = driver.at(bit);
+			if (!expanded) {
+				active.insert(bit);
+				stack.push_back({bit, true});
+				for (auto port : {ID::A, ID::B, ID::C, ID::D, ID::S}) {
+					if (!cell->hasPort(port))
+						continue;
+					auto input = sigmap(SigBit(cell->getPort(port)));
+					if (input.wire && !cuts.count(input) && !active.count(input))
+						stack.push_back({input, false});
+				}
 				continue;
+			}
+			active.erase(bit);
+
+			// inputs on a combinational loop and x or z inputs end all cuts here
+			vector<cut_t> result = {trivial_cut(bit)};
+			vector<const vector<cut_t>*> input_cuts;
+			vector<int> const_funcs;
+			bool expandable = true;
+			for (auto port : {ID::A, ID::B, ID::C, ID::D, ID::S}) {
+				if (!cell->hasPort(port)) {
+					input_cuts.push_back(nullptr);
+					const_funcs.push_back(0);
+					continue;
+				}
+				auto input = sigmap(SigBit(cell->getPort(port)));
+				if (input.wire == nullptr) {
+					if (input != State::S0 && input != State::S1)
+						expandable = false;
+					input_cuts.push_back(nullptr);
+					const_funcs.push_back(input == State::S1 ? 0xff : 0);
+				} else if (cuts.count(input) == 0) {
+					expandable = false;
+					input_cuts.push_back(nullptr);
+					const_funcs.push_back(0);
+				} else {
+					input_cuts.push_back(&cuts.at(input));
+					const_funcs.push_back(0);
+				}
+			}
 
-			find_partitions(root, new_leaves, cache, maxdepth-1, maxbreadth);
+			if (expandable) {
+				dict<tuple<SigBit, SigBit, SigBit>, int> index;
+				index[tuple<SigBit, SigBit, SigBit>(bit, SigBit(), SigBit())] = 0;
+				vector<const cut_t*> chosen;
+				merge_cuts(cell, input_cuts, const_funcs, chosen, result, index);
+			}
+			cuts[bit] = std::move(result);
 		}
 	}
 
@@ -297,8 +372,6 @@ struct ExtractFaWorker
 				continue;
 
 			SigBit root = it.first;
-			pool<SigBit> leaves = { root };
-			pool<pool<SigBit>> cache;
 
 			if (config.verbose)
 				log("  checking %s\n", log_signal(it.first));
@@ -306,7 +379,28 @@ struct ExtractFaWorker
 			count_func2 = 0;
 			count_func3 = 0;
 
-			find_partitions(root, leaves, cache, config.maxdepth, config.maxbreadth);
+			compute_cuts(root);
+			for (auto &cut : cuts.at(root))
+			{
+				if (config.enable_ha && cut.size == 2)
+				{
+					auto key = tuple<SigBit, SigBit>(cut.leaves[0], cut.leaves[1]);
+					int func = cut.func & 0xf;
+					if (func == xor2_func || func == xnor2_func)
+						xorxnor2.insert(key);
+					count_func2++;
+					func2[key][func].insert(root);
+				}
+
+				if (config.enable_fa && cut.size == 3)
+				{
+					auto key = tuple<SigBit, SigBit, SigBit>(cut.leaves[0], cut.leaves[1], cut.leaves[2]);
+					if (cut.func == xor3_func || cut.func == xnor3_func)
+						xorxnor3.insert(key);
+					count_func3++;
+					func3[key][cut.func].insert(root);
+				}
+			}
 
 			if (config.verbose && count_func2 > 0)
 				log("    extracted %d two-input functions\n", count_func2);
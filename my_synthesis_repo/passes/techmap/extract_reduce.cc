@@ -117,9 +117,16 @@ struct ExtractReducePass : public Pass
 
 			// Actual logic starts here
 			pool<Cell*> consumed_cells;
+
+			// Without off-chain loads, every cell of a chain leads to the same head, and
+			// the inner cells of a reduce tree feed only that tree. Remember both, so that
+			// each chain is walked and each tree is built only once.
+			dict<Cell*, Cell*> chain_head;
+			pool<Cell*> inner_cells_done;
+
 			for (auto cell : module->selected_cells())
 			{
-				if (consumed_cells.count(cell))
+				if (consumed_cells.count(cell) || inner_cells_done.count(cell))
 					continue;
 
 				GateType gt;
@@ -141,12 +148,20 @@ struct ExtractReducePass : public Pass
 				{
 					Cell* head_cell = cell;
 					Cell* x = cell;
+					vector<Cell*> chain;
 					while (true)
 					{
 						if(!IsRightType(x, gt))
 							break;
 
+						auto known = chain_head.find(x);
+						if (known != chain_head.end()) {
+							head_cell = known->second;
+							break;
+						}
+
 						head_cell = x;
+						chain.push_back(x);
 
 						auto y = sigmap(x->getPort(ID::Y));
 						log_assert(y.size() == 1);
@@ -158,6 +173,8 @@ struct ExtractReducePass : public Pass
 						x = *sig_to_sink[y].begin();
 					}
 
+					for (auto c : chain)
+						chain_head[c] = head_cell;
 					sinks.insert(head_cell);
 				}
 
@@ -227,6 +244,7 @@ struct ExtractReducePass : public Pass
 						continue;
 
 					dict<SigBit, int> sources;
+					vector<Cell*> inner_cell_list;
 					int inner_cells = 0;
 					std::deque<Cell*> bfs_queue = {head_cell};
 					while (bfs_queue.size())
@@ -244,6 +262,7 @@ struct ExtractReducePass : public Pass
 
 							if (drv_ok && (allow_off_chain || sink_single)) {
 								inner_cells++;
+								inner_cell_list.push_back(drv);
 								bfs_queue.push_back(drv);
 							} else {
 								sources[bit]++;
@@ -280,6 +299,9 @@ struct ExtractReducePass : public Pass
 						}
 
 						consumed_cells.insert(head_cell);
+						if (!allow_off_chain)
+							for (auto c : inner_cell_list)
+								inner_cells_done.insert(c);
 					}
 				}
 			}
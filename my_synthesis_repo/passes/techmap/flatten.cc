@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/utils.h"
 #include "kernel/sigtools.h"
+#include "kernel/scopeinfo.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -28,22 +29,23 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-IdString concat_name(RTLIL::Cell *cell, IdString object_name)
+// The part of a flattened object's name that does not depend on the cell
+std::string name_suffix(IdString object_name)
 {
 	if (object_name[0] == '\\')
-		return stringf("%s.%s", cell->name.c_str(), object_name.c_str() + 1);
-	else {
-		std::string object_name_str = object_name.str();
-		if (object_name_str.substr(0, 8) == "$flatten")
-			object_name_str.erase(0, 8);
-		return stringf("$flatten%s.%s", cell->name.c_str(), object_name_str.c_str());
-	}
+		return stringf(".%s", object_name.c_str() + 1);
+	std::string object_name_str = object_name.str();
+	if (object_name_str.substr(0, 8) == "$flatten")
+		object_name_str.erase(0, 8);
+	return "." + object_name_str;
 }
 
-template<class T>
-IdString map_name(RTLIL::Cell *cell, T *object)
+IdString concat_name(RTLIL::Cell *cell, IdString object_name)
 {
-	return cell->module->uniquify(concat_name(cell, object->name));
+	if (object_name[0] == '\\')
+		return cell->name.str() + name_suffix(object_name);
+	else
+		return "$flatten" + cell->name.str() + name_suffix(object_name);
 }
 
 void map_sigspec(const dict<RTLIL::Wire*, RTLIL::Wire*> &map, RTLIL::SigSpec &sig, RTLIL::Module *into = nullptr)
@@ -60,6 +62,53 @@ struct FlattenWorker
 	bool ignore_wb = false;
 	bool create_scopeinfo = true;
 	bool create_scopename = false;
+	bool compact_names = false;
+	bool scope_ids = false;
+
+	// What flatten_cell() needs to know about a template, computed once and
+	// shared by all its instances. Recomputed if the template was changed.
+	struct TemplateInfo
+	{
+		unsigned int generation = 0;
+		dict<IdString, IdString> positional_ports;
+		pool<SigBit> driven;
+		dict<IdString, std::string> name_suffixes;
+	};
+
+	dict<RTLIL::Module*, TemplateInfo> template_infos;
+
+	const TemplateInfo &template_info(RTLIL::Module *tpl)
+	{
+		auto it = template_infos.find(tpl);
+		if (it != template_infos.end() && it->second.generation == tpl->generation_)
+			return it->second;
+
+		TemplateInfo &info = template_infos[tpl];
+		info = TemplateInfo();
+		info.generation = tpl->generation_;
+
+		for (auto &it : tpl->memories)
+			info.name_suffixes[it.first] = name_suffix(it.first);
+		for (auto &it : tpl->processes)
+			info.name_suffixes[it.first] = name_suffix(it.first);
+		for (auto tpl_wire : tpl->wires()) {
+			if (tpl_wire->port_id > 0)
+				info.positional_ports.emplace(stringf("$%d", tpl_wire->port_id), tpl_wire->name);
+			info.name_suffixes[tpl_wire->name] = name_suffix(tpl_wire->name);
+		}
+		for (auto tpl_cell : tpl->cells()) {
+			info.name_suffixes[tpl_cell->name] = name_suffix(tpl_cell->name);
+			for (auto &tpl_conn : tpl_cell->connections())
+				if (tpl_cell->output(tpl_conn.first))
+					for (auto bit : tpl_conn.second)
+						info.driven.insert(bit);
+		}
+		for (auto &tpl_conn : tpl->connections())
+			for (auto bit : tpl_conn.first)
+				info.driven.insert(bit);
+
+		return info;
+	}
 
 	template<class T>
 	void map_attributes(RTLIL::Cell *cell, T *object, IdString orig_object_name)
@@ -70,7 +119,9 @@ struct FlattenWorker
 		// Preserve original names via the hdlname attribute, but only for objects with a fully public name.
 		// If the '-scopename' option is used, also preserve the containing scope of private objects if their scope is fully public.
 		if (cell->name[0] == '\\') {
-			if (object->has_attribute(ID::hdlname) || orig_object_name[0] == '\\') {
+			if (scope_ids && !object->has_attribute(ID::hdlname) && orig_object_name[0] == '\\') {
+				// The path is implied by the compact name.
+			} else if (object->has_attribute(ID::hdlname) || orig_object_name[0] == '\\') {
 				std::string new_hdlname;
 
 				if (cell->has_attribute(ID::hdlname)) {
@@ -109,25 +160,61 @@ struct FlattenWorker
 
 	void flatten_cell(RTLIL::Design *design, RTLIL::Module *module, RTLIL::Cell *cell, RTLIL::Module *tpl, SigMap &sigmap, std::vector<RTLIL::Cell*> &new_cells)
 	{
+		const TemplateInfo &info = template_info(tpl);
+
 		// Copy the contents of the flattened cell
 
+		std::string public_prefix = cell->name.str();
+		std::string private_prefix = compact_names ? NEW_ID_PREFIX : "$flatten" + cell->name.str();
+
+		// With -scopeids, scopes of the template get fresh ids for every instance
+		bool use_scope_ids = scope_ids && cell->name.isPublic();
+		int scope = use_scope_ids ? next_autoidx() : 0;
+		dict<int, int> scope_map;
+		auto map_scope = [&](int tpl_scope) {
+			auto it = scope_map.find(tpl_scope);
+			if (it != scope_map.end())
+				return it->second;
+			int new_scope = next_autoidx();
+			scope_map[tpl_scope] = new_scope;
+			return new_scope;
+		};
+
+		auto hier_name = [&](IdString object_name) -> IdString {
+			if (object_name[0] == '\\' && use_scope_ids) {
+				int tpl_scope;
+				IdString leaf;
+				if (parse_compact_hier_name(object_name, tpl_scope, leaf))
+					return compact_hier_name(map_scope(tpl_scope), leaf);
+				return compact_hier_name(scope, object_name);
+			}
+			if (object_name[0] == '\\')
+				return public_prefix + info.name_suffixes.at(object_name);
+			if (compact_names)
+				return private_prefix + std::to_string(next_autoidx());
+			return private_prefix + info.name_suffixes.at(object_name);
+		};
+		auto map_name = [&](IdString object_name) {
+			return module->uniquify(hier_name(object_name));
+		};
+
+		module->reserve_wires(GetSize(tpl->wires_));
+		module->reserve_cells(GetSize(tpl->cells_));
+
 		dict<IdString, IdString> memory_map;
 		for (auto &tpl_memory_it : tpl->memories) {
-			RTLIL::Memory *new_memory = module->addMemory(map_name(cell, tpl_memory_it.second), tpl_memory_it.second);
+			RTLIL::Memory *new_memory = module->addMemory(map_name(tpl_memory_it.first), tpl_memory_it.second);
 			map_attributes(cell, new_memory, tpl_memory_it.second->name);
 			memory_map[tpl_memory_it.first] = new_memory->name;
 			design->select(module, new_memory);
 		}
 
 		dict<RTLIL::Wire*, RTLIL::Wire*> wire_map;
-		dict<IdString, IdString> positional_ports;
+		wire_map.reserve(GetSize(tpl->wires_));
 		for (auto tpl_wire : tpl->wires()) {
-			if (tpl_wire->port_id > 0)
-				positional_ports.emplace(stringf("$%d", tpl_wire->port_id), tpl_wire->name);
-
 			RTLIL::Wire *new_wire = nullptr;
 			if (tpl_wire->name[0] == '\\') {
-				RTLIL::Wire *hier_wire = module->wire(concat_name(cell, tpl_wire->name));
+				RTLIL::Wire *hier_wire = module->wire(hier_name(tpl_wire->name));
 				if (hier_wire != nullptr && hier_wire->get_bool_attribute(ID::hierconn)) {
 					hier_wire->attributes.erase(ID::hierconn);
 					if (GetSize(hier_wire) < GetSize(tpl_wire)) {
@@ -139,7 +226,7 @@ struct FlattenWorker
 				}
 			}
 			if (new_wire == nullptr) {
-				new_wire = module->addWire(map_name(cell, tpl_wire), tpl_wire);
+				new_wire = module->addWire(map_name(tpl_wire->name), tpl_wire);
 				new_wire->port_input = new_wire->port_output = false;
 				new_wire->port_id = false;
 			}
@@ -150,7 +237,7 @@ struct FlattenWorker
 		}
 
 		for (auto &tpl_proc_it : tpl->processes) {
-			RTLIL::Process *new_proc = module->addProcess(map_name(cell, tpl_proc_it.second), tpl_proc_it.second);
+			RTLIL::Process *new_proc = module->addProcess(map_name(tpl_proc_it.first), tpl_proc_it.second);
 			map_attributes(cell, new_proc, tpl_proc_it.second->name);
 			for (auto new_proc_sync : new_proc->syncs)
 				for (auto &memwr_action : new_proc_sync->mem_write_actions)
@@ -161,8 +248,14 @@ struct FlattenWorker
 		}
 
 		for (auto tpl_cell : tpl->cells()) {
-			RTLIL::Cell *new_cell = module->addCell(map_name(cell, tpl_cell), tpl_cell);
+			RTLIL::Cell *new_cell = module->addCell(map_name(tpl_cell->name), tpl_cell);
 			map_attributes(cell, new_cell, tpl_cell->name);
+			if (new_cell->type == ID($scopeinfo) && new_cell->has_attribute(ID(scope_id))) {
+				if (use_scope_ids)
+					new_cell->attributes[ID(scope_id)] = map_scope(new_cell->attributes.at(ID(scope_id)).as_int());
+				else
+					new_cell->attributes.erase(ID(scope_id));
+			}
 			if (new_cell->has_memid()) {
 				IdString memid = new_cell->getParam(ID::MEMID).decode_string();
 				new_cell->setParam(ID::MEMID, Const(memory_map.at(memid).str()));
@@ -185,21 +278,11 @@ struct FlattenWorker
 
 		// Attach port connections of the flattened cell
 
-		pool<SigBit> tpl_driven;
-		for (auto tpl_cell : tpl->cells())
-			for (auto &tpl_conn : tpl_cell->connections())
-				if (tpl_cell->output(tpl_conn.first))
-					for (auto bit : tpl_conn.second)
-						tpl_driven.insert(bit);
-		for (auto &tpl_conn : tpl->connections())
-			for (auto bit : tpl_conn.first)
-				tpl_driven.insert(bit);
-
 		for (auto &port_it : cell->connections())
 		{
 			IdString port_name = port_it.first;
-			if (positional_ports.count(port_name) > 0)
-				port_name = positional_ports.at(port_name);
+			if (info.positional_ports.count(port_name) > 0)
+				port_name = info.positional_ports.at(port_name);
 			if (tpl->wire(port_name) == nullptr || tpl->wire(port_name)->port_id == 0) {
 				if (port_name.begins_with("$"))
 					log_error("Can't map port `%s' of cell `%s' to template `%s'!\n",
@@ -224,7 +307,7 @@ struct FlattenWorker
 			} else {
 				SigSpec sig_tpl = tpl_wire, sig_mod = port_it.second;
 				for (int i = 0; i < GetSize(sig_tpl) && i < GetSize(sig_mod); i++) {
-					if (tpl_driven.count(sig_tpl[i])) {
+					if (info.driven.count(sig_tpl[i])) {
 						new_conn.first.append(sig_mod[i]);
 						new_conn.second.append(sig_tpl[i]);
 					} else {
@@ -271,6 +354,9 @@ struct FlattenWorker
 				scopeinfo->attributes.emplace(stringf("\\module_%s", RTLIL::unescape_id(attr.first).c_str()), attr.second);
 
 			scopeinfo->attributes.emplace(ID(module), RTLIL::unescape_id(tpl->name));
+
+			if (use_scope_ids)
+				scopeinfo->attributes[ID(scope_id)] = scope;
 		}
 
 		module->remove(cell);
@@ -345,6 +431,19 @@ struct FlattenPass : public Pass {
 		log("        with a public name the enclosing scope can be found via their\n");
 		log("        'hdlname' attribute.\n");
 		log("\n");
+		log("    -compactnames\n");
+		log("        Give objects with a private name short generated names instead of\n");
+		log("        names that spell out the whole instance path. Together with\n");
+		log("        -scopename the enclosing scope of such objects is still recorded.\n");
+		log("\n");
+		log("    -scopeids\n");
+		log("        Name objects with a public name '\\@<id>.<name>', where <id> is the\n");
+		log("        'scope_id' attribute of the '$scopeinfo' cell of the flattened instance,\n");
+		log("        and don't create 'hdlname' attributes for them. This avoids storing the\n");
+		log("        full instance path in every name, which can take a lot of memory for\n");
+		log("        deep hierarchies. Use 'rename -hiernames' to restore the usual names\n");
+		log("        before writing the design.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -367,10 +466,23 @@ struct FlattenPass : public Pass {
 				worker.create_scopename = true;
 				continue;
 			}
+			if (args[argidx] == "-compactnames") {
+				worker.compact_names = true;
+				continue;
+			}
+			if (args[argidx] == "-scopeids") {
+				worker.scope_ids = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
 
+		if (worker.scope_ids && !worker.create_scopeinfo)
+			log_cmd_error("Option -scopeids requires '$scopeinfo' cells and can't be used with -noscopeinfo.\n");
+		if (worker.scope_ids && worker.create_scopename)
+			log_cmd_error("Options -scopeids and -scopename can't be used together.\n");
+
 		RTLIL::Module *top = nullptr;
 		if (design->full_selection())
 			for (auto module : design->modules())
@@ -99,6 +99,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/modtools.h"
 #include "kernel/consteval.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -445,6 +446,194 @@ struct FlowGraph
 	}
 };
 
+// FlowSolver computes the same labels and cuts as FlowGraph, but works on an indexed copy of the gate IR instead of SigBit keyed dicts,
+// and keeps all of its buffers between calls. Once the buffers have grown to the size of the largest cone, labeling a node does not
+// allocate. The flow through Nt'' never exceeds k+1, so at most k+2 breadth first searches for an augmenting path are needed per node,
+// which is also the bound a push-relabel solver would have to beat; the searches themselves are what used to be slow.
+//
+// Vertex 0 is the source and vertex 1 is the sink of Nt''. Every other node of Nt' is split into a top vertex (even) and a bottom
+// vertex (odd) joined by an edge of capacity 1. Edges are stored in pairs, so that edge ^ 1 is the residual edge of edge.
+struct FlowSolver
+{
+	struct Result
+	{
+		int label;
+		vector<int> xi, k;
+	};
+
+	static constexpr int SOURCE = 0, SINK = 1;
+	static constexpr int INFINITE_FLOW = 1 << 30;
+
+	int order;
+	const vector<vector<int>> &fanin;
+	const vector<int> &labels;
+	const vector<char> &is_input;
+
+	// indexed by gate IR node, valid where stamp == generation
+	unsigned int generation = 0;
+	vector<unsigned int> stamp, k_stamp;
+	vector<int> vertex;
+	vector<char> in_x;
+	vector<int> cone, worklist;
+
+	// indexed by Nt'' vertex or edge
+	vector<int> edge_head, edge_next, edge_to, edge_cap;
+	vector<int> parent_edge, queue;
+	vector<char> reached;
+
+	FlowSolver(int order, const vector<vector<int>> &fanin, const vector<int> &labels, const vector<char> &is_input) :
+		order(order), fanin(fanin), labels(labels), is_input(is_input),
+		stamp(fanin.size()), k_stamp(fanin.size()), vertex(fanin.size()), in_x(fanin.size()) {}
+
+	void add_edge(int from, int to, int cap)
+	{
+		edge_to.push_back(to);
+		edge_cap.push_back(cap);
+		edge_next.push_back(edge_head[from]);
+		edge_head[from] = GetSize(edge_to) - 1;
+
+		edge_to.push_back(from);
+		edge_cap.push_back(0);
+		edge_next.push_back(edge_head[to]);
+		edge_head[to] = GetSize(edge_to) - 1;
+	}
+
+	int top(int node) const
+	{
+		return vertex[node];
+	}
+
+	int bottom(int node) const
+	{
+		return vertex[node] == SINK ? SINK : vertex[node] + 1;
+	}
+
+	bool find_augmenting_path()
+	{
+		reached.assign(edge_head.size(), 0);
+		parent_edge.resize(edge_head.size());
+		queue.clear();
+		queue.push_back(SOURCE);
+		reached[SOURCE] = 1;
+		for (int i = 0; i < GetSize(queue); i++)
+		{
+			for (int edge = edge_head[queue[i]]; edge != -1; edge = edge_next[edge])
+			{
+				int next = edge_to[edge];
+				if (edge_cap[edge] == 0 || reached[next])
+					continue;
+				reached[next] = 1;
+				parent_edge[next] = edge;
+				if (next == SINK)
+					return true;
+				queue.push_back(next);
+			}
+		}
+		return false;
+	}
+
+	void augment()
+	{
+		for (int v = SINK; v != SOURCE; v = edge_to[parent_edge[v] ^ 1])
+		{
+			edge_cap[parent_edge[v]]--;
+			edge_cap[parent_edge[v] ^ 1]++;
+		}
+	}
+
+	void solve(int sink, Result &result)
+	{
+		generation++;
+		result.xi.clear();
+		result.k.clear();
+
+		cone.clear();
+		worklist.assign(1, sink);
+		stamp[sink] = generation;
+		int p = 1;
+		while (!worklist.empty())
+		{
+			int node = worklist.back();
+			worklist.pop_back();
+			cone.push_back(node);
+			p = max(p, labels[node]);
+			for (int node_pred : fanin[node])
+			{
+				if (stamp[node_pred] != generation)
+				{
+					stamp[node_pred] = generation;
+					worklist.push_back(node_pred);
+				}
+			}
+		}
+
+		// Nodes with label p are collapsed into the sink, like in FlowmapWorker::build_flow_graph().
+		int vertex_count = 2;
+		for (int node : cone)
+		{
+			if (node == sink || labels[node] == p)
+				vertex[node] = SINK;
+			else
+			{
+				vertex[node] = vertex_count;
+				vertex_count += 2;
+			}
+		}
+
+		edge_head.assign(vertex_count, -1);
+		edge_next.clear();
+		edge_to.clear();
+		edge_cap.clear();
+		for (int node : cone)
+		{
+			if (top(node) != SINK)
+				add_edge(top(node), bottom(node), 1);
+			if (is_input[node])
+				add_edge(SOURCE, top(node), INFINITE_FLOW);
+			for (int node_pred : fanin[node])
+				if (top(node) != SINK || top(node_pred) != SINK)
+					add_edge(bottom(node_pred), top(node), INFINITE_FLOW);
+		}
+
+		int flow = 0;
+		while (flow <= order && find_augmenting_path())
+		{
+			augment();
+			flow++;
+		}
+
+		if (flow > order)
+		{
+			result.label = p + 1;
+			result.xi.push_back(sink);
+			result.k = fanin[sink];
+			return;
+		}
+
+		// The last search failed, so `reached` is the set of vertices reachable from the source in the residual network, which
+		// is the max-volume min-cut (X'', X̅''). A node is in X if its top vertex is.
+		result.label = p;
+		for (int node : cone)
+		{
+			in_x[node] = top(node) != SINK && reached[top(node)];
+			if (!in_x[node])
+				result.xi.push_back(node);
+		}
+		for (int xi_node : result.xi)
+		{
+			for (int xi_node_pred : fanin[xi_node])
+			{
+				if (in_x[xi_node_pred] && k_stamp[xi_node_pred] != generation)
+				{
+					k_stamp[xi_node_pred] = generation;
+					result.k.push_back(xi_node_pred);
+				}
+			}
+		}
+		log_assert(GetSize(result.k) <= order);
+	}
+};
+
 struct FlowmapWorker
 {
 	int order;
@@ -668,22 +857,14 @@ struct FlowmapWorker
 		}
 	}
 
-	void label_nodes()
+	// Labels nodes one at a time with FlowGraph. This is much slower than label_nodes_levelized(), but can dump every flow network.
+	void label_nodes_debug()
 	{
-		for (auto node : nodes)
-			labels[node] = -1;
-		for (auto input : inputs)
-		{
-			if (input.wire->attributes.count(ID($flowmap_level)))
-				labels[input] = input.wire->attributes[ID($flowmap_level)].as_int();
-			else
-				labels[input] = 0;
-		}
-
 		pool<RTLIL::SigBit> worklist = nodes;
 		int debug_num = 0;
 		while (!worklist.empty())
 		{
+			log_check_interrupt("flowmap labeling", GetSize(nodes) - GetSize(worklist), GetSize(nodes));
 			auto sink = worklist.pop();
 			if (labels[sink] != -1)
 				continue;
@@ -763,6 +944,114 @@ struct FlowmapWorker
 			for (auto sink_succ : edges_fw[sink])
 				worklist.insert(sink_succ);
 		}
+	}
+
+	// Labels nodes one topological level at a time. A node is in the fan-in cone of no other node of its level, so the nodes of a level
+	// are labeled concurrently, and the results are committed in level order afterwards.
+	void label_nodes_levelized()
+	{
+		vector<RTLIL::SigBit> bits(nodes.begin(), nodes.end());
+		dict<RTLIL::SigBit, int> bit_index;
+		for (int i = 0; i < GetSize(bits); i++)
+			bit_index[bits[i]] = i;
+
+		vector<vector<int>> fanin(GetSize(bits)), fanout(GetSize(bits));
+		vector<int> node_labels(GetSize(bits)), pending(GetSize(bits));
+		vector<char> node_inputs(GetSize(bits));
+		for (int i = 0; i < GetSize(bits); i++)
+		{
+			node_labels[i] = labels.at(bits[i]);
+			node_inputs[i] = inputs.count(bits[i]);
+			auto it = edges_bw.find(bits[i]);
+			if (it == edges_bw.end())
+				continue;
+			for (auto node_pred : it->second)
+			{
+				int pred = bit_index.at(node_pred);
+				fanin[i].push_back(pred);
+				fanout[pred].push_back(i);
+			}
+		}
+
+		vector<int> level;
+		for (int i = 0; i < GetSize(bits); i++)
+		{
+			if (node_labels[i] != -1)
+				continue;
+			for (int pred : fanin[i])
+				if (node_labels[pred] == -1)
+					pending[i]++;
+			if (pending[i] == 0)
+				level.push_back(i);
+		}
+
+		int jobs = max(1, yosys_parallel_jobs);
+		vector<FlowSolver> solvers;
+		for (int i = 0; i < jobs; i++)
+			solvers.emplace_back(order, fanin, node_labels, node_inputs);
+
+		vector<FlowSolver::Result> results;
+		vector<int> next_level;
+		int labeled = GetSize(inputs);
+		while (!level.empty())
+		{
+			log_check_interrupt("flowmap labeling", labeled, GetSize(nodes));
+
+			results.resize(GetSize(level));
+			int level_jobs = min(jobs, GetSize(level));
+			if (level_jobs > 1)
+				parallel_for(level_jobs, [&](int job) {
+					for (int i = job; i < GetSize(level); i += level_jobs)
+						solvers[job].solve(level[i], results[i]);
+				});
+			else
+				for (int i = 0; i < GetSize(level); i++)
+					solvers[0].solve(level[i], results[i]);
+
+			next_level.clear();
+			for (int i = 0; i < GetSize(level); i++)
+			{
+				int node = level[i];
+				auto &result = results[i];
+				RTLIL::SigBit sink = bits[node];
+				node_labels[node] = result.label;
+				labels[sink] = result.label;
+
+				auto &xi = lut_gates[sink];
+				for (int xi_node : result.xi)
+					xi.insert(bits[xi_node]);
+				auto &k = lut_edges_bw[sink];
+				for (int k_node : result.k)
+				{
+					k.insert(bits[k_node]);
+					lut_edges_fw[bits[k_node]].insert(sink);
+				}
+
+				for (int succ : fanout[node])
+					if (--pending[succ] == 0)
+						next_level.push_back(succ);
+			}
+			labeled += GetSize(level);
+			level.swap(next_level);
+		}
+	}
+
+	void label_nodes()
+	{
+		for (auto node : nodes)
+			labels[node] = -1;
+		for (auto input : inputs)
+		{
+			if (input.wire->attributes.count(ID($flowmap_level)))
+				labels[input] = input.wire->attributes[ID($flowmap_level)].as_int();
+			else
+				labels[input] = 0;
+		}
+
+		if (debug)
+			label_nodes_debug();
+		else
+			label_nodes_levelized();
 
 		if (debug)
 		{
@@ -1484,6 +1773,9 @@ struct FlowmapPass : public Pass {
 		log("be evaluated with the `eval` pass, including cells with multiple output ports\n");
 		log("and multi-bit input and output ports.\n");
 		log("\n");
+		log("When synthesizer runs with -j <jobs>, the nodes of each logic level are labeled\n");
+		log("concurrently. The mapping does not depend on the number of jobs.\n");
+		log("\n");
 		log("    -maxlut k\n");
 		log("        perform technology mapping for a k-LUT architecture. if not specified,\n");
 		log("        defaults to 3.\n");
@@ -27,7 +27,8 @@
 #include <sstream>
 
 #ifndef FILTERLIB
-#include "kernel/log.h"
+#include "kernel/yosys.h"
+#include "libs/sha1/sha1.h"
 #endif
 
 using namespace Yosys;
@@ -182,6 +183,30 @@ int LibertyParser::lexer(std::string &str)
 	return c;
 }
 
+// Groups that hold timing and power tables. None of the passes reading
+// Liberty files look into them, and they make up most of a typical library.
+static const std::set<std::string> lazy_skipped_groups = {
+	"timing", "internal_power", "leakage_power", "lu_table_template",
+	"power_lut_template", "output_current_template", "receiver_capacitance",
+	"ccsn_first_stage", "ccsn_last_stage", "normalized_driver_waveform"
+};
+
+// Consumes the tokens of a group up to and including its closing brace.
+void LibertyParser::skip_group()
+{
+	std::string str;
+	int depth = 1;
+	while (depth > 0) {
+		int tok = lexer(str);
+		if (tok < 0)
+			break;
+		if (tok == '{')
+			depth++;
+		if (tok == '}')
+			depth--;
+	}
+}
+
 LibertyAst *LibertyParser::parse()
 {
 	std::string str;
@@ -336,6 +361,10 @@ LibertyAst *LibertyParser::parse()
 		}
 
 		if (tok == '{') {
+			if (lazy && lazy_skipped_groups.count(ast->id)) {
+				skip_group();
+				break;
+			}
 			while (1) {
 				LibertyAst *child = parse();
 				if (child == NULL)
@@ -366,6 +395,196 @@ void LibertyParser::error(const std::string &str)
 	log_error("%s", ss.str().c_str());
 }
 
+/*
+ *  On-disk form of a lazy AST: the magic "YSLIBAST" and a u32 version
+ *  (little endian), followed by the root node, if any. A node is its id and
+ *  value, a uint count of args and the args, and a uint count of children
+ *  and the children. Strings are a uint length and the bytes, all "uint"s
+ *  are LEB128 varints.
+ */
+
+static const char liberty_cache_magic[8] = { 'Y', 'S', 'L', 'I', 'B', 'A', 'S', 'T' };
+static const uint32_t liberty_cache_version = 1;
+
+static void liberty_put_uint(std::string &buf, uint64_t value)
+{
+	while (value >= 0x80) {
+		buf.push_back(char(value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back(char(value));
+}
+
+static void liberty_put_string(std::string &buf, const std::string &str)
+{
+	liberty_put_uint(buf, str.size());
+	buf.append(str);
+}
+
+static void liberty_put_node(std::string &buf, const LibertyAst *node)
+{
+	liberty_put_string(buf, node->id);
+	liberty_put_string(buf, node->value);
+	liberty_put_uint(buf, node->args.size());
+	for (auto &arg : node->args)
+		liberty_put_string(buf, arg);
+	liberty_put_uint(buf, node->children.size());
+	for (auto child : node->children)
+		liberty_put_node(buf, child);
+}
+
+struct LibertyCacheReader
+{
+	const char *ptr, *end;
+	bool ok = true;
+
+	uint64_t get_uint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; ok; shift += 7) {
+			if (ptr == end || shift > 63) {
+				ok = false;
+				break;
+			}
+			unsigned char byte = *ptr++;
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		return value;
+	}
+
+	void get_string(std::string &str)
+	{
+		uint64_t len = get_uint();
+		if (!ok || len > uint64_t(end - ptr)) {
+			ok = false;
+			return;
+		}
+		str.assign(ptr, len);
+		ptr += len;
+	}
+
+	LibertyAst *get_node()
+	{
+		LibertyAst *node = new LibertyAst;
+		get_string(node->id);
+		get_string(node->value);
+		uint64_t num_args = get_uint();
+		for (uint64_t i = 0; ok && i < num_args; i++) {
+			node->args.emplace_back();
+			get_string(node->args.back());
+		}
+		uint64_t num_children = get_uint();
+		for (uint64_t i = 0; ok && i < num_children; i++)
+			node->children.push_back(get_node());
+		return node;
+	}
+};
+
+struct LibertyCacheStore
+{
+	std::map<std::string, LibertyAst*> asts;
+
+	~LibertyCacheStore()
+	{
+		for (auto &it : asts)
+			delete it.second;
+	}
+};
+
+static LibertyCacheStore liberty_cache;
+
+static LibertyAst *liberty_cache_read(const std::string &filename, bool &found)
+{
+	MappedFile mapped;
+	found = false;
+	if (!mapped.map(filename) || mapped.size < sizeof(liberty_cache_magic) + 4 ||
+			memcmp(mapped.data, liberty_cache_magic, sizeof(liberty_cache_magic)) != 0)
+		return nullptr;
+
+	uint32_t version = 0;
+	for (int i = 0; i < 4; i++)
+		version |= uint32_t((unsigned char)mapped.data[sizeof(liberty_cache_magic)+i]) << (8*i);
+	if (version != liberty_cache_version)
+		return nullptr;
+
+	LibertyCacheReader reader;
+	reader.ptr = mapped.data + sizeof(liberty_cache_magic) + 4;
+	reader.end = mapped.data + mapped.size;
+
+	LibertyAst *ast = reader.ptr != reader.end ? reader.get_node() : nullptr;
+	if (!reader.ok || reader.ptr != reader.end) {
+		log_warning("Ignoring corrupt Liberty cache file `%s'.\n", filename.c_str());
+		delete ast;
+		return nullptr;
+	}
+
+	found = true;
+	return ast;
+}
+
+static void liberty_cache_write(const std::string &filename, const LibertyAst *ast)
+{
+	std::string buf(liberty_cache_magic, sizeof(liberty_cache_magic));
+	for (int i = 0; i < 4; i++)
+		buf.push_back(char(liberty_cache_version >> (8*i)));
+	if (ast != nullptr)
+		liberty_put_node(buf, ast);
+
+	// write to a temporary file first so that a concurrent run never
+	// reads a partially written cache file
+#ifdef _WIN32
+	int pid = GetCurrentProcessId();
+#else
+	int pid = getpid();
+#endif
+	std::string tmp_fn = stringf("%s.%d.tmp", filename.c_str(), pid);
+	std::ofstream f(tmp_fn.c_str(), std::ofstream::binary);
+	if (f.fail())
+		return;
+	f.write(buf.data(), buf.size());
+	f.close();
+	if (f.fail() || rename(tmp_fn.c_str(), filename.c_str()) != 0)
+		remove(tmp_fn.c_str());
+}
+
+LibertyAst *LibertyCache::parse(std::istream &f)
+{
+	std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+	std::string key = sha1(content);
+
+	auto it = liberty_cache.asts.find(key);
+	if (it != liberty_cache.asts.end()) {
+		log("Using cached Liberty library %s.\n", key.c_str());
+		return it->second;
+	}
+
+	std::string cache_fn;
+	const char *dir = getenv("YOSYS_LIBERTY_CACHE");
+	if (dir != nullptr && dir[0] != 0)
+		cache_fn = stringf("%s/%s.ylb", dir, key.c_str());
+
+	bool found = false;
+	LibertyAst *ast = nullptr;
+	if (!cache_fn.empty())
+		ast = liberty_cache_read(cache_fn, found);
+
+	if (found) {
+		log("Reading Liberty library from cache file `%s'.\n", cache_fn.c_str());
+	} else {
+		std::istringstream in(content);
+		LibertyParser parser(in, true);
+		ast = parser.ast;
+		parser.ast = nullptr;
+		if (!cache_fn.empty())
+			liberty_cache_write(cache_fn, ast);
+	}
+
+	liberty_cache.asts[key] = ast;
+	return ast;
+}
+
 #else
 
 void LibertyParser::error()
@@ -43,8 +43,10 @@ namespace Yosys
 	{
 		std::istream &f;
 		int line;
+		// skip the contents of timing and power groups, see skip_group()
+		bool lazy;
 		LibertyAst *ast;
-		LibertyParser(std::istream &f) : f(f), line(1), ast(parse()) {}
+		LibertyParser(std::istream &f, bool lazy = false) : f(f), line(1), lazy(lazy), ast(parse()) {}
 		~LibertyParser() { if (ast) delete ast; }
         
         /* lexer return values:
@@ -55,9 +57,25 @@ namespace Yosys
 		int lexer(std::string &str);
 		
         LibertyAst *parse();
+		void skip_group();
 		void error();
         void error(const std::string &str);
 	};
+
+#ifndef FILTERLIB
+	// Liberty files parsed by read_liberty, dfflibmap and stat, shared by all
+	// calls of the process and keyed by the SHA1 of the file content. Only
+	// a lazy AST is kept, without the timing and power tables. If the
+	// YOSYS_LIBERTY_CACHE environment variable names a directory, the AST
+	// is also stored there in a compact binary form, and later runs load it
+	// instead of parsing the file.
+	struct LibertyCache
+	{
+		// returns the AST of the library read from f; it is owned by the
+		// cache and must not be modified
+		static LibertyAst *parse(std::istream &f);
+	};
+#endif
 }
 
 #endif
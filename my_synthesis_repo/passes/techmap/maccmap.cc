@@ -36,14 +36,15 @@ struct MaccmapWorker
 
 	void add(RTLIL::SigBit bit, int position)
 	{
-		if (position >= width || bit == State::S0)
+		if (bit == State::S0)
 			return;
 
-		if (bits.at(position).count(bit)) {
-			bits.at(position).erase(bit);
-			add(bit, position+1);
-		} else {
-			bits.at(position).insert(bit);
+		// a bit that is already present at a position carries into the next one
+		for (; position < width; position++) {
+			auto it = bits[position].insert(bit);
+			if (it.second)
+				break;
+			bits[position].erase(it.first);
 		}
 	}
 
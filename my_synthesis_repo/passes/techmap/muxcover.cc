@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -498,13 +499,61 @@ struct MuxcoverWorker
 		return best_mux.cost;
 	}
 
-	void implement_best_cover(tree_t &tree, SigBit bit, int count_muxes_by_type[4])
+	// Evaluates the tree in post-order, so that find_best_cover() finds the covers of
+	// all mux inputs already memoized and every node is costed exactly once.
+	void find_best_covers_bottom_up(tree_t &tree)
 	{
-		newmux_t mux = tree.newmuxes.at(bit);
+		vector<pair<SigBit, bool>> stack;
+		pool<SigBit> visited;
+		stack.push_back(make_pair(tree.root, false));
 
-		for (auto inbit : mux.inputs)
-			implement_best_cover(tree, inbit, count_muxes_by_type);
+		while (!stack.empty())
+		{
+			auto entry = stack.back();
+			stack.pop_back();
+
+			if (entry.second) {
+				find_best_cover(tree, entry.first);
+				continue;
+			}
+
+			if (tree.muxes.count(entry.first) == 0 || !visited.insert(entry.first).second)
+				continue;
+
+			Cell *cell = tree.muxes.at(entry.first);
+			stack.push_back(make_pair(entry.first, true));
+			stack.push_back(make_pair(sigmap(cell->getPort(ID::B)), false));
+			stack.push_back(make_pair(sigmap(cell->getPort(ID::A)), false));
+		}
+
+		find_best_cover(tree, tree.root);
+	}
+
+	void implement_best_cover(tree_t &tree, SigBit root, int count_muxes_by_type[4])
+	{
+		// explicit stack of (bit, next input), visiting the inputs of each mux in order
+		vector<pair<SigBit, int>> stack;
+		stack.push_back(make_pair(root, 0));
 
+		while (!stack.empty())
+		{
+			SigBit bit = stack.back().first;
+			int next_input = stack.back().second;
+			const newmux_t &mux = tree.newmuxes.at(bit);
+
+			if (next_input < GetSize(mux.inputs)) {
+				stack.back().second++;
+				stack.push_back(make_pair(mux.inputs[next_input], 0));
+				continue;
+			}
+
+			stack.pop_back();
+			implement_mux(bit, mux, count_muxes_by_type);
+		}
+	}
+
+	void implement_mux(SigBit bit, const newmux_t &mux, int count_muxes_by_type[4])
+	{
 		for (auto selbit : mux.selects)
 			implement_decode_mux(selbit);
 
@@ -586,7 +635,7 @@ struct MuxcoverWorker
 	{
 		int count_muxes_by_type[4] = {0, 0, 0, 0};
 		log_debug("    Searching for best cover for tree at %s.\n", log_signal(tree.root));
-		find_best_cover(tree, tree.root);
+		find_best_covers_bottom_up(tree);
 		implement_best_cover(tree, tree.root, count_muxes_by_type);
 		log("    Replaced tree at %s: %d MUX2, %d MUX4, %d MUX8, %d MUX16\n", log_signal(tree.root),
 				count_muxes_by_type[0], count_muxes_by_type[1], count_muxes_by_type[2], count_muxes_by_type[3]);
@@ -605,7 +654,7 @@ struct MuxcoverWorker
 		if (!nodecode) {
 			log_debug("    Populating cache of decoder muxes.\n");
 			for (auto &tree : tree_list) {
-				find_best_cover(tree, tree.root);
+				find_best_covers_bottom_up(tree);
 				tree.newmuxes.clear();
 			}
 		}
@@ -652,6 +701,9 @@ struct MuxcoverPass : public Pass {
 		log("        Do not consider mappings that use $_MUX<N>_ to select from less\n");
 		log("        than <N> different signals.\n");
 		log("\n");
+		log("Every MUX tree is costed bottom-up, so each node of a tree is evaluated once.\n");
+		log("When synthesizer runs with -j <jobs>, modules are covered concurrently.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -722,7 +774,9 @@ struct MuxcoverPass : public Pass {
 			use_mux16 = true;
 		}
 
-		for (auto module : design->selected_modules())
+		// trees of one module share their decoder muxes, so only modules run in parallel
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		parallel_for_modules(design, modules, [&](RTLIL::Module *module)
 		{
 			MuxcoverWorker worker(module);
 			worker.use_mux4 = use_mux4;
@@ -736,7 +790,7 @@ struct MuxcoverPass : public Pass {
 			worker.nodecode = nodecode;
 			worker.nopartial = nopartial;
 			worker.run();
-		}
+		});
 	}
 } MuxcoverPass;
 
@@ -181,17 +181,17 @@ struct ShregmapWorker
 				IdString d_port = opts.ffcells.at(c1->type).first;
 				IdString q_port = opts.ffcells.at(c1->type).second;
 
-				auto c1_conn = c1->connections();
-				auto c2_conn = c2->connections();
-
-				c1_conn.erase(d_port);
-				c1_conn.erase(q_port);
-
-				c2_conn.erase(d_port);
-				c2_conn.erase(q_port);
-
-				if (c1_conn != c2_conn)
+				// compare all other connections in place, without copying
+				// both connection dicts for every link
+				if (GetSize(c1->connections()) != GetSize(c2->connections()))
 					goto start_cell;
+				for (auto &conn : c1->connections()) {
+					if (conn.first == d_port || conn.first == q_port)
+						continue;
+					auto it = c2->connections().find(conn.first);
+					if (it == c2->connections().end() || it->second != conn.second)
+						goto start_cell;
+				}
 
 				continue;
 			}
@@ -27,6 +27,14 @@
 USING_YOSYS_NAMESPACE
 YOSYS_NAMESPACE_BEGIN
 
+// the gates created for a cell inherit its src attribute
+static dict<IdString, RTLIL::Const> gate_attributes(RTLIL::Cell *cell)
+{
+	dict<IdString, RTLIL::Const> attributes;
+	attributes[ID::src] = cell->attributes[ID::src];
+	return attributes;
+}
+
 void simplemap_not(RTLIL::Module *module, RTLIL::Cell *cell)
 {
 	RTLIL::SigSpec sig_a = cell->getPort(ID::A);
@@ -34,12 +42,8 @@ void simplemap_not(RTLIL::Module *module, RTLIL::Cell *cell)
 
 	sig_a.extend_u0(GetSize(sig_y), cell->parameters.at(ID::A_SIGNED).as_bool());
 
-	for (int i = 0; i < GetSize(sig_y); i++) {
-		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_NOT_));
-		gate->attributes[ID::src] = cell->attributes[ID::src];
-		gate->setPort(ID::A, sig_a[i]);
-		gate->setPort(ID::Y, sig_y[i]);
-	}
+	module->addCells(NEW_ID_PREFIX, ID($_NOT_), GetSize(sig_y),
+			{{ID::A, sig_a}, {ID::Y, sig_y}}, gate_attributes(cell));
 }
 
 void simplemap_pos(RTLIL::Module *module, RTLIL::Cell *cell)
@@ -71,13 +75,9 @@ void simplemap_bitop(RTLIL::Module *module, RTLIL::Cell *cell)
 	if (cell->type == ID($bweqx)) gate_type = ID($_XNOR_);
 	log_assert(!gate_type.empty());
 
-	for (int i = 0; i < GetSize(sig_y); i++) {
-		RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-		gate->attributes[ID::src] = cell->attributes[ID::src];
-		gate->setPort(ID::A, sig_a[i]);
-		gate->setPort(ID::B, sig_b[i]);
-		gate->setPort(ID::Y, sig_y[i]);
-	}
+	module->addCells(NEW_ID_PREFIX, gate_type, GetSize(sig_y),
+			{{ID::A, sig_a.extract(0, GetSize(sig_y))}, {ID::B, sig_b.extract(0, GetSize(sig_y))}, {ID::Y, sig_y}},
+			gate_attributes(cell));
 }
 
 void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
@@ -111,26 +111,25 @@ void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 	log_assert(!gate_type.empty());
 
 	RTLIL::Cell *last_output_cell = NULL;
+	dict<IdString, RTLIL::Const> attributes = gate_attributes(cell);
 
 	while (sig_a.size() > 1)
 	{
-		RTLIL::SigSpec sig_t = module->addWire(NEW_ID, sig_a.size() / 2);
-
-		for (int i = 0; i < sig_a.size(); i += 2)
-		{
-			if (i+1 == sig_a.size()) {
-				sig_t.append(sig_a[i]);
-				continue;
-			}
+		int pairs = sig_a.size() / 2;
+		RTLIL::SigSpec sig_t = module->addWire(NEW_ID, pairs);
+		RTLIL::SigSpec sig_even, sig_odd;
 
-			RTLIL::Cell *gate = module->addCell(NEW_ID, gate_type);
-			gate->attributes[ID::src] = cell->attributes[ID::src];
-			gate->setPort(ID::A, sig_a[i]);
-			gate->setPort(ID::B, sig_a[i+1]);
-			gate->setPort(ID::Y, sig_t[i/2]);
-			last_output_cell = gate;
+		for (int i = 0; i+1 < sig_a.size(); i += 2) {
+			sig_even.append(sig_a[i]);
+			sig_odd.append(sig_a[i+1]);
 		}
 
+		std::vector<RTLIL::Cell*> gates = module->addCells(NEW_ID_PREFIX, gate_type, pairs,
+				{{ID::A, sig_even}, {ID::B, sig_odd}, {ID::Y, sig_t}}, attributes);
+		last_output_cell = gates.back();
+
+		if (sig_a.size() % 2)
+			sig_t.append(sig_a[sig_a.size()-1]);
 		sig_a = sig_t;
 	}
 
@@ -153,24 +152,23 @@ void simplemap_reduce(RTLIL::Module *module, RTLIL::Cell *cell)
 
 static void logic_reduce(RTLIL::Module *module, RTLIL::SigSpec &sig, RTLIL::Cell *cell)
 {
+	dict<IdString, RTLIL::Const> attributes = gate_attributes(cell);
+
 	while (sig.size() > 1)
 	{
-		RTLIL::SigSpec sig_t = module->addWire(NEW_ID, sig.size() / 2);
+		int pairs = sig.size() / 2;
+		RTLIL::SigSpec sig_t = module->addWire(NEW_ID, pairs);
+		RTLIL::SigSpec sig_even, sig_odd;
 
-		for (int i = 0; i < sig.size(); i += 2)
-		{
-			if (i+1 == sig.size()) {
-				sig_t.append(sig[i]);
-				continue;
-			}
-
-			RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_OR_));
-			gate->attributes[ID::src] = cell->attributes[ID::src];
-			gate->setPort(ID::A, sig[i]);
-			gate->setPort(ID::B, sig[i+1]);
-			gate->setPort(ID::Y, sig_t[i/2]);
+		for (int i = 0; i+1 < sig.size(); i += 2) {
+			sig_even.append(sig[i]);
+			sig_odd.append(sig[i+1]);
 		}
 
+		module->addCells(NEW_ID_PREFIX, ID($_OR_), pairs, {{ID::A, sig_even}, {ID::B, sig_odd}, {ID::Y, sig_t}}, attributes);
+
+		if (sig.size() % 2)
+			sig_t.append(sig[sig.size()-1]);
 		sig = sig_t;
 	}
 
@@ -263,14 +261,9 @@ void simplemap_mux(RTLIL::Module *module, RTLIL::Cell *cell)
 	RTLIL::SigSpec sig_b = cell->getPort(ID::B);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
-	for (int i = 0; i < GetSize(sig_y); i++) {
-		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-		gate->attributes[ID::src] = cell->attributes[ID::src];
-		gate->setPort(ID::A, sig_a[i]);
-		gate->setPort(ID::B, sig_b[i]);
-		gate->setPort(ID::S, cell->getPort(ID::S));
-		gate->setPort(ID::Y, sig_y[i]);
-	}
+	module->addCells(NEW_ID_PREFIX, ID($_MUX_), GetSize(sig_y),
+			{{ID::A, sig_a}, {ID::B, sig_b}, {ID::S, cell->getPort(ID::S)}, {ID::Y, sig_y}},
+			gate_attributes(cell));
 }
 
 void simplemap_bwmux(RTLIL::Module *module, RTLIL::Cell *cell)
@@ -280,14 +273,9 @@ void simplemap_bwmux(RTLIL::Module *module, RTLIL::Cell *cell)
 	RTLIL::SigSpec sig_s = cell->getPort(ID::S);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
-	for (int i = 0; i < GetSize(sig_y); i++) {
-		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-		gate->attributes[ID::src] = cell->attributes[ID::src];
-		gate->setPort(ID::A, sig_a[i]);
-		gate->setPort(ID::B, sig_b[i]);
-		gate->setPort(ID::S, sig_s[i]);
-		gate->setPort(ID::Y, sig_y[i]);
-	}
+	module->addCells(NEW_ID_PREFIX, ID($_MUX_), GetSize(sig_y),
+			{{ID::A, sig_a}, {ID::B, sig_b}, {ID::S, sig_s}, {ID::Y, sig_y}},
+			gate_attributes(cell));
 }
 
 void simplemap_tribuf(RTLIL::Module *module, RTLIL::Cell *cell)
@@ -296,13 +284,8 @@ void simplemap_tribuf(RTLIL::Module *module, RTLIL::Cell *cell)
 	RTLIL::SigSpec sig_e = cell->getPort(ID::EN);
 	RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
 
-	for (int i = 0; i < GetSize(sig_y); i++) {
-		RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_TBUF_));
-		gate->attributes[ID::src] = cell->attributes[ID::src];
-		gate->setPort(ID::A, sig_a[i]);
-		gate->setPort(ID::E, sig_e);
-		gate->setPort(ID::Y, sig_y[i]);
-	}
+	module->addCells(NEW_ID_PREFIX, ID($_TBUF_), GetSize(sig_y),
+			{{ID::A, sig_a}, {ID::E, sig_e}, {ID::Y, sig_y}}, gate_attributes(cell));
 }
 
 void simplemap_bmux(RTLIL::Module *module, RTLIL::Cell *cell)
@@ -310,19 +293,17 @@ void simplemap_bmux(RTLIL::Module *module, RTLIL::Cell *cell)
 	SigSpec sel = cell->getPort(ID::S);
 	SigSpec data = cell->getPort(ID::A);
 	int width = GetSize(cell->getPort(ID::Y));
+	dict<IdString, RTLIL::Const> attributes = gate_attributes(cell);
 
 	for (int idx = 0; idx < GetSize(sel); idx++) {
 		SigSpec new_data = module->addWire(NEW_ID, GetSize(data)/2);
+		SigSpec sig_a, sig_b;
 		for (int i = 0; i < GetSize(new_data); i += width) {
-			for (int k = 0; k < width; k++) {
-				RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-				gate->attributes[ID::src] = cell->attributes[ID::src];
-				gate->setPort(ID::A, data[i*2+k]);
-				gate->setPort(ID::B, data[i*2+width+k]);
-				gate->setPort(ID::S, sel[idx]);
-				gate->setPort(ID::Y, new_data[i+k]);
-			}
+			sig_a.append(data.extract(i*2, width));
+			sig_b.append(data.extract(i*2+width, width));
 		}
+		module->addCells(NEW_ID_PREFIX, ID($_MUX_), GetSize(new_data),
+				{{ID::A, sig_a}, {ID::B, sig_b}, {ID::S, sel[idx]}, {ID::Y, new_data}}, attributes);
 		data = new_data;
 	}
 
@@ -335,16 +316,17 @@ void simplemap_lut(RTLIL::Module *module, RTLIL::Cell *cell)
 	SigSpec lut_data = cell->getParam(ID::LUT);
 	lut_data.extend_u0(1 << cell->getParam(ID::WIDTH).as_int());
 
+	dict<IdString, RTLIL::Const> attributes = gate_attributes(cell);
+
 	for (int idx = 0; GetSize(lut_data) > 1; idx++) {
 		SigSpec new_lut_data = module->addWire(NEW_ID, GetSize(lut_data)/2);
+		SigSpec sig_a, sig_b;
 		for (int i = 0; i < GetSize(lut_data); i += 2) {
-			RTLIL::Cell *gate = module->addCell(NEW_ID, ID($_MUX_));
-			gate->attributes[ID::src] = cell->attributes[ID::src];
-			gate->setPort(ID::A, lut_data[i]);
-			gate->setPort(ID::B, lut_data[i+1]);
-			gate->setPort(ID::S, lut_ctrl[idx]);
-			gate->setPort(ID::Y, new_lut_data[i/2]);
+			sig_a.append(lut_data[i]);
+			sig_b.append(lut_data[i+1]);
 		}
+		module->addCells(NEW_ID_PREFIX, ID($_MUX_), GetSize(new_lut_data),
+				{{ID::A, sig_a}, {ID::B, sig_b}, {ID::S, lut_ctrl[idx]}, {ID::Y, new_lut_data}}, attributes);
 		lut_data = new_lut_data;
 	}
 
@@ -400,6 +382,7 @@ void simplemap_concat(RTLIL::Module *module, RTLIL::Cell *cell)
 void simplemap_ff(RTLIL::Module *, RTLIL::Cell *cell)
 {
 	FfData ff(nullptr, cell);
+	ff.module->reserve_cells(ff.width);
 	for (int i = 0; i < ff.width; i++) {
 		FfData fff = ff.slice({i});
 		fff.is_fine = true;
@@ -21,7 +21,10 @@
 #include "kernel/utils.h"
 #include "kernel/sigtools.h"
 #include "kernel/ffinit.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
+#include "frontends/rtlil/rtlil_frontend.h"
+#include "backends/rtlil/rtlil_backend.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -83,6 +86,26 @@ struct TechmapWorker
 	bool autoproc_mode = false;
 	bool ignore_wb = false;
 
+	// Set while modules are mapped by parallel workers. The workers only use
+	// templates that are already elaborated and leave all other cells to the
+	// serial mapping that follows, as everything shared is read-only then.
+	bool parallel_mode = false;
+
+	// Options that change how templates are elaborated, for the template cache.
+	std::string options_key() const
+	{
+		return stringf("\n-options %d%d%d%d%d", extern_mode, assert_mode, recursive_mode, autoproc_mode, ignore_wb);
+	}
+
+	// Returns true the first time msg is seen. Parallel workers cannot share
+	// the cache, so there every message counts as new.
+	bool first_log_msg(const std::string &msg)
+	{
+		if (parallel_mode)
+			return true;
+		return log_msg_cache.insert(msg).second;
+	}
+
 	std::string constmap_tpl_name(SigMap &sigmap, RTLIL::Module *tpl, RTLIL::Cell *cell, bool verbose)
 	{
 		std::string constmap_info;
@@ -110,7 +133,9 @@ struct TechmapWorker
 		return stringf("$paramod$constmap:%s%s", sha1(constmap_info).c_str(), tpl->name.c_str());
 	}
 
-	TechmapWires techmap_find_special_wires(RTLIL::Module *module)
+	// With mark set, the special wires are given the keep and _techmap_special_
+	// attributes. Templates found in techmap_do_cache have them already.
+	TechmapWires techmap_find_special_wires(RTLIL::Module *module, bool mark = true)
 	{
 		TechmapWires result;
 
@@ -126,8 +151,10 @@ struct TechmapWorker
 				record.wire = w;
 				record.value = w;
 				result[w->name].push_back(record);
-				w->set_bool_attribute(ID::keep);
-				w->set_bool_attribute(ID::_techmap_special_);
+				if (mark) {
+					w->set_bool_attribute(ID::keep);
+					w->set_bool_attribute(ID::_techmap_special_);
+				}
 			}
 		}
 
@@ -161,7 +188,7 @@ struct TechmapWorker
 		orig_cell_name = cell->name.str();
 		for (auto tpl_cell : tpl->cells())
 			if (tpl_cell->name.ends_with("_TECHMAP_REPLACE_")) {
-				module->rename(cell, stringf("$techmap%d", autoidx++) + cell->name.str());
+				module->rename(cell, stringf("$techmap%d", next_autoidx()) + cell->name.str());
 				break;
 			}
 
@@ -180,6 +207,8 @@ struct TechmapWorker
 		dict<IdString, IdString> positional_ports;
 		dict<Wire*, IdString> temp_renamed_wires;
 		pool<SigBit> autopurge_tpl_bits;
+		SigMap parallel_tpl_sigmap;
+		SigMap *tpl_sigmap = nullptr;
 
 		for (auto tpl_w : tpl->wires())
 		{
@@ -192,10 +221,16 @@ struct TechmapWorker
 						(!cell->hasPort(tpl_w->name) || !GetSize(cell->getPort(tpl_w->name))) &&
 						(!cell->hasPort(posportname) || !GetSize(cell->getPort(posportname))))
 				{
-					if (sigmaps.count(tpl) == 0)
-						sigmaps[tpl].set(tpl);
+					if (tpl_sigmap == nullptr && parallel_mode) {
+						parallel_tpl_sigmap.set(tpl);
+						tpl_sigmap = &parallel_tpl_sigmap;
+					} else if (tpl_sigmap == nullptr) {
+						if (sigmaps.count(tpl) == 0)
+							sigmaps[tpl].set(tpl);
+						tpl_sigmap = &sigmaps.at(tpl);
+					}
 
-					for (auto bit : sigmaps.at(tpl)(tpl_w))
+					for (auto bit : (*tpl_sigmap)(tpl_w))
 						if (bit.wire != nullptr)
 							autopurge_tpl_bits.insert(bit);
 				}
@@ -349,7 +384,7 @@ struct TechmapWorker
 				bool autopurge = false;
 				if (!autopurge_tpl_bits.empty()) {
 					autopurge = GetSize(conn.second) != 0;
-					for (auto &bit : sigmaps.at(tpl)(conn.second))
+					for (auto &bit : (*tpl_sigmap)(conn.second))
 						if (!autopurge_tpl_bits.count(bit)) {
 							autopurge = false;
 							break;
@@ -480,6 +515,7 @@ struct TechmapWorker
 			log_assert(handled_cells.count(cell) == 0);
 			log_assert(cell == module->cell(cell->name));
 			bool mapped_cell = false;
+			bool deferred_cell = false;
 
 			std::string cell_type = cell->type.str();
 
@@ -510,6 +546,11 @@ struct TechmapWorker
 				{
 					cell->type = cell_type;
 
+					if (parallel_mode && extmapper_name == "wrap") {
+						deferred_cell = true;
+						break;
+					}
+
 					if ((extern_mode && !in_recursion) || extmapper_name == "wrap")
 					{
 						std::string m_name = stringf("$extern:%s:%s", extmapper_name.c_str(), log_id(cell->type));
@@ -578,8 +619,7 @@ struct TechmapWorker
 						}
 
 						auto msg = stringf("Using extmapper %s for cells of type %s.", log_id(extmapper_module), log_id(cell->type));
-						if (!log_msg_cache.count(msg)) {
-							log_msg_cache.insert(msg);
+						if (first_log_msg(msg)) {
 							if(log_verbose_level > 9)
 								log("%s\n", msg.c_str());
 						}
@@ -588,8 +628,7 @@ struct TechmapWorker
 					else
 					{
 						auto msg = stringf("Using extmapper %s for cells of type %s.", extmapper_name.c_str(), log_id(cell->type));
-						if (!log_msg_cache.count(msg)) {
-							log_msg_cache.insert(msg);
+						if (first_log_msg(msg)) {
 							if(log_verbose_level > 9)
 								log("%s\n", msg.c_str());
 						}
@@ -702,6 +741,9 @@ struct TechmapWorker
 					auto it = techmap_cache.find(key);
 					if (it != techmap_cache.end()) {
 						tpl = it->second;
+					} else if (parallel_mode) {
+						deferred_cell = true;
+						break;
 					} else {
 						if (parameters.size() != 0) {
 							mkdebug.on();
@@ -717,6 +759,11 @@ struct TechmapWorker
 				if (constmapped_tpl != nullptr)
 					tpl = constmapped_tpl;
 
+				if (parallel_mode && (techmap_do_cache.count(tpl) == 0 || (techmap_do_cache.at(tpl) && tpl->processes.size() != 0))) {
+					deferred_cell = true;
+					break;
+				}
+
 				if (techmap_do_cache.count(tpl) == 0)
 				{
 					bool keep_running = true;
@@ -910,7 +957,7 @@ struct TechmapWorker
 					mkdebug.off();
 				}
 
-				TechmapWires twd = techmap_find_special_wires(tpl);
+				TechmapWires twd = techmap_find_special_wires(tpl, !parallel_mode);
 				for (auto &it : twd) {
 					if (it.first.begins_with("\\_TECHMAP_REMOVEINIT_")) {
 						for (auto &it2 : it.second) {
@@ -952,10 +999,8 @@ struct TechmapWorker
 				{
 					if(log_verbose_level > 9){
 						auto msg = stringf("Using template %s for cells of type %s.", log_id(tpl), log_id(cell->type));
-						if (!log_msg_cache.count(msg)) {
-							log_msg_cache.insert(msg);
+						if (first_log_msg(msg))
 							log("%s\n", msg.c_str());
-						}
 					}
 					log_debug("%s %s.%s (%s) using %s.\n", mapmsg_prefix.c_str(), log_id(module), log_id(cell), log_id(cell->type), log_id(tpl));
 					techmap_module_worker(design, module, cell, tpl);
@@ -966,6 +1011,9 @@ struct TechmapWorker
 				break;
 			}
 
+			if (deferred_cell)
+				continue;
+
 			if (assert_mode && !mapped_cell)
 				log_error("(ASSERT MODE) Failed to map cell %s.%s (%s).\n", log_id(module), log_id(cell), log_id(cell->type));
 
@@ -982,8 +1030,198 @@ struct TechmapWorker
 	}
 };
 
+// Templates elaborated by earlier techmap calls with the same map library and
+// options: the working copy of the library with all derived and constmapped
+// modules, and the worker caches that point into it. An entry that is not
+// complete was left behind by a call that failed and is rebuilt.
+struct MapTemplateCache
+{
+	RTLIL::Design *map = nullptr;
+	dict<IdString, pool<IdString>> celltypeMap;
+	dict<std::pair<IdString, dict<IdString, RTLIL::Const>>, RTLIL::Module*> techmap_cache;
+	dict<RTLIL::Module*, bool> techmap_do_cache;
+	bool complete = false;
+
+	void clear()
+	{
+		delete map;
+		map = nullptr;
+		celltypeMap.clear();
+		techmap_cache.clear();
+		techmap_do_cache.clear();
+		complete = false;
+	}
+};
+
+// Map libraries read from files, shared by all techmap calls of the process.
+// An entry is keyed by the frontend command and the names and content hashes
+// of all map files, so it is only reused if none of them has changed. The
+// cached design is never modified, techmap works on a copy of its modules.
+struct MapLibraryCache
+{
+	std::map<std::string, RTLIL::Design*> designs;
+	std::map<std::string, MapTemplateCache> templates;
+
+	~MapLibraryCache()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		for (auto &it : designs)
+			delete it.second;
+		designs.clear();
+		for (auto &it : templates)
+			it.second.clear();
+		templates.clear();
+	}
+
+	// Returns the cache key for the given map files, or an empty string if
+	// they cannot be cached (if they are missing, use wildcards or contain
+	// `include directives, whose targets are not part of the key).
+	static std::string make_key(const std::vector<std::string> &map_files, const std::string &verilog_frontend)
+	{
+		std::string key = verilog_frontend;
+		for (auto fn : map_files) {
+			rewrite_filename(fn);
+			if (fn.find_first_of("*?[") != std::string::npos)
+				return std::string();
+			std::ifstream f(fn.c_str(), std::ifstream::binary);
+			if (f.fail())
+				return std::string();
+			std::string content((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+			std::string text = content;
+			if (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".pb") == 0)
+				for (char &c : text)
+					c ^= 0xAA;
+			if (text.find("`include") != std::string::npos)
+				return std::string();
+			key += "\n" + fn + "\n" + sha1(content);
+		}
+		return key;
+	}
+
+	// Path of the on-disk copy of an entry in the directory named by
+	// YOSYS_TECHMAP_CACHE, or an empty string if that is not set.
+	static std::string disk_filename(const std::string &key)
+	{
+		const char *dir = getenv("YOSYS_TECHMAP_CACHE");
+		if (dir == nullptr || dir[0] == 0)
+			return std::string();
+		return stringf("%s/%s.ysb", dir, sha1(key).c_str());
+	}
+
+	// Modules with parameters are derived from their AST later on, which the
+	// binary RTLIL format does not store.
+	static bool can_write_to_disk(RTLIL::Design *design)
+	{
+		for (auto module : design->modules())
+			if (!module->avail_parameters.empty())
+				return false;
+		return true;
+	}
+
+	RTLIL::Design *load(const std::string &key, const std::vector<std::string> &map_files, const std::string &verilog_frontend)
+	{
+		auto it = designs.find(key);
+		if (it != designs.end()) {
+			log("Using cached map library for %s.\n", map_files.front().c_str());
+			return it->second;
+		}
+
+		RTLIL::Design *lib = new RTLIL::Design;
+		std::string cache_fn = disk_filename(key);
+		std::ifstream cache_file;
+		if (!cache_fn.empty())
+			cache_file.open(cache_fn.c_str(), std::ifstream::binary);
+
+		if (cache_file.is_open()) {
+			log("Reading map library for %s from cache file `%s'.\n", map_files.front().c_str(), cache_fn.c_str());
+			RTLIL_FRONTEND::read_design_binary(&cache_file, cache_fn, lib, pool<RTLIL::IdString>());
+		} else {
+			for (auto &fn : map_files)
+				Frontend::frontend_call(lib, nullptr, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "rtlil" : verilog_frontend));
+			if (!cache_fn.empty() && can_write_to_disk(lib)) {
+				// write to a temporary file first so that a concurrent run
+				// never reads a partially written cache file
+#ifdef _WIN32
+				int pid = GetCurrentProcessId();
+#else
+				int pid = getpid();
+#endif
+				std::string tmp_fn = stringf("%s.%d.tmp", cache_fn.c_str(), pid);
+				std::ofstream f(tmp_fn.c_str(), std::ofstream::binary);
+				if (!f.fail()) {
+					RTLIL_BACKEND::dump_design_binary(f, lib, false);
+					f.close();
+					if (f.fail() || rename(tmp_fn.c_str(), cache_fn.c_str()) != 0)
+						remove(tmp_fn.c_str());
+				}
+			}
+		}
+
+		designs[key] = lib;
+		return lib;
+	}
+};
+
+static MapLibraryCache map_library_cache;
+
+// Returns the templates in map for each cell type, from the techmap_celltype
+// attributes or the module names.
+static dict<IdString, pool<IdString>> techmap_celltype_map(RTLIL::Design *map)
+{
+	dict<IdString, pool<IdString>> celltypeMap;
+	for (auto module : map->modules()) {
+		if (module->attributes.count(ID::techmap_celltype) && !module->attributes.at(ID::techmap_celltype).bits.empty()) {
+			char *p = strdup(module->attributes.at(ID::techmap_celltype).decode_string().c_str());
+			for (char *q = strtok(p, " \t\r\n"); q; q = strtok(nullptr, " \t\r\n")) {
+				std::vector<std::string> queue;
+				queue.push_back(q);
+				while (!queue.empty()) {
+					std::string name = queue.back();
+					queue.pop_back();
+					auto pos = name.find('[');
+					if (pos == std::string::npos) {
+						// No further expansion.
+						celltypeMap[RTLIL::escape_id(name)].insert(module->name);
+					} else {
+						// Expand [] in this name.
+						auto epos = name.find(']', pos);
+						if (epos == std::string::npos)
+							log_error("Malformed techmap_celltype pattern %s\n", q);
+						for (size_t i = pos + 1; i < epos; i++) {
+							queue.push_back(name.substr(0, pos) + name[i] + name.substr(epos + 1, std::string::npos));
+						}
+					}
+				}
+			}
+			free(p);
+		} else {
+			IdString module_name = module->name.begins_with("\\$") ?
+					module->name.substr(1) : module->name.str();
+			celltypeMap[module_name].insert(module->name);
+		}
+	}
+	log_debug("Cell type mappings to use:\n");
+	for (auto &i : celltypeMap) {
+		i.second.sort(RTLIL::sort_by_id_str());
+		std::string maps = "";
+		for (auto &map : i.second)
+			maps += stringf(" %s", log_id(map));
+		log_debug("    %s:%s\n", log_id(i.first), maps.c_str());
+	}
+	log_debug("\n");
+	return celltypeMap;
+}
+
 struct TechmapPass : public Pass {
 	TechmapPass() : Pass("techmap", "generic technology mapper") { }
+	void on_shutdown() override
+	{
+		map_library_cache.clear();
+	}
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -1032,6 +1270,19 @@ struct TechmapPass : public Pass {
 		log("        map file. Note that the Verilog frontend is also called with the\n");
 		log("        '-nooverwrite' option set.\n");
 		log("\n");
+		log("Map libraries read from files are kept in memory and reused by later techmap\n");
+		log("calls with the same map files and -D/-I options, as long as the files are not\n");
+		log("changed and do not use `include. If the environment variable\n");
+		log("YOSYS_TECHMAP_CACHE is set to a directory, libraries without parametric\n");
+		log("modules are also stored there in binary RTLIL format for later runs.\n");
+		log("The templates elaborated from such a library (with their parameters, constant\n");
+		log("inputs and _TECHMAP_DO_ commands applied) are kept as well and are shared by\n");
+		log("all later calls with the same map files and options.\n");
+		log("\n");
+		log("When synthesizer runs with -j <jobs>, fully selected modules are first mapped\n");
+		log("in parallel using the templates elaborated so far. Cells that need a new\n");
+		log("template are then mapped serially.\n");
+		log("\n");
 		log("When a module in the map file has the 'techmap_celltype' attribute set, it will\n");
 		log("match cells with a type that match the text value of this attribute. Otherwise\n");
 		log("the module name will be used to match the cell.  Multiple space-separated cell\n");
@@ -1208,10 +1459,38 @@ struct TechmapPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		RTLIL::Design *map = new RTLIL::Design;
-		if (map_files.empty()) {
-			Frontend::frontend_call(map, nullptr, "+/techmap.v", verilog_frontend);
+		if (map_files.empty())
+			map_files.push_back("+/techmap.v");
+
+		bool use_cache = true;
+		for (auto &fn : map_files)
+			if (fn.compare(0, 1, "%") == 0)
+				use_cache = false;
+
+		std::string cache_key = use_cache ? MapLibraryCache::make_key(map_files, verilog_frontend) : std::string();
+		RTLIL::Design *cached_map = cache_key.empty() ? nullptr : map_library_cache.load(cache_key, map_files, verilog_frontend);
+		MapTemplateCache *templates = nullptr;
+		RTLIL::Design *map = nullptr;
+		dict<IdString, pool<IdString>> celltypeMap;
+
+		if (cached_map != nullptr) {
+			templates = &map_library_cache.templates[cache_key + worker.options_key()];
+			if (!templates->complete)
+				templates->clear();
+			if (templates->map == nullptr) {
+				templates->map = new RTLIL::Design;
+				for (auto mod : cached_map->modules())
+					templates->map->add(mod->clone());
+				templates->celltypeMap = techmap_celltype_map(templates->map);
+			} else if (!templates->techmap_cache.empty())
+				log("Reusing %d elaborated templates from earlier techmap calls.\n", GetSize(templates->techmap_cache));
+			templates->complete = false;
+			map = templates->map;
+			celltypeMap = templates->celltypeMap;
+			std::swap(worker.techmap_cache, templates->techmap_cache);
+			std::swap(worker.techmap_do_cache, templates->techmap_do_cache);
 		} else {
+			map = new RTLIL::Design;
 			for (auto &fn : map_files)
 				if (fn.compare(0, 1, "%") == 0) {
 					if (!saved_designs.count(fn.substr(1))) {
@@ -1224,51 +1503,31 @@ struct TechmapPass : public Pass {
 				} else {
 					Frontend::frontend_call(map, nullptr, fn, (fn.size() > 3 && fn.compare(fn.size()-3, std::string::npos, ".il") == 0 ? "rtlil" : verilog_frontend));
 				}
+			celltypeMap = techmap_celltype_map(map);
 		}
 
 		log_header(design, "Continuing TECHMAP pass.\n");
 
-		dict<IdString, pool<IdString>> celltypeMap;
-		for (auto module : map->modules()) {
-			if (module->attributes.count(ID::techmap_celltype) && !module->attributes.at(ID::techmap_celltype).bits.empty()) {
-				char *p = strdup(module->attributes.at(ID::techmap_celltype).decode_string().c_str());
-				for (char *q = strtok(p, " \t\r\n"); q; q = strtok(nullptr, " \t\r\n")) {
-					std::vector<std::string> queue;
-					queue.push_back(q);
-					while (!queue.empty()) {
-						std::string name = queue.back();
-						queue.pop_back();
-						auto pos = name.find('[');
-						if (pos == std::string::npos) {
-							// No further expansion.
-							celltypeMap[RTLIL::escape_id(name)].insert(module->name);
-						} else {
-							// Expand [] in this name.
-							auto epos = name.find(']', pos);
-							if (epos == std::string::npos)
-								log_error("Malformed techmap_celltype pattern %s\n", q);
-							for (size_t i = pos + 1; i < epos; i++) {
-								queue.push_back(name.substr(0, pos) + name[i] + name.substr(epos + 1, std::string::npos));
-							}
-						}
-					}
+		// With -j, whole modules are first mapped in parallel using the templates
+		// that are elaborated already; the serial loop below maps the rest.
+		dict<RTLIL::Module*, pool<RTLIL::Cell*>> parallel_handled_cells;
+		if (yosys_parallel_jobs > 1 && !worker.extern_mode && max_iter < 0)
+		{
+			std::vector<RTLIL::Module*> modules;
+			for (auto module : design->modules())
+				if (design->selected_whole_module(module) && !module->get_blackbox_attribute(worker.ignore_wb)) {
+					modules.push_back(module);
+					parallel_handled_cells[module];
 				}
-				free(p);
-			} else {
-				IdString module_name = module->name.begins_with("\\$") ?
-						module->name.substr(1) : module->name.str();
-				celltypeMap[module_name].insert(module->name);
-			}
-		}
-		log_debug("Cell type mappings to use:\n");
-		for (auto &i : celltypeMap) {
-			i.second.sort(RTLIL::sort_by_id_str());
-			std::string maps = "";
-			for (auto &map : i.second)
-				maps += stringf(" %s", log_id(map));
-			log_debug("    %s:%s\n", log_id(i.first), maps.c_str());
+
+			worker.parallel_mode = true;
+			parallel_for_modules(design, modules, [&](RTLIL::Module *module) {
+				pool<RTLIL::Cell*> &handled_cells = parallel_handled_cells.at(module);
+				while (worker.techmap_module(design, module, map, handled_cells, celltypeMap, false))
+					module->check();
+			});
+			worker.parallel_mode = false;
 		}
-		log_debug("\n");
 
 		for (auto module : design->modules())
 			worker.module_queue.insert(module);
@@ -1281,6 +1540,9 @@ struct TechmapPass : public Pass {
 			int module_max_iter = max_iter;
 			bool did_something = true;
 			pool<RTLIL::Cell*> handled_cells;
+			auto it = parallel_handled_cells.find(module);
+			if (it != parallel_handled_cells.end())
+				handled_cells.swap(it->second);
 			while (did_something) {
 				did_something = false;
 				if (worker.techmap_module(design, module, map, handled_cells, celltypeMap, false))
@@ -1293,7 +1555,13 @@ struct TechmapPass : public Pass {
 		}
 		if(log_verbose_level > 9)
 			log("No more expansions possible.\n");
-		delete map;
+
+		if (templates != nullptr) {
+			std::swap(worker.techmap_cache, templates->techmap_cache);
+			std::swap(worker.techmap_do_cache, templates->techmap_do_cache);
+			templates->complete = true;
+		} else
+			delete map;
 
 		log_pop();
 	}
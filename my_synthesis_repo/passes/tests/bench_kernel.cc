@@ -0,0 +1,366 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+static uint32_t xorshift32_state = 123456789;
+
+static uint32_t xorshift32(uint32_t limit) {
+	xorshift32_state ^= xorshift32_state << 13;
+	xorshift32_state ^= xorshift32_state >> 17;
+	xorshift32_state ^= xorshift32_state << 5;
+	return xorshift32_state % limit;
+}
+
+struct bench_result_t {
+	std::string name;
+	int64_t ns, ops;
+};
+
+struct KernelBench
+{
+	int size, repeat;
+	pool<std::string> filters;
+	std::vector<bench_result_t> results;
+	uint64_t checksum = 0;
+
+	KernelBench(int size, int repeat) : size(size), repeat(repeat) { }
+
+	// Runs the benchmark repeat times and keeps the fastest run, which is
+	// the least noisy number to compare against a baseline.
+	template<typename F>
+	void measure(const std::string &group, const std::string &name, int64_t ops, F body)
+	{
+		if (!filters.empty() && !filters.count(group))
+			return;
+
+		int64_t best_ns = -1;
+		for (int i = 0; i < repeat; i++) {
+			PerformanceTimer timer;
+			timer.begin();
+			body();
+			timer.end();
+			if (best_ns < 0 || timer.total_ns < best_ns)
+				best_ns = timer.total_ns;
+		}
+
+		results.push_back({name, best_ns, ops});
+		log("  %-32s %10.3f ms %10.2f ns/op\n", name.c_str(), best_ns / 1e6, ops ? double(best_ns) / ops : 0.0);
+	}
+
+	void bench_hashlib()
+	{
+		std::vector<int> keys, misses;
+		for (int i = 0; i < size; i++) {
+			keys.push_back(2 * xorshift32(0x40000000));
+			misses.push_back(2 * xorshift32(0x40000000) + 1);
+		}
+
+		measure("hashlib", "dict<int>.insert", size, [&]() {
+			dict<int, int> d;
+			for (int i = 0; i < size; i++)
+				d[keys[i]] = i;
+			checksum += GetSize(d);
+		});
+
+		dict<int, int> d;
+		pool<int> p;
+		for (int i = 0; i < size; i++) {
+			d[keys[i]] = i;
+			p.insert(keys[i]);
+		}
+
+		measure("hashlib", "dict<int>.lookup", 2 * int64_t(size), [&]() {
+			for (int i = 0; i < size; i++) {
+				checksum += d.count(keys[i]);
+				checksum += d.count(misses[i]);
+			}
+		});
+
+		measure("hashlib", "dict<int>.iterate", GetSize(d), [&]() {
+			for (auto &it : d)
+				checksum += it.second;
+		});
+
+		measure("hashlib", "pool<int>.insert", size, [&]() {
+			pool<int> q;
+			for (int i = 0; i < size; i++)
+				q.insert(keys[i]);
+			checksum += GetSize(q);
+		});
+
+		measure("hashlib", "pool<int>.lookup", 2 * int64_t(size), [&]() {
+			for (int i = 0; i < size; i++) {
+				checksum += p.count(keys[i]);
+				checksum += p.count(misses[i]);
+			}
+		});
+
+		measure("hashlib", "pool<int>.iterate", GetSize(p), [&]() {
+			for (auto key : p)
+				checksum += key;
+		});
+	}
+
+	void bench_idstring()
+	{
+		std::vector<std::string> names;
+		for (int i = 0; i < size; i++)
+			names.push_back(stringf("\\bench_id_%d", i));
+
+		// new names in every run, so that each run really creates them
+		int run = 0;
+		measure("idstring", "IdString.create", size, [&]() {
+			std::vector<RTLIL::IdString> ids;
+			ids.reserve(size);
+			for (int i = 0; i < size; i++)
+				ids.push_back(stringf("\\bench_new_%d_%d", run, i));
+			checksum += ids.back().index_;
+			run++;
+		});
+
+		std::vector<RTLIL::IdString> ids(names.begin(), names.end());
+		measure("idstring", "IdString.lookup", size, [&]() {
+			for (int i = 0; i < size; i++)
+				checksum += RTLIL::IdString(names[i]).index_;
+		});
+
+		dict<RTLIL::IdString, int> id_dict;
+		for (int i = 0; i < size; i++)
+			id_dict[ids[i]] = i;
+		measure("idstring", "dict<IdString>.lookup", size, [&]() {
+			for (int i = 0; i < size; i++)
+				checksum += id_dict.at(ids[xorshift32(size)]);
+		});
+	}
+
+	void bench_sigspec()
+	{
+		RTLIL::Design design;
+		RTLIL::Module *module = design.addModule(ID(bench));
+		int width = 64;
+		std::vector<RTLIL::Wire*> wires;
+		for (int i = 0; i < (size + width - 1) / width; i++)
+			wires.push_back(module->addWire(stringf("\\w%d", i), width));
+
+		std::vector<RTLIL::SigBit> bits;
+		for (auto wire : wires)
+			for (int i = 0; i < width; i++)
+				bits.push_back(RTLIL::SigBit(wire, i));
+
+		measure("sigspec", "SigSpec.append(SigBit)", GetSize(bits), [&]() {
+			RTLIL::SigSpec sig;
+			for (auto &bit : bits)
+				sig.append(bit);
+			checksum += GetSize(sig.chunks());
+		});
+
+		measure("sigspec", "SigSpec.append(Wire)", GetSize(wires), [&]() {
+			RTLIL::SigSpec sig;
+			for (auto wire : wires)
+				sig.append(wire);
+			checksum += GetSize(sig);
+		});
+
+		// bits in random order, so packing finds few contiguous runs
+		std::vector<RTLIL::SigBit> shuffled = bits;
+		for (int i = GetSize(shuffled) - 1; i > 0; i--)
+			std::swap(shuffled[i], shuffled[xorshift32(i + 1)]);
+
+		measure("sigspec", "SigSpec.pack", 2 * int64_t(GetSize(bits)), [&]() {
+			RTLIL::SigSpec sorted(bits), unsorted(shuffled);
+			checksum += GetSize(sorted.chunks());
+			checksum += GetSize(unsorted.chunks());
+		});
+
+		RTLIL::SigSpec all_wires;
+		for (auto wire : wires)
+			all_wires.append(wire);
+		std::vector<int> offsets;
+		for (int i = 0; i < size; i++)
+			offsets.push_back(xorshift32(GetSize(all_wires) - 16));
+
+		measure("sigspec", "SigSpec.extract", size, [&]() {
+			for (int i = 0; i < size; i++)
+				checksum += GetSize(all_wires.extract(offsets[i], 16).chunks());
+		});
+
+		// random 1-bit connections between the wires, like after flattening
+		for (int i = 0; i < size; i++)
+			module->connect(bits[xorshift32(GetSize(bits))], bits[xorshift32(GetSize(bits))]);
+
+		measure("sigspec", "SigMap.construct", size, [&]() {
+			SigMap sigmap(module);
+			checksum += sigmap(bits.front()).offset;
+		});
+
+		SigMap sigmap(module);
+		measure("sigspec", "SigMap.lookup", GetSize(bits), [&]() {
+			for (auto &bit : bits)
+				checksum += sigmap(bit).offset;
+		});
+	}
+
+	void bench_const()
+	{
+		int num_ops = std::max(1, size / 10);
+		std::vector<RTLIL::Const> narrow, wide;
+		for (int i = 0; i < 64; i++) {
+			narrow.push_back(RTLIL::Const(int(xorshift32(0x40000000)), 32));
+			std::vector<RTLIL::State> bits;
+			for (int j = 0; j < 256; j++)
+				bits.push_back(xorshift32(2) ? State::S1 : State::S0);
+			wide.push_back(RTLIL::Const(bits));
+		}
+
+		auto const_op = [&](const char *name, std::vector<RTLIL::Const> &args, RTLIL::Const (*op)(const RTLIL::Const&, const RTLIL::Const&, bool, bool, int)) {
+			measure("const", stringf("%s/%d", name, GetSize(args.front())), num_ops, [&]() {
+				for (int i = 0; i < num_ops; i++)
+					checksum += op(args[i % 64], args[(i * 7 + 1) % 64], false, false, GetSize(args.front())).as_bool();
+			});
+		};
+
+		for (auto args : {&narrow, &wide}) {
+			const_op("const_and", *args, RTLIL::const_and);
+			const_op("const_add", *args, RTLIL::const_add);
+			const_op("const_mul", *args, RTLIL::const_mul);
+			const_op("const_eq", *args, RTLIL::const_eq);
+		}
+
+		std::vector<RTLIL::Const> amounts;
+		for (int i = 0; i < 64; i++)
+			amounts.push_back(RTLIL::Const(int(xorshift32(64)), 8));
+		measure("const", "const_shl/256", num_ops, [&]() {
+			for (int i = 0; i < num_ops; i++)
+				checksum += RTLIL::const_shl(wide[i % 64], amounts[i % 64], false, false, 256).as_bool();
+		});
+	}
+
+	void write_json(std::ostream &f)
+	{
+		f << "{\n";
+		f << stringf("  \"size\": %d,\n", size);
+		f << stringf("  \"repeat\": %d,\n", repeat);
+		f << "  \"results\": [\n";
+		for (int i = 0; i < GetSize(results); i++) {
+			auto &r = results[i];
+			f << stringf("    { \"name\": \"%s\", \"ns\": %lld, \"ops\": %lld, \"ns_per_op\": %.3f }%s\n", r.name.c_str(),
+					(long long)r.ns, (long long)r.ops, r.ops ? double(r.ns) / r.ops : 0.0, i+1 < GetSize(results) ? "," : "");
+		}
+		f << "  ]\n";
+		f << "}\n";
+	}
+};
+
+struct BenchKernelPass : public Pass {
+	BenchKernelPass() : Pass("bench_kernel", "benchmark the kernel data structures") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_kernel [options] [groups]\n");
+		log("\n");
+		log("Run microbenchmarks of the kernel data structures and print the time of each\n");
+		log("one. The groups are:\n");
+		log("\n");
+		log("    hashlib     dict<> and pool<> insertion, lookup and iteration\n");
+		log("    idstring    IdString creation and lookup\n");
+		log("    sigspec     SigSpec append, pack and extract, SigMap construction\n");
+		log("    const       the Const operations of calc.cc\n");
+		log("\n");
+		log("All groups are run when none is given. Each benchmark is repeated and the\n");
+		log("fastest run is reported, in CPU time.\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of elements per benchmark (default = 100000).\n");
+		log("\n");
+		log("    -r {integer}\n");
+		log("        number of repetitions of each benchmark (default = 5).\n");
+		log("\n");
+		log("    -s {positive_integer}\n");
+		log("        use this value as rng seed value (default = 123456789).\n");
+		log("\n");
+		log("    -json {filename}\n");
+		log("        write the results to a JSON file, to be compared against the results\n");
+		log("        of a baseline build.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) override
+	{
+		int size = 100000;
+		int repeat = 5;
+		std::string json_file;
+		xorshift32_state = 123456789;
+
+		int argidx;
+		for (argidx = 1; argidx < GetSize(args); argidx++)
+		{
+			if (args[argidx] == "-n" && argidx+1 < GetSize(args)) {
+				size = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-r" && argidx+1 < GetSize(args)) {
+				repeat = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-s" && argidx+1 < GetSize(args)) {
+				xorshift32_state = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-json" && argidx+1 < GetSize(args)) {
+				json_file = args[++argidx];
+				continue;
+			}
+			break;
+		}
+
+		if (size < 100 || repeat < 1 || xorshift32_state == 0)
+			log_cmd_error("Invalid argument.\n");
+
+		KernelBench bench(size, repeat);
+
+		for (; argidx < GetSize(args); argidx++) {
+			if (args[argidx] != "hashlib" && args[argidx] != "idstring" && args[argidx] != "sigspec" && args[argidx] != "const")
+				log_cmd_error("Unknown benchmark group `%s'.\n", args[argidx].c_str());
+			bench.filters.insert(args[argidx]);
+		}
+
+		log("Elements: %d, repetitions: %d\n\n", size, repeat);
+
+		bench.bench_hashlib();
+		bench.bench_idstring();
+		bench.bench_sigspec();
+		bench.bench_const();
+
+		log("\nChecksum: %llu\n", (unsigned long long)bench.checksum);
+
+		if (!json_file.empty()) {
+			std::ofstream f(json_file, std::ios_base::trunc);
+			if (!f.is_open())
+				log_cmd_error("Failed to open output file `%s'.\n", json_file.c_str());
+			bench.write_json(f);
+		}
+	}
+} BenchKernelPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,386 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include <fstream>
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+static uint32_t xorshift32_state = 123456789;
+
+static uint32_t xorshift32(uint32_t limit) {
+	xorshift32_state ^= xorshift32_state << 13;
+	xorshift32_state ^= xorshift32_state >> 17;
+	xorshift32_state ^= xorshift32_state << 5;
+	return xorshift32_state % limit;
+}
+
+// registered ALU: add, sub, and, xor selected by a 2 bit opcode, plus a compare flag
+static void create_alu(RTLIL::Module *module, int width)
+{
+	RTLIL::Wire *clk = module->addWire(ID(clk));
+	RTLIL::Wire *a = module->addWire(ID(a), width);
+	RTLIL::Wire *b = module->addWire(ID(b), width);
+	RTLIL::Wire *op = module->addWire(ID(op), 2);
+	RTLIL::Wire *y = module->addWire(ID(y), width);
+	RTLIL::Wire *lt = module->addWire(ID(lt));
+	clk->port_input = a->port_input = b->port_input = op->port_input = true;
+	y->port_output = lt->port_output = true;
+
+	RTLIL::SigSpec arith = module->Mux(NEW_ID, module->Add(NEW_ID, a, b), module->Sub(NEW_ID, a, b), RTLIL::SigSpec(op, 0));
+	RTLIL::SigSpec logic = module->Mux(NEW_ID, module->And(NEW_ID, a, b), module->Xor(NEW_ID, a, b), RTLIL::SigSpec(op, 0));
+	module->addDff(NEW_ID, clk, module->Mux(NEW_ID, arith, logic, RTLIL::SigSpec(op, 1)), y);
+	module->addDff(NEW_ID, clk, module->Lt(NEW_ID, a, b), lt);
+}
+
+// multiplier with registered inputs and output, for DSP inference
+static void create_mul(RTLIL::Module *module, int width)
+{
+	RTLIL::Wire *clk = module->addWire(ID(clk));
+	RTLIL::Wire *a = module->addWire(ID(a), width);
+	RTLIL::Wire *b = module->addWire(ID(b), width);
+	RTLIL::Wire *y = module->addWire(ID(y), 2 * width);
+	clk->port_input = a->port_input = b->port_input = true;
+	y->port_output = true;
+
+	RTLIL::SigSpec a_q = module->addWire(NEW_ID, width);
+	RTLIL::SigSpec b_q = module->addWire(NEW_ID, width);
+	module->addDff(NEW_ID, clk, a, a_q);
+	module->addDff(NEW_ID, clk, b, b_q);
+	module->addDff(NEW_ID, clk, module->Mul(NEW_ID, a_q, b_q, false), y);
+}
+
+// random gate level netlist, every 16th gate is a flip-flop; the inputs of a
+// gate are taken from the recent gates, so most of the netlist stays alive
+static void create_random(RTLIL::Module *module, int num_gates)
+{
+	const int io_width = 64, window = 4096;
+
+	RTLIL::Wire *clk = module->addWire(ID(clk));
+	RTLIL::Wire *in = module->addWire(ID(in), io_width);
+	RTLIL::Wire *out = module->addWire(ID(out), io_width);
+	clk->port_input = in->port_input = true;
+	out->port_output = true;
+
+	RTLIL::Wire *nets = module->addWire(ID(nets), num_gates);
+	auto pick = [&](int i) {
+		int n = xorshift32(std::min(i, window) + io_width);
+		return n < io_width ? RTLIL::SigBit(in, n) : RTLIL::SigBit(nets, i - 1 - (n - io_width));
+	};
+
+	for (int i = 0; i < num_gates; i++) {
+		RTLIL::SigBit y = RTLIL::SigBit(nets, i);
+		if (i % 16 == 15) {
+			module->addDffGate(NEW_ID, clk, pick(i), y);
+			continue;
+		}
+		switch (xorshift32(4)) {
+			case 0: module->addAndGate(NEW_ID, pick(i), pick(i), y); break;
+			case 1: module->addOrGate(NEW_ID, pick(i), pick(i), y); break;
+			case 2: module->addXorGate(NEW_ID, pick(i), pick(i), y); break;
+			default: module->addMuxGate(NEW_ID, pick(i), pick(i), pick(i), y); break;
+		}
+	}
+
+	for (int i = 0; i < io_width; i++)
+		module->connect(RTLIL::SigBit(out, i), RTLIL::SigBit(nets, num_gates - 1 - i));
+}
+
+struct benchmark_design_t {
+	std::string name;
+	int tier; // 0 = small, 1 = medium, 2 = large
+	std::function<void(RTLIL::Module*)> create;
+};
+
+static std::vector<benchmark_design_t> benchmark_corpus()
+{
+	return {
+		{"alu8", 0, [](RTLIL::Module *m) { create_alu(m, 8); }},
+		{"alu32", 0, [](RTLIL::Module *m) { create_alu(m, 32); }},
+		{"mul16", 0, [](RTLIL::Module *m) { create_mul(m, 16); }},
+		{"random2k", 0, [](RTLIL::Module *m) { create_random(m, 2000); }},
+		{"alu128", 1, [](RTLIL::Module *m) { create_alu(m, 128); }},
+		{"mul32", 1, [](RTLIL::Module *m) { create_mul(m, 32); }},
+		{"random20k", 1, [](RTLIL::Module *m) { create_random(m, 20000); }},
+		{"random100k", 1, [](RTLIL::Module *m) { create_random(m, 100000); }},
+		{"random1m", 2, [](RTLIL::Module *m) { create_random(m, 1000000); }},
+	};
+}
+
+struct Benchmark
+{
+	double threshold = 20, mem_threshold = 20, min_time = 0.5;
+	nlohmann::json results = nlohmann::json::array();
+	int regressions = 0;
+
+	nlohmann::json run(const benchmark_design_t &entry, const std::string &flow)
+	{
+		log_header(nullptr, "Running %s on %s.\n", flow.c_str(), entry.name.c_str());
+		log_push();
+
+		RTLIL::Design *design = new RTLIL::Design;
+		RTLIL::Module *module = design->addModule(ID(top));
+		entry.create(module);
+		module->fixup_ports();
+
+		nlohmann::json row;
+		row["design"] = entry.name;
+		row["flow"] = flow;
+		row["input_cells"] = GetSize(module->cells());
+
+		int64_t rss_before_kb = current_rss_kb();
+		Pass::call(design, flow + " -profile -top top");
+
+		ScriptPass *pass = dynamic_cast<ScriptPass*>(pass_register.at(flow));
+		log_assert(pass != nullptr);
+
+		row["labels"] = nlohmann::json::array();
+		int64_t cpu_ns = 0, wall_ns = 0, peak_kb = rss_before_kb;
+		for (auto &profile : pass->label_profiles) {
+			nlohmann::json label;
+			label["label"] = profile.label;
+			label["cpu_ns"] = profile.cpu_ns;
+			label["wall_ns"] = profile.wall_ns;
+			label["peak_rss_kb"] = profile.peak_rss_kb;
+			label["cells"] = profile.cells;
+			row["labels"].push_back(label);
+			cpu_ns += profile.cpu_ns;
+			wall_ns += profile.wall_ns;
+			peak_kb = std::max(peak_kb, profile.peak_rss_kb);
+		}
+		row["cpu_ns"] = cpu_ns;
+		row["wall_ns"] = wall_ns;
+		row["rss_growth_kb"] = peak_kb - rss_before_kb;
+		row["cells"] = pass->label_profiles.empty() ? 0 : pass->label_profiles.back().cells;
+
+		delete design;
+		log_pop();
+		return row;
+	}
+
+	void check_time(const std::string &what, double current_sec, double baseline_sec)
+	{
+		if (baseline_sec < min_time)
+			return;
+		double change = 100 * (current_sec - baseline_sec) / baseline_sec;
+		if (change > threshold) {
+			log_warning("Regression in %s: %.3f sec, baseline %.3f sec (%+.1f%%).\n", what.c_str(), current_sec, baseline_sec, change);
+			regressions++;
+		}
+	}
+
+	// Compares the CPU time of every label and each run's memory growth against
+	// the entry of the same design and flow in the baseline.
+	void compare(const nlohmann::json &row, const nlohmann::json &baseline)
+	{
+		const nlohmann::json *base = nullptr;
+		for (auto &it : baseline)
+			if (it["design"] == row["design"] && it["flow"] == row["flow"])
+				base = &it;
+		std::string name = row["design"].get<std::string>() + "/" + row["flow"].get<std::string>();
+		if (base == nullptr) {
+			log("No baseline for %s.\n", name.c_str());
+			return;
+		}
+
+		check_time(name, row["cpu_ns"].get<int64_t>() / 1e9, (*base)["cpu_ns"].get<int64_t>() / 1e9);
+		for (auto &label : row["labels"])
+			for (auto &base_label : (*base)["labels"])
+				if (base_label["label"] == label["label"])
+					check_time(name + ":" + label["label"].get<std::string>(), label["cpu_ns"].get<int64_t>() / 1e9,
+							base_label["cpu_ns"].get<int64_t>() / 1e9);
+
+		// growth below 16 MB is noise from the allocator
+		int64_t growth = row["rss_growth_kb"].get<int64_t>(), base_growth = (*base)["rss_growth_kb"].get<int64_t>();
+		if (growth - base_growth > 16 * 1024 && growth > base_growth * (1 + mem_threshold / 100)) {
+			log_warning("Memory regression in %s: +%.1f MB, baseline +%.1f MB.\n", name.c_str(), growth / 1024.0, base_growth / 1024.0);
+			regressions++;
+		}
+	}
+};
+
+struct BenchmarkPass : public Pass {
+	BenchmarkPass() : Pass("benchmark", "run the synthesis flows on a corpus of generated designs") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    benchmark [options] [designs]\n");
+		log("\n");
+		log("Generate the designs of the benchmark corpus and run synth and synth_xilinx on\n");
+		log("each of them, with the per label profiling of -profile. The corpus is built in\n");
+		log("from a fixed seed, so that runs of different builds can be compared:\n");
+		log("\n");
+		log("    small    alu8, alu32, mul16, random2k\n");
+		log("    medium   alu128, mul32, random20k, random100k\n");
+		log("    large    random1m (a netlist of one million gates)\n");
+		log("\n");
+		log("The aluN designs are registered N bit ALUs, mulN are registered N by N bit\n");
+		log("multipliers and randomN are random netlists of N gates and flip-flops. The\n");
+		log("given designs are run, or all designs up to the tier given with -corpus. The\n");
+		log("current design is not used or changed.\n");
+		log("\n");
+		log("    -corpus small|medium|large\n");
+		log("        run the designs up to and including this tier (default = medium).\n");
+		log("\n");
+		log("    -flow {pass}\n");
+		log("        run this synthesis script pass instead of synth and synth_xilinx.\n");
+		log("        can be given more than once.\n");
+		log("\n");
+		log("    -json {filename}\n");
+		log("        write the time, memory and cell counts of every design, flow and\n");
+		log("        label to a JSON file.\n");
+		log("\n");
+		log("    -baseline {filename}\n");
+		log("        compare the results against a file written with -json by an earlier\n");
+		log("        run, and fail if there are regressions.\n");
+		log("\n");
+		log("    -threshold {percent}\n");
+		log("        CPU time increase of a run or label that counts as a regression\n");
+		log("        (default = 20).\n");
+		log("\n");
+		log("    -mem_threshold {percent}\n");
+		log("        memory growth increase of a run that counts as a regression\n");
+		log("        (default = 20).\n");
+		log("\n");
+		log("    -min_time {seconds}\n");
+		log("        only compare runs and labels that took at least this long in the\n");
+		log("        baseline (default = 0.5).\n");
+		log("\n");
+		log("Peak memory can only be measured for the process as a whole, so the memory\n");
+		log("growth of a run is how far it raised the peak above the memory in use before\n");
+		log("it. The corpus is run by increasing size to keep that meaningful.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		Benchmark bench;
+		int tier = 1;
+		std::vector<std::string> flows;
+		std::string json_file, baseline_file;
+
+		log_header(design, "Executing BENCHMARK pass.\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-corpus" && argidx+1 < args.size()) {
+				std::string arg = args[++argidx];
+				if (arg == "small")
+					tier = 0;
+				else if (arg == "medium")
+					tier = 1;
+				else if (arg == "large")
+					tier = 2;
+				else
+					log_cmd_error("Unknown corpus `%s'.\n", arg.c_str());
+				continue;
+			}
+			if (args[argidx] == "-flow" && argidx+1 < args.size()) {
+				flows.push_back(args[++argidx]);
+				continue;
+			}
+			if (args[argidx] == "-json" && argidx+1 < args.size()) {
+				json_file = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-baseline" && argidx+1 < args.size()) {
+				baseline_file = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-threshold" && argidx+1 < args.size()) {
+				bench.threshold = atof(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-mem_threshold" && argidx+1 < args.size()) {
+				bench.mem_threshold = atof(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-min_time" && argidx+1 < args.size()) {
+				bench.min_time = atof(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+
+		if (flows.empty())
+			flows = {"synth", "synth_xilinx"};
+		for (auto &flow : flows)
+			if (pass_register.count(flow) == 0 || dynamic_cast<ScriptPass*>(pass_register.at(flow)) == nullptr)
+				log_cmd_error("`%s' is not a synthesis script pass.\n", flow.c_str());
+
+		std::vector<benchmark_design_t> corpus = benchmark_corpus(), selected;
+		for (; argidx < args.size(); argidx++) {
+			auto it = std::find_if(corpus.begin(), corpus.end(), [&](const benchmark_design_t &entry) { return entry.name == args[argidx]; });
+			if (it == corpus.end())
+				log_cmd_error("Unknown benchmark design `%s'.\n", args[argidx].c_str());
+			selected.push_back(*it);
+		}
+		if (selected.empty())
+			for (auto &entry : corpus)
+				if (entry.tier <= tier)
+					selected.push_back(entry);
+
+		nlohmann::json baseline;
+		if (!baseline_file.empty()) {
+			std::ifstream f(baseline_file);
+			if (!f.is_open())
+				log_cmd_error("Can't open baseline file `%s'.\n", baseline_file.c_str());
+			try {
+				baseline = nlohmann::json::parse(f)["results"];
+			} catch (const nlohmann::json::exception &e) {
+				log_cmd_error("Can't parse baseline file `%s': %s\n", baseline_file.c_str(), e.what());
+			}
+		}
+
+		for (auto &entry : selected)
+			for (auto &flow : flows) {
+				xorshift32_state = 123456789;
+				bench.results.push_back(bench.run(entry, flow));
+			}
+
+		log("\n%-12s %-14s %10s %10s %10s %10s\n", "design", "flow", "in cells", "cells", "CPU sec", "+peak MB");
+		for (auto &row : bench.results)
+			log("%-12s %-14s %10d %10lld %10.3f %10.2f\n", row["design"].get<std::string>().c_str(), row["flow"].get<std::string>().c_str(),
+					row["input_cells"].get<int>(), (long long)row["cells"].get<int64_t>(), row["cpu_ns"].get<int64_t>() / 1e9,
+					row["rss_growth_kb"].get<int64_t>() / 1024.0);
+
+		if (!json_file.empty()) {
+			nlohmann::json data;
+			data["results"] = bench.results;
+			std::ofstream fout;
+			fout.open(json_file, std::ios::out | std::ios::trunc);
+			if (!fout.is_open())
+				log_error("Could not open file \"%s\" with write access.\n", json_file.c_str());
+			fout << data.dump(2) << std::endl;
+		}
+
+		if (!baseline_file.empty()) {
+			log("\n");
+			for (auto &row : bench.results)
+				bench.compare(row, baseline);
+			if (bench.regressions)
+				log_error("Found %d regressions against baseline `%s'.\n", bench.regressions, baseline_file.c_str());
+			log("No regressions against baseline `%s'.\n", baseline_file.c_str());
+		}
+	}
+} BenchmarkPass;
+
+PRIVATE_NAMESPACE_END
@@ -23,7 +23,9 @@
 #include "kernel/consteval.h"
 #include "kernel/celledges.h"
 #include "kernel/macc.h"
+#include "kernel/threading.h"
 #include <algorithm>
+#include <chrono>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -700,6 +702,102 @@ static void run_eval_test(RTLIL::Design *design, bool verbose, bool nosat, std::
 		log(" ok.\n");
 }
 
+// number of cases per child process with -j, fixed so the cases do not depend on the job count
+static const int shard_size = 10;
+
+struct test_cell_shard_t {
+	IdString cell_type;
+	int count;
+	uint32_t seed;
+	double seconds;
+	bool failed;
+};
+
+struct test_cell_report_t {
+	IdString cell_type;
+	int cases;
+	double seconds;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point begin)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+static uint32_t shard_seed(uint32_t seed, IdString cell_type, int index)
+{
+	unsigned int h = mkhash(seed, index);
+	for (char c : cell_type.str())
+		h = mkhash(h, c);
+	h &= 0x7fffffff;
+	return h ? h : 1;
+}
+
+static void write_json_report(const std::string &filename, const std::vector<test_cell_report_t> &report, double seconds, int jobs)
+{
+	std::ofstream f(filename, std::ios_base::trunc);
+	if (!f.is_open())
+		log_error("Failed to open output file `%s'.\n", filename.c_str());
+
+	int cases = 0;
+	f << "{\n";
+	f << stringf("  \"jobs\": %d,\n", jobs);
+	f << "  \"cell_types\": [\n";
+	for (int i = 0; i < GetSize(report); i++) {
+		auto &r = report[i];
+		f << stringf("    { \"type\": \"%s\", \"cases\": %d, \"seconds\": %.3f, \"cases_per_second\": %.3f }%s\n",
+				log_id(r.cell_type), r.cases, r.seconds, r.seconds > 0 ? r.cases / r.seconds : 0.0, i+1 < GetSize(report) ? "," : "");
+		cases += r.cases;
+	}
+	f << "  ],\n";
+	f << stringf("  \"cases\": %d,\n", cases);
+	f << stringf("  \"seconds\": %.3f,\n", seconds);
+	f << stringf("  \"cases_per_second\": %.3f\n", seconds > 0 ? cases / seconds : 0.0);
+	f << "}\n";
+}
+
+static void run_parallel(const std::vector<IdString> &selected_cell_types, int num_iter, uint32_t seed, const std::string &child_args,
+		std::string yosys_cmd, int jobs, std::vector<test_cell_report_t> &report)
+{
+	std::vector<test_cell_shard_t> shards;
+	for (auto cell_type : selected_cell_types)
+		for (int i = 0; i*shard_size < num_iter; i++)
+			shards.push_back({cell_type, std::min(shard_size, num_iter - i*shard_size), shard_seed(seed, cell_type, i), 0, false});
+
+	auto shard_cmdline = [&](int i) {
+		auto &shard = shards[i];
+		return stringf("%s -qq -L test_cell-%d.log -p 'test_cell%s -s %u -n %d %s'", yosys_cmd.c_str(), i,
+				child_args.c_str(), shard.seed, shard.count, log_id(shard.cell_type));
+	};
+
+	log("Running %d cases in %d child processes, up to %d at a time.\n", GetSize(selected_cell_types) * num_iter, GetSize(shards), jobs);
+
+	parallel_for(GetSize(shards), [&](int i) {
+		auto begin = std::chrono::steady_clock::now();
+		shards[i].failed = run_command(shard_cmdline(i)) != 0;
+		shards[i].seconds = seconds_since(begin);
+		if (!shards[i].failed)
+			remove(stringf("test_cell-%d.log", i).c_str());
+	}, jobs);
+
+	int failed = 0;
+	for (int i = 0; i < GetSize(shards); i++) {
+		auto &shard = shards[i];
+		if (report.empty() || report.back().cell_type != shard.cell_type)
+			report.push_back({shard.cell_type, 0, 0});
+		report.back().cases += shard.count;
+		report.back().seconds += shard.seconds;
+		if (shard.failed) {
+			log("Failed %d %s cases, see test_cell-%d.log. Rerun with:\n  %s\n", shard.count, log_id(shard.cell_type), i, shard_cmdline(i).c_str());
+			failed++;
+		}
+	}
+
+	if (failed)
+		log_error("%d of %d child processes failed.\n", failed, GetSize(shards));
+	log("All %d child processes passed.\n", GetSize(shards));
+}
+
 struct TestCellPass : public Pass {
 	TestCellPass() : Pass("test_cell", "automatically test the implementation of a cell type") { }
 	void help() override
@@ -761,6 +859,24 @@ struct TestCellPass : public Pass {
 		log("    -vlog {filename}\n");
 		log("        create a Verilog test bench to test simlib and write_verilog\n");
 		log("\n");
+		log("    -j {num}\n");
+		log("        run the test in child processes, up to {num} at a time. the cases of each\n");
+		log("        cell type are split into groups of %d, each with its own rng seed derived\n", shard_size);
+		log("        from -s, so the cases do not depend on {num}. failing groups are logged\n");
+		log("        with the command line that reproduces them. not supported with -f, -w\n");
+		log("        and -vlog.\n");
+		log("\n");
+		log("    -yosys {command}\n");
+		log("        the synthesizer executable used for the child processes of -j (default:\n");
+		log("        the running executable).\n");
+		log("\n");
+		log("    -json {filename}\n");
+		log("        write the number of cases, the run time and the throughput of each cell\n");
+		log("        type to a JSON file.\n");
+		log("\n");
+		log("Each case is first simulated with random input patterns, it is only handed to\n");
+		log("the SAT equivalence check when the simulation found no mismatch.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design*) override
 	{
@@ -775,6 +891,9 @@ struct TestCellPass : public Pass {
 		bool nosat = false;
 		bool noeval = false;
 		bool edges = false;
+		int jobs = 0;
+		std::string yosys_cmd = proc_self_dirname() + proc_program_prefix() + "yosys";
+		std::string json_file, child_args;
 
 		int argidx;
 		for (argidx = 1; argidx < GetSize(args); argidx++)
@@ -789,6 +908,7 @@ struct TestCellPass : public Pass {
 			}
 			if (args[argidx] == "-map" && argidx+1 < GetSize(args)) {
 				techmap_cmd += " -map " + args[++argidx];
+				child_args += " -map " + args[argidx];
 				continue;
 			}
 			if (args[argidx] == "-f" && argidx+1 < GetSize(args)) {
@@ -802,38 +922,47 @@ struct TestCellPass : public Pass {
 			}
 			if (args[argidx] == "-script" && argidx+1 < GetSize(args)) {
 				techmap_cmd = "script " + args[++argidx];
+				child_args += " -script " + args[argidx];
 				continue;
 			}
 			if (args[argidx] == "-simlib") {
 				techmap_cmd = "techmap -D SIMLIB_NOCHECKS -map +/simlib.v -max_iter 2 -autoproc";
+				child_args += " -simlib";
 				continue;
 			}
 			if (args[argidx] == "-aigmap") {
 				techmap_cmd = "aigmap";
+				child_args += " -aigmap";
 				continue;
 			}
 			if (args[argidx] == "-muxdiv") {
 				muxdiv = true;
+				child_args += " -muxdiv";
 				continue;
 			}
 			if (args[argidx] == "-const") {
 				constmode = true;
+				child_args += " -const";
 				continue;
 			}
 			if (args[argidx] == "-nosat") {
 				nosat = true;
+				child_args += " -nosat";
 				continue;
 			}
 			if (args[argidx] == "-noeval") {
 				noeval = true;
+				child_args += " -noeval";
 				continue;
 			}
 			if (args[argidx] == "-edges") {
 				edges = true;
+				child_args += " -edges";
 				continue;
 			}
 			if (args[argidx] == "-v") {
 				verbose = true;
+				child_args += " -v";
 				continue;
 			}
 			if (args[argidx] == "-vlog" && argidx+1 < GetSize(args)) {
@@ -842,6 +971,20 @@ struct TestCellPass : public Pass {
 					log_cmd_error("Failed to open output file `%s'.\n", args[argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < GetSize(args)) {
+				jobs = atoi(args[++argidx].c_str());
+				if (jobs < 1)
+					log_cmd_error("Invalid number of jobs: %d\n", jobs);
+				continue;
+			}
+			if (args[argidx] == "-yosys" && argidx+1 < GetSize(args)) {
+				yosys_cmd = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-json" && argidx+1 < GetSize(args)) {
+				json_file = args[++argidx];
+				continue;
+			}
 			break;
 		}
 
@@ -963,9 +1106,23 @@ struct TestCellPass : public Pass {
 		if (selected_cell_types.empty())
 			log_cmd_error("No cell type to test specified.\n");
 
+		std::vector<test_cell_report_t> report;
+		auto begin = std::chrono::steady_clock::now();
+
+		if (jobs > 0) {
+			if (!rtlil_file.empty() || !write_prefix.empty() || vlog_file.is_open())
+				log_cmd_error("Option -j can not be combined with -f, -w or -vlog.\n");
+			run_parallel(selected_cell_types, num_iter, xorshift32_state, child_args, yosys_cmd, jobs, report);
+			if (!json_file.empty())
+				write_json_report(json_file, report, seconds_since(begin), jobs);
+			return;
+		}
+
 		std::vector<std::string> uut_names;
 
 		for (auto cell_type : selected_cell_types)
+		{
+			auto type_begin = std::chrono::steady_clock::now();
 			for (int i = 0; i < num_iter; i++)
 			{
 				RTLIL::Design *design = new RTLIL::Design;
@@ -980,13 +1137,9 @@ struct TestCellPass : public Pass {
 					run_edges_test(design, verbose);
 				} else {
 					Pass::call(design, stringf("copy gold gate; cd gate; %s; cd ..; opt -fast gate", techmap_cmd.c_str()));
-					if (!nosat)
-						Pass::call(design, "miter -equiv -flatten -make_outputs -ignore_gold_x gold gate miter");
 					if (verbose)
 						Pass::call(design, "dump gate");
 					Pass::call(design, "dump gold");
-					if (!nosat)
-						Pass::call(design, "sat -verify -enable_undef -prove trigger 0 -show-inputs -show-outputs miter");
 					std::string uut_name = stringf("uut_%s_%d", cell_type.substr(1).c_str(), i);
 					if (vlog_file.is_open()) {
 						Pass::call(design, stringf("copy gold %s_expr; select %s_expr", uut_name.c_str(), uut_name.c_str()));
@@ -997,9 +1150,16 @@ struct TestCellPass : public Pass {
 					}
 					if (!noeval)
 						run_eval_test(design, verbose, nosat, uut_name, vlog_file);
+					// the proof only runs once the simulation above found no mismatch
+					if (!nosat) {
+						Pass::call(design, "miter -equiv -flatten -make_outputs -ignore_gold_x gold gate miter");
+						Pass::call(design, "sat -verify -enable_undef -prove trigger 0 -show-inputs -show-outputs miter");
+					}
 				}
 				delete design;
 			}
+			report.push_back({cell_type, num_iter, seconds_since(type_begin)});
+		}
 
 		if (vlog_file.is_open()) {
 			vlog_file << "\nmodule testbench;\n";
@@ -1011,6 +1171,9 @@ struct TestCellPass : public Pass {
 			vlog_file << "  end\n";
 			vlog_file << "endmodule\n";
 		}
+
+		if (!json_file.empty())
+			write_json_report(json_file, report, seconds_since(begin), 1);
 	}
 } TestCellPass;
 
@@ -0,0 +1,190 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+static uint32_t xorshift32_state = 123456789;
+
+static uint32_t xorshift32(uint32_t limit) {
+	xorshift32_state ^= xorshift32_state << 13;
+	xorshift32_state ^= xorshift32_state >> 17;
+	xorshift32_state ^= xorshift32_state << 5;
+	return xorshift32_state % limit;
+}
+
+struct HashlibBench
+{
+	int num_keys, num_rounds;
+	uint64_t checksum = 0;
+
+	HashlibBench(int num_keys, int num_rounds) : num_keys(num_keys), num_rounds(num_rounds) { }
+
+	void report(const char *name, int64_t ns, int64_t ops)
+	{
+		log("  %-28s %10.2f ms %8.2f ns/op\n", name, ns / 1e6, ops ? double(ns) / ops : 0.0);
+	}
+
+	// Inserts all keys, then does num_rounds lookups per key with a 50%
+	// miss rate, then erases every other key and iterates the rest.
+	template<typename K, typename T>
+	void run(const char *name, const std::vector<K> &keys, const std::vector<K> &misses, const T &value)
+	{
+		PerformanceTimer timer;
+		timer.begin();
+
+		dict<K, T> d;
+		for (auto &key : keys)
+			d[key] = value;
+		for (int round = 0; round < num_rounds; round++)
+			for (int i = 0; i < GetSize(keys); i++) {
+				checksum += d.count(keys[i]);
+				checksum += d.count(misses[i]);
+			}
+		for (int i = 0; i < GetSize(keys); i += 2)
+			d.erase(keys[i]);
+		for (auto &it : d)
+			checksum += hash_ops<K>::hash(it.first);
+
+		timer.end();
+		report(stringf("dict<%s>", name).c_str(), timer.total_ns, int64_t(GetSize(keys)) * (2 * num_rounds + 2));
+
+		timer.reset();
+		timer.begin();
+
+		pool<K> p;
+		for (auto &key : keys)
+			p.insert(key);
+		for (int round = 0; round < num_rounds; round++)
+			for (int i = 0; i < GetSize(keys); i++) {
+				checksum += p.count(keys[i]);
+				checksum += p.count(misses[i]);
+			}
+
+		timer.end();
+		report(stringf("pool<%s>", name).c_str(), timer.total_ns, int64_t(GetSize(keys)) * (2 * num_rounds + 1));
+	}
+
+	void execute()
+	{
+		std::vector<int> int_keys, int_misses;
+		for (int i = 0; i < num_keys; i++) {
+			int_keys.push_back(2 * xorshift32(0x40000000));
+			int_misses.push_back(2 * xorshift32(0x40000000) + 1);
+		}
+		run("int", int_keys, int_misses, 0);
+
+		std::vector<RTLIL::IdString> id_keys, id_misses;
+		for (int i = 0; i < num_keys; i++) {
+			id_keys.push_back(stringf("\\bench_hit_%d", i));
+			id_misses.push_back(stringf("\\bench_miss_%d", i));
+		}
+		run("IdString", id_keys, id_misses, RTLIL::IdString());
+
+		// SigBits of a few wide wires, like the keys of a SigMap
+		RTLIL::Design design;
+		RTLIL::Module *module = design.addModule(ID(bench));
+		std::vector<RTLIL::Wire*> wires;
+		for (int i = 0; i < 16; i++)
+			wires.push_back(module->addWire(stringf("\\w%d", i), (num_keys + 7) / 8));
+
+		std::vector<RTLIL::SigBit> bit_keys, bit_misses;
+		for (int i = 0; i < num_keys; i++) {
+			int offset = i / 8;
+			bit_keys.push_back(RTLIL::SigBit(wires[i % 8], offset));
+			bit_misses.push_back(RTLIL::SigBit(wires[8 + i % 8], offset));
+		}
+		run("SigBit", bit_keys, bit_misses, RTLIL::SigBit());
+
+		std::vector<std::pair<RTLIL::SigBit, RTLIL::SigBit>> pair_keys, pair_misses;
+		for (int i = 0; i < num_keys; i++) {
+			pair_keys.push_back(std::make_pair(bit_keys[i], bit_keys[xorshift32(num_keys)]));
+			pair_misses.push_back(std::make_pair(bit_keys[i], bit_misses[xorshift32(num_keys)]));
+		}
+		run("pair<SigBit,SigBit>", pair_keys, pair_misses, 0);
+	}
+};
+
+struct TestHashlibPass : public Pass {
+	TestHashlibPass() : Pass("test_hashlib", "benchmark the hashlib dict<> and pool<> containers") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    test_hashlib [options]\n");
+		log("\n");
+		log("Run a microbenchmark of dict<> and pool<> with int, IdString, SigBit and\n");
+		log("pair<SigBit,SigBit> keys: insertion, hit and miss lookups, erase and iteration.\n");
+		log("Build once with and once without -DYOSYS_HASHLIB_SWISS to compare the two\n");
+		log("hash table backends.\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of keys per container (default = 100000).\n");
+		log("\n");
+		log("    -r {integer}\n");
+		log("        number of lookup rounds over all keys (default = 10).\n");
+		log("\n");
+		log("    -s {positive_integer}\n");
+		log("        use this value as rng seed value (default = 123456789).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) override
+	{
+		int num_keys = 100000;
+		int num_rounds = 10;
+		xorshift32_state = 123456789;
+
+		int argidx;
+		for (argidx = 1; argidx < GetSize(args); argidx++)
+		{
+			if (args[argidx] == "-n" && argidx+1 < GetSize(args)) {
+				num_keys = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-r" && argidx+1 < GetSize(args)) {
+				num_rounds = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-s" && argidx+1 < GetSize(args)) {
+				xorshift32_state = atoi(args[++argidx].c_str());
+				continue;
+			}
+			break;
+		}
+
+		if (num_keys < 1 || num_rounds < 0 || xorshift32_state == 0)
+			log_cmd_error("Invalid argument.\n");
+
+#ifdef YOSYS_HASHLIB_SWISS
+		log("Hashlib backend: open addressing (YOSYS_HASHLIB_SWISS)\n");
+#else
+		log("Hashlib backend: chained buckets\n");
+#endif
+		log("Keys: %d, lookup rounds: %d\n\n", num_keys, num_rounds);
+
+		HashlibBench bench(num_keys, num_rounds);
+		bench.execute();
+
+		log("\nChecksum: %llu\n", (unsigned long long)bench.checksum);
+	}
+} TestHashlibPass;
+
+PRIVATE_NAMESPACE_END
@@ -77,6 +77,21 @@ struct SynthPass : public ScriptPass {
 		log("        from label is synonymous to 'begin', and empty to label is\n");
 		log("        synonymous to the end of the command list.\n");
 		log("\n");
+		log("    -checkpoint <dir>\n");
+		log("        write a snapshot of the design and its scratchpad to <dir> at the\n");
+		log("        start of every label that is run. map libraries loaded by techmap\n");
+		log("        are cached in <dir>/techmap unless YOSYS_TECHMAP_CACHE is set.\n");
+		log("\n");
+		log("    -resume\n");
+		log("        together with -checkpoint and -run, replace the current design with\n");
+		log("        the snapshot taken at the from label instead of running the earlier\n");
+		log("        labels again.\n");
+		log("\n");
+		log("    -profile\n");
+		log("        print the wall time, CPU time, peak memory and change of the cell\n");
+		log("        count of every label that was run. these are also sent as\n");
+		log("        LABEL_PROFILE data to the DATA pipe, with or without this option.\n");
+		log("\n");
 		log("    -abc9\n");
 		log("        use new ABC9 flow (EXPERIMENTAL)\n");
 		log("\n");
@@ -106,6 +121,9 @@ struct SynthPass : public ScriptPass {
 	void clear_flags() override
 	{
 		top_module.clear();
+		checkpoint_dir.clear();
+		checkpoint_resume = false;
+		profile_labels = false;
 		fsm_opts.clear();
 		memory_opts.clear();
 
@@ -148,6 +166,18 @@ struct SynthPass : public ScriptPass {
 				}
 				continue;
 			}
+			if (args[argidx] == "-checkpoint" && argidx + 1 < args.size()) {
+				checkpoint_dir = args[++argidx];
+				continue;
+			}
+			if (args[argidx] == "-resume") {
+				checkpoint_resume = true;
+				continue;
+			}
+			if (args[argidx] == "-profile") {
+				profile_labels = true;
+				continue;
+			}
 			if (args[argidx] == "-auto-top") {
 				autotop = true;
 				continue;
@@ -19,14 +19,62 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-typedef std::pair<Const, std::vector<SigBit>> LutData;
+// LUT truth tables are kept as 64-bit masks, bit i holding the output for
+// input combination i (enough for LUT6), so that merging two LUTs is a few
+// word operations instead of a walk over the bits of an INIT parameter.
+typedef std::pair<uint64_t, std::vector<SigBit>> LutData;
+
+static const uint64_t lut_var[6] = {
+	0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+	0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull,
+};
+
+static uint64_t lut_mask(int inputs)
+{
+	return inputs >= 6 ? ~uint64_t(0) : (uint64_t(1) << (1 << inputs)) - 1;
+}
+
+static uint64_t lut_from_const(const Const &init)
+{
+	uint64_t table = 0;
+	for (int i = 0; i < GetSize(init) && i < 64; i++)
+		if (init.bits[i] == State::S1)
+			table |= uint64_t(1) << i;
+	return table;
+}
+
+static Const lut_to_const(uint64_t table, int inputs)
+{
+	Const init(State::S0, 1 << inputs);
+	for (int i = 0; i < GetSize(init); i++)
+		if (table >> i & 1)
+			init.bits[i] = State::S1;
+	return init;
+}
+
+// Re-expresses a LUT whose input j is input idx[j] of a larger LUT as a
+// truth table over the inputs of the larger LUT.
+static uint64_t remap_lut(uint64_t table, const std::vector<int> &idx)
+{
+	uint64_t result = 0;
+	for (int m = 0; m < (1 << GetSize(idx)); m++) {
+		if (!(table >> m & 1))
+			continue;
+		uint64_t minterm = ~uint64_t(0);
+		for (int j = 0; j < GetSize(idx); j++)
+			minterm &= (m >> j & 1) ? lut_var[idx[j]] : ~lut_var[idx[j]];
+		result |= minterm;
+	}
+	return result;
+}
 
 // Compute a LUT implementing (select ^ select_inv) ? alt_data : data.  Returns true if successful.
-bool merge_lut(LutData &result, const LutData &data, const LutData select, bool select_inv, SigBit alt_data, int max_lut_size) {
+bool merge_lut(LutData &result, const LutData &data, const LutData &select, bool select_inv, SigBit alt_data, int max_lut_size) {
 	// First, gather input signals -- insert new signals at the beginning
 	// of the vector, so they don't disturb the likely-critical D LUT input
 	// timings.
@@ -73,28 +121,164 @@ bool merge_lut(LutData &result, const LutData &data, const LutData select, bool
 		return false;
 
 	// Okay, we're doing it — compute the LUT mask.
-	result.first = Const(0, 1 << GetSize(result.second));
-	for (int i = 0; i < GetSize(result.first); i++) {
-		int sel_lut_idx = 0;
-		for (int j = 0; j < GetSize(select.second); j++)
-			if (i & 1 << idx_sel[j])
-				sel_lut_idx |= 1 << j;
-		bool select_val = (select.first.bits[sel_lut_idx] == State::S1);
-		bool new_bit;
-		if (select_val ^ select_inv) {
-			// Use alt_data.
-			if (alt_data.wire)
-				new_bit = (i & 1 << idx_alt) != 0;
-			else
-				new_bit = alt_data.data == State::S1;
-		} else {
-			// Use original LUT.
-			int lut_idx = i >> idx_data & ((1 << GetSize(data.second)) - 1);
-			new_bit = data.first.bits[lut_idx] == State::S1;
+	std::vector<int> idx_d;
+	for (int j = 0; j < GetSize(data.second); j++)
+		idx_d.push_back(idx_data + j);
+	uint64_t sel_table = remap_lut(select.first, idx_sel);
+	if (select_inv)
+		sel_table = ~sel_table;
+	uint64_t alt_table;
+	if (alt_data.wire)
+		alt_table = lut_var[idx_alt];
+	else
+		alt_table = alt_data.data == State::S1 ? ~uint64_t(0) : 0;
+	uint64_t data_table = remap_lut(data.first, idx_d);
+	result.first = ((sel_table & alt_table) | (~sel_table & data_table)) & lut_mask(GetSize(result.second));
+	return true;
+}
+
+// The outcome of looking at one FF, computed before any FF is changed.
+struct FfMerge {
+	Cell *cell = nullptr;
+	Cell *cell_d = nullptr;
+	Wire *q_wire = nullptr;
+	LutData final_lut;
+	int d_inputs = 0;
+	bool has_s = false;
+	bool worthy_post_ce = false, worthy_post_s = false, worthy_post_r = false;
+};
+
+// Decides whether the control signals of one FF are better emulated in its
+// D LUT, and if so fills in merge with the LUT to create.  Only reads the
+// module, so that many FFs can be looked at in parallel.
+static void analyze_ff(FfMerge &merge, Cell *cell, const SigMap &sigmap, const dict<SigBit, pair<LutData, Cell *>> &bit_to_lut,
+		const dict<SigBit, int> &bit_uses, int max_lut_size)
+{
+	bool has_s = false, has_r = false;
+	if (cell->type.in(ID(FDCE), ID(FDPE), ID(FDCPE), ID(FDCE_1), ID(FDPE_1), ID(FDCPE_1))) {
+		// Async reset.
+	} else if (cell->type.in(ID(FDRE), ID(FDRE_1))) {
+		has_r = true;
+	} else if (cell->type.in(ID(FDSE), ID(FDSE_1))) {
+		has_s = true;
+	} else if (cell->type.in(ID(FDRSE), ID(FDRSE_1))) {
+		has_r = true;
+		has_s = true;
+	} else {
+		// Not a FF.
+		return;
+	}
+
+	// Don't bother if D has more than one use.
+	SigBit sig_D = sigmap(cell->getPort(ID::D));
+	auto it_uses = bit_uses.find(sig_D);
+	if (it_uses != bit_uses.end() && it_uses->second > 2)
+		return;
+
+	// Find the D LUT.
+	auto it_D = bit_to_lut.find(sig_D);
+	if (it_D == bit_to_lut.end())
+		return;
+	LutData lut_d = it_D->second.first;
+	Cell *cell_d = it_D->second.second;
+	if (cell->hasParam(ID(IS_D_INVERTED)) && cell->getParam(ID(IS_D_INVERTED)).as_bool()) {
+		// Flip all bits in the LUT.
+		lut_d.first ^= lut_mask(GetSize(lut_d.second));
+	}
+
+	LutData lut_d_post_ce;
+	LutData lut_d_post_s;
+	LutData lut_d_post_r;
+	bool worthy_post_ce = false;
+	bool worthy_post_s = false;
+	bool worthy_post_r = false;
+
+	// First, unmap CE.
+	SigBit sig_Q = sigmap(cell->getPort(ID::Q));
+	SigBit sig_CE = sigmap(cell->getPort(ID(CE)));
+	LutData lut_ce = LutData(2, {sig_CE});
+	auto it_CE = bit_to_lut.find(sig_CE);
+	if (it_CE != bit_to_lut.end())
+		lut_ce = it_CE->second.first;
+	if (sig_CE.wire) {
+		// Merge CE LUT and D LUT into one.  If it cannot be done, nothing to do about this FF.
+		if (!merge_lut(lut_d_post_ce, lut_d, lut_ce, true, sig_Q, max_lut_size))
+			return;
+
+		// If this gets rid of a CE LUT, it's worth it.  If not, it still may be worth it, if we can remove set/reset as well.
+		if (it_CE != bit_to_lut.end())
+			worthy_post_ce = true;
+	} else if (sig_CE.data != State::S1) {
+		// Strange.  Should not happen in a reasonable flow, so bail.
+		return;
+	} else {
+		lut_d_post_ce = lut_d;
+	}
+
+	// Second, unmap S, if any.
+	lut_d_post_s = lut_d_post_ce;
+	if (has_s) {
+		SigBit sig_S = sigmap(cell->getPort(ID::S));
+		LutData lut_s = LutData(2, {sig_S});
+		bool inv_s = cell->hasParam(ID(IS_S_INVERTED)) && cell->getParam(ID(IS_S_INVERTED)).as_bool();
+		auto it_S = bit_to_lut.find(sig_S);
+		if (it_S != bit_to_lut.end())
+			lut_s = it_S->second.first;
+		if (sig_S.wire) {
+			// Merge S LUT and D LUT into one.  If it cannot be done, try to at least merge CE.
+			if (!merge_lut(lut_d_post_s, lut_d_post_ce, lut_s, inv_s, SigBit(State::S1), max_lut_size))
+				goto unmap;
+			// If this gets rid of an S LUT, it's worth it.
+			if (it_S != bit_to_lut.end())
+				worthy_post_s = true;
+		} else if (sig_S.data != (inv_s ? State::S1 : State::S0)) {
+			// Strange.  Should not happen in a reasonable flow, so bail.
+			return;
 		}
-		result.first.bits[i] = new_bit ? State::S1 : State::S0;
 	}
-	return true;
+
+	// Third, unmap R, if any.
+	lut_d_post_r = lut_d_post_s;
+	if (has_r) {
+		SigBit sig_R = sigmap(cell->getPort(ID::R));
+		LutData lut_r = LutData(2, {sig_R});
+		bool inv_r = cell->hasParam(ID(IS_R_INVERTED)) && cell->getParam(ID(IS_R_INVERTED)).as_bool();
+		auto it_R = bit_to_lut.find(sig_R);
+		if (it_R != bit_to_lut.end())
+			lut_r = it_R->second.first;
+		if (sig_R.wire) {
+			// Merge R LUT and D LUT into one.  If it cannot be done, try to at least merge CE/S.
+			if (!merge_lut(lut_d_post_r, lut_d_post_s, lut_r, inv_r, SigBit(State::S0), max_lut_size))
+				goto unmap;
+			// If this gets rid of an S LUT, it's worth it.
+			if (it_R != bit_to_lut.end())
+				worthy_post_r = true;
+		} else if (sig_R.data != (inv_r ? State::S1 : State::S0)) {
+			// Strange.  Should not happen in a reasonable flow, so bail.
+			return;
+		}
+	}
+
+unmap:
+	if (worthy_post_r) {
+		merge.final_lut = lut_d_post_r;
+	} else if (worthy_post_s) {
+		merge.final_lut = lut_d_post_s;
+	} else if (worthy_post_ce) {
+		merge.final_lut = lut_d_post_ce;
+	} else {
+		// Nothing to do here.
+		return;
+	}
+
+	merge.cell = cell;
+	merge.cell_d = cell_d;
+	merge.q_wire = sig_Q.wire;
+	merge.d_inputs = GetSize(lut_d.second);
+	merge.has_s = has_s;
+	merge.worthy_post_ce = worthy_post_ce;
+	merge.worthy_post_s = worthy_post_s;
+	merge.worthy_post_r = worthy_post_r;
 }
 
 struct XilinxDffOptPass : public Pass {
@@ -112,6 +296,9 @@ struct XilinxDffOptPass : public Pass {
 		log("    -lut4\n");
 		log("        Assume a LUT4-based device (instead of a LUT6-based device).\n");
 		log("\n");
+		log("When synthesizer runs with -j <jobs>, the FFs of a module are inspected in\n");
+		log("parallel, in blocks of consecutive cells, and then rewritten one by one.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -140,8 +327,9 @@ struct XilinxDffOptPass : public Pass {
 			SigMap sigmap(module);
 			dict<SigBit, pair<LutData, Cell *>> bit_to_lut;
 			dict<SigBit, int> bit_uses;
+			std::vector<Cell*> ffs;
 
-			// Gather LUTs.
+			// Gather LUTs and FFs.
 			for (auto cell : module->selected_cells())
 			{
 				for (auto port : cell->connections())
@@ -152,7 +340,7 @@ struct XilinxDffOptPass : public Pass {
 				if (cell->type == ID(INV)) {
 					SigBit sigout = sigmap(cell->getPort(ID::O));
 					SigBit sigin = sigmap(cell->getPort(ID::I));
-					bit_to_lut[sigout] = make_pair(LutData(Const(1, 2), {sigin}), cell);
+					bit_to_lut[sigout] = make_pair(LutData(1, {sigin}), cell);
 				} else if (cell->type.in(ID(LUT1), ID(LUT2), ID(LUT3), ID(LUT4), ID(LUT5), ID(LUT6))) {
 					SigBit sigout = sigmap(cell->getPort(ID::O));
 					const Const &init = cell->getParam(ID::INIT);
@@ -174,7 +362,10 @@ struct XilinxDffOptPass : public Pass {
 						goto lut_sigin_done;
 					sigin.push_back(sigmap(cell->getPort(ID(I5))));
 lut_sigin_done:
-					bit_to_lut[sigout] = make_pair(LutData(init, sigin), cell);
+					bit_to_lut[sigout] = make_pair(LutData(lut_from_const(init) & lut_mask(GetSize(sigin)), sigin), cell);
+				} else if (cell->type.in(ID(FDCE), ID(FDPE), ID(FDCPE), ID(FDCE_1), ID(FDPE_1), ID(FDCPE_1),
+						ID(FDRE), ID(FDRE_1), ID(FDSE), ID(FDSE_1), ID(FDRSE), ID(FDRSE_1))) {
+					ffs.push_back(cell);
 				}
 			}
 			for (auto wire : module->wires())
@@ -182,141 +373,36 @@ lut_sigin_done:
 					for (int i = 0; i < GetSize(wire); i++)
 						bit_uses[sigmap(SigBit(wire, i))]++;
 
-			// Iterate through FFs.
-			for (auto cell : module->selected_cells())
-			{
-				bool has_s = false, has_r = false;
-				if (cell->type.in(ID(FDCE), ID(FDPE), ID(FDCPE), ID(FDCE_1), ID(FDPE_1), ID(FDCPE_1))) {
-					// Async reset.
-				} else if (cell->type.in(ID(FDRE), ID(FDRE_1))) {
-					has_r = true;
-				} else if (cell->type.in(ID(FDSE), ID(FDSE_1))) {
-					has_s = true;
-				} else if (cell->type.in(ID(FDRSE), ID(FDRSE_1))) {
-					has_r = true;
-					has_s = true;
-				} else {
-					// Not a FF.
-					continue;
-				}
-				if (cell->get_bool_attribute(ID::keep))
-					continue;
-
-				// Don't bother if D has more than one use.
-				SigBit sig_D = sigmap(cell->getPort(ID::D));
-				if (bit_uses[sig_D] > 2)
-					continue;
-
-				// Find the D LUT.
-				auto it_D = bit_to_lut.find(sig_D);
-				if (it_D == bit_to_lut.end())
-					continue;
-				LutData lut_d = it_D->second.first;
-				Cell *cell_d = it_D->second.second;
-				if (cell->hasParam(ID(IS_D_INVERTED)) && cell->getParam(ID(IS_D_INVERTED)).as_bool()) {
-					// Flip all bits in the LUT.
-					for (int i = 0; i < GetSize(lut_d.first); i++)
-						lut_d.first.bits[i] = (lut_d.first.bits[i] == State::S1) ? State::S0 : State::S1;
-				}
+			// Look at all FFs against the indexes above, which do not change
+			// until every FF has been looked at.
+			std::vector<FfMerge> merges(GetSize(ffs));
+			const int block_size = 4096;
+			parallel_for((GetSize(ffs) + block_size - 1) / block_size, [&](int block) {
+				int block_end = std::min(GetSize(ffs), (block + 1) * block_size);
+				for (int i = block * block_size; i < block_end; i++)
+					analyze_ff(merges[i], ffs[i], sigmap, bit_to_lut, bit_uses, max_lut_size);
+			});
 
-				LutData lut_d_post_ce;
-				LutData lut_d_post_s;
-				LutData lut_d_post_r;
-				bool worthy_post_ce = false;
-				bool worthy_post_s = false;
-				bool worthy_post_r = false;
-
-				// First, unmap CE.
-				SigBit sig_Q = sigmap(cell->getPort(ID::Q));
-				SigBit sig_CE = sigmap(cell->getPort(ID(CE)));
-				LutData lut_ce = LutData(Const(2, 2), {sig_CE});
-				auto it_CE = bit_to_lut.find(sig_CE);
-				if (it_CE != bit_to_lut.end())
-					lut_ce = it_CE->second.first;
-				if (sig_CE.wire) {
-					// Merge CE LUT and D LUT into one.  If it cannot be done, nothing to do about this FF.
-					if (!merge_lut(lut_d_post_ce, lut_d, lut_ce, true, sig_Q, max_lut_size))
-						continue;
-
-					// If this gets rid of a CE LUT, it's worth it.  If not, it still may be worth it, if we can remove set/reset as well.
-					if (it_CE != bit_to_lut.end())
-						worthy_post_ce = true;
-				} else if (sig_CE.data != State::S1) {
-					// Strange.  Should not happen in a reasonable flow, so bail.
-					continue;
-				} else {
-					lut_d_post_ce = lut_d;
-				}
-
-				// Second, unmap S, if any.
-				lut_d_post_s = lut_d_post_ce;
-				if (has_s) {
-					SigBit sig_S = sigmap(cell->getPort(ID::S));
-					LutData lut_s = LutData(Const(2, 2), {sig_S});
-					bool inv_s = cell->hasParam(ID(IS_S_INVERTED)) && cell->getParam(ID(IS_S_INVERTED)).as_bool();
-					auto it_S = bit_to_lut.find(sig_S);
-					if (it_S != bit_to_lut.end())
-						lut_s = it_S->second.first;
-					if (sig_S.wire) {
-						// Merge S LUT and D LUT into one.  If it cannot be done, try to at least merge CE.
-						if (!merge_lut(lut_d_post_s, lut_d_post_ce, lut_s, inv_s, SigBit(State::S1), max_lut_size))
-							goto unmap;
-						// If this gets rid of an S LUT, it's worth it.
-						if (it_S != bit_to_lut.end())
-							worthy_post_s = true;
-					} else if (sig_S.data != (inv_s ? State::S1 : State::S0)) {
-						// Strange.  Should not happen in a reasonable flow, so bail.
-						continue;
-					}
-				}
-
-				// Third, unmap R, if any.
-				lut_d_post_r = lut_d_post_s;
-				if (has_r) {
-					SigBit sig_R = sigmap(cell->getPort(ID::R));
-					LutData lut_r = LutData(Const(2, 2), {sig_R});
-					bool inv_r = cell->hasParam(ID(IS_R_INVERTED)) && cell->getParam(ID(IS_R_INVERTED)).as_bool();
-					auto it_R = bit_to_lut.find(sig_R);
-					if (it_R != bit_to_lut.end())
-						lut_r = it_R->second.first;
-					if (sig_R.wire) {
-						// Merge R LUT and D LUT into one.  If it cannot be done, try to at least merge CE/S.
-						if (!merge_lut(lut_d_post_r, lut_d_post_s, lut_r, inv_r, SigBit(State::S0), max_lut_size))
-							goto unmap;
-						// If this gets rid of an S LUT, it's worth it.
-						if (it_R != bit_to_lut.end())
-							worthy_post_r = true;
-					} else if (sig_R.data != (inv_r ? State::S1 : State::S0)) {
-						// Strange.  Should not happen in a reasonable flow, so bail.
-						continue;
-					}
-				}
-
-unmap:
-				LutData final_lut;
-				if (worthy_post_r) {
-					final_lut = lut_d_post_r;
-				} else if (worthy_post_s) {
-					final_lut = lut_d_post_s;
-				} else if (worthy_post_ce) {
-					final_lut = lut_d_post_ce;
-				} else {
-					// Nothing to do here.
+			// Rewrite the FFs worth it, in cell order.
+			for (auto &merge : merges)
+			{
+				if (merge.cell == nullptr)
 					continue;
-				}
+				Cell *cell = merge.cell;
+				LutData &final_lut = merge.final_lut;
 
 				std::string ports;
-				if (worthy_post_r) ports += " + R";
-				if (worthy_post_s) ports += " + S";
-				if (worthy_post_ce) ports += " + CE";
-				log("  Merging D%s LUTs for %s/%s (%d -> %d)\n", ports.c_str(), log_id(cell), log_id(sig_Q.wire), GetSize(lut_d.second), GetSize(final_lut.second));
+				if (merge.worthy_post_r) ports += " + R";
+				if (merge.worthy_post_s) ports += " + S";
+				if (merge.worthy_post_ce) ports += " + CE";
+				log("  Merging D%s LUTs for %s/%s (%d -> %d)\n", ports.c_str(), log_id(cell), log_id(merge.q_wire), merge.d_inputs, GetSize(final_lut.second));
 
 				// Okay, we're doing it.  Unmap ports.
-				if (worthy_post_r) {
+				if (merge.worthy_post_r) {
 					cell->unsetParam(ID(IS_R_INVERTED));
 					cell->setPort(ID::R, Const(0, 1));
 				}
-				if (has_s && (worthy_post_r || worthy_post_s)) {
+				if (merge.has_s && (merge.worthy_post_r || merge.worthy_post_s)) {
 					cell->unsetParam(ID(IS_S_INVERTED));
 					cell->setPort(ID::S, Const(0, 1));
 				}
@@ -347,9 +433,9 @@ unmap:
 					default:
 						log_assert(!"unknown lut size");
 				}
-				lut_cell->attributes = cell_d->attributes;
+				lut_cell->attributes = merge.cell_d->attributes;
 				Wire *lut_out = module->addWire(NEW_ID);
-				lut_cell->setParam(ID::INIT, final_lut.first);
+				lut_cell->setParam(ID::INIT, lut_to_const(final_lut.first, GetSize(final_lut.second)));
 				cell->setPort(ID::D, lut_out);
 				lut_cell->setPort(ID::O, lut_out);
 				lut_cell->setPort(ID(I0), final_lut.second[0]);